@@ -9,7 +9,47 @@
 /// Enable/Disable DLNA Output (Casting to remote renderers)
 #define ENABLE_DLNA_OUTPUT 0
 
+/// Enable/Disable the DLNA media server (the library browsable by renderers
+/// and control points on the network)
+#define ENABLE_DLNA_SERVER 0
+
 /// Enable/Disable MIDI file support (.mid/.midi scanning and playback)
 #define ENABLE_MIDI_PLAYBACK 0
 
+/// Render MIDI files to PCM with FluidSynth and decode them like any other
+/// track (seeking, fades, gapless, analysis) instead of playing them on the
+/// system synth. Needs ENABLE_MIDI_PLAYBACK and an installed soundfont;
+/// `make MIDI_RENDERING=1` sets it and links libfluidsynth.
+#ifndef ENABLE_MIDI_RENDERING
+#define ENABLE_MIDI_RENDERING 0
+#endif
+
+/// Fingerprint the library with Chromaprint and look the fingerprints up on
+/// AcoustID (File > Identify Recordings). `make ACOUSTID=1` sets it and
+/// links libchromaprint.
+#ifndef ENABLE_ACOUSTID
+#define ENABLE_ACOUSTID 0
+#endif
+
+/// Application key for the AcoustID web service. Without one, fingerprints
+/// are computed and stored but not looked up.
+#ifndef ACOUSTID_CLIENT_KEY
+#define ACOUSTID_CLIENT_KEY ""
+#endif
+
+/// Compress the library and DLNA cache files in independent LZ4 or Zstd
+/// blocks when the settings directory reads slowly (network or USB
+/// storage). `make CACHE_COMPRESSION=1` sets it and links liblz4 and
+/// libzstd; builds without it reject compressed files and rebuild them.
+#ifndef ENABLE_CACHE_COMPRESSION
+#define ENABLE_CACHE_COMPRESSION 0
+#endif
+
+/// Trace categories compiled in, a mask of TraceCategory (see Trace.h).
+/// They are recorded only with `--trace <file>`; `make TRACE_CATEGORIES=0`
+/// removes every trace point from the build.
+#ifndef TRACE_CATEGORIES
+#define TRACE_CATEGORIES 0x1f
+#endif
+
 #endif // BETON_CONFIG_H
@@ -0,0 +1,243 @@
+#include "LooperStats.h"
+
+#include <File.h>
+#include <Looper.h>
+#include <Message.h>
+#include <MessageQueue.h>
+
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <vector>
+
+/** @brief Histogram buckets; bucket i holds [2^i, 2^(i+1)) microseconds. */
+static const int32 kBuckets = 24;
+static const int32 kMaxLoopers = 16;
+/** @brief (looper, what) pairs tracked; a power of two. */
+static const int32 kMaxEntries = 1024;
+static const int32 kNameLength = 32;
+
+struct StatsEntry {
+  std::atomic<uint64> key;      ///< (slot + 1) << 32 | what; 0 = unused
+  std::atomic<uint32> counts[kBuckets];
+  std::atomic<uint64> totalTime;
+  std::atomic<uint64> maxTime;
+  std::atomic<uint64> totalDepth;
+  std::atomic<uint32> maxDepth;
+};
+
+std::atomic<bool> LooperStats::sEnabled(false);
+
+static StatsEntry sEntries[kMaxEntries];
+static char sNames[kMaxLoopers][kNameLength];
+static std::atomic<int32> sNameCount(0);
+static std::atomic<uint32> sDropped(0);
+
+template <typename T>
+static void AtomicMax(std::atomic<T> &target, T value) {
+  T current = target.load(std::memory_order_relaxed);
+  while (value > current &&
+         !target.compare_exchange_weak(current, value,
+                                       std::memory_order_relaxed))
+    ;
+}
+
+static int32 BucketFor(bigtime_t elapsed) {
+  int32 bucket = 0;
+  while (bucket < kBuckets - 1 && elapsed >= ((bigtime_t)2 << bucket))
+    bucket++;
+  return bucket;
+}
+
+/** @brief Finds or claims the entry of `key`; nullptr if the table is full. */
+static StatsEntry *EntryFor(uint64 key) {
+  uint32 index = (uint32)((key * 0x9E3779B97F4A7C15ULL) >> 54) &
+                 (kMaxEntries - 1);
+  for (int32 probe = 0; probe < kMaxEntries; probe++) {
+    StatsEntry &entry = sEntries[(index + probe) & (kMaxEntries - 1)];
+    uint64 current = entry.key.load(std::memory_order_acquire);
+    if (current == key)
+      return &entry;
+    if (current == 0) {
+      uint64 expected = 0;
+      if (entry.key.compare_exchange_strong(expected, key,
+                                            std::memory_order_acq_rel) ||
+          expected == key)
+        return &entry;
+    }
+  }
+  return nullptr;
+}
+
+void LooperStats::SetEnabled(bool enabled) {
+  sEnabled.store(enabled, std::memory_order_relaxed);
+}
+
+int32 LooperStats::Register(const char *name) {
+  static std::atomic<int32> sLock(0);
+  while (sLock.exchange(1, std::memory_order_acquire) != 0)
+    snooze(100);
+
+  int32 count = sNameCount.load(std::memory_order_relaxed);
+  int32 slot = -1;
+  for (int32 i = 0; i < count; i++) {
+    if (strcmp(sNames[i], name) == 0) {
+      slot = i;
+      break;
+    }
+  }
+  if (slot < 0 && count < kMaxLoopers) {
+    strlcpy(sNames[count], name, kNameLength);
+    slot = count;
+    sNameCount.store(count + 1, std::memory_order_release);
+  }
+
+  sLock.store(0, std::memory_order_release);
+  return slot;
+}
+
+void LooperStats::Record(int32 slot, uint32 what, bigtime_t elapsed,
+                         int32 queueDepth) {
+  if (slot < 0 || elapsed < 0)
+    return;
+  StatsEntry *entry = EntryFor(((uint64)(slot + 1) << 32) | what);
+  if (entry == nullptr) {
+    sDropped.fetch_add(1, std::memory_order_relaxed);
+    return;
+  }
+
+  entry->counts[BucketFor(elapsed)].fetch_add(1, std::memory_order_relaxed);
+  entry->totalTime.fetch_add((uint64)elapsed, std::memory_order_relaxed);
+  AtomicMax(entry->maxTime, (uint64)elapsed);
+  entry->totalDepth.fetch_add((uint64)queueDepth, std::memory_order_relaxed);
+  AtomicMax(entry->maxDepth, (uint32)queueDepth);
+}
+
+void LooperStats::Reset() {
+  // Keys stay claimed so concurrent recorders keep valid entries.
+  for (StatsEntry &entry : sEntries) {
+    for (auto &count : entry.counts)
+      count.store(0, std::memory_order_relaxed);
+    entry.totalTime.store(0, std::memory_order_relaxed);
+    entry.maxTime.store(0, std::memory_order_relaxed);
+    entry.totalDepth.store(0, std::memory_order_relaxed);
+    entry.maxDepth.store(0, std::memory_order_relaxed);
+  }
+  sDropped.store(0, std::memory_order_relaxed);
+}
+
+static void FormatWhat(uint32 what, BString &out) {
+  char code[5] = {(char)(what >> 24), (char)(what >> 16), (char)(what >> 8),
+                  (char)what, 0};
+  bool printable = true;
+  for (int i = 0; i < 4; i++)
+    printable = printable && isprint((unsigned char)code[i]);
+  if (printable)
+    out.SetToFormat("'%s'", code);
+  else
+    out.SetToFormat("0x%08" B_PRIx32, what);
+}
+
+/** @brief Upper bound (us) of the bucket holding the given fraction. */
+static bigtime_t Percentile(const uint32 *counts, uint64 total,
+                            double fraction) {
+  uint64 wanted = (uint64)(total * fraction + 0.5);
+  uint64 seen = 0;
+  for (int32 i = 0; i < kBuckets; i++) {
+    seen += counts[i];
+    if (seen >= wanted && seen > 0)
+      return (bigtime_t)2 << i;
+  }
+  return (bigtime_t)2 << (kBuckets - 1);
+}
+
+BString LooperStats::Report() {
+  struct Row {
+    int32 slot;
+    uint32 what;
+    uint32 counts[kBuckets];
+    uint64 count;
+    uint64 totalTime;
+    uint64 maxTime;
+    uint64 totalDepth;
+    uint32 maxDepth;
+  };
+
+  std::vector<Row> rows;
+  for (StatsEntry &entry : sEntries) {
+    uint64 key = entry.key.load(std::memory_order_acquire);
+    if (key == 0)
+      continue;
+    Row row;
+    row.slot = (int32)(key >> 32) - 1;
+    row.what = (uint32)key;
+    row.count = 0;
+    for (int32 i = 0; i < kBuckets; i++) {
+      row.counts[i] = entry.counts[i].load(std::memory_order_relaxed);
+      row.count += row.counts[i];
+    }
+    if (row.count == 0)
+      continue;
+    row.totalTime = entry.totalTime.load(std::memory_order_relaxed);
+    row.maxTime = entry.maxTime.load(std::memory_order_relaxed);
+    row.totalDepth = entry.totalDepth.load(std::memory_order_relaxed);
+    row.maxDepth = entry.maxDepth.load(std::memory_order_relaxed);
+    rows.push_back(row);
+  }
+
+  std::sort(rows.begin(), rows.end(), [](const Row &a, const Row &b) {
+    return a.totalTime > b.totalTime;
+  });
+
+  BString report;
+  report.SetToFormat("%-20s %-12s %8s %10s %8s %8s %8s %9s %6s %6s\n",
+                     "Looper", "What", "Count", "Total ms", "Mean us",
+                     "p50 us", "p99 us", "Max us", "Queue", "Max Q");
+  int32 names = sNameCount.load(std::memory_order_acquire);
+  for (const Row &row : rows) {
+    BString what, line;
+    FormatWhat(row.what, what);
+    line.SetToFormat(
+        "%-20s %-12s %8" B_PRIu64 " %10.1f %8" B_PRIu64 " %8" B_PRIdBIGTIME
+        " %8" B_PRIdBIGTIME " %9" B_PRIu64 " %6.1f %6" B_PRIu32 "\n",
+        row.slot < names ? sNames[row.slot] : "?", what.String(), row.count,
+        row.totalTime / 1000.0, row.totalTime / row.count,
+        Percentile(row.counts, row.count, 0.5),
+        Percentile(row.counts, row.count, 0.99), row.maxTime,
+        (double)row.totalDepth / row.count, row.maxDepth);
+    report << line;
+  }
+
+  uint32 dropped = sDropped.load(std::memory_order_relaxed);
+  if (dropped > 0)
+    report << "\n" << dropped << " dispatches not recorded (table full)\n";
+  return report;
+}
+
+status_t LooperStats::DumpToFile(const char *path) {
+  BFile file(path, B_WRITE_ONLY | B_CREATE_FILE | B_ERASE_FILE);
+  status_t status = file.InitCheck();
+  if (status != B_OK)
+    return status;
+  BString report = Report();
+  ssize_t written = file.Write(report.String(), report.Length());
+  return written == report.Length() ? B_OK
+                                    : (written < 0 ? (status_t)written
+                                                   : B_IO_ERROR);
+}
+
+LooperStats::Scope::Scope(int32 slot, BLooper *looper, const BMessage *msg)
+    : fSlot(-1), fWhat(0), fQueueDepth(0), fStart(0) {
+  if (!IsEnabled() || msg == nullptr)
+    return;
+  fSlot = slot;
+  fWhat = msg->what;
+  if (looper != nullptr && looper->MessageQueue() != nullptr)
+    fQueueDepth = looper->MessageQueue()->CountMessages();
+  fStart = system_time();
+}
+
+LooperStats::Scope::~Scope() {
+  if (fSlot >= 0)
+    Record(fSlot, fWhat, system_time() - fStart, fQueueDepth);
+}
@@ -0,0 +1,74 @@
+#ifndef BETON_LOOPER_STATS_H
+#define BETON_LOOPER_STATS_H
+
+#include <OS.h>
+#include <String.h>
+#include <SupportDefs.h>
+#include <atomic>
+
+class BLooper;
+class BMessage;
+
+/**
+ * @class LooperStats
+ * @brief Opt-in per-message timing of the application's loopers.
+ *
+ * Instrumented loopers wrap `DispatchMessage()` in a `Scope`. While enabled
+ * (`--looper-stats` on the command line) each dispatch adds its handling
+ * time to a log2 histogram keyed by looper and message `what`, together with
+ * the number of messages still queued behind it. All counters are atomics
+ * in a fixed table, so recording never locks or allocates.
+ *
+ * Haiku does not timestamp messages, so queue wait is reported as the queue
+ * depth seen at dispatch: a message handled with N others queued waited for
+ * N handling times.
+ *
+ * When disabled a Scope costs one relaxed atomic load.
+ */
+class LooperStats {
+public:
+  static void SetEnabled(bool enabled);
+  static bool IsEnabled() {
+    return sEnabled.load(std::memory_order_relaxed);
+  }
+
+  /**
+   * @brief Returns the slot of a looper name, registering it if needed.
+   * @return Slot index, or -1 if the name table is full.
+   */
+  static int32 Register(const char *name);
+
+  /** @brief Adds one dispatch; called by Scope. */
+  static void Record(int32 slot, uint32 what, bigtime_t elapsed,
+                     int32 queueDepth);
+
+  /** @brief Drops all recorded samples. */
+  static void Reset();
+
+  /** @brief Plain text table, slowest total first. */
+  static BString Report();
+
+  /** @brief Writes Report() to `path`. */
+  static status_t DumpToFile(const char *path);
+
+  /**
+   * @class Scope
+   * @brief Times the dispatch of one message.
+   */
+  class Scope {
+  public:
+    Scope(int32 slot, BLooper *looper, const BMessage *msg);
+    ~Scope();
+
+  private:
+    int32 fSlot;
+    uint32 fWhat;
+    int32 fQueueDepth;
+    bigtime_t fStart;
+  };
+
+private:
+  static std::atomic<bool> sEnabled;
+};
+
+#endif // BETON_LOOPER_STATS_H
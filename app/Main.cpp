@@ -1,4 +1,6 @@
 #include "Debug.h"
+#include "LooperStats.h"
+#include "Trace.h"
 #include "MainWindow.h"
 #include "Messages.h"
 #include <Application.h>
@@ -223,9 +225,15 @@ private:
 int main(int argc, char **argv) {
   signal(SIGPIPE, SIG_IGN);
 
+  const char *tracePath = nullptr;
+
   for (int i = 1; i < argc; ++i) {
     if (strcmp(argv[i], "--debug") == 0) {
       gIsDebug = true;
+    } else if (strcmp(argv[i], "--looper-stats") == 0) {
+      LooperStats::SetEnabled(true);
+    } else if (strcmp(argv[i], "--trace") == 0 && i + 1 < argc) {
+      tracePath = argv[++i];
     }
   }
 
@@ -239,7 +247,11 @@ int main(int argc, char **argv) {
     DEBUG_PRINT("Starting in DEBUG mode\n");
   }
 
+  if (tracePath != nullptr && Trace::Start(tracePath) != B_OK)
+    fprintf(stderr, "Cannot write trace to %s\n", tracePath);
+
   BetonApp app;
   app.Run();
+  Trace::Stop();
   return 0;
 }
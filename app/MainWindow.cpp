@@ -1,6 +1,7 @@
 #include "MainWindow.h"
 #include "ArtworkController.h"
 #include "MediaTableView.h"
+#include "DLNAMediaServer.h"
 #include "DLNAMessageHandler.h"
 #include "DLNAViewController.h"
 #include "DLNAService.h"
@@ -9,6 +10,13 @@
 #include "NowPlayingInfoPanel.h"
 #include "LibraryMessageHandler.h"
 #include "LibraryController.h"
+#include "AudioHealthWindow.h"
+#include "EmbeddedCoverCache.h"
+#include "EqualizerWindow.h"
+#include "IconCache.h"
+#include "LooperStats.h"
+#include "LooperStatsWindow.h"
+#include "MemoryStatsWindow.h"
 #include "MusicBrainzMatcherWindow.h"
 #include "MetadataMessageHandler.h"
 #include "MusicSourceSettings.h"
@@ -29,6 +37,7 @@
 #include "RadioStationController.h"
 #include "PlaybackSeekBarView.h"
 #include "SettingsController.h"
+#include "StartupSequence.h"
 #include "UndoManager.h"
 #include "StatusBarController.h"
 #include "SyncMessageHandler.h"
@@ -56,6 +65,7 @@
 #include <OS.h>
 #include <Path.h>
 #include <PopUpMenu.h>
+#include <PropertyInfo.h>
 #include <Roster.h>
 #include <ScrollView.h>
 #include <Slider.h>
@@ -66,13 +76,12 @@
 #include <View.h>
 #include <algorithm>
 #include <random>
+#include <string.h>
 #include <vector>
 
 #include <Catalog.h>
 
 #include <Application.h>
-#include <IconUtils.h>
-#include <Resources.h>
 
 #undef B_TRANSLATION_CONTEXT
 #define B_TRANSLATION_CONTEXT "MainWindow"
@@ -178,6 +187,23 @@ bool MainWindow::_HandleAppCommandMessage(BMessage *msg) {
     break;
   }
 
+  case MSG_STARTUP_TASK_DONE: {
+    if (fStartup)
+      fStartup->HandleTaskDone(msg);
+    break;
+  }
+
+  case MSG_STARTUP_SHOW: {
+    _ShowStartupWindow();
+    break;
+  }
+
+  case MSG_SETTINGS_FLUSH: {
+    if (fSettingsController)
+      fSettingsController->FlushSettings();
+    break;
+  }
+
   case MSG_TEST_MODE: {
     _ShowMatcherTestWindow();
     break;
@@ -188,6 +214,72 @@ bool MainWindow::_HandleAppCommandMessage(BMessage *msg) {
     break;
   }
 
+  case MSG_FIND_DUPLICATES: {
+    fLibraryController->ShowDuplicateFinder();
+    break;
+  }
+
+  case MSG_LOOPER_STATS: {
+    (new LooperStatsWindow())->Show();
+    break;
+  }
+
+  case MSG_AUDIO_HEALTH: {
+    (new AudioHealthWindow(BMessenger(this)))->Show();
+    break;
+  }
+
+  case MSG_MEMORY_STATS: {
+    (new MemoryStatsWindow(BMessenger(this)))->Show();
+    break;
+  }
+
+  case MSG_MEMORY_REPORT: {
+    _UpdateItemMemory();
+    BMessage reply(MSG_MEMORY_REPORT);
+    MemoryStats::Archive(&reply);
+    reply.AddString("report", MemoryStats::Report());
+    msg->SendReply(&reply);
+    break;
+  }
+
+  case MSG_MEMORY_TRIM: {
+    _TrimMemory();
+    break;
+  }
+
+  case MSG_EQUALIZER: {
+    if (fEqualizerWindow.SendMessage(MSG_EQUALIZER) == B_OK)
+      break;
+    EqualizerWindow *window = new EqualizerWindow(BMessenger(this),
+                                                  fDspSettings);
+    fEqualizerWindow = BMessenger(window);
+    window->Show();
+    break;
+  }
+
+  case MSG_SCAN_PAUSE_TOGGLE: {
+    fLibraryController->ToggleScanPause();
+    break;
+  }
+
+  case MSG_LOUDNESS_SCAN: {
+    fLibraryController->ToggleLoudnessScan();
+    break;
+  }
+
+  case MSG_ACOUSTID_SCAN: {
+    fLibraryController->ToggleAcoustIdScan();
+    break;
+  }
+
+  case MSG_TOGGLE_LOUDNESS_WRITE: {
+    fLoudnessWriteFiles = !fLoudnessWriteFiles;
+    if (fLoudnessWriteItem)
+      fLoudnessWriteItem->SetMarked(fLoudnessWriteFiles);
+    break;
+  }
+
   case B_CONTROL_INVOKED: {
     _HandleControlInvoked(msg);
     break;
@@ -238,6 +330,97 @@ void MainWindow::MenusBeginning() {
     fRedoItem->SetEnabled(fUndoManager && fUndoManager->CanRedo());
 }
 
+/** @brief Scripting properties of the window, besides BWindow's. */
+static property_info kScriptProperties[] = {
+    {"Memory",
+     {B_GET_PROPERTY, 0},
+     {B_DIRECT_SPECIFIER, 0},
+     "Memory usage per subsystem: \"category\", \"bytes\", \"objects\", "
+     "\"process_ram\" and the report as \"result\"."},
+    {"TrimCaches",
+     {B_EXECUTE_PROPERTY, 0},
+     {B_DIRECT_SPECIFIER, 0},
+     "Drops in-memory caches and spare container capacity."},
+    {0}};
+
+BHandler *MainWindow::ResolveSpecifier(BMessage *msg, int32 index,
+                                       BMessage *specifier, int32 what,
+                                       const char *property) {
+  BPropertyInfo info(kScriptProperties);
+  if (info.FindMatch(msg, index, specifier, what, property) >= 0)
+    return this;
+  return BWindow::ResolveSpecifier(msg, index, specifier, what, property);
+}
+
+status_t MainWindow::GetSupportedSuites(BMessage *data) {
+  data->AddString("suites", "suite/vnd.BeTon-window");
+  BPropertyInfo info(kScriptProperties);
+  data->AddFlat("messages", &info);
+  return BWindow::GetSupportedSuites(data);
+}
+
+/**
+ * @brief Handles the properties of kScriptProperties, e.g.
+ * `hey BeTon get Memory of Window 0`.
+ */
+bool MainWindow::_HandleScriptingMessage(BMessage *msg) {
+  if (msg->what != B_GET_PROPERTY && msg->what != B_EXECUTE_PROPERTY)
+    return false;
+
+  BMessage specifier;
+  int32 index;
+  int32 form;
+  const char *property;
+  if (msg->GetCurrentSpecifier(&index, &specifier, &form, &property) != B_OK)
+    return false;
+
+  BMessage reply(B_REPLY);
+  if (msg->what == B_GET_PROPERTY && strcmp(property, "Memory") == 0) {
+    _UpdateItemMemory();
+    MemoryStats::Archive(&reply);
+    reply.AddString("result", MemoryStats::Report());
+  } else if (msg->what == B_EXECUTE_PROPERTY &&
+             strcmp(property, "TrimCaches") == 0) {
+    _TrimMemory();
+  } else {
+    return false;
+  }
+  reply.AddInt32("error", B_OK);
+  msg->SendReply(&reply);
+  return true;
+}
+
+/**
+ * @brief Brings the account of the item lists held by the window and its
+ * controllers up to date; they are sized only when a report is asked for.
+ */
+void MainWindow::_UpdateItemMemory() {
+  size_t bytes = MemoryStats::BytesOf(fRadioItems) +
+                 MemoryStats::BytesOf(fPendingItems) +
+                 fPathIndex.MemoryBytes();
+  if (fLibraryManager)
+    bytes += fLibraryManager->ScopeBytes();
+  if (fDlnaController)
+    bytes += fDlnaController->QueueBytes();
+  fItemMemory.Set(bytes);
+}
+
+/**
+ * @brief Drops the in-memory covers and gives back spare capacity of the
+ * window's and the cache's item storage.
+ */
+void MainWindow::_TrimMemory() {
+  EmbeddedCoverCache::Default().Trim();
+  if (fLibraryManager)
+    fLibraryManager->TrimViewCache();
+  if (fPendingItems.empty())
+    std::vector<MediaItem>().swap(fPendingItems);
+  fRadioItems.shrink_to_fit();
+  if (fMediaLibraryCache)
+    fMediaLibraryCache->PostMessage(MSG_MEMORY_TRIM);
+  _UpdateItemMemory();
+}
+
 void MainWindow::_HandleControlInvoked(BMessage *msg) {
   void *source = nullptr;
   MediaTableView *cv = fLibraryManager->ContentView();
@@ -288,36 +471,22 @@ void MainWindow::_SetOutputMenuVisible(bool visible) {
 }
 #endif
 
+/** @brief How long startup keeps the window hidden at most. */
+static const bigtime_t kStartupShowTimeout = 500000;
+
 /**
- * @brief Loads a vector icon from application resources and renders it to a
- * bitmap.
- * @param id The resource ID of the icon.
- * @param size The desired size in pixels.
- * @return A new BBitmap containing the rendered icon, or nullptr on failure.
+ * @brief Returns the edge length of the toolbar buttons for the plain font.
  */
-static BBitmap *LoadIconFromResource(int32 id, float size) {
-  if (!be_app || !be_app->AppResources())
-    return nullptr;
-
-  size_t len = 0;
-  const void *data =
-      be_app->AppResources()->LoadResource(B_VECTOR_ICON_TYPE, id, &len);
-  if (!data || len == 0) {
-    DEBUG_PRINT("Icon-ID %ld not found\n", (long)id);
-    return nullptr;
-  }
-
-  BRect r(0, 0, size - 1, size - 1);
-  auto *bmp = new BBitmap(r, 0, B_RGBA32);
-  if (BIconUtils::GetVectorIcon(static_cast<const uint8 *>(data), len, bmp) !=
-      B_OK) {
-    delete bmp;
-    DEBUG_PRINT("Icon-ID %ld: Decoding failed\n", (long)id);
-    return nullptr;
-  }
-  return bmp;
+static float ToolbarButtonSize() {
+  font_height fh;
+  be_plain_font->GetHeight(&fh);
+  float fontHeight = fh.ascent + fh.descent + fh.leading;
+  return std::max(24.0f, fontHeight * 1.8f);
 }
 
+/** @brief Icon is 65% of button size. */
+static float ToolbarIconSize() { return ToolbarButtonSize() * 0.65f; }
+
 MainWindow *gMainWindow = nullptr;
 
 extern void AddItemToPlaylist(const BString &playlist, const BString &path);
@@ -368,6 +537,10 @@ MainWindow::MainWindow()
               B_QUIT_ON_WINDOW_CLOSE),
       fNewFilesCount(0), fMetadataPropertiesWindow(nullptr), fPlaybackEngine(nullptr),
       fUpdateRunner(nullptr) {
+  fLaunchTime = system_time();
+
+  // Rendered while the controllers are set up.
+  _StartIconRendering(ToolbarIconSize());
 
   MusicSourceSettings::InitCache();
 
@@ -382,10 +555,18 @@ MainWindow::MainWindow()
   fDlnaManager = new DLNAService(BMessenger(this));
 #if ENABLE_DLNA_OUTPUT
   fPlaybackEngine->SetRemoteOutputManagers(fDlnaManager, &fLocalServer);
+  DLNAService *dlna = fDlnaManager;
+  fLocalServer.SetEventHandler([dlna](const BString &sid, const BString &body) {
+    return dlna->HandleEvent(sid, body);
+  });
+#endif
+#if ENABLE_DLNA_SERVER
+  fMediaServer = new DLNAMediaServer(&fLocalServer, &fSearchIndex, &fIndexLock);
 #endif
 
   fMediaLibraryCache = new MediaLibraryCache(BMessenger(this));
   fMediaLibraryCache->Run();
+  BMessenger(fMediaLibraryCache).SendMessage(MSG_LOAD_CACHE);
 
   fLibraryManager = new LibraryBrowserController(BMessenger(this));
   fMetadataService = new MetadataService(BMessenger(this));
@@ -413,6 +594,7 @@ MainWindow::MainWindow()
   fUndoManager = new UndoManager(this);
 
   fNowPlayingInfoPanel = new NowPlayingInfoPanel();
+  fNowPlayingInfoPanel->SetAnalysisTap(&fPlaybackEngine->Analysis());
   fStatusLabel = new BStringView("status", B_TRANSLATE("Loading..."));
 
   fSeekBarColor = ui_color(B_CONTROL_HIGHLIGHT_COLOR);
@@ -432,26 +614,161 @@ MainWindow::MainWindow()
   float minH = std::max(510.0f, fontHeight * 36.0f);
   SetSizeLimits(minW, 32768, minH, 32768);
 
-  BMessenger(fMediaLibraryCache).SendMessage(MSG_LOAD_CACHE);
-
   fMbClient = new MusicBrainzApiClient("beton-app@outlook.com");
 
   fStatusLabel->SetText(B_TRANSLATE("Loading Music Library..."));
 
   RegisterWithMediaLibraryCache();
 
-  LoadSettings();
+  AddCommonFilter(new WindowClickFilter(this));
 
-  BMessage msg(MSG_INIT_LIBRARY);
-  PostMessage(&msg);
+  // Shown by the startup sequence once settings and sidebar are applied, or
+  // by the runner if that takes longer.
+  Hide();
+  BMessage show(MSG_STARTUP_SHOW);
+  fStartupShowRunner =
+      new BMessageRunner(BMessenger(this), &show, kStartupShowTimeout, 1);
+
+  _StartStartupSequence();
+}
 
+/**
+ * @brief Renders the toolbar icons into the IconCache on the worker pool.
+ *
+ * The first paint needs most of them, and the other states follow on the
+ * first toggle, so all are rendered while the constructor goes on.
+ * _BuildUI() picks them up with _WaitForIcons(); state changes only swap
+ * the shared bitmaps.
+ */
+void MainWindow::_StartIconRendering(float iconSize) {
+  struct Icon {
+    const BBitmap **bitmap;
+    int32 id;
+  };
+  std::vector<Icon> icons = {
+      {&fIconPlay, ICON_PLAY_GRAY},
+      {&fIconPause, ICON_PAUSE_GRAY},
+      {&fIconStop, ICON_STOP},
+      {&fIconNext, ICON_NEXT},
+      {&fIconPrev, ICON_PREV},
+      {&fIconShuffleOff, ICON_SHUFFLE_GRAY},
+      {&fIconShuffleOn, ICON_SHUFFLE_COLOR},
+      {&fIconRepeatOff, ICON_REPEAT_GRAY},
+      {&fIconRepeatAll, ICON_REPEAT_GREEN},
+      {&fIconRepeatOne, ICON_REPEAT_ORANGE},
+      {&fIconMuteOn, ICON_MUTE_ON},
+      {&fIconMuteOff, ICON_MUTE_OFF},
 #if ENABLE_DLNA_OUTPUT
-  if (fDlnaController)
-    fDlnaController->RebuildRendererMenu();
-  fLocalServer.Start();
+      {&fIconRenderer, 1005},
 #endif
+  };
+
+  fIconsQueued = system_time();
+  bigtime_t *rendered = &fIconsRendered;
+  std::function<void()> render = [icons, iconSize, rendered]() {
+    IconCache &cache = IconCache::Default();
+    for (const Icon &icon : icons)
+      *icon.bitmap = cache.Get(icon.id, iconSize);
+    *rendered = system_time();
+  };
+  fIconJob = WorkerPool::Default().Submit(kLaneInteractive, "render icons",
+                                          std::function<void()>(render));
+  if (fIconJob.Get() == nullptr)
+    render();
+}
 
-  AddCommonFilter(new WindowClickFilter(this));
+/**
+ * @brief Waits for the icons of _StartIconRendering().
+ */
+void MainWindow::_WaitForIcons() {
+  if (fIconJob.Get() == nullptr)
+    return;
+  fIconJob->Wait();
+  fIconJob.Unset();
+}
+
+/**
+ * @brief Sets up and starts the staged startup.
+ *
+ * Settings, radio stations and the playlist folder are read on the worker
+ * pool while the window thread finishes the UI, and the cache loads on its
+ * own looper. The results are applied on the window thread in dependency
+ * order; the window is shown as soon as settings and sidebar are in. DLNA
+ * discovery, the HTTP servers and the live queries wait until then, so they
+ * do not compete with the first paint.
+ */
+void MainWindow::_StartStartupSequence() {
+  fStartup = new StartupSequence(BMessenger(this), fLaunchTime);
+  if (fIconsRendered > 0)
+    fStartup->Record("icons", fIconsQueued, fIconsRendered);
+
+  SettingsController *settings = fSettingsController;
+
+  fStartupSettingsTask = fStartup->Add(
+      "settings", {}, {},
+      []() { return StartupSequence::Work(SettingsController::ReadSettings); },
+      [settings](BMessage &state) { settings->ApplySettings(state); });
+
+  fStartup->Add(
+      "stations", {}, {fStartupSettingsTask},
+      []() { return StartupSequence::Work(RadioStationLibrary::ReadStations); },
+      [settings](BMessage &archive) { settings->ApplyStations(archive); });
+
+  // The playlist folder is known once the settings are applied.
+  const int32 playlistsTask = fStartup->Add(
+      "playlists", {fStartupSettingsTask}, {},
+      [this]() -> StartupSequence::Work {
+        BString folder = fPlaylistPath;
+        return [folder](BMessage &files) {
+          PlaylistLibrary::ListPlaylistFiles(folder, files);
+        };
+      },
+      [this, settings](BMessage &files) {
+        settings->ApplyPlaylists(files);
+        PostMessage(MSG_INIT_LIBRARY);
+      });
+
+  fStartupCacheTask = fStartup->AddExternal("cache");
+
+  const int32 showTask =
+      fStartup->Add("show", {}, {fStartupSettingsTask, playlistsTask},
+                    nullptr, [this](BMessage &) { _ShowStartupWindow(); });
+
+  fStartup->Add("discovery", {showTask}, {}, nullptr, [this](BMessage &) {
+    fSettingsController->StartDiscovery();
+#if ENABLE_DLNA_OUTPUT
+    if (fDlnaController)
+      fDlnaController->RebuildRendererMenu();
+#endif
+#if ENABLE_DLNA_OUTPUT || ENABLE_DLNA_SERVER
+    fLocalServer.Start();
+#endif
+#if ENABLE_DLNA_SERVER
+    fMediaServer->Start(fDlnaManager);
+#endif
+  });
+
+  fStartup->Add("live queries", {showTask}, {}, nullptr, [this](BMessage &) {
+    BMessenger(fMediaLibraryCache).SendMessage(MSG_START_LIVE_QUERIES);
+  });
+
+  fStartup->Start();
+}
+
+/**
+ * @brief Shows the window the constructor hid, and draws it right away.
+ */
+void MainWindow::_ShowStartupWindow() {
+  if (fStartupShown)
+    return;
+  fStartupShown = true;
+  delete fStartupShowRunner;
+  fStartupShowRunner = nullptr;
+
+  Show();
+  UpdateIfNeeded();
+  DEBUG_PRINT("Startup: window shown after %lld ms\n",
+              (long long)((system_time() - fLaunchTime) / 1000));
 }
 
 /**
@@ -467,12 +784,21 @@ MainWindow::~MainWindow() {
   if (fPlaybackEngine)
     fPlaybackEngine->Stop();
 
-  if (fRadioStationController)
-    fRadioStationController->WaitForPlayThread();
+  if (fRadioStationController) {
+    fRadioStationController->WaitForPlayJob();
+    fRadioStationController->StopProbing();
+  }
 
-  _WaitForLaunchedThreads();
+  // Queued jobs still run: they include tag writes and file moves.
+  WorkerPool::Default().Shutdown(WorkerPool::kDrainQueue);
 
-  SaveSettings();
+  // Written right here: the pool no longer takes jobs.
+  if (fSettingsController)
+    fSettingsController->FlushSettings();
+  if (fNowPlayingInfoPanel)
+    fNowPlayingInfoPanel->SetAnalysisTap(nullptr);
+  if (fSeekBar)
+    fSeekBar->SetClock(nullptr);
   if (fPlaybackEngine) {
     fPlaybackEngine->Shutdown();
     delete fPlaybackEngine;
@@ -506,6 +832,17 @@ MainWindow::~MainWindow() {
   delete fRadioStationLibrary;
   delete fDlnaCommandHandler;
   delete fDlnaController;
+#if ENABLE_DLNA_SERVER
+  fMediaServer->Stop();
+#endif
+#if ENABLE_DLNA_OUTPUT || ENABLE_DLNA_SERVER
+  // Its workers deliver DLNA events to fDlnaManager and requests to
+  // fMediaServer.
+  fLocalServer.Stop();
+#endif
+#if ENABLE_DLNA_SERVER
+  delete fMediaServer;
+#endif
   delete fDlnaManager;
   delete fLibraryMessageHandler;
   delete fViewMessageHandler;
@@ -516,21 +853,12 @@ MainWindow::~MainWindow() {
   delete fMbClient;
   delete fSearchRunner;
   delete fViewsRefreshRunner;
+  delete fStartupShowRunner;
+  delete fStartup;
 
-  delete fIconPlay;
-  delete fIconPause;
-  delete fIconStop;
-  delete fIconNext;
-  delete fIconPrev;
-  delete fIconShuffleOff;
-  delete fIconShuffleOn;
-  delete fIconRepeatOff;
-  delete fIconRepeatAll;
-  delete fIconRepeatOne;
 #if ENABLE_DLNA_OUTPUT
   if (fOutputMenuItem && fOutputMenuItem->Menu() == nullptr)
     delete fOutputMenuItem;
-  delete fIconRenderer;
 #endif
 }
 
@@ -555,6 +883,20 @@ void MainWindow::_BuildUI() {
 
   fileMenu->AddItem(new BMenuItem(B_TRANSLATE("Synchronize Metadata"),
                                   new BMessage(MSG_SYNC_SMART)));
+  fileMenu->AddItem(
+      new BMenuItem(B_TRANSLATE("Find Duplicates..."),
+                    new BMessage(MSG_FIND_DUPLICATES)));
+  fPauseScanItem = new BMenuItem(B_TRANSLATE("Pause Scanning"),
+                                 new BMessage(MSG_SCAN_PAUSE_TOGGLE));
+  fileMenu->AddItem(fPauseScanItem);
+  fLoudnessScanItem = new BMenuItem(B_TRANSLATE("Analyze Loudness"),
+                                    new BMessage(MSG_LOUDNESS_SCAN));
+  fileMenu->AddItem(fLoudnessScanItem);
+#if ENABLE_ACOUSTID
+  fAcoustIdScanItem = new BMenuItem(B_TRANSLATE("Identify Recordings"),
+                                    new BMessage(MSG_ACOUSTID_SCAN));
+  fileMenu->AddItem(fAcoustIdScanItem);
+#endif
 
   fileMenu->AddSeparatorItem();
   fileMenu->AddItem(
@@ -660,14 +1002,117 @@ void MainWindow::_BuildUI() {
   tooltipsMenu->AddItem(fTooltipsOffItem);
   fSettingsMenu->AddItem(tooltipsMenu);
 
+  fCrossfadeMenu = new BMenu(B_TRANSLATE("Crossfade"));
+  fCrossfadeMenu->SetRadioMode(true);
+  static const int32 kCrossfadeChoices[] = {0, 2, 4, 6, 10};
+  for (int32 seconds : kCrossfadeChoices) {
+    BMessage *msg = new BMessage(MSG_SET_CROSSFADE);
+    msg->AddInt32("seconds", seconds);
+    BString label;
+    if (seconds == 0)
+      label = B_TRANSLATE("Off");
+    else
+      label.SetToFormat(B_TRANSLATE("%ld seconds"), (long)seconds);
+    BMenuItem *item = new BMenuItem(label.String(), msg);
+    item->SetMarked(seconds == fCrossfadeSeconds);
+    fCrossfadeMenu->AddItem(item);
+  }
+  fSettingsMenu->AddItem(fCrossfadeMenu);
+
+  fOutputRateMenu = new BMenu(B_TRANSLATE("Output Rate"));
+  fOutputRateMenu->SetRadioMode(true);
+  static const int32 kOutputRateChoices[] = {0, 44100, 48000, 88200, 96000};
+  for (int32 rate : kOutputRateChoices) {
+    BMessage *msg = new BMessage(MSG_SET_OUTPUT_RATE);
+    msg->AddInt32("rate", rate);
+    BString label;
+    if (rate == 0)
+      label = B_TRANSLATE("Native (per Track)");
+    else
+      label.SetToFormat(B_TRANSLATE("%.1f kHz"), rate / 1000.0);
+    BMenuItem *item = new BMenuItem(label.String(), msg);
+    item->SetMarked(rate == fOutputRate);
+    fOutputRateMenu->AddItem(item);
+  }
+  fSettingsMenu->AddItem(fOutputRateMenu);
+
+  fStreamQualityMenu = new BMenu(B_TRANSLATE("Stream Quality"));
+  fStreamQualityMenu->SetRadioMode(true);
+  static const int32 kStreamQualityChoices[] = {0, 64, 128, 256};
+  for (int32 kbps : kStreamQualityChoices) {
+    BMessage *msg = new BMessage(MSG_SET_STREAM_QUALITY);
+    msg->AddInt32("kbps", kbps);
+    BString label;
+    if (kbps == 0)
+      label = B_TRANSLATE("Best Available");
+    else
+      label.SetToFormat(B_TRANSLATE("Up to %ld kbps"), (long)kbps);
+    BMenuItem *item = new BMenuItem(label.String(), msg);
+    item->SetMarked(kbps == fStreamQualityKbps);
+    fStreamQualityMenu->AddItem(item);
+  }
+  fSettingsMenu->AddItem(fStreamQualityMenu);
+
+  fTimeShiftMenu = new BMenu(B_TRANSLATE("Radio Time-Shift"));
+  fTimeShiftMenu->SetRadioMode(true);
+  static const int32 kTimeShiftChoices[] = {0, 10, 30, 60};
+  for (int32 minutes : kTimeShiftChoices) {
+    BMessage *msg = new BMessage(MSG_SET_TIME_SHIFT);
+    msg->AddInt32("minutes", minutes);
+    BString label;
+    if (minutes == 0)
+      label = B_TRANSLATE("Off");
+    else
+      label.SetToFormat(B_TRANSLATE("Last %ld Minutes"), (long)minutes);
+    BMenuItem *item = new BMenuItem(label.String(), msg);
+    item->SetMarked(minutes == fTimeShiftMinutes);
+    fTimeShiftMenu->AddItem(item);
+  }
+  fSettingsMenu->AddItem(fTimeShiftMenu);
+  fRecordLibraryItem =
+      new BMenuItem(B_TRANSLATE("Add Radio Recordings to Library"),
+                    new BMessage(MSG_TOGGLE_RECORD_LIBRARY));
+  fRecordLibraryItem->SetMarked(fRecordToLibrary);
+  fSettingsMenu->AddItem(fRecordLibraryItem);
+
+  // Marked by hand: the last item is a toggle, not one of the modes.
+  fNormalizationMenu = new BMenu(B_TRANSLATE("Normalization"));
+  const char *normalizationLabels[] = {B_TRANSLATE("Off"),
+                                       B_TRANSLATE("Track Gain"),
+                                       B_TRANSLATE("Album Gain")};
+  for (int32 mode = 0; mode < 3; mode++) {
+    BMessage *msg = new BMessage(MSG_SET_NORMALIZATION);
+    msg->AddInt32("mode", mode);
+    BMenuItem *item = new BMenuItem(normalizationLabels[mode], msg);
+    item->SetMarked(mode == fNormalizationMode);
+    fNormalizationMenu->AddItem(item);
+  }
+  fNormalizationMenu->AddSeparatorItem();
+  fLoudnessWriteItem = new BMenuItem(B_TRANSLATE("Store Analysis in Files"),
+                                     new BMessage(MSG_TOGGLE_LOUDNESS_WRITE));
+  fLoudnessWriteItem->SetMarked(fLoudnessWriteFiles);
+  fNormalizationMenu->AddItem(fLoudnessWriteItem);
+  fSettingsMenu->AddItem(fNormalizationMenu);
+  fSettingsMenu->AddItem(new BMenuItem(B_TRANSLATE("Equalizer..."),
+                                       new BMessage(MSG_EQUALIZER)));
+
   fMenuBar->AddItem(fSettingsMenu);
 
   BMenu *helpMenu = new BMenu(B_TRANSLATE("Help"));
-  helpMenu->AddItem(new BMenuItem(B_TRANSLATE("About Beton" B_UTF8_ELLIPSIS),
+  helpMenu->AddItem(new BMenuItem(B_TRANSLATE("About Beton..."),
                                   new BMessage(B_ABOUT_REQUESTED)));
+  helpMenu->AddSeparatorItem();
+  helpMenu->AddItem(new BMenuItem(B_TRANSLATE("Audio Engine Health..."),
+                                  new BMessage(MSG_AUDIO_HEALTH)));
+  helpMenu->AddItem(new BMenuItem(B_TRANSLATE("Memory Usage..."),
+                                  new BMessage(MSG_MEMORY_STATS)));
+  if (LooperStats::IsEnabled())
+    helpMenu->AddItem(new BMenuItem(B_TRANSLATE("Looper Statistics..."),
+                                    new BMessage(MSG_LOOPER_STATS)));
   fMenuBar->AddItem(helpMenu);
 
   fSeekBar = new PlaybackSeekBarView("seekbar");
+  fSeekBar->SetClock(&fPlaybackEngine->Clock());
 
   font_height fh;
   be_plain_font->GetHeight(&fh);
@@ -689,29 +1134,13 @@ void MainWindow::_BuildUI() {
   fBtnShuffle = new BButton("", new BMessage(MSG_SHUFFLE_TOGGLE));
   fBtnRepeat = new BButton("", new BMessage(MSG_REPEAT_TOGGLE));
 
-  float size = fontHeight * 1.8f;
-  if (size < 24.0f)
-    size = 24.0f;
+  float size = ToolbarButtonSize();
   BSize buttonSize(size, size);
 
-  float iconSize = size * 0.65f; // Icon is 65% of button size
-  fIconPlay = LoadIconFromResource(ICON_PLAY_GRAY, iconSize);
-  fIconPause = LoadIconFromResource(ICON_PAUSE_GRAY, iconSize);
-  fIconStop = LoadIconFromResource(ICON_STOP, iconSize);
-  fIconNext = LoadIconFromResource(ICON_NEXT, iconSize);
-  fIconPrev = LoadIconFromResource(ICON_PREV, iconSize);
-  fIconShuffleOff = LoadIconFromResource(ICON_SHUFFLE_GRAY, iconSize);
-  fIconShuffleOn = LoadIconFromResource(ICON_SHUFFLE_COLOR, iconSize);
-  fIconRepeatOff = LoadIconFromResource(ICON_REPEAT_GRAY, iconSize);
-  fIconRepeatAll = LoadIconFromResource(ICON_REPEAT_GREEN, iconSize);
-  fIconRepeatOne = LoadIconFromResource(ICON_REPEAT_ORANGE, iconSize);
-  fIconMuteOn = LoadIconFromResource(ICON_MUTE_ON, iconSize);
-  fIconMuteOff = LoadIconFromResource(ICON_MUTE_OFF, iconSize);
+  float iconSize = ToolbarIconSize();
+  _WaitForIcons();
 
   fBtnMute = new IconButtonView("mute_icon", fIconMuteOn, new BMessage(MSG_MUTE_TOGGLE));
-#if ENABLE_DLNA_OUTPUT
-  fIconRenderer = LoadIconFromResource(1005, iconSize);
-#endif
 
   if (fIconPrev)
     fBtnPrev->SetIcon(fIconPrev, 0);
@@ -855,8 +1284,19 @@ void MainWindow::_BuildUI() {
       .End();
 }
 
+/**
+ * @brief Times every dispatched message when looper statistics are on.
+ */
+void MainWindow::DispatchMessage(BMessage *msg, BHandler *handler) {
+  static const int32 sStatsSlot = LooperStats::Register("MainWindow");
+  LooperStats::Scope scope(sStatsSlot, this, msg);
+  BWindow::DispatchMessage(msg, handler);
+}
+
 void MainWindow::WindowActivated(bool active) {
   BWindow::WindowActivated(active);
+  if (active && fLibraryController)
+    fLibraryController->ResumeDeferredRefresh();
   if (!active) {
     if (fLibraryManager && fLibraryManager->ContentView()) {
       fLibraryManager->ContentView()->CommitCellEdit();
@@ -864,6 +1304,13 @@ void MainWindow::WindowActivated(bool active) {
   }
 }
 
+void MainWindow::Minimize(bool minimize) {
+  BWindow::Minimize(minimize);
+  // Nothing of the seek bar is visible; stop redrawing it.
+  if (fSeekBar)
+    fSeekBar->SetFramePacing(!minimize);
+}
+
 /**
  * @brief Main message loop handler.
  *
@@ -906,62 +1353,52 @@ void MainWindow::MessageReceived(BMessage *msg) {
   if (_HandleLibraryDataMessage(msg))
     return;
 
+  if (_HandleScriptingMessage(msg))
+    return;
+
   BWindow::MessageReceived(msg);
 }
 
 /**
- * @brief Helper to spawn and resume a background thread.
+ * @brief Queues a job on the application's worker pool.
  *
- * @param name Name of the thread (for system monitor).
- * @param func Lambda function to execute in the thread.
- * @return thread_id The ID of the spawned thread, or error code.
+ * @param lane Queue of the job; see WorkerLane.
+ * @param name Literal naming the worker thread while the job runs.
+ * @param func Function to run.
+ * @return The job, or an empty reference once the window is shutting down.
  */
-thread_id MainWindow::LaunchThread(const char *name,
-                                   std::function<void()> &&func) {
-  auto *funcPtr = new std::function<void()>(std::move(func));
-
-  BAutolock lock(&fWorkerThreadsLock);
-  if (fShuttingDown.load(std::memory_order_relaxed)) {
-    delete funcPtr;
-    return B_NOT_ALLOWED;
-  }
+BReference<WorkerJob> MainWindow::QueueJob(WorkerLane lane, const char *name,
+                                           std::function<void()> &&func) {
+  if (fShuttingDown.load(std::memory_order_relaxed))
+    return BReference<WorkerJob>();
+  return WorkerPool::Default().Submit(lane, name, std::move(func));
+}
 
-  thread_id thread = spawn_thread(_ThreadEntry, name, B_NORMAL_PRIORITY, funcPtr);
-  if (thread >= 0) {
-    fWorkerThreads.push_back(thread);
-    resume_thread(thread);
-  } else {
-    delete funcPtr;
-  }
-  return thread;
+bool MainWindow::IsRadioRecording() const {
+  return fRadioStationController && fRadioStationController->IsRecording();
 }
 
-void MainWindow::_WaitForLaunchedThreads() {
-  std::vector<thread_id> threads;
-  {
-    BAutolock lock(&fWorkerThreadsLock);
-    threads.swap(fWorkerThreads);
-  }
+bool MainWindow::CanRecordRadio() const {
+  return fRadioStationController &&
+         fRadioStationController->HasActiveStation() && fPlaybackEngine &&
+         fPlaybackEngine->IsStreaming();
+}
 
-  thread_id current = find_thread(nullptr);
-  for (thread_id thread : threads) {
-    if (thread < 0 || thread == current)
-      continue;
-    status_t exit;
-    wait_for_thread(thread, &exit);
-  }
+bool MainWindow::HasMoreRadioStations() const {
+  return fRadioStationController && fRadioStationController->HasMoreStations();
 }
 
-/**
- * @brief Static entry point for spawned C++ threads.
- */
-status_t MainWindow::_ThreadEntry(void *data) {
-  auto *func = static_cast<std::function<void()> *>(data);
-  if (func) {
-    (*func)();
-    delete func;
-  }
-  return B_OK;
+LibraryFilterSource MainWindow::FilterSource() {
+  LibraryFilterSource source;
+  if (fIsRadioMode || fIsDlnaMode)
+    return source;
+
+  source.snapshot = fAllItems.Snapshot();
+  source.facets = &fFacetIndex;
+  source.search = &fSearchIndex;
+  source.indexLock = &fIndexLock;
+  source.paths = &fPathIndex;
+  return source;
 }
 
 /**
@@ -970,7 +1407,7 @@ status_t MainWindow::_ThreadEntry(void *data) {
 void MainWindow::UpdateFilteredViews(bool preserveScroll) {
   if (fLibraryManager) {
     const auto &items =
-        (fIsRadioMode || fIsDlnaMode) ? fRadioItems : fAllItems;
+        (fIsRadioMode || fIsDlnaMode) ? fRadioItems : fAllItems.Items();
     BString context = "Library";
     if (fIsRadioMode)
       context = "Radio";
@@ -981,10 +1418,12 @@ void MainWindow::UpdateFilteredViews(bool preserveScroll) {
     else if (!fIsLibraryMode)
       context = fCurrentPlaylistName;
 
+    LibraryFilterSource library = FilterSource();
     fLibraryManager->UpdateFilteredViews(
         items, fIsLibraryMode || fIsRadioMode || fIsDlnaMode,
         context,
-        fSearchField->Text(), preserveScroll, true, IsPlaylistSelected());
+        fSearchField->Text(), preserveScroll, true, IsPlaylistSelected(),
+        &library);
     if (!fIsRadioMode && !fIsDlnaMode) {
       if (fStatusBarController)
         fStatusBarController->UpdateLibraryStatus();
@@ -1175,22 +1614,14 @@ void MainWindow::UpdateStatus(const BString &text, bool isPermanent) {
 }
 
 /**
- * @brief Saves current UI state (columns, playlist path, etc.) to settings
- * file.
+ * @brief Schedules saving the current UI state (columns, playlist path,
+ * etc.) to the settings file.
  */
 void MainWindow::SaveSettings() {
   if (fSettingsController)
     fSettingsController->SaveSettings();
 }
 
-/**
- * @brief Loads UI state from settings file.
- */
-void MainWindow::LoadSettings() {
-  if (fSettingsController)
-    fSettingsController->LoadSettings();
-}
-
 /**
  * @brief Calculates the luminance of a color (0.0 - 1.0).
  */
@@ -2,10 +2,14 @@
 #define MAINWINDOW_H
 
 #include "MediaLibraryCache.h"
+#include "LibraryFacetIndex.h"
+#include "LibrarySearchIndex.h"
+#include "LibrarySnapshot.h"
 #include "DLNAService.h"
 #include "LibraryBrowserController.h"
 #include "MarqueeTextView.h"
 #include "MediaItem.h"
+#include "MemoryStats.h"
 #include "AudioPlaybackEngine.h"
 #include "Messages.h"
 #include "MetadataService.h"
@@ -14,6 +18,7 @@
 #include "RadioStationLibrary.h"
 #include "MetadataTagIO.h"
 #include "LocalFileHttpServer.h"
+#include "WorkerPool.h"
 #include "Config.h"
 
 #include <Bitmap.h>
@@ -39,6 +44,7 @@ class PlaybackSeekBarView;
 class NowPlayingInfoPanel;
 class BGroupView;
 class ArtworkController;
+class DLNAMediaServer;
 class DLNAMessageHandler;
 class DLNAViewController;
 class LibraryMessageHandler;
@@ -56,6 +62,7 @@ class MetadataPropertiesWindow;
 class RadioMessageHandler;
 class RadioStationController;
 class SettingsController;
+class StartupSequence;
 class StatusBarController;
 class SyncMessageHandler;
 class MetadataSyncConflictDialog;
@@ -87,8 +94,13 @@ public:
   virtual ~MainWindow();
 
   void MessageReceived(BMessage *msg) override;
+  void DispatchMessage(BMessage *msg, BHandler *handler) override;
   void WindowActivated(bool active) override;
+  void Minimize(bool minimize) override;
   void MenusBeginning() override;
+  BHandler *ResolveSpecifier(BMessage *msg, int32 index, BMessage *specifier,
+                             int32 what, const char *property) override;
+  status_t GetSupportedSuites(BMessage *data) override;
 
   /** @name Helpers used by child windows/components */
   ///@{
@@ -111,12 +123,19 @@ public:
   bool IsFolderMode() const { return fIsFolderMode; }
   bool IsRadioMode() const { return fIsRadioMode; }
   bool IsDlnaMode() const { return fIsDlnaMode; }
+  /// True while the playing radio station is being recorded.
+  bool IsRadioRecording() const;
+  /// True while a radio station plays that could be recorded.
+  bool CanRecordRadio() const;
+  /// True if the radio list shows only part of the matching stations.
+  bool HasMoreRadioStations() const;
+  /// Snapshot and indexes behind fAllItems; empty in Radio/DLNA mode.
+  LibraryFilterSource FilterSource();
 
   ///@}
 
   /** @name Settings */
   ///@{
-  void LoadSettings();
   void SaveSettings();
 
   ///@}
@@ -124,7 +143,8 @@ public:
   /** @name Async Logic */
   ///@{
   void RegisterWithMediaLibraryCache();
-  thread_id LaunchThread(const char *name, std::function<void()> &&func);
+  BReference<WorkerJob> QueueJob(WorkerLane lane, const char *name,
+                                 std::function<void()> &&func);
 
   ///@}
 
@@ -153,8 +173,6 @@ private:
   friend class ViewMessageHandler;
   friend class ViewStateController;
 
-  static status_t _ThreadEntry(void *data);
-
   void _BuildUI();
   bool _HandleViewMessage(BMessage* msg);
   bool _HandlePlaybackMessage(BMessage* msg);
@@ -166,11 +184,17 @@ private:
   bool _HandleMetadataMessage(BMessage* msg);
   bool _HandleAppCommandMessage(BMessage* msg);
   bool _HandleLibraryDataMessage(BMessage* msg);
-  void _WaitForLaunchedThreads();
+  bool _HandleScriptingMessage(BMessage* msg);
 
   void _HandleControlInvoked(BMessage* msg);
   void _ShowAboutWindow();
   void _ShowMatcherTestWindow();
+  void _StartIconRendering(float iconSize);
+  void _WaitForIcons();
+  void _StartStartupSequence();
+  void _ShowStartupWindow();
+  void _UpdateItemMemory();
+  void _TrimMemory();
 #if ENABLE_DLNA_OUTPUT
   void _SetOutputMenuVisible(bool visible);
 #endif
@@ -178,8 +202,9 @@ private:
 
   /** @name Data & State */
   ///@{
-  std::vector<MediaItem> fAllItems;   ///< Complete database cache
+  LibraryItems fAllItems;             ///< Library items (shared with the cache)
   std::vector<MediaItem> fRadioItems; ///< Radio stations as MediaItems
+  MemoryAccount fItemMemory{kMemoryViewItems}; ///< See _UpdateItemMemory()
   bool fIsLibraryMode = true; ///< True = All tracks, False = Playlist view
   bool fIsFolderMode = false; ///< True = live folder source view
   bool fIsRadioMode = false;  ///< True = Radio station view
@@ -214,10 +239,21 @@ private:
   ///@{
   std::vector<MediaItem> fPendingItems;
   std::vector<BString> fPendingPlaylistOrder;
-  std::map<BString, size_t> fPathIndex; ///< Maps file path to index in fAllItems for O(log n) lookup
+  MediaPathIndex fPathIndex; ///< Maps file path to index in fAllItems (hashed)
+  LibraryFacetIndex fFacetIndex; ///< Genre/artist/album cells of fAllItems
+  LibrarySearchIndex fSearchIndex; ///< Filter-box text index over fAllItems
+  BLocker fIndexLock{"index lock"}; ///< Guards both indexes against the filter worker
   int32 fCurrentIndex{0};
   int32 fNewFilesCount{0};
   bool fCacheLoaded = false;
+  bigtime_t fLaunchTime = 0; ///< Window construction, for startup timing
+  StartupSequence *fStartup{nullptr}; ///< Staged startup; see _StartStartupSequence()
+  int32 fStartupSettingsTask{-1};
+  int32 fStartupCacheTask{-1};
+  bool fStartupShown = false; ///< The window is hidden until settings apply
+  BReference<WorkerJob> fIconJob; ///< Renders the toolbar icons at startup
+  bigtime_t fIconsQueued = 0;
+  bigtime_t fIconsRendered = 0; ///< Written by fIconJob
 
   ///@}
 
@@ -225,8 +261,6 @@ private:
   ///@{
   BString fLastSelectedPath;
   std::atomic<bool> fShuttingDown{false};
-  BLocker fWorkerThreadsLock;
-  std::vector<thread_id> fWorkerThreads;
 
   ///@}
 
@@ -274,6 +308,36 @@ private:
   bool fFastEditEnabled = false;
   BMenuItem *fFastEditItem = nullptr;
 
+  int32 fCrossfadeSeconds = 0; ///< Overlap of consecutive tracks (0 = off)
+  BMenu *fCrossfadeMenu = nullptr;
+
+  int32 fOutputRate = 0; ///< Fixed output frame rate (0 = each track's own)
+  BMenu *fOutputRateMenu = nullptr;
+
+  int32 fStreamQualityKbps = 0; ///< Highest HLS variant played (0 = any)
+  BMenu *fStreamQualityMenu = nullptr;
+
+  int32 fTimeShiftMinutes = 0; ///< Live stream kept for pause/rewind (0 = off)
+  BMenu *fTimeShiftMenu = nullptr;
+  bool fRecordToLibrary = true; ///< Radio recordings go into a music folder
+  BMenuItem *fRecordLibraryItem = nullptr;
+
+  int32 fNormalizationMode = 0; ///< ReplayGain::Mode used for playback
+  DspSettings fDspSettings;      ///< Preamp, equalizer and limiter
+  BMessenger fEqualizerWindow;   ///< Open equalizer window, if any
+  BMenu *fNormalizationMenu = nullptr;
+  bool fLoudnessWriteFiles = false; ///< Store analysis results in the files
+  BMenuItem *fLoudnessWriteItem = nullptr;
+  bool fLoudnessRunning = false; ///< Loudness analysis in progress
+  BMenuItem *fLoudnessScanItem = nullptr;
+  bool fAcoustIdRunning = false; ///< Recording identification in progress
+  BMenuItem *fAcoustIdScanItem = nullptr;
+
+  int32 fScanTagReaders = 0; ///< Scanner tag reader threads (0 = auto)
+  int32 fScanWalkersPerDevice = 1; ///< Parallel scanners on one device
+  bool fScanPaused = false;  ///< Scanning paused from the File menu
+  BMenuItem *fPauseScanItem = nullptr;
+
   UndoManager *fUndoManager{nullptr};
   BMenuItem *fUndoItem = nullptr;
   BMenuItem *fRedoItem = nullptr;
@@ -293,22 +357,22 @@ private:
 
   ///@}
 
-  /** @name Player Icon Bitmaps */
+  /** @name Player Icon Bitmaps (shared, owned by the IconCache) */
   ///@{
-  BBitmap *fIconPlay{nullptr};
-  BBitmap *fIconPause{nullptr};
-  BBitmap *fIconStop{nullptr};
-  BBitmap *fIconNext{nullptr};
-  BBitmap *fIconPrev{nullptr};
-  BBitmap *fIconShuffleOff{nullptr};
-  BBitmap *fIconShuffleOn{nullptr};
-  BBitmap *fIconRepeatOff{nullptr};
-  BBitmap *fIconRepeatAll{nullptr};
-  BBitmap *fIconRepeatOne{nullptr};
-  BBitmap *fIconMuteOn{nullptr};
-  BBitmap *fIconMuteOff{nullptr};
+  const BBitmap *fIconPlay{nullptr};
+  const BBitmap *fIconPause{nullptr};
+  const BBitmap *fIconStop{nullptr};
+  const BBitmap *fIconNext{nullptr};
+  const BBitmap *fIconPrev{nullptr};
+  const BBitmap *fIconShuffleOff{nullptr};
+  const BBitmap *fIconShuffleOn{nullptr};
+  const BBitmap *fIconRepeatOff{nullptr};
+  const BBitmap *fIconRepeatAll{nullptr};
+  const BBitmap *fIconRepeatOne{nullptr};
+  const BBitmap *fIconMuteOn{nullptr};
+  const BBitmap *fIconMuteOff{nullptr};
 #if ENABLE_DLNA_OUTPUT
-  BBitmap *fIconRenderer{nullptr};
+  const BBitmap *fIconRenderer{nullptr};
 #endif
 
   ///@}
@@ -365,6 +429,7 @@ private:
   ViewMessageHandler *fViewMessageHandler{nullptr};
   ViewStateController *fViewStateController{nullptr};
   LocalFileHttpServer fLocalServer;
+  DLNAMediaServer *fMediaServer{nullptr}; ///< Only with ENABLE_DLNA_SERVER
 
   static const uint32 MSG_RENDERER_SELECTED = 'rndS';
   static const uint32 MSG_SHOW_RENDERER_MENU = 'shRM';
@@ -380,6 +445,7 @@ private:
   BMessageRunner *fStatusRunner{nullptr}; ///< Status bar clear timer
   BMessageRunner *fSearchRunner{nullptr}; ///< Search debounce timer
   BMessageRunner *fViewsRefreshRunner{nullptr}; ///< View refresh debounce timer
+  BMessageRunner *fStartupShowRunner{nullptr}; ///< Shows a stalled startup
   ///@}
 };
 
@@ -0,0 +1,62 @@
+#include "MemoryStats.h"
+
+#include <Message.h>
+#include <OS.h>
+
+std::atomic<int64> MemoryStats::sBytes[kMemoryCategoryCount];
+std::atomic<int64> MemoryStats::sObjects[kMemoryCategoryCount];
+
+static const char *kCategoryNames[kMemoryCategoryCount] = {
+    "entry store", "snapshots", "view items", "table rows",
+    "string pool", "covers",    "stream rings", "icons",
+    "view cache"};
+
+const char *MemoryStats::Name(MemoryCategory category) {
+  if (category < 0 || category >= kMemoryCategoryCount)
+    return "?";
+  return kCategoryNames[category];
+}
+
+int64 MemoryStats::ProcessRam() {
+  int64 total = 0;
+  ssize_t cookie = 0;
+  area_info info;
+  while (get_next_area_info(B_CURRENT_TEAM, &cookie, &info) == B_OK)
+    total += info.ram_size;
+  return total;
+}
+
+BString MemoryStats::Report() {
+  BString report;
+  report.SetToFormat("%-14s %10s %12s\n", "Category", "Objects", "KiB");
+
+  int64 accounted = 0;
+  for (int32 i = 0; i < kMemoryCategoryCount; i++) {
+    MemoryCategory category = (MemoryCategory)i;
+    int64 bytes = Bytes(category);
+    accounted += bytes;
+    BString line;
+    line.SetToFormat("%-14s %10lld %12lld\n", Name(category),
+                     (long long)Objects(category), (long long)(bytes / 1024));
+    report << line;
+  }
+
+  BString line;
+  line.SetToFormat("\n%-14s %10s %12lld\n", "accounted", "",
+                   (long long)(accounted / 1024));
+  report << line;
+  line.SetToFormat("%-14s %10s %12lld\n", "process RAM", "",
+                   (long long)(ProcessRam() / 1024));
+  report << line;
+  return report;
+}
+
+void MemoryStats::Archive(BMessage *into) {
+  for (int32 i = 0; i < kMemoryCategoryCount; i++) {
+    MemoryCategory category = (MemoryCategory)i;
+    into->AddString("category", Name(category));
+    into->AddInt64("bytes", Bytes(category));
+    into->AddInt64("objects", Objects(category));
+  }
+  into->AddInt64("process_ram", ProcessRam());
+}
@@ -0,0 +1,154 @@
+#ifndef BETON_MEMORY_STATS_H
+#define BETON_MEMORY_STATS_H
+
+#include <String.h>
+#include <SupportDefs.h>
+#include <atomic>
+#include <new>
+#include <vector>
+
+class BMessage;
+
+/**
+ * @brief Subsystems whose memory is accounted.
+ */
+enum MemoryCategory {
+  kMemoryEntries = 0, ///< Cache entry store and its indexes
+  kMemorySnapshots,   ///< Published library snapshots and their orders
+  kMemoryViewItems,   ///< Item copies held by the window and the browser
+  kMemoryTableRows,   ///< MediaTableView rows and their cell fields
+  kMemoryStrings,     ///< String pool slots and pooled strings
+  kMemoryCovers,      ///< Embedded covers held in memory
+  kMemoryStreams,     ///< Network stream rings
+  kMemoryIcons,       ///< Rasterized icons of the IconCache
+  kMemoryViewCache,   ///< Built views kept by the ViewModelCache
+  kMemoryCategoryCount
+};
+
+/**
+ * @class MemoryStats
+ * @brief Memory accounting of the large containers and caches.
+ *
+ * Containers report their own size through a `MemoryAccount`; classes that
+ * are allocated one by one derive from `MemoryCounted`, which hooks their
+ * `new` and `delete`. Each category thus holds the bytes and the number of
+ * its live containers or objects.
+ *
+ * Sizes are shallow: a container counts its arrays by capacity, not the
+ * string buffers its items point to. The repetitive ones are shared through
+ * the string pool and counted there, once.
+ *
+ * All counters are relaxed atomics in a fixed table.
+ */
+class MemoryStats {
+public:
+  static void Add(MemoryCategory category, int64 bytes, int64 objects) {
+    sBytes[category].fetch_add(bytes, std::memory_order_relaxed);
+    sObjects[category].fetch_add(objects, std::memory_order_relaxed);
+  }
+
+  static int64 Bytes(MemoryCategory category) {
+    return sBytes[category].load(std::memory_order_relaxed);
+  }
+  static int64 Objects(MemoryCategory category) {
+    return sObjects[category].load(std::memory_order_relaxed);
+  }
+  static const char *Name(MemoryCategory category);
+
+  /** @brief RAM committed to all areas of the team. */
+  static int64 ProcessRam();
+
+  /** @brief Plain text table of the categories and their sum. */
+  static BString Report();
+
+  /**
+   * @brief Adds "category", "bytes" and "objects" for each category, and
+   * "process_ram", to `into`.
+   */
+  static void Archive(BMessage *into);
+
+  /** @brief Heap bytes of a vector's array. */
+  template <typename T> static size_t BytesOf(const std::vector<T> &vector) {
+    return vector.capacity() * sizeof(T);
+  }
+
+private:
+  static std::atomic<int64> sBytes[kMemoryCategoryCount];
+  static std::atomic<int64> sObjects[kMemoryCategoryCount];
+};
+
+/**
+ * @class MemoryAccount
+ * @brief One container's share of a category.
+ *
+ * The container calls Set() with its size whenever that changed; the
+ * account adds the difference and gives its share back when destroyed.
+ * A copy starts at the size of the original, like the copied container.
+ */
+class MemoryAccount {
+public:
+  explicit MemoryAccount(MemoryCategory category)
+      : fCategory(category), fBytes(0) {
+    MemoryStats::Add(fCategory, 0, 1);
+  }
+
+  MemoryAccount(const MemoryAccount &other)
+      : fCategory(other.fCategory), fBytes(0) {
+    MemoryStats::Add(fCategory, 0, 1);
+    Set(other.fBytes);
+  }
+
+  MemoryAccount(MemoryAccount &&other)
+      : fCategory(other.fCategory), fBytes(other.fBytes) {
+    MemoryStats::Add(fCategory, 0, 1);
+    other.fBytes = 0;
+  }
+
+  ~MemoryAccount() { MemoryStats::Add(fCategory, -fBytes, -1); }
+
+  MemoryAccount &operator=(const MemoryAccount &other) {
+    if (this != &other)
+      Set(other.fBytes);
+    return *this;
+  }
+
+  MemoryAccount &operator=(MemoryAccount &&other) {
+    if (this != &other) {
+      Set(other.fBytes);
+      other.Set(0);
+    }
+    return *this;
+  }
+
+  void Set(size_t bytes) {
+    MemoryStats::Add(fCategory, (int64)bytes - fBytes, 0);
+    fBytes = (int64)bytes;
+  }
+
+  size_t Bytes() const { return (size_t)fBytes; }
+
+private:
+  MemoryCategory fCategory;
+  int64 fBytes;
+};
+
+/**
+ * @class MemoryCounted
+ * @brief Base that counts every instance of a class created with `new`, at
+ * its real size, in `Category`.
+ */
+template <MemoryCategory Category> class MemoryCounted {
+public:
+  static void *operator new(size_t size) {
+    void *pointer = ::operator new(size);
+    MemoryStats::Add(Category, (int64)size, 1);
+    return pointer;
+  }
+
+  static void operator delete(void *pointer, size_t size) {
+    MemoryStats::Add(Category, -(int64)size, -1);
+    ::operator delete(pointer);
+  }
+};
+
+#endif // BETON_MEMORY_STATS_H
@@ -8,10 +8,12 @@
 #define MSG_SCAN_FINISHED 'scfd'    ///< Final cleanup after scan.
 #define MSG_SCAN_PROGRESS 'mprg'    ///< Periodic progress update from scanner.
 #define MSG_MEDIA_ITEM_FOUND 'mitm' ///< (Legacy) Single item found.
-#define MSG_MEDIA_BATCH 'mbat'      ///< Batch of items from scanner to cache.
+#define MSG_MEDIA_ITEMS_UPDATED 'mitu' ///< Coalesced MSG_MEDIA_ITEM_FOUND updates ("item").
+#define MSG_MEDIA_BATCH 'mbat'      ///< Shared MediaBatch (scanner -> cache -> UI).
 #define MSG_MEDIA_ITEM_REMOVED 'mirm' ///< Item removed from library.
 #define MSG_LOAD_CACHE 'load'         ///< Request to load initial cache.
 #define MSG_CACHE_LOADED 'cach'       ///< Cache loading complete.
+#define MSG_START_LIVE_QUERIES 'lqst' ///< Start the live queries and the watcher once the window is up.
 #define MSG_RESCAN 'resc'             ///< Trigger a quick rescan.
 #define MSG_RESCAN_FULL 'rscn'        ///< Trigger a full, deep rescan.
 #define MSG_BASE_OFFLINE 'moff'       ///< Base path is offline/unreachable.
@@ -23,7 +25,23 @@
 #define MSG_DIR_REMOVE 'drmv'         ///< Remove directory from library.
 #define MSG_DIR_EDIT 'dedt'           ///< Edit directory sync settings.
 #define MSG_DIR_OK 'doky'             ///< Directory settings confirm.
-#define MSG_ATTR_POLL 'apol' ///< Periodic poll for BFS attribute changes.
+#define MSG_ATTR_POLL 'apol' ///< Re-read the files reported by the attribute live queries.
+#define MSG_SET_TAG_READERS 'stgr' ///< Set scanner tag reader pool size.
+#define MSG_WATCH_FLUSH 'wflu' ///< Debounce timer of the library watcher fired.
+#define MSG_LIBRARY_CHANGED 'lchg' ///< Watched files changed ("changed"/"removed"/"from"/"to").
+#define MSG_VALIDATE_CACHE 'vcac' ///< Check cached entries against the disk ("path" first).
+#define MSG_VALIDATE_NEXT 'vcnx'  ///< Next batch of the cache validation pass.
+#define MSG_SEARCH_INDEX_READY 'sidx' ///< Background search index build finished.
+#define MSG_SET_SCAN_WALKERS 'sswk'  ///< Set concurrent scanners per device ("count").
+#define MSG_SCAN_THROTTLE 'sthr'     ///< Scanner throttle level ("level").
+#define MSG_SCAN_SET_PAUSED 'spau'   ///< Pause or resume scanning ("paused").
+#define MSG_SCAN_PRIORITY 'sprh'     ///< Files to scan first ("path", none = clear).
+#define MSG_SCAN_PAUSE_TOGGLE 'sptg' ///< Menu: toggle scan pause.
+#define MSG_PLAYBACK_DEVICE 'pbdv'   ///< Device of local playback ("device", -1 = none).
+#define MSG_CACHE_GC 'cgcr'          ///< Drop stale cache entries (optional "days").
+#define MSG_CACHE_GC_DONE 'cgcd'     ///< Cache GC report ("orphaned", "expired", "bytes_before", "bytes_after").
+#define MSG_BFS_INDEXES_MISSING 'bixm' ///< Source volume lacks attribute indexes ("device", "volume", "attr").
+#define MSG_BFS_INDEXES_CREATE 'bixc'  ///< Reply to the index question ("device", "volume", "attr", "which").
 ///@}
 
 /** @name Playback Control */
@@ -37,13 +55,25 @@
 #define MSG_PREV_SONG 'prvs'      ///< Play previous track.
 #define MSG_SEEK_REQUEST 'seek'   ///< User requested seek (slider).
 #define MSG_VOLUME_CHANGED 'volu' ///< Volume slider changed.
-#define MSG_TIME_UPDATE 'tmuc'    ///< Periodic playback time update.
+#define MSG_TIME_UPDATE 'tmuc'    ///< Position poll for MIDI and remote playback.
+#define MSG_SEEKBAR_FRAME 'skfr'  ///< Seek bar redraw pacing tick.
 #define MSG_TRACK_ENDED 'tend'    ///< Current track finished playing.
 #define MSG_NOW_PLAYING 'nply'    ///< Notification of new track playing.
 #define MSG_PLAY_BTN 'plyB'       ///< Play button clicked.
 #define MSG_PREV_BTN 'prvB'       ///< Previous button clicked.
 #define MSG_SHUFFLE_TOGGLE 'shuf' ///< Toggle shuffle mode.
 #define MSG_REPEAT_TOGGLE 'rept'  ///< Toggle repeat mode.
+#define MSG_SET_CROSSFADE 'xfad'  ///< Set crossfade length ("seconds", 0 = off).
+#define MSG_SET_OUTPUT_RATE 'ordt' ///< Set fixed output rate ("rate", 0 = native).
+#define MSG_SET_STREAM_QUALITY 'sqcp' ///< Cap HLS variant bitrate ("kbps", 0 = none).
+#define MSG_SET_TIME_SHIFT 'tshf'     ///< Set live time-shift window ("minutes", 0 = off).
+#define MSG_SET_DSP 'dspS'          ///< Set the DSP chain (DspSettings::Archive() fields).
+#define MSG_EQUALIZER 'eqlz'        ///< Open (or raise) the equalizer window.
+#define MSG_EQUALIZER_CHANGED 'eqlc' ///< Equalizer window control changed.
+#define MSG_EQUALIZER_FLAT 'eqlf'   ///< Equalizer window: reset bands and preamp.
+#define MSG_WAVEFORM_REQUEST 'wfrq' ///< Waveform analyzer job ("path", "ticket").
+#define MSG_WAVEFORM_READY 'wfrd'   ///< Waveform overview ready ("path", "overview").
+#define MSG_SPECTRUM_TICK 'sptk'    ///< Spectrum view refresh tick.
 ///@}
 
 /** @name UI & Selection */
@@ -79,11 +109,15 @@
 #define MSG_TOOLTIPS_OFF 'ttof'           ///< Disable tooltips.
 #define MSG_TOGGLE_FAST_EDIT 'tgfe'       ///< Toggle inline cell editing.
 #define MSG_FILE_MOVE 'fmov'              ///< Request file move ("from"/"to" paths).
+#define MSG_FILES_MOVE 'fmvb'             ///< Move many files off the window thread.
+#define MSG_FILES_MOVED 'fmvj'            ///< File move job finished ("from"/"to" moved).
 #define MSG_FILE_MOVED 'fmvd'             ///< File moved on disk; rekey cache entry.
 #define MSG_UNDO 'undo'                   ///< Undo the last edit action.
 #define MSG_REDO 'redo'                   ///< Redo the last undone action.
 #define MSG_VIEWS_REFRESH 'vwrf'          ///< Debounced view refresh trigger.
 #define MSG_VIEWS_REFRESH_PARTIAL 'vwrp'  ///< Refresh trigger for Filters.
+#define MSG_FILTER_REQUEST 'fltq'         ///< Filter job queued for the filter worker.
+#define MSG_FILTER_RESULT 'fltr'          ///< Filter worker finished a job ("job").
 ///@}
 
 /** @name Playlist Management */
@@ -112,6 +146,8 @@
 #define MSG_RESTORE_PLAYLIST_PATHS 'rplp'    ///< Revert/restore playlist tracks.
 #define MSG_CREATE_PLAYLIST_WITH_PATHS 'cplp' ///< Create playlist and populate paths.
 #define MSG_DELETE_PLAYLIST_BY_NAME 'dpln'    ///< Delete playlist by name.
+#define MSG_PLAYLIST_FLUSH 'plfl'             ///< Write changed playlists.
+#define MSG_FOLDER_SOURCE_CHANGED 'fsch'      ///< Files below a cached folder source changed.
 ///@}
 
 
@@ -123,6 +159,8 @@
 #define MSG_MB_LIST_SEL 'mbls'        ///< Result list selection.
 #define MSG_MB_APPLY 'mbap'           ///< Apply single track metadata.
 #define MSG_MB_APPLY_ALBUM 'mbal'     ///< Apply full album metadata.
+#define MSG_MB_MATCH_ALBUMS 'mbma'    ///< Match files album by album ("file").
+#define MSG_MB_ALBUMS_MATCHED 'mbmd'  ///< Album matching done ("matched", "albums").
 #define MSG_MB_CANCEL 'mbcl'          ///< Cancel metadata dialog.
 ///@}
 
@@ -136,6 +174,8 @@
 #define MSG_PROP_SET_COVER_DATA 'pcvd' ///< Set cover image data.
 #define MSG_PROP_REQUEST_COVER 'prcv'  ///< Request cover fetch.
 #define MSG_SET_RATING 'srat'          ///< Set file rating (1-10).
+#define MSG_PROP_TAGS_LOADED 'prtl'    ///< Batch of tags read in background.
+#define MSG_PROP_TAB_SELECTED 'prts'   ///< Properties tab switched.
 ///@}
 
 /** @name Cover Art Handling */
@@ -148,6 +188,8 @@
 #define MSG_COVER_CLEAR_ALBUM 'cvca'       ///< Clear cover for album.
 #define MSG_COVER_DROPPED_APPLY_ALL 'cvda' ///< dropped cover -> all files.
 #define MSG_COVER_BITMAP_READY 'cvbr'      ///< Cover bitmap loaded & ready.
+#define MSG_ARTWORK_SCALE 'arsq'           ///< Scale request for the artwork scaler.
+#define MSG_ARTWORK_SCALED 'arsd'          ///< Scaled cover ready ("bitmap").
 ///@}
 
 /** @name Matching Window */
@@ -159,12 +201,55 @@
 #define MSG_MOVE_DOWN 'mvdn'    ///< Move item down.
 #define MSG_SMART_MATCH 'smrt'  ///< Trigger smart matching.
 #define MSG_DRAG_ITEM 'drgI'    ///< Drag started.
+#define MSG_MATCH_SCORES 'mtsc' ///< Best tracks of a file ("file", "track", "score").
+///@}
+
+/** @name Duplicate Finder */
+///@{
+#define MSG_FIND_DUPLICATES 'fdup'    ///< Open the duplicate finder window.
+#define MSG_DUPLICATE_PROGRESS 'dupP' ///< Duplicate search progress.
+#define MSG_DUPLICATES_FOUND 'dupF'   ///< Duplicate groups of a finished run.
+#define MSG_DUPLICATE_REVEAL 'dupR'   ///< Reveal the selected files.
+#define MSG_DUPLICATE_RESCAN 'dupS'   ///< Search the library again.
+///@}
+
+/** @name Loudness Analysis */
+///@{
+#define MSG_LOUDNESS_SCAN 'ldsc'     ///< Start/stop loudness analysis ("stop", "write").
+#define MSG_LOUDNESS_RESULT 'ldrs'   ///< Gains of one album ("path", "trackGain", ...).
+#define MSG_LOUDNESS_PROGRESS 'ldpg' ///< Analysis progress ("current", "total", "done").
+#define MSG_SET_NORMALIZATION 'nrml' ///< Playback normalization ("mode": 0 off, 1 track, 2 album).
+#define MSG_TOGGLE_LOUDNESS_WRITE 'ldwr' ///< Menu: store analysis results in the files.
+///@}
+
+/** @name Recording Identification */
+///@{
+#define MSG_ACOUSTID_SCAN 'aisc'     ///< Start/stop fingerprinting ("stop", "write").
+#define MSG_ACOUSTID_RESULT 'aidr'   ///< AcoustIDs found ("path", "acoustId").
+#define MSG_ACOUSTID_PROGRESS 'aipg' ///< Fingerprinting progress ("current", "total", "identified", "done").
 ///@}
 
 /** @name Debug / Misc */
 ///@{
 #define MSG_TEST_MODE 'tstM'       ///< Trigger test mode.
 #define MSG_REGISTER_TARGET 'regt' ///< Register messaging target.
+#define MSG_LOOPER_STATS 'lpst'         ///< Open the looper statistics window.
+#define MSG_LOOPER_STATS_REFRESH 'lpsr' ///< Statistics window refresh tick.
+#define MSG_LOOPER_STATS_RESET 'lpsz'   ///< Clear the recorded statistics.
+#define MSG_LOOPER_STATS_SAVE 'lpsv'    ///< Write the statistics to a file.
+#define MSG_AUDIO_HEALTH 'ahlt'         ///< Open the audio engine health window.
+#define MSG_AUDIO_HEALTH_REPORT 'ahlp'  ///< Request/reply of the health report ("report").
+#define MSG_AUDIO_HEALTH_REFRESH 'ahlr' ///< Health window refresh tick.
+#define MSG_AUDIO_HEALTH_RESET 'ahlz'   ///< Clear the audio engine counters.
+#define MSG_AUDIO_HEALTH_SAVE 'ahlv'    ///< Write the health report to a file.
+#define MSG_MEMORY_STATS 'mmst'         ///< Open the memory usage window.
+#define MSG_MEMORY_REPORT 'mmrp'        ///< Request/reply of the memory report ("report", MemoryStats::Archive() fields).
+#define MSG_MEMORY_REFRESH 'mmrf'       ///< Memory window refresh tick.
+#define MSG_MEMORY_TRIM 'mmtr'          ///< Drop in-memory caches and spare container capacity.
+#define MSG_MEMORY_SAVE 'mmsv'          ///< Write the memory report to a file.
+#define MSG_STARTUP_TASK_DONE 'stup'    ///< Worker part of a startup task done ("task", "result").
+#define MSG_STARTUP_SHOW 'stsh'         ///< Show the window before startup finished.
+#define MSG_SETTINGS_FLUSH 'stfl'       ///< Write the settings saved since the last flush.
 ///@}
 
 /** @name Metadata Sync */
@@ -189,6 +274,13 @@
 #define MSG_STREAM_METADATA 'smta' ///< ICY/stream metadata update.
 #define MSG_RADIO_FORMAT_UNSUPPORTED 'rfus' ///< Radio stream format not supported.
 #define MSG_RADIO_CONNECTION_FAILED 'rfcf'  ///< Connection to radio station failed.
+#define MSG_RADIO_STARTED 'rsta' ///< Station audible ("url", "elapsed" µs since Play).
+#define MSG_RADIO_PROBED 'rprb'     ///< Station checked ("url", "health", "latency", "bitrate", "codec").
+#define MSG_RADIO_PROBE_DONE 'rprd' ///< Station prober queue ran empty.
+#define MSG_RADIO_RECORD 'rrec'          ///< Start/stop recording the playing station.
+#define MSG_RADIO_RECORDING_SAVED 'rrsv' ///< Recorded title finished ("path").
+#define MSG_TOGGLE_RECORD_LIBRARY 'rrlb' ///< Menu: record into the library.
+#define MSG_RADIO_MORE_STATIONS 'rmor'   ///< Show the next page of stations.
 ///@}
 
 /** @name DLNA/UPnP */
@@ -202,9 +294,12 @@
 #define MSG_DLNA_SELECT_SERVER   'dlss'  ///< User selected a server from dropdown.
 #define MSG_DLNA_CRAWL_PROGRESS  'dlcp'  ///< Crawl progress update (item count).
 #define MSG_DLNA_CRAWL_DONE      'dlcd'  ///< Recursive crawl finished.
+#define MSG_DLNA_CRAWL_PAGE      'dlcg'  ///< Items a running crawl just found.
+#define MSG_DLNA_CRAWL_REFRESH   'dlcr'  ///< Coalesced view refresh while crawling.
 #define MSG_DLNA_VOLUME_UPDATE   'dlvu'  ///< DLNA renderer volume updated externally.
 #define MSG_DLNA_REFRESH_CACHE   'dlrc'  ///< Invalidate and rebuild server cache.
 #define MSG_DLNA_RESOURCE_UNAVAILABLE 'dlru' ///< DLNA resource cannot be played.
+#define MSG_DLNA_CONTENT_CHANGED 'dlcc' ///< A subscribed server's content changed.
 #define MSG_MUTE_TOGGLE          'mute'  ///< Toggle audio mute.
 ///@}
 
@@ -0,0 +1,177 @@
+#include "StartupSequence.h"
+#include "Debug.h"
+#include "Messages.h"
+#include "WorkerPool.h"
+
+StartupSequence::StartupSequence(const BMessenger &target,
+                                 bigtime_t launchTime)
+    : fTarget(target), fLaunchTime(launchTime), fAdvancing(false),
+      fReported(false) {}
+
+int32 StartupSequence::Add(const char *name,
+                           std::initializer_list<int32> needs,
+                           std::initializer_list<int32> applyAfter,
+                           Starter start, Apply apply) {
+  Task task;
+  task.name = name;
+  task.needs = needs;
+  task.applyAfter = applyAfter;
+  task.start = std::move(start);
+  task.apply = std::move(apply);
+  fTasks.push_back(std::move(task));
+  return (int32)fTasks.size() - 1;
+}
+
+int32 StartupSequence::AddExternal(const char *name) {
+  Task task;
+  task.name = name;
+  task.external = true;
+  fTasks.push_back(std::move(task));
+  return (int32)fTasks.size() - 1;
+}
+
+void StartupSequence::Record(const char *name, bigtime_t start,
+                             bigtime_t end) {
+  Task task;
+  task.name = name;
+  task.state = kApplied;
+  task.ready = task.workStart = start;
+  task.workEnd = task.applied = end;
+  fTasks.push_back(std::move(task));
+}
+
+void StartupSequence::Start() { _Advance(); }
+
+void StartupSequence::HandleTaskDone(BMessage *msg) {
+  int32 index = msg->GetInt32("task", -1);
+  if (index < 0 || index >= (int32)fTasks.size() ||
+      fTasks[index].state != kWorking) {
+    return;
+  }
+
+  Task &task = fTasks[index];
+  msg->FindMessage("result", &task.result);
+  task.workStart = msg->GetInt64("start", task.ready);
+  task.workEnd = msg->GetInt64("end", system_time());
+  task.state = kDone;
+  _Advance();
+}
+
+void StartupSequence::Complete(int32 task) {
+  if (task < 0 || task >= (int32)fTasks.size() ||
+      fTasks[task].state == kApplied) {
+    return;
+  }
+  Task &entry = fTasks[task];
+  entry.ready = entry.workStart = fLaunchTime;
+  entry.workEnd = system_time();
+  _MarkApplied(entry);
+  _Advance();
+}
+
+bool StartupSequence::IsApplied(int32 task) const {
+  return task >= 0 && task < (int32)fTasks.size() &&
+         fTasks[task].state == kApplied;
+}
+
+bool StartupSequence::DeferUntil(int32 task, const BMessage *msg) {
+  if (task < 0 || task >= (int32)fTasks.size() || IsApplied(task))
+    return false;
+  fTasks[task].deferred.push_back(*msg);
+  return true;
+}
+
+bool StartupSequence::_AllApplied(const std::vector<int32> &tasks) const {
+  for (int32 task : tasks) {
+    if (!IsApplied(task))
+      return false;
+  }
+  return true;
+}
+
+/**
+ * @brief Starts and applies whatever has become possible, until nothing
+ * changes.
+ */
+void StartupSequence::_Advance() {
+  // An apply that completes another task lands here; the loop below sees it.
+  if (fAdvancing)
+    return;
+  fAdvancing = true;
+
+  bool changed = true;
+  while (changed) {
+    changed = false;
+    for (int32 i = 0; i < (int32)fTasks.size(); i++) {
+      Task &task = fTasks[i];
+      if (task.state == kWaiting && !task.external &&
+          _AllApplied(task.needs)) {
+        task.ready = system_time();
+        Work work = task.start ? task.start() : Work();
+        if (!work) {
+          task.workStart = task.workEnd = task.ready;
+          task.state = kDone;
+        } else {
+          task.state = kWorking;
+          BMessenger target(fTarget);
+          BReference<WorkerJob> job = WorkerPool::Default().Submit(
+              kLaneInteractive, "startup", [target, i, work]() {
+                BMessage done(MSG_STARTUP_TASK_DONE);
+                BMessage result;
+                done.AddInt64("start", system_time());
+                work(result);
+                done.AddInt64("end", system_time());
+                done.AddInt32("task", i);
+                done.AddMessage("result", &result);
+                target.SendMessage(&done);
+              });
+          if (job.Get() == nullptr) {
+            task.workStart = system_time();
+            work(task.result);
+            task.workEnd = system_time();
+            task.state = kDone;
+          }
+        }
+        changed = true;
+      }
+
+      if (task.state == kDone && _AllApplied(task.applyAfter)) {
+        if (task.apply)
+          task.apply(task.result);
+        task.result.MakeEmpty();
+        _MarkApplied(task);
+        changed = true;
+      }
+    }
+  }
+  fAdvancing = false;
+
+  if (fReported)
+    return;
+  for (const Task &task : fTasks) {
+    if (task.state != kApplied)
+      return;
+  }
+  fReported = true;
+  _Report();
+}
+
+void StartupSequence::_MarkApplied(Task &task) {
+  task.applied = system_time();
+  task.state = kApplied;
+  for (BMessage &msg : task.deferred)
+    fTarget.SendMessage(&msg);
+  task.deferred.clear();
+}
+
+void StartupSequence::_Report() const {
+  auto ms = [this](bigtime_t time) {
+    return time < 0 ? 0.0 : (time - fLaunchTime) / 1000.0;
+  };
+  DEBUG_PRINT("Startup profile (ms since launch):\n");
+  for (const Task &task : fTasks) {
+    DEBUG_PRINT("  %-14s ready %7.1f  work %7.1f  applied %7.1f\n", task.name,
+                ms(task.ready), (task.workEnd - task.workStart) / 1000.0,
+                ms(task.applied));
+  }
+}
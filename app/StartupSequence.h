@@ -0,0 +1,105 @@
+#ifndef BETON_STARTUP_SEQUENCE_H
+#define BETON_STARTUP_SEQUENCE_H
+
+#include <Message.h>
+#include <Messenger.h>
+#include <OS.h>
+#include <SupportDefs.h>
+#include <functional>
+#include <initializer_list>
+#include <vector>
+
+/**
+ * @class StartupSequence
+ * @brief Dependency graph of the window's startup tasks.
+ *
+ * A task has an optional part that runs on the worker pool and an apply
+ * part that runs on the window thread with the worker's result. Its work
+ * starts once the tasks it `needs` are applied; its result is applied once
+ * the tasks in `applyAfter` are applied too. Tasks without either wait for
+ * nothing, so independent reads run side by side while the window thread
+ * keeps building the UI.
+ *
+ * Other milestones (e.g. the cache arriving from its own looper) are
+ * external tasks that the window completes by hand. Once every task is
+ * applied the sequence logs when each became ready, how long its work took
+ * and when it was applied, in ms since launch.
+ *
+ * Not thread-safe: everything but the work functions runs on the window
+ * thread.
+ */
+class StartupSequence {
+public:
+  /** @brief Worker part; fills `result`. Must not touch window state. */
+  typedef std::function<void(BMessage &result)> Work;
+  /**
+   * @brief Called on the window thread when the task's needs are applied;
+   * returns its work (or an empty function for none), e.g. bound to values
+   * read from the window.
+   */
+  typedef std::function<Work()> Starter;
+  /** @brief Window part; receives the worker's result. */
+  typedef std::function<void(BMessage &result)> Apply;
+
+  StartupSequence(const BMessenger &target, bigtime_t launchTime);
+
+  int32 Add(const char *name, std::initializer_list<int32> needs,
+            std::initializer_list<int32> applyAfter, Starter start,
+            Apply apply);
+
+  /** @brief Adds a task the owner completes with Complete(). */
+  int32 AddExternal(const char *name);
+
+  /** @brief Records a step that was timed outside the graph. */
+  void Record(const char *name, bigtime_t start, bigtime_t end);
+
+  /** @brief Starts every task whose needs are met. */
+  void Start();
+
+  /** @brief Handles MSG_STARTUP_TASK_DONE. */
+  void HandleTaskDone(BMessage *msg);
+
+  /** @brief Marks an external task as applied. */
+  void Complete(int32 task);
+
+  bool IsApplied(int32 task) const;
+
+  /**
+   * @brief Keeps a copy of `msg` until `task` is applied, then posts it to
+   * the target again.
+   * @return false if the task is applied already; handle `msg` right away.
+   */
+  bool DeferUntil(int32 task, const BMessage *msg);
+
+private:
+  enum State { kWaiting, kWorking, kDone, kApplied };
+
+  struct Task {
+    const char *name;
+    std::vector<int32> needs;
+    std::vector<int32> applyAfter;
+    Starter start;
+    Apply apply;
+    bool external = false;
+    State state = kWaiting;
+    bigtime_t ready = -1;
+    bigtime_t workStart = -1;
+    bigtime_t workEnd = -1;
+    bigtime_t applied = -1;
+    BMessage result;
+    std::vector<BMessage> deferred;
+  };
+
+  bool _AllApplied(const std::vector<int32> &tasks) const;
+  void _Advance();
+  void _MarkApplied(Task &task);
+  void _Report() const;
+
+  BMessenger fTarget;
+  bigtime_t fLaunchTime;
+  std::vector<Task> fTasks;
+  bool fAdvancing;
+  bool fReported;
+};
+
+#endif // BETON_STARTUP_SEQUENCE_H
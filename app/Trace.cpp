@@ -0,0 +1,267 @@
+#include "Trace.h"
+#include "Debug.h"
+
+#include <Autolock.h>
+#include <Locker.h>
+
+#include <new>
+#include <set>
+#include <stdio.h>
+#include <string>
+#include <string.h>
+#include <unistd.h>
+
+/** @brief Events per thread ring; a power of two. */
+static const uint32 kRingSize = 8192;
+/** @brief Threads that can record at the same time. */
+static const int32 kMaxRings = 128;
+/** @brief Flusher period. */
+static const bigtime_t kFlushInterval = 250000;
+
+static const char *kCategoryNames[kTraceCategoryCount] = {
+    "scan", "cache", "filter", "playback", "dlna"};
+
+namespace {
+
+struct TraceEvent {
+  const char *name;
+  bigtime_t start;
+  bigtime_t duration; ///< -1 for an instant
+  int64 arg;
+  uint32 category;
+};
+
+/**
+ * @brief Single-producer (the owning thread), single-consumer (the flusher)
+ * event ring.
+ */
+struct TraceRing {
+  enum State { kFree = 0, kOwned, kReleased };
+
+  std::atomic<int32> state{kOwned};
+  std::atomic<uint32> head{0}; ///< Written by the owner
+  std::atomic<uint32> tail{0}; ///< Written by the flusher
+  thread_id thread = -1;
+  thread_id namedThread = -1; ///< Thread the file has a name for
+  TraceEvent events[kRingSize];
+};
+
+/** @brief Hands the ring back when its thread exits. */
+struct RingHolder {
+  TraceRing *ring = nullptr;
+  ~RingHolder() {
+    if (ring != nullptr)
+      ring->state.store(TraceRing::kReleased, std::memory_order_release);
+  }
+};
+
+} // namespace
+
+std::atomic<bool> Trace::sEnabled(false);
+
+static std::atomic<TraceRing *> sRings[kMaxRings];
+static std::atomic<uint32> sDropped(0);
+static thread_local RingHolder sRingHolder;
+
+static FILE *sFile = nullptr;
+static bool sFirstEvent = true;
+static thread_id sFlusher = -1;
+static std::atomic<bool> sFlusherRunning(false);
+
+/** @brief The calling thread's ring, claimed on first use. */
+static TraceRing *CurrentRing() {
+  if (sRingHolder.ring != nullptr)
+    return sRingHolder.ring;
+
+  TraceRing *ring = nullptr;
+  for (int32 i = 0; i < kMaxRings && ring == nullptr; i++) {
+    TraceRing *slot = sRings[i].load(std::memory_order_acquire);
+    if (slot == nullptr) {
+      TraceRing *created = new (std::nothrow) TraceRing;
+      if (created == nullptr)
+        return nullptr;
+      if (sRings[i].compare_exchange_strong(slot, created,
+                                            std::memory_order_acq_rel)) {
+        ring = created;
+      } else {
+        delete created;
+      }
+    } else {
+      int32 expected = TraceRing::kFree;
+      if (slot->state.compare_exchange_strong(expected, TraceRing::kOwned,
+                                              std::memory_order_acq_rel))
+        ring = slot;
+    }
+  }
+  if (ring == nullptr)
+    return nullptr;
+
+  ring->thread = find_thread(nullptr);
+  sRingHolder.ring = ring;
+  return ring;
+}
+
+static void Push(const TraceEvent &event) {
+  TraceRing *ring = CurrentRing();
+  if (ring == nullptr) {
+    sDropped.fetch_add(1, std::memory_order_relaxed);
+    return;
+  }
+  uint32 head = ring->head.load(std::memory_order_relaxed);
+  uint32 tail = ring->tail.load(std::memory_order_acquire);
+  if (head - tail >= kRingSize) {
+    sDropped.fetch_add(1, std::memory_order_relaxed);
+    return;
+  }
+  ring->events[head & (kRingSize - 1)] = event;
+  ring->head.store(head + 1, std::memory_order_release);
+}
+
+static const char *CategoryName(uint32 category) {
+  for (int32 i = 0; i < kTraceCategoryCount; i++) {
+    if (category == (1u << i))
+      return kCategoryNames[i];
+  }
+  return "other";
+}
+
+static void WriteSeparator() {
+  fputs(sFirstEvent ? "\n" : ",\n", sFile);
+  sFirstEvent = false;
+}
+
+static void WriteThreadName(thread_id thread) {
+  thread_info info;
+  if (get_thread_info(thread, &info) != B_OK)
+    return;
+  // Names are free text; keep the JSON valid.
+  for (char *c = info.name; *c != '\0'; c++) {
+    if (*c == '"' || *c == '\\' || (unsigned char)*c < 0x20)
+      *c = '_';
+  }
+  WriteSeparator();
+  fprintf(sFile,
+          "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":%d,"
+          "\"args\":{\"name\":\"%s\"}}",
+          (int)getpid(), (int)thread, info.name);
+}
+
+/** @brief Moves every buffered event into the file; flusher only. */
+static void Drain() {
+  const int pid = (int)getpid();
+  for (int32 i = 0; i < kMaxRings; i++) {
+    TraceRing *ring = sRings[i].load(std::memory_order_acquire);
+    if (ring == nullptr)
+      break;
+    // Read the state first: a released ring gets no more events.
+    const int32 state = ring->state.load(std::memory_order_acquire);
+    uint32 tail = ring->tail.load(std::memory_order_relaxed);
+    const uint32 head = ring->head.load(std::memory_order_acquire);
+    if (tail != head && ring->namedThread != ring->thread) {
+      WriteThreadName(ring->thread);
+      ring->namedThread = ring->thread;
+    }
+    for (; tail != head; tail++) {
+      const TraceEvent &event = ring->events[tail & (kRingSize - 1)];
+      WriteSeparator();
+      if (event.duration >= 0) {
+        fprintf(sFile,
+                "{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"X\",\"ts\":%lld,"
+                "\"dur\":%lld,\"pid\":%d,\"tid\":%d,\"args\":{\"n\":%lld}}",
+                event.name, CategoryName(event.category),
+                (long long)event.start, (long long)event.duration, pid,
+                (int)ring->thread, (long long)event.arg);
+      } else {
+        fprintf(sFile,
+                "{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"i\",\"s\":\"t\","
+                "\"ts\":%lld,\"pid\":%d,\"tid\":%d,\"args\":{\"n\":%lld}}",
+                event.name, CategoryName(event.category),
+                (long long)event.start, pid, (int)ring->thread,
+                (long long)event.arg);
+      }
+    }
+    ring->tail.store(head, std::memory_order_release);
+    if (state == TraceRing::kReleased)
+      ring->state.store(TraceRing::kFree, std::memory_order_release);
+  }
+  fflush(sFile);
+}
+
+static int32 FlusherThread(void *) {
+  while (sFlusherRunning.load(std::memory_order_acquire)) {
+    snooze(kFlushInterval);
+    Drain();
+  }
+  return 0;
+}
+
+status_t Trace::Start(const char *path) {
+  if (sFile != nullptr)
+    return B_BUSY;
+  sFile = fopen(path, "w");
+  if (sFile == nullptr)
+    return B_ERROR;
+  fputs("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[", sFile);
+  sFirstEvent = true;
+  sDropped.store(0, std::memory_order_relaxed);
+
+  sFlusherRunning.store(true, std::memory_order_release);
+  sFlusher = spawn_thread(FlusherThread, "trace flusher", B_LOW_PRIORITY,
+                          nullptr);
+  if (sFlusher < B_OK) {
+    sFlusherRunning.store(false, std::memory_order_release);
+    fclose(sFile);
+    sFile = nullptr;
+    return sFlusher;
+  }
+  resume_thread(sFlusher);
+  sEnabled.store(true, std::memory_order_relaxed);
+  DEBUG_PRINT("[Trace] recording to %s\n", path);
+  return B_OK;
+}
+
+void Trace::Stop() {
+  if (sFile == nullptr)
+    return;
+  sEnabled.store(false, std::memory_order_relaxed);
+  sFlusherRunning.store(false, std::memory_order_release);
+  status_t result;
+  wait_for_thread(sFlusher, &result);
+  sFlusher = -1;
+
+  Drain();
+  const uint32 dropped = sDropped.load(std::memory_order_relaxed);
+  WriteSeparator();
+  fprintf(sFile,
+          "{\"name\":\"dropped events\",\"ph\":\"i\",\"s\":\"g\",\"ts\":%lld,"
+          "\"pid\":%d,\"tid\":0,\"args\":{\"n\":%u}}\n]}\n",
+          (long long)system_time(), (int)getpid(), (unsigned)dropped);
+  fclose(sFile);
+  sFile = nullptr;
+}
+
+void Trace::Complete(uint32 category, const char *name, bigtime_t start,
+                     bigtime_t duration, int64 arg) {
+  if (!IsEnabled())
+    return;
+  Push({name, start, duration, arg, category});
+}
+
+void Trace::Instant(uint32 category, const char *name, int64 arg) {
+  if (!IsEnabled())
+    return;
+  Push({name, system_time(), -1, arg, category});
+}
+
+const char *Trace::Intern(const char *name) {
+  static BLocker sLock("trace names");
+  static std::set<std::string> *sNames = new std::set<std::string>;
+  // Names are written into the JSON as they are.
+  std::string safe(name);
+  for (char &c : safe) {
+    if (c == '"' || c == '\\' || (unsigned char)c < 0x20)
+      c = '_';
+  }
+  BAutolock lock(sLock);
+  return sNames->insert(safe).first->c_str();
+}
@@ -0,0 +1,125 @@
+#ifndef BETON_TRACE_H
+#define BETON_TRACE_H
+
+#include "Config.h"
+
+#include <OS.h>
+#include <SupportDefs.h>
+#include <atomic>
+
+/**
+ * @brief Trace categories; bits of TRACE_CATEGORIES (see Config.h).
+ */
+enum TraceCategory : uint32 {
+  kTraceScan = 1 << 0,     ///< Library scans and tag reading
+  kTraceCache = 1 << 1,    ///< media.cache load, save and batches
+  kTraceFilter = 1 << 2,   ///< Column browser filter passes
+  kTracePlayback = 1 << 3, ///< Track start, decoding and underruns
+  kTraceDlna = 1 << 4      ///< DLNA control point and media server
+};
+
+static const int32 kTraceCategoryCount = 5;
+
+/**
+ * @class Trace
+ * @brief Low-overhead timeline tracing of selected code paths.
+ *
+ * Trace points are spans (TRACE_SCOPE) and instants (TRACE_INSTANT), each
+ * with a category, a name that must be a string literal and an optional
+ * integer argument. Categories not in TRACE_CATEGORIES compile to nothing;
+ * the others cost one relaxed atomic load while no trace is recorded.
+ *
+ * While recording (`--trace <file>` on the command line) every thread
+ * appends its events to a ring buffer of its own, without locks or
+ * allocation once the ring is set up. A flusher thread drains the rings a
+ * few times a second into a Chrome trace JSON file, which chrome://tracing
+ * and ui.perfetto.dev open as a timeline. A ring that is full when its
+ * thread records drops the event; the count of dropped events is written
+ * at the end.
+ */
+class Trace {
+public:
+  /** @brief Starts recording to `path`. */
+  static status_t Start(const char *path);
+
+  /** @brief Writes out what is buffered and closes the file. */
+  static void Stop();
+
+  static bool IsEnabled() {
+    return sEnabled.load(std::memory_order_relaxed);
+  }
+
+  /** @brief Records a span that began at `start` and lasted `duration`. */
+  static void Complete(uint32 category, const char *name, bigtime_t start,
+                       bigtime_t duration, int64 arg = 0);
+
+  /** @brief Records a point in time. */
+  static void Instant(uint32 category, const char *name, int64 arg = 0);
+
+  /**
+   * @brief Returns a copy of `name` that lives until exit, for names that
+   * are not literals (e.g. SOAP action names). Takes a lock; the same name
+   * always yields the same pointer.
+   */
+  static const char *Intern(const char *name);
+
+private:
+  static std::atomic<bool> sEnabled;
+};
+
+/**
+ * @class TraceScope
+ * @brief Records the lifetime of a block as a span of `Category`.
+ */
+template <uint32 Category> class TraceScope {
+public:
+  explicit TraceScope(const char *name, int64 arg = 0)
+      : fName(name), fArg(arg), fStart(-1) {
+    if constexpr ((TRACE_CATEGORIES & Category) != 0) {
+      if (Trace::IsEnabled())
+        fStart = system_time();
+    }
+  }
+
+  ~TraceScope() {
+    if constexpr ((TRACE_CATEGORIES & Category) != 0) {
+      if (fStart >= 0)
+        Trace::Complete(Category, fName, fStart, system_time() - fStart, fArg);
+    }
+  }
+
+  /** @brief Replaces the argument, e.g. with a count known at the end. */
+  void SetArg(int64 arg) { fArg = arg; }
+
+private:
+  const char *fName;
+  int64 fArg;
+  bigtime_t fStart;
+};
+
+#define TRACE_CONCAT_(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_(a, b)
+
+/** @brief Traces the enclosing block; optional third argument: an int64. */
+#define TRACE_SCOPE(category, ...)                                             \
+  TraceScope<category> TRACE_CONCAT(traceScope, __LINE__)(__VA_ARGS__)
+
+/** @brief Traces a point in time: TRACE_INSTANT(category, name[, arg]). */
+#define TRACE_INSTANT(category, ...)                                           \
+  do {                                                                         \
+    if constexpr ((TRACE_CATEGORIES & (category)) != 0) {                      \
+      if (Trace::IsEnabled())                                                  \
+        Trace::Instant(category, __VA_ARGS__);                                 \
+    }                                                                          \
+  } while (0)
+
+/** @brief Records a span timed by the caller. */
+#define TRACE_COMPLETE(category, ...)                                          \
+  do {                                                                         \
+    if constexpr ((TRACE_CATEGORIES & (category)) != 0) {                      \
+      if (Trace::IsEnabled())                                                  \
+        Trace::Complete(category, __VA_ARGS__);                                \
+    }                                                                          \
+  } while (0)
+
+#endif // BETON_TRACE_H
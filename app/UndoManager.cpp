@@ -1,8 +1,35 @@
 #include "UndoManager.h"
+#include "Debug.h"
 
+#include <Entry.h>
+#include <FindDirectory.h>
 #include <Window.h>
 
-UndoManager::UndoManager(BWindow *window) : fWindow(window) {}
+#include <algorithm>
+#include <unistd.h>
+
+static size_t FlattenedSize(const std::vector<BMessage> &msgs) {
+  size_t bytes = 0;
+  for (const auto &m : msgs)
+    bytes += (size_t)m.FlattenedSize();
+  return bytes;
+}
+
+UndoManager::UndoManager(BWindow *window)
+    : fWindow(window), fMemoryBudget(kDefaultMemoryBudget),
+      fSpillToDisk(true), fResidentBytes(0) {}
+
+UndoManager::~UndoManager() {
+  fSpillFile.Unset();
+  if (fSpillPath.InitCheck() == B_OK)
+    BEntry(fSpillPath.Path()).Remove();
+}
+
+void UndoManager::SetMemoryBudget(size_t bytes, bool spillToDisk) {
+  fMemoryBudget = bytes;
+  fSpillToDisk = spillToDisk;
+  _Trim();
+}
 
 void UndoManager::RecordAction(std::vector<BMessage> undoMsgs,
                                std::vector<BMessage> redoMsgs) {
@@ -19,12 +46,15 @@ void UndoManager::RecordAction(std::vector<BMessage> undoMsgs,
   Action action;
   action.undoMsgs = std::move(undoMsgs);
   action.redoMsgs = std::move(redoMsgs);
-  fUndoStack.push_back(std::move(action));
-  if ((int32)fUndoStack.size() > kMaxDepth)
-    fUndoStack.pop_front();
+  action.bytes = FlattenedSize(action.undoMsgs) +
+                 FlattenedSize(action.redoMsgs);
 
   // A new action invalidates the redo history.
+  for (const Action &old : fRedoStack)
+    _Forget(old);
   fRedoStack.clear();
+
+  _Push(fUndoStack, std::move(action));
 }
 
 bool UndoManager::Undo() {
@@ -33,10 +63,11 @@ bool UndoManager::Undo() {
 
   Action action = std::move(fUndoStack.back());
   fUndoStack.pop_back();
+  _Forget(action);
+  if (!_Restore(action))
+    return false;
   _Post(action.undoMsgs);
-  fRedoStack.push_back(std::move(action));
-  if ((int32)fRedoStack.size() > kMaxDepth)
-    fRedoStack.pop_front();
+  _Push(fRedoStack, std::move(action));
   return true;
 }
 
@@ -46,10 +77,11 @@ bool UndoManager::Redo() {
 
   Action action = std::move(fRedoStack.back());
   fRedoStack.pop_back();
+  _Forget(action);
+  if (!_Restore(action))
+    return false;
   _Post(action.redoMsgs);
-  fUndoStack.push_back(std::move(action));
-  if ((int32)fUndoStack.size() > kMaxDepth)
-    fUndoStack.pop_front();
+  _Push(fUndoStack, std::move(action));
   return true;
 }
 
@@ -59,3 +91,115 @@ void UndoManager::_Post(std::vector<BMessage> &msgs) {
   for (auto &m : msgs)
     fWindow->PostMessage(&m);
 }
+
+void UndoManager::_Push(std::deque<Action> &stack, Action action) {
+  fResidentBytes += action.bytes;
+  stack.push_back(std::move(action));
+  if ((int32)stack.size() > kMaxDepth) {
+    _Forget(stack.front());
+    stack.pop_front();
+  }
+  _Trim();
+}
+
+/**
+ * @brief Stops counting a resident action against the budget.
+ */
+void UndoManager::_Forget(const Action &action) {
+  if (action.spillOffset < 0)
+    fResidentBytes -= std::min(fResidentBytes, action.bytes);
+}
+
+/**
+ * @brief Spills or drops the oldest actions until the budget is met.
+ *
+ * The far end of the redo stack goes first, then the oldest undo steps.
+ */
+void UndoManager::_Trim() {
+  auto shrink = [this](std::deque<Action> &stack, size_t keep) {
+    for (size_t i = 0; i + keep < stack.size() &&
+                       fResidentBytes > fMemoryBudget;) {
+      Action &action = stack[i];
+      if (action.spillOffset >= 0) {
+        i++;
+        continue;
+      }
+      _Forget(action);
+      if (fSpillToDisk && _Spill(action)) {
+        i++;
+      } else {
+        stack.erase(stack.begin() + i);
+      }
+    }
+  };
+
+  shrink(fRedoStack, 0);
+  shrink(fUndoStack, 1);
+  _ResetSpillFileIfUnused();
+}
+
+bool UndoManager::_Spill(Action &action) {
+  if (fSpillFile.InitCheck() != B_OK) {
+    BPath path;
+    if (find_directory(B_SYSTEM_TEMP_DIRECTORY, &path) != B_OK)
+      return false;
+    BString leaf;
+    leaf.SetToFormat("BeTon-undo-%ld", (long)getpid());
+    path.Append(leaf.String());
+    if (fSpillFile.SetTo(path.Path(), B_READ_WRITE | B_CREATE_FILE |
+                                          B_ERASE_FILE) != B_OK)
+      return false;
+    fSpillPath = path;
+  }
+
+  BMessage archive;
+  for (const auto &m : action.undoMsgs)
+    archive.AddMessage("undo", &m);
+  for (const auto &m : action.redoMsgs)
+    archive.AddMessage("redo", &m);
+
+  off_t offset = fSpillFile.Seek(0, SEEK_END);
+  if (offset < 0 || archive.Flatten(&fSpillFile) != B_OK) {
+    DEBUG_PRINT("UndoManager: could not spill action\n");
+    if (offset >= 0)
+      fSpillFile.SetSize(offset);
+    return false;
+  }
+
+  action.undoMsgs.clear();
+  action.undoMsgs.shrink_to_fit();
+  action.redoMsgs.clear();
+  action.redoMsgs.shrink_to_fit();
+  action.spillOffset = offset;
+  return true;
+}
+
+bool UndoManager::_Restore(Action &action) {
+  if (action.spillOffset < 0)
+    return true;
+
+  BMessage archive;
+  if (fSpillFile.Seek(action.spillOffset, SEEK_SET) != action.spillOffset ||
+      archive.Unflatten(&fSpillFile) != B_OK) {
+    DEBUG_PRINT("UndoManager: could not restore spilled action\n");
+    return false;
+  }
+
+  BMessage m;
+  for (int32 i = 0; archive.FindMessage("undo", i, &m) == B_OK; i++)
+    action.undoMsgs.push_back(m);
+  for (int32 i = 0; archive.FindMessage("redo", i, &m) == B_OK; i++)
+    action.redoMsgs.push_back(m);
+  action.spillOffset = -1;
+  return true;
+}
+
+void UndoManager::_ResetSpillFileIfUnused() {
+  if (fSpillFile.InitCheck() != B_OK)
+    return;
+  for (const auto *stack : {&fUndoStack, &fRedoStack})
+    for (const Action &action : *stack)
+      if (action.spillOffset >= 0)
+        return;
+  fSpillFile.SetSize(0);
+}
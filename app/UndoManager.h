@@ -1,7 +1,9 @@
 #ifndef BETON_UNDO_MANAGER_H
 #define BETON_UNDO_MANAGER_H
 
+#include <File.h>
 #include <Message.h>
+#include <Path.h>
 #include <deque>
 #include <vector>
 
@@ -17,12 +19,23 @@ class BWindow;
  * the exact same code paths as the original user action. All replayed
  * messages carry "undo_replay" = true so the handlers that performed the
  * original action do not record the replay as a new action.
+ *
+ * Recorders should keep actions compact: one message per action that lists
+ * all affected files, with per-file differences as sub-messages (see
+ * MetadataService::SaveTags()), rather than one message per file.
+ *
+ * The flattened size of the kept actions is bounded by a memory budget.
+ * When it is exceeded the oldest actions are moved to a temporary spill
+ * file and read back when they are replayed; without spilling they are
+ * dropped. The newest undo action is always kept.
  */
 class UndoManager {
 public:
   static constexpr int32 kMaxDepth = 10;
+  static constexpr size_t kDefaultMemoryBudget = 4 * 1024 * 1024;
 
   UndoManager(BWindow *window);
+  ~UndoManager();
 
   /**
    * @brief Records an undoable action and clears the redo stack.
@@ -38,17 +51,45 @@ public:
   bool CanUndo() const { return !fUndoStack.empty(); }
   bool CanRedo() const { return !fRedoStack.empty(); }
 
+  /**
+   * @brief Sets the in-memory limit for recorded actions.
+   * @param bytes Budget for the flattened size of resident actions.
+   * @param spillToDisk Move evicted actions to a temp file instead of
+   * dropping them.
+   */
+  void SetMemoryBudget(size_t bytes, bool spillToDisk = true);
+
+  /** @brief Flattened size of the actions currently held in memory. */
+  size_t MemoryUsage() const { return fResidentBytes; }
+
 private:
   struct Action {
     std::vector<BMessage> undoMsgs;
     std::vector<BMessage> redoMsgs;
+    size_t bytes = 0;       ///< Flattened size while resident
+    off_t spillOffset = -1; ///< Position in the spill file, -1 if resident
   };
 
   void _Post(std::vector<BMessage> &msgs);
+  void _Push(std::deque<Action> &stack, Action action);
+  void _Trim();
+  bool _Spill(Action &action);
+  bool _Restore(Action &action);
+  void _Forget(const Action &action);
+  void _ResetSpillFileIfUnused();
 
   BWindow *fWindow;
   std::deque<Action> fUndoStack;
   std::deque<Action> fRedoStack;
+
+  /** @name Memory budget */
+  ///@{
+  size_t fMemoryBudget;
+  bool fSpillToDisk;
+  size_t fResidentBytes;
+  BFile fSpillFile;
+  BPath fSpillPath;
+  ///@}
 };
 
 #endif // BETON_UNDO_MANAGER_H
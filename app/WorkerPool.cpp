@@ -0,0 +1,323 @@
+#include "WorkerPool.h"
+#include "Debug.h"
+
+#include <Autolock.h>
+
+#include <algorithm>
+#include <string.h>
+
+/** @brief Upper bound of the interactive/background group. */
+static const int32 kMaxComputeWorkers = 8;
+/** @brief Size of the I/O group; its jobs mostly sleep on sockets. */
+static const int32 kIOWorkers = 4;
+
+static thread_local WorkerJob *sCurrentJob = nullptr;
+
+thread_local WorkerPool::Worker *WorkerPool::sCurrentWorker = nullptr;
+
+WorkerJob::WorkerJob(const char *name, WorkerLane lane,
+                     std::function<void()> &&func)
+    : fName(name), fLane(lane), fFunc(std::move(func)), fCancelled(false),
+      fDone(false), fDoneSem(create_sem(0, "worker job")) {}
+
+WorkerJob::~WorkerJob() {
+  if (!IsDone())
+    delete_sem(fDoneSem);
+}
+
+status_t WorkerJob::Wait(bigtime_t timeout) {
+  if (sCurrentJob == this)
+    return B_WOULD_BLOCK;
+  if (IsDone())
+    return B_OK;
+  status_t status = acquire_sem_etc(fDoneSem, 1, B_RELATIVE_TIMEOUT, timeout);
+  // _Finish() deletes the semaphore, which wakes every waiter.
+  if (status == B_BAD_SEM_ID || IsDone())
+    return B_OK;
+  return status == B_OK ? B_OK : B_TIMED_OUT;
+}
+
+WorkerJob *WorkerJob::Current() { return sCurrentJob; }
+
+void WorkerJob::_Finish() {
+  fFunc = nullptr; // Drops the captures now, not when the last holder does
+  fDone.store(true, std::memory_order_release);
+  delete_sem(fDoneSem);
+}
+
+WorkerPool::WorkerPool(int32 computeWorkers, int32 ioWorkers)
+    : fLock("worker pool"), fBackgroundRunning(0), fStopping(false),
+      fDropQueued(false) {
+  fGroups[kGroupCompute].limit =
+      std::max((int32)2, std::min(computeWorkers, kMaxGroupWorkers));
+  fGroups[kGroupIO].limit =
+      std::max((int32)1, std::min(ioWorkers, kMaxGroupWorkers));
+  fGroups[kGroupCompute].wake = create_sem(0, "worker pool compute");
+  fGroups[kGroupIO].wake = create_sem(0, "worker pool io");
+}
+
+WorkerPool::~WorkerPool() {
+  Shutdown(kDrainQueue);
+  for (Group &group : fGroups)
+    delete_sem(group.wake);
+}
+
+WorkerPool &WorkerPool::Default() {
+  static WorkerPool *sDefault = []() {
+    system_info info;
+    int32 cpus = get_system_info(&info) == B_OK ? (int32)info.cpu_count : 1;
+    return new WorkerPool(std::min(cpus, kMaxComputeWorkers), kIOWorkers);
+  }();
+  return *sDefault;
+}
+
+BReference<WorkerJob> WorkerPool::Submit(WorkerLane lane, const char *name,
+                                         std::function<void()> &&func) {
+  if (lane < 0 || lane >= kLaneCount)
+    return BReference<WorkerJob>();
+
+  BReference<WorkerJob> job(new WorkerJob(name, lane, std::move(func)), true);
+  Group &group = fGroups[_GroupOf(lane)];
+
+  // A worker keeps follow-up jobs of its own group local.
+  Worker *self = sCurrentWorker;
+  if (self != nullptr &&
+      (self->pool != this || self->group != _GroupOf(lane)))
+    self = nullptr;
+
+  {
+    BAutolock lock(fLock);
+    if (fStopping.load(std::memory_order_relaxed))
+      return BReference<WorkerJob>();
+    if (group.idle.load() == 0 && group.spawned.load() < group.limit &&
+        _SpawnLocked(_GroupOf(lane)) != B_OK && group.spawned.load() == 0)
+      return BReference<WorkerJob>();
+
+    job->AcquireReference(); // Held by the queue until the job finished
+    if (self != nullptr) {
+      BAutolock workerLock(self->lock);
+      self->jobs.push_back(job.Get());
+    } else {
+      fQueues[lane].push_back(job.Get());
+    }
+  }
+
+  release_sem(group.wake);
+  return job;
+}
+
+void WorkerPool::Shutdown(ShutdownMode mode) {
+  std::deque<WorkerJob *> dropped;
+  {
+    BAutolock lock(fLock);
+    if (fStopping.load(std::memory_order_relaxed))
+      return;
+    fStopping.store(true, std::memory_order_relaxed);
+    if (mode == kCancelQueue) {
+      fDropQueued.store(true, std::memory_order_relaxed);
+      for (auto &queue : fQueues) {
+        dropped.insert(dropped.end(), queue.begin(), queue.end());
+        queue.clear();
+      }
+    }
+  }
+
+  for (WorkerJob *job : dropped) {
+    job->Cancel();
+    job->_Finish();
+    job->ReleaseReference();
+  }
+
+  for (Group &group : fGroups) {
+    const int32 spawned = group.spawned.load();
+    if (mode == kCancelQueue) {
+      for (int32 i = 0; i < spawned; i++) {
+        Worker *worker = group.workers[i];
+        BAutolock lock(worker->lock);
+        if (worker->current != nullptr)
+          worker->current->Cancel();
+      }
+    }
+    if (spawned > 0)
+      release_sem_etc(group.wake, spawned, 0);
+  }
+
+  for (Group &group : fGroups) {
+    const int32 spawned = group.spawned.load();
+    for (int32 i = 0; i < spawned; i++) {
+      status_t exit;
+      wait_for_thread(group.workers[i]->thread, &exit);
+      delete group.workers[i];
+      group.workers[i] = nullptr;
+    }
+    group.spawned.store(0);
+  }
+}
+
+int32 WorkerPool::_WorkerEntry(void *data) {
+  Worker *worker = static_cast<Worker *>(data);
+  sCurrentWorker = worker;
+  worker->pool->_WorkerLoop(worker);
+  return 0;
+}
+
+void WorkerPool::_WorkerLoop(Worker *worker) {
+  Group &group = fGroups[worker->group];
+  for (;;) {
+    WorkerJob *job = _Take(worker);
+    if (job != nullptr) {
+      _Run(worker, job);
+      continue;
+    }
+    if (fStopping.load(std::memory_order_relaxed))
+      break;
+
+    group.idle.fetch_add(1);
+    status_t status;
+    do {
+      status = acquire_sem(group.wake);
+    } while (status == B_INTERRUPTED);
+    group.idle.fetch_sub(1);
+    if (status != B_OK)
+      break;
+  }
+}
+
+WorkerJob *WorkerPool::_Take(Worker *worker) {
+  if (fDropQueued.load(std::memory_order_relaxed)) {
+    BAutolock lock(worker->lock);
+    for (WorkerJob *job : worker->jobs) {
+      job->Cancel();
+      job->_Finish();
+      job->ReleaseReference();
+    }
+    worker->jobs.clear();
+    return nullptr;
+  }
+
+  if (worker->group == kGroupIO) {
+    {
+      BAutolock lock(worker->lock);
+      if (!worker->jobs.empty()) {
+        WorkerJob *job = worker->jobs.back();
+        worker->jobs.pop_back();
+        return job;
+      }
+    }
+    if (WorkerJob *job = _PopGlobal(kLaneIO))
+      return job;
+    return _Steal(worker);
+  }
+
+  if (WorkerJob *job = _PopGlobal(kLaneInteractive))
+    return job;
+
+  {
+    BAutolock lock(worker->lock);
+    if (!worker->jobs.empty()) {
+      WorkerJob *job = worker->jobs.back();
+      if (job->Lane() != kLaneBackground || _ClaimBackground()) {
+        worker->jobs.pop_back();
+        return job;
+      }
+    }
+  }
+
+  if (_ClaimBackground()) {
+    if (WorkerJob *job = _PopGlobal(kLaneBackground))
+      return job;
+    fBackgroundRunning.fetch_sub(1);
+  }
+  return _Steal(worker);
+}
+
+WorkerJob *WorkerPool::_PopGlobal(WorkerLane lane) {
+  BAutolock lock(fLock);
+  if (fQueues[lane].empty())
+    return nullptr;
+  WorkerJob *job = fQueues[lane].front();
+  fQueues[lane].pop_front();
+  return job;
+}
+
+WorkerJob *WorkerPool::_Steal(Worker *thief) {
+  Group &group = fGroups[thief->group];
+  const int32 spawned = group.spawned.load();
+  for (int32 i = 0; i < spawned; i++) {
+    Worker *victim = group.workers[i];
+    if (victim == thief)
+      continue;
+    BAutolock lock(victim->lock);
+    if (victim->jobs.empty())
+      continue;
+    WorkerJob *job = victim->jobs.front();
+    if (job->Lane() == kLaneBackground && !_ClaimBackground())
+      continue;
+    victim->jobs.pop_front();
+    return job;
+  }
+  return nullptr;
+}
+
+/** @brief Reserves a background slot; one compute worker is always left. */
+bool WorkerPool::_ClaimBackground() {
+  // While shutting down nothing interactive can arrive any more.
+  const int32 limit = fStopping.load(std::memory_order_relaxed)
+                          ? fGroups[kGroupCompute].limit
+                          : fGroups[kGroupCompute].limit - 1;
+  int32 running = fBackgroundRunning.load();
+  while (running < limit) {
+    if (fBackgroundRunning.compare_exchange_weak(running, running + 1))
+      return true;
+  }
+  return false;
+}
+
+void WorkerPool::_Run(Worker *worker, WorkerJob *job) {
+  const bool background = job->Lane() == kLaneBackground;
+  {
+    BAutolock lock(worker->lock);
+    worker->current = job;
+  }
+
+  if (!job->IsCancelled()) {
+    rename_thread(worker->thread, job->Name());
+    if (background)
+      set_thread_priority(worker->thread, B_LOW_PRIORITY);
+    sCurrentJob = job;
+    job->fFunc();
+    sCurrentJob = nullptr;
+    if (background)
+      set_thread_priority(worker->thread, B_NORMAL_PRIORITY);
+    rename_thread(worker->thread, "worker");
+  }
+
+  {
+    BAutolock lock(worker->lock);
+    worker->current = nullptr;
+  }
+  if (background)
+    fBackgroundRunning.fetch_sub(1);
+  job->_Finish();
+  job->ReleaseReference();
+}
+
+status_t WorkerPool::_SpawnLocked(int32 group) {
+  Group &target = fGroups[group];
+  const int32 spawned = target.spawned.load();
+  Worker *worker = new Worker;
+  worker->pool = this;
+  worker->group = group;
+  worker->thread =
+      spawn_thread(_WorkerEntry, "worker", B_NORMAL_PRIORITY, worker);
+  if (worker->thread < 0) {
+    status_t status = worker->thread;
+    DEBUG_PRINT("[WorkerPool] spawn_thread failed: %s\n", strerror(status));
+    delete worker;
+    return status;
+  }
+  target.workers[spawned] = worker;
+  target.spawned.store(spawned + 1);
+  resume_thread(worker->thread);
+  return B_OK;
+}
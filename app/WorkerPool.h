@@ -0,0 +1,157 @@
+#ifndef BETON_WORKER_POOL_H
+#define BETON_WORKER_POOL_H
+
+#include <Locker.h>
+#include <OS.h>
+#include <Referenceable.h>
+#include <SupportDefs.h>
+#include <atomic>
+#include <deque>
+#include <functional>
+
+/**
+ * @brief Queues of the worker pool, in the order workers look at them.
+ */
+enum WorkerLane {
+  kLaneInteractive = 0, ///< Work the user is waiting for right now
+  kLaneBackground,      ///< Long CPU or disk work; runs at low priority
+  kLaneIO,              ///< Work that mostly waits on the network
+  kLaneCount
+};
+
+/**
+ * @class WorkerJob
+ * @brief One queued function of a `WorkerPool`, reference counted so both
+ * the pool and the submitter can hold it.
+ *
+ * Cancellation is cooperative: Cancel() only sets a flag, which the job
+ * polls through Current() (or hands to APIs taking a `std::atomic<bool>`
+ * via CancelFlag()). A job cancelled before it started does not run at
+ * all.
+ */
+class WorkerJob : public BReferenceable {
+public:
+  const char *Name() const { return fName; }
+  WorkerLane Lane() const { return fLane; }
+
+  void Cancel() { fCancelled.store(true, std::memory_order_relaxed); }
+  bool IsCancelled() const {
+    return fCancelled.load(std::memory_order_relaxed);
+  }
+  const std::atomic<bool> *CancelFlag() const { return &fCancelled; }
+
+  bool IsDone() const { return fDone.load(std::memory_order_acquire); }
+
+  /**
+   * @brief Blocks until the job ran, or was dropped unrun.
+   * @return B_OK, B_TIMED_OUT, or B_WOULD_BLOCK when called from the job
+   * itself.
+   */
+  status_t Wait(bigtime_t timeout = B_INFINITE_TIMEOUT);
+
+  /** @brief The job running on the calling thread, or nullptr. */
+  static WorkerJob *Current();
+
+private:
+  friend class WorkerPool;
+
+  WorkerJob(const char *name, WorkerLane lane, std::function<void()> &&func);
+  ~WorkerJob() override;
+
+  void _Finish();
+
+  const char *fName; ///< A literal; names the worker thread while running
+  WorkerLane fLane;
+  std::function<void()> fFunc;
+  std::atomic<bool> fCancelled;
+  std::atomic<bool> fDone;
+  const sem_id fDoneSem; ///< Deleted on completion, which wakes all waiters
+};
+
+/**
+ * @class WorkerPool
+ * @brief Bounded, work-stealing thread pool shared by the whole application.
+ *
+ * Interactive and background jobs share a group of workers sized to the
+ * CPU count; I/O jobs get a small group of their own, so a slow server
+ * cannot hold up local work. Workers are spawned when work arrives and no
+ * worker of the group is idle, up to the group's limit; beyond that jobs
+ * queue, however fast they are submitted. Background jobs never occupy the
+ * last worker of their group, which stays free for interactive ones.
+ *
+ * Jobs submitted from outside go to the queue of their lane. A job that
+ * submits another job of the same group puts it on its worker's own deque,
+ * which the worker pops newest first; idle workers of the group steal
+ * oldest first from the other deques.
+ */
+class WorkerPool {
+public:
+  enum ShutdownMode {
+    kDrainQueue, ///< Run what is queued, then stop
+    kCancelQueue ///< Cancel running jobs, drop queued ones
+  };
+
+  WorkerPool(int32 computeWorkers, int32 ioWorkers);
+  ~WorkerPool();
+
+  /** @brief The application's pool. */
+  static WorkerPool &Default();
+
+  /**
+   * @brief Queues `func` on `lane`.
+   * @param name Literal naming the worker thread while the job runs.
+   * @return The job, or an empty reference after Shutdown().
+   */
+  BReference<WorkerJob> Submit(WorkerLane lane, const char *name,
+                               std::function<void()> &&func);
+
+  /**
+   * @brief Stops the workers once the queues are handled as `mode` says;
+   * Submit() fails from then on. Must not be called from a job.
+   */
+  void Shutdown(ShutdownMode mode);
+
+private:
+  enum { kGroupCompute = 0, kGroupIO, kGroupCount };
+  static const int32 kMaxGroupWorkers = 16;
+
+  struct Worker {
+    WorkerPool *pool;
+    int32 group;
+    thread_id thread = -1;
+    BLocker lock;
+    std::deque<WorkerJob *> jobs; ///< Own deque, guarded by lock
+    WorkerJob *current = nullptr; ///< Guarded by lock
+  };
+
+  struct Group {
+    int32 limit = 0;
+    sem_id wake = -1;
+    std::atomic<int32> spawned{0};
+    std::atomic<int32> idle{0};
+    Worker *workers[kMaxGroupWorkers] = {};
+  };
+
+  static int32 _WorkerEntry(void *data);
+  status_t _SpawnLocked(int32 group);
+  void _WorkerLoop(Worker *worker);
+  WorkerJob *_Take(Worker *worker);
+  WorkerJob *_PopGlobal(WorkerLane lane);
+  WorkerJob *_Steal(Worker *thief);
+  bool _ClaimBackground();
+  void _Run(Worker *worker, WorkerJob *job);
+  static int32 _GroupOf(WorkerLane lane) {
+    return lane == kLaneIO ? kGroupIO : kGroupCompute;
+  }
+
+  static thread_local Worker *sCurrentWorker;
+
+  BLocker fLock; ///< Guards the lane queues and spawning
+  std::deque<WorkerJob *> fQueues[kLaneCount];
+  Group fGroups[kGroupCount];
+  std::atomic<int32> fBackgroundRunning;
+  std::atomic<bool> fStopping;
+  std::atomic<bool> fDropQueued;
+};
+
+#endif // BETON_WORKER_POOL_H
@@ -1,6 +1,9 @@
 #include "ArtworkController.h"
 
 #include "Config.h"
+#include "CoverPrefetcher.h"
+#include "CoverThumbnailCache.h"
+#include "EmbeddedCoverCache.h"
 #include "MediaTableView.h"
 #include "NowPlayingInfoPanel.h"
 #include "LibraryBrowserController.h"
@@ -15,23 +18,22 @@
 #include <Bitmap.h>
 #include <ColumnListView.h>
 #include <DataIO.h>
-#include <HttpRequest.h>
 #include <MenuItem.h>
 #include <Message.h>
 #include <Messenger.h>
 #include <OS.h>
 #include <Path.h>
 #include <TranslationUtils.h>
-#include <Url.h>
-#include <UrlProtocolRoster.h>
 
-#include <memory>
 
 /**
  * @brief Constructs the artwork controller.
  * @param window Owning main window context.
  */
-ArtworkController::ArtworkController(MainWindow *window) : fWindow(window) {}
+ArtworkController::ArtworkController(MainWindow *window)
+    : fWindow(window), fPrefetcher(new CoverPrefetcher()) {}
+
+ArtworkController::~ArtworkController() { delete fPrefetcher; }
 
 /**
  * @brief Toggles artwork visibility and updates persisted settings.
@@ -81,12 +83,6 @@ void ArtworkController::HandleCoverBitmapReady(BMessage *msg) {
     return;
   }
 
-  if (fWindow->fRadioStationController &&
-      fWindow->fRadioStationController->IsCurrentCoverDownloadThread(
-          find_thread(nullptr))) {
-    fWindow->fRadioStationController->MarkCoverDownloadThreadDone();
-  }
-
   MediaTableView *cv = fWindow->fLibraryManager->ContentView();
   BRow *row = cv->CurrentSelection();
   bool match = false;
@@ -157,58 +153,60 @@ void ArtworkController::FetchNowPlayingCover(const BString &path,
 
 /**
  * @brief Downloads artwork from a remote URL in a background thread.
+ *
+ * Covers seen before are served from the thumbnail cache without a request;
+ * a cover already being prefetched is shown once that fetch is done.
  */
 void ArtworkController::DownloadCoverBitmap(const BString &path,
                                             const BString &coverUrl) {
-  BMessenger target(fWindow);
-  fWindow->LaunchThread("dlna_cover_dl", [coverUrl, target, path]() {
-    BMallocIO sink;
-#if B_HAIKU_VERSION <= B_HAIKU_VERSION_1_BETA_5
-    BUrl burl(coverUrl.String());
-#else
-    BUrl burl(coverUrl.String(), true);
-#endif
-    std::unique_ptr<BPrivate::Network::BUrlRequest> req(
-        BPrivate::Network::BUrlProtocolRoster::MakeRequest(burl, &sink));
-    if (req) {
-      if (auto http =
-              dynamic_cast<BPrivate::Network::BHttpRequest *>(req.get())) {
-        http->SetFollowLocation(true);
-      }
-      thread_id tid = req->Run();
-      status_t exit;
-      if (wait_for_thread_etc(tid, B_RELATIVE_TIMEOUT, 5000000, &exit) ==
-          B_OK) {
-        sink.Seek(0, SEEK_SET);
-        BBitmap *bitmap = BTranslationUtils::GetBitmap(&sink);
-        if (bitmap) {
-          BMessage update(MSG_COVER_BITMAP_READY);
-          update.AddString("path", path);
-          update.AddPointer("bitmap", bitmap);
-          if (target.SendMessage(&update) != B_OK)
-            delete bitmap;
-        }
-      } else {
-        req->Stop();
-      }
-    }
-  });
+  fPrefetcher->Fetch(coverUrl, path, BMessenger(fWindow));
+}
+
+/**
+ * @brief Loads the cover of a selected item.
+ *
+ * Items of a remote source carry a cover URL; their path is a stream URL
+ * without embedded artwork.
+ */
+void ArtworkController::FetchItemCover(const MediaItem &item) {
+  if (!item.coverUrl.IsEmpty())
+    DownloadCoverBitmap(item.path, item.coverUrl);
+  else
+    FetchEmbeddedCoverBitmap(item.path);
+}
+
+/**
+ * @brief Queues remote covers for the thumbnail cache.
+ */
+void ArtworkController::PrefetchCovers(const std::vector<BString> &urls,
+                                       bool urgent) {
+  fPrefetcher->Prefetch(urls, urgent);
 }
 
 /**
  * @brief Extracts embedded artwork from a local media file asynchronously.
+ *
+ * The cover comes from the EmbeddedCoverCache, and its thumbnail, keyed by
+ * the cover's hash, is only decoded when it is not in the thumbnail cache.
  */
 void ArtworkController::FetchEmbeddedCoverBitmap(const BString &path) {
   BMessenger target(fWindow);
   BString pathStr = path;
-  fWindow->LaunchThread("CoverFetch", [target, pathStr]() {
-    BPath p(pathStr.String());
-    CoverBlob cb;
+  fWindow->QueueJob(kLaneInteractive, "CoverFetch", [target, pathStr]() {
+    uint64 hash = 0;
+    std::shared_ptr<const CoverBlob> cover =
+        EmbeddedCoverCache::Default().Get(pathStr.String(), &hash);
     BBitmap *bmp = nullptr;
-
-    if (MetadataTagIO::ExtractEmbeddedCover(p, cb) && cb.data() && cb.size() > 0) {
-      BMemoryIO io(cb.data(), cb.size());
-      bmp = BTranslationUtils::GetBitmap(&io);
+    if (cover) {
+      CoverThumbnailCache &thumbnails = CoverThumbnailCache::Default();
+      BString key = CoverThumbnailCache::KeyForCover(hash);
+      bmp = thumbnails.Load(key);
+      if (bmp == nullptr) {
+        BMemoryIO io(cover->data(), cover->size());
+        bmp = BTranslationUtils::GetBitmap(&io);
+        if (bmp)
+          thumbnails.Store(key, bmp);
+      }
     }
 
     if (target.IsValid()) {
@@ -293,10 +291,11 @@ void ArtworkController::RequestEmbeddedCover(BMessage *msg) {
   if (msg->FindString("file", &file) != B_OK || file.IsEmpty())
     return;
 
-  CoverBlob cover;
-  if (MetadataTagIO::ExtractEmbeddedCover(BPath(file.String()), cover)) {
+  std::shared_ptr<const CoverBlob> cover =
+      EmbeddedCoverCache::Default().Get(file.String());
+  if (cover) {
     BMessage reply(MSG_PROP_SET_COVER_DATA);
-    reply.AddData("bytes", B_RAW_TYPE, cover.data(), (ssize_t)cover.size());
+    reply.AddData("bytes", B_RAW_TYPE, cover->data(), (ssize_t)cover->size());
 
     BMessenger sender = msg->ReturnAddress();
     sender.SendMessage(&reply);
@@ -2,9 +2,12 @@
 #define ARTWORK_CONTROLLER_H
 
 #include <String.h>
+#include <vector>
 
 class BMessage;
+class CoverPrefetcher;
 class MainWindow;
+struct MediaItem;
 
 /**
  * @class ArtworkController
@@ -20,6 +23,7 @@ public:
    * @param window Owning main window.
    */
   explicit ArtworkController(MainWindow *window);
+  ~ArtworkController();
 
   /**
    * @brief Toggles cover visibility in the sidebar panel and persists settings.
@@ -50,6 +54,19 @@ public:
    */
   void FetchEmbeddedCoverBitmap(const BString &path);
 
+  /**
+   * @brief Loads the cover of a selected item: from its cover URL if it has
+   * one, otherwise the embedded artwork.
+   */
+  void FetchItemCover(const MediaItem &item);
+
+  /**
+   * @brief Fetches remote covers into the thumbnail cache in the background.
+   * @param urls Cover URLs, most wanted first.
+   * @param urgent Fetches them before the covers asked for earlier.
+   */
+  void PrefetchCovers(const std::vector<BString> &urls, bool urgent = false);
+
   /**
    * @brief Applies album cover bytes to a single file via metadata service.
    * @param msg Message containing file path and raw image bytes.
@@ -84,6 +101,8 @@ private:
 
   /** Window context used to access controllers, services, and UI targets. */
   MainWindow *fWindow;
+  /** Downloads remote covers, shared by prefetches and shown covers. */
+  CoverPrefetcher *fPrefetcher;
 };
 
 #endif // ARTWORK_CONTROLLER_H
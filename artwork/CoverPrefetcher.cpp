@@ -0,0 +1,251 @@
+#include "CoverPrefetcher.h"
+
+#include "CoverThumbnailCache.h"
+#include "Debug.h"
+#include "HttpConnectionPool.h"
+#include "Messages.h"
+
+#include <Autolock.h>
+#include <Bitmap.h>
+#include <DataIO.h>
+#include <Message.h>
+#include <TranslationUtils.h>
+
+#include <algorithm>
+
+CoverPrefetcher::CoverPrefetcher()
+    : fWork(create_sem(0, "cover prefetch work")) {}
+
+CoverPrefetcher::~CoverPrefetcher() { Stop(); }
+
+void CoverPrefetcher::Prefetch(const std::vector<BString> &urls, bool urgent) {
+  if (fWork < 0 || fQuit.load(std::memory_order_relaxed))
+    return;
+
+  BAutolock lock(&fLock);
+  std::vector<BString> added;
+  for (const BString &url : urls) {
+    if (url.IsEmpty() || fKnown.count(url) > 0 || fInFlight.count(url) > 0)
+      continue;
+    if (fQueued.count(url) > 0) {
+      if (!urgent)
+        continue;
+      // Asked for again, now as urgent: moves up with the others.
+      fQueue.erase(std::find(fQueue.begin(), fQueue.end(), url));
+      fQueued.erase(url);
+    }
+    if (fQueued.insert(url).second)
+      added.push_back(url);
+  }
+  if (added.empty())
+    return;
+
+  if (urgent)
+    fQueue.insert(fQueue.begin(), added.begin(), added.end());
+  else
+    fQueue.insert(fQueue.end(), added.begin(), added.end());
+
+  _StartWorkersLocked();
+  release_sem_etc(fWork, (int32)added.size(), 0);
+}
+
+void CoverPrefetcher::Fetch(const BString &url, const BString &path,
+                            BMessenger target) {
+  if (url.IsEmpty() || fWork < 0 || fQuit.load(std::memory_order_relaxed))
+    return;
+
+  BAutolock lock(&fLock);
+  fWaiters[url].push_back({target, path});
+  // A running fetch serves its waiters when it is done.
+  if (fInFlight.count(url) > 0)
+    return;
+
+  if (fQueued.count(url) > 0)
+    fQueue.erase(std::find(fQueue.begin(), fQueue.end(), url));
+  else
+    fQueued.insert(url);
+  fQueue.push_front(url);
+
+  _StartWorkersLocked();
+  release_sem(fWork);
+}
+
+void CoverPrefetcher::Stop() {
+  fQuit.store(true, std::memory_order_relaxed);
+
+  std::vector<thread_id> workers;
+  {
+    BAutolock lock(&fLock);
+    workers.swap(fWorkers);
+    fQueue.clear();
+    fQueued.clear();
+    fWaiters.clear();
+  }
+  // Wakes the waiting workers; running fetches see fQuit through the cancel
+  // flag of their request.
+  if (fWork >= 0) {
+    delete_sem(fWork);
+    fWork = -1;
+  }
+  for (thread_id thread : workers) {
+    status_t exitValue;
+    wait_for_thread(thread, &exitValue);
+  }
+}
+
+void CoverPrefetcher::_StartWorkersLocked() {
+  // Workers are started with the first cover to fetch.
+  if (!fWorkers.empty())
+    return;
+  for (int32 i = 0; i < kConcurrency; i++) {
+    thread_id thread =
+        spawn_thread(_WorkerEntry, "cover prefetch", B_LOW_PRIORITY, this);
+    if (thread < 0)
+      break;
+    fWorkers.push_back(thread);
+    resume_thread(thread);
+  }
+}
+
+int32 CoverPrefetcher::_WorkerEntry(void *arg) {
+  static_cast<CoverPrefetcher *>(arg)->_Work();
+  return 0;
+}
+
+bool CoverPrefetcher::_TakeLocked(BString &url) {
+  for (auto it = fQueue.begin(); it != fQueue.end(); ++it) {
+    int32 &running = fRunning[_ServerOf(*it)];
+    if (running >= kPerServer)
+      continue;
+    running++;
+    url = *it;
+    fQueue.erase(it);
+    fQueued.erase(url);
+    fInFlight.insert(url);
+    return true;
+  }
+  return false;
+}
+
+void CoverPrefetcher::_RememberLocked(const BString &url) {
+  if (fKnown.size() >= kMaxKnown)
+    fKnown.clear();
+  fKnown.insert(url);
+}
+
+void CoverPrefetcher::_Work() {
+  for (;;) {
+    status_t status = acquire_sem(fWork);
+    if (status == B_INTERRUPTED)
+      continue;
+    if (status != B_OK || fQuit.load(std::memory_order_relaxed))
+      break;
+
+    // When every queued server is busy, the work is left to the fetch that
+    // frees a slot.
+    BString url;
+    bool wanted;
+    {
+      BAutolock lock(&fLock);
+      if (!_TakeLocked(url))
+        continue;
+      wanted = fWaiters.count(url) > 0;
+    }
+
+    BBitmap *bitmap = _Load(url, wanted);
+
+    std::vector<Waiter> waiters;
+    bool more;
+    {
+      BAutolock lock(&fLock);
+      fInFlight.erase(url);
+      BString server = _ServerOf(url);
+      if (--fRunning[server] <= 0)
+        fRunning.erase(server);
+      _RememberLocked(url);
+      auto found = fWaiters.find(url);
+      if (found != fWaiters.end()) {
+        waiters.swap(found->second);
+        fWaiters.erase(found);
+      }
+      more = !fQueue.empty();
+    }
+    if (more && fWork >= 0)
+      release_sem(fWork);
+
+    // Asked for while it was only being prefetched: it is cached by now.
+    if (bitmap == nullptr && !waiters.empty()) {
+      bitmap = CoverThumbnailCache::Default().Load(
+          CoverThumbnailCache::KeyForUrl(url));
+    }
+    if (fQuit.load(std::memory_order_relaxed) || bitmap == nullptr) {
+      delete bitmap;
+      if (fQuit.load(std::memory_order_relaxed))
+        break;
+      continue;
+    }
+
+    for (size_t i = 0; i < waiters.size(); i++) {
+      BBitmap *copy = i + 1 < waiters.size() ? new BBitmap(bitmap) : bitmap;
+      BMessage update(MSG_COVER_BITMAP_READY);
+      update.AddString("path", waiters[i].path);
+      update.AddPointer("bitmap", copy);
+      if (waiters[i].target.SendMessage(&update) != B_OK)
+        delete copy;
+    }
+    if (waiters.empty())
+      delete bitmap;
+  }
+}
+
+/**
+ * @brief Makes sure the cover at `url` is in the thumbnail cache.
+ * @param wanted Also returns it decoded; otherwise nullptr is returned and
+ *        a cached cover is not read at all.
+ */
+BBitmap *CoverPrefetcher::_Load(const BString &url, bool wanted) {
+  CoverThumbnailCache &thumbnails = CoverThumbnailCache::Default();
+  BString key = CoverThumbnailCache::KeyForUrl(url);
+  if (wanted) {
+    if (BBitmap *cached = thumbnails.Load(key))
+      return cached;
+  } else if (thumbnails.Contains(key)) {
+    return nullptr;
+  }
+
+  HttpConnectionPool::Request request;
+  request.url = url;
+  request.maxRedirects = 5;
+  request.timeout = kFetchTimeout;
+  request.cancel = &fQuit;
+  HttpConnectionPool::Response response;
+  if (HttpConnectionPool::Default().Fetch(request, response) != B_OK ||
+      response.status != 200 || response.body.empty()) {
+    DEBUG_PRINT("CoverPrefetcher: no cover at %s (%ld)\n", url.String(),
+                (long)response.status);
+    return nullptr;
+  }
+
+  BMemoryIO io(response.body.data(), response.body.size());
+  BBitmap *bitmap = BTranslationUtils::GetBitmap(&io);
+  if (bitmap == nullptr)
+    return nullptr;
+  thumbnails.Store(key, bitmap);
+  if (wanted)
+    return bitmap;
+  delete bitmap;
+  return nullptr;
+}
+
+/** @brief "scheme://host:port" of `url`; fetches are limited per server. */
+BString CoverPrefetcher::_ServerOf(const BString &url) {
+  int32 hostStart = url.FindFirst("://");
+  if (hostStart < 0)
+    return url;
+  int32 end = url.FindFirst('/', hostStart + 3);
+  if (end < 0)
+    return url;
+  BString server;
+  url.CopyInto(server, 0, end);
+  return server;
+}
@@ -0,0 +1,88 @@
+#ifndef BETON_COVER_PREFETCHER_H
+#define BETON_COVER_PREFETCHER_H
+
+#include <Locker.h>
+#include <Messenger.h>
+#include <OS.h>
+#include <String.h>
+#include <SupportDefs.h>
+#include <atomic>
+#include <deque>
+#include <map>
+#include <set>
+#include <vector>
+
+class BBitmap;
+
+/**
+ * @class CoverPrefetcher
+ * @brief Downloads remote covers into the CoverThumbnailCache ahead of
+ * being shown, a few at a time per server.
+ *
+ * DLNA tracks carry the albumArtURI of their album, so a listing names the
+ * same few covers over and over. Each URL is queued once; URLs already
+ * fetched, cached or found broken are remembered (up to kMaxKnown) and not
+ * queued again. kConcurrency low priority workers take the queue in order,
+ * but never run more than kPerServer fetches against one host, so a
+ * MediaServer on a NAS is not swamped while browsing.
+ *
+ * Fetch() asks for a cover to be shown: it goes to the front of the queue,
+ * or joins the fetch already running for its URL, and MSG_COVER_BITMAP_READY
+ * with the decoded bitmap goes to the target once it is there.
+ */
+class CoverPrefetcher {
+public:
+  static const int32 kConcurrency = 4;
+  static const int32 kPerServer = 2;
+  static const size_t kMaxKnown = 4096;
+  static const bigtime_t kFetchTimeout = 5000000;
+
+  CoverPrefetcher();
+  ~CoverPrefetcher();
+
+  /**
+   * @brief Queues covers to have them in the cache when they are shown.
+   * @param urls Cover URLs, most wanted first; duplicates are skipped.
+   * @param urgent Queues them ahead of the covers queued before.
+   */
+  void Prefetch(const std::vector<BString> &urls, bool urgent = false);
+
+  /**
+   * @brief Loads the cover at `url`, from the cache or the network, and
+   * sends MSG_COVER_BITMAP_READY with "path" and "bitmap" to `target`.
+   */
+  void Fetch(const BString &url, const BString &path, BMessenger target);
+
+  /** @brief Cancels running fetches and joins the workers. */
+  void Stop();
+
+private:
+  /** @brief Someone waiting for a cover to be shown. */
+  struct Waiter {
+    BMessenger target;
+    BString path;
+  };
+
+  static int32 _WorkerEntry(void *arg);
+  void _Work();
+  /** @brief Decoded cover, or nullptr; stores new downloads in the cache. */
+  BBitmap *_Load(const BString &url, bool wanted);
+  /** @brief Takes the first queued URL whose server has a free slot. */
+  bool _TakeLocked(BString &url);
+  void _StartWorkersLocked();
+  void _RememberLocked(const BString &url);
+  static BString _ServerOf(const BString &url);
+
+  BLocker fLock{"cover prefetcher"}; ///< Guards everything below
+  std::deque<BString> fQueue;
+  std::set<BString> fQueued;
+  std::map<BString, int32> fRunning; ///< Fetches in flight, per server
+  std::set<BString> fInFlight;
+  std::set<BString> fKnown; ///< Fetched, cached or failed
+  std::map<BString, std::vector<Waiter>> fWaiters;
+  sem_id fWork;
+  std::atomic<bool> fQuit{false};
+  std::vector<thread_id> fWorkers;
+};
+
+#endif // BETON_COVER_PREFETCHER_H
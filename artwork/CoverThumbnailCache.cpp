@@ -0,0 +1,279 @@
+#include "CoverThumbnailCache.h"
+#include "ArtworkScaler.h"
+#include "Debug.h"
+
+#include <Autolock.h>
+#include <Bitmap.h>
+#include <Directory.h>
+#include <Entry.h>
+#include <File.h>
+#include <FindDirectory.h>
+
+#include <algorithm>
+#include <memory>
+#include <time.h>
+#include <vector>
+
+/** @brief Cache size at which the oldest entries are evicted. */
+static const off_t kDefaultSizeLimit = 128 * 1024 * 1024;
+static const uint32 kThumbnailMagic = 'BTth';
+static const uint32 kThumbnailVersion = 1;
+
+/** @brief File header; followed by `height` rows of `width` BGRA pixels. */
+struct ThumbnailHeader {
+  uint32 magic;
+  uint32 version;
+  int32 width;
+  int32 height;
+};
+
+CoverThumbnailCache &CoverThumbnailCache::Default() {
+  static CoverThumbnailCache sCache;
+  return sCache;
+}
+
+CoverThumbnailCache::CoverThumbnailCache()
+    : fLock("CoverThumbnailCache"), fInitialized(false), fTotalSize(0),
+      fSizeLimit(kDefaultSizeLimit) {}
+
+BString CoverThumbnailCache::KeyForCover(uint64 hash) {
+  BString key;
+  key.SetToFormat("c-%016llx", (unsigned long long)hash);
+  return key;
+}
+
+BString CoverThumbnailCache::KeyForUrl(const BString &url) {
+  // 64-bit FNV-1a
+  uint64 hash = 14695981039346656037ULL;
+  for (int32 i = 0; i < url.Length(); i++) {
+    hash ^= (uint8)url.ByteAt(i);
+    hash *= 1099511628211ULL;
+  }
+  BString key;
+  key.SetToFormat("u-%016llx", (unsigned long long)hash);
+  return key;
+}
+
+status_t CoverThumbnailCache::_InitLocked() {
+  if (fInitialized)
+    return fDirectory.InitCheck();
+  fInitialized = true;
+
+  status_t status = find_directory(B_USER_SETTINGS_DIRECTORY, &fDirectory);
+  if (status != B_OK)
+    return status;
+  fDirectory.Append("BeTon/thumbnails");
+  create_directory(fDirectory.Path(), 0755);
+
+  BDirectory dir(fDirectory.Path());
+  status = dir.InitCheck();
+  if (status != B_OK) {
+    fDirectory.Unset();
+    return status;
+  }
+
+  BEntry entry;
+  while (dir.GetNextEntry(&entry) == B_OK) {
+    off_t size = 0;
+    if (entry.GetSize(&size) == B_OK)
+      fTotalSize += size;
+  }
+  DEBUG_PRINT("CoverThumbnailCache: %lld bytes in %s\n",
+              (long long)fTotalSize, fDirectory.Path());
+  return B_OK;
+}
+
+BBitmap *CoverThumbnailCache::Load(const BString &key) {
+  if (key.IsEmpty())
+    return nullptr;
+
+  BPath path;
+  {
+    BAutolock lock(fLock);
+    if (_InitLocked() != B_OK)
+      return nullptr;
+    path = fDirectory;
+  }
+  path.Append(key.String());
+
+  BFile file(path.Path(), B_READ_ONLY);
+  if (file.InitCheck() != B_OK)
+    return nullptr;
+
+  ThumbnailHeader header;
+  if (file.Read(&header, sizeof(header)) != (ssize_t)sizeof(header) ||
+      header.magic != kThumbnailMagic || header.version != kThumbnailVersion ||
+      header.width <= 0 || header.height <= 0 ||
+      header.width > kThumbnailEdge || header.height > kThumbnailEdge)
+    return nullptr;
+
+  std::unique_ptr<BBitmap> bitmap(new BBitmap(
+      BRect(0, 0, header.width - 1, header.height - 1), B_RGB32));
+  if (!bitmap->IsValid())
+    return nullptr;
+
+  size_t rowBytes = (size_t)header.width * 4;
+  uint8 *bits = static_cast<uint8 *>(bitmap->Bits());
+  if ((size_t)bitmap->BytesPerRow() == rowBytes) {
+    size_t total = rowBytes * header.height;
+    if (file.Read(bits, total) != (ssize_t)total)
+      return nullptr;
+  } else {
+    for (int32 y = 0; y < header.height; y++) {
+      if (file.Read(bits + (size_t)y * bitmap->BytesPerRow(), rowBytes) !=
+          (ssize_t)rowBytes)
+        return nullptr;
+    }
+  }
+
+  // Eviction goes by modification time, so a hit marks the entry as fresh.
+  BEntry(path.Path()).SetModificationTime(time(nullptr));
+  return bitmap.release();
+}
+
+bool CoverThumbnailCache::Contains(const BString &key) {
+  if (key.IsEmpty())
+    return false;
+
+  BPath path;
+  {
+    BAutolock lock(fLock);
+    if (_InitLocked() != B_OK)
+      return false;
+    path = fDirectory;
+  }
+  path.Append(key.String());
+
+  BEntry entry(path.Path());
+  if (!entry.Exists())
+    return false;
+  entry.SetModificationTime(time(nullptr));
+  return true;
+}
+
+void CoverThumbnailCache::Store(const BString &key, const BBitmap *cover) {
+  if (key.IsEmpty() || cover == nullptr || !cover->IsValid())
+    return;
+
+  int32 width = cover->Bounds().IntegerWidth() + 1;
+  int32 height = cover->Bounds().IntegerHeight() + 1;
+
+  // Downscale() wants a 32-bit source; decoders may hand out anything.
+  std::unique_ptr<BBitmap> converted;
+  const BBitmap *source = cover;
+  if (cover->ColorSpace() != B_RGB32 && cover->ColorSpace() != B_RGBA32) {
+    converted.reset(new BBitmap(cover->Bounds(), B_RGB32));
+    if (!converted->IsValid() || converted->ImportBits(cover) != B_OK)
+      return;
+    source = converted.get();
+  }
+
+  std::unique_ptr<BBitmap> scaled;
+  if (width > kThumbnailEdge || height > kThumbnailEdge) {
+    float factor = (float)kThumbnailEdge / std::max(width, height);
+    int32 targetWidth = std::max((int32)1, (int32)(width * factor + 0.5f));
+    int32 targetHeight = std::max((int32)1, (int32)(height * factor + 0.5f));
+    scaled.reset(ArtworkScaler::Downscale(source, targetWidth, targetHeight));
+    if (!scaled)
+      return;
+    source = scaled.get();
+    width = targetWidth;
+    height = targetHeight;
+  }
+
+  BAutolock lock(fLock);
+  if (_InitLocked() != B_OK)
+    return;
+
+  BPath path(fDirectory);
+  path.Append(key.String());
+  BString tempName(key);
+  tempName << ".tmp";
+  BPath tempPath(fDirectory);
+  tempPath.Append(tempName.String());
+
+  off_t oldSize = 0;
+  BEntry(path.Path()).GetSize(&oldSize);
+
+  // Write next to the final name and rename, so a reader never sees a
+  // partial file.
+  {
+    BFile file(tempPath.Path(), B_WRITE_ONLY | B_CREATE_FILE | B_ERASE_FILE);
+    if (file.InitCheck() != B_OK)
+      return;
+
+    ThumbnailHeader header = {kThumbnailMagic, kThumbnailVersion, width,
+                              height};
+    bool ok = file.Write(&header, sizeof(header)) == (ssize_t)sizeof(header);
+    size_t rowBytes = (size_t)width * 4;
+    const uint8 *bits = static_cast<const uint8 *>(source->Bits());
+    for (int32 y = 0; ok && y < height; y++) {
+      ok = file.Write(bits + (size_t)y * source->BytesPerRow(), rowBytes) ==
+           (ssize_t)rowBytes;
+    }
+    if (!ok) {
+      DEBUG_PRINT("CoverThumbnailCache: failed to write %s\n", key.String());
+      BEntry(tempPath.Path()).Remove();
+      return;
+    }
+  }
+
+  BEntry temp(tempPath.Path());
+  if (temp.Rename(path.Leaf(), true) != B_OK) {
+    temp.Remove();
+    return;
+  }
+
+  fTotalSize += sizeof(ThumbnailHeader) + (off_t)width * height * 4 - oldSize;
+  if (fTotalSize > fSizeLimit)
+    _EvictLocked();
+}
+
+/**
+ * @brief Removes the least recently used entries until the cache is back
+ * under three quarters of its limit, so eviction does not run on every store.
+ */
+void CoverThumbnailCache::_EvictLocked() {
+  struct Entry {
+    BString name;
+    off_t size;
+    time_t modified;
+  };
+
+  BDirectory dir(fDirectory.Path());
+  if (dir.InitCheck() != B_OK)
+    return;
+
+  std::vector<Entry> entries;
+  fTotalSize = 0;
+  BEntry entry;
+  while (dir.GetNextEntry(&entry) == B_OK) {
+    Entry item;
+    char name[B_FILE_NAME_LENGTH];
+    if (entry.GetName(name) != B_OK || entry.GetSize(&item.size) != B_OK ||
+        entry.GetModificationTime(&item.modified) != B_OK)
+      continue;
+    item.name = name;
+    fTotalSize += item.size;
+    entries.push_back(item);
+  }
+
+  std::sort(entries.begin(), entries.end(),
+            [](const Entry &a, const Entry &b) {
+              return a.modified < b.modified;
+            });
+
+  off_t target = fSizeLimit / 4 * 3;
+  int32 removed = 0;
+  for (const Entry &item : entries) {
+    if (fTotalSize <= target)
+      break;
+    BEntry victim(&dir, item.name.String());
+    if (victim.Remove() == B_OK) {
+      fTotalSize -= item.size;
+      removed++;
+    }
+  }
+  DEBUG_PRINT("CoverThumbnailCache: evicted %ld entries, %lld bytes left\n",
+              (long)removed, (long long)fTotalSize);
+}
@@ -0,0 +1,65 @@
+#ifndef BETON_COVER_THUMBNAIL_CACHE_H
+#define BETON_COVER_THUMBNAIL_CACHE_H
+
+#include <Locker.h>
+#include <Path.h>
+#include <String.h>
+#include <SupportDefs.h>
+
+class BBitmap;
+
+/**
+ * @class CoverThumbnailCache
+ * @brief Persistent cache of pre-scaled cover images.
+ *
+ * Covers are stored downscaled to at most `kThumbnailEdge` pixels as raw
+ * 32-bit pixels under `~/config/settings/BeTon/thumbnails`, so loading one
+ * is a single read without any decoding. Embedded covers are keyed by a
+ * hash of their bytes (see EmbeddedCoverCache), so tracks sharing their art
+ * share one thumbnail; remote covers by a hash of their URL.
+ *
+ * Entries are evicted least recently used first once the cache grows past
+ * its size limit; a hit refreshes the entry's modification time.
+ *
+ * All methods are thread-safe.
+ */
+class CoverThumbnailCache {
+public:
+  /** @brief Longest edge of a stored thumbnail, in pixels. */
+  static const int32 kThumbnailEdge = 400;
+
+  /** @brief Returns the cache shared by the cover loaders. */
+  static CoverThumbnailCache &Default();
+
+  /** @brief Key for an embedded cover, by EmbeddedCoverCache::HashOf(). */
+  static BString KeyForCover(uint64 hash);
+
+  /** @brief Key for a remote cover. */
+  static BString KeyForUrl(const BString &url);
+
+  /**
+   * @brief Loads a cached thumbnail.
+   * @return New bitmap owned by the caller, or nullptr on a miss.
+   */
+  BBitmap *Load(const BString &key);
+
+  /** @brief True if a thumbnail is stored under `key`; counts as a hit. */
+  bool Contains(const BString &key);
+
+  /** @brief Scales `cover` down to a thumbnail and stores it under `key`. */
+  void Store(const BString &key, const BBitmap *cover);
+
+private:
+  CoverThumbnailCache();
+
+  status_t _InitLocked();
+  void _EvictLocked();
+
+  BLocker fLock;
+  BPath fDirectory;
+  bool fInitialized;
+  off_t fTotalSize;  ///< Bytes in the cache directory
+  off_t fSizeLimit;
+};
+
+#endif // BETON_COVER_THUMBNAIL_CACHE_H
@@ -0,0 +1,158 @@
+#include "EmbeddedCoverCache.h"
+
+#include <Autolock.h>
+#include <Path.h>
+
+#include <string.h>
+#include <sys/stat.h>
+
+EmbeddedCoverCache &EmbeddedCoverCache::Default() {
+  static EmbeddedCoverCache sCache;
+  return sCache;
+}
+
+EmbeddedCoverCache::EmbeddedCoverCache()
+    : fLock("EmbeddedCoverCache"), fBytes(0), fMemory(kMemoryCovers) {}
+
+bool EmbeddedCoverCache::FileKey::operator<(const FileKey &other) const {
+  if (device != other.device)
+    return device < other.device;
+  if (inode != other.inode)
+    return inode < other.inode;
+  if (size != other.size)
+    return size < other.size;
+  return mtime < other.mtime;
+}
+
+bool EmbeddedCoverCache::_KeyOf(const char *path, FileKey &key) {
+  struct stat st;
+  if (path == nullptr || stat(path, &st) != 0)
+    return false;
+  key.device = st.st_dev;
+  key.inode = st.st_ino;
+  key.size = st.st_size;
+  key.mtime = (int64)st.st_mtim.tv_sec * 1000000000LL + st.st_mtim.tv_nsec;
+  return true;
+}
+
+uint64 EmbeddedCoverCache::HashOf(const CoverBlob &cover) {
+  // 64-bit FNV-1a
+  uint64 hash = 14695981039346656037ULL;
+  for (uint8_t byte : cover.bytes) {
+    hash ^= byte;
+    hash *= 1099511628211ULL;
+  }
+  return hash != 0 ? hash : 1;
+}
+
+std::shared_ptr<const CoverBlob> EmbeddedCoverCache::Get(const char *path,
+                                                         uint64 *hash) {
+  uint64 found = 0;
+  FileKey key;
+  const bool keyed = _KeyOf(path, key);
+  if (keyed) {
+    BAutolock lock(&fLock);
+    auto it = fFiles.find(key);
+    if (it != fFiles.end()) {
+      found = it->second;
+      std::shared_ptr<const CoverBlob> cover;
+      if (found != 0)
+        cover = _FindLocked(found);
+      // Known without a cover, or with one still in memory.
+      if (found == 0 || cover) {
+        if (hash != nullptr)
+          *hash = found;
+        return cover;
+      }
+    }
+  }
+
+  CoverBlob cover;
+  if (path != nullptr)
+    MetadataTagIO::ExtractEmbeddedCover(BPath(path), cover);
+
+  BAutolock lock(&fLock);
+  std::shared_ptr<const CoverBlob> shared =
+      _AddLocked(keyed ? &key : nullptr, cover, found);
+  if (hash != nullptr)
+    *hash = found;
+  return shared;
+}
+
+std::shared_ptr<const CoverBlob>
+EmbeddedCoverCache::Put(const char *path, CoverBlob &cover, uint64 *hash) {
+  FileKey key;
+  const bool keyed = _KeyOf(path, key);
+  uint64 found = 0;
+  BAutolock lock(&fLock);
+  std::shared_ptr<const CoverBlob> shared =
+      _AddLocked(keyed ? &key : nullptr, cover, found);
+  if (hash != nullptr)
+    *hash = found;
+  return shared;
+}
+
+void EmbeddedCoverCache::Trim() {
+  BAutolock lock(&fLock);
+  fCovers.clear();
+  fLru.clear();
+  fFiles.clear();
+  fBytes = 0;
+  fMemory.Set(0);
+}
+
+std::shared_ptr<const CoverBlob> EmbeddedCoverCache::_FindLocked(uint64 hash) {
+  auto it = fCovers.find(hash);
+  if (it == fCovers.end())
+    return nullptr;
+  fLru.splice(fLru.begin(), fLru, it->second.lru);
+  return it->second.cover;
+}
+
+/**
+ * @brief Remembers the cover of a file and stores it, or finds the equal
+ * cover stored for another file.
+ */
+std::shared_ptr<const CoverBlob>
+EmbeddedCoverCache::_AddLocked(const FileKey *key, CoverBlob &cover,
+                               uint64 &hash) {
+  hash = cover.size() > 0 ? HashOf(cover) : 0;
+  std::shared_ptr<const CoverBlob> shared;
+  if (hash != 0) {
+    shared = _FindLocked(hash);
+    if (shared && (shared->size() != cover.size() ||
+                   memcmp(shared->data(), cover.data(), cover.size()) != 0)) {
+      // Different bytes, same hash: handed out, but not remembered.
+      auto own = std::make_shared<CoverBlob>();
+      own->bytes.swap(cover.bytes);
+      return own;
+    }
+  }
+
+  if (key != nullptr) {
+    if (fFiles.size() >= kMaxFiles)
+      fFiles.clear();
+    fFiles[*key] = hash;
+  }
+  if (hash == 0 || shared)
+    return shared;
+
+  auto stored = std::make_shared<CoverBlob>();
+  stored->bytes.swap(cover.bytes);
+  fLru.push_front(hash);
+  fCovers[hash] = {stored, fLru.begin()};
+  fBytes += stored->size();
+  _EvictLocked();
+  return stored;
+}
+
+void EmbeddedCoverCache::_EvictLocked() {
+  // The newest cover stays even if it alone is over the limit.
+  while (fBytes > kMaxBytes && fLru.size() > 1) {
+    auto it = fCovers.find(fLru.back());
+    fBytes -= it->second.cover->size();
+    fCovers.erase(it);
+    fLru.pop_back();
+  }
+  fMemory.Set(fBytes);
+}
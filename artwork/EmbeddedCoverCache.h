@@ -0,0 +1,94 @@
+#ifndef BETON_EMBEDDED_COVER_CACHE_H
+#define BETON_EMBEDDED_COVER_CACHE_H
+
+#include "MemoryStats.h"
+#include "MetadataTagIO.h"
+
+#include <Locker.h>
+#include <SupportDefs.h>
+#include <list>
+#include <map>
+#include <memory>
+#include <sys/types.h>
+#include <unordered_map>
+
+/**
+ * @class EmbeddedCoverCache
+ * @brief In-memory cache of the covers embedded in local files.
+ *
+ * Files are keyed by device, inode, size and modification time, so a file
+ * whose cover was rewritten is read again. Each file maps to a hash of its
+ * cover bytes, and covers are stored once per hash: the tracks of an album
+ * that carry the same art share one entry. The hash also keys the cover's
+ * thumbnail in the CoverThumbnailCache.
+ *
+ * Covers are evicted least recently used first past kMaxBytes. Up to
+ * kMaxFiles file keys are remembered, files without a cover included.
+ *
+ * All methods are thread-safe; files are read outside the lock.
+ */
+class EmbeddedCoverCache {
+public:
+  static const size_t kMaxBytes = 32 * 1024 * 1024;
+  static const size_t kMaxFiles = 16384;
+
+  /** @brief Returns the cache shared by the cover loaders. */
+  static EmbeddedCoverCache &Default();
+
+  /**
+   * @brief Cover embedded in `path`, read from the file on a miss.
+   * @param hash Receives the hash of the cover, 0 if there is none.
+   * @return The cover, or nullptr if the file has none.
+   */
+  std::shared_ptr<const CoverBlob> Get(const char *path,
+                                       uint64 *hash = nullptr);
+
+  /**
+   * @brief Adds a cover read along with the tags of `path`.
+   * @param cover Taken over; empty if the file has none.
+   * @return The shared cover, or nullptr if it is empty.
+   */
+  std::shared_ptr<const CoverBlob> Put(const char *path, CoverBlob &cover,
+                                       uint64 *hash = nullptr);
+
+  /**
+   * @brief Drops every cover and file key; covers handed out stay valid
+   * with their holders.
+   */
+  void Trim();
+
+  /** @brief 64-bit FNV-1a of the cover bytes; never 0. */
+  static uint64 HashOf(const CoverBlob &cover);
+
+private:
+  struct FileKey {
+    dev_t device;
+    ino_t inode;
+    off_t size;
+    int64 mtime; ///< Nanoseconds
+
+    bool operator<(const FileKey &other) const;
+  };
+
+  struct Entry {
+    std::shared_ptr<const CoverBlob> cover;
+    std::list<uint64>::iterator lru;
+  };
+
+  EmbeddedCoverCache();
+
+  static bool _KeyOf(const char *path, FileKey &key);
+  std::shared_ptr<const CoverBlob> _FindLocked(uint64 hash);
+  std::shared_ptr<const CoverBlob> _AddLocked(const FileKey *key,
+                                              CoverBlob &cover, uint64 &hash);
+  void _EvictLocked();
+
+  BLocker fLock;
+  std::map<FileKey, uint64> fFiles; ///< Cover hash per file, 0 = none
+  std::unordered_map<uint64, Entry> fCovers;
+  std::list<uint64> fLru; ///< Most recently used first
+  size_t fBytes;
+  MemoryAccount fMemory;
+};
+
+#endif // BETON_EMBEDDED_COVER_CACHE_H
@@ -0,0 +1,243 @@
+#include "DLNACacheFile.h"
+#include "Debug.h"
+
+#include <OS.h>
+
+#include <string.h>
+
+// ============================================================================
+// DLNACacheWriter
+// ============================================================================
+
+DLNACacheWriter::DLNACacheWriter()
+    : fItemCount(0),
+      fHasSystemUpdateId(false),
+      fSystemUpdateId(0)
+{
+}
+
+void DLNACacheWriter::Reserve(size_t itemCount)
+{
+    fStringRefs.reserve(itemCount * kDlnaCacheStringFieldCount);
+}
+
+void DLNACacheWriter::AddItem(const DLNABrowseItem& item)
+{
+    fStringRefs.push_back(fStrings.Intern(item.title));
+    fStringRefs.push_back(fStrings.Intern(item.artist));
+    fStringRefs.push_back(fStrings.Intern(item.album));
+    fStringRefs.push_back(fStrings.Intern(item.genre));
+    fStringRefs.push_back(fStrings.Intern(item.resourceUrl));
+    fStringRefs.push_back(fStrings.Intern(item.mimeType));
+    fStringRefs.push_back(fStrings.Intern(item.duration));
+    fStringRefs.push_back(fStrings.Intern(item.albumArtUrl));
+    fStringRefs.push_back(fStrings.Intern(item.id));
+    fStringRefs.push_back(fStrings.Intern(item.parentId));
+    fItemCount++;
+}
+
+void DLNACacheWriter::SetState(const DLNAContentState& state)
+{
+    fHasSystemUpdateId = state.hasSystemUpdateId;
+    fSystemUpdateId = state.systemUpdateId;
+    fContainers.clear();
+    for (const auto& container : state.containerUpdateIds) {
+        fContainers.push_back(fStrings.Intern(container.first));
+        fContainers.push_back(container.second);
+    }
+}
+
+/**
+ * @brief Writes the collected records to `path` atomically, through
+ * `<path>.tmp`.
+ */
+status_t DLNACacheWriter::WriteTo(const char* path, CacheCodec codec) const
+{
+    const std::vector<uint32>& stringOffsets = fStrings.Offsets();
+    const std::vector<char>& blob = fStrings.Blob();
+
+    DLNACacheHeader header;
+    memset(&header, 0, sizeof(header));
+    header.magic = kDlnaCacheMagic;
+    header.version = kDlnaCacheVersion;
+    header.itemCount = fItemCount;
+    header.stringCount = fStrings.CountStrings();
+    header.timestamp = system_time();
+    header.flags = fHasSystemUpdateId ? kDlnaCacheHasSystemUpdateId : 0;
+    header.systemUpdateId = fSystemUpdateId;
+    header.containerCount = (uint32)(fContainers.size() / 2);
+
+    uint64 offset = CacheAlignOffset(sizeof(header));
+    header.stringRefsOffset = offset;
+    offset = CacheAlignOffset(offset + fStringRefs.size() * sizeof(uint32));
+    header.containersOffset = offset;
+    offset = CacheAlignOffset(offset + fContainers.size() * sizeof(uint32));
+    header.stringOffsetsOffset = offset;
+    offset = CacheAlignOffset(offset + stringOffsets.size() * sizeof(uint32));
+    header.blobOffset = offset;
+    header.blobSize = blob.size();
+
+    CacheFileWriter file(path, header.blobOffset + header.blobSize, codec);
+    status_t status = file.InitCheck();
+    if (status != B_OK)
+        return status;
+    auto writeAt = [&](uint64 at, const void* data, size_t size) {
+        file.WriteAt(at, data, size);
+    };
+
+    writeAt(0, &header, sizeof(header));
+    writeAt(header.stringRefsOffset, fStringRefs.data(),
+            fStringRefs.size() * sizeof(uint32));
+    writeAt(header.containersOffset, fContainers.data(),
+            fContainers.size() * sizeof(uint32));
+    writeAt(header.stringOffsetsOffset, stringOffsets.data(),
+            stringOffsets.size() * sizeof(uint32));
+    writeAt(header.blobOffset, blob.data(), blob.size());
+
+    return file.Commit();
+}
+
+// ============================================================================
+// DLNACacheReader
+// ============================================================================
+
+DLNACacheReader::DLNACacheReader()
+    : fHeader(nullptr),
+      fStringRefs(nullptr),
+      fContainers(nullptr)
+{
+}
+
+DLNACacheReader::~DLNACacheReader()
+{
+    Close();
+}
+
+void DLNACacheReader::Close()
+{
+    fFile.Close();
+    fHeader = nullptr;
+    fStringRefs = nullptr;
+    fContainers = nullptr;
+    fStrings.Unset();
+}
+
+/**
+ * @brief Maps `path` read-only and validates the header and all ordinals.
+ */
+status_t DLNACacheReader::Open(const char* path)
+{
+    Close();
+
+    status_t status = fFile.Open(path, sizeof(DLNACacheHeader));
+    if (status != B_OK)
+        return status;
+
+    /// Stream caches (v1, v2) share the magic: told apart before mapping.
+    DLNACacheHeader probe;
+    if (!fFile.Probe(&probe, sizeof(probe), 0)
+        || probe.magic != kDlnaCacheMagic
+        || probe.version != kDlnaCacheVersion) {
+        Close();
+        return B_BAD_DATA;
+    }
+
+    status = fFile.Map();
+    if (status != B_OK) {
+        Close();
+        return status;
+    }
+
+    const char* base = fFile.Data();
+    fHeader = (const DLNACacheHeader*)base;
+
+    const uint64 items = fHeader->itemCount;
+    const uint64 strings = fHeader->stringCount;
+    const uint64 containers = fHeader->containerCount;
+    if (!fFile.InBounds(fHeader->stringRefsOffset,
+                        items * kDlnaCacheStringFieldCount * sizeof(uint32))
+        || !fFile.InBounds(fHeader->containersOffset,
+                           containers * 2 * sizeof(uint32))
+        || !fFile.InBounds(fHeader->stringOffsetsOffset,
+                           strings * sizeof(uint32))
+        || !fFile.InBounds(fHeader->blobOffset, fHeader->blobSize)
+        || fStrings.SetTo((const uint32*)(base + fHeader->stringOffsetsOffset),
+                          (uint32)strings, base + fHeader->blobOffset,
+                          fHeader->blobSize) != B_OK) {
+        DEBUG_PRINT("DLNACacheReader: bad section in %s\n", path);
+        Close();
+        return B_BAD_DATA;
+    }
+
+    fStringRefs = (const uint32*)(base + fHeader->stringRefsOffset);
+    fContainers = (const uint32*)(base + fHeader->containersOffset);
+
+    const uint64 refCount = items * kDlnaCacheStringFieldCount;
+    for (uint64 i = 0; i < refCount; i++) {
+        if (fStringRefs[i] >= strings) {
+            Close();
+            return B_BAD_DATA;
+        }
+    }
+    for (uint64 i = 0; i < containers; i++) {
+        if (fContainers[i * 2] >= strings) {
+            Close();
+            return B_BAD_DATA;
+        }
+    }
+    return B_OK;
+}
+
+uint32 DLNACacheReader::_Ordinal(uint32 index, DLNACacheStringField field) const
+{
+    return fStringRefs[(size_t)index * kDlnaCacheStringFieldCount + field];
+}
+
+const char* DLNACacheReader::StringField(uint32 index,
+                                         DLNACacheStringField field,
+                                         uint32* outLength) const
+{
+    if (fHeader == nullptr || index >= fHeader->itemCount) {
+        if (outLength != nullptr)
+            *outLength = 0;
+        return "";
+    }
+    return fStrings.StringAt(_Ordinal(index, field), outLength);
+}
+
+const BString& DLNACacheReader::StringFieldAsBString(uint32 index,
+                                                     DLNACacheStringField field)
+{
+    if (fHeader == nullptr || index >= fHeader->itemCount)
+        return fEmpty;
+    return fStrings.BStringAt(_Ordinal(index, field));
+}
+
+void DLNACacheReader::ReadItem(uint32 index, DLNABrowseItem& out)
+{
+    out.title = StringFieldAsBString(index, kDlnaCacheTitle);
+    out.artist = StringFieldAsBString(index, kDlnaCacheArtist);
+    out.album = StringFieldAsBString(index, kDlnaCacheAlbum);
+    out.genre = StringFieldAsBString(index, kDlnaCacheGenre);
+    out.resourceUrl = StringFieldAsBString(index, kDlnaCacheResourceUrl);
+    out.mimeType = StringFieldAsBString(index, kDlnaCacheMimeType);
+    out.duration = StringFieldAsBString(index, kDlnaCacheDuration);
+    out.albumArtUrl = StringFieldAsBString(index, kDlnaCacheAlbumArtUrl);
+    out.id = StringFieldAsBString(index, kDlnaCacheId);
+    out.parentId = StringFieldAsBString(index, kDlnaCacheParentId);
+    out.isContainer = false;
+}
+
+void DLNACacheReader::ReadState(DLNAContentState& out)
+{
+    out = DLNAContentState();
+    if (fHeader == nullptr)
+        return;
+
+    out.hasSystemUpdateId = (fHeader->flags & kDlnaCacheHasSystemUpdateId) != 0;
+    out.systemUpdateId = fHeader->systemUpdateId;
+    for (uint32 i = 0; i < fHeader->containerCount; i++) {
+        out.containerUpdateIds[fStrings.BStringAt(fContainers[i * 2])]
+            = fContainers[i * 2 + 1];
+    }
+}
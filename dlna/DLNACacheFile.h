@@ -0,0 +1,154 @@
+#ifndef BETON_DLNA_CACHE_FILE_H
+#define BETON_DLNA_CACHE_FILE_H
+
+#include "CacheStringTable.h"
+#include "DLNAService.h"
+
+#include <String.h>
+#include <SupportDefs.h>
+#include <vector>
+
+/**
+ * @file DLNACacheFile.h
+ * @brief Memory-mapped on-disk format (v3) of a MediaServer's browse cache.
+ *
+ * Laid out like `media.cache` (all offsets absolute and 8-byte aligned):
+ * - `DLNACacheHeader`, with the server's SystemUpdateID
+ * - Record table: `itemCount * kDlnaCacheStringFieldCount` uint32 ordinals
+ * - Container table: `containerCount` pairs of an ObjectID ordinal and its
+ *   last ContainerUpdateIDs value
+ * - String offset table and blob: a `CacheStringTable`
+ *
+ * Versions 1 and 2 were a stream of length-prefixed strings; DLNAService
+ * still reads those when DLNACacheReader rejects a file.
+ *
+ * Like `media.cache` the file may be block-compressed as a whole.
+ */
+
+static const uint32 kDlnaCacheMagic = 'DLCA';
+static const uint32 kDlnaCacheVersion = 3;
+
+/** @brief String fields stored per record, in on-disk order. */
+enum DLNACacheStringField {
+    kDlnaCacheTitle = 0,
+    kDlnaCacheArtist,
+    kDlnaCacheAlbum,
+    kDlnaCacheGenre,
+    kDlnaCacheResourceUrl,
+    kDlnaCacheMimeType,
+    kDlnaCacheDuration,
+    kDlnaCacheAlbumArtUrl,
+    kDlnaCacheId,
+    kDlnaCacheParentId,
+    kDlnaCacheStringFieldCount
+};
+
+/** @brief Header flag: `systemUpdateId` is valid. */
+static const uint32 kDlnaCacheHasSystemUpdateId = 1;
+
+/**
+ * @struct DLNACacheHeader
+ * @brief Fixed-size file header of a v3 server cache.
+ */
+struct DLNACacheHeader {
+    uint32 magic;
+    uint32 version;
+    uint32 itemCount;
+    uint32 stringCount;
+    int64  timestamp;          ///< system_time() when written
+    uint32 flags;
+    uint32 systemUpdateId;
+    uint32 containerCount;
+    uint32 reserved0;
+    uint64 stringRefsOffset;
+    uint64 containersOffset;
+    uint64 stringOffsetsOffset;
+    uint64 blobOffset;
+    uint64 blobSize;
+    uint64 reserved[2];
+};
+
+/**
+ * @class DLNACacheWriter
+ * @brief Collects browse items and writes a v3 server cache.
+ *
+ * The file is written to a temporary sibling and renamed over the target,
+ * so a crash mid-write keeps the previous cache intact.
+ */
+class DLNACacheWriter {
+public:
+    DLNACacheWriter();
+
+    void Reserve(size_t itemCount);
+    void AddItem(const DLNABrowseItem& item);
+    void SetState(const DLNAContentState& state);
+
+    uint32 CountItems() const { return fItemCount; }
+
+    /**
+     * @param codec Block compression; by default chosen from the measured
+     * read throughput.
+     * @return `B_OK` on success or a storage error code.
+     */
+    status_t WriteTo(const char* path,
+                     CacheCodec codec = kCacheCodecAuto) const;
+
+private:
+    uint32 fItemCount;
+    std::vector<uint32> fStringRefs;
+    std::vector<uint32> fContainers; ///< Ordinal, update ID pairs
+    bool fHasSystemUpdateId;
+    uint32 fSystemUpdateId;
+    CacheStringTableWriter fStrings;
+};
+
+/**
+ * @class DLNACacheReader
+ * @brief Memory-maps a v3 server cache and materializes items on demand.
+ *
+ * Each distinct string becomes a `BString` once; the artist, album and
+ * genre shared by many tracks are thus one buffer each.
+ */
+class DLNACacheReader {
+public:
+    DLNACacheReader();
+    ~DLNACacheReader();
+
+    /**
+     * @return `B_OK`, `B_ENTRY_NOT_FOUND`, or `B_BAD_DATA` when the file is
+     *         not a valid v3 cache (older versions included).
+     */
+    status_t Open(const char* path);
+    void Close();
+
+    uint32 CountItems() const { return fHeader ? fHeader->itemCount : 0; }
+
+    /** @brief Read and decompression figures of Open(). */
+    const CacheLoadStats& LoadStats() const { return fFile.LoadStats(); }
+
+    /** @brief Returns a field without creating a `BString`. */
+    const char* StringField(uint32 index, DLNACacheStringField field,
+                            uint32* outLength = nullptr) const;
+
+    /** @brief Returns a field as a shared `BString`. */
+    const BString& StringFieldAsBString(uint32 index,
+                                        DLNACacheStringField field);
+
+    /** @brief Fills a browse item from one record. */
+    void ReadItem(uint32 index, DLNABrowseItem& out);
+
+    /** @brief The change counters saved with the items. */
+    void ReadState(DLNAContentState& out);
+
+private:
+    uint32 _Ordinal(uint32 index, DLNACacheStringField field) const;
+
+    CacheFileMapping fFile;
+    const DLNACacheHeader* fHeader;
+    const uint32* fStringRefs;
+    const uint32* fContainers;
+    CacheStringTableReader fStrings;
+    BString fEmpty;
+};
+
+#endif // BETON_DLNA_CACHE_FILE_H
@@ -9,7 +9,8 @@
  * @brief Represents a discovered UPnP device (MediaServer or MediaRenderer).
  *
  * Stores identity, service control URLs, and a last-seen timestamp
- * for automatic expiration of devices that go offline.
+ * for automatic expiration of devices that go offline. Devices restored
+ * from the description cache stay unverified until they answer again.
  */
 struct DLNADevice {
     /**
@@ -28,19 +29,32 @@ struct DLNADevice {
     /** @name MediaServer service URLs */
     ///@{
     BString contentDirUrl;   ///< ContentDirectory control URL (Server only).
+    BString contentDirEventUrl; ///< ContentDirectory event subscription URL (Server only).
     ///@}
 
     /** @name MediaRenderer service URLs */
     ///@{
     BString avTransportUrl;  ///< AVTransport control URL (Renderer only).
+    BString avTransportEventUrl; ///< AVTransport event subscription URL (Renderer only).
     BString renderingCtlUrl; ///< RenderingControl control URL (Renderer only).
+    BString renderingCtlEventUrl; ///< RenderingControl event subscription URL (Renderer only).
+    BString connectionMgrUrl; ///< ConnectionManager control URL (Renderer only).
+    BString sinkProtocolInfo; ///< GetProtocolInfo Sink, fetched on first use.
     ///@}
 
     bigtime_t lastSeen;      ///< system_time() when last seen via SSDP.
+    bigtime_t maxAge;        ///< CACHE-CONTROL max-age of the last SSDP reply.
+    int32   bootId;          ///< BOOTID.UPNP.ORG of the description; -1 if none.
+    int32   configId;        ///< CONFIGID.UPNP.ORG of the description; -1 if none.
+    bool    verified;        ///< Seen this session, not only restored from disk.
 
     DLNADevice()
         : type(MediaServer),
-          lastSeen(0)
+          lastSeen(0),
+          maxAge(0),
+          bootId(-1),
+          configId(-1),
+          verified(true)
     {
     }
 };
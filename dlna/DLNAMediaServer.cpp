@@ -0,0 +1,1171 @@
+#include "DLNAMediaServer.h"
+#include "DLNAService.h"
+#include "Debug.h"
+#include "LibrarySearchIndex.h"
+#include "Trace.h"
+
+#include <Autolock.h>
+#include <Catalog.h>
+#include <Directory.h>
+#include <File.h>
+#include <FindDirectory.h>
+#include <Message.h>
+#include <Path.h>
+
+#include <unistd.h>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include <initializer_list>
+#include <map>
+#include <random>
+
+#undef B_TRANSLATION_CONTEXT
+#define B_TRANSLATION_CONTEXT "DLNAMediaServer"
+
+static const char* kContentDirectoryUrn = "urn:schemas-upnp-org:service:ContentDirectory:1";
+static const char* kConnectionManagerUrn = "urn:schemas-upnp-org:service:ConnectionManager:1";
+
+static const char* kDidlHeader =
+    "<DIDL-Lite xmlns=\"urn:schemas-upnp-org:metadata-1-0/DIDL-Lite/\""
+    " xmlns:dc=\"http://purl.org/dc/elements/1.1/\""
+    " xmlns:upnp=\"urn:schemas-upnp-org:metadata-1-0/upnp/\""
+    " xmlns:dlna=\"urn:schemas-dlna-org:metadata-1-0/\">";
+
+/// Formats offered as the original file, for GetProtocolInfo.
+static const char* kSourceProtocolInfo =
+    "http-get:*:audio/mpeg:*,http-get:*:audio/flac:*,http-get:*:audio/ogg:*,"
+    "http-get:*:audio/mp4:*,http-get:*:audio/wav:*";
+
+static const char* kSearchCapabilities =
+    "dc:title,dc:creator,upnp:artist,upnp:album,upnp:genre,upnp:class";
+
+/** @brief One argument of an SCPD action. */
+struct ScpdArgument {
+    const char* name;
+    const char* direction;
+    const char* variable;
+};
+
+static void
+AppendScpdAction(BString& xml, const char* name,
+                 std::initializer_list<ScpdArgument> arguments)
+{
+    xml << "<action><name>" << name << "</name><argumentList>";
+    for (const ScpdArgument& argument : arguments) {
+        xml << "<argument><name>" << argument.name << "</name>"
+            << "<direction>" << argument.direction << "</direction>"
+            << "<relatedStateVariable>" << argument.variable
+            << "</relatedStateVariable></argument>";
+    }
+    xml << "</argumentList></action>";
+}
+
+static void
+AppendStateVariable(BString& xml, const char* name, const char* type,
+                    bool sendEvents = false)
+{
+    xml << "<stateVariable sendEvents=\"" << (sendEvents ? "yes" : "no") << "\">"
+        << "<name>" << name << "</name><dataType>" << type << "</dataType>"
+        << "</stateVariable>";
+}
+
+static const char* kScpdHeader =
+    "<?xml version=\"1.0\" encoding=\"utf-8\"?>"
+    "<scpd xmlns=\"urn:schemas-upnp-org:service-1-0\">"
+    "<specVersion><major>1</major><minor>0</minor></specVersion>";
+
+static BString
+ContentDirectoryScpd()
+{
+    const ScpdArgument page[] = {
+        { "Filter", "in", "A_ARG_TYPE_Filter" },
+        { "StartingIndex", "in", "A_ARG_TYPE_Index" },
+        { "RequestedCount", "in", "A_ARG_TYPE_Count" },
+        { "SortCriteria", "in", "A_ARG_TYPE_SortCriteria" },
+        { "Result", "out", "A_ARG_TYPE_Result" },
+        { "NumberReturned", "out", "A_ARG_TYPE_Count" },
+        { "TotalMatches", "out", "A_ARG_TYPE_Count" },
+        { "UpdateID", "out", "A_ARG_TYPE_UpdateID" }
+    };
+
+    BString xml(kScpdHeader);
+    xml << "<actionList>";
+    AppendScpdAction(xml, "GetSearchCapabilities",
+                     { { "SearchCaps", "out", "SearchCapabilities" } });
+    AppendScpdAction(xml, "GetSortCapabilities",
+                     { { "SortCaps", "out", "SortCapabilities" } });
+    AppendScpdAction(xml, "GetSystemUpdateID",
+                     { { "Id", "out", "SystemUpdateID" } });
+    AppendScpdAction(xml, "Browse",
+                     { { "ObjectID", "in", "A_ARG_TYPE_ObjectID" },
+                       { "BrowseFlag", "in", "A_ARG_TYPE_BrowseFlag" },
+                       page[0], page[1], page[2], page[3],
+                       page[4], page[5], page[6], page[7] });
+    AppendScpdAction(xml, "Search",
+                     { { "ContainerID", "in", "A_ARG_TYPE_ObjectID" },
+                       { "SearchCriteria", "in", "A_ARG_TYPE_SearchCriteria" },
+                       page[0], page[1], page[2], page[3],
+                       page[4], page[5], page[6], page[7] });
+    xml << "</actionList><serviceStateTable>";
+    AppendStateVariable(xml, "SearchCapabilities", "string");
+    AppendStateVariable(xml, "SortCapabilities", "string");
+    AppendStateVariable(xml, "SystemUpdateID", "ui4", true);
+    AppendStateVariable(xml, "A_ARG_TYPE_ObjectID", "string");
+    AppendStateVariable(xml, "A_ARG_TYPE_Result", "string");
+    AppendStateVariable(xml, "A_ARG_TYPE_SearchCriteria", "string");
+    xml << "<stateVariable sendEvents=\"no\"><name>A_ARG_TYPE_BrowseFlag</name>"
+        << "<dataType>string</dataType><allowedValueList>"
+        << "<allowedValue>BrowseMetadata</allowedValue>"
+        << "<allowedValue>BrowseDirectChildren</allowedValue>"
+        << "</allowedValueList></stateVariable>";
+    AppendStateVariable(xml, "A_ARG_TYPE_Filter", "string");
+    AppendStateVariable(xml, "A_ARG_TYPE_SortCriteria", "string");
+    AppendStateVariable(xml, "A_ARG_TYPE_Index", "ui4");
+    AppendStateVariable(xml, "A_ARG_TYPE_Count", "ui4");
+    AppendStateVariable(xml, "A_ARG_TYPE_UpdateID", "ui4");
+    xml << "</serviceStateTable></scpd>";
+    return xml;
+}
+
+static BString
+ConnectionManagerScpd()
+{
+    BString xml(kScpdHeader);
+    xml << "<actionList>";
+    AppendScpdAction(xml, "GetProtocolInfo",
+                     { { "Source", "out", "SourceProtocolInfo" },
+                       { "Sink", "out", "SinkProtocolInfo" } });
+    AppendScpdAction(xml, "GetCurrentConnectionIDs",
+                     { { "ConnectionIDs", "out", "CurrentConnectionIDs" } });
+    AppendScpdAction(xml, "GetCurrentConnectionInfo",
+                     { { "ConnectionID", "in", "A_ARG_TYPE_ConnectionID" },
+                       { "RcsID", "out", "A_ARG_TYPE_RcsID" },
+                       { "AVTransportID", "out", "A_ARG_TYPE_AVTransportID" },
+                       { "ProtocolInfo", "out", "A_ARG_TYPE_ProtocolInfo" },
+                       { "PeerConnectionManager", "out", "A_ARG_TYPE_ConnectionManager" },
+                       { "PeerConnectionID", "out", "A_ARG_TYPE_ConnectionID" },
+                       { "Direction", "out", "A_ARG_TYPE_Direction" },
+                       { "Status", "out", "A_ARG_TYPE_ConnectionStatus" } });
+    xml << "</actionList><serviceStateTable>";
+    AppendStateVariable(xml, "SourceProtocolInfo", "string", true);
+    AppendStateVariable(xml, "SinkProtocolInfo", "string", true);
+    AppendStateVariable(xml, "CurrentConnectionIDs", "string", true);
+    AppendStateVariable(xml, "A_ARG_TYPE_ConnectionStatus", "string");
+    AppendStateVariable(xml, "A_ARG_TYPE_ConnectionManager", "string");
+    AppendStateVariable(xml, "A_ARG_TYPE_Direction", "string");
+    AppendStateVariable(xml, "A_ARG_TYPE_ProtocolInfo", "string");
+    AppendStateVariable(xml, "A_ARG_TYPE_ConnectionID", "i4");
+    AppendStateVariable(xml, "A_ARG_TYPE_AVTransportID", "i4");
+    AppendStateVariable(xml, "A_ARG_TYPE_RcsID", "i4");
+    xml << "</serviceStateTable></scpd>";
+    return xml;
+}
+
+/** @brief DIDL duration, "H:MM:SS.000". */
+static BString
+DidlDuration(int32 seconds)
+{
+    BString duration;
+    duration.SetToFormat("%d:%02d:%02d.000", (int)(seconds / 3600),
+                         (int)(seconds / 60 % 60), (int)(seconds % 60));
+    return duration;
+}
+
+DLNAMediaServer::DLNAMediaServer(LocalFileHttpServer* http,
+                                 const LibrarySearchIndex* search,
+                                 BLocker* indexLock)
+    : fHttp(http),
+      fSearchIndex(search),
+      fIndexLock(indexLock),
+      fSsdp(nullptr),
+      fUdn(_LoadUdn()),
+      fViewLock("dlna media server"),
+      fView(new View, true),
+      fSystemUpdateId(0)
+{
+    char hostname[256];
+    if (gethostname(hostname, sizeof(hostname)) == 0 && hostname[0] != '\0') {
+        hostname[sizeof(hostname) - 1] = '\0';
+        fFriendlyName.SetToFormat("BeTon (%s)", hostname);
+    } else {
+        fFriendlyName = "BeTon";
+    }
+
+    fHttp->SetRequestHandler([this](const BString& method, const BString& target,
+                                    const BString& request,
+                                    LocalFileHttpServer::Response& response) {
+        return _HandleRequest(method, target, request, response);
+    });
+    fHttp->SetLibraryResolver([this](const BString& id) {
+        return _ResolveLibraryId(id);
+    });
+}
+
+/**
+ * @brief Stops advertising. The HTTP server must be stopped before, as its
+ * workers call into this object.
+ */
+DLNAMediaServer::~DLNAMediaServer()
+{
+    Stop();
+}
+
+status_t DLNAMediaServer::Start(DLNAService* ssdp)
+{
+    BString baseUrl = fHttp->BaseUrl();
+    if (ssdp == nullptr || baseUrl.IsEmpty())
+        return B_NO_INIT;
+
+    Stop();
+    BString location(baseUrl);
+    location << "/upnp/description.xml";
+    status_t status = ssdp->StartAdvertising(location, fUdn);
+    if (status == B_OK)
+        fSsdp = ssdp;
+    DEBUG_PRINT("DLNA media server at %s: %s\n", location.String(), strerror(status));
+    return status;
+}
+
+void DLNAMediaServer::Stop()
+{
+    if (fSsdp != nullptr) {
+        fSsdp->StopAdvertising();
+        fSsdp = nullptr;
+    }
+}
+
+/**
+ * @brief Builds the View of `snapshot` from its facet index.
+ *
+ * The facet cells are already sorted by genre, artist and album, so only
+ * the tracks of each album are sorted, by disc and number. Albums and
+ * artists that span several genres are merged and sorted again.
+ */
+void DLNAMediaServer::Publish(LibrarySnapshot* snapshot,
+                              const LibraryFacetIndex& facets)
+{
+    bigtime_t start = system_time();
+    BReference<View> view(new View, true);
+    view->snapshot.SetTo(snapshot);
+
+    if (snapshot != nullptr && facets.Count() == snapshot->Items().size()) {
+        const std::vector<MediaItem>& items = snapshot->Items();
+        auto byNumber = [&items](uint32 a, uint32 b) {
+            const MediaItem& x = items[a];
+            const MediaItem& y = items[b];
+            if (x.disc != y.disc)
+                return x.disc < y.disc;
+            if (x.track != y.track)
+                return x.track < y.track;
+            return a < b;
+        };
+
+        typedef std::map<LibraryFacetIndex::AlbumKey, std::vector<uint32>> AlbumTracks;
+        std::map<LibraryFacetIndex::AlbumKey, Container> albums;
+        std::map<BString, AlbumTracks> artists;
+
+        for (const auto& genre : facets.Genres()) {
+            Container genreContainer;
+            genreContainer.title = genre.first.IsEmpty()
+                ? BString(B_TRANSLATE("Unknown genre")) : genre.first;
+
+            for (const auto& artist : genre.second) {
+                AlbumTracks& artistAlbums = artists[artist.first];
+                for (const auto& album : artist.second) {
+                    std::vector<uint32> tracks(album.second);
+                    std::sort(tracks.begin(), tracks.end(), byNumber);
+                    genreContainer.tracks.insert(genreContainer.tracks.end(),
+                                                 tracks.begin(), tracks.end());
+
+                    std::vector<uint32>& artistTracks = artistAlbums[album.first];
+                    artistTracks.insert(artistTracks.end(), tracks.begin(), tracks.end());
+
+                    Container& albumContainer = albums[album.first];
+                    if (albumContainer.tracks.empty()) {
+                        albumContainer.title = album.first.album.IsEmpty()
+                            ? BString(B_TRANSLATE("Unknown album")) : album.first.album;
+                        albumContainer.artist = artist.first;
+                    } else if (albumContainer.artist != artist.first) {
+                        albumContainer.artist = B_TRANSLATE("Various artists");
+                    }
+                    albumContainer.tracks.insert(albumContainer.tracks.end(),
+                                                 tracks.begin(), tracks.end());
+                }
+            }
+            view->genres.push_back(std::move(genreContainer));
+        }
+
+        view->albums.reserve(albums.size());
+        for (auto& album : albums) {
+            std::vector<uint32>& tracks = album.second.tracks;
+            if (!std::is_sorted(tracks.begin(), tracks.end(), byNumber))
+                std::sort(tracks.begin(), tracks.end(), byNumber);
+            view->albums.push_back(std::move(album.second));
+        }
+
+        view->artists.reserve(artists.size());
+        view->tracks.reserve(items.size());
+        for (auto& artist : artists) {
+            Container artistContainer;
+            artistContainer.title = artist.first.IsEmpty()
+                ? BString(B_TRANSLATE("Unknown artist")) : artist.first;
+            for (auto& album : artist.second) {
+                std::vector<uint32>& tracks = album.second;
+                if (!std::is_sorted(tracks.begin(), tracks.end(), byNumber))
+                    std::sort(tracks.begin(), tracks.end(), byNumber);
+                artistContainer.tracks.insert(artistContainer.tracks.end(),
+                                              tracks.begin(), tracks.end());
+            }
+            view->tracks.insert(view->tracks.end(), artistContainer.tracks.begin(),
+                                artistContainer.tracks.end());
+            view->artists.push_back(std::move(artistContainer));
+        }
+    }
+
+    BAutolock lock(fViewLock);
+    view->updateId = ++fSystemUpdateId;
+    fView = view;
+    fLastSearchView.Unset();
+    fLastSearchResults.clear();
+    DEBUG_PRINT("DLNA media server: %zu tracks published in %lld us\n",
+                view->tracks.size(), (long long)(system_time() - start));
+}
+
+BReference<DLNAMediaServer::View> DLNAMediaServer::_CurrentView()
+{
+    BAutolock lock(fViewLock);
+    return fView;
+}
+
+bool DLNAMediaServer::_HandleRequest(const BString& method, const BString& target,
+                                     const BString& request,
+                                     LocalFileHttpServer::Response& response)
+{
+    if (method == "GET") {
+        if (target == "description.xml")
+            response.body = _DeviceDescription();
+        else if (target == "cds.xml")
+            response.body = ContentDirectoryScpd();
+        else if (target == "cms.xml")
+            response.body = ConnectionManagerScpd();
+        else
+            return false;
+        return true;
+    }
+
+    if (method == "POST") {
+        if (target == "cds/control")
+            return _Control(kContentDirectoryUrn, request, response);
+        if (target == "cms/control")
+            return _Control(kConnectionManagerUrn, request, response);
+        return false;
+    }
+
+    /// Some control points give up on a server they cannot subscribe to;
+    /// the subscription is granted, but no events follow.
+    if (method == "SUBSCRIBE" && target.EndsWith("/event")) {
+        BString sid = LocalFileHttpServer::HeaderValue(request, "SID");
+        if (sid.IsEmpty()) {
+            std::random_device random;
+            sid.SetToFormat("uuid:%08x-%08x", (unsigned)random(), (unsigned)random());
+        }
+        response.headers << "SID: " << sid << "\r\n"
+                         << "TIMEOUT: Second-1800\r\n";
+        return true;
+    }
+    if (method == "UNSUBSCRIBE" && target.EndsWith("/event"))
+        return true;
+
+    return false;
+}
+
+/**
+ * @brief Path of a library URL id, "<position>-<inode>", in the current
+ * View; empty if that position now holds another file.
+ */
+BString DLNAMediaServer::_ResolveLibraryId(const BString& id)
+{
+    unsigned int position;
+    unsigned long long inode;
+    if (sscanf(id.String(), "%u-%llx", &position, &inode) != 2)
+        return "";
+
+    BReference<View> view = _CurrentView();
+    if (!view->snapshot.IsSet() || position >= view->snapshot->Items().size())
+        return "";
+    const MediaItem& item = view->snapshot->Items()[position];
+    if ((unsigned long long)item.inode != inode)
+        return "";
+    return item.path;
+}
+
+BString DLNAMediaServer::_DeviceDescription() const
+{
+    BString xml;
+    xml << "<?xml version=\"1.0\" encoding=\"utf-8\"?>"
+        << "<root xmlns=\"urn:schemas-upnp-org:device-1-0\""
+        << " xmlns:dlna=\"urn:schemas-dlna-org:device-1-0\">"
+        << "<specVersion><major>1</major><minor>0</minor></specVersion>"
+        << "<device>"
+        << "<deviceType>urn:schemas-upnp-org:device:MediaServer:1</deviceType>"
+        << "<dlna:X_DLNADOC>DMS-1.50</dlna:X_DLNADOC>"
+        << "<friendlyName>" << _EscapeXml(fFriendlyName) << "</friendlyName>"
+        << "<manufacturer>BeTon</manufacturer>"
+        << "<modelName>BeTon</modelName>"
+        << "<UDN>" << fUdn << "</UDN>"
+        << "<serviceList>"
+        << "<service><serviceType>" << kContentDirectoryUrn << "</serviceType>"
+        << "<serviceId>urn:upnp-org:serviceId:ContentDirectory</serviceId>"
+        << "<SCPDURL>/upnp/cds.xml</SCPDURL>"
+        << "<controlURL>/upnp/cds/control</controlURL>"
+        << "<eventSubURL>/upnp/cds/event</eventSubURL></service>"
+        << "<service><serviceType>" << kConnectionManagerUrn << "</serviceType>"
+        << "<serviceId>urn:upnp-org:serviceId:ConnectionManager</serviceId>"
+        << "<SCPDURL>/upnp/cms.xml</SCPDURL>"
+        << "<controlURL>/upnp/cms/control</controlURL>"
+        << "<eventSubURL>/upnp/cms/event</eventSubURL></service>"
+        << "</serviceList></device></root>";
+    return xml;
+}
+
+/**
+ * @brief Answers a SOAP action of `service`.
+ */
+bool DLNAMediaServer::_Control(const BString& service, const BString& request,
+                               LocalFileHttpServer::Response& response)
+{
+    BString soapAction = LocalFileHttpServer::HeaderValue(request, "SOAPACTION");
+    soapAction.RemoveAll("\"");
+    int32 hash = soapAction.FindLast('#');
+    BString action;
+    if (hash >= 0)
+        soapAction.CopyInto(action, hash + 1, soapAction.Length() - hash - 1);
+    TraceScope<kTraceDlna> trace(
+        Trace::IsEnabled() ? Trace::Intern(action.String()) : "");
+
+    BString arguments;
+    if (service == kContentDirectoryUrn) {
+        if (action == "Browse" || action == "Search") {
+            int32 error = action == "Browse"
+                ? _Browse(request, arguments) : _Search(request, arguments);
+            if (error != 0) {
+                _SoapFault(error, error == 701 ? "No such object"
+                                  : error == 708 ? "Unsupported or invalid search criteria"
+                                  : "Invalid Args", response);
+                return true;
+            }
+        } else if (action == "GetSearchCapabilities") {
+            arguments << "<SearchCaps>" << kSearchCapabilities << "</SearchCaps>";
+        } else if (action == "GetSortCapabilities") {
+            arguments << "<SortCaps></SortCaps>";
+        } else if (action == "GetSystemUpdateID") {
+            BAutolock lock(fViewLock);
+            arguments << "<Id>" << fSystemUpdateId << "</Id>";
+        } else {
+            _SoapFault(401, "Invalid Action", response);
+            return true;
+        }
+    } else {
+        if (action == "GetProtocolInfo") {
+            arguments << "<Source>" << kSourceProtocolInfo << "</Source><Sink></Sink>";
+        } else if (action == "GetCurrentConnectionIDs") {
+            arguments << "<ConnectionIDs>0</ConnectionIDs>";
+        } else if (action == "GetCurrentConnectionInfo") {
+            arguments << "<RcsID>-1</RcsID><AVTransportID>-1</AVTransportID>"
+                      << "<ProtocolInfo></ProtocolInfo>"
+                      << "<PeerConnectionManager></PeerConnectionManager>"
+                      << "<PeerConnectionID>-1</PeerConnectionID>"
+                      << "<Direction>Output</Direction><Status>OK</Status>";
+        } else {
+            _SoapFault(401, "Invalid Action", response);
+            return true;
+        }
+    }
+
+    _SoapResponse(service, action, arguments, response);
+    return true;
+}
+
+/**
+ * @brief Answers Browse from the current View.
+ * @return 0, or the UPnP error code to fault with.
+ */
+int32 DLNAMediaServer::_Browse(const BString& request, BString& result)
+{
+    BReference<View> view = _CurrentView();
+    Object object;
+    if (!_ParseObjectId(*view, _Argument(request, "ObjectID"), object))
+        return 701;
+
+    BString flag = _Argument(request, "BrowseFlag");
+    uint32 start = strtoul(_Argument(request, "StartingIndex").String(), nullptr, 10);
+    uint32 count = strtoul(_Argument(request, "RequestedCount").String(), nullptr, 10);
+    if (count == 0 || count > kMaxPageSize)
+        count = kMaxPageSize;
+
+    BString didl(kDidlHeader);
+    uint32 returned = 0;
+    uint32 total = 0;
+    if (flag == "BrowseMetadata") {
+        _AppendObject(*view, object, didl);
+        returned = total = 1;
+    } else if (flag == "BrowseDirectChildren") {
+        total = _ChildCount(*view, object);
+        for (uint32 i = start; i < total && returned < count; i++, returned++)
+            _AppendObject(*view, _Child(*view, object, i), didl);
+    } else {
+        return 402;
+    }
+    didl << "</DIDL-Lite>";
+
+    result << "<Result>" << _EscapeXml(didl) << "</Result>"
+           << "<NumberReturned>" << returned << "</NumberReturned>"
+           << "<TotalMatches>" << total << "</TotalMatches>"
+           << "<UpdateID>" << view->updateId << "</UpdateID>";
+    return 0;
+}
+
+/**
+ * @brief Answers Search over the whole library; ContainerID is only
+ * checked to exist.
+ * @return 0, or the UPnP error code to fault with.
+ */
+int32 DLNAMediaServer::_Search(const BString& request, BString& result)
+{
+    BReference<View> view = _CurrentView();
+    Object container;
+    if (!_ParseObjectId(*view, _Argument(request, "ContainerID"), container))
+        return 701;
+
+    BString criteria = _Argument(request, "SearchCriteria");
+    char kind;
+    std::vector<SearchTerm> terms;
+    bool anyTerm;
+    if (!_ParseCriteria(criteria, kind, terms, anyTerm))
+        return 708;
+
+    uint32 start = strtoul(_Argument(request, "StartingIndex").String(), nullptr, 10);
+    uint32 count = strtoul(_Argument(request, "RequestedCount").String(), nullptr, 10);
+    if (count == 0 || count > kMaxPageSize)
+        count = kMaxPageSize;
+
+    /// Control points page through one search; the matches are kept for
+    /// the pages after the first.
+    std::vector<uint32> page;
+    uint32 total = 0;
+    bool cached = false;
+    {
+        BAutolock lock(fViewLock);
+        if (fLastSearchView.Get() == view.Get() && fLastSearchCriteria == criteria) {
+            total = fLastSearchResults.size();
+            for (uint32 i = start; i < total && page.size() < count; i++)
+                page.push_back(fLastSearchResults[i]);
+            cached = true;
+        }
+    }
+
+    if (!cached) {
+        std::vector<uint32> matches;
+        if (kind == 't') {
+            _SearchTracks(*view, terms, anyTerm, matches);
+        } else {
+            const std::vector<Container>* list = _ContainerList(*view, kind);
+            for (uint32 i = 0; i < list->size(); i++) {
+                const Container& entry = (*list)[i];
+                bool matched = !anyTerm;
+                for (const SearchTerm& term : terms) {
+                    const BString& field = term.property == "upnp:artist"
+                            || term.property == "dc:creator"
+                        ? (kind == 'L' ? entry.artist : entry.title) : entry.title;
+                    std::string folded = LibrarySearchIndex::Fold(field.String());
+                    bool match = term.exact ? folded == term.folded
+                        : folded.find(term.folded) != std::string::npos;
+                    if (match == anyTerm) {
+                        matched = anyTerm;
+                        break;
+                    }
+                }
+                if (matched)
+                    matches.push_back(i);
+            }
+        }
+
+        total = matches.size();
+        for (uint32 i = start; i < total && page.size() < count; i++)
+            page.push_back(matches[i]);
+
+        BAutolock lock(fViewLock);
+        if (fView.Get() == view.Get()) {
+            fLastSearchView = view;
+            fLastSearchCriteria = criteria;
+            fLastSearchResults.swap(matches);
+        }
+    }
+
+    BString didl(kDidlHeader);
+    for (uint32 entry : page) {
+        Object object;
+        if (kind == 't') {
+            object.kind = 't';
+            object.parentKind = 'T';
+            object.position = entry;
+        } else {
+            object.kind = kind;
+            object.index = entry;
+        }
+        _AppendObject(*view, object, didl);
+    }
+    didl << "</DIDL-Lite>";
+
+    result << "<Result>" << _EscapeXml(didl) << "</Result>"
+           << "<NumberReturned>" << (uint32)page.size() << "</NumberReturned>"
+           << "<TotalMatches>" << total << "</TotalMatches>"
+           << "<UpdateID>" << view->updateId << "</UpdateID>";
+    return 0;
+}
+
+/**
+ * @brief Collects the tracks matching `terms`.
+ *
+ * Candidates come from the search index when it covers the snapshot and a
+ * term is on an indexed field; otherwise all tracks are checked.
+ */
+void DLNAMediaServer::_SearchTracks(const View& view,
+                                    const std::vector<SearchTerm>& terms,
+                                    bool anyTerm, std::vector<uint32>& positions) const
+{
+    positions.clear();
+    if (terms.empty()) {
+        positions = view.tracks;
+        return;
+    }
+    if (!view.snapshot.IsSet())
+        return;
+    const std::vector<MediaItem>& items = view.snapshot->Items();
+
+    /// The index holds title, artist and album text; genre is not in it.
+    const SearchTerm* seed = nullptr;
+    if (!anyTerm) {
+        for (const SearchTerm& term : terms) {
+            if (term.property != "upnp:genre"
+                && (seed == nullptr || term.folded.size() > seed->folded.size()))
+                seed = &term;
+        }
+    }
+
+    std::vector<uint32> candidates;
+    bool indexed = false;
+    if (seed != nullptr && fSearchIndex != nullptr && fIndexLock != nullptr) {
+        BAutolock lock(fIndexLock);
+        if (fSearchIndex->Count() == items.size()) {
+            fSearchIndex->Search(seed->value, candidates);
+            indexed = true;
+        }
+    }
+
+    const std::vector<uint32>& source = indexed ? candidates : view.tracks;
+    for (uint32 position : source) {
+        if (position < items.size() && _Matches(items[position], terms, anyTerm))
+            positions.push_back(position);
+    }
+}
+
+bool DLNAMediaServer::_Matches(const MediaItem& item,
+                               const std::vector<SearchTerm>& terms, bool anyTerm)
+{
+    for (const SearchTerm& term : terms) {
+        const BString* fields[2] = { nullptr, nullptr };
+        if (term.property == "dc:title") {
+            fields[0] = &item.title;
+        } else if (term.property == "upnp:artist" || term.property == "dc:creator") {
+            fields[0] = &item.artist;
+            fields[1] = &item.albumArtist;
+        } else if (term.property == "upnp:album") {
+            fields[0] = &item.album;
+        } else if (term.property == "upnp:genre") {
+            fields[0] = &item.genre;
+        }
+
+        bool match = false;
+        for (const BString* field : fields) {
+            if (field == nullptr)
+                continue;
+            std::string folded = LibrarySearchIndex::Fold(field->String());
+            if (term.exact ? folded == term.folded
+                           : folded.find(term.folded) != std::string::npos) {
+                match = true;
+                break;
+            }
+        }
+        if (match == anyTerm)
+            return anyTerm;
+    }
+    return !anyTerm;
+}
+
+/**
+ * @brief Reads the subset of SearchCriteria control points send.
+ *
+ * `upnp:class` clauses pick what is searched: tracks, albums, artists or
+ * genres, tracks when several are asked for. "contains" and "=" clauses on
+ * dc:title, dc:creator, upnp:artist, upnp:album and upnp:genre must all
+ * match, or any of them if they are joined with "or". "exists" clauses and
+ * other properties are ignored.
+ *
+ * @param kind Set to 't', 'L', 'A' or 'G'.
+ * @return False for criteria that cannot be parsed.
+ */
+bool DLNAMediaServer::_ParseCriteria(const BString& criteria, char& kind,
+                                     std::vector<SearchTerm>& terms, bool& anyTerm)
+{
+    kind = 't';
+    terms.clear();
+    anyTerm = false;
+
+    BString trimmed(criteria);
+    trimmed.Trim();
+    if (trimmed.IsEmpty() || trimmed == "*")
+        return true;
+
+    const char* p = trimmed.String();
+    auto skipSpace = [&p]() {
+        while (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n'
+               || *p == '(' || *p == ')')
+            p++;
+    };
+    auto readWord = [&p, &skipSpace]() {
+        skipSpace();
+        const char* start = p;
+        while (*p != '\0' && *p != ' ' && *p != '\t' && *p != '\r' && *p != '\n'
+               && *p != '(' && *p != ')' && *p != '"')
+            p++;
+        return BString(start, p - start);
+    };
+
+    bool tracks = false;
+    char containerKind = 0;
+    BString connector;
+    for (;;) {
+        BString property = readWord();
+        if (property.IsEmpty())
+            break;
+        if (property.ICompare("and") == 0 || property.ICompare("or") == 0) {
+            connector = property;
+            connector.ToLower();
+            continue;
+        }
+
+        BString op = readWord();
+        if (op == "exists") {
+            readWord();
+            continue;
+        }
+
+        skipSpace();
+        if (*p != '"')
+            return false;
+        p++;
+        BString value;
+        while (*p != '\0' && *p != '"') {
+            if (*p == '\\' && p[1] != '\0')
+                p++;
+            value.Append(p, 1);
+            p++;
+        }
+        if (*p != '"')
+            return false;
+        p++;
+
+        if (property == "upnp:class") {
+            if (value.StartsWith("object.item"))
+                tracks = true;
+            else if (value.StartsWith("object.container.album") && containerKind == 0)
+                containerKind = 'L';
+            else if (value.StartsWith("object.container.person") && containerKind == 0)
+                containerKind = 'A';
+            else if (value.StartsWith("object.container.genre") && containerKind == 0)
+                containerKind = 'G';
+            connector = "";
+            continue;
+        }
+        if (op != "contains" && op != "=" && op != "derivedfrom")
+            return false;
+        if (property.StartsWith("@")) {
+            connector = "";
+            continue;
+        }
+
+        if (!terms.empty() && connector == "or")
+            anyTerm = true;
+        connector = "";
+
+        SearchTerm term;
+        term.property = property;
+        term.value = value;
+        term.folded = LibrarySearchIndex::Fold(value.String());
+        term.exact = op == "=";
+        terms.push_back(term);
+    }
+
+    if (!tracks && containerKind != 0)
+        kind = containerKind;
+    return true;
+}
+
+const std::vector<DLNAMediaServer::Container>*
+DLNAMediaServer::_ContainerList(const View& view, char kind) const
+{
+    switch (kind) {
+        case 'A': return &view.artists;
+        case 'L': return &view.albums;
+        case 'G': return &view.genres;
+        default: return nullptr;
+    }
+}
+
+/**
+ * @brief Reads an object ID of the View, see the class description.
+ * @return False for IDs the View does not hold.
+ */
+bool DLNAMediaServer::_ParseObjectId(const View& view, const BString& id,
+                                     Object& object) const
+{
+    object = Object();
+    if (id == "0") {
+        object.kind = '0';
+        return true;
+    }
+    if (id.IsEmpty())
+        return false;
+
+    const char kind = id.ByteAt(0);
+    if (kind != 'A' && kind != 'L' && kind != 'G' && kind != 'T')
+        return false;
+
+    const char* rest = id.String() + 1;
+    char* end = nullptr;
+    if (*rest != '\0' && *rest != ':') {
+        if (kind == 'T')
+            return false;
+        unsigned long index = strtoul(rest, &end, 10);
+        if (end == rest || index >= _ContainerList(view, kind)->size())
+            return false;
+        object.index = (int32)index;
+        rest = end;
+    }
+
+    if (*rest == '\0') {
+        object.kind = kind;
+        return true;
+    }
+    if (*rest != ':' || !view.snapshot.IsSet())
+        return false;
+
+    unsigned long position = strtoul(rest + 1, &end, 10);
+    if (end == rest + 1 || *end != '\0' || position >= view.snapshot->Items().size())
+        return false;
+    object.kind = 't';
+    object.parentKind = kind;
+    object.position = (uint32)position;
+    return true;
+}
+
+uint32 DLNAMediaServer::_ChildCount(const View& view, const Object& object) const
+{
+    switch (object.kind) {
+        case '0':
+            return 4;
+        case 'T':
+            return view.tracks.size();
+        case 'A':
+        case 'L':
+        case 'G': {
+            const std::vector<Container>* list = _ContainerList(view, object.kind);
+            return object.index < 0 ? list->size() : (*list)[object.index].tracks.size();
+        }
+        default:
+            return 0;
+    }
+}
+
+DLNAMediaServer::Object DLNAMediaServer::_Child(const View& view,
+                                                const Object& parent,
+                                                uint32 index) const
+{
+    Object child;
+    if (parent.kind == '0') {
+        child.kind = "ALGT"[index];
+    } else if (parent.kind == 'T') {
+        child.kind = 't';
+        child.parentKind = 'T';
+        child.position = view.tracks[index];
+    } else if (parent.index < 0) {
+        child.kind = parent.kind;
+        child.index = index;
+    } else {
+        child.kind = 't';
+        child.parentKind = parent.kind;
+        child.index = parent.index;
+        child.position = (*_ContainerList(view, parent.kind))[parent.index].tracks[index];
+    }
+    return child;
+}
+
+BString DLNAMediaServer::_ObjectId(const Object& object) const
+{
+    BString id;
+    if (object.kind == '0') {
+        id = "0";
+    } else if (object.kind == 't') {
+        Object parent;
+        parent.kind = object.parentKind;
+        parent.index = object.index;
+        id << _ObjectId(parent) << ":" << object.position;
+    } else {
+        id << object.kind;
+        if (object.index >= 0)
+            id << object.index;
+    }
+    return id;
+}
+
+BString DLNAMediaServer::_ParentId(const Object& object) const
+{
+    switch (object.kind) {
+        case '0':
+            return "-1";
+        case 't': {
+            Object parent;
+            parent.kind = object.parentKind;
+            parent.index = object.index;
+            return _ObjectId(parent);
+        }
+        default:
+            if (object.index < 0)
+                return "0";
+            return BString() << object.kind;
+    }
+}
+
+void DLNAMediaServer::_AppendObject(const View& view, const Object& object,
+                                    BString& didl) const
+{
+    if (object.kind == 't')
+        _AppendTrack(view, object, didl);
+    else
+        _AppendContainer(view, object, didl);
+}
+
+void DLNAMediaServer::_AppendContainer(const View& view, const Object& object,
+                                       BString& didl) const
+{
+    BString title;
+    BString artist;
+    const char* upnpClass = "object.container.storageFolder";
+    if (object.kind == '0') {
+        title = fFriendlyName;
+        upnpClass = "object.container";
+    } else if (object.index < 0) {
+        switch (object.kind) {
+            case 'A': title = B_TRANSLATE("Artists"); break;
+            case 'L': title = B_TRANSLATE("Albums"); break;
+            case 'G': title = B_TRANSLATE("Genres"); break;
+            default: title = B_TRANSLATE("All tracks"); break;
+        }
+    } else {
+        const Container& entry = (*_ContainerList(view, object.kind))[object.index];
+        title = entry.title;
+        artist = entry.artist;
+        upnpClass = object.kind == 'A' ? "object.container.person.musicArtist"
+            : object.kind == 'L' ? "object.container.album.musicAlbum"
+            : "object.container.genre.musicGenre";
+    }
+
+    didl << "<container id=\"" << _EscapeXml(_ObjectId(object))
+         << "\" parentID=\"" << _EscapeXml(_ParentId(object))
+         << "\" restricted=\"1\" searchable=\"1\" childCount=\""
+         << _ChildCount(view, object) << "\">"
+         << "<dc:title>" << _EscapeXml(title) << "</dc:title>";
+    if (!artist.IsEmpty()) {
+        didl << "<dc:creator>" << _EscapeXml(artist) << "</dc:creator>"
+             << "<upnp:artist>" << _EscapeXml(artist) << "</upnp:artist>";
+    }
+    didl << "<upnp:class>" << upnpClass << "</upnp:class></container>";
+}
+
+void DLNAMediaServer::_AppendTrack(const View& view, const Object& object,
+                                   BString& didl) const
+{
+    const MediaItem& item = view.snapshot->Items()[object.position];
+
+    BString name(item.path);
+    int32 slash = name.FindLast('/');
+    if (slash >= 0)
+        name.Remove(0, slash + 1);
+
+    BString libraryId;
+    libraryId.SetToFormat("%u-%llx", (unsigned int)object.position,
+                          (unsigned long long)item.inode);
+    const char* mimeType = LocalFileHttpServer::MimeTypeForPath(item.path);
+
+    didl << "<item id=\"" << _EscapeXml(_ObjectId(object))
+         << "\" parentID=\"" << _EscapeXml(_ParentId(object))
+         << "\" restricted=\"1\">"
+         << "<dc:title>" << _EscapeXml(item.title.IsEmpty() ? name : item.title)
+         << "</dc:title>";
+    if (!item.artist.IsEmpty()) {
+        didl << "<dc:creator>" << _EscapeXml(item.artist) << "</dc:creator>"
+             << "<upnp:artist>" << _EscapeXml(item.artist) << "</upnp:artist>";
+    }
+    if (!item.albumArtist.IsEmpty()) {
+        didl << "<upnp:artist role=\"AlbumArtist\">" << _EscapeXml(item.albumArtist)
+             << "</upnp:artist>";
+    }
+    if (!item.album.IsEmpty())
+        didl << "<upnp:album>" << _EscapeXml(item.album) << "</upnp:album>";
+    if (!item.genre.IsEmpty())
+        didl << "<upnp:genre>" << _EscapeXml(item.genre) << "</upnp:genre>";
+    if (item.track > 0)
+        didl << "<upnp:originalTrackNumber>" << item.track << "</upnp:originalTrackNumber>";
+    if (item.year > 0)
+        didl << "<dc:date>" << item.year << "-01-01</dc:date>";
+    didl << "<upnp:class>object.item.audioItem.musicTrack</upnp:class>";
+
+    BString duration = DidlDuration(item.duration);
+    didl << "<res protocolInfo=\"http-get:*:" << mimeType << ":DLNA.ORG_OP=01\"";
+    if (item.size > 0)
+        didl << " size=\"" << item.size << "\"";
+    if (item.duration > 0)
+        didl << " duration=\"" << duration << "\"";
+    if (item.bitrate > 0)
+        didl << " bitrate=\"" << item.bitrate * 125 << "\""; ///< Bytes per second
+    if (item.sampleRate > 0)
+        didl << " sampleFrequency=\"" << item.sampleRate << "\"";
+    if (item.channels > 0)
+        didl << " nrAudioChannels=\"" << item.channels << "\"";
+    didl << ">" << _EscapeXml(fHttp->LibraryUrl(libraryId, name,
+                                                 TranscodeCache::kPassThrough))
+         << "</res>";
+
+    /// Clients that cannot play the original pick the MP3; ranges into a
+    /// running transcode would wait for all of it, so none are offered.
+    if (strcmp(mimeType, "audio/mpeg") != 0) {
+        didl << "<res protocolInfo=\"http-get:*:audio/mpeg:DLNA.ORG_PN=MP3;DLNA.ORG_OP=00\"";
+        if (item.duration > 0)
+            didl << " duration=\"" << duration << "\"";
+        didl << " bitrate=\"40000\" sampleFrequency=\"44100\" nrAudioChannels=\"2\">"
+             << _EscapeXml(fHttp->LibraryUrl(libraryId, name, TranscodeCache::kMp3))
+             << "</res>";
+    }
+    didl << "</item>";
+}
+
+/**
+ * @brief Unescaped text of the SOAP argument `name`; empty if absent.
+ */
+BString DLNAMediaServer::_Argument(const BString& request, const char* name)
+{
+    BString open;
+    open << "<" << name << ">";
+    int32 start = request.FindFirst(open);
+    if (start < 0)
+        return "";
+    start += open.Length();
+
+    BString close;
+    close << "</" << name << ">";
+    int32 end = request.FindFirst(close, start);
+    if (end < 0)
+        return "";
+
+    BString value;
+    request.CopyInto(value, start, end - start);
+    value.ReplaceAll("&lt;", "<");
+    value.ReplaceAll("&gt;", ">");
+    value.ReplaceAll("&quot;", "\"");
+    value.ReplaceAll("&apos;", "'");
+    value.ReplaceAll("&amp;", "&");
+    value.Trim();
+    return value;
+}
+
+BString DLNAMediaServer::_EscapeXml(const BString& text)
+{
+    BString escaped(text);
+    escaped.ReplaceAll("&", "&amp;");
+    escaped.ReplaceAll("<", "&lt;");
+    escaped.ReplaceAll(">", "&gt;");
+    escaped.ReplaceAll("\"", "&quot;");
+    escaped.ReplaceAll("'", "&apos;");
+    return escaped;
+}
+
+void DLNAMediaServer::_SoapResponse(const BString& service, const BString& action,
+                                    const BString& arguments,
+                                    LocalFileHttpServer::Response& response)
+{
+    response.body.SetTo("");
+    response.body
+        << "<?xml version=\"1.0\" encoding=\"utf-8\"?>"
+        << "<s:Envelope xmlns:s=\"http://schemas.xmlsoap.org/soap/envelope/\""
+        << " s:encodingStyle=\"http://schemas.xmlsoap.org/soap/encoding/\">"
+        << "<s:Body><u:" << action << "Response xmlns:u=\"" << service << "\">"
+        << arguments
+        << "</u:" << action << "Response></s:Body></s:Envelope>";
+    response.headers << "EXT:\r\n";
+}
+
+void DLNAMediaServer::_SoapFault(int32 code, const char* description,
+                                 LocalFileHttpServer::Response& response)
+{
+    response.status = "500 Internal Server Error";
+    response.body.SetTo("");
+    response.body
+        << "<?xml version=\"1.0\" encoding=\"utf-8\"?>"
+        << "<s:Envelope xmlns:s=\"http://schemas.xmlsoap.org/soap/envelope/\""
+        << " s:encodingStyle=\"http://schemas.xmlsoap.org/soap/encoding/\">"
+        << "<s:Body><s:Fault><faultcode>s:Client</faultcode>"
+        << "<faultstring>UPnPError</faultstring><detail>"
+        << "<UPnPError xmlns=\"urn:schemas-upnp-org:control-1-0\">"
+        << "<errorCode>" << code << "</errorCode>"
+        << "<errorDescription>" << description << "</errorDescription>"
+        << "</UPnPError></detail></s:Fault></s:Body></s:Envelope>";
+}
+
+/**
+ * @brief The device UDN from settings/BeTon/dlna_server, created on first
+ * use so control points recognize the server across runs.
+ */
+BString DLNAMediaServer::_LoadUdn()
+{
+    BPath path;
+    find_directory(B_USER_SETTINGS_DIRECTORY, &path);
+    path.Append("BeTon");
+    create_directory(path.Path(), 0755);
+    path.Append("dlna_server");
+
+    BMessage settings;
+    BString udn;
+    BFile file(path.Path(), B_READ_ONLY);
+    if (file.InitCheck() == B_OK && settings.Unflatten(&file) == B_OK
+        && settings.FindString("udn", &udn) == B_OK && udn.StartsWith("uuid:"))
+        return udn;
+
+    std::random_device random;
+    uint32 words[4];
+    for (uint32& word : words)
+        word = random();
+    udn.SetToFormat("uuid:%08x-%04x-%04x-%04x-%04x%08x", (unsigned)words[0],
+                    (unsigned)(words[1] >> 16), (unsigned)((words[1] & 0x0fff) | 0x4000),
+                    (unsigned)(((words[2] >> 16) & 0x3fff) | 0x8000),
+                    (unsigned)(words[2] & 0xffff), (unsigned)words[3]);
+
+    settings.MakeEmpty();
+    settings.AddString("udn", udn);
+    BFile out(path.Path(), B_WRITE_ONLY | B_CREATE_FILE | B_ERASE_FILE);
+    if (out.InitCheck() == B_OK)
+        settings.Flatten(&out);
+    return udn;
+}
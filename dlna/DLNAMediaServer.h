@@ -0,0 +1,176 @@
+#ifndef BETON_DLNA_MEDIA_SERVER_H
+#define BETON_DLNA_MEDIA_SERVER_H
+
+#include "LibraryFacetIndex.h"
+#include "LibrarySnapshot.h"
+#include "LocalFileHttpServer.h"
+
+#include <Locker.h>
+#include <Referenceable.h>
+#include <String.h>
+#include <SupportDefs.h>
+#include <string>
+#include <vector>
+
+class DLNAService;
+class LibrarySearchIndex;
+
+/**
+ * @class DLNAMediaServer
+ * @brief Offers the local library to the network as a UPnP MediaServer:1,
+ * with ContentDirectory:1 and ConnectionManager:1.
+ *
+ * The window publishes every library snapshot together with its facet
+ * index. Publish() turns them into a View: the artists, albums and genres
+ * with the positions of their tracks, in the order they are listed, and
+ * bumps the SystemUpdateID. A Browse slices a View, so a page costs
+ * O(page) whatever the size of the library. A Search takes its candidates
+ * from the window's LibrarySearchIndex and checks the asked properties
+ * against the snapshot; the matches of the last search are kept, so the
+ * pages after the first cost O(page) as well.
+ *
+ * Object IDs:
+ * - "0" is the root; "A", "L", "G" and "T" hold all artists, albums,
+ *   genres and tracks
+ * - "A<n>", "L<n>" and "G<n>" are the n-th artist, album and genre
+ * - "<container>:<position>" is the track at that snapshot position,
+ *   listed in that container
+ *
+ * Tracks are served by the LocalFileHttpServer under library URLs that
+ * carry the snapshot position and the inode of the file, from a mapping
+ * like any served file. Files other than MP3 are offered as MP3 from
+ * TranscodeCache as well, for clients that cannot play the original.
+ *
+ * SSDP announcements go through DLNAService. Subscriptions to the
+ * services are accepted, but no events are sent; clients see changes from
+ * the UpdateID of their next Browse.
+ *
+ * Publish() is called by the window; requests arrive on the HTTP server's
+ * worker threads.
+ */
+class DLNAMediaServer {
+public:
+    /**
+     * @param http Server the device is reached through; the handlers are
+     *        installed at once, so this is created before it starts.
+     * @param search The window's text index.
+     * @param indexLock Guards `search`.
+     */
+    DLNAMediaServer(LocalFileHttpServer* http, const LibrarySearchIndex* search,
+                    BLocker* indexLock);
+    ~DLNAMediaServer();
+
+    /**
+     * @brief Starts announcing the server; the HTTP server must be running.
+     */
+    status_t Start(DLNAService* ssdp);
+
+    /**
+     * @brief Says byebye; requests are still answered until the HTTP
+     * server stops.
+     */
+    void Stop();
+
+    /**
+     * @brief Serves `snapshot` from now on.
+     * @param facets Built from the items of `snapshot`; only read during
+     *        the call.
+     */
+    void Publish(LibrarySnapshot* snapshot, const LibraryFacetIndex& facets);
+
+    /** @brief "uuid:..." of the device, kept across runs. */
+    const BString& Udn() const { return fUdn; }
+
+    static const uint32 kMaxPageSize = 1000; ///< Children per Browse, when all are asked for
+
+private:
+    /** @brief Artist, album or genre listed by the server. */
+    struct Container {
+        BString title;
+        BString artist;               ///< Albums only
+        std::vector<uint32> tracks;   ///< Snapshot positions, in listing order
+    };
+
+    /** @brief Immutable listing of one snapshot. */
+    struct View : public BReferenceable {
+        BReference<LibrarySnapshot> snapshot;
+        std::vector<uint32> tracks;   ///< All tracks, by artist and album
+        std::vector<Container> artists;
+        std::vector<Container> albums;
+        std::vector<Container> genres;
+        uint32 updateId = 0;
+    };
+
+    /** @brief What an object ID names. */
+    struct Object {
+        char kind = 0;         ///< '0', 'A', 'L', 'G', 'T', or 't' for a track
+        char parentKind = 0;   ///< Tracks: the kind of the listing container
+        int32 index = -1;      ///< Artist, album or genre, -1 for a list
+        uint32 position = 0;   ///< Tracks: snapshot position
+    };
+
+    /** @brief A searched property and the text asked for. */
+    struct SearchTerm {
+        BString property;
+        BString value;
+        std::string folded;   ///< LibrarySearchIndex::Fold() of the value
+        bool exact = false;
+    };
+
+    bool _HandleRequest(const BString& method, const BString& target,
+                        const BString& request, LocalFileHttpServer::Response& response);
+    BString _ResolveLibraryId(const BString& id);
+
+    BString _DeviceDescription() const;
+    bool _Control(const BString& service, const BString& request,
+                  LocalFileHttpServer::Response& response);
+
+    int32 _Browse(const BString& request, BString& result);
+    int32 _Search(const BString& request, BString& result);
+
+    BReference<View> _CurrentView();
+    bool _ParseObjectId(const View& view, const BString& id, Object& object) const;
+    const std::vector<Container>* _ContainerList(const View& view, char kind) const;
+    uint32 _ChildCount(const View& view, const Object& object) const;
+    /** @brief Child `index` of a container object, as an object. */
+    Object _Child(const View& view, const Object& parent, uint32 index) const;
+
+    void _AppendObject(const View& view, const Object& object, BString& didl) const;
+    void _AppendContainer(const View& view, const Object& object, BString& didl) const;
+    void _AppendTrack(const View& view, const Object& object, BString& didl) const;
+    BString _ObjectId(const Object& object) const;
+    BString _ParentId(const Object& object) const;
+
+    static bool _ParseCriteria(const BString& criteria, char& kind,
+                               std::vector<SearchTerm>& terms, bool& anyTerm);
+    static bool _Matches(const MediaItem& item, const std::vector<SearchTerm>& terms,
+                         bool anyTerm);
+    void _SearchTracks(const View& view, const std::vector<SearchTerm>& terms,
+                       bool anyTerm, std::vector<uint32>& positions) const;
+
+    static BString _Argument(const BString& request, const char* name);
+    static BString _EscapeXml(const BString& text);
+    static void _SoapResponse(const BString& service, const BString& action,
+                              const BString& arguments,
+                              LocalFileHttpServer::Response& response);
+    static void _SoapFault(int32 code, const char* description,
+                           LocalFileHttpServer::Response& response);
+    static BString _LoadUdn();
+
+    LocalFileHttpServer* fHttp;
+    const LibrarySearchIndex* fSearchIndex;
+    BLocker* fIndexLock;
+    DLNAService* fSsdp;
+    BString fUdn;
+    BString fFriendlyName;
+
+    BLocker fViewLock;   ///< Guards the fields below
+    BReference<View> fView;
+    uint32 fSystemUpdateId;
+    /// Matches of the last Search, for the pages after the first.
+    BReference<View> fLastSearchView;
+    BString fLastSearchCriteria;
+    std::vector<uint32> fLastSearchResults;
+};
+
+#endif // BETON_DLNA_MEDIA_SERVER_H
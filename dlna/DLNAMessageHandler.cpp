@@ -78,12 +78,30 @@ bool DLNAMessageHandler::HandleMessage(BMessage *msg) {
     break;
   }
 
+  case MSG_DLNA_CRAWL_PAGE: {
+    if (fWindow->fDlnaController)
+      fWindow->fDlnaController->HandleCrawlPage(msg);
+    break;
+  }
+
+  case MSG_DLNA_CRAWL_REFRESH: {
+    if (fWindow->fDlnaController)
+      fWindow->fDlnaController->RefreshCrawlViews();
+    break;
+  }
+
   case MSG_DLNA_CRAWL_DONE: {
     if (fWindow->fDlnaController)
       fWindow->fDlnaController->HandleCrawlDone(msg);
     break;
   }
 
+  case MSG_DLNA_CONTENT_CHANGED: {
+    if (fWindow->fDlnaController)
+      fWindow->fDlnaController->HandleContentChanged(msg);
+    break;
+  }
+
   case MSG_DLNA_RESOURCE_UNAVAILABLE: {
     if (fWindow->fDlnaController)
       fWindow->fDlnaController->ShowResourceUnavailableAlert(msg);
@@ -1,11 +1,12 @@
 #include "DLNAService.h"
+#include "DLNACacheFile.h"
 #include "Debug.h"
+#include "DidlParser.h"
+#include "HttpConnectionPool.h"
 #include "Messages.h"
+#include "Trace.h"
 
-#include <UrlProtocolRoster.h>
-#include <private/netservices/HttpRequest.h>
-#include <private/netservices/HttpResult.h>
-#include <DataIO.h>
+#include <Autolock.h>
 #include <Directory.h>
 #include <File.h>
 #include <FindDirectory.h>
@@ -22,16 +23,23 @@
 #include <algorithm>
 #include <cerrno>
 #include <deque>
-#include <memory>
 #include <map>
 #include <set>
 #include <string>
 
-using namespace BPrivate::Network;
-
 static const char* kSsdpAddress = "239.255.255.250";
 static const uint16 kSsdpPort = 1900;
 
+/// Notification types announced for the local MediaServer; the UDN itself
+/// is announced as well.
+static const char* const kAdvertisedTypes[] = {
+    "upnp:rootdevice",
+    "urn:schemas-upnp-org:device:MediaServer:1",
+    "urn:schemas-upnp-org:service:ContentDirectory:1",
+    "urn:schemas-upnp-org:service:ConnectionManager:1"
+};
+static const int32 kAdvertisedTypeCount = 4;
+
 static BString
 _NormalizedDlnaDedupPart(const BString& value)
 {
@@ -79,16 +87,22 @@ DLNAService::DLNAService(BMessenger target)
       fDiscoveryMode(Manual),
       fDiscoveryThread(-1),
       fDiscoveryWakeSem(create_sem(0, "dlna_discovery_wake")),
-      fRunning(false)
+      fRunning(false),
+      fPositionPollWakeSem(create_sem(0, "dlna_poll_wake"))
 {
 }
 
 DLNAService::~DLNAService()
 {
+    UnsubscribeContentDirectory();
+    UnsubscribeRendererEvents();
     _StopPositionPolling();
     StopDiscovery();
+    StopAdvertising();
     if (fDiscoveryWakeSem >= 0)
         delete_sem(fDiscoveryWakeSem);
+    if (fPositionPollWakeSem >= 0)
+        delete_sem(fPositionPollWakeSem);
 }
 
 /**
@@ -105,6 +119,11 @@ void DLNAService::StartDiscovery()
         return;
     }
 
+    /// Devices known from earlier runs are listed right away, before the
+    /// thread owns fDevices; the first pass confirms or drops them.
+    if (!fDescriptionsLoaded)
+        _LoadDeviceCache();
+
     fRunning = true;
     fDiscoveryThread = spawn_thread(_DiscoveryThreadEntry, "dlna_discovery",
                                     B_LOW_PRIORITY, this);
@@ -206,6 +225,11 @@ void DLNAService::_DiscoveryLoop()
         }
 
         _PurgeStaleDevices();
+        if (fDescriptionsDirty)
+            _SaveDeviceCache();
+
+        /// Renew before the next pass could come too late.
+        _RenewSubscription(fContentEvents, 2 * kDiscoveryInterval);
 
         if (fRunning) {
             if (fDiscoveryWakeSem >= 0) {
@@ -266,7 +290,229 @@ void DLNAService::_SendMSearch(int sock)
 }
 
 /**
- * @brief Parses an SSDP response and fetches device description if new.
+ * @brief Returns the value of an SSDP header, empty if absent.
+ */
+BString DLNAService::_SsdpHeader(const BString& response, const char* name)
+{
+    BString key("\n");
+    key << name << ":";
+    int32 pos = response.IFindFirst(key);
+    if (pos < 0)
+        return BString();
+
+    int32 start = pos + key.Length();
+    int32 end = response.FindFirst("\n", start);
+    if (end < 0)
+        end = response.Length();
+    BString value;
+    response.CopyInto(value, start, end - start);
+    value.Trim();
+    return value;
+}
+
+/**
+ * @brief Starts the thread that announces the local MediaServer.
+ */
+status_t DLNAService::StartAdvertising(const BString& location, const BString& udn)
+{
+    StopAdvertising();
+
+    fAdvertisedLocation = location;
+    fAdvertisedUdn = udn;
+    /// A new BOOTID tells control points to drop what they cached of an
+    /// earlier run.
+    fAdvertisedBootId = (int32)real_time_clock();
+    fAdvertising = true;
+    fAdvertiseThread = spawn_thread(_AdvertiseThreadEntry, "dlna_advertise",
+                                    B_LOW_PRIORITY, this);
+    if (fAdvertiseThread < 0) {
+        fAdvertising = false;
+        return fAdvertiseThread;
+    }
+    resume_thread(fAdvertiseThread);
+    return B_OK;
+}
+
+/**
+ * @brief Stops the advertising thread, which says byebye on its way out.
+ */
+void DLNAService::StopAdvertising()
+{
+    fAdvertising = false;
+    if (fAdvertiseThread >= 0) {
+        status_t exit;
+        wait_for_thread(fAdvertiseThread, &exit);
+        fAdvertiseThread = -1;
+    }
+}
+
+int32 DLNAService::_AdvertiseThreadEntry(void* arg)
+{
+    static_cast<DLNAService*>(arg)->_AdvertiseLoop();
+    return 0;
+}
+
+/**
+ * @brief Listens on the SSDP port for searches and re-announces the server
+ * every kAdvertiseInterval.
+ */
+void DLNAService::_AdvertiseLoop()
+{
+    int sock = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    if (sock < 0) {
+        DEBUG_PRINT("Failed to create SSDP advertise socket: %s\n", strerror(errno));
+        return;
+    }
+
+    /// Short timeouts, so StopAdvertising() does not wait long.
+    struct timeval tv;
+    tv.tv_sec = 1;
+    tv.tv_usec = 0;
+    setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+
+    int reuse = 1;
+    setsockopt(sock, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+#ifdef SO_REUSEPORT
+    setsockopt(sock, SOL_SOCKET, SO_REUSEPORT, &reuse, sizeof(reuse));
+#endif
+
+    int ttl = 4;
+    setsockopt(sock, IPPROTO_IP, IP_MULTICAST_TTL, &ttl, sizeof(ttl));
+
+    /// Searches are multicast to port 1900, so that is where we listen.
+    struct sockaddr_in local;
+    memset(&local, 0, sizeof(local));
+    local.sin_family = AF_INET;
+    local.sin_addr.s_addr = htonl(INADDR_ANY);
+    local.sin_port = htons(kSsdpPort);
+    if (bind(sock, (struct sockaddr*)&local, sizeof(local)) < 0)
+        DEBUG_PRINT("SSDP bind() failed: %s, only announcing\n", strerror(errno));
+
+    struct ip_mreq mreq;
+    mreq.imr_multiaddr.s_addr = inet_addr(kSsdpAddress);
+    mreq.imr_interface.s_addr = htonl(INADDR_ANY);
+    if (setsockopt(sock, IPPROTO_IP, IP_ADD_MEMBERSHIP, &mreq, sizeof(mreq)) < 0)
+        DEBUG_PRINT("Failed to join multicast group: %s\n", strerror(errno));
+
+    /// UDP may drop the first announcement; the second one is cheap.
+    _SendNotify(sock, "ssdp:alive");
+    _SendNotify(sock, "ssdp:alive");
+    bigtime_t nextNotify = system_time() + kAdvertiseInterval;
+
+    char buf[4096];
+    while (fAdvertising) {
+        struct sockaddr_in from;
+        socklen_t fromLen = sizeof(from);
+        ssize_t len = recvfrom(sock, buf, sizeof(buf) - 1, 0,
+                               (struct sockaddr*)&from, &fromLen);
+        if (len > 0) {
+            buf[len] = '\0';
+            BString request(buf, len);
+            if (request.StartsWith("M-SEARCH"))
+                _AnswerMSearch(sock, request, from);
+        }
+
+        if (system_time() >= nextNotify) {
+            _SendNotify(sock, "ssdp:alive");
+            nextNotify = system_time() + kAdvertiseInterval;
+        }
+    }
+
+    _SendNotify(sock, "ssdp:byebye");
+    close(sock);
+    DEBUG_PRINT("SSDP advertising ended\n");
+}
+
+BString DLNAService::_AdvertisedUsn(const BString& nt) const
+{
+    if (nt == fAdvertisedUdn)
+        return fAdvertisedUdn;
+    BString usn(fAdvertisedUdn);
+    usn << "::" << nt;
+    return usn;
+}
+
+void DLNAService::_SendNotify(int sock, const char* subtype)
+{
+    struct sockaddr_in dest;
+    memset(&dest, 0, sizeof(dest));
+    dest.sin_family = AF_INET;
+    dest.sin_port = htons(kSsdpPort);
+    dest.sin_addr.s_addr = inet_addr(kSsdpAddress);
+
+    const bool alive = strcmp(subtype, "ssdp:alive") == 0;
+    for (int32 i = -1; i < kAdvertisedTypeCount; i++) {
+        BString nt = i < 0 ? fAdvertisedUdn : BString(kAdvertisedTypes[i]);
+        BString notify;
+        notify << "NOTIFY * HTTP/1.1\r\n"
+               << "HOST: 239.255.255.250:1900\r\n"
+               << "NT: " << nt << "\r\n"
+               << "NTS: " << subtype << "\r\n"
+               << "USN: " << _AdvertisedUsn(nt) << "\r\n"
+               << "BOOTID.UPNP.ORG: " << fAdvertisedBootId << "\r\n"
+               << "CONFIGID.UPNP.ORG: 1\r\n";
+        if (alive) {
+            notify << "CACHE-CONTROL: max-age=" << kAdvertiseMaxAge << "\r\n"
+                   << "LOCATION: " << fAdvertisedLocation << "\r\n"
+                   << "SERVER: Haiku UPnP/1.0 BeTon/1.0\r\n";
+        }
+        notify << "\r\n";
+        sendto(sock, notify.String(), notify.Length(), 0,
+               (struct sockaddr*)&dest, sizeof(dest));
+    }
+}
+
+void DLNAService::_AnswerMSearch(int sock, const BString& request,
+                                 const struct sockaddr_in& from)
+{
+    if (_SsdpHeader(request, "MAN").IFindFirst("ssdp:discover") < 0)
+        return;
+
+    BString st = _SsdpHeader(request, "ST");
+    std::vector<BString> matches;
+    for (int32 i = -1; i < kAdvertisedTypeCount; i++) {
+        BString nt = i < 0 ? fAdvertisedUdn : BString(kAdvertisedTypes[i]);
+        if (st == "ssdp:all" || st.ICompare(nt) == 0)
+            matches.push_back(nt);
+    }
+
+    for (const BString& nt : matches) {
+        BString response;
+        response << "HTTP/1.1 200 OK\r\n"
+                 << "CACHE-CONTROL: max-age=" << kAdvertiseMaxAge << "\r\n"
+                 << "EXT:\r\n"
+                 << "LOCATION: " << fAdvertisedLocation << "\r\n"
+                 << "SERVER: Haiku UPnP/1.0 BeTon/1.0\r\n"
+                 << "ST: " << nt << "\r\n"
+                 << "USN: " << _AdvertisedUsn(nt) << "\r\n"
+                 << "BOOTID.UPNP.ORG: " << fAdvertisedBootId << "\r\n"
+                 << "CONFIGID.UPNP.ORG: 1\r\n"
+                 << "\r\n";
+        sendto(sock, response.String(), response.Length(), 0,
+               (const struct sockaddr*)&from, sizeof(from));
+    }
+}
+
+/**
+ * @brief Whether a known description still holds for an SSDP reply.
+ *
+ * The reply must name the same UDN and announce the same BOOTID and
+ * CONFIGID. A description restored from disk is only taken on those
+ * numbers; a device that sends neither is fetched once per session.
+ */
+bool DLNAService::_DescriptionCurrent(const DLNADevice& dev, const BString& udn,
+                                      int32 bootId, int32 configId) const
+{
+    if (!udn.IsEmpty() && udn != dev.uuid)
+        return false;
+    if (bootId != dev.bootId || configId != dev.configId)
+        return false;
+    return dev.verified || bootId >= 0 || configId >= 0;
+}
+
+/**
+ * @brief Parses an SSDP response and fetches the device description if
+ * no current one is known.
  */
 void DLNAService::_ProcessSsdpResponse(const char* data, size_t len, const struct sockaddr_in& from)
 {
@@ -284,50 +530,98 @@ void DLNAService::_ProcessSsdpResponse(const char* data, size_t len, const struc
     /* DEBUG_PRINT("SSDP response from %s (%zd bytes) - candidate found\n", 
                 fromAddr.String(), len); */
 
-    BString location;
-    int32 locPos = response.IFindFirst("LOCATION:");
-    if (locPos < 0)
-        return;
-    int32 start = locPos + 9;
-    while (start < response.Length() && response[start] == ' ')
-        start++;
-    int32 end = response.FindFirst("\r\n", start);
-    if (end < 0)
-        end = response.FindFirst("\n", start);
-    if (end < 0)
-        end = response.Length();
-    response.CopyInto(location, start, end - start);
-    location.Trim();
-
+    BString location = _SsdpHeader(response, "LOCATION");
     if (location.IsEmpty())
         return;
 
-    for (auto& dev : fDevices) {
-        if (dev.location == location) {
-            dev.lastSeen = system_time();
+    /// USN is "uuid:<device>" or "uuid:<device>::<type>".
+    BString udn = _SsdpHeader(response, "USN");
+    int32 separator = udn.FindFirst("::");
+    if (separator >= 0)
+        udn.Truncate(separator);
+
+    BString value = _SsdpHeader(response, "BOOTID.UPNP.ORG");
+    int32 bootId = value.IsEmpty() ? -1 : atoi(value.String());
+    value = _SsdpHeader(response, "CONFIGID.UPNP.ORG");
+    int32 configId = value.IsEmpty() ? -1 : atoi(value.String());
+
+    bigtime_t maxAge = 0;
+    value = _SsdpHeader(response, "CACHE-CONTROL");
+    int32 agePos = value.IFindFirst("max-age");
+    if (agePos >= 0) {
+        int32 equals = value.FindFirst('=', agePos);
+        if (equals >= 0)
+            maxAge = atoll(value.String() + equals + 1) * 1000000LL;
+    }
+
+    bigtime_t now = system_time();
+    auto listed = std::find_if(fDevices.begin(), fDevices.end(),
+        [&location](const DLNADevice& d) { return d.location == location; });
+    if (listed != fDevices.end()) {
+        listed->lastSeen = now;
+        if (maxAge > 0)
+            listed->maxAge = maxAge;
+        if (listed->verified
+            && _DescriptionCurrent(*listed, udn, bootId, configId))
             return;
-        }
     }
 
     DLNADevice dev;
-    dev.type = isServer ? DLNADevice::MediaServer : DLNADevice::MediaRenderer;
-    dev.location = location;
-    dev.lastSeen = system_time();
+    bool fetched = false;
+    auto cached = fDescriptions.find(location);
+    if (cached != fDescriptions.end()
+        && _DescriptionCurrent(cached->second.device, udn, bootId, configId)) {
+        dev = cached->second.device;
+        if (!dev.verified) {
+            cached->second.device.verified = true;
+            cached->second.seen = real_time_clock();
+            fDescriptionsDirty = true;
+        }
+    } else {
+        dev.type = isServer ? DLNADevice::MediaServer : DLNADevice::MediaRenderer;
+        dev.location = location;
+        if (_FetchDeviceDescription(location, dev) != B_OK
+            || dev.friendlyName.IsEmpty())
+            return;
+        dev.bootId = bootId;
+        dev.configId = configId;
+        fetched = true;
+
+        CachedDescription& entry = fDescriptions[location];
+        entry.device = dev;
+        entry.seen = real_time_clock();
+        fDescriptionsDirty = true;
+    }
 
-    if (_FetchDeviceDescription(location, dev) == B_OK
-        && !dev.friendlyName.IsEmpty()) {
-        fDevices.push_back(dev);
-        DEBUG_PRINT("Found %s: '%s' (%s)\n",
-                    isServer ? "Server" : "Renderer",
-                    dev.friendlyName.String(), dev.uuid.String());
+    dev.verified = true;
+    dev.lastSeen = now;
+    dev.maxAge = maxAge;
 
-        if (fTarget.IsValid()) {
-            BMessage msg(MSG_DLNA_DEVICE_FOUND);
-            msg.AddString("name", dev.friendlyName);
-            msg.AddString("uuid", dev.uuid);
-            msg.AddInt32("type", (int32)dev.type);
-            fTarget.SendMessage(&msg);
+    if (listed != fDevices.end()) {
+        if (!fetched) {
+            listed->verified = true;
+            return;
         }
+        /// Rebooted or reconfigured: take the new description.
+        if (listed->uuid == dev.uuid)
+            dev.sinkProtocolInfo = listed->sinkProtocolInfo;
+        if (maxAge == 0)
+            dev.maxAge = listed->maxAge;
+        *listed = dev;
+    } else {
+        fDevices.push_back(dev);
+    }
+
+    DEBUG_PRINT("%s %s: '%s' (%s)\n", fetched ? "Found" : "Recognized",
+                dev.type == DLNADevice::MediaServer ? "Server" : "Renderer",
+                dev.friendlyName.String(), dev.uuid.String());
+
+    if (fTarget.IsValid()) {
+        BMessage msg(MSG_DLNA_DEVICE_FOUND);
+        msg.AddString("name", dev.friendlyName);
+        msg.AddString("uuid", dev.uuid);
+        msg.AddInt32("type", (int32)dev.type);
+        fTarget.SendMessage(&msg);
     }
 }
 
@@ -337,26 +631,15 @@ void DLNAService::_ProcessSsdpResponse(const char* data, size_t len, const struc
 status_t DLNAService::_FetchDeviceDescription(const BString& location,
                                                DLNADevice& dev)
 {
-    BMallocIO sink;
-#if B_HAIKU_VERSION <= B_HAIKU_VERSION_1_BETA_5
-    BUrl burl(location.String());
-#else
-    BUrl burl(location.String(), false);
-#endif
-    std::unique_ptr<BUrlRequest> req(
-        BUrlProtocolRoster::MakeRequest(burl, &sink, nullptr, &fUrlContext));
-    if (!req)
-        return B_ERROR;
-
-    thread_id tid = req->Run();
-    status_t exit;
-    if (wait_for_thread_etc(tid, B_RELATIVE_TIMEOUT, 10000000, &exit) != B_OK) {
-        req->Stop();
-        wait_for_thread(tid, &exit);
-        return B_TIMED_OUT;
-    }
-
-    BString xml((const char*)sink.Buffer(), sink.BufferLength());
+    HttpConnectionPool::Request request;
+    request.url = location;
+    request.maxRedirects = 5;
+    HttpConnectionPool::Response response;
+    status_t status = HttpConnectionPool::Default().Fetch(request, response);
+    if (status != B_OK)
+        return status;
+
+    BString xml((const char*)response.body.data(), response.body.size());
     if (xml.IsEmpty())
         return B_ERROR;
 
@@ -412,19 +695,33 @@ void DLNAService::_ParseDeviceXml(const BString& xml, DLNADevice& dev)
 
         BString svcType = _ExtractXmlTag(svcBlock, "serviceType");
         BString ctrlUrl = _ExtractXmlTag(svcBlock, "controlURL");
+        BString eventUrl = _ExtractXmlTag(svcBlock, "eventSubURL");
 
         if (!ctrlUrl.IsEmpty() && !ctrlUrl.StartsWith("http")) {
             if (!ctrlUrl.StartsWith("/"))
                 ctrlUrl.Prepend("/");
             ctrlUrl.Prepend(baseUrl);
         }
+        if (!eventUrl.IsEmpty() && !eventUrl.StartsWith("http")) {
+            if (!eventUrl.StartsWith("/"))
+                eventUrl.Prepend("/");
+            eventUrl.Prepend(baseUrl);
+        }
 
-        if (svcType.FindFirst("ContentDirectory") >= 0)
+        if (svcType.FindFirst("ContentDirectory") >= 0) {
             dev.contentDirUrl = ctrlUrl;
-        else if (svcType.FindFirst("AVTransport") >= 0)
+            dev.contentDirEventUrl = eventUrl;
+        }
+        else if (svcType.FindFirst("AVTransport") >= 0) {
             dev.avTransportUrl = ctrlUrl;
-        else if (svcType.FindFirst("RenderingControl") >= 0)
+            dev.avTransportEventUrl = eventUrl;
+        }
+        else if (svcType.FindFirst("RenderingControl") >= 0) {
             dev.renderingCtlUrl = ctrlUrl;
+            dev.renderingCtlEventUrl = eventUrl;
+        }
+        else if (svcType.FindFirst("ConnectionManager") >= 0)
+            dev.connectionMgrUrl = ctrlUrl;
 
         searchStart = svcEnd;
     }
@@ -443,7 +740,15 @@ void DLNAService::_PurgeStaleDevices()
     bigtime_t now = system_time();
     auto it = fDevices.begin();
     while (it != fDevices.end()) {
-        if (now - it->lastSeen > kDeviceTimeout) {
+        /// Devices restored from disk that did not answer this pass go at
+        /// once. Others are kept for their announced max-age, within limits,
+        /// so one missed reply between passes does not drop them.
+        bigtime_t timeout = 0;
+        if (it->verified) {
+            timeout = std::max(kDeviceTimeout,
+                               std::min(it->maxAge, 2 * kDiscoveryInterval));
+        }
+        if (now - it->lastSeen > timeout) {
             DEBUG_PRINT("Device timed out: '%s'\n",
                         it->friendlyName.String());
             if (fHasActiveRenderer && fActiveRenderer.uuid == it->uuid)
@@ -464,9 +769,17 @@ void DLNAService::_PurgeStaleDevices()
 void DLNAService::SetActiveRenderer(const BString& uuid)
 {
     _StopPositionPolling();
-    fCurrentPosition = 0;
+    UnsubscribeRendererEvents();
     fCurrentDuration = 0;
-    
+    _SetPosition(0);
+    {
+        BAutolock lock(fPositionLock);
+        fTransportState = "";
+        fCurrentUri = "";
+        fNextUri = "";
+    }
+    fNextUriUnsupported = false;
+
     if (uuid.IsEmpty()) {
         fHasActiveRenderer = false;
         return;
@@ -504,13 +817,11 @@ std::vector<DLNADevice> DLNAService::Renderers() const
 }
 
 /**
- * @brief Sends a SOAP action to a UPnP service control URL.
+ * @brief Builds the POST of a SOAP action to a UPnP service control URL.
  */
-status_t DLNAService::_SendSoapAction(const BString& controlUrl,
-                                       const BString& serviceUrn,
-                                       const BString& action,
-                                       const BString& bodyArgs,
-                                       BString& response)
+static HttpConnectionPool::Request
+_SoapRequest(const BString& controlUrl, const BString& serviceUrn,
+             const BString& action, const BString& bodyArgs)
 {
     BString soapBody;
     soapBody << "<?xml version=\"1.0\" encoding=\"utf-8\"?>"
@@ -522,49 +833,158 @@ status_t DLNAService::_SendSoapAction(const BString& controlUrl,
              << "</u:" << action << ">"
              << "</s:Body></s:Envelope>";
 
-    BMallocIO sink;
-#if B_HAIKU_VERSION <= B_HAIKU_VERSION_1_BETA_5
-    BUrl burl(controlUrl.String());
-#else
-    BUrl burl(controlUrl.String(), false);
-#endif
-    std::unique_ptr<BUrlRequest> req(
-        BUrlProtocolRoster::MakeRequest(burl, &sink, nullptr, nullptr));
-    if (!req)
-        return B_ERROR;
+    // Position polling sends one of these every second: on a kept-alive
+    // connection to the renderer.
+    HttpConnectionPool::Request request;
+    request.method = "POST";
+    request.url = controlUrl;
+    request.headers << "Content-Type: text/xml; charset=\"utf-8\"\r\n"
+                    << "SOAPAction: \"" << serviceUrn << "#" << action
+                    << "\"\r\n";
+    request.body = soapBody;
+    request.timeout = 30000000;
+    return request;
+}
+
+/**
+ * @brief Sends a SOAP action to a UPnP service control URL.
+ */
+status_t DLNAService::_SendSoapAction(const BString& controlUrl,
+                                       const BString& serviceUrn,
+                                       const BString& action,
+                                       const BString& bodyArgs,
+                                       BString& response)
+{
+    HttpConnectionPool::Request request
+        = _SoapRequest(controlUrl, serviceUrn, action, bodyArgs);
+    HttpConnectionPool::Response reply;
+    status_t status = _PerformSoapAction(controlUrl, serviceUrn, action,
+                                         request, reply);
+    if (status != B_OK)
+        return status;
+
+    response.SetTo((const char*)reply.body.data(), reply.body.size());
+    return B_OK;
+}
 
-    auto http = dynamic_cast<BHttpRequest*>(req.get());
-    if (http) {
-        http->SetMethod(B_HTTP_POST);
-        BHttpHeaders headers;
-        headers.AddHeader("Content-Type", "text/xml; charset=\"utf-8\"");
+/**
+ * @brief Sends a SOAP action and parses a successful reply as it is read,
+ * so the body is never held whole.
+ */
+status_t DLNAService::_SendSoapAction(const BString& controlUrl,
+                                       const BString& serviceUrn,
+                                       const BString& action,
+                                       const BString& bodyArgs,
+                                       DidlParser& parser)
+{
+    HttpConnectionPool::Request request
+        = _SoapRequest(controlUrl, serviceUrn, action, bodyArgs);
+    request.bodySink = [&parser](const uint8* data, size_t size) {
+        parser.FeedSoap((const char*)data, size);
+    };
+    HttpConnectionPool::Response reply;
+    status_t status = _PerformSoapAction(controlUrl, serviceUrn, action,
+                                         request, reply);
+    // What was parsed of a cut reply is not a page.
+    if (status == B_OK && reply.truncated)
+        status = B_IO_ERROR;
+    return status;
+}
 
-        BString soapAction;
-        soapAction << "\"" << serviceUrn << "#" << action << "\"";
-        headers.AddHeader("SOAPAction", soapAction.String());
-        http->SetHeaders(headers);
+/**
+ * @brief The channel of the device serving `controlUrl`; created on first
+ * use and kept for the service's lifetime.
+ */
+DLNAService::DeviceChannel* DLNAService::_Channel(const BString& controlUrl)
+{
+    BString key(controlUrl);
+    int32 scheme = key.FindFirst("://");
+    int32 path = key.FindFirst('/', scheme >= 0 ? scheme + 3 : 0);
+    if (path >= 0)
+        key.Truncate(path);
+
+    BAutolock lock(fChannelsLock);
+    std::unique_ptr<DeviceChannel>& channel = fChannels[key];
+    if (!channel)
+        channel.reset(new DeviceChannel);
+    return channel.get();
+}
 
-        BMemoryIO* bodyIO = new BMemoryIO(soapBody.String(), soapBody.Length());
-        http->AdoptInputData(bodyIO, soapBody.Length());
-    }
+/**
+ * @brief Sends a built SOAP request and records its latency.
+ *
+ * Renderer control actions wait for the device's previous one; a
+ * ContentDirectory's Search pages may run side by side.
+ */
+status_t DLNAService::_PerformSoapAction(const BString& controlUrl,
+                                          const BString& serviceUrn,
+                                          const BString& action,
+                                          const HttpConnectionPool::Request& request,
+                                          HttpConnectionPool::Response& reply)
+{
+    DeviceChannel* channel = _Channel(controlUrl);
+    const bool serialize = serviceUrn.FindFirst("ContentDirectory") < 0;
+    if (serialize)
+        channel->lock.Lock();
+    bigtime_t start = system_time();
+    status_t status = HttpConnectionPool::Default().Fetch(request, reply);
+    bigtime_t latency = system_time() - start;
+    if (serialize)
+        channel->lock.Unlock();
+    TRACE_COMPLETE(kTraceDlna, Trace::Intern(action.String()), start, latency,
+                   (int64)reply.status);
+
+    BAutolock lock(fChannelsLock);
+    ActionStats& stats = channel->actions[action];
+    stats.count++;
+    if (status != B_OK || reply.status != 200)
+        stats.failures++;
+    stats.total += latency;
+    stats.max = std::max(stats.max, latency);
+    stats.last = latency;
+    return status;
+}
 
-    thread_id tid = req->Run();
-    status_t exit;
-    if (wait_for_thread_etc(tid, B_RELATIVE_TIMEOUT, 30000000, &exit) != B_OK) {
-        req->Stop();
-        wait_for_thread(tid, &exit);
-        return B_TIMED_OUT;
+BString DLNAService::ActionReport() const
+{
+    BString report;
+    BAutolock lock(fChannelsLock);
+    for (const auto& channel : fChannels) {
+        for (const auto& entry : channel.second->actions) {
+            const ActionStats& stats = entry.second;
+            BString line;
+            line.SetToFormat("DLNA %s %s: %" B_PRIu32 " sent, %" B_PRIu32
+                             " failed, mean %lld ms, max %lld ms, last %lld ms\n",
+                             channel.first.String(), entry.first.String(),
+                             stats.count, stats.failures,
+                             (long long)(stats.total / std::max<uint32>(stats.count, 1) / 1000),
+                             (long long)(stats.max / 1000),
+                             (long long)(stats.last / 1000));
+            report << line;
+        }
     }
+    return report;
+}
 
-    response.SetTo((const char*)sink.Buffer(), sink.BufferLength());
-    return B_OK;
+void DLNAService::ResetActionStats()
+{
+    BAutolock lock(fChannelsLock);
+    for (auto& channel : fChannels)
+        channel.second->actions.clear();
 }
 
 status_t DLNAService::SetAVTransportURI(const BString& uri, const BString& title)
 {
-    fCurrentPosition = 0;
+    // Before the renderer reports the old track stopped: with no duration
+    // that does not count as its end.
     fCurrentDuration = 0;
-    
+    _SetPosition(0);
+    {
+        BAutolock lock(fPositionLock);
+        fCurrentUri = uri;
+        fNextUri = "";
+    }
+
     if (!fHasActiveRenderer || fActiveRenderer.avTransportUrl.IsEmpty())
         return B_NOT_ALLOWED;
 
@@ -579,6 +999,77 @@ status_t DLNAService::SetAVTransportURI(const BString& uri, const BString& title
                            "SetAVTransportURI", args, response);
 }
 
+status_t DLNAService::SetNextAVTransportURI(const BString& uri, const BString& title)
+{
+    if (!fHasActiveRenderer || fActiveRenderer.avTransportUrl.IsEmpty())
+        return B_NOT_ALLOWED;
+    if (fNextUriUnsupported)
+        return B_NOT_SUPPORTED;
+    BString next(uri);
+    {
+        BAutolock lock(fPositionLock);
+        /// Its track URI would not tell a repeat from the current track.
+        if (next == fCurrentUri)
+            next = "";
+        /// A new current URI drops the queued one, so nothing to clear then.
+        if (next == fNextUri)
+            return B_OK;
+    }
+
+    BString args;
+    args << "<InstanceID>0</InstanceID>"
+         << "<NextURI>" << next << "</NextURI>"
+         << "<NextURIMetaData></NextURIMetaData>";
+
+    BString response;
+    status_t err = _SendSoapAction(fActiveRenderer.avTransportUrl,
+                                   "urn:schemas-upnp-org:service:AVTransport:1",
+                                   "SetNextAVTransportURI", args, response);
+    if (err != B_OK)
+        return err;
+
+    /// 401 Invalid Action, 602 Optional Action Not Implemented.
+    BString fault = _ExtractXmlTag(response, "errorCode");
+    if (!fault.IsEmpty()) {
+        int32 code = atoi(fault.String());
+        DEBUG_PRINT("SetNextAVTransportURI failed: UPnP error %ld\n",
+                    (long)code);
+        if (code == 401 || code == 602) {
+            fNextUriUnsupported = true;
+            return B_NOT_SUPPORTED;
+        }
+        return B_ERROR;
+    }
+
+    BAutolock lock(fPositionLock);
+    fNextUri = next;
+    return B_OK;
+}
+
+BString DLNAService::SinkProtocolInfo()
+{
+    if (!fHasActiveRenderer || fActiveRenderer.connectionMgrUrl.IsEmpty())
+        return "";
+    if (!fActiveRenderer.sinkProtocolInfo.IsEmpty())
+        return fActiveRenderer.sinkProtocolInfo;
+
+    BString response;
+    status_t err = _SendSoapAction(fActiveRenderer.connectionMgrUrl,
+                                   "urn:schemas-upnp-org:service:ConnectionManager:1",
+                                   "GetProtocolInfo", "", response);
+    if (err != B_OK) {
+        DEBUG_PRINT("GetProtocolInfo failed: %ld\n", (long)err);
+        return "";
+    }
+
+    BString sink = _UnescapeXml(_ExtractXmlTag(response, "Sink"));
+    sink.Trim();
+    fActiveRenderer.sinkProtocolInfo = sink;
+    DEBUG_PRINT("Renderer '%s' plays: %s\n",
+                fActiveRenderer.friendlyName.String(), sink.String());
+    return sink;
+}
+
 status_t DLNAService::RendererPlay()
 {
     if (!fHasActiveRenderer || fActiveRenderer.avTransportUrl.IsEmpty())
@@ -591,6 +1082,7 @@ status_t DLNAService::RendererPlay()
                                    "Play", args, response);
     if (err == B_OK) {
         _StartPositionPolling();
+        _WakePositionPolling();
     }
     return err;
 }
@@ -607,6 +1099,12 @@ status_t DLNAService::RendererStop()
                                    "Stop", args, response);
     if (err == B_OK) {
         _StopPositionPolling();
+        // Stopped by us, not at the track's end.
+        BAutolock lock(fPositionLock);
+        fPositionBase = GetCurrentPosition();
+        fPositionStamp = system_time();
+        fTransportState = "STOPPED";
+        fNextUri = "";
     }
     return err;
 }
@@ -644,7 +1142,7 @@ status_t DLNAService::RendererSeek(bigtime_t position)
                                    "urn:schemas-upnp-org:service:AVTransport:1",
                                    "Seek", args, response);
     if (err == B_OK)
-        fCurrentPosition = position;
+        _SetPosition(position);
     return err;
 }
 
@@ -657,6 +1155,87 @@ bigtime_t DLNAService::_ParseUpnpTime(const BString& timeStr) const
     return 0;
 }
 
+bigtime_t DLNAService::GetCurrentPosition() const
+{
+    BAutolock lock(fPositionLock);
+    bigtime_t position = fPositionBase;
+    if (fTransportState == "PLAYING")
+        position += system_time() - fPositionStamp;
+    bigtime_t duration = fCurrentDuration;
+    if (duration > 0 && position > duration)
+        position = duration;
+    return position;
+}
+
+/**
+ * @brief Takes `position` as the renderer's position now.
+ */
+void DLNAService::_SetPosition(bigtime_t position)
+{
+    BAutolock lock(fPositionLock);
+    fPositionBase = position;
+    fPositionStamp = system_time();
+}
+
+/**
+ * @brief Takes a TransportState from an event or a poll.
+ *
+ * Interpolation runs only while PLAYING. Entering STOPPED within two
+ * seconds of the track's end announces MSG_TRACK_ENDED.
+ */
+void DLNAService::_SetTransportState(const BString& state)
+{
+    bool ended = false;
+    {
+        BAutolock lock(fPositionLock);
+        if (state == fTransportState)
+            return;
+
+        bigtime_t position = GetCurrentPosition();
+        bigtime_t duration = fCurrentDuration;
+        if (state == "STOPPED" && duration > 0 && position > 0
+            && position + 2000000LL >= duration) {
+            position = duration;
+            ended = true;
+        }
+        fPositionBase = position;
+        fPositionStamp = system_time();
+        fTransportState = state;
+    }
+    DEBUG_PRINT("Renderer state: %s\n", state.String());
+
+    if (ended)
+        fTarget.SendMessage(MSG_TRACK_ENDED);
+    else if (state == "PLAYING")
+        _WakePositionPolling();
+}
+
+/**
+ * @brief Takes the renderer's current track URI from an event or a poll.
+ *
+ * Once it is the URI queued with SetNextAVTransportURI, the renderer has
+ * moved on by itself: the new track starts at zero and MSG_TRACK_ENDED is
+ * sent with "gapless" = true.
+ */
+void DLNAService::_SetTrackUri(const BString& uri)
+{
+    {
+        BAutolock lock(fPositionLock);
+        if (fNextUri.IsEmpty() || uri != fNextUri)
+            return;
+        fCurrentUri = fNextUri;
+        fNextUri = "";
+        fCurrentDuration = 0;
+        fPositionBase = 0;
+        fPositionStamp = system_time();
+    }
+    DEBUG_PRINT("Renderer moved on to the queued track\n");
+
+    BMessage msg(MSG_TRACK_ENDED);
+    msg.AddBool("gapless", true);
+    fTarget.SendMessage(&msg);
+}
+
 void DLNAService::_StartPositionPolling()
 {
     if (fPositionPolling) return;
@@ -670,6 +1249,7 @@ void DLNAService::_StopPositionPolling()
 {
     if (!fPositionPolling) return;
     fPositionPolling = false;
+    _WakePositionPolling();
     if (fPositionPollThread >= 0) {
         status_t ret;
         wait_for_thread(fPositionPollThread, &ret);
@@ -677,46 +1257,91 @@ void DLNAService::_StopPositionPolling()
     }
 }
 
+/**
+ * @brief Makes the poll thread ask for the position now.
+ */
+void DLNAService::_WakePositionPolling()
+{
+    if (fPositionPollWakeSem >= 0)
+        release_sem_etc(fPositionPollWakeSem, 1, B_DO_NOT_RESCHEDULE);
+}
+
 int32 DLNAService::_PositionPollThreadEntry(void* arg)
 {
     static_cast<DLNAService*>(arg)->_PositionPollLoop();
     return 0;
 }
 
+/**
+ * @brief Keeps position, duration, transport state and volume current.
+ *
+ * What events deliver is not asked for; the position is, every
+ * kEventResyncInterval with AVTransport events and kFallbackPollInterval
+ * without. Without events, a state that is still settling and the
+ * expected end of the track are looked at sooner.
+ */
 void DLNAService::_PositionPollLoop()
 {
+    /// Poll interval while the transport state is unknown or changing.
+    const bigtime_t kSettleInterval = 1000000;
+
     while (fPositionPolling) {
-        snooze(1000000); ///< 1 second
+        const bool transportEvented = fTransportEvented;
+        bigtime_t wait = transportEvented ? kEventResyncInterval
+                                          : kFallbackPollInterval;
+        if (!transportEvented) {
+            BAutolock lock(fPositionLock);
+            if (fTransportState == "PLAYING") {
+                bigtime_t left = fCurrentDuration - GetCurrentPosition();
+                if (fCurrentDuration > 0)
+                    wait = std::min(wait, left + 500000);
+            } else if (fTransportState != "PAUSED_PLAYBACK"
+                && fTransportState != "STOPPED") {
+                wait = kSettleInterval;
+            }
+            wait = std::max(wait, kSettleInterval);
+        }
+
+        if (fPositionPollWakeSem >= 0) {
+            acquire_sem_etc(fPositionPollWakeSem, 1, B_RELATIVE_TIMEOUT, wait);
+        } else {
+            snooze(wait);
+        }
+        if (!fPositionPolling)
+            break;
 
         if (!fHasActiveRenderer) continue;
 
+        _RenewSubscription(fTransportEvents, 2 * kEventResyncInterval);
+        _RenewSubscription(fRenderingEvents, 2 * kEventResyncInterval);
+
         /// Poll Volume
-        int32 vol = -1;
-        status_t volErr = GetRendererVolume(vol);
-        if (volErr == B_OK && vol >= 0 && vol != fCurrentVolume.load()) {
-            fCurrentVolume = vol;
-            BMessage volMsg(MSG_DLNA_VOLUME_UPDATE);
-            volMsg.AddInt32("volume", vol);
-            fTarget.SendMessage(&volMsg);
+        if (!fRenderingEvented) {
+            int32 vol = -1;
+            status_t volErr = GetRendererVolume(vol);
+            if (volErr == B_OK && vol >= 0 && vol != fCurrentVolume.load()) {
+                fCurrentVolume = vol;
+                BMessage volMsg(MSG_DLNA_VOLUME_UPDATE);
+                volMsg.AddInt32("volume", vol);
+                fTarget.SendMessage(&volMsg);
+            }
         }
 
         BString args("<InstanceID>0</InstanceID>");
         BString response;
-        
+
         /// Poll Transport State
-        status_t stateErr = _SendSoapAction(fActiveRenderer.avTransportUrl,
-                                       "urn:schemas-upnp-org:service:AVTransport:1",
-                                       "GetTransportInfo", args, response);
-        if (stateErr == B_OK) {
-            BString state = _ExtractXmlTag(response, "CurrentTransportState");
-            if (state == "STOPPED") {
-                if (fCurrentDuration > 0 && fCurrentPosition > 0 && fCurrentPosition + 2000000LL >= fCurrentDuration) {
-                    fCurrentPosition = fCurrentDuration.load();
-                    fTarget.SendMessage(MSG_TRACK_ENDED);
-                }
+        if (!transportEvented) {
+            status_t stateErr = _SendSoapAction(fActiveRenderer.avTransportUrl,
+                                           "urn:schemas-upnp-org:service:AVTransport:1",
+                                           "GetTransportInfo", args, response);
+            if (stateErr == B_OK) {
+                BString state = _ExtractXmlTag(response, "CurrentTransportState");
+                if (!state.IsEmpty())
+                    _SetTransportState(state);
+            } else {
+                DEBUG_PRINT("GetTransportInfo failed: %ld\n", (long)stateErr);
             }
-        } else {
-            DEBUG_PRINT("GetTransportInfo failed: %ld\n", (long)stateErr);
         }
 
         /// Poll Position
@@ -724,20 +1349,24 @@ void DLNAService::_PositionPollLoop()
                               "urn:schemas-upnp-org:service:AVTransport:1",
                               "GetPositionInfo", args, response);
         if (posErr == B_OK) {
+            BString trackUri = _UnescapeXml(_ExtractXmlTag(response, "TrackURI"));
+            if (!trackUri.IsEmpty())
+                _SetTrackUri(trackUri);
+
             BString relTime = _ExtractXmlTag(response, "RelTime");
             BString trackDuration = _ExtractXmlTag(response, "TrackDuration");
-            
+
+            if (!trackDuration.IsEmpty()) {
+                fCurrentDuration = _ParseUpnpTime(trackDuration);
+            }
+
             if (!relTime.IsEmpty()) {
-                fCurrentPosition = _ParseUpnpTime(relTime);
+                _SetPosition(_ParseUpnpTime(relTime));
             } else {
                 DEBUG_PRINT("RelTime is empty! Raw response: %s\n", response.String());
             }
-            
-            if (!trackDuration.IsEmpty()) {
-                fCurrentDuration = _ParseUpnpTime(trackDuration);
-            }
-            
-            DEBUG_PRINT("Poll OK: pos=%lld dur=%lld\n", (long long)fCurrentPosition.load(), (long long)fCurrentDuration.load());
+
+            DEBUG_PRINT("Poll OK: pos=%lld dur=%lld\n", (long long)GetCurrentPosition(), (long long)fCurrentDuration.load());
         } else {
             DEBUG_PRINT("GetPositionInfo failed: %ld\n", (long)posErr);
         }
@@ -799,166 +1428,46 @@ status_t DLNAService::Browse(const DLNADevice& server, const BString& objectId,
     if (server.contentDirUrl.IsEmpty())
         return B_NOT_ALLOWED;
 
-    BString args;
-    args << "<ObjectID>" << objectId << "</ObjectID>"
-         << "<BrowseFlag>BrowseDirectChildren</BrowseFlag>"
-         << "<Filter>*</Filter>"
-         << "<StartingIndex>0</StartingIndex>"
-         << "<RequestedCount>200</RequestedCount>"
-         << "<SortCriteria></SortCriteria>";
-
-    BString response;
-    status_t err = _SendSoapAction(server.contentDirUrl,
-                                   "urn:schemas-upnp-org:service:ContentDirectory:1",
-                                   "Browse", args, response);
-    if (err != B_OK)
-        return err;
-
-    BString didl = _ExtractXmlTag(response, "Result");
-    if (didl.IsEmpty())
-        return B_ERROR;
+    /// Servers return at most a page per request: as many as it takes.
+    uint32 startIndex = 0;
+    uint32 totalMatches = 1;
+    while (startIndex < totalMatches) {
+        BString args;
+        args << "<ObjectID>" << objectId << "</ObjectID>"
+             << "<BrowseFlag>BrowseDirectChildren</BrowseFlag>"
+             << "<Filter>*</Filter>"
+             << "<StartingIndex>" << startIndex << "</StartingIndex>"
+             << "<RequestedCount>200</RequestedCount>"
+             << "<SortCriteria></SortCriteria>";
 
-    didl = _UnescapeXml(didl);
-    _ParseDIDLLite(didl, results);
+        std::vector<DLNABrowseItem> page;
+        DidlParser parser(page);
+        status_t err = _SendSoapAction(server.contentDirUrl,
+                                       "urn:schemas-upnp-org:service:ContentDirectory:1",
+                                       "Browse", args, parser);
+        if (err != B_OK)
+            return startIndex > 0 ? B_OK : err;
+        if (!parser.HasResult())
+            return startIndex > 0 ? B_OK : B_ERROR;
+
+        results.insert(results.end(), page.begin(), page.end());
+
+        uint32 numberReturned = parser.HasNumberReturned()
+                                    ? parser.NumberReturned()
+                                    : (uint32)page.size();
+        /// Without a total, one page is all there is.
+        totalMatches = parser.HasTotalMatches() ? parser.TotalMatches() : 0;
+        if (numberReturned == 0 || page.empty()
+            || results.size() >= (size_t)kMaxCrawlItems)
+            break;
+        startIndex += numberReturned;
+    }
 
     DEBUG_PRINT("Browse '%s': %zu items\n",
                 objectId.String(), results.size());
     return B_OK;
 }
 
-/**
- * @brief Parses DIDL-Lite XML into browse items.
- */
-void DLNAService::_ParseDIDLLite(const BString& didl,
-                                  std::vector<DLNABrowseItem>& items)
-{
-    int32 pos = 0;
-    while (pos < didl.Length()) {
-        bool isContainer = false;
-        int32 itemStart = didl.FindFirst("<item ", pos);
-        int32 contStart = didl.FindFirst("<container ", pos);
-
-        int32 start = -1;
-        const char* endTag = nullptr;
-
-        if (itemStart >= 0 && (contStart < 0 || itemStart < contStart)) {
-            start = itemStart;
-            endTag = "</item>";
-            isContainer = false;
-        } else if (contStart >= 0) {
-            start = contStart;
-            endTag = "</container>";
-            isContainer = true;
-        } else {
-            break;
-        }
-
-        int32 end = didl.FindFirst(endTag, start);
-        if (end < 0)
-            break;
-        end += strlen(endTag);
-
-        BString block;
-        didl.CopyInto(block, start, end - start);
-
-        DLNABrowseItem item;
-        item.isContainer = isContainer;
-
-        int32 idPos = block.FindFirst("id=\"");
-        if (idPos >= 0) {
-            int32 idStart = idPos + 4;
-            int32 idEnd = block.FindFirst('"', idStart);
-            if (idEnd > idStart)
-                block.CopyInto(item.id, idStart, idEnd - idStart);
-        }
-
-        int32 refPos = block.FindFirst("refID=\"");
-        if (refPos >= 0) {
-            int32 refStart = refPos + 7;
-            int32 refEnd = block.FindFirst('"', refStart);
-            if (refEnd > refStart)
-                block.CopyInto(item.refId, refStart, refEnd - refStart);
-        }
-
-        int32 pidPos = block.FindFirst("parentID=\"");
-        if (pidPos >= 0) {
-            int32 pidStart = pidPos + 10;
-            int32 pidEnd = block.FindFirst('"', pidStart);
-            if (pidEnd > pidStart)
-                block.CopyInto(item.parentId, pidStart, pidEnd - pidStart);
-        }
-
-        item.title = _UnescapeXml(_ExtractXmlTag(block, "dc:title"));
-        item.artist = _UnescapeXml(_ExtractXmlTag(block, "dc:creator"));
-        if (item.artist.IsEmpty())
-            item.artist = _UnescapeXml(_ExtractXmlTag(block, "upnp:artist"));
-        item.album = _UnescapeXml(_ExtractXmlTag(block, "upnp:album"));
-        item.genre = _UnescapeXml(_ExtractXmlTag(block, "upnp:genre"));
-        item.upnpClass = _UnescapeXml(_ExtractXmlTag(block, "upnp:class"));
-        item.albumArtUrl = _UnescapeXml(_ExtractXmlTag(block, "upnp:albumArtURI"));
-
-        if (!isContainer) {
-            int32 resStart = block.FindFirst("<res ");
-            if (resStart >= 0) {
-                int32 resClose = block.FindFirst('>', resStart);
-                if (resClose >= 0) {
-                    int32 resEnd = block.FindFirst("</res>", resClose);
-                    if (resEnd > resClose + 1) {
-                        BString rawUrl;
-                        block.CopyInto(rawUrl, resClose + 1,
-                                       resEnd - resClose - 1);
-                        item.resourceUrl = _UnescapeXml(rawUrl);
-                        item.resourceUrl.Trim();
-                    }
-
-                    BString resAttrs;
-                    block.CopyInto(resAttrs, resStart, resClose - resStart);
-                    int32 piPos = resAttrs.FindFirst("protocolInfo=\"");
-                    if (piPos >= 0) {
-                        int32 piStart = piPos + 14;
-                        int32 piEnd = resAttrs.FindFirst('"', piStart);
-                        if (piEnd > piStart) {
-                            BString pi;
-                            resAttrs.CopyInto(pi, piStart, piEnd - piStart);
-                            int32 c1 = pi.FindFirst(':');
-                            if (c1 >= 0) {
-                                int32 c2 = pi.FindFirst(':', c1 + 1);
-                                if (c2 >= 0) {
-                                    int32 c3 = pi.FindFirst(':', c2 + 1);
-                                    if (c3 > c2 + 1)
-                                        pi.CopyInto(item.mimeType, c2 + 1,
-                                                     c3 - c2 - 1);
-                                }
-                            }
-                        }
-                    }
-
-                    int32 durPos = resAttrs.FindFirst("duration=\"");
-                    if (durPos >= 0) {
-                        int32 durStart = durPos + 10;
-                        int32 durEnd = resAttrs.FindFirst('"', durStart);
-                        if (durEnd > durStart)
-                            resAttrs.CopyInto(item.duration, durStart,
-                                              durEnd - durStart);
-                    }
-
-                    int32 sizePos = resAttrs.FindFirst("size=\"");
-                    if (sizePos >= 0) {
-                        int32 sizeStart = sizePos + 6;
-                        int32 sizeEnd = resAttrs.FindFirst('"', sizeStart);
-                        if (sizeEnd > sizeStart)
-                            resAttrs.CopyInto(item.resourceSize, sizeStart,
-                                              sizeEnd - sizeStart);
-                    }
-                }
-            }
-        }
-
-        items.push_back(item);
-        pos = end;
-    }
-}
-
 /**
  * @brief Extracts the text content of a simple XML tag.
  */
@@ -1021,101 +1530,278 @@ BString DLNAService::_UnescapeXml(const BString& escaped) const
     return result;
 }
 
+namespace {
+
 /**
- * @brief Uses the ContentDirectory Search action to fetch all audio items paginated.
+ * @brief Pages of one Search that pool threads fetch, and the parent
+ * merges in order.
  */
-status_t DLNAService::_SearchAudio(const DLNADevice& server,
-                                   std::vector<DLNABrowseItem>& allItems,
-                                   BMessenger progressTarget)
+struct SearchWindow {
+    struct Page {
+        uint32 start;
+        uint32 count;
+        status_t status = B_OK;
+        std::vector<DLNABrowseItem> items;
+        uint32 returned = 0;
+        bool done = false;
+    };
+
+    DLNAService* service;
+    const DLNADevice* server;
+    const char* criteria;
+    std::vector<Page> pages;
+    std::atomic<int32> next{0};
+    /// Pages past this one are not started; lowered to stop.
+    std::atomic<int32> last{0};
+    BLocker lock{"dlna search window"}; ///< Guards Page::done and results
+    sem_id finished = -1; ///< Released once per finished page
+};
+
+} // namespace
+
+/**
+ * @brief Fetches Search results [startIndex, startIndex + requestedCount).
+ * @param totalMatches Set from the reply; 0 if the server leaves it out.
+ */
+status_t DLNAService::_SearchPage(const DLNADevice& server, const char* criteria,
+                                  uint32 startIndex, uint32 requestedCount,
+                                  std::vector<DLNABrowseItem>& items,
+                                  uint32& numberReturned, uint32& totalMatches)
+{
+    BString args;
+    args << "<ContainerID>0</ContainerID>"
+         << "<SearchCriteria>upnp:class derivedfrom &quot;" << criteria
+         << "&quot;</SearchCriteria>"
+         << "<Filter>*</Filter>"
+         << "<StartingIndex>" << startIndex << "</StartingIndex>"
+         << "<RequestedCount>" << requestedCount << "</RequestedCount>"
+         << "<SortCriteria></SortCriteria>";
+
+    size_t before = items.size();
+    DidlParser parser(items);
+    status_t err = _SendSoapAction(server.contentDirUrl,
+                                   "urn:schemas-upnp-org:service:ContentDirectory:1",
+                                   "Search", args, parser);
+    if (err == B_OK && !parser.HasResult())
+        err = B_ERROR;
+    if (err != B_OK) {
+        items.resize(before);
+        return err;
+    }
+
+    totalMatches = parser.HasTotalMatches() ? parser.TotalMatches() : 0;
+    numberReturned = parser.HasNumberReturned()
+                         ? parser.NumberReturned()
+                         : (uint32)(items.size() - before);
+    return B_OK;
+}
+
+int32 DLNAService::_SearchWorkerEntry(void* arg)
+{
+    SearchWindow* window = static_cast<SearchWindow*>(arg);
+    for (;;) {
+        int32 index = window->next.fetch_add(1);
+        if (index > window->last || index >= (int32)window->pages.size())
+            break;
+
+        SearchWindow::Page& page = window->pages[index];
+        std::vector<DLNABrowseItem> items;
+        uint32 returned = 0;
+        uint32 total = 0;
+        status_t status = window->service->_SearchPage(*window->server,
+            window->criteria, page.start, page.count, items, returned, total);
+
+        BAutolock lock(window->lock);
+        page.status = status;
+        page.items.swap(items);
+        page.returned = returned;
+        page.done = true;
+        release_sem(window->finished);
+    }
+    return 0;
+}
+
+/**
+ * @brief Runs a ContentDirectory Search for items derived from `criteria`
+ * and hands each page to `handler`, in order.
+ *
+ * The first page tells TotalMatches and how many items the server returns
+ * per page; the rest are then requested kSearchWindow at a time. A page
+ * that comes back short is completed before the next one is handed on. An
+ * error ends the search at that page: some servers answer 500 at the end,
+ * so the pages before it count as success. The handler is also told the
+ * StartingIndex that follows the page, to resume from with `firstIndex`.
+ *
+ * @return B_OK if at least the first page arrived.
+ */
+status_t DLNAService::_SearchPages(const DLNADevice& server, const char* criteria,
+                                   const SearchPageHandler& handler,
+                                   uint32 firstIndex)
 {
     if (server.contentDirUrl.IsEmpty())
         return B_NOT_ALLOWED;
 
-    uint32 startIndex = 0;
-    uint32 requestedCount = 500;
-    uint32 totalMatches = 1;
+    std::vector<DLNABrowseItem> items;
+    uint32 returned = 0;
+    uint32 totalMatches = 0;
+    status_t err = _SearchPage(server, criteria, firstIndex, kSearchPageSize,
+                               items, returned, totalMatches);
+    if (err != B_OK)
+        return err;
+    if (!handler(items, totalMatches, firstIndex + returned) || returned == 0
+        || items.empty())
+        return B_OK;
 
-    int32 lastReported = 0;
-    std::set<BString> seenItems;
+    /// Servers cap a page at their own size; later pages ask for that.
+    const uint32 pageSize = std::min(returned, (uint32)kSearchPageSize);
+    uint32 startIndex = firstIndex + returned;
+
+    if (totalMatches == 0) {
+        /// Without a total there is no telling the pages apart: one by one.
+        for (;;) {
+            items.clear();
+            err = _SearchPage(server, criteria, startIndex, pageSize, items,
+                              returned, totalMatches);
+            if (err != B_OK) {
+                DEBUG_PRINT("_SearchPages partial success: error at index %lu\n",
+                            (unsigned long)startIndex);
+                return B_OK;
+            }
+            if (returned == 0 || items.empty()
+                || !handler(items, totalMatches, startIndex + returned))
+                return B_OK;
+            startIndex += returned;
+        }
+    }
 
-    while (startIndex < totalMatches) {
-        BString args;
-        args << "<ContainerID>0</ContainerID>"
-             << "<SearchCriteria>upnp:class derivedfrom &quot;object.item.audioItem&quot;</SearchCriteria>"
-             << "<Filter>*</Filter>"
-             << "<StartingIndex>" << startIndex << "</StartingIndex>"
-             << "<RequestedCount>" << requestedCount << "</RequestedCount>"
-             << "<SortCriteria></SortCriteria>";
+    const uint32 end = std::min<uint32>(totalMatches, startIndex + kMaxCrawlItems);
+    SearchWindow window;
+    window.service = this;
+    window.server = &server;
+    window.criteria = criteria;
+    for (uint32 start = startIndex; start < end; start += pageSize)
+        window.pages.push_back({start, std::min(pageSize, end - start)});
+    if (window.pages.empty())
+        return B_OK;
+    window.last = (int32)window.pages.size() - 1;
+    window.finished = create_sem(0, "dlna search pages");
+    if (window.finished < 0)
+        return B_OK;
 
-        BString response;
-        status_t err = _SendSoapAction(server.contentDirUrl,
-                                       "urn:schemas-upnp-org:service:ContentDirectory:1",
-                                       "Search", args, response);
-        if (err != B_OK) {
-            /// Some servers return an error (HTTP 500) if StartingIndex is exactly at the end
-            /// or if a timeout occurs. If we already collected items, accept them!
-            if (!allItems.empty()) {
-                DEBUG_PRINT("_SearchAudio partial success: error at index %lu, keeping %zu items.\n",
-                            (unsigned long)startIndex, allItems.size());
-                break;
+    std::vector<thread_id> workers;
+    for (int32 i = 0; i < kSearchWindow && i < (int32)window.pages.size(); i++) {
+        thread_id worker = spawn_thread(_SearchWorkerEntry, "dlna_search",
+                                        B_LOW_PRIORITY, &window);
+        if (worker < 0)
+            break;
+        workers.push_back(worker);
+        resume_thread(worker);
+    }
+
+    bigtime_t started = system_time();
+    size_t merged = 0;
+    for (; !workers.empty() && merged < window.pages.size(); merged++) {
+        SearchWindow::Page& page = window.pages[merged];
+        for (;;) {
+            {
+                BAutolock lock(window.lock);
+                if (page.done)
+                    break;
             }
-            return err;
+            acquire_sem(window.finished);
         }
 
-        BString didl = _ExtractXmlTag(response, "Result");
-        if (didl.IsEmpty()) {
-            if (!allItems.empty())
+        if (page.status != B_OK) {
+            DEBUG_PRINT("_SearchPages partial success: error at index %lu\n",
+                        (unsigned long)page.start);
+            break;
+        }
+        /// A short page: the rest of it before anything after it.
+        uint32 covered = page.returned;
+        while (covered > 0 && covered < page.count && !page.items.empty()) {
+            std::vector<DLNABrowseItem> rest;
+            uint32 restReturned = 0;
+            uint32 total = 0;
+            if (_SearchPage(server, criteria, page.start + covered,
+                            page.count - covered, rest, restReturned, total) != B_OK
+                || restReturned == 0) {
                 break;
-            return B_ERROR;
+            }
+            page.items.insert(page.items.end(), rest.begin(), rest.end());
+            covered += restReturned;
         }
 
-        BString totalStr = _ExtractXmlTag(response, "TotalMatches");
-        if (!totalStr.IsEmpty()) {
-            totalMatches = (uint32)atoi(totalStr.String());
-        } else {
-            totalMatches = startIndex + requestedCount;
+        if (page.returned == 0 || page.items.empty()
+            || !handler(page.items, totalMatches, page.start + covered)) {
+            break;
         }
+        std::vector<DLNABrowseItem>().swap(page.items);
+    }
 
-        didl = _UnescapeXml(didl);
-        std::vector<DLNABrowseItem> pageResults;
-        _ParseDIDLLite(didl, pageResults);
+    window.last = -1;
+    status_t exitValue;
+    for (thread_id worker : workers)
+        wait_for_thread(worker, &exitValue);
+    delete_sem(window.finished);
 
-        for (const auto& item : pageResults) {
-            if (!item.isContainer && item.upnpClass.StartsWith("object.item.audioItem")) {
-                BString dedupKey = _DlnaDedupKey(item);
-                if (seenItems.find(dedupKey) == seenItems.end()) {
-                    seenItems.insert(dedupKey);
-                    allItems.push_back(item);
+    DEBUG_PRINT("_SearchPages '%s': %lu of %lu pages in %lld ms\n", criteria,
+                (unsigned long)merged, (unsigned long)window.pages.size(),
+                (long long)((system_time() - started) / 1000));
+    return B_OK;
+}
+
+/**
+ * @brief Uses the ContentDirectory Search action to fetch all audio items paginated.
+ *
+ * Items already in `allItems` came from the pages before `firstIndex`.
+ */
+status_t DLNAService::_SearchAudio(const DLNADevice& server,
+                                   std::vector<DLNABrowseItem>& allItems,
+                                   BMessenger progressTarget,
+                                   const CrawlPageHandler& pageHandler,
+                                   uint32 firstIndex)
+{
+    int32 lastReported = (int32)allItems.size();
+    std::set<BString> seenItems;
+    for (const auto& item : allItems)
+        seenItems.insert(_DlnaDedupKey(item));
+
+    status_t err = _SearchPages(server, "object.item.audioItem",
+        [&](const std::vector<DLNABrowseItem>& pageResults, uint32,
+            uint32 nextIndex) {
+            size_t before = allItems.size();
+            for (const auto& item : pageResults) {
+                if (!item.isContainer && item.upnpClass.StartsWith("object.item.audioItem")) {
+                    BString dedupKey = _DlnaDedupKey(item);
+                    if (seenItems.find(dedupKey) == seenItems.end()) {
+                        seenItems.insert(dedupKey);
+                        allItems.push_back(item);
+                    }
                 }
             }
-        }
 
-        BString returnedStr = _ExtractXmlTag(response, "NumberReturned");
-        uint32 numberReturned = 0;
-        if (!returnedStr.IsEmpty()) {
-            numberReturned = (uint32)atoi(returnedStr.String());
-        } else {
-            numberReturned = pageResults.size();
-        }
-
-        if (numberReturned == 0) break; ///< Reached the end
-
-        startIndex += numberReturned;
-
-        if ((int32)allItems.size() - lastReported >= 200) {
-            lastReported = (int32)allItems.size();
-            if (progressTarget.IsValid()) {
-                BMessage progress(MSG_DLNA_CRAWL_PROGRESS);
-                progress.AddInt32("count", lastReported);
-                progress.AddString("phase", "audio");
-                progress.AddString("server", server.friendlyName);
-                progressTarget.SendMessage(&progress);
+            if (pageHandler) {
+                DLNACrawlCheckpoint checkpoint;
+                checkpoint.nextIndex = nextIndex;
+                pageHandler(std::vector<DLNABrowseItem>(
+                                allItems.begin() + before, allItems.end()),
+                            &checkpoint);
             }
-        }
 
-        if (pageResults.empty()) break;
-        if (allItems.size() >= kMaxCrawlItems) break;
-    }
+            if ((int32)allItems.size() - lastReported >= 200) {
+                lastReported = (int32)allItems.size();
+                if (progressTarget.IsValid()) {
+                    BMessage progress(MSG_DLNA_CRAWL_PROGRESS);
+                    progress.AddInt32("count", lastReported);
+                    progress.AddString("phase", "audio");
+                    progress.AddString("server", server.friendlyName);
+                    progressTarget.SendMessage(&progress);
+                }
+            }
+            return allItems.size() < kMaxCrawlItems;
+        }, firstIndex);
+    if (err != B_OK && allItems.empty())
+        return err;
 
     if (progressTarget.IsValid()) {
         BMessage progress(MSG_DLNA_CRAWL_PROGRESS);
@@ -1205,75 +1891,421 @@ status_t DLNAService::_SearchAudio(const DLNADevice& server,
 status_t DLNAService::_SearchAlbumContainers(
     const DLNADevice& server, std::vector<DLNABrowseItem>& albumContainers,
     BMessenger progressTarget)
+{
+    status_t err = _SearchPages(server, "object.container.album.musicAlbum",
+        [&](const std::vector<DLNABrowseItem>& pageResults, uint32 totalMatches,
+            uint32) {
+            for (const auto& item : pageResults) {
+                if (item.isContainer &&
+                    item.upnpClass.StartsWith("object.container.album.musicAlbum")) {
+                    albumContainers.push_back(item);
+                }
+            }
+
+            if (progressTarget.IsValid()) {
+                BMessage progress(MSG_DLNA_CRAWL_PROGRESS);
+                progress.AddInt32("count", (int32)albumContainers.size());
+                progress.AddInt32("total", (int32)totalMatches);
+                progress.AddString("phase", "cover");
+                progress.AddString("server", server.friendlyName);
+                progressTarget.SendMessage(&progress);
+            }
+            return true;
+        });
+    return albumContainers.empty() ? err : B_OK;
+}
+
+status_t DLNAService::GetSystemUpdateID(const DLNADevice& server, uint32& updateId)
 {
     if (server.contentDirUrl.IsEmpty())
         return B_NOT_ALLOWED;
 
-    uint32 startIndex = 0;
-    uint32 requestedCount = 500;
-    uint32 totalMatches = 1;
+    BString response;
+    status_t err = _SendSoapAction(server.contentDirUrl,
+                                   "urn:schemas-upnp-org:service:ContentDirectory:1",
+                                   "GetSystemUpdateID", "", response);
+    if (err != B_OK)
+        return err;
 
-    while (startIndex < totalMatches) {
-        BString args;
-        args << "<ContainerID>0</ContainerID>"
-             << "<SearchCriteria>upnp:class derivedfrom &quot;object.container.album.musicAlbum&quot;</SearchCriteria>"
-             << "<Filter>*</Filter>"
-             << "<StartingIndex>" << startIndex << "</StartingIndex>"
-             << "<RequestedCount>" << requestedCount << "</RequestedCount>"
-             << "<SortCriteria></SortCriteria>";
+    BString id = _ExtractXmlTag(response, "Id");
+    if (id.IsEmpty())
+        return B_ERROR;
+    updateId = (uint32)strtoul(id.String(), NULL, 10);
+    return B_OK;
+}
 
-        BString response;
-        status_t err = _SendSoapAction(
-            server.contentDirUrl,
-            "urn:schemas-upnp-org:service:ContentDirectory:1", "Search",
-            args, response);
-        if (err != B_OK)
-            return albumContainers.empty() ? err : B_OK;
+/**
+ * @brief Re-browses the given containers and patches the cached items.
+ */
+status_t DLNAService::RefreshContainers(const DLNADevice& server,
+                                         const std::vector<BString>& containerIds,
+                                         std::vector<DLNABrowseItem>& items)
+{
+    std::set<BString> knownParents;
+    for (const auto& item : items)
+        knownParents.insert(item.parentId);
 
-        BString didl = _ExtractXmlTag(response, "Result");
-        if (didl.IsEmpty())
-            return albumContainers.empty() ? B_ERROR : B_OK;
+    std::set<BString> refreshed;
+    std::vector<DLNABrowseItem> found;
+    std::deque<std::pair<BString, int32>> queue;
+    for (const BString& id : containerIds)
+        queue.push_back({id, 0});
 
-        BString totalStr = _ExtractXmlTag(response, "TotalMatches");
-        if (!totalStr.IsEmpty())
-            totalMatches = (uint32)atoi(totalStr.String());
-        else
-            totalMatches = startIndex + requestedCount;
+    while (!queue.empty()) {
+        auto entry = queue.front();
+        queue.pop_front();
+        if (entry.second > kMaxCrawlDepth || !refreshed.insert(entry.first).second)
+            continue;
 
-        didl = _UnescapeXml(didl);
-        std::vector<DLNABrowseItem> pageResults;
-        _ParseDIDLLite(didl, pageResults);
+        std::vector<DLNABrowseItem> children;
+        status_t err = Browse(server, entry.first, children);
+        if (err != B_OK) {
+            DEBUG_PRINT("RefreshContainers: failed at '%s': %s\n",
+                        entry.first.String(), strerror(err));
+            return err;
+        }
 
-        for (const auto& item : pageResults) {
-            if (item.isContainer &&
-                item.upnpClass.StartsWith("object.container.album.musicAlbum")) {
-                albumContainers.push_back(item);
+        for (const auto& child : children) {
+            if (child.isContainer) {
+                if (child.upnpClass.StartsWith("object.container.video") ||
+                    child.upnpClass.StartsWith("object.container.image"))
+                    continue;
+                /// A container no cached item came from is new.
+                if (knownParents.find(child.id) == knownParents.end())
+                    queue.push_back({child.id, entry.second + 1});
+            } else if (child.upnpClass.StartsWith("object.item.audioItem")) {
+                found.push_back(child);
             }
         }
+    }
 
-        BString returnedStr = _ExtractXmlTag(response, "NumberReturned");
-        uint32 numberReturned = returnedStr.IsEmpty()
-                                    ? (uint32)pageResults.size()
-                                    : (uint32)atoi(returnedStr.String());
-        if (numberReturned == 0)
-            break;
+    /// Keep cover art a re-listed item no longer carries itself.
+    std::map<std::string, BString> artByParent;
+    for (const auto& item : items) {
+        if (!item.albumArtUrl.IsEmpty() && !item.parentId.IsEmpty())
+            artByParent[item.parentId.String()] = item.albumArtUrl;
+    }
 
-        startIndex += numberReturned;
+    std::vector<DLNABrowseItem> updated;
+    updated.reserve(items.size() + found.size());
+    std::set<BString> seenItems;
+    for (const auto& item : items) {
+        if (refreshed.find(item.parentId) != refreshed.end())
+            continue;
+        seenItems.insert(_DlnaDedupKey(item));
+        updated.push_back(item);
+    }
+    for (auto& item : found) {
+        if (item.albumArtUrl.IsEmpty()) {
+            auto art = artByParent.find(item.parentId.String());
+            if (art != artByParent.end())
+                item.albumArtUrl = art->second;
+        }
+        if (seenItems.insert(_DlnaDedupKey(item)).second)
+            updated.push_back(item);
+    }
 
-        if (progressTarget.IsValid()) {
-            BMessage progress(MSG_DLNA_CRAWL_PROGRESS);
-            progress.AddInt32("count", (int32)albumContainers.size());
-            progress.AddInt32("total", (int32)totalMatches);
-            progress.AddString("phase", "cover");
-            progress.AddString("server", server.friendlyName);
-            progressTarget.SendMessage(&progress);
+    DEBUG_PRINT("RefreshContainers: %zu containers, %zu -> %zu items\n",
+                refreshed.size(), items.size(), updated.size());
+    items.swap(updated);
+    return B_OK;
+}
+
+status_t DLNAService::SubscribeContentDirectory(const DLNADevice& server,
+                                                 const BString& callbackUrl)
+{
+    UnsubscribeContentDirectory();
+    if (server.contentDirEventUrl.IsEmpty() || callbackUrl.IsEmpty())
+        return B_NOT_SUPPORTED;
+
+    {
+        BAutolock lock(fEventLock);
+        fEventServerUuid = server.uuid;
+        fContentEvents.url = server.contentDirEventUrl;
+        fContentEvents.callback = callbackUrl;
+    }
+    return _Subscribe(fContentEvents, false);
+}
+
+void DLNAService::UnsubscribeContentDirectory()
+{
+    {
+        BAutolock lock(fEventLock);
+        fEventServerUuid = "";
+    }
+    _Unsubscribe(fContentEvents);
+}
+
+status_t DLNAService::SubscribeRendererEvents(const BString& callbackUrl)
+{
+    if (!fHasActiveRenderer || callbackUrl.IsEmpty())
+        return B_NOT_SUPPORTED;
+
+    {
+        /// Every track is started through here: keep what is running.
+        BAutolock lock(fEventLock);
+        if (!fTransportEvents.sid.IsEmpty()
+            && fTransportEvents.url == fActiveRenderer.avTransportEventUrl
+            && fTransportEvents.callback == callbackUrl)
+            return B_OK;
+    }
+
+    UnsubscribeRendererEvents();
+    {
+        BAutolock lock(fEventLock);
+        fTransportEvents.url = fActiveRenderer.avTransportEventUrl;
+        fTransportEvents.callback = callbackUrl;
+        fRenderingEvents.url = fActiveRenderer.renderingCtlEventUrl;
+        fRenderingEvents.callback = callbackUrl;
+    }
+    if (!fActiveRenderer.renderingCtlEventUrl.IsEmpty())
+        _Subscribe(fRenderingEvents, false);
+    if (fActiveRenderer.avTransportEventUrl.IsEmpty())
+        return B_NOT_SUPPORTED;
+    return _Subscribe(fTransportEvents, false);
+}
+
+void DLNAService::UnsubscribeRendererEvents()
+{
+    _Unsubscribe(fTransportEvents);
+    _Unsubscribe(fRenderingEvents);
+    fTransportEvented = false;
+    fRenderingEvented = false;
+}
+
+/**
+ * @brief Ends `subscription` at the device and forgets it.
+ */
+void DLNAService::_Unsubscribe(EventSubscription& subscription)
+{
+    BString url;
+    BString sid;
+    {
+        BAutolock lock(fEventLock);
+        url = subscription.url;
+        sid = subscription.sid;
+        subscription.url = "";
+        subscription.callback = "";
+        subscription.sid = "";
+    }
+    if (sid.IsEmpty())
+        return;
+
+    HttpConnectionPool::Request request;
+    request.method = "UNSUBSCRIBE";
+    request.url = url;
+    request.headers << "SID: " << sid << "\r\n";
+    request.timeout = 3000000;
+    HttpConnectionPool::Response reply;
+    HttpConnectionPool::Default().Fetch(request, reply);
+}
+
+/**
+ * @brief Renews `subscription` if it expires within `margin`, and
+ * subscribes anew if the device has forgotten it.
+ */
+void DLNAService::_RenewSubscription(EventSubscription& subscription,
+                                     bigtime_t margin)
+{
+    bool renew;
+    {
+        BAutolock lock(fEventLock);
+        renew = !subscription.sid.IsEmpty()
+            && subscription.expires - system_time() < margin;
+    }
+    if (renew && _Subscribe(subscription, true) != B_OK)
+        _Subscribe(subscription, false);
+}
+
+/**
+ * @brief Sends SUBSCRIBE for `subscription`: a new one, or a renewal of
+ * its SID.
+ */
+status_t DLNAService::_Subscribe(EventSubscription& subscription, bool renew)
+{
+    HttpConnectionPool::Request request;
+    request.method = "SUBSCRIBE";
+    {
+        BAutolock lock(fEventLock);
+        if (subscription.url.IsEmpty()
+            || (renew && subscription.sid.IsEmpty()))
+            return B_NO_INIT;
+        request.url = subscription.url;
+        if (renew)
+            request.headers << "SID: " << subscription.sid << "\r\n";
+        else {
+            request.headers << "CALLBACK: <" << subscription.callback
+                            << ">\r\n"
+                            << "NT: upnp:event\r\n";
         }
+    }
+    request.headers << "TIMEOUT: Second-" << kEventTimeout << "\r\n";
+
+    HttpConnectionPool::Response reply;
+    status_t status = HttpConnectionPool::Default().Fetch(request, reply);
+    if (status == B_OK && reply.status != 200)
+        status = B_ERROR;
+
+    BString sid;
+    bigtime_t timeout = kEventTimeout * 1000000LL;
+    if (status == B_OK) {
+        BString headers(reply.headers);
+        headers.Prepend("\r\n");
+        int32 sidAt = headers.IFindFirst("\r\nSID:");
+        if (sidAt >= 0) {
+            int32 end = headers.FindFirst("\r\n", sidAt + 2);
+            headers.CopyInto(sid, sidAt + 7, end - sidAt - 7);
+            sid.Trim();
+        }
+        int32 timeoutAt = headers.IFindFirst("Second-");
+        if (timeoutAt >= 0 && atol(headers.String() + timeoutAt + 7) > 0)
+            timeout = atol(headers.String() + timeoutAt + 7) * 1000000LL;
+        if (sid.IsEmpty())
+            status = B_ERROR;
+    }
+
+    BAutolock lock(fEventLock);
+    if (status != B_OK) {
+        DEBUG_PRINT("%s %s failed: %s\n", subscription.service,
+                    renew ? "renewal" : "subscription", strerror(status));
+        subscription.sid = "";
+        /// Without events the poll thread takes over again.
+        if (&subscription == &fTransportEvents)
+            fTransportEvented = false;
+        else if (&subscription == &fRenderingEvents)
+            fRenderingEvented = false;
+        return status;
+    }
+    subscription.sid = sid;
+    subscription.expires = system_time() + timeout;
+    DEBUG_PRINT("%s events: %s for %lld s\n", subscription.service,
+                sid.String(), (long long)(timeout / 1000000));
+    return B_OK;
+}
 
-        if (pageResults.empty())
+bool DLNAService::HandleEvent(const BString& sid, const BString& body)
+{
+    BString uuid;
+    bool transport;
+    bool rendering;
+    {
+        BAutolock lock(fEventLock);
+        if (sid.IsEmpty())
+            return false;
+        transport = sid == fTransportEvents.sid;
+        rendering = sid == fRenderingEvents.sid;
+        if (!transport && !rendering && sid != fContentEvents.sid)
+            return false;
+        uuid = fEventServerUuid;
+    }
+    if (transport || rendering) {
+        _HandleLastChange(body, transport);
+        return true;
+    }
+
+    BMessage changed(MSG_DLNA_CONTENT_CHANGED);
+    changed.AddString("uuid", uuid);
+
+    BString systemId = _ExtractXmlTag(body, "SystemUpdateID");
+    if (!systemId.IsEmpty())
+        changed.AddInt32("system_update_id", (int32)strtoul(systemId.String(), NULL, 10));
+
+    /// "id,updateId,id,updateId,..."
+    BString containers = _ExtractXmlTag(body, "ContainerUpdateIDs");
+    int32 start = 0;
+    while (start < containers.Length()) {
+        int32 comma = containers.FindFirst(',', start);
+        if (comma < 0)
             break;
+        int32 next = containers.FindFirst(',', comma + 1);
+        if (next < 0)
+            next = containers.Length();
+        BString id;
+        BString update;
+        containers.CopyInto(id, start, comma - start);
+        containers.CopyInto(update, comma + 1, next - comma - 1);
+        changed.AddString("container", _UnescapeXml(id));
+        changed.AddInt32("update_id", (int32)strtoul(update.String(), NULL, 10));
+        start = next + 1;
     }
 
-    return B_OK;
+    if (fTarget.IsValid())
+        fTarget.SendMessage(&changed);
+    return true;
+}
+
+namespace {
+
+/**
+ * @brief Collects the `val` of each state variable in a LastChange event;
+ * of channel-specific ones, the Master channel's.
+ */
+class LastChangeHandler : public XmlTokenizer::Handler {
+public:
+    void StartElement(const XmlTokenizer& tokenizer, const char* name) override
+    {
+        const char* value = tokenizer.Attribute("val");
+        if (value == nullptr || strcmp(name, "InstanceID") == 0)
+            return;
+        const char* channel = tokenizer.Attribute("channel");
+        if (channel != nullptr && strcmp(channel, "Master") != 0)
+            return;
+        values[name] = value;
+    }
+    void EndElement(const char* name) override {}
+    void Text(const char* text, size_t length) override {}
+
+    std::map<BString, BString> values;
+};
+
+} // namespace
+
+/**
+ * @brief Applies an AVTransport or RenderingControl LastChange event.
+ */
+void DLNAService::_HandleLastChange(const BString& body, bool transport)
+{
+    if (transport)
+        fTransportEvented = true;
+    else
+        fRenderingEvented = true;
+
+    BString lastChange = _UnescapeXml(_ExtractXmlTag(body, "LastChange"));
+    LastChangeHandler handler;
+    XmlTokenizer tokenizer(handler);
+    tokenizer.Feed(lastChange.String(), lastChange.Length());
+    const std::map<BString, BString>& values = handler.values;
+
+    if (transport) {
+        /// First: the switch to a queued track resets duration and position.
+        auto uri = values.find("CurrentTrackURI");
+        if (uri == values.end() || uri->second.IsEmpty())
+            uri = values.find("AVTransportURI");
+        if (uri != values.end() && !uri->second.IsEmpty())
+            _SetTrackUri(uri->second);
+        auto duration = values.find("CurrentTrackDuration");
+        if (duration != values.end() && duration->second.FindFirst(':') > 0)
+            fCurrentDuration = _ParseUpnpTime(duration->second);
+        /// Not evented by the standard, but some renderers do.
+        auto position = values.find("RelativeTimePosition");
+        if (position != values.end() && position->second.FindFirst(':') > 0)
+            _SetPosition(_ParseUpnpTime(position->second));
+        auto state = values.find("TransportState");
+        if (state != values.end() && !state->second.IsEmpty())
+            _SetTransportState(state->second);
+        return;
+    }
+
+    auto volume = values.find("Volume");
+    if (volume != values.end()) {
+        int32 percent = atoi(volume->second.String());
+        if (percent >= 0 && percent != fCurrentVolume.load()) {
+            fCurrentVolume = percent;
+            BMessage volMsg(MSG_DLNA_VOLUME_UPDATE);
+            volMsg.AddInt32("volume", percent);
+            fTarget.SendMessage(&volMsg);
+        }
+    }
 }
 
 /**
@@ -1282,40 +2314,61 @@ status_t DLNAService::_SearchAlbumContainers(
  * Traverses the server's ContentDirectory starting from the root ("0"),
  * collecting all playable audio items. Containers are expanded breadth-first.
  * Progress is reported via MSG_DLNA_CRAWL_PROGRESS every 50 items.
+ *
+ * New items go to `pageHandler` after every Search page and every browsed
+ * container. Search pages are each a checkpoint; the container walk makes
+ * one every kCrawlCheckpointItems items, as its checkpoint lists the whole
+ * queue.
  */
 status_t DLNAService::BrowseAll(const DLNADevice& server,
                                  std::vector<DLNABrowseItem>& allItems,
-                                 BMessenger progressTarget)
+                                 BMessenger progressTarget,
+                                 const CrawlPageHandler& pageHandler,
+                                 const DLNACrawlCheckpoint* resume)
 {
-    /// 1. Try the fast Search method first
-    status_t err = _SearchAudio(server, allItems, progressTarget);
-    if (err == B_OK && !allItems.empty()) {
-        DEBUG_PRINT("BrowseAll: SearchAudio succeeded, found %zu items\n", allItems.size());
-        return B_OK;
-    }
+    status_t err = B_OK;
+    if (resume == nullptr || resume->search) {
+        /// 1. Try the fast Search method first
+        err = _SearchAudio(server, allItems, progressTarget, pageHandler,
+                           resume != nullptr ? resume->nextIndex : 0);
+        if (err == B_OK && !allItems.empty()) {
+            DEBUG_PRINT("BrowseAll: SearchAudio succeeded, found %zu items\n", allItems.size());
+            return B_OK;
+        }
 
-    DEBUG_PRINT("BrowseAll: SearchAudio failed or empty (%s). Falling back to BFS crawl...\n", strerror(err));
-    allItems.clear();
+        DEBUG_PRINT("BrowseAll: SearchAudio failed or empty (%s). Falling back to BFS crawl...\n", strerror(err));
+        allItems.clear();
+        resume = nullptr;
+    }
 
     if (progressTarget.IsValid()) {
         BMessage progress(MSG_DLNA_CRAWL_PROGRESS);
-        progress.AddInt32("count", 0);
+        progress.AddInt32("count", (int32)allItems.size());
         progress.AddString("phase", "browse");
         progress.AddString("server", server.friendlyName);
         progressTarget.SendMessage(&progress);
     }
 
-    struct QueueEntry {
-        BString objectId;
-        int32 depth;
-    };
+    /// The art of a queued container is kept with it for the checkpoint.
+    typedef DLNACrawlCheckpoint::Container QueueEntry;
 
     std::deque<QueueEntry> queue;
-    queue.push_back({"0", 0});
-
     std::set<BString> seenItems;
     std::map<std::string, BString> artByContainerId;
-    int32 lastReported = 0;
+    if (resume != nullptr) {
+        queue.assign(resume->pending.begin(), resume->pending.end());
+        for (const auto& entry : queue) {
+            if (!entry.albumArtUrl.IsEmpty())
+                artByContainerId[entry.objectId.String()] = entry.albumArtUrl;
+        }
+        for (const auto& item : allItems)
+            seenItems.insert(_DlnaDedupKey(item));
+    } else {
+        queue.push_back({"0", 0, BString()});
+    }
+
+    int32 lastReported = (int32)allItems.size();
+    size_t lastCheckpoint = allItems.size();
 
     while (!queue.empty()) {
         QueueEntry entry = queue.front();
@@ -1332,6 +2385,8 @@ status_t DLNAService::BrowseAll(const DLNADevice& server,
             continue;
         }
 
+        size_t before = allItems.size();
+
         for (const auto& item : results) {
             if (item.isContainer) {
 
@@ -1341,7 +2396,7 @@ status_t DLNAService::BrowseAll(const DLNADevice& server,
                 }
                 if (!item.id.IsEmpty() && !item.albumArtUrl.IsEmpty())
                     artByContainerId[item.id.String()] = item.albumArtUrl;
-                queue.push_back({item.id, entry.depth + 1});
+                queue.push_back({item.id, entry.depth + 1, item.albumArtUrl});
             } else {
 
                 if (!item.upnpClass.StartsWith("object.item.audioItem")) {
@@ -1363,6 +2418,20 @@ status_t DLNAService::BrowseAll(const DLNADevice& server,
             }
         }
 
+        if (pageHandler && allItems.size() > before) {
+            std::vector<DLNABrowseItem> added(allItems.begin() + before,
+                                              allItems.end());
+            if (allItems.size() - lastCheckpoint >= (size_t)kCrawlCheckpointItems) {
+                lastCheckpoint = allItems.size();
+                DLNACrawlCheckpoint checkpoint;
+                checkpoint.search = false;
+                checkpoint.pending.assign(queue.begin(), queue.end());
+                pageHandler(added, &checkpoint);
+            } else {
+                pageHandler(added, nullptr);
+            }
+        }
+
         if ((int32)allItems.size() - lastReported >= 50) {
             lastReported = (int32)allItems.size();
             if (progressTarget.IsValid()) {
@@ -1385,13 +2454,15 @@ status_t DLNAService::BrowseAll(const DLNADevice& server,
     return B_OK;
 }
 
-static const uint32 kCacheMagic = 'DLCA';
-static const uint32 kCacheVersion = 1;
+/// The length-prefixed stream format, still used by crawl checkpoints;
+/// server caches are written by DLNACacheWriter since version 3.
+static const uint32 kCacheMagic = kDlnaCacheMagic;
+static const uint32 kCacheVersion = 2;
 
 /**
  * @brief Derives the cache file path for a given server UUID.
  */
-BPath DLNAService::_CachePath(const BString& uuid) const
+BPath DLNAService::_CachePath(const BString& uuid, const char* suffix) const
 {
     BPath path;
     find_directory(B_USER_SETTINGS_DIRECTORY, &path);
@@ -1402,7 +2473,7 @@ BPath DLNAService::_CachePath(const BString& uuid) const
         create_directory(path.Path(), 0755);
 
     BString filename("dlna_");
-    filename << uuid << ".cache";
+    filename << uuid << suffix;
     path.Append(filename.String());
     return path;
 }
@@ -1444,37 +2515,65 @@ static status_t _ReadString(BFile& file, BString& str)
 }
 
 /**
- * @brief Saves the browse results for a server to a binary cache file.
+ * @brief Writes the cached fields of a browse item.
  */
-status_t DLNAService::SaveServerCache(const BString& uuid,
-                                       const std::vector<DLNABrowseItem>& items)
+static status_t _WriteItem(BFile& file, const DLNABrowseItem& item)
 {
-    BPath cachePath = _CachePath(uuid);
-    BFile file(cachePath.Path(), B_WRITE_ONLY | B_CREATE_FILE | B_ERASE_FILE);
-    if (file.InitCheck() != B_OK) {
-        DEBUG_PRINT("Cache: cannot create '%s'\n", cachePath.Path());
-        return file.InitCheck();
+    const BString* fields[] = {
+        &item.title, &item.artist, &item.album, &item.genre,
+        &item.resourceUrl, &item.mimeType, &item.duration,
+        &item.albumArtUrl, &item.id, &item.parentId
+    };
+    for (const BString* field : fields) {
+        if (_WriteString(file, *field) != B_OK)
+            return B_IO_ERROR;
     }
+    return B_OK;
+}
 
-    uint32 magic = kCacheMagic;
-    uint32 version = kCacheVersion;
-    uint32 count = (uint32)items.size();
-    int64 timestamp = system_time();
+/**
+ * @brief Reads a browse item written by _WriteItem() with cache `version`.
+ */
+static status_t _ReadItem(BFile& file, DLNABrowseItem& item, uint32 version)
+{
+    if (_ReadString(file, item.title) != B_OK
+        || _ReadString(file, item.artist) != B_OK
+        || _ReadString(file, item.album) != B_OK
+        || _ReadString(file, item.genre) != B_OK
+        || _ReadString(file, item.resourceUrl) != B_OK
+        || _ReadString(file, item.mimeType) != B_OK
+        || _ReadString(file, item.duration) != B_OK
+        || _ReadString(file, item.albumArtUrl) != B_OK)
+        return B_IO_ERROR;
+    if (version >= 2) {
+        if (_ReadString(file, item.id) != B_OK
+            || _ReadString(file, item.parentId) != B_OK)
+            return B_IO_ERROR;
+    }
+    item.isContainer = false;
+    return B_OK;
+}
 
-    file.Write(&magic, sizeof(magic));
-    file.Write(&version, sizeof(version));
-    file.Write(&count, sizeof(count));
-    file.Write(&timestamp, sizeof(timestamp));
+/**
+ * @brief Saves the browse results for a server as a mapped v3 cache.
+ */
+status_t DLNAService::SaveServerCache(const BString& uuid,
+                                       const std::vector<DLNABrowseItem>& items,
+                                       const DLNAContentState& state)
+{
+    BPath cachePath = _CachePath(uuid);
 
-    for (const auto& item : items) {
-        _WriteString(file, item.title);
-        _WriteString(file, item.artist);
-        _WriteString(file, item.album);
-        _WriteString(file, item.genre);
-        _WriteString(file, item.resourceUrl);
-        _WriteString(file, item.mimeType);
-        _WriteString(file, item.duration);
-        _WriteString(file, item.albumArtUrl);
+    DLNACacheWriter writer;
+    writer.Reserve(items.size());
+    for (const auto& item : items)
+        writer.AddItem(item);
+    writer.SetState(state);
+
+    status_t status = writer.WriteTo(cachePath.Path());
+    if (status != B_OK) {
+        DEBUG_PRINT("Cache: cannot write '%s': %s\n", cachePath.Path(),
+                    strerror(status));
+        return status;
     }
 
     DEBUG_PRINT("Cache: saved %lu items to '%s'\n",
@@ -1483,13 +2582,13 @@ status_t DLNAService::SaveServerCache(const BString& uuid,
 }
 
 /**
- * @brief Loads the browse results for a server from its binary cache file.
+ * @brief Reads a v1/v2 stream cache, as written before the mapped format.
  */
-status_t DLNAService::LoadServerCache(const BString& uuid,
-                                       std::vector<DLNABrowseItem>& items)
+static status_t _LoadStreamCache(const char* path,
+                                 std::vector<DLNABrowseItem>& items,
+                                 DLNAContentState& loaded)
 {
-    BPath cachePath = _CachePath(uuid);
-    BFile file(cachePath.Path(), B_READ_ONLY);
+    BFile file(path, B_READ_ONLY);
     if (file.InitCheck() != B_OK)
         return B_ENTRY_NOT_FOUND;
 
@@ -1498,39 +2597,378 @@ status_t DLNAService::LoadServerCache(const BString& uuid,
 
     if (file.Read(&magic, sizeof(magic)) != sizeof(magic) || magic != kCacheMagic)
         return B_BAD_DATA;
-    if (file.Read(&version, sizeof(version)) != sizeof(version) || version != kCacheVersion)
+    /// Version 1 had no change counters and no object IDs.
+    if (file.Read(&version, sizeof(version)) != sizeof(version)
+        || version < 1 || version > kCacheVersion)
         return B_BAD_DATA;
     if (file.Read(&count, sizeof(count)) != sizeof(count))
         return B_BAD_DATA;
     if (file.Read(&timestamp, sizeof(timestamp)) != sizeof(timestamp))
         return B_BAD_DATA;
 
+    if (version >= 2) {
+        uint8 hasSystemUpdateId = 0;
+        uint32 containerCount = 0;
+        if (file.Read(&hasSystemUpdateId, sizeof(hasSystemUpdateId)) != sizeof(hasSystemUpdateId)
+            || file.Read(&loaded.systemUpdateId, sizeof(loaded.systemUpdateId))
+                != sizeof(loaded.systemUpdateId)
+            || file.Read(&containerCount, sizeof(containerCount)) != sizeof(containerCount))
+            return B_BAD_DATA;
+        loaded.hasSystemUpdateId = hasSystemUpdateId != 0;
+        for (uint32 i = 0; i < containerCount; i++) {
+            BString id;
+            uint32 updateId = 0;
+            if (_ReadString(file, id) != B_OK
+                || file.Read(&updateId, sizeof(updateId)) != sizeof(updateId))
+                return B_BAD_DATA;
+            loaded.containerUpdateIds[id] = updateId;
+        }
+    }
+
     items.clear();
     items.reserve(count);
 
     for (uint32 i = 0; i < count; i++) {
         DLNABrowseItem item;
-        if (_ReadString(file, item.title) != B_OK) break;
-        if (_ReadString(file, item.artist) != B_OK) break;
-        if (_ReadString(file, item.album) != B_OK) break;
-        if (_ReadString(file, item.genre) != B_OK) break;
-        if (_ReadString(file, item.resourceUrl) != B_OK) break;
-        if (_ReadString(file, item.mimeType) != B_OK) break;
-        if (_ReadString(file, item.duration) != B_OK) break;
-        if (_ReadString(file, item.albumArtUrl) != B_OK) break;
-        item.isContainer = false;
+        if (_ReadItem(file, item, version) != B_OK)
+            break;
         items.push_back(item);
     }
+    return B_OK;
+}
+
+/**
+ * @brief Loads the browse results for a server from its binary cache file.
+ *
+ * A v3 cache is mapped and each distinct string is copied out once, so the
+ * artist, album and genre of many tracks share one buffer. Older stream
+ * caches are still read; the next save converts them.
+ */
+status_t DLNAService::LoadServerCache(const BString& uuid,
+                                       std::vector<DLNABrowseItem>& items,
+                                       DLNAContentState* state)
+{
+    BPath cachePath = _CachePath(uuid);
+    DLNAContentState loaded;
+
+    DLNACacheReader reader;
+    status_t status = reader.Open(cachePath.Path());
+    if (status == B_OK) {
+        const uint32 count = reader.CountItems();
+        items.clear();
+        items.resize(count);
+        for (uint32 i = 0; i < count; i++)
+            reader.ReadItem(i, items[i]);
+        reader.ReadState(loaded);
+
+        const CacheLoadStats& stats = reader.LoadStats();
+        DEBUG_PRINT("Cache: %s, %llu of %llu bytes read in %lld us, "
+                    "decompressed in %lld us\n",
+                    CacheCompression::Name(stats.codec),
+                    (unsigned long long)stats.fileBytes,
+                    (unsigned long long)stats.rawBytes,
+                    (long long)stats.readTime,
+                    (long long)stats.decompressTime);
+    } else if (status == B_BAD_DATA) {
+        status = _LoadStreamCache(cachePath.Path(), items, loaded);
+        if (status != B_OK)
+            return status;
+    } else {
+        return B_ENTRY_NOT_FOUND;
+    }
+
+    if (state != nullptr)
+        *state = loaded;
 
     DEBUG_PRINT("Cache: loaded %zu items from '%s'\n",
                 items.size(), cachePath.Path());
     return B_OK;
 }
 
+static const uint32 kCheckpointMagic = 'DLCK';
+static const uint32 kCheckpointVersion = 1;
+
+/**
+ * @brief Appends one checkpoint record to a server's checkpoint file.
+ *
+ * The file holds a header with the SystemUpdateID the crawl started at,
+ * then records of the items found since the last record followed by the
+ * checkpoint after them. A record cut short by a crash is ignored when
+ * loading, so the file only ever grows by what is new.
+ */
+status_t DLNAService::AppendCrawlCheckpoint(const BString& uuid,
+                                             const DLNAContentState& state,
+                                             const std::vector<DLNABrowseItem>& items,
+                                             const DLNACrawlCheckpoint& checkpoint)
+{
+    BPath path = _CachePath(uuid, ".partial");
+    BFile file(path.Path(), B_WRITE_ONLY | B_CREATE_FILE | B_OPEN_AT_END);
+    if (file.InitCheck() != B_OK)
+        return file.InitCheck();
+
+    off_t size = 0;
+    if (file.GetSize(&size) != B_OK)
+        return B_IO_ERROR;
+    if (size == 0) {
+        uint32 magic = kCheckpointMagic;
+        uint32 version = kCheckpointVersion;
+        uint8 hasSystemUpdateId = state.hasSystemUpdateId ? 1 : 0;
+        uint32 systemUpdateId = state.systemUpdateId;
+        file.Write(&magic, sizeof(magic));
+        file.Write(&version, sizeof(version));
+        file.Write(&hasSystemUpdateId, sizeof(hasSystemUpdateId));
+        file.Write(&systemUpdateId, sizeof(systemUpdateId));
+    }
+
+    uint32 count = (uint32)items.size();
+    if (file.Write(&count, sizeof(count)) != sizeof(count))
+        return B_IO_ERROR;
+    for (const auto& item : items) {
+        if (_WriteItem(file, item) != B_OK)
+            return B_IO_ERROR;
+    }
+
+    uint8 search = checkpoint.search ? 1 : 0;
+    uint32 pendingCount = (uint32)checkpoint.pending.size();
+    file.Write(&search, sizeof(search));
+    file.Write(&checkpoint.nextIndex, sizeof(checkpoint.nextIndex));
+    if (file.Write(&pendingCount, sizeof(pendingCount)) != sizeof(pendingCount))
+        return B_IO_ERROR;
+    for (const auto& container : checkpoint.pending) {
+        if (_WriteString(file, container.objectId) != B_OK
+            || file.Write(&container.depth, sizeof(container.depth))
+                != sizeof(container.depth)
+            || _WriteString(file, container.albumArtUrl) != B_OK)
+            return B_IO_ERROR;
+    }
+    return B_OK;
+}
+
+/**
+ * @brief Reads the checkpoint file record by record and truncates it after
+ * the last complete one, so further records continue from there.
+ */
+status_t DLNAService::LoadCrawlCheckpoint(const BString& uuid,
+                                           std::vector<DLNABrowseItem>& items,
+                                           DLNAContentState& state,
+                                           DLNACrawlCheckpoint& checkpoint)
+{
+    BPath path = _CachePath(uuid, ".partial");
+    BFile file(path.Path(), B_READ_WRITE);
+    if (file.InitCheck() != B_OK)
+        return B_ENTRY_NOT_FOUND;
+
+    uint32 magic = 0, version = 0;
+    uint8 hasSystemUpdateId = 0;
+    DLNAContentState loaded;
+    if (file.Read(&magic, sizeof(magic)) != sizeof(magic)
+        || magic != kCheckpointMagic
+        || file.Read(&version, sizeof(version)) != sizeof(version)
+        || version != kCheckpointVersion
+        || file.Read(&hasSystemUpdateId, sizeof(hasSystemUpdateId))
+            != sizeof(hasSystemUpdateId)
+        || file.Read(&loaded.systemUpdateId, sizeof(loaded.systemUpdateId))
+            != sizeof(loaded.systemUpdateId))
+        return B_ENTRY_NOT_FOUND;
+    loaded.hasSystemUpdateId = hasSystemUpdateId != 0;
+
+    std::vector<DLNABrowseItem> found;
+    DLNACrawlCheckpoint last;
+    size_t complete = 0;
+    off_t completeEnd = file.Position();
+    bool any = false;
+
+    for (;;) {
+        uint32 count = 0;
+        if (file.Read(&count, sizeof(count)) != sizeof(count))
+            break;
+        bool ok = true;
+        for (uint32 i = 0; i < count && ok; i++) {
+            DLNABrowseItem item;
+            ok = _ReadItem(file, item, kCacheVersion) == B_OK;
+            if (ok)
+                found.push_back(item);
+        }
+
+        DLNACrawlCheckpoint next;
+        uint8 search = 0;
+        uint32 pendingCount = 0;
+        ok = ok && file.Read(&search, sizeof(search)) == sizeof(search)
+            && file.Read(&next.nextIndex, sizeof(next.nextIndex))
+                == sizeof(next.nextIndex)
+            && file.Read(&pendingCount, sizeof(pendingCount))
+                == sizeof(pendingCount);
+        for (uint32 i = 0; i < pendingCount && ok; i++) {
+            DLNACrawlCheckpoint::Container container;
+            ok = _ReadString(file, container.objectId) == B_OK
+                && file.Read(&container.depth, sizeof(container.depth))
+                    == sizeof(container.depth)
+                && _ReadString(file, container.albumArtUrl) == B_OK;
+            if (ok)
+                next.pending.push_back(container);
+        }
+        if (!ok)
+            break;
+
+        next.search = search != 0;
+        last = next;
+        complete = found.size();
+        completeEnd = file.Position();
+        any = true;
+    }
+
+    file.SetSize(completeEnd);
+    if (!any)
+        return B_ENTRY_NOT_FOUND;
+
+    found.resize(complete);
+    items.swap(found);
+    state = loaded;
+    checkpoint = last;
+    DEBUG_PRINT("Cache: resuming crawl with %zu items from '%s'\n",
+                items.size(), path.Path());
+    return B_OK;
+}
+
+void DLNAService::DeleteCrawlCheckpoint(const BString& uuid)
+{
+    BPath path = _CachePath(uuid, ".partial");
+    BEntry entry(path.Path());
+    if (entry.Exists())
+        entry.Remove();
+}
+
+static const uint32 kDeviceCacheMagic = 'DLDV';
+static const uint32 kDeviceCacheVersion = 1;
+
+/**
+ * @brief Restores the description cache and lists its devices unverified.
+ *
+ * Entries not verified for kDescriptionCacheAge are dropped. Called before
+ * the discovery thread starts, so fDevices is still ours to fill.
+ */
+void DLNAService::_LoadDeviceCache()
+{
+    fDescriptionsLoaded = true;
+
+    /// UDNs start with "uuid:", so this name cannot meet a server cache.
+    BPath cachePath = _CachePath("devices");
+    BFile file(cachePath.Path(), B_READ_ONLY);
+    if (file.InitCheck() != B_OK)
+        return;
+
+    uint32 magic = 0, version = 0, count = 0;
+    if (file.Read(&magic, sizeof(magic)) != sizeof(magic)
+        || magic != kDeviceCacheMagic
+        || file.Read(&version, sizeof(version)) != sizeof(version)
+        || version != kDeviceCacheVersion
+        || file.Read(&count, sizeof(count)) != sizeof(count))
+        return;
+
+    int64 oldest = (int64)real_time_clock() - kDescriptionCacheAge;
+    bigtime_t now = system_time();
+
+    for (uint32 i = 0; i < count; i++) {
+        CachedDescription entry;
+        DLNADevice& dev = entry.device;
+        int32 type = 0;
+        if (file.Read(&entry.seen, sizeof(entry.seen)) != sizeof(entry.seen)
+            || file.Read(&type, sizeof(type)) != sizeof(type)
+            || file.Read(&dev.bootId, sizeof(dev.bootId)) != sizeof(dev.bootId)
+            || file.Read(&dev.configId, sizeof(dev.configId))
+                != sizeof(dev.configId))
+            break;
+        if (_ReadString(file, dev.location) != B_OK) break;
+        if (_ReadString(file, dev.friendlyName) != B_OK) break;
+        if (_ReadString(file, dev.uuid) != B_OK) break;
+        if (_ReadString(file, dev.contentDirUrl) != B_OK) break;
+        if (_ReadString(file, dev.contentDirEventUrl) != B_OK) break;
+        if (_ReadString(file, dev.avTransportUrl) != B_OK) break;
+        if (_ReadString(file, dev.avTransportEventUrl) != B_OK) break;
+        if (_ReadString(file, dev.renderingCtlUrl) != B_OK) break;
+        if (_ReadString(file, dev.renderingCtlEventUrl) != B_OK) break;
+        if (_ReadString(file, dev.connectionMgrUrl) != B_OK) break;
+
+        if (entry.seen < oldest || dev.location.IsEmpty()) {
+            fDescriptionsDirty = true;
+            continue;
+        }
+        dev.type = type == DLNADevice::MediaRenderer
+            ? DLNADevice::MediaRenderer : DLNADevice::MediaServer;
+        dev.verified = false;
+        dev.lastSeen = now;
+        fDescriptions[dev.location] = entry;
+
+        bool listed = false;
+        for (const auto& d : fDevices) {
+            if (d.location == dev.location) {
+                listed = true;
+                break;
+            }
+        }
+        if (listed)
+            continue;
+        fDevices.push_back(dev);
+
+        if (fTarget.IsValid()) {
+            BMessage msg(MSG_DLNA_DEVICE_FOUND);
+            msg.AddString("name", dev.friendlyName);
+            msg.AddString("uuid", dev.uuid);
+            msg.AddInt32("type", (int32)dev.type);
+            fTarget.SendMessage(&msg);
+        }
+    }
+
+    DEBUG_PRINT("Cache: restored %zu device descriptions\n",
+                fDescriptions.size());
+}
+
+/**
+ * @brief Writes the description cache; runs on the discovery thread.
+ */
+void DLNAService::_SaveDeviceCache()
+{
+    fDescriptionsDirty = false;
+
+    BPath cachePath = _CachePath("devices");
+    BFile file(cachePath.Path(), B_WRITE_ONLY | B_CREATE_FILE | B_ERASE_FILE);
+    if (file.InitCheck() != B_OK) {
+        DEBUG_PRINT("Cache: cannot create '%s'\n", cachePath.Path());
+        return;
+    }
+
+    uint32 magic = kDeviceCacheMagic;
+    uint32 version = kDeviceCacheVersion;
+    uint32 count = (uint32)fDescriptions.size();
+    file.Write(&magic, sizeof(magic));
+    file.Write(&version, sizeof(version));
+    file.Write(&count, sizeof(count));
+
+    for (const auto& pair : fDescriptions) {
+        const DLNADevice& dev = pair.second.device;
+        int32 type = (int32)dev.type;
+        file.Write(&pair.second.seen, sizeof(pair.second.seen));
+        file.Write(&type, sizeof(type));
+        file.Write(&dev.bootId, sizeof(dev.bootId));
+        file.Write(&dev.configId, sizeof(dev.configId));
+        _WriteString(file, dev.location);
+        _WriteString(file, dev.friendlyName);
+        _WriteString(file, dev.uuid);
+        _WriteString(file, dev.contentDirUrl);
+        _WriteString(file, dev.contentDirEventUrl);
+        _WriteString(file, dev.avTransportUrl);
+        _WriteString(file, dev.avTransportEventUrl);
+        _WriteString(file, dev.renderingCtlUrl);
+        _WriteString(file, dev.renderingCtlEventUrl);
+        _WriteString(file, dev.connectionMgrUrl);
+    }
+}
+
 /**
  * @brief Deletes the cache file for a specific server.
  */
 status_t DLNAService::DeleteServerCache(const BString& uuid) {
+    DeleteCrawlCheckpoint(uuid);
     BPath path = _CachePath(uuid);
     BEntry entry(path.Path());
     if (!entry.Exists())
@@ -2,15 +2,22 @@
 #define BETON_DLNA_SERVICE_H
 
 #include "DLNADeviceInfo.h"
+#include "HttpConnectionPool.h"
 
+#include <Locker.h>
 #include <Messenger.h>
 #include <OS.h>
 #include <Path.h>
 #include <String.h>
 #include <UrlContext.h>
 #include <atomic>
+#include <functional>
+#include <map>
+#include <memory>
 #include <vector>
 
+class DidlParser;
+
 /**
  * @struct DLNABrowseItem
  * @brief Represents a single item or container returned by ContentDirectory Browse.
@@ -34,6 +41,35 @@ struct DLNABrowseItem {
     DLNABrowseItem() : isContainer(false) {}
 };
 
+/**
+ * @struct DLNAContentState
+ * @brief Change counters of a MediaServer's ContentDirectory, kept with its
+ * cache to tell whether the cache is still current.
+ */
+struct DLNAContentState {
+    bool    hasSystemUpdateId = false;
+    uint32  systemUpdateId = 0;   ///< Bumped by the server on any change.
+    /// Last ContainerUpdateIDs value seen per container, from events.
+    std::map<BString, uint32> containerUpdateIds;
+};
+
+/**
+ * @struct DLNACrawlCheckpoint
+ * @brief Where an interrupted BrowseAll() can pick up again.
+ */
+struct DLNACrawlCheckpoint {
+    /** @brief A container still to be browsed by the container walk. */
+    struct Container {
+        BString objectId;
+        int32   depth = 0;
+        BString albumArtUrl;  ///< Inherited by its items without cover.
+    };
+
+    bool    search = true;    ///< Search pages; false for the container walk.
+    uint32  nextIndex = 0;    ///< StartingIndex of the next Search page.
+    std::vector<Container> pending; ///< Containers not browsed yet, in order.
+};
+
 /**
  * @class DLNAService
  * @brief Manages UPnP/DLNA device discovery, server browsing, and renderer control.
@@ -85,6 +121,25 @@ public:
 
     ///@}
 
+    /** @name Media server advertising */
+    ///@{
+
+    /**
+     * @brief Announces a local MediaServer with SSDP NOTIFY and answers
+     * M-SEARCH requests for it, until StopAdvertising().
+     * @param location URL of the device description.
+     * @param udn Device UDN, "uuid:...".
+     * @return B_OK, or an error if the thread could not be started.
+     */
+    status_t StartAdvertising(const BString& location, const BString& udn);
+
+    /**
+     * @brief Sends ssdp:byebye for the advertised server and stops.
+     */
+    void StopAdvertising();
+
+    ///@}
+
     /** @name Input: MediaServer Browsing */
     ///@{
 
@@ -103,6 +158,15 @@ public:
     status_t Browse(const DLNADevice& server, const BString& objectId,
                     std::vector<DLNABrowseItem>& results);
 
+    /**
+     * @brief Receives the items a crawl added, as they arrive.
+     *
+     * Called on the crawling thread. `checkpoint` tells where the crawl
+     * would go on after these items, or is null between checkpoints.
+     */
+    typedef std::function<void(const std::vector<DLNABrowseItem>& items,
+                               const DLNACrawlCheckpoint* checkpoint)> CrawlPageHandler;
+
     /**
      * @brief Recursively browses all containers on a MediaServer.
      *
@@ -113,11 +177,85 @@ public:
      * @param server The server to crawl.
      * @param allItems Output vector of all playable items found.
      * @param progressTarget Messenger to receive progress updates.
+     * @param pageHandler If set, handed each batch of new items.
+     * @param resume Checkpoint to go on from; `allItems` must then hold the
+     *        items found before it.
      * @return B_OK on success, error code otherwise.
      */
     status_t BrowseAll(const DLNADevice& server,
                        std::vector<DLNABrowseItem>& allItems,
-                       BMessenger progressTarget);
+                       BMessenger progressTarget,
+                       const CrawlPageHandler& pageHandler = CrawlPageHandler(),
+                       const DLNACrawlCheckpoint* resume = nullptr);
+
+    /**
+     * @brief Re-browses changed containers and updates `items` in place.
+     *
+     * The audio items directly in each container are replaced by what the
+     * server lists now; child containers no item came from yet are new and
+     * are browsed as well.
+     *
+     * @param containerIds ObjectIDs of the changed containers.
+     * @param items Cached items of the server, with their parentId.
+     * @return B_OK on success; on error `items` is left as it was.
+     */
+    status_t RefreshContainers(const DLNADevice& server,
+                               const std::vector<BString>& containerIds,
+                               std::vector<DLNABrowseItem>& items);
+
+    /**
+     * @brief Asks a MediaServer for its current SystemUpdateID.
+     */
+    status_t GetSystemUpdateID(const DLNADevice& server, uint32& updateId);
+
+    ///@}
+
+    /** @name GENA events */
+    ///@{
+
+    /**
+     * @brief Subscribes to ContentDirectory events of `server`, replacing
+     * any earlier subscription.
+     *
+     * Changes are announced to the target with MSG_DLNA_CONTENT_CHANGED
+     * ("uuid", "system_update_id", and pairs of "container"/"update_id").
+     * The subscription is renewed by the discovery loop.
+     *
+     * @param callbackUrl URL the server sends its NOTIFY requests to.
+     */
+    status_t SubscribeContentDirectory(const DLNADevice& server,
+                                       const BString& callbackUrl);
+
+    /**
+     * @brief Ends the current ContentDirectory subscription, if any.
+     */
+    void UnsubscribeContentDirectory();
+
+    /**
+     * @brief Subscribes to AVTransport and RenderingControl events of the
+     * active renderer, replacing any earlier renderer subscription.
+     *
+     * While the renderer sends LastChange events, transport state and
+     * volume come from them, the position is interpolated locally and
+     * GetPositionInfo is asked only every kEventResyncInterval; without
+     * events, polling falls back to kFallbackPollInterval.
+     *
+     * @param callbackUrl URL the renderer sends its NOTIFY requests to.
+     */
+    status_t SubscribeRendererEvents(const BString& callbackUrl);
+
+    /**
+     * @brief Ends the renderer subscriptions, if any.
+     */
+    void UnsubscribeRendererEvents();
+
+    /**
+     * @brief Handles a NOTIFY request of a subscribed device. Thread-safe.
+     * @param sid The request's SID header.
+     * @param body The request's property set.
+     * @return False for an unknown subscription.
+     */
+    bool HandleEvent(const BString& sid, const BString& body);
 
     ///@}
 
@@ -131,16 +269,19 @@ public:
      * @return B_OK on success.
      */
     status_t SaveServerCache(const BString& uuid,
-                             const std::vector<DLNABrowseItem>& items);
+                             const std::vector<DLNABrowseItem>& items,
+                             const DLNAContentState& state = DLNAContentState());
 
     /**
      * @brief Loads a server's browse results from the binary disk cache.
      * @param uuid Server UUID used to derive the cache filename.
      * @param items Output vector populated from cache.
+     * @param state If given, set to the change counters saved with it.
      * @return B_OK on success, B_ENTRY_NOT_FOUND if no cache exists.
      */
     status_t LoadServerCache(const BString& uuid,
-                             std::vector<DLNABrowseItem>& items);
+                             std::vector<DLNABrowseItem>& items,
+                             DLNAContentState* state = nullptr);
 
     /**
      * @brief Deletes the cache file for a specific server.
@@ -149,6 +290,29 @@ public:
      */
     status_t DeleteServerCache(const BString& uuid);
 
+    /**
+     * @brief Appends crawl results and where to go on to a server's
+     * checkpoint file, creating it with `state` if needed.
+     * @param items Items found since the previous checkpoint.
+     */
+    status_t AppendCrawlCheckpoint(const BString& uuid,
+                                   const DLNAContentState& state,
+                                   const std::vector<DLNABrowseItem>& items,
+                                   const DLNACrawlCheckpoint& checkpoint);
+
+    /**
+     * @brief Reads a server's checkpoint file up to its last complete
+     * checkpoint; anything written after it is cut off.
+     * @return B_OK if a checkpoint was read, B_ENTRY_NOT_FOUND otherwise.
+     */
+    status_t LoadCrawlCheckpoint(const BString& uuid,
+                                 std::vector<DLNABrowseItem>& items,
+                                 DLNAContentState& state,
+                                 DLNACrawlCheckpoint& checkpoint);
+
+    /** @brief Deletes a server's checkpoint file, once its crawl is saved. */
+    void DeleteCrawlCheckpoint(const BString& uuid);
+
     ///@}
 
     /** @name Output: MediaRenderer Control */
@@ -183,6 +347,25 @@ public:
      */
     status_t SetAVTransportURI(const BString& uri, const BString& title);
 
+    /**
+     * @brief Queues the media the active renderer plays after the current one.
+     *
+     * The renderer buffers it ahead and switches without a gap. When an
+     * AVTransport event (or a poll, without events) shows the switch,
+     * MSG_TRACK_ENDED is sent with "gapless" = true. An empty URI clears
+     * the queued media.
+     * @return B_NOT_SUPPORTED if the renderer lacks SetNextAVTransportURI.
+     */
+    status_t SetNextAVTransportURI(const BString& uri, const BString& title);
+
+    /**
+     * @brief Returns the formats the active renderer plays, as the
+     * comma-separated protocolInfo list of ConnectionManager GetProtocolInfo.
+     *
+     * Asked once per renderer and kept; empty if the renderer does not say.
+     */
+    BString SinkProtocolInfo();
+
     /**
      * @brief Sends Play command to the active renderer.
      */
@@ -204,7 +387,11 @@ public:
      */
     status_t RendererSeek(bigtime_t position);
 
-    bigtime_t GetCurrentPosition() const { return fCurrentPosition; }
+    /**
+     * @brief Renderer position: the last one reported, advanced by the
+     * time since while the renderer plays.
+     */
+    bigtime_t GetCurrentPosition() const;
     bigtime_t GetCurrentDuration() const { return fCurrentDuration; }
 
     /**
@@ -221,6 +408,16 @@ public:
 
     ///@}
 
+    /** @name Diagnostics */
+    ///@{
+    /**
+     * @brief SOAP action latencies, one line per device and action:
+     * count, failures, mean, maximum and last.
+     */
+    BString ActionReport() const;
+    void ResetActionStats();
+    ///@}
+
     /** @name Settings */
     ///@{
     void SetDiscoveryMode(DiscoveryMode mode) { fDiscoveryMode = mode; }
@@ -238,6 +435,40 @@ private:
     status_t _FetchDeviceDescription(const BString& location, DLNADevice& dev);
     void _ParseDeviceXml(const BString& xml, DLNADevice& dev);
     void _PurgeStaleDevices();
+    bool _DescriptionCurrent(const DLNADevice& dev, const BString& udn,
+                             int32 bootId, int32 configId) const;
+    static BString _SsdpHeader(const BString& response, const char* name);
+    ///@}
+
+    /** @name Advertising internals */
+    ///@{
+    static int32 _AdvertiseThreadEntry(void* arg);
+    void _AdvertiseLoop();
+    /** @brief Multicasts one NOTIFY per advertised target. */
+    void _SendNotify(int sock, const char* subtype);
+    /** @brief Answers an M-SEARCH for one of the advertised targets. */
+    void _AnswerMSearch(int sock, const BString& request,
+                        const struct sockaddr_in& from);
+    /** @brief USN of the advertised device for notification type `nt`. */
+    BString _AdvertisedUsn(const BString& nt) const;
+    ///@}
+
+    /** @name Event internals */
+    ///@{
+    /** @brief One GENA subscription; guarded by fEventLock. */
+    struct EventSubscription {
+        const char* service;  ///< For log lines
+        BString url;          ///< eventSubURL of the service
+        BString callback;
+        BString sid;          ///< Empty while not subscribed
+        bigtime_t expires = 0;
+    };
+
+    status_t _Subscribe(EventSubscription& subscription, bool renew);
+    void _Unsubscribe(EventSubscription& subscription);
+    void _RenewSubscription(EventSubscription& subscription,
+                            bigtime_t margin);
+    void _HandleLastChange(const BString& body, bool transport);
     ///@}
 
     /** @name Polling internals */
@@ -246,25 +477,79 @@ private:
     void _PositionPollLoop();
     void _StartPositionPolling();
     void _StopPositionPolling();
+    void _WakePositionPolling();
+    void _SetPosition(bigtime_t position);
+    void _SetTransportState(const BString& state);
+    void _SetTrackUri(const BString& uri);
     bigtime_t _ParseUpnpTime(const BString& timeStr) const;
     ///@}
 
     /** @name SOAP communication */
     ///@{
+    struct ActionStats {
+        uint32 count = 0;
+        uint32 failures = 0;
+        bigtime_t total = 0;
+        bigtime_t max = 0;
+        bigtime_t last = 0;
+    };
+
+    /**
+     * @brief Per device (host and port of its control URLs): renderer
+     * control actions are sent one at a time, so the poll thread and
+     * playback commands share one kept-alive connection instead of each
+     * opening its own.
+     */
+    struct DeviceChannel {
+        BLocker lock{"dlna device"};  ///< Held while a control action runs
+        std::map<BString, ActionStats> actions; ///< Guarded by fChannelsLock
+    };
+
+    DeviceChannel* _Channel(const BString& controlUrl);
+    status_t _PerformSoapAction(const BString& controlUrl,
+                                const BString& serviceUrn,
+                                const BString& action,
+                                const HttpConnectionPool::Request& request,
+                                HttpConnectionPool::Response& reply);
     status_t _SendSoapAction(const BString& controlUrl,
                              const BString& serviceUrn,
                              const BString& action,
                              const BString& bodyArgs,
                              BString& response);
+    /** @brief Sends a ContentDirectory action and parses the reply into
+     *  `parser` while it arrives. */
+    status_t _SendSoapAction(const BString& controlUrl,
+                             const BString& serviceUrn,
+                             const BString& action,
+                             const BString& bodyArgs,
+                             DidlParser& parser);
     ///@}
 
     /** @name ContentDirectory parsing */
     ///@{
-    status_t _SearchAudio(const DLNADevice& server, std::vector<DLNABrowseItem>& allItems, BMessenger progressTarget);
+    /**
+     * @brief Receives the items of one Search page, in page order.
+     * @return False to stop the search.
+     */
+    typedef std::function<bool(const std::vector<DLNABrowseItem>& items,
+                               uint32 totalMatches,
+                               uint32 nextIndex)> SearchPageHandler;
+
+    status_t _SearchPages(const DLNADevice& server, const char* criteria,
+                          const SearchPageHandler& handler,
+                          uint32 firstIndex = 0);
+    status_t _SearchPage(const DLNADevice& server, const char* criteria,
+                         uint32 startIndex, uint32 requestedCount,
+                         std::vector<DLNABrowseItem>& items,
+                         uint32& numberReturned, uint32& totalMatches);
+    static int32 _SearchWorkerEntry(void* arg);
+    status_t _SearchAudio(const DLNADevice& server, std::vector<DLNABrowseItem>& allItems,
+                          BMessenger progressTarget,
+                          const CrawlPageHandler& pageHandler,
+                          uint32 firstIndex);
     status_t _SearchAlbumContainers(const DLNADevice& server,
                                     std::vector<DLNABrowseItem>& albumContainers,
                                     BMessenger progressTarget);
-    void _ParseDIDLLite(const BString& didl, std::vector<DLNABrowseItem>& items);
     BString _ExtractXmlTag(const BString& xml, const char* tagName) const;
     BString _ExtractXmlTagFull(const BString& xml, const char* openTag,
                                const char* closeTag) const;
@@ -274,13 +559,25 @@ private:
 
     /** @name Cache internals */
     ///@{
-    BPath _CachePath(const BString& uuid) const;
+    BPath _CachePath(const BString& uuid, const char* suffix = ".cache") const;
+    void _LoadDeviceCache();
+    void _SaveDeviceCache();
+
+    /** @brief A parsed device description, as kept between runs. */
+    struct CachedDescription {
+        DLNADevice device;
+        int64 seen = 0;  ///< real_time_clock() when last verified
+    };
     ///@}
 
     /** @name State */
     ///@{
     BMessenger fTarget;
     std::vector<DLNADevice> fDevices;
+    /// Descriptions by LOCATION; the discovery thread's once it runs.
+    std::map<BString, CachedDescription> fDescriptions;
+    bool fDescriptionsLoaded = false;
+    bool fDescriptionsDirty = false;
     DLNADevice fActiveRenderer;
     bool fHasActiveRenderer = false;
     DiscoveryMode fDiscoveryMode;
@@ -289,17 +586,53 @@ private:
     std::atomic<bool> fRunning;
     BPrivate::Network::BUrlContext fUrlContext;
 
+    thread_id fAdvertiseThread = -1;
+    std::atomic<bool> fAdvertising{false};
+    BString fAdvertisedLocation;   ///< Set before the thread starts
+    BString fAdvertisedUdn;
+    int32 fAdvertisedBootId = 0;
+
     thread_id fPositionPollThread = -1;
+    sem_id fPositionPollWakeSem;
     std::atomic<bool> fPositionPolling{false};
-    std::atomic<bigtime_t> fCurrentPosition{0};
     std::atomic<bigtime_t> fCurrentDuration{0};
     std::atomic<int32> fCurrentVolume{-1};
+
+    mutable BLocker fPositionLock{"dlna position"}; ///< Guards the five below
+    bigtime_t fPositionBase = 0;   ///< Position reported at fPositionStamp
+    bigtime_t fPositionStamp = 0;
+    BString fTransportState;       ///< Last AVTransport TransportState
+    BString fCurrentUri;           ///< Last SetAVTransportURI, or the switch to fNextUri
+    BString fNextUri;              ///< Queued by SetNextAVTransportURI
+    /// The active renderer faulted SetNextAVTransportURI as unknown.
+    std::atomic<bool> fNextUriUnsupported{false};
+
+    mutable BLocker fChannelsLock{"dlna channels"}; ///< Guards fChannels and stats
+    std::map<BString, std::unique_ptr<DeviceChannel>> fChannels;
+
+    BLocker fEventLock{"dlna events"}; ///< Guards the subscriptions
+    BString fEventServerUuid;
+    EventSubscription fContentEvents{"ContentDirectory"};
+    EventSubscription fTransportEvents{"AVTransport"};
+    EventSubscription fRenderingEvents{"RenderingControl"};
+    /// Set by the first event of each renderer service: polling slows down.
+    std::atomic<bool> fTransportEvented{false};
+    std::atomic<bool> fRenderingEvented{false};
     ///@}
 
     static const bigtime_t kDeviceTimeout = 120000000LL; ///< 120 seconds
     static const bigtime_t kDiscoveryInterval = 300000000LL; ///< 5 minutes
+    static const int32 kAdvertiseMaxAge = 1800; ///< CACHE-CONTROL of announcements, in seconds
+    static const bigtime_t kAdvertiseInterval = 600000000LL; ///< Re-announce, a third of the max-age
+    static const int64 kDescriptionCacheAge = 7 * 86400; ///< Seconds a cached description is kept unseen
     static const int32 kMaxCrawlItems = 100000; ///< Safety limit for recursive crawl
     static const int32 kMaxCrawlDepth = 10; ///< Maximum directory nesting depth
+    static const int32 kCrawlCheckpointItems = 500; ///< Items between container walk checkpoints
+    static const uint32 kSearchPageSize = 500; ///< Items asked for per Search page
+    static const int32 kSearchWindow = 4; ///< Search pages requested at once
+    static const int32 kEventTimeout = 1800; ///< Subscription length asked for, in seconds
+    static const bigtime_t kFallbackPollInterval = 5000000LL; ///< Renderers without events
+    static const bigtime_t kEventResyncInterval = 30000000LL; ///< Position check with events
 };
 
 #endif // BETON_DLNA_SERVICE_H
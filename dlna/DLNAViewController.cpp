@@ -1,6 +1,7 @@
 #include "DLNAViewController.h"
 
 #include "MediaTableView.h"
+#include "ArtworkController.h"
 #include "Debug.h"
 #include "NowPlayingInfoPanel.h"
 #include "LibraryBrowserController.h"
@@ -29,6 +30,11 @@
 #undef B_TRANSLATION_CONTEXT
 #define B_TRANSLATION_CONTEXT "DLNAViewController"
 
+/** @brief Rows below the visible ones whose covers are prefetched. */
+static const int32 kPrefetchRowsAhead = 200;
+/** @brief Queue items after the playing one whose covers are prefetched. */
+static const int32 kPrefetchQueued = 4;
+
 static int32 ParseDurationString(const BString &dur) {
   int h = 0, m = 0, s = 0;
   if (sscanf(dur.String(), "%d:%2d:%2d", &h, &m, &s) >= 2)
@@ -73,7 +79,48 @@ static BString DlnaDedupKey(const DLNABrowseItem &item) {
   return key;
 }
 
-DLNAViewController::DLNAViewController(MainWindow *window) : fWindow(window) {}
+static MediaItem ToMediaItem(const DLNABrowseItem &bi) {
+  MediaItem mi;
+  mi.title = bi.title;
+  mi.artist = bi.artist;
+  mi.album = bi.album;
+  mi.genre = bi.genre;
+  mi.path = bi.resourceUrl;
+  mi.coverUrl = bi.albumArtUrl;
+  mi.duration = ParseDurationString(bi.duration);
+  return mi;
+}
+
+/**
+ * @brief Sends items found by a crawl to the window as MSG_DLNA_CRAWL_PAGE.
+ *
+ * Carries the fields shown and those DlnaDedupKey() looks at.
+ */
+static void PostCrawlPage(const BMessenger &target, const BString &uuid,
+                          const std::vector<DLNABrowseItem> &items) {
+  if (items.empty())
+    return;
+
+  BMessage page(MSG_DLNA_CRAWL_PAGE);
+  page.AddString("uuid", uuid);
+  for (const auto &bi : items) {
+    page.AddString("url", bi.resourceUrl);
+    page.AddString("title", bi.title);
+    page.AddString("artist", bi.artist);
+    page.AddString("album", bi.album);
+    page.AddString("genre", bi.genre);
+    page.AddString("cover", bi.albumArtUrl);
+    page.AddString("duration", bi.duration);
+    page.AddString("ref", bi.refId);
+    page.AddString("id", bi.id);
+    page.AddString("size", bi.resourceSize);
+  }
+  target.SendMessage(&page);
+}
+
+DLNAViewController::DLNAViewController(MainWindow *window)
+    : fWindow(window),
+      fCrawlRefresh(BMessenger(window), MSG_DLNA_CRAWL_REFRESH) {}
 
 /**
  * @brief Applies remote renderer volume updates to local UI state.
@@ -141,6 +188,7 @@ void DLNAViewController::PlaySelection(MediaTableView *view, int32 rowIndex) {
   if (fWindow->fRadioStationController)
     fWindow->fRadioStationController->CancelQueuedPlay();
   fPlayQueue.clear();
+  fArmedIndex = -1;
 
   int32 count = view->CountRows();
   for (int32 i = 0; i < count; i++) {
@@ -152,6 +200,39 @@ void DLNAViewController::PlaySelection(MediaTableView *view, int32 rowIndex) {
     PlayIndex(rowIndex);
 }
 
+/**
+ * @brief Prefetches the covers of the content rows on screen, ahead of the
+ * covers asked for before, then those of the next kPrefetchRowsAhead rows.
+ *
+ * The tracks of an album share their cover, so this is a handful of
+ * downloads for a screen of rows.
+ */
+void DLNAViewController::PrefetchCovers() {
+  if (!fWindow || !fWindow->fIsDlnaMode || !fWindow->fArtworkController ||
+      !fWindow->fLibraryManager)
+    return;
+
+  MediaTableView *cv = fWindow->fLibraryManager->ContentView();
+  if (!cv)
+    return;
+
+  int32 first = cv->FirstVisibleIndex();
+  int32 visibleEnd = std::min(cv->CountRows(), first + cv->CountVisibleRows());
+  int32 end = std::min(cv->CountRows(), visibleEnd + kPrefetchRowsAhead);
+
+  std::set<BString> seen;
+  std::vector<BString> visible;
+  std::vector<BString> ahead;
+  for (int32 i = first; i < end; i++) {
+    const MediaItem *mi = cv->ItemAt(i);
+    if (!mi || mi->coverUrl.IsEmpty() || !seen.insert(mi->coverUrl).second)
+      continue;
+    (i < visibleEnd ? visible : ahead).push_back(mi->coverUrl);
+  }
+  fWindow->fArtworkController->PrefetchCovers(visible, true);
+  fWindow->fArtworkController->PrefetchCovers(ahead);
+}
+
 /**
  * @brief Activates the DLNA source view and selects an initial server.
  */
@@ -461,6 +542,76 @@ void DLNAViewController::HandleCrawlProgress(BMessage *msg) {
   fWindow->UpdateStatus(status, true);
 }
 
+/**
+ * @brief Appends the items of a crawl page to the content view.
+ *
+ * Rows are added unsorted with one redraw per page, as the library does
+ * while scanning; the filter columns follow through fCrawlRefresh. With a
+ * search active the rows are left to that refresh, which filters them.
+ * The finished crawl repopulates the views sorted and with covers.
+ *
+ * @param msg MSG_DLNA_CRAWL_PAGE.
+ */
+void DLNAViewController::HandleCrawlPage(BMessage *msg) {
+  if (!fWindow || !msg || !fWindow->fLibraryManager)
+    return;
+
+  BString uuid;
+  if (msg->FindString("uuid", &uuid) != B_OK || !fWindow->fIsDlnaMode ||
+      fWindow->fActiveDlnaServer.uuid != uuid)
+    return;
+
+  std::vector<MediaItem> added;
+  BString url;
+  for (int32 i = 0; msg->FindString("url", i, &url) == B_OK; i++) {
+    DLNABrowseItem bi;
+    bi.resourceUrl = url;
+    msg->FindString("title", i, &bi.title);
+    msg->FindString("artist", i, &bi.artist);
+    msg->FindString("album", i, &bi.album);
+    msg->FindString("genre", i, &bi.genre);
+    msg->FindString("cover", i, &bi.albumArtUrl);
+    msg->FindString("duration", i, &bi.duration);
+    msg->FindString("ref", i, &bi.refId);
+    msg->FindString("id", i, &bi.id);
+    msg->FindString("size", i, &bi.resourceSize);
+
+    if (!fStreamedKeys.insert(DlnaDedupKey(bi)).second)
+      continue;
+    added.push_back(ToMediaItem(bi));
+  }
+  if (added.empty())
+    return;
+
+  fWindow->fRadioItems.insert(fWindow->fRadioItems.end(), added.begin(),
+                              added.end());
+
+  const char *search = fWindow->fSearchField->Text();
+  MediaTableView *cv = fWindow->fLibraryManager->ContentView();
+  if (cv && (search == nullptr || search[0] == '\0')) {
+    cv->AppendEntries(added);
+    PrefetchCovers();
+  }
+  fCrawlRefresh.Schedule();
+}
+
+/**
+ * @brief Updates the filter columns, and with a search the content list,
+ * for the items a running crawl has added so far.
+ */
+void DLNAViewController::RefreshCrawlViews() {
+  fCrawlRefresh.Fired();
+  if (!fWindow || !fWindow->fLibraryManager || !fWindow->fIsDlnaMode ||
+      fStreamedKeys.empty())
+    return;
+
+  bigtime_t start = system_time();
+  BString search(fWindow->fSearchField->Text());
+  fWindow->fLibraryManager->UpdateFilteredViews(
+      fWindow->fRadioItems, true, "DLNA", search, true, !search.IsEmpty());
+  fCrawlRefresh.RecordCost(system_time() - start);
+}
+
 /**
  * @brief Handles crawl completion, then loads and shows cached browse results.
  * @param msg Message containing crawled server `uuid`.
@@ -470,6 +621,10 @@ void DLNAViewController::HandleCrawlDone(BMessage *msg) {
     return;
 
   fWindow->fDlnaCrawling = false;
+  fCrawlRefresh.Cancel();
+  // Rows were shown while crawling: keep the user where they scrolled to.
+  bool streamed = !fStreamedKeys.empty();
+  fStreamedKeys.clear();
 
   if (!fWindow->fDlnaManager)
     return;
@@ -478,6 +633,16 @@ void DLNAViewController::HandleCrawlDone(BMessage *msg) {
   if (msg->FindString("uuid", &targetUuid) != B_OK)
     return;
 
+  if (fHasPendingChange) {
+    BMessage pending(fPendingChange);
+    fHasPendingChange = false;
+    fPendingChange.MakeEmpty();
+    HandleContentChanged(&pending);
+  }
+  // A check that found the server as cached has nothing new to show.
+  if (msg->GetBool("unchanged", false))
+    return;
+
   if (!fWindow->fIsDlnaMode || fWindow->fActiveDlnaServer.uuid != targetUuid) {
     DEBUG_PRINT("DLNA CRAWL_DONE ignored: Navigated away or "
                 "UUID mismatch.\n");
@@ -494,7 +659,7 @@ void DLNAViewController::HandleCrawlDone(BMessage *msg) {
                 fWindow->fActiveDlnaServer.friendlyName.String(),
                 cached.size(), (long long)(tCacheEnd - tCacheStart));
 
-    PopulateItems(cached);
+    PopulateItems(cached, streamed);
 
     BString status;
     status.SetToFormat("%ld items from '%s'", (long)fWindow->fRadioItems.size(),
@@ -505,6 +670,167 @@ void DLNAViewController::HandleCrawlDone(BMessage *msg) {
   }
 }
 
+/**
+ * @brief Subscribes to the selected server's events, then compares its
+ * SystemUpdateID with the cached one and browses it again if it differs.
+ * @param server Selected server.
+ * @param cachedState Change counters saved with its cache.
+ */
+void DLNAViewController::CheckServerChanged(
+    const DLNADevice &server, const DLNAContentState &cachedState) {
+  if (fWindow->fDlnaCrawling)
+    return;
+  fWindow->fDlnaCrawling = true;
+
+  DLNAService *mgr = fWindow->fDlnaManager;
+  BMessenger target(fWindow);
+  BString callbackUrl;
+#if ENABLE_DLNA_OUTPUT
+  callbackUrl = fWindow->fLocalServer.EventUrl();
+#endif
+
+  fWindow->QueueJob(kLaneIO, "dlna_check", [mgr, server, cachedState, target,
+                                             callbackUrl]() {
+    mgr->SubscribeContentDirectory(server, callbackUrl);
+
+    DLNAContentState state = cachedState;
+    uint32 updateId = 0;
+    bool unchanged = true;
+    if (mgr->GetSystemUpdateID(server, updateId) == B_OK) {
+      std::vector<DLNABrowseItem> items;
+      if (!cachedState.hasSystemUpdateId) {
+        // A cache from before change counters: keep it, count from now.
+        state.hasSystemUpdateId = true;
+        state.systemUpdateId = updateId;
+        if (mgr->LoadServerCache(server.uuid, items) == B_OK)
+          mgr->SaveServerCache(server.uuid, items, state);
+      } else if (updateId != cachedState.systemUpdateId) {
+        DEBUG_PRINT("DLNA '%s' changed (%lu -> %lu), browsing again\n",
+                    server.friendlyName.String(),
+                    (unsigned long)cachedState.systemUpdateId,
+                    (unsigned long)updateId);
+        state.systemUpdateId = updateId;
+        state.containerUpdateIds.clear();
+        if (mgr->BrowseAll(server, items, target) == B_OK && !items.empty()) {
+          mgr->SaveServerCache(server.uuid, items, state);
+          unchanged = false;
+        }
+      }
+    }
+
+    BMessage done(MSG_DLNA_CRAWL_DONE);
+    done.AddString("uuid", server.uuid);
+    done.AddBool("unchanged", unchanged);
+    target.SendMessage(&done);
+  });
+}
+
+/**
+ * @brief Applies a content change event of the active server to its cache.
+ *
+ * Containers whose update ID differs from the cached one are browsed
+ * again; a SystemUpdateID change without container IDs browses the whole
+ * server. Changes arriving during a crawl are kept and applied after it.
+ *
+ * @param msg MSG_DLNA_CONTENT_CHANGED.
+ */
+void DLNAViewController::HandleContentChanged(BMessage *msg) {
+  if (!fWindow || !msg || !fWindow->fDlnaManager)
+    return;
+
+  BString uuid;
+  if (msg->FindString("uuid", &uuid) != B_OK ||
+      fWindow->fActiveDlnaServer.uuid != uuid)
+    return;
+
+  if (fWindow->fDlnaCrawling) {
+    if (!fHasPendingChange) {
+      fPendingChange = *msg;
+      fHasPendingChange = true;
+      return;
+    }
+    int32 systemUpdateId;
+    if (msg->FindInt32("system_update_id", &systemUpdateId) == B_OK) {
+      fPendingChange.RemoveName("system_update_id");
+      fPendingChange.AddInt32("system_update_id", systemUpdateId);
+    }
+    BString container;
+    int32 updateId;
+    for (int32 i = 0; msg->FindString("container", i, &container) == B_OK &&
+                      msg->FindInt32("update_id", i, &updateId) == B_OK;
+         i++) {
+      fPendingChange.AddString("container", container);
+      fPendingChange.AddInt32("update_id", updateId);
+    }
+    return;
+  }
+
+  fWindow->fDlnaCrawling = true;
+  DLNADevice server = fWindow->fActiveDlnaServer;
+  DLNAService *mgr = fWindow->fDlnaManager;
+  BMessenger target(fWindow);
+  BMessage change(*msg);
+
+  fWindow->QueueJob(kLaneIO, "dlna_update", [mgr, server, target, change]() {
+    std::vector<DLNABrowseItem> items;
+    DLNAContentState state;
+    bool unchanged = true;
+    if (mgr->LoadServerCache(server.uuid, items, &state) == B_OK) {
+      std::vector<BString> containers;
+      BString container;
+      int32 updateId;
+      for (int32 i = 0;
+           change.FindString("container", i, &container) == B_OK &&
+           change.FindInt32("update_id", i, &updateId) == B_OK;
+           i++) {
+        auto known = state.containerUpdateIds.find(container);
+        if (known == state.containerUpdateIds.end() ||
+            known->second != (uint32)updateId) {
+          state.containerUpdateIds[container] = (uint32)updateId;
+          if (std::find(containers.begin(), containers.end(), container) ==
+              containers.end())
+            containers.push_back(container);
+        }
+      }
+
+      int32 systemUpdateId;
+      bool systemChanged =
+          change.FindInt32("system_update_id", &systemUpdateId) == B_OK &&
+          (!state.hasSystemUpdateId ||
+           state.systemUpdateId != (uint32)systemUpdateId);
+      if (systemChanged) {
+        state.hasSystemUpdateId = true;
+        state.systemUpdateId = (uint32)systemUpdateId;
+      }
+
+      status_t err = B_OK;
+      if (!containers.empty()) {
+        err = mgr->RefreshContainers(server, containers, items);
+        unchanged = false;
+      } else if (systemChanged) {
+        unchanged = false;
+      }
+      // Without the changed containers, or when they failed: everything.
+      if (!unchanged && (containers.empty() || err != B_OK)) {
+        std::vector<DLNABrowseItem> allItems;
+        err = mgr->BrowseAll(server, allItems, target);
+        if (err == B_OK && !allItems.empty())
+          items.swap(allItems);
+        state.containerUpdateIds.clear();
+      }
+      if (err != B_OK)
+        unchanged = true;
+      else if (!unchanged)
+        mgr->SaveServerCache(server.uuid, items, state);
+    }
+
+    BMessage done(MSG_DLNA_CRAWL_DONE);
+    done.AddString("uuid", server.uuid);
+    done.AddBool("unchanged", unchanged);
+    target.SendMessage(&done);
+  });
+}
+
 /**
  * @brief Shows discovered DLNA servers in the content view as selectable items.
  */
@@ -688,8 +1014,10 @@ void DLNAViewController::SelectServer(const BString &uuid) {
   RebuildServerMenu();
 
   std::vector<DLNABrowseItem> cached;
+  DLNAContentState cachedState;
   bigtime_t tCacheStart = system_time();
-  if (fWindow->fDlnaManager->LoadServerCache(uuid, cached) == B_OK &&
+  if (fWindow->fDlnaManager->LoadServerCache(uuid, cached, &cachedState) ==
+          B_OK &&
       !cached.empty()) {
     bigtime_t tCacheEnd = system_time();
     DEBUG_PRINT(
@@ -702,6 +1030,7 @@ void DLNAViewController::SelectServer(const BString &uuid) {
     status.SetToFormat("%ld items from '%s'", (long)fWindow->fRadioItems.size(),
                        fWindow->fActiveDlnaServer.friendlyName.String());
     fWindow->UpdateStatus(status, false);
+    CheckServerChanged(fWindow->fActiveDlnaServer, cachedState);
     return;
   }
 
@@ -717,15 +1046,61 @@ void DLNAViewController::SelectServer(const BString &uuid) {
   }
 
   fWindow->fDlnaCrawling = true;
+  fStreamedKeys.clear();
+  fCrawlRefresh.Cancel();
   fWindow->UpdateStatus(B_TRANSLATE("Indexing DLNA server..."), true);
 
   DLNADevice serverCopy = fWindow->fActiveDlnaServer;
   DLNAService *mgr = fWindow->fDlnaManager;
   BMessenger target(fWindow);
+  BString callbackUrl;
+#if ENABLE_DLNA_OUTPUT
+  callbackUrl = fWindow->fLocalServer.EventUrl();
+#endif
 
-  fWindow->LaunchThread("dlna_crawl", [mgr, serverCopy, target]() {
+  fWindow->QueueJob(kLaneIO, "dlna_crawl", [mgr, serverCopy, target,
+                                             callbackUrl]() {
+    // Taken first: a change during the crawl makes the saved ID stale,
+    // and the next check browses again.
+    DLNAContentState state;
+    state.hasSystemUpdateId =
+        mgr->GetSystemUpdateID(serverCopy, state.systemUpdateId) == B_OK;
+    mgr->SubscribeContentDirectory(serverCopy, callbackUrl);
+
+    // An interrupted crawl goes on from its checkpoint, as long as the
+    // server has not changed since it was taken.
     std::vector<DLNABrowseItem> allItems;
-    status_t err = mgr->BrowseAll(serverCopy, allItems, target);
+    DLNAContentState checkpointState;
+    DLNACrawlCheckpoint resume;
+    bool resuming =
+        state.hasSystemUpdateId &&
+        mgr->LoadCrawlCheckpoint(serverCopy.uuid, allItems, checkpointState,
+                                 resume) == B_OK &&
+        checkpointState.hasSystemUpdateId &&
+        checkpointState.systemUpdateId == state.systemUpdateId;
+    if (resuming) {
+      PostCrawlPage(target, serverCopy.uuid, allItems);
+    } else {
+      allItems.clear();
+      mgr->DeleteCrawlCheckpoint(serverCopy.uuid);
+    }
+
+    // Items between checkpoints are written together with the next one.
+    std::vector<DLNABrowseItem> unsaved;
+    status_t err = mgr->BrowseAll(
+        serverCopy, allItems, target,
+        [&](const std::vector<DLNABrowseItem> &items,
+            const DLNACrawlCheckpoint *checkpoint) {
+          PostCrawlPage(target, serverCopy.uuid, items);
+          if (!state.hasSystemUpdateId)
+            return;
+          unsaved.insert(unsaved.end(), items.begin(), items.end());
+          if (checkpoint != nullptr &&
+              mgr->AppendCrawlCheckpoint(serverCopy.uuid, state, unsaved,
+                                         *checkpoint) == B_OK)
+            unsaved.clear();
+        },
+        resuming ? &resume : nullptr);
 
     if (err == B_OK && !allItems.empty()) {
       BMessage saving(MSG_DLNA_CRAWL_PROGRESS);
@@ -734,7 +1109,8 @@ void DLNAViewController::SelectServer(const BString &uuid) {
       saving.AddInt32("count", (int32)allItems.size());
       target.SendMessage(&saving);
 
-      mgr->SaveServerCache(serverCopy.uuid, allItems);
+      if (mgr->SaveServerCache(serverCopy.uuid, allItems, state) == B_OK)
+        mgr->DeleteCrawlCheckpoint(serverCopy.uuid);
     }
 
     BMessage done(MSG_DLNA_CRAWL_DONE);
@@ -752,6 +1128,7 @@ void DLNAViewController::PlayIndex(int32 index) {
     return;
 
   fPlayIndex = index;
+  fArmedIndex = -1;
   if (fWindow->fPlaybackQueueManager)
     fWindow->fPlaybackQueueManager->SetActiveSource(
         PlaybackQueueManager::SourceDLNA);
@@ -767,17 +1144,61 @@ void DLNAViewController::PlayIndex(int32 index) {
     return;
   }
 
-  if (fWindow->fNowPlayingInfoPanel && fWindow->fShowCoverArt)
-    fWindow->fNowPlayingInfoPanel->ClearCover();
-
   DEBUG_PRINT("_PlayDlnaIndex: playing URL '%s'\n", mi.path.String());
+  ShowPlayingItem(mi);
+  PrefetchQueuedCovers(index);
+
   AudioPlaybackEngine *ctrl = fWindow->fPlaybackEngine;
   BString title = mi.title;
-  BString artist = mi.artist;
+  int32 duration = mi.duration;
+  BString itemPath = mi.path;
+  BPrivate::Network::BUrlContext *ctx = fWindow->fDlnaManager->GetUrlContext();
+
+  fWindow->QueueJob(kLaneIO, "dlna_play",
+                    [ctrl, itemPath, title, duration, ctx]() {
+#if B_HAIKU_VERSION <= B_HAIKU_VERSION_1_BETA_5
+    BUrl url(itemPath.String());
+#else
+    BUrl url(itemPath.String(), false);
+#endif
+    ctrl->PlayUrl(url, title.String(), duration, ctx);
+  });
+
+  if (fWindow->fIconPause) {
+    fWindow->fBtnPlayPause->SetIcon(fWindow->fIconPause, 0);
+    fWindow->fBtnPlayPause->SetLabel("");
+  }
+}
+
+/**
+ * @brief Prefetches the covers of the next queue items, so the cover is
+ * there when playback moves on.
+ */
+void DLNAViewController::PrefetchQueuedCovers(int32 index) {
+  if (!fWindow->fArtworkController)
+    return;
+
+  std::vector<BString> urls;
+  int32 end = std::min((int32)fPlayQueue.size(), index + 1 + kPrefetchQueued);
+  for (int32 i = index + 1; i < end; i++) {
+    if (!fPlayQueue[i].coverUrl.IsEmpty())
+      urls.push_back(fPlayQueue[i].coverUrl);
+  }
+  fWindow->fArtworkController->PrefetchCovers(urls);
+}
+
+/**
+ * @brief Shows a DLNA item as playing: status, title, tags and its row.
+ * @param mi Queue item being played.
+ */
+void DLNAViewController::ShowPlayingItem(const MediaItem &mi) {
+  if (fWindow->fNowPlayingInfoPanel && fWindow->fShowCoverArt)
+    fWindow->fNowPlayingInfoPanel->ClearCover();
+
   BString displayLabel;
-  if (!artist.IsEmpty())
-    displayLabel << artist << " - ";
-  displayLabel << title;
+  if (!mi.artist.IsEmpty())
+    displayLabel << mi.artist << " - ";
+  displayLabel << mi.title;
 
   fWindow->UpdateStatus(B_TRANSLATE("Playing from DLNA server..."), false);
   if (fWindow->fTitleView)
@@ -786,10 +1207,6 @@ void DLNAViewController::PlayIndex(int32 index) {
   if (fWindow->fNowPlayingInfoPanel)
     fWindow->fNowPlayingInfoPanel->SetTags(mi.artist, mi.title, mi.album);
 
-  int32 duration = mi.duration;
-  BString itemPath = mi.path;
-  BPrivate::Network::BUrlContext *ctx = fWindow->fDlnaManager->GetUrlContext();
-
   if (fWindow->fLibraryManager && fWindow->fLibraryManager->ContentView()) {
     fWindow->fLibraryManager->ContentView()->DeselectAll();
     int32 count = fWindow->fLibraryManager->ContentView()->CountRows();
@@ -806,20 +1223,43 @@ void DLNAViewController::PlayIndex(int32 index) {
       }
     }
   }
+}
 
-  fWindow->LaunchThread("dlna_play", [ctrl, itemPath, title, duration, ctx]() {
-#if B_HAIKU_VERSION <= B_HAIKU_VERSION_1_BETA_5
-    BUrl url(itemPath.String());
-#else
-    BUrl url(itemPath.String(), false);
-#endif
-    ctrl->PlayUrl(url, title.String(), duration, ctx);
-  });
+/**
+ * @brief Queues an item on the renderer to follow the current one without
+ * a gap.
+ * @param index Queue index; -1 clears the armed item.
+ */
+void DLNAViewController::ArmNext(int32 index) {
+  if (!fWindow || !fWindow->fPlaybackEngine)
+    return;
+  if (index < 0 || index >= (int32)fPlayQueue.size() ||
+      fPlayQueue[index].path.IsEmpty())
+    index = -1;
+  if (index == fArmedIndex)
+    return;
 
-  if (fWindow->fIconPause) {
-    fWindow->fBtnPlayPause->SetIcon(fWindow->fIconPause, 0);
-    fWindow->fBtnPlayPause->SetLabel("");
+  fArmedIndex = index;
+  if (index < 0) {
+    fWindow->fPlaybackEngine->SetRemoteNextUrl("", "", 0);
+    return;
   }
+  const MediaItem &mi = fPlayQueue[index];
+  fWindow->fPlaybackEngine->SetRemoteNextUrl(mi.path, mi.title, mi.duration);
+}
+
+/**
+ * @brief Makes the armed item current after the renderer switched to it.
+ * @return False if no item was armed.
+ */
+bool DLNAViewController::CompleteArmedHandoff() {
+  if (fArmedIndex < 0 || fArmedIndex >= (int32)fPlayQueue.size())
+    return false;
+
+  fPlayIndex = fArmedIndex;
+  fArmedIndex = -1;
+  ShowPlayingItem(fPlayQueue[fPlayIndex]);
+  return true;
 }
 
 /**
@@ -828,6 +1268,7 @@ void DLNAViewController::PlayIndex(int32 index) {
 void DLNAViewController::ClearPlayQueue() {
   fPlayQueue.clear();
   fPlayIndex = -1;
+  fArmedIndex = -1;
 }
 
 /**
@@ -863,9 +1304,10 @@ const MediaItem *DLNAViewController::CurrentPlayItem() const {
 /**
  * @brief Converts browse items into `MediaItem`s and refreshes filtered views.
  * @param browseItems Raw browse items from cache or crawl.
+ * @param preserveScroll Keeps the content scroll position.
  */
 void DLNAViewController::PopulateItems(
-    const std::vector<DLNABrowseItem> &browseItems) {
+    const std::vector<DLNABrowseItem> &browseItems, bool preserveScroll) {
   if (!fWindow || !fWindow->fLibraryManager)
     return;
 
@@ -879,22 +1321,14 @@ void DLNAViewController::PopulateItems(
     if (seenItems.find(dedupKey) != seenItems.end())
       continue;
     seenItems.insert(dedupKey);
-
-    MediaItem mi;
-    mi.title = bi.title;
-    mi.artist = bi.artist;
-    mi.album = bi.album;
-    mi.genre = bi.genre;
-    mi.path = bi.resourceUrl;
-    mi.coverUrl = bi.albumArtUrl;
-    mi.duration = ParseDurationString(bi.duration);
-    fWindow->fRadioItems.push_back(mi);
+    fWindow->fRadioItems.push_back(ToMediaItem(bi));
   }
   bigtime_t t1 = system_time();
 
   fWindow->fLibraryManager->SetRadioFilterMode(false);
   fWindow->fLibraryManager->UpdateFilteredViews(
-      fWindow->fRadioItems, true, "DLNA", fWindow->fSearchField->Text());
+      fWindow->fRadioItems, true, "DLNA", fWindow->fSearchField->Text(),
+      preserveScroll);
   bigtime_t t2 = system_time();
 
   DEBUG_PRINT("_PopulateDlnaItems(%zu): convert=%lld us, "
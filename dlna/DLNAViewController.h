@@ -4,10 +4,13 @@
 #include "Config.h"
 #include "DLNAService.h"
 #include "MediaItem.h"
+#include "MemoryStats.h"
+#include "RefreshCoalescer.h"
 
+#include <Message.h>
+#include <set>
 #include <vector>
 
-class BMessage;
 class MediaTableView;
 class MainWindow;
 
@@ -69,17 +72,34 @@ public:
   /** @param msg Message containing crawl progress fields. */
   void HandleCrawlProgress(BMessage *msg);
 
+  /** @brief Adds the items of a running crawl to the views as they come. */
+  /** @param msg MSG_DLNA_CRAWL_PAGE with the new items. */
+  void HandleCrawlPage(BMessage *msg);
+
+  /** @brief Refreshes the filter columns for the items added so far. */
+  void RefreshCrawlViews();
+
   /** @brief Finalizes crawl and loads cache for the completed server. */
   /** @param msg Message containing completed crawl server `uuid`. */
   void HandleCrawlDone(BMessage *msg);
 
+  /** @brief Brings the cache of a server whose content changed up to date. */
+  /** @param msg MSG_DLNA_CONTENT_CHANGED from the subscribed server. */
+  void HandleContentChanged(BMessage *msg);
+
   /** @brief Selects active DLNA server and starts cache/crawl pipeline. */
   /** @param uuid Server UUID. */
   void SelectServer(const BString &uuid);
 
   /** @brief Converts browse items into view/playable `MediaItem` entries. */
   /** @param browseItems Raw browse results from cache/crawl. */
-  void PopulateItems(const std::vector<DLNABrowseItem> &browseItems);
+  /** @param preserveScroll Keeps the content scroll position. */
+  void PopulateItems(const std::vector<DLNABrowseItem> &browseItems,
+                     bool preserveScroll = false);
+
+  /** @brief Prefetches the covers of the rows on screen, then of the rows
+   *  below them. */
+  void PrefetchCovers();
 
   /** @brief Builds queue from a view and starts DLNA playback at row index. */
   /** @param view Source media table view. */
@@ -90,6 +110,17 @@ public:
   /** @param index Queue index. */
   void PlayIndex(int32 index);
 
+  /** @brief Heap bytes of the play queue's array, for MemoryStats. */
+  size_t QueueBytes() const { return MemoryStats::BytesOf(fPlayQueue); }
+
+  /** @brief Queues an item on the renderer to follow without a gap. */
+  /** @param index Queue index; -1 clears the armed item. */
+  void ArmNext(int32 index);
+
+  /** @brief Makes the armed item current once the renderer switched. */
+  /** @return False if no item was armed. */
+  bool CompleteArmedHandoff();
+
   /** @brief Clears DLNA play queue and resets active play index. */
   void ClearPlayQueue();
 
@@ -121,12 +152,32 @@ public:
 #endif
 
 private:
+  /** @brief Shows a queue item as playing: status, title, tags and row. */
+  void ShowPlayingItem(const MediaItem &mi);
+
+  /** @brief Prefetches the covers of the queue items after `index`. */
+  void PrefetchQueuedCovers(int32 index);
+
+  /** @brief Subscribes to a server's events and refreshes its cache in the
+   *  background if the server changed since it was saved. */
+  void CheckServerChanged(const DLNADevice &server,
+                          const DLNAContentState &cachedState);
+
   /** Main window context used for UI updates and controller access. */
   MainWindow *fWindow;
   /** Current DLNA playback queue (view-ordered snapshot). */
   std::vector<MediaItem> fPlayQueue;
   /** Active playback index in `fPlayQueue`; -1 when idle. */
   int32 fPlayIndex = -1;
+  /** Index queued on the renderer with ArmNext(); -1 when none. */
+  int32 fArmedIndex = -1;
+  /** Changes announced while a crawl ran; applied once it is done. */
+  BMessage fPendingChange;
+  bool fHasPendingChange = false;
+  /** Dedup keys of the rows a running crawl added to the views. */
+  std::set<BString> fStreamedKeys;
+  /** Paces filter refreshes while crawl pages arrive. */
+  RefreshCoalescer fCrawlRefresh;
 };
 
 #endif // BETON_DLNA_VIEW_CONTROLLER_H
@@ -0,0 +1,609 @@
+#include "DidlParser.h"
+
+#include <cctype>
+#include <cstdlib>
+#include <cstring>
+
+static inline bool
+_IsSpace(char c)
+{
+    return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+/** @brief `name` without its namespace prefix. */
+static inline const char*
+_LocalName(const char* name)
+{
+    const char* colon = strchr(name, ':');
+    return colon != nullptr ? colon + 1 : name;
+}
+
+// #pragma mark - XmlTokenizer
+
+XmlTokenizer::XmlTokenizer(Handler& handler)
+    :
+    fHandler(handler),
+    fState(kText),
+    fEntityReturn(kText),
+    fAttributeCount(0),
+    fQuote('"'),
+    fRun(0)
+{
+}
+
+/**
+ * @brief Tokenizes the next piece of the document.
+ */
+void XmlTokenizer::Feed(const char* data, size_t length)
+{
+    const char* p = data;
+    const char* end = data + length;
+    while (p < end) {
+        switch (fState) {
+            case kText:
+            {
+                const char* stop = p;
+                while (stop < end && *stop != '<' && *stop != '&')
+                    stop++;
+                if (stop > p)
+                    fHandler.Text(p, stop - p);
+                if (stop == end)
+                    return;
+                if (*stop == '<') {
+                    fState = kTagStart;
+                } else {
+                    fMarkup.clear();
+                    fEntityReturn = kText;
+                    fState = kEntity;
+                }
+                p = stop + 1;
+                break;
+            }
+
+            case kTagStart:
+                if (*p == '/') {
+                    fName.clear();
+                    fState = kEndTag;
+                    p++;
+                } else if (*p == '!') {
+                    fMarkup.clear();
+                    fState = kBang;
+                    p++;
+                } else if (*p == '?') {
+                    fRun = 0;
+                    fState = kInstruction;
+                    p++;
+                } else {
+                    fName.clear();
+                    fAttributeCount = 0;
+                    fState = kTagName;
+                }
+                break;
+
+            case kTagName:
+            {
+                const char* stop = p;
+                while (stop < end && !_IsSpace(*stop) && *stop != '>'
+                    && *stop != '/')
+                    stop++;
+                fName.append(p, stop - p);
+                p = stop;
+                if (p == end)
+                    return;
+                char c = *p++;
+                if (c == '>')
+                    _StartElement(false);
+                else if (c == '/')
+                    fState = kEmptyClose;
+                else
+                    fState = kInTag;
+                break;
+            }
+
+            case kInTag:
+            {
+                char c = *p++;
+                if (_IsSpace(c))
+                    break;
+                if (c == '>') {
+                    _StartElement(false);
+                } else if (c == '/') {
+                    fState = kEmptyClose;
+                } else {
+                    if (fAttributeCount == fAttributes.size())
+                        fAttributes.emplace_back();
+                    AttributeSlot& slot = fAttributes[fAttributeCount++];
+                    slot.name.assign(1, c);
+                    slot.value.clear();
+                    fState = kAttributeName;
+                }
+                break;
+            }
+
+            case kAttributeName:
+            {
+                char c = *p;
+                if (c == '=') {
+                    fState = kAttributeEquals;
+                    p++;
+                } else if (c == '>' || c == '/') {
+                    // No value; the tag goes on or ends as usual.
+                    fState = kInTag;
+                } else {
+                    if (!_IsSpace(c))
+                        fAttributes[fAttributeCount - 1].name += c;
+                    p++;
+                }
+                break;
+            }
+
+            case kAttributeEquals:
+            {
+                char c = *p;
+                if (c == '"' || c == '\'') {
+                    fQuote = c;
+                    fState = kAttributeValue;
+                    p++;
+                } else if (_IsSpace(c)) {
+                    p++;
+                } else {
+                    fState = kInTag;
+                }
+                break;
+            }
+
+            case kAttributeValue:
+            {
+                const char* stop = p;
+                while (stop < end && *stop != fQuote && *stop != '&')
+                    stop++;
+                fAttributes[fAttributeCount - 1].value.append(p, stop - p);
+                if (stop == end)
+                    return;
+                if (*stop == '&') {
+                    fMarkup.clear();
+                    fEntityReturn = kAttributeValue;
+                    fState = kEntity;
+                } else {
+                    fState = kInTag;
+                }
+                p = stop + 1;
+                break;
+            }
+
+            case kEmptyClose:
+                if (*p++ == '>')
+                    _StartElement(true);
+                else
+                    fState = kInTag;
+                break;
+
+            case kEndTag:
+            {
+                const char* stop = p;
+                while (stop < end && *stop != '>')
+                    stop++;
+                fName.append(p, stop - p);
+                if (stop == end)
+                    return;
+                p = stop + 1;
+                while (!fName.empty() && _IsSpace(fName.back()))
+                    fName.pop_back();
+                fState = kText;
+                fHandler.EndElement(fName.c_str());
+                break;
+            }
+
+            case kBang:
+            {
+                static const char kCdataStart[] = "[CDATA[";
+                fMarkup += *p++;
+                if (fMarkup == kCdataStart) {
+                    fRun = 0;
+                    fState = kCdata;
+                } else if (fMarkup == "--") {
+                    fRun = 0;
+                    fState = kComment;
+                } else if (strncmp(kCdataStart, fMarkup.c_str(),
+                               fMarkup.size()) != 0
+                    && strncmp("--", fMarkup.c_str(), fMarkup.size()) != 0) {
+                    // DOCTYPE and the like.
+                    fState = fMarkup.back() == '>' ? kText : kSkipTag;
+                }
+                break;
+            }
+
+            case kCdata:
+            {
+                char c = *p;
+                if (c == ']') {
+                    p++;
+                    if (++fRun > 2) {
+                        fHandler.Text("]", 1);
+                        fRun = 2;
+                    }
+                    break;
+                }
+                if (c == '>' && fRun == 2) {
+                    p++;
+                    fState = kText;
+                    break;
+                }
+                if (fRun > 0) {
+                    fHandler.Text("]]", fRun);
+                    fRun = 0;
+                }
+                const char* stop = p + 1;
+                while (stop < end && *stop != ']')
+                    stop++;
+                fHandler.Text(p, stop - p);
+                p = stop;
+                break;
+            }
+
+            case kComment:
+            {
+                char c = *p++;
+                if (c == '>' && fRun >= 2)
+                    fState = kText;
+                else
+                    fRun = c == '-' ? fRun + 1 : 0;
+                break;
+            }
+
+            case kInstruction:
+            {
+                char c = *p++;
+                if (c == '>' && fRun > 0)
+                    fState = kText;
+                else
+                    fRun = c == '?' ? 1 : 0;
+                break;
+            }
+
+            case kSkipTag:
+                if (*p++ == '>')
+                    fState = kText;
+                break;
+
+            case kEntity:
+            {
+                char c = *p;
+                if (c == ';') {
+                    p++;
+                    fState = fEntityReturn;
+                    _DecodeEntity();
+                } else if (fMarkup.size() < 10
+                    && (isalnum((unsigned char)c) || c == '#')) {
+                    fMarkup += c;
+                    p++;
+                } else {
+                    // A bare '&': kept as written, `c` is read again.
+                    fState = fEntityReturn;
+                    fMarkup.insert(0, 1, '&');
+                    if (fState == kText)
+                        fHandler.Text(fMarkup.data(), fMarkup.size());
+                    else
+                        fAttributes[fAttributeCount - 1].value += fMarkup;
+                }
+                break;
+            }
+        }
+    }
+}
+
+const char* XmlTokenizer::Attribute(const char* name) const
+{
+    for (size_t i = 0; i < fAttributeCount; i++) {
+        if (fAttributes[i].name == name)
+            return fAttributes[i].value.c_str();
+    }
+    return nullptr;
+}
+
+void XmlTokenizer::_StartElement(bool empty)
+{
+    fState = kText;
+    fHandler.StartElement(*this, fName.c_str());
+    if (empty)
+        fHandler.EndElement(fName.c_str());
+}
+
+/**
+ * @brief Emits the reference in fMarkup decoded, to the text or the value
+ * being read; unknown ones as written.
+ */
+void XmlTokenizer::_DecodeEntity()
+{
+    char decoded[4];
+    size_t length = 0;
+    const std::string& name = fMarkup;
+    if (name == "lt") {
+        decoded[length++] = '<';
+    } else if (name == "gt") {
+        decoded[length++] = '>';
+    } else if (name == "amp") {
+        decoded[length++] = '&';
+    } else if (name == "quot") {
+        decoded[length++] = '"';
+    } else if (name == "apos") {
+        decoded[length++] = '\'';
+    } else if (name.size() > 1 && name[0] == '#') {
+        bool hex = name[1] == 'x' || name[1] == 'X';
+        char* stop = nullptr;
+        unsigned long code = strtoul(name.c_str() + (hex ? 2 : 1), &stop,
+            hex ? 16 : 10);
+        if (*stop == '\0' && code > 0 && code <= 0x10FFFF) {
+            // UTF-8.
+            if (code < 0x80) {
+                decoded[length++] = (char)code;
+            } else if (code < 0x800) {
+                decoded[length++] = (char)(0xC0 | (code >> 6));
+                decoded[length++] = (char)(0x80 | (code & 0x3F));
+            } else if (code < 0x10000) {
+                decoded[length++] = (char)(0xE0 | (code >> 12));
+                decoded[length++] = (char)(0x80 | ((code >> 6) & 0x3F));
+                decoded[length++] = (char)(0x80 | (code & 0x3F));
+            } else {
+                decoded[length++] = (char)(0xF0 | (code >> 18));
+                decoded[length++] = (char)(0x80 | ((code >> 12) & 0x3F));
+                decoded[length++] = (char)(0x80 | ((code >> 6) & 0x3F));
+                decoded[length++] = (char)(0x80 | (code & 0x3F));
+            }
+        }
+    }
+
+    if (length == 0) {
+        fMarkup.insert(0, 1, '&');
+        fMarkup += ';';
+    }
+    const char* text = length > 0 ? decoded : fMarkup.data();
+    if (length == 0)
+        length = fMarkup.size();
+
+    if (fEntityReturn == kText)
+        fHandler.Text(text, length);
+    else
+        fAttributes[fAttributeCount - 1].value.append(text, length);
+}
+
+// #pragma mark - DidlParser
+
+enum {
+    kFieldTitle = 1 << 0,
+    kFieldCreator = 1 << 1,
+    kFieldArtist = 1 << 2,
+    kFieldAlbum = 1 << 3,
+    kFieldGenre = 1 << 4,
+    kFieldClass = 1 << 5,
+    kFieldAlbumArt = 1 << 6,
+    kFieldResource = 1 << 7
+};
+
+DidlParser::DidlHandler::DidlHandler(std::vector<DLNABrowseItem>& items)
+    :
+    fItems(items),
+    fInObject(false),
+    fDepth(0),
+    fObjectDepth(0),
+    fField(nullptr),
+    fFieldDepth(0),
+    fSeen(0)
+{
+}
+
+void DidlParser::DidlHandler::StartElement(const XmlTokenizer& tokenizer,
+                                           const char* name)
+{
+    fDepth++;
+    if (!fInObject) {
+        const char* local = _LocalName(name);
+        bool container = strcmp(local, "container") == 0;
+        if (!container && strcmp(local, "item") != 0)
+            return;
+
+        fItem = DLNABrowseItem();
+        fItem.isContainer = container;
+        fArtistFallback.Truncate(0);
+        fInObject = true;
+        fObjectDepth = fDepth;
+        fField = nullptr;
+        fSeen = 0;
+        if (const char* value = tokenizer.Attribute("id"))
+            fItem.id = value;
+        if (const char* value = tokenizer.Attribute("refID"))
+            fItem.refId = value;
+        if (const char* value = tokenizer.Attribute("parentID"))
+            fItem.parentId = value;
+        return;
+    }
+    if (fField != nullptr)
+        return;
+
+    BString* field = nullptr;
+    uint32 bit = 0;
+    if (strcmp(name, "dc:title") == 0) {
+        field = &fItem.title;
+        bit = kFieldTitle;
+    } else if (strcmp(name, "dc:creator") == 0) {
+        field = &fItem.artist;
+        bit = kFieldCreator;
+    } else if (strcmp(name, "upnp:artist") == 0) {
+        field = &fArtistFallback;
+        bit = kFieldArtist;
+    } else if (strcmp(name, "upnp:album") == 0) {
+        field = &fItem.album;
+        bit = kFieldAlbum;
+    } else if (strcmp(name, "upnp:genre") == 0) {
+        field = &fItem.genre;
+        bit = kFieldGenre;
+    } else if (strcmp(name, "upnp:class") == 0) {
+        field = &fItem.upnpClass;
+        bit = kFieldClass;
+    } else if (strcmp(name, "upnp:albumArtURI") == 0) {
+        field = &fItem.albumArtUrl;
+        bit = kFieldAlbumArt;
+    } else if (strcmp(_LocalName(name), "res") == 0 && !fItem.isContainer) {
+        field = &fItem.resourceUrl;
+        bit = kFieldResource;
+    }
+    if (field == nullptr || (fSeen & bit) != 0)
+        return;
+
+    fSeen |= bit;
+    fField = field;
+    fFieldDepth = fDepth;
+    fText.clear();
+
+    if (bit == kFieldResource) {
+        // protocolInfo is "<protocol>:<network>:<MIME type>:<info>".
+        if (const char* info = tokenizer.Attribute("protocolInfo")) {
+            const char* c1 = strchr(info, ':');
+            const char* c2 = c1 != nullptr ? strchr(c1 + 1, ':') : nullptr;
+            const char* c3 = c2 != nullptr ? strchr(c2 + 1, ':') : nullptr;
+            if (c3 != nullptr && c3 > c2 + 1)
+                fItem.mimeType.SetTo(c2 + 1, c3 - c2 - 1);
+        }
+        if (const char* value = tokenizer.Attribute("duration"))
+            fItem.duration = value;
+        if (const char* value = tokenizer.Attribute("size"))
+            fItem.resourceSize = value;
+    }
+}
+
+void DidlParser::DidlHandler::EndElement(const char* name)
+{
+    if (fInObject) {
+        if (fField != nullptr && fDepth == fFieldDepth) {
+            // Entities split a text node into runs; the field is set once.
+            fField->SetTo(fText.data(), (int32)fText.size());
+            if (fField == &fItem.resourceUrl)
+                fItem.resourceUrl.Trim();
+            fField = nullptr;
+        }
+        if (fDepth == fObjectDepth) {
+            if (fItem.artist.IsEmpty())
+                fItem.artist = fArtistFallback;
+            fItems.push_back(fItem);
+            fInObject = false;
+        }
+    }
+    if (fDepth > 0)
+        fDepth--;
+}
+
+void DidlParser::DidlHandler::Text(const char* text, size_t length)
+{
+    if (fField != nullptr && fDepth == fFieldDepth)
+        fText.append(text, length);
+}
+
+DidlParser::SoapHandler::SoapHandler(DidlParser& parser)
+    :
+    fParser(parser),
+    fField(kNone),
+    fResultDepth(0)
+{
+}
+
+void DidlParser::SoapHandler::StartElement(const XmlTokenizer& tokenizer,
+                                           const char* name)
+{
+    if (fField == kResult) {
+        // DIDL-Lite sent as markup rather than escaped text.
+        fResultDepth++;
+        fParser.fHasResult = true;
+        fParser.fDidlHandler.StartElement(tokenizer, name);
+        return;
+    }
+
+    const char* local = _LocalName(name);
+    fValue.clear();
+    if (strcmp(local, "Result") == 0) {
+        fField = kResult;
+        fResultDepth = 0;
+    } else if (strcmp(local, "NumberReturned") == 0) {
+        fField = kNumberReturned;
+    } else if (strcmp(local, "TotalMatches") == 0) {
+        fField = kTotalMatches;
+    } else if (strcmp(local, "UpdateID") == 0) {
+        fField = kUpdateID;
+    } else {
+        fField = kNone;
+    }
+}
+
+void DidlParser::SoapHandler::EndElement(const char* name)
+{
+    if (fField == kResult && fResultDepth > 0) {
+        fResultDepth--;
+        fParser.fDidlHandler.EndElement(name);
+        return;
+    }
+
+    if (!fValue.empty()) {
+        uint32 value = (uint32)strtoul(fValue.c_str(), nullptr, 10);
+        switch (fField) {
+            case kNumberReturned:
+                fParser.fHasNumberReturned = true;
+                fParser.fNumberReturned = value;
+                break;
+            case kTotalMatches:
+                fParser.fHasTotalMatches = true;
+                fParser.fTotalMatches = value;
+                break;
+            case kUpdateID:
+                fParser.fHasUpdateID = true;
+                fParser.fUpdateID = value;
+                break;
+            default:
+                break;
+        }
+    }
+    fField = kNone;
+}
+
+void DidlParser::SoapHandler::Text(const char* text, size_t length)
+{
+    switch (fField) {
+        case kNone:
+            break;
+        case kResult:
+            fParser.fHasResult = true;
+            if (fResultDepth > 0)
+                fParser.fDidlHandler.Text(text, length);
+            else
+                fParser.fDidl.Feed(text, length);
+            break;
+        default:
+            if (fValue.size() < 32)
+                fValue.append(text, length);
+            break;
+    }
+}
+
+DidlParser::DidlParser(std::vector<DLNABrowseItem>& items)
+    :
+    fDidlHandler(items),
+    fDidl(fDidlHandler),
+    fSoapHandler(*this),
+    fSoap(fSoapHandler),
+    fHasResult(false),
+    fHasNumberReturned(false),
+    fNumberReturned(0),
+    fHasTotalMatches(false),
+    fTotalMatches(0),
+    fHasUpdateID(false),
+    fUpdateID(0)
+{
+}
+
+void DidlParser::FeedSoap(const char* data, size_t length)
+{
+    fSoap.Feed(data, length);
+}
+
+void DidlParser::FeedDidl(const char* data, size_t length)
+{
+    fDidl.Feed(data, length);
+}
@@ -0,0 +1,173 @@
+#ifndef BETON_DIDL_PARSER_H
+#define BETON_DIDL_PARSER_H
+
+#include "DLNAService.h"
+
+#include <String.h>
+#include <SupportDefs.h>
+#include <string>
+#include <vector>
+
+/**
+ * @class XmlTokenizer
+ * @brief Single-pass, incremental XML tokenizer with SAX-style callbacks.
+ *
+ * Input may be fed in pieces of any size, split anywhere. Character and
+ * entity references are decoded in text and attribute values; CDATA is
+ * passed through as text; comments, processing instructions and DOCTYPE
+ * are skipped. Element names are reported as written, prefix included.
+ * There is no validation: malformed input yields whatever events it
+ * resembles, never an error.
+ *
+ * Scratch buffers are reused from tag to tag, so steady-state parsing does
+ * not allocate.
+ */
+class XmlTokenizer {
+public:
+    class Handler {
+    public:
+        virtual ~Handler() {}
+        /** @brief Attributes are available from the tokenizer meanwhile. */
+        virtual void StartElement(const XmlTokenizer& tokenizer,
+                                  const char* name) = 0;
+        virtual void EndElement(const char* name) = 0;
+        /** @brief A decoded run of text; one text node may come in several. */
+        virtual void Text(const char* text, size_t length) = 0;
+    };
+
+    explicit XmlTokenizer(Handler& handler);
+
+    void Feed(const char* data, size_t length);
+
+    /** @brief Value of an attribute of the element being started. */
+    const char* Attribute(const char* name) const;
+
+private:
+    enum State {
+        kText,
+        kTagStart,
+        kTagName,
+        kInTag,
+        kAttributeName,
+        kAttributeEquals,
+        kAttributeValue,
+        kEmptyClose,
+        kEndTag,
+        kBang,
+        kCdata,
+        kComment,
+        kInstruction,
+        kSkipTag,
+        kEntity
+    };
+
+    struct AttributeSlot {
+        std::string name;
+        std::string value;
+    };
+
+    void _StartElement(bool empty);
+    void _DecodeEntity();
+
+    Handler& fHandler;
+    State fState;
+    State fEntityReturn;   ///< Where a reference appears: text or value
+    std::string fName;
+    std::string fMarkup;   ///< "<!" lookahead, and references being read
+    std::vector<AttributeSlot> fAttributes;
+    size_t fAttributeCount;
+    char fQuote;
+    int32 fRun;            ///< ']' or '-' seen before a possible end
+};
+
+/**
+ * @class DidlParser
+ * @brief Parses ContentDirectory Browse and Search replies into
+ * DLNABrowseItems in one pass, as the body arrives.
+ *
+ * FeedSoap() takes the SOAP envelope: the escaped DIDL-Lite inside
+ * <Result> is decoded and parsed on the fly, without a copy of either
+ * document, and NumberReturned, TotalMatches and UpdateID are picked up.
+ * FeedDidl() takes a bare DIDL-Lite document.
+ *
+ * The fields follow the rules DLNAService has used: the first dc:title,
+ * dc:creator (upnp:artist without one), upnp:album, upnp:genre, upnp:class
+ * and upnp:albumArtURI of an object, and for items the URL, MIME type,
+ * duration and size of their first <res>.
+ */
+class DidlParser {
+public:
+    /** @param items Receives each object once its end tag is read. */
+    explicit DidlParser(std::vector<DLNABrowseItem>& items);
+
+    void FeedSoap(const char* data, size_t length);
+    void FeedDidl(const char* data, size_t length);
+
+    /** @brief True once a SOAP reply had a non-empty <Result>. */
+    bool HasResult() const { return fHasResult; }
+    bool HasNumberReturned() const { return fHasNumberReturned; }
+    uint32 NumberReturned() const { return fNumberReturned; }
+    bool HasTotalMatches() const { return fHasTotalMatches; }
+    uint32 TotalMatches() const { return fTotalMatches; }
+    bool HasUpdateID() const { return fHasUpdateID; }
+    uint32 UpdateID() const { return fUpdateID; }
+
+private:
+    /** @brief Builds DLNABrowseItems from DIDL-Lite events. */
+    class DidlHandler : public XmlTokenizer::Handler {
+    public:
+        explicit DidlHandler(std::vector<DLNABrowseItem>& items);
+
+        void StartElement(const XmlTokenizer& tokenizer,
+                          const char* name) override;
+        void EndElement(const char* name) override;
+        void Text(const char* text, size_t length) override;
+
+    private:
+        std::vector<DLNABrowseItem>& fItems;
+        DLNABrowseItem fItem;
+        BString fArtistFallback;
+        bool fInObject;
+        int32 fDepth;
+        int32 fObjectDepth;
+        BString* fField;       ///< Receiving text; null outside fields
+        std::string fText;     ///< Text of fField so far, reused per field
+        int32 fFieldDepth;
+        uint32 fSeen;          ///< Fields already taken from this object
+    };
+
+    /** @brief Reads the SOAP envelope and forwards <Result> to DIDL. */
+    class SoapHandler : public XmlTokenizer::Handler {
+    public:
+        explicit SoapHandler(DidlParser& parser);
+
+        void StartElement(const XmlTokenizer& tokenizer,
+                          const char* name) override;
+        void EndElement(const char* name) override;
+        void Text(const char* text, size_t length) override;
+
+    private:
+        enum Field { kNone, kResult, kNumberReturned, kTotalMatches,
+                     kUpdateID };
+
+        DidlParser& fParser;
+        Field fField;
+        int32 fResultDepth;    ///< Elements open inside <Result>
+        std::string fValue;
+    };
+
+    DidlHandler fDidlHandler;
+    XmlTokenizer fDidl;
+    SoapHandler fSoapHandler;
+    XmlTokenizer fSoap;
+
+    bool fHasResult;
+    bool fHasNumberReturned;
+    uint32 fNumberReturned;
+    bool fHasTotalMatches;
+    uint32 fTotalMatches;
+    bool fHasUpdateID;
+    uint32 fUpdateID;
+};
+
+#endif // BETON_DIDL_PARSER_H
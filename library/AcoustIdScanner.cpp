@@ -0,0 +1,623 @@
+#include "AcoustIdScanner.h"
+#include "Config.h"
+#include "Debug.h"
+#include "HttpConnectionPool.h"
+#include "Messages.h"
+#include "MetadataTagIO.h"
+#include "ParallelAlgorithms.h"
+
+#include <Autolock.h>
+#include <File.h>
+#include <FindDirectory.h>
+#include <Json.h>
+#include <Message.h>
+#include <Path.h>
+
+#include <algorithm>
+#include <cstring>
+#include <set>
+#include <sys/stat.h>
+
+#if ENABLE_ACOUSTID
+#include <chromaprint.h>
+
+extern "C" {
+#include <libavcodec/avcodec.h>
+#include <libavformat/avformat.h>
+#include <libavutil/channel_layout.h>
+#include <libswresample/swresample.h>
+}
+#endif
+
+static const char *kLookupUrl = "https://api.acoustid.org/v2/lookup";
+
+/** @brief Failed lookups in a row after which a run stops asking. */
+static const int32 kMaxLookupFailures = 3;
+
+/**
+ * @brief Returns the path of the fingerprint cache in the settings directory.
+ */
+static BString FingerprintCachePath() {
+  BPath settingsPath;
+  find_directory(B_USER_SETTINGS_DIRECTORY, &settingsPath);
+  settingsPath.Append("BeTon/acoustid.settings");
+  return BString(settingsPath.Path());
+}
+
+/**
+ * @brief Best AcoustID of a lookup "results" array (a BJson array message),
+ * or an empty string if none scores at least `minScore`.
+ */
+static BString BestResult(const BMessage &results, float minScore) {
+  BString best;
+  double bestScore = minScore;
+  BMessage result;
+  for (int32 i = 0;; i++) {
+    BString name;
+    name << i;
+    if (results.FindMessage(name.String(), &result) != B_OK)
+      break;
+    double score = result.GetDouble("score", 0.0);
+    const char *id = result.GetString("id", nullptr);
+    if (id != nullptr && score >= bestScore) {
+      best = id;
+      bestScore = score;
+    }
+  }
+  return best;
+}
+
+/** @brief The "index" of one answer of a batched lookup; -1 if missing. */
+static int32 ResultIndex(const BMessage &answer) {
+  double number;
+  if (answer.FindDouble("index", &number) == B_OK)
+    return (int32)number;
+  const char *text;
+  if (answer.FindString("index", &text) == B_OK)
+    return atoi(text);
+  return -1;
+}
+
+#if ENABLE_ACOUSTID
+namespace {
+
+/** @brief FFmpeg and Chromaprint state of one fingerprint; frees it all. */
+struct FingerprintState {
+  AVFormatContext *input = nullptr;
+  AVCodecContext *decoder = nullptr;
+  SwrContext *resampler = nullptr;
+  AVFrame *frame = nullptr;
+  AVPacket *packet = nullptr;
+  ChromaprintContext *chromaprint = nullptr;
+
+  ~FingerprintState() {
+    if (chromaprint != nullptr)
+      chromaprint_free(chromaprint);
+    swr_free(&resampler);
+    av_frame_free(&frame);
+    av_packet_free(&packet);
+    avcodec_free_context(&decoder);
+    avformat_close_input(&input);
+  }
+};
+
+} // namespace
+#endif
+
+bool AcoustIdScanner::FileKey::operator<(const FileKey &other) const {
+  if (inode != other.inode)
+    return inode < other.inode;
+  return mtime < other.mtime;
+}
+
+AcoustIdScanner::AcoustIdScanner(const BMessenger &target)
+    : fTarget(target), fThread(-1), fCancel(false), fRunning(false),
+      fWriteToFiles(false), fClientKey(ACOUSTID_CLIENT_KEY), fNext(0),
+      fFingerprinters(0), fDone(0), fIdentified(0), fTotal(0),
+      fQueued(create_sem(0, "acoustid queued")), fLastLookup(0),
+      fOldestQueued(0) {}
+
+AcoustIdScanner::~AcoustIdScanner() {
+  Cancel();
+  if (fQueued >= 0)
+    delete_sem(fQueued);
+}
+
+status_t AcoustIdScanner::Start(LibrarySnapshot *snapshot, bool writeToFiles) {
+  Cancel();
+  if (snapshot == nullptr)
+    return B_BAD_VALUE;
+  if (fQueued < 0)
+    return fQueued;
+
+  fSnapshot.SetTo(snapshot);
+  fWriteToFiles = writeToFiles;
+  fCancel = false;
+  fRunning = true;
+  fThread = spawn_thread(_ThreadEntry, "AcoustIdScanner", B_LOW_PRIORITY, this);
+  if (fThread < 0) {
+    status_t status = fThread;
+    fRunning = false;
+    return status;
+  }
+  return resume_thread(fThread);
+}
+
+void AcoustIdScanner::Cancel() {
+  fCancel = true;
+  if (fThread >= 0) {
+    status_t result;
+    wait_for_thread(fThread, &result);
+    fThread = -1;
+  }
+  fRunning = false;
+}
+
+int32 AcoustIdScanner::_ThreadEntry(void *data) {
+  auto *scanner = static_cast<AcoustIdScanner *>(data);
+  scanner->_Run();
+  scanner->fRunning = false;
+  return 0;
+}
+
+void AcoustIdScanner::_ReportProgress(bool done) {
+  BMessage progress(MSG_ACOUSTID_PROGRESS);
+  progress.AddInt32("current", fDone.load());
+  progress.AddInt32("total", fTotal);
+  progress.AddInt32("identified", fIdentified.load());
+  progress.AddBool("done", done);
+  fTarget.SendMessage(&progress);
+}
+
+void AcoustIdScanner::_Run() {
+  bigtime_t t0 = system_time();
+  const std::vector<MediaItem> &items = fSnapshot->Items();
+  _LoadCache();
+
+  // Items the cache already knows about are not decoded again.
+  BMessage known(MSG_ACOUSTID_RESULT);
+  std::vector<Pending> lookups;
+  fWork.clear();
+  for (size_t i = 0; i < items.size(); i++) {
+    const MediaItem &item = items[i];
+    if (item.missing || !item.HasFile() || !item.acoustId.IsEmpty())
+      continue;
+    BString lower(item.path);
+    lower.ToLower();
+    if (lower.EndsWith(".mid") || lower.EndsWith(".midi"))
+      continue;
+
+    Pending pending = {i, FileKey{item.inode, item.mtime}};
+    auto it = fCache.find(pending.key);
+    if (it == fCache.end()) {
+      fWork.push_back(pending);
+    } else if (!it->second.acoustId.IsEmpty()) {
+      known.AddString("path", item.path);
+      known.AddString("acoustId", it->second.acoustId);
+    } else if (_NeedsLookup(it->second)) {
+      lookups.push_back(pending);
+    }
+  }
+  if (!known.IsEmpty())
+    fTarget.SendMessage(&known);
+
+  {
+    BAutolock lock(&fLock);
+    fLookups.assign(lookups.begin(), lookups.end());
+    fOldestQueued = 0;
+  }
+  const int32 workers =
+      std::min(ParallelAlgorithms::WorkerCount(), (int32)fWork.size());
+  const bool lookup = !fClientKey.IsEmpty();
+  fTotal = (int32)(fWork.size() + lookups.size());
+  fNext = 0;
+  fDone = 0;
+  type_code type;
+  int32 knownCount = 0;
+  known.GetInfo("path", &type, &knownCount);
+  fIdentified = knownCount;
+  fFingerprinters = workers;
+  _ReportProgress(false);
+
+  // Helpers inherit the priority of this thread (B_LOW_PRIORITY); the
+  // first task sends the lookups while the others decode.
+  const int32 tasks = workers + (lookup ? 1 : 0);
+  if (tasks > 0) {
+    ParallelAlgorithms::Run(tasks, [&](int32 task) {
+      if (lookup && task == 0)
+        _LookupLoop();
+      else
+        _Fingerprint();
+    });
+  }
+
+  DEBUG_PRINT("AcoustIdScanner: %ld of %ld files, %ld identified in %lld "
+              "ms%s\n",
+              (long)fDone.load(), (long)fTotal, (long)fIdentified.load(),
+              (long long)(system_time() - t0) / 1000,
+              fCancel.load() ? " (cancelled)" : "");
+  _SaveCache(items);
+  _ReportProgress(true);
+  fWork.clear();
+  {
+    BAutolock lock(&fLock);
+    fLookups.clear();
+    fCache.clear();
+  }
+  fSnapshot.Unset();
+}
+
+bool AcoustIdScanner::_NeedsLookup(const CacheEntry &entry) const {
+  if (fClientKey.IsEmpty() || entry.fingerprint.IsEmpty() ||
+      !entry.acoustId.IsEmpty())
+    return false;
+  return entry.checked == 0 ||
+         (int64)real_time_clock() - entry.checked >= kRetryInterval;
+}
+
+void AcoustIdScanner::_Fingerprint() {
+  const std::vector<MediaItem> &items = fSnapshot->Items();
+  for (;;) {
+    int32 next = fNext.fetch_add(1);
+    if (next >= (int32)fWork.size() || fCancel.load())
+      break;
+    const Pending &pending = fWork[next];
+    const MediaItem &item = items[pending.index];
+
+    // Files tagged by another tagger keep their fingerprint.
+    CacheEntry entry;
+    MetadataTagIO::ReadAcoustId(BPath(item.path.String()), entry.acoustId,
+                                entry.fingerprint);
+    if (entry.fingerprint.IsEmpty() && entry.acoustId.IsEmpty()) {
+      status_t status =
+          _Compute(item.path.String(), entry.fingerprint, entry.duration);
+      if (status == B_CANCELED)
+        break;
+      if (status != B_OK) {
+        DEBUG_PRINT("AcoustIdScanner: cannot fingerprint %s: %s\n",
+                    item.path.String(), strerror(status));
+        fDone++;
+        _ReportProgress(false);
+        continue;
+      }
+    }
+    if (entry.duration <= 0)
+      entry.duration = item.duration;
+
+    if (_NeedsLookup(entry))
+      _Enqueue(pending, entry);
+    else
+      _Finish(pending, entry);
+  }
+
+  // The last worker lets the lookup task drain the queue.
+  if (fFingerprinters.fetch_sub(1) == 1)
+    release_sem(fQueued);
+}
+
+void AcoustIdScanner::_Enqueue(const Pending &pending,
+                               const CacheEntry &entry) {
+  {
+    BAutolock lock(&fLock);
+    fCache[pending.key] = entry;
+    if (fLookups.empty())
+      fOldestQueued = system_time();
+    fLookups.push_back(pending);
+  }
+  release_sem(fQueued);
+}
+
+void AcoustIdScanner::_LookupLoop() {
+  int32 failures = 0;
+  while (!fCancel.load()) {
+    const bool finished = fFingerprinters.load() == 0;
+    std::vector<Pending> batch;
+    {
+      BAutolock lock(&fLock);
+      bool due = !fLookups.empty() &&
+                 (finished || (int32)fLookups.size() >= kLookupBatch ||
+                  system_time() - fOldestQueued >= kBatchWait);
+      while (due && !fLookups.empty() && (int32)batch.size() < kLookupBatch) {
+        batch.push_back(fLookups.front());
+        fLookups.pop_front();
+      }
+      if (due && !fLookups.empty())
+        fOldestQueued = system_time();
+    }
+
+    if (!batch.empty()) {
+      // Once the service keeps failing, the rest waits for the next run.
+      if (failures < kMaxLookupFailures && _Lookup(batch)) {
+        failures = 0;
+      } else {
+        failures++;
+        fDone += (int32)batch.size();
+        _ReportProgress(false);
+      }
+      continue;
+    }
+    // Workers queue before they count themselves out.
+    if (finished)
+      break;
+    acquire_sem_etc(fQueued, 1, B_RELATIVE_TIMEOUT, kBatchWait / 4);
+  }
+}
+
+bool AcoustIdScanner::_Lookup(const std::vector<Pending> &batch) {
+  std::vector<CacheEntry> entries;
+  {
+    BAutolock lock(&fLock);
+    for (const Pending &pending : batch)
+      entries.push_back(fCache[pending.key]);
+  }
+
+  HttpConnectionPool::Request request;
+  request.method = "POST";
+  request.url = kLookupUrl;
+  request.headers = "Content-Type: application/x-www-form-urlencoded\r\n";
+  request.cancel = &fCancel;
+  // Fingerprints are URL-safe base64 and need no escaping.
+  request.body << "format=json&client=" << fClientKey;
+  for (size_t i = 0; i < entries.size(); i++) {
+    request.body << "&duration." << (int32)i << "=" << entries[i].duration
+                 << "&fingerprint." << (int32)i << "="
+                 << entries[i].fingerprint;
+  }
+
+  bigtime_t wait = fLastLookup + kLookupInterval - system_time();
+  if (wait > 0)
+    snooze(wait);
+  fLastLookup = system_time();
+
+  HttpConnectionPool::Response response;
+  status_t status = HttpConnectionPool::Default().Fetch(request, response);
+  if (status != B_OK || response.status != 200) {
+    DEBUG_PRINT("AcoustIdScanner: lookup failed: %s (HTTP %ld)\n",
+                strerror(status), (long)response.status);
+    return false;
+  }
+
+  BMessage reply;
+  BString json((const char *)response.body.data(),
+               (int32)response.body.size());
+  if (BPrivate::BJson::Parse(json, reply) != B_OK ||
+      strcmp(reply.GetString("status", ""), "ok") != 0) {
+    DEBUG_PRINT("AcoustIdScanner: unexpected lookup reply\n");
+    return false;
+  }
+
+  // Batches answer per "index"; a single fingerprint may be answered plain.
+  BMessage answers, answer, results;
+  if (reply.FindMessage("fingerprints", &answers) == B_OK) {
+    for (int32 i = 0;; i++) {
+      BString name;
+      name << i;
+      if (answers.FindMessage(name.String(), &answer) != B_OK)
+        break;
+      int32 index = ResultIndex(answer);
+      if (index >= 0 && index < (int32)entries.size() &&
+          answer.FindMessage("results", &results) == B_OK)
+        entries[index].acoustId = BestResult(results, kMinScore);
+    }
+  } else if (entries.size() == 1 &&
+             reply.FindMessage("results", &results) == B_OK) {
+    entries[0].acoustId = BestResult(results, kMinScore);
+  }
+
+  const int64 now = (int64)real_time_clock();
+  for (size_t i = 0; i < batch.size(); i++) {
+    entries[i].checked = now;
+    _Finish(batch[i], entries[i]);
+  }
+  return true;
+}
+
+void AcoustIdScanner::_Finish(const Pending &pending,
+                              const CacheEntry &entry) {
+  const MediaItem &item = fSnapshot->Items()[pending.index];
+  FileKey key = pending.key;
+
+  if (fWriteToFiles && !entry.fingerprint.IsEmpty()) {
+    BPath path(item.path.String());
+    BString storedId, storedFingerprint;
+    MetadataTagIO::ReadAcoustId(path, storedId, storedFingerprint);
+    if ((storedId != entry.acoustId && !entry.acoustId.IsEmpty()) ||
+        storedFingerprint != entry.fingerprint) {
+      // The write moves the modification time; the cache follows it.
+      struct stat st;
+      if (MetadataTagIO::WriteAcoustId(path, entry.acoustId,
+                                       entry.fingerprint) &&
+          stat(item.path.String(), &st) == 0)
+        key.mtime = st.st_mtime;
+    }
+  }
+
+  {
+    BAutolock lock(&fLock);
+    if (key.mtime != pending.key.mtime)
+      fCache.erase(pending.key);
+    fCache[key] = entry;
+  }
+
+  if (!entry.acoustId.IsEmpty()) {
+    fIdentified++;
+    BMessage result(MSG_ACOUSTID_RESULT);
+    result.AddString("path", item.path);
+    result.AddString("acoustId", entry.acoustId);
+    fTarget.SendMessage(&result);
+  }
+  fDone++;
+  _ReportProgress(false);
+}
+
+/**
+ * @brief Decodes up to kFingerprintSeconds of `path` to 11025 Hz mono and
+ * fingerprints it.
+ * @param duration Receives the length of the whole file in seconds, 0 if the
+ * container does not tell.
+ */
+status_t AcoustIdScanner::_Compute(const char *path, BString &fingerprint,
+                                   int32 &duration) {
+#if ENABLE_ACOUSTID
+  FingerprintState s;
+
+  if (avformat_open_input(&s.input, path, nullptr, nullptr) < 0 ||
+      avformat_find_stream_info(s.input, nullptr) < 0)
+    return B_BAD_DATA;
+  duration =
+      s.input->duration > 0 ? (int32)(s.input->duration / AV_TIME_BASE) : 0;
+
+  const AVCodec *decoderCodec = nullptr;
+  int streamIndex = av_find_best_stream(s.input, AVMEDIA_TYPE_AUDIO, -1, -1,
+                                        &decoderCodec, 0);
+  if (streamIndex < 0 || decoderCodec == nullptr)
+    return B_BAD_DATA;
+
+  s.decoder = avcodec_alloc_context3(decoderCodec);
+  if (s.decoder == nullptr ||
+      avcodec_parameters_to_context(
+          s.decoder, s.input->streams[streamIndex]->codecpar) < 0 ||
+      avcodec_open2(s.decoder, decoderCodec, nullptr) < 0)
+    return B_BAD_DATA;
+  if (s.decoder->ch_layout.nb_channels <= 0)
+    av_channel_layout_default(&s.decoder->ch_layout, 2);
+
+  const AVChannelLayout mono = AV_CHANNEL_LAYOUT_MONO;
+  if (swr_alloc_set_opts2(&s.resampler, &mono, AV_SAMPLE_FMT_S16, kSampleRate,
+                          &s.decoder->ch_layout, s.decoder->sample_fmt,
+                          s.decoder->sample_rate, 0, nullptr) < 0 ||
+      swr_init(s.resampler) < 0)
+    return B_ERROR;
+
+  s.chromaprint = chromaprint_new(CHROMAPRINT_ALGORITHM_DEFAULT);
+  s.frame = av_frame_alloc();
+  s.packet = av_packet_alloc();
+  if (s.chromaprint == nullptr || s.frame == nullptr || s.packet == nullptr)
+    return B_NO_MEMORY;
+  if (!chromaprint_start(s.chromaprint, kSampleRate, 1))
+    return B_ERROR;
+
+  const int64 limit = (int64)kFingerprintSeconds * kSampleRate;
+  int64 fed = 0;
+  std::vector<int16> pcm;
+
+  // Resamples `frame` (nullptr flushes the resampler) and feeds the samples
+  // up to the limit.
+  auto feed = [&](const AVFrame *frame) -> status_t {
+    int capacity = swr_get_out_samples(s.resampler,
+                                       frame != nullptr ? frame->nb_samples : 0);
+    if (capacity <= 0)
+      return B_OK;
+    pcm.resize(capacity);
+    uint8 *out = reinterpret_cast<uint8 *>(pcm.data());
+    int samples = swr_convert(
+        s.resampler, &out, capacity,
+        frame != nullptr ? (const uint8 **)frame->extended_data : nullptr,
+        frame != nullptr ? frame->nb_samples : 0);
+    if (samples < 0)
+      return B_ERROR;
+    samples = (int)std::min<int64>(samples, limit - fed);
+    if (samples > 0 && !chromaprint_feed(s.chromaprint, pcm.data(), samples))
+      return B_ERROR;
+    fed += samples;
+    return B_OK;
+  };
+
+  status_t status = B_OK;
+  while (status == B_OK && fed < limit) {
+    if (fCancel.load())
+      return B_CANCELED;
+    if (av_read_frame(s.input, s.packet) < 0)
+      break;
+    // A damaged packet is skipped, as a player would.
+    if (s.packet->stream_index == streamIndex &&
+        avcodec_send_packet(s.decoder, s.packet) == 0) {
+      while (status == B_OK && fed < limit &&
+             avcodec_receive_frame(s.decoder, s.frame) == 0) {
+        status = feed(s.frame);
+        av_frame_unref(s.frame);
+      }
+    }
+    av_packet_unref(s.packet);
+  }
+  if (status == B_OK && fed < limit)
+    status = feed(nullptr);
+  if (status != B_OK)
+    return status;
+  if (fed == 0)
+    return B_BAD_DATA;
+
+  char *encoded = nullptr;
+  if (!chromaprint_finish(s.chromaprint) ||
+      !chromaprint_get_fingerprint(s.chromaprint, &encoded) ||
+      encoded == nullptr)
+    return B_ERROR;
+  fingerprint = encoded;
+  chromaprint_dealloc(encoded);
+  return B_OK;
+#else
+  (void)path;
+  (void)fingerprint;
+  duration = 0;
+  return B_NOT_SUPPORTED;
+#endif
+}
+
+void AcoustIdScanner::_LoadCache() {
+  BAutolock lock(&fLock);
+  fCache.clear();
+
+  BFile file(FingerprintCachePath().String(), B_READ_ONLY);
+  BMessage archive;
+  if (file.InitCheck() != B_OK || archive.Unflatten(&file) != B_OK)
+    return;
+
+  int64 inode, mtime, checked;
+  int32 duration;
+  const char *fingerprint, *acoustId;
+  for (int32 i = 0; archive.FindInt64("inode", i, &inode) == B_OK; i++) {
+    if (archive.FindInt64("mtime", i, &mtime) != B_OK ||
+        archive.FindString("fingerprint", i, &fingerprint) != B_OK ||
+        archive.FindString("acoustId", i, &acoustId) != B_OK ||
+        archive.FindInt32("duration", i, &duration) != B_OK ||
+        archive.FindInt64("checked", i, &checked) != B_OK)
+      break;
+    CacheEntry &entry = fCache[FileKey{inode, mtime}];
+    entry.fingerprint = fingerprint;
+    entry.acoustId = acoustId;
+    entry.duration = duration;
+    entry.checked = checked;
+  }
+}
+
+/**
+ * @brief Writes the cache, dropping the files no longer in `items`.
+ *
+ * Kept by inode alone: a file this run wrote to is cached under its new
+ * modification time, which the snapshot does not know yet.
+ */
+void AcoustIdScanner::_SaveCache(const std::vector<MediaItem> &items) {
+  std::set<int64> current;
+  for (const MediaItem &item : items)
+    current.insert(item.inode);
+
+  BMessage archive;
+  {
+    BAutolock lock(&fLock);
+    for (const auto &entry : fCache) {
+      if (current.count(entry.first.inode) == 0)
+        continue;
+      archive.AddInt64("inode", entry.first.inode);
+      archive.AddInt64("mtime", entry.first.mtime);
+      archive.AddString("fingerprint", entry.second.fingerprint);
+      archive.AddString("acoustId", entry.second.acoustId);
+      archive.AddInt32("duration", entry.second.duration);
+      archive.AddInt64("checked", entry.second.checked);
+    }
+  }
+
+  BFile file(FingerprintCachePath().String(),
+             B_WRITE_ONLY | B_CREATE_FILE | B_ERASE_FILE);
+  if (file.InitCheck() != B_OK || archive.Flatten(&file) != B_OK)
+    DEBUG_PRINT("AcoustIdScanner: could not save the fingerprint cache\n");
+}
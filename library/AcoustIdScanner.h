@@ -0,0 +1,144 @@
+#ifndef BETON_ACOUSTID_SCANNER_H
+#define BETON_ACOUSTID_SCANNER_H
+
+#include "LibrarySnapshot.h"
+#include "MediaItem.h"
+
+#include <Locker.h>
+#include <Messenger.h>
+#include <OS.h>
+#include <String.h>
+#include <SupportDefs.h>
+#include <atomic>
+#include <deque>
+#include <map>
+#include <vector>
+
+/**
+ * @class AcoustIdScanner
+ * @brief Identifies the recordings of the library with Chromaprint
+ * fingerprints and the AcoustID web service, in the background.
+ *
+ * A run works on every item without an AcoustID. Files that already carry a
+ * fingerprint or an ID in their tags or `BeTon:AcoustId*` attributes are not
+ * decoded. The others are decoded with FFmpeg, only the first
+ * kFingerprintSeconds, downmixed to mono and resampled to 11025 Hz (the
+ * rate Chromaprint works at), on a low-priority worker pool
+ * (`ParallelAlgorithms::Run()` from a `B_LOW_PRIORITY` thread).
+ *
+ * One more task of the pool sends the fingerprints to the AcoustID lookup
+ * service, up to kLookupBatch per POST and no faster than kLookupInterval
+ * (the service allows three requests a second). A partial batch is sent
+ * after kBatchWait. Without ACOUSTID_CLIENT_KEY nothing is looked up.
+ *
+ * Fingerprints and results are cached in `acoustid.settings` by inode and
+ * modification time, so a cancelled run continues where it stopped and a
+ * file without a match is asked about again only after kRetryInterval.
+ *
+ * The IDs found are sent to the target as `MSG_ACOUSTID_RESULT` with a
+ * "path" and "acoustId" per item. Progress is sent as
+ * `MSG_ACOUSTID_PROGRESS` ("current", "total" files, "identified"; "done"
+ * at the end).
+ */
+class AcoustIdScanner {
+public:
+  static const int32 kFingerprintSeconds = 120;
+  static const int32 kSampleRate = 11025;
+  static const int32 kLookupBatch = 16;
+  static const bigtime_t kLookupInterval = 340000;
+  static const bigtime_t kBatchWait = 2000000;
+  static const int64 kRetryInterval = 30 * 24 * 3600;
+  static constexpr float kMinScore = 0.7f;
+
+  explicit AcoustIdScanner(const BMessenger &target);
+  ~AcoustIdScanner();
+
+  /**
+   * @brief Starts a run over `snapshot`; cancels a run still in progress.
+   * @param writeToFiles Also store new fingerprints and IDs with
+   * MetadataTagIO::WriteAcoustId().
+   */
+  status_t Start(LibrarySnapshot *snapshot, bool writeToFiles);
+
+  /** @brief Stops the current run and waits for its threads. */
+  void Cancel();
+
+  bool IsRunning() const { return fThread >= 0 && fRunning.load(); }
+
+private:
+  struct FileKey {
+    int64 inode;
+    int64 mtime;
+
+    bool operator<(const FileKey &other) const;
+  };
+
+  struct CacheEntry {
+    BString fingerprint;
+    BString acoustId;
+    int32 duration = 0; ///< Seconds, as sent with the fingerprint
+    int64 checked = 0;  ///< real_time_clock() of the last lookup, 0 = none
+  };
+
+  /** @brief An item waiting for its lookup. */
+  struct Pending {
+    size_t index;
+    FileKey key;
+  };
+
+  static int32 _ThreadEntry(void *data);
+  void _Run();
+
+  /** @brief Decode worker: fingerprints items until none are left. */
+  void _Fingerprint();
+  /** @brief Lookup task: sends batches until the workers are done. */
+  void _LookupLoop();
+
+  /** @brief Decodes the start of `path` and fingerprints it. */
+  status_t _Compute(const char *path, BString &fingerprint, int32 &duration);
+
+  /**
+   * @brief Looks up one batch and stores the results.
+   * @return False if the service could not be asked or did not answer.
+   */
+  bool _Lookup(const std::vector<Pending> &batch);
+
+  /** @brief Stores a result in the cache and the files; reports a match. */
+  void _Finish(const Pending &pending, const CacheEntry &entry);
+
+  /** @brief Caches a fingerprint and queues it for the lookup task. */
+  void _Enqueue(const Pending &pending, const CacheEntry &entry);
+  bool _NeedsLookup(const CacheEntry &entry) const;
+
+  void _LoadCache();
+  void _SaveCache(const std::vector<MediaItem> &items);
+
+  void _ReportProgress(bool done);
+
+  BMessenger fTarget;
+  BReference<LibrarySnapshot> fSnapshot;
+  thread_id fThread;
+  std::atomic<bool> fCancel;
+  std::atomic<bool> fRunning;
+  bool fWriteToFiles;
+  BString fClientKey;
+
+  /** @name Current run (scanner and worker threads) */
+  ///@{
+  std::vector<Pending> fWork; ///< Items to fingerprint
+  std::atomic<int32> fNext;
+  std::atomic<int32> fFingerprinters; ///< Decode workers still running
+  std::atomic<int32> fDone;
+  std::atomic<int32> fIdentified;
+  int32 fTotal;
+  sem_id fQueued; ///< Released for every fingerprint queued for lookup
+  bigtime_t fLastLookup;
+
+  BLocker fLock{"AcoustIdScanner"}; ///< Guards the fields below
+  std::map<FileKey, CacheEntry> fCache;
+  std::deque<Pending> fLookups;
+  bigtime_t fOldestQueued;
+  ///@}
+};
+
+#endif // BETON_ACOUSTID_SCANNER_H
@@ -0,0 +1,247 @@
+#include "CacheCompression.h"
+#include "CacheStringTable.h"
+#include "ParallelAlgorithms.h"
+
+#include <Entry.h>
+#include <OS.h>
+#include <Path.h>
+
+#include <algorithm>
+#include <atomic>
+#include <new>
+#include <string.h>
+
+#if ENABLE_CACHE_COMPRESSION
+#include <lz4.h>
+#include <lz4hc.h>
+#include <zstd.h>
+#endif
+
+/** @brief Uncompressed bytes per block. */
+static const uint32 kCacheBlockSize = 1024 * 1024;
+
+/** @brief Images smaller than this are never compressed. */
+static const uint64 kMinCompressedSize = 1024 * 1024;
+
+/**
+ * @name Codec thresholds
+ * Decompression runs on all cores at several hundred MB/s per core. Below
+ * about 1 GB/s from disk LZ4's fewer bytes to read pay off; below about
+ * 200 MB/s Zstd's smaller files outweigh its slower decoding.
+ */
+///@{
+static const uint64 kLZ4BelowThroughput = 1000 * 1000 * 1000;
+static const uint64 kZstdBelowThroughput = 200 * 1000 * 1000;
+///@}
+
+static const int kZstdLevel = 9;
+
+static std::atomic<uint64> sReadThroughput(0);
+
+const char *CacheCompression::Name(CacheCodec codec) {
+  switch (codec) {
+  case kCacheCodecNone:
+    return "none";
+  case kCacheCodecLZ4:
+    return "lz4";
+  case kCacheCodecZstd:
+    return "zstd";
+  default:
+    return "?";
+  }
+}
+
+void CacheCompression::RecordRead(uint64 bytes, bigtime_t time) {
+  if (bytes < kMinMeasuredBytes)
+    return;
+  uint64 throughput = bytes * 1000000 / std::max(time, (bigtime_t)1);
+  uint64 unknown = 0;
+  sReadThroughput.compare_exchange_strong(unknown, throughput);
+}
+
+uint64 CacheCompression::ReadThroughput() { return sReadThroughput.load(); }
+
+CacheCodec CacheCompression::ChooseCodec(uint64 rawSize) {
+  uint64 throughput = ReadThroughput();
+  if (!Available() || rawSize < kMinCompressedSize || throughput == 0 ||
+      throughput >= kLZ4BelowThroughput)
+    return kCacheCodecNone;
+  return throughput >= kZstdBelowThroughput ? kCacheCodecLZ4 : kCacheCodecZstd;
+}
+
+/** @brief Compresses one block into `out`; empty if the codec failed. */
+static void CompressBlock(CacheCodec codec, const char *source, size_t size,
+                          std::vector<char> &out) {
+  out.clear();
+#if ENABLE_CACHE_COMPRESSION
+  if (codec == kCacheCodecLZ4) {
+    out.resize(LZ4_compressBound((int)size));
+    int written = LZ4_compress_HC(source, out.data(), (int)size,
+                                  (int)out.size(), LZ4HC_CLEVEL_DEFAULT);
+    out.resize(written > 0 ? written : 0);
+  } else if (codec == kCacheCodecZstd) {
+    out.resize(ZSTD_compressBound(size));
+    size_t written =
+        ZSTD_compress(out.data(), out.size(), source, size, kZstdLevel);
+    out.resize(ZSTD_isError(written) ? 0 : written);
+  }
+#else
+  (void)codec;
+  (void)source;
+  (void)size;
+#endif
+}
+
+status_t CacheCompression::Compress(const std::vector<char> &image,
+                                    CacheCodec codec,
+                                    std::vector<char> &file) {
+  if (!Available() || (codec != kCacheCodecLZ4 && codec != kCacheCodecZstd))
+    return B_NOT_SUPPORTED;
+
+  const uint32 count =
+      (uint32)((image.size() + kCacheBlockSize - 1) / kCacheBlockSize);
+  std::vector<std::vector<char>> blocks(count);
+  const int32 workers =
+      std::min(ParallelAlgorithms::WorkerCount(), (int32)count);
+  ParallelAlgorithms::Run(workers, [&](int32 worker) {
+    for (uint32 i = worker; i < count; i += workers) {
+      size_t start = (size_t)i * kCacheBlockSize;
+      size_t size = std::min((size_t)kCacheBlockSize, image.size() - start);
+      CompressBlock(codec, image.data() + start, size, blocks[i]);
+    }
+  });
+
+  CacheBlockHeader header;
+  memset(&header, 0, sizeof(header));
+  header.magic = kCacheBlockMagic;
+  header.codec = codec;
+  header.blockSize = kCacheBlockSize;
+  header.blockCount = count;
+  header.rawSize = image.size();
+
+  std::vector<CacheBlockEntry> entries(count);
+  uint64 offset = CacheAlignOffset(sizeof(header) +
+                                   (uint64)count * sizeof(CacheBlockEntry));
+  for (uint32 i = 0; i < count; i++) {
+    size_t rawSize = std::min((size_t)kCacheBlockSize,
+                              image.size() - (size_t)i * kCacheBlockSize);
+    // Blocks that do not shrink are stored as they are.
+    if (blocks[i].empty() || blocks[i].size() >= rawSize) {
+      blocks[i].assign(image.begin() + (size_t)i * kCacheBlockSize,
+                       image.begin() + (size_t)i * kCacheBlockSize + rawSize);
+      entries[i].flags = kCacheBlockStored;
+    } else {
+      entries[i].flags = 0;
+    }
+    entries[i].offset = offset;
+    entries[i].size = (uint32)blocks[i].size();
+    offset += blocks[i].size();
+  }
+
+  file.assign(offset, 0);
+  memcpy(file.data(), &header, sizeof(header));
+  memcpy(file.data() + sizeof(header), entries.data(),
+         entries.size() * sizeof(CacheBlockEntry));
+  for (uint32 i = 0; i < count; i++) {
+    memcpy(file.data() + entries[i].offset, blocks[i].data(),
+           blocks[i].size());
+  }
+  return B_OK;
+}
+
+status_t CacheCompression::DecompressBlock(CacheCodec codec,
+                                           const char *source,
+                                           const CacheBlockEntry &entry,
+                                           char *dest, size_t destSize) {
+  if ((entry.flags & kCacheBlockStored) != 0) {
+    if (entry.size != destSize)
+      return B_BAD_DATA;
+    memcpy(dest, source, destSize);
+    return B_OK;
+  }
+#if ENABLE_CACHE_COMPRESSION
+  if (codec == kCacheCodecLZ4) {
+    int read = LZ4_decompress_safe(source, dest, (int)entry.size,
+                                   (int)destSize);
+    return read == (int)destSize ? B_OK : B_BAD_DATA;
+  }
+  if (codec == kCacheCodecZstd) {
+    size_t read = ZSTD_decompress(dest, destSize, source, entry.size);
+    return !ZSTD_isError(read) && read == destSize ? B_OK : B_BAD_DATA;
+  }
+#else
+  (void)codec;
+#endif
+  return B_NOT_SUPPORTED;
+}
+
+// ============================================================================
+// CacheFileWriter
+// ============================================================================
+
+CacheFileWriter::CacheFileWriter(const char *path, uint64 size,
+                                 CacheCodec codec)
+    : fPath(path), fCodec(codec), fStatus(B_OK), fCommitted(false) {
+  if (fCodec == kCacheCodecAuto)
+    fCodec = CacheCompression::ChooseCodec(size);
+  if (fCodec != kCacheCodecNone && !CacheCompression::Available())
+    fCodec = kCacheCodecNone;
+
+  fTmpPath = fPath;
+  fTmpPath << ".tmp";
+  fStatus = fFile.SetTo(fTmpPath.String(),
+                        B_WRITE_ONLY | B_CREATE_FILE | B_ERASE_FILE);
+  if (fStatus == B_OK && fCodec != kCacheCodecNone) {
+    try {
+      fImage.assign(size, 0);
+    } catch (const std::bad_alloc &) {
+      fStatus = B_NO_MEMORY;
+    }
+  }
+}
+
+CacheFileWriter::~CacheFileWriter() {
+  if (!fCommitted) {
+    fFile.Unset();
+    BEntry(fTmpPath.String()).Remove();
+  }
+}
+
+void CacheFileWriter::WriteAt(uint64 offset, const void *data, size_t size) {
+  if (fStatus != B_OK || size == 0)
+    return;
+  if (fCodec == kCacheCodecNone) {
+    if (fFile.WriteAt((off_t)offset, data, size) != (ssize_t)size)
+      fStatus = B_IO_ERROR;
+    return;
+  }
+  if (offset > fImage.size() || size > fImage.size() - offset) {
+    fStatus = B_BAD_VALUE;
+    return;
+  }
+  memcpy(fImage.data() + offset, data, size);
+}
+
+status_t CacheFileWriter::Commit() {
+  if (fStatus == B_OK && fCodec != kCacheCodecNone) {
+    std::vector<char> file;
+    fStatus = CacheCompression::Compress(fImage, fCodec, file);
+    std::vector<char>().swap(fImage);
+    if (fStatus == B_OK &&
+        fFile.WriteAt(0, file.data(), file.size()) != (ssize_t)file.size())
+      fStatus = B_IO_ERROR;
+  }
+  if (fStatus == B_OK && fFile.Sync() != B_OK)
+    fStatus = B_IO_ERROR;
+  fFile.Unset();
+  if (fStatus != B_OK)
+    return fStatus;
+
+  BEntry tmpEntry(fTmpPath.String());
+  BPath target(fPath.String());
+  BString leaf(target.Leaf());
+  fStatus = tmpEntry.Rename(leaf.String(), true);
+  if (fStatus == B_OK)
+    fCommitted = true;
+  return fStatus;
+}
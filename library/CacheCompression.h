@@ -0,0 +1,150 @@
+#ifndef BETON_CACHE_COMPRESSION_H
+#define BETON_CACHE_COMPRESSION_H
+
+#include "Config.h"
+
+#include <File.h>
+#include <String.h>
+#include <SupportDefs.h>
+#include <vector>
+
+/**
+ * @file CacheCompression.h
+ * @brief Optional block compression of the binary cache files.
+ *
+ * A compressed cache file is a `CacheBlockHeader`, a table of
+ * `CacheBlockEntry`s and the blocks. Each block holds `blockSize` bytes of
+ * the uncompressed file image (the last one fewer) and is compressed on its
+ * own, so the blocks decompress in parallel and the image keeps the layout
+ * of an uncompressed file: `CacheFileMapping` hands out the same sections
+ * either way. A block that does not shrink is stored as is.
+ *
+ * Whether a file is compressed, and with which codec, is chosen when it is
+ * written from the read throughput measured when a cache was loaded:
+ * uncompressed files on fast disks stay mapped, slow (network or USB)
+ * settings directories get LZ4 or, slower still, Zstd.
+ */
+
+/** @brief Magic of a compressed cache file. */
+static const uint32 kCacheBlockMagic = 'BTCZ';
+
+/** @brief Block compression of a cache file. */
+enum CacheCodec {
+  kCacheCodecNone = 0,
+  kCacheCodecLZ4,
+  kCacheCodecZstd,
+  kCacheCodecAuto = 0xff ///< Writers only: CacheCompression::ChooseCodec()
+};
+
+/** @brief Block flag: stored uncompressed. */
+static const uint32 kCacheBlockStored = 1;
+
+struct CacheBlockHeader {
+  uint32 magic;
+  uint32 codec;
+  uint32 blockSize;  ///< Uncompressed bytes per block
+  uint32 blockCount;
+  uint64 rawSize;    ///< Size of the uncompressed image
+  uint64 reserved;
+};
+
+struct CacheBlockEntry {
+  uint64 offset; ///< Absolute file offset of the block
+  uint32 size;   ///< Bytes in the file
+  uint32 flags;
+};
+
+/**
+ * @struct CacheLoadStats
+ * @brief How long reading a cache file took, for the load logs and the
+ * benchmark.
+ */
+struct CacheLoadStats {
+  CacheCodec codec = kCacheCodecNone;
+  uint64 fileBytes = 0;         ///< Read (or measured) from disk
+  uint64 rawBytes = 0;          ///< Size of the image
+  bigtime_t readTime = 0;       ///< Reading `fileBytes`
+  bigtime_t decompressTime = 0; ///< Decompressing all blocks
+};
+
+/**
+ * @class CacheCompression
+ * @brief Codecs, the block container and the codec choice.
+ */
+class CacheCompression {
+public:
+  /** @brief Whether the build links the codecs (`make CACHE_COMPRESSION=1`). */
+  static bool Available() { return ENABLE_CACHE_COMPRESSION != 0; }
+
+  static const char *Name(CacheCodec codec);
+
+  /**
+   * @brief Notes the throughput of a cache read. Only the first read of at
+   * least `kMinMeasuredBytes` counts, as it is the least likely to come from
+   * the file cache; both caches live in the same settings directory.
+   */
+  static void RecordRead(uint64 bytes, bigtime_t time);
+
+  /** @brief Measured read throughput in bytes per second, 0 if unknown. */
+  static uint64 ReadThroughput();
+
+  /**
+   * @brief Codec for a file image of `rawSize` bytes: none without a
+   * measurement, for small files and on fast disks.
+   */
+  static CacheCodec ChooseCodec(uint64 rawSize);
+
+  /**
+   * @brief Compresses `image` into a complete compressed file.
+   * @return `B_OK`, or `B_NOT_SUPPORTED` for a codec this build lacks.
+   */
+  static status_t Compress(const std::vector<char> &image, CacheCodec codec,
+                           std::vector<char> &file);
+
+  /**
+   * @brief Decompresses one block into `dest`, which holds exactly its
+   * uncompressed size.
+   */
+  static status_t DecompressBlock(CacheCodec codec, const char *source,
+                                  const CacheBlockEntry &entry, char *dest,
+                                  size_t destSize);
+
+  /** @brief Reads below this size are not used as a measurement. */
+  static const uint64 kMinMeasuredBytes = 256 * 1024;
+};
+
+/**
+ * @class CacheFileWriter
+ * @brief Writes a cache file image of known size, compressed or not.
+ *
+ * Without compression the sections go straight to the file; otherwise they
+ * are collected into the image, which Commit() compresses. The data goes to
+ * a temporary sibling that Commit() renames over `path`, so a crash
+ * mid-write keeps the previous file intact.
+ */
+class CacheFileWriter {
+public:
+  CacheFileWriter(const char *path, uint64 size,
+                  CacheCodec codec = kCacheCodecAuto);
+  ~CacheFileWriter();
+
+  status_t InitCheck() const { return fStatus; }
+  CacheCodec Codec() const { return fCodec; }
+
+  /** @brief Writes `size` bytes at `offset` of the image. */
+  void WriteAt(uint64 offset, const void *data, size_t size);
+
+  /** @brief Syncs the file and renames it over the target. */
+  status_t Commit();
+
+private:
+  BString fPath;
+  BString fTmpPath;
+  BFile fFile;
+  CacheCodec fCodec;
+  std::vector<char> fImage; ///< Compressed codecs only
+  status_t fStatus;
+  bool fCommitted;
+};
+
+#endif // BETON_CACHE_COMPRESSION_H
@@ -0,0 +1,384 @@
+#include "CacheStringTable.h"
+#include "ParallelAlgorithms.h"
+
+#include <OS.h>
+
+#include <algorithm>
+#include <atomic>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/** @brief FNV-1a over a byte range. */
+static inline uint32 HashBytes(const char *data, uint32 length) {
+  uint32 hash = 2166136261u;
+  for (uint32 i = 0; i < length; i++) {
+    hash ^= (uint8)data[i];
+    hash *= 16777619u;
+  }
+  return hash;
+}
+
+static const uint32 kEmptySlot = 0xffffffffu;
+
+// ============================================================================
+// CacheStringTableWriter
+// ============================================================================
+
+CacheStringTableWriter::CacheStringTableWriter() {
+  // Ordinal 0 is reserved for the empty string.
+  fOffsets.push_back(0);
+  fHashes.push_back(HashBytes("", 0));
+  uint32 zero = 0;
+  fBlob.insert(fBlob.end(), (const char *)&zero,
+               (const char *)&zero + sizeof(zero));
+  fBlob.push_back('\0');
+  fHashSlots.assign(1024, kEmptySlot);
+}
+
+/**
+ * @brief Doubles the hash table and re-inserts all known ordinals.
+ */
+void CacheStringTableWriter::_GrowHashTable() {
+  std::vector<uint32> slots(fHashSlots.size() * 2, kEmptySlot);
+  const size_t mask = slots.size() - 1;
+  for (uint32 ordinal = 1; ordinal < fHashes.size(); ordinal++) {
+    size_t slot = fHashes[ordinal] & mask;
+    while (slots[slot] != kEmptySlot)
+      slot = (slot + 1) & mask;
+    slots[slot] = ordinal;
+  }
+  fHashSlots.swap(slots);
+}
+
+/**
+ * @brief Returns the ordinal of `value`, appending it to the blob if new.
+ */
+uint32 CacheStringTableWriter::Intern(const BString &value) {
+  const uint32 length = (uint32)value.Length();
+  if (length == 0)
+    return 0;
+
+  const char *data = value.String();
+  const uint32 hash = HashBytes(data, length);
+
+  if ((fOffsets.size() + 1) * 2 > fHashSlots.size())
+    _GrowHashTable();
+
+  const size_t mask = fHashSlots.size() - 1;
+  size_t slot = hash & mask;
+  while (fHashSlots[slot] != kEmptySlot) {
+    const uint32 ordinal = fHashSlots[slot];
+    if (fHashes[ordinal] == hash) {
+      const char *entry = fBlob.data() + fOffsets[ordinal];
+      uint32 entryLength;
+      memcpy(&entryLength, entry, sizeof(entryLength));
+      if (entryLength == length &&
+          memcmp(entry + sizeof(uint32), data, length) == 0)
+        return ordinal;
+    }
+    slot = (slot + 1) & mask;
+  }
+
+  const uint32 ordinal = (uint32)fOffsets.size();
+  fOffsets.push_back((uint32)fBlob.size());
+  fHashes.push_back(hash);
+  fBlob.insert(fBlob.end(), (const char *)&length,
+               (const char *)&length + sizeof(length));
+  fBlob.insert(fBlob.end(), data, data + length);
+  fBlob.push_back('\0');
+  fHashSlots[slot] = ordinal;
+  return ordinal;
+}
+
+// ============================================================================
+// CacheStringTableReader
+// ============================================================================
+
+CacheStringTableReader::CacheStringTableReader()
+    : fOffsets(nullptr), fCount(0), fBlob(nullptr) {}
+
+void CacheStringTableReader::Unset() {
+  fOffsets = nullptr;
+  fCount = 0;
+  fBlob = nullptr;
+  fStrings.clear();
+  fMaterialized.clear();
+}
+
+status_t CacheStringTableReader::SetTo(const uint32 *offsets, uint32 count,
+                                       const char *blob, uint64 blobSize) {
+  Unset();
+  if (count == 0)
+    return B_BAD_DATA;
+
+  for (uint32 i = 0; i < count; i++) {
+    const uint64 entry = offsets[i];
+    if (entry + sizeof(uint32) + 1 > blobSize)
+      return B_BAD_DATA;
+    uint32 length;
+    memcpy(&length, blob + entry, sizeof(length));
+    if (entry + sizeof(uint32) + length + 1 > blobSize ||
+        blob[entry + sizeof(uint32) + length] != '\0')
+      return B_BAD_DATA;
+  }
+
+  fOffsets = offsets;
+  fCount = count;
+  fBlob = blob;
+  fStrings.resize(count);
+  fMaterialized.assign(count, false);
+  return B_OK;
+}
+
+const char *CacheStringTableReader::StringAt(uint32 ordinal,
+                                             uint32 *outLength) const {
+  const char *entry = fBlob + fOffsets[ordinal];
+  if (outLength != nullptr)
+    memcpy(outLength, entry, sizeof(uint32));
+  return entry + sizeof(uint32);
+}
+
+/**
+ * @brief Returns the materialized `BString` for an ordinal.
+ *
+ * The first access copies the bytes out of the mapping; all further
+ * accesses share that buffer.
+ */
+const BString &CacheStringTableReader::BStringAt(uint32 ordinal) {
+  if (ordinal == 0 || ordinal >= fCount)
+    return fEmpty;
+
+  if (!fMaterialized[ordinal]) {
+    uint32 length = 0;
+    const char *data = StringAt(ordinal, &length);
+    fStrings[ordinal].SetTo(data, length);
+    fMaterialized[ordinal] = true;
+  }
+  return fStrings[ordinal];
+}
+
+// ============================================================================
+// CacheFileMapping
+// ============================================================================
+
+/** @brief Bytes of a mapped file touched to measure the disk. */
+static const size_t kMeasuredBytes = 4 * 1024 * 1024;
+
+CacheFileMapping::CacheFileMapping()
+    : fFD(-1), fMapping(nullptr), fSize(0), fMapped(false), fFileSize(0) {
+  memset(&fBlockHeader, 0, sizeof(fBlockHeader));
+}
+
+CacheFileMapping::~CacheFileMapping() { Close(); }
+
+/**
+ * @brief Releases the mapping (or fallback buffer) and the file descriptor.
+ */
+void CacheFileMapping::Close() {
+  if (fMapping != nullptr) {
+    if (fMapped)
+      munmap(fMapping, fSize);
+    else
+      free(fMapping);
+  }
+  if (fFD >= 0)
+    close(fFD);
+
+  fFD = -1;
+  fMapping = nullptr;
+  fSize = 0;
+  fMapped = false;
+  memset(&fBlockHeader, 0, sizeof(fBlockHeader));
+  fBlocks.clear();
+  fFileSize = 0;
+}
+
+status_t CacheFileMapping::Open(const char *path, size_t minSize) {
+  Close();
+  fStats = CacheLoadStats();
+
+  fFD = open(path, O_RDONLY);
+  if (fFD < 0)
+    return B_ENTRY_NOT_FOUND;
+
+  struct stat st;
+  if (fstat(fFD, &st) != 0 || st.st_size < (off_t)minSize) {
+    Close();
+    return B_BAD_DATA;
+  }
+  fSize = fFileSize = (size_t)st.st_size;
+
+  uint32 magic = 0;
+  if (pread(fFD, &magic, sizeof(magic), 0) == sizeof(magic) &&
+      magic == kCacheBlockMagic) {
+    status_t status = _OpenBlocks(minSize);
+    if (status != B_OK) {
+      Close();
+      return status;
+    }
+  }
+  return B_OK;
+}
+
+/**
+ * @brief Reads and validates the block table of a compressed file.
+ */
+status_t CacheFileMapping::_OpenBlocks(size_t minSize) {
+  CacheBlockHeader header;
+  if (pread(fFD, &header, sizeof(header), 0) != sizeof(header))
+    return B_BAD_DATA;
+  if (!CacheCompression::Available() ||
+      (header.codec != kCacheCodecLZ4 && header.codec != kCacheCodecZstd) ||
+      header.blockSize == 0 || header.rawSize < minSize ||
+      header.rawSize > (uint64)SIZE_MAX ||
+      header.blockCount !=
+          (header.rawSize + header.blockSize - 1) / header.blockSize)
+    return B_BAD_DATA;
+
+  const uint64 tableSize = (uint64)header.blockCount * sizeof(CacheBlockEntry);
+  if (tableSize > fFileSize - sizeof(header))
+    return B_BAD_DATA;
+  fBlocks.resize(header.blockCount);
+  if (pread(fFD, fBlocks.data(), tableSize, sizeof(header)) !=
+      (ssize_t)tableSize)
+    return B_BAD_DATA;
+
+  fBlockHeader = header;
+  for (uint32 i = 0; i < header.blockCount; i++) {
+    const CacheBlockEntry &entry = fBlocks[i];
+    if (entry.offset > fFileSize || entry.size > fFileSize - entry.offset ||
+        ((entry.flags & kCacheBlockStored) != 0 &&
+         entry.size != _BlockSize(i)))
+      return B_BAD_DATA;
+  }
+  fSize = (size_t)header.rawSize;
+  return B_OK;
+}
+
+size_t CacheFileMapping::_BlockSize(uint32 index) const {
+  uint64 start = (uint64)index * fBlockHeader.blockSize;
+  return (size_t)std::min((uint64)fBlockHeader.blockSize,
+                          fBlockHeader.rawSize - start);
+}
+
+/**
+ * @brief Decompresses block `index` from the file contents at `source`.
+ */
+bool CacheFileMapping::_ReadBlock(uint32 index, const char *source,
+                                  char *dest) const {
+  const CacheBlockEntry &entry = fBlocks[index];
+  return CacheCompression::DecompressBlock((CacheCodec)fBlockHeader.codec,
+                                           source + entry.offset, entry, dest,
+                                           _BlockSize(index)) == B_OK;
+}
+
+bool CacheFileMapping::Probe(void *buffer, size_t size, off_t offset) const {
+  if (fFD < 0)
+    return false;
+  if (fBlockHeader.magic != kCacheBlockMagic)
+    return pread(fFD, buffer, size, offset) == (ssize_t)size;
+
+  // Headers lie in the first block; decompress only that one.
+  if (fBlocks.empty() || offset < 0 || (uint64)offset + size > _BlockSize(0))
+    return false;
+  const CacheBlockEntry &entry = fBlocks[0];
+  std::vector<char> source(entry.offset + entry.size);
+  std::vector<char> block(_BlockSize(0));
+  if (pread(fFD, source.data() + entry.offset, entry.size, entry.offset) !=
+          (ssize_t)entry.size ||
+      !_ReadBlock(0, source.data(), block.data()))
+    return false;
+  memcpy(buffer, block.data() + offset, size);
+  return true;
+}
+
+status_t CacheFileMapping::Map() {
+  if (fFD < 0)
+    return B_NO_INIT;
+  if (fMapping != nullptr)
+    return B_OK;
+  if (fBlockHeader.magic == kCacheBlockMagic)
+    return _MapBlocks();
+
+  fStats.rawBytes = fSize;
+  void *mapping = mmap(nullptr, fSize, PROT_READ, MAP_SHARED, fFD, 0);
+  if (mapping != MAP_FAILED) {
+    fMapping = mapping;
+    fMapped = true;
+
+    // The readers fault these pages in anyway; timing it measures the disk.
+    const size_t measured = std::min(fSize, kMeasuredBytes);
+    bigtime_t start = system_time();
+    volatile uint8 sum = 0;
+    for (size_t i = 0; i < measured; i += B_PAGE_SIZE)
+      sum = sum + ((const uint8 *)mapping)[i];
+    fStats.fileBytes = measured;
+    fStats.readTime = system_time() - start;
+    CacheCompression::RecordRead(fStats.fileBytes, fStats.readTime);
+    return B_OK;
+  }
+
+  bigtime_t start = system_time();
+  fMapping = malloc(fSize);
+  if (fMapping == nullptr || pread(fFD, fMapping, fSize, 0) != (ssize_t)fSize) {
+    Close();
+    return B_NO_MEMORY;
+  }
+  fStats.fileBytes = fSize;
+  fStats.readTime = system_time() - start;
+  CacheCompression::RecordRead(fStats.fileBytes, fStats.readTime);
+  return B_OK;
+}
+
+/**
+ * @brief Reads a compressed file in one call and decompresses its blocks
+ * into the image, a share of them on each core.
+ */
+status_t CacheFileMapping::_MapBlocks() {
+  fStats.codec = (CacheCodec)fBlockHeader.codec;
+  fStats.rawBytes = fSize;
+  fStats.fileBytes = fFileSize;
+
+  bigtime_t start = system_time();
+  char *source = (char *)malloc(fFileSize);
+  if (source == nullptr ||
+      pread(fFD, source, fFileSize, 0) != (ssize_t)fFileSize) {
+    free(source);
+    Close();
+    return B_NO_MEMORY;
+  }
+  bigtime_t read = system_time();
+  fStats.readTime = read - start;
+  CacheCompression::RecordRead(fStats.fileBytes, fStats.readTime);
+
+  char *image = (char *)malloc(fSize);
+  if (image == nullptr) {
+    free(source);
+    Close();
+    return B_NO_MEMORY;
+  }
+
+  const uint32 count = fBlockHeader.blockCount;
+  const int32 workers =
+      std::min(ParallelAlgorithms::WorkerCount(), (int32)count);
+  std::atomic<bool> ok(true);
+  ParallelAlgorithms::Run(workers, [&](int32 worker) {
+    for (uint32 i = worker; i < count && ok.load(); i += workers) {
+      if (!_ReadBlock(i, source, image + (size_t)i * fBlockHeader.blockSize))
+        ok.store(false);
+    }
+  });
+  free(source);
+  fStats.decompressTime = system_time() - read;
+
+  fMapping = image;
+  if (!ok.load()) {
+    Close();
+    return B_BAD_DATA;
+  }
+  return B_OK;
+}
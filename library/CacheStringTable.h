@@ -0,0 +1,159 @@
+#ifndef BETON_CACHE_STRING_TABLE_H
+#define BETON_CACHE_STRING_TABLE_H
+
+#include "CacheCompression.h"
+
+#include <String.h>
+#include <SupportDefs.h>
+#include <vector>
+
+/**
+ * @file CacheStringTable.h
+ * @brief Deduplicated string table shared by the binary cache formats.
+ *
+ * On disk a table is an offset array of `stringCount` uint32 entries into a
+ * blob of `uint32 length`, bytes, `'\0'` entries. Ordinal 0 is always the
+ * empty string. Records refer to strings by ordinal, so repeated values
+ * (artist, album, genre) are stored once.
+ */
+
+/**
+ * @class CacheStringTableWriter
+ * @brief Interns strings into a blob while a cache file is collected.
+ */
+class CacheStringTableWriter {
+public:
+  CacheStringTableWriter();
+
+  /** @brief Returns the ordinal of `value`, adding it if new. */
+  uint32 Intern(const BString &value);
+
+  /** @brief Number of distinct strings (including the empty string). */
+  uint32 CountStrings() const { return (uint32)fOffsets.size(); }
+
+  /** @brief Ordinal -> blob offset, as written to disk. */
+  const std::vector<uint32> &Offsets() const { return fOffsets; }
+
+  /** @brief The string blob, as written to disk. */
+  const std::vector<char> &Blob() const { return fBlob; }
+
+private:
+  void _GrowHashTable();
+
+  std::vector<uint32> fOffsets; ///< Ordinal -> blob offset
+  std::vector<uint32> fHashes;  ///< Ordinal -> string hash
+  std::vector<char> fBlob;
+  std::vector<uint32> fHashSlots; ///< Open-addressing table of ordinals
+};
+
+/**
+ * @class CacheStringTableReader
+ * @brief Reads a string table in place, from a mapped cache file.
+ *
+ * Each distinct string is turned into a `BString` at most once; later reads
+ * of the same ordinal return a shallow copy that shares the buffer.
+ */
+class CacheStringTableReader {
+public:
+  CacheStringTableReader();
+
+  /**
+   * @brief Points the reader at a table and validates every entry, so the
+   * accessors can stay unchecked.
+   * @return `B_OK` or `B_BAD_DATA`.
+   */
+  status_t SetTo(const uint32 *offsets, uint32 count, const char *blob,
+                 uint64 blobSize);
+
+  /** @brief Forgets the table and drops materialized strings. */
+  void Unset();
+
+  uint32 CountStrings() const { return fCount; }
+
+  /** @brief Returns a string without creating a `BString`. */
+  const char *StringAt(uint32 ordinal, uint32 *outLength = nullptr) const;
+
+  /** @brief Returns a string as a shared `BString`. */
+  const BString &BStringAt(uint32 ordinal);
+
+private:
+  const uint32 *fOffsets;
+  uint32 fCount;
+  const char *fBlob;
+
+  std::vector<BString> fStrings; ///< Lazily materialized strings by ordinal
+  std::vector<bool> fMaterialized;
+  BString fEmpty;
+};
+
+/**
+ * @class CacheFileMapping
+ * @brief Maps a cache file read-only.
+ *
+ * If mmap() is not available for the file, the whole file is read into a
+ * heap buffer in a single call instead. A compressed file (see
+ * CacheCompression.h) is read in one call and its blocks are decompressed
+ * into a heap buffer on all cores; Data() and Size() then describe the
+ * uncompressed image.
+ *
+ * Map() reports the read throughput to CacheCompression::RecordRead(); of a
+ * mapped file the first few MiB are touched for that.
+ */
+class CacheFileMapping {
+public:
+  CacheFileMapping();
+  ~CacheFileMapping();
+
+  /**
+   * @param path File to map.
+   * @param minSize Files (or images) shorter than this are rejected.
+   * @return `B_OK`, `B_ENTRY_NOT_FOUND`, `B_BAD_DATA` or `B_NO_MEMORY`.
+   * A compressed file this build cannot decompress is `B_BAD_DATA`.
+   */
+  status_t Open(const char *path, size_t minSize);
+
+  /** @brief Reads `size` bytes at `offset` before the file is mapped. */
+  bool Probe(void *buffer, size_t size, off_t offset) const;
+
+  /** @brief Maps the file opened with Open(). */
+  status_t Map();
+
+  void Close();
+
+  const char *Data() const { return (const char *)fMapping; }
+  size_t Size() const { return fSize; }
+
+  /** @brief Figures of the last Map(). */
+  const CacheLoadStats &LoadStats() const { return fStats; }
+
+  /** @brief Whether `size` bytes at `offset` lie inside the file. */
+  bool InBounds(uint64 offset, uint64 size) const {
+    return offset <= fSize && size <= fSize - offset;
+  }
+
+private:
+  status_t _OpenBlocks(size_t minSize);
+  bool _ReadBlock(uint32 index, const char *source, char *dest) const;
+  size_t _BlockSize(uint32 index) const;
+  status_t _MapBlocks();
+
+  int fFD;
+  void *fMapping; ///< mmap() result or malloc'ed fallback buffer
+  size_t fSize;   ///< Of the (uncompressed) image
+  bool fMapped;   ///< True if fMapping must be released with munmap()
+
+  /** @name Compressed files */
+  ///@{
+  CacheBlockHeader fBlockHeader; ///< magic 0 if not compressed
+  std::vector<CacheBlockEntry> fBlocks;
+  size_t fFileSize;
+  ///@}
+  CacheLoadStats fStats;
+};
+
+/** @brief Rounds a file offset up to the next 8-byte boundary. */
+static inline uint64 CacheAlignOffset(uint64 offset) {
+  return (offset + 7) & ~(uint64)7;
+}
+
+#endif // BETON_CACHE_STRING_TABLE_H
@@ -0,0 +1,403 @@
+#include "DuplicateFinder.h"
+#include "Debug.h"
+#include "LibrarySearchIndex.h"
+#include "Messages.h"
+#include "TrackMatchingUtils.h"
+
+#include <File.h>
+#include <FindDirectory.h>
+#include <Message.h>
+#include <Path.h>
+#include <algorithm>
+#include <set>
+#include <string.h>
+#include <sys/stat.h>
+#include <unordered_map>
+
+/** @brief Largest duration gap (seconds) between recordings of one track. */
+static const int32 kDurationTolerance = 2;
+/** @brief Read size while hashing payloads. */
+static const size_t kHashChunkSize = 64 * 1024;
+/** @brief Minimum interval between two progress messages. */
+static const bigtime_t kProgressInterval = 100000;
+
+static const uint64 kFnvOffset = 0xcbf29ce484222325ULL;
+static const uint64 kFnvPrime = 0x100000001b3ULL;
+
+/**
+ * @brief Returns the path of the payload hash cache in the settings directory.
+ */
+static BString HashCachePath() {
+  BPath settingsPath;
+  find_directory(B_USER_SETTINGS_DIRECTORY, &settingsPath);
+  settingsPath.Append("BeTon/duplicate_hashes.settings");
+  return BString(settingsPath.Path());
+}
+
+/**
+ * @brief Returns the byte range of `file` holding the audio payload.
+ *
+ * Skips a leading ID3v2 tag, FLAC metadata blocks and a trailing ID3v1 tag,
+ * so retagging a file does not change its hash. Other containers are hashed
+ * whole. Returns false if the file cannot be read.
+ */
+static bool PayloadRange(BFile &file, int64 size, off_t &start, off_t &end) {
+  start = 0;
+  end = size;
+
+  uint8 header[10];
+  if (file.ReadAt(0, header, sizeof(header)) == (ssize_t)sizeof(header) &&
+      memcmp(header, "ID3", 3) == 0) {
+    // Syncsafe size, excluding the header and an optional footer.
+    off_t tagSize = ((off_t)(header[6] & 0x7f) << 21) |
+                    ((off_t)(header[7] & 0x7f) << 14) |
+                    ((off_t)(header[8] & 0x7f) << 7) | (header[9] & 0x7f);
+    start = 10 + tagSize + ((header[5] & 0x10) ? 10 : 0);
+  }
+
+  uint8 magic[4];
+  if (file.ReadAt(start, magic, 4) == 4 && memcmp(magic, "fLaC", 4) == 0) {
+    off_t pos = start + 4;
+    for (;;) {
+      uint8 block[4];
+      if (file.ReadAt(pos, block, 4) != 4)
+        return false;
+      pos += 4 + ((off_t)block[1] << 16 | (off_t)block[2] << 8 | block[3]);
+      if (block[0] & 0x80)
+        break;
+    }
+    start = pos;
+  }
+
+  if (size >= 128) {
+    char tag[3];
+    if (file.ReadAt(size - 128, tag, 3) == 3 && memcmp(tag, "TAG", 3) == 0)
+      end = size - 128;
+  }
+
+  if (start > end)
+    start = end;
+  return true;
+}
+
+DuplicateFinder::DuplicateFinder(const BMessenger &target)
+    : fTarget(target), fThread(-1), fCancel(false), fRunning(false),
+      fHashesLoaded(false), fHashesDirty(false) {}
+
+DuplicateFinder::~DuplicateFinder() { Cancel(); }
+
+status_t DuplicateFinder::Start(LibrarySnapshot *snapshot) {
+  Cancel();
+  if (snapshot == nullptr)
+    return B_BAD_VALUE;
+
+  fSnapshot.SetTo(snapshot);
+  fCancel = false;
+  fRunning = true;
+  fThread = spawn_thread(_ThreadEntry, "DuplicateFinder", B_LOW_PRIORITY, this);
+  if (fThread < 0) {
+    status_t status = fThread;
+    fRunning = false;
+    return status;
+  }
+  return resume_thread(fThread);
+}
+
+void DuplicateFinder::Cancel() {
+  fCancel = true;
+  if (fThread >= 0) {
+    status_t result;
+    wait_for_thread(fThread, &result);
+    fThread = -1;
+  }
+  fRunning = false;
+}
+
+int32 DuplicateFinder::_ThreadEntry(void *data) {
+  auto *finder = static_cast<DuplicateFinder *>(data);
+  finder->_Run();
+  finder->fRunning = false;
+  return 0;
+}
+
+void DuplicateFinder::_ReportProgress(int32 stage, int32 current,
+                                      int32 total) {
+  BMessage progress(MSG_DUPLICATE_PROGRESS);
+  progress.AddInt32("stage", stage);
+  progress.AddInt32("current", current);
+  progress.AddInt32("total", total);
+  fTarget.SendMessage(&progress);
+}
+
+void DuplicateFinder::_Run() {
+  bigtime_t t0 = system_time();
+  const std::vector<MediaItem> &items = fSnapshot->Items();
+  const size_t count = items.size();
+  _ReportProgress(kStageKeys, 0, (int32)count);
+
+  if (!fHashesLoaded)
+    _LoadHashCache();
+
+  BMessage result(MSG_DUPLICATES_FOUND);
+  auto addGroup = [&](int32 kind, const std::vector<uint32> &members) {
+    BMessage group;
+    group.AddInt32("kind", kind);
+    for (uint32 i : members) {
+      group.AddString("path", items[i].path);
+      group.AddInt64("size", items[i].size);
+      group.AddInt32("bitrate", items[i].bitrate);
+      group.AddInt32("duration", items[i].duration);
+    }
+    result.AddMessage("group", &group);
+  };
+
+  // Stage 1: equal inodes are only stat()ed to tell devices apart.
+  std::vector<bool> alias(count, false);
+  std::unordered_map<int64, std::vector<uint32>> byInode;
+  for (size_t i = 0; i < count; i++) {
+    const MediaItem &item = items[i];
+    if (item.HasFile() && !item.missing && item.inode != 0)
+      byInode[item.inode].push_back((uint32)i);
+  }
+  for (const auto &bucket : byInode) {
+    if (fCancel)
+      return;
+    if (bucket.second.size() < 2)
+      continue;
+
+    std::map<dev_t, std::vector<uint32>> byDevice;
+    for (uint32 i : bucket.second) {
+      struct stat st;
+      if (stat(items[i].path.String(), &st) == 0 &&
+          (int64)st.st_ino == bucket.first)
+        byDevice[st.st_dev].push_back(i);
+    }
+    for (const auto &files : byDevice) {
+      if (files.second.size() < 2)
+        continue;
+      addGroup(kSameFile, files.second);
+      for (size_t k = 1; k < files.second.size(); k++)
+        alias[files.second[k]] = true;
+    }
+  }
+
+  // Stage 2: cheap candidate keys, one representative per file.
+  std::map<std::pair<int64, int32>, std::vector<uint32>> bySize;
+  std::map<BString, std::vector<uint32>> byTitle;
+  for (size_t i = 0; i < count; i++) {
+    const MediaItem &item = items[i];
+    if (!item.HasFile() || item.missing || alias[i])
+      continue;
+    if (item.size > 0)
+      bySize[std::make_pair(item.size, item.duration)].push_back((uint32)i);
+
+    BString artist = TrackMatchingUtils::NormalizeKey(
+        LibrarySearchIndex::Fold(item.artist.String()).c_str());
+    BString title = TrackMatchingUtils::NormalizeKey(
+        LibrarySearchIndex::Fold(item.title.String()).c_str());
+    if (!artist.IsEmpty() && !title.IsEmpty())
+      byTitle[artist << "\n" << title].push_back((uint32)i);
+  }
+
+  // Stage 3a: payload hashes for the size/duration candidates.
+  int32 hashTotal = 0;
+  for (const auto &bucket : bySize) {
+    if (bucket.second.size() >= 2)
+      hashTotal += (int32)bucket.second.size();
+  }
+
+  std::vector<uint32> audioClass(count);
+  for (size_t i = 0; i < count; i++)
+    audioClass[i] = (uint32)i;
+
+  int32 hashed = 0;
+  bigtime_t lastProgress = 0;
+  for (const auto &bucket : bySize) {
+    if (bucket.second.size() < 2)
+      continue;
+
+    std::map<uint64, std::vector<uint32>> byHash;
+    for (uint32 i : bucket.second) {
+      if (fCancel) {
+        _SaveHashCache(items);
+        return;
+      }
+      uint64 hash = _PayloadHash(items[i]);
+      if (hash != 0)
+        byHash[hash].push_back(i);
+
+      hashed++;
+      bigtime_t now = system_time();
+      if (now - lastProgress >= kProgressInterval) {
+        lastProgress = now;
+        _ReportProgress(kStageHashing, hashed, hashTotal);
+      }
+    }
+    for (const auto &same : byHash) {
+      if (same.second.size() < 2)
+        continue;
+      addGroup(kIdenticalAudio, same.second);
+      for (uint32 i : same.second)
+        audioClass[i] = same.second.front();
+    }
+  }
+  _SaveHashCache(items);
+  _ReportProgress(kStageGrouping, 0, (int32)byTitle.size());
+
+  // Stage 3b: title candidates, split by length and by AcoustID.
+  for (auto &bucket : byTitle) {
+    if (fCancel)
+      return;
+    std::vector<uint32> &members = bucket.second;
+    if (members.size() < 2)
+      continue;
+
+    std::sort(members.begin(), members.end(), [&](uint32 a, uint32 b) {
+      return items[a].duration < items[b].duration;
+    });
+
+    size_t first = 0;
+    while (first < members.size()) {
+      size_t last = first + 1;
+      while (last < members.size() &&
+             items[members[last]].duration -
+                     items[members[last - 1]].duration <=
+                 kDurationTolerance)
+        last++;
+
+      std::vector<uint32> cluster(members.begin() + first,
+                                  members.begin() + last);
+      first = last;
+      if (cluster.size() < 2)
+        continue;
+
+      // With conflicting AcoustIDs only items that carry one are certain.
+      std::map<BString, std::vector<uint32>> byAcoustId;
+      for (uint32 i : cluster) {
+        if (!items[i].acoustId.IsEmpty())
+          byAcoustId[items[i].acoustId].push_back(i);
+      }
+      std::vector<std::vector<uint32>> recordings;
+      if (byAcoustId.size() >= 2) {
+        for (auto &recording : byAcoustId)
+          recordings.push_back(recording.second);
+      } else {
+        recordings.push_back(cluster);
+      }
+
+      for (const auto &recording : recordings) {
+        // Skip groups already reported as identical audio.
+        std::set<uint32> classes;
+        for (uint32 i : recording)
+          classes.insert(audioClass[i]);
+        if (classes.size() >= 2)
+          addGroup(kSameRecording, recording);
+      }
+    }
+  }
+
+  if (fCancel)
+    return;
+
+  result.AddInt32("scanned", (int32)count);
+  result.AddInt32("hashed", hashed);
+  result.AddInt64("elapsed", system_time() - t0);
+  fTarget.SendMessage(&result);
+  DEBUG_PRINT("DuplicateFinder: %zu items, %d hashed in %lld ms\n", count,
+              (int)hashed, (long long)((system_time() - t0) / 1000));
+}
+
+uint64 DuplicateFinder::_PayloadHash(const MediaItem &item) {
+  HashKey key = {item.inode, item.mtime, item.size};
+  auto it = fHashes.find(key);
+  if (it != fHashes.end())
+    return it->second;
+
+  uint64 hash = _HashFile(item.path.String(), item.size, fCancel);
+  if (hash != 0 && item.inode != 0) {
+    fHashes[key] = hash;
+    fHashesDirty = true;
+  }
+  return hash;
+}
+
+uint64 DuplicateFinder::_HashFile(const char *path, int64 size,
+                                  const std::atomic<bool> &cancel) {
+  BFile file(path, B_READ_ONLY);
+  if (file.InitCheck() != B_OK)
+    return 0;
+
+  off_t start, end;
+  if (!PayloadRange(file, size, start, end))
+    return 0;
+
+  uint64 hash = kFnvOffset;
+  std::vector<uint8> buffer(kHashChunkSize);
+  for (off_t pos = start; pos < end;) {
+    if (cancel)
+      return 0;
+    size_t wanted = (size_t)std::min<off_t>(kHashChunkSize, end - pos);
+    ssize_t bytes = file.ReadAt(pos, buffer.data(), wanted);
+    if (bytes <= 0)
+      return 0;
+    for (ssize_t i = 0; i < bytes; i++) {
+      hash ^= buffer[i];
+      hash *= kFnvPrime;
+    }
+    pos += bytes;
+  }
+  // 0 means "no hash".
+  return hash != 0 ? hash : 1;
+}
+
+void DuplicateFinder::_LoadHashCache() {
+  fHashesLoaded = true;
+  fHashes.clear();
+
+  BFile file(HashCachePath().String(), B_READ_ONLY);
+  BMessage archive;
+  if (file.InitCheck() != B_OK || archive.Unflatten(&file) != B_OK)
+    return;
+
+  int64 inode, mtime, size, hash;
+  for (int32 i = 0; archive.FindInt64("inode", i, &inode) == B_OK; i++) {
+    if (archive.FindInt64("mtime", i, &mtime) != B_OK ||
+        archive.FindInt64("size", i, &size) != B_OK ||
+        archive.FindInt64("hash", i, &hash) != B_OK)
+      break;
+    fHashes[HashKey{inode, mtime, size}] = (uint64)hash;
+  }
+}
+
+/**
+ * @brief Writes the hash cache, dropping file versions no longer in `items`.
+ */
+void DuplicateFinder::_SaveHashCache(const std::vector<MediaItem> &items) {
+  std::set<HashKey> current;
+  for (const MediaItem &item : items)
+    current.insert(HashKey{item.inode, item.mtime, item.size});
+
+  for (auto it = fHashes.begin(); it != fHashes.end();) {
+    if (current.count(it->first) == 0) {
+      it = fHashes.erase(it);
+      fHashesDirty = true;
+    } else {
+      ++it;
+    }
+  }
+  if (!fHashesDirty)
+    return;
+
+  BMessage archive;
+  for (const auto &entry : fHashes) {
+    archive.AddInt64("inode", entry.first.inode);
+    archive.AddInt64("mtime", entry.first.mtime);
+    archive.AddInt64("size", entry.first.size);
+    archive.AddInt64("hash", (int64)entry.second);
+  }
+
+  BFile file(HashCachePath().String(),
+             B_WRITE_ONLY | B_CREATE_FILE | B_ERASE_FILE);
+  if (file.InitCheck() == B_OK && archive.Flatten(&file) == B_OK)
+    fHashesDirty = false;
+}
@@ -0,0 +1,105 @@
+#ifndef BETON_DUPLICATE_FINDER_H
+#define BETON_DUPLICATE_FINDER_H
+
+#include "LibrarySnapshot.h"
+#include "MediaItem.h"
+
+#include <Messenger.h>
+#include <OS.h>
+#include <String.h>
+#include <SupportDefs.h>
+#include <atomic>
+#include <map>
+#include <vector>
+
+/**
+ * @class DuplicateFinder
+ * @brief Groups library items that are the same track, off the window thread.
+ *
+ * A run works through a snapshot in stages, each only looking at what the
+ * cheaper stage before it left over:
+ *
+ * 1. **Same file**: items with equal inode (and, for those only, equal
+ *    device) are hard links or repeated paths to one file.
+ * 2. **Candidates**: items with equal size and duration, and items with the
+ *    same normalized artist and title whose durations are at most two seconds
+ *    apart.
+ * 3. **Confirmation**: size/duration candidates are compared by a hash of the
+ *    audio payload (tags skipped), title candidates by `acoustId` where the
+ *    items have one.
+ *
+ * Payload hashes are cached by (inode, mtime, size) in the settings
+ * directory, so a re-run only reads files that are new or changed.
+ *
+ * Progress is sent to the target as `MSG_DUPLICATE_PROGRESS` ("stage",
+ * "current", "total"); the result as `MSG_DUPLICATES_FOUND` with one "group"
+ * message per group ("kind" and "path" fields, see Kind).
+ */
+class DuplicateFinder {
+public:
+  /** @brief How the items of a group were matched. */
+  enum Kind {
+    kSameFile = 0,       ///< Same inode on the same device.
+    kIdenticalAudio = 1, ///< Equal audio payload; only tags may differ.
+    kSameRecording = 2   ///< Same artist, title and length (or AcoustID).
+  };
+
+  /** @brief Stages reported in `MSG_DUPLICATE_PROGRESS`. */
+  enum Stage { kStageKeys = 0, kStageHashing = 1, kStageGrouping = 2 };
+
+  explicit DuplicateFinder(const BMessenger &target);
+  ~DuplicateFinder();
+
+  /**
+   * @brief Starts a run over `snapshot`; cancels a run still in progress.
+   * @return B_OK, or the error from spawning the thread.
+   */
+  status_t Start(LibrarySnapshot *snapshot);
+
+  /** @brief Stops the current run and waits for its thread. */
+  void Cancel();
+
+  bool IsRunning() const { return fThread >= 0 && fRunning.load(); }
+
+private:
+  /** @brief Cached payload hash of one file version. */
+  struct HashKey {
+    int64 inode;
+    int64 mtime;
+    int64 size;
+    bool operator<(const HashKey &o) const {
+      if (inode != o.inode)
+        return inode < o.inode;
+      if (mtime != o.mtime)
+        return mtime < o.mtime;
+      return size < o.size;
+    }
+  };
+
+  static int32 _ThreadEntry(void *data);
+  void _Run();
+
+  /** @brief Returns the cached or freshly computed hash; 0 on failure. */
+  uint64 _PayloadHash(const MediaItem &item);
+  static uint64 _HashFile(const char *path, int64 size,
+                          const std::atomic<bool> &cancel);
+
+  void _LoadHashCache();
+  void _SaveHashCache(const std::vector<MediaItem> &items);
+  void _ReportProgress(int32 stage, int32 current, int32 total);
+
+  BMessenger fTarget;
+  BReference<LibrarySnapshot> fSnapshot;
+  thread_id fThread;
+  std::atomic<bool> fCancel;
+  std::atomic<bool> fRunning;
+
+  /** @name Hash cache (finder thread only) */
+  ///@{
+  std::map<HashKey, uint64> fHashes;
+  bool fHashesLoaded;
+  bool fHashesDirty;
+  ///@}
+};
+
+#endif // BETON_DUPLICATE_FINDER_H
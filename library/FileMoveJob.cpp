@@ -0,0 +1,169 @@
+#include "FileMoveJob.h"
+#include "Debug.h"
+#include "Messages.h"
+
+#include <Directory.h>
+#include <Entry.h>
+#include <File.h>
+#include <Path.h>
+#include <fs_attr.h>
+#include <string.h>
+
+/** @brief Chunk size of cross-volume copies. */
+static const size_t kCopyChunkSize = 1024 * 1024;
+
+void FileMoveJob::Run(const BMessage &request, BMessage &result) {
+  result = request;
+  result.what = MSG_FILES_MOVED;
+  result.RemoveName("from");
+  result.RemoveName("to");
+
+  const BString directory = request.GetString("directory", "");
+  std::vector<char> buffer;
+  int32 failed = 0;
+  status_t firstError = B_OK;
+
+  BString from;
+  for (int32 i = 0; request.FindString("from", i, &from) == B_OK; i++) {
+    BString to;
+    if (request.FindString("to", i, &to) != B_OK) {
+      if (directory.IsEmpty())
+        break;
+      to = _UniqueTarget(directory, from);
+    }
+    if (from.IsEmpty() || to.IsEmpty() || from == to)
+      continue;
+
+    status_t status = _Move(from, to, buffer);
+    if (status != B_OK) {
+      DEBUG_PRINT("[FileMoveJob] %s -> %s failed: %s\n", from.String(),
+                  to.String(), strerror(status));
+      if (failed++ == 0)
+        firstError = status;
+      continue;
+    }
+    result.AddString("from", from);
+    result.AddString("to", to);
+  }
+
+  result.AddInt32("failed", failed);
+  if (failed > 0)
+    result.AddString("error", strerror(firstError));
+}
+
+/**
+ * @brief `directory`/leaf of `from`, numbered if that name is taken.
+ */
+BString FileMoveJob::_UniqueTarget(const BString &directory,
+                                   const BString &from) {
+  BPath fromPath(from.String());
+  if (fromPath.InitCheck() != B_OK || fromPath.Leaf() == nullptr)
+    return BString();
+
+  BPath target(directory.String(), fromPath.Leaf());
+  BEntry test(target.Path());
+  if (!test.Exists())
+    return BString(target.Path());
+
+  BString name(fromPath.Leaf());
+  BString base, ext;
+  int32 extIdx = name.FindLast('.');
+  if (extIdx > 0) {
+    name.CopyInto(base, 0, extIdx);
+    name.CopyInto(ext, extIdx, name.Length() - extIdx);
+  } else {
+    base = name;
+  }
+  int32 counter = 1;
+  do {
+    BString leaf;
+    leaf << base << " " << counter++ << ext;
+    target.SetTo(directory.String(), leaf.String());
+    test.SetTo(target.Path());
+  } while (test.Exists());
+  return BString(target.Path());
+}
+
+status_t FileMoveJob::_Move(const BString &from, const BString &to,
+                            std::vector<char> &buffer) {
+  BEntry entry(from.String());
+  if (entry.InitCheck() != B_OK || !entry.Exists())
+    return B_ENTRY_NOT_FOUND;
+
+  BPath toPath(to.String());
+  BPath toDir;
+  if (toPath.InitCheck() != B_OK || toPath.GetParent(&toDir) != B_OK)
+    return B_BAD_VALUE;
+  BDirectory dir(toDir.Path());
+  if (dir.InitCheck() != B_OK)
+    return dir.InitCheck();
+
+  status_t status = entry.MoveTo(&dir, toPath.Leaf(), false);
+  if (status != B_CROSS_DEVICE_LINK)
+    return status;
+
+  status = _Copy(from, to, buffer);
+  if (status != B_OK)
+    return status;
+  return entry.Remove();
+}
+
+status_t FileMoveJob::_Copy(const BString &from, const BString &to,
+                            std::vector<char> &buffer) {
+  BFile source(from.String(), B_READ_ONLY);
+  if (source.InitCheck() != B_OK)
+    return source.InitCheck();
+  BFile target(to.String(), B_WRITE_ONLY | B_CREATE_FILE | B_FAIL_IF_EXISTS);
+  if (target.InitCheck() != B_OK)
+    return target.InitCheck();
+
+  status_t status = _CopyContents(source, target, buffer);
+  if (status != B_OK) {
+    target.Unset();
+    BEntry(to.String()).Remove();
+  }
+  return status;
+}
+
+status_t FileMoveJob::_CopyContents(BFile &source, BFile &target,
+                                    std::vector<char> &buffer) {
+  // Reading sequentially in large chunks lets the file cache read ahead
+  // while the previous chunk is being written.
+  if (buffer.size() < kCopyChunkSize)
+    buffer.resize(kCopyChunkSize);
+  for (;;) {
+    ssize_t bytesRead = source.Read(buffer.data(), buffer.size());
+    if (bytesRead < 0)
+      return (status_t)bytesRead;
+    if (bytesRead == 0)
+      break;
+    ssize_t written = target.Write(buffer.data(), bytesRead);
+    if (written != bytesRead)
+      return written < 0 ? (status_t)written : B_DEVICE_FULL;
+  }
+
+  // Tags, ratings and the like live in attributes.
+  char name[B_ATTR_NAME_LENGTH];
+  source.RewindAttrs();
+  while (source.GetNextAttrName(name) == B_OK) {
+    attr_info info;
+    if (source.GetAttrInfo(name, &info) != B_OK)
+      continue;
+    std::vector<char> value((size_t)info.size);
+    ssize_t size = source.ReadAttr(name, info.type, 0, value.data(),
+                                   value.size());
+    if (size < 0)
+      continue;
+    if (target.WriteAttr(name, info.type, 0, value.data(), size) != size)
+      return B_ERROR;
+  }
+
+  mode_t permissions;
+  if (source.GetPermissions(&permissions) == B_OK)
+    target.SetPermissions(permissions);
+  time_t modified;
+  if (source.GetModificationTime(&modified) == B_OK)
+    target.SetModificationTime(modified);
+
+  return target.Sync();
+}
@@ -0,0 +1,43 @@
+#ifndef BETON_FILE_MOVE_JOB_H
+#define BETON_FILE_MOVE_JOB_H
+
+#include <Message.h>
+#include <String.h>
+#include <SupportDefs.h>
+
+#include <vector>
+
+class BFile;
+
+/**
+ * @class FileMoveJob
+ * @brief Moves a batch of files on disk, meant to run off the window thread.
+ *
+ * A request (MSG_FILES_MOVE) holds the "from" paths and either a "to" path
+ * for each or a target "directory", where every file keeps its name, with
+ * " 1", " 2"... inserted before the extension if it is taken.
+ *
+ * Files on the same volume are renamed. Across volumes a file is copied in
+ * large chunks, together with its attributes, permissions and modification
+ * time, and the source is removed once the copy is on disk; a failed copy
+ * leaves the source alone and removes the partial target.
+ *
+ * The result (MSG_FILES_MOVED) is the request with "from"/"to" replaced by
+ * the pairs that actually moved, plus "failed" (count) and "error" (the
+ * first failure), so the window applies the whole batch at once.
+ */
+class FileMoveJob {
+public:
+  static void Run(const BMessage &request, BMessage &result);
+
+private:
+  static BString _UniqueTarget(const BString &directory, const BString &from);
+  static status_t _Move(const BString &from, const BString &to,
+                        std::vector<char> &buffer);
+  static status_t _Copy(const BString &from, const BString &to,
+                        std::vector<char> &buffer);
+  static status_t _CopyContents(BFile &source, BFile &target,
+                                std::vector<char> &buffer);
+};
+
+#endif // BETON_FILE_MOVE_JOB_H
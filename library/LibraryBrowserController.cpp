@@ -1,14 +1,16 @@
 #include "LibraryBrowserController.h"
 #include "MediaTableView.h"
 #include "Debug.h"
+#include "LibraryFacetIndex.h"
+#include "LibraryFilterWorker.h"
+#include "MediaEntryStore.h"
 #include "MediaItem.h"
 #include "Messages.h"
 #include "SingleColumnListView.h"
+#include "StringPool.h"
 #include <ColumnListView.h>
 #include <ColumnTypes.h>
-#include <Entry.h>
 #include <OS.h>
-#include <Path.h>
 #include <ScrollView.h>
 #include <String.h>
 #include <Window.h>
@@ -31,65 +33,6 @@ static BString kLabelNoGenre = B_TRANSLATE("No Genre");
 static BString kLabelNoArtist = B_TRANSLATE("No Artist");
 static BString kLabelNoAlbum = B_TRANSLATE("No Album");
 
-/**
- * @brief Normalizes album/artist key parts for stable deduplication.
- *
- * Trims, lowercases, and collapses whitespace to single spaces.
- */
-static BString
-NormalizeAlbumKeyPart(const BString &value)
-{
-  std::string normalized;
-  normalized.reserve(value.Length());
-
-  bool previousWasSpace = true;
-  const char *raw = value.String();
-  for (int32 i = 0; i < value.Length(); ++i) {
-    unsigned char c = (unsigned char)raw[i];
-    if (std::isspace(c)) {
-      if (!previousWasSpace) {
-        normalized.push_back(' ');
-        previousWasSpace = true;
-      }
-      continue;
-    }
-    normalized.push_back((char)std::tolower(c));
-    previousWasSpace = false;
-  }
-
-  if (!normalized.empty() && normalized.back() == ' ')
-    normalized.pop_back();
-
-  return BString(normalized.c_str());
-}
-
-/**
- * @brief Builds a stable album identity key for filtering/disambiguation.
- * @param item Source media item.
- * @param radioMode True when radio-specific album identity should be used.
- */
-static BString
-AlbumIdentityForItem(const MediaItem &item, bool radioMode)
-{
-  if (radioMode)
-    return item.album;
-
-  if (!item.mbAlbumId.IsEmpty()) {
-    BString key("mb:");
-    key << item.mbAlbumId;
-    return key;
-  }
-
-  BString albumArtist = item.albumArtist;
-  if (albumArtist.IsEmpty())
-    albumArtist = item.artist;
-
-  BString key("meta:");
-  key << NormalizeAlbumKeyPart(albumArtist) << "|"
-      << NormalizeAlbumKeyPart(item.album) << "|" << item.year;
-  return key;
-}
-
 /**
  * @brief Constructs the LibraryBrowserController.
  *
@@ -119,11 +62,19 @@ LibraryBrowserController::LibraryBrowserController(BMessenger target) : fTarget(
   fAlbumView->SetTarget(fTarget);
 
   fContentView = new MediaTableView("content");
+
+  fWorker = new LibraryFilterWorker(fTarget);
+  fWorker->Run();
 }
 
 LibraryBrowserController::~LibraryBrowserController() {
   /// Views are usually owned by the window's view hierarchy,
   /// so we don't strictly need to delete them if they are attached.
+
+  /// Abort a running pass; Quit() waits for the worker thread.
+  fWorker->Cancel();
+  if (fWorker->Lock())
+    fWorker->Quit();
 }
 
 /**
@@ -172,14 +123,18 @@ void LibraryBrowserController::SetActiveItems(const std::vector<MediaItem> &item
     fActivePaths.push_back(it.path);
 }
 
-void LibraryBrowserController::RenameActivePath(const BString &from,
-                                                const BString &to) {
-  for (auto &p : fActivePaths)
-    if (p == from)
-      p = to;
-  for (auto &it : fActiveItems)
-    if (it.path == from)
-      it.path = to;
+void LibraryBrowserController::RenameActivePaths(
+    const std::map<BString, BString> &moves) {
+  for (auto &p : fActivePaths) {
+    auto move = moves.find(p);
+    if (move != moves.end())
+      p = move->second;
+  }
+  for (auto &it : fActiveItems) {
+    auto move = moves.find(it.path);
+    if (move != moves.end())
+      it.path = move->second;
+  }
 }
 
 void LibraryBrowserController::UpdateActiveItem(const MediaItem &item) {
@@ -225,6 +180,7 @@ void LibraryBrowserController::ResetFilters() {
   fAlbumView->Clear();
   fContentView->ClearEntries();
   fActivePaths.clear();
+  fShownSource.stamp = 0;
 }
 
 /**
@@ -276,15 +232,18 @@ void LibraryBrowserController::SetRadioFilterMode(bool radio) {
  * haven't changed.
  *
  * Filtering Process:
- * 1. Filter Source Items based on Library/Playlist Mode.
- * 2. Build Filter Sets (Genre, Artist, Album -> Years).
- * 3. Populate Filter Lists (Genre, Artist, Album).
- * 4. Build Final Content List.
- * 5. Notify Target (Main Window) about totals.
- * 6. Update Content View.
- * 7. Prepare Display Items (handling "Show all", "No" and
- * Disambiguation).
- * 8. Smart Update of List Views.
+ * 1. Save/restore per-context filter state (window thread).
+ * 2. Capture selection and sort state into a `LibraryFilterJob`.
+ * 3. Filter, build filter sets and sort (`LibraryFilterWorker::Compute()`).
+ * 4. Apply the result in _ApplyFilterJob().
+ *
+ * Library jobs with a shared snapshot run on the filter worker and are
+ * applied when MSG_FILTER_RESULT arrives; a newer update makes pending ones
+ * stale. All other sources are small and computed inline.
+ *
+ * The view left on a context change goes into the view cache. Returning to
+ * a context whose items and selections are unchanged shows the cached view
+ * without a pass.
  *
  * @param allItems The full database of media items.
  * @param isLibraryMode True if showing full library, False if showing a
@@ -293,16 +252,17 @@ void LibraryBrowserController::SetRadioFilterMode(bool radio) {
  * @param filterText Search filter text.
  * @param preserveScroll True to preserve content scroll position.
  * @param updateContentList True to rebuild content list, false to update filters only.
+ * @param library Snapshot and indexes behind `allItems`, or `nullptr`.
  */
 void LibraryBrowserController::UpdateFilteredViews(
     const std::vector<MediaItem> &allItems, bool isLibraryMode,
     const BString &currentContext, const BString &filterText,
-    bool preserveScroll, bool updateContentList, bool showPlaylistSort) {
-
-  bigtime_t tStart = system_time();
+    bool preserveScroll, bool updateContentList, bool showPlaylistSort,
+    const LibraryFilterSource *library) {
 
   /// 1. Save state for previous context if changed
   if (!fCurrentContext.IsEmpty() && fCurrentContext != currentContext) {
+    _CaptureView();
     FilterState &state = fSavedStates[fCurrentContext];
     state.genre = SelectedText(fGenreView);
     state.artist = SelectedText(fArtistView);
@@ -316,7 +276,7 @@ void LibraryBrowserController::UpdateFilteredViews(
   BString selArtist = SelectedText(fArtistView);
   BString selAlbum = SelectedText(fAlbumView);
 
-  /// 2. Restore state for new context if changing contexts or on first update
+  /// Restore state for new context if changing contexts or on first update
   bool contextChanged = (fCurrentContext != currentContext);
   bool restoreFilters = (fFirstUpdate || contextChanged);
 
@@ -357,203 +317,191 @@ void LibraryBrowserController::UpdateFilteredViews(
   fLastSelectedGenre = selGenre;
   fLastSelectedArtist = selArtist;
 
-  /// 1. Filter Source Items based on Library/Playlist Mode
-  std::vector<MediaItem> playlistItems;
-
-  if (!isLibraryMode) {
-    if (!fActiveItems.empty()) {
-      playlistItems = fActiveItems;
-    } else {
-      /// Fallback: Build items from paths (e.g. from a loaded .m3u)
-      playlistItems.reserve(fActivePaths.size());
-
-      /// Optimization: Build a map for O(1) lookup in allItems
-      std::unordered_map<std::string, size_t> pathMap;
-      pathMap.reserve(allItems.size());
-      for (size_t i = 0; i < allItems.size(); ++i) {
-        pathMap[allItems[i].path.String()] = i;
-      }
-
-      for (const auto &p : fActivePaths) {
-        auto it = pathMap.find(p.String());
-        if (it != pathMap.end()) {
-          playlistItems.push_back(allItems[it->second]);
-        } else {
-          MediaItem mi;
-          mi.path = p;
-
-          BPath bp(p.String());
-          mi.title = bp.Leaf() ? bp.Leaf() : p.String();
-
-          BEntry e(bp.Path());
-          mi.missing = !e.Exists();
-          playlistItems.push_back(mi);
-        }
-      }
+  const bool libraryItems =
+      library != nullptr && library->snapshot != nullptr &&
+      library->snapshot->Items().data() == allItems.data();
+  const uint64 stamp = _SourceStamp(
+      allItems, isLibraryMode, libraryItems ? library->snapshot : nullptr);
+
+  /// Back in a context: show its cached view if nothing it was built from
+  /// has changed.
+  if (contextChanged && updateContentList) {
+    ViewSource source;
+    source.stamp = stamp;
+    source.library = libraryItems;
+    source.filterText = filterText;
+    source.genre = selGenre;
+    source.artist = selArtist;
+    source.album = selAlbum;
+    source.radioFilterMode = fIsRadioFilterMode;
+    source.playlistSort = showPlaylistSort;
+    const CachedView *view = fViewCache.Find(currentContext, stamp);
+    if (view != nullptr && view->source == source) {
+      _ShowCachedView(*view);
+      return;
     }
   }
 
-  const std::vector<MediaItem> &sourceItems =
-      isLibraryMode ? allItems : playlistItems;
-
-  if (updateContentList) {
-    if (preserveScroll) {
-      fContentView->SaveScrollState();
-    }
-    fContentView->ClearEntries();
+  /// 2. Capture the pass. Interned selections let the per-item checks
+  /// compare buffers first.
+  StringPool &pool = StringPool::Default();
+
+  auto *job = new LibraryFilterJob;
+  job->isLibraryMode = isLibraryMode;
+  job->context = currentContext;
+  job->filterText = filterText;
+  job->genre = pool.Intern(selGenre);
+  job->artist = pool.Intern(selArtist);
+  job->album = pool.Intern(selAlbum);
+  job->albumData = SelectedData(fAlbumView);
+  job->anyGenre = selGenre.IsEmpty() || selGenre == kLabelAllGenre;
+  job->noGenre = selGenre == kLabelNoGenre;
+  job->anyArtist = selArtist.IsEmpty() || selArtist == kLabelAllArtist;
+  job->noArtist = selArtist == kLabelNoArtist;
+  job->anyAlbum = selAlbum.IsEmpty() || selAlbum == kLabelAllAlbum;
+  job->noAlbum = selAlbum == kLabelNoAlbum;
+  job->radioFilterMode = fIsRadioFilterMode;
+  job->restoreFilters = restoreFilters;
+  job->updateContentList = updateContentList;
+  job->preserveScroll = preserveScroll;
+  job->playlistSort = showPlaylistSort;
+  job->sourceStamp = stamp;
+  job->libraryItems = libraryItems;
+  if (updateContentList)
+    fContentView->EffectiveSortState(&job->sortState, showPlaylistSort);
+
+  if (library != nullptr) {
+    job->facets = library->facets;
+    job->search = library->search;
+    job->indexLock = library->indexLock;
   }
 
-  /// 2. Build Filter Sets
-  std::set<BString> allGenres;
-  bool hasUntaggedGenreSrc = false;
-
-  std::set<BString> artistsForGenre;
-  bool hasUntaggedArtistForGenre = false;
-
-  struct AlbumKey {
-    int32 year;
-    BString identity;
-    bool operator<(const AlbumKey &o) const {
-      if (identity == o.identity)
-        return false;
-      if (year != o.year)
-        return year < o.year;
-      return identity.Compare(o.identity) < 0;
-    }
-  };
-
-  /// Map AlbumName -> Set of AlbumKeys (for disambiguation)
-  std::map<BString, std::set<AlbumKey>> albumsForGA;
-  bool hasUntaggedAlbumForGA = false;
-
-  /// -- Filter Lambdas --
-
-  auto genreOK = [&](const MediaItem &i) {
-    if (selGenre.IsEmpty() || selGenre == kLabelAllGenre)
-      return true;
-    if (selGenre == kLabelNoGenre)
-      return i.genre.IsEmpty();
-    return i.genre == selGenre;
-  };
-
-  auto artistOK = [&](const MediaItem &i) {
-    if (selArtist.IsEmpty() || selArtist == kLabelAllArtist)
-      return true;
-    if (selArtist == kLabelNoArtist)
-      return i.artist.IsEmpty();
-    return i.artist == selArtist;
-  };
-
-  BString selAlbumData = SelectedData(fAlbumView);
-
-  auto albumOK = [&](const MediaItem &i) {
-    if (selAlbum.IsEmpty() || selAlbum == kLabelAllAlbum)
-      return true;
-    if (selAlbum == kLabelNoAlbum)
-      return i.album.IsEmpty();
-
-    /// Check against hidden data if available
-    if (!selAlbumData.IsEmpty()) {
-      if (AlbumIdentityForItem(i, fIsRadioFilterMode) == selAlbumData)
-        return true;
+  const bool async = libraryItems && isLibraryMode;
 
-      BString legacyData = i.album;
-      legacyData << "|" << i.year << "|" << i.base;
-      return legacyData == selAlbumData;
-    }
-
-    /// Standard album name match
-    if (i.album != selAlbum)
-      return false;
-
-    return true;
-  };
-
-  auto textOK = [&](const MediaItem &i) {
-    if (filterText.IsEmpty())
-      return true;
-    if (i.title.IFindFirst(filterText) >= 0)
-      return true;
-    if (i.artist.IFindFirst(filterText) >= 0)
-      return true;
-    if (i.album.IFindFirst(filterText) >= 0)
-      return true;
-    return false;
-  };
-
-  /// 3. Populate Filter Lists (Genre, Artist, Album)
-  for (const auto &it : sourceItems) {
-    if (!textOK(it))
-      continue;
-
-    if (it.genre.IsEmpty())
-      hasUntaggedGenreSrc = true;
-    else
-      allGenres.insert(it.genre);
-
-    if (genreOK(it)) {
-      if (it.artist.IsEmpty())
-        hasUntaggedArtistForGenre = true;
-      else
-        artistsForGenre.insert(it.artist);
-
-      if (artistOK(it)) {
-        if (it.album.IsEmpty())
-          hasUntaggedAlbumForGA = true;
-        else {
-          albumsForGA[it.album].insert(
-              {it.year, AlbumIdentityForItem(it, fIsRadioFilterMode)});
-        }
-      }
-    }
+  /// 3. Compute on the worker, or inline for small sources
+  if (async) {
+    job->snapshot.SetTo(library->snapshot);
+    job->shownGeneration = fShownGeneration;
+    job->shownRows = fContentView->CountRows();
+    int32 generation = fWorker->Submit(job);
+    if (updateContentList)
+      fContentGeneration = generation;
+    return;
   }
 
-  /// 4. Build Final Content List
-  std::vector<MediaItem> finalItems;
-  finalItems.reserve(sourceItems.size());
+  /// Inline passes supersede anything still queued.
+  job->generation = fWorker->Cancel();
+  if (updateContentList)
+    fContentGeneration = job->generation;
+  job->items = &allItems;
+  job->activeItems = &fActiveItems;
+  job->activePaths = &fActivePaths;
+  if (library != nullptr)
+    job->pathIndex = library->paths;
+  LibraryFilterWorker::Compute(*job, nullptr);
+  _ApplyFilterJob(*job);
+  delete job;
+}
 
-  for (const auto &it : sourceItems) {
-    if (!(genreOK(it) && artistOK(it) && albumOK(it)))
-      continue;
-    if (!textOK(it))
-      continue;
-    finalItems.push_back(it);
-  }
+/**
+ * @brief Applies a job finished by the filter worker, unless a newer update
+ * was requested in the meantime.
+ */
+void LibraryBrowserController::HandleFilterResult(BMessage *msg) {
+  LibraryFilterJob *job = nullptr;
+  if (msg->FindPointer("job", (void **)&job) != B_OK || job == nullptr)
+    return;
 
-  /// 5. Notify Target (Main Window) about totals
-  int32 totalCount = finalItems.size();
-  int64 totalDuration = 0;
-  for (const auto &it : finalItems) {
-    totalDuration += it.duration;
-  }
+  if (job->generation == fWorker->Generation() &&
+      job->context == fCurrentContext) {
+    bigtime_t start = system_time();
+    _ApplyFilterJob(*job);
+    fLastApplyTime = system_time() - start;
+  } else
+    DEBUG_PRINT("UpdateFilteredViews: dropped stale result %ld\n",
+                (long)job->generation);
+  delete job;
+}
 
+/**
+ * @brief Shows a computed filter pass.
+ *
+ * 5. Notify Target (Main Window) about totals.
+ * 6. Update Content View.
+ * 7. Prepare Display Items (handling "Show all", "No" and
+ * Disambiguation).
+ * 8. Smart Update of List Views.
+ */
+void LibraryBrowserController::_ApplyFilterJob(LibraryFilterJob &job) {
+  /// 5. Notify Target (Main Window) about totals
   if (fTarget.IsValid()) {
     BMessage previewMsg(MSG_LIBRARY_PREVIEW);
-    previewMsg.AddInt32("count", totalCount);
-    previewMsg.AddInt64("duration", totalDuration);
+    previewMsg.AddInt32("count", job.totalCount);
+    previewMsg.AddInt64("duration", job.totalDuration);
+    previewMsg.AddInt64("size", job.totalSize);
     fTarget.SendMessage(&previewMsg);
   }
 
-  bigtime_t tFilter = system_time();
+  bigtime_t tContentStart = system_time();
 
-  /// 6. Update Content View
-  size_t finalCount = finalItems.size();
-  if (updateContentList) {
-    fContentView->SetPlaylistMode(showPlaylistSort);
-    if (restoreFilters && fSavedStates.count(currentContext) > 0) {
-      FilterState &state = fSavedStates[currentContext];
+  /// 6. Update Content View. Within the same mode and sort order only the
+  /// rows that differ are changed; selection and scroll position stay.
+  if (job.updateContentList && !job.contentUnchanged) {
+    BMessage *restoredSort = nullptr;
+    if (job.restoreFilters && fSavedStates.count(job.context) > 0) {
+      FilterState &state = fSavedStates[job.context];
       if (!state.sortState.IsEmpty())
-        fContentView->RestoreSortState(&state.sortState);
+        restoredSort = &state.sortState;
     }
-    fContentView->AddEntries(std::move(finalItems));
+
+    if (fContentView->IsPlaylistMode() == job.playlistSort &&
+        restoredSort == nullptr) {
+      BMessage sortState;
+      fContentView->EffectiveSortState(&sortState, job.playlistSort);
+      fContentView->ApplyEntries(std::move(job.finalItems),
+                                 sortState.HasSameData(job.sortState),
+                                 job.preserveScroll);
+    } else {
+      if (job.preserveScroll)
+        fContentView->SaveScrollState();
+      fContentView->ClearEntries();
+
+      fContentView->SetPlaylistMode(job.playlistSort);
+      if (restoredSort != nullptr)
+        fContentView->RestoreSortState(restoredSort);
+
+      /// The items were sorted with the state captured at submit time; sort
+      /// again only if the user changed it since.
+      BMessage sortState;
+      fContentView->EffectiveSortState(&sortState, job.playlistSort);
+      bool presorted = sortState.HasSameData(job.sortState);
+      fContentView->AddEntries(std::move(job.finalItems), presorted);
+    }
+  }
+  if (job.updateContentList) {
+    fShownGeneration = job.generation;
+    fShownTotals.count = job.totalCount;
+    fShownTotals.duration = job.totalDuration;
+    fShownTotals.size = job.totalSize;
+
+    fShownSource.stamp = job.sourceStamp;
+    fShownSource.library = job.libraryItems;
+    fShownSource.filterText = job.filterText;
+    fShownSource.genre = job.genre;
+    fShownSource.artist = job.artist;
+    fShownSource.album = job.album;
+    fShownSource.radioFilterMode = job.radioFilterMode;
+    fShownSource.playlistSort = job.playlistSort;
   }
 
   bigtime_t tContent = system_time();
 
   DEBUG_PRINT("UpdateFilteredViews: source=%zu, "
-              "filtered=%zu, filterBuild=%lld us, addEntries=%lld us\n",
-              sourceItems.size(), finalCount, (long long)(tFilter - tStart),
-              (long long)(tContent - tFilter));
+              "filtered=%ld, filterBuild=%lld us, addEntries=%lld us%s\n",
+              job.sourceCount, (long)job.totalCount,
+              (long long)job.filterTime,
+              (long long)(tContent - tContentStart),
+              job.contentUnchanged ? " (unchanged)" : "");
 
   /// 7. Prepare Display Items (handling "All", "No...", and
   /// Disambiguation)
@@ -564,28 +512,28 @@ void LibraryBrowserController::UpdateFilteredViews(
 
   std::vector<BString> genreItems;
   genreItems.push_back(kLabelAllGenre);
-  if (hasUntaggedGenreSrc)
+  if (job.untaggedGenre)
     genreItems.push_back(kLabelNoGenre);
-  for (const auto &g : allGenres)
+  for (const auto &g : job.genres)
     genreItems.push_back(g);
 
   std::vector<BString> artistItems;
   artistItems.push_back(kLabelAllArtist);
-  if (hasUntaggedArtistForGenre)
+  if (job.untaggedArtist)
     artistItems.push_back(kLabelNoArtist);
-  for (const auto &a : artistsForGenre)
+  for (const auto &a : job.artists)
     artistItems.push_back(a);
 
   std::vector<DisplayItem> albumDisplayItems;
   albumDisplayItems.push_back({kLabelAllAlbum, ""});
-  if (hasUntaggedAlbumForGA)
+  if (job.untaggedAlbum)
     albumDisplayItems.push_back({kLabelNoAlbum, ""});
 
-  for (auto &[name, keys] : albumsForGA) {
+  for (auto &[name, keys] : job.albums) {
     if (keys.empty())
       continue;
 
-    std::vector<AlbumKey> sortedKeys(keys.begin(), keys.end());
+    std::vector<LibraryFilterJob::AlbumKey> sortedKeys(keys.begin(), keys.end());
 
     if (sortedKeys.size() == 1) {
       /// Single item, no visual disambiguation needed, but store data just in
@@ -640,71 +588,34 @@ void LibraryBrowserController::UpdateFilteredViews(
   /// unchanged)
   bigtime_t tSmartStart = system_time();
 
+  /// Each pane gets a new model; it is only swapped in if it differs, and
+  /// the copied BStrings share the interned library strings.
   auto smartUpdateWithData =
       [&](SingleColumnListView *view, const std::vector<DisplayItem> &newItems,
           const BString &currentSelText, const BString &currentSelData) {
-        bool changed = false;
-        if (view->CountItems() != (int32)newItems.size()) {
-          changed = true;
-        } else {
-          for (int32 i = 0; i < (int32)newItems.size(); i++) {
-            if (view->ItemAt(i) != newItems[i].text ||
-                view->PathAt(i) != newItems[i].data) {
-              changed = true;
-              break;
-            }
-          }
-        }
+        BReference<SingleColumnListModel> model(new SingleColumnListModel,
+                                                true);
+        model->Reserve((int32)newItems.size());
+        for (const auto &item : newItems)
+          model->Add(item.text, item.data);
 
-        if (!changed)
+        if (view->Model() && view->Model()->Equals(*model))
           return;
 
-        std::vector<std::pair<BString, BString>> bulk;
-        bulk.reserve(newItems.size());
-        for (const auto &item : newItems) {
-          bulk.push_back({item.text, item.data});
-        }
-        view->SetItems(bulk);
-
-        /// Restore Selection
-        if (!currentSelText.IsEmpty()) {
-          bool found = false;
-
-          /// Try matching by data first (more precise)
-          if (!currentSelData.IsEmpty()) {
-            for (int32 i = 0; i < view->CountItems(); i++) {
-              if (view->PathAt(i) == currentSelData) {
-                view->Select(i);
-                view->ScrollToSelection();
-                found = true;
-                break;
-              }
-            }
-          }
-
-          /// Fallback to text match
-          if (!found) {
-            for (int32 i = 0; i < view->CountItems(); i++) {
-              if (view->ItemAt(i) == currentSelText) {
-                view->Select(i);
-                view->ScrollToSelection();
-                break;
-              }
-            }
-          }
-        }
+        _SetListModel(view, model.Get(), currentSelText, currentSelData);
       };
 
   auto toDisplay = [](const std::vector<BString> &strs) {
     std::vector<DisplayItem> out;
+    out.reserve(strs.size());
     for (const auto &s : strs)
       out.push_back({s, ""});
     return out;
   };
 
-  smartUpdateWithData(fGenreView, toDisplay(genreItems), selGenre, "");
-  smartUpdateWithData(fArtistView, toDisplay(artistItems), selArtist, "");
-  smartUpdateWithData(fAlbumView, albumDisplayItems, selAlbum, selAlbumData);
+  smartUpdateWithData(fGenreView, toDisplay(genreItems), job.genre, "");
+  smartUpdateWithData(fArtistView, toDisplay(artistItems), job.artist, "");
+  smartUpdateWithData(fAlbumView, albumDisplayItems, job.album, job.albumData);
 
   bigtime_t tSmartEnd = system_time();
   DEBUG_PRINT("smartUpdate: genre=%ld, artist=%ld, "
@@ -714,6 +625,138 @@ void LibraryBrowserController::UpdateFilteredViews(
               (long long)(tSmartEnd - tSmartStart));
 }
 
+void LibraryBrowserController::_SetListModel(SingleColumnListView *view,
+                                             SingleColumnListModel *model,
+                                             const BString &selText,
+                                             const BString &selData) {
+  view->SetModel(model);
+
+  /// Restore Selection
+  if (!selText.IsEmpty()) {
+    /// Try matching by data first (more precise), then by text
+    int32 index = -1;
+    if (!selData.IsEmpty())
+      index = model->IndexOfData(selData);
+    if (index < 0)
+      index = model->IndexOf(selText);
+    if (index >= 0) {
+      view->Select(index);
+      view->ScrollToSelection();
+    }
+  }
+}
+
+static uint64 MixStamp(uint64 stamp, uint64 value) {
+  return (stamp ^ value) * 1099511628211ULL;
+}
+
+static uint64 MixStamp(uint64 stamp, const BString &value) {
+  return MixStamp(stamp, HashMediaPath(value.String(), value.Length()));
+}
+
+/**
+ * Library items are identified by their snapshot version and the library
+ * change count, a playlist in addition by its entries. Radio and DLNA lists
+ * have neither and are hashed whole; they are small.
+ */
+uint64 LibraryBrowserController::_SourceStamp(
+    const std::vector<MediaItem> &allItems, bool isLibraryMode,
+    const LibrarySnapshot *snapshot) const {
+  uint64 stamp = 14695981039346656037ULL;
+  if (snapshot != nullptr) {
+    stamp = MixStamp(stamp, snapshot->Version());
+    stamp = MixStamp(stamp, fSourceEpoch);
+    if (!isLibraryMode) {
+      for (const auto &item : fActiveItems)
+        stamp = MixStamp(MixStamp(stamp, item.path), item.title);
+      for (const auto &path : fActivePaths)
+        stamp = MixStamp(stamp, path);
+    }
+  } else {
+    for (const auto &item : allItems) {
+      stamp = MixStamp(stamp, item.path);
+      stamp = MixStamp(stamp, item.title);
+      stamp = MixStamp(stamp, item.genre);
+      stamp = MixStamp(stamp, item.artist);
+      stamp = MixStamp(stamp, item.album);
+      stamp = MixStamp(stamp, item.albumArtist);
+      stamp = MixStamp(stamp, (uint64)item.missing);
+    }
+  }
+  return stamp != 0 ? stamp : 1;
+}
+
+/**
+ * The view is only kept if its content list is complete and the newest
+ * requested, and the facet panes show models.
+ */
+void LibraryBrowserController::_CaptureView() {
+  if (fShownSource.stamp == 0 || fShownGeneration != fContentGeneration ||
+      fContentView->IsLoading() || fGenreView->Model() == nullptr ||
+      fArtistView->Model() == nullptr || fAlbumView->Model() == nullptr)
+    return;
+
+  CachedView view;
+  view.source = fShownSource;
+  view.items = fContentView->Entries();
+  fContentView->EffectiveSortState(&view.sortState,
+                                   view.source.playlistSort);
+  view.totals = fShownTotals;
+  view.genres.SetTo(fGenreView->Model());
+  view.artists.SetTo(fArtistView->Model());
+  view.albums.SetTo(fAlbumView->Model());
+  view.albumData = SelectedData(fAlbumView);
+  fContentView->GetScrollState(view.topPath, view.selectedPaths);
+  fViewCache.Put(fCurrentContext, std::move(view));
+}
+
+/**
+ * Rows are created again from the cached items, in their order and with the
+ * first page drawn at once; filtering, sorting and the facet lists are
+ * skipped. Results of passes still running are dropped.
+ */
+void LibraryBrowserController::_ShowCachedView(const CachedView &view) {
+  fShownGeneration = fContentGeneration = fWorker->Cancel();
+
+  fContentView->ClearEntries();
+  fContentView->SetPlaylistMode(view.source.playlistSort);
+  auto saved = fSavedStates.find(fCurrentContext);
+  if (saved != fSavedStates.end() && !saved->second.sortState.IsEmpty())
+    fContentView->RestoreSortState(&saved->second.sortState);
+  fContentView->RestoreScrollState(view.topPath, view.selectedPaths);
+
+  BMessage sortState;
+  fContentView->EffectiveSortState(&sortState, view.source.playlistSort);
+  fContentView->AddEntries(std::vector<MediaItem>(view.items),
+                           sortState.HasSameData(view.sortState));
+
+  _SetListModel(fGenreView, view.genres.Get(), view.source.genre, "");
+  _SetListModel(fArtistView, view.artists.Get(), view.source.artist, "");
+  _SetListModel(fAlbumView, view.albums.Get(), view.source.album,
+                view.albumData);
+
+  fShownSource = view.source;
+  fShownTotals = view.totals;
+
+  if (fTarget.IsValid()) {
+    BMessage previewMsg(MSG_LIBRARY_PREVIEW);
+    previewMsg.AddInt32("count", view.totals.count);
+    previewMsg.AddInt64("duration", view.totals.duration);
+    previewMsg.AddInt64("size", view.totals.size);
+    fTarget.SendMessage(&previewMsg);
+  }
+  DEBUG_PRINT("UpdateFilteredViews: %s from view cache, %zu rows\n",
+              fCurrentContext.String(), view.items.size());
+}
+
+void LibraryBrowserController::InvalidateFilterCache() {
+  fWorker->InvalidateTextCache();
+  fSourceEpoch++;
+  fViewCache.RemoveLibraryViews();
+}
+
+void LibraryBrowserController::TrimViewCache() { fViewCache.Clear(); }
+
 /**
  * @brief Adds a single item to the views incrementally.
  * Note: Only used for real-time updates (e.g. during scan).
@@ -726,9 +769,14 @@ void LibraryBrowserController::AddMediaItem(const MediaItem &item) {
                       const char *emptyLabel) {
     BString text = val.IsEmpty() ? BString(emptyLabel) : val;
 
-    for (int32 i = 0; i < v->CountItems(); i++) {
-      if (v->ItemAt(i) == text)
+    if (SingleColumnListModel *model = v->Model()) {
+      if (model->IndexOf(text) >= 0)
         return;
+    } else {
+      for (int32 i = 0; i < v->CountItems(); i++) {
+        if (v->ItemAt(i) == text)
+          return;
+      }
     }
     v->AddItem(text);
   };
@@ -2,16 +2,37 @@
 #define BETON_LIBRARY_BROWSER_CONTROLLER_H
 
 #include "MediaTableView.h"
+#include "LibraryFacetIndex.h"
+#include "LibraryFilterWorker.h"
+#include "LibrarySearchIndex.h"
+#include "LibrarySnapshot.h"
 #include "MediaItem.h"
+#include "MemoryStats.h"
 #include "SingleColumnListView.h"
+#include "ViewModelCache.h"
+#include <Locker.h>
 #include <Message.h>
 #include <Messenger.h>
 #include <String.h>
 #include <SupportDefs.h>
+#include <map>
 #include <set>
 #include <unordered_map>
 #include <vector>
 
+/**
+ * @struct LibraryFilterSource
+ * @brief Shared library state behind the items passed to
+ * `LibraryBrowserController::UpdateFilteredViews()`.
+ */
+struct LibraryFilterSource {
+  LibrarySnapshot *snapshot = nullptr;       ///< Shared copy of the items
+  const LibraryFacetIndex *facets = nullptr; ///< Facet index over the items
+  const LibrarySearchIndex *search = nullptr; ///< Text index over the items
+  BLocker *indexLock = nullptr; ///< Guards both indexes against the worker
+  const MediaPathIndex *paths = nullptr; ///< Path index, window thread only
+};
+
 /**
  * @class LibraryBrowserController
  * @brief Manages the "Column Browser" interface (Genre -> Artist -> Album ->
@@ -66,13 +87,23 @@ public:
    * @param preserveScroll If true, keeps previous content scroll position.
    * @param updateContentList If false, updates filters only and keeps content list untouched.
    * @param showPlaylistSort True only for real playlist sources.
+   * @param library Snapshot and indexes `allItems` belong to, or `nullptr`.
+   * With a snapshot in library mode the pass runs on the filter worker and
+   * the views update when its result arrives; otherwise it runs inline.
    */
   void UpdateFilteredViews(const std::vector<MediaItem> &allItems,
                            bool isLibraryMode, const BString &currentContext,
                            const BString &filterText = "",
                            bool preserveScroll = false,
                            bool updateContentList = true,
-                           bool showPlaylistSort = false);
+                           bool showPlaylistSort = false,
+                           const LibraryFilterSource *library = nullptr);
+
+  /**
+   * @brief Applies a `MSG_FILTER_RESULT` from the filter worker.
+   * @param msg Message with the finished "job".
+   */
+  void HandleFilterResult(BMessage *msg);
 
   /**
    * @brief Incrementally adds a media item (used during live scanning).
@@ -84,6 +115,18 @@ public:
    */
   void ResetFilters();
 
+  /**
+   * @brief Forgets the text matches of the previous library update and the
+   * cached views built from library items.
+   *
+   * Must be called whenever library items change, since a following
+   * narrowing query only re-checks the previous matches.
+   */
+  void InvalidateFilterCache();
+
+  /** @brief Drops the views cached for switching back to a context. */
+  void TrimViewCache();
+
   ///@}
 
   /** @name Static Helper Methods */
@@ -117,11 +160,16 @@ public:
   void SetActiveItems(const std::vector<MediaItem> &items);
 
   /**
-   * @brief Replaces a path in the active scope after a file was moved.
-   * @param from Old absolute path.
-   * @param to New absolute path.
+   * @brief Replaces paths in the active scope after files were moved.
+   * @param moves Old absolute path to new absolute path.
    */
-  void RenameActivePath(const BString &from, const BString &to);
+  void RenameActivePaths(const std::map<BString, BString> &moves);
+
+  /** @brief Heap bytes of the active scope's arrays, for MemoryStats. */
+  size_t ScopeBytes() const {
+    return MemoryStats::BytesOf(fActivePaths) +
+           MemoryStats::BytesOf(fActiveItems);
+  }
 
   void UpdateActiveItem(const MediaItem &item);
 
@@ -138,6 +186,15 @@ public:
    */
   void SetRadioFilterMode(bool radio);
 
+  /** @brief Window-thread time of the last applied filter result. */
+  bigtime_t LastApplyTime() const { return fLastApplyTime; }
+
+  /**
+   * @brief Totals of the content list as of the last filter pass. Rows added
+   * or removed since then make `count` differ from the list.
+   */
+  const LibraryTotals &ShownTotals() const { return fShownTotals; }
+
 private:
   /**
    * @brief Internal helper to check path allowance against active paths.
@@ -145,6 +202,32 @@ private:
   bool _PathAllowedByMode(const BString &filePath, bool isLibraryMode,
                           const std::vector<BString> &activePaths) const;
 
+  /** @brief Updates the columns and content list from a computed pass. */
+  void _ApplyFilterJob(LibraryFilterJob &job);
+
+  /**
+   * @brief Identifies the items a pass over `allItems` would filter; equal
+   * stamps give equal results for equal selections.
+   * @param snapshot The library snapshot `allItems` belong to, or nullptr.
+   */
+  uint64 _SourceStamp(const std::vector<MediaItem> &allItems,
+                      bool isLibraryMode,
+                      const LibrarySnapshot *snapshot) const;
+
+  /** @brief Stores the shown view of the current context in the cache. */
+  void _CaptureView();
+
+  /** @brief Shows a cached view instead of running a filter pass. */
+  void _ShowCachedView(const CachedView &view);
+
+  /**
+   * @brief Shows `model` in `view` and selects the row with `selData`, or
+   * else `selText`.
+   */
+  static void _SetListModel(SingleColumnListView *view,
+                            SingleColumnListModel *model,
+                            const BString &selText, const BString &selData);
+
 private:
   /** @name State */
   ///@{
@@ -173,6 +256,22 @@ private:
 
   bool fIsRadioFilterMode{false}; ///< Controls filter label text
   bool fFirstUpdate{true};        ///< Force filter restore on first update
+  bigtime_t fLastApplyTime{0};
+  LibraryTotals fShownTotals;
+  ///@}
+
+  /** @name View Cache */
+  ///@{
+  ViewModelCache fViewCache;
+  ViewSource fShownSource; ///< What the shown content was built from
+  uint64 fSourceEpoch{0};  ///< Counts library item changes
+  ///@}
+
+  /** @name Filter Worker */
+  ///@{
+  LibraryFilterWorker *fWorker;
+  int32 fShownGeneration{0}; ///< Job whose content list is displayed
+  int32 fContentGeneration{0}; ///< Latest job that updates the content list
   ///@}
 
 public:
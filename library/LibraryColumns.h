@@ -0,0 +1,57 @@
+#ifndef BETON_LIBRARY_COLUMNS_H
+#define BETON_LIBRARY_COLUMNS_H
+
+#include "MediaItem.h"
+
+#include <SupportDefs.h>
+#include <vector>
+
+/** @brief Sums over a set of library items. */
+struct LibraryTotals {
+  int32 count = 0;
+  int64 duration = 0; ///< Seconds
+  int64 size = 0;     ///< Bytes
+};
+
+/**
+ * @class LibraryColumns
+ * @brief Numeric fields of the library items, one contiguous array per field.
+ *
+ * Sums over a view (status bar, browser preview) then read a few packed
+ * arrays instead of striding through whole `MediaItem`s. The reductions keep
+ * independent accumulators so the compiler can vectorize them. Position `i`
+ * in every column is item `i` of the array the columns were built from.
+ */
+class LibraryColumns {
+public:
+  LibraryColumns();
+
+  /** @brief Replaces the columns with the fields of `items`. */
+  void Build(const std::vector<MediaItem> &items);
+
+  size_t Count() const { return fDurations.size(); }
+
+  const std::vector<int32> &Durations() const { return fDurations; }
+  const std::vector<int64> &Sizes() const { return fSizes; }
+  const std::vector<int32> &Bitrates() const { return fBitrates; }
+  const std::vector<int32> &Years() const { return fYears; }
+  const std::vector<int32> &Ratings() const { return fRatings; }
+
+  /** @brief Totals over all items. */
+  LibraryTotals Totals() const;
+
+  /** @brief Totals over the items at `positions`. */
+  LibraryTotals Totals(const std::vector<uint32> &positions) const;
+
+  /** @brief Heap bytes held by the columns. */
+  size_t MemoryBytes() const;
+
+private:
+  std::vector<int32> fDurations;
+  std::vector<int64> fSizes;
+  std::vector<int32> fBitrates;
+  std::vector<int32> fYears;
+  std::vector<int32> fRatings;
+};
+
+#endif // BETON_LIBRARY_COLUMNS_H
@@ -1,24 +1,36 @@
 #include "LibraryController.h"
+#include "DLNAMediaServer.h"
+#include "DuplicateFinderWindow.h"
+#include "FileMoveJob.h"
 #include "MainWindow.h"
 #include "MetadataPropertiesWindow.h"
 #include "LibraryBrowserController.h"
+#include "MediaBatch.h"
 #include "MusicSourceManagerWindow.h"
 #include "MediaLibraryCache.h"
 #include "Debug.h"
 #include "Messages.h"
 #include "PlaylistLibrary.h"
+#include "PlaylistSelectionController.h"
 #include "PlaylistSidebarView.h"
+#include "SmartPlaylistManager.h"
 #include "MediaTableView.h"
 #include "StatusBarController.h"
+#include "StringPool.h"
 #include "UndoManager.h"
+#include <Alert.h>
+#include <Autolock.h>
 #include <Catalog.h>
 #include <Directory.h>
+#include <MenuItem.h>
 #include <MessageRunner.h>
 #include <Entry.h>
+#include <Invoker.h>
 #include <Messenger.h>
 #include <OS.h>
 #include <Path.h>
 #include <Roster.h>
+#include <StringForSize.h>
 #include <algorithm>
 #include <map>
 #include <set>
@@ -27,7 +39,12 @@
 #undef B_TRANSLATION_CONTEXT
 #define B_TRANSLATION_CONTEXT "LibraryController"
 
-LibraryController::LibraryController(MainWindow* window) : fWindow(window) {}
+LibraryController::LibraryController(MainWindow* window)
+    : fWindow(window), fSearchIndexBuilding(false),
+      fSearchIndexRestart(false),
+      fPartialRefresh(BMessenger(window), MSG_VIEWS_REFRESH_PARTIAL),
+      fRefreshDeferred(false), fFirstRowShown(false), fRowsComplete(false),
+      fStartupDone(false) {}
 LibraryController::~LibraryController() {}
 
 /**
@@ -38,6 +55,18 @@ void LibraryController::ShowDirectoryManager() {
   win->Show();
 }
 
+void LibraryController::ShowDuplicateFinder() {
+  LibrarySnapshot *snapshot = fWindow->fAllItems.Snapshot();
+  if (snapshot == nullptr || fWindow->fAllItems.IsEmpty()) {
+    fWindow->UpdateStatus(B_TRANSLATE("The library is empty"));
+    return;
+  }
+
+  DuplicateFinderWindow *win =
+      new DuplicateFinderWindow(BMessenger(fWindow), snapshot);
+  win->Show();
+}
+
 /**
  * @brief Moves a file on disk and updates library state on success.
  */
@@ -84,50 +113,207 @@ void LibraryController::HandleFileMove(BMessage *msg) {
   }
 
   BString newPath = toPath.Path();
+  std::map<BString, BString> moves;
+  moves[from] = newPath;
+  _ApplyFileMoves(moves);
+
+  // Record the move as an undoable action (skip undo/redo replays).
+  if (!msg->HasBool("undo_replay") && fWindow->fUndoManager) {
+    BMessage u(MSG_FILE_MOVE);
+    u.AddString("from", newPath);
+    u.AddString("to", from);
+    BMessage r(MSG_FILE_MOVE);
+    r.AddString("from", from);
+    r.AddString("to", newPath);
+    fWindow->fUndoManager->RecordAction({u}, {r});
+  }
+
+  BString status(B_TRANSLATE("Moved to "));
+  status << newPath;
+  fWindow->UpdateStatus(status);
+}
+
+/**
+ * @brief Starts a MSG_FILES_MOVE request on a worker thread.
+ *
+ * The result arrives as MSG_FILES_MOVED, see HandleFilesMoved().
+ */
+void LibraryController::HandleFilesMove(BMessage *msg) {
+  int32 count = 0;
+  if (msg->GetInfo("from", nullptr, &count) != B_OK || count == 0)
+    return;
+
+  BMessenger target(fWindow);
+  BMessage request(*msg);
+  BReference<WorkerJob> job = fWindow->QueueJob(
+      kLaneBackground, "file move", [request, target]() {
+        BMessage result;
+        FileMoveJob::Run(request, result);
+        target.SendMessage(&result);
+      });
+  if (job.Get() == nullptr) {
+    BMessage result;
+    FileMoveJob::Run(*msg, result);
+    HandleFilesMoved(&result);
+    return;
+  }
+
+  BString status;
+  status.SetToFormat(B_TRANSLATE("Moving %ld files..."),
+                     (long)count);
+  fWindow->UpdateStatus(status);
+}
+
+/**
+ * @brief Applies a finished file move job in one go: library, views,
+ * cache, playlists and a single undo step.
+ */
+void LibraryController::HandleFilesMoved(BMessage *msg) {
+  std::map<BString, BString> moves;
+  BString from, to;
+  for (int32 i = 0; msg->FindString("from", i, &from) == B_OK &&
+                    msg->FindString("to", i, &to) == B_OK;
+       i++) {
+    moves[from] = to;
+  }
+
+  // Trashed files leave the playlist they were removed from.
+  BString playlist = msg->GetString("playlist", "");
+  const bool trash = msg->GetBool("trash", false);
+  const bool updatesPlaylist = !playlist.IsEmpty() && !moves.empty() &&
+                               fWindow->fPlaylistLibrary &&
+                               fWindow->fPlaylistLibrary->IsPlaylistWritable(
+                                   playlist);
+  std::vector<BString> beforePaths, afterPaths;
+  if (updatesPlaylist && trash) {
+    beforePaths = fWindow->fPlaylistLibrary->LoadPlaylist(playlist);
+    for (const auto &p : beforePaths) {
+      if (moves.find(p) == moves.end())
+        afterPaths.push_back(p);
+    }
+  }
+
+  if (!moves.empty())
+    _ApplyFileMoves(moves);
+
+  if (updatesPlaylist && trash)
+    fWindow->fPlaylistLibrary->SavePlaylist(playlist, afterPaths);
+  if (updatesPlaylist && playlist == fWindow->fCurrentPlaylistName) {
+    int32 selected = fWindow->fPlaylistLibrary->View()->CurrentSelection();
+    if (selected >= 0) {
+      BMessage selMsg(MSG_PLAYLIST_SELECTION);
+      selMsg.AddInt32("index", selected);
+      selMsg.AddString("name", playlist);
+      fWindow->fPlaylistSelectionController->HandlePlaylistSelection(&selMsg);
+    }
+  }
+
+  if (!moves.empty() && !msg->HasBool("undo_replay") && fWindow->fUndoManager) {
+    BMessage u(MSG_FILES_MOVE);
+    BMessage r(MSG_FILES_MOVE);
+    for (const auto &move : moves) {
+      u.AddString("from", move.second);
+      u.AddString("to", move.first);
+      r.AddString("from", move.first);
+      r.AddString("to", move.second);
+    }
+    std::vector<BMessage> undoMsgs{u};
+    std::vector<BMessage> redoMsgs{r};
+    if (updatesPlaylist && trash) {
+      BMessage uPlaylist(MSG_RESTORE_PLAYLIST_PATHS);
+      uPlaylist.AddString("playlist", playlist);
+      for (const auto &p : beforePaths)
+        uPlaylist.AddString("paths", p);
+      undoMsgs.push_back(uPlaylist);
+
+      BMessage rPlaylist(MSG_RESTORE_PLAYLIST_PATHS);
+      rPlaylist.AddString("playlist", playlist);
+      for (const auto &p : afterPaths)
+        rPlaylist.AddString("paths", p);
+      redoMsgs.push_back(rPlaylist);
+    }
+    fWindow->fUndoManager->RecordAction(undoMsgs, redoMsgs);
+  }
+
+  BString status;
+  BPath directory(msg->GetString("directory", ""));
+  if (trash)
+    status.SetToFormat(B_TRANSLATE("Moved %zu items to Trash."), moves.size());
+  else if (directory.InitCheck() == B_OK && directory.Leaf() != nullptr)
+    status.SetToFormat(B_TRANSLATE("Moved %zu items to %s."), moves.size(),
+                       directory.Leaf());
+  else
+    status.SetToFormat(B_TRANSLATE("Moved %zu items."), moves.size());
+  int32 failed = msg->GetInt32("failed", 0);
+  if (failed > 0) {
+    BString failures;
+    failures.SetToFormat(B_TRANSLATE(" %ld could not be moved: %s"),
+                         (long)failed, msg->GetString("error", ""));
+    status << failures;
+  }
+  fWindow->UpdateStatus(status);
+}
 
-  // Update the in-memory model and the visible row.
+/**
+ * @brief Updates the library, views, cache and saved playlists for files
+ * that were moved on disk.
+ * @param moves Old absolute path to new absolute path.
+ */
+void LibraryController::_ApplyFileMoves(
+    const std::map<BString, BString> &moves) {
   MediaTableView *cv =
       (fWindow->fLibraryManager) ? fWindow->fLibraryManager->ContentView()
                                  : nullptr;
-
-  auto mapIt = fWindow->fPathIndex.find(from);
-  if (mapIt != fWindow->fPathIndex.end()) {
-    size_t idx = mapIt->second;
-    fWindow->fPathIndex.erase(mapIt);
-    fWindow->fAllItems[idx].path = newPath;
-    fWindow->fPathIndex[newPath] = idx;
-    if (cv)
-      cv->UpdateItem(fWindow->fAllItems[idx], &from);
-  } else if (cv) {
-    // Items outside the library index (e.g. playlist-only entries):
-    // update the visible row directly.
-    for (int32 i = 0; i < cv->CountRows(); ++i) {
-      const MediaItem *mi = cv->ItemAt(i);
-      if (mi && mi->path == from) {
+  SmartPlaylistManager *smart =
+      fWindow->fPlaylistLibrary ? &fWindow->fPlaylistLibrary->SmartPlaylists()
+                                : nullptr;
+
+  BMessage moved(MSG_FILE_MOVED);
+  for (const auto &move : moves) {
+    const BString &from = move.first;
+    const BString &newPath = move.second;
+
+    // Update the in-memory model and the visible row.
+    size_t idx = fWindow->fPathIndex.Find(from);
+    if (idx != MediaPathIndex::kNotFound) {
+      fWindow->fPathIndex.Erase(from);
+      MediaItem &item = fWindow->fAllItems.Mutable()[idx];
+      item.path = newPath;
+      fWindow->fPathIndex.Insert(newPath, idx);
+      if (cv)
+        cv->UpdateItem(item, &from);
+      if (smart) {
+        smart->ItemRemoved(from);
+        smart->ItemChanged(item);
+      }
+    } else if (cv) {
+      // Items outside the library index (e.g. playlist-only entries):
+      // update the visible row directly.
+      if (const MediaItem *mi = cv->FindItem(from)) {
         MediaItem updated = *mi;
         updated.path = newPath;
         cv->UpdateItem(updated, &from);
-        break;
       }
     }
-  }
 
-  if (cv && cv->NowPlayingPath() == from)
-    cv->SetNowPlayingPath(newPath);
+    if (cv && cv->NowPlayingPath() == from)
+      cv->SetNowPlayingPath(newPath);
 
-  if (fWindow->fLibraryManager)
-    fWindow->fLibraryManager->RenameActivePath(from, newPath);
-
-  // Rekey the persistent cache entry.
-  if (fWindow->fMediaLibraryCache) {
-    BMessage moved(MSG_FILE_MOVED);
     moved.AddString("from", from);
     moved.AddString("to", newPath);
-    fWindow->fMediaLibraryCache->PostMessage(&moved);
   }
 
-  // Rewrite saved playlists that reference the old path.
+  if (fWindow->fLibraryManager)
+    fWindow->fLibraryManager->RenameActivePaths(moves);
+
+  // Rekey the persistent cache entries.
+  if (fWindow->fMediaLibraryCache)
+    fWindow->fMediaLibraryCache->PostMessage(&moved);
+
+  // Rewrite saved playlists that reference the old paths.
   if (fWindow->fPlaylistLibrary) {
+    _FlushSmartPlaylists();
+
     BMessage names;
     fWindow->fPlaylistLibrary->GetPlaylistNames(names, true);
     BString plName;
@@ -136,8 +322,9 @@ void LibraryController::HandleFileMove(BMessage *msg) {
           fWindow->fPlaylistLibrary->LoadPlaylist(plName);
       bool changed = false;
       for (auto &p : paths) {
-        if (p == from) {
-          p = newPath;
+        auto move = moves.find(p);
+        if (move != moves.end()) {
+          p = move->second;
           changed = true;
         }
       }
@@ -145,21 +332,6 @@ void LibraryController::HandleFileMove(BMessage *msg) {
         fWindow->fPlaylistLibrary->SavePlaylist(plName, paths);
     }
   }
-
-  // Record the move as an undoable action (skip undo/redo replays).
-  if (!msg->HasBool("undo_replay") && fWindow->fUndoManager) {
-    BMessage u(MSG_FILE_MOVE);
-    u.AddString("from", newPath);
-    u.AddString("to", from);
-    BMessage r(MSG_FILE_MOVE);
-    r.AddString("from", from);
-    r.AddString("to", newPath);
-    fWindow->fUndoManager->RecordAction({u}, {r});
-  }
-
-  BString status(B_TRANSLATE("Moved to "));
-  status << newPath;
-  fWindow->UpdateStatus(status);
 }
 
 /**
@@ -170,16 +342,17 @@ void LibraryController::HandleCacheLoaded() {
   bigtime_t tc0 = system_time();
   fWindow->fCacheLoaded = true;
   if (fWindow->fMediaLibraryCache) {
-    auto entries = fWindow->fMediaLibraryCache->AllEntries();
+    fWindow->fAllItems.SetTo(
+        fWindow->fMediaLibraryCache->CurrentSnapshot().Get());
     bigtime_t tc1 = system_time();
-    fWindow->fAllItems = std::move(entries);
 
     RebuildPathIndex();
+    _RebuildSmartPlaylists();
     bigtime_t tc2 = system_time();
 
     DEBUG_PRINT("Cache populated: %zu items "
-                "(AllEntries=%lld us, PathIndex=%lld us)\n",
-                fWindow->fAllItems.size(), (long long)(tc1 - tc0),
+                "(Snapshot=%lld us, PathIndex=%lld us)\n",
+                fWindow->fAllItems.Count(), (long long)(tc1 - tc0),
                 (long long)(tc2 - tc1));
 
     fWindow->UpdateFilteredViews();
@@ -191,6 +364,41 @@ void LibraryController::HandleCacheLoaded() {
   }
 }
 
+void LibraryController::NoteRowsShown(bool rowsComplete) {
+  if (fStartupDone || !fWindow->fCacheLoaded)
+    return;
+
+  if (!fFirstRowShown) {
+    fFirstRowShown = true;
+    DEBUG_PRINT("Startup: time-to-first-row %lld ms\n",
+                (long long)((system_time() - fWindow->fLaunchTime) / 1000));
+  }
+  if (rowsComplete)
+    fRowsComplete = true;
+  _CheckInteractive();
+}
+
+/**
+ * @brief Finishes startup once all rows and the search index are ready.
+ */
+void LibraryController::_CheckInteractive() {
+  if (fStartupDone || !fRowsComplete || fSearchIndexBuilding)
+    return;
+  fStartupDone = true;
+  DEBUG_PRINT("Startup: time-to-interactive %lld ms\n",
+              (long long)((system_time() - fWindow->fLaunchTime) / 1000));
+
+  if (!fWindow->fMediaLibraryCache)
+    return;
+  BMessage validate(MSG_VALIDATE_CACHE);
+  if (fWindow->fLibraryManager && fWindow->fLibraryManager->ContentView()) {
+    for (const BString &path :
+         fWindow->fLibraryManager->ContentView()->VisiblePaths())
+      validate.AddString("path", path);
+  }
+  BMessenger(fWindow->fMediaLibraryCache).SendMessage(&validate);
+}
+
 /**
  * @brief Starts a complete rescan and clears current visible library content.
  */
@@ -201,7 +409,13 @@ void LibraryController::StartFullRescan() {
   fWindow->fLibraryManager->GenreView()->Clear();
   fWindow->fLibraryManager->ArtistView()->Clear();
   fWindow->fLibraryManager->AlbumView()->Clear();
-  fWindow->fAllItems.clear();
+  fWindow->fAllItems.Clear();
+  fWindow->fPathIndex.Clear();
+  {
+    BAutolock lock(fWindow->fIndexLock);
+    fWindow->fFacetIndex.Clear();
+  }
+  RebuildSearchIndex();
 
   if (fWindow->fMediaLibraryCache) {
     BMessenger(fWindow->fMediaLibraryCache).SendMessage(MSG_RESCAN);
@@ -213,6 +427,86 @@ void LibraryController::StartFullRescan() {
 /**
  * @brief Updates status text while scan is running.
  */
+void LibraryController::ToggleLoudnessScan() {
+  if (!fWindow->fMediaLibraryCache)
+    return;
+
+  BMessage scan(MSG_LOUDNESS_SCAN);
+  if (fWindow->fLoudnessRunning)
+    scan.AddBool("stop", true);
+  else
+    scan.AddBool("write", fWindow->fLoudnessWriteFiles);
+  BMessenger(fWindow->fMediaLibraryCache).SendMessage(&scan);
+}
+
+void LibraryController::UpdateLoudnessProgress(BMessage *msg) {
+  int32 current = msg->GetInt32("current", 0);
+  int32 total = msg->GetInt32("total", 0);
+  bool done = msg->GetBool("done", false);
+
+  fWindow->fLoudnessRunning = !done;
+  if (fWindow->fLoudnessScanItem)
+    fWindow->fLoudnessScanItem->SetLabel(done
+        ? B_TRANSLATE("Analyze Loudness")
+        : B_TRANSLATE("Stop Loudness Analysis"));
+
+  BString status;
+  if (!done) {
+    status.SetToFormat(B_TRANSLATE("Analyzing loudness: %ld of %ld albums"),
+                       (long)current, (long)total);
+  } else if (current < total) {
+    status.SetToFormat(B_TRANSLATE("Loudness analysis stopped after %ld of "
+                                   "%ld albums"),
+                       (long)current, (long)total);
+  } else {
+    status.SetToFormat(B_TRANSLATE("Loudness analysis done: %ld albums"),
+                       (long)total);
+  }
+  fWindow->fStatusLabel->SetText(status.String());
+}
+
+void LibraryController::ToggleAcoustIdScan() {
+  if (!fWindow->fMediaLibraryCache)
+    return;
+
+  // Fingerprints are kept in the files, like other taggers do.
+  BMessage scan(MSG_ACOUSTID_SCAN);
+  if (fWindow->fAcoustIdRunning)
+    scan.AddBool("stop", true);
+  else
+    scan.AddBool("write", true);
+  BMessenger(fWindow->fMediaLibraryCache).SendMessage(&scan);
+}
+
+void LibraryController::UpdateAcoustIdProgress(BMessage *msg) {
+  int32 current = msg->GetInt32("current", 0);
+  int32 total = msg->GetInt32("total", 0);
+  int32 identified = msg->GetInt32("identified", 0);
+  bool done = msg->GetBool("done", false);
+
+  fWindow->fAcoustIdRunning = !done;
+  if (fWindow->fAcoustIdScanItem)
+    fWindow->fAcoustIdScanItem->SetLabel(done
+        ? B_TRANSLATE("Identify Recordings")
+        : B_TRANSLATE("Stop Identifying Recordings"));
+
+  BString status;
+  if (!done) {
+    status.SetToFormat(B_TRANSLATE("Fingerprinting: %ld of %ld files, %ld "
+                                   "identified"),
+                       (long)current, (long)total, (long)identified);
+  } else if (current < total) {
+    status.SetToFormat(B_TRANSLATE("Fingerprinting stopped after %ld of %ld "
+                                   "files, %ld identified"),
+                       (long)current, (long)total, (long)identified);
+  } else {
+    status.SetToFormat(B_TRANSLATE("Fingerprinting done: %ld files, %ld "
+                                   "identified"),
+                       (long)total, (long)identified);
+  }
+  fWindow->fStatusLabel->SetText(status.String());
+}
+
 void LibraryController::UpdateScanProgress(BMessage *msg) {
   int32 dirs = 0;
   int32 files = 0;
@@ -233,8 +527,56 @@ void LibraryController::UpdateScanProgress(BMessage *msg) {
       status.SetToFormat(B_TRANSLATE("Scanning: %ld folders, %ld files"),
                          (long)dirs, (long)files);
     }
+
+    int32 running = 0;
+    if (msg->FindInt32("running", &running) == B_OK && running > 1) {
+      BString devices;
+      devices.SetToFormat(B_TRANSLATE(" - %ld sources in parallel"),
+                          (long)running);
+      status << devices;
+    }
+
+    float filesPerSec = 0, mbPerSec = 0;
+    if (msg->FindFloat("files_per_sec", &filesPerSec) == B_OK &&
+        msg->FindFloat("mb_per_sec", &mbPerSec) == B_OK && filesPerSec > 0) {
+      BString rate;
+      rate.SetToFormat(B_TRANSLATE(" - %.0f files/s, %.1f MB/s"),
+                       filesPerSec, mbPerSec);
+      status << rate;
+    }
     fWindow->fStatusLabel->SetText(status.String());
   }
+
+  _SendScanPriority();
+}
+
+/** @brief Upper bound of paths sent as scan priority. */
+static const size_t kMaxScanPriorityPaths = 64;
+
+/**
+ * @brief Sends the paths of the visible and selected content rows to the
+ * cache, which passes them on to the running scanners.
+ *
+ * Rows of a playlist can stand for files not read yet; the scanners walk
+ * towards them and read them first. Nothing is sent while the rows stay the
+ * same.
+ */
+void LibraryController::_SendScanPriority() {
+  if (!fWindow->fMediaLibraryCache || !fWindow->fLibraryManager)
+    return;
+  MediaTableView *cv = fWindow->fLibraryManager->ContentView();
+  if (!cv)
+    return;
+
+  std::vector<BString> paths = cv->AttentionPaths(kMaxScanPriorityPaths);
+  if (paths == fScanPriority)
+    return;
+  fScanPriority = paths;
+
+  BMessage priority(MSG_SCAN_PRIORITY);
+  for (const BString &path : paths)
+    priority.AddString("path", path);
+  BMessenger(fWindow->fMediaLibraryCache).SendMessage(&priority);
 }
 
 /**
@@ -255,10 +597,11 @@ void LibraryController::HandleScanDone(BMessage *msg) {
   fWindow->UpdateStatus(status.String(), false);
 
   if (fWindow->fMediaLibraryCache) {
-    auto entries = fWindow->fMediaLibraryCache->AllEntries();
-    fWindow->fAllItems = std::move(entries);
+    fWindow->fAllItems.SetTo(
+        fWindow->fMediaLibraryCache->CurrentSnapshot().Get());
 
     RebuildPathIndex();
+    _RebuildSmartPlaylists();
   }
 
   fWindow->UpdateFilteredViews();
@@ -266,6 +609,75 @@ void LibraryController::HandleScanDone(BMessage *msg) {
   fWindow->fNewFilesCount = 0;
 }
 
+void LibraryController::ToggleScanPause() {
+  fWindow->fScanPaused = !fWindow->fScanPaused;
+  if (fWindow->fPauseScanItem)
+    fWindow->fPauseScanItem->SetMarked(fWindow->fScanPaused);
+
+  if (fWindow->fMediaLibraryCache) {
+    BMessage pause(MSG_SCAN_SET_PAUSED);
+    pause.AddBool("paused", fWindow->fScanPaused);
+    BMessenger(fWindow->fMediaLibraryCache).SendMessage(&pause);
+  }
+
+  fWindow->UpdateStatus(fWindow->fScanPaused ? B_TRANSLATE("Scanning paused")
+                                             : B_TRANSLATE("Scanning resumed"));
+}
+
+void LibraryController::HandleCacheCollected(BMessage *msg) {
+  int32 orphaned = 0, expired = 0;
+  msg->FindInt32("orphaned", &orphaned);
+  msg->FindInt32("expired", &expired);
+
+  BString status;
+  status.SetToFormat(B_TRANSLATE("Library cleanup: removed %ld entries"),
+                     (long)(orphaned + expired));
+
+  int64 before = 0, after = 0;
+  if (msg->FindInt64("bytes_before", &before) == B_OK &&
+      msg->FindInt64("bytes_after", &after) == B_OK && before > after) {
+    char sizeText[64];
+    status << ", " << string_for_size((double)(before - after), sizeText,
+                                      sizeof(sizeText))
+           << B_TRANSLATE(" freed");
+  }
+  fWindow->UpdateStatus(status.String(), false);
+}
+
+void LibraryController::HandleBfsIndexesMissing(BMessage *msg) {
+  BString volume;
+  if (!fWindow->fMediaLibraryCache ||
+      msg->FindString("volume", &volume) != B_OK)
+    return;
+
+  BString attributes;
+  const char *attr;
+  for (int32 i = 0; msg->FindString("attr", i, &attr) == B_OK; i++) {
+    if (i > 0)
+      attributes << ", ";
+    attributes << attr;
+  }
+
+  BString text(B_TRANSLATE(
+      "The volume \"%volume%\" has no index for %attributes%.\n\n"
+      "With these indexes, queries in Tracker can find your music by its "
+      "tags. Files are added to an index when their attributes are next "
+      "written.\n\nCreate the indexes now?"));
+  text.ReplaceFirst("%volume%", volume);
+  text.ReplaceFirst("%attributes%", attributes);
+
+  BAlert *alert = new BAlert(B_TRANSLATE("Attribute indexes"), text.String(),
+                             B_TRANSLATE("Not now"),
+                             B_TRANSLATE("Create indexes"), nullptr,
+                             B_WIDTH_AS_USUAL, B_IDEA_ALERT);
+  alert->SetShortcut(0, B_ESCAPE);
+
+  // The alert adds the button index as "which".
+  BMessage *reply = new BMessage(*msg);
+  reply->what = MSG_BFS_INDEXES_CREATE;
+  alert->Go(new BInvoker(reply, BMessenger(fWindow->fMediaLibraryCache)));
+}
+
 /**
  * @brief Loads pending cache items in small timed batches to keep UI responsive.
  */
@@ -297,69 +709,97 @@ void LibraryController::HandleBatchTimer() {
   fWindow->fStatusLabel->SetText(buf);
 }
 
+/**
+ * @brief True if BPath would rewrite `path`: relative, or with an empty,
+ * "." or ".." component, or a trailing slash.
+ */
+static bool NeedsNormalizing(const BString &path) {
+  const char *p = path.String();
+  const int32 length = path.Length();
+  if (length == 0 || p[0] != '/')
+    return true;
+  if (length > 1 && p[length - 1] == '/')
+    return true;
+  for (int32 i = 0; i < length; i++) {
+    if (p[i] != '/')
+      continue;
+    const char *c = p + i + 1;
+    if (c[0] == '/')
+      return true;
+    if (c[0] == '.' && (c[1] == '/' || c[1] == '\0'))
+      return true;
+    if (c[0] == '.' && c[1] == '.' && (c[2] == '/' || c[2] == '\0'))
+      return true;
+  }
+  return false;
+}
+
 /**
  * @brief Applies a batch of media field updates and schedules partial refresh.
  */
 void LibraryController::HandleMediaBatch(BMessage *msg) {
-  type_code type;
-  int32 count = 0;
-  if (msg->GetInfo("path", &type, &count) != B_OK)
+  BReference<MediaBatch> batch = MediaBatch::Detach(msg);
+  if (batch.Get() == nullptr)
     return;
 
-  for (int32 i = 0; i < count; i++) {
-    BString pathStr;
-    if (msg->FindString("path", i, &pathStr) != B_OK)
-      continue;
-
-    BPath normPath(pathStr.String());
-    BString path;
-    if (normPath.InitCheck() == B_OK)
-      path = normPath.Path();
-    else
-      path = pathStr;
+  StringPool &pool = StringPool::Default();
+  std::vector<MediaItem> &allItems = fWindow->fAllItems.Mutable();
+  for (const MediaItem &item : batch->items) {
+    // Scanned paths are normalized already; they are shared, not copied.
+    BString path = item.path;
+    if (NeedsNormalizing(path)) {
+      BPath normPath(path.String());
+      if (normPath.InitCheck() == B_OK)
+        path = normPath.Path();
+    }
 
     bool isNewItem = false;
     MediaItem *itemToUpdate = nullptr;
-    auto mapIt = fWindow->fPathIndex.find(path);
-    if (mapIt != fWindow->fPathIndex.end()) {
-      itemToUpdate = &fWindow->fAllItems[mapIt->second];
+    size_t index = fWindow->fPathIndex.Find(path);
+    if (index != MediaPathIndex::kNotFound) {
+      itemToUpdate = &allItems[index];
     } else {
-      MediaItem newItem;
-      newItem.path = path;
-      fWindow->fAllItems.push_back(newItem);
-      fWindow->fPathIndex[path] = fWindow->fAllItems.size() - 1;
-      itemToUpdate = &fWindow->fAllItems.back();
+      allItems.emplace_back();
+      allItems.back().path = path;
+      fWindow->fPathIndex.Insert(path, allItems.size() - 1);
+      itemToUpdate = &allItems.back();
       isNewItem = true;
     }
 
     if (itemToUpdate) {
-      BString tmp;
-      if (msg->FindString("title", i, &tmp) == B_OK)
-        itemToUpdate->title = tmp;
-      if (msg->FindString("artist", i, &tmp) == B_OK)
-        itemToUpdate->artist = tmp;
-      if (msg->FindString("album", i, &tmp) == B_OK)
-        itemToUpdate->album = tmp;
-      if (msg->FindString("genre", i, &tmp) == B_OK)
-        itemToUpdate->genre = tmp;
-
-      int32 val;
-      if (msg->FindInt32("year", i, &val) == B_OK)
-        itemToUpdate->year = val;
-      if (msg->FindInt32("track", i, &val) == B_OK)
-        itemToUpdate->track = val;
-      if (msg->FindInt32("disc", i, &val) == B_OK)
-        itemToUpdate->disc = val;
-      if (msg->FindInt32("duration", i, &val) == B_OK)
-        itemToUpdate->duration = val;
+      const size_t position = isNewItem ? allItems.size() - 1 : index;
+      const MediaItem before = *itemToUpdate;
+      itemToUpdate->title = item.title;
+      itemToUpdate->artist = pool.Intern(item.artist);
+      itemToUpdate->album = pool.Intern(item.album);
+      itemToUpdate->genre = pool.Intern(item.genre);
+      itemToUpdate->year = item.year;
+      itemToUpdate->track = item.track;
+      itemToUpdate->disc = item.disc;
+      itemToUpdate->duration = item.duration;
+      itemToUpdate->trackGain = item.trackGain;
+      itemToUpdate->trackPeak = item.trackPeak;
+      itemToUpdate->albumGain = item.albumGain;
+      itemToUpdate->albumPeak = item.albumPeak;
+
+      {
+        BAutolock lock(fWindow->fIndexLock);
+        if (isNewItem)
+          fWindow->fFacetIndex.Add(position, *itemToUpdate);
+        else
+          fWindow->fFacetIndex.Update(position, before, *itemToUpdate);
+        _UpdateSearchIndex(position, *itemToUpdate);
+      }
+      if (fWindow->fPlaylistLibrary)
+        fWindow->fPlaylistLibrary->SmartPlaylists().ItemChanged(*itemToUpdate);
 
       MediaTableView *cv =
           fWindow->fLibraryManager ? fWindow->fLibraryManager->ContentView() : nullptr;
       if (cv) {
         if (isNewItem) {
-          if (fWindow->fIsLibraryMode) {
-            cv->AddEntry(*itemToUpdate);
-          }
+          /// Shown with the next refresh, together with the other additions.
+          if (fWindow->fIsLibraryMode)
+            fPendingAdditions.push_back(path);
         } else {
           cv->UpdateItem(*itemToUpdate);
         }
@@ -367,38 +807,95 @@ void LibraryController::HandleMediaBatch(BMessage *msg) {
     }
   }
 
-  delete fWindow->fViewsRefreshRunner;
-  BMessage refresh(MSG_VIEWS_REFRESH_PARTIAL);
-  fWindow->fViewsRefreshRunner =
-      new BMessageRunner(BMessenger(fWindow), &refresh, 200000, 1);
+  _FlushSmartPlaylists();
+  fPartialRefresh.Schedule();
 }
 
 /**
  * @brief Refreshes filtered views after debounced incremental updates.
  */
 void LibraryController::RefreshPartialViews() {
-  DEBUG_PRINT("Debounced partial view refresh triggered\n");
+  fPartialRefresh.Fired();
+  if (fWindow->IsHidden() || fWindow->IsMinimized()) {
+    fRefreshDeferred = true;
+    return;
+  }
+  fRefreshDeferred = false;
+
+  DEBUG_PRINT("Coalesced partial view refresh (%zu new rows)\n",
+              fPendingAdditions.size());
+  bigtime_t start = system_time();
+
+  /// Items may have changed or gone since they were collected, and a full
+  /// refresh in between may already show them.
+  MediaTableView *cv =
+      fWindow->fLibraryManager ? fWindow->fLibraryManager->ContentView() : nullptr;
+  if (cv && fWindow->fIsLibraryMode && !fPendingAdditions.empty()) {
+    const std::vector<MediaItem> &allItems = fWindow->fAllItems.Items();
+    std::vector<MediaItem> added;
+    added.reserve(fPendingAdditions.size());
+    for (const BString &path : fPendingAdditions) {
+      size_t index = fWindow->fPathIndex.Find(path);
+      if (index != MediaPathIndex::kNotFound && !cv->FindItem(path))
+        added.push_back(allItems[index]);
+    }
+    cv->AppendEntries(added);
+  }
+  fPendingAdditions.clear();
+
   const auto &items =
       (fWindow->fIsRadioMode || fWindow->fIsDlnaMode)
           ? fWindow->fRadioItems
-          : fWindow->fAllItems;
+          : fWindow->fAllItems.Items();
+  LibraryFilterSource library = fWindow->FilterSource();
   fWindow->fLibraryManager->UpdateFilteredViews(
       items, fWindow->fIsLibraryMode || fWindow->fIsRadioMode ||
                  fWindow->fIsDlnaMode,
       fWindow->fCurrentPlaylistName,
       fWindow->fSearchField->Text() ? fWindow->fSearchField->Text() : "",
-      false, false, fWindow->IsPlaylistSelected());
+      false, false, fWindow->IsPlaylistSelected(), &library);
+
+  /// The filter result is applied later; count the previous one instead.
+  fPartialRefresh.RecordCost(system_time() - start +
+                             fWindow->fLibraryManager->LastApplyTime());
+}
+
+void LibraryController::ResumeDeferredRefresh() {
+  if (fRefreshDeferred)
+    fPartialRefresh.Schedule();
 }
 
 /**
  * @brief Applies single-item updates from scanner/metadata changes.
  */
 void LibraryController::HandleMediaItemFound(BMessage *msg) {
+  if (_ApplyMediaItem(msg))
+    _ScheduleViewsRefresh();
+  _FlushSmartPlaylists();
+  if (fWindow->fMetadataPropertiesWindow)
+    fWindow->fMetadataPropertiesWindow->PostMessage(msg);
+}
+
+void LibraryController::HandleMediaItemsUpdated(BMessage *msg) {
+  bool needsFullRefresh = false;
+  BMessage item;
+  for (int32 i = 0; msg->FindMessage("item", i, &item) == B_OK; i++) {
+    if (_ApplyMediaItem(&item))
+      needsFullRefresh = true;
+  }
+  if (needsFullRefresh)
+    _ScheduleViewsRefresh();
+  _FlushSmartPlaylists();
+  if (fWindow->fMetadataPropertiesWindow)
+    fWindow->fMetadataPropertiesWindow->PostMessage(msg);
+}
+
+bool LibraryController::_ApplyMediaItem(BMessage *msg) {
   BString pathStr;
   if (msg->FindString("path", &pathStr) != B_OK) {
     DEBUG_PRINT(
         "MSG_MEDIA_ITEM_FOUND path not found in message!\n");
-    return;
+    return false;
   }
 
   BPath normPath(pathStr.String());
@@ -412,16 +909,17 @@ void LibraryController::HandleMediaItemFound(BMessage *msg) {
               path.String(), pathStr.String());
 
   MediaItem *itemToUpdate = nullptr;
-  auto mapIt = fWindow->fPathIndex.find(path);
-  bool isLibraryItem = (mapIt != fWindow->fPathIndex.end());
+  size_t index = fWindow->fPathIndex.Find(path);
+  bool isLibraryItem = (index != MediaPathIndex::kNotFound);
   if (isLibraryItem) {
-    itemToUpdate = &fWindow->fAllItems[mapIt->second];
+    itemToUpdate = &fWindow->fAllItems.Mutable()[index];
   } else if (!fWindow->fIsFolderMode) {
     MediaItem newItem;
     newItem.path = path;
-    fWindow->fAllItems.push_back(newItem);
-    fWindow->fPathIndex[path] = fWindow->fAllItems.size() - 1;
-    itemToUpdate = &fWindow->fAllItems.back();
+    std::vector<MediaItem> &allItems = fWindow->fAllItems.Mutable();
+    allItems.push_back(newItem);
+    fWindow->fPathIndex.Insert(path, allItems.size() - 1);
+    itemToUpdate = &allItems.back();
   }
 
   // Folder-mode item not in library: apply update in-place without touching
@@ -451,18 +949,19 @@ void LibraryController::HandleMediaItemFound(BMessage *msg) {
       if (fWindow->fLibraryManager->ContentView())
         fWindow->fLibraryManager->ContentView()->UpdateItem(folderItem);
     }
-    if (fWindow->fMetadataPropertiesWindow)
-      fWindow->fMetadataPropertiesWindow->PostMessage(msg);
-    return;
+    return false;
   }
 
   if (!itemToUpdate) {
     DEBUG_PRINT("MSG_MEDIA_ITEM_FOUND itemToUpdate is NULL "
                 "for path: %s\n",
                 path.String());
-    return;
+    return false;
   }
 
+  const size_t position =
+      isLibraryItem ? index : fWindow->fAllItems.Count() - 1;
+  const MediaItem before = *itemToUpdate;
   bool needsFullRefresh = false;
 
   BString tmp;
@@ -522,23 +1021,36 @@ void LibraryController::HandleMediaItemFound(BMessage *msg) {
   if (msg->FindInt32("bitrate", &val) == B_OK)
     itemToUpdate->bitrate = val;
 
+  {
+    BAutolock lock(fWindow->fIndexLock);
+    if (isLibraryItem)
+      fWindow->fFacetIndex.Update(position, before, *itemToUpdate);
+    else
+      fWindow->fFacetIndex.Add(position, *itemToUpdate);
+    _UpdateSearchIndex(position, *itemToUpdate);
+  }
+  if (fWindow->fPlaylistLibrary)
+    fWindow->fPlaylistLibrary->SmartPlaylists().ItemChanged(*itemToUpdate);
+
   if (fWindow->fLibraryManager) {
     fWindow->fLibraryManager->UpdateActiveItem(*itemToUpdate);
     if (fWindow->fLibraryManager->ContentView())
       fWindow->fLibraryManager->ContentView()->UpdateItem(*itemToUpdate);
   }
 
-  if (fWindow->fMetadataPropertiesWindow)
-    fWindow->fMetadataPropertiesWindow->PostMessage(msg);
+  if (needsFullRefresh)
+    DEBUG_PRINT("View refresh needed for %s\n", itemToUpdate->title.String());
+  return needsFullRefresh;
+}
 
-  if (needsFullRefresh) {
-    DEBUG_PRINT("Scheduling debounced view refresh for %s...\n",
-                itemToUpdate->title.String());
-    delete fWindow->fViewsRefreshRunner;
-    BMessage refresh(MSG_VIEWS_REFRESH);
-    fWindow->fViewsRefreshRunner =
-        new BMessageRunner(BMessenger(fWindow), &refresh, 200000, 1);
-  }
+/**
+ * @brief Rebuilds the views shortly, once for a run of updates.
+ */
+void LibraryController::_ScheduleViewsRefresh() {
+  delete fWindow->fViewsRefreshRunner;
+  BMessage refresh(MSG_VIEWS_REFRESH);
+  fWindow->fViewsRefreshRunner =
+      new BMessageRunner(BMessenger(fWindow), &refresh, 200000, 1);
 }
 
 /**
@@ -551,34 +1063,152 @@ void LibraryController::HandleMediaItemRemoved(BMessage *msg) {
 
   DEBUG_PRINT("remove item: %s\n", path.String());
 
-  MediaTableView *cv = fWindow->fLibraryManager->ContentView();
-  for (int32 i = 0; i < cv->CountRows(); ++i) {
-    const MediaItem *mi = cv->ItemAt(i);
-    if (mi && mi->path == path) {
-      BRow *r = cv->RowAt(i);
-      cv->RemoveRow(r);
-      delete r;
-      break;
-    }
-  }
+  fWindow->fLibraryManager->ContentView()->RemoveEntry(path);
 
-  auto mapIt = fWindow->fPathIndex.find(path);
-  if (mapIt != fWindow->fPathIndex.end()) {
-    fWindow->fAllItems.erase(fWindow->fAllItems.begin() + mapIt->second);
+  size_t index = fWindow->fPathIndex.Find(path);
+  if (index != MediaPathIndex::kNotFound) {
+    std::vector<MediaItem> &allItems = fWindow->fAllItems.Mutable();
+    allItems.erase(allItems.begin() + index);
     RebuildPathIndex();
   }
+  if (fWindow->fPlaylistLibrary) {
+    fWindow->fPlaylistLibrary->SmartPlaylists().ItemRemoved(path);
+    _FlushSmartPlaylists();
+  }
+}
+
+/**
+ * @brief Matches the smart playlists against the whole library again.
+ */
+void LibraryController::_RebuildSmartPlaylists() {
+  if (!fWindow->fPlaylistLibrary)
+    return;
+  fWindow->fPlaylistLibrary->SmartPlaylists().Rebuild(fWindow->fAllItems,
+                                                      &fWindow->fFacetIndex);
+  _FlushSmartPlaylists();
+}
+
+/**
+ * @brief Writes smart playlists whose tracks changed and reloads the one
+ * shown, if it is among them.
+ */
+void LibraryController::_FlushSmartPlaylists() {
+  if (!fWindow->fPlaylistLibrary)
+    return;
+  std::vector<BString> changed;
+  fWindow->fPlaylistLibrary->SmartPlaylists().Flush(&changed);
+  if (!fWindow->IsPlaylistSelected() || !fWindow->fPlaylistSelectionController)
+    return;
+  for (const BString &name : changed) {
+    if (name == fWindow->fCurrentPlaylistName) {
+      fWindow->fPlaylistSelectionController->ShowSelectedPlaylistSource(name);
+      break;
+    }
+  }
 }
 
 /**
  * @brief Rebuilds lookup table from media path to vector index.
  */
 void LibraryController::RebuildPathIndex() {
-  fWindow->fPathIndex.clear();
-  for (size_t i = 0; i < fWindow->fAllItems.size(); ++i) {
-    fWindow->fPathIndex[fWindow->fAllItems[i].path] = i;
+  fWindow->fPathIndex.Rebuild(fWindow->fAllItems.Items());
+  {
+    BAutolock lock(fWindow->fIndexLock);
+    fWindow->fFacetIndex.Rebuild(fWindow->fAllItems.Items());
+  }
+#if ENABLE_DLNA_SERVER
+  if (fWindow->fMediaServer)
+    fWindow->fMediaServer->Publish(fWindow->fAllItems.Snapshot(),
+                                   fWindow->fFacetIndex);
+#endif
+  RebuildSearchIndex();
+}
+
+void LibraryController::RebuildSearchIndex() {
+  if (fWindow->fLibraryManager)
+    fWindow->fLibraryManager->InvalidateFilterCache();
+  if (fSearchIndexBuilding) {
+    fSearchIndexRestart = true;
+    return;
+  }
+
+  {
+    BAutolock lock(fWindow->fIndexLock);
+    fWindow->fSearchIndex.Clear();
+  }
+  fSearchIndexPending.clear();
+
+  // Holding the snapshot makes the window copy it before the next change,
+  // so the worker reads a stable array.
+  BReference<LibrarySnapshot> snapshot(fWindow->fAllItems.Snapshot());
+  if (snapshot.Get() == nullptr || snapshot->Items().empty())
+    return;
+
+  BMessenger target(fWindow);
+  fSearchIndexBuilding = true;
+  BReference<WorkerJob> job = fWindow->QueueJob(
+      kLaneBackground, "search_index", [snapshot, target]() {
+        bigtime_t t0 = system_time();
+        auto *index = new LibrarySearchIndex;
+        index->Rebuild(snapshot->Items());
+        DEBUG_PRINT("Search index: %zu items in %lld us\n", index->Count(),
+                    (long long)(system_time() - t0));
+
+        BMessage ready(MSG_SEARCH_INDEX_READY);
+        ready.AddPointer("index", index);
+        if (target.SendMessage(&ready) != B_OK)
+          delete index;
+      });
+
+  if (job.Get() == nullptr) {
+    fSearchIndexBuilding = false;
+    BAutolock lock(fWindow->fIndexLock);
+    fWindow->fSearchIndex.Rebuild(fWindow->fAllItems.Items());
   }
 }
 
+void LibraryController::HandleSearchIndexReady(BMessage *msg) {
+  LibrarySearchIndex *index = nullptr;
+  if (msg->FindPointer("index", (void **)&index) != B_OK || index == nullptr)
+    return;
+
+  fSearchIndexBuilding = false;
+  if (fSearchIndexRestart) {
+    delete index;
+    fSearchIndexRestart = false;
+    RebuildSearchIndex();
+    return;
+  }
+
+  BAutolock lock(fWindow->fIndexLock);
+  fWindow->fSearchIndex = std::move(*index);
+  delete index;
+
+  const std::vector<MediaItem> &items = fWindow->fAllItems.Items();
+  for (uint32 position : fSearchIndexPending) {
+    if (position < items.size())
+      fWindow->fSearchIndex.Set(position, items[position]);
+  }
+  fSearchIndexPending.clear();
+  lock.Unlock();
+
+  _CheckInteractive();
+}
+
+/**
+ * @brief Applies an item change to the search index, or queues it while the
+ * index is being built. Call with `fIndexLock` held.
+ */
+void LibraryController::_UpdateSearchIndex(size_t position,
+                                           const MediaItem &item) {
+  if (fWindow->fLibraryManager)
+    fWindow->fLibraryManager->InvalidateFilterCache();
+  if (fSearchIndexBuilding)
+    fSearchIndexPending.push_back((uint32)position);
+  else
+    fWindow->fSearchIndex.Set(position, item);
+}
+
 struct TrackerRevealEntry {
   entry_ref fileRef;
   BString   dirPath;
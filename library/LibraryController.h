@@ -1,7 +1,15 @@
 #ifndef BETON_LIBRARY_CONTROLLER_H
 #define BETON_LIBRARY_CONTROLLER_H
 
+#include "RefreshCoalescer.h"
+
 #include <Message.h>
+#include <String.h>
+#include <SupportDefs.h>
+#include <map>
+#include <vector>
+
+struct MediaItem;
 
 class MainWindow;
 
@@ -29,6 +37,11 @@ public:
    */
   void ShowDirectoryManager();
 
+  /**
+   * @brief Opens the duplicate finder over the current library items.
+   */
+  void ShowDuplicateFinder();
+
   /**
    * @brief Reveals one or more files in Tracker.
    * @param msg Message containing `refs` or a nested `files` message with refs.
@@ -42,18 +55,68 @@ public:
    */
   void HandleFileMove(BMessage* msg);
 
+  /**
+   * @brief Moves many files on a worker thread.
+   * @param msg MSG_FILES_MOVE with "from" paths and either a "to" path for
+   * each or a target "directory"; "playlist" and "trash" describe the view
+   * they were moved from.
+   */
+  void HandleFilesMove(BMessage* msg);
+
+  /**
+   * @brief Applies the result of HandleFilesMove() once for the whole batch.
+   * @param msg MSG_FILES_MOVED with the "from"/"to" pairs that were moved.
+   */
+  void HandleFilesMoved(BMessage* msg);
+
   /**
    * @brief Handles initial cache-load completion and refreshes views.
    */
   void HandleCacheLoaded();
 
+  /**
+   * @brief Tracks the startup phases after the cache was loaded.
+   *
+   * Logs time-to-first-row once loaded rows are shown and time-to-interactive
+   * once all rows and the search index are in place; then asks the cache to
+   * validate its entries, the rows on screen first.
+   *
+   * @param rowsComplete True once the content view added its last chunk.
+   */
+  void NoteRowsShown(bool rowsComplete);
+
   /**
    * @brief Starts a full media rescan and clears visible list views.
    */
   void StartFullRescan();
 
   /**
-   * @brief Updates scan progress text from a scan-progress message.
+   * @brief Starts the loudness analysis, or stops the running one.
+   */
+  void ToggleLoudnessScan();
+
+  /**
+   * @brief Shows loudness analysis progress in the status bar.
+   * @param msg `MSG_LOUDNESS_PROGRESS` with "current", "total" and "done".
+   */
+  void UpdateLoudnessProgress(BMessage* msg);
+
+  /**
+   * @brief Starts identifying the library's recordings, or stops the
+   * running identification.
+   */
+  void ToggleAcoustIdScan();
+
+  /**
+   * @brief Shows fingerprinting progress in the status bar.
+   * @param msg `MSG_ACOUSTID_PROGRESS` with "current", "total",
+   * "identified" and "done".
+   */
+  void UpdateAcoustIdProgress(BMessage* msg);
+
+  /**
+   * @brief Updates scan progress text from a scan-progress message and tells
+   * the scanners which rows the user is looking at.
    * @param msg Progress message containing folder/file counters and optional time.
    */
   void UpdateScanProgress(BMessage* msg);
@@ -64,6 +127,24 @@ public:
    */
   void HandleScanDone(BMessage* msg);
 
+  /**
+   * @brief Reports a cache garbage collection pass in the status bar.
+   * @param msg `MSG_CACHE_GC_DONE` with entry counts and file sizes.
+   */
+  void HandleCacheCollected(BMessage* msg);
+
+  /**
+   * @brief Asks whether to create the attribute indexes a source volume
+   * lacks; the answer goes back to the cache.
+   * @param msg `MSG_BFS_INDEXES_MISSING` with the volume and attributes.
+   */
+  void HandleBfsIndexesMissing(BMessage* msg);
+
+  /**
+   * @brief Pauses or resumes all library scans (File menu).
+   */
+  void ToggleScanPause();
+
   /**
    * @brief Processes a cache-loading batch timer tick.
    */
@@ -76,16 +157,30 @@ public:
   void HandleMediaBatch(BMessage* msg);
 
   /**
-   * @brief Performs a debounced partial refresh of filtered list views.
+   * @brief Performs a coalesced partial refresh of filtered list views.
+   *
+   * Adds the rows collected since the last refresh in one go. While the
+   * window is hidden or minimized nothing is done until it is activated.
    */
   void RefreshPartialViews();
 
+  /** @brief Runs a refresh that was skipped while the window was hidden. */
+  void ResumeDeferredRefresh();
+
   /**
    * @brief Applies an incremental single-item metadata update.
    * @param msg Message containing item path and updated fields.
    */
   void HandleMediaItemFound(BMessage* msg);
 
+  /**
+   * @brief Applies the "item" updates of a `MSG_MEDIA_ITEMS_UPDATED`.
+   *
+   * Views are refreshed and the properties window is told once for the
+   * whole message.
+   */
+  void HandleMediaItemsUpdated(BMessage* msg);
+
   /**
    * @brief Removes a media item from views and in-memory index.
    * @param msg Message containing the item path.
@@ -94,12 +189,63 @@ public:
 
   /**
    * @brief Rebuilds the path-to-index lookup for `fAllItems`.
+   *
+   * Also rebuilds the facet index and starts a search index rebuild, since
+   * both are keyed by the same positions.
    */
   void RebuildPathIndex();
 
+  /**
+   * @brief Rebuilds the search index for `fAllItems` on a worker thread.
+   *
+   * Until the result arrives the filter box falls back to scanning all
+   * items. Requests made while a build is running restart it once it ends.
+   */
+  void RebuildSearchIndex();
+
+  /**
+   * @brief Adopts a search index built by RebuildSearchIndex().
+   * @param msg Message with the "index" pointer.
+   */
+  void HandleSearchIndexReady(BMessage* msg);
+
 private:
+  /** @brief Applies one item update; true if the views need a rebuild. */
+  bool _ApplyMediaItem(BMessage* msg);
+  void _ScheduleViewsRefresh();
+  void _ApplyFileMoves(const std::map<BString, BString>& moves);
+  void _RebuildSmartPlaylists();
+  void _FlushSmartPlaylists();
+  void _UpdateSearchIndex(size_t position, const MediaItem& item);
+  void _CheckInteractive();
+  void _SendScanPriority();
+
   /** @brief Owning main window and shared state access. */
   MainWindow* fWindow;
+
+  /** @name Search Index Build */
+  ///@{
+  bool fSearchIndexBuilding;
+  bool fSearchIndexRestart;         ///< Items were removed during the build
+  std::vector<uint32> fSearchIndexPending; ///< Positions changed meanwhile
+  ///@}
+
+  /** @name Incremental Refresh */
+  ///@{
+  RefreshCoalescer fPartialRefresh;
+  std::vector<BString> fPendingAdditions; ///< New paths not yet shown
+  bool fRefreshDeferred;                  ///< Skipped while hidden
+  ///@}
+
+  /** @brief Visible and selected paths last sent as scan priority. */
+  std::vector<BString> fScanPriority;
+
+  /** @name Startup Timing */
+  ///@{
+  bool fFirstRowShown;
+  bool fRowsComplete;
+  bool fStartupDone; ///< Interactive reported, validation requested
+  ///@}
 };
 
 #endif // BETON_LIBRARY_CONTROLLER_H
@@ -0,0 +1,139 @@
+#include "LibraryFacetIndex.h"
+
+#include <algorithm>
+#include <cctype>
+#include <string>
+
+/**
+ * @brief Normalizes album/artist key parts for stable deduplication.
+ *
+ * Trims, lowercases, and collapses whitespace to single spaces.
+ */
+static BString
+NormalizeAlbumKeyPart(const BString &value)
+{
+  std::string normalized;
+  normalized.reserve(value.Length());
+
+  bool previousWasSpace = true;
+  const char *raw = value.String();
+  for (int32 i = 0; i < value.Length(); ++i) {
+    unsigned char c = (unsigned char)raw[i];
+    if (std::isspace(c)) {
+      if (!previousWasSpace) {
+        normalized.push_back(' ');
+        previousWasSpace = true;
+      }
+      continue;
+    }
+    normalized.push_back((char)std::tolower(c));
+    previousWasSpace = false;
+  }
+
+  if (!normalized.empty() && normalized.back() == ' ')
+    normalized.pop_back();
+
+  return BString(normalized.c_str());
+}
+
+BString LibraryFacetIndex::AlbumIdentity(const MediaItem &item,
+                                         bool radioMode) {
+  if (radioMode)
+    return item.album;
+
+  if (!item.mbAlbumId.IsEmpty()) {
+    BString key("mb:");
+    key << item.mbAlbumId;
+    return key;
+  }
+
+  BString albumArtist = item.albumArtist;
+  if (albumArtist.IsEmpty())
+    albumArtist = item.artist;
+
+  BString key("meta:");
+  key << NormalizeAlbumKeyPart(albumArtist) << "|"
+      << NormalizeAlbumKeyPart(item.album) << "|" << item.year;
+  return key;
+}
+
+bool LibraryFacetIndex::AlbumKey::operator<(const AlbumKey &other) const {
+  int cmp = album.Compare(other.album);
+  if (cmp != 0)
+    return cmp < 0;
+  cmp = identity.Compare(other.identity);
+  if (cmp != 0)
+    return cmp < 0;
+  return year < other.year;
+}
+
+LibraryFacetIndex::LibraryFacetIndex() : fCount(0) {}
+
+void LibraryFacetIndex::Clear() {
+  fGenres.clear();
+  fCount = 0;
+}
+
+void LibraryFacetIndex::Rebuild(const std::vector<MediaItem> &items) {
+  Clear();
+  for (size_t i = 0; i < items.size(); i++)
+    Add(i, items[i]);
+}
+
+void LibraryFacetIndex::Add(size_t position, const MediaItem &item) {
+  AlbumKey key{item.album, AlbumIdentity(item, false), item.year};
+  Postings &postings = fGenres[item.genre][item.artist][key];
+  // Positions arrive in ascending order except for updates; keep lists
+  // sorted so intersections and merges stay linear.
+  if (postings.empty() || postings.back() < position)
+    postings.push_back((uint32)position);
+  else
+    postings.insert(
+        std::lower_bound(postings.begin(), postings.end(), (uint32)position),
+        (uint32)position);
+  fCount++;
+}
+
+void LibraryFacetIndex::Update(size_t position, const MediaItem &before,
+                               const MediaItem &after) {
+  if (_SameFacets(before, after))
+    return;
+  _Remove(position, before);
+  Add(position, after);
+}
+
+bool LibraryFacetIndex::_SameFacets(const MediaItem &a, const MediaItem &b) {
+  return a.genre == b.genre && a.artist == b.artist && a.album == b.album &&
+         a.year == b.year && a.albumArtist == b.albumArtist &&
+         a.mbAlbumId == b.mbAlbumId;
+}
+
+void LibraryFacetIndex::_Remove(size_t position, const MediaItem &item) {
+  auto genre = fGenres.find(item.genre);
+  if (genre == fGenres.end())
+    return;
+  auto artist = genre->second.find(item.artist);
+  if (artist == genre->second.end())
+    return;
+  AlbumKey key{item.album, AlbumIdentity(item, false), item.year};
+  auto album = artist->second.find(key);
+  if (album == artist->second.end())
+    return;
+
+  Postings &postings = album->second;
+  auto it = std::lower_bound(postings.begin(), postings.end(),
+                             (uint32)position);
+  if (it == postings.end() || *it != position)
+    return;
+  postings.erase(it);
+  fCount--;
+
+  if (postings.empty()) {
+    artist->second.erase(album);
+    if (artist->second.empty()) {
+      genre->second.erase(artist);
+      if (genre->second.empty())
+        fGenres.erase(genre);
+    }
+  }
+}
@@ -0,0 +1,81 @@
+#ifndef BETON_LIBRARY_FACET_INDEX_H
+#define BETON_LIBRARY_FACET_INDEX_H
+
+#include "MediaItem.h"
+
+#include <String.h>
+#include <SupportDefs.h>
+#include <map>
+#include <vector>
+
+/**
+ * @class LibraryFacetIndex
+ * @brief Genre -> artist -> album index over the library item array.
+ *
+ * Every (genre, artist, album) combination holds a posting list with the
+ * positions of its tracks in the item array, so the column browser can list
+ * filter values and collect matching tracks without touching unrelated
+ * items. The number of tracks of a combination is the size of its list.
+ *
+ * Positions refer to the vector the index was built from. Appending and
+ * changing items is applied incrementally; removals shift positions and
+ * require Rebuild().
+ */
+class LibraryFacetIndex {
+public:
+  /** @brief Album cell below one (genre, artist) pair. */
+  struct AlbumKey {
+    BString album;    ///< Album name as tagged (may be empty)
+    BString identity; ///< See AlbumIdentity()
+    int32 year;
+
+    bool operator<(const AlbumKey &other) const;
+  };
+
+  typedef std::vector<uint32> Postings;
+  typedef std::map<AlbumKey, Postings> AlbumMap;
+  typedef std::map<BString, AlbumMap> ArtistMap;
+  typedef std::map<BString, ArtistMap> GenreMap;
+
+  LibraryFacetIndex();
+
+  /** @brief Replaces the index with the contents of `items`. */
+  void Rebuild(const std::vector<MediaItem> &items);
+
+  /** @brief Removes everything. */
+  void Clear();
+
+  /** @brief Number of indexed positions. */
+  size_t Count() const { return fCount; }
+
+  /** @brief Indexes `item` stored at `position`. */
+  void Add(size_t position, const MediaItem &item);
+
+  /**
+   * @brief Moves the item at `position` from the cell of `before` to the cell
+   * of `after`. Does nothing if none of the indexed fields changed.
+   */
+  void Update(size_t position, const MediaItem &before,
+              const MediaItem &after);
+
+  /** @brief Genre -> artist -> album cells ("" = untagged). */
+  const GenreMap &Genres() const { return fGenres; }
+
+  /**
+   * @brief Builds a stable album identity key for filtering/disambiguation.
+   *
+   * Uses the MusicBrainz release ID when present, otherwise the normalized
+   * album artist (or artist), album name and year. In radio mode the album
+   * name is used as is.
+   */
+  static BString AlbumIdentity(const MediaItem &item, bool radioMode);
+
+private:
+  static bool _SameFacets(const MediaItem &a, const MediaItem &b);
+  void _Remove(size_t position, const MediaItem &item);
+
+  GenreMap fGenres;
+  size_t fCount;
+};
+
+#endif // BETON_LIBRARY_FACET_INDEX_H
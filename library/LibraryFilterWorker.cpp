@@ -0,0 +1,453 @@
+#include "LibraryFilterWorker.h"
+#include "Debug.h"
+#include "LibraryFacetIndex.h"
+#include "LibrarySearchIndex.h"
+#include "MediaEntryStore.h"
+#include "MediaTableView.h"
+#include "Messages.h"
+#include "ParallelAlgorithms.h"
+#include "StringPool.h"
+#include "Trace.h"
+
+#include <Entry.h>
+#include <OS.h>
+#include <Path.h>
+#include <algorithm>
+#include <unordered_map>
+
+/** @brief Items between two checks whether a job became stale. */
+static const size_t kStaleCheckInterval = 4096;
+
+static const std::vector<MediaItem> kNoItems;
+
+const std::vector<MediaItem> &LibraryFilterJob::SourceItems() const {
+  if (snapshot.Get() != nullptr)
+    return snapshot->Items();
+  return items != nullptr ? *items : kNoItems;
+}
+
+LibraryFilterWorker::LibraryFilterWorker(const BMessenger &target)
+    : BLooper("LibraryFilterWorker", B_NORMAL_PRIORITY), fTarget(target),
+      fGeneration(0), fTextCacheInvalid(false), fLastGeneration(0) {}
+
+LibraryFilterWorker::~LibraryFilterWorker() {}
+
+int32 LibraryFilterWorker::Submit(LibraryFilterJob *job) {
+  job->generation = fGeneration.fetch_add(1) + 1;
+
+  BMessage request(MSG_FILTER_REQUEST);
+  request.AddPointer("job", job);
+  if (PostMessage(&request) != B_OK) {
+    delete job;
+    return fGeneration.load();
+  }
+  return job->generation;
+}
+
+int32 LibraryFilterWorker::Cancel() { return fGeneration.fetch_add(1) + 1; }
+
+bool LibraryFilterWorker::_IsStale(const LibraryFilterJob &job) const {
+  return job.generation != fGeneration.load(std::memory_order_relaxed);
+}
+
+void LibraryFilterWorker::MessageReceived(BMessage *msg) {
+  switch (msg->what) {
+  case MSG_FILTER_REQUEST: {
+    LibraryFilterJob *job = nullptr;
+    if (msg->FindPointer("job", (void **)&job) != B_OK || job == nullptr)
+      break;
+
+    bool finished = !_IsStale(*job) && Compute(*job, this);
+    // Release the snapshot here so the window can change its items without
+    // copying them while the result is queued.
+    job->snapshot.Unset();
+    if (!finished) {
+      delete job;
+      break;
+    }
+
+    BMessage result(MSG_FILTER_RESULT);
+    result.AddPointer("job", job);
+    if (fTarget.SendMessage(&result) != B_OK)
+      delete job;
+    break;
+  }
+
+  default:
+    BLooper::MessageReceived(msg);
+  }
+}
+
+/**
+ * @brief The filter pass formerly run inline by UpdateFilteredViews().
+ *
+ * 1. Resolve the playlist scope (non-library mode).
+ * 2. Collect text matches (search index, previous matches or a scan).
+ * 3. Populate the genre/artist/album sets.
+ * 4. Build and sort the final content list.
+ */
+bool LibraryFilterWorker::Compute(LibraryFilterJob &job,
+                                  LibraryFilterWorker *worker) {
+  bigtime_t t0 = system_time();
+  const std::vector<MediaItem> &allItems = job.SourceItems();
+  TRACE_SCOPE(kTraceFilter, "filter", (int64)allItems.size());
+
+  auto stale = [&]() { return worker != nullptr && worker->_IsStale(job); };
+
+  /// 1. Filter Source Items based on Library/Playlist Mode
+  std::vector<MediaItem> playlistItems;
+
+  if (!job.isLibraryMode) {
+    if (job.activeItems != nullptr && !job.activeItems->empty()) {
+      playlistItems = *job.activeItems;
+    } else if (job.activePaths != nullptr) {
+      /// Fallback: Build items from paths (e.g. from a loaded .m3u)
+      const std::vector<BString> &activePaths = *job.activePaths;
+      playlistItems.reserve(activePaths.size());
+
+      /// The window's path index is over the same items; without it, build
+      /// a map for O(1) lookup in allItems.
+      const MediaPathIndex *pathIndex = job.pathIndex;
+      std::unordered_map<std::string, size_t> pathMap;
+      if (pathIndex == nullptr) {
+        pathMap.reserve(allItems.size());
+        for (size_t i = 0; i < allItems.size(); ++i) {
+          pathMap[allItems[i].path.String()] = i;
+        }
+      }
+      auto find = [&](const BString &p) -> size_t {
+        if (pathIndex != nullptr) {
+          size_t position = pathIndex->Find(p);
+          return position < allItems.size() ? position
+                                             : MediaPathIndex::kNotFound;
+        }
+        auto it = pathMap.find(p.String());
+        return it != pathMap.end() ? it->second : MediaPathIndex::kNotFound;
+      };
+
+      for (const auto &p : activePaths) {
+        size_t position = find(p);
+        if (position != MediaPathIndex::kNotFound) {
+          playlistItems.push_back(allItems[position]);
+        } else {
+          MediaItem mi;
+          mi.path = p;
+
+          BPath bp(p.String());
+          mi.title = bp.Leaf() ? bp.Leaf() : p.String();
+
+          BEntry e(bp.Path());
+          mi.missing = !e.Exists();
+          playlistItems.push_back(mi);
+        }
+      }
+    }
+  }
+
+  const std::vector<MediaItem> &sourceItems =
+      job.isLibraryMode ? allItems : playlistItems;
+  job.sourceCount = sourceItems.size();
+
+  /// The indexes are shared with the window thread, which updates them
+  /// while holding indexLock. It is held only while they are read, so the
+  /// window never waits on the item scans, totals or sort below.
+  struct IndexGuard {
+    BLocker *lock;
+    bool locked;
+    explicit IndexGuard(BLocker *l) : lock(l), locked(false) {}
+    ~IndexGuard() { Unlock(); }
+    void Lock() {
+      if (lock != nullptr && !locked)
+        locked = lock->Lock();
+    }
+    void Unlock() {
+      if (locked)
+        lock->Unlock();
+      locked = false;
+    }
+  } guard(job.indexLock);
+
+  const LibraryFacetIndex *facets = job.facets;
+  const LibrarySearchIndex *search = job.search;
+
+  /// -- Filter Lambdas --
+  /// Selections are interned by the caller so the per-item checks compare
+  /// buffers first.
+  auto genreOK = [&](const MediaItem &i) {
+    if (job.anyGenre)
+      return true;
+    if (job.noGenre)
+      return i.genre.IsEmpty();
+    return StringPool::Equals(i.genre, job.genre);
+  };
+
+  auto artistOK = [&](const MediaItem &i) {
+    if (job.anyArtist)
+      return true;
+    if (job.noArtist)
+      return i.artist.IsEmpty();
+    return StringPool::Equals(i.artist, job.artist);
+  };
+
+  auto albumOK = [&](const MediaItem &i) {
+    if (job.anyAlbum)
+      return true;
+    if (job.noAlbum)
+      return i.album.IsEmpty();
+
+    /// Check against hidden data if available
+    if (!job.albumData.IsEmpty()) {
+      if (LibraryFacetIndex::AlbumIdentity(i, job.radioFilterMode) ==
+          job.albumData)
+        return true;
+
+      BString legacyData = i.album;
+      legacyData << "|" << i.year << "|" << i.base;
+      return legacyData == job.albumData;
+    }
+
+    /// Standard album name match
+    return StringPool::Equals(i.album, job.album);
+  };
+
+  /// 2. Text matches are positions in sourceItems. They come from the search
+  /// index when it covers the items; otherwise every item is folded and
+  /// checked the same way. A query containing the previous one can only
+  /// narrow its result, so then just the previous matches are re-checked.
+  const std::string foldedFilter = LibrarySearchIndex::Fold(job.filterText);
+  const bool hasText = !foldedFilter.empty();
+  guard.Lock();
+  const bool useSearch = search != nullptr && job.isLibraryMode &&
+                         search->Count() == sourceItems.size();
+  if (!hasText || !useSearch)
+    guard.Unlock();
+  TextCache *cache = (worker != nullptr && search != nullptr &&
+                      job.isLibraryMode)
+                         ? &worker->fTextCache
+                         : nullptr;
+  if (cache != nullptr && worker->fTextCacheInvalid.exchange(false))
+    cache->valid = false;
+
+  std::vector<uint32> textMatches;
+
+  if (hasText) {
+    auto matchesAt = [&](size_t position) {
+      return useSearch ? search->Contains(position, foldedFilter)
+                       : LibrarySearchIndex::Matches(sourceItems[position],
+                                                     foldedFilter);
+    };
+
+    const bool narrowing =
+        cache != nullptr && cache->valid &&
+        cache->source == sourceItems.data() &&
+        cache->count == sourceItems.size() &&
+        foldedFilter.find(cache->folded) != std::string::npos;
+
+    if (narrowing && foldedFilter == cache->folded) {
+      textMatches = cache->matches;
+    } else if (narrowing) {
+      for (uint32 position : cache->matches) {
+        if (matchesAt(position))
+          textMatches.push_back(position);
+      }
+    } else if (useSearch) {
+      search->Search(job.filterText, textMatches);
+    } else {
+      ParallelAlgorithms::FilterPositions(sourceItems.size(), matchesAt,
+                                          textMatches);
+      if (stale())
+        return false;
+    }
+
+    if (cache != nullptr) {
+      cache->folded = foldedFilter;
+      cache->matches = textMatches;
+      cache->source = sourceItems.data();
+      cache->count = sourceItems.size();
+      cache->valid = true;
+    }
+  }
+  guard.Unlock();
+
+  auto forEachTextMatch = [&](auto &&visit) {
+    size_t visited = 0;
+    if (hasText) {
+      for (uint32 position : textMatches) {
+        if (++visited % kStaleCheckInterval == 0 && stale())
+          return false;
+        visit(sourceItems[position]);
+      }
+      return true;
+    }
+    for (const auto &it : sourceItems) {
+      if (++visited % kStaleCheckInterval == 0 && stale())
+        return false;
+      visit(it);
+    }
+    return true;
+  };
+
+  std::vector<MediaItem> &finalItems = job.finalItems;
+  finalItems.clear();
+  /// Positions of finalItems in sourceItems, before sorting.
+  std::vector<uint32> positions;
+
+  /// Without a search term the facet index answers steps 3 and 4 from the
+  /// (genre, artist, album) cells in scope instead of scanning every item.
+  guard.Lock();
+  const bool useFacets = facets != nullptr && job.isLibraryMode && !hasText &&
+                         !job.radioFilterMode &&
+                         facets->Count() == sourceItems.size();
+
+  if (useFacets) {
+    for (const auto &genre : facets->Genres()) {
+      if (genre.first.IsEmpty())
+        job.untaggedGenre = true;
+      else
+        job.genres.insert(genre.first);
+
+      if (!job.anyGenre &&
+          (job.noGenre ? !genre.first.IsEmpty()
+                       : !StringPool::Equals(genre.first, job.genre)))
+        continue;
+
+      for (const auto &artist : genre.second) {
+        if (artist.first.IsEmpty())
+          job.untaggedArtist = true;
+        else
+          job.artists.insert(artist.first);
+
+        if (!job.anyArtist &&
+            (job.noArtist ? !artist.first.IsEmpty()
+                          : !StringPool::Equals(artist.first, job.artist)))
+          continue;
+
+        for (const auto &album : artist.second) {
+          if (album.first.album.IsEmpty())
+            job.untaggedAlbum = true;
+          else
+            job.albums[album.first.album].insert(
+                {album.first.year, album.first.identity});
+
+          for (uint32 position : album.second) {
+            if (job.anyAlbum || albumOK(sourceItems[position]))
+              positions.push_back(position);
+          }
+        }
+      }
+    }
+    guard.Unlock();
+
+    /// Keep library order, as the scan below would.
+    std::sort(positions.begin(), positions.end());
+    finalItems.reserve(positions.size());
+    for (uint32 position : positions)
+      finalItems.push_back(sourceItems[position]);
+  } else {
+    guard.Unlock();
+
+    /// 3. Populate Filter Lists (Genre, Artist, Album)
+    /// Neighbouring items usually share genre/artist; skip the set insert
+    /// (and its string compares) when the interned value repeats.
+    BString lastGenre, lastArtist;
+    bool complete = forEachTextMatch([&](const MediaItem &it) {
+      if (it.genre.IsEmpty())
+        job.untaggedGenre = true;
+      else if (!StringPool::Equals(it.genre, lastGenre)) {
+        job.genres.insert(it.genre);
+        lastGenre = it.genre;
+      }
+
+      if (genreOK(it)) {
+        if (it.artist.IsEmpty())
+          job.untaggedArtist = true;
+        else if (!StringPool::Equals(it.artist, lastArtist)) {
+          job.artists.insert(it.artist);
+          lastArtist = it.artist;
+        }
+
+        if (artistOK(it)) {
+          if (it.album.IsEmpty())
+            job.untaggedAlbum = true;
+          else {
+            job.albums[it.album].insert(
+                {it.year,
+                 LibraryFacetIndex::AlbumIdentity(it, job.radioFilterMode)});
+          }
+        }
+      }
+    });
+    if (!complete)
+      return false;
+
+    /// 4. Build Final Content List. The checks only read the job, so large
+    /// lists are filtered in parallel chunks.
+    auto candidateAt = [&](size_t i) -> const MediaItem & {
+      return hasText ? sourceItems[textMatches[i]] : sourceItems[i];
+    };
+
+    std::vector<uint32> kept;
+    ParallelAlgorithms::FilterPositions(
+        hasText ? textMatches.size() : sourceItems.size(),
+        [&](size_t i) {
+          const MediaItem &it = candidateAt(i);
+          return genreOK(it) && artistOK(it) && albumOK(it);
+        },
+        kept);
+    if (stale())
+      return false;
+
+    finalItems.reserve(kept.size());
+    for (uint32 i : kept)
+      finalItems.push_back(candidateAt(i));
+    if (hasText) {
+      positions.reserve(kept.size());
+      for (uint32 i : kept)
+        positions.push_back(textMatches[i]);
+    } else {
+      positions = std::move(kept);
+    }
+  }
+
+  /// Library totals come from the snapshot's columns; playlist items are
+  /// copies without them.
+  LibraryTotals totals;
+  if (job.isLibraryMode && job.snapshot.Get() != nullptr) {
+    totals = job.snapshot->Columns().Totals(positions);
+  } else {
+    totals.count = (int32)finalItems.size();
+    for (const auto &it : finalItems) {
+      totals.duration += it.duration;
+      totals.size += it.size;
+    }
+  }
+  job.totalCount = totals.count;
+  job.totalDuration = totals.duration;
+  job.totalSize = totals.size;
+
+  /// Compare with what the window shows, so an unchanged list (e.g. the
+  /// same matches after another keystroke) is not rebuilt.
+  if (worker != nullptr && job.updateContentList) {
+    std::vector<BString> paths;
+    paths.reserve(finalItems.size());
+    for (const auto &it : finalItems)
+      paths.push_back(it.path);
+
+    job.contentUnchanged = job.shownGeneration == worker->fLastGeneration &&
+                           job.shownRows == job.totalCount &&
+                           paths == worker->fLastPaths;
+    worker->fLastPaths.swap(paths);
+    worker->fLastGeneration = job.generation;
+  }
+
+  if (stale())
+    return false;
+
+  if (job.contentUnchanged)
+    finalItems.clear();
+  else if (job.updateContentList)
+    MediaTableView::SortItems(finalItems, job.sortState, job.playlistSort);
+
+  job.filterTime = system_time() - t0;
+  return true;
+}
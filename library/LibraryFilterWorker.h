@@ -0,0 +1,180 @@
+#ifndef BETON_LIBRARY_FILTER_WORKER_H
+#define BETON_LIBRARY_FILTER_WORKER_H
+
+#include "LibrarySnapshot.h"
+#include "MediaItem.h"
+
+#include <Locker.h>
+#include <Looper.h>
+#include <Message.h>
+#include <Messenger.h>
+#include <String.h>
+#include <SupportDefs.h>
+#include <atomic>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+class LibraryFacetIndex;
+class LibrarySearchIndex;
+class MediaPathIndex;
+
+/**
+ * @struct LibraryFilterJob
+ * @brief Inputs and results of one column browser filter pass.
+ *
+ * Filled on the window thread, computed by `LibraryFilterWorker::Compute()`
+ * (on the worker or inline) and applied by `LibraryBrowserController`. Only
+ * the compute step reads the input section; only the apply step reads the
+ * result section.
+ */
+struct LibraryFilterJob {
+  /** @brief Album cell of the album column ("" identity = no data). */
+  struct AlbumKey {
+    int32 year;
+    BString identity;
+    bool operator<(const AlbumKey &o) const {
+      if (identity == o.identity)
+        return false;
+      if (year != o.year)
+        return year < o.year;
+      return identity.Compare(o.identity) < 0;
+    }
+  };
+
+  int32 generation = 0;
+
+  /**
+   * @name Source
+   * Jobs sent to the worker read the shared snapshot only; the borrowed
+   * vectors are for jobs computed inline on the window thread.
+   */
+  ///@{
+  BReference<LibrarySnapshot> snapshot;             ///< Library items
+  const std::vector<MediaItem> *items = nullptr;    ///< Borrowed items
+  bool isLibraryMode = true;
+  const std::vector<MediaItem> *activeItems = nullptr; ///< Playlist scope
+  const std::vector<BString> *activePaths = nullptr;   ///< If no activeItems
+  const MediaPathIndex *pathIndex = nullptr; ///< Over `items`, inline only
+  const LibraryFacetIndex *facets = nullptr;
+  const LibrarySearchIndex *search = nullptr;
+  BLocker *indexLock = nullptr; ///< Guards facets and search
+  uint64 sourceStamp = 0;       ///< Identifies the items, for the view cache
+  bool libraryItems = false;    ///< Source is the library (or a playlist)
+  ///@}
+
+  /** @name Selection */
+  ///@{
+  BString context;
+  BString filterText;
+  BString genre, artist, album, albumData;
+  bool anyGenre = true, noGenre = false;
+  bool anyArtist = true, noArtist = false;
+  bool anyAlbum = true, noAlbum = false;
+  bool radioFilterMode = false;
+  bool restoreFilters = false;
+  ///@}
+
+  /** @name Content */
+  ///@{
+  bool updateContentList = true;
+  bool preserveScroll = false;
+  bool playlistSort = false;
+  BMessage sortState; ///< Sort order the content list will use
+  /** @brief Generation and row count of the content shown at submit time. */
+  int32 shownGeneration = 0;
+  int32 shownRows = -1;
+  ///@}
+
+  /** @name Result */
+  ///@{
+  std::vector<MediaItem> finalItems; ///< Sorted by `sortState`
+  bool contentUnchanged = false;     ///< Shown content already matches
+  int32 totalCount = 0;
+  int64 totalDuration = 0;
+  int64 totalSize = 0;
+  size_t sourceCount = 0;
+  std::set<BString> genres;
+  bool untaggedGenre = false;
+  std::set<BString> artists;
+  bool untaggedArtist = false;
+  std::map<BString, std::set<AlbumKey>> albums;
+  bool untaggedAlbum = false;
+  bigtime_t filterTime = 0;
+  ///@}
+
+  /** @brief Items the filter runs on (snapshot or borrowed vector). */
+  const std::vector<MediaItem> &SourceItems() const;
+};
+
+/**
+ * @class LibraryFilterWorker
+ * @brief Runs column browser filter passes off the window thread.
+ *
+ * Every Submit() gets a new generation number. A job whose generation is no
+ * longer current when it is picked up, or while it runs, is dropped, so a
+ * burst of keystrokes only computes the last query. Finished jobs are sent
+ * back to the target as `MSG_FILTER_RESULT` with a "job" pointer.
+ *
+ * The worker also keeps the text matches of the previous library query, so a
+ * query that only narrows it re-checks just those items.
+ */
+class LibraryFilterWorker : public BLooper {
+public:
+  explicit LibraryFilterWorker(const BMessenger &target);
+  ~LibraryFilterWorker() override;
+
+  void MessageReceived(BMessage *msg) override;
+
+  /**
+   * @brief Queues `job` with a new generation; takes ownership.
+   * @return The job's generation.
+   */
+  int32 Submit(LibraryFilterJob *job);
+
+  /**
+   * @brief Makes all queued and running jobs stale.
+   * @return The new current generation.
+   */
+  int32 Cancel();
+
+  /** @brief Generation of the most recent Submit() or Cancel(). */
+  int32 Generation() const { return fGeneration.load(); }
+
+  /** @brief Drops the remembered text matches (call when items change). */
+  void InvalidateTextCache() { fTextCacheInvalid.store(true); }
+
+  /**
+   * @brief Filters and sorts `job`'s items.
+   *
+   * @param job Job to compute; the result section is filled.
+   * @param worker Worker whose generation and text cache to use, or
+   * `nullptr` to compute inline without either.
+   * @return `false` if the job became stale and was abandoned.
+   */
+  static bool Compute(LibraryFilterJob &job, LibraryFilterWorker *worker);
+
+private:
+  /** @brief Text matches of the previous library query. */
+  struct TextCache {
+    bool valid = false;
+    std::string folded;           ///< Folded filter text
+    std::vector<uint32> matches;  ///< Positions in the source items
+    const MediaItem *source = nullptr;
+    size_t count = 0;
+  };
+
+  bool _IsStale(const LibraryFilterJob &job) const;
+
+  BMessenger fTarget;
+  std::atomic<int32> fGeneration;
+  std::atomic<bool> fTextCacheInvalid;
+  TextCache fTextCache;
+
+  /** @brief Final paths of the last finished job, before sorting. */
+  std::vector<BString> fLastPaths;
+  int32 fLastGeneration;
+};
+
+#endif // BETON_LIBRARY_FILTER_WORKER_H
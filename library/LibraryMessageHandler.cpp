@@ -5,6 +5,7 @@
 #include "PlaylistEditController.h"
 #include "Messages.h"
 #include "PlaylistSelectionController.h"
+#include "StartupSequence.h"
 
 #include <Message.h>
 
@@ -17,7 +18,14 @@ bool LibraryMessageHandler::HandleMessage(BMessage *msg) {
 
   switch (msg->what) {
   case MSG_CACHE_LOADED: {
+    // The library view restores its columns and sorting with the settings.
+    if (fWindow->fStartup &&
+        fWindow->fStartup->DeferUntil(fWindow->fStartupSettingsTask, msg)) {
+      break;
+    }
     fWindow->fLibraryController->HandleCacheLoaded();
+    if (fWindow->fStartup)
+      fWindow->fStartup->Complete(fWindow->fStartupCacheTask);
     break;
   }
 
@@ -36,11 +44,31 @@ bool LibraryMessageHandler::HandleMessage(BMessage *msg) {
     break;
   }
 
+  case MSG_LOUDNESS_PROGRESS: {
+    fWindow->fLibraryController->UpdateLoudnessProgress(msg);
+    break;
+  }
+
+  case MSG_ACOUSTID_PROGRESS: {
+    fWindow->fLibraryController->UpdateAcoustIdProgress(msg);
+    break;
+  }
+
   case MSG_SCAN_DONE: {
     fWindow->fLibraryController->HandleScanDone(msg);
     break;
   }
 
+  case MSG_CACHE_GC_DONE: {
+    fWindow->fLibraryController->HandleCacheCollected(msg);
+    break;
+  }
+
+  case MSG_BFS_INDEXES_MISSING: {
+    fWindow->fLibraryController->HandleBfsIndexesMissing(msg);
+    break;
+  }
+
   case MSG_BATCH_TIMER: {
     fWindow->fLibraryController->HandleBatchTimer();
     break;
@@ -61,6 +89,21 @@ bool LibraryMessageHandler::HandleMessage(BMessage *msg) {
     break;
   }
 
+  case MSG_MEDIA_ITEMS_UPDATED: {
+    fWindow->fLibraryController->HandleMediaItemsUpdated(msg);
+    break;
+  }
+
+  case MSG_FILTER_RESULT: {
+    fWindow->fLibraryManager->HandleFilterResult(msg);
+    break;
+  }
+
+  case MSG_SEARCH_INDEX_READY: {
+    fWindow->fLibraryController->HandleSearchIndexReady(msg);
+    break;
+  }
+
   case MSG_MEDIA_ITEM_REMOVED: {
     fWindow->fLibraryController->HandleMediaItemRemoved(msg);
     break;
@@ -71,6 +114,16 @@ bool LibraryMessageHandler::HandleMessage(BMessage *msg) {
     break;
   }
 
+  case MSG_FILES_MOVE: {
+    fWindow->fLibraryController->HandleFilesMove(msg);
+    break;
+  }
+
+  case MSG_FILES_MOVED: {
+    fWindow->fLibraryController->HandleFilesMoved(msg);
+    break;
+  }
+
   case MSG_PLAYLIST_SELECTION:
   case MSG_INIT_LIBRARY: {
     if (fWindow->fPlaylistSelectionController)
@@ -0,0 +1,274 @@
+#include "LibrarySearchIndex.h"
+
+#include <UnicodeChar.h>
+
+#include <algorithm>
+#include <iterator>
+
+/**
+ * @brief Base letters for U+0100..U+017F (Latin Extended-A).
+ *
+ * '?' marks the ligatures handled separately in AppendFolded().
+ */
+static const char kLatinExtendedA[] =
+    "aaaaaa"       // U+0100 Ā ā Ă ă Ą ą
+    "cccccccc"     // U+0106 Ć ć Ĉ ĉ Ċ ċ Č č
+    "dddd"         // U+010E Ď ď Đ đ
+    "eeeeeeeeee"   // U+0112 Ē ē Ĕ ĕ Ė ė Ę ę Ě ě
+    "gggggggg"     // U+011C Ĝ ĝ Ğ ğ Ġ ġ Ģ ģ
+    "hhhh"         // U+0124 Ĥ ĥ Ħ ħ
+    "iiiiiiiiii"   // U+0128 Ĩ ĩ Ī ī Ĭ ĭ Į į İ ı
+    "??"           // U+0132 Ĳ ĳ
+    "jj"           // U+0134 Ĵ ĵ
+    "kkk"          // U+0136 Ķ ķ ĸ
+    "llllllllll"   // U+0139 Ĺ ĺ Ļ ļ Ľ ľ Ŀ ŀ Ł ł
+    "nnnnnnnnn"    // U+0143 Ń ń Ņ ņ Ň ň ŉ Ŋ ŋ
+    "oooooo"       // U+014C Ō ō Ŏ ŏ Ő ő
+    "??"           // U+0152 Œ œ
+    "rrrrrr"       // U+0154 Ŕ ŕ Ŗ ŗ Ř ř
+    "ssssssss"     // U+015A Ś ś Ŝ ŝ Ş ş Š š
+    "tttttt"       // U+0162 Ţ ţ Ť ť Ŧ ŧ
+    "uuuuuuuuuuuu" // U+0168 Ũ ũ Ū ū Ŭ ŭ Ů ů Ű ű Ų ų
+    "ww"           // U+0174 Ŵ ŵ
+    "yyy"          // U+0176 Ŷ ŷ Ÿ
+    "zzzzzz"       // U+0179 Ź ź Ż ż Ž ž
+    "s";           // U+017F ſ
+
+static_assert(sizeof(kLatinExtendedA) == 0x80 + 1,
+              "kLatinExtendedA must cover U+0100..U+017F");
+
+/** @brief Base letters for U+00C0..U+00FF; '?' is handled separately. */
+static const char kLatin1[] = "aaaaaa?ceeeeiiii"
+                              "dnooooo?ouuuuy??"
+                              "aaaaaa?ceeeeiiii"
+                              "dnooooo?ouuuuy?y";
+
+static_assert(sizeof(kLatin1) == 0x40 + 1,
+              "kLatin1 must cover U+00C0..U+00FF");
+
+static void AppendFolded(std::string &out, uint32 c) {
+  if (c >= 0xC0 && c <= 0xFF) {
+    switch (c) {
+    case 0xC6: // Æ
+    case 0xE6:
+      out += "ae";
+      return;
+    case 0xDE: // Þ
+    case 0xFE:
+      out += "th";
+      return;
+    case 0xDF: // ß
+      out += "ss";
+      return;
+    case 0xD7: // × and ÷ are no letters
+    case 0xF7:
+      break;
+    default:
+      out += kLatin1[c - 0xC0];
+      return;
+    }
+  } else if (c >= 0x100 && c <= 0x17F) {
+    char base = kLatinExtendedA[c - 0x100];
+    if (base != '?') {
+      out += base;
+      return;
+    }
+    out += (c < 0x150) ? "ij" : "oe";
+    return;
+  } else if (c >= 0x300 && c <= 0x36F) {
+    // Combining diacritical marks (decomposed input).
+    return;
+  }
+
+  char buffer[8];
+  char *end = buffer;
+  BUnicodeChar::ToUTF8(BUnicodeChar::ToLower(c), &end);
+  out.append(buffer, end - buffer);
+}
+
+std::string LibrarySearchIndex::Fold(const char *text) {
+  std::string out;
+  if (text == nullptr)
+    return out;
+
+  const char *p = text;
+  while (*p != '\0') {
+    unsigned char c = (unsigned char)*p;
+    if (c < 0x80) {
+      out += (char)((c >= 'A' && c <= 'Z') ? c + ('a' - 'A') : c);
+      p++;
+      continue;
+    }
+
+    const char *start = p;
+    uint32 codepoint = BUnicodeChar::FromUTF8(&p);
+    if (p == start) {
+      // Invalid sequence; keep the byte so matching stays exact.
+      out += *p++;
+      continue;
+    }
+    AppendFolded(out, codepoint);
+  }
+  return out;
+}
+
+std::string LibrarySearchIndex::_FoldedText(const MediaItem &item) {
+  std::string text = Fold(item.title.String());
+  const BString *fields[] = {&item.artist, &item.album, &item.albumArtist,
+                             &item.composer};
+  for (const BString *field : fields) {
+    if (field->IsEmpty())
+      continue;
+    text += '\n';
+    text += Fold(field->String());
+  }
+  return text;
+}
+
+bool LibrarySearchIndex::Matches(const MediaItem &item,
+                                 const std::string &foldedQuery) {
+  if (foldedQuery.empty())
+    return true;
+  return _FoldedText(item).find(foldedQuery) != std::string::npos;
+}
+
+/**
+ * @brief Appends the distinct trigrams of `text` to `out`, sorted.
+ *
+ * Trigrams spanning a field separator are skipped.
+ */
+void LibrarySearchIndex::_Trigrams(const std::string &text,
+                                   std::vector<uint32> &out) {
+  size_t first = out.size();
+  for (size_t i = 0; i + 3 <= text.size(); i++) {
+    unsigned char a = text[i], b = text[i + 1], c = text[i + 2];
+    if (a == '\n' || b == '\n' || c == '\n')
+      continue;
+    out.push_back((uint32)a << 16 | (uint32)b << 8 | c);
+  }
+  std::sort(out.begin() + first, out.end());
+  out.erase(std::unique(out.begin() + first, out.end()), out.end());
+}
+
+LibrarySearchIndex::LibrarySearchIndex() {}
+
+void LibrarySearchIndex::Clear() {
+  fTexts.clear();
+  fPostings.clear();
+}
+
+void LibrarySearchIndex::Rebuild(const std::vector<MediaItem> &items) {
+  Clear();
+  fTexts.reserve(items.size());
+  for (const MediaItem &item : items)
+    fTexts.push_back(_FoldedText(item));
+
+  // Positions are visited in order, so every list is built sorted.
+  std::vector<uint32> trigrams;
+  for (size_t i = 0; i < fTexts.size(); i++) {
+    trigrams.clear();
+    _Trigrams(fTexts[i], trigrams);
+    for (uint32 trigram : trigrams)
+      fPostings[trigram].push_back((uint32)i);
+  }
+}
+
+void LibrarySearchIndex::Set(size_t position, const MediaItem &item) {
+  std::string text = _FoldedText(item);
+  if (position < fTexts.size()) {
+    if (fTexts[position] == text)
+      return;
+    _RemovePostings((uint32)position);
+  } else {
+    fTexts.resize(position + 1);
+  }
+  fTexts[position].swap(text);
+  _AddPostings((uint32)position);
+}
+
+void LibrarySearchIndex::_AddPostings(uint32 position) {
+  std::vector<uint32> trigrams;
+  _Trigrams(fTexts[position], trigrams);
+  for (uint32 trigram : trigrams) {
+    Postings &list = fPostings[trigram];
+    if (list.empty() || list.back() < position)
+      list.push_back(position);
+    else
+      list.insert(std::lower_bound(list.begin(), list.end(), position),
+                  position);
+  }
+}
+
+void LibrarySearchIndex::_RemovePostings(uint32 position) {
+  std::vector<uint32> trigrams;
+  _Trigrams(fTexts[position], trigrams);
+  for (uint32 trigram : trigrams) {
+    auto it = fPostings.find(trigram);
+    if (it == fPostings.end())
+      continue;
+    Postings &list = it->second;
+    auto entry = std::lower_bound(list.begin(), list.end(), position);
+    if (entry != list.end() && *entry == position)
+      list.erase(entry);
+    if (list.empty())
+      fPostings.erase(it);
+  }
+}
+
+bool LibrarySearchIndex::Contains(size_t position,
+                                  const std::string &foldedQuery) const {
+  return position < fTexts.size() &&
+         fTexts[position].find(foldedQuery) != std::string::npos;
+}
+
+void LibrarySearchIndex::Search(const BString &query,
+                                std::vector<uint32> &positions) const {
+  positions.clear();
+  std::string folded = Fold(query.String());
+  if (folded.empty()) {
+    positions.reserve(fTexts.size());
+    for (size_t i = 0; i < fTexts.size(); i++)
+      positions.push_back((uint32)i);
+    return;
+  }
+
+  std::vector<uint32> trigrams;
+  _Trigrams(folded, trigrams);
+
+  if (trigrams.empty()) {
+    for (size_t i = 0; i < fTexts.size(); i++) {
+      if (fTexts[i].find(folded) != std::string::npos)
+        positions.push_back((uint32)i);
+    }
+    return;
+  }
+
+  std::vector<const Postings *> lists;
+  lists.reserve(trigrams.size());
+  for (uint32 trigram : trigrams) {
+    auto it = fPostings.find(trigram);
+    if (it == fPostings.end())
+      return;
+    lists.push_back(&it->second);
+  }
+  std::sort(lists.begin(), lists.end(),
+            [](const Postings *a, const Postings *b) {
+              return a->size() < b->size();
+            });
+
+  std::vector<uint32> candidates(*lists[0]);
+  std::vector<uint32> next;
+  for (size_t i = 1; i < lists.size() && !candidates.empty(); i++) {
+    next.clear();
+    std::set_intersection(candidates.begin(), candidates.end(),
+                          lists[i]->begin(), lists[i]->end(),
+                          std::back_inserter(next));
+    candidates.swap(next);
+  }
+
+  // Trigrams match in any order; confirm the query occurs as a whole.
+  for (uint32 position : candidates) {
+    if (fTexts[position].find(folded) != std::string::npos)
+      positions.push_back(position);
+  }
+}
@@ -0,0 +1,92 @@
+#ifndef BETON_LIBRARY_SEARCH_INDEX_H
+#define BETON_LIBRARY_SEARCH_INDEX_H
+
+#include "MediaItem.h"
+
+#include <String.h>
+#include <SupportDefs.h>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * @class LibrarySearchIndex
+ * @brief Trigram index over the searchable text of the library items.
+ *
+ * Title, artist, album, album artist and composer are folded (lowercase,
+ * accents stripped, see Fold()) and split into byte trigrams. Each trigram
+ * has a sorted posting list of item positions. A search intersects the lists
+ * of the query trigrams, starting with the shortest, and verifies the
+ * remaining candidates against the folded text.
+ *
+ * Like `LibraryFacetIndex`, positions refer to the vector the index was built
+ * from; Set() updates or appends single positions, removals require a
+ * rebuild.
+ */
+class LibrarySearchIndex {
+public:
+  LibrarySearchIndex();
+
+  /** @brief Replaces the index with the contents of `items`. */
+  void Rebuild(const std::vector<MediaItem> &items);
+
+  /** @brief Removes everything. */
+  void Clear();
+
+  /** @brief Number of indexed positions. */
+  size_t Count() const { return fTexts.size(); }
+
+  /**
+   * @brief (Re)indexes `item` at `position`.
+   *
+   * Positions past the end are appended; gaps stay empty until set.
+   */
+  void Set(size_t position, const MediaItem &item);
+
+  /**
+   * @brief Collects the positions of all items whose text contains `query`.
+   *
+   * Matching is case- and accent-insensitive. Queries shorter than a trigram
+   * are verified against every item's folded text.
+   *
+   * @param query Search text as typed.
+   * @param positions Receives the matching positions in ascending order.
+   */
+  void Search(const BString &query, std::vector<uint32> &positions) const;
+
+  /**
+   * @brief Returns whether the indexed text at `position` contains the
+   * already folded `foldedQuery`.
+   */
+  bool Contains(size_t position, const std::string &foldedQuery) const;
+
+  /**
+   * @brief Lowercases `text` and strips diacritics.
+   *
+   * Latin letters with accents map to their base letter (ligatures and
+   * "ß" to two letters), combining marks are dropped, everything else is
+   * lowercased and kept as UTF-8.
+   */
+  static std::string Fold(const char *text);
+
+  /**
+   * @brief Returns whether the searchable text of `item` contains the
+   * already folded `foldedQuery`. Used where no index is available.
+   */
+  static bool Matches(const MediaItem &item, const std::string &foldedQuery);
+
+private:
+  typedef std::vector<uint32> Postings;
+
+  static std::string _FoldedText(const MediaItem &item);
+  static void _Trigrams(const std::string &text, std::vector<uint32> &out);
+
+  void _AddPostings(uint32 position);
+  void _RemovePostings(uint32 position);
+
+  /** @brief Folded fields per position, separated by '\n'. */
+  std::vector<std::string> fTexts;
+  std::unordered_map<uint32, Postings> fPostings;
+};
+
+#endif // BETON_LIBRARY_SEARCH_INDEX_H
@@ -0,0 +1,156 @@
+#include "LibrarySnapshot.h"
+
+#include <Autolock.h>
+
+#include <algorithm>
+#include <string.h>
+#include <utility>
+
+static const std::vector<MediaItem> kNoItems;
+
+LibrarySnapshot::LibrarySnapshot(uint64 version, std::vector<MediaItem> items)
+    : fVersion(version), fItems(std::move(items)),
+      fOrderLock("LibrarySnapshot orders"), fPathOrderValid(false),
+      fInodeOrderValid(false), fColumnsValid(false),
+      fMemory(kMemorySnapshots) {
+  _UpdateMemory();
+}
+
+void LibrarySnapshot::_UpdateMemory() const {
+  fMemory.Set(MemoryStats::BytesOf(fItems) + MemoryStats::BytesOf(fPathOrder) +
+              MemoryStats::BytesOf(fInodeOrder) + fColumns.MemoryBytes());
+}
+
+void LibrarySnapshot::_BuildPathOrder() const {
+  if (fPathOrderValid.load(std::memory_order_acquire))
+    return;
+  BAutolock lock(&fOrderLock);
+  if (fPathOrderValid.load(std::memory_order_relaxed))
+    return;
+
+  fPathOrder.resize(fItems.size());
+  for (uint32 i = 0; i < (uint32)fItems.size(); i++)
+    fPathOrder[i] = i;
+  std::sort(fPathOrder.begin(), fPathOrder.end(), [this](uint32 a, uint32 b) {
+    return strcmp(fItems[a].path.String(), fItems[b].path.String()) < 0;
+  });
+  _UpdateMemory();
+  fPathOrderValid.store(true, std::memory_order_release);
+}
+
+void LibrarySnapshot::_BuildInodeOrder() const {
+  if (fInodeOrderValid.load(std::memory_order_acquire))
+    return;
+  BAutolock lock(&fOrderLock);
+  if (fInodeOrderValid.load(std::memory_order_relaxed))
+    return;
+
+  fInodeOrder.clear();
+  fInodeOrder.reserve(fItems.size());
+  for (uint32 i = 0; i < (uint32)fItems.size(); i++) {
+    if (fItems[i].inode != 0)
+      fInodeOrder.push_back(i);
+  }
+  std::sort(fInodeOrder.begin(), fInodeOrder.end(),
+            [this](uint32 a, uint32 b) {
+              return fItems[a].inode < fItems[b].inode;
+            });
+  _UpdateMemory();
+  fInodeOrderValid.store(true, std::memory_order_release);
+}
+
+const LibraryColumns &LibrarySnapshot::Columns() const {
+  if (fColumnsValid.load(std::memory_order_acquire))
+    return fColumns;
+  BAutolock lock(&fOrderLock);
+  if (fColumnsValid.load(std::memory_order_relaxed))
+    return fColumns;
+
+  fColumns.Build(fItems);
+  _UpdateMemory();
+  fColumnsValid.store(true, std::memory_order_release);
+  return fColumns;
+}
+
+void LibrarySnapshot::FindBelow(const BString &directory,
+                                std::vector<uint32> &positions) const {
+  BString prefix = directory;
+  if (!prefix.EndsWith("/"))
+    prefix << '/';
+
+  auto before = [this](uint32 position, const char *path) {
+    return strcmp(fItems[position].path.String(), path) < 0;
+  };
+
+  _BuildPathOrder();
+  auto it = std::lower_bound(fPathOrder.begin(), fPathOrder.end(),
+                             prefix.String(), before);
+  for (; it != fPathOrder.end(); ++it) {
+    if (strncmp(fItems[*it].path.String(), prefix.String(),
+                prefix.Length()) != 0)
+      break;
+    positions.push_back(*it);
+  }
+}
+
+const MediaItem *LibrarySnapshot::Find(const BString &path) const {
+  _BuildPathOrder();
+  auto it = std::lower_bound(
+      fPathOrder.begin(), fPathOrder.end(), path.String(),
+      [this](uint32 position, const char *key) {
+        return strcmp(fItems[position].path.String(), key) < 0;
+      });
+  if (it == fPathOrder.end() || fItems[*it].path != path)
+    return nullptr;
+  return &fItems[*it];
+}
+
+const MediaItem *LibrarySnapshot::FindByFileStat(int64 inode, int64 size,
+                                                 int64 mtime) const {
+  if (inode == 0)
+    return nullptr;
+
+  _BuildInodeOrder();
+  auto it = std::lower_bound(fInodeOrder.begin(), fInodeOrder.end(), inode,
+                             [this](uint32 position, int64 key) {
+                               return fItems[position].inode < key;
+                             });
+  for (; it != fInodeOrder.end() && fItems[*it].inode == inode; ++it) {
+    const MediaItem &item = fItems[*it];
+    if (item.size == size && item.mtime == mtime)
+      return &item;
+  }
+  return nullptr;
+}
+
+LibraryItems::LibraryItems() {}
+
+void LibraryItems::SetTo(LibrarySnapshot *snapshot) { fSnapshot.SetTo(snapshot); }
+
+void LibraryItems::Clear() { fSnapshot.Unset(); }
+
+const std::vector<MediaItem> &LibraryItems::Items() const {
+  return fSnapshot.Get() != nullptr ? fSnapshot->fItems : kNoItems;
+}
+
+uint64 LibraryItems::Version() const {
+  return fSnapshot.Get() != nullptr ? fSnapshot->fVersion : 0;
+}
+
+std::vector<MediaItem> &LibraryItems::Mutable() {
+  if (fSnapshot.Get() == nullptr) {
+    fSnapshot.SetTo(new LibrarySnapshot(0, std::vector<MediaItem>()), true);
+  } else if (fSnapshot->CountReferences() > 1) {
+    // Still shared: detach so the other holders keep their version.
+    fSnapshot.SetTo(
+        new LibrarySnapshot(fSnapshot->fVersion, fSnapshot->fItems), true);
+  } else {
+    // Only this handle sees the items; their orders are about to go stale.
+    fSnapshot->fPathOrderValid.store(false, std::memory_order_relaxed);
+    fSnapshot->fInodeOrderValid.store(false, std::memory_order_relaxed);
+    fSnapshot->fColumnsValid.store(false, std::memory_order_relaxed);
+    // Counts what earlier changes through this handle did to the array.
+    fSnapshot->_UpdateMemory();
+  }
+  return fSnapshot->fItems;
+}
@@ -0,0 +1,130 @@
+#ifndef BETON_LIBRARY_SNAPSHOT_H
+#define BETON_LIBRARY_SNAPSHOT_H
+
+#include "LibraryColumns.h"
+#include "MediaItem.h"
+#include "MemoryStats.h"
+
+#include <Locker.h>
+#include <Referenceable.h>
+#include <String.h>
+#include <SupportDefs.h>
+#include <atomic>
+#include <vector>
+
+/**
+ * @class LibrarySnapshot
+ * @brief Immutable, reference-counted copy of the library item array.
+ *
+ * The cache publishes one snapshot per version of its entries; the window,
+ * the browser filters and the smart-playlist generator all read that same
+ * array instead of copying it. Holders that need to change items go through
+ * `LibraryItems`, which copies the snapshot only while it is still shared.
+ */
+class LibrarySnapshot : public BReferenceable {
+public:
+  LibrarySnapshot(uint64 version, std::vector<MediaItem> items);
+
+  /** @brief Cache version the snapshot was taken at. */
+  uint64 Version() const { return fVersion; }
+
+  /** @brief Items in cache order. */
+  const std::vector<MediaItem> &Items() const { return fItems; }
+
+  /**
+   * @brief Appends the positions of the items below `directory`, in path
+   * order.
+   *
+   * The items are sorted by path on the first call; later calls only
+   * search that order for the range sharing the directory's prefix.
+   */
+  void FindBelow(const BString &directory,
+                 std::vector<uint32> &positions) const;
+
+  /** @brief Returns the item stored for `path`, or `nullptr`. */
+  const MediaItem *Find(const BString &path) const;
+
+  /**
+   * @brief Returns an item with `inode` whose size and mtime also match, or
+   * `nullptr`.
+   *
+   * The inode order is built on the first call, like the path order.
+   */
+  const MediaItem *FindByFileStat(int64 inode, int64 size,
+                                  int64 mtime) const;
+
+  /**
+   * @brief Numeric fields of the items as columns, for totals over views.
+   *
+   * Built on the first call, like the path order.
+   */
+  const LibraryColumns &Columns() const;
+
+private:
+  friend class LibraryItems;
+
+  void _BuildPathOrder() const;
+  void _BuildInodeOrder() const;
+  void _UpdateMemory() const;
+
+  uint64 fVersion;
+  std::vector<MediaItem> fItems;
+
+  // Built once under the lock; lookups after that take no lock, so the
+  // scanners of all sources can share one snapshot.
+  mutable BLocker fOrderLock;
+  mutable std::vector<uint32> fPathOrder;  ///< Positions sorted by path
+  mutable std::vector<uint32> fInodeOrder; ///< Positions sorted by inode
+  mutable std::atomic<bool> fPathOrderValid;
+  mutable std::atomic<bool> fInodeOrderValid;
+  mutable LibraryColumns fColumns;
+  mutable std::atomic<bool> fColumnsValid;
+  mutable MemoryAccount fMemory; ///< Updated under fOrderLock after creation
+};
+
+/**
+ * @class LibraryItems
+ * @brief Copy-on-write handle to a `LibrarySnapshot`.
+ *
+ * Read access never copies. Mutable() detaches first if the snapshot is
+ * referenced elsewhere (e.g. still published by the cache), so other holders
+ * keep seeing their version unchanged.
+ *
+ * Not thread-safe; each handle belongs to one looper.
+ */
+class LibraryItems {
+public:
+  LibraryItems();
+
+  /** @brief Shares `snapshot` (no copy). */
+  void SetTo(LibrarySnapshot *snapshot);
+
+  /** @brief Drops all items. */
+  void Clear();
+
+  const std::vector<MediaItem> &Items() const;
+  size_t Count() const { return Items().size(); }
+  bool IsEmpty() const { return Items().empty(); }
+  const MediaItem &operator[](size_t index) const { return Items()[index]; }
+  std::vector<MediaItem>::const_iterator begin() const {
+    return Items().begin();
+  }
+  std::vector<MediaItem>::const_iterator end() const { return Items().end(); }
+
+  /** @brief Version of the snapshot this handle started from. */
+  uint64 Version() const;
+
+  /**
+   * @brief Returns the items for modification, copying them first if the
+   * snapshot is shared.
+   */
+  std::vector<MediaItem> &Mutable();
+
+  /** @brief Underlying snapshot (shared with other holders). */
+  LibrarySnapshot *Snapshot() const { return fSnapshot.Get(); }
+
+private:
+  BReference<LibrarySnapshot> fSnapshot;
+};
+
+#endif // BETON_LIBRARY_SNAPSHOT_H
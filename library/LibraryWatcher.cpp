@@ -0,0 +1,218 @@
+#include "LibraryWatcher.h"
+#include "Debug.h"
+#include "Messages.h"
+
+#include <Entry.h>
+#include <NodeMonitor.h>
+#include <PathMonitor.h>
+#include <string.h>
+
+static const uint32 kWatchFlags =
+    B_WATCH_RECURSIVELY | B_WATCH_NAME | B_WATCH_DIRECTORY | B_WATCH_STAT;
+
+LibraryWatcher::LibraryWatcher(const BMessenger &target)
+    : BHandler("LibraryWatcher"), fTarget(target), fFlushRunner(nullptr),
+      fFirstPendingTime(0) {}
+
+LibraryWatcher::~LibraryWatcher() { StopWatching(); }
+
+/**
+ * @brief Starts watching roots that are new and stops watching removed ones.
+ */
+void LibraryWatcher::SetRoots(const std::vector<BString> &roots) {
+  BMessenger self(this);
+
+  std::vector<BString> watched;
+  for (const BString &root : fRoots) {
+    bool keep = false;
+    for (const BString &r : roots) {
+      if (r == root) {
+        keep = true;
+        break;
+      }
+    }
+    if (keep)
+      watched.push_back(root);
+    else
+      BPrivate::BPathMonitor::StopWatching(root.String(), self);
+  }
+
+  for (const BString &root : roots) {
+    bool known = false;
+    for (const BString &w : watched) {
+      if (w == root) {
+        known = true;
+        break;
+      }
+    }
+    if (known)
+      continue;
+
+    BEntry entry(root.String());
+    if (!entry.IsDirectory())
+      continue;
+
+    status_t status =
+        BPrivate::BPathMonitor::StartWatching(root.String(), kWatchFlags, self);
+    if (status != B_OK) {
+      DEBUG_PRINT("LibraryWatcher: cannot watch %s: %s\n", root.String(),
+                  strerror(status));
+      continue;
+    }
+    DEBUG_PRINT("LibraryWatcher: watching %s\n", root.String());
+    watched.push_back(root);
+  }
+
+  fRoots.swap(watched);
+}
+
+void LibraryWatcher::StopWatching() {
+  if (!fRoots.empty())
+    BPrivate::BPathMonitor::StopWatching(BMessenger(this));
+  fRoots.clear();
+  fPending.clear();
+  fMoves.clear();
+  delete fFlushRunner;
+  fFlushRunner = nullptr;
+}
+
+void LibraryWatcher::MessageReceived(BMessage *msg) {
+  switch (msg->what) {
+  case B_PATH_MONITOR:
+    _HandlePathEvent(msg);
+    break;
+
+  case MSG_WATCH_FLUSH:
+    delete fFlushRunner;
+    fFlushRunner = nullptr;
+    _Flush();
+    break;
+
+  default:
+    BHandler::MessageReceived(msg);
+  }
+}
+
+/**
+ * @brief Returns whether `path` is outside all roots or below a hidden entry.
+ */
+bool LibraryWatcher::_IsIgnored(const BString &path) const {
+  for (const BString &root : fRoots) {
+    if (!path.StartsWith(root) || path.Length() <= root.Length() ||
+        path.ByteAt(root.Length()) != '/')
+      continue;
+    // Hidden files and directories are skipped by the scanner as well.
+    return path.FindFirst("/.", root.Length()) >= 0;
+  }
+  return true;
+}
+
+void LibraryWatcher::_HandlePathEvent(BMessage *msg) {
+  int32 opcode;
+  if (msg->FindInt32("opcode", &opcode) != B_OK)
+    return;
+
+  BString path;
+  bool hasPath = msg->FindString("path", &path) == B_OK && !_IsIgnored(path);
+
+  switch (opcode) {
+  case B_ENTRY_CREATED:
+  case B_ENTRY_REMOVED:
+    if (hasPath)
+      _AddPending(path, kPendingEntry);
+    break;
+
+  case B_ENTRY_MOVED: {
+    BString from;
+    bool hasFrom =
+        msg->FindString("from path", &from) == B_OK && !_IsIgnored(from);
+    if (hasFrom)
+      _AddPending(from, kPendingEntry);
+    if (hasPath)
+      _AddPending(path, kPendingEntry);
+    // Moves inside the library keep the entry (and its track ID) alive.
+    if (hasFrom && hasPath)
+      fMoves.push_back(std::make_pair(from, path));
+    break;
+  }
+
+  case B_STAT_CHANGED: {
+    int32 fields = msg->GetInt32("fields", 0);
+    // Interim updates arrive while a file is still being written.
+    if ((fields & B_STAT_INTERIM_UPDATE) != 0)
+      break;
+    if (hasPath && (fields & (B_STAT_SIZE | B_STAT_MODIFICATION_TIME)) != 0)
+      _AddPending(path, kPendingStat);
+    break;
+  }
+
+  default:
+    break;
+  }
+}
+
+void LibraryWatcher::_AddPending(const BString &path, uint32 reason) {
+  fPending[path] |= reason;
+  _ScheduleFlush();
+}
+
+/**
+ * @brief (Re)starts the debounce timer, bounded by `kMaxDelay`.
+ */
+void LibraryWatcher::_ScheduleFlush() {
+  bigtime_t now = system_time();
+  if (fFlushRunner == nullptr)
+    fFirstPendingTime = now;
+
+  bigtime_t delay = kDebounceDelay;
+  bigtime_t deadline = fFirstPendingTime + kMaxDelay;
+  if (now + delay > deadline)
+    delay = deadline > now ? deadline - now : 0;
+
+  delete fFlushRunner;
+  fFlushRunner = nullptr;
+  if (delay == 0) {
+    _Flush();
+    return;
+  }
+
+  BMessage flush(MSG_WATCH_FLUSH);
+  fFlushRunner = new BMessageRunner(BMessenger(this), &flush, delay, 1);
+}
+
+/**
+ * @brief Sends the pending paths, classified by their current state, to the
+ * target.
+ *
+ * Existing files and newly appeared directories are reported as "changed",
+ * vanished paths as "removed". Stat changes of directories are dropped; they
+ * only reflect changes of their contents, which are reported separately.
+ */
+void LibraryWatcher::_Flush() {
+  if (fPending.empty() && fMoves.empty())
+    return;
+
+  BMessage changes(MSG_LIBRARY_CHANGED);
+  int32 changed = 0, removed = 0;
+  for (const auto &pending : fPending) {
+    BEntry entry(pending.first.String());
+    if (!entry.Exists()) {
+      changes.AddString("removed", pending.first);
+      removed++;
+    } else if (!entry.IsDirectory() || (pending.second & kPendingEntry) != 0) {
+      changes.AddString("changed", pending.first);
+      changed++;
+    }
+  }
+  for (const auto &move : fMoves) {
+    changes.AddString("from", move.first);
+    changes.AddString("to", move.second);
+  }
+
+  DEBUG_PRINT("LibraryWatcher: flush %ld changed, %ld removed, %zu moved\n",
+              (long)changed, (long)removed, fMoves.size());
+
+  fPending.clear();
+  fMoves.clear();
+  fTarget.SendMessage(&changes);
+}
@@ -0,0 +1,78 @@
+#ifndef BETON_LIBRARY_WATCHER_H
+#define BETON_LIBRARY_WATCHER_H
+
+#include <Handler.h>
+#include <Message.h>
+#include <MessageRunner.h>
+#include <Messenger.h>
+#include <OS.h>
+#include <String.h>
+#include <map>
+#include <utility>
+#include <vector>
+
+/**
+ * @class LibraryWatcher
+ * @brief Turns node monitor events below the source roots into library
+ * updates.
+ *
+ * Watches every configured source directory recursively via `BPathMonitor`
+ * (entry and stat changes). Events are collected per path and flushed as a
+ * single `MSG_LIBRARY_CHANGED` once the file system has been quiet for
+ * `kDebounceDelay`, or after `kMaxDelay` during a long burst (e.g. copying an
+ * album). The flush classifies paths by their state on disk at that moment,
+ * so create/remove sequences for the same path collapse to the final result.
+ *
+ * The handler is meant to be added to the `MediaLibraryCache` looper, which
+ * applies the changes.
+ */
+class LibraryWatcher : public BHandler {
+public:
+  /** @brief Quiet period before pending events are flushed. */
+  static const bigtime_t kDebounceDelay = 750000;
+  /** @brief Upper bound for holding back events during a burst. */
+  static const bigtime_t kMaxDelay = 5000000;
+
+  /**
+   * @param target Receives `MSG_LIBRARY_CHANGED` (usually the cache looper).
+   */
+  explicit LibraryWatcher(const BMessenger &target);
+  ~LibraryWatcher() override;
+
+  void MessageReceived(BMessage *msg) override;
+
+  /**
+   * @brief Replaces the set of watched roots.
+   *
+   * Roots that are not reachable are skipped; they are picked up again by the
+   * next call (e.g. after a rescan once the volume is mounted).
+   * Must be called with the owning looper locked.
+   */
+  void SetRoots(const std::vector<BString> &roots);
+
+  /** @brief Stops watching all roots and drops pending events. */
+  void StopWatching();
+
+private:
+  /** @brief Reason a path is pending. */
+  enum {
+    kPendingEntry = 0x01, ///< Created, removed or moved
+    kPendingStat = 0x02   ///< Size or modification time changed
+  };
+
+  void _HandlePathEvent(BMessage *msg);
+  void _AddPending(const BString &path, uint32 reason);
+  void _ScheduleFlush();
+  void _Flush();
+  bool _IsIgnored(const BString &path) const;
+
+  BMessenger fTarget;
+  std::vector<BString> fRoots;
+  std::map<BString, uint32> fPending;
+  /** @brief Moves with both ends below a watched root, in event order. */
+  std::vector<std::pair<BString, BString>> fMoves;
+  BMessageRunner *fFlushRunner;
+  bigtime_t fFirstPendingTime;
+};
+
+#endif // BETON_LIBRARY_WATCHER_H
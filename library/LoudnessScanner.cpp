@@ -0,0 +1,311 @@
+#include "LoudnessScanner.h"
+#include "Debug.h"
+#include "LoudnessMeter.h"
+#include "Messages.h"
+#include "MetadataTagIO.h"
+#include "ParallelAlgorithms.h"
+#include "PcmKernels.h"
+#include "ReadAheadFile.h"
+
+#include <Entry.h>
+#include <MediaFile.h>
+#include <MediaTrack.h>
+#include <Message.h>
+#include <Path.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <map>
+
+/** @brief Separates the parts of an album key. */
+static const char kKeySeparator = '\x1f';
+
+/** @brief One item of an album and the values it ends up with. */
+struct AlbumMember {
+  size_t index = 0;
+  ReplayGainInfo gain;
+  bool measured = false; ///< Decoded in this run
+  bool changed = false;  ///< Differs from the snapshot item
+};
+
+static int32 ToHundredths(double db) { return (int32)std::lround(db * 100.0); }
+
+static int32 ToMillionths(float peak) {
+  // A silent track still counts as analyzed.
+  return std::max((int32)1,
+                  (int32)std::min(peak * 1000000.0 + 0.5, 2147483647.0));
+}
+
+LoudnessScanner::LoudnessScanner(const BMessenger &target)
+    : fTarget(target), fThread(-1), fCancel(false), fRunning(false),
+      fWriteToFiles(false), fNextAlbum(0), fAlbumsDone(0) {}
+
+LoudnessScanner::~LoudnessScanner() { Cancel(); }
+
+status_t LoudnessScanner::Start(LibrarySnapshot *snapshot, bool writeToFiles) {
+  Cancel();
+  if (snapshot == nullptr)
+    return B_BAD_VALUE;
+
+  fSnapshot.SetTo(snapshot);
+  fWriteToFiles = writeToFiles;
+  fCancel = false;
+  fRunning = true;
+  fThread = spawn_thread(_ThreadEntry, "LoudnessScanner", B_LOW_PRIORITY, this);
+  if (fThread < 0) {
+    status_t status = fThread;
+    fRunning = false;
+    return status;
+  }
+  return resume_thread(fThread);
+}
+
+void LoudnessScanner::Cancel() {
+  fCancel = true;
+  if (fThread >= 0) {
+    status_t result;
+    wait_for_thread(fThread, &result);
+    fThread = -1;
+  }
+  fRunning = false;
+}
+
+int32 LoudnessScanner::_ThreadEntry(void *data) {
+  auto *scanner = static_cast<LoudnessScanner *>(data);
+  scanner->_Run();
+  scanner->fRunning = false;
+  return 0;
+}
+
+void LoudnessScanner::_ReportProgress(int32 current, int32 total, bool done) {
+  BMessage progress(MSG_LOUDNESS_PROGRESS);
+  progress.AddInt32("current", current);
+  progress.AddInt32("total", total);
+  progress.AddBool("done", done);
+  fTarget.SendMessage(&progress);
+}
+
+void LoudnessScanner::_Run() {
+  bigtime_t t0 = system_time();
+  const std::vector<MediaItem> &items = fSnapshot->Items();
+
+  std::map<BString, size_t> albumIndex;
+  fAlbums.clear();
+  for (size_t i = 0; i < items.size(); i++) {
+    const MediaItem &item = items[i];
+    if (item.missing || !item.HasFile())
+      continue;
+    BString lower(item.path);
+    lower.ToLower();
+    if (lower.EndsWith(".mid") || lower.EndsWith(".midi"))
+      continue;
+
+    if (item.album.IsEmpty()) {
+      fAlbums.push_back(std::vector<size_t>(1, i));
+      continue;
+    }
+    BString key(item.album);
+    key << kKeySeparator
+        << (item.albumArtist.IsEmpty() ? item.base : item.albumArtist);
+    key.ToLower();
+    auto it = albumIndex.find(key);
+    if (it == albumIndex.end()) {
+      albumIndex[key] = fAlbums.size();
+      fAlbums.push_back(std::vector<size_t>(1, i));
+    } else {
+      fAlbums[it->second].push_back(i);
+    }
+  }
+
+  // Only albums with something left to do; earlier runs stored the rest.
+  auto done = [&](const std::vector<size_t> &album) {
+    bool named = !items[album.front()].album.IsEmpty();
+    for (size_t index : album) {
+      const MediaItem &item = items[index];
+      if (!item.HasLoudness() || (named && item.albumPeak <= 0))
+        return false;
+    }
+    return true;
+  };
+  fAlbums.erase(std::remove_if(fAlbums.begin(), fAlbums.end(), done),
+                fAlbums.end());
+
+  const int32 total = (int32)fAlbums.size();
+  fNextAlbum = 0;
+  fAlbumsDone = 0;
+  _ReportProgress(0, total, false);
+
+  int32 workers = std::min(ParallelAlgorithms::WorkerCount(), total);
+  // Helpers inherit the priority of this thread (B_LOW_PRIORITY).
+  ParallelAlgorithms::Run(workers, [&](int32) {
+    for (;;) {
+      int32 next = fNextAlbum.fetch_add(1);
+      if (next >= total || fCancel.load())
+        break;
+      _AnalyzeAlbum(fAlbums[next]);
+      if (fCancel.load())
+        break;
+      _ReportProgress(fAlbumsDone.fetch_add(1) + 1, total, false);
+    }
+  });
+
+  DEBUG_PRINT("LoudnessScanner: %ld of %ld albums in %lld ms%s\n",
+              (long)fAlbumsDone.load(), (long)total,
+              (long long)(system_time() - t0) / 1000,
+              fCancel.load() ? " (cancelled)" : "");
+  _ReportProgress(fAlbumsDone.load(), total, true);
+  fAlbums.clear();
+  fSnapshot.Unset();
+}
+
+void LoudnessScanner::_AnalyzeAlbum(const std::vector<size_t> &album) {
+  const std::vector<MediaItem> &items = fSnapshot->Items();
+  const bool named = !items[album.front()].album.IsEmpty();
+
+  std::vector<AlbumMember> members;
+  std::vector<double> blocks;
+  bool allMeasured = true;
+  bool allHaveAlbum = true;
+  int32 albumPeak = 0;
+  double energy = 0;
+  double weight = 0;
+
+  for (size_t index : album) {
+    const MediaItem &item = items[index];
+    AlbumMember member;
+    member.index = index;
+
+    if (item.HasLoudness()) {
+      member.gain.trackGain = item.trackGain;
+      member.gain.trackPeak = item.trackPeak;
+      member.gain.albumGain = item.albumGain;
+      member.gain.albumPeak = item.albumPeak;
+    } else if (MetadataTagIO::ReadReplayGain(BPath(item.path.String()),
+                                             member.gain)) {
+      member.changed = true;
+    } else {
+      LoudnessMeter meter;
+      status_t status = _Measure(item.path.String(), meter);
+      if (status == B_CANCELED)
+        return;
+      if (status != B_OK) {
+        DEBUG_PRINT("LoudnessScanner: cannot measure %s: %s\n",
+                    item.path.String(), strerror(status));
+        allMeasured = false;
+        continue;
+      }
+      member.gain.trackGain =
+          ToHundredths(LoudnessMeter::GainFor(meter.Integrated()));
+      member.gain.trackPeak = ToMillionths(meter.TruePeak());
+      blocks.insert(blocks.end(), meter.Blocks().begin(),
+                    meter.Blocks().end());
+      member.measured = true;
+      member.changed = true;
+    }
+
+    allMeasured = allMeasured && member.measured;
+    allHaveAlbum = allHaveAlbum && member.gain.HasAlbum();
+    albumPeak = std::max(albumPeak, member.gain.trackPeak);
+    double seconds = item.duration > 0 ? item.duration : 1.0;
+    energy += seconds *
+              std::pow(10.0, (-18.0 - member.gain.trackGain / 100.0) / 10.0);
+    weight += seconds;
+    members.push_back(member);
+  }
+  if (members.empty())
+    return;
+
+  // Albums that bring their own album values keep them.
+  if (named && !allHaveAlbum) {
+    double lufs = allMeasured ? LoudnessMeter::Integrated(blocks)
+                              : 10.0 * std::log10(energy / weight);
+    int32 albumGain = ToHundredths(LoudnessMeter::GainFor(lufs));
+    for (AlbumMember &member : members) {
+      if (member.gain.albumGain != albumGain ||
+          member.gain.albumPeak != albumPeak)
+        member.changed = true;
+      member.gain.albumGain = albumGain;
+      member.gain.albumPeak = albumPeak;
+    }
+  }
+
+  BMessage result(MSG_LOUDNESS_RESULT);
+  for (const AlbumMember &member : members) {
+    if (!member.changed)
+      continue;
+    const MediaItem &item = items[member.index];
+    result.AddString("path", item.path);
+    result.AddInt32("trackGain", member.gain.trackGain);
+    result.AddInt32("trackPeak", member.gain.trackPeak);
+    result.AddInt32("albumGain", member.gain.albumGain);
+    result.AddInt32("albumPeak", member.gain.albumPeak);
+
+    // Files that came with their own tags are left alone.
+    if (fWriteToFiles && member.measured)
+      MetadataTagIO::WriteReplayGain(BPath(item.path.String()), member.gain);
+  }
+  if (!result.IsEmpty())
+    fTarget.SendMessage(&result);
+}
+
+status_t LoudnessScanner::_Measure(const char *path, LoudnessMeter &meter) {
+  entry_ref ref;
+  status_t status = get_ref_for_path(path, &ref);
+  if (status != B_OK)
+    return status;
+
+  LocalMediaFile file(ref);
+  if ((status = file.InitCheck()) != B_OK)
+    return status;
+  BMediaTrack *track = file.TrackAt(0);
+  if (track == nullptr)
+    return B_ERROR;
+
+  // Ask for floats; decoders that cannot deliver them usually give int16.
+  media_format format;
+  format.type = B_MEDIA_RAW_AUDIO;
+  format.u.raw_audio = media_raw_audio_format::wildcard;
+  format.u.raw_audio.format = media_raw_audio_format::B_AUDIO_FLOAT;
+  status = track->DecodedFormat(&format);
+
+  const media_raw_audio_format &raw = format.u.raw_audio;
+  int32 channels = (int32)raw.channel_count;
+  bool isFloat = raw.format == media_raw_audio_format::B_AUDIO_FLOAT;
+  bool isShort = raw.format == media_raw_audio_format::B_AUDIO_SHORT;
+  if (status == B_OK && (!isFloat && !isShort))
+    status = B_NOT_SUPPORTED;
+  if (status == B_OK)
+    status = meter.Reset(raw.frame_rate, channels);
+  if (status != B_OK) {
+    file.ReleaseTrack(track);
+    return status;
+  }
+
+  size_t bufferSize = raw.buffer_size > 0 ? raw.buffer_size : 65536;
+  std::vector<char> buffer(bufferSize);
+  std::vector<float> converted;
+
+  for (;;) {
+    if (fCancel.load()) {
+      status = B_CANCELED;
+      break;
+    }
+
+    int64 frames = 0;
+    if (track->ReadFrames(buffer.data(), &frames) != B_OK || frames <= 0)
+      break;
+
+    const float *samples = reinterpret_cast<const float *>(buffer.data());
+    if (isShort) {
+      const int16 *in = reinterpret_cast<const int16 *>(buffer.data());
+      converted.resize((size_t)frames * channels);
+      PcmKernels::Int16ToFloat(in, converted.data(), converted.size());
+      samples = converted.data();
+    }
+    meter.Add(samples, frames);
+  }
+
+  file.ReleaseTrack(track);
+  return status;
+}
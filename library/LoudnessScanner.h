@@ -0,0 +1,83 @@
+#ifndef BETON_LOUDNESS_SCANNER_H
+#define BETON_LOUDNESS_SCANNER_H
+
+#include "LibrarySnapshot.h"
+#include "MediaItem.h"
+
+#include <Messenger.h>
+#include <OS.h>
+#include <String.h>
+#include <SupportDefs.h>
+#include <atomic>
+#include <vector>
+
+class LoudnessMeter;
+
+/**
+ * @class LoudnessScanner
+ * @brief Measures track and album loudness of the library in the
+ * background.
+ *
+ * A run groups the items of a snapshot into albums (same album tag and album
+ * artist, or the same folder if there is no album artist) and works on
+ * every album that still has an item without loudness. Albums are handed
+ * to a low-priority worker pool (`ParallelAlgorithms::Run()` from a
+ * `B_LOW_PRIORITY` thread), one album per worker at a time.
+ *
+ * Items whose files already carry ReplayGain tags (or `BeTon:*` attributes)
+ * take those values and are not decoded. The others are decoded to float
+ * and measured with a LoudnessMeter. The album gain is gated over the blocks
+ * of all tracks when the whole album was decoded, otherwise it is the
+ * duration-weighted energy mean of the track values.
+ *
+ * Every finished album is sent to the target as `MSG_LOUDNESS_RESULT` with
+ * one "path", "trackGain", "trackPeak", "albumGain" and "albumPeak" entry
+ * per item (MediaItem units); the target stores them, so a cancelled run
+ * continues where it stopped. Progress is sent as `MSG_LOUDNESS_PROGRESS`
+ * ("current", "total" albums; "done" at the end).
+ */
+class LoudnessScanner {
+public:
+  explicit LoudnessScanner(const BMessenger &target);
+  ~LoudnessScanner();
+
+  /**
+   * @brief Starts a run over `snapshot`; cancels a run still in progress.
+   * @param writeToFiles Also store new values with
+   * MetadataTagIO::WriteReplayGain().
+   */
+  status_t Start(LibrarySnapshot *snapshot, bool writeToFiles);
+
+  /** @brief Stops the current run and waits for its threads. */
+  void Cancel();
+
+  bool IsRunning() const { return fThread >= 0 && fRunning.load(); }
+
+private:
+  static int32 _ThreadEntry(void *data);
+  void _Run();
+
+  /** @brief Measures one album and sends its result. */
+  void _AnalyzeAlbum(const std::vector<size_t> &album);
+
+  /** @brief Decodes `path` into `meter`; B_CANCELED if the run stopped. */
+  status_t _Measure(const char *path, LoudnessMeter &meter);
+
+  void _ReportProgress(int32 current, int32 total, bool done);
+
+  BMessenger fTarget;
+  BReference<LibrarySnapshot> fSnapshot;
+  thread_id fThread;
+  std::atomic<bool> fCancel;
+  std::atomic<bool> fRunning;
+  bool fWriteToFiles;
+
+  /** @name Current run (scanner and worker threads) */
+  ///@{
+  std::vector<std::vector<size_t>> fAlbums; ///< Item indices per album
+  std::atomic<int32> fNextAlbum;
+  std::atomic<int32> fAlbumsDone;
+  ///@}
+};
+
+#endif // BETON_LOUDNESS_SCANNER_H
@@ -0,0 +1,24 @@
+#include "MediaBatch.h"
+
+static const char *kBatchField = "batch";
+
+status_t MediaBatch::SendTo(const BMessenger &target, uint32 what) {
+  BMessage msg(what);
+  msg.AddInt32("count", (int32)items.size());
+  msg.AddPointer(kBatchField, this);
+
+  AcquireReference();
+  status_t status = target.SendMessage(&msg);
+  if (status != B_OK)
+    ReleaseReference();
+  return status;
+}
+
+BReference<MediaBatch> MediaBatch::Detach(BMessage *msg) {
+  void *pointer = nullptr;
+  if (msg->FindPointer(kBatchField, &pointer) != B_OK || pointer == nullptr)
+    return BReference<MediaBatch>();
+
+  msg->RemoveName(kBatchField);
+  return BReference<MediaBatch>(static_cast<MediaBatch *>(pointer), true);
+}
@@ -0,0 +1,48 @@
+#ifndef BETON_MEDIA_BATCH_H
+#define BETON_MEDIA_BATCH_H
+
+#include "MediaItem.h"
+
+#include <Message.h>
+#include <Messenger.h>
+#include <Referenceable.h>
+#include <String.h>
+#include <utility>
+#include <vector>
+
+/**
+ * @class MediaBatch
+ * @brief Reference-counted batch of scanned items passed between loopers.
+ *
+ * Instead of packing every field into the message, the scanner hands a
+ * pointer to the batch through `MSG_MEDIA_BATCH`. Each message in flight
+ * owns one reference; the receiver takes it over with Detach(). All loopers
+ * live in the same team, so the pointer stays valid, and a forwarded batch
+ * (cache -> window) is shared instead of copied.
+ *
+ * A batch must not be modified once it has been sent.
+ */
+class MediaBatch : public BReferenceable {
+public:
+  BString base;                 ///< Source root the items were scanned from
+  std::vector<MediaItem> items; ///< Scanned items in traversal order
+  /** @brief (old path, new path) of moved entries; applied before `items`. */
+  std::vector<std::pair<BString, BString>> moves;
+
+  /**
+   * @brief Sends the batch to `target` as a `what` message.
+   *
+   * The message gets its own reference, which is dropped again if the
+   * message cannot be delivered.
+   */
+  status_t SendTo(const BMessenger &target, uint32 what);
+
+  /**
+   * @brief Takes over the reference carried by `msg`.
+   * @return The batch (empty reference if `msg` carries none). The pointer
+   * is removed from the message so it cannot be released twice.
+   */
+  static BReference<MediaBatch> Detach(BMessage *msg);
+};
+
+#endif // BETON_MEDIA_BATCH_H
@@ -0,0 +1,306 @@
+#include "MediaCacheFile.h"
+#include "Debug.h"
+
+#include <string.h>
+
+// ============================================================================
+// MediaCacheWriter
+// ============================================================================
+
+MediaCacheWriter::MediaCacheWriter() : fItemCount(0) {}
+
+/**
+ * @brief Pre-allocates column storage for `itemCount` records.
+ */
+void MediaCacheWriter::Reserve(size_t itemCount) {
+  fStringRefs.reserve(itemCount * kCacheStringFieldCount);
+  for (auto &column : fInt32Columns)
+    column.reserve(itemCount);
+  for (auto &column : fInt64Columns)
+    column.reserve(itemCount);
+  fFlags.reserve(itemCount);
+}
+
+/**
+ * @brief Appends a record for `item` to all columns.
+ */
+void MediaCacheWriter::AddItem(const MediaItem &item) {
+  fStringRefs.push_back(fStrings.Intern(item.path));
+  fStringRefs.push_back(fStrings.Intern(item.base));
+  fStringRefs.push_back(fStrings.Intern(item.title));
+  fStringRefs.push_back(fStrings.Intern(item.artist));
+  fStringRefs.push_back(fStrings.Intern(item.album));
+  fStringRefs.push_back(fStrings.Intern(item.albumArtist));
+  fStringRefs.push_back(fStrings.Intern(item.genre));
+  fStringRefs.push_back(fStrings.Intern(item.comment));
+  fStringRefs.push_back(fStrings.Intern(item.composer));
+  fStringRefs.push_back(fStrings.Intern(item.mbTrackId));
+  fStringRefs.push_back(fStrings.Intern(item.mbAlbumId));
+  fStringRefs.push_back(fStrings.Intern(item.mbArtistId));
+  fStringRefs.push_back(fStrings.Intern(item.acoustId));
+
+  fInt32Columns[kCacheYear].push_back(item.year);
+  fInt32Columns[kCacheTrack].push_back(item.track);
+  fInt32Columns[kCacheTrackTotal].push_back(item.trackTotal);
+  fInt32Columns[kCacheDisc].push_back(item.disc);
+  fInt32Columns[kCacheDiscTotal].push_back(item.discTotal);
+  fInt32Columns[kCacheDuration].push_back(item.duration);
+  fInt32Columns[kCacheBitrate].push_back(item.bitrate);
+  fInt32Columns[kCacheSampleRate].push_back(item.sampleRate);
+  fInt32Columns[kCacheChannels].push_back(item.channels);
+  fInt32Columns[kCacheRating].push_back(item.rating);
+  fInt32Columns[kCacheTrackGain].push_back(item.trackGain);
+  fInt32Columns[kCacheTrackPeak].push_back(item.trackPeak);
+  fInt32Columns[kCacheAlbumGain].push_back(item.albumGain);
+  fInt32Columns[kCacheAlbumPeak].push_back(item.albumPeak);
+
+  fInt64Columns[kCacheSize].push_back(item.size);
+  fInt64Columns[kCacheMtime].push_back(item.mtime);
+  fInt64Columns[kCacheInode].push_back(item.inode);
+
+  fFlags.push_back(item.missing ? kCacheFlagMissing : 0);
+  fItemCount++;
+}
+
+/**
+ * @brief Writes the collected columns to `path` atomically.
+ *
+ * Data goes to `<path>.tmp` first; only a completely written file is renamed
+ * over the previous cache.
+ */
+status_t MediaCacheWriter::WriteTo(const char *path, CacheCodec codec) const {
+  MediaCacheHeader header;
+  memset(&header, 0, sizeof(header));
+  header.magic = kMediaCacheMagic;
+  header.version = kMediaCacheVersion;
+  header.itemCount = fItemCount;
+  header.stringCount = fStrings.CountStrings();
+
+  const std::vector<uint32> &stringOffsets = fStrings.Offsets();
+  const std::vector<char> &blob = fStrings.Blob();
+
+  uint64 offset = CacheAlignOffset(sizeof(header));
+  header.stringRefsOffset = offset;
+  offset = CacheAlignOffset(offset + fStringRefs.size() * sizeof(uint32));
+  header.int32ColumnsOffset = offset;
+  offset = CacheAlignOffset(offset + (uint64)kCacheInt32ColumnCount * fItemCount *
+                                    sizeof(int32));
+  header.int64ColumnsOffset = offset;
+  offset = CacheAlignOffset(offset + (uint64)kCacheInt64ColumnCount * fItemCount *
+                                    sizeof(int64));
+  header.flagsOffset = offset;
+  offset = CacheAlignOffset(offset + fFlags.size());
+  header.stringOffsetsOffset = offset;
+  offset = CacheAlignOffset(offset + stringOffsets.size() * sizeof(uint32));
+  header.blobOffset = offset;
+  header.blobSize = blob.size();
+
+  CacheFileWriter file(path, header.blobOffset + header.blobSize, codec);
+  status_t status = file.InitCheck();
+  if (status != B_OK)
+    return status;
+  auto writeAt = [&](uint64 at, const void *data, size_t size) {
+    file.WriteAt(at, data, size);
+  };
+
+  writeAt(0, &header, sizeof(header));
+  writeAt(header.stringRefsOffset, fStringRefs.data(),
+          fStringRefs.size() * sizeof(uint32));
+  for (int32 c = 0; c < kCacheInt32ColumnCount; c++) {
+    writeAt(header.int32ColumnsOffset + (uint64)c * fItemCount * sizeof(int32),
+            fInt32Columns[c].data(), fInt32Columns[c].size() * sizeof(int32));
+  }
+  for (int32 c = 0; c < kCacheInt64ColumnCount; c++) {
+    writeAt(header.int64ColumnsOffset + (uint64)c * fItemCount * sizeof(int64),
+            fInt64Columns[c].data(), fInt64Columns[c].size() * sizeof(int64));
+  }
+  writeAt(header.flagsOffset, fFlags.data(), fFlags.size());
+  writeAt(header.stringOffsetsOffset, stringOffsets.data(),
+          stringOffsets.size() * sizeof(uint32));
+  writeAt(header.blobOffset, blob.data(), blob.size());
+
+  return file.Commit();
+}
+
+// ============================================================================
+// MediaCacheReader
+// ============================================================================
+
+MediaCacheReader::MediaCacheReader()
+    : fHeader(nullptr), fStringRefs(nullptr), fInt32Columns(nullptr),
+      fInt32ColumnCount(0), fInt64Columns(nullptr), fFlags(nullptr) {}
+
+MediaCacheReader::~MediaCacheReader() { Close(); }
+
+/**
+ * @brief Releases the mapping and drops materialized strings.
+ */
+void MediaCacheReader::Close() {
+  fFile.Close();
+  fHeader = nullptr;
+  fStringRefs = nullptr;
+  fInt32Columns = nullptr;
+  fInt32ColumnCount = 0;
+  fInt64Columns = nullptr;
+  fFlags = nullptr;
+  fStrings.Unset();
+}
+
+/**
+ * @brief Maps `path` read-only and validates the header and section bounds.
+ */
+status_t MediaCacheReader::Open(const char *path) {
+  Close();
+
+  status_t status = fFile.Open(path, sizeof(MediaCacheHeader));
+  if (status != B_OK)
+    return status;
+
+  // Cheap magic/version probe so v2 files are rejected before mapping.
+  MediaCacheHeader probe;
+  if (!fFile.Probe(&probe, sizeof(probe), 0) ||
+      probe.magic != kMediaCacheMagic ||
+      probe.version < kMediaCacheMinVersion ||
+      probe.version > kMediaCacheVersion) {
+    Close();
+    return B_BAD_DATA;
+  }
+  fInt32ColumnCount = probe.version >= 4 ? (int32)kCacheInt32ColumnCount
+                                         : kCacheInt32ColumnCountV3;
+
+  status = fFile.Map();
+  if (status != B_OK) {
+    Close();
+    return status;
+  }
+
+  const char *base = fFile.Data();
+  fHeader = (const MediaCacheHeader *)base;
+
+  const uint64 items = fHeader->itemCount;
+  const uint64 strings = fHeader->stringCount;
+
+  if (strings == 0 ||
+      !fFile.InBounds(fHeader->stringRefsOffset,
+                      items * kCacheStringFieldCount * sizeof(uint32)) ||
+      !fFile.InBounds(fHeader->int32ColumnsOffset,
+                      items * fInt32ColumnCount * sizeof(int32)) ||
+      !fFile.InBounds(fHeader->int64ColumnsOffset,
+                      items * kCacheInt64ColumnCount * sizeof(int64)) ||
+      !fFile.InBounds(fHeader->flagsOffset, items) ||
+      !fFile.InBounds(fHeader->stringOffsetsOffset, strings * sizeof(uint32)) ||
+      !fFile.InBounds(fHeader->blobOffset, fHeader->blobSize)) {
+    DEBUG_PRINT("MediaCacheReader: section out of bounds in %s\n", path);
+    Close();
+    return B_BAD_DATA;
+  }
+
+  fStringRefs = (const uint32 *)(base + fHeader->stringRefsOffset);
+  fInt32Columns = (const int32 *)(base + fHeader->int32ColumnsOffset);
+  fInt64Columns = (const int64 *)(base + fHeader->int64ColumnsOffset);
+  fFlags = (const uint8 *)(base + fHeader->flagsOffset);
+
+  // Validate every string entry once so accessors can stay unchecked.
+  if (fStrings.SetTo((const uint32 *)(base + fHeader->stringOffsetsOffset),
+                     (uint32)strings, base + fHeader->blobOffset,
+                     fHeader->blobSize) != B_OK) {
+    Close();
+    return B_BAD_DATA;
+  }
+  const uint64 refCount = items * kCacheStringFieldCount;
+  for (uint64 i = 0; i < refCount; i++) {
+    if (fStringRefs[i] >= strings) {
+      Close();
+      return B_BAD_DATA;
+    }
+  }
+  return B_OK;
+}
+
+uint32 MediaCacheReader::_Ordinal(uint32 index,
+                                  MediaCacheStringField field) const {
+  return fStringRefs[(size_t)index * kCacheStringFieldCount + field];
+}
+
+const char *MediaCacheReader::StringField(uint32 index,
+                                          MediaCacheStringField field,
+                                          uint32 *outLength) const {
+  if (fHeader == nullptr || index >= fHeader->itemCount) {
+    if (outLength != nullptr)
+      *outLength = 0;
+    return "";
+  }
+  return fStrings.StringAt(_Ordinal(index, field), outLength);
+}
+
+/**
+ * @brief Returns the materialized `BString` for a field.
+ */
+const BString &MediaCacheReader::StringFieldAsBString(
+    uint32 index, MediaCacheStringField field) {
+  if (fHeader == nullptr || index >= fHeader->itemCount)
+    return fEmpty;
+
+  return fStrings.BStringAt(_Ordinal(index, field));
+}
+
+int32 MediaCacheReader::Int32Field(uint32 index,
+                                   MediaCacheInt32Column column) const {
+  if (fHeader == nullptr || index >= fHeader->itemCount ||
+      column >= fInt32ColumnCount)
+    return 0;
+  return fInt32Columns[(size_t)column * fHeader->itemCount + index];
+}
+
+int64 MediaCacheReader::Int64Field(uint32 index,
+                                   MediaCacheInt64Column column) const {
+  if (fHeader == nullptr || index >= fHeader->itemCount)
+    return 0;
+  return fInt64Columns[(size_t)column * fHeader->itemCount + index];
+}
+
+uint8 MediaCacheReader::Flags(uint32 index) const {
+  if (fHeader == nullptr || index >= fHeader->itemCount)
+    return 0;
+  return fFlags[index];
+}
+
+/**
+ * @brief Materializes one complete record into `out`.
+ */
+void MediaCacheReader::ReadItem(uint32 index, MediaItem &out) {
+  out.path = StringFieldAsBString(index, kCachePath);
+  out.base = StringFieldAsBString(index, kCacheBase);
+  out.title = StringFieldAsBString(index, kCacheTitle);
+  out.artist = StringFieldAsBString(index, kCacheArtist);
+  out.album = StringFieldAsBString(index, kCacheAlbum);
+  out.albumArtist = StringFieldAsBString(index, kCacheAlbumArtist);
+  out.genre = StringFieldAsBString(index, kCacheGenre);
+  out.comment = StringFieldAsBString(index, kCacheComment);
+  out.composer = StringFieldAsBString(index, kCacheComposer);
+  out.mbTrackId = StringFieldAsBString(index, kCacheMbTrackId);
+  out.mbAlbumId = StringFieldAsBString(index, kCacheMbAlbumId);
+  out.mbArtistId = StringFieldAsBString(index, kCacheMbArtistId);
+  out.acoustId = StringFieldAsBString(index, kCacheAcoustId);
+
+  out.year = Int32Field(index, kCacheYear);
+  out.track = Int32Field(index, kCacheTrack);
+  out.trackTotal = Int32Field(index, kCacheTrackTotal);
+  out.disc = Int32Field(index, kCacheDisc);
+  out.discTotal = Int32Field(index, kCacheDiscTotal);
+  out.duration = Int32Field(index, kCacheDuration);
+  out.bitrate = Int32Field(index, kCacheBitrate);
+  out.sampleRate = Int32Field(index, kCacheSampleRate);
+  out.channels = Int32Field(index, kCacheChannels);
+  out.rating = Int32Field(index, kCacheRating);
+  out.trackGain = Int32Field(index, kCacheTrackGain);
+  out.trackPeak = Int32Field(index, kCacheTrackPeak);
+  out.albumGain = Int32Field(index, kCacheAlbumGain);
+  out.albumPeak = Int32Field(index, kCacheAlbumPeak);
+
+  out.size = Int64Field(index, kCacheSize);
+  out.mtime = Int64Field(index, kCacheMtime);
+  out.inode = Int64Field(index, kCacheInode);
+
+  out.missing = (Flags(index) & kCacheFlagMissing) != 0;
+}
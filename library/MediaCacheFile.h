@@ -0,0 +1,243 @@
+#ifndef BETON_MEDIA_CACHE_FILE_H
+#define BETON_MEDIA_CACHE_FILE_H
+
+#include "CacheStringTable.h"
+#include "MediaItem.h"
+
+#include <String.h>
+#include <SupportDefs.h>
+#include <vector>
+
+/**
+ * @file MediaCacheFile.h
+ * @brief Memory-mapped, columnar on-disk format (v4) for `media.cache`.
+ *
+ * Layout (all offsets are absolute and 8-byte aligned):
+ * - `MediaCacheHeader`
+ * - String reference table: `itemCount * kCacheStringFieldCount` uint32
+ *   ordinals into the string table (ordinal 0 is always the empty string).
+ * - Numeric columns: one int32 column per `MediaCacheInt32Column`, one int64
+ *   column per `MediaCacheInt64Column`, one uint8 flags column.
+ * - String offset table and blob: a `CacheStringTable`.
+ *
+ * v4 only appended the loudness int32 columns; v3 files are still read and
+ * report 0 (not analyzed) for them.
+ *
+ * The file may be block-compressed as a whole (see CacheCompression.h); the
+ * reader then sees the same layout in the decompressed image.
+ *
+ * MediaLibraryCache still turns every record into a `MediaItem` at load.
+ * A `MediaItem` owns its strings, and the search, facet and sort indexes
+ * read most of them right after the load. Each distinct string is copied
+ * out of the mapping only once and shared by every record that uses it
+ * (StringFieldAsBString()). A field therefore costs a lookup and a
+ * reference instead of v2's read, allocation and copy. library_bench's
+ * cache_open (mapping only) against cache_load (every item) measures what
+ * building the items costs.
+ */
+
+/** @brief Magic shared by all binary cache versions. */
+static const uint32 kMediaCacheMagic = 'BTCA';
+/** @brief Current format version written by `MediaCacheWriter`. */
+static const uint32 kMediaCacheVersion = 4;
+/** @brief Oldest version MediaCacheReader still maps. */
+static const uint32 kMediaCacheMinVersion = 3;
+
+/** @brief String fields stored per record, in on-disk order. */
+enum MediaCacheStringField {
+  kCachePath = 0,
+  kCacheBase,
+  kCacheTitle,
+  kCacheArtist,
+  kCacheAlbum,
+  kCacheAlbumArtist,
+  kCacheGenre,
+  kCacheComment,
+  kCacheComposer,
+  kCacheMbTrackId,
+  kCacheMbAlbumId,
+  kCacheMbArtistId,
+  kCacheAcoustId,
+  kCacheStringFieldCount
+};
+
+/** @brief int32 columns, in on-disk order. */
+enum MediaCacheInt32Column {
+  kCacheYear = 0,
+  kCacheTrack,
+  kCacheTrackTotal,
+  kCacheDisc,
+  kCacheDiscTotal,
+  kCacheDuration,
+  kCacheBitrate,
+  kCacheSampleRate,
+  kCacheChannels,
+  kCacheRating,
+  kCacheTrackGain,
+  kCacheTrackPeak,
+  kCacheAlbumGain,
+  kCacheAlbumPeak,
+  kCacheInt32ColumnCount
+};
+
+/** @brief int32 columns present in v3 files. */
+static const int32 kCacheInt32ColumnCountV3 = kCacheRating + 1;
+
+/** @brief int64 columns, in on-disk order. */
+enum MediaCacheInt64Column {
+  kCacheSize = 0,
+  kCacheMtime,
+  kCacheInode,
+  kCacheInt64ColumnCount
+};
+
+/** @brief Record flag: file was not found during the last scan. */
+static const uint8 kCacheFlagMissing = 1;
+
+/**
+ * @struct MediaCacheHeader
+ * @brief Fixed-size file header of a v3/v4 cache file.
+ */
+struct MediaCacheHeader {
+  uint32 magic;
+  uint32 version;
+  uint32 itemCount;
+  uint32 stringCount;
+  uint64 stringRefsOffset;
+  uint64 int32ColumnsOffset;
+  uint64 int64ColumnsOffset;
+  uint64 flagsOffset;
+  uint64 stringOffsetsOffset;
+  uint64 blobOffset;
+  uint64 blobSize;
+  uint64 reserved[2];
+};
+
+/**
+ * @class MediaCacheWriter
+ * @brief Collects `MediaItem`s into columns and writes a v4 cache file.
+ *
+ * Equal strings are stored once in the blob. The file is written to a
+ * temporary sibling and renamed over the target, so a crash mid-write keeps
+ * the previous cache intact.
+ */
+class MediaCacheWriter {
+public:
+  MediaCacheWriter();
+
+  /**
+   * @brief Pre-allocates column storage.
+   * @param itemCount Expected number of items.
+   */
+  void Reserve(size_t itemCount);
+
+  /**
+   * @brief Appends one item to the record table.
+   * @param item Item to serialize.
+   */
+  void AddItem(const MediaItem &item);
+
+  /** @brief Number of records added so far. */
+  uint32 CountItems() const { return fItemCount; }
+
+  /** @brief Number of distinct strings (including the empty string). */
+  uint32 CountStrings() const { return fStrings.CountStrings(); }
+
+  /**
+   * @brief Writes all collected records to `path`.
+   * @param path Destination file path.
+   * @param codec Block compression; by default chosen from the measured
+   * read throughput.
+   * @return `B_OK` on success or a storage error code.
+   */
+  status_t WriteTo(const char *path,
+                   CacheCodec codec = kCacheCodecAuto) const;
+
+private:
+  uint32 fItemCount;
+  std::vector<uint32> fStringRefs;
+  std::vector<int32> fInt32Columns[kCacheInt32ColumnCount];
+  std::vector<int64> fInt64Columns[kCacheInt64ColumnCount];
+  std::vector<uint8> fFlags;
+  CacheStringTableWriter fStrings;
+};
+
+/**
+ * @class MediaCacheReader
+ * @brief Memory-maps a v3/v4 cache file and materializes items on demand.
+ *
+ * Strings stay in the mapping until a caller reads them. Each distinct string
+ * is turned into a `BString` at most once; later reads of the same ordinal
+ * return a shallow copy that shares the buffer.
+ */
+class MediaCacheReader {
+public:
+  MediaCacheReader();
+  ~MediaCacheReader();
+
+  /**
+   * @brief Maps and validates a v3/v4 cache file.
+   * @param path Cache file path.
+   * @return `B_OK`, `B_ENTRY_NOT_FOUND`, or `B_BAD_DATA` when the file is
+   *         not a valid v3/v4 cache (callers then fall back to older
+   *         loaders).
+   */
+  status_t Open(const char *path);
+
+  /** @brief Unmaps the file and drops materialized strings. */
+  void Close();
+
+  /** @brief Number of records in the mapped file. */
+  uint32 CountItems() const { return fHeader ? fHeader->itemCount : 0; }
+
+  /** @brief Read and decompression figures of Open(). */
+  const CacheLoadStats &LoadStats() const { return fFile.LoadStats(); }
+
+  /**
+   * @brief Returns a field of a record without creating a `BString`.
+   * @param index Record index.
+   * @param field String field.
+   * @param outLength Optional length in bytes.
+   * @return Pointer into the mapping (NUL-terminated), never `nullptr`.
+   */
+  const char *StringField(uint32 index, MediaCacheStringField field,
+                          uint32 *outLength = nullptr) const;
+
+  /**
+   * @brief Returns a field of a record as a shared `BString`.
+   */
+  const BString &StringFieldAsBString(uint32 index,
+                                      MediaCacheStringField field);
+
+  /** @brief Reads an int32 column value; 0 for columns the file lacks. */
+  int32 Int32Field(uint32 index, MediaCacheInt32Column column) const;
+
+  /** @brief Reads an int64 column value. */
+  int64 Int64Field(uint32 index, MediaCacheInt64Column column) const;
+
+  /** @brief Reads the flags of a record. */
+  uint8 Flags(uint32 index) const;
+
+  /**
+   * @brief Fills a complete `MediaItem` from one record.
+   * @param index Record index.
+   * @param out Destination item.
+   */
+  void ReadItem(uint32 index, MediaItem &out);
+
+private:
+  uint32 _Ordinal(uint32 index, MediaCacheStringField field) const;
+
+  CacheFileMapping fFile;
+  const MediaCacheHeader *fHeader;
+
+  const uint32 *fStringRefs;
+  const int32 *fInt32Columns;
+  int32 fInt32ColumnCount; ///< Depends on the file version
+  const int64 *fInt64Columns;
+  const uint8 *fFlags;
+  CacheStringTableReader fStrings;
+  BString fEmpty;
+};
+
+#endif // BETON_MEDIA_CACHE_FILE_H
@@ -0,0 +1,304 @@
+#include "MediaCacheJournal.h"
+#include "Debug.h"
+
+#include <Entry.h>
+#include <File.h>
+#include <Path.h>
+
+#include <string.h>
+
+namespace {
+
+/** @brief Appends raw bytes to a record buffer. */
+void PutBytes(std::vector<char> &out, const void *data, size_t size) {
+  const char *p = (const char *)data;
+  out.insert(out.end(), p, p + size);
+}
+
+template <typename T> void Put(std::vector<char> &out, T value) {
+  PutBytes(out, &value, sizeof(value));
+}
+
+void PutString(std::vector<char> &out, const BString &s) {
+  Put<uint32>(out, (uint32)s.Length());
+  PutBytes(out, s.String(), s.Length());
+}
+
+/**
+ * @brief Bounds-checked cursor over one record payload.
+ */
+struct PayloadReader {
+  const char *data;
+  size_t size;
+  size_t pos = 0;
+  bool ok = true;
+
+  template <typename T> T Get() {
+    T value{};
+    if (!ok || size - pos < sizeof(T)) {
+      ok = false;
+      return value;
+    }
+    memcpy(&value, data + pos, sizeof(T));
+    pos += sizeof(T);
+    return value;
+  }
+
+  void GetString(BString &out) {
+    uint32 len = Get<uint32>();
+    if (!ok || size - pos < len) {
+      ok = false;
+      return;
+    }
+    out.SetTo(data + pos, len);
+    pos += len;
+  }
+};
+
+void PutItem(std::vector<char> &out, const MediaItem &e) {
+  PutString(out, e.path);
+  PutString(out, e.base);
+  PutString(out, e.title);
+  PutString(out, e.artist);
+  PutString(out, e.album);
+  PutString(out, e.albumArtist);
+  PutString(out, e.genre);
+  PutString(out, e.comment);
+  PutString(out, e.composer);
+  PutString(out, e.mbTrackId);
+  PutString(out, e.mbAlbumId);
+  PutString(out, e.mbArtistId);
+  PutString(out, e.acoustId);
+
+  Put(out, e.year);
+  Put(out, e.track);
+  Put(out, e.trackTotal);
+  Put(out, e.disc);
+  Put(out, e.discTotal);
+  Put(out, e.duration);
+  Put(out, e.bitrate);
+  Put(out, e.sampleRate);
+  Put(out, e.channels);
+  Put(out, e.rating);
+  Put(out, e.size);
+  Put(out, e.mtime);
+  Put(out, e.inode);
+  Put<uint8>(out, e.missing ? 1 : 0);
+  Put(out, e.trackGain);
+  Put(out, e.trackPeak);
+  Put(out, e.albumGain);
+  Put(out, e.albumPeak);
+}
+
+bool GetItem(PayloadReader &in, MediaItem &e) {
+  in.GetString(e.path);
+  in.GetString(e.base);
+  in.GetString(e.title);
+  in.GetString(e.artist);
+  in.GetString(e.album);
+  in.GetString(e.albumArtist);
+  in.GetString(e.genre);
+  in.GetString(e.comment);
+  in.GetString(e.composer);
+  in.GetString(e.mbTrackId);
+  in.GetString(e.mbAlbumId);
+  in.GetString(e.mbArtistId);
+  in.GetString(e.acoustId);
+
+  e.year = in.Get<int32>();
+  e.track = in.Get<int32>();
+  e.trackTotal = in.Get<int32>();
+  e.disc = in.Get<int32>();
+  e.discTotal = in.Get<int32>();
+  e.duration = in.Get<int32>();
+  e.bitrate = in.Get<int32>();
+  e.sampleRate = in.Get<int32>();
+  e.channels = in.Get<int32>();
+  e.rating = in.Get<int32>();
+  e.size = in.Get<int64>();
+  e.mtime = in.Get<int64>();
+  e.inode = in.Get<int64>();
+  e.missing = (in.Get<uint8>() & 1) != 0;
+  // Loudness was appended later; older records simply end here.
+  if (in.ok && in.size - in.pos >= 4 * sizeof(int32)) {
+    e.trackGain = in.Get<int32>();
+    e.trackPeak = in.Get<int32>();
+    e.albumGain = in.Get<int32>();
+    e.albumPeak = in.Get<int32>();
+  }
+  return in.ok;
+}
+
+/** @brief Size of the per-record header (`op` + payload size). */
+const size_t kRecordHeaderSize = sizeof(uint8) + sizeof(uint32);
+
+} // namespace
+
+MediaCacheJournal::MediaCacheJournal(const BString &cachePath)
+    : fPath(cachePath) {
+  fPath << ".journal";
+  fRotatedPath = fPath;
+  fRotatedPath << ".1";
+}
+
+/**
+ * @brief Serializes an upsert into the pending buffer.
+ */
+void MediaCacheJournal::AddUpsert(const MediaItem &item) {
+  const size_t headerPos = fBuffer.size();
+  Put<uint8>(fBuffer, kJournalUpsert);
+  Put<uint32>(fBuffer, 0);
+  PutItem(fBuffer, item);
+
+  const uint32 payload = (uint32)(fBuffer.size() - headerPos -
+                                  kRecordHeaderSize);
+  memcpy(fBuffer.data() + headerPos + sizeof(uint8), &payload,
+         sizeof(payload));
+}
+
+/**
+ * @brief Serializes a tombstone into the pending buffer.
+ */
+void MediaCacheJournal::AddTombstone(const BString &path) {
+  Put<uint8>(fBuffer, kJournalTombstone);
+  Put<uint32>(fBuffer, (uint32)(sizeof(uint32) + path.Length()));
+  PutString(fBuffer, path);
+}
+
+/**
+ * @brief Appends the pending buffer to the live journal.
+ *
+ * The buffer is dropped either way: on error the caller writes a snapshot,
+ * which already holds these changes, so replaying them later over it could
+ * only bring back older values. A partial append is cut off again so the
+ * next record does not follow a torn one.
+ */
+status_t MediaCacheJournal::Commit() {
+  if (fBuffer.empty())
+    return B_OK;
+
+  BFile file(fPath.String(), B_WRITE_ONLY | B_CREATE_FILE | B_OPEN_AT_END);
+  status_t status = file.InitCheck();
+  off_t size = 0;
+  if (status == B_OK)
+    status = file.GetSize(&size);
+  if (status != B_OK) {
+    fBuffer.clear();
+    return status;
+  }
+
+  ssize_t written = file.Write(fBuffer.data(), fBuffer.size());
+  if (written != (ssize_t)fBuffer.size()) {
+    DEBUG_PRINT("MediaCacheJournal: short write to %s\n", fPath.String());
+    if (file.SetSize(size) != B_OK)
+      DEBUG_PRINT("MediaCacheJournal: cannot truncate %s\n", fPath.String());
+    fBuffer.clear();
+    return written < 0 ? (status_t)written : B_IO_ERROR;
+  }
+
+  fBuffer.clear();
+  return B_OK;
+}
+
+off_t MediaCacheJournal::Size() const {
+  BEntry entry(fPath.String());
+  off_t size = 0;
+  if (entry.GetSize(&size) != B_OK)
+    return 0;
+  return size;
+}
+
+status_t MediaCacheJournal::Rotate() {
+  BEntry live(fPath.String());
+  if (!live.Exists())
+    return B_OK;
+
+  BEntry rotated(fRotatedPath.String());
+  if (!rotated.Exists()) {
+    BPath path(fRotatedPath.String());
+    return live.Rename(path.Leaf(), false);
+  }
+
+  // A previous compaction did not finish; keep its records in front.
+  BFile in(fPath.String(), B_READ_ONLY);
+  BFile out(fRotatedPath.String(), B_WRITE_ONLY | B_OPEN_AT_END);
+  status_t status = in.InitCheck() != B_OK ? in.InitCheck() : out.InitCheck();
+  if (status != B_OK)
+    return status;
+
+  char buffer[16 * 1024];
+  ssize_t bytes;
+  while ((bytes = in.Read(buffer, sizeof(buffer))) > 0) {
+    if (out.Write(buffer, bytes) != bytes)
+      return B_IO_ERROR;
+  }
+  return live.Remove();
+}
+
+void MediaCacheJournal::RemoveRotated() {
+  BEntry rotated(fRotatedPath.String());
+  if (rotated.Exists())
+    rotated.Remove();
+}
+
+void MediaCacheJournal::RemoveAll() {
+  RemoveRotated();
+  BEntry live(fPath.String());
+  if (live.Exists())
+    live.Remove();
+}
+
+int32 MediaCacheJournal::Replay(
+    const std::function<void(MediaItem &)> &upsert,
+    const std::function<void(const BString &)> &tombstone) const {
+  return _ReplayFile(fRotatedPath, upsert, tombstone) +
+         _ReplayFile(fPath, upsert, tombstone);
+}
+
+int32 MediaCacheJournal::_ReplayFile(
+    const BString &path, const std::function<void(MediaItem &)> &upsert,
+    const std::function<void(const BString &)> &tombstone) {
+  BFile file(path.String(), B_READ_ONLY);
+  if (file.InitCheck() != B_OK)
+    return 0;
+
+  off_t size = 0;
+  if (file.GetSize(&size) != B_OK || size <= 0)
+    return 0;
+
+  std::vector<char> data((size_t)size);
+  if (file.ReadAt(0, data.data(), data.size()) != (ssize_t)data.size())
+    return 0;
+
+  int32 applied = 0;
+  size_t pos = 0;
+  while (data.size() - pos >= kRecordHeaderSize) {
+    uint8 op = (uint8)data[pos];
+    uint32 payload;
+    memcpy(&payload, data.data() + pos + sizeof(uint8), sizeof(payload));
+    pos += kRecordHeaderSize;
+    if (data.size() - pos < payload) {
+      DEBUG_PRINT("MediaCacheJournal: truncated record in %s\n",
+                  path.String());
+      break;
+    }
+
+    PayloadReader in{data.data() + pos, payload};
+    if (op == kJournalUpsert) {
+      MediaItem item;
+      if (GetItem(in, item)) {
+        upsert(item);
+        applied++;
+      }
+    } else if (op == kJournalTombstone) {
+      BString removed;
+      in.GetString(removed);
+      if (in.ok) {
+        tombstone(removed);
+        applied++;
+      }
+    }
+    pos += payload;
+  }
+  return applied;
+}
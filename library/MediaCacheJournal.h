@@ -0,0 +1,100 @@
+#ifndef BETON_MEDIA_CACHE_JOURNAL_H
+#define BETON_MEDIA_CACHE_JOURNAL_H
+
+#include "MediaItem.h"
+
+#include <String.h>
+#include <SupportDefs.h>
+#include <functional>
+#include <vector>
+
+/**
+ * @file MediaCacheJournal.h
+ * @brief Append-only change log stored next to `media.cache`.
+ *
+ * Each record is `uint8 op`, `uint32 payloadSize`, payload. Upserts carry a
+ * complete serialized `MediaItem`; tombstones carry only the path. Replaying
+ * a record is idempotent, so a journal that was already folded into a
+ * snapshot can safely be applied again after a crash.
+ *
+ * During compaction the live journal is rotated to `<journal>.1`, which is
+ * removed once the new snapshot is on disk. Readers replay the rotated file
+ * before the live one.
+ */
+
+/** @brief Journal record opcodes. */
+enum MediaCacheJournalOp {
+  kJournalUpsert = 1,
+  kJournalTombstone = 2
+};
+
+/**
+ * @class MediaCacheJournal
+ * @brief Buffers and appends cache change records.
+ */
+class MediaCacheJournal {
+public:
+  /**
+   * @param cachePath Path of the snapshot file; the journal uses
+   *        `<cachePath>.journal`.
+   */
+  explicit MediaCacheJournal(const BString &cachePath);
+
+  /** @brief Queues an upsert record for `item`. */
+  void AddUpsert(const MediaItem &item);
+
+  /** @brief Queues a tombstone record for `path`. */
+  void AddTombstone(const BString &path);
+
+  /** @brief Returns whether records are waiting for Commit(). */
+  bool HasPending() const { return !fBuffer.empty(); }
+
+  /**
+   * @brief Appends all queued records with a single write.
+   * @return `B_OK` or a storage error. Queued records are dropped on error
+   *         and a partial append is truncated; the caller then writes a
+   *         snapshot instead.
+   */
+  status_t Commit();
+
+  /** @brief Size of the live journal on disk in bytes. */
+  off_t Size() const;
+
+  /**
+   * @brief Moves the live journal aside before a snapshot is written.
+   *
+   * If an older rotated journal is still present (a previous compaction
+   * failed), the live journal is appended to it instead.
+   */
+  status_t Rotate();
+
+  /** @brief Deletes the rotated journal after a successful snapshot. */
+  void RemoveRotated();
+
+  /** @brief Deletes both journal files (the snapshot is authoritative). */
+  void RemoveAll();
+
+  /** @brief Path of the rotated journal. */
+  const BString &RotatedPath() const { return fRotatedPath; }
+
+  /**
+   * @brief Replays rotated and live journals in order.
+   * @param upsert Called for each upsert record.
+   * @param tombstone Called for each tombstone record.
+   * @return Number of records applied. A truncated trailing record (for
+   *         example after a crash during append) is ignored.
+   */
+  int32 Replay(const std::function<void(MediaItem &)> &upsert,
+               const std::function<void(const BString &)> &tombstone) const;
+
+private:
+  static int32 _ReplayFile(const BString &path,
+                           const std::function<void(MediaItem &)> &upsert,
+                           const std::function<void(const BString &)> &tombstone);
+
+  BString fPath;
+  BString fRotatedPath;
+  std::vector<char> fBuffer;
+};
+
+#endif // BETON_MEDIA_CACHE_JOURNAL_H
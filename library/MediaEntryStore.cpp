@@ -0,0 +1,401 @@
+#include "MediaEntryStore.h"
+
+#include <string.h>
+#include <utility>
+
+uint32 HashMediaPath(const char *path, int32 length) {
+  uint32 hash = 2166136261u;
+  for (int32 i = 0; i < length; i++) {
+    hash ^= (uint8)path[i];
+    hash *= 16777619u;
+  }
+  return hash;
+}
+
+/** @brief Hash for the inode index (64-bit mix folded to size_t). */
+static inline size_t HashInode(int64 inode) {
+  uint64 x = (uint64)inode;
+  x ^= x >> 33;
+  x *= 0xff51afd7ed558ccdULL;
+  x ^= x >> 33;
+  return (size_t)x;
+}
+
+/**
+ * @brief Returns whether slot `j` may be moved to the hole at `i` given its
+ * ideal slot `k` (linear probing, backward-shift deletion).
+ */
+static inline bool CanShiftBack(size_t i, size_t j, size_t k) {
+  if (j > i)
+    return k <= i || k > j;
+  return k <= i && k > j;
+}
+
+// ============================================================================
+// MediaPathIndex
+// ============================================================================
+
+MediaPathIndex::MediaPathIndex() : fCount(0) {}
+
+void MediaPathIndex::Clear() {
+  for (Slot &slot : fSlots) {
+    slot.key = "";
+    slot.position = kNotFound;
+  }
+  fCount = 0;
+}
+
+void MediaPathIndex::Reserve(size_t count) {
+  if ((count + 1) * 2 > fSlots.size())
+    _Grow(count * 2);
+}
+
+/**
+ * @brief Returns the slot holding `path` or the empty slot ending its probe.
+ */
+size_t MediaPathIndex::_Probe(const char *path, int32 length,
+                              uint32 hash) const {
+  const size_t mask = fSlots.size() - 1;
+  size_t i = hash & mask;
+  while (fSlots[i].position != kNotFound) {
+    const Slot &slot = fSlots[i];
+    if (slot.hash == hash && slot.key.Length() == length &&
+        memcmp(slot.key.String(), path, length) == 0)
+      return i;
+    i = (i + 1) & mask;
+  }
+  return i;
+}
+
+/**
+ * @brief Rehashes into a power-of-two table with at least `minSlots` slots.
+ */
+void MediaPathIndex::_Grow(size_t minSlots) {
+  size_t slots = 16;
+  while (slots < minSlots)
+    slots <<= 1;
+
+  std::vector<Slot> old;
+  old.swap(fSlots);
+  fSlots.resize(slots);
+
+  const size_t mask = slots - 1;
+  for (Slot &slot : old) {
+    if (slot.position == kNotFound)
+      continue;
+    size_t i = slot.hash & mask;
+    while (fSlots[i].position != kNotFound)
+      i = (i + 1) & mask;
+    fSlots[i] = std::move(slot);
+  }
+}
+
+size_t MediaPathIndex::Find(const BString &path) const {
+  if (fCount == 0)
+    return kNotFound;
+  const uint32 hash = HashMediaPath(path.String(), path.Length());
+  return fSlots[_Probe(path.String(), path.Length(), hash)].position;
+}
+
+size_t MediaPathIndex::Find(const char *path) const {
+  if (fCount == 0 || path == nullptr)
+    return kNotFound;
+  const int32 length = (int32)strlen(path);
+  const uint32 hash = HashMediaPath(path, length);
+  return fSlots[_Probe(path, length, hash)].position;
+}
+
+void MediaPathIndex::Insert(const BString &path, size_t position) {
+  if ((fCount + 1) * 2 > fSlots.size())
+    _Grow(fSlots.size() * 2);
+
+  const uint32 hash = HashMediaPath(path.String(), path.Length());
+  Slot &slot = fSlots[_Probe(path.String(), path.Length(), hash)];
+  if (slot.position == kNotFound) {
+    slot.key = path;
+    slot.hash = hash;
+    fCount++;
+  }
+  slot.position = position;
+}
+
+bool MediaPathIndex::Erase(const BString &path) {
+  if (fCount == 0)
+    return false;
+
+  const uint32 hash = HashMediaPath(path.String(), path.Length());
+  size_t i = _Probe(path.String(), path.Length(), hash);
+  if (fSlots[i].position == kNotFound)
+    return false;
+
+  const size_t mask = fSlots.size() - 1;
+  size_t j = i;
+  while (true) {
+    j = (j + 1) & mask;
+    if (fSlots[j].position == kNotFound)
+      break;
+    if (CanShiftBack(i, j, fSlots[j].hash & mask)) {
+      fSlots[i] = std::move(fSlots[j]);
+      i = j;
+    }
+  }
+  fSlots[i].key = "";
+  fSlots[i].position = kNotFound;
+  fCount--;
+  return true;
+}
+
+void MediaPathIndex::Rebuild(const std::vector<MediaItem> &items) {
+  Clear();
+  Reserve(items.size());
+  for (size_t i = 0; i < items.size(); i++)
+    Insert(items[i].path, i);
+}
+
+// ============================================================================
+// MediaEntryStore
+// ============================================================================
+
+MediaEntryStore::MediaEntryStore()
+    : fInodeCount(0), fMemory(kMemoryEntries) {
+  // Track ID 0 is kInvalidTrackId.
+  fIdPositions.push_back(MediaPathIndex::kNotFound);
+  _UpdateMemory();
+}
+
+void MediaEntryStore::Reserve(size_t count) {
+  fItems.reserve(count);
+  fIds.reserve(count);
+  fPathIndex.Reserve(count);
+  if ((count + 1) * 2 > fInodeSlots.size())
+    _InodeRehash(count * 2);
+  _UpdateMemory();
+}
+
+void MediaEntryStore::Clear() {
+  for (TrackId id : fIds)
+    fIdPositions[id] = MediaPathIndex::kNotFound;
+  fItems.clear();
+  fIds.clear();
+  fPathIndex.Clear();
+  for (InodeSlot &slot : fInodeSlots)
+    slot.position = MediaPathIndex::kNotFound;
+  fInodeCount = 0;
+}
+
+void MediaEntryStore::Compact() {
+  fItems.shrink_to_fit();
+  fIds.shrink_to_fit();
+  _UpdateMemory();
+}
+
+/**
+ * @brief Reports the arrays' capacities; they only change when an item is
+ * added, storage is reserved or Compact() runs.
+ */
+void MediaEntryStore::_UpdateMemory() {
+  fMemory.Set(MemoryStats::BytesOf(fItems) + MemoryStats::BytesOf(fIds) +
+              MemoryStats::BytesOf(fIdPositions) + fPathIndex.MemoryBytes() +
+              MemoryStats::BytesOf(fInodeSlots));
+}
+
+MediaItem *MediaEntryStore::Find(const BString &path) {
+  size_t position = fPathIndex.Find(path);
+  return position == MediaPathIndex::kNotFound ? nullptr : &fItems[position];
+}
+
+const MediaItem *MediaEntryStore::Find(const BString &path) const {
+  size_t position = fPathIndex.Find(path);
+  return position == MediaPathIndex::kNotFound ? nullptr : &fItems[position];
+}
+
+const MediaItem *MediaEntryStore::FindByInode(int64 inode) const {
+  if (inode == 0 || fInodeCount == 0)
+    return nullptr;
+  const size_t mask = fInodeSlots.size() - 1;
+  size_t i = HashInode(inode) & mask;
+  while (fInodeSlots[i].position != MediaPathIndex::kNotFound) {
+    if (fInodeSlots[i].inode == inode)
+      return &fItems[fInodeSlots[i].position];
+    i = (i + 1) & mask;
+  }
+  return nullptr;
+}
+
+const MediaItem *MediaEntryStore::FindByFileStat(int64 inode, int64 size,
+                                                 int64 mtime) const {
+  if (inode == 0 || fInodeCount == 0)
+    return nullptr;
+  const size_t mask = fInodeSlots.size() - 1;
+  size_t i = HashInode(inode) & mask;
+  while (fInodeSlots[i].position != MediaPathIndex::kNotFound) {
+    const InodeSlot &slot = fInodeSlots[i];
+    if (slot.inode == inode) {
+      const MediaItem &item = fItems[slot.position];
+      if (item.size == size && item.mtime == mtime)
+        return &item;
+    }
+    i = (i + 1) & mask;
+  }
+  return nullptr;
+}
+
+const MediaItem *MediaEntryStore::FindById(TrackId id) const {
+  if (id == kInvalidTrackId || id >= fIdPositions.size())
+    return nullptr;
+  size_t position = fIdPositions[id];
+  return position == MediaPathIndex::kNotFound ? nullptr : &fItems[position];
+}
+
+MediaEntryStore::TrackId MediaEntryStore::IdOf(const BString &path) const {
+  size_t position = fPathIndex.Find(path);
+  return position == MediaPathIndex::kNotFound ? kInvalidTrackId
+                                               : fIds[position];
+}
+
+MediaEntryStore::TrackId MediaEntryStore::Put(const MediaItem &item) {
+  return Put(MediaItem(item));
+}
+
+MediaEntryStore::TrackId MediaEntryStore::Put(MediaItem &&item) {
+  size_t position = fPathIndex.Find(item.path);
+  if (position != MediaPathIndex::kNotFound) {
+    MediaItem &slot = fItems[position];
+    if (slot.inode != item.inode) {
+      _InodeErase(slot.inode, position);
+      _InodeInsert(item.inode, position);
+    }
+    slot = std::move(item);
+    return fIds[position];
+  }
+
+  position = fItems.size();
+  TrackId id = (TrackId)fIdPositions.size();
+  fIdPositions.push_back(position);
+  fIds.push_back(id);
+  fItems.push_back(std::move(item));
+
+  const MediaItem &stored = fItems.back();
+  fPathIndex.Insert(stored.path, position);
+  _InodeInsert(stored.inode, position);
+  _UpdateMemory();
+  return id;
+}
+
+bool MediaEntryStore::Remove(const BString &path) {
+  size_t position = fPathIndex.Find(path);
+  if (position == MediaPathIndex::kNotFound)
+    return false;
+  _RemoveAt(position);
+  return true;
+}
+
+bool MediaEntryStore::Rename(const BString &from, const BString &to) {
+  size_t position = fPathIndex.Find(from);
+  if (position == MediaPathIndex::kNotFound)
+    return false;
+  if (from == to)
+    return true;
+
+  // A stale entry at the destination is replaced by the moved one.
+  size_t existing = fPathIndex.Find(to);
+  if (existing != MediaPathIndex::kNotFound) {
+    _RemoveAt(existing);
+    position = fPathIndex.Find(from);
+  }
+
+  fPathIndex.Erase(from);
+  fItems[position].path = to;
+  fPathIndex.Insert(fItems[position].path, position);
+  return true;
+}
+
+void MediaEntryStore::_RemoveAt(size_t position) {
+  MediaItem &item = fItems[position];
+  fPathIndex.Erase(item.path);
+  _InodeErase(item.inode, position);
+  fIdPositions[fIds[position]] = MediaPathIndex::kNotFound;
+
+  if (position + 1 != fItems.size())
+    _MoveLastTo(position);
+  fItems.pop_back();
+  fIds.pop_back();
+}
+
+/**
+ * @brief Moves the last item into `position` and fixes all indexes.
+ */
+void MediaEntryStore::_MoveLastTo(size_t position) {
+  const size_t last = fItems.size() - 1;
+  _InodeErase(fItems[last].inode, last);
+
+  fItems[position] = std::move(fItems[last]);
+  fIds[position] = fIds[last];
+
+  fPathIndex.Insert(fItems[position].path, position);
+  _InodeInsert(fItems[position].inode, position);
+  fIdPositions[fIds[position]] = position;
+}
+
+void MediaEntryStore::_InodeInsert(int64 inode, size_t position) {
+  if (inode == 0)
+    return;
+  if ((fInodeCount + 1) * 2 > fInodeSlots.size())
+    _InodeRehash(fInodeSlots.size() * 2);
+
+  const size_t mask = fInodeSlots.size() - 1;
+  size_t i = HashInode(inode) & mask;
+  while (fInodeSlots[i].position != MediaPathIndex::kNotFound)
+    i = (i + 1) & mask;
+  fInodeSlots[i].inode = inode;
+  fInodeSlots[i].position = position;
+  fInodeCount++;
+}
+
+void MediaEntryStore::_InodeErase(int64 inode, size_t position) {
+  if (inode == 0 || fInodeCount == 0)
+    return;
+
+  const size_t mask = fInodeSlots.size() - 1;
+  size_t i = HashInode(inode) & mask;
+  while (fInodeSlots[i].position != MediaPathIndex::kNotFound) {
+    if (fInodeSlots[i].inode == inode && fInodeSlots[i].position == position)
+      break;
+    i = (i + 1) & mask;
+  }
+  if (fInodeSlots[i].position == MediaPathIndex::kNotFound)
+    return;
+
+  size_t j = i;
+  while (true) {
+    j = (j + 1) & mask;
+    if (fInodeSlots[j].position == MediaPathIndex::kNotFound)
+      break;
+    if (CanShiftBack(i, j, HashInode(fInodeSlots[j].inode) & mask)) {
+      fInodeSlots[i] = fInodeSlots[j];
+      i = j;
+    }
+  }
+  fInodeSlots[i].position = MediaPathIndex::kNotFound;
+  fInodeCount--;
+}
+
+void MediaEntryStore::_InodeRehash(size_t minSlots) {
+  size_t slots = 16;
+  while (slots < minSlots)
+    slots <<= 1;
+
+  std::vector<InodeSlot> old;
+  old.swap(fInodeSlots);
+  fInodeSlots.resize(slots);
+
+  const size_t mask = slots - 1;
+  for (const InodeSlot &slot : old) {
+    if (slot.position == MediaPathIndex::kNotFound)
+      continue;
+    size_t i = HashInode(slot.inode) & mask;
+    while (fInodeSlots[i].position != MediaPathIndex::kNotFound)
+      i = (i + 1) & mask;
+    fInodeSlots[i] = slot;
+  }
+}
@@ -0,0 +1,194 @@
+#ifndef BETON_MEDIA_ENTRY_STORE_H
+#define BETON_MEDIA_ENTRY_STORE_H
+
+#include "MediaItem.h"
+#include "MemoryStats.h"
+
+#include <String.h>
+#include <SupportDefs.h>
+#include <vector>
+
+/**
+ * @brief FNV-1a hash of a path, shared by the entry store indexes.
+ */
+uint32 HashMediaPath(const char *path, int32 length);
+
+/**
+ * @class MediaPathIndex
+ * @brief Open-addressing hash from file path to a position in a vector.
+ *
+ * Uses linear probing with backward-shift deletion, so there are no
+ * tombstones and lookups stay short after many removals. Keys are stored as
+ * `BString` copies, which share the buffer of the item's path.
+ */
+class MediaPathIndex {
+public:
+  static const size_t kNotFound = (size_t)-1;
+
+  MediaPathIndex();
+
+  /** @brief Removes all keys; keeps the allocated table. */
+  void Clear();
+
+  /** @brief Grows the table so `count` keys fit without rehashing. */
+  void Reserve(size_t count);
+
+  /** @brief Number of keys in the index. */
+  size_t Size() const { return fCount; }
+
+  /**
+   * @brief Looks up a path.
+   * @return The stored position, or `kNotFound`.
+   */
+  size_t Find(const BString &path) const;
+  size_t Find(const char *path) const;
+
+  /** @brief Inserts `path` or replaces its stored position. */
+  void Insert(const BString &path, size_t position);
+
+  /**
+   * @brief Removes `path` from the index.
+   * @return `true` if the key was present.
+   */
+  bool Erase(const BString &path);
+
+  /**
+   * @brief Replaces the index with `items[i].path -> i` for all items.
+   *
+   * Allocates the table once, so rebuilding is linear in the item count.
+   */
+  void Rebuild(const std::vector<MediaItem> &items);
+
+  /** @brief Bytes of the slot table. */
+  size_t MemoryBytes() const { return MemoryStats::BytesOf(fSlots); }
+
+private:
+  struct Slot {
+    BString key;
+    size_t position = kNotFound;
+    uint32 hash = 0;
+  };
+
+  size_t _Probe(const char *path, int32 length, uint32 hash) const;
+  void _Grow(size_t minSlots);
+
+  std::vector<Slot> fSlots;
+  size_t fCount;
+};
+
+/**
+ * @class MediaEntryStore
+ * @brief Dense storage for library entries with path and inode indexes.
+ *
+ * Items live in one contiguous vector. Removing an item moves the last item
+ * into its place, so positions are not stable; track IDs are, and stay valid
+ * until the item is removed.
+ */
+class MediaEntryStore {
+public:
+  typedef uint32 TrackId;
+  static const TrackId kInvalidTrackId = 0;
+
+  MediaEntryStore();
+
+  /** @brief Number of stored items. */
+  size_t Count() const { return fItems.size(); }
+  bool IsEmpty() const { return fItems.empty(); }
+
+  /** @brief Pre-allocates storage and indexes. */
+  void Reserve(size_t count);
+
+  /** @brief Removes all items. Track IDs are not reused. */
+  void Clear();
+
+  /** @brief Gives back the item storage not in use. */
+  void Compact();
+
+  /** @brief Dense item array in unspecified order. */
+  const std::vector<MediaItem> &Items() const { return fItems; }
+
+  /** @brief Item at a dense position (`0 <= index < Count()`). */
+  MediaItem &ItemAt(size_t index) { return fItems[index]; }
+  const MediaItem &ItemAt(size_t index) const { return fItems[index]; }
+
+  /** @brief Returns the item stored for `path`, or `nullptr`. */
+  MediaItem *Find(const BString &path);
+  const MediaItem *Find(const BString &path) const;
+
+  /** @brief Returns the first item with `inode`, or `nullptr`. */
+  const MediaItem *FindByInode(int64 inode) const;
+
+  /**
+   * @brief Returns an item with `inode` whose size and mtime also match.
+   *
+   * Used to recognize files that were moved or renamed outside the app.
+   */
+  const MediaItem *FindByFileStat(int64 inode, int64 size,
+                                  int64 mtime) const;
+
+  /** @brief Returns the item with track ID `id`, or `nullptr`. */
+  const MediaItem *FindById(TrackId id) const;
+
+  /** @brief Returns the track ID of `path`, or `kInvalidTrackId`. */
+  TrackId IdOf(const BString &path) const;
+
+  /**
+   * @brief Inserts `item` or replaces the item with the same path.
+   * @return The (existing or new) track ID.
+   */
+  TrackId Put(const MediaItem &item);
+  TrackId Put(MediaItem &&item);
+
+  /**
+   * @brief Removes the item stored for `path`.
+   * @return `true` if an item was removed.
+   */
+  bool Remove(const BString &path);
+
+  /**
+   * @brief Changes the path of an entry and keeps its track ID.
+   * @return `false` if `from` is unknown.
+   */
+  bool Rename(const BString &from, const BString &to);
+
+  /**
+   * @brief Removes all items for which `predicate(item)` returns `true`.
+   * @return Number of items removed.
+   */
+  template <typename Predicate> size_t RemoveIf(Predicate predicate) {
+    size_t removed = 0;
+    for (size_t i = 0; i < fItems.size();) {
+      if (predicate(static_cast<const MediaItem &>(fItems[i]))) {
+        _RemoveAt(i);
+        removed++;
+      } else {
+        i++;
+      }
+    }
+    return removed;
+  }
+
+private:
+  struct InodeSlot {
+    int64 inode = 0;
+    size_t position = MediaPathIndex::kNotFound;
+  };
+
+  void _RemoveAt(size_t position);
+  void _MoveLastTo(size_t position);
+
+  void _InodeInsert(int64 inode, size_t position);
+  void _InodeErase(int64 inode, size_t position);
+  void _InodeRehash(size_t minSlots);
+  void _UpdateMemory();
+
+  std::vector<MediaItem> fItems;
+  std::vector<TrackId> fIds;          ///< Parallel to fItems
+  std::vector<size_t> fIdPositions;   ///< TrackId -> position (or kNotFound)
+  MediaPathIndex fPathIndex;
+  std::vector<InodeSlot> fInodeSlots;
+  size_t fInodeCount;
+  MemoryAccount fMemory;
+};
+
+#endif // BETON_MEDIA_ENTRY_STORE_H
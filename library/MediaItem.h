@@ -60,6 +60,18 @@ struct MediaItem {
   BString acoustId; ///< AcoustID fingerprint identifier.
   ///@}
 
+  /**
+   * @name Loudness (ReplayGain 2.0, -18 LUFS reference)
+   * Gains are in hundredths of a dB, peaks in millionths of full scale. A
+   * peak of 0 means "not analyzed".
+   */
+  ///@{
+  int32 trackGain = 0;
+  int32 trackPeak = 0;
+  int32 albumGain = 0;
+  int32 albumPeak = 0;
+  ///@}
+
   /** @name Haiku BFS Attributes */
   ///@{
   int32 rating = 0; ///< Rating 1-10 (Media:Rating).
@@ -91,6 +103,9 @@ struct MediaItem {
    * @return True if path is not empty.
    */
   bool HasFile() const { return !path.IsEmpty(); }
+
+  /** @brief True once a track gain is known (analyzed or from tags). */
+  bool HasLoudness() const { return trackPeak > 0; }
 };
 
 #endif // BETON_MEDIA_ITEM_H
@@ -1,9 +1,17 @@
 #include "MediaLibraryCache.h"
 #include "Config.h"
 #include "Debug.h"
+#include "LibrarySnapshot.h"
+#include "LooperStats.h"
+#include "MediaBatch.h"
+#include "MediaCacheFile.h"
 #include "MediaLibraryScanner.h"
 #include "Messages.h"
 #include "MusicSourceSettings.h"
+#include "ScanStats.h"
+#include "StringPool.h"
+#include "Trace.h"
+#include <Autolock.h>
 #include <Directory.h>
 #include <Entry.h>
 #include <File.h>
@@ -11,8 +19,13 @@
 #include <Node.h>
 #include <OS.h>
 #include <Path.h>
+#include <algorithm>
+#include <errno.h>
+#include <fs_index.h>
 #include <set>
+#include <string.h>
 #include <sys/stat.h>
+#include <time.h>
 
 /**
  * @brief Returns whether a path points to MIDI while MIDI playback is disabled.
@@ -28,29 +41,108 @@ static bool IsDisabledMidiPath(const BString &path) {
 #endif
 }
 
+/** @brief Journal size in bytes after which a new snapshot is written. */
+static const off_t kJournalCompactThreshold = 1024 * 1024;
+
 /**
- * @brief Constructor.
- * Determines the path to the cache file (user settings) but does not load it
- * yet.
+ * @brief Returns the path of `media.cache` in the user settings directory.
  */
-MediaLibraryCache::MediaLibraryCache(const BMessenger &target)
-    : BLooper("MediaLibraryCache"), fTarget(target) {
+static BString DefaultCachePath() {
   BPath settingsPath;
   find_directory(B_USER_SETTINGS_DIRECTORY, &settingsPath);
   settingsPath.Append("BeTon/media.cache");
-  fCachePath = settingsPath.Path();
+  return BString(settingsPath.Path());
+}
+
+/**
+ * @brief Returns the path of the per-root scan state file.
+ */
+static BString ScanStatePath() {
+  BPath settingsPath;
+  find_directory(B_USER_SETTINGS_DIRECTORY, &settingsPath);
+  settingsPath.Append("BeTon/scan_state.settings");
+  return BString(settingsPath.Path());
 }
 
+/** @brief Maximum age of the last full walk before delta scans are refused. */
+static const time_t kFullScanInterval = 7 * 24 * 60 * 60;
+/** @brief Overlap for the delta query to cover clock granularity. */
+static const time_t kDeltaScanSlack = 2;
+/** @brief Entries stat()ed per MSG_VALIDATE_NEXT. */
+static const size_t kValidationBatchSize = 200;
+/** @brief Minimum interval between combined progress messages. */
+static const bigtime_t kScanProgressInterval = 100000;
+/** @brief Default time an offline entry is kept before it is dropped. */
+static const time_t kMissingEntryRetention = 30 * 24 * 60 * 60;
+/** @brief Delay that gathers the files of a live query burst into one re-read. */
+static const bigtime_t kAttrRereadDelay = 500000;
+
+/** @brief Attributes worth indexing on the source volumes. */
+static const struct {
+  const char *name;
+  uint32 type;
+} kIndexedAttributes[] = {
+    {"Media:Title", B_STRING_TYPE}, {"Audio:Artist", B_STRING_TYPE},
+    {"Audio:Album", B_STRING_TYPE}, {"Media:Genre", B_STRING_TYPE},
+    {"Media:Year", B_INT32_TYPE},   {"Media:Rating", B_INT32_TYPE},
+};
+
+/**
+ * @brief Work item handed to the compaction thread.
+ */
+struct CacheCompactionJob {
+  BString cachePath;
+  BReference<LibrarySnapshot> snapshot;
+  std::atomic<bool> *running;
+  BMessenger reportTarget;
+  BMessage report; ///< Sent to reportTarget when set (what != 0)
+};
+
+/**
+ * @brief Constructor.
+ * Determines the path to the cache file (user settings) but does not load it
+ * yet.
+ */
+MediaLibraryCache::MediaLibraryCache(const BMessenger &target)
+    : BLooper("MediaLibraryCache"), fTarget(target),
+      fCachePath(DefaultCachePath()), fJournal(fCachePath),
+      fLoudness(BMessenger(this)), fAcoustId(BMessenger(this)),
+      fMissingRetention(kMissingEntryRetention) {}
+
 MediaLibraryCache::~MediaLibraryCache() {
-  if (fCacheDirty) {
+  // Results still in flight are lost; the next run redoes those albums.
+  fLoudness.Cancel();
+  fAcoustId.Cancel();
+
+  // Let a running compaction finish so a stale snapshot can be rewritten.
+  if (fCompactionThread >= 0) {
+    status_t result;
+    wait_for_thread(fCompactionThread, &result);
+    fCompactionThread = -1;
+  }
+
+  if (fCacheDirty || fSnapshotStale) {
     DEBUG_PRINT("Saving dirty cache before shutdown...\n");
     SaveCache();
   }
 
-  for (BQuery *q : fRatingQueries) {
-    delete q;
+  if (fCompactionThread >= 0) {
+    status_t result;
+    wait_for_thread(fCompactionThread, &result);
+  }
+
+  if (fWatcher != nullptr) {
+    fWatcher->StopWatching();
+    RemoveHandler(fWatcher);
+    delete fWatcher;
+    fWatcher = nullptr;
   }
-  fRatingQueries.clear();
+
+  delete fRereadRunner;
+  fRereadRunner = nullptr;
+  for (auto &query : fLiveQueries)
+    delete query.second;
+  fLiveQueries.clear();
 }
 
 /**
@@ -99,22 +191,22 @@ void MediaLibraryCache::LoadDirectories(std::vector<BString> &outDirs) {
  *
  * Note: Real sync happens via Scanners reporting back.
  */
-void MediaLibraryCache::StartScan() {
+void MediaLibraryCache::StartScan(bool full) {
   std::vector<BString> dirs;
   LoadDirectories(dirs);
+  const time_t now = (time_t)real_time_clock();
 
   // 1) Remove entries that belong to directories no longer monitored.
   std::set<BString> validBases(dirs.begin(), dirs.end());
 
-  for (auto it = fEntries.begin(); it != fEntries.end();) {
-    const MediaItem &e = it->second;
-    if (validBases.find(e.base) == validBases.end()) {
-      it = fEntries.erase(it);
-      fCacheDirty = true;
-    } else {
-      ++it;
-    }
-  }
+  fEntries.RemoveIf([&](const MediaItem &e) {
+    if (validBases.find(e.base) != validBases.end())
+      return false;
+    _MarkChanged(e.path);
+    return true;
+  });
+
+  _UpdateWatcher(dirs);
 
   // Notify UI that scan starts from current known state.
   if (fTarget.IsValid()) {
@@ -122,9 +214,10 @@ void MediaLibraryCache::StartScan() {
     fTarget.SendMessage(&update);
   }
 
-  // 2) Start scanners.
+  // 2) Group reachable sources by device.
   fActiveScanners = 0;
   std::set<BString> offlineBases;
+  std::map<dev_t, std::vector<std::pair<BString, entry_ref>>> byDevice;
   for (const auto &dirPath : dirs) {
     entry_ref ref;
     status_t s = get_ref_for_path(dirPath.String(), &ref);
@@ -141,63 +234,110 @@ void MediaLibraryCache::StartScan() {
       continue;
     }
 
-    BVolume vol(ref.device);
-    if (vol.KnowsQuery() &&
-        fQueriedVolumes.find(ref.device) == fQueriedVolumes.end()) {
-      _InitRatingLiveQueries(ref.device);
-    }
-
-    // Launch scanner. It reports via MSG_MEDIA_ITEM_FOUND/MSG_SCAN_DONE.
-    auto *scanner = new MediaLibraryScanner(ref, BMessenger(this), fTarget);
-    scanner->SetCache(fEntries);
-    scanner->Run();
-
-    BMessenger msgr(scanner);
-    msgr.SendMessage(MSG_START_SCAN);
-    fActiveScanners++;
+    if (fLiveQueries.find(ref.device) == fLiveQueries.end())
+      _InitLiveQuery(ref.device, time(nullptr));
+    _CheckIndexes(ref.device);
+    byDevice[ref.device].push_back(std::make_pair(dirPath, ref));
   }
 
-  // 3) Remove stale files from reachable sources.
-  for (auto it = fEntries.begin(); it != fEntries.end();) {
-    const BString path = it->first;
-    bool wasMissing = it->second.missing;
+  // 3) Find entries of reachable sources whose files are gone. They stay
+  // until the source's scanner is done, which re-keys the ones that were
+  // only moved or renamed (same inode) instead of re-reading their tags.
+  // Entries outside every source go right away.
+  fPendingRemovals.clear();
+  const BString noSource;
+  for (size_t i = 0; i < fEntries.Count(); i++) {
+    MediaItem &item = fEntries.ItemAt(i);
 
     bool baseOffline = false;
     for (const auto &base : offlineBases) {
       BString basePrefix(base);
       basePrefix << "/";
-      if (path == base || path.StartsWith(basePrefix)) {
+      if (item.path == base || item.path.StartsWith(basePrefix)) {
         baseOffline = true;
         break;
       }
     }
-    if (baseOffline) {
-      ++it;
+    if (baseOffline)
       continue;
-    }
 
-    BEntry e(path.String());
-    if (!e.Exists()) {
-      DEBUG_PRINT("Remove missing file: %s\n", path.String());
-
-      if (fTarget.IsValid()) {
-        BMessage gone(MSG_MEDIA_ITEM_REMOVED);
-        gone.AddString("path", path);
-        fTarget.SendMessage(&gone);
+    const BString *source = &noSource;
+    for (const auto &device : byDevice) {
+      for (const auto &dir : device.second) {
+        BString prefix(dir.first);
+        prefix << "/";
+        if (item.path.StartsWith(prefix)) {
+          source = &dir.first;
+          break;
+        }
       }
+      if (source != &noSource)
+        break;
+    }
 
-      it = fEntries.erase(it);
-      fCacheDirty = true;
+    BEntry e(item.path.String());
+    if (!e.Exists()) {
+      fPendingRemovals[*source].push_back(item.path);
       continue;
     }
 
-    if (wasMissing) {
-      it->second.missing = false;
-      fCacheDirty = true;
+    if (item.missing) {
+      item.missing = false;
+      fMissingSince.erase(item.path);
+      _MarkChanged(item.path);
     }
+  }
+  _RemovePending(noSource);
+
+  // 4) Queue one scanner per source, taking turns between devices, so the
+  // first source of every device starts right away and the sources sharing
+  // a device follow each other (see ScanScheduler).
+  fScanProgress.clear();
+  fScanStartTime = system_time();
+  fLastProgressSent = 0;
+  // One snapshot for all scanners; usually the one the window holds anyway.
+  BReference<LibrarySnapshot> known = CurrentSnapshot();
+  for (size_t round = 0;; round++) {
+    bool queued = false;
+    for (const auto &device : byDevice) {
+      if (round >= device.second.size())
+        continue;
+      queued = true;
+      const BString &dirPath = device.second[round].first;
+      const entry_ref &ref = device.second[round].second;
+      BVolume vol(ref.device);
 
-    ++it;
+      // Progress and completion come back here; the window gets the sum.
+      auto *scanner =
+          new MediaLibraryScanner(ref, BMessenger(this), BMessenger(this));
+      scanner->SetCache(known.Get());
+      scanner->SetTagReaderCount(fTagReaderCount);
+
+      // A delta query does not see moved files (their mtime is unchanged),
+      // so sources with missing entries get a full walk.
+      auto state = fScanStates.find(dirPath);
+      if (!full && vol.KnowsQuery() && !fEntries.IsEmpty() &&
+          fPendingRemovals.find(dirPath) == fPendingRemovals.end() &&
+          state != fScanStates.end() && state->second.lastScan > 0 &&
+          now - state->second.lastFullScan < kFullScanInterval) {
+        DEBUG_PRINT("Delta scan of %s\n", dirPath.String());
+        scanner->SetDeltaSince(state->second.lastScan - kDeltaScanSlack);
+      }
+      fScanStarted[dirPath] = now;
+      scanner->Run();
+
+      // The scheduler sends MSG_START_SCAN once the device has a free slot.
+      fScheduler.Enqueue(BMessenger(scanner), BPath(&ref).Path(), ref.device);
+      fActiveScanners++;
+    }
+    if (!queued)
+      break;
   }
+  DEBUG_PRINT("StartScan: %ld sources on %zu devices\n",
+              (long)fActiveScanners, byDevice.size());
+
+  if (!offlineBases.empty())
+    _SaveScanState();
 
   // If no scanners were started (e.g. no directories), finish immediately.
   if (fActiveScanners == 0) {
@@ -210,87 +350,167 @@ void MediaLibraryCache::StartScan() {
 }
 
 /**
- * @brief Saves the current in-memory cache to disk.
- * The cache is flattened into a BMessage and saved to 'media.cache'.
+ * @brief Persists changes made since the last save.
+ *
+ * Only the changed entries are appended to the journal, so the cost depends
+ * on the size of the change rather than the size of the library. The full
+ * snapshot is rewritten in the background when needed.
  */
 void MediaLibraryCache::SaveCache() {
+  TRACE_SCOPE(kTraceCache, "save cache", (int64)fChangedPaths.size());
   bigtime_t t0 = system_time();
 
-  BFile file(fCachePath, B_WRITE_ONLY | B_CREATE_FILE | B_ERASE_FILE);
-  if (file.InitCheck() != B_OK) {
-    DEBUG_PRINT("SaveCache: Failed to open %s\n",
-                fCachePath.String());
+  if (!fSnapshotStale && !fChangedPaths.empty()) {
+    for (const BString &path : fChangedPaths) {
+      const MediaItem *item = fEntries.Find(path);
+      if (item != nullptr)
+        fJournal.AddUpsert(*item);
+      else
+        fJournal.AddTombstone(path);
+    }
+
+    status_t status = fJournal.Commit();
+    if (status != B_OK) {
+      DEBUG_PRINT("SaveCache: journal append failed: %s\n", strerror(status));
+      fSnapshotStale = true;
+    } else {
+      DEBUG_PRINT("SaveCache: journaled %zu changes in %lld us\n",
+                  fChangedPaths.size(), (long long)(system_time() - t0));
+    }
+  }
+
+  fChangedPaths.clear();
+  fCacheDirty = false;
+
+  if (fSnapshotStale || fJournal.Size() > kJournalCompactThreshold)
+    _StartCompaction();
+}
+
+/**
+ * @brief Starts writing a full v3 snapshot on a low-priority thread.
+ *
+ * The live journal is rotated first so new changes keep going to a fresh
+ * journal while the snapshot (taken from the current state) is written.
+ */
+void MediaLibraryCache::_StartCompaction() {
+  if (fCompacting.load())
     return;
+
+  if (fCompactionThread >= 0) {
+    status_t result;
+    wait_for_thread(fCompactionThread, &result);
+    fCompactionThread = -1;
   }
 
-  uint32 magic = 'BTCA';
-  uint32 version = 2;
-  uint32 count = (uint32)fEntries.size();
+  status_t status = fJournal.Rotate();
+  if (status != B_OK) {
+    DEBUG_PRINT("SaveCache: journal rotation failed: %s\n", strerror(status));
+    if (fCollectReport.what != 0) {
+      fTarget.SendMessage(&fCollectReport);
+      fCollectReport.MakeEmpty();
+      fCollectReport.what = 0;
+    }
+    return;
+  }
 
-  file.Write(&magic, sizeof(magic));
-  file.Write(&version, sizeof(version));
-  file.Write(&count, sizeof(count));
+  auto *job = new CacheCompactionJob;
+  job->cachePath = fCachePath;
+  job->snapshot = CurrentSnapshot();
+  job->running = &fCompacting;
+  if (fCollectReport.what != 0) {
+    job->reportTarget = fTarget;
+    job->report = fCollectReport;
+    fCollectReport.MakeEmpty();
+    fCollectReport.what = 0;
+  }
 
-  auto writeStr = [&file](const BString &s) {
-    uint32 len = (uint32)s.Length();
-    file.Write(&len, sizeof(len));
-    if (len > 0)
-      file.Write(s.String(), len);
-  };
+  fCompacting = true;
+  fCompactionThread = spawn_thread(_CompactionThread, "MediaCacheCompaction",
+                                   B_LOW_PRIORITY, job);
+  if (fCompactionThread < 0 || resume_thread(fCompactionThread) != B_OK) {
+    // Fall back to writing the snapshot synchronously.
+    fCompactionThread = -1;
+    _CompactionThread(job);
+  }
+  fSnapshotStale = false;
+}
 
-  for (const auto &[key, e] : fEntries) {
-    writeStr(e.path);
-    writeStr(e.base);
-    writeStr(e.title);
-    writeStr(e.artist);
-    writeStr(e.album);
-    writeStr(e.albumArtist);
-    writeStr(e.genre);
-    writeStr(e.comment);
-    writeStr(e.composer);
-    writeStr(e.mbTrackId);
-    writeStr(e.mbAlbumId);
-    writeStr(e.mbArtistId);
-    writeStr(e.acoustId);
-
-    file.Write(&e.year, sizeof(e.year));
-    file.Write(&e.track, sizeof(e.track));
-    file.Write(&e.trackTotal, sizeof(e.trackTotal));
-    file.Write(&e.disc, sizeof(e.disc));
-    file.Write(&e.discTotal, sizeof(e.discTotal));
-    file.Write(&e.duration, sizeof(e.duration));
-    file.Write(&e.bitrate, sizeof(e.bitrate));
-    file.Write(&e.sampleRate, sizeof(e.sampleRate));
-    file.Write(&e.channels, sizeof(e.channels));
-    file.Write(&e.rating, sizeof(e.rating));
-    file.Write(&e.size, sizeof(e.size));
-    file.Write(&e.mtime, sizeof(e.mtime));
-    file.Write(&e.inode, sizeof(e.inode));
-
-    uint8 flags = e.missing ? 1 : 0;
-    file.Write(&flags, sizeof(flags));
-  }
-
-  bigtime_t t1 = system_time();
-  DEBUG_PRINT("SaveCache: %lu items in %lld us to %s\n", (unsigned long)count,
-              (long long)(t1 - t0), fCachePath.String());
-  fCacheDirty = false;
+int32 MediaLibraryCache::_CompactionThread(void *data) {
+  auto *job = static_cast<CacheCompactionJob *>(data);
+  TRACE_SCOPE(kTraceCache, "write snapshot",
+              (int64)job->snapshot->Items().size());
+  bigtime_t t0 = system_time();
+
+  MediaCacheWriter writer;
+  const std::vector<MediaItem> &items = job->snapshot->Items();
+  writer.Reserve(items.size());
+  for (const MediaItem &item : items)
+    writer.AddItem(item);
+
+  status_t status = writer.WriteTo(job->cachePath.String());
+  if (status == B_OK) {
+    MediaCacheJournal(job->cachePath).RemoveRotated();
+    DEBUG_PRINT("SaveCache (v3): %lu items, %lu strings in %lld us to %s\n",
+                (unsigned long)writer.CountItems(),
+                (unsigned long)writer.CountStrings(),
+                (long long)(system_time() - t0), job->cachePath.String());
+  } else {
+    // The rotated journal stays in place and is replayed on next load.
+    DEBUG_PRINT("SaveCache: Failed to write %s: %s\n",
+                job->cachePath.String(), strerror(status));
+  }
+
+  if (job->report.what != 0) {
+    if (status == B_OK) {
+      struct stat st;
+      if (stat(job->cachePath.String(), &st) == 0)
+        job->report.AddInt64("bytes_after", (int64)st.st_size);
+    }
+    job->reportTarget.SendMessage(&job->report);
+  }
+
+  job->running->store(false);
+  delete job;
+  return status;
 }
 
 /**
  * @brief Loads the cache from disk into memory.
  *
- * Supports both the new binary format (version 2, magic 'BTCA')
- * and the legacy BMessage format for migration.
+ * Prefers the memory-mapped v3 format. The stream-based binary format
+ * (version 2) and the legacy BMessage format are still read for migration;
+ * both mark the cache dirty so it is rewritten as v3.
  */
 void MediaLibraryCache::LoadCache() {
-  fEntries.clear();
+  TRACE_SCOPE(kTraceCache, "load cache");
+  fEntries.Clear();
 
   bigtime_t t0 = system_time();
 
+  CacheLoadStats stats;
+  if (_LoadMappedCache(stats)) {
+    bigtime_t t1 = system_time();
+    DEBUG_PRINT("LoadCache (mapped v3): %zu items in %lld us\n",
+                fEntries.Count(), (long long)(t1 - t0));
+    DEBUG_PRINT("LoadCache: %s, %llu of %llu bytes read in %lld us, "
+                "decompressed in %lld us\n",
+                CacheCompression::Name(stats.codec),
+                (unsigned long long)stats.fileBytes,
+                (unsigned long long)stats.rawBytes, (long long)stats.readTime,
+                (long long)stats.decompressTime);
+    _ReplayJournal();
+    _FinishLoad();
+    return;
+  }
+
   BFile file(fCachePath, B_READ_ONLY);
   if (file.InitCheck() != B_OK) {
     DEBUG_PRINT("Kein Cache gefunden (%s)\n", fCachePath.String());
+    // A first snapshot may not have been written yet.
+    if (_ReplayJournal() > 0) {
+      fSnapshotStale = true;
+      _FinishLoad();
+    }
     return;
   }
 
@@ -358,12 +578,16 @@ void MediaLibraryCache::LoadCache() {
         continue;
       }
 
-      fEntries[e.path] = std::move(e);
+      StringPool::Default().InternItem(e);
+      fEntries.Put(std::move(e));
     }
 
     bigtime_t t1 = system_time();
     DEBUG_PRINT("LoadCache (binary v%lu): %zu items in %lld us\n",
-                (unsigned long)version, fEntries.size(), (long long)(t1 - t0));
+                (unsigned long)version, fEntries.Count(), (long long)(t1 - t0));
+
+    fCacheDirty = true;
+    fSnapshotStale = true;
   } else {
     file.Seek(0, SEEK_SET);
 
@@ -407,37 +631,376 @@ void MediaLibraryCache::LoadCache() {
         continue;
       }
 
-      fEntries[entry.path] = entry;
+      StringPool::Default().InternItem(entry);
+      fEntries.Put(entry);
     }
 
     bigtime_t t2 = system_time();
     DEBUG_PRINT("LoadCache (BMessage legacy): %zu items "
                 "(unflatten=%lld us, extract=%lld us)\n",
-                fEntries.size(), (long long)(t1 - t0), (long long)(t2 - t1));
+                fEntries.Count(), (long long)(t1 - t0), (long long)(t2 - t1));
 
     fCacheDirty = true;
+    fSnapshotStale = true;
+  }
+
+  _ReplayJournal();
+  _FinishLoad();
+}
+
+/**
+ * @brief Tries to load a v3 cache through MediaCacheReader.
+ *
+ * Builds every item at once; the strings are shared per distinct value
+ * (see MediaCacheFile.h).
+ * @return false if the file is missing or not in v3 format.
+ */
+bool MediaLibraryCache::_LoadMappedCache(CacheLoadStats &stats) {
+  MediaCacheReader reader;
+  if (reader.Open(fCachePath.String()) != B_OK)
+    return false;
+  stats = reader.LoadStats();
+
+  const uint32 count = reader.CountItems();
+  fEntries.Reserve(count);
+  for (uint32 i = 0; i < count; i++) {
+    const char *path = reader.StringField(i, kCachePath);
+    if (IsDisabledMidiPath(path)) {
+      _MarkChanged(path);
+      continue;
+    }
+
+    MediaItem e;
+    reader.ReadItem(i, e);
+    StringPool::Default().InternItem(e);
+    fEntries.Put(std::move(e));
+  }
+  return true;
+}
+
+/**
+ * @brief Replays `media.cache.journal` onto fEntries.
+ */
+int32 MediaLibraryCache::_ReplayJournal() {
+  bigtime_t t0 = system_time();
+  int32 applied = fJournal.Replay(
+      [this](MediaItem &item) {
+        if (IsDisabledMidiPath(item.path)) {
+          _MarkChanged(item.path);
+          return;
+        }
+        StringPool::Default().InternItem(item);
+        fEntries.Put(std::move(item));
+      },
+      [this](const BString &path) { fEntries.Remove(path); });
+
+  if (applied > 0) {
+    DEBUG_PRINT("LoadCache: replayed %ld journal records in %lld us\n",
+                (long)applied, (long long)(system_time() - t0));
   }
+  return applied;
+}
+
+/**
+ * @brief Merges the fields of an item update into the cached entry.
+ */
+bool MediaLibraryCache::_ApplyItemUpdate(const BMessage *msg) {
+  MediaItem e;
+  const char *tmpStr = nullptr;
+
+  if (msg->FindString("path", &tmpStr) != B_OK)
+    return false;
+  e.path = tmpStr;
+
+  const MediaItem *existing = fEntries.Find(e.path);
+  if (existing != nullptr)
+    e = *existing;
+  e.path = tmpStr;
+
+  if (msg->FindString("base", &tmpStr) == B_OK)
+    e.base = tmpStr;
+  if (msg->FindString("title", &tmpStr) == B_OK)
+    e.title = tmpStr;
+  if (msg->FindString("artist", &tmpStr) == B_OK)
+    e.artist = tmpStr;
+  if (msg->FindString("album", &tmpStr) == B_OK)
+    e.album = tmpStr;
+  if (msg->FindString("genre", &tmpStr) == B_OK)
+    e.genre = tmpStr;
+  if (msg->FindString("comment", &tmpStr) == B_OK)
+    e.comment = tmpStr;
+  if (msg->FindString("albumArtist", &tmpStr) == B_OK)
+    e.albumArtist = tmpStr;
+  if (msg->FindString("composer", &tmpStr) == B_OK)
+    e.composer = tmpStr;
+
+  msg->FindInt32("year", &e.year);
+  msg->FindInt32("track", &e.track);
+  msg->FindInt32("trackTotal", &e.trackTotal);
+  msg->FindInt32("disc", &e.disc);
+  msg->FindInt32("discTotal", &e.discTotal);
+  msg->FindInt32("duration", &e.duration);
+  msg->FindInt32("bitrate", &e.bitrate);
+  msg->FindInt32("sampleRate", &e.sampleRate);
+  msg->FindInt32("channels", &e.channels);
+  msg->FindInt32("rating", &e.rating);
+  msg->FindInt64("size", &e.size);
+  msg->FindInt64("mtime", &e.mtime);
+  msg->FindInt64("inode", &e.inode);
+
+  if (msg->FindString("mbAlbumId", &tmpStr) == B_OK ||
+      msg->FindString("mbAlbumID", &tmpStr) == B_OK)
+    e.mbAlbumId = tmpStr;
+  if (msg->FindString("mbArtistId", &tmpStr) == B_OK ||
+      msg->FindString("mbArtistID", &tmpStr) == B_OK)
+    e.mbArtistId = tmpStr;
+  if (msg->FindString("mbTrackId", &tmpStr) == B_OK ||
+      msg->FindString("mbTrackID", &tmpStr) == B_OK)
+    e.mbTrackId = tmpStr;
+
+  AddOrUpdateEntry(e);
+  return true;
+}
+
+/**
+ * @brief Records a changed or removed entry for the next SaveCache().
+ */
+void MediaLibraryCache::_MarkChanged(const BString &path) {
+  fChangedPaths.insert(path);
+  fCacheDirty = true;
+  _BumpVersion();
+}
+
+/**
+ * @brief Invalidates the published snapshot after fEntries changed.
+ *
+ * Holders of the old snapshot keep it; only the cache's reference is
+ * dropped, so a still-shared array is freed as soon as they let go of it.
+ */
+void MediaLibraryCache::_BumpVersion() {
+  fVersion++;
+  fPublished.Unset();
+}
+
+/**
+ * @brief Notifies the target that the cache is available; starts the
+ * queries if the window already asked for them.
+ */
+void MediaLibraryCache::_FinishLoad() {
+  _LoadScanState();
+  _CollectGarbage(false);
+  _BumpVersion();
 
   if (fTarget.IsValid()) {
     BMessage msg(MSG_CACHE_LOADED);
     fTarget.SendMessage(&msg);
   }
 
+  fLoaded = true;
+  if (fLiveQueriesWanted)
+    _StartLiveQueries();
+}
+
+/**
+ * @brief Starts the live queries and the watcher. Startup asks for this
+ * only after the window is drawn, so their directory walks do not compete
+ * with it.
+ */
+void MediaLibraryCache::_StartLiveQueries() {
   _InitAllLiveQueries();
+
+  std::vector<BString> dirs;
+  LoadDirectories(dirs);
+  _UpdateWatcher(dirs);
+}
+
+void MediaLibraryCache::_LoadScanState() {
+  fScanStates.clear();
+
+  BFile file(ScanStatePath().String(), B_READ_ONLY);
+  BMessage archive;
+  if (file.InitCheck() != B_OK || archive.Unflatten(&file) != B_OK)
+    return;
+
+  BString root;
+  for (int32 i = 0; archive.FindString("root", i, &root) == B_OK; i++) {
+    int64 lastScan = 0, lastFullScan = 0;
+    archive.FindInt64("last_scan", i, &lastScan);
+    archive.FindInt64("last_full_scan", i, &lastFullScan);
+    ScanState &state = fScanStates[root];
+    state.lastScan = (time_t)lastScan;
+    state.lastFullScan = (time_t)lastFullScan;
+  }
+
+  fMissingSince.clear();
+  BString path;
+  for (int32 i = 0; archive.FindString("missing_path", i, &path) == B_OK;
+       i++) {
+    int64 since = 0;
+    if (archive.FindInt64("missing_since", i, &since) == B_OK)
+      fMissingSince[path] = (time_t)since;
+  }
+
+  fIndexDeclined.clear();
+  BString volume;
+  for (int32 i = 0; archive.FindString("no_index_volume", i, &volume) == B_OK;
+       i++)
+    fIndexDeclined.insert(volume);
+}
+
+void MediaLibraryCache::_SaveScanState() {
+  BMessage archive;
+  for (const auto &state : fScanStates) {
+    archive.AddString("root", state.first);
+    archive.AddInt64("last_scan", (int64)state.second.lastScan);
+    archive.AddInt64("last_full_scan", (int64)state.second.lastFullScan);
+  }
+  for (const auto &missing : fMissingSince) {
+    archive.AddString("missing_path", missing.first);
+    archive.AddInt64("missing_since", (int64)missing.second);
+  }
+  for (const BString &volume : fIndexDeclined)
+    archive.AddString("no_index_volume", volume);
+
+  BFile file(ScanStatePath().String(),
+             B_WRITE_ONLY | B_CREATE_FILE | B_ERASE_FILE);
+  if (file.InitCheck() == B_OK)
+    archive.Flatten(&file);
+}
+
+void MediaLibraryCache::_UpdateWatcher(const std::vector<BString> &dirs) {
+  if (fWatcher == nullptr) {
+    fWatcher = new LibraryWatcher(BMessenger(this));
+    AddHandler(fWatcher);
+  }
+  fWatcher->SetRoots(dirs);
+}
+
+int32 MediaLibraryCache::_RemoveEntriesAt(const BString &path) {
+  std::vector<BString> gone;
+  if (fEntries.Find(path) != nullptr) {
+    gone.push_back(path);
+  } else {
+    BString prefix(path);
+    prefix << "/";
+    for (const MediaItem &item : fEntries.Items()) {
+      if (item.path.StartsWith(prefix))
+        gone.push_back(item.path);
+    }
+  }
+
+  for (const BString &p : gone) {
+    fEntries.Remove(p);
+    _MarkChanged(p);
+    if (fTarget.IsValid()) {
+      BMessage msg(MSG_MEDIA_ITEM_REMOVED);
+      msg.AddString("path", p);
+      fTarget.SendMessage(&msg);
+    }
+  }
+  return (int32)gone.size();
 }
 
 /**
- * @brief Returns a copy of all current media items.
- * @return std::vector<MediaItem>
+ * @brief Applies watcher events without walking the whole library.
+ *
+ * Moved entries keep their track IDs; the new location is still re-read
+ * because the scanner does not get the old metadata as a fast-skip cache.
  */
-std::vector<MediaItem> MediaLibraryCache::AllEntries() const {
-  std::vector<MediaItem> out;
-  out.reserve(fEntries.size());
+void MediaLibraryCache::_ApplyLibraryChanges(BMessage *msg) {
+  // 1) Moves: rekey entries (a directory move rekeys everything below it).
+  BString from, to;
+  for (int32 i = 0; msg->FindString("from", i, &from) == B_OK &&
+                    msg->FindString("to", i, &to) == B_OK;
+       i++) {
+    std::vector<BString> sources;
+    if (fEntries.Find(from) != nullptr) {
+      sources.push_back(from);
+    } else {
+      BString prefix(from);
+      prefix << "/";
+      for (const MediaItem &item : fEntries.Items()) {
+        if (item.path.StartsWith(prefix))
+          sources.push_back(item.path);
+      }
+    }
+
+    for (const BString &source : sources) {
+      BString target(to);
+      target << (source.String() + from.Length());
+      if (!fEntries.Rename(source, target))
+        continue;
+      _MarkChanged(source);
+      _MarkChanged(target);
+      if (fTarget.IsValid()) {
+        BMessage gone(MSG_MEDIA_ITEM_REMOVED);
+        gone.AddString("path", source);
+        fTarget.SendMessage(&gone);
+      }
+    }
+  }
+
+  // 2) Removals.
+  int32 removed = 0;
+  BString path;
+  for (int32 i = 0; msg->FindString("removed", i, &path) == B_OK; i++)
+    removed += _RemoveEntriesAt(path);
+
+  // 3) Changes: one incremental scanner per source root.
+  std::vector<BString> dirs;
+  LoadDirectories(dirs);
+  std::map<BString, std::vector<BString>> byRoot;
+  for (int32 i = 0; msg->FindString("changed", i, &path) == B_OK; i++) {
+    if (IsDisabledMidiPath(path))
+      continue;
+    for (const BString &dir : dirs) {
+      BString prefix(dir);
+      prefix << "/";
+      if (path.StartsWith(prefix)) {
+        byRoot[dir].push_back(path);
+        break;
+      }
+    }
+  }
+
+  DEBUG_PRINT("Watcher update: %ld removed, %zu roots to rescan\n",
+              (long)removed, byRoot.size());
+
+  for (const auto &root : byRoot) {
+    entry_ref ref;
+    if (get_ref_for_path(root.first.String(), &ref) != B_OK)
+      continue;
+
+    auto *scanner = new MediaLibraryScanner(ref, BMessenger(this), fTarget);
+    scanner->SetPaths(root.second);
+    scanner->SetTagReaderCount(fTagReaderCount);
+    scanner->Run();
+    BMessenger(scanner).SendMessage(MSG_START_SCAN);
+    fActiveWatchScanners++;
+  }
 
-  for (const auto &kv : fEntries) {
-    out.push_back(kv.second);
+  if (byRoot.empty() && fCacheDirty)
+    SaveCache();
+}
+
+/**
+ * @brief Returns the snapshot for the current entries, creating it if the
+ * entries changed since the last call.
+ *
+ * Locks the looper, so it may be called from other threads.
+ */
+BReference<LibrarySnapshot> MediaLibraryCache::CurrentSnapshot() {
+  BAutolock locker(this);
+  if (fPublished.Get() == nullptr || fPublished->Version() != fVersion) {
+    fPublished.SetTo(new LibrarySnapshot(fVersion, fEntries.Items()), true);
   }
-  return out;
+  return fPublished;
+}
+
+void MediaLibraryCache::DispatchMessage(BMessage *msg, BHandler *handler) {
+  static const int32 sStatsSlot = LooperStats::Register("MediaLibraryCache");
+  LooperStats::Scope scope(sStatsSlot, this, msg);
+  BLooper::DispatchMessage(msg, handler);
 }
 
 /**
@@ -451,153 +1014,79 @@ void MediaLibraryCache::MessageReceived(BMessage *msg) {
     LoadCache();
     break;
 
+  case MSG_START_LIVE_QUERIES:
+    if (fLiveQueriesWanted)
+      break;
+    fLiveQueriesWanted = true;
+    if (fLoaded)
+      _StartLiveQueries();
+    break;
+
   case MSG_MEDIA_BATCH: {
-    type_code type;
-    int32 count = 0;
-    if (msg->GetInfo("path", &type, &count) != B_OK)
+    BReference<MediaBatch> batch = MediaBatch::Detach(msg);
+    if (batch.Get() == nullptr)
       break;
 
-    const char *baseStr = nullptr;
-    msg->FindString("base", &baseStr);
+    for (const auto &move : batch->moves) {
+      if (!fEntries.Rename(move.first, move.second))
+        continue;
+      _MarkChanged(move.first);
+      _MarkChanged(move.second);
+      fMissingSince.erase(move.first);
+      DEBUG_PRINT("File moved outside the app: %s -> %s\n",
+                  move.first.String(), move.second.String());
 
-    for (int32 i = 0; i < count; i++) {
-      MediaItem e;
-      const char *itemBaseStr = nullptr;
-      if (msg->FindString("item_base", i, &itemBaseStr) == B_OK)
-        e.base = itemBaseStr;
-      else if (baseStr)
-        e.base = baseStr;
-
-      const char *tmp = nullptr;
-      if (msg->FindString("path", i, &tmp) == B_OK)
-        e.path = tmp;
-      if (msg->FindString("title", i, &tmp) == B_OK)
-        e.title = tmp;
-      if (msg->FindString("artist", i, &tmp) == B_OK)
-        e.artist = tmp;
-      if (msg->FindString("album", i, &tmp) == B_OK)
-        e.album = tmp;
-      if (msg->FindString("genre", i, &tmp) == B_OK)
-        e.genre = tmp;
-
-      msg->FindInt32("year", i, &e.year);
-      msg->FindInt32("track", i, &e.track);
-      msg->FindInt32("disc", i, &e.disc);
-      msg->FindInt32("duration", i, &e.duration);
-      msg->FindInt32("bitrate", i, &e.bitrate);
-      msg->FindInt64("size", i, &e.size);
-      msg->FindInt64("mtime", i, &e.mtime);
-      msg->FindInt64("inode", i, &e.inode);
-      msg->FindInt32("rating", i, &e.rating);
-      if (e.rating > 0)
-        DEBUG_PRINT("Received rating %d for %s\n", (int)e.rating,
-                    e.path.String());
-
-      if (msg->FindString("mbAlbumId", i, &tmp) == B_OK)
-        e.mbAlbumId = tmp;
-      if (msg->FindString("mbArtistId", i, &tmp) == B_OK)
-        e.mbArtistId = tmp;
-      if (msg->FindString("mbTrackId", i, &tmp) == B_OK)
-        e.mbTrackId = tmp;
-
-      AddOrUpdateEntry(e);
-    }
-
-    DEBUG_PRINT("Processed batch of %d items\n", (int)count);
-
-    // Ensure cache is saved after scan completion.
-    fCacheDirty = true;
+      // The window gets the new path with the items of this batch.
+      if (fTarget.IsValid()) {
+        BMessage gone(MSG_MEDIA_ITEM_REMOVED);
+        gone.AddString("path", move.first);
+        fTarget.SendMessage(&gone);
+      }
+    }
+
+    TRACE_SCOPE(kTraceCache, "apply batch", (int64)batch->items.size());
+    for (const MediaItem &item : batch->items)
+      AddOrUpdateEntry(item);
 
+    // The window shares the same batch; nothing is copied or re-packed.
     if (fTarget.IsValid())
-      fTarget.SendMessage(msg);
+      batch->SendTo(fTarget, MSG_MEDIA_BATCH);
     break;
   }
 
   case MSG_MEDIA_ITEM_FOUND: {
-    MediaItem e;
-    const char *tmpStr = nullptr;
-
-    if (msg->FindString("path", &tmpStr) != B_OK)
-      break;
-    e.path = tmpStr;
-
-    auto existing = fEntries.find(e.path);
-    if (existing != fEntries.end())
-      e = existing->second;
-    e.path = tmpStr;
-
-    if (msg->FindString("base", &tmpStr) == B_OK)
-      e.base = tmpStr;
-    if (msg->FindString("title", &tmpStr) == B_OK)
-      e.title = tmpStr;
-    if (msg->FindString("artist", &tmpStr) == B_OK)
-      e.artist = tmpStr;
-    if (msg->FindString("album", &tmpStr) == B_OK)
-      e.album = tmpStr;
-    if (msg->FindString("genre", &tmpStr) == B_OK)
-      e.genre = tmpStr;
-    if (msg->FindString("comment", &tmpStr) == B_OK)
-      e.comment = tmpStr;
-    if (msg->FindString("albumArtist", &tmpStr) == B_OK)
-      e.albumArtist = tmpStr;
-    if (msg->FindString("composer", &tmpStr) == B_OK)
-      e.composer = tmpStr;
-
-    msg->FindInt32("year", &e.year);
-    msg->FindInt32("track", &e.track);
-    msg->FindInt32("trackTotal", &e.trackTotal);
-    msg->FindInt32("disc", &e.disc);
-    msg->FindInt32("discTotal", &e.discTotal);
-    msg->FindInt32("duration", &e.duration);
-    msg->FindInt32("bitrate", &e.bitrate);
-    msg->FindInt32("sampleRate", &e.sampleRate);
-    msg->FindInt32("channels", &e.channels);
-    msg->FindInt32("rating", &e.rating);
-    msg->FindInt64("size", &e.size);
-    msg->FindInt64("mtime", &e.mtime);
-    msg->FindInt64("inode", &e.inode);
-
-    if (msg->FindString("mbAlbumId", &tmpStr) == B_OK ||
-        msg->FindString("mbAlbumID", &tmpStr) == B_OK)
-      e.mbAlbumId = tmpStr;
-    if (msg->FindString("mbArtistId", &tmpStr) == B_OK ||
-        msg->FindString("mbArtistID", &tmpStr) == B_OK)
-      e.mbArtistId = tmpStr;
-    if (msg->FindString("mbTrackId", &tmpStr) == B_OK ||
-        msg->FindString("mbTrackID", &tmpStr) == B_OK)
-      e.mbTrackId = tmpStr;
-
-    AddOrUpdateEntry(e);
-
-    fCacheDirty = true;
-
-    DEBUG_PRINT("Item found: path=%s, title=%s\n",
-                e.path.String(), e.title.String());
+    if (_ApplyItemUpdate(msg) && fTarget.IsValid())
+      fTarget.SendMessage(msg);
+    break;
+  }
 
+  case MSG_MEDIA_ITEMS_UPDATED: {
+    BMessage item;
+    for (int32 i = 0; msg->FindMessage("item", i, &item) == B_OK; i++)
+      _ApplyItemUpdate(&item);
     if (fTarget.IsValid())
       fTarget.SendMessage(msg);
     break;
   }
 
   case MSG_FILE_MOVED: {
+    // One message may carry a whole batch of moves; save once.
     BString from, to;
-    if (msg->FindString("from", &from) != B_OK ||
-        msg->FindString("to", &to) != B_OK)
-      break;
-
-    auto it = fEntries.find(from);
-    if (it == fEntries.end())
+    int32 renamed = 0;
+    for (int32 i = 0; msg->FindString("from", i, &from) == B_OK &&
+                      msg->FindString("to", i, &to) == B_OK;
+         i++) {
+      if (!fEntries.Rename(from, to))
+        continue;
+      _MarkChanged(from);
+      _MarkChanged(to);
+      renamed++;
+    }
+    if (renamed == 0)
       break;
 
-    MediaItem e = it->second;
-    fEntries.erase(it);
-    e.path = to;
-    fEntries[e.path] = e;
-
-    DEBUG_PRINT("File moved in cache: %s -> %s\n", from.String(),
-                to.String());
+    DEBUG_PRINT("Files moved in cache: %ld\n", (long)renamed);
     SaveCache();
-    fCacheDirty = false;
     break;
   }
 
@@ -611,24 +1100,168 @@ void MediaLibraryCache::MessageReceived(BMessage *msg) {
   }
   case MSG_RESCAN:
     DEBUG_PRINT("received MSG_RESCAN, starting new scan\n");
-    StartScan();
+    StartScan(msg->GetBool("full", false));
+    break;
+
+  case MSG_SET_TAG_READERS:
+    fTagReaderCount = msg->GetInt32("count", 0);
+    break;
+
+  case MSG_SCAN_PROGRESS: {
+    BString base;
+    if (fActiveScanners <= 0 || msg->FindString("base", &base) != B_OK)
+      break;
+    ScanProgress &progress = fScanProgress[base];
+    msg->FindInt32("dirs", &progress.dirs);
+    msg->FindInt32("files", &progress.files);
+    msg->FindFloat("files_per_sec", &progress.filesPerSec);
+    msg->FindFloat("mb_per_sec", &progress.mbPerSec);
+    _ForwardScanProgress(false);
+    break;
+  }
+
+  case MSG_SET_SCAN_WALKERS:
+    fScheduler.SetDeviceLimit(msg->GetInt32("count", 1));
+    break;
+
+  case MSG_SCAN_SET_PAUSED:
+    fScheduler.SetPaused(msg->GetBool("paused", false));
+    break;
+
+  case MSG_PLAYBACK_DEVICE:
+    fScheduler.SetPlaybackDevice((dev_t)msg->GetInt32("device", -1));
+    break;
+
+  case MSG_SCAN_PRIORITY: {
+    std::vector<BString> paths;
+    BString path;
+    for (int32 i = 0; msg->FindString("path", i, &path) == B_OK; i++)
+      paths.push_back(path);
+    fScheduler.SetPriorityPaths(paths);
+    break;
+  }
+
+  case MSG_CACHE_GC: {
+    int32 days;
+    if (msg->FindInt32("days", &days) == B_OK && days > 0)
+      fMissingRetention = (time_t)days * 24 * 60 * 60;
+    _CollectGarbage(true);
+    break;
+  }
+
+  case MSG_LIBRARY_CHANGED:
+    _ApplyLibraryChanges(msg);
+    break;
+
+  case MSG_MEMORY_TRIM:
+    fEntries.Compact();
+    break;
+
+  case MSG_VALIDATE_CACHE:
+    _StartValidation(msg);
+    break;
+
+  case MSG_VALIDATE_NEXT:
+    _ValidateNext();
+    break;
+
+  case MSG_LOUDNESS_SCAN:
+    if (msg->GetBool("stop", false)) {
+      fLoudness.Cancel();
+    } else {
+      BReference<LibrarySnapshot> snapshot = CurrentSnapshot();
+      fLoudness.Start(snapshot.Get(), msg->GetBool("write", false));
+    }
+    break;
+
+  case MSG_LOUDNESS_RESULT:
+    _ApplyLoudness(msg);
+    break;
+
+  case MSG_LOUDNESS_PROGRESS:
+    if (msg->GetBool("done", false) && fCacheDirty)
+      SaveCache();
+    if (fTarget.IsValid())
+      fTarget.SendMessage(msg);
+    break;
+
+  case MSG_ACOUSTID_SCAN:
+    if (msg->GetBool("stop", false)) {
+      fAcoustId.Cancel();
+    } else {
+      BReference<LibrarySnapshot> snapshot = CurrentSnapshot();
+      fAcoustId.Start(snapshot.Get(), msg->GetBool("write", false));
+    }
+    break;
+
+  case MSG_ACOUSTID_RESULT:
+    _ApplyAcoustIds(msg);
+    break;
+
+  case MSG_ACOUSTID_PROGRESS:
+    if (msg->GetBool("done", false) && fCacheDirty)
+      SaveCache();
+    if (fTarget.IsValid())
+      fTarget.SendMessage(msg);
     break;
 
   case MSG_SCAN_DONE: {
+    if (msg->GetBool("incremental", false)) {
+      fActiveWatchScanners--;
+      if (fCacheDirty)
+        SaveCache();
+      break;
+    }
+
     DEBUG_PRINT("received MSG_SCAN_DONE (scanners left: %ld)\\n",
                 (long)(fActiveScanners - 1));
 
+    BString base;
+    if (msg->FindString("base", &base) == B_OK) {
+      fScheduler.Finished(base);
+      _RemovePending(base);
+      ScanProgress &progress = fScanProgress[base];
+      msg->FindInt32("dirs", &progress.dirs);
+      msg->FindInt32("files", &progress.files);
+      progress.filesPerSec = 0;
+      progress.mbPerSec = 0;
+
+      BMessage stats;
+      if (msg->FindMessage("stats", &stats) == B_OK) {
+        DEBUG_PRINT("Scan of %s:\n%s", base.String(),
+                    ScanStats::Report(stats).String());
+      }
+
+      auto started = fScanStarted.find(base);
+      if (started != fScanStarted.end()) {
+        ScanState &state = fScanStates[base];
+        state.lastScan = started->second;
+        if (!msg->GetBool("delta", false))
+          state.lastFullScan = started->second;
+        fScanStarted.erase(started);
+        _SaveScanState();
+      }
+    }
+
     if (--fActiveScanners <= 0) {
-      if (fCacheDirty) {
+      while (!fPendingRemovals.empty())
+        _RemovePending(fPendingRemovals.begin()->first);
+
+      // The window reloads the snapshot on MSG_SCAN_DONE anyway.
+      _CollectGarbage(false);
+      if (fCacheDirty || fSnapshotStale) {
         DEBUG_PRINT(
             "all scanners finished, writing media.cache\\n");
         SaveCache();
-        fCacheDirty = false;
       }
 
       if (fTarget.IsValid()) {
+        _ForwardScanProgress(true);
+
         DEBUG_PRINT("forward MSG_SCAN_DONE to MainWindow\\n");
         BMessage done(MSG_SCAN_DONE);
+        done.AddInt64("elapsed_sec",
+                      (system_time() - fScanStartTime) / 1000000);
         fTarget.SendMessage(&done);
       }
     }
@@ -636,57 +1269,32 @@ void MediaLibraryCache::MessageReceived(BMessage *msg) {
   }
 
   case B_QUERY_UPDATE: {
+    // Files leave the result set only when their query is replaced.
     int32 opcode;
-    if (msg->FindInt32("opcode", &opcode) == B_OK) {
-      DEBUG_PRINT("B_QUERY_UPDATE received with opcode %ld\n",
-                  (long)opcode);
-
-      dev_t device;
-      ino_t directory;
-      const char *name;
-      if (msg->FindInt32("device", &device) == B_OK &&
-          msg->FindInt64("directory", &directory) == B_OK &&
-          msg->FindString("name", &name) == B_OK) {
-        entry_ref ref(device, directory, name);
-        BPath path(&ref);
-        if (path.InitCheck() == B_OK) {
-          BString pathStr = path.Path();
-          DEBUG_PRINT("B_QUERY_UPDATE path: %s\n",
-                      pathStr.String());
-
-          auto it = fEntries.find(pathStr);
-          if (it != fEntries.end()) {
-            DEBUG_PRINT("Path found in fEntries, rereading "
-                        "attributes...\n");
-            if (_RereadBfsAttributes(it->second)) {
-              DEBUG_PRINT("Attributes changed! Sending "
-                          "MSG_MEDIA_ITEM_FOUND\n");
-              fCacheDirty = true;
-              if (fTarget.IsValid()) {
-                BMessage update(MSG_MEDIA_ITEM_FOUND);
-                update.AddString("path", it->second.path);
-                update.AddString("title", it->second.title);
-                update.AddString("artist", it->second.artist);
-                update.AddString("album", it->second.album);
-                update.AddString("genre", it->second.genre);
-                update.AddString("comment", it->second.comment);
-                update.AddString("albumArtist", it->second.albumArtist);
-                update.AddString("composer", it->second.composer);
-                update.AddInt32("year", it->second.year);
-                update.AddInt32("track", it->second.track);
-                update.AddInt32("rating", it->second.rating);
-                update.AddInt32("duration", it->second.duration);
-                update.AddInt32("bitrate", it->second.bitrate);
-                fTarget.SendMessage(&update);
-              }
-            }
-          }
-        }
-      }
+    dev_t device;
+    ino_t directory;
+    const char *name;
+    if (msg->FindInt32("opcode", &opcode) == B_OK &&
+        opcode != B_ENTRY_REMOVED &&
+        msg->FindInt32("device", &device) == B_OK &&
+        msg->FindInt64("directory", &directory) == B_OK &&
+        msg->FindString("name", &name) == B_OK) {
+      entry_ref ref(device, directory, name);
+      BPath path(&ref);
+      if (path.InitCheck() == B_OK && fEntries.Find(path.Path()) != nullptr)
+        _QueueReread(path.Path(), device);
     }
     break;
   }
 
+  case MSG_ATTR_POLL:
+    _RereadQueued();
+    break;
+
+  case MSG_BFS_INDEXES_CREATE:
+    _CreateIndexes(msg);
+    break;
+
   default:
     BLooper::MessageReceived(msg);
   }
@@ -699,19 +1307,74 @@ void MediaLibraryCache::MessageReceived(BMessage *msg) {
  * @param entry The item to store.
  */
 void MediaLibraryCache::AddOrUpdateEntry(const MediaItem &entry) {
-  auto it = fEntries.find(entry.path);
-  if (it == fEntries.end()) {
-    fEntries[entry.path] = entry;
+  _MarkChanged(entry.path);
+
+  const MediaItem *old = fEntries.Find(entry.path);
+  if (old != nullptr && !old->mbTrackId.IsEmpty() &&
+      entry.mbTrackId.IsEmpty()) {
+    DEBUG_PRINT("WARNING: Overwriting existing MB Track ID "
+                "for %s with empty value!\n",
+                entry.path.String());
+  }
+  if (!entry.missing && !fMissingSince.empty())
+    fMissingSince.erase(entry.path);
+
+  MediaItem item(entry);
+  // A rescan of an unchanged file keeps its analysis results.
+  if (old != nullptr && !item.HasLoudness() && old->HasLoudness() &&
+      old->mtime == item.mtime && old->size == item.size) {
+    item.trackGain = old->trackGain;
+    item.trackPeak = old->trackPeak;
+    item.albumGain = old->albumGain;
+    item.albumPeak = old->albumPeak;
+  }
+  if (old != nullptr && item.acoustId.IsEmpty() && !old->acoustId.IsEmpty() &&
+      old->mtime == item.mtime && old->size == item.size)
+    item.acoustId = old->acoustId;
+  StringPool::Default().InternItem(item);
+  fEntries.Put(std::move(item));
+}
 
-  } else {
-    const MediaItem &old = it->second;
-    if (!old.mbTrackId.IsEmpty() && entry.mbTrackId.IsEmpty()) {
-      DEBUG_PRINT("WARNING: Overwriting existing MB Track ID "
-                  "for %s with empty value!\n",
-                  entry.path.String());
-    }
-    fEntries[entry.path] = entry;
+void MediaLibraryCache::_ApplyLoudness(BMessage *msg) {
+  BReference<MediaBatch> batch(new MediaBatch, true);
+  const char *path = nullptr;
+  for (int32 i = 0; msg->FindString("path", i, &path) == B_OK; i++) {
+    const MediaItem *existing = fEntries.Find(BString(path));
+    if (existing == nullptr)
+      continue;
+
+    MediaItem item(*existing);
+    msg->FindInt32("trackGain", i, &item.trackGain);
+    msg->FindInt32("trackPeak", i, &item.trackPeak);
+    msg->FindInt32("albumGain", i, &item.albumGain);
+    msg->FindInt32("albumPeak", i, &item.albumPeak);
+    AddOrUpdateEntry(item);
+    batch->items.push_back(item);
   }
+
+  if (!batch->items.empty() && fTarget.IsValid())
+    batch->SendTo(fTarget, MSG_MEDIA_BATCH);
+}
+
+void MediaLibraryCache::_ApplyAcoustIds(BMessage *msg) {
+  BReference<MediaBatch> batch(new MediaBatch, true);
+  const char *path = nullptr;
+  const char *acoustId = nullptr;
+  for (int32 i = 0; msg->FindString("path", i, &path) == B_OK &&
+                    msg->FindString("acoustId", i, &acoustId) == B_OK;
+       i++) {
+    const MediaItem *existing = fEntries.Find(BString(path));
+    if (existing == nullptr || existing->acoustId == acoustId)
+      continue;
+
+    MediaItem item(*existing);
+    item.acoustId = acoustId;
+    AddOrUpdateEntry(item);
+    batch->items.push_back(item);
+  }
+
+  if (!batch->items.empty() && fTarget.IsValid())
+    batch->SendTo(fTarget, MSG_MEDIA_BATCH);
 }
 
 /**
@@ -719,9 +1382,13 @@ void MediaLibraryCache::AddOrUpdateEntry(const MediaItem &entry) {
  * This is used when a configured directory is not found/mounted.
  */
 void MediaLibraryCache::MarkBaseOffline(const BString &basePath) {
-  for (auto &kv : fEntries) {
-    if (kv.first.StartsWith(basePath)) {
-      kv.second.missing = true;
+  const time_t now = (time_t)real_time_clock();
+  for (size_t i = 0; i < fEntries.Count(); i++) {
+    MediaItem &item = fEntries.ItemAt(i);
+    if (item.path.StartsWith(basePath) && !item.missing) {
+      item.missing = true;
+      fMissingSince.emplace(item.path, now);
+      _MarkChanged(item.path);
     }
   }
 
@@ -733,39 +1400,277 @@ void MediaLibraryCache::MarkBaseOffline(const BString &basePath) {
 }
 
 /**
- * @brief Creates live queries for `Media:Rating == 1..10` on one device.
- * @param device Target BFS volume device id.
+ * @brief Starts checking the loaded entries against the disk.
+ *
+ * Runs in small batches on this looper, so scanner and watcher messages get
+ * their turn in between. Rows the window shows come first. Changed files are
+ * re-read and missing ones removed through _ApplyLibraryChanges(); entries
+ * of unreachable sources are left alone.
  */
-void MediaLibraryCache::_InitRatingLiveQueries(dev_t device) {
-  BVolume vol(device);
-  if (vol.InitCheck() != B_OK || !vol.KnowsQuery())
+void MediaLibraryCache::_StartValidation(BMessage *msg) {
+  fValidationQueue.clear();
+  fValidationNext = 0;
+  fValidationChanged = 0;
+  fValidationRemoved = 0;
+  fValidationStart = system_time();
+
+  std::vector<BString> dirs;
+  LoadDirectories(dirs);
+  fValidationRoots.clear();
+  for (const BString &dir : dirs) {
+    BEntry root(dir.String());
+    if (root.Exists())
+      fValidationRoots.push_back(dir);
+  }
+
+  fValidationQueue.reserve(fEntries.Count());
+  std::set<BString> first;
+  BString path;
+  for (int32 i = 0; msg->FindString("path", i, &path) == B_OK; i++) {
+    if (fEntries.Find(path) != nullptr && first.insert(path).second)
+      fValidationQueue.push_back(path);
+  }
+  for (const MediaItem &item : fEntries.Items()) {
+    if (first.find(item.path) == first.end())
+      fValidationQueue.push_back(item.path);
+  }
+
+  DEBUG_PRINT("Validation: %zu entries (%zu on screen)\n",
+              fValidationQueue.size(), first.size());
+  PostMessage(MSG_VALIDATE_NEXT);
+}
+
+void MediaLibraryCache::_ValidateNext() {
+  // A running scan checks every file anyway.
+  if (fActiveScanners > 0) {
+    DEBUG_PRINT("Validation: superseded by a scan\n");
+    fValidationQueue.clear();
     return;
+  }
 
-  for (int32 i = 1; i <= 10; i++) {
-    BQuery *q = new BQuery();
-    q->SetVolume(&vol);
-    q->PushAttr("Media:Rating");
-    q->PushInt32(i);
-    q->PushOp(B_EQ);
-    q->SetTarget(BMessenger(this));
-    status_t status = q->Fetch();
-    if (status == B_OK) {
-      entry_ref dummy;
-      while (q->GetNextRef(&dummy) == B_OK) {
-        // Drain initial results so the live query starts emitting updates.
+  BMessage changes(MSG_LIBRARY_CHANGED);
+  const size_t end =
+      std::min(fValidationNext + kValidationBatchSize, fValidationQueue.size());
+  for (; fValidationNext < end; fValidationNext++) {
+    const BString &path = fValidationQueue[fValidationNext];
+    const MediaItem *item = fEntries.Find(path);
+    if (item == nullptr || item->missing)
+      continue;
+
+    bool reachable = false;
+    for (const BString &root : fValidationRoots) {
+      BString prefix(root);
+      prefix << "/";
+      if (path.StartsWith(prefix)) {
+        reachable = true;
+        break;
       }
-    } else {
-      DEBUG_PRINT("Live Query failed for rating %ld on device "
-                  "%d (status %d)\n",
-                  (long)i, (int)device, (int)status);
     }
-    fRatingQueries.push_back(q);
+    if (!reachable)
+      continue;
+
+    struct stat st;
+    if (stat(path.String(), &st) != 0) {
+      changes.AddString("removed", path);
+      fValidationRemoved++;
+    } else if (st.st_mtime != item->mtime || st.st_size != item->size) {
+      changes.AddString("changed", path);
+      fValidationChanged++;
+    }
+  }
+
+  if (changes.HasString("removed") || changes.HasString("changed"))
+    _ApplyLibraryChanges(&changes);
+
+  if (fValidationNext < fValidationQueue.size()) {
+    PostMessage(MSG_VALIDATE_NEXT);
+    return;
+  }
+
+  DEBUG_PRINT("Validation: %zu checked, %ld changed, %ld removed "
+              "in %lld ms\n",
+              fValidationQueue.size(), (long)fValidationChanged,
+              (long)fValidationRemoved,
+              (long long)((system_time() - fValidationStart) / 1000));
+  fValidationQueue.clear();
+  fValidationQueue.shrink_to_fit();
+}
+
+void MediaLibraryCache::_RemovePending(const BString &base) {
+  auto pending = fPendingRemovals.find(base);
+  if (pending == fPendingRemovals.end())
+    return;
+
+  for (const BString &path : pending->second) {
+    // Moved entries were renamed away; re-created files are kept.
+    if (fEntries.Find(path) == nullptr || BEntry(path.String()).Exists())
+      continue;
+    DEBUG_PRINT("Remove missing file: %s\n", path.String());
+
+    if (fTarget.IsValid()) {
+      BMessage gone(MSG_MEDIA_ITEM_REMOVED);
+      gone.AddString("path", path);
+      fTarget.SendMessage(&gone);
+    }
+    fEntries.Remove(path);
+    fMissingSince.erase(path);
+    _MarkChanged(path);
+  }
+  fPendingRemovals.erase(pending);
+}
+
+void MediaLibraryCache::_ForwardScanProgress(bool force) {
+  bigtime_t now = system_time();
+  if (!fTarget.IsValid() ||
+      (!force && now - fLastProgressSent < kScanProgressInterval))
+    return;
+  fLastProgressSent = now;
+
+  // Scanners run on different devices, so their throughputs add up.
+  int32 dirs = 0, files = 0;
+  float filesPerSec = 0, mbPerSec = 0;
+  for (const auto &progress : fScanProgress) {
+    dirs += progress.second.dirs;
+    files += progress.second.files;
+    filesPerSec += progress.second.filesPerSec;
+    mbPerSec += progress.second.mbPerSec;
+  }
+
+  BMessage progress(MSG_SCAN_PROGRESS);
+  progress.AddInt32("dirs", dirs);
+  progress.AddInt32("files", files);
+  progress.AddFloat("files_per_sec", filesPerSec);
+  progress.AddFloat("mb_per_sec", mbPerSec);
+  progress.AddInt64("elapsed_sec", (now - fScanStartTime) / 1000000);
+  progress.AddInt32("running", fScheduler.CountRunning());
+  progress.AddInt32("queued", fScheduler.CountQueued());
+  fTarget.SendMessage(&progress);
+}
+
+off_t MediaLibraryCache::_CacheFileSize() const {
+  off_t size = fJournal.Size();
+  struct stat st;
+  if (stat(fCachePath.String(), &st) == 0)
+    size += st.st_size;
+  return size;
+}
+
+int32 MediaLibraryCache::_CollectGarbage(bool notify) {
+  std::vector<BString> dirs;
+  LoadDirectories(dirs);
+  const time_t now = (time_t)real_time_clock();
+
+  // Without any configured source a broken settings file must not empty the
+  // library; StartScan() handles an intentionally empty source list.
+  std::set<BString> validBases(dirs.begin(), dirs.end());
+  const bool checkSources = !validBases.empty();
+
+  int32 orphaned = 0, expired = 0;
+  std::vector<BString> removed;
+  fEntries.RemoveIf([&](const MediaItem &e) {
+    if (checkSources && validBases.find(e.base) == validBases.end()) {
+      orphaned++;
+      removed.push_back(e.path);
+      return true;
+    }
+    if (!e.missing)
+      return false;
+
+    // Entries missing since before this was tracked start the clock now.
+    auto since = fMissingSince.emplace(e.path, now).first;
+    if (now - since->second < fMissingRetention)
+      return false;
+    expired++;
+    removed.push_back(e.path);
+    return true;
+  });
+
+  size_t tracked = fMissingSince.size();
+  for (auto it = fMissingSince.begin(); it != fMissingSince.end();) {
+    const MediaItem *item = fEntries.Find(it->first);
+    if (item == nullptr || !item->missing)
+      it = fMissingSince.erase(it);
+    else
+      ++it;
+  }
+  if (!removed.empty() || tracked != fMissingSince.size())
+    _SaveScanState();
+
+  if (removed.empty())
+    return 0;
+
+  DEBUG_PRINT("Cache GC: dropped %ld entries of removed sources, %ld missing "
+              "for more than %ld days\n",
+              (long)orphaned, (long)expired,
+              (long)(fMissingRetention / (24 * 60 * 60)));
+
+  for (const BString &path : removed)
+    _MarkChanged(path);
+
+  BMessage report(MSG_CACHE_GC_DONE);
+  report.AddInt32("orphaned", orphaned);
+  report.AddInt32("expired", expired);
+  report.AddInt64("bytes_before", (int64)_CacheFileSize());
+
+  // Rewrite the whole snapshot instead of journaling every tombstone.
+  fSnapshotStale = true;
+  if (fCompacting.load()) {
+    // A snapshot is being written; this one follows with the next save.
+    if (fTarget.IsValid())
+      fTarget.SendMessage(&report);
+  } else {
+    fCollectReport = report;
   }
+  SaveCache();
+
+  if (notify && fTarget.IsValid()) {
+    BMessage update(MSG_CACHE_LOADED);
+    fTarget.SendMessage(&update);
+  }
+  return (int32)removed.size();
+}
+
+void MediaLibraryCache::_InitLiveQuery(dev_t device, time_t since,
+                                       const std::set<BString> *reread) {
+  auto existing = fLiveQueries.find(device);
+  if (existing != fLiveQueries.end()) {
+    delete existing->second;
+    fLiveQueries.erase(existing);
+  }
+
+  BVolume vol(device);
+  if (vol.InitCheck() != B_OK || !vol.KnowsQuery())
+    return;
 
-  fQueriedVolumes.insert(device);
-  DEBUG_PRINT(
-      "Initialized 10 Rating Live Queries for device %d\n",
-      (int)device);
+  // One query on the last_modified index covers changes to any attribute
+  // or tag, whichever application made them.
+  BString predicate;
+  predicate << "(last_modified>=" << (int64)since << ")";
+
+  BQuery *q = new BQuery();
+  q->SetVolume(&vol);
+  q->SetPredicate(predicate.String());
+  q->SetTarget(BMessenger(this));
+  status_t status = q->Fetch();
+  if (status != B_OK) {
+    DEBUG_PRINT("Live query failed on device %d (status %d)\n", (int)device,
+                (int)status);
+    delete q;
+    fLiveQueries[device] = nullptr;
+    return;
+  }
+  fLiveQueries[device] = q;
+
+  // Draining the initial results starts the updates. Files changed since
+  // `since` are in the set already and would not be reported.
+  entry_ref ref;
+  while (q->GetNextRef(&ref) == B_OK) {
+    BPath path(&ref);
+    if (path.InitCheck() != B_OK || fEntries.Find(path.Path()) == nullptr)
+      continue;
+    if (reread == nullptr || reread->count(path.Path()) == 0)
+      _QueueReread(path.Path(), device);
+  }
 }
 
 /**
@@ -781,10 +1686,120 @@ void MediaLibraryCache::_InitAllLiveQueries() {
     if (entry.InitCheck() == B_OK && entry.Exists() && entry.IsDirectory()) {
       entry_ref ref;
       entry.GetRef(&ref);
-      BVolume vol(ref.device);
-      if (vol.KnowsQuery() &&
-          fQueriedVolumes.find(ref.device) == fQueriedVolumes.end()) {
-        _InitRatingLiveQueries(ref.device);
+      if (fLiveQueries.find(ref.device) == fLiveQueries.end())
+        _InitLiveQuery(ref.device, time(nullptr));
+      _CheckIndexes(ref.device);
+    }
+  }
+}
+
+void MediaLibraryCache::_QueueReread(const BString &path, dev_t device) {
+  fRereadQueue.insert(path);
+  fRereadDevices.insert(device);
+  if (fRereadRunner == nullptr) {
+    BMessage poll(MSG_ATTR_POLL);
+    fRereadRunner =
+        new BMessageRunner(BMessenger(this), &poll, kAttrRereadDelay, 1);
+  }
+}
+
+void MediaLibraryCache::_RereadQueued() {
+  delete fRereadRunner;
+  fRereadRunner = nullptr;
+
+  // Changes from now on are caught by the re-armed queries.
+  const time_t batchStart = time(nullptr);
+  std::set<BString> paths;
+  paths.swap(fRereadQueue);
+  std::set<dev_t> devices;
+  devices.swap(fRereadDevices);
+
+  BMessage batch(MSG_MEDIA_ITEMS_UPDATED);
+  int32 changed = 0;
+  for (const BString &path : paths) {
+    MediaItem *item = fEntries.Find(path);
+    if (item == nullptr || !_RereadBfsAttributes(*item))
+      continue;
+    _MarkChanged(item->path);
+    BMessage update(MSG_MEDIA_ITEM_FOUND);
+    update.AddString("path", item->path);
+    update.AddString("title", item->title);
+    update.AddString("artist", item->artist);
+    update.AddString("album", item->album);
+    update.AddString("genre", item->genre);
+    update.AddString("comment", item->comment);
+    update.AddString("albumArtist", item->albumArtist);
+    update.AddString("composer", item->composer);
+    update.AddInt32("year", item->year);
+    update.AddInt32("track", item->track);
+    update.AddInt32("rating", item->rating);
+    update.AddInt32("duration", item->duration);
+    update.AddInt32("bitrate", item->bitrate);
+    batch.AddMessage("item", &update);
+    changed++;
+  }
+  DEBUG_PRINT("Live queries: %zu files re-read, %ld changed\n", paths.size(),
+              (long)changed);
+
+  if (changed > 0) {
+    SaveCache();
+    if (fTarget.IsValid())
+      fTarget.SendMessage(&batch);
+  }
+
+  for (dev_t device : devices)
+    _InitLiveQuery(device, batchStart, &paths);
+}
+
+void MediaLibraryCache::_CheckIndexes(dev_t device) {
+  if (!fIndexChecked.insert(device).second || !fTarget.IsValid())
+    return;
+
+  BVolume vol(device);
+  char name[B_FILE_NAME_LENGTH];
+  if (vol.InitCheck() != B_OK || !vol.KnowsQuery() || vol.IsReadOnly() ||
+      vol.GetName(name) != B_OK || fIndexDeclined.count(name) > 0)
+    return;
+
+  BMessage ask(MSG_BFS_INDEXES_MISSING);
+  for (const auto &attr : kIndexedAttributes) {
+    index_info info;
+    if (fs_stat_index(device, attr.name, &info) != 0)
+      ask.AddString("attr", attr.name);
+  }
+  if (!ask.HasString("attr"))
+    return;
+
+  ask.AddInt32("device", device);
+  ask.AddString("volume", name);
+  fTarget.SendMessage(&ask);
+}
+
+void MediaLibraryCache::_CreateIndexes(BMessage *msg) {
+  int32 which = 0;
+  dev_t device;
+  BString volume;
+  if (msg->FindInt32("device", &device) != B_OK ||
+      msg->FindString("volume", &volume) != B_OK)
+    return;
+
+  // 0 is "Not now"; the volume is not asked about again.
+  if (msg->FindInt32("which", &which) != B_OK || which != 1) {
+    fIndexDeclined.insert(volume);
+    _SaveScanState();
+    return;
+  }
+
+  const char *name;
+  for (int32 i = 0; msg->FindString("attr", i, &name) == B_OK; i++) {
+    for (const auto &attr : kIndexedAttributes) {
+      if (strcmp(attr.name, name) != 0)
+        continue;
+      if (fs_create_index(device, attr.name, attr.type, 0) != 0) {
+        DEBUG_PRINT("Could not create index %s on %s: %s\n", attr.name,
+                    volume.String(), strerror(errno));
+      } else {
+        DEBUG_PRINT("Created index %s on %s\n", attr.name, volume.String());
       }
     }
   }
@@ -1,14 +1,23 @@
 #ifndef BETON_MEDIA_LIBRARY_CACHE_H
 #define BETON_MEDIA_LIBRARY_CACHE_H
 
+#include "CacheCompression.h"
+#include "MediaCacheJournal.h"
+#include "AcoustIdScanner.h"
+#include "MediaEntryStore.h"
 #include "MediaItem.h"
 #include "Messages.h"
+#include "LibrarySnapshot.h"
+#include "LibraryWatcher.h"
+#include "LoudnessScanner.h"
+#include "ScanScheduler.h"
 #include <Looper.h>
 #include <MessageRunner.h>
 #include <Messenger.h>
 #include <String.h>
 #include <Query.h>
 #include <Volume.h>
+#include <atomic>
 #include <map>
 #include <set>
 #include <vector>
@@ -19,9 +28,12 @@
  *
  * The MediaLibraryCache is responsible for:
  * - Loading and saving the 'media.cache' file.
- * - Coordinating the scanning process (via MediaLibraryScanner).
+ * - Coordinating the scanning process (via MediaLibraryScanner, started
+ *   and throttled by a ScanScheduler).
  * - Maintaining the in-memory state of all known media files (fEntries).
  * - Notifying the UI about progress and updates.
+ * - Running the background loudness analysis (LoudnessScanner) and
+ *   recording identification (AcoustIdScanner) and storing their results.
  *
  * It runs as a BLooper to handle asynchronous messages.
  */
@@ -46,14 +58,29 @@ public:
   void LoadCache();
 
   /**
-   * @brief Saves the current cache to disk.
+   * @brief Persists pending changes.
+   *
+   * Appends the entries changed since the last save to the journal. A full
+   * snapshot is written in the background once the journal grows past
+   * `kJournalCompactThreshold` or after migrating an older cache format.
    */
   void SaveCache();
 
   /**
    * @brief Starts the scanning process for all configured directories.
+   *
+   * Sources are grouped by device. Devices are scanned in parallel, sources
+   * on one device one after another (`ScanScheduler`), and the window gets
+   * one combined MSG_SCAN_PROGRESS for all of them.
+   *
+   * On query-capable volumes that were scanned before, only files modified
+   * since the last scan are visited (BFS `last_modified` query). A full
+   * directory walk is done when `full` is set, on other volumes, and at least
+   * every `kFullScanInterval` to pick up files copied with old timestamps.
+   *
+   * @param full Force a full directory walk for every source.
    */
-  void StartScan();
+  void StartScan(bool full = false);
 
   /**
    * @brief Handles cache/scanner/query messages on the looper thread.
@@ -61,23 +88,21 @@ public:
    */
   void MessageReceived(BMessage *msg) override;
 
-  /**
-   * @brief Returns the internal path-indexed cache map.
-   */
-  const std::map<BString, MediaItem> &Entries() const { return fEntries; }
+  /** @brief Times dispatched messages when looper statistics are on. */
+  void DispatchMessage(BMessage *msg, BHandler *handler) override;
 
   /**
-   * @brief Returns a flattened vector of all media items.
-   * Useful for UI population.
+   * @brief Returns the internal entry store.
    */
-  std::vector<MediaItem> AllEntries() const;
+  const MediaEntryStore &Entries() const { return fEntries; }
 
-private:
   /**
-   * @brief Inserts or replaces an item in the cache.
-   * @param entry Item to store.
+   * @brief Returns the shared, immutable snapshot of all entries.
+   *
+   * Consecutive calls without intervening changes return the same object,
+   * so all readers share one copy of the item array.
    */
-  void AddOrUpdateEntry(const MediaItem &entry);
+  BReference<LibrarySnapshot> CurrentSnapshot();
 
   /**
    * @brief Loads configured source directories into `outDirs`.
@@ -85,6 +110,13 @@ private:
    */
   void LoadDirectories(std::vector<BString> &outDirs);
 
+private:
+  /**
+   * @brief Inserts or replaces an item in the cache.
+   * @param entry Item to store.
+   */
+  void AddOrUpdateEntry(const MediaItem &entry);
+
   /**
    * @brief Marks all entries below a base path as currently unavailable.
    * @param basePath Root path that is offline.
@@ -93,32 +125,247 @@ private:
 
   /** @name Data */
   ///@{
-  /** @brief Path-indexed media entries (`key == MediaItem::path`). */
-  std::map<BString, MediaItem> fEntries;
+  /** @brief All known media entries, indexed by path and inode. */
+  MediaEntryStore fEntries;
   /** @brief UI/update target messenger (usually `MainWindow`). */
   BMessenger fTarget;
   /** @brief Absolute path of the on-disk cache file. */
   BString fCachePath;
+  /** @brief Change log appended to by SaveCache(). */
+  MediaCacheJournal fJournal;
+  /** @brief Paths changed since the last SaveCache() (upsert or removal). */
+  std::set<BString> fChangedPaths;
+  /** @brief Set when the snapshot must be rewritten (format migration). */
+  bool fSnapshotStale{false};
+  /** @brief Background compaction thread, or -1. */
+  thread_id fCompactionThread{-1};
+  /** @brief True while the compaction thread is writing a snapshot. */
+  std::atomic<bool> fCompacting{false};
+  /** @brief Starts queued scanners per device and throttles them. */
+  ScanScheduler fScheduler;
+  /** @brief Latest counts reported by one scanner of the current scan. */
+  struct ScanProgress {
+    int32 dirs = 0;
+    int32 files = 0;
+    float filesPerSec = 0; ///< Tag read throughput while running
+    float mbPerSec = 0;
+  };
+  /** @brief Progress per scan root, summed up for the window. */
+  std::map<BString, ScanProgress> fScanProgress;
+  /** @brief Start of the current StartScan(). */
+  bigtime_t fScanStartTime{0};
+  /** @brief Time of the last combined MSG_SCAN_PROGRESS. */
+  bigtime_t fLastProgressSent{0};
   /** @brief Number of currently active scanner loopers. */
   int32 fActiveScanners{0};
+  /** @brief Scanners started for watcher updates (not part of a rescan). */
+  int32 fActiveWatchScanners{0};
+  /** @brief Incremented on every change of fEntries. */
+  uint64 fVersion{1};
+  /** @brief Snapshot of fEntries at fVersion, created on demand. */
+  BReference<LibrarySnapshot> fPublished;
+  /** @brief Node monitor for the source roots (handler of this looper). */
+  LibraryWatcher *fWatcher{nullptr};
+  /** @brief Background ReplayGain analysis, started by MSG_LOUDNESS_SCAN. */
+  LoudnessScanner fLoudness;
+  /** @brief Background fingerprinting, started by MSG_ACOUSTID_SCAN. */
+  AcoustIdScanner fAcoustId;
+
+  /** @brief Completion times of the last scans of one source root. */
+  struct ScanState {
+    time_t lastScan = 0;     ///< Start of the last completed scan (any kind)
+    time_t lastFullScan = 0; ///< Start of the last completed full walk
+  };
+  /** @brief Persisted per-root scan state (`scan_state.settings`). */
+  std::map<BString, ScanState> fScanStates;
+  /** @brief Start time of the scan currently running for each root. */
+  std::map<BString, time_t> fScanStarted;
+  /**
+   * @brief Entries whose files were gone at the start of the scan, per
+   * source root. Removed when the root's scanner is done, unless it found
+   * them moved in the meantime.
+   */
+  std::map<BString, std::vector<BString>> fPendingRemovals;
+  /** @name Startup Validation */
+  ///@{
+  std::vector<BString> fValidationQueue; ///< Paths in the order to check
+  size_t fValidationNext{0};
+  std::vector<BString> fValidationRoots; ///< Reachable source roots
+  bigtime_t fValidationStart{0};
+  int32 fValidationChanged{0};
+  int32 fValidationRemoved{0};
+  ///@}
+  /** @brief First time each currently missing entry was seen missing. */
+  std::map<BString, time_t> fMissingSince;
+  /** @brief Age in seconds after which missing entries are dropped. */
+  time_t fMissingRetention;
+  /** @brief Pending `MSG_CACHE_GC_DONE`, sent once compaction finished. */
+  BMessage fCollectReport;
+  /** @brief Tag reader threads per scanner (0 = one per CPU). */
+  int32 fTagReaderCount{0};
   bool fCacheDirty{false}; ///< Set when entries changed, cleared after SaveCache()
+  bool fLoaded{false};            ///< The first load finished
+  bool fLiveQueriesWanted{false}; ///< MSG_START_LIVE_QUERIES arrived
   
-  /** @brief Active rating live queries (owned pointers). */
-  std::vector<BQuery*> fRatingQueries;
-  /** @brief Volumes that already have initialized rating live queries. */
-  std::set<dev_t> fQueriedVolumes;
+  /**
+   * @brief Live query for recently modified files per source volume (owned;
+   * nullptr where it could not be started).
+   */
+  std::map<dev_t, BQuery *> fLiveQueries;
+  /** @brief Library files reported by the live queries, re-read together. */
+  std::set<BString> fRereadQueue;
+  /** @brief Volumes whose live query is re-armed after the re-read. */
+  std::set<dev_t> fRereadDevices;
+  /** @brief One-shot MSG_ATTR_POLL for the queued re-reads. */
+  BMessageRunner *fRereadRunner{nullptr};
+  /** @brief Volumes checked for missing indexes in this session. */
+  std::set<dev_t> fIndexChecked;
+  /** @brief Names of volumes the user did not want indexed (persisted). */
+  std::set<BString> fIndexDeclined;
   ///@}
 
   /**
-   * @brief Initializes rating live queries for all configured source volumes.
+   * @brief Loads a memory-mapped v3 cache file into fEntries.
+   * @param stats Set to how reading the file went.
+   * @return `false` if the file is missing or uses an older format.
+   */
+  bool _LoadMappedCache(CacheLoadStats &stats);
+
+  /**
+   * @brief Applies journal records on top of the loaded snapshot.
+   * @return Number of records applied.
+   */
+  int32 _ReplayJournal();
+
+  /**
+   * @brief Merges a `MSG_MEDIA_ITEM_FOUND` update into its entry.
+   * @return `false` if the message names no path.
+   */
+  bool _ApplyItemUpdate(const BMessage *msg);
+
+  /**
+   * @brief Records that the entry for `path` changed or was removed.
+   */
+  void _MarkChanged(const BString &path);
+
+  /** @brief Drops the published snapshot after fEntries changed. */
+  void _BumpVersion();
+
+  /**
+   * @brief Rotates the journal and writes a snapshot on a worker thread.
+   */
+  void _StartCompaction();
+
+  /** @brief Entry point of the compaction thread. */
+  static int32 _CompactionThread(void *data);
+
+  /**
+   * @brief Announces the loaded cache and starts live queries.
+   */
+  void _FinishLoad();
+
+  /**
+   * @brief Drops entries that no longer belong to the library.
+   *
+   * Removes entries whose source root is no longer configured and entries
+   * that have been missing for longer than `fMissingRetention`, then writes a
+   * fresh snapshot in the background so the file shrinks as well. What was
+   * reclaimed is reported to the target as `MSG_CACHE_GC_DONE`.
+   *
+   * @param notify Send `MSG_CACHE_LOADED` if entries were removed.
+   * @return Number of removed entries.
+   */
+  int32 _CollectGarbage(bool notify);
+
+  /** @brief Returns the on-disk size of the cache and its journal. */
+  off_t _CacheFileSize() const;
+
+  /**
+   * @brief Sends the summed progress of all scanners to the target.
+   * @param force Send even if the last update was less than 100 ms ago.
+   */
+  void _ForwardScanProgress(bool force);
+
+  /** @brief Queues the validation pass, `msg`'s "path" entries first. */
+  void _StartValidation(BMessage *msg);
+  /** @brief Checks the next batch of the validation queue. */
+  void _ValidateNext();
+
+  /** @brief Drops the pending removals of `base` that are still missing. */
+  void _RemovePending(const BString &base);
+
+  /** @brief Loads fScanStates from the settings directory. */
+  void _LoadScanState();
+  /** @brief Writes fScanStates and fMissingSince to the settings directory. */
+  void _SaveScanState();
+
+  /**
+   * @brief Points the library watcher at the given source roots.
+   */
+  void _UpdateWatcher(const std::vector<BString> &dirs);
+
+  /**
+   * @brief Applies a `MSG_LIBRARY_CHANGED` from the watcher.
+   *
+   * Moves rekey the affected entries, removed paths (files or whole
+   * directories) are dropped, and changed paths are re-read by an
+   * incremental scanner per source root.
+   */
+  void _ApplyLibraryChanges(BMessage *msg);
+
+  /**
+   * @brief Removes the entry for `path` or all entries below it.
+   * @return Number of removed entries.
+   */
+  int32 _RemoveEntriesAt(const BString &path);
+
+  /**
+   * @brief Starts the live queries and checks the indexes of all configured
+   * source volumes.
    */
   void _InitAllLiveQueries();
+  void _StartLiveQueries();
+
+  /**
+   * @brief (Re)starts the live query for files modified since `since` on
+   * one BFS-capable volume.
+   *
+   * A live query only reports files entering its result set, so it is
+   * re-armed after every re-read. Library files already in the new set,
+   * except those in `reread`, are queued for a re-read.
+   */
+  void _InitLiveQuery(dev_t device, time_t since,
+                      const std::set<BString> *reread = nullptr);
+
+  /** @brief Queues a library file for the next batched re-read. */
+  void _QueueReread(const BString &path, dev_t device);
+
+  /**
+   * @brief Re-reads the attributes of the queued files, sends the changed
+   * ones as one `MSG_MEDIA_ITEMS_UPDATED` and re-arms the live queries.
+   */
+  void _RereadQueued();
+
+  /**
+   * @brief Asks the target to create the missing attribute indexes of a
+   * writable source volume, unless the user declined before.
+   */
+  void _CheckIndexes(dev_t device);
+
+  /** @brief Creates the indexes, or remembers the refusal. */
+  void _CreateIndexes(BMessage *msg);
+
+  /**
+   * @brief Stores the gains of a `MSG_LOUDNESS_RESULT` and hands the
+   * updated items to the window as a MediaBatch.
+   */
+  void _ApplyLoudness(BMessage *msg);
 
   /**
-   * @brief Initializes per-rating live queries on one BFS-capable volume.
-   * @param device Device identifier.
+   * @brief Stores the IDs of a `MSG_ACOUSTID_RESULT` and hands the updated
+   * items to the window as a MediaBatch.
    */
-  void _InitRatingLiveQueries(dev_t device);
+  void _ApplyAcoustIds(BMessage *msg);
 
   /**
    * @brief Re-reads BFS metadata attributes and updates an item in-place.
@@ -1,18 +1,28 @@
 #include "MediaLibraryScanner.h"
 #include "Config.h"
 #include "Debug.h"
+#include "LooperStats.h"
+#include "MediaBatch.h"
 #include "Messages.h"
 #include "MetadataTagIO.h"
+#include "ScanScheduler.h"
+#include "StringPool.h"
+#include "Trace.h"
 
+#include <Autolock.h>
 #include <Node.h>
 #include <Path.h>
+#include <Query.h>
 #include <SupportDefs.h>
+#include <Volume.h>
+#include <algorithm>
+#include <ctype.h>
 #include <new>
-#include <stack>
+#include <utility>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
 #include <sys/stat.h>
-#include <taglib/fileref.h>
-#include <taglib/tag.h>
-#include <taglib/tpropertymap.h>
 
 /**
  * @brief Constructor.
@@ -56,6 +66,15 @@ MediaLibraryScanner::~MediaLibraryScanner() {
   delete_sem(fControlSem);
 }
 
+/**
+ * @brief All scanner instances share one statistics slot.
+ */
+void MediaLibraryScanner::DispatchMessage(BMessage *msg, BHandler *handler) {
+  static const int32 sStatsSlot = LooperStats::Register("MediaLibraryScanner");
+  LooperStats::Scope scope(sStatsSlot, this, msg);
+  BLooper::DispatchMessage(msg, handler);
+}
+
 /**
  * @brief Message handler for the BLooper.
  *
@@ -73,11 +92,31 @@ void MediaLibraryScanner::MessageReceived(BMessage *msg) {
     release_sem(fControlSem);
     break;
   }
+  case MSG_SCAN_THROTTLE:
+    SetThrottle(msg->GetInt32("level", ScanScheduler::kThrottleNone));
+    break;
+  case MSG_SCAN_PRIORITY: {
+    std::vector<BString> paths;
+    BString path;
+    for (int32 i = 0; msg->FindString("path", i, &path) == B_OK; i++)
+      paths.push_back(path);
+    SetPriorityPaths(std::move(paths));
+    break;
+  }
   default:
     BLooper::MessageReceived(msg);
   }
 }
 
+/** @brief File extensions (without dot) handled by the scanner. */
+static const char *kAudioExtensions[] = {"mp3", "wav", "flac", "ogg",
+                                         "opus", "m4a", "aac", "wma"
+#if ENABLE_MIDI_PLAYBACK
+                                         ,
+                                         "mid", "midi"
+#endif
+};
+
 /**
  * @brief Helper to check file extensions.
  *
@@ -86,61 +125,72 @@ void MediaLibraryScanner::MessageReceived(BMessage *msg) {
  * @param path The file path to check.
  * @return True if the extension is supported.
  */
-static bool IsSupportedAudioFile(const BString &path) {
-  BString lower(path);
-  lower.ToLower();
-
-  static const char *exts[] = {".mp3", ".wav", ".flac", ".ogg",
-                               ".opus", ".m4a", ".aac",  ".wma"
-#if ENABLE_MIDI_PLAYBACK
-                               ,
-                               ".mid", ".midi"
-#endif
-  };
+static bool IsSupportedAudioFile(const char *path) {
+  const char *dot = strrchr(path, '.');
+  if (dot == nullptr || strchr(dot, '/') != nullptr)
+    return false;
 
-  for (auto ext : exts) {
-    if (lower.EndsWith(ext))
+  for (auto ext : kAudioExtensions) {
+    if (strcasecmp(dot + 1, ext) == 0)
       return true;
   }
   return false;
 }
 
+/** @brief Buffer size for bulk directory reads (holds many entries). */
+static const size_t kDirentBufferSize = 16384;
+
+/** @brief Upper bound for the tag reader pool. */
+static const int32 kMaxTagReaders = 8;
+/** @brief Queued jobs per reader before traversal blocks. */
+static const int32 kJobsPerReader = 16;
+/** @brief Pause per directory or file while backing off for playback. */
+static const bigtime_t kBackOffDelay = 20000;
+/** @brief Poll interval while paused. */
+static const bigtime_t kPausePollInterval = 100000;
+/** @brief Items per MSG_MEDIA_BATCH. */
+static const size_t kBatchSize = 100;
 /**
- * @brief Processes a single file entry.
+ * @brief Seconds the header estimate may differ from the cached duration
+ * before the file's audio properties are read in full.
+ */
+static const int32 kDurationTolerance = 2;
+
+/**
+ * @brief Applies the throttle level before the next directory or file.
+ *
+ * Backing off sleeps briefly so playback from the same disk gets its reads
+ * in; pausing blocks until the level drops or the scan is stopped.
+ */
+void MediaLibraryScanner::_WaitWhileThrottled() {
+  while (!fStopRequested) {
+    int32 level = fThrottle.load();
+    if (level == ScanScheduler::kThrottleNone)
+      return;
+    if (level == ScanScheduler::kThrottleBackOff) {
+      snooze(kBackOffDelay);
+      return;
+    }
+    snooze(kPausePollInterval);
+  }
+}
+
+/**
+ * @brief Processes a single file on the traversal thread.
  *
  * Workflow:
- * 1. Validates file extension and existence.
+ * 1. Validates the file extension.
  * 2. FAST SKIP: Checks against `fCache` to see if file is unchanged
  * (mtime/size).
- * 3. METADATA: Extracts tags (Title, Artist, Album, Year, MBIDs) using TagLib.
- * 4. BATCHING: Adds the resulting `MediaItem` to `fBatchBuffer` and flushes if
- * full.
+ * 3. MOVE: Re-keys a cached entry with the same inode (see _ProcessMove()).
+ * 4. Queues the file for a tag reader worker (see _ReadTags()).
  *
- * @param entry The file entry to process.
+ * @param filePath Absolute path of the file.
+ * @param st Result of the (link-following) stat of `filePath`.
  */
-void MediaLibraryScanner::ProcessFile(BEntry &entry) {
-  BPath path;
-
-  if (entry.GetPath(&path) != B_OK)
-    return;
-
-  /// Unconditional trace log
-  DEBUG_PRINT("Checking file: %s\n", path.Path());
-
-  BString filePath(path.Path());
-
-  if (!IsSupportedAudioFile(filePath))
-    return;
-
-  BString lowerPath(filePath);
-  lowerPath.ToLower();
-  bool isMidiFile = false;
-#if ENABLE_MIDI_PLAYBACK
-  isMidiFile = lowerPath.EndsWith(".mid") || lowerPath.EndsWith(".midi");
-#endif
-
-  struct stat st{};
-  if (stat(path.Path(), &st) != 0)
+void MediaLibraryScanner::ProcessFile(const BString &filePath,
+                                      const struct stat &st) {
+  if (!IsSupportedAudioFile(filePath.String()))
     return;
 
   /**
@@ -150,10 +200,15 @@ void MediaLibraryScanner::ProcessFile(BEntry &entry) {
    * no further processing is needed. All metadata including
    * the rating is preserved from the cached entry.
    */
-  if (!fCache.empty()) {
-    auto it = fCache.find(filePath);
-    if (it != fCache.end()) {
-      const MediaItem &old = it->second;
+  int32 cachedDuration = 0;
+  if (fCache.Get() != nullptr && !fCache->Items().empty()) {
+    const MediaItem *cached = fCache->Find(filePath);
+    if (cached != nullptr) {
+      const MediaItem &old = *cached;
+      // Same inode: the file was changed in place, as tag editors do, so
+      // its audio and the duration measured for it are unchanged.
+      if (old.inode == (int64)st.st_ino && old.duration > 0)
+        cachedDuration = old.duration;
       if (old.mtime == st.st_mtime && old.size == st.st_size) {
         /**
          * @brief Fast Skip: file unchanged, use cached data as-is.
@@ -166,145 +221,563 @@ void MediaLibraryScanner::ProcessFile(BEntry &entry) {
          */
         return;
       }
+    } else if (_ProcessMove(filePath, st)) {
+      return;
     }
   }
 
   fFoundFiles++;
   ReportProgress();
 
-  BString title, artist, album, genre;
-  int32 year = 0;
-  int32 track = 0;
-  int32 disc = 0;
-  int32 bitrate = 0;
-  int32 duration = 0;
-  BString mbTrackId, mbAlbumId, mbArtistId;
-
-  if (!isMidiFile) {
-    try {
-      TagLib::FileRef f(path.Path());
-
-      if (!f.isNull() && f.tag()) {
-        TagLib::Tag *tag = f.tag();
-        title = tag->title().toCString(true);
-        artist = tag->artist().toCString(true);
-        album = tag->album().toCString(true);
-        genre = tag->genre().toCString(true);
-        year = tag->year();
-        track = tag->track();
-
-        TagLib::PropertyMap props = f.file()->properties();
-        if (props.contains("DISCNUMBER")) {
-          TagLib::StringList l = props["DISCNUMBER"];
-          if (!l.isEmpty()) {
-            disc = l.front().toInt();
-          }
-        }
+  TagJob job;
+  job.sequence = fNextJobSequence++;
+  job.path = filePath;
+  job.st = st;
+  job.cachedDuration = cachedDuration;
+  _EnqueueJob(job);
+}
 
-        auto getProp = [&](const char *key, BString &target) {
-          if (props.contains(key)) {
-            TagLib::StringList l = props[key];
-            if (!l.isEmpty()) {
-              target = l.front().toCString(true);
-            }
-          }
-        };
+/**
+ * @brief Re-keys the cached entry of a file moved outside the app.
+ *
+ * A cached entry counts as the same file if it has the inode, size and mtime
+ * of `st`, lies on the same device, and its old path is gone (otherwise it
+ * is a hard link or the inode was reused). The cached tags are kept, so no
+ * TagLib call is needed.
+ *
+ * @return `true` if the file was emitted as moved.
+ */
+bool MediaLibraryScanner::_ProcessMove(const BString &filePath,
+                                       const struct stat &st) {
+  const MediaItem *cached =
+      fCache->FindByFileStat(st.st_ino, st.st_size, st.st_mtime);
+  if (cached == nullptr || cached->path == filePath)
+    return false;
+
+  struct stat oldSt;
+  if (stat(cached->path.String(), &oldSt) == 0 ||
+      _DeviceOf(cached->path) != st.st_dev)
+    return false;
+
+  MediaItem item(*cached);
+  item.path = filePath;
+  BPath parentPath;
+  if (BPath(filePath.String()).GetParent(&parentPath) == B_OK)
+    item.base = parentPath.Path();
+  else
+    item.base = fBasePath;
+  item.missing = false;
+
+  DEBUG_PRINT("Moved: %s -> %s\n", cached->path.String(), filePath.String());
+  _CompleteJob(fNextJobSequence++, &item, cached->path);
+  return true;
+}
+
+/**
+ * @brief Returns the device an old (no longer existing) path was on.
+ *
+ * Uses the nearest ancestor that still exists. Results are kept per parent
+ * directory, since a moved folder brings all of its files at once.
+ *
+ * @return The device, or -1 if no ancestor exists.
+ */
+dev_t MediaLibraryScanner::_DeviceOf(const BString &path) {
+  BPath parent;
+  if (BPath(path.String()).GetParent(&parent) != B_OK)
+    return -1;
+  BString dir(parent.Path());
+
+  auto known = fOldDirDevices.find(dir);
+  if (known != fOldDirDevices.end())
+    return known->second;
+
+  dev_t device = -1;
+  BPath current(parent);
+  struct stat st;
+  while (true) {
+    if (stat(current.Path(), &st) == 0) {
+      device = st.st_dev;
+      break;
+    }
+    BPath up;
+    if (current.GetParent(&up) != B_OK)
+      break;
+    current = up;
+  }
+  fOldDirDevices[dir] = device;
+  return device;
+}
+
+void MediaLibraryScanner::SetPriorityPaths(std::vector<BString> paths) {
+  std::sort(paths.begin(), paths.end());
+  paths.erase(std::unique(paths.begin(), paths.end()), paths.end());
+
+  std::vector<BString> areas;
+  for (const BString &path : paths) {
+    BPath folder, area;
+    if (BPath(path.String()).GetParent(&folder) != B_OK ||
+        folder.GetParent(&area) != B_OK)
+      continue;
+    BString prefix(area.Path());
+    prefix << '/';
+    // Neighbours of a folder directly below the root are the whole tree.
+    if (prefix.Length() > fBasePath.Length() + 1)
+      areas.push_back(prefix);
+  }
+
+  BAutolock lock(&fPriorityLock);
+  fPriorityPaths.swap(paths);
+  fPriorityAreas.swap(areas);
+  fHasPriority = !fPriorityPaths.empty();
+  fPriorityChanged = true;
+}
+
+/**
+ * @brief Whether `dirPath` contains a hinted file or is a neighbour of a
+ * hinted file's folder (another album of the same artist, say).
+ *
+ * Caller holds fPriorityLock.
+ */
+bool MediaLibraryScanner::_IsPriorityDirectory(const BString &dirPath) const {
+  BString prefix(dirPath);
+  prefix << '/';
+  auto it =
+      std::lower_bound(fPriorityPaths.begin(), fPriorityPaths.end(), prefix);
+  if (it != fPriorityPaths.end() && it->StartsWith(prefix))
+    return true;
+
+  for (const BString &area : fPriorityAreas) {
+    if (prefix.StartsWith(area))
+      return true;
+  }
+  return false;
+}
+
+/** @brief Whether `filePath` is one of the hinted files. */
+bool MediaLibraryScanner::_IsPriorityFile(const BString &filePath) {
+  if (!fHasPriority)
+    return false;
+  BAutolock lock(&fPriorityLock);
+  return std::binary_search(fPriorityPaths.begin(), fPriorityPaths.end(),
+                            filePath);
+}
 
-        BString localMbTrackId, localMbAlbumId, localMbArtistId;
-        getProp("MUSICBRAINZ_TRACKID", localMbTrackId);
-        getProp("MUSICBRAINZ_ALBUMID", localMbAlbumId);
-        getProp("MUSICBRAINZ_ARTISTID", localMbArtistId);
+/**
+ * @brief Moves priority directories in `pending` from `from` on to the top,
+ * keeping the depth-first order within both groups.
+ *
+ * Only directories below a priority directory can be priority directories
+ * themselves, so sorting the children of each walked directory keeps the
+ * whole stack in order once it was sorted after a hint change.
+ */
+void MediaLibraryScanner::_PrioritizePending(std::vector<BString> &pending,
+                                             size_t from) {
+  if (!fHasPriority || from >= pending.size())
+    return;
+  BAutolock lock(&fPriorityLock);
+  std::stable_partition(
+      pending.begin() + from, pending.end(),
+      [this](const BString &dir) { return !_IsPriorityDirectory(dir); });
+}
 
-        if (!localMbArtistId.IsEmpty())
-          mbArtistId = localMbArtistId;
+/**
+ * @brief Records a directory as visited.
+ * @return `false` if (device, inode) was seen before in this scan, i.e. the
+ * directory was reached again through a symlink.
+ */
+bool MediaLibraryScanner::_MarkVisited(const struct stat &st) {
+  return fVisitedDirs.insert(std::make_pair(st.st_dev, st.st_ino)).second;
+}
+
+/**
+ * @brief Reads one directory in bulk and dispatches its children.
+ *
+ * Entries are read with GetNextDirents() and classified with a single
+ * stat relative to the directory. Only symlinks are resolved through their
+ * full path; directories found that way are skipped when already visited,
+ * which keeps link cycles from looping.
+ *
+ * @param dirPath Absolute path of the directory.
+ * @param pending Receives subdirectories to visit.
+ */
+void MediaLibraryScanner::_ScanDirectory(const BString &dirPath,
+                                         std::vector<BString> &pending) {
+  _WaitWhileThrottled();
+
+  bigtime_t start = system_time();
+  BDirectory dir(dirPath.String());
+  if (dir.InitCheck() != B_OK)
+    return;
+
+  fScannedDirs++;
+  ReportProgress();
+
+  // Time spent on this directory itself, without queueing its files.
+  bigtime_t enumerateTime = 0, statTime = 0;
+  alignas(dirent) char buffer[kDirentBufferSize];
+  int32 count;
+  while (!fStopRequested &&
+         (count = dir.GetNextDirents((dirent *)buffer, sizeof(buffer))) > 0) {
+    bigtime_t now = system_time();
+    enumerateTime += now - start;
+    start = now;
+    const char *cursor = buffer;
+    for (int32 i = 0; i < count && !fStopRequested; i++) {
+      const dirent *ent = (const dirent *)cursor;
+      cursor += ent->d_reclen;
+
+      // Also skips "." and "..".
+      const char *name = ent->d_name;
+      if (name[0] == '.')
+        continue;
+
+      struct stat st;
+      start = system_time();
+      status_t status = dir.GetStatFor(name, &st);
+      statTime += system_time() - start;
+      if (status != B_OK)
+        continue;
+
+      bool isLink = S_ISLNK(st.st_mode);
+      if (!isLink && !S_ISDIR(st.st_mode) && !IsSupportedAudioFile(name))
+        continue;
+
+      BString childPath(dirPath);
+      childPath << "/" << name;
+      if (isLink) {
+        start = system_time();
+        int result = stat(childPath.String(), &st);
+        statTime += system_time() - start;
+        if (result != 0)
+          continue;
       }
 
-      if (!f.isNull() && f.audioProperties()) {
-        TagLib::AudioProperties *props = f.audioProperties();
-        duration = props->lengthInSeconds();
-        bitrate = props->bitrate();
+      if (S_ISDIR(st.st_mode)) {
+        if (_MarkVisited(st))
+          pending.push_back(childPath);
+        else
+          DEBUG_PRINT("Skipping already visited directory %s\n",
+                      childPath.String());
+      } else if (S_ISREG(st.st_mode)) {
+        ProcessFile(childPath, st);
       }
-    } catch (const std::bad_alloc &) {
-      throw;
-    } catch (const std::exception &ex) {
-      DEBUG_PRINT("Exception parsing '%s': %s\n", path.Path(),
-                  ex.what());
-    } catch (...) {
-      DEBUG_PRINT("Unknown exception parsing '%s'\n",
-                  path.Path());
     }
+    start = system_time();
   }
+  enumerateTime += system_time() - start;
 
-  TagData bfsData;
-  bool hasBfsData = MetadataTagIO::ReadBfsAttributes(path, bfsData);
-
-  if (title.IsEmpty() || artist.IsEmpty()) {
-    if (hasBfsData) {
-      if (title.IsEmpty())
-        title = bfsData.title;
-      if (artist.IsEmpty())
-        artist = bfsData.artist;
-      if (album.IsEmpty())
-        album = bfsData.album;
-      if (genre.IsEmpty())
-        genre = bfsData.genre;
-      if (year == 0)
-        year = bfsData.year;
-      if (track == 0)
-        track = bfsData.track;
-
-      if (duration == 0)
-        duration = bfsData.lengthSec;
-      if (bitrate == 0)
-        bitrate = bfsData.bitrate;
+  fStats.AddPhase(kScanPhaseEnumerate, enumerateTime);
+  fStats.AddPhase(kScanPhaseStat, statTime);
+  fStats.AddDirectory(dirPath, enumerateTime + statTime);
+}
+
+/**
+ * @brief Appends a case-insensitive `name=="*.ext"` term for `ext`.
+ */
+static void AppendExtensionTerm(BString &predicate, const char *ext) {
+  predicate << "||(name==\"*.";
+  for (const char *c = ext; *c != '\0'; c++) {
+    char lower = tolower(*c), upper = toupper(*c);
+    if (lower == upper)
+      predicate << *c;
+    else
+      predicate << "[" << lower << upper << "]";
+  }
+  predicate << "\")";
+}
+
+/**
+ * @brief Visits files below fBasePath modified after fDeltaSince.
+ *
+ * Uses the BFS `last_modified` index, so the cost depends on the number of
+ * changed files instead of the size of the tree. Audio files are matched by
+ * MIME type or, for files that were never sniffed, by extension.
+ *
+ * @return `false` if the volume cannot run the query; nothing was visited.
+ */
+bool MediaLibraryScanner::_RunDeltaQuery() {
+  BVolume volume(fStartRef.device);
+  if (volume.InitCheck() != B_OK || !volume.KnowsQuery())
+    return false;
+
+  BString predicate;
+  predicate << "((last_modified>" << (int64)fDeltaSince
+            << ")&&((BEOS:TYPE==\"audio/*\")";
+  for (auto ext : kAudioExtensions)
+    AppendExtensionTerm(predicate, ext);
+  predicate << "))";
+
+  BQuery query;
+  query.SetVolume(&volume);
+  if (query.SetPredicate(predicate.String()) != B_OK || query.Fetch() != B_OK) {
+    DEBUG_PRINT("Delta query failed on %s, walking the tree\n",
+                fBasePath.String());
+    return false;
+  }
+
+  BString prefix(fBasePath);
+  prefix << "/";
+
+  int32 hits = 0;
+  BEntry entry;
+  while (!fStopRequested) {
+    bigtime_t start = system_time();
+    if (query.GetNextEntry(&entry) != B_OK)
+      break;
+    BPath p;
+    status_t status = entry.GetPath(&p);
+    fStats.AddPhase(kScanPhaseEnumerate, system_time() - start);
+    if (status != B_OK)
+      continue;
+    BString path(p.Path());
+    if (!path.StartsWith(prefix) ||
+        path.FindFirst("/.", fBasePath.Length()) >= 0)
+      continue;
+    _WaitWhileThrottled();
+    struct stat st;
+    start = system_time();
+    int result = stat(path.String(), &st);
+    fStats.AddPhase(kScanPhaseStat, system_time() - start);
+    if (result != 0 || !S_ISREG(st.st_mode))
+      continue;
+    hits++;
+    ProcessFile(path, st);
+  }
+
+  DEBUG_PRINT("Delta query on %s: %ld modified files\n", fBasePath.String(),
+              (long)hits);
+  return true;
+}
+
+/**
+ * @brief Extracts metadata for one queued file.
+ *
+ * Runs on a tag reader worker. Reads tags, audio properties, ReplayGain
+ * and BFS attributes with one open of the file; empty tag fields are
+ * filled from the attributes, and a BFS rating wins over the embedded one.
+ * When the job carries a cached duration, the audio properties are only
+ * estimated from the headers. The cached duration is kept if the estimate
+ * agrees with it; otherwise the file was re-encoded or trimmed in place and
+ * its audio properties are read again in full.
+ *
+ * @param job File to read.
+ * @param item Receives the resulting MediaItem.
+ */
+void MediaLibraryScanner::_ReadTags(const TagJob &job, MediaItem &item) {
+  TRACE_SCOPE(kTraceScan, "read tags", (int64)job.st.st_size);
+  BPath path(job.path.String());
+  const struct stat &st = job.st;
+
+  uint32 fields =
+      kReadTags | kReadAudioProperties | kReadBfs | kReadReplayGain;
+  if (job.cachedDuration > 0)
+    fields |= kReadFastAudioProperties;
+
+  bigtime_t start = system_time();
+  FileMetadata meta;
+  int32 duration = 0;
+  uint32 bitrate = 0;
+  try {
+    MetadataTagIO::ReadFile(path, fields, meta);
+    duration = (int32)meta.tags.lengthSec;
+    bitrate = meta.tags.bitrate;
+    if (job.cachedDuration > 0) {
+      if (abs(duration - job.cachedDuration) <= kDurationTolerance) {
+        duration = job.cachedDuration;
+      } else {
+        FileMetadata exact;
+        MetadataTagIO::ReadFile(path, kReadAudioProperties, exact);
+        meta.parseTime += exact.parseTime;
+        duration = (int32)exact.tags.lengthSec;
+        bitrate = exact.tags.bitrate;
+      }
     }
+  } catch (const std::bad_alloc &) {
+    throw;
+  } catch (const std::exception &ex) {
+    DEBUG_PRINT("Exception parsing '%s': %s\n", path.Path(), ex.what());
+  } catch (...) {
+    DEBUG_PRINT("Unknown exception parsing '%s'\n", path.Path());
   }
+  bigtime_t readTime = system_time() - start;
+  fStats.AddPhase(kScanPhaseParse, meta.parseTime);
+  fStats.AddPhase(kScanPhaseAttributes, meta.bfsTime);
 
+  const TagData &tags = meta.tags;
+  BString title = tags.title;
   if (title.IsEmpty()) {
     title = path.Leaf();
   }
 
-  MediaItem item;
   BPath parentPath;
   if (path.GetParent(&parentPath) == B_OK) {
     item.base = parentPath.Path();
   } else {
     item.base = fBasePath;
   }
-  item.path = filePath;
+  item.path = job.path;
   item.title = title;
-  item.artist = artist;
-  item.album = album;
-  item.genre = genre;
-  item.year = year;
-  item.track = track;
-  item.disc = disc;
+  item.artist = tags.artist;
+  item.album = tags.album;
+  item.genre = tags.genre;
+  item.year = tags.year;
+  item.track = tags.track;
+  item.disc = tags.disc;
   item.duration = duration;
   item.bitrate = bitrate;
   item.size = st.st_size;
   item.mtime = st.st_mtime;
   item.inode = st.st_ino;
-  item.mbTrackId = mbTrackId;
-  item.mbAlbumId = mbAlbumId;
-  item.mbArtistId = mbArtistId;
-  if (hasBfsData && bfsData.rating > 0) {
-    item.rating = bfsData.rating;
-    DEBUG_PRINT("Read rating %d (BFS) for %s\n", (int)item.rating,
-                item.path.String());
-  } else {
-    TagData embeddedData;
-    MetadataTagIO::ReadTags(path, embeddedData);
-    item.rating = embeddedData.rating;
-    if (item.rating > 0)
-      DEBUG_PRINT("Read rating %d (embedded) for %s\n", (int)item.rating,
-                  item.path.String());
+  item.mbTrackId = tags.mbTrackID;
+  item.mbAlbumId = tags.mbAlbumID;
+  item.mbArtistId = tags.mbArtistID;
+  item.acoustId = tags.acoustId;
+  item.trackGain = meta.replayGain.trackGain;
+  item.trackPeak = meta.replayGain.trackPeak;
+  item.albumGain = meta.replayGain.albumGain;
+  item.albumPeak = meta.replayGain.albumPeak;
+  if (meta.hasBfs && meta.bfs.rating > 0)
+    item.rating = meta.bfs.rating;
+  else
+    item.rating = tags.rating;
+
+  StringPool::Default().InternItem(item);
+  fStats.AddFile(job.path, item.base, st.st_size, readTime);
+}
+
+/**
+ * @brief Sets the number of tag reader workers used by the next scan.
+ * @param count Worker count; values <= 0 select a count based on the CPUs.
+ */
+void MediaLibraryScanner::SetTagReaderCount(int32 count) {
+  fTagReaderCount = count;
+}
+
+/**
+ * @brief Spawns the tag reader pool for one scan.
+ */
+void MediaLibraryScanner::_StartTagReaders() {
+  int32 count = fTagReaderCount;
+  if (count <= 0) {
+    system_info info;
+    count = get_system_info(&info) == B_OK ? (int32)info.cpu_count : 1;
   }
+  if (count < 1)
+    count = 1;
+  if (count > kMaxTagReaders)
+    count = kMaxTagReaders;
+
+  fNextJobSequence = 0;
+  fNextEmitSequence = 0;
+  fReadersExit = false;
+  fJobsSem = create_sem(0, "MediaLibraryScanner Jobs");
+  fSlotsSem = create_sem(count * kJobsPerReader, "MediaLibraryScanner Slots");
+
+  for (int32 i = 0; i < count; i++) {
+    thread_id thread = spawn_thread(TagReaderEntry, "MediaLibraryScanner Tags",
+                                    B_LOW_PRIORITY, this);
+    if (thread < 0)
+      break;
+    fTagReaders.push_back(thread);
+    resume_thread(thread);
+  }
+  DEBUG_PRINT("Worker: started %zu tag readers\n", fTagReaders.size());
+}
+
+/**
+ * @brief Lets the pool drain the queue, then joins all workers.
+ */
+void MediaLibraryScanner::_StopTagReaders() {
+  fJobLock.Lock();
+  fReadersExit = true;
+  fJobLock.Unlock();
 
+  if (!fTagReaders.empty())
+    release_sem_etc(fJobsSem, (int32)fTagReaders.size(), 0);
+
+  for (thread_id thread : fTagReaders) {
+    status_t exitValue;
+    wait_for_thread(thread, &exitValue);
+  }
+  fTagReaders.clear();
+  fJobQueue.clear();
+  fReorderBuffer.clear();
+  fReorderArena.release();
+
+  delete_sem(fJobsSem);
+  delete_sem(fSlotsSem);
+  fJobsSem = -1;
+  fSlotsSem = -1;
+}
+
+/**
+ * @brief Queues a job, blocking while the bounded queue is full.
+ *
+ * Falls back to reading inline if no worker could be started.
+ */
+void MediaLibraryScanner::_EnqueueJob(const TagJob &job) {
+  if (fTagReaders.empty()) {
+    MediaItem item;
+    _ReadTags(job, item);
+    _CompleteJob(job.sequence, &item);
+    return;
+  }
+
+  while (true) {
+    status_t err = acquire_sem_etc(fSlotsSem, 1, B_RELATIVE_TIMEOUT, 100000);
+    if (err == B_OK)
+      break;
+    if (fStopRequested || (err != B_TIMED_OUT && err != B_INTERRUPTED))
+      return;
+  }
+
+  // A hinted file is read next. Results still leave in traversal order,
+  // so it waits for at most one queue's worth of reads.
+  bool urgent = _IsPriorityFile(job.path);
+  fJobLock.Lock();
+  if (urgent)
+    fJobQueue.push_front(job);
+  else
+    fJobQueue.push_back(job);
+  fJobLock.Unlock();
+  release_sem(fJobsSem);
+}
+
+/**
+ * @brief Stores a finished job and releases all results that are now in
+ * sequence to the batch buffer.
+ *
+ * Results are emitted in traversal order regardless of which worker
+ * finished first, so batches stay deterministic.
+ *
+ * @param sequence Job sequence number.
+ * @param item Result, or nullptr if the job was cancelled.
+ * @param movedFrom Previous path if `item` is a re-keyed cache entry.
+ */
+void MediaLibraryScanner::_CompleteJob(uint64 sequence, MediaItem *item,
+                                       const BString &movedFrom) {
   bool needsFlush = false;
 
   fBatchLock.Lock();
-  fBatchBuffer.push_back(item);
-  if (fBatchBuffer.size() >= 100) {
+  ReorderSlot &slot = fReorderBuffer[sequence];
+  slot.valid = item != nullptr;
+  if (item != nullptr)
+    slot.item = std::move(*item);
+  slot.movedFrom = movedFrom;
+
+  auto it = fReorderBuffer.begin();
+  while (it != fReorderBuffer.end() && it->first == fNextEmitSequence) {
+    if (it->second.valid) {
+      if (!it->second.movedFrom.IsEmpty()) {
+        fMoveBuffer.push_back(
+            std::make_pair(it->second.movedFrom, it->second.item.path));
+      }
+      fBatchBuffer.push_back(std::move(it->second.item));
+    }
+    it = fReorderBuffer.erase(it);
+    fNextEmitSequence++;
+  }
+  if (fBatchBuffer.size() >= kBatchSize) {
     needsFlush = true;
   }
   fBatchLock.Unlock();
@@ -314,54 +787,84 @@ void MediaLibraryScanner::ProcessFile(BEntry &entry) {
   }
 }
 
+/**
+ * @brief Static entry point for tag reader workers.
+ */
+status_t MediaLibraryScanner::TagReaderEntry(void *data) {
+  MediaLibraryScanner *self = (MediaLibraryScanner *)data;
+  self->TagReaderMethod();
+  return B_OK;
+}
+
+/**
+ * @brief Tag reader loop: pops jobs until the queue is drained and closed.
+ */
+void MediaLibraryScanner::TagReaderMethod() {
+  while (true) {
+    status_t err = acquire_sem(fJobsSem);
+    if (err == B_INTERRUPTED)
+      continue;
+    if (err != B_OK)
+      break;
+
+    fJobLock.Lock();
+    if (fJobQueue.empty()) {
+      bool exit = fReadersExit;
+      fJobLock.Unlock();
+      if (exit)
+        break;
+      continue;
+    }
+    TagJob job = fJobQueue.front();
+    fJobQueue.pop_front();
+    fJobLock.Unlock();
+    release_sem(fSlotsSem);
+
+    _WaitWhileThrottled();
+    if (fStopRequested) {
+      _CompleteJob(job.sequence, nullptr);
+      continue;
+    }
+
+    MediaItem item;
+    _ReadTags(job, item);
+    _CompleteJob(job.sequence, &item);
+  }
+}
+
 /**
  * @brief Sends the current batch of found items to the MediaLibraryCache.
  *
  * Uses MSG_MEDIA_BATCH. Clears the buffer after sending.
  */
 void MediaLibraryScanner::FlushBatch() {
+  bigtime_t start = system_time();
   fBatchLock.Lock();
   if (fBatchBuffer.empty()) {
     fBatchLock.Unlock();
     return;
   }
 
-  BMessage msg(MSG_MEDIA_BATCH);
-  msg.AddString("base", fBasePath);
-
-  for (const auto &item : fBatchBuffer) {
-    msg.AddString("path", item.path);
-    msg.AddString("item_base", item.base);
-    msg.AddString("title", item.title);
-    msg.AddString("artist", item.artist);
-    msg.AddString("album", item.album);
-    msg.AddString("genre", item.genre);
-    msg.AddInt32("year", item.year);
-    msg.AddInt32("track", item.track);
-    msg.AddInt32("disc", item.disc);
-    msg.AddInt32("duration", item.duration);
-    msg.AddInt32("bitrate", item.bitrate);
-    msg.AddInt64("size", item.size);
-    msg.AddInt64("mtime", item.mtime);
-    msg.AddInt64("inode", item.inode);
-    msg.AddInt32("rating", item.rating);
-    if (item.rating > 0)
-      DEBUG_PRINT("FlushBatch: Sending rating %d for %s\n",
-                  (int)item.rating, item.path.String());
-  }
-
-  fBatchBuffer.clear();
+  TRACE_INSTANT(kTraceScan, "batch", (int64)fBatchBuffer.size());
+  BReference<MediaBatch> batch(new MediaBatch, true);
+  batch->base = fBasePath;
+  batch->items.swap(fBatchBuffer);
+  batch->moves.swap(fMoveBuffer);
+  // The next batch fills to the same size; grow it once, not in steps.
+  fBatchBuffer.reserve(kBatchSize);
   fBatchLock.Unlock();
 
   if (fCacheTarget.IsValid())
-    fCacheTarget.SendMessage(&msg);
+    batch->SendTo(fCacheTarget, MSG_MEDIA_BATCH);
+  fStats.AddPhase(kScanPhaseTransport, system_time() - start);
 }
 
 /**
  * @brief Reports scan progress to the UI.
  *
  * Rates limited to avoid flooding the message queue.
- * Sends MSG_SCAN_PROGRESS with dirs and files counts.
+ * Sends MSG_SCAN_PROGRESS with dirs and files counts and the tag read
+ * throughput ("files_per_sec", "mb_per_sec").
  */
 void MediaLibraryScanner::ReportProgress() {
   auto now = std::chrono::steady_clock::now();
@@ -371,10 +874,13 @@ void MediaLibraryScanner::ReportProgress() {
 
   if (elapsed > 100) {
     fLastUpdate = now;
-    if (fLiveTarget.IsValid()) {
+    if (fLiveTarget.IsValid() && fPaths.empty()) {
       BMessage msg(MSG_SCAN_PROGRESS);
+      msg.AddString("base", fBasePath);
       msg.AddInt32("dirs", fScannedDirs);
       msg.AddInt32("files", fFoundFiles);
+      msg.AddFloat("files_per_sec", fStats.FilesPerSecond());
+      msg.AddFloat("mb_per_sec", fStats.MegabytesPerSecond());
 
       auto totalElapsed =
           std::chrono::duration_cast<std::chrono::seconds>(now - fStartTime)
@@ -403,7 +909,7 @@ status_t MediaLibraryScanner::WorkerEntry(void *data) {
  *
  * Waits on fControlSem for scan requests.
  * Performs iterative DFS to traverse directories.
- * Sends MSG_SCAN_DONE when finished.
+ * Sends MSG_SCAN_DONE with the run's ScanStats when finished.
  */
 void MediaLibraryScanner::WorkerMethod() {
   while (true) {
@@ -416,49 +922,52 @@ void MediaLibraryScanner::WorkerMethod() {
     if (fStopRequested)
       break;
 
+    bool usedDelta = false;
     if (fScanRequested) {
       fScanRequested = false;
       fIsScanning = true;
+      TraceScope<kTraceScan> scanTrace("scan");
 
       fScannedDirs = 0;
       fFoundFiles = 0;
       fStartTime = std::chrono::steady_clock::now();
-
-      std::stack<BString> stack;
-      stack.push(fBasePath);
-
-      while (!stack.empty() && !fStopRequested) {
-        BString currentPath = stack.top();
-        stack.pop();
-
-        BDirectory dir(currentPath.String());
-        if (dir.InitCheck() != B_OK)
-          continue;
-
-        fScannedDirs++;
-        ReportProgress();
-
-        BEntry entry;
-        dir.Rewind();
-        while (dir.GetNextEntry(&entry, true) == B_OK) {
-          if (fStopRequested)
-            break;
-
-          BPath p;
-          if (entry.GetPath(&p) != B_OK)
-            continue;
-
-          BString leaf(p.Leaf());
-          if (leaf.Length() > 0 && leaf.ByteAt(0) == '.')
+      fStats.Reset();
+
+      _StartTagReaders();
+
+      std::vector<BString> pending; ///< Used as a stack
+      fVisitedDirs.clear();
+      fOldDirDevices.clear();
+      if (fDeltaSince > 0 && fPaths.empty() && _RunDeltaQuery()) {
+        usedDelta = true;
+      } else {
+        const std::vector<BString> roots =
+            fPaths.empty() ? std::vector<BString>(1, fBasePath) : fPaths;
+        for (const BString &path : roots) {
+          struct stat st;
+          if (stat(path.String(), &st) != 0)
             continue;
-
-          if (entry.IsDirectory()) {
-            stack.push(p.Path());
-          } else {
-            ProcessFile(entry);
+          if (S_ISDIR(st.st_mode)) {
+            if (_MarkVisited(st))
+              pending.push_back(path);
+          } else if (S_ISREG(st.st_mode)) {
+            ProcessFile(path, st);
           }
         }
       }
+
+      while (!pending.empty() && !fStopRequested) {
+        if (fPriorityChanged.exchange(false))
+          _PrioritizePending(pending, 0);
+        BString currentPath = pending.back();
+        pending.pop_back();
+        size_t found = pending.size();
+        _ScanDirectory(currentPath, pending);
+        _PrioritizePending(pending, found);
+      }
+
+      _StopTagReaders();
+      scanTrace.SetArg(fFoundFiles);
     }
 
     FlushBatch();
@@ -466,16 +975,31 @@ void MediaLibraryScanner::WorkerMethod() {
     if (!fStopRequested) {
       DEBUG_PRINT("Worker: Scan finished\n");
 
+      BMessage stats;
+      fStats.Archive(&stats);
+
       if (fCacheTarget.IsValid()) {
-        fCacheTarget.SendMessage(MSG_SCAN_DONE);
+        BMessage cacheDone(MSG_SCAN_DONE);
+        cacheDone.AddString("base", fBasePath);
+        cacheDone.AddInt32("dirs", fScannedDirs);
+        cacheDone.AddInt32("files", fFoundFiles);
+        if (!fPaths.empty())
+          cacheDone.AddBool("incremental", true);
+        if (usedDelta)
+          cacheDone.AddBool("delta", true);
+        cacheDone.AddMessage("stats", &stats);
+        fCacheTarget.SendMessage(&cacheDone);
       }
 
-      if (fLiveTarget.IsValid()) {
+      // A cache that also collects progress reports for the UI itself.
+      if (fLiveTarget.IsValid() && fPaths.empty() &&
+          fLiveTarget != fCacheTarget) {
         BMessage doneMsg(MSG_SCAN_DONE);
         auto totalElapsed = std::chrono::duration_cast<std::chrono::seconds>(
                                 std::chrono::steady_clock::now() - fStartTime)
                                 .count();
         doneMsg.AddInt64("elapsed_sec", totalElapsed);
+        doneMsg.AddMessage("stats", &stats);
         fLiveTarget.SendMessage(&doneMsg);
 
         BMessage progress(MSG_SCAN_PROGRESS);
@@ -1,7 +1,9 @@
 #ifndef BETON_MEDIA_LIBRARY_SCANNER_H
 #define BETON_MEDIA_LIBRARY_SCANNER_H
 
+#include "LibrarySnapshot.h"
 #include "MediaItem.h"
+#include "ScanStats.h"
 
 #include <Directory.h>
 #include <Entry.h>
@@ -14,7 +16,12 @@
 #include <String.h>
 #include <atomic>
 #include <chrono>
+#include <deque>
 #include <map>
+#include <memory_resource>
+#include <set>
+#include <sys/stat.h>
+#include <utility>
 #include <vector>
 
 /**
@@ -23,11 +30,19 @@
  * extraction.
  *
  * Runs in its own thread (via BLooper and a separate worker thread).
- * Scans a directory tree, identifies audio files, extracts metadata using
- * TagLib, and sends batches of `MediaItem`s to the `MediaLibraryCache` for storage.
+ * The worker walks the directory tree and queues audio files for a bounded
+ * pool of tag reader threads, which extract metadata using TagLib. Results
+ * are put back into traversal order before they are sent as batches of
+ * `MediaItem`s to the `MediaLibraryCache` for storage.
  *
  * Supports incremental scanning by checking file modification times against
- * a provided cache map.
+ * a provided cache map. Files missing from the cache under their path but
+ * known by (device, inode), size and mtime are reported as moved and keep
+ * their cached tags.
+ *
+ * Each run keeps ScanStats: progress reports carry the read throughput and
+ * MSG_SCAN_DONE the time per phase and the slowest files and directories
+ * ("stats").
  */
 class MediaLibraryScanner : public BLooper {
 public:
@@ -37,7 +52,8 @@ public:
    * @param cacheTarget Messenger to receive batched MediaItems
    * (MSG_MEDIA_BATCH).
    * @param liveTarget Messenger to receive progress updates
-   * (MSG_SCAN_PROGRESS).
+   * (MSG_SCAN_PROGRESS with "base"). If it equals `cacheTarget`, the counts
+   * are only sent with the cache's MSG_SCAN_DONE at the end.
    */
   MediaLibraryScanner(const entry_ref &startDir, BMessenger cacheTarget,
                BMessenger liveTarget);
@@ -45,32 +61,120 @@ public:
 
   void MessageReceived(BMessage *msg) override;
 
+  /** @brief Times dispatched messages when looper statistics are on. */
+  void DispatchMessage(BMessage *msg, BHandler *handler) override;
+
+  /**
+   * @brief Shares the known entries to enable incremental scanning.
+   * @param cache Snapshot of the entries known from the previous scan; read
+   * only, and shared with the other scanners and the window.
+   */
+  void SetCache(LibrarySnapshot *cache) { fCache.SetTo(cache); }
+
+  /**
+   * @brief Sets the size of the tag reader pool (0 = one per CPU).
+   * Must be called before MSG_START_SCAN.
+   */
+  void SetTagReaderCount(int32 count);
+
+  /**
+   * @brief Restricts the scan to `paths` below the start directory.
+   *
+   * Files are read directly, directories are walked recursively. Used for
+   * incremental updates from the library watcher: no progress is reported
+   * and MSG_SCAN_DONE (with "incremental" set) only goes to the cache.
+   * Must be called before MSG_START_SCAN.
+   */
+  void SetPaths(const std::vector<BString> &paths) { fPaths = paths; }
+
+  /**
+   * @brief Enables the BFS delta scan: only files with `last_modified` after
+   * `since` (seconds) are visited, found via a volume query.
+   *
+   * Falls back to the directory walk if the volume cannot answer the query.
+   * Deleted files are not detected by the query; the cache checks known
+   * entries for that. MSG_SCAN_DONE carries "delta" when the query was used.
+   * Must be called before MSG_START_SCAN.
+   */
+  void SetDeltaSince(time_t since) { fDeltaSince = since; }
+
+  /**
+   * @brief Sets the I/O throttle (see `ScanScheduler::ThrottleLevel`).
+   *
+   * Usually set through `MSG_SCAN_THROTTLE`; takes effect at the next
+   * directory or file.
+   */
+  void SetThrottle(int32 level) { fThrottle = level; }
+
   /**
-   * @brief Pre-loads the cache to enable incremental scanning.
-   * @param cache Map of existing file paths to MediaItems.
+   * @brief Sets the files the user is looking at (`MSG_SCAN_PRIORITY`).
+   *
+   * Pending directories that lead to them or lie next to their folders are
+   * walked first, and the files themselves jump the tag reader queue. An
+   * empty list restores the plain depth-first order.
    */
-  void SetCache(const std::map<BString, MediaItem> &cache) { fCache = cache; }
+  void SetPriorityPaths(std::vector<BString> paths);
 
 private:
-  void ProcessFile(BEntry &entry);
+  /** @brief File queued for tag extraction. */
+  struct TagJob {
+    uint64 sequence = 0;
+    BString path;
+    struct stat st{};
+    /// Duration of the cached entry of the same inode, otherwise 0
+    int32 cachedDuration = 0;
+  };
+
+  /** @brief Finished job waiting for its turn in traversal order. */
+  struct ReorderSlot {
+    bool valid = false;
+    MediaItem item;
+    BString movedFrom; ///< Previous path if the item was re-keyed
+  };
+
+  void ProcessFile(const BString &filePath, const struct stat &st);
+  bool _ProcessMove(const BString &filePath, const struct stat &st);
+  dev_t _DeviceOf(const BString &path);
+  bool _RunDeltaQuery();
+  void _ScanDirectory(const BString &dirPath, std::vector<BString> &pending);
+  void _PrioritizePending(std::vector<BString> &pending, size_t from);
+  bool _IsPriorityDirectory(const BString &dirPath) const;
+  bool _IsPriorityFile(const BString &filePath);
+  bool _MarkVisited(const struct stat &st);
+  void _WaitWhileThrottled();
   void FlushBatch();
   void ReportProgress();
 
+  void _ReadTags(const TagJob &job, MediaItem &item);
+  void _StartTagReaders();
+  void _StopTagReaders();
+  void _EnqueueJob(const TagJob &job);
+  void _CompleteJob(uint64 sequence, MediaItem *item,
+                    const BString &movedFrom = BString());
+
   static status_t WorkerEntry(void *data);
   void WorkerMethod();
 
+  static status_t TagReaderEntry(void *data);
+  void TagReaderMethod();
+
   /** @name Configuration & Messaging */
   ///@{
   entry_ref fStartRef;
   BMessenger fCacheTarget;
   BMessenger fLiveTarget;
   BString fBasePath;
+  std::vector<BString> fPaths; ///< Explicit scan roots (empty = fBasePath)
+  time_t fDeltaSince = 0;      ///< Delta scan threshold (0 = full walk)
   ///@}
 
   /** @name Data */
   ///@{
-  std::map<BString, MediaItem> fCache;
+  BReference<LibrarySnapshot> fCache;
   std::vector<MediaItem> fBatchBuffer;
+  std::vector<std::pair<BString, BString>> fMoveBuffer; ///< Guarded by fBatchLock
+  /** @brief Device of each parent directory of a moved entry (traversal). */
+  std::map<BString, dev_t> fOldDirDevices;
   BLocker fBatchLock;
   ///@}
 
@@ -78,6 +182,33 @@ private:
   ///@{
   thread_id fWorkerThread;
   sem_id fControlSem;
+  int32 fTagReaderCount = 0;
+  std::vector<thread_id> fTagReaders;
+  std::deque<TagJob> fJobQueue;       ///< Guarded by fJobLock
+  BLocker fJobLock;
+  sem_id fJobsSem = -1;               ///< Counts queued jobs + exit tokens
+  sem_id fSlotsSem = -1;              ///< Free queue slots (bounds the queue)
+  bool fReadersExit = false;          ///< Guarded by fJobLock
+  uint64 fNextJobSequence = 0;        ///< Traversal thread only
+  uint64 fNextEmitSequence = 0;       ///< Guarded by fBatchLock
+  /**
+   * @brief Recycles the reorder buffer's nodes: every file passes through
+   * one, and at most a queue's worth are alive. Guarded by fBatchLock.
+   */
+  std::pmr::unsynchronized_pool_resource fReorderArena;
+  std::pmr::map<uint64, ReorderSlot> fReorderBuffer{&fReorderArena};
+  /** @brief (device, inode) of directories visited by the current walk. */
+  std::set<std::pair<dev_t, ino_t>> fVisitedDirs;
+  ///@}
+
+  /** @name Priority Hints */
+  ///@{
+  BLocker fPriorityLock;
+  std::vector<BString> fPriorityPaths; ///< Sorted; guarded by fPriorityLock
+  /// Parents of the hinted files' folders, with a trailing slash
+  std::vector<BString> fPriorityAreas; ///< Guarded by fPriorityLock
+  std::atomic<bool> fHasPriority{false};
+  std::atomic<bool> fPriorityChanged{false}; ///< Pending order is stale
   ///@}
 
   /** @name State Flags */
@@ -85,12 +216,14 @@ private:
   bool fScanRequested;
   std::atomic<bool> fStopRequested;
   std::atomic<bool> fIsScanning;
+  std::atomic<int32> fThrottle{0};
   ///@}
 
   /** @name Progress Tracking */
   ///@{
   std::atomic<int> fScannedDirs;
   std::atomic<int> fFoundFiles;
+  ScanStats fStats;
   std::chrono::steady_clock::time_point fLastUpdate;
   std::chrono::steady_clock::time_point fStartTime;
   ///@}
@@ -0,0 +1,122 @@
+#include "MediaSortKey.h"
+#include "ParallelAlgorithms.h"
+
+#include <algorithm>
+#include <cstring>
+#include <strings.h>
+
+/** @brief Bytes of a string packed into the key prefix. */
+static const int32 kPrefixBytes = 8;
+
+static inline uint64 BiasInt(int32 value) {
+  // Flipping the sign bit makes signed order match unsigned order.
+  return (uint64)((uint32)value ^ 0x80000000u);
+}
+
+MediaSortKey MediaSortKey::ForString(const BString &value) {
+  MediaSortKey key;
+  const char *text = value.String();
+  int32 length = value.Length();
+
+  // Fold the way strcasecmp() does (ASCII only), so keys order like
+  // BString::ICompare(). Short strings are padded with zero bytes, which
+  // sort before any character, just like the terminating NUL.
+  int32 count = std::min(length, kPrefixBytes);
+  for (int32 i = 0; i < kPrefixBytes; i++) {
+    uint8 c = i < count ? (uint8)text[i] : 0;
+    if (c >= 'A' && c <= 'Z')
+      c += 'a' - 'A';
+    key.prefix = (key.prefix << 8) | c;
+  }
+  if (length > kPrefixBytes)
+    key.tail = text + kPrefixBytes;
+  return key;
+}
+
+MediaSortKey MediaSortKey::ForInt(int32 value) {
+  MediaSortKey key;
+  key.prefix = BiasInt(value);
+  return key;
+}
+
+MediaSortKey MediaSortKey::ForInts(int32 major, int32 minor) {
+  MediaSortKey key;
+  key.prefix = (BiasInt(major) << 32) | BiasInt(minor);
+  return key;
+}
+
+MediaSortKey MediaSortKey::ForField(const MediaItem &item, int32 field) {
+  switch (field) {
+  case 0:
+    return ForString(item.title);
+  case 1:
+    return ForString(item.artist);
+  case 2:
+    return ForString(item.album);
+  case 3:
+    return ForString(item.albumArtist);
+  case 4:
+    return ForString(item.genre);
+  case 5:
+    return ForInt(item.year);
+  case 6:
+    return ForInt(item.duration);
+  case 7:
+  case 8:
+    return ForInts(item.disc, item.track);
+  case 9:
+    return ForInt(item.bitrate);
+  case 10:
+    return ForString(item.path);
+  case 11:
+    return ForInt(item.rating);
+  default:
+    return MediaSortKey();
+  }
+}
+
+int MediaSortKey::Compare(const MediaSortKey &a, const MediaSortKey &b) {
+  if (a.prefix != b.prefix)
+    return a.prefix < b.prefix ? -1 : 1;
+  if (a.tail == b.tail)
+    return 0;
+  // Equal prefixes with one tail missing: that string ended after exactly
+  // kPrefixBytes bytes, so it is the shorter one.
+  if (a.tail == nullptr)
+    return -1;
+  if (b.tail == nullptr)
+    return 1;
+  int result = strcasecmp(a.tail, b.tail);
+  return (result < 0) ? -1 : (result > 0 ? 1 : 0);
+}
+
+void SortMediaItems(std::vector<MediaItem> &items, int32 field,
+                    bool ascending) {
+  struct Entry {
+    MediaSortKey key;
+    MediaSortKey path;
+    uint32 index;
+  };
+
+  std::vector<Entry> entries(items.size());
+  for (size_t i = 0; i < items.size(); i++) {
+    entries[i].key = MediaSortKey::ForField(items[i], field);
+    entries[i].path = MediaSortKey::ForString(items[i].path);
+    entries[i].index = (uint32)i;
+  }
+
+  ParallelAlgorithms::Sort(entries.begin(), entries.end(),
+                           [ascending](const Entry &a, const Entry &b) {
+                             int result = MediaSortKey::Compare(a.key, b.key);
+                             if (result == 0)
+                               result = MediaSortKey::Compare(a.path, b.path);
+                             return ascending ? (result < 0) : (result > 0);
+                           });
+
+  // The keys point into the items, so only move them once sorting is done.
+  std::vector<MediaItem> sorted;
+  sorted.reserve(items.size());
+  for (const Entry &entry : entries)
+    sorted.push_back(std::move(items[entry.index]));
+  items.swap(sorted);
+}
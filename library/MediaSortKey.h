@@ -0,0 +1,53 @@
+#ifndef BETON_MEDIA_SORT_KEY_H
+#define BETON_MEDIA_SORT_KEY_H
+
+#include "MediaItem.h"
+
+#include <SupportDefs.h>
+#include <vector>
+
+/**
+ * @struct MediaSortKey
+ * @brief Precomputed sort key of one media table field.
+ *
+ * String fields pack their first eight case-folded bytes big-endian into
+ * `prefix` and keep a pointer to the rest in `tail`; numeric fields are
+ * biased into `prefix` and have no tail. Comparing two keys orders exactly
+ * like `BString::ICompare()` (or integer comparison), but most comparisons
+ * end after a single 64-bit compare.
+ *
+ * The tail points into the item's string, so a key is only valid as long as
+ * the item it was made from is unchanged.
+ */
+struct MediaSortKey {
+  uint64 prefix = 0;
+  const char *tail = nullptr; ///< Bytes after the prefix, or nullptr
+
+  /**
+   * @brief Builds the key of `field` (the MediaTableView field IDs 0-11).
+   *
+   * Track and Disc both order by disc, then track.
+   */
+  static MediaSortKey ForField(const MediaItem &item, int32 field);
+  static MediaSortKey ForString(const BString &value);
+  static MediaSortKey ForInt(int32 value);
+  static MediaSortKey ForInts(int32 major, int32 minor);
+
+  /** @brief Three-way comparison (-1, 0, 1). */
+  static int Compare(const MediaSortKey &a, const MediaSortKey &b);
+};
+
+/**
+ * @brief Sorts items by one field, ties broken by path.
+ *
+ * Builds each item's keys once, sorts the keys (in parallel for large
+ * lists) and moves the items into their final order in a single pass.
+ *
+ * @param items Items to sort in place.
+ * @param field MediaTableView field ID (0-11).
+ * @param ascending Sort direction.
+ */
+void SortMediaItems(std::vector<MediaItem> &items, int32 field,
+                    bool ascending);
+
+#endif // BETON_MEDIA_SORT_KEY_H
@@ -6,6 +6,7 @@
 #include "MusicSourceSettings.h"
 #include "Debug.h"
 
+#include <Autolock.h>
 #include <File.h>
 #include <FindDirectory.h>
 #include <Path.h>
@@ -94,61 +95,110 @@ const char *MusicSourceSettings::ConflictModeName(ConflictMode m) {
   }
 }
 
+std::vector<MusicSourceSettings> MusicSourceSettings::sCache;
+MusicSourceSettings::TrieNode MusicSourceSettings::sTrie;
+bool MusicSourceSettings::sCacheLoaded = false;
+BLocker MusicSourceSettings::sLock("MusicSourceSettings");
+
 /**
  * @brief Find MusicSourceSettings settings for a given file path.
  */
 MusicSourceSettings MusicSourceSettings::GetSourceForPath(const BString &filePath) {
+  BAutolock lock(&sLock);
   if (!sCacheLoaded)
-    InitCache();
+    _LoadLocked();
 
-  MusicSourceSettings bestMatch;
-  int32 bestLen = 0;
+  const MusicSourceSettings *found = _FindLocked(filePath);
+  return found != nullptr ? *found : MusicSourceSettings();
+}
 
-  for (const auto &src : sCache) {
-    if (src.path.IsEmpty())
-      continue;
-    int32 len = src.path.Length();
-    bool match = filePath.StartsWith(src.path.String()) &&
-                 (filePath.Length() == len ||
-                  filePath[len] == '/' ||
-                  src.path[len - 1] == '/');
-    if (match && len > bestLen) {
-      bestLen = len;
-      bestMatch = src;
-    }
+/**
+ * @brief Finds the settings for many files, resolving each directory once.
+ */
+std::vector<MusicSourceSettings>
+MusicSourceSettings::GetSourcesForPaths(const std::vector<BString> &filePaths) {
+  BAutolock lock(&sLock);
+  if (!sCacheLoaded)
+    _LoadLocked();
+
+  std::vector<MusicSourceSettings> sources;
+  sources.reserve(filePaths.size());
+  std::map<BString, const MusicSourceSettings *> directories;
+  const MusicSourceSettings fallback;
+  for (const BString &filePath : filePaths) {
+    BString directory(filePath);
+    int32 slash = directory.FindLast('/');
+    if (slash >= 0)
+      directory.Truncate(slash);
+    auto it = directories.find(directory);
+    if (it == directories.end())
+      it = directories.emplace(directory, _FindLocked(filePath)).first;
+    sources.push_back(it->second != nullptr ? *it->second : fallback);
   }
-
-  return bestMatch;
+  return sources;
 }
 
-std::vector<MusicSourceSettings> MusicSourceSettings::sCache;
-bool MusicSourceSettings::sCacheLoaded = false;
+/**
+ * @brief Returns the source with the longest path above `filePath`.
+ *
+ * Empty components are skipped, so "/music/" and "/music" are the same
+ * source, and "/" holds every file.
+ */
+const MusicSourceSettings *
+MusicSourceSettings::_FindLocked(const BString &filePath) {
+  const TrieNode *node = &sTrie;
+  int32 best = node->source;
+  const int32 length = filePath.Length();
+  int32 start = 0;
+  while (start < length) {
+    int32 end = filePath.FindFirst('/', start);
+    if (end < 0)
+      end = length;
+    if (end > start) {
+      BString component;
+      filePath.CopyInto(component, start, end - start);
+      auto child = node->children.find(component);
+      if (child == node->children.end())
+        break;
+      node = child->second.get();
+      if (node->source >= 0)
+        best = node->source;
+    }
+    start = end + 1;
+  }
+  return best >= 0 ? &sCache[best] : nullptr;
+}
 
 /**
  * @brief Loads all MusicSourceSettings entries from directories.settings into memory.
  */
 void MusicSourceSettings::InitCache() {
+  BAutolock lock(&sLock);
+  _LoadLocked();
+}
+
+/**
+ * @brief Loads the sources and builds the path trie over them.
+ */
+void MusicSourceSettings::_LoadLocked() {
   sCache.clear();
+  sTrie.children.clear();
+  sTrie.source = -1;
+  sCacheLoaded = true;
 
   BPath settingsPath;
-  if (find_directory(B_USER_SETTINGS_DIRECTORY, &settingsPath) != B_OK) {
-    sCacheLoaded = true;
+  if (find_directory(B_USER_SETTINGS_DIRECTORY, &settingsPath) != B_OK)
     return;
-  }
 
   settingsPath.Append("BeTon/directories.settings");
 
   BFile file(settingsPath.Path(), B_READ_ONLY);
-  if (file.InitCheck() != B_OK) {
-    sCacheLoaded = true;
+  if (file.InitCheck() != B_OK)
     return;
-  }
 
   BMessage archive;
-  if (archive.Unflatten(&file) != B_OK) {
-    sCacheLoaded = true;
+  if (archive.Unflatten(&file) != B_OK)
     return;
-  }
 
   BMessage srcMsg;
   int32 idx = 0;
@@ -158,7 +208,31 @@ void MusicSourceSettings::InitCache() {
     sCache.push_back(src);
   }
 
-  sCacheLoaded = true;
+  for (int32 i = 0; i < (int32)sCache.size(); i++) {
+    const BString &path = sCache[i].path;
+    if (path.IsEmpty())
+      continue;
+    TrieNode *node = &sTrie;
+    int32 start = 0;
+    while (start < path.Length()) {
+      int32 end = path.FindFirst('/', start);
+      if (end < 0)
+        end = path.Length();
+      if (end > start) {
+        BString component;
+        path.CopyInto(component, start, end - start);
+        std::unique_ptr<TrieNode> &child = node->children[component];
+        if (!child)
+          child.reset(new TrieNode);
+        node = child.get();
+      }
+      start = end + 1;
+    }
+    // The first of two entries for one directory wins.
+    if (node->source < 0)
+      node->source = i;
+  }
+
   DEBUG_PRINT("Cache loaded: %zu sources\n", sCache.size());
 }
 
@@ -166,6 +240,9 @@ void MusicSourceSettings::InitCache() {
  * @brief Discards the in-memory cache so it is reloaded on next access.
  */
 void MusicSourceSettings::InvalidateCache() {
+  BAutolock lock(&sLock);
   sCache.clear();
+  sTrie.children.clear();
+  sTrie.source = -1;
   sCacheLoaded = false;
 }
@@ -10,8 +10,11 @@
 #ifndef BETON_MUSIC_SOURCE_SETTINGS_H
 #define BETON_MUSIC_SOURCE_SETTINGS_H
 
+#include <Locker.h>
 #include <Message.h>
 #include <String.h>
+#include <map>
+#include <memory>
 #include <vector>
 
 /**
@@ -84,14 +87,23 @@ struct MusicSourceSettings {
   /**
    * @brief Find MusicSourceSettings settings for a given file path.
    *
-   * Uses the in-memory cache populated by InitCache() to find
-   * the MusicSourceSettings whose path is a prefix of the given file path.
+   * Walks the path trie built by InitCache() to find the MusicSourceSettings
+   * with the longest path that is a prefix of the given file path; the cost
+   * grows with the depth of the path, not the number of sources.
    *
    * @param filePath Absolute path to a media file
    * @return MusicSourceSettings for the directory, or default settings if not found
    */
   static MusicSourceSettings GetSourceForPath(const BString &filePath);
 
+  /**
+   * @brief Finds the settings for many files, resolving each directory once.
+   * @param filePaths Absolute paths to media files
+   * @return The settings for each file, in the order of `filePaths`
+   */
+  static std::vector<MusicSourceSettings>
+  GetSourcesForPaths(const std::vector<BString> &filePaths);
+
   /**
    * @brief Loads all MusicSourceSettings entries from directories.settings into memory.
    *
@@ -105,10 +117,26 @@ struct MusicSourceSettings {
   static void InvalidateCache();
 
 private:
+  /**
+   * @brief One path component; the sources of a path end at its last node.
+   */
+  struct TrieNode {
+    std::map<BString, std::unique_ptr<TrieNode>> children;
+    /** @brief Index into `sCache` of the source ending here, or -1. */
+    int32 source = -1;
+  };
+
+  static void _LoadLocked();
+  static const MusicSourceSettings *_FindLocked(const BString &filePath);
+
   /** @brief Cached source settings loaded from `directories.settings`. */
   static std::vector<MusicSourceSettings> sCache;
+  /** @brief Source paths of `sCache`, split at '/'. */
+  static TrieNode sTrie;
   /** @brief Indicates whether `sCache` was initialized. */
   static bool sCacheLoaded;
+  /** @brief Guards the cache; sources are resolved from worker threads. */
+  static BLocker sLock;
 };
 
 #endif // BETON_MUSIC_SOURCE_SETTINGS_H
@@ -0,0 +1,62 @@
+#include "ParallelAlgorithms.h"
+
+#include <OS.h>
+
+/** @brief Upper bound for workers, so huge machines do not over-split. */
+static const int32 kMaxWorkers = 16;
+
+struct ParallelTask {
+  const std::function<void(int32)> *task;
+  int32 index;
+};
+
+static int32 ParallelTaskEntry(void *data) {
+  ParallelTask *task = static_cast<ParallelTask *>(data);
+  (*task->task)(task->index);
+  return 0;
+}
+
+int32 ParallelAlgorithms::WorkerCount() {
+  static const int32 sCount = []() {
+    system_info info;
+    int32 count = get_system_info(&info) == B_OK ? (int32)info.cpu_count : 1;
+    return std::max((int32)1, std::min(count, kMaxWorkers));
+  }();
+  return sCount;
+}
+
+void ParallelAlgorithms::Run(int32 count,
+                             const std::function<void(int32)> &task) {
+  if (count <= 0)
+    return;
+
+  // Helpers run at the caller's priority, so a window thread's sort is not
+  // overtaken by background work.
+  thread_info self;
+  int32 priority = get_thread_info(find_thread(NULL), &self) == B_OK
+                       ? self.priority
+                       : B_NORMAL_PRIORITY;
+
+  std::vector<ParallelTask> tasks(count);
+  std::vector<thread_id> threads;
+  threads.reserve(count - 1);
+  for (int32 i = 1; i < count; i++) {
+    tasks[i].task = &task;
+    tasks[i].index = i;
+    thread_id thread = spawn_thread(ParallelTaskEntry, "ParallelAlgorithms",
+                                    priority, &tasks[i]);
+    if (thread < 0) {
+      task(i);
+      continue;
+    }
+    threads.push_back(thread);
+    resume_thread(thread);
+  }
+
+  task(0);
+
+  for (thread_id thread : threads) {
+    status_t exitValue;
+    wait_for_thread(thread, &exitValue);
+  }
+}
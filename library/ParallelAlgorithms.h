@@ -0,0 +1,126 @@
+#ifndef BETON_PARALLEL_ALGORITHMS_H
+#define BETON_PARALLEL_ALGORITHMS_H
+
+#include <SupportDefs.h>
+#include <algorithm>
+#include <functional>
+#include <iterator>
+#include <vector>
+
+/**
+ * @class ParallelAlgorithms
+ * @brief Sort and filter kernels that split large inputs across the CPUs.
+ *
+ * Inputs below the threshold run serially on the calling thread, so small
+ * views pay nothing. Larger ones are cut into one chunk per worker; the
+ * calling thread works on the first chunk and waits for the others before
+ * returning. Results are the same as the serial versions (filters keep the
+ * input order).
+ *
+ * Comparators and predicates run concurrently and must only read shared
+ * data.
+ */
+class ParallelAlgorithms {
+public:
+  /** @brief Input size below which the kernels stay serial. */
+  static const size_t kDefaultThreshold = 16384;
+
+  /** @brief Number of workers used for large inputs (CPU count, capped). */
+  static int32 WorkerCount();
+
+  /**
+   * @brief Calls `task(i)` for every `i` in `[0, count)` concurrently and
+   * returns once all calls finished.
+   */
+  static void Run(int32 count, const std::function<void(int32)> &task);
+
+  /**
+   * @brief Parallel merge sort: sorts one chunk per worker, then merges
+   * neighbouring runs in parallel rounds.
+   */
+  template <typename Iterator, typename Compare>
+  static void Sort(Iterator first, Iterator last, Compare compare,
+                   size_t threshold = kDefaultThreshold) {
+    size_t size = std::distance(first, last);
+    int32 chunks = _ChunkCount(size, threshold);
+    if (chunks <= 1) {
+      std::sort(first, last, compare);
+      return;
+    }
+
+    std::vector<size_t> bounds = _ChunkBounds(size, chunks);
+    Run(chunks, [&](int32 i) {
+      std::sort(first + bounds[i], first + bounds[i + 1], compare);
+    });
+
+    while (bounds.size() > 2) {
+      int32 runs = (int32)bounds.size() - 1;
+      Run(runs / 2, [&](int32 pair) {
+        std::inplace_merge(first + bounds[2 * pair],
+                           first + bounds[2 * pair + 1],
+                           first + bounds[2 * pair + 2], compare);
+      });
+
+      // Every merged pair becomes one run; an odd last run is kept as is.
+      std::vector<size_t> merged;
+      for (size_t i = 0; i < bounds.size(); i += 2)
+        merged.push_back(bounds[i]);
+      if (merged.back() != size)
+        merged.push_back(size);
+      bounds.swap(merged);
+    }
+  }
+
+  /**
+   * @brief Collects the positions in `[0, count)` that satisfy `predicate`,
+   * in ascending order.
+   *
+   * Every worker filters a contiguous chunk into its own list; the lists are
+   * concatenated in chunk order.
+   */
+  template <typename Predicate>
+  static void FilterPositions(size_t count, Predicate predicate,
+                              std::vector<uint32> &out,
+                              size_t threshold = kDefaultThreshold) {
+    int32 chunks = _ChunkCount(count, threshold);
+    if (chunks <= 1) {
+      for (size_t i = 0; i < count; i++) {
+        if (predicate(i))
+          out.push_back((uint32)i);
+      }
+      return;
+    }
+
+    std::vector<size_t> bounds = _ChunkBounds(count, chunks);
+    std::vector<std::vector<uint32>> parts(chunks);
+    Run(chunks, [&](int32 chunk) {
+      for (size_t i = bounds[chunk]; i < bounds[chunk + 1]; i++) {
+        if (predicate(i))
+          parts[chunk].push_back((uint32)i);
+      }
+    });
+
+    size_t total = out.size();
+    for (const auto &part : parts)
+      total += part.size();
+    out.reserve(total);
+    for (const auto &part : parts)
+      out.insert(out.end(), part.begin(), part.end());
+  }
+
+private:
+  static int32 _ChunkCount(size_t size, size_t threshold) {
+    if (size < threshold || size < 2)
+      return 1;
+    return (int32)std::min((size_t)WorkerCount(), size);
+  }
+
+  static std::vector<size_t> _ChunkBounds(size_t size, int32 chunks) {
+    std::vector<size_t> bounds(chunks + 1);
+    for (int32 i = 0; i <= chunks; i++)
+      bounds[i] = size * i / chunks;
+    return bounds;
+  }
+};
+
+#endif // BETON_PARALLEL_ALGORITHMS_H
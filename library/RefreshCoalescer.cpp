@@ -0,0 +1,48 @@
+#include "RefreshCoalescer.h"
+#include "Debug.h"
+
+#include <Message.h>
+#include <MessageRunner.h>
+
+#include <algorithm>
+
+/** @brief Interval before any refresh was measured (the old fixed debounce). */
+static const bigtime_t kInitialInterval = 200000;
+
+RefreshCoalescer::RefreshCoalescer(const BMessenger &target, uint32 what)
+    : fTarget(target), fWhat(what), fRunner(nullptr),
+      fInterval(kInitialInterval), fAverageCost(0) {}
+
+RefreshCoalescer::~RefreshCoalescer() { delete fRunner; }
+
+void RefreshCoalescer::Schedule() {
+  if (fRunner != nullptr)
+    return;
+  BMessage msg(fWhat);
+  fRunner = new BMessageRunner(fTarget, &msg, fInterval, 1);
+  if (fRunner->InitCheck() != B_OK) {
+    delete fRunner;
+    fRunner = nullptr;
+    fTarget.SendMessage(&msg);
+  }
+}
+
+void RefreshCoalescer::Fired() {
+  delete fRunner;
+  fRunner = nullptr;
+}
+
+void RefreshCoalescer::Cancel() { Fired(); }
+
+void RefreshCoalescer::RecordCost(bigtime_t cost) {
+  if (cost < 0)
+    return;
+  // Weight new samples by 1/4: one slow refresh should not stall the views.
+  fAverageCost = fAverageCost == 0 ? cost : (fAverageCost * 3 + cost) / 4;
+  fInterval = std::clamp(fAverageCost * 100 / kBudgetPercent, kMinInterval,
+                         kMaxInterval);
+  DEBUG_PRINT("RefreshCoalescer: cost %lld us, average %lld us, next in "
+              "%lld ms\n",
+              (long long)cost, (long long)fAverageCost,
+              (long long)fInterval / 1000);
+}
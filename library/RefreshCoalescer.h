@@ -0,0 +1,60 @@
+#ifndef BETON_REFRESH_COALESCER_H
+#define BETON_REFRESH_COALESCER_H
+
+#include <Messenger.h>
+#include <SupportDefs.h>
+
+class BMessageRunner;
+
+/**
+ * @class RefreshCoalescer
+ * @brief Paces a repeated UI refresh by how long the refresh itself takes.
+ *
+ * Schedule() arms a one-shot timer unless one is already pending, so a
+ * steady stream of updates refreshes once per interval instead of pushing
+ * the refresh back forever. After each refresh the caller reports its cost
+ * on the window thread; the interval is then set so refreshes use at most
+ * `kBudgetPercent` of the window thread (within `kMinInterval` and
+ * `kMaxInterval`). A fast disk thus gets fewer, larger refreshes once they
+ * become expensive, while cheap refreshes keep the views lively.
+ *
+ * Not thread-safe; use from the window thread.
+ */
+class RefreshCoalescer {
+public:
+  static constexpr bigtime_t kMinInterval = 100000;
+  static constexpr bigtime_t kMaxInterval = 3000000;
+  static constexpr int32 kBudgetPercent = 20;
+
+  /**
+   * @param target Receiver of the refresh message.
+   * @param what Refresh message command.
+   */
+  RefreshCoalescer(const BMessenger &target, uint32 what);
+  ~RefreshCoalescer();
+
+  /** @brief Arms the timer unless a refresh is already pending. */
+  void Schedule();
+
+  /** @brief Call when the refresh message arrives. */
+  void Fired();
+
+  /** @brief Drops a pending refresh. */
+  void Cancel();
+
+  bool IsPending() const { return fRunner != nullptr; }
+
+  /** @brief Feeds the window-thread time of the refresh that just ran. */
+  void RecordCost(bigtime_t cost);
+
+  bigtime_t Interval() const { return fInterval; }
+
+private:
+  BMessenger fTarget;
+  uint32 fWhat;
+  BMessageRunner *fRunner;
+  bigtime_t fInterval;
+  bigtime_t fAverageCost; ///< Exponential moving average
+};
+
+#endif // BETON_REFRESH_COALESCER_H
@@ -0,0 +1,133 @@
+#include "ScanScheduler.h"
+#include "Debug.h"
+#include "Messages.h"
+
+#include <Message.h>
+
+/** @brief Scanners allowed per device unless configured otherwise. */
+static const int32 kDefaultDeviceLimit = 1;
+
+ScanScheduler::ScanScheduler()
+    : fDeviceLimit(kDefaultDeviceLimit), fPaused(false), fPlaybackDevice(-1) {}
+
+void ScanScheduler::SetDeviceLimit(int32 limit) {
+  fDeviceLimit = limit < 1 ? 1 : limit;
+  _Dispatch();
+}
+
+void ScanScheduler::Enqueue(const BMessenger &scanner, const BString &base,
+                            dev_t device) {
+  Job job;
+  job.scanner = scanner;
+  job.base = base;
+  job.device = device;
+  fJobs.push_back(job);
+  _Dispatch();
+}
+
+void ScanScheduler::Finished(const BString &base) {
+  for (auto it = fJobs.begin(); it != fJobs.end(); ++it) {
+    if (!it->running || it->base != base)
+      continue;
+    if (--fRunning[it->device] <= 0)
+      fRunning.erase(it->device);
+    fJobs.erase(it);
+    break;
+  }
+  _Dispatch();
+}
+
+void ScanScheduler::SetPaused(bool paused) {
+  if (fPaused == paused)
+    return;
+  fPaused = paused;
+  DEBUG_PRINT("ScanScheduler: %s\n", paused ? "paused" : "resumed");
+  _Dispatch();
+}
+
+void ScanScheduler::SetPlaybackDevice(dev_t device) {
+  if (fPlaybackDevice == device)
+    return;
+  fPlaybackDevice = device;
+  _Dispatch();
+}
+
+void ScanScheduler::SetPriorityPaths(const std::vector<BString> &paths) {
+  if (paths == fPriorityPaths)
+    return;
+  fPriorityPaths = paths;
+  for (const Job &job : fJobs) {
+    if (job.running)
+      _SendPriority(job);
+  }
+}
+
+int32 ScanScheduler::CountQueued() const {
+  int32 count = 0;
+  for (const Job &job : fJobs) {
+    if (!job.running)
+      count++;
+  }
+  return count;
+}
+
+int32 ScanScheduler::CountRunning() const {
+  return (int32)fJobs.size() - CountQueued();
+}
+
+int32 ScanScheduler::_ThrottleFor(const Job &job) const {
+  if (fPaused)
+    return kThrottlePaused;
+  if (fPlaybackDevice >= 0 && job.device == fPlaybackDevice)
+    return kThrottleBackOff;
+  return kThrottleNone;
+}
+
+void ScanScheduler::_UpdateThrottle(Job &job) {
+  int32 level = _ThrottleFor(job);
+  if (level == job.throttle)
+    return;
+  job.throttle = level;
+
+  BMessage throttle(MSG_SCAN_THROTTLE);
+  throttle.AddInt32("level", level);
+  job.scanner.SendMessage(&throttle);
+}
+
+void ScanScheduler::_SendPriority(const Job &job) const {
+  BString prefix(job.base);
+  prefix << '/';
+
+  BMessage priority(MSG_SCAN_PRIORITY);
+  for (const BString &path : fPriorityPaths) {
+    if (path.StartsWith(prefix))
+      priority.AddString("path", path);
+  }
+  job.scanner.SendMessage(&priority);
+}
+
+/**
+ * @brief Applies the current throttle to running scanners and starts queued
+ * ones that have a free slot on their device.
+ */
+void ScanScheduler::_Dispatch() {
+  for (Job &job : fJobs) {
+    if (job.running) {
+      _UpdateThrottle(job);
+      continue;
+    }
+    if (fPaused || fRunning[job.device] >= fDeviceLimit)
+      continue;
+
+    job.running = true;
+    fRunning[job.device]++;
+    // Set the level before the walk, so nothing runs at full speed first.
+    _UpdateThrottle(job);
+    if (!fPriorityPaths.empty())
+      _SendPriority(job);
+    job.scanner.SendMessage(MSG_START_SCAN);
+    DEBUG_PRINT("ScanScheduler: started %s (device %ld, %ld running)\n",
+                job.base.String(), (long)job.device,
+                (long)fRunning[job.device]);
+  }
+}
@@ -0,0 +1,95 @@
+#ifndef BETON_SCAN_SCHEDULER_H
+#define BETON_SCAN_SCHEDULER_H
+
+#include <Messenger.h>
+#include <String.h>
+#include <SupportDefs.h>
+#include <map>
+#include <vector>
+
+/**
+ * @class ScanScheduler
+ * @brief Decides when queued `MediaLibraryScanner`s may start.
+ *
+ * Scanners are started in the order they were queued, but at most
+ * `DeviceLimit()` of them walk one device at the same time, so sources on a
+ * single disk do not compete for the head. While local playback reads from a
+ * device, scanners on that device run throttled (`kThrottleBackOff`); while
+ * the scheduler is paused, no scanner starts and running ones wait. Files
+ * the user is looking at are passed on, so scanners read them first.
+ *
+ * Not thread-safe; owned by `MediaLibraryCache` and used on its looper.
+ * Scanners are addressed through messengers only, since they quit on their
+ * own once they finished.
+ */
+class ScanScheduler {
+public:
+  /** @brief Levels sent to scanners in `MSG_SCAN_THROTTLE` ("level"). */
+  enum ThrottleLevel {
+    kThrottleNone = 0,    ///< Full speed.
+    kThrottleBackOff = 1, ///< Short pause after every directory and file.
+    kThrottlePaused = 2   ///< Wait until the level drops again.
+  };
+
+  ScanScheduler();
+
+  /** @brief Sets how many scanners may run per device (at least 1). */
+  void SetDeviceLimit(int32 limit);
+  int32 DeviceLimit() const { return fDeviceLimit; }
+
+  /**
+   * @brief Queues a scanner and starts it if its device has a free slot.
+   *
+   * @param scanner Running scanner looper waiting for `MSG_START_SCAN`.
+   * @param base Scan root as reported in the scanner's `MSG_SCAN_DONE`.
+   * @param device Device of the scan root.
+   */
+  void Enqueue(const BMessenger &scanner, const BString &base, dev_t device);
+
+  /** @brief Frees the slot of the scanner for `base` and starts the next. */
+  void Finished(const BString &base);
+
+  /** @brief Stops (or lets go of) all scanners on the next file. */
+  void SetPaused(bool paused);
+  bool IsPaused() const { return fPaused; }
+
+  /**
+   * @brief Sets the device local playback currently reads from.
+   * @param device Device, or -1 if nothing local is playing.
+   */
+  void SetPlaybackDevice(dev_t device);
+
+  /**
+   * @brief Sets the files the user is looking at; running scanners and
+   * those started later get the ones below their root (`MSG_SCAN_PRIORITY`).
+   */
+  void SetPriorityPaths(const std::vector<BString> &paths);
+
+  /** @brief Number of scanners waiting for a slot. */
+  int32 CountQueued() const;
+  /** @brief Number of scanners started and not finished. */
+  int32 CountRunning() const;
+
+private:
+  struct Job {
+    BMessenger scanner;
+    BString base;
+    dev_t device;
+    bool running = false;
+    int32 throttle = kThrottleNone;
+  };
+
+  void _Dispatch();
+  int32 _ThrottleFor(const Job &job) const;
+  void _UpdateThrottle(Job &job);
+  void _SendPriority(const Job &job) const;
+
+  std::vector<Job> fJobs; ///< Queued and running, in queue order
+  std::map<dev_t, int32> fRunning;
+  int32 fDeviceLimit;
+  bool fPaused;
+  dev_t fPlaybackDevice;
+  std::vector<BString> fPriorityPaths;
+};
+
+#endif // BETON_SCAN_SCHEDULER_H
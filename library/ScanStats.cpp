@@ -0,0 +1,147 @@
+#include "ScanStats.h"
+
+#include <Autolock.h>
+#include <Message.h>
+
+#include <algorithm>
+
+static const char *kPhaseNames[kScanPhaseCount] = {
+    "enumerate", "stat", "tag parse", "attributes", "transport"};
+
+ScanStats::ScanStats() : fFiles(0), fBytes(0), fStart(0) {
+  for (auto &time : fPhaseTime)
+    time = 0;
+}
+
+const char *ScanStats::Name(ScanPhase phase) {
+  if (phase < 0 || phase >= kScanPhaseCount)
+    return "?";
+  return kPhaseNames[phase];
+}
+
+void ScanStats::Reset() {
+  for (auto &time : fPhaseTime)
+    time = 0;
+  fFiles = 0;
+  fBytes = 0;
+  fStart = system_time();
+
+  BAutolock lock(&fLock);
+  fSlowFiles.clear();
+  fDirectoryTime.clear();
+}
+
+void ScanStats::AddDirectory(const BString &path, bigtime_t time) {
+  BAutolock lock(&fLock);
+  _AddToDirectory(path, time);
+}
+
+void ScanStats::AddFile(const BString &path, const BString &directory,
+                        off_t size, bigtime_t time) {
+  fFiles.fetch_add(1, std::memory_order_relaxed);
+  fBytes.fetch_add(size, std::memory_order_relaxed);
+
+  BAutolock lock(&fLock);
+  _AddToDirectory(directory, time);
+  if (fSlowFiles.size() < kSlowestCount) {
+    fSlowFiles.push_back(Sample{path, time, size});
+    std::push_heap(fSlowFiles.begin(), fSlowFiles.end(), _Slower);
+  } else if (time > fSlowFiles.front().time) {
+    std::pop_heap(fSlowFiles.begin(), fSlowFiles.end(), _Slower);
+    fSlowFiles.back() = Sample{path, time, size};
+    std::push_heap(fSlowFiles.begin(), fSlowFiles.end(), _Slower);
+  }
+}
+
+/** @brief Heap order of fSlowFiles: the fastest sample at the front. */
+bool ScanStats::_Slower(const Sample &a, const Sample &b) {
+  return a.time > b.time;
+}
+
+void ScanStats::_AddToDirectory(const BString &directory, bigtime_t time) {
+  fDirectoryTime[directory] += time;
+}
+
+float ScanStats::FilesPerSecond() const {
+  bigtime_t elapsed = std::max(system_time() - fStart, (bigtime_t)1);
+  return FilesRead() * 1000000.0f / elapsed;
+}
+
+float ScanStats::MegabytesPerSecond() const {
+  // Bytes per microsecond are megabytes per second.
+  bigtime_t elapsed = std::max(system_time() - fStart, (bigtime_t)1);
+  return (float)BytesRead() / elapsed;
+}
+
+void ScanStats::Archive(BMessage *into) const {
+  for (int32 i = 0; i < kScanPhaseCount; i++) {
+    into->AddString("phase", Name((ScanPhase)i));
+    into->AddInt64("phase_us", fPhaseTime[i].load(std::memory_order_relaxed));
+  }
+  into->AddInt64("elapsed_us", system_time() - fStart);
+  into->AddInt64("read_files", FilesRead());
+  into->AddInt64("read_bytes", BytesRead());
+
+  BAutolock lock(&fLock);
+  std::vector<Sample> files(fSlowFiles);
+  std::sort(files.begin(), files.end(), _Slower);
+  for (const Sample &file : files) {
+    into->AddString("slow_file", file.path);
+    into->AddInt64("slow_file_us", file.time);
+    into->AddInt64("slow_file_size", file.size);
+  }
+
+  std::vector<std::pair<BString, bigtime_t>> dirs(fDirectoryTime.begin(),
+                                                  fDirectoryTime.end());
+  size_t count = std::min(dirs.size(), kSlowestCount);
+  std::partial_sort(dirs.begin(), dirs.begin() + count, dirs.end(),
+                    [](const std::pair<BString, bigtime_t> &a,
+                       const std::pair<BString, bigtime_t> &b) {
+                      return a.second > b.second;
+                    });
+  for (size_t i = 0; i < count; i++) {
+    into->AddString("slow_dir", dirs[i].first);
+    into->AddInt64("slow_dir_us", dirs[i].second);
+  }
+}
+
+BString ScanStats::Report(const BMessage &archive) {
+  int64 elapsed = std::max(archive.GetInt64("elapsed_us", 0), (int64)1);
+  int64 files = archive.GetInt64("read_files", 0);
+  int64 bytes = archive.GetInt64("read_bytes", 0);
+
+  BString report, line;
+  report.SetToFormat("%lld files, %.1f MB read in %.1f s (%.1f files/s, "
+                     "%.1f MB/s)\n\n",
+                     (long long)files, bytes / 1e6, elapsed / 1e6,
+                     files * 1e6 / elapsed, (double)bytes / elapsed);
+
+  line.SetToFormat("%-14s %10s\n", "Phase", "Total ms");
+  report << line;
+  const char *name;
+  for (int32 i = 0; archive.FindString("phase", i, &name) == B_OK; i++) {
+    line.SetToFormat("%-14s %10.1f\n", name,
+                     archive.GetInt64("phase_us", i, 0) / 1000.0);
+    report << line;
+  }
+
+  line.SetToFormat("\n%10s %10s  %s\n", "ms", "KiB", "Slowest files");
+  report << line;
+  for (int32 i = 0; archive.FindString("slow_file", i, &name) == B_OK; i++) {
+    line.SetToFormat("%10.1f %10lld  %s\n",
+                     archive.GetInt64("slow_file_us", i, 0) / 1000.0,
+                     (long long)(archive.GetInt64("slow_file_size", i, 0) /
+                                 1024),
+                     name);
+    report << line;
+  }
+
+  line.SetToFormat("\n%10s  %s\n", "ms", "Slowest directories");
+  report << line;
+  for (int32 i = 0; archive.FindString("slow_dir", i, &name) == B_OK; i++) {
+    line.SetToFormat("%10.1f  %s\n",
+                     archive.GetInt64("slow_dir_us", i, 0) / 1000.0, name);
+    report << line;
+  }
+  return report;
+}
@@ -0,0 +1,99 @@
+#ifndef BETON_SCAN_STATS_H
+#define BETON_SCAN_STATS_H
+
+#include <Locker.h>
+#include <OS.h>
+#include <String.h>
+#include <SupportDefs.h>
+#include <atomic>
+#include <map>
+#include <vector>
+
+class BMessage;
+
+/** @brief Parts of a scan whose time ScanStats adds up. */
+enum ScanPhase {
+  kScanPhaseEnumerate = 0, ///< Reading directories and the query
+  kScanPhaseStat,          ///< stat() of the entries found
+  kScanPhaseParse,         ///< TagLib, summed over the tag readers
+  kScanPhaseAttributes,    ///< BFS attributes, summed over the tag readers
+  kScanPhaseTransport,     ///< Packing and sending MSG_MEDIA_BATCH
+  kScanPhaseCount
+};
+
+/**
+ * @class ScanStats
+ * @brief Telemetry of one scanner run: time per phase, files and bytes read
+ * and the slowest files and directories.
+ *
+ * The phase times are atomics; the slowest lists take a lock once per file
+ * read, which is small next to opening and parsing the file.
+ *
+ * The result travels as a message (`Archive()`) in the scanner's
+ * MSG_SCAN_DONE, and `Report()` turns that into text for the log.
+ */
+class ScanStats {
+public:
+  ScanStats();
+
+  /** @brief Clears everything and starts the clock. */
+  void Reset();
+
+  void AddPhase(ScanPhase phase, bigtime_t time) {
+    fPhaseTime[phase].fetch_add(time, std::memory_order_relaxed);
+  }
+
+  /** @brief Adds a directory's own enumeration and stat time. */
+  void AddDirectory(const BString &path, bigtime_t time);
+
+  /**
+   * @brief Adds the tag read of one file; its time also counts for
+   * `directory`. Called by the tag readers.
+   */
+  void AddFile(const BString &path, const BString &directory, off_t size,
+               bigtime_t time);
+
+  int64 FilesRead() const { return fFiles.load(std::memory_order_relaxed); }
+  int64 BytesRead() const { return fBytes.load(std::memory_order_relaxed); }
+
+  /** @brief Files read per second since Reset(). */
+  float FilesPerSecond() const;
+  /** @brief Megabytes (10^6 bytes) read per second since Reset(). */
+  float MegabytesPerSecond() const;
+
+  /**
+   * @brief Adds the phases ("phase", "phase_us"), totals and the slowest
+   * files ("slow_file", "slow_file_us", "slow_file_size") and directories
+   * ("slow_dir", "slow_dir_us"), slowest first.
+   */
+  void Archive(BMessage *into) const;
+
+  /** @brief Plain text report of an archive. */
+  static BString Report(const BMessage &archive);
+
+  /** @brief Entries in each slowest list. */
+  static const size_t kSlowestCount = 50;
+
+  static const char *Name(ScanPhase phase);
+
+private:
+  struct Sample {
+    BString path;
+    bigtime_t time;
+    off_t size;
+  };
+
+  static bool _Slower(const Sample &a, const Sample &b);
+  void _AddToDirectory(const BString &directory, bigtime_t time);
+
+  std::atomic<int64> fPhaseTime[kScanPhaseCount];
+  std::atomic<int64> fFiles;
+  std::atomic<int64> fBytes;
+  bigtime_t fStart;
+
+  mutable BLocker fLock;
+  std::vector<Sample> fSlowFiles; ///< Min-heap by time; guarded by fLock
+  std::map<BString, bigtime_t> fDirectoryTime; ///< Guarded by fLock
+};
+
+#endif // BETON_SCAN_STATS_H
@@ -0,0 +1,119 @@
+#include "StringPool.h"
+#include "MediaEntryStore.h"
+
+#include <Autolock.h>
+
+#include <string.h>
+
+StringPool &StringPool::Default() {
+  static StringPool sPool;
+  return sPool;
+}
+
+StringPool::StringPool()
+    : fLock("StringPool"), fCount(0), fStringBytes(0),
+      fMemory(kMemoryStrings) {
+  fSlots.resize(1024);
+  fHashes.resize(1024);
+  _Added(-1);
+}
+
+/**
+ * @brief Returns the slot holding `value` or the empty slot ending its probe.
+ */
+size_t StringPool::_Probe(const char *value, int32 length,
+                          uint32 hash) const {
+  const size_t mask = fSlots.size() - 1;
+  size_t i = hash & mask;
+  while (!fSlots[i].IsEmpty()) {
+    if (fHashes[i] == hash && fSlots[i].Length() == length &&
+        memcmp(fSlots[i].String(), value, length) == 0)
+      return i;
+    i = (i + 1) & mask;
+  }
+  return i;
+}
+
+void StringPool::_Grow() {
+  std::vector<BString> oldSlots(fSlots.size() * 2);
+  std::vector<uint32> oldHashes(fHashes.size() * 2);
+  oldSlots.swap(fSlots);
+  oldHashes.swap(fHashes);
+
+  const size_t mask = fSlots.size() - 1;
+  for (size_t j = 0; j < oldSlots.size(); j++) {
+    if (oldSlots[j].IsEmpty())
+      continue;
+    size_t i = oldHashes[j] & mask;
+    while (!fSlots[i].IsEmpty())
+      i = (i + 1) & mask;
+    fSlots[i] = oldSlots[j];
+    fHashes[i] = oldHashes[j];
+  }
+}
+
+/**
+ * @brief Accounts a string of `length` added to the pool (-1: none, only
+ * the tables changed).
+ */
+void StringPool::_Added(int32 length) {
+  // BString keeps its length and reference count in front of the text.
+  if (length >= 0)
+    fStringBytes += length + 1 + 2 * sizeof(int32);
+  fMemory.Set(MemoryStats::BytesOf(fSlots) + MemoryStats::BytesOf(fHashes) +
+              fStringBytes);
+}
+
+BString StringPool::Intern(const BString &value) {
+  if (value.IsEmpty())
+    return value;
+
+  const uint32 hash = HashMediaPath(value.String(), value.Length());
+  BAutolock lock(fLock);
+  size_t i = _Probe(value.String(), value.Length(), hash);
+  if (fSlots[i].IsEmpty()) {
+    if ((fCount + 1) * 2 > fSlots.size()) {
+      _Grow();
+      i = _Probe(value.String(), value.Length(), hash);
+    }
+    fSlots[i] = value;
+    fHashes[i] = hash;
+    fCount++;
+    _Added(value.Length());
+  }
+  return fSlots[i];
+}
+
+BString StringPool::Intern(const char *value, int32 length) {
+  if (value == nullptr || length <= 0)
+    return BString();
+
+  const uint32 hash = HashMediaPath(value, length);
+  BAutolock lock(fLock);
+  size_t i = _Probe(value, length, hash);
+  if (fSlots[i].IsEmpty()) {
+    if ((fCount + 1) * 2 > fSlots.size()) {
+      _Grow();
+      i = _Probe(value, length, hash);
+    }
+    fSlots[i].SetTo(value, length);
+    fHashes[i] = hash;
+    fCount++;
+    _Added(length);
+  }
+  return fSlots[i];
+}
+
+void StringPool::InternItem(MediaItem &item) {
+  item.artist = Intern(item.artist);
+  item.album = Intern(item.album);
+  item.albumArtist = Intern(item.albumArtist);
+  item.genre = Intern(item.genre);
+  item.composer = Intern(item.composer);
+  item.base = Intern(item.base);
+}
+
+size_t StringPool::CountStrings() {
+  BAutolock lock(fLock);
+  return fCount;
+}
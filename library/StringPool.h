@@ -0,0 +1,67 @@
+#ifndef BETON_STRING_POOL_H
+#define BETON_STRING_POOL_H
+
+#include "MediaItem.h"
+#include "MemoryStats.h"
+
+#include <Locker.h>
+#include <String.h>
+#include <SupportDefs.h>
+#include <vector>
+
+/**
+ * @class StringPool
+ * @brief Process-wide table of interned strings.
+ *
+ * `BString` buffers are reference counted, so handing out copies of one
+ * canonical instance makes all equal values share a single allocation. Two
+ * interned strings are equal exactly when their buffers are identical, which
+ * lets hot comparisons (filters, grouping) check a pointer first.
+ *
+ * All methods are thread-safe.
+ */
+class StringPool {
+public:
+  /** @brief Returns the shared pool used for library metadata. */
+  static StringPool &Default();
+
+  /**
+   * @brief Returns the canonical copy of `value`.
+   */
+  BString Intern(const BString &value);
+  BString Intern(const char *value, int32 length);
+
+  /**
+   * @brief Interns the highly repetitive fields of a media item
+   * (artist, album, albumArtist, genre, composer, base).
+   */
+  void InternItem(MediaItem &item);
+
+  /** @brief Number of distinct strings in the pool. */
+  size_t CountStrings();
+
+  /**
+   * @brief Equality with a pointer fast path for interned strings.
+   */
+  static inline bool Equals(const BString &a, const BString &b) {
+    if (a.String() == b.String())
+      return true;
+    return a.Length() == b.Length() && a == b;
+  }
+
+private:
+  StringPool();
+
+  size_t _Probe(const char *value, int32 length, uint32 hash) const;
+  void _Grow();
+  void _Added(int32 length);
+
+  BLocker fLock;
+  std::vector<BString> fSlots;
+  std::vector<uint32> fHashes;
+  size_t fCount;
+  size_t fStringBytes; ///< Buffers of the pooled strings
+  MemoryAccount fMemory;
+};
+
+#endif // BETON_STRING_POOL_H
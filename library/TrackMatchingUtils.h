@@ -10,6 +10,8 @@
 #include <SupportDefs.h>
 #include <algorithm>
 #include <ctype.h>
+#include <stdint.h>
+#include <string.h>
 #include <vector>
 
 /**
@@ -17,9 +19,10 @@
  * @brief Static helper class for string similarity and metadata extraction.
  *
  * Provides utility functions for:
- * - Levenshtein distance calculation.
- * - String similarity scoring.
+ * - Levenshtein distance calculation, bit-parallel for short strings.
+ * - String similarity scoring, on raw or prepared (MatchText) strings.
  * - Extracting track numbers from filenames.
+ * - Normalizing tag text for exact-match keys.
  */
 class TrackMatchingUtils {
 public:
@@ -35,23 +38,34 @@ public:
    * @return The edit distance.
    */
   static int LevenshteinDistance(const char *s1, const char *s2) {
+    return BoundedDistance(s1, s2, INT32_MAX - 1);
+  }
+
+  /**
+   * @brief Levenshtein distance, giving up once it exceeds `maxDistance`.
+   *
+   * When the shorter string has at most 64 characters this is Myers'
+   * bit-parallel algorithm (in Hyyrö's form), one pass over the longer
+   * string without allocating. Longer strings use two rows of the classic
+   * matrix. Both stop as soon as the distance can no longer stay within
+   * `maxDistance`. Case-insensitive.
+   *
+   * @return The distance, or `maxDistance + 1` if it is larger.
+   */
+  static int BoundedDistance(const char *s1, const char *s2, int maxDistance) {
     int len1 = strlen(s1);
     int len2 = strlen(s2);
-    std::vector<std::vector<int>> d(len1 + 1, std::vector<int>(len2 + 1));
-
-    for (int i = 0; i <= len1; i++)
-      d[i][0] = i;
-    for (int j = 0; j <= len2; j++)
-      d[0][j] = j;
-
-    for (int i = 1; i <= len1; i++) {
-      for (int j = 1; j <= len2; j++) {
-        int cost = (tolower(s1[i - 1]) == tolower(s2[j - 1])) ? 0 : 1;
-        d[i][j] = std::min(
-            {d[i - 1][j] + 1, d[i][j - 1] + 1, d[i - 1][j - 1] + cost});
-      }
+    if (len1 > len2) {
+      std::swap(s1, s2);
+      std::swap(len1, len2);
     }
-    return d[len1][len2];
+    if (len2 - len1 > maxDistance)
+      return maxDistance + 1;
+    if (len1 == 0)
+      return len2;
+    if (len1 <= 64)
+      return _MyersDistance(s1, len1, s2, len2, maxDistance);
+    return _TwoRowDistance(s1, len1, s2, len2, maxDistance);
   }
 
   /**
@@ -86,18 +100,182 @@ public:
   /**
    * @brief Calculates a normalized similarity score between two strings.
    *
-   * Based on Levenshtein distance.
+   * Based on Levenshtein distance. Below `minSimilarity` the distance is
+   * not worked out in full and 0 is returned.
    *
    * @param s1 First string.
    * @param s2 Second string.
+   * @param minSimilarity Lowest score the caller has a use for.
    * @return Float between 0.0 (no match) and 1.0 (perfect match).
    */
-  static float Similarity(const char *s1, const char *s2) {
+  static float Similarity(const char *s1, const char *s2,
+                          float minSimilarity = 0.0f) {
     int maxLen = std::max(strlen(s1), strlen(s2));
     if (maxLen == 0)
       return 1.0f;
-    int dist = LevenshteinDistance(s1, s2);
-    return 1.0f - (float)dist / maxLen;
+    int maxDistance = std::max(0, (int)((1.0f - minSimilarity) * maxLen));
+    int dist = BoundedDistance(s1, s2, maxDistance);
+    if (dist > maxDistance)
+      return 0.0f;
+    float similarity = 1.0f - (float)dist / maxLen;
+    return similarity >= minSimilarity ? similarity : 0.0f;
+  }
+
+  /**
+   * @brief Reduces tag text to a comparison key.
+   *
+   * ASCII letters are lowercased, every run of punctuation and whitespace
+   * becomes a single space and a leading "the " is dropped, so
+   * "The Beatles" and "beatles" or "Don't Stop" and "Dont  Stop" collide.
+   * Non-ASCII bytes are kept as they are; fold accents beforehand if needed.
+   *
+   * @param text The text to normalize.
+   * @return The key, empty if `text` has no letters or digits.
+   */
+  static BString NormalizeKey(const char *text) {
+    BString key;
+    bool pendingSpace = false;
+    for (const char *p = text; *p != '\0'; p++) {
+      unsigned char c = (unsigned char)*p;
+      if (c == '\'')
+        continue;
+      if (c >= 0x80 || isalnum(c)) {
+        if (pendingSpace && !key.IsEmpty())
+          key += ' ';
+        pendingSpace = false;
+        key += (char)tolower(c);
+      } else {
+        pendingSpace = true;
+      }
+    }
+    if (key.StartsWith("the ") && key.Length() > 4)
+      key.Remove(0, 4);
+    return key;
+  }
+
+  /**
+   * @brief Text prepared once for matching against many candidates.
+   */
+  struct MatchText {
+    BString key;                 ///< NormalizeKey() of the text
+    std::vector<BString> tokens; ///< Words of `key`, sorted
+  };
+
+  /** @brief Normalizes and tokenizes `text` for Similarity(). */
+  static MatchText PrepareText(const char *text) {
+    MatchText prepared;
+    prepared.key = NormalizeKey(text);
+    int32 start = 0;
+    while (start < prepared.key.Length()) {
+      int32 end = prepared.key.FindFirst(' ', start);
+      if (end < 0)
+        end = prepared.key.Length();
+      BString token;
+      prepared.key.CopyInto(token, start, end - start);
+      prepared.tokens.push_back(token);
+      start = end + 1;
+    }
+    std::sort(prepared.tokens.begin(), prepared.tokens.end());
+    return prepared;
+  }
+
+  /**
+   * @brief Share of words two prepared texts have in common (Dice
+   * coefficient), whatever their order.
+   */
+  static float TokenSimilarity(const MatchText &a, const MatchText &b) {
+    size_t total = a.tokens.size() + b.tokens.size();
+    if (total == 0)
+      return 1.0f;
+    size_t common = 0;
+    auto i = a.tokens.begin();
+    auto j = b.tokens.begin();
+    while (i != a.tokens.end() && j != b.tokens.end()) {
+      if (*i < *j)
+        ++i;
+      else if (*j < *i)
+        ++j;
+      else {
+        common++;
+        ++i;
+        ++j;
+      }
+    }
+    return 2.0f * common / total;
+  }
+
+  /**
+   * @brief Similarity of two prepared texts: the better of their word
+   * overlap and the edit similarity of their normalized keys, so
+   * "Symphony No. 5 - Beethoven" and "Beethoven: Symphony No. 5" match.
+   */
+  static float Similarity(const MatchText &a, const MatchText &b,
+                          float minSimilarity = 0.0f) {
+    float tokens = TokenSimilarity(a, b);
+    if (tokens >= 1.0f)
+      return tokens;
+    // The edit distance only matters where it could beat the word overlap.
+    float edit = Similarity(a.key.String(), b.key.String(),
+                            std::max(minSimilarity, tokens));
+    float similarity = std::max(tokens, edit);
+    return similarity >= minSimilarity ? similarity : 0.0f;
+  }
+
+private:
+  static int _MyersDistance(const char *pattern, int m, const char *text,
+                            int n, int maxDistance) {
+    uint64 peq[256] = {};
+    for (int i = 0; i < m; i++)
+      peq[(unsigned char)tolower((unsigned char)pattern[i])] |= 1ULL << i;
+
+    const uint64 last = 1ULL << (m - 1);
+    uint64 pv = ~0ULL;
+    uint64 mv = 0;
+    int score = m;
+    for (int j = 0; j < n; j++) {
+      uint64 eq = peq[(unsigned char)tolower((unsigned char)text[j])];
+      uint64 xv = eq | mv;
+      uint64 xh = (((eq & pv) + pv) ^ pv) | eq;
+      uint64 ph = mv | ~(xh | pv);
+      uint64 mh = pv & xh;
+      if (ph & last)
+        score++;
+      else if (mh & last)
+        score--;
+      // Each remaining character lowers the score by at most one.
+      if (score - (n - j - 1) > maxDistance)
+        return maxDistance + 1;
+      ph = (ph << 1) | 1;
+      mh <<= 1;
+      pv = mh | ~(xv | ph);
+      mv = ph & xv;
+    }
+    return score;
+  }
+
+  static int _TwoRowDistance(const char *s1, int len1, const char *s2,
+                             int len2, int maxDistance) {
+    std::vector<int> row(len1 + 1);
+    for (int i = 0; i <= len1; i++)
+      row[i] = i;
+    for (int j = 1; j <= len2; j++) {
+      int diagonal = row[0];
+      row[0] = j;
+      int rowMin = row[0];
+      for (int i = 1; i <= len1; i++) {
+        int above = row[i];
+        int cost = (tolower((unsigned char)s1[i - 1]) ==
+                    tolower((unsigned char)s2[j - 1]))
+                       ? 0
+                       : 1;
+        row[i] = std::min({above + 1, row[i - 1] + 1, diagonal + cost});
+        diagonal = above;
+        rowMin = std::min(rowMin, row[i]);
+      }
+      if (rowMin > maxDistance)
+        return maxDistance + 1;
+    }
+    return std::min(row[len1], maxDistance + 1);
   }
 };
 
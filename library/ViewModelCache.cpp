@@ -0,0 +1,99 @@
+#include "ViewModelCache.h"
+
+#include <iterator>
+
+/** @brief Memory the cached views may use together. */
+static const size_t kViewCacheBudget = 64 * 1024 * 1024;
+
+/** @brief Views kept at most, however small. */
+static const size_t kMaxViews = 8;
+
+bool ViewSource::operator==(const ViewSource &other) const {
+  return stamp == other.stamp && library == other.library &&
+         filterText == other.filterText && genre == other.genre &&
+         artist == other.artist && album == other.album &&
+         radioFilterMode == other.radioFilterMode &&
+         playlistSort == other.playlistSort;
+}
+
+size_t CachedView::MemoryBytes() const {
+  size_t rows = 0;
+  if (genres.Get() != nullptr)
+    rows += genres->Count();
+  if (artists.Get() != nullptr)
+    rows += artists->Count();
+  if (albums.Get() != nullptr)
+    rows += albums->Count();
+  return sizeof(CachedView) + MemoryStats::BytesOf(items) +
+         MemoryStats::BytesOf(selectedPaths) + rows * 2 * sizeof(BString);
+}
+
+ViewModelCache::ViewModelCache() : fBytes(0), fMemory(kMemoryViewCache) {}
+
+void ViewModelCache::Put(const BString &context, CachedView &&view) {
+  Remove(context);
+  if (view.source.stamp == 0)
+    return;
+
+  size_t bytes = view.MemoryBytes();
+  fSlots.push_front(Slot{context, std::move(view), bytes});
+  fBytes += bytes;
+  _Evict();
+  fMemory.Set(fBytes);
+}
+
+const CachedView *ViewModelCache::Find(const BString &context, uint64 stamp) {
+  for (auto it = fSlots.begin(); it != fSlots.end(); ++it) {
+    if (it->context != context)
+      continue;
+    if (it->view.source.stamp != stamp) {
+      _Erase(it);
+      fMemory.Set(fBytes);
+      return nullptr;
+    }
+    fSlots.splice(fSlots.begin(), fSlots, it);
+    return &fSlots.front().view;
+  }
+  return nullptr;
+}
+
+void ViewModelCache::Remove(const BString &context) {
+  for (auto it = fSlots.begin(); it != fSlots.end(); ++it) {
+    if (it->context == context) {
+      _Erase(it);
+      fMemory.Set(fBytes);
+      return;
+    }
+  }
+}
+
+void ViewModelCache::RemoveLibraryViews() {
+  for (auto it = fSlots.begin(); it != fSlots.end();) {
+    auto next = std::next(it);
+    if (it->view.source.library)
+      _Erase(it);
+    it = next;
+  }
+  fMemory.Set(fBytes);
+}
+
+void ViewModelCache::Clear() {
+  fSlots.clear();
+  fBytes = 0;
+  fMemory.Set(0);
+}
+
+void ViewModelCache::_Erase(std::list<Slot>::iterator it) {
+  fBytes -= it->bytes;
+  fSlots.erase(it);
+}
+
+/**
+ * @brief Drops the least recently used views while over the budget. A view
+ * larger than the whole budget is not kept either.
+ */
+void ViewModelCache::_Evict() {
+  while (!fSlots.empty() &&
+         (fBytes > kViewCacheBudget || fSlots.size() > kMaxViews))
+    _Erase(std::prev(fSlots.end()));
+}
@@ -0,0 +1,100 @@
+#ifndef BETON_VIEW_MODEL_CACHE_H
+#define BETON_VIEW_MODEL_CACHE_H
+
+#include "LibraryColumns.h"
+#include "MediaItem.h"
+#include "MemoryStats.h"
+#include "SingleColumnListModel.h"
+
+#include <Message.h>
+#include <Referenceable.h>
+#include <String.h>
+#include <SupportDefs.h>
+#include <list>
+#include <vector>
+
+/**
+ * @struct ViewSource
+ * @brief What a column browser view was built from. A cached view may only
+ * be shown again if all of it still holds.
+ */
+struct ViewSource {
+  uint64 stamp = 0;     ///< Identifies the items behind the view, 0 = none
+  bool library = false; ///< Built from library items
+  BString filterText;
+  BString genre, artist, album; ///< Selections the content was filtered by
+  bool radioFilterMode = false;
+  bool playlistSort = false;
+
+  bool operator==(const ViewSource &other) const;
+};
+
+/**
+ * @struct CachedView
+ * @brief A built column browser view: the content list in order, the facet
+ * lists and where the user was in them.
+ */
+struct CachedView {
+  ViewSource source;
+  BMessage sortState;           ///< Order of `items`
+  std::vector<MediaItem> items; ///< Content rows, in that order
+  LibraryTotals totals;
+  BReference<SingleColumnListModel> genres, artists, albums;
+  BString albumData; ///< Data of the selected album row
+  BString topPath;   ///< Row at the top of the list
+  std::vector<BString> selectedPaths;
+
+  /** @brief Heap bytes of the view, shallow like the other accounts. */
+  size_t MemoryBytes() const;
+};
+
+/**
+ * @class ViewModelCache
+ * @brief Most recently left views of the column browser, one per context
+ * (library, a playlist, radio, DLNA).
+ *
+ * Switching back to a context shows its cached view instead of filtering,
+ * sorting and building the facet lists again. The facet models are shared
+ * with the list views; a view that edits one works on its own copy.
+ *
+ * The least recently used views are dropped beyond the memory budget. The
+ * cache belongs to the window thread and is not locked.
+ */
+class ViewModelCache {
+public:
+  ViewModelCache();
+
+  /** @brief Stores `view` as the view of `context`, replacing the old one. */
+  void Put(const BString &context, CachedView &&view);
+
+  /**
+   * @brief The view of `context` if it was built from items with `stamp`.
+   * A view of older items is dropped.
+   */
+  const CachedView *Find(const BString &context, uint64 stamp);
+
+  void Remove(const BString &context);
+
+  /** @brief Drops the views built from library items. */
+  void RemoveLibraryViews();
+
+  void Clear();
+
+  size_t MemoryBytes() const { return fBytes; }
+
+private:
+  struct Slot {
+    BString context;
+    CachedView view;
+    size_t bytes;
+  };
+
+  void _Erase(std::list<Slot>::iterator it);
+  void _Evict();
+
+  std::list<Slot> fSlots; ///< Most recently used first
+  size_t fBytes;
+  MemoryAccount fMemory;
+};
+
+#endif // BETON_VIEW_MODEL_CACHE_H
@@ -34,6 +34,10 @@ bool MetadataMessageHandler::HandleMessage(BMessage *msg) {
 
   switch (msg->what) {
   case MSG_COVER_APPLY_ALBUM: {
+    if (msg->HasString("cover_mbid") && fMusicBrainzLookupController) {
+      fMusicBrainzLookupController->FetchFullCover(msg);
+      break;
+    }
     if (fWindow->fArtworkController)
       fWindow->fArtworkController->ApplyAlbumCover(msg);
     break;
@@ -46,6 +50,10 @@ bool MetadataMessageHandler::HandleMessage(BMessage *msg) {
   }
 
   case MSG_COVER_DROPPED_APPLY_ALL: {
+    if (msg->HasString("cover_mbid") && fMusicBrainzLookupController) {
+      fMusicBrainzLookupController->FetchFullCover(msg);
+      break;
+    }
     if (fWindow->fArtworkController)
       fWindow->fArtworkController->ApplyDroppedCoverToAll(msg);
     break;
@@ -79,6 +87,7 @@ bool MetadataMessageHandler::HandleMessage(BMessage *msg) {
   case MSG_MB_SEARCH_COMPLETE:
   case MSG_MB_APPLY:
   case MSG_MB_APPLY_ALBUM:
+  case MSG_MB_MATCH_ALBUMS:
   case MSG_COVER_FETCH_MB: {
     return fMusicBrainzLookupController &&
            fMusicBrainzLookupController->HandleMessage(msg);
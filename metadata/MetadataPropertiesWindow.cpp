@@ -1,8 +1,11 @@
 #include "MetadataPropertiesWindow.h"
 #include "ArtworkView.h"
 #include "Debug.h"
+#include "EmbeddedCoverCache.h"
 #include "Messages.h"
 #include "MetadataTagIO.h"
+#include "MusicBrainzApiClient.h"
+#include "PropertiesTagLoader.h"
 
 #include <Bitmap.h>
 #include <Button.h>
@@ -289,6 +292,19 @@ private:
   MetadataPropertiesWindow *fOwner;
 };
 
+/** @brief Tells the window when the user switches tabs. */
+class PropertiesTabView final : public BTabView {
+public:
+  explicit PropertiesTabView(const char *name)
+      : BTabView(name, B_WIDTH_FROM_LABEL) {}
+
+  void Select(int32 index) override {
+    BTabView::Select(index);
+    if (Window())
+      Window()->PostMessage(MSG_PROP_TAB_SELECTED);
+  }
+};
+
 class MusicBrainzResultRow final : public BRow {
 public:
   explicit MusicBrainzResultRow(int32 cacheIndex)
@@ -473,6 +489,8 @@ MetadataPropertiesWindow::~MetadataPropertiesWindow() {
     BMessage closed(MSG_PROP_CLOSED);
     fTarget.SendMessage(&closed);
   }
+  delete fTagLoader;
+  fTagLoader = nullptr;
   delete fOpenPanel;
   fOpenPanel = nullptr;
 }
@@ -482,68 +500,13 @@ bool MetadataPropertiesWindow::QuitRequested() {
   return BWindow::QuitRequested();
 }
 
-/**
- * @brief Determines the state of a string field across multiple files.
- * @param vals Vector of string values for the field from all selected files.
- * @param outCommon Output parameter to store the common value if all are same.
- * @return FieldState: AllSame, AllEmpty, or Mixed.
- */
-MetadataPropertiesWindow::FieldState
-MetadataPropertiesWindow::_StateForStrings(const std::vector<BString> &vals,
-                                   BString &outCommon) {
-  if (vals.empty()) {
-    outCommon.Truncate(0);
-    return FieldState::AllEmpty;
-  }
-  const BString &first = vals.front();
-  bool allSame = true;
-  for (size_t i = 1; i < vals.size(); ++i) {
-    if (vals[i] != first)
-      allSame = false;
-  }
-  if (allSame) {
-    outCommon = first;
-    return first.IsEmpty() ? FieldState::AllEmpty : FieldState::AllSame;
-  }
-  return FieldState::Mixed;
-}
-
-/**
- * @brief Determines the state of an integer field across multiple files.
- * @param vals Vector of integer values for the field from all selected files.
- * @param outCommon Output parameter to store the common value if all are same.
- * @return FieldState: AllSame, AllEmpty, or Mixed.
- */
-MetadataPropertiesWindow::FieldState
-MetadataPropertiesWindow::_StateForInts(const std::vector<uint32> &vals,
-                                uint32 &outCommon) {
-  if (vals.empty()) {
-    outCommon = 0;
-    return FieldState::AllEmpty;
-  }
-  uint32 first = vals.front();
-  bool allSame = true;
-  bool anyNonZero = (first != 0);
-  for (size_t i = 1; i < vals.size(); ++i) {
-    if (vals[i] != first)
-      allSame = false;
-    if (vals[i] != 0)
-      anyNonZero = true;
-  }
-  if (allSame) {
-    outCommon = first;
-    return anyNonZero ? FieldState::AllSame : FieldState::AllEmpty;
-  }
-  return FieldState::Mixed;
-}
-
 /**
  * @brief Constructs the main UI layout, including tabs and buttons.
  */
 void MetadataPropertiesWindow::_BuildUI() {
   SetLayout(new BGroupLayout(B_VERTICAL));
 
-  fTabs = new BTabView("propsTabs", B_WIDTH_FROM_LABEL);
+  fTabs = new PropertiesTabView("propsTabs");
 
   auto *tagsPage = new BGroupView(B_VERTICAL, B_USE_DEFAULT_SPACING);
   auto *mbPage = new BGroupView(B_VERTICAL, B_USE_DEFAULT_SPACING);
@@ -826,6 +789,9 @@ void MetadataPropertiesWindow::_BuildTab_MB(BView *parent) {
   fMbApplyAlbum =
       new BButton("ApplyAlbum", B_TRANSLATE("Apply Selection (Album)"),
                   new BMessage(MSG_MB_APPLY_ALBUM));
+  fMbMatchAlbums =
+      new BButton("MatchAlbums", B_TRANSLATE("Match Albums"),
+                  new BMessage(MSG_MB_MATCH_ALBUMS));
 
   gl->SetInsets(B_USE_WINDOW_INSETS);
 
@@ -879,6 +845,7 @@ void MetadataPropertiesWindow::_BuildTab_MB(BView *parent) {
   bgl->AddView(fMbApplyTrack);
   bgl->AddView(fMbApplyAlbum);
   bgl->AddItem(BSpaceLayoutItem::CreateGlue());
+  bgl->AddView(fMbMatchAlbums);
   gl->AddView(brow);
 
   if (auto *pg = dynamic_cast<BGroupLayout *>(parent->GetLayout()))
@@ -909,6 +876,14 @@ void MetadataPropertiesWindow::MessageReceived(BMessage *msg) {
     Quit();
     break;
 
+  case MSG_PROP_TAGS_LOADED:
+    _HandleTagsLoaded(msg);
+    break;
+
+  case MSG_PROP_TAB_SELECTED:
+    _ShowPendingCover();
+    break;
+
   case MSG_SET_RATING: {
     int32 rating = 0;
     if (msg->FindInt32("rating", &rating) == B_OK)
@@ -962,6 +937,7 @@ void MetadataPropertiesWindow::MessageReceived(BMessage *msg) {
     fCoverDirty = false;
     fCurrentCoverMime.Truncate(0);
     fCurrentCoverBytes.clear();
+    fCoverMbid.Truncate(0);
     break;
   }
 
@@ -978,6 +954,7 @@ void MetadataPropertiesWindow::MessageReceived(BMessage *msg) {
 
     payload->AddData("bytes", B_RAW_TYPE, fCurrentCoverBytes.data(),
                      fCurrentCoverBytes.size());
+    _AddCoverSource(payload);
 
     _SendMessageToTarget(MSG_COVER_APPLY_ALBUM, payload);
     break;
@@ -1013,6 +990,12 @@ void MetadataPropertiesWindow::MessageReceived(BMessage *msg) {
     if (fCoverStatus)
       fCoverStatus->SetText(B_TRANSLATE("Fetching cover..."));
     auto *payload = new BMessage(MSG_COVER_FETCH_MB);
+    // Only ask for a thumbnail the size of the panel; applying the cover
+    // fetches the original.
+    payload->AddInt32("size",
+                      MusicBrainzApiClient::CoverSizeFor(
+                          fArtworkView ? fArtworkView->Bounds().Width() + 1
+                                       : 500));
     if (!fIsMulti)
       payload->AddString("file", fFilePath.Path());
     else
@@ -1037,6 +1020,8 @@ void MetadataPropertiesWindow::MessageReceived(BMessage *msg) {
         fCurrentCoverMime.Truncate(0);
       fCoverDirty = true;
       fCoverMixed = false;
+      fCoverMbid = msg->GetString("mbid", "");
+      fCoverIsReleaseGroup = msg->GetBool("release_group", false);
 
       BMemoryIO io(buf, (size_t)sz);
       if (BBitmap *bmp = BTranslationUtils::GetBitmap(&io)) {
@@ -1224,6 +1209,53 @@ void MetadataPropertiesWindow::MessageReceived(BMessage *msg) {
     break;
   }
 
+  case MSG_MB_MATCH_ALBUMS: {
+    if (!fIsMulti)
+      break;
+    if (fMbCancel)
+      fMbCancel->SetEnabled(true);
+    if (fMbStatusView)
+      fMbStatusView->SetText(B_TRANSLATE("Matching albums..."));
+
+    auto *payload = new BMessage(MSG_MB_MATCH_ALBUMS);
+    for (auto &p : fFiles)
+      payload->AddString("file", p.Path());
+    _SendMessageToTarget(MSG_MB_MATCH_ALBUMS, payload);
+    break;
+  }
+
+  case MSG_MB_ALBUMS_MATCHED: {
+    if (fMbCancel)
+      fMbCancel->SetEnabled(false);
+    BString status;
+    status.SetToFormat(B_TRANSLATE("Matched %ld of %ld albums."),
+                       (long)msg->GetInt32("matched", 0),
+                       (long)msg->GetInt32("albums", 0));
+    if (fMbStatusView)
+      fMbStatusView->SetText(status);
+    break;
+  }
+
+  case MSG_MEDIA_ITEMS_UPDATED: {
+    // Many files written at once: reloads once, from the first update of a
+    // file shown here.
+    BMessage item;
+    for (int32 i = 0; msg->FindMessage("item", i, &item) == B_OK; i++) {
+      BString path;
+      if (item.FindString("path", &path) != B_OK)
+        continue;
+      bool shown = !fIsMulti && path == fFilePath.Path();
+      for (size_t j = 0; fIsMulti && !shown && j < fFiles.size(); j++)
+        shown = path == fFiles[j].Path();
+      if (shown) {
+        item.what = MSG_MEDIA_ITEM_FOUND;
+        MessageReceived(&item);
+        break;
+      }
+    }
+    break;
+  }
+
   case MSG_MEDIA_ITEM_FOUND: {
 
     BString path;
@@ -1304,6 +1336,9 @@ void MetadataPropertiesWindow::MessageReceived(BMessage *msg) {
  * MSG_PROP_APPLY implies "Apply" without closing.
  */
 void MetadataPropertiesWindow::_SendApply(bool saveToDisk) {
+  if (fLoading)
+    return;
+
   auto *m = new BMessage(saveToDisk ? MSG_PROP_SAVE : MSG_PROP_APPLY);
 
   if (!fIsMulti)
@@ -1367,6 +1402,7 @@ void MetadataPropertiesWindow::_SendApply(bool saveToDisk) {
                    fCurrentCoverBytes.size());
     if (!fCurrentCoverMime.IsEmpty())
       cover->AddString("mime", fCurrentCoverMime.String());
+    _AddCoverSource(cover);
     if (!fIsMulti) {
       cover->AddString("file", fFilePath.Path());
     } else {
@@ -1493,7 +1529,7 @@ void MetadataPropertiesWindow::_UpdateReadOnlyState() {
     }
   }
 
-  bool canEdit = !isReadOnly && !fileMissing;
+  bool canEdit = !isReadOnly && !fileMissing && !fLoading;
 
   fEdTitle->SetEnabled(canEdit);
   fEdArtist->SetEnabled(canEdit);
@@ -1547,6 +1583,8 @@ void MetadataPropertiesWindow::_UpdateReadOnlyState() {
     fMbApplyTrack->SetEnabled(canEdit && hasMbResults && !fMbAlbumResults);
   if (fMbApplyAlbum)
     fMbApplyAlbum->SetEnabled(canEdit && hasMbResults);
+  if (fMbMatchAlbums)
+    fMbMatchAlbums->SetEnabled(canEdit && fIsMulti);
   fRatingReadOnly = !canEdit;
   if (fHdrRating)
     static_cast<RatingStringView *>(fHdrRating)->SetEditable(canEdit);
@@ -1682,6 +1720,7 @@ void MetadataPropertiesWindow::_HandleCoverChosen(const entry_ref &ref) {
   fCoverMixed = false;
   fCurrentCoverBytes.assign(buf.get(), buf.get() + rd);
   fCurrentCoverMime.Truncate(0);
+  fCoverMbid.Truncate(0);
   fCoverDirty = false;
 
   auto *out = new BMessage(MSG_COVER_DROPPED_APPLY_ALL);
@@ -1700,6 +1739,17 @@ void MetadataPropertiesWindow::_HandleCoverChosen(const entry_ref &ref) {
  * @param what The command constant for the message.
  * @param payload The message to send (takes ownership).
  */
+/**
+ * @brief Marks a cover apply request as carrying a MusicBrainz thumbnail, so
+ * the full-size image is embedded instead.
+ */
+void MetadataPropertiesWindow::_AddCoverSource(BMessage *payload) const {
+  if (fCoverMbid.IsEmpty())
+    return;
+  payload->AddString("cover_mbid", fCoverMbid);
+  payload->AddBool("cover_release_group", fCoverIsReleaseGroup);
+}
+
 void MetadataPropertiesWindow::_SendMessageToTarget(uint32 what, BMessage *payload) {
   if (!payload)
     payload = new BMessage(what);
@@ -1766,6 +1816,7 @@ bool MetadataPropertiesWindow::_FieldValueChanged(const char *name,
 void MetadataPropertiesWindow::_LoadInitialData() {
   fInitialFieldValues.clear();
   fCurrentCoverBytes.clear();
+  fCoverMbid.Truncate(0);
   fCurrentCoverMime.Truncate(0);
   fCoverDirty = false;
   if (fArtworkView)
@@ -1852,17 +1903,17 @@ void MetadataPropertiesWindow::_LoadInitialData() {
           td.year ? BString().SetToFormat("%lu", (unsigned long)td.year) : "");
   }
 
-  CoverBlob cover;
-  if (MetadataTagIO::ExtractEmbeddedCover(fFilePath, cover) && cover.data() &&
-      cover.size() > 0) {
-    BMemoryIO io(cover.data(), cover.size());
+  std::shared_ptr<const CoverBlob> cover =
+      EmbeddedCoverCache::Default().Get(fFilePath.Path());
+  if (cover) {
+    BMemoryIO io(cover->data(), cover->size());
     if (BBitmap *bmp = BTranslationUtils::GetBitmap(&io)) {
       if (fArtworkView)
         fArtworkView->SetBitmap(bmp);
       delete bmp;
 
-      fCurrentCoverBytes.assign((const uint8_t *)cover.data(),
-                                (const uint8_t *)cover.data() + cover.size());
+      fCurrentCoverBytes = cover->bytes;
+      fCoverMbid.Truncate(0);
     }
   } else if (fTarget.IsValid()) {
     auto *req = new BMessage(MSG_PROP_REQUEST_COVER);
@@ -1894,165 +1945,183 @@ void MetadataPropertiesWindow::_LoadInitialData() {
 }
 
 /**
- * @brief Loads aggregated metadata for multiple files, detecting mixed values.
+ * @brief Starts loading aggregated metadata for multiple files.
+ *
+ * Fields show a placeholder and stay disabled until the loader's last batch
+ * arrives; see _HandleTagsLoaded().
  */
 void MetadataPropertiesWindow::_LoadInitialDataMulti() {
   fInitialFieldValues.clear();
   fCurrentCoverBytes.clear();
+  fCoverMbid.Truncate(0);
   fCurrentCoverMime.Truncate(0);
+  fPendingCoverBytes.clear();
+  fCoverDecodePending = false;
   fCoverDirty = false;
+  fCoverMixed = false;
   if (fArtworkView)
     fArtworkView->SetBitmap(nullptr);
   if (fCoverStatus)
-    fCoverStatus->SetText("");
+    fCoverStatus->SetText(B_TRANSLATE("Reading tags..."));
+
+  fSummary = MultiSummary();
+  fLoadedCount = 0;
+  fLoading = true;
+
+  BTextControl *fields[] = {fEdTitle,     fEdArtist,      fEdAlbum,
+                            fEdAlbumArtist, fEdComposer,  fEdGenre,
+                            fEdComment,   fEdYear,        fEdTrack,
+                            fEdTrackTotal, fEdDisc,       fEdDiscTotal,
+                            fEdMBTrackID, fEdMBAlbumID};
+  for (BTextControl *field : fields) {
+    if (!field)
+      continue;
+    field->SetText("");
+    field->SetEnabled(false);
+  }
+
+  if (!fTagLoader)
+    fTagLoader = new PropertiesTagLoader(BMessenger(this));
+  if (fTagLoader->Start(fFiles, fPreloadedItems, ++fLoadGeneration) != B_OK) {
+    DEBUG_PRINT("_LoadInitialDataMulti: could not start the tag loader\n");
+    fLoading = false;
+    if (fCoverStatus)
+      fCoverStatus->SetText("");
+    _ApplySummary(true);
+  }
 
-  std::vector<BString> titles, artists, albums, albumArtists, composers, genres,
-      comments;
-  std::vector<uint32> years, tracks, trackTotals, discs, discTotals, ratings;
-
-  titles.reserve(fFiles.size());
-  artists.reserve(fFiles.size());
-  albums.reserve(fFiles.size());
-  albumArtists.reserve(fFiles.size());
-  composers.reserve(fFiles.size());
-  genres.reserve(fFiles.size());
-  comments.reserve(fFiles.size());
-  years.reserve(fFiles.size());
-  tracks.reserve(fFiles.size());
-  trackTotals.reserve(fFiles.size());
-  discs.reserve(fFiles.size());
-  discTotals.reserve(fFiles.size());
-  ratings.reserve(fFiles.size());
-  std::vector<BString> mbTrackIDs, mbAlbumIDs;
-  mbTrackIDs.reserve(fFiles.size());
-  mbAlbumIDs.reserve(fFiles.size());
+  _UpdateHeaderFromFields();
+}
 
-  fCoverMixed = false;
-  bool anyCover = false;
-  bool compareCovers = fFiles.size() <= 8;
-  CoverBlob firstCoverBlob;
+/**
+ * @brief Folds one loader batch into the summary and refreshes the fields.
+ * @param msg A MSG_PROP_TAGS_LOADED batch.
+ */
+void MetadataPropertiesWindow::_HandleTagsLoaded(const BMessage *msg) {
+  int32 generation = 0;
+  if (msg->FindInt32("generation", &generation) != B_OK ||
+      generation != fLoadGeneration || !fLoading)
+    return;
+
+  type_code type;
+  int32 count = 0;
+  if (msg->GetInfo("title", &type, &count) != B_OK)
+    count = 0;
 
-  for (size_t index = 0; index < fFiles.size(); ++index) {
-    const BPath &p = fFiles[index];
+  for (int32 i = 0; i < count; ++i) {
     TagData td;
-    if (index < fPreloadedItems.size() &&
-        fPreloadedItems[index].path == p.Path()) {
-      const MediaItem &mi = fPreloadedItems[index];
-      td.title = mi.title;
-      td.artist = mi.artist;
-      td.album = mi.album;
-      td.albumArtist = mi.albumArtist;
-      td.composer = mi.composer;
-      td.genre = mi.genre;
-      td.comment = mi.comment;
-      td.year = mi.year;
-      td.track = mi.track;
-      td.trackTotal = mi.trackTotal;
-      td.disc = mi.disc;
-      td.discTotal = mi.discTotal;
-      td.rating = mi.rating;
-      td.mbTrackID = mi.mbTrackId;
-      td.mbAlbumID = mi.mbAlbumId;
-    } else {
-      MetadataTagIO::ReadTags(p, td);
+    PropertiesTagLoader::FindTags(msg, i, td);
+    fSummary.title.Add(td.title);
+    fSummary.artist.Add(td.artist);
+    fSummary.album.Add(td.album);
+    fSummary.albumArtist.Add(td.albumArtist);
+    fSummary.composer.Add(td.composer);
+    fSummary.genre.Add(td.genre);
+    fSummary.comment.Add(td.comment);
+    fSummary.mbTrackID.Add(td.mbTrackID);
+    fSummary.mbAlbumID.Add(td.mbAlbumID);
+    fSummary.year.Add(td.year);
+    fSummary.track.Add(td.track);
+    fSummary.trackTotal.Add(td.trackTotal);
+    fSummary.disc.Add(td.disc);
+    fSummary.discTotal.Add(td.discTotal);
+    fSummary.rating.Add(td.rating);
+  }
+  fLoadedCount += count;
+
+  bool done = msg->GetBool("done", false);
+  if (!done) {
+    if (fCoverStatus) {
+      BString status(B_TRANSLATE("Reading tags: %current% of %total%"));
+      BString current, total;
+      current << fLoadedCount;
+      total << (int32)fFiles.size();
+      status.ReplaceFirst("%current%", current);
+      status.ReplaceFirst("%total%", total);
+      fCoverStatus->SetText(status.String());
     }
+    _ApplySummary(false);
+    return;
+  }
 
-    titles.push_back(td.title);
-    artists.push_back(td.artist);
-    albums.push_back(td.album);
-    albumArtists.push_back(td.albumArtist);
-    composers.push_back(td.composer);
-    genres.push_back(td.genre);
-    comments.push_back(td.comment);
-    years.push_back(td.year);
-    tracks.push_back(td.track);
-    trackTotals.push_back(td.trackTotal);
-    discs.push_back(td.disc);
-    discTotals.push_back(td.discTotal);
-    ratings.push_back(td.rating);
-    mbTrackIDs.push_back(td.mbTrackID);
-    mbAlbumIDs.push_back(td.mbAlbumID);
-
-    if ((compareCovers || index == 0) && !fCoverMixed) {
-      CoverBlob cb;
-      if (MetadataTagIO::ExtractEmbeddedCover(p, cb) && cb.data() && cb.size() > 0) {
-        if (!anyCover) {
-          firstCoverBlob.assign(cb.data(), cb.size());
-          anyCover = true;
-        } else if (compareCovers) {
-          if (cb.size() != firstCoverBlob.size() ||
-              (cb.size() > 0 &&
-               memcmp(cb.data(), firstCoverBlob.data(),
-                      std::min(cb.size(), firstCoverBlob.size())) != 0)) {
-            fCoverMixed = true;
-          }
-        }
-      } else if (compareCovers) {
-        if (anyCover)
-          fCoverMixed = true;
-      }
+  fLoading = false;
+  if (fCoverStatus)
+    fCoverStatus->SetText("");
+
+  // A cover dropped while loading wins over the one read from the files.
+  if (!fCoverDirty) {
+    fCoverMixed = msg->GetBool("cover_mixed", false);
+    const void *data = nullptr;
+    ssize_t size = 0;
+    if (msg->FindData("cover", B_RAW_TYPE, &data, &size) == B_OK && size > 0) {
+      fPendingCoverBytes.assign((const uint8_t *)data,
+                                (const uint8_t *)data + size);
+      fCoverDecodePending = true;
+      _ShowPendingCover();
     }
   }
 
-  auto setText = [&](BTextControl *ed, const std::vector<BString> &vals) {
+  _ApplySummary(true);
+  _UpdateReadOnlyState();
+}
+
+/**
+ * @brief Writes the current summary to the fields.
+ * @param complete True once every file is in; fields are then remembered as
+ * the initial values and the MusicBrainz search is prefilled.
+ */
+void MetadataPropertiesWindow::_ApplySummary(bool complete) {
+  auto setText = [&](BTextControl *ed, const FieldSummary<BString> &sum) {
     if (!ed)
       return;
-    BString common;
-    switch (_StateForStrings(vals, common)) {
+    switch (sum.State()) {
     case FieldState::AllSame:
-      ed->SetEnabled(true);
-      ed->SetText(common.String());
+      ed->SetText(sum.common.String());
       break;
     case FieldState::AllEmpty:
-      ed->SetEnabled(true);
       ed->SetText("");
       break;
     case FieldState::Mixed:
-      ed->SetEnabled(false);
       ed->SetText(MultipleFilesPlaceholder());
       break;
     }
+    ed->SetEnabled(complete && sum.State() != FieldState::Mixed);
   };
-  auto setInt = [&](BTextControl *ed, const std::vector<uint32> &vals) {
+  auto setInt = [&](BTextControl *ed, const FieldSummary<uint32> &sum) {
     if (!ed)
       return;
-    uint32 common = 0;
-    switch (_StateForInts(vals, common)) {
+    switch (sum.State()) {
     case FieldState::AllSame: {
-      ed->SetEnabled(true);
       BString s;
-      s.SetToFormat("%lu", (unsigned long)common);
-      if (common == 0)
-        s = "";
+      s.SetToFormat("%lu", (unsigned long)sum.common);
       ed->SetText(s.String());
       break;
     }
     case FieldState::AllEmpty:
-      ed->SetEnabled(true);
       ed->SetText("");
       break;
     case FieldState::Mixed:
-      ed->SetEnabled(false);
       ed->SetText(MultipleFilesPlaceholder());
       break;
     }
+    ed->SetEnabled(complete && sum.State() != FieldState::Mixed);
   };
 
-  setText(fEdTitle, titles);
-  setText(fEdArtist, artists);
-  setText(fEdAlbum, albums);
-  setText(fEdAlbumArtist, albumArtists);
-  setText(fEdComposer, composers);
-  setText(fEdGenre, genres);
-  setText(fEdComment, comments);
-  setText(fEdMBTrackID, mbTrackIDs);
-  setText(fEdMBAlbumID, mbAlbumIDs);
-
-  setInt(fEdYear, years);
-  setInt(fEdTrack, tracks);
-  setInt(fEdTrackTotal, trackTotals);
-  setInt(fEdDisc, discs);
-  setInt(fEdDiscTotal, discTotals);
+  setText(fEdTitle, fSummary.title);
+  setText(fEdArtist, fSummary.artist);
+  setText(fEdAlbum, fSummary.album);
+  setText(fEdAlbumArtist, fSummary.albumArtist);
+  setText(fEdComposer, fSummary.composer);
+  setText(fEdGenre, fSummary.genre);
+  setText(fEdComment, fSummary.comment);
+  setText(fEdMBTrackID, fSummary.mbTrackID);
+  setText(fEdMBAlbumID, fSummary.mbAlbumID);
+
+  setInt(fEdYear, fSummary.year);
+  setInt(fEdTrack, fSummary.track);
+  setInt(fEdTrackTotal, fSummary.trackTotal);
+  setInt(fEdDisc, fSummary.disc);
+  setInt(fEdDiscTotal, fSummary.discTotal);
 
   if (fIsMulti) {
     if (fEdTitle) {
@@ -2069,54 +2138,33 @@ void MetadataPropertiesWindow::_LoadInitialDataMulti() {
     }
   }
 
-  if (!compareCovers)
-    fCoverMixed = true;
-
-  uint32 commonRating = 0;
-  FieldState ratingState = _StateForInts(ratings, commonRating);
   fRatingDirty = false;
-  if (ratingState == FieldState::Mixed) {
+  if (fSummary.rating.State() == FieldState::Mixed) {
     fCurrentRating = 0;
     fRatingMixed = true;
   } else {
-    fCurrentRating = (int32)commonRating;
+    fCurrentRating = (int32)fSummary.rating.common;
     fRatingMixed = false;
   }
   _UpdateRatingStars();
+  _UpdateHeaderFromFields();
 
-  if (fMbSearchArtist) {
-    BString common;
-    if (_StateForStrings(artists, common) == FieldState::AllSame)
-      fMbSearchArtist->SetText(common.String());
-    else
-      fMbSearchArtist->SetText("");
-  }
-  if (fMbSearchAlbum) {
-    BString common;
-    if (_StateForStrings(albums, common) == FieldState::AllSame)
-      fMbSearchAlbum->SetText(common.String());
-    else
-      fMbSearchAlbum->SetText("");
-  }
-  if (fMbSearchTitle) {
-    BString common;
-    if (_StateForStrings(titles, common) == FieldState::AllSame)
-      fMbSearchTitle->SetText(common.String());
-    else
-      fMbSearchTitle->SetText("");
-  }
-  if (fMbSearchTag) {
-    BString common;
-    if (_StateForStrings(genres, common) == FieldState::AllSame)
-      fMbSearchTag->SetText(common.String());
-    else
-      fMbSearchTag->SetText("");
-  }
+  if (!complete)
+    return;
+
+  auto prefill = [&](BTextControl *ed, const FieldSummary<BString> &sum) {
+    if (ed)
+      ed->SetText(sum.State() == FieldState::AllSame ? sum.common.String()
+                                                     : "");
+  };
+  prefill(fMbSearchArtist, fSummary.artist);
+  prefill(fMbSearchAlbum, fSummary.album);
+  prefill(fMbSearchTitle, fSummary.title);
+  prefill(fMbSearchTag, fSummary.genre);
   if (fMbSearchYear) {
-    uint32 common = 0;
-    if (_StateForInts(years, common) == FieldState::AllSame && common > 0) {
+    if (fSummary.year.State() == FieldState::AllSame) {
       BString year;
-      year.SetToFormat("%lu", (unsigned long)common);
+      year.SetToFormat("%lu", (unsigned long)fSummary.year.common);
       fMbSearchYear->SetText(year.String());
     } else {
       fMbSearchYear->SetText("");
@@ -2125,23 +2173,6 @@ void MetadataPropertiesWindow::_LoadInitialDataMulti() {
   if (fMbSearchCountry)
     fMbSearchCountry->SetText("");
 
-  if (fArtworkView) {
-    if (anyCover && firstCoverBlob.data() && firstCoverBlob.size() > 0) {
-      BMemoryIO io(firstCoverBlob.data(), firstCoverBlob.size());
-      if (BBitmap *bmp = BTranslationUtils::GetBitmap(&io)) {
-        fArtworkView->SetBitmap(bmp);
-        delete bmp;
-        fCurrentCoverBytes.assign(
-            (const uint8_t *)firstCoverBlob.data(),
-            (const uint8_t *)firstCoverBlob.data() + firstCoverBlob.size());
-      } else {
-        fArtworkView->SetBitmap(nullptr);
-      }
-    } else {
-      fArtworkView->SetBitmap(nullptr);
-    }
-  }
-
   _RememberInitialFieldValue("title", fEdTitle);
   _RememberInitialFieldValue("artist", fEdArtist);
   _RememberInitialFieldValue("album", fEdAlbum);
@@ -2156,8 +2187,30 @@ void MetadataPropertiesWindow::_LoadInitialDataMulti() {
   _RememberInitialFieldValue("disctotal", fEdDiscTotal);
   _RememberInitialFieldValue("mbTrackID", fEdMBTrackID);
   _RememberInitialFieldValue("mbAlbumID", fEdMBAlbumID);
+}
 
-  _UpdateHeaderFromFields();
+/**
+ * @brief Decodes the loaded cover once the tab holding it is visible.
+ */
+void MetadataPropertiesWindow::_ShowPendingCover() {
+  if (!fCoverDecodePending || !fTabs || fTabs->Selection() != 0)
+    return;
+  fCoverDecodePending = false;
+
+  if (!fArtworkView || fCoverDirty) {
+    fPendingCoverBytes.clear();
+    return;
+  }
+
+  BMemoryIO io(fPendingCoverBytes.data(), fPendingCoverBytes.size());
+  if (BBitmap *bmp = BTranslationUtils::GetBitmap(&io)) {
+    fArtworkView->SetBitmap(bmp);
+    delete bmp;
+    fCurrentCoverBytes.swap(fPendingCoverBytes);
+  } else {
+    fArtworkView->SetBitmap(nullptr);
+  }
+  fPendingCoverBytes.clear();
 }
 
 /**
@@ -24,6 +24,7 @@ class BTextControl;
 class BView;
 class ArtworkView;
 class PropertiesArtworkView;
+class PropertiesTagLoader;
 
 /**
  * @class MetadataPropertiesWindow
@@ -32,6 +33,9 @@ class PropertiesArtworkView;
  *
  * Supports both single-file and multi-file editing.
  * In multi-file mode, fields with mixed values are disabled or shown as mixed.
+ * The window opens at once with placeholders; a PropertiesTagLoader reads the
+ * selection in the background and the mixed-value summary is folded in batch
+ * by batch. Fields stay read-only until the last batch has arrived.
  * It provides tabs for basic tags, cover art management, and MusicBrainz
  * integration.
  */
@@ -101,8 +105,12 @@ private:
   void _OpenCoverPanel();
   void _HandleCoverChosen(const entry_ref &ref);
   void _SendMessageToTarget(uint32 what, BMessage *payload = nullptr);
+  void _AddCoverSource(BMessage *payload) const;
   void _LoadInitialData();
   void _LoadInitialDataMulti();
+  void _HandleTagsLoaded(const BMessage *msg);
+  void _ApplySummary(bool complete);
+  void _ShowPendingCover();
   void _ClearMusicBrainzResults(bool cancelPendingSearch);
   void _UpdateHeaderFromFields();
   void _SetRating(int32 rating, bool markDirty);
@@ -116,10 +124,38 @@ private:
   void _ShowCoverContextMenu(BPoint screenWhere);
 
   enum class FieldState { AllSame, AllEmpty, Mixed };
-  static FieldState _StateForStrings(const std::vector<BString> &vals,
-                                     BString &outCommon);
-  static FieldState _StateForInts(const std::vector<uint32> &vals,
-                                  uint32 &outCommon);
+
+  /**
+   * @brief Running mixed-value state of one field, fed one file at a time.
+   *
+   * A field that is 0 / empty in every file is AllEmpty.
+   */
+  template <typename T> struct FieldSummary {
+    T common{};
+    bool seen = false;
+    bool mixed = false;
+
+    void Add(const T &value) {
+      if (!seen) {
+        common = value;
+        seen = true;
+      } else if (!mixed && value != common) {
+        mixed = true;
+      }
+    }
+    FieldState State() const {
+      if (mixed)
+        return FieldState::Mixed;
+      return common == T() ? FieldState::AllEmpty : FieldState::AllSame;
+    }
+  };
+
+  /** @brief Summary of every field over the files loaded so far. */
+  struct MultiSummary {
+    FieldSummary<BString> title, artist, album, albumArtist, composer, genre,
+        comment, mbTrackID, mbAlbumID;
+    FieldSummary<uint32> year, track, trackTotal, disc, discTotal, rating;
+  };
 
 private:
   BPath fFilePath;           ///< Current single file path (or first of multi)
@@ -141,6 +177,19 @@ private:
   bool fCoverDirty = false;
   BString fCurrentCoverMime;
   std::vector<uint8_t> fCurrentCoverBytes;
+  BString fCoverMbid; ///< Release (group) whose thumbnail is shown, if any
+  bool fCoverIsReleaseGroup = false;
+  std::vector<uint8_t> fPendingCoverBytes; ///< Loaded, decoded when shown
+  bool fCoverDecodePending = false;
+  ///@}
+
+  /** @name Background Loading (multi-file) */
+  ///@{
+  PropertiesTagLoader *fTagLoader = nullptr;
+  int32 fLoadGeneration = 0;
+  int32 fLoadedCount = 0;
+  bool fLoading = false;
+  MultiSummary fSummary;
   ///@}
 
   /** @name Header / Tags Tab */
@@ -185,6 +234,7 @@ private:
   BColumnListView *fMbResults = nullptr;
   BButton *fMbApplyTrack = nullptr;
   BButton *fMbApplyAlbum = nullptr;
+  BButton *fMbMatchAlbums = nullptr;
   ///@}
 
   /** @name Global Buttons */
@@ -1,16 +1,18 @@
 #include "MetadataService.h"
 #include "MediaLibraryCache.h"
-#include "Config.h"
 #include "Debug.h"
 #include "Messages.h"
-#include "MusicSourceSettings.h"
+#include "MetadataSyncJob.h"
 #include "MetadataTagIO.h"
+#include "MetadataWriteQueue.h"
 
 #include <Alert.h>
 #include <Directory.h>
 #include <Entry.h>
 #include <Path.h>
 
+#include <memory>
+
 MetadataService::MetadataService(BMessenger target) : fTarget(target) {}
 
 MetadataService::~MetadataService() {}
@@ -84,128 +86,134 @@ void MetadataService::ApplyCoverToAll(const BMessage *msg) {
  * @brief Saves metadata tags to one or more files based on the BMessage.
  *
  * Iterates through "file" entries in the message and updates tags based on
- * available fields (title, artist, album, etc.).
+ * available fields (title, artist, album, etc.). If the message has a "diff"
+ * sub-message at the index of a file, that file takes its fields from the
+ * diff instead, so one message can restore different values per file.
  * Also updates BFS attributes if available and notifies the UI/MediaLibraryCache.
  *
+ * The files are written by a MetadataWriteQueue; the caller's thread waits
+ * for it, and files that could not be saved are reported in one alert.
+ *
  * @param msg The message containing tag data and file paths.
  */
 void MetadataService::SaveTags(const BMessage *msg) {
-  BString file;
-  int32 i = 0;
+  bool forceTags = false;
+  msg->FindBool("force_tags", &forceTags);
+
+  MetadataWriteQueue queue;
+  queue.AddTarget(fTarget);
+  queue.SetStatusTarget(fTarget);
 
-  while (msg->FindString("file", i++, &file) == B_OK) {
+  BString file;
+  for (int32 i = 0; msg->FindString("file", i, &file) == B_OK; i++) {
     if (file.IsEmpty())
       continue;
 
+    // Undo records carry each file's old values as its own "diff".
+    BMessage diff;
+    bool hasDiff = msg->FindMessage("diff", i, &diff) == B_OK;
+
     BPath path(file.String());
     MetadataWriteTargets targets = MetadataTagIO::WriteTargetsForPath(file);
-
-    bool forceTags = false;
-    msg->FindBool("force_tags", &forceTags);
     if (forceTags) {
       targets.tags = true;
       targets.bfs = MetadataTagIO::IsBeFsVolume(path);
     }
 
-    TagData td;
-    if (!targets.tags && targets.bfs)
-      MetadataTagIO::ReadBfsAttributes(path, td);
-    else
-      MetadataTagIO::ReadTags(path, td);
-    bool hasRating = false;
-
-    BString s;
-    if (msg->FindString("title", &s) == B_OK)
-      td.title = s;
-    if (msg->FindString("artist", &s) == B_OK)
-      td.artist = s;
-    if (msg->FindString("album", &s) == B_OK)
-      td.album = s;
-    if (msg->FindString("albumArtist", &s) == B_OK)
-      td.albumArtist = s;
-    if (msg->FindString("composer", &s) == B_OK)
-      td.composer = s;
-    if (msg->FindString("genre", &s) == B_OK)
-      td.genre = s;
-    if (msg->FindString("comment", &s) == B_OK)
-      td.comment = s;
-
-    auto _toUInt = [](const char *str) -> unsigned int {
-      return (unsigned int)atoi(str);
+    auto hasRating = std::make_shared<bool>(false);
+    auto prepare = [msg, diff, hasDiff, targets,
+                    hasRating](const BString &filePath, TagData &td) {
+      const BMessage *fields = hasDiff ? &diff : msg;
+      BPath path(filePath.String());
+      if (!targets.tags && targets.bfs)
+        MetadataTagIO::ReadBfsAttributes(path, td);
+      else
+        MetadataTagIO::ReadTags(path, td);
+
+      BString s;
+      if (fields->FindString("title", &s) == B_OK)
+        td.title = s;
+      if (fields->FindString("artist", &s) == B_OK)
+        td.artist = s;
+      if (fields->FindString("album", &s) == B_OK)
+        td.album = s;
+      if (fields->FindString("albumArtist", &s) == B_OK)
+        td.albumArtist = s;
+      if (fields->FindString("composer", &s) == B_OK)
+        td.composer = s;
+      if (fields->FindString("genre", &s) == B_OK)
+        td.genre = s;
+      if (fields->FindString("comment", &s) == B_OK)
+        td.comment = s;
+
+      auto _toUInt = [](const char *str) -> unsigned int {
+        return (unsigned int)atoi(str);
+      };
+
+      if (fields->FindString("year", &s) == B_OK)
+        td.year = _toUInt(s.String());
+      if (fields->FindString("track", &s) == B_OK)
+        td.track = _toUInt(s.String());
+      if (fields->FindString("trackTotal", &s) == B_OK ||
+          fields->FindString("tracktotal", &s) == B_OK)
+        td.trackTotal = _toUInt(s.String());
+      if (fields->FindString("disc", &s) == B_OK)
+        td.disc = _toUInt(s.String());
+      if (fields->FindString("discTotal", &s) == B_OK ||
+          fields->FindString("disctotal", &s) == B_OK)
+        td.discTotal = _toUInt(s.String());
+
+      if (fields->FindString("mbAlbumID", &s) == B_OK)
+        td.mbAlbumID = s;
+      if (fields->FindString("mbArtistID", &s) == B_OK)
+        td.mbArtistID = s;
+      if (fields->FindString("mbTrackID", &s) == B_OK)
+        td.mbTrackID = s;
+      int32 rating = 0;
+      if (fields->FindInt32("rating", &rating) == B_OK) {
+        td.rating = rating < 0 ? 0 : (rating > 10 ? 10 : (uint32)rating);
+        *hasRating = true;
+      }
+      return true;
     };
 
-    if (msg->FindString("year", &s) == B_OK)
-      td.year = _toUInt(s.String());
-    if (msg->FindString("track", &s) == B_OK)
-      td.track = _toUInt(s.String());
-    if (msg->FindString("trackTotal", &s) == B_OK ||
-        msg->FindString("tracktotal", &s) == B_OK)
-      td.trackTotal = _toUInt(s.String());
-    if (msg->FindString("disc", &s) == B_OK)
-      td.disc = _toUInt(s.String());
-    if (msg->FindString("discTotal", &s) == B_OK ||
-        msg->FindString("disctotal", &s) == B_OK)
-      td.discTotal = _toUInt(s.String());
-
-    if (msg->FindString("mbAlbumID", &s) == B_OK)
-      td.mbAlbumID = s;
-    if (msg->FindString("mbArtistID", &s) == B_OK)
-      td.mbArtistID = s;
-    if (msg->FindString("mbTrackID", &s) == B_OK)
-      td.mbTrackID = s;
-    int32 rating = 0;
-    if (msg->FindInt32("rating", &rating) == B_OK) {
-      td.rating = rating < 0 ? 0 : (rating > 10 ? 10 : (uint32)rating);
-      hasRating = true;
-    }
-
-    DEBUG_PRINT("SaveTags: Writing metadata. "
-                "mbAlbumID='%s', mbTrackID='%s'\n",
-                td.mbAlbumID.String(), td.mbTrackID.String());
-    bool ok = false;
-    if (targets.tags) {
-      ok = MetadataTagIO::WriteTagsToFile(path, td, nullptr);
-    } else if (targets.bfs) {
-      ok = MetadataTagIO::WriteBfsAttributes(path, td, nullptr);
-    }
+    auto write = [targets, hasRating](const BString &filePath,
+                                      const TagData &td) {
+      BPath path(filePath.String());
+      DEBUG_PRINT("SaveTags: Writing metadata. "
+                  "mbAlbumID='%s', mbTrackID='%s'\n",
+                  td.mbAlbumID.String(), td.mbTrackID.String());
+      bool ok = false;
+      if (targets.tags) {
+        ok = MetadataTagIO::WriteTagsToFile(path, td, nullptr);
+      } else if (targets.bfs) {
+        ok = MetadataTagIO::WriteBfsAttributes(path, td, nullptr);
+      }
 
-    if (ok) {
-      if (targets.tags && targets.bfs && MetadataTagIO::IsBeFsVolume(path)) {
+      if (ok && targets.tags && targets.bfs &&
+          MetadataTagIO::IsBeFsVolume(path)) {
         TagData tdSaved;
         MetadataTagIO::ReadTags(path, tdSaved);
-        if (hasRating)
+        if (*hasRating)
           tdSaved.rating = td.rating;
         MetadataTagIO::WriteBfsAttributes(path, tdSaved, nullptr, 512 * 1024);
       }
+      return ok;
+    };
 
-      BMessage update(MSG_MEDIA_ITEM_FOUND);
-      update.AddString("path", path.Path());
-      update.AddString("title", td.title);
-      update.AddString("artist", td.artist);
-      update.AddString("album", td.album);
-      update.AddString("genre", td.genre);
-      update.AddString("comment", td.comment);
-      update.AddInt32("year", td.year);
-      update.AddInt32("track", td.track);
-      update.AddInt32("trackTotal", td.trackTotal);
-      update.AddInt32("disc", td.disc);
-      update.AddInt32("discTotal", td.discTotal);
-      update.AddInt32("rating", td.rating);
-      update.AddInt32("duration", td.lengthSec);
-      update.AddInt32("bitrate", td.bitrate);
-
-      update.AddString("albumArtist", td.albumArtist);
-      update.AddString("composer", td.composer);
-      update.AddString("mbAlbumID", td.mbAlbumID);
-      update.AddString("mbArtistID", td.mbArtistID);
-      update.AddString("mbTrackID", td.mbTrackID);
+    queue.Add(path.Path(), prepare, write);
+  }
 
-      fTarget.SendMessage(&update);
+  if (queue.Run() == 0)
+    return;
 
-    } else {
-      (new BAlert("savefail", "Konnte Tags nicht speichern.", "OK"))->Go();
-    }
-  }
+  BString text("Konnte Tags nicht speichern.");
+  const std::vector<BString> &failed = queue.Failed();
+  for (size_t i = 0; i < failed.size() && i < 10; i++)
+    text << "\n" << BPath(failed[i].String()).Leaf();
+  if (failed.size() > 10)
+    text << "\n...";
+  (new BAlert("savefail", text.String(), "OK"))->Go();
 }
 
 /**
@@ -253,87 +261,14 @@ void MetadataService::_ProcessDirectoryForCover(const BString &filePath,
 /**
  * @brief Synchronizes metadata between Tags and BFS attributes.
  *
- * Reads the MusicSourceSettings settings for each file's directory and uses
- * the configured ConflictMode for merging.
+ * Each file is merged according to the MusicSourceSettings of its
+ * directory; see MetadataSyncJob.
  *
  * @param files List of file paths to sync.
- * @param towardsBfs If true, reads from Tags and writes to BFS.
- *                   If false, reads from BFS and writes to Tags.
+ * @param cancel Stops the sync after the files being worked on.
  */
-void MetadataService::SyncMetadata(const std::vector<BString> &files) {
-  for (size_t i = 0; i < files.size(); ++i) {
-    BPath path(files[i].String());
-    BString lowerPath(files[i]);
-    lowerPath.ToLower();
-    bool isMidiFile = false;
-#if ENABLE_MIDI_PLAYBACK
-    isMidiFile = lowerPath.EndsWith(".mid") || lowerPath.EndsWith(".midi");
-#endif
-    MusicSourceSettings src = MusicSourceSettings::GetSourceForPath(files[i]);
-
-    TagData tags, bfs;
-    MetadataTagIO::ReadTags(path, tags);
-    MetadataTagIO::ReadBfsAttributes(path, bfs);
-
-    bool primIsBfs = (src.primary == SOURCE_BFS);
-    const TagData &primaryData = primIsBfs ? bfs : tags;
-    const TagData &secondaryData = primIsBfs ? tags : bfs;
-
-    TagData merged;
-    bool conflict = false;
-    bool changed =
-        MetadataTagIO::SmartMerge(primaryData, secondaryData, merged, conflict);
-
-    if (conflict && src.conflictMode == CONFLICT_ASK) {
-      DEBUG_PRINT("CONFLICT for: %s\n", path.Path());
-      primaryData.LogDifferences(secondaryData);
-
-      BMessage ask(MSG_SYNC_CONFLICT);
-      ask.AddString("path", path.Path());
-      ask.AddInt32("index", i);
-      ask.AddInt32("total", files.size());
-      ask.AddBool("towardsBfs", true);
-      fTarget.SendMessage(&ask);
-      continue;
-    }
-
-    bool canWriteTags = !isMidiFile && (src.primary == SOURCE_TAGS ||
-                                        src.secondary == SOURCE_TAGS);
-    bool canWriteBfs =
-        isMidiFile || (src.primary == SOURCE_BFS || src.secondary == SOURCE_BFS);
-
-    if (canWriteTags) {
-      if (merged.HasDifferences(tags)) {
-        MetadataTagIO::WriteTags(path, merged);
-        DEBUG_PRINT("Updated Tags for %s\n", path.Path());
-      }
-    }
-
-    if (canWriteBfs) {
-      if (merged.HasBfsStandardDifferences(bfs)) {
-        MetadataTagIO::WriteBfsAttributes(path, merged, nullptr);
-        DEBUG_PRINT("Updated BFS for %s\n", path.Path());
-      }
-    }
-
-    if (changed || conflict) {
-      BMessage update(MSG_MEDIA_ITEM_FOUND);
-      update.AddString("path", path.Path());
-      update.AddString("title", merged.title);
-      update.AddString("artist", merged.artist);
-      update.AddString("album", merged.album);
-      update.AddString("genre", merged.genre);
-      update.AddInt32("year", merged.year);
-      update.AddInt32("track", merged.track);
-      fTarget.SendMessage(&update);
-    }
-
-    BMessage progress(MSG_SYNC_PROGRESS);
-    progress.AddInt32("current", i + 1);
-    progress.AddInt32("total", files.size());
-    fTarget.SendMessage(&progress);
-  }
-
-  BMessage done(MSG_SYNC_DONE);
-  fTarget.SendMessage(&done);
+void MetadataService::SyncMetadata(const std::vector<BString> &files,
+                                   const std::atomic<bool> *cancel) {
+  MetadataSyncJob job(fTarget, cancel);
+  job.Run(files);
 }
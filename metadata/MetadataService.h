@@ -7,6 +7,7 @@
 #include <Messenger.h>
 #include <String.h>
 
+#include <atomic>
 #include <vector>
 
 /**
@@ -55,9 +56,15 @@ public:
 
   /**
    * @brief Synchronizes metadata between embedded tags and BFS attributes.
+   *
+   * Runs a MetadataSyncJob: files unchanged since their last sync are
+   * skipped, the others are synced on a worker pool.
+   *
    * @param files List of file paths to synchronize.
+   * @param cancel Stops the sync early when set; optional.
    */
-  void SyncMetadata(const std::vector<BString> &files);
+  void SyncMetadata(const std::vector<BString> &files,
+                    const std::atomic<bool> *cancel = nullptr);
 
 private:
   /** @brief Update target for UI/cache notifications. */
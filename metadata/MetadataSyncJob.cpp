@@ -0,0 +1,326 @@
+#include "MetadataSyncJob.h"
+
+#include "Config.h"
+#include "Debug.h"
+#include "MetadataTagIO.h"
+#include "Messages.h"
+
+#include <Autolock.h>
+#include <File.h>
+#include <FindDirectory.h>
+#include <Path.h>
+
+#include <algorithm>
+#include <sys/stat.h>
+
+/**
+ * @brief Returns the path of the sync state file in the settings directory.
+ */
+static BString SyncStatePath() {
+  BPath settingsPath;
+  find_directory(B_USER_SETTINGS_DIRECTORY, &settingsPath);
+  settingsPath.Append("BeTon/sync_state.settings");
+  return BString(settingsPath.Path());
+}
+
+bool MetadataSyncJob::FileKey::operator<(const FileKey &other) const {
+  if (device != other.device)
+    return device < other.device;
+  return inode < other.inode;
+}
+
+MetadataSyncJob::MetadataSyncJob(const BMessenger &target,
+                                 const std::atomic<bool> *cancel)
+    : fTarget(target), fCancel(cancel),
+      fDone(create_sem(0, "metadata sync done")),
+      fUpdates(MSG_MEDIA_ITEMS_UPDATED), fConflicts(MSG_SYNC_CONFLICT) {}
+
+MetadataSyncJob::~MetadataSyncJob() {
+  if (fDone >= 0)
+    delete_sem(fDone);
+}
+
+void MetadataSyncJob::Run(const std::vector<BString> &files) {
+  bigtime_t t0 = system_time();
+  _LoadStamps();
+
+  const int32 total = (int32)files.size();
+  int32 skipped = 0;
+  std::vector<MusicSourceSettings> sources =
+      MusicSourceSettings::GetSourcesForPaths(files);
+  for (int32 i = 0; i < total; i++) {
+    const BString &file = files[i];
+    FileKey key;
+    Stamp stamp;
+    if (_StatFile(file.String(), key, stamp)) {
+      auto known = fStamps.find(key);
+      if (known != fStamps.end() && known->second.mtime == stamp.mtime &&
+          known->second.ctime == stamp.ctime &&
+          known->second.mode == _ModeOf(sources[i])) {
+        skipped++;
+        continue;
+      }
+    }
+    fWork.push_back({file, sources[i]});
+  }
+
+  const int32 count = (int32)fWork.size();
+  fNext.store(0);
+  std::vector<thread_id> workers;
+  for (int32 i = 0; i < std::min(kMaxWorkers, count); i++) {
+    thread_id thread =
+        spawn_thread(_WorkerEntry, "metadata sync", B_NORMAL_PRIORITY, this);
+    if (thread < 0)
+      break;
+    workers.push_back(thread);
+    resume_thread(thread);
+  }
+  if (workers.empty() && count > 0)
+    _Work();
+
+  int32 done = 0;
+  bigtime_t lastFlush = system_time();
+  bigtime_t lastCheckpoint = lastFlush;
+  while (done < count && !_Cancelled()) {
+    status_t status =
+        acquire_sem_etc(fDone, 1, B_RELATIVE_TIMEOUT, kFlushInterval);
+    if (status == B_OK)
+      done++;
+    else if (status != B_TIMED_OUT && status != B_INTERRUPTED)
+      break;
+    bigtime_t now = system_time();
+    if (now - lastFlush >= kFlushInterval) {
+      _Flush(skipped + done, total);
+      lastFlush = now;
+    }
+    if (now - lastCheckpoint >= kCheckpointInterval) {
+      _SaveStamps();
+      lastCheckpoint = now;
+    }
+  }
+
+  // Cancelled workers finish the file they are on.
+  for (thread_id thread : workers) {
+    status_t exitValue;
+    wait_for_thread(thread, &exitValue);
+  }
+  while (acquire_sem_etc(fDone, 1, B_RELATIVE_TIMEOUT, 0) == B_OK)
+    done++;
+  _Flush(skipped + done, total);
+  _SaveStamps();
+
+  DEBUG_PRINT("MetadataSyncJob: %ld of %ld files synced, %ld unchanged "
+              "since the last sync (%lld ms)%s\n",
+              (long)done, (long)count, (long)skipped,
+              (long long)((system_time() - t0) / 1000),
+              _Cancelled() ? ", cancelled" : "");
+
+  BMessage doneMsg(MSG_SYNC_DONE);
+  doneMsg.AddInt32("skipped", skipped);
+  doneMsg.AddBool("cancelled", _Cancelled());
+  fTarget.SendMessage(&doneMsg);
+  fWork.clear();
+}
+
+int32 MetadataSyncJob::_WorkerEntry(void *arg) {
+  static_cast<MetadataSyncJob *>(arg)->_Work();
+  return 0;
+}
+
+void MetadataSyncJob::_Work() {
+  while (!_Cancelled()) {
+    int32 index = fNext.fetch_add(1);
+    if (index >= (int32)fWork.size())
+      break;
+    _SyncFile(fWork[index]);
+    release_sem(fDone);
+  }
+}
+
+bool MetadataSyncJob::_Cancelled() const {
+  return fCancel != nullptr && fCancel->load(std::memory_order_relaxed);
+}
+
+void MetadataSyncJob::_SyncFile(const Work &work) {
+  const MusicSourceSettings &src = work.source;
+  BPath path(work.path.String());
+  BString lowerPath(work.path);
+  lowerPath.ToLower();
+  bool isMidiFile = false;
+#if ENABLE_MIDI_PLAYBACK
+  isMidiFile = lowerPath.EndsWith(".mid") || lowerPath.EndsWith(".midi");
+#endif
+
+  // One open per file; sync compares text fields, so the audio
+  // properties are not computed.
+  FileMetadata meta;
+  if (!MetadataTagIO::ReadFile(path, kReadTags | kReadBfs, meta))
+    return;
+  const TagData &tags = meta.tags;
+  const TagData &bfs = meta.bfs;
+
+  bool primIsBfs = (src.primary == SOURCE_BFS);
+  const TagData &primaryData = primIsBfs ? bfs : tags;
+  const TagData &secondaryData = primIsBfs ? tags : bfs;
+
+  TagData merged;
+  bool conflict = false;
+  bool changed =
+      MetadataTagIO::SmartMerge(primaryData, secondaryData, merged, conflict);
+
+  if (conflict && src.conflictMode == CONFLICT_ASK) {
+    DEBUG_PRINT("CONFLICT for: %s\n", path.Path());
+    primaryData.LogDifferences(secondaryData);
+    BAutolock lock(&fLock);
+    fConflicts.AddString("path", work.path);
+    return;
+  }
+
+  bool canWriteTags = !isMidiFile && (src.primary == SOURCE_TAGS ||
+                                      src.secondary == SOURCE_TAGS);
+  bool canWriteBfs =
+      isMidiFile || (src.primary == SOURCE_BFS || src.secondary == SOURCE_BFS);
+  bool writeTags = canWriteTags && merged.HasDifferences(tags);
+  bool writeBfs = canWriteBfs && merged.HasBfsStandardDifferences(bfs);
+
+  FileKey key;
+  Stamp stamp;
+  bool written = true;
+  if ((writeTags || writeBfs) && _StatFile(path.Path(), key, stamp)) {
+    BAutolock deviceLock(_DeviceLock(key.device));
+    if (writeTags) {
+      written = MetadataTagIO::WriteTags(path, merged) && written;
+      DEBUG_PRINT("Updated Tags for %s\n", path.Path());
+    }
+    if (writeBfs) {
+      written = MetadataTagIO::WriteBfsAttributes(path, merged, nullptr) &&
+                written;
+      DEBUG_PRINT("Updated BFS for %s\n", path.Path());
+    }
+  }
+
+  // Stamped with the times after the writes, which are the sync's own.
+  bool stamped = written && _StatFile(path.Path(), key, stamp);
+
+  BAutolock lock(&fLock);
+  if (stamped) {
+    if (fStamps.size() >= kMaxStamps)
+      fStamps.clear();
+    stamp.mode = _ModeOf(src);
+    fStamps[key] = stamp;
+    fStampsDirty = true;
+  }
+  if (changed || conflict) {
+    BMessage update(MSG_MEDIA_ITEM_FOUND);
+    update.AddString("path", work.path);
+    update.AddString("title", merged.title);
+    update.AddString("artist", merged.artist);
+    update.AddString("album", merged.album);
+    update.AddString("genre", merged.genre);
+    update.AddInt32("year", merged.year);
+    update.AddInt32("track", merged.track);
+    fUpdates.AddMessage("item", &update);
+  }
+}
+
+bool MetadataSyncJob::_StatFile(const char *path, FileKey &key,
+                                Stamp &stamp) {
+  struct stat st;
+  if (path == nullptr || stat(path, &st) != 0)
+    return false;
+  key.device = st.st_dev;
+  key.inode = st.st_ino;
+  stamp.mtime = (int64)st.st_mtim.tv_sec * 1000000000LL + st.st_mtim.tv_nsec;
+  stamp.ctime = (int64)st.st_ctim.tv_sec * 1000000000LL + st.st_ctim.tv_nsec;
+  stamp.mode = 0;
+  return true;
+}
+
+/** @brief Packs the settings a file is synced with into one value. */
+int32 MetadataSyncJob::_ModeOf(const MusicSourceSettings &source) {
+  return (int32)source.primary | (int32)source.secondary << 4 |
+         (int32)source.conflictMode << 8;
+}
+
+BLocker *MetadataSyncJob::_DeviceLock(dev_t device) {
+  BAutolock lock(&fLock);
+  std::unique_ptr<BLocker> &deviceLock = fDeviceLocks[device];
+  if (!deviceLock)
+    deviceLock.reset(new BLocker("metadata sync device writes"));
+  return deviceLock.get();
+}
+
+void MetadataSyncJob::_LoadStamps() {
+  fStamps.clear();
+  fStampsDirty = false;
+
+  BFile file(SyncStatePath().String(), B_READ_ONLY);
+  BMessage archive;
+  if (file.InitCheck() != B_OK || archive.Unflatten(&file) != B_OK)
+    return;
+
+  int64 device, inode, mtime, ctime;
+  int32 mode;
+  for (int32 i = 0; archive.FindInt64("device", i, &device) == B_OK; i++) {
+    if (archive.FindInt64("inode", i, &inode) != B_OK ||
+        archive.FindInt64("mtime", i, &mtime) != B_OK ||
+        archive.FindInt64("ctime", i, &ctime) != B_OK ||
+        archive.FindInt32("mode", i, &mode) != B_OK)
+      break;
+    fStamps[FileKey{(dev_t)device, (ino_t)inode}] = Stamp{mtime, ctime, mode};
+  }
+}
+
+/**
+ * @brief Writes the stamps of the files synced so far; the checkpoint a
+ * cancelled sync resumes from.
+ */
+void MetadataSyncJob::_SaveStamps() {
+  BMessage archive;
+  {
+    BAutolock lock(&fLock);
+    if (!fStampsDirty)
+      return;
+    for (const auto &entry : fStamps) {
+      archive.AddInt64("device", entry.first.device);
+      archive.AddInt64("inode", entry.first.inode);
+      archive.AddInt64("mtime", entry.second.mtime);
+      archive.AddInt64("ctime", entry.second.ctime);
+      archive.AddInt32("mode", entry.second.mode);
+    }
+    fStampsDirty = false;
+  }
+
+  BFile file(SyncStatePath().String(),
+             B_WRITE_ONLY | B_CREATE_FILE | B_ERASE_FILE);
+  if (file.InitCheck() != B_OK || archive.Flatten(&file) != B_OK) {
+    DEBUG_PRINT("MetadataSyncJob: could not save the sync state\n");
+    BAutolock lock(&fLock);
+    fStampsDirty = true;
+  }
+}
+
+/**
+ * @brief Sends the updates and conflicts collected since the last flush and
+ * the progress.
+ */
+void MetadataSyncJob::_Flush(int32 done, int32 total) {
+  BMessage updates(MSG_MEDIA_ITEMS_UPDATED);
+  BMessage conflicts(MSG_SYNC_CONFLICT);
+  {
+    BAutolock lock(&fLock);
+    updates = fUpdates;
+    fUpdates.MakeEmpty();
+    conflicts = fConflicts;
+    fConflicts.MakeEmpty();
+  }
+  if (updates.HasMessage("item"))
+    fTarget.SendMessage(&updates);
+  if (conflicts.HasString("path"))
+    fTarget.SendMessage(&conflicts);
+
+  BMessage progress(MSG_SYNC_PROGRESS);
+  progress.AddInt32("current", done);
+  progress.AddInt32("total", total);
+  fTarget.SendMessage(&progress);
+}
@@ -0,0 +1,102 @@
+#ifndef BETON_METADATA_SYNC_JOB_H
+#define BETON_METADATA_SYNC_JOB_H
+
+#include "MusicSourceSettings.h"
+
+#include <Locker.h>
+#include <Message.h>
+#include <Messenger.h>
+#include <OS.h>
+#include <String.h>
+#include <atomic>
+#include <map>
+#include <memory>
+#include <sys/types.h>
+#include <vector>
+
+/**
+ * @class MetadataSyncJob
+ * @brief Synchronizes embedded tags and BFS attributes of many files on a
+ * small worker pool.
+ *
+ * The source settings of all files are resolved before the workers start.
+ * Up to kMaxWorkers files are read and merged at once; the writes to one
+ * device are done one at a time.
+ *
+ * After a file is synced, its modification and attribute-change times are
+ * stored in `sync_state.settings` along with the source settings they were
+ * synced with. Files whose times and settings have not moved since are
+ * skipped. The state is saved every kCheckpointInterval and at the end, so a
+ * cancelled sync carries on where it stopped the next time.
+ *
+ * Every kFlushInterval the target gets the changed items as one
+ * `MSG_MEDIA_ITEMS_UPDATED`, the files needing a decision as one
+ * `MSG_SYNC_CONFLICT` with a "path" per file, and the progress. Files in
+ * conflict are not stamped and are looked at again by the next sync.
+ */
+class MetadataSyncJob {
+public:
+  static constexpr int32 kMaxWorkers = 4;
+  static constexpr bigtime_t kFlushInterval = 250000;
+  static constexpr bigtime_t kCheckpointInterval = 5000000;
+  static constexpr size_t kMaxStamps = 200000;
+
+  /**
+   * @param target Receives updates, conflicts, progress and `MSG_SYNC_DONE`.
+   * @param cancel Stops the sync after the files being worked on; optional.
+   */
+  MetadataSyncJob(const BMessenger &target,
+                  const std::atomic<bool> *cancel = nullptr);
+  ~MetadataSyncJob();
+
+  /** @brief Syncs `files` and blocks until done or cancelled. */
+  void Run(const std::vector<BString> &files);
+
+private:
+  struct FileKey {
+    dev_t device;
+    ino_t inode;
+
+    bool operator<(const FileKey &other) const;
+  };
+
+  struct Stamp {
+    int64 mtime; ///< Nanoseconds
+    int64 ctime; ///< Nanoseconds; changes with the attributes
+    int32 mode;  ///< Source settings the file was synced with
+  };
+
+  struct Work {
+    BString path;
+    MusicSourceSettings source;
+  };
+
+  static int32 _WorkerEntry(void *arg);
+  void _Work();
+  void _SyncFile(const Work &work);
+  bool _Cancelled() const;
+
+  static bool _StatFile(const char *path, FileKey &key, Stamp &stamp);
+  static int32 _ModeOf(const MusicSourceSettings &source);
+  BLocker *_DeviceLock(dev_t device);
+
+  void _LoadStamps();
+  void _SaveStamps();
+  void _Flush(int32 done, int32 total);
+
+  BMessenger fTarget;
+  const std::atomic<bool> *fCancel;
+
+  std::vector<Work> fWork;
+  std::atomic<int32> fNext{0};
+  sem_id fDone;
+
+  BLocker fLock{"metadata sync"}; ///< Guards the fields below
+  std::map<FileKey, Stamp> fStamps;
+  bool fStampsDirty = false;
+  std::map<dev_t, std::unique_ptr<BLocker>> fDeviceLocks;
+  BMessage fUpdates;
+  BMessage fConflicts;
+};
+
+#endif // BETON_METADATA_SYNC_JOB_H
@@ -3,14 +3,17 @@
 #include "Debug.h"
 #include "MusicSourceSettings.h"
 
+#include <algorithm>
 #include <cmath>
 #include <cstdio>
 #include <cstring>
 #include <cwchar>
 #include <unistd.h>
 #include <Entry.h>
+#include <File.h>
 #include <Node.h>
 #include <NodeInfo.h>
+#include <OS.h>
 #include <Path.h>
 #include <Volume.h>
 #include <fs_attr.h>
@@ -26,11 +29,15 @@
 #include <taglib/mp4tag.h>
 #include <taglib/mpegfile.h>
 #include <taglib/popularimeterframe.h>
+#include <taglib/privateframe.h>
 #include <taglib/tag.h>
+#include <taglib/taglib.h>
 #include <taglib/textidentificationframe.h>
 #include <taglib/tfile.h>
+#include <taglib/tiostream.h>
 #include <taglib/tpropertymap.h>
 #include <taglib/unsynchronizedlyricsframe.h>
+#include <taglib/xiphcomment.h>
 
 /**
  * @brief Converts a TagLib::String to a BString.
@@ -122,6 +129,61 @@ static BString _getStr(const TagLib::PropertyMap &p,
   return s.isEmpty() ? BString() : TL(s);
 }
 
+#if TAGLIB_MAJOR_VERSION >= 2
+typedef TagLib::offset_t StreamOffset;
+typedef TagLib::offset_t StreamStart;
+typedef size_t StreamLength;
+#else
+typedef long StreamOffset;
+typedef unsigned long StreamStart;
+typedef unsigned long StreamLength;
+#endif
+
+/**
+ * @class BFileStream
+ * @brief Read-only TagLib stream over an open BFile.
+ *
+ * Lets TagLib parse the file whose node the BFS attributes were just read
+ * from, instead of opening it again by name.
+ */
+class BFileStream : public TagLib::IOStream {
+public:
+  BFileStream(BFile &file, const char *name) : fFile(file), fName(name) {}
+
+  TagLib::FileName name() const override { return fName; }
+
+  TagLib::ByteVector readBlock(StreamLength length) override {
+    TagLib::ByteVector data((unsigned int)length, 0);
+    ssize_t read = fFile.Read(data.data(), length);
+    data.resize(read > 0 ? (unsigned int)read : 0);
+    return data;
+  }
+
+  void writeBlock(const TagLib::ByteVector &) override {}
+  void insert(const TagLib::ByteVector &, StreamStart, StreamLength) override {}
+  void removeBlock(StreamStart, StreamLength) override {}
+  bool readOnly() const override { return true; }
+  bool isOpen() const override { return fFile.InitCheck() == B_OK; }
+
+  void seek(StreamOffset offset, Position p) override {
+    uint32 mode = p == Beginning ? SEEK_SET : p == Current ? SEEK_CUR : SEEK_END;
+    fFile.Seek(offset, mode);
+  }
+
+  StreamOffset tell() const override { return fFile.Position(); }
+
+  StreamOffset length() override {
+    off_t size = 0;
+    return fFile.GetSize(&size) == B_OK ? size : 0;
+  }
+
+  void truncate(StreamOffset) override {}
+
+private:
+  BFile &fFile;
+  const char *fName;
+};
+
 static void _setOrErase(TagLib::PropertyMap &pm, const char *key,
                         const BString &v) {
   TagLib::String k(key, TagLib::String::UTF8);
@@ -228,219 +290,572 @@ static uint32 _byteToRating(uint8_t val) {
 }
 
 /**
- * @brief Reads metadata from a file into a TagData struct.
- * @param path The file path to read from.
- * @param out Output structure for metadata.
- * @return True if successful, false otherwise.
+ * @brief Reads the tag fields of a parsed file: the common tag, the
+ * property map and the ID3v2/MP4 rating and identifier frames.
  */
-bool MetadataTagIO::ReadTags(const BPath &path, TagData &out) {
-  if (path.InitCheck() != B_OK)
-    return false;
+static bool _readTagFields(TagLib::File *file, const TagLib::PropertyMap &pm,
+                           TagData &out) {
+  bool foundData = false;
 
-  BString lower = path.Path();
-  lower.ToLower();
-  if (lower.EndsWith(".mid") || lower.EndsWith(".midi")) {
-    return ReadBfsAttributes(path, out);
+  if (TagLib::Tag *t = file->tag()) {
+    out.title = TL(t->title());
+    out.artist = TL(t->artist());
+    out.album = TL(t->album());
+    out.genre = TL(t->genre());
+    out.comment = TL(t->comment());
+    out.year = t->year();
+    out.track = t->track();
+    foundData = true;
   }
 
-  bool foundData = false;
+  out.albumArtist = _getStr(pm, {"ALBUMARTIST", "ALBUM ARTIST", "TPE2", "aART"});
 
-  TagLib::FileRef fr(path.Path());
-  if (!fr.isNull()) {
-    if (TagLib::Tag *t = fr.tag()) {
-      out.title = TL(t->title());
-      out.artist = TL(t->artist());
-      out.album = TL(t->album());
-      out.genre = TL(t->genre());
-      out.comment = TL(t->comment());
-      out.year = t->year();
-      out.track = t->track();
-      foundData = true;
-    }
-
-    if (const TagLib::AudioProperties *ap = fr.audioProperties()) {
-      const int ms = ap->lengthInMilliseconds();
-      out.lengthSec = (ms > 0) ? (ms / 1000) : 0;
-      out.bitrate = ap->bitrate();
-      out.sampleRate = ap->sampleRate();
-      out.channels = ap->channels();
-      foundData = true;
-    }
+  out.composer =
+      _getStr(pm, {"COMPOSER", "TCOM", "©wrt", "composer", "Composer"});
 
-    if (fr.file()) {
-      const TagLib::PropertyMap &pm = fr.file()->properties();
+  if (out.trackTotal == 0) {
+    BString s = _getStr(pm, {"TRACKTOTAL", "TOTALTRACKS", "TOTAL TRACKS"});
+    if (!s.IsEmpty())
+      out.trackTotal = _toUInt(TagLib::String(s.String(), TagLib::String::UTF8));
+  }
+  TagLib::String trkPair = _getTL(pm, {"TRACKNUMBER", "TRCK", "trkn"});
+  if (!trkPair.isEmpty()) {
+    uint32 n = 0, tot = 0;
+    _parsePair(trkPair, n, tot);
+    if (n && !out.track)
+      out.track = n;
+    if (tot)
+      out.trackTotal = tot;
+  }
 
-      out.albumArtist =
-          _getStr(pm, {"ALBUMARTIST", "ALBUM ARTIST", "TPE2", "aART"});
+  if (out.disc == 0)
+    out.disc = _toUInt(_getTL(pm, {"DISCNUMBER", "DISC NUMBER", "TPOS"}));
+  if (out.discTotal == 0) {
+    BString s = _getStr(pm, {"DISCTOTAL", "TOTALDISCS", "TOTAL DISCS"});
+    if (!s.IsEmpty())
+      out.discTotal = _toUInt(TagLib::String(s.String(), TagLib::String::UTF8));
+  }
+  TagLib::String tpos = _getTL(pm, {"TPOS", "DISCNUMBER", "disk"});
+  if (!tpos.isEmpty()) {
+    uint32 d = 0, tot = 0;
+    _parsePair(tpos, d, tot);
+    if (d && !out.disc)
+      out.disc = d;
+    if (tot)
+      out.discTotal = tot;
+  }
 
-      out.composer =
-          _getStr(pm, {"COMPOSER", "TCOM", "©wrt", "composer", "Composer"});
+  if (out.rating == 0) {
+    TagLib::String r = _getTL(pm, {"RATING", "rating"});
+    if (!r.isEmpty()) {
+      int v = _toUInt(r);
+      if (v > 10)
+        v /= 10;
+      if (v > 5)
+        v = 5;
+      out.rating = v * 2;
+    }
+  }
 
-      if (out.trackTotal == 0) {
-        BString s = _getStr(pm, {"TRACKTOTAL", "TOTALTRACKS", "TOTAL TRACKS"});
-        if (!s.IsEmpty())
-          out.trackTotal =
-              _toUInt(TagLib::String(s.String(), TagLib::String::UTF8));
-      }
-      TagLib::String trkPair = _getTL(pm, {"TRACKNUMBER", "TRCK", "trkn"});
-      if (!trkPair.isEmpty()) {
-        uint32 n = 0, tot = 0;
-        _parsePair(trkPair, n, tot);
-        if (n && !out.track)
-          out.track = n;
-        if (tot)
-          out.trackTotal = tot;
-      }
+  out.mbAlbumID = _getStr(pm, {"MUSICBRAINZ_ALBUMID", "MusicBrainz Album Id"});
+  out.mbArtistID =
+      _getStr(pm, {"MUSICBRAINZ_ARTISTID", "MusicBrainz Artist Id"});
+  out.mbTrackID = _getStr(pm, {"MUSICBRAINZ_TRACKID", "MusicBrainz Track Id"});
+  out.acoustId = _getStr(pm, {"ACOUSTID_ID"});
+  out.acoustIdFp = _getStr(pm, {"ACOUSTID_FINGERPRINT"});
+
+  if (auto *mf = dynamic_cast<TagLib::MPEG::File *>(file)) {
+    if (TagLib::ID3v2::Tag *id3 = mf->ID3v2Tag()) {
+      const TagLib::ID3v2::FrameList &popm = id3->frameList("POPM");
+      for (auto *f : popm) {
+        TagLib::ID3v2::PopularimeterFrame *pf =
+            dynamic_cast<TagLib::ID3v2::PopularimeterFrame *>(f);
+        if (pf) {
+          out.rating = _byteToRating(pf->rating());
 
-      if (out.disc == 0)
-        out.disc = _toUInt(_getTL(pm, {"DISCNUMBER", "DISC NUMBER", "TPOS"}));
-      if (out.discTotal == 0) {
-        BString s = _getStr(pm, {"DISCTOTAL", "TOTALDISCS", "TOTAL DISCS"});
-        if (!s.IsEmpty())
-          out.discTotal =
-              _toUInt(TagLib::String(s.String(), TagLib::String::UTF8));
-      }
-      TagLib::String tpos = _getTL(pm, {"TPOS", "DISCNUMBER", "disk"});
-      if (!tpos.isEmpty()) {
-        uint32 d = 0, tot = 0;
-        _parsePair(tpos, d, tot);
-        if (d && !out.disc)
-          out.disc = d;
-        if (tot)
-          out.discTotal = tot;
+          if (pf->email() == "Windows Media Player 9 Series")
+            break;
+        }
       }
 
-      if (out.rating == 0) {
-        TagLib::String r = _getTL(pm, {"RATING", "rating"});
-        if (!r.isEmpty()) {
-          int v = _toUInt(r);
-          if (v > 10)
-            v /= 10;
-          if (v > 5)
-            v = 5;
-          out.rating = v * 2;
+      const TagLib::ID3v2::FrameList &txxx = id3->frameList("TXXX");
+      for (auto it = txxx.begin(); it != txxx.end(); ++it) {
+        TagLib::ID3v2::UserTextIdentificationFrame *u =
+            dynamic_cast<TagLib::ID3v2::UserTextIdentificationFrame *>(*it);
+        if (!u)
+          continue;
+
+        const BString desc = TL(u->description());
+        BString val;
+        const auto &fl = u->fieldList();
+
+        if (fl.size() >= 2) {
+          val = TL(fl[1]);
+        } else if (fl.size() == 1) {
+          BString item0 = TL(fl.front());
+          if (item0 != desc)
+            val = item0;
         }
+
+        if (desc.ICompare("MusicBrainz Album Id") == 0)
+          out.mbAlbumID = val;
+        else if (desc.ICompare("MusicBrainz Artist Id") == 0)
+          out.mbArtistID = val;
+        else if (desc.ICompare("MusicBrainz Track Id") == 0)
+          out.mbTrackID = val;
+        else if (desc.ICompare("AcoustID Fingerprint") == 0)
+          out.acoustIdFp = val;
+        else if (desc.ICompare("AcoustID Id") == 0)
+          out.acoustId = val;
       }
 
-      out.mbAlbumID =
-          _getStr(pm, {"MUSICBRAINZ_ALBUMID", "MusicBrainz Album Id"});
-      out.mbArtistID =
-          _getStr(pm, {"MUSICBRAINZ_ARTISTID", "MusicBrainz Artist Id"});
-      out.mbTrackID =
-          _getStr(pm, {"MUSICBRAINZ_TRACKID", "MusicBrainz Track Id"});
+      foundData = true;
+    }
+  } else if (auto *mf = dynamic_cast<TagLib::MP4::File *>(file)) {
+    if (TagLib::MP4::Tag *tag = mf->tag()) {
+      if (tag->contains("rate")) {
+        int val = tag->item("rate").toInt();
+        if (val > 0 && val <= 100)
+          out.rating = (val + 5) / 10;
+        else if (val > 100)
+          out.rating = _byteToRating(val);
+      }
+      foundData = true;
     }
   }
 
-  {
-    TagLib::MPEG::File mf(path.Path());
-    if (mf.isOpen()) {
-      if (TagLib::ID3v2::Tag *id3 = mf.ID3v2Tag()) {
-        const TagLib::ID3v2::FrameList &popm = id3->frameList("POPM");
-        if (!popm.isEmpty()) {
-          for (auto *f : popm) {
-            TagLib::ID3v2::PopularimeterFrame *pf =
-                dynamic_cast<TagLib::ID3v2::PopularimeterFrame *>(f);
-            if (pf) {
-              out.rating = _byteToRating(pf->rating());
-
-              if (pf->email() == "Windows Media Player 9 Series")
-                break;
-            }
+  return foundData;
+}
+
+/**
+ * @brief Copies the first embedded picture of an MP3, FLAC or MP4 file.
+ */
+static bool _readCover(TagLib::File *file, CoverBlob &outCover) {
+  outCover.clear();
+
+  if (auto *f = dynamic_cast<TagLib::MPEG::File *>(file)) {
+    if (TagLib::ID3v2::Tag *id3 = f->ID3v2Tag(false)) {
+      const TagLib::ID3v2::FrameList &apic = id3->frameList("APIC");
+      for (auto it = apic.begin(); it != apic.end(); ++it) {
+        if (auto *pic = dynamic_cast<TagLib::ID3v2::AttachedPictureFrame *>(*it)) {
+          const TagLib::ByteVector &bv = pic->picture();
+          if (!bv.isEmpty()) {
+            outCover.assign(bv.data(), bv.size());
+            return true;
           }
         }
-
-        const TagLib::ID3v2::FrameList &txxx = id3->frameList("TXXX");
-        for (auto it = txxx.begin(); it != txxx.end(); ++it) {
-          TagLib::ID3v2::UserTextIdentificationFrame *u =
-              dynamic_cast<TagLib::ID3v2::UserTextIdentificationFrame *>(*it);
-          if (!u)
-            continue;
-
-          const BString desc = TL(u->description());
-          BString val;
-          const auto &fl = u->fieldList();
-
-          if (fl.size() >= 2) {
-            val = TL(fl[1]);
-          } else if (fl.size() == 1) {
-
-            BString item0 = TL(fl.front());
-
-            if (item0 != TL(u->description()))
-              val = item0;
-            else
-              val = "";
-          } else {
-            val = "";
+      }
+    }
+  } else if (auto *f = dynamic_cast<TagLib::FLAC::File *>(file)) {
+    const TagLib::List<TagLib::FLAC::Picture *> &pics = f->pictureList();
+    if (!pics.isEmpty() && pics[0]) {
+      const TagLib::ByteVector &bv = pics[0]->data();
+      if (!bv.isEmpty()) {
+        outCover.assign(bv.data(), bv.size());
+        return true;
+      }
+    }
+  } else if (auto *f = dynamic_cast<TagLib::MP4::File *>(file)) {
+    if (f->tag()) {
+      const TagLib::MP4::ItemMap &im = f->tag()->itemMap();
+      auto it = im.find("covr");
+      if (it != im.end()) {
+        const TagLib::MP4::CoverArtList list = it->second.toCoverArtList();
+        if (!list.isEmpty()) {
+          const TagLib::ByteVector &bv = list.front().data();
+          if (!bv.isEmpty()) {
+            outCover.assign(bv.data(), bv.size());
+            return true;
           }
-
-          if (desc.ICompare("MusicBrainz Album Id") == 0)
-            out.mbAlbumID = val;
-          else if (desc.ICompare("MusicBrainz Artist Id") == 0)
-            out.mbArtistID = val;
-          else if (desc.ICompare("MusicBrainz Track Id") == 0)
-            out.mbTrackID = val;
-          else if (desc.ICompare("AcoustID Fingerprint") == 0)
-            out.acoustIdFp = val;
-          else if (desc.ICompare("AcoustID Id") == 0)
-            out.acoustId = val;
         }
-
-        foundData = true;
       }
     }
   }
+  return false;
+}
 
-  {
-    TagLib::MP4::File mf(path.Path());
-    if (mf.isValid() && mf.tag()) {
-      TagLib::MP4::Tag *tag = mf.tag();
+/**
+ * @brief Reads the BFS attributes of an open node.
+ */
+static bool _readBfs(BNode &node, TagData &out) {
+  char buffer[512];
+  memset(buffer, 0, sizeof(buffer));
+  int32 intVal;
 
-      if (tag->contains("rate")) {
-        TagLib::MP4::Item item = tag->item("rate");
-        if (item.toInt() > 0) {
-          int val = item.toInt();
-          if (val > 0 && val <= 100) {
-            out.rating = (val + 5) / 10;
-          } else if (val > 100) {
-            out.rating = _byteToRating(val);
-          }
+  if (node.ReadAttr("Media:Title", B_STRING_TYPE, 0, buffer, sizeof(buffer)) >
+      0) {
+    out.title = buffer;
+    _trimBString(out.title);
+  }
+
+  if (node.ReadAttr("Audio:Artist", B_STRING_TYPE, 0, buffer, sizeof(buffer)) >
+      0) {
+    out.artist = buffer;
+    _trimBString(out.artist);
+  }
+
+  if (node.ReadAttr("Audio:Album", B_STRING_TYPE, 0, buffer, sizeof(buffer)) >
+      0) {
+    out.album = buffer;
+    _trimBString(out.album);
+  }
+
+  if (node.ReadAttr("Media:Genre", B_STRING_TYPE, 0, buffer, sizeof(buffer)) >
+      0) {
+    out.genre = buffer;
+    _trimBString(out.genre);
+  } else if (node.ReadAttr("Audio:Genre", B_STRING_TYPE, 0, buffer,
+                           sizeof(buffer)) > 0) {
+    out.genre = buffer;
+    _trimBString(out.genre);
+  }
+
+  if (node.ReadAttr("Media:Comment", B_STRING_TYPE, 0, buffer, sizeof(buffer)) >
+      0) {
+    out.comment = buffer;
+    _trimBString(out.comment);
+  }
+
+  if (node.ReadAttr("Media:Year", B_INT32_TYPE, 0, &intVal, sizeof(intVal)) > 0)
+    out.year = static_cast<uint32>(intVal);
+
+  if (node.ReadAttr("Audio:Track", B_INT32_TYPE, 0, &intVal, sizeof(intVal)) >
+      0)
+    out.track = static_cast<uint32>(intVal);
+
+  if (node.ReadAttr("Media:Length", B_INT32_TYPE, 0, &intVal,
+                    sizeof(intVal)) > 0)
+    out.lengthSec = static_cast<uint32>(intVal);
+
+  if (node.ReadAttr("Audio:Bitrate", B_INT32_TYPE, 0, &intVal,
+                    sizeof(intVal)) > 0)
+    out.bitrate = static_cast<uint32>(intVal);
+
+  if (node.ReadAttr("Media:Rating", B_INT32_TYPE, 0, &intVal, sizeof(intVal)) >
+      0) {
+    if (intVal >= 1 && intVal <= 10)
+      out.rating = static_cast<uint32>(intVal);
+  }
+
+  return true;
+}
+
+/**
+ * @brief Reads the parts of a file selected by `fields` from one open file.
+ */
+bool MetadataTagIO::ReadFile(const BPath &path, uint32 fields,
+                             FileMetadata &out) {
+  out = FileMetadata();
+  if (path.InitCheck() != B_OK)
+    return false;
+
+  BFile file(path.Path(), B_READ_ONLY);
+  if (file.InitCheck() != B_OK)
+    return false;
+
+  if (fields & kReadBfs) {
+    bigtime_t start = system_time();
+    out.hasBfs = _readBfs(file, out.bfs);
+    out.bfsTime = system_time() - start;
+  }
+
+  BString lower = path.Path();
+  lower.ToLower();
+  const bool isMidi = lower.EndsWith(".mid") || lower.EndsWith(".midi");
+  const uint32 parsed =
+      kReadTags | kReadAudioProperties | kReadCover | kReadReplayGain;
+
+  if (!isMidi && (fields & parsed) != 0) {
+    bigtime_t start = system_time();
+    BFileStream stream(file, path.Path());
+    // Tags, POPM, TXXX and MP4 items all come from this one parse; see
+    // _readTagFields().
+    const TagLib::AudioProperties::ReadStyle style =
+        (fields & kReadFastAudioProperties) ? TagLib::AudioProperties::Fast
+                                            : TagLib::AudioProperties::Average;
+    TagLib::FileRef fr(&stream, (fields & kReadAudioProperties) != 0, style);
+    if (!fr.isNull() && fr.file()) {
+      TagLib::File *f = fr.file();
+      if (fields & (kReadTags | kReadReplayGain)) {
+        const TagLib::PropertyMap pm = f->properties();
+        if ((fields & kReadTags) && _readTagFields(f, pm, out.tags))
+          out.hasTags = true;
+        if (fields & kReadReplayGain)
+          ReadReplayGain(pm, out.replayGain);
+      }
+
+      if (fields & kReadAudioProperties) {
+        if (const TagLib::AudioProperties *ap = fr.audioProperties()) {
+          const int ms = ap->lengthInMilliseconds();
+          out.tags.lengthSec = (ms > 0) ? (ms / 1000) : 0;
+          out.tags.bitrate = ap->bitrate();
+          out.tags.sampleRate = ap->sampleRate();
+          out.tags.channels = ap->channels();
+          out.hasTags = true;
         }
       }
 
-      foundData = true;
+      if (fields & kReadCover)
+        _readCover(f, out.cover);
     }
+    out.parseTime = system_time() - start;
   }
 
-  TagData bfsData;
-  if (ReadBfsAttributes(path, bfsData)) {
-    if (out.title.IsEmpty())
-      out.title = bfsData.title;
-    if (out.artist.IsEmpty())
-      out.artist = bfsData.artist;
-    if (out.album.IsEmpty())
-      out.album = bfsData.album;
-    if (out.genre.IsEmpty())
-      out.genre = bfsData.genre;
-    if (out.comment.IsEmpty())
-      out.comment = bfsData.comment;
-    if (out.year == 0)
-      out.year = bfsData.year;
-    if (out.track == 0)
-      out.track = bfsData.track;
-
-    if (out.lengthSec == 0)
-      out.lengthSec = bfsData.lengthSec;
-    if (out.bitrate == 0)
-      out.bitrate = bfsData.bitrate;
-
-    if (out.rating == 0)
-      out.rating = bfsData.rating;
+  if ((fields & kReadTags) && out.hasBfs) {
+    const TagData &bfs = out.bfs;
+    TagData &tags = out.tags;
+    if (tags.title.IsEmpty())
+      tags.title = bfs.title;
+    if (tags.artist.IsEmpty())
+      tags.artist = bfs.artist;
+    if (tags.album.IsEmpty())
+      tags.album = bfs.album;
+    if (tags.genre.IsEmpty())
+      tags.genre = bfs.genre;
+    if (tags.comment.IsEmpty())
+      tags.comment = bfs.comment;
+    if (tags.year == 0)
+      tags.year = bfs.year;
+    if (tags.track == 0)
+      tags.track = bfs.track;
+
+    if (tags.lengthSec == 0)
+      tags.lengthSec = bfs.lengthSec;
+    if (tags.bitrate == 0)
+      tags.bitrate = bfs.bitrate;
+
+    if (tags.rating == 0)
+      tags.rating = bfs.rating;
+
+    out.hasTags = true;
+  }
 
-    foundData = true;
+  return out.hasTags || out.hasBfs || out.cover.size() > 0 ||
+         out.replayGain.HasTrack();
+}
+
+/**
+ * @brief Reads metadata from a file into a TagData struct.
+ *
+ * Tags and audio properties, with empty fields filled from the BFS
+ * attributes.
+ * @param path The file path to read from.
+ * @param out Output structure for metadata.
+ * @return True if successful, false otherwise.
+ */
+bool MetadataTagIO::ReadTags(const BPath &path, TagData &out) {
+  FileMetadata meta;
+  ReadFile(path, kReadTags | kReadAudioProperties | kReadBfs, meta);
+  out = meta.tags;
+  return meta.hasTags;
+}
+
+/**
+ * @name In-place saves
+ *
+ * TagLib rewrites a tag in place when the new one fits into the old tag and
+ * its padding; otherwise everything after it, the audio, is moved. It keeps
+ * leftover padding of up to 1% of the file (at most 1 MB) and otherwise
+ * falls back to a minimal one.
+ *
+ * When the audio has to move anyway, the save below first writes the tag
+ * with a filler of kReservePadding bytes and then saves again without it.
+ * The second save fits, so the filler is left as padding, and later edits,
+ * a new cover included, usually fit without moving the audio again.
+ */
+///@{
+static const long long kReservePadding = 256 * 1024;
+static const long long kMaxTagLibPadding = 1024 * 1024;
+
+/** @brief Set when a save on this thread had to move the audio. */
+static thread_local bool sFullRewrite = false;
+
+/** @brief Largest padding TagLib keeps in a file of `length` bytes. */
+static long long _paddingThreshold(long long length, long long minPadding) {
+  return std::min(std::max(length / 100, minPadding), kMaxTagLibPadding);
+}
+
+/** @brief Filler for a file of `length` bytes, or 0 if it is not worth it. */
+static long long _reserveFor(long long length, long long minPadding) {
+  // The filler's frame or block header and TagLib's own minimum padding
+  // must fit below the threshold as well.
+  long long reserve =
+      std::min(kReservePadding,
+               _paddingThreshold(length, minPadding) - 2 * minPadding);
+  return reserve >= 4096 ? reserve : 0;
+}
+
+static bool _saveMpegNow(TagLib::MPEG::File &f,
+                         TagLib::ID3v2::Version version) {
+  return f.save(TagLib::MPEG::File::AllTags, TagLib::File::StripNone, version,
+                TagLib::File::DoNotDuplicate);
+}
+
+/**
+ * @brief Saves an MP3 whose ID3v2 tag was changed, keeping the audio in
+ * place when the tag fits.
+ */
+static bool _saveMpeg(TagLib::MPEG::File &f, TagLib::ID3v2::Version version,
+                      const char *path) {
+  TagLib::ID3v2::Tag *id3 = f.ID3v2Tag(true);
+  const long long original =
+      f.hasID3v2Tag() ? (long long)id3->header()->completeTagSize() : 0;
+  // Rendering applies TagLib's padding rules: the tag fits exactly when it
+  // keeps its size.
+  if (original > 0 && (long long)id3->render(version).size() == original)
+    return _saveMpegNow(f, version);
+
+  sFullRewrite = true;
+  DEBUG_PRINT("MetadataTagIO: ID3v2 tag of %s does not fit, moving audio\n",
+              path);
+  const long long reserve = _reserveFor((long long)f.length(), 1024);
+  if (reserve == 0)
+    return _saveMpegNow(f, version);
+
+  auto *filler = new TagLib::ID3v2::PrivateFrame();
+  filler->setOwner("BeTon padding");
+  filler->setData(TagLib::ByteVector((unsigned int)reserve, '\0'));
+  id3->addFrame(filler);
+  bool saved = _saveMpegNow(f, version);
+  id3->removeFrame(filler, true);
+  return saved && _saveMpegNow(f, version);
+}
+
+/**
+ * @brief Bytes taken by the comment, picture and padding blocks of a FLAC
+ * file: the space its tags can use without moving the audio.
+ * @return `false` if the file does not start with the FLAC header.
+ */
+static bool _flacTagSpace(const char *path, long long &space) {
+  space = 0;
+  BFile file(path, B_READ_ONLY);
+  char magic[4];
+  if (file.InitCheck() != B_OK || file.ReadAt(0, magic, 4) != 4 ||
+      memcmp(magic, "fLaC", 4) != 0)
+    return false;
+
+  off_t offset = 4;
+  for (;;) {
+    uint8 header[4];
+    if (file.ReadAt(offset, header, 4) != 4)
+      return false;
+    const uint8 type = header[0] & 0x7f;
+    const off_t length = ((off_t)header[1] << 16) | ((off_t)header[2] << 8) |
+                         (off_t)header[3];
+    // Padding, Vorbis comment and picture blocks.
+    if (type == 1 || type == 4 || type == 6)
+      space += 4 + length;
+    offset += 4 + length;
+    if (header[0] & 0x80)
+      return true;
   }
+}
 
-  return foundData;
+/**
+ * @brief Saves a FLAC file whose comment or pictures were changed, keeping
+ * the audio in place when they fit.
+ */
+static bool _saveFlac(TagLib::FLAC::File &f, const char *path) {
+  const long long minPadding = 4096;
+  long long space = 0;
+  // Without the FLAC header up front (an ID3v2 tag before it, say), the
+  // space is not known; TagLib decides on its own.
+  if (!_flacTagSpace(path, space))
+    return f.save();
+
+  long long needed = 4 + (long long)f.xiphComment(true)->render(false).size();
+  const TagLib::List<TagLib::FLAC::Picture *> &pics = f.pictureList();
+  for (unsigned int i = 0; i < pics.size(); ++i)
+    needed += 4 + (long long)pics[i]->render().size();
+  // What is left becomes the padding block, if TagLib keeps it.
+  const long long padding = space - needed - 4;
+  if (padding > 0 &&
+      padding <= _paddingThreshold((long long)f.length(), minPadding))
+    return f.save();
+
+  sFullRewrite = true;
+  DEBUG_PRINT("MetadataTagIO: FLAC tags of %s do not fit, moving audio\n",
+              path);
+  const long long reserve = _reserveFor((long long)f.length(), minPadding);
+  if (reserve == 0)
+    return f.save();
+
+  auto *filler = new TagLib::FLAC::Picture;
+  filler->setType(TagLib::FLAC::Picture::Other);
+  filler->setMimeType("application/octet-stream");
+  filler->setData(TagLib::ByteVector((unsigned int)reserve, '\0'));
+  f.addPicture(filler);
+  bool saved = f.save();
+  f.removePicture(filler, true);
+  return saved && f.save();
+}
+
+/** @brief Replaces the pictures of an ID3v2 tag with `data`, if any. */
+static void _setId3Cover(TagLib::ID3v2::Tag *id3, const uint8 *data,
+                         size_t size, const char *mime) {
+  std::vector<TagLib::ID3v2::Frame *> toRemove;
+  const TagLib::ID3v2::FrameList &apic = id3->frameList("APIC");
+  for (auto *frame : apic)
+    toRemove.push_back(frame);
+  for (auto *frame : toRemove)
+    id3->removeFrame(frame, true);
+
+  if (data == nullptr || size == 0)
+    return;
+  auto *pic = new TagLib::ID3v2::AttachedPictureFrame;
+  pic->setType(TagLib::ID3v2::AttachedPictureFrame::FrontCover);
+  pic->setMimeType(mime ? mime : "image/jpeg");
+  pic->setPicture(TagLib::ByteVector(reinterpret_cast<const char *>(data),
+                                     static_cast<unsigned int>(size)));
+  id3->addFrame(pic);
+}
+
+/** @brief Replaces the pictures of a FLAC file with `data`, if any. */
+static void _setFlacCover(TagLib::FLAC::File &f, const uint8 *data,
+                          size_t size, const char *mime) {
+  f.removePictures();
+  if (data == nullptr || size == 0)
+    return;
+  auto *pic = new TagLib::FLAC::Picture;
+  pic->setType(TagLib::FLAC::Picture::FrontCover);
+  pic->setMimeType(mime ? mime : "image/jpeg");
+  pic->setData(TagLib::ByteVector(reinterpret_cast<const char *>(data),
+                                  static_cast<unsigned int>(size)));
+  f.addPicture(pic);
+}
+
+/**
+ * @brief Replaces the cover of an MP4 tag with `data`, if any.
+ * @return `false` for an image format MP4 cannot hold.
+ */
+static bool _setMp4Cover(TagLib::MP4::Tag *tag, const uint8 *data,
+                         size_t size, const char *mime) {
+  tag->removeItem("covr");
+  if (data == nullptr || size == 0)
+    return true;
+
+  TagLib::MP4::CoverArt::Format fmt;
+  if (mime && strcmp(mime, "image/png") == 0)
+    fmt = TagLib::MP4::CoverArt::PNG;
+  else if (mime && strcmp(mime, "image/jpeg") == 0)
+    fmt = TagLib::MP4::CoverArt::JPEG;
+  else
+    return false;
+
+  TagLib::MP4::CoverArt art(
+      fmt, TagLib::ByteVector(reinterpret_cast<const char *>(data),
+                              static_cast<unsigned int>(size)));
+  TagLib::MP4::CoverArtList list;
+  list.append(art);
+  tag->setItem("covr", list);
+  return true;
+}
+///@}
+
+bool MetadataTagIO::TakeFullRewrite() {
+  bool rewrote = sFullRewrite;
+  sFullRewrite = false;
+  return rewrote;
 }
 
 static void set_basic_tags(TagLib::Tag *t, const TagData &td) {
@@ -621,27 +1036,13 @@ bool MetadataTagIO::WriteTagsToFile(const BPath &path, const TagData &td,
         DEBUG_PRINT("WriteTagsToFile: embedding MP3 cover, "
                     "size=%zu\n",
                     coverOpt->size());
-        std::vector<TagLib::ID3v2::Frame *> toRemove;
-        const TagLib::ID3v2::FrameList &apic = id3->frameList("APIC");
-        for (auto *frame : apic)
-          toRemove.push_back(frame);
-        for (auto *frame : toRemove)
-          id3->removeFrame(frame, true);
-
-        auto *pic = new TagLib::ID3v2::AttachedPictureFrame;
-        const char *mime = sniff_mime((const uint8 *)coverOpt->data(),
-                                      coverOpt->size());
-        pic->setType(TagLib::ID3v2::AttachedPictureFrame::FrontCover);
-        pic->setMimeType(mime ? mime : "image/jpeg");
-        pic->setPicture(TagLib::ByteVector(
-            reinterpret_cast<const char *>(coverOpt->data()),
-            static_cast<unsigned int>(coverOpt->size())));
-        id3->addFrame(pic);
+        const uint8 *data = (const uint8 *)coverOpt->data();
+        _setId3Cover(id3, data, coverOpt->size(),
+                     sniff_mime(data, coverOpt->size()));
       }
     }
 
-    return f.save(TagLib::MPEG::File::AllTags, TagLib::File::StripNone,
-                  TagLib::ID3v2::v4, TagLib::File::DoNotDuplicate);
+    return _saveMpeg(f, TagLib::ID3v2::v4, path.Path());
   }
 
   if (lower.EndsWith(".m4a") || lower.EndsWith(".mp4") ||
@@ -696,6 +1097,12 @@ bool MetadataTagIO::WriteTagsToFile(const BPath &path, const TagData &td,
       tag->removeItem("rate");
     }
 
+    if (coverOpt && coverOpt->data() && coverOpt->size() > 0) {
+      const uint8 *data = (const uint8 *)coverOpt->data();
+      _setMp4Cover(tag, data, coverOpt->size(),
+                   sniff_mime(data, coverOpt->size()));
+    }
+
     return f.save();
   }
 
@@ -746,6 +1153,16 @@ bool MetadataTagIO::WriteTagsToFile(const BPath &path, const TagData &td,
 
       fr.file()->setProperties(pm);
     }
+
+    // FLAC takes the cover in the same save, into space kept free for it.
+    if (auto *flac = dynamic_cast<TagLib::FLAC::File *>(fr.file())) {
+      if (coverOpt && coverOpt->data() && coverOpt->size() > 0) {
+        const uint8 *data = (const uint8 *)coverOpt->data();
+        _setFlacCover(*flac, data, coverOpt->size(),
+                      sniff_mime(data, coverOpt->size()));
+      }
+      return _saveFlac(*flac, path.Path());
+    }
     return fr.save();
   }
 }
@@ -757,6 +1174,149 @@ bool MetadataTagIO::WriteTags(const BPath &path, const TagData &in) {
   return WriteTagsToFile(path, in, nullptr);
 }
 
+/** @brief Parses "-6.54 dB" into hundredths of a dB; false if no number. */
+static bool _parseGain(const TagLib::String &s, double scale, double offset,
+                       int32 &out) {
+  if (s.isEmpty())
+    return false;
+  const std::string text = s.to8Bit(true);
+  char *end = nullptr;
+  double value = strtod(text.c_str(), &end);
+  if (end == text.c_str() || !std::isfinite(value))
+    return false;
+  out = (int32)std::lround((value * scale + offset) * 100.0);
+  return true;
+}
+
+static int32 _parsePeak(const TagLib::String &s) {
+  if (s.isEmpty())
+    return 0;
+  double value = strtod(s.to8Bit(true).c_str(), nullptr);
+  if (!std::isfinite(value) || value <= 0)
+    return 0;
+  return (int32)std::min(value * 1000000.0 + 0.5, 2147483647.0);
+}
+
+bool MetadataTagIO::ReadReplayGain(const TagLib::PropertyMap &pm,
+                                   ReplayGainInfo &out) {
+  out = ReplayGainInfo();
+  int32 gain = 0;
+  if (_parseGain(_getTL(pm, {"REPLAYGAIN_TRACK_GAIN"}), 1.0, 0.0, gain) ||
+      // Opus: Q7.8 dB relative to -23 LUFS, 5 dB below ReplayGain.
+      _parseGain(_getTL(pm, {"R128_TRACK_GAIN"}), 1.0 / 256.0, 5.0, gain)) {
+    out.trackGain = gain;
+    out.trackPeak = _parsePeak(_getTL(pm, {"REPLAYGAIN_TRACK_PEAK"}));
+    if (out.trackPeak == 0)
+      out.trackPeak = 1000000;
+  }
+  if (_parseGain(_getTL(pm, {"REPLAYGAIN_ALBUM_GAIN"}), 1.0, 0.0, gain) ||
+      _parseGain(_getTL(pm, {"R128_ALBUM_GAIN"}), 1.0 / 256.0, 5.0, gain)) {
+    out.albumGain = gain;
+    out.albumPeak = _parsePeak(_getTL(pm, {"REPLAYGAIN_ALBUM_PEAK"}));
+    if (out.albumPeak == 0)
+      out.albumPeak = 1000000;
+  }
+  return out.HasTrack();
+}
+
+static bool _readFloatAttr(BNode &node, const char *name, float &out) {
+  return node.ReadAttr(name, B_FLOAT_TYPE, 0, &out, sizeof(out)) ==
+             (ssize_t)sizeof(out) &&
+         std::isfinite(out);
+}
+
+bool MetadataTagIO::ReadReplayGain(const BPath &path, ReplayGainInfo &out) {
+  out = ReplayGainInfo();
+  if (path.InitCheck() != B_OK)
+    return false;
+
+  BString lower = path.Path();
+  lower.ToLower();
+  if (!lower.EndsWith(".mid") && !lower.EndsWith(".midi")) {
+    TagLib::FileRef fr(path.Path());
+    if (!fr.isNull() && fr.file() &&
+        ReadReplayGain(fr.file()->properties(), out))
+      return true;
+  }
+
+  BNode node(path.Path());
+  if (node.InitCheck() != B_OK)
+    return false;
+  float gain, peak;
+  if (_readFloatAttr(node, "BeTon:TrackGain", gain) &&
+      _readFloatAttr(node, "BeTon:TrackPeak", peak) && peak > 0) {
+    out.trackGain = (int32)std::lround(gain * 100.0f);
+    out.trackPeak = (int32)std::lround(peak * 1000000.0f);
+  }
+  if (_readFloatAttr(node, "BeTon:AlbumGain", gain) &&
+      _readFloatAttr(node, "BeTon:AlbumPeak", peak) && peak > 0) {
+    out.albumGain = (int32)std::lround(gain * 100.0f);
+    out.albumPeak = (int32)std::lround(peak * 1000000.0f);
+  }
+  return out.HasTrack();
+}
+
+static bool _writeFloatAttr(BNode &node, const char *name, float value) {
+  return node.WriteAttr(name, B_FLOAT_TYPE, 0, &value, sizeof(value)) ==
+         (ssize_t)sizeof(value);
+}
+
+bool MetadataTagIO::WriteReplayGain(const BPath &path,
+                                    const ReplayGainInfo &in) {
+  if (path.InitCheck() != B_OK || !in.HasTrack())
+    return false;
+  if (access(path.Path(), W_OK) != 0) {
+    DEBUG_PRINT("WriteReplayGain: file is read-only: %s\n", path.Path());
+    return false;
+  }
+
+  MetadataWriteTargets targets = WriteTargetsForPath(BString(path.Path()));
+  bool ok = true;
+
+  if (targets.tags) {
+    TagLib::FileRef fr(path.Path());
+    if (fr.isNull() || !fr.file()) {
+      ok = false;
+    } else {
+      TagLib::PropertyMap pm = fr.file()->properties();
+      BString value;
+      _setOrErase(pm, "REPLAYGAIN_TRACK_GAIN",
+                  value.SetToFormat("%.2f dB", in.trackGain / 100.0));
+      _setOrErase(pm, "REPLAYGAIN_TRACK_PEAK",
+                  value.SetToFormat("%.6f", in.trackPeak / 1000000.0));
+      _setOrErase(pm, "REPLAYGAIN_ALBUM_GAIN",
+                  in.HasAlbum()
+                      ? value.SetToFormat("%.2f dB", in.albumGain / 100.0)
+                      : "");
+      _setOrErase(pm, "REPLAYGAIN_ALBUM_PEAK",
+                  in.HasAlbum()
+                      ? value.SetToFormat("%.6f", in.albumPeak / 1000000.0)
+                      : "");
+      fr.file()->setProperties(pm);
+      ok &= fr.save();
+    }
+  }
+
+  if (targets.bfs && IsBeFsVolume(path)) {
+    BNode node(path.Path());
+    if (node.InitCheck() != B_OK) {
+      ok = false;
+    } else {
+      ok &= _writeFloatAttr(node, "BeTon:TrackGain", in.trackGain / 100.0f);
+      ok &= _writeFloatAttr(node, "BeTon:TrackPeak",
+                            in.trackPeak / 1000000.0f);
+      if (in.HasAlbum()) {
+        ok &= _writeFloatAttr(node, "BeTon:AlbumGain", in.albumGain / 100.0f);
+        ok &= _writeFloatAttr(node, "BeTon:AlbumPeak",
+                              in.albumPeak / 1000000.0f);
+      }
+    }
+  }
+
+  DEBUG_PRINT("write replaygain %s: %s\n", path.Path(), ok ? "OK" : "FAILED");
+  return ok;
+}
+
 MetadataWriteTargets MetadataTagIO::WriteTargetsForPath(
     const BString &filePath) {
   MusicSourceSettings src = MusicSourceSettings::GetSourceForPath(filePath);
@@ -859,6 +1419,72 @@ bool MetadataTagIO::WriteBfsAttributes(const BPath &path, const TagData &td,
   return ok;
 }
 
+bool MetadataTagIO::ReadAcoustId(const BPath &path, BString &acoustId,
+                                 BString &fingerprint) {
+  acoustId = "";
+  fingerprint = "";
+  if (path.InitCheck() != B_OK)
+    return false;
+
+  TagLib::FileRef fr(path.Path());
+  if (!fr.isNull() && fr.file()) {
+    const TagLib::PropertyMap pm = fr.file()->properties();
+    acoustId = _getStr(pm, {"ACOUSTID_ID"});
+    fingerprint = _getStr(pm, {"ACOUSTID_FINGERPRINT"});
+  }
+
+  BNode node(path.Path());
+  if (node.InitCheck() == B_OK) {
+    if (acoustId.IsEmpty())
+      node.ReadAttrString("BeTon:AcoustId", &acoustId);
+    if (fingerprint.IsEmpty())
+      node.ReadAttrString("BeTon:AcoustIdFp", &fingerprint);
+  }
+  return !acoustId.IsEmpty() || !fingerprint.IsEmpty();
+}
+
+bool MetadataTagIO::WriteAcoustId(const BPath &path, const BString &acoustId,
+                                  const BString &fingerprint) {
+  if (path.InitCheck() != B_OK || fingerprint.IsEmpty())
+    return false;
+  if (access(path.Path(), W_OK) != 0) {
+    DEBUG_PRINT("WriteAcoustId: file is read-only: %s\n", path.Path());
+    return false;
+  }
+
+  MetadataWriteTargets targets = WriteTargetsForPath(BString(path.Path()));
+  bool ok = true;
+
+  if (targets.tags) {
+    TagLib::FileRef fr(path.Path());
+    if (fr.isNull() || !fr.file()) {
+      ok = false;
+    } else {
+      TagLib::PropertyMap pm = fr.file()->properties();
+      // An ID the lookup did not confirm is left as it is.
+      if (!acoustId.IsEmpty())
+        _setOrErase(pm, "ACOUSTID_ID", acoustId);
+      _setOrErase(pm, "ACOUSTID_FINGERPRINT", fingerprint);
+      fr.file()->setProperties(pm);
+      ok &= fr.save();
+    }
+  }
+
+  if (targets.bfs && IsBeFsVolume(path)) {
+    BNode node(path.Path());
+    if (node.InitCheck() != B_OK) {
+      ok = false;
+    } else {
+      if (!acoustId.IsEmpty())
+        ok &= write_attr_str(node, "BeTon:AcoustId", acoustId);
+      ok &= write_attr_str(node, "BeTon:AcoustIdFp", fingerprint);
+    }
+  }
+
+  DEBUG_PRINT("write acoustid %s: %s\n", path.Path(), ok ? "OK" : "FAILED");
+  return ok;
+}
+
 /**
  * @brief Writes or removes embedded cover art in a supported audio file.
  */
@@ -890,28 +1516,8 @@ bool MetadataTagIO::WriteEmbeddedCover(const BPath &file, const uint8 *data,
     if (!id3)
       return false;
 
-    {
-      std::vector<TagLib::ID3v2::Frame *> toRemove;
-      const TagLib::ID3v2::FrameList &apic = id3->frameList("APIC");
-      for (auto *frame : apic) {
-        toRemove.push_back(frame);
-      }
-      for (auto *frame : toRemove) {
-        id3->removeFrame(frame, true);
-      }
-    }
-
-    if (!removeOnly) {
-      auto *pic = new TagLib::ID3v2::AttachedPictureFrame;
-      pic->setType(TagLib::ID3v2::AttachedPictureFrame::FrontCover);
-      pic->setMimeType(mime ? mime : "image/jpeg");
-      pic->setPicture(TagLib::ByteVector(reinterpret_cast<const char *>(data),
-                                         static_cast<unsigned int>(size)));
-      id3->addFrame(pic);
-    }
-
-    return f.save(TagLib::MPEG::File::AllTags, TagLib::File::StripNone,
-                  TagLib::ID3v2::v3, TagLib::File::DoNotDuplicate);
+    _setId3Cover(id3, removeOnly ? nullptr : data, size, mime);
+    return _saveMpeg(f, TagLib::ID3v2::v3, file.Path());
   }
 
   if (lower.EndsWith(".m4a") || lower.EndsWith(".mp4") ||
@@ -920,26 +1526,8 @@ bool MetadataTagIO::WriteEmbeddedCover(const BPath &file, const uint8 *data,
     if (!f.isValid() || !f.tag())
       return false;
 
-    f.tag()->removeItem("covr");
-
-    if (!removeOnly) {
-      TagLib::MP4::CoverArt::Format fmt;
-      if (mime && strcmp(mime, "image/png") == 0)
-        fmt = TagLib::MP4::CoverArt::PNG;
-      else if (mime && strcmp(mime, "image/jpeg") == 0)
-        fmt = TagLib::MP4::CoverArt::JPEG;
-      else {
-
-        return false;
-      }
-
-      TagLib::MP4::CoverArt art(
-          fmt, TagLib::ByteVector(reinterpret_cast<const char *>(data),
-                                  static_cast<unsigned int>(size)));
-      TagLib::MP4::CoverArtList list;
-      list.append(art);
-      f.tag()->setItem("covr", list);
-    }
+    if (!_setMp4Cover(f.tag(), removeOnly ? nullptr : data, size, mime))
+      return false;
     return f.save();
   }
 
@@ -948,22 +1536,8 @@ bool MetadataTagIO::WriteEmbeddedCover(const BPath &file, const uint8 *data,
     if (!f.isValid())
       return false;
 
-    const TagLib::List<TagLib::FLAC::Picture *> &pics = f.pictureList();
-    for (unsigned int i = 0; i < pics.size(); ++i)
-      f.removePicture(pics[i]);
-
-    if (!removeOnly) {
-      auto *pic = new TagLib::FLAC::Picture;
-      pic->setType(TagLib::FLAC::Picture::FrontCover);
-      if (mime)
-        pic->setMimeType(mime);
-      else
-        pic->setMimeType("image/jpeg");
-      pic->setData(TagLib::ByteVector(reinterpret_cast<const char *>(data),
-                                      static_cast<unsigned int>(size)));
-      f.addPicture(pic);
-    }
-    return f.save();
+    _setFlacCover(f, removeOnly ? nullptr : data, size, mime);
+    return _saveFlac(f, file.Path());
   }
 
   return false;
@@ -983,63 +1557,10 @@ bool MetadataTagIO::WriteEmbeddedCover(const BPath &file, const CoverBlob &blob,
  */
 bool MetadataTagIO::ExtractEmbeddedCover(const BPath &file, CoverBlob &outCover) {
   outCover.clear();
-  const char *p = file.Path();
-  if (!p)
-    return false;
-
-  {
-    TagLib::MPEG::File f(p);
-    if (f.isOpen()) {
-      if (TagLib::ID3v2::Tag *id3 = f.ID3v2Tag(false)) {
-        const TagLib::ID3v2::FrameList &apic = id3->frameList("APIC");
-        for (auto it = apic.begin(); it != apic.end(); ++it) {
-          if (auto *pic =
-                  dynamic_cast<TagLib::ID3v2::AttachedPictureFrame *>(*it)) {
-            const TagLib::ByteVector &bv = pic->picture();
-            if (!bv.isEmpty()) {
-              outCover.assign(bv.data(), bv.size());
-              return outCover.size() > 0;
-            }
-          }
-        }
-      }
-    }
-  }
-
-  {
-    TagLib::FLAC::File f(p);
-    if (f.isValid()) {
-      const TagLib::List<TagLib::FLAC::Picture *> &pics = f.pictureList();
-      if (!pics.isEmpty() && pics[0]) {
-        const TagLib::ByteVector &bv = pics[0]->data();
-        if (!bv.isEmpty()) {
-          outCover.assign(bv.data(), bv.size());
-          return outCover.size() > 0;
-        }
-      }
-    }
-  }
-
-  {
-    TagLib::MP4::File f(p);
-    if (f.isValid() && f.tag()) {
-      const TagLib::MP4::ItemMap &im = f.tag()->itemMap();
-      auto it = im.find("covr");
-      if (it != im.end()) {
-        const TagLib::MP4::CoverArtList list = it->second.toCoverArtList();
-        if (!list.isEmpty()) {
-          const TagLib::MP4::CoverArt &art = list.front();
-          const TagLib::ByteVector &bv = art.data();
-          if (!bv.isEmpty()) {
-            outCover.assign(bv.data(), bv.size());
-            return outCover.size() > 0;
-          }
-        }
-      }
-    }
-  }
-
-  return false;
+  FileMetadata meta;
+  ReadFile(file, kReadCover, meta);
+  outCover.bytes.swap(meta.cover.bytes);
+  return outCover.size() > 0;
 }
 
 /**
@@ -1049,67 +1570,7 @@ bool MetadataTagIO::ReadBfsAttributes(const BPath &path, TagData &out) {
   BNode node(path.Path());
   if (node.InitCheck() != B_OK)
     return false;
-
-  char buffer[512];
-  memset(buffer, 0, sizeof(buffer));
-  int32 intVal;
-
-  if (node.ReadAttr("Media:Title", B_STRING_TYPE, 0, buffer, sizeof(buffer)) >
-      0) {
-    out.title = buffer;
-    _trimBString(out.title);
-  }
-
-  if (node.ReadAttr("Audio:Artist", B_STRING_TYPE, 0, buffer, sizeof(buffer)) >
-      0) {
-    out.artist = buffer;
-    _trimBString(out.artist);
-  }
-
-  if (node.ReadAttr("Audio:Album", B_STRING_TYPE, 0, buffer, sizeof(buffer)) >
-      0) {
-    out.album = buffer;
-    _trimBString(out.album);
-  }
-
-  if (node.ReadAttr("Media:Genre", B_STRING_TYPE, 0, buffer, sizeof(buffer)) >
-      0) {
-    out.genre = buffer;
-    _trimBString(out.genre);
-  } else if (node.ReadAttr("Audio:Genre", B_STRING_TYPE, 0, buffer,
-                           sizeof(buffer)) > 0) {
-    out.genre = buffer;
-    _trimBString(out.genre);
-  }
-
-  if (node.ReadAttr("Media:Comment", B_STRING_TYPE, 0, buffer, sizeof(buffer)) >
-      0) {
-    out.comment = buffer;
-    _trimBString(out.comment);
-  }
-
-  if (node.ReadAttr("Media:Year", B_INT32_TYPE, 0, &intVal, sizeof(intVal)) > 0)
-    out.year = static_cast<uint32>(intVal);
-
-  if (node.ReadAttr("Audio:Track", B_INT32_TYPE, 0, &intVal, sizeof(intVal)) >
-      0)
-    out.track = static_cast<uint32>(intVal);
-
-  if (node.ReadAttr("Media:Length", B_INT32_TYPE, 0, &intVal,
-                    sizeof(intVal)) > 0)
-    out.lengthSec = static_cast<uint32>(intVal);
-
-  if (node.ReadAttr("Audio:Bitrate", B_INT32_TYPE, 0, &intVal,
-                    sizeof(intVal)) > 0)
-    out.bitrate = static_cast<uint32>(intVal);
-
-  if (node.ReadAttr("Media:Rating", B_INT32_TYPE, 0, &intVal, sizeof(intVal)) >
-      0) {
-    if (intVal >= 1 && intVal <= 10)
-      out.rating = static_cast<uint32>(intVal);
-  }
-
-  return true;
+  return _readBfs(node, out);
 }
 
 /**
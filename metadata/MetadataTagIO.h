@@ -133,6 +133,56 @@ struct CoverBlob {
   size_t size() const { return bytes.size(); }
 };
 
+/**
+ * @struct ReplayGainInfo
+ * @brief ReplayGain values in the units of MediaItem: gains in hundredths
+ * of a dB, peaks in millionths of full scale, 0 peak = not present.
+ */
+struct ReplayGainInfo {
+  int32 trackGain = 0;
+  int32 trackPeak = 0;
+  int32 albumGain = 0;
+  int32 albumPeak = 0;
+
+  bool HasTrack() const { return trackPeak > 0; }
+  bool HasAlbum() const { return albumPeak > 0; }
+};
+
+namespace TagLib {
+class PropertyMap;
+}
+
+/**
+ * @brief Parts of a file MetadataTagIO::ReadFile() reads; combine with |.
+ */
+enum MetadataReadFields : uint32 {
+  kReadTags = 1 << 0,            ///< Tag fields, MusicBrainz IDs, rating
+  kReadAudioProperties = 1 << 1, ///< Length, bitrate, sample rate, channels
+  kReadBfs = 1 << 2,             ///< BFS attributes
+  kReadCover = 1 << 3,           ///< Embedded cover bytes
+  kReadReplayGain = 1 << 4,      ///< ReplayGain from the tag properties
+  /// With kReadAudioProperties: estimated from the headers only, for files
+  /// whose exact duration is known already
+  kReadFastAudioProperties = 1 << 5,
+};
+
+/**
+ * @struct FileMetadata
+ * @brief Everything ReadFile() read from one file.
+ */
+struct FileMetadata {
+  /// From the tags; with kReadBfs, empty fields are filled from the
+  /// attributes as ReadTags() does.
+  TagData tags;
+  TagData bfs;           ///< The BFS attributes alone
+  bool hasTags = false;  ///< `tags` holds anything read
+  bool hasBfs = false;   ///< The attributes could be read
+  CoverBlob cover;
+  ReplayGainInfo replayGain;
+  bigtime_t bfsTime = 0;   ///< Spent reading the attributes
+  bigtime_t parseTime = 0; ///< Spent in TagLib
+};
+
 /**
  * @struct MetadataWriteTargets
  * @brief Describes where editable text metadata should be written.
@@ -164,6 +214,58 @@ bool ReadTags(const BPath &path, TagData &out);
  */
 bool ReadBfsAttributes(const BPath &path, TagData &out);
 
+/**
+ * @brief Reads the parts of a file selected by `fields` in one pass.
+ *
+ * The file is opened once: the attributes come from its node and TagLib
+ * parses the same descriptor, so tags, audio properties, ReplayGain and
+ * the cover cost one open and one parse instead of one each. Audio
+ * properties are only computed when asked for.
+ *
+ * @param fields MetadataReadFields.
+ * @return True if anything was read.
+ */
+bool ReadFile(const BPath &path, uint32 fields, FileMetadata &out);
+
+/**
+ * @brief Reads ReplayGain values from tag properties.
+ *
+ * Understands `REPLAYGAIN_TRACK_GAIN`/`_PEAK`, `REPLAYGAIN_ALBUM_GAIN`/`_PEAK`
+ * and the Opus `R128_TRACK_GAIN`/`R128_ALBUM_GAIN`. A gain without a peak
+ * gets a full-scale peak.
+ * @return True if at least a track gain was found.
+ */
+bool ReadReplayGain(const TagLib::PropertyMap &props, ReplayGainInfo &out);
+
+/**
+ * @brief Reads ReplayGain values from the tags of `path`, falling back to
+ * the `BeTon:*Gain`/`BeTon:*Peak` BFS attributes.
+ */
+bool ReadReplayGain(const BPath &path, ReplayGainInfo &out);
+
+/**
+ * @brief Stores ReplayGain values in the places WriteTargetsForPath()
+ * selects for `path`: `REPLAYGAIN_*` tags and/or BFS attributes.
+ * @return True if every selected target was written.
+ */
+bool WriteReplayGain(const BPath &path, const ReplayGainInfo &in);
+
+/**
+ * @brief Reads the AcoustID and Chromaprint fingerprint of `path` from the
+ * `ACOUSTID_ID`/`ACOUSTID_FINGERPRINT` tags, falling back to the
+ * `BeTon:AcoustId`/`BeTon:AcoustIdFp` BFS attributes.
+ * @return True if either was found.
+ */
+bool ReadAcoustId(const BPath &path, BString &acoustId, BString &fingerprint);
+
+/**
+ * @brief Stores a fingerprint, and the AcoustID it was matched to if not
+ * empty, in the places WriteTargetsForPath() selects for `path`.
+ * @return True if every selected target was written.
+ */
+bool WriteAcoustId(const BPath &path, const BString &acoustId,
+                   const BString &fingerprint);
+
 /**
  * @brief Merges metadata from two sources based on conflict mode.
  * @param primary Primary metadata source.
@@ -220,6 +322,15 @@ bool WriteEmbeddedCover(const BPath &file, const CoverBlob &blob,
 bool WriteTagsToFile(const BPath &path, const TagData &td,
                      const CoverBlob *coverOpt);
 
+/**
+ * @brief Tells whether a write on this thread since the last call had to
+ * move the audio data, rewriting the rest of the file.
+ *
+ * MP3 and FLAC tags are rewritten in place when they fit their old space;
+ * when they do not, room for later edits is reserved in the same rewrite.
+ */
+bool TakeFullRewrite();
+
 /**
  * @brief Writes only metadata tags to the file.
  * @param path The path to the audio file.
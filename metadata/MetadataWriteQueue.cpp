@@ -0,0 +1,199 @@
+#include "MetadataWriteQueue.h"
+
+#include "Debug.h"
+#include "Messages.h"
+
+#include <Autolock.h>
+#include <Catalog.h>
+
+#include <algorithm>
+#include <sys/stat.h>
+
+#undef B_TRANSLATION_CONTEXT
+#define B_TRANSLATION_CONTEXT "MetadataWriteQueue"
+
+MetadataWriteQueue::MetadataWriteQueue()
+    : fDone(create_sem(0, "metadata writes done")),
+      fPending(MSG_MEDIA_ITEMS_UPDATED) {}
+
+MetadataWriteQueue::~MetadataWriteQueue() {
+  if (fDone >= 0)
+    delete_sem(fDone);
+}
+
+void MetadataWriteQueue::AddTarget(const BMessenger &target) {
+  if (target.IsValid())
+    fTargets.push_back(target);
+}
+
+void MetadataWriteQueue::Add(const BString &path, PrepareFunc prepare,
+                             WriteFunc write) {
+  fJobs.push_back({path, std::move(prepare), std::move(write)});
+}
+
+int32 MetadataWriteQueue::Run() {
+  const int32 total = (int32)fJobs.size();
+  fFailed.clear();
+  fRewritten = 0;
+  if (total == 0)
+    return 0;
+
+  fNext.store(0);
+  std::vector<thread_id> workers;
+  for (int32 i = 0; i < std::min(kMaxWorkers, total); i++) {
+    thread_id thread =
+        spawn_thread(_WorkerEntry, "metadata writer", B_NORMAL_PRIORITY, this);
+    if (thread < 0)
+      break;
+    workers.push_back(thread);
+    resume_thread(thread);
+  }
+  // Without a worker the jobs run here, and are reported at the end.
+  if (workers.empty())
+    _Work();
+
+  int32 done = 0;
+  bigtime_t lastFlush = system_time();
+  while (done < total) {
+    status_t status =
+        acquire_sem_etc(fDone, 1, B_RELATIVE_TIMEOUT, kFlushInterval);
+    if (status == B_OK)
+      done++;
+    else if (status != B_TIMED_OUT && status != B_INTERRUPTED)
+      break;
+    if (system_time() - lastFlush >= kFlushInterval) {
+      _Flush(done);
+      lastFlush = system_time();
+    }
+  }
+
+  for (thread_id thread : workers) {
+    status_t exitValue;
+    wait_for_thread(thread, &exitValue);
+  }
+  _Flush(done);
+
+  DEBUG_PRINT("MetadataWriteQueue: %ld files written, %zu failed, %ld "
+              "rewritten in full\n",
+              (long)(total - (int32)fFailed.size()), fFailed.size(),
+              (long)fRewritten);
+  if (fRewritten > 0 && fStatusTarget.IsValid()) {
+    BString text;
+    text.SetToFormat(B_TRANSLATE("Tags written, %ld files had to be "
+                                 "rewritten in full."),
+                     (long)fRewritten);
+    BMessage status(MSG_STATUS_UPDATE);
+    status.AddString("text", text);
+    fStatusTarget.SendMessage(&status);
+  }
+  fJobs.clear();
+  return (int32)fFailed.size();
+}
+
+int32 MetadataWriteQueue::_WorkerEntry(void *arg) {
+  static_cast<MetadataWriteQueue *>(arg)->_Work();
+  return 0;
+}
+
+void MetadataWriteQueue::_Work() {
+  for (;;) {
+    int32 index = fNext.fetch_add(1);
+    if (index >= (int32)fJobs.size())
+      break;
+    _RunJob(fJobs[index]);
+    release_sem(fDone);
+  }
+}
+
+void MetadataWriteQueue::_RunJob(const Job &job) {
+  TagData td;
+  bool ok = false;
+  bool rewritten = false;
+  try {
+    ok = job.prepare(job.path, td);
+    if (ok) {
+      BAutolock deviceLock(_DeviceLock(job.path));
+      MetadataTagIO::TakeFullRewrite();
+      ok = job.write(job.path, td);
+      rewritten = MetadataTagIO::TakeFullRewrite();
+    }
+  } catch (...) {
+    DEBUG_PRINT("MetadataWriteQueue: exception writing %s\n",
+                job.path.String());
+    ok = false;
+  }
+
+  BAutolock lock(&fLock);
+  if (rewritten)
+    fRewritten++;
+  if (!ok) {
+    fFailed.push_back(job.path);
+    return;
+  }
+  BMessage update(MSG_MEDIA_ITEM_FOUND);
+  update.AddString("path", job.path);
+  AddTagData(update, td);
+  fPending.AddMessage("item", &update);
+}
+
+BLocker *MetadataWriteQueue::_DeviceLock(const BString &path) {
+  struct stat st;
+  dev_t device = stat(path.String(), &st) == 0 ? st.st_dev : -1;
+
+  BAutolock lock(&fLock);
+  std::unique_ptr<BLocker> &deviceLock = fDeviceLocks[device];
+  if (!deviceLock)
+    deviceLock.reset(new BLocker("metadata device writes"));
+  return deviceLock.get();
+}
+
+/**
+ * @brief Sends the updates collected since the last flush and the progress.
+ */
+void MetadataWriteQueue::_Flush(int32 done) {
+  BMessage batch(MSG_MEDIA_ITEMS_UPDATED);
+  {
+    BAutolock lock(&fLock);
+    batch = fPending;
+    fPending.MakeEmpty();
+  }
+  if (batch.HasMessage("item")) {
+    for (const BMessenger &target : fTargets)
+      target.SendMessage(&batch);
+  }
+
+  if (fStatusTarget.IsValid()) {
+    BString text(B_TRANSLATE("Writing tags: %current% of %total%"));
+    BString current, total;
+    current << done;
+    total << (int32)fJobs.size();
+    text.ReplaceFirst("%current%", current);
+    text.ReplaceFirst("%total%", total);
+    BMessage status(MSG_STATUS_UPDATE);
+    status.AddString("text", text);
+    fStatusTarget.SendMessage(&status);
+  }
+}
+
+void MetadataWriteQueue::AddTagData(BMessage &update, const TagData &td) {
+  update.AddString("title", td.title);
+  update.AddString("artist", td.artist);
+  update.AddString("album", td.album);
+  update.AddString("genre", td.genre);
+  update.AddString("comment", td.comment);
+  update.AddString("albumArtist", td.albumArtist);
+  update.AddString("composer", td.composer);
+  update.AddString("mbAlbumID", td.mbAlbumID);
+  update.AddString("mbArtistID", td.mbArtistID);
+  update.AddString("mbTrackID", td.mbTrackID);
+  update.AddInt32("year", td.year);
+  update.AddInt32("track", td.track);
+  update.AddInt32("trackTotal", td.trackTotal);
+  update.AddInt32("disc", td.disc);
+  update.AddInt32("discTotal", td.discTotal);
+  update.AddInt32("duration", td.lengthSec);
+  update.AddInt32("bitrate", td.bitrate);
+  update.AddInt32("sampleRate", td.sampleRate);
+  update.AddInt32("channels", td.channels);
+  update.AddInt32("rating", td.rating);
+}
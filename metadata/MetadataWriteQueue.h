@@ -0,0 +1,100 @@
+#ifndef BETON_METADATA_WRITE_QUEUE_H
+#define BETON_METADATA_WRITE_QUEUE_H
+
+#include "MetadataTagIO.h"
+
+#include <Locker.h>
+#include <Message.h>
+#include <Messenger.h>
+#include <OS.h>
+#include <String.h>
+#include <atomic>
+#include <functional>
+#include <map>
+#include <memory>
+#include <vector>
+
+/**
+ * @class MetadataWriteQueue
+ * @brief Writes the tags of many files on a small worker pool and reports
+ * the results in coalesced messages.
+ *
+ * Each job reads its file and works out the new values (`prepare`), then
+ * writes them (`write`). Up to kMaxWorkers jobs run at once, but the writes
+ * to one device are done one at a time: the reading of the next file
+ * overlaps the writing of the last, while the disk is not made to seek
+ * between files written in parallel.
+ *
+ * Run() blocks the calling thread until all jobs are done. Every
+ * kFlushInterval the updates of the files written so far go to the targets
+ * as one `MSG_MEDIA_ITEMS_UPDATED`, with a `MSG_MEDIA_ITEM_FOUND` per file
+ * as "item", and the status target gets the progress. Failed files are
+ * collected for the caller to report once; files whose tags no longer fit
+ * and that were rewritten in full are counted and reported at the end.
+ *
+ * Files are written in place: their inode, and with it their BFS
+ * attributes and their place in the library, stays the same.
+ */
+class MetadataWriteQueue {
+public:
+  static constexpr int32 kMaxWorkers = 4;
+  static constexpr bigtime_t kFlushInterval = 250000;
+
+  /** @brief Reads `path` into `td` and applies the changes; runs on any worker. */
+  typedef std::function<bool(const BString &path, TagData &td)> PrepareFunc;
+  /** @brief Writes `td` to `path`; one at a time per device. */
+  typedef std::function<bool(const BString &path, const TagData &td)>
+      WriteFunc;
+
+  MetadataWriteQueue();
+  ~MetadataWriteQueue();
+
+  /** @brief Adds a receiver of the `MSG_MEDIA_ITEMS_UPDATED` messages. */
+  void AddTarget(const BMessenger &target);
+
+  /** @brief Receives the progress as `MSG_STATUS_UPDATE`. */
+  void SetStatusTarget(const BMessenger &target) { fStatusTarget = target; }
+
+  void Add(const BString &path, PrepareFunc prepare, WriteFunc write);
+
+  /**
+   * @brief Runs all jobs added so far and waits for them.
+   * @return Number of files that could not be written.
+   */
+  int32 Run();
+
+  /** @brief Files whose prepare or write step failed in Run(). */
+  const std::vector<BString> &Failed() const { return fFailed; }
+
+  /** @brief Adds the fields of `td` to a `MSG_MEDIA_ITEM_FOUND` update. */
+  static void AddTagData(BMessage &update, const TagData &td);
+
+private:
+  struct Job {
+    BString path;
+    PrepareFunc prepare;
+    WriteFunc write;
+  };
+
+  static int32 _WorkerEntry(void *arg);
+  void _Work();
+  void _RunJob(const Job &job);
+  /** @brief Lock serializing the writes to the device of `path`. */
+  BLocker *_DeviceLock(const BString &path);
+  void _Flush(int32 done);
+
+  std::vector<Job> fJobs;
+  std::atomic<int32> fNext{0};
+  sem_id fDone;
+
+  BLocker fLock{"metadata write queue"}; ///< Guards the fields below
+  std::map<dev_t, std::unique_ptr<BLocker>> fDeviceLocks;
+  BMessage fPending;
+  std::vector<BString> fFailed;
+  int32 fRewritten = 0;
+
+  std::vector<BMessenger> fTargets;
+  BMessenger fStatusTarget;
+};
+
+#endif // BETON_METADATA_WRITE_QUEUE_H
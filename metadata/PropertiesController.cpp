@@ -17,6 +17,7 @@
 #include <File.h>
 #include <unistd.h>
 #include <Entry.h>
+#include <map>
 #include <vector>
 
 #undef B_TRANSLATION_CONTEXT
@@ -34,23 +35,24 @@ PropertiesController::~PropertiesController() {
  * @param msg The pending MSG_PROP_SAVE message.
  *
  * For every file in the message, the current library values of the
- * fields being changed are packed into a replay MSG_PROP_SAVE that
- * restores them. Skipped entirely when the save is itself a replay.
+ * fields being changed are packed as a "diff" into a single replay
+ * MSG_PROP_SAVE, so undoing a bulk edit is one compact record and one
+ * write job. Skipped entirely when the save is itself a replay.
  */
 void PropertiesController::_RecordUndoForPropertySave(BMessage *msg) {
   if (msg->HasBool("undo_replay") || !fWindow->fUndoManager)
     return;
 
-  std::vector<BMessage> undoMsgs;
+  BMessage undo(MSG_PROP_SAVE);
+  bool anyFile = false;
   BString file;
   for (int32 i = 0; msg->FindString("file", i, &file) == B_OK; ++i) {
-    auto it = fWindow->fPathIndex.find(file);
-    if (it == fWindow->fPathIndex.end())
+    size_t index = fWindow->fPathIndex.Find(file);
+    if (index == MediaPathIndex::kNotFound)
       continue;
-    const MediaItem &old = fWindow->fAllItems[it->second];
+    const MediaItem &old = fWindow->fAllItems[index];
 
-    BMessage u(MSG_PROP_SAVE);
-    u.AddString("file", file);
+    BMessage u;
     bool any = false;
 
     auto addOld = [&](const char *field, const BString &val) {
@@ -89,13 +91,15 @@ void PropertiesController::_RecordUndoForPropertySave(BMessage *msg) {
       any = true;
     }
 
-    if (any)
-      undoMsgs.push_back(u);
+    if (any) {
+      undo.AddString("file", file);
+      undo.AddMessage("diff", &u);
+      anyFile = true;
+    }
   }
 
-  if (!undoMsgs.empty())
-    fWindow->fUndoManager->RecordAction(std::move(undoMsgs),
-                                        {BMessage(*msg)});
+  if (anyFile)
+    fWindow->fUndoManager->RecordAction({undo}, {BMessage(*msg)});
 }
 
 /**
@@ -115,14 +119,14 @@ void PropertiesController::SavePropertyTags(BMessage *msg) {
 
   auto *copy = new BMessage(*msg);
   MetadataService *metadataHandler = fWindow->fMetadataService;
-  thread_id thread = fWindow->LaunchThread("save property tags",
-      [metadataHandler, copy]() {
+  BReference<WorkerJob> job = fWindow->QueueJob(
+      kLaneBackground, "save property tags", [metadataHandler, copy]() {
         if (metadataHandler)
           metadataHandler->SaveTags(copy);
         delete copy;
       });
 
-  if (thread < 0) {
+  if (job.Get() == nullptr) {
     if (metadataHandler)
       metadataHandler->SaveTags(msg);
     delete copy;
@@ -210,13 +214,13 @@ void PropertiesController::OpenMetadataPropertiesWindow(BMessage *msg) {
     preloadedItems.reserve(files.size());
     bool haveAllPreloaded = true;
     for (const auto &path : files) {
-      auto it = fWindow->fPathIndex.find(path.Path());
-      if (it == fWindow->fPathIndex.end() ||
-          it->second >= fWindow->fAllItems.size()) {
+      size_t index = fWindow->fPathIndex.Find(path.Path());
+      if (index == MediaPathIndex::kNotFound ||
+          index >= fWindow->fAllItems.Count()) {
         haveAllPreloaded = false;
         break;
       }
-      preloadedItems.push_back(fWindow->fAllItems[it->second]);
+      preloadedItems.push_back(fWindow->fAllItems[index]);
     }
 
     if (haveAllPreloaded)
@@ -242,22 +246,25 @@ void PropertiesController::SetRating(BMessage *msg) {
   if (msg->FindMessage("files", &files) != B_OK)
     return;
 
-  // Record per-file old ratings as an undo action (skip replays).
+  // Record the old ratings as an undo action (skip replays). Files are
+  // grouped by old rating, so a bulk change undoes with at most 11 messages.
   if (!msg->HasBool("undo_replay") && fWindow->fUndoManager) {
-    std::vector<BMessage> undoMsgs;
+    std::map<int32, BMessage> byRating;
     entry_ref undoRef;
     for (int32 i = 0; files.FindRef("refs", i, &undoRef) == B_OK; i++) {
       BPath p(&undoRef);
       if (p.InitCheck() != B_OK)
         continue;
-      auto it = fWindow->fPathIndex.find(p.Path());
-      if (it == fWindow->fPathIndex.end())
+      size_t index = fWindow->fPathIndex.Find(p.Path());
+      if (index == MediaPathIndex::kNotFound)
         continue;
+      byRating[fWindow->fAllItems[index].rating].AddRef("refs", &undoRef);
+    }
+    std::vector<BMessage> undoMsgs;
+    for (const auto &group : byRating) {
       BMessage u(MSG_SET_RATING);
-      u.AddInt32("rating", fWindow->fAllItems[it->second].rating);
-      BMessage uf;
-      uf.AddRef("refs", &undoRef);
-      u.AddMessage("files", &uf);
+      u.AddInt32("rating", group.first);
+      u.AddMessage("files", &group.second);
       undoMsgs.push_back(u);
     }
     if (!undoMsgs.empty())
@@ -295,9 +302,9 @@ void PropertiesController::SetRating(BMessage *msg) {
         // but without going through HandleMediaItemFound (which normalizes
         // the path and can create a duplicate item triggering a full rebuild).
         BString pathStr(path.Path());
-        auto mapIt = fWindow->fPathIndex.find(pathStr);
-        if (mapIt != fWindow->fPathIndex.end()) {
-          MediaItem &mi = fWindow->fAllItems[mapIt->second];
+        size_t index = fWindow->fPathIndex.Find(pathStr);
+        if (index != MediaPathIndex::kNotFound) {
+          MediaItem &mi = fWindow->fAllItems.Mutable()[index];
           mi.rating = rating;
 
           // Replicate exactly what MetadataService::SaveTags does after a
@@ -0,0 +1,201 @@
+#include "PropertiesTagLoader.h"
+#include "Debug.h"
+#include "EmbeddedCoverCache.h"
+#include "Messages.h"
+
+#include <Message.h>
+
+PropertiesTagLoader::PropertiesTagLoader(const BMessenger &target)
+    : fTarget(target), fGeneration(0), fThread(-1), fCancel(false) {}
+
+PropertiesTagLoader::~PropertiesTagLoader() { Cancel(); }
+
+status_t PropertiesTagLoader::Start(const std::vector<BPath> &files,
+                                    const std::vector<MediaItem> &preloaded,
+                                    int32 generation) {
+  Cancel();
+
+  fFiles = files;
+  fPreloaded = preloaded;
+  fGeneration = generation;
+  fCancel = false;
+  fThread = spawn_thread(_ThreadEntry, "PropertiesTagLoader",
+                         B_NORMAL_PRIORITY, this);
+  if (fThread < 0) {
+    status_t status = fThread;
+    fThread = -1;
+    return status;
+  }
+  return resume_thread(fThread);
+}
+
+void PropertiesTagLoader::Cancel() {
+  fCancel = true;
+  if (fThread >= 0) {
+    status_t result;
+    wait_for_thread(fThread, &result);
+    fThread = -1;
+  }
+}
+
+int32 PropertiesTagLoader::_ThreadEntry(void *data) {
+  static_cast<PropertiesTagLoader *>(data)->_Run();
+  return 0;
+}
+
+void PropertiesTagLoader::_Send(BMessage &batch) {
+  // A timeout keeps Cancel() from deadlocking against a full window port.
+  for (;;) {
+    status_t status = fTarget.SendMessage(&batch, (BHandler *)nullptr,
+                                          kSendTimeout);
+    if ((status != B_TIMED_OUT && status != B_WOULD_BLOCK) || fCancel)
+      return;
+  }
+}
+
+void PropertiesTagLoader::_AddTags(BMessage &batch, const TagData &tags) {
+  batch.AddString("title", tags.title);
+  batch.AddString("artist", tags.artist);
+  batch.AddString("album", tags.album);
+  batch.AddString("albumArtist", tags.albumArtist);
+  batch.AddString("composer", tags.composer);
+  batch.AddString("genre", tags.genre);
+  batch.AddString("comment", tags.comment);
+  batch.AddString("mbTrackID", tags.mbTrackID);
+  batch.AddString("mbAlbumID", tags.mbAlbumID);
+  batch.AddInt32("year", (int32)tags.year);
+  batch.AddInt32("track", (int32)tags.track);
+  batch.AddInt32("tracktotal", (int32)tags.trackTotal);
+  batch.AddInt32("disc", (int32)tags.disc);
+  batch.AddInt32("disctotal", (int32)tags.discTotal);
+  batch.AddInt32("rating", (int32)tags.rating);
+}
+
+void PropertiesTagLoader::FindTags(const BMessage *batch, int32 index,
+                                   TagData &out) {
+  auto str = [&](const char *name, BString &value) {
+    if (batch->FindString(name, index, &value) != B_OK)
+      value.Truncate(0);
+  };
+  auto num = [&](const char *name, uint32 &value) {
+    int32 v = 0;
+    batch->FindInt32(name, index, &v);
+    value = (uint32)v;
+  };
+
+  str("title", out.title);
+  str("artist", out.artist);
+  str("album", out.album);
+  str("albumArtist", out.albumArtist);
+  str("composer", out.composer);
+  str("genre", out.genre);
+  str("comment", out.comment);
+  str("mbTrackID", out.mbTrackID);
+  str("mbAlbumID", out.mbAlbumID);
+  num("year", out.year);
+  num("track", out.track);
+  num("tracktotal", out.trackTotal);
+  num("disc", out.disc);
+  num("disctotal", out.discTotal);
+  num("rating", out.rating);
+}
+
+void PropertiesTagLoader::_Run() {
+  bigtime_t t0 = system_time();
+  const size_t count = fFiles.size();
+
+  // Covers are only compared for small selections; larger ones count as
+  // mixed and only the first file's cover is read. Equal covers have equal
+  // hashes (see EmbeddedCoverCache).
+  const bool compareCovers = count <= 8;
+  bool coverMixed = false;
+  std::shared_ptr<const CoverBlob> firstCover;
+  uint64 firstHash = 0;
+
+  BMessage batch(MSG_PROP_TAGS_LOADED);
+  int32 batchCount = 0;
+  size_t batchFirst = 0;
+
+  for (size_t index = 0; index < count; ++index) {
+    if (fCancel)
+      return;
+
+    const BPath &path = fFiles[index];
+    const bool wantCover = (compareCovers || index == 0) && !coverMixed;
+    TagData td;
+    std::shared_ptr<const CoverBlob> cover;
+    uint64 hash = 0;
+    if (index < fPreloaded.size() && fPreloaded[index].path == path.Path()) {
+      const MediaItem &mi = fPreloaded[index];
+      td.title = mi.title;
+      td.artist = mi.artist;
+      td.album = mi.album;
+      td.albumArtist = mi.albumArtist;
+      td.composer = mi.composer;
+      td.genre = mi.genre;
+      td.comment = mi.comment;
+      td.year = mi.year;
+      td.track = mi.track;
+      td.trackTotal = mi.trackTotal;
+      td.disc = mi.disc;
+      td.discTotal = mi.discTotal;
+      td.rating = mi.rating;
+      td.mbTrackID = mi.mbTrackId;
+      td.mbAlbumID = mi.mbAlbumId;
+      if (wantCover)
+        cover = EmbeddedCoverCache::Default().Get(path.Path(), &hash);
+    } else {
+      // Tags and cover from one open of the file.
+      FileMetadata meta;
+      MetadataTagIO::ReadFile(
+          path, kReadTags | kReadBfs | (wantCover ? kReadCover : 0), meta);
+      td = meta.tags;
+      if (wantCover)
+        cover = EmbeddedCoverCache::Default().Put(path.Path(), meta.cover,
+                                                  &hash);
+    }
+
+    if (wantCover) {
+      if (cover) {
+        if (!firstCover) {
+          firstCover = cover;
+          firstHash = hash;
+        } else if (hash != firstHash) {
+          coverMixed = true;
+        }
+      } else if (compareCovers && firstCover) {
+        coverMixed = true;
+      }
+    }
+
+    if (batchCount == 0)
+      batchFirst = index;
+    _AddTags(batch, td);
+    if (++batchCount < kBatchSize && index + 1 < count)
+      continue;
+
+    batch.AddInt32("generation", fGeneration);
+    batch.AddInt32("first", (int32)batchFirst);
+    if (index + 1 == count) {
+      batch.AddBool("done", true);
+      batch.AddBool("cover_mixed", coverMixed || !compareCovers);
+      if (firstCover)
+        batch.AddData("cover", B_RAW_TYPE, firstCover->data(),
+                      firstCover->size());
+    }
+    _Send(batch);
+    batch.MakeEmpty();
+    batchCount = 0;
+  }
+
+  if (count == 0) {
+    batch.AddInt32("generation", fGeneration);
+    batch.AddInt32("first", 0);
+    batch.AddBool("done", true);
+    batch.AddBool("cover_mixed", false);
+    _Send(batch);
+  }
+
+  DEBUG_PRINT("[PropertiesTagLoader] %zu files in %" B_PRIdBIGTIME " us\n",
+              count, system_time() - t0);
+}
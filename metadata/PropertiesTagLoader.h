@@ -0,0 +1,67 @@
+#ifndef BETON_PROPERTIES_TAG_LOADER_H
+#define BETON_PROPERTIES_TAG_LOADER_H
+
+#include "MediaItem.h"
+#include "MetadataTagIO.h"
+
+#include <Messenger.h>
+#include <OS.h>
+#include <Path.h>
+#include <atomic>
+#include <vector>
+
+/**
+ * @class PropertiesTagLoader
+ * @brief Reads the tags of a multi-file selection off the window thread.
+ *
+ * Results are sent to the target as `MSG_PROP_TAGS_LOADED` in batches of
+ * `kBatchSize` files, so the properties window can open at once and fold
+ * values into its mixed-value summary as they arrive. Each batch carries
+ * "generation", "first" (index of its first file) and one value per file
+ * for every tag field (see FindTags()). The last batch has "done" set and,
+ * if a common cover was found, its undecoded bytes as "cover"; "cover_mixed"
+ * tells whether the files disagree.
+ *
+ * Items from the library cache are used instead of reading the file when
+ * their path matches.
+ */
+class PropertiesTagLoader {
+public:
+  static constexpr int32 kBatchSize = 32;
+
+  explicit PropertiesTagLoader(const BMessenger &target);
+  ~PropertiesTagLoader();
+
+  /**
+   * @brief Starts loading `files`; cancels a load still in progress.
+   * @param generation Echoed in every batch so stale ones can be dropped.
+   * @return B_OK, or the error from spawning the thread.
+   */
+  status_t Start(const std::vector<BPath> &files,
+                 const std::vector<MediaItem> &preloaded, int32 generation);
+
+  /** @brief Stops the current load and waits for its thread. */
+  void Cancel();
+
+  /** @brief Reads the tags of file `index` of a batch message. */
+  static void FindTags(const BMessage *batch, int32 index, TagData &out);
+
+private:
+  static int32 _ThreadEntry(void *data);
+  void _Run();
+
+  static constexpr bigtime_t kSendTimeout = 100000;
+
+  /** @brief Sends `batch`, retrying while the target's queue is full. */
+  void _Send(BMessage &batch);
+  static void _AddTags(BMessage &batch, const TagData &tags);
+
+  BMessenger fTarget;
+  std::vector<BPath> fFiles;
+  std::vector<MediaItem> fPreloaded;
+  int32 fGeneration;
+  thread_id fThread;
+  std::atomic<bool> fCancel;
+};
+
+#endif // BETON_PROPERTIES_TAG_LOADER_H
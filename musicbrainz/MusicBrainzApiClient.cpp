@@ -1,15 +1,14 @@
 #include "MusicBrainzApiClient.h"
 #include "Debug.h"
+#include "HttpConnectionPool.h"
+#include "MusicBrainzQueryPool.h"
+#include "MusicBrainzRequestScheduler.h"
+#include "MusicBrainzResponseCache.h"
 
 #include <DataIO.h>
-#include <Locker.h>
+#include <Message.h>
 #include <OS.h>
 #include <String.h>
-#include <Url.h>
-#include <private/netservices/HttpRequest.h>
-#include <private/netservices/HttpResult.h>
-#include <private/netservices/UrlResult.h>
-#include <unistd.h>
 
 #include <musicbrainz5/Artist.h>
 #include <musicbrainz5/ArtistCredit.h>
@@ -25,49 +24,13 @@
 #include <musicbrainz5/TrackList.h>
 
 #include <algorithm>
-#include <atomic>
 #include <cctype>
 #include <cstdio>
 #include <cstring>
-#include <fcntl.h>
 #include <memory>
 #include <new>
 #include <stdexcept>
 
-/**
- * @class ScopedSilence
- * @brief Helper to silence libmusicbrainz5's stdout/stderr output during
- * queries.
- *
- * libmusicbrainz5 can be chatty on stderr. This class redirects stderr to
- * /dev/null within its scope, using a static lock to ensure thread safety
- * (preventing races on the global file descriptors).
- */
-class ScopedSilence {
-public:
-  ScopedSilence() {
-    fLocker.Lock();
-    fflush(stderr);
-    fOldStdErr = dup(STDERR_FILENO);
-    int devNull = open("/dev/null", O_WRONLY);
-    dup2(devNull, STDERR_FILENO);
-    close(devNull);
-  }
-
-  ~ScopedSilence() {
-    fflush(stderr);
-    dup2(fOldStdErr, STDERR_FILENO);
-    close(fOldStdErr);
-    fLocker.Unlock();
-  }
-
-private:
-  int fOldStdErr;
-  static BLocker fLocker;
-};
-
-BLocker ScopedSilence::fLocker("SilenceLocker");
-
 using namespace MusicBrainz5;
 using namespace BPrivate::Network;
 
@@ -331,116 +294,143 @@ BuildReleaseSearchQueries(const MBReleaseSearchOptions &options)
 }
 
 /**
- * @brief Runs a MusicBrainz query with a timeout in a separate thread.
- *
- * libmusicbrainz5 queries are blocking and can hang indefinitely if the network
- * stalls. This wrapper runs the query in a thread and waits with a timeout.
- *
- * @param userAgent The User-Agent string for the request.
- * @param entity The MB entity to query (e.g., "recording", "release").
- * @param id The entity ID (UUID).
- * @param resource Additional resource path (e.g., "inc").
- * @param params Query parameters.
- * @param shouldCancel Callback to check for cancellation request.
- * @return CMetadata result from the query, or empty if failed/timed out.
+ * @brief URL of a web service query; the key of its cached answer.
  */
-static CMetadata RunQueryWithTimeout(const BString &userAgent,
-                                     const std::string &entity,
-                                     const std::string &id,
-                                     const std::string &resource,
-                                     const CQuery::tParamMap &params,
-                                     std::function<bool()> shouldCancel) {
-  struct Context {
-    BString ua;
-    std::string e, i, r;
-    CQuery::tParamMap p;
-    CMetadata *result = nullptr;
-    std::string error;
-    std::atomic<bool> abandoned{false};
-  };
-
-  Context *ctx = new Context();
-  ctx->ua = userAgent;
-  ctx->e = entity;
-  ctx->i = id;
-  ctx->r = resource;
-  ctx->p = params;
-
-  thread_id tid = spawn_thread(
-      [](void *data) -> int32 {
-        Context *c = (Context *)data;
-        try {
-          ScopedSilence silence;
-          CQuery q(c->ua.String());
-          CMetadata *res = new CMetadata(q.Query(c->e, c->i, c->r, c->p));
-          if (c->abandoned.load(std::memory_order_acquire)) {
-            delete res;
-          } else {
-            c->result = res;
-          }
-        } catch (const std::exception &ex) {
-          if (!c->abandoned.load(std::memory_order_acquire))
-            c->error = ex.what();
-        } catch (...) {
-          if (!c->abandoned.load(std::memory_order_acquire))
-            c->error = "Unknown non-std exception in MusicBrainz query";
-        }
-        if (c->abandoned.load(std::memory_order_acquire)) {
-          delete c->result;
-          delete c;
-        }
-        return 0;
-      },
-      "mb_query_thread", B_NORMAL_PRIORITY, ctx);
+static BString
+QueryUrl(const char *entity, const BString &id,
+         const CQuery::tParamMap &params)
+{
+  BString url("https://musicbrainz.org/ws/2/");
+  url << entity;
+  if (!id.IsEmpty())
+    url << "/" << id;
+  const char *separator = "?";
+  for (const auto &param : params) {
+    url << separator << param.first.c_str() << "=" << param.second.c_str();
+    separator = "&";
+  }
+  return url;
+}
 
-  if (tid < 0) {
-    delete ctx;
-    return CMetadata();
+/**
+ * @class UrlClaim
+ * @brief Claims a URL with the MusicBrainzRequestScheduler while in scope, so
+ * a second thread asking for it waits and reads the cached answer.
+ */
+class UrlClaim {
+public:
+  UrlClaim(const BString &url, const std::function<bool()> &shouldCancel)
+      : fKey(MusicBrainzResponseCache::NormalizeUrl(url)),
+        fClaimed(
+            MusicBrainzRequestScheduler::Default().Claim(fKey, shouldCancel)) {}
+
+  ~UrlClaim() {
+    if (fClaimed)
+      MusicBrainzRequestScheduler::Default().Release(fKey);
   }
 
-  resume_thread(tid);
+  bool Claimed() const { return fClaimed; }
 
-  status_t exit;
+private:
+  UrlClaim(const UrlClaim &) = delete;
+  UrlClaim &operator=(const UrlClaim &) = delete;
 
-  for (int i = 0; i < 200; i++) {
-    if (shouldCancel && shouldCancel()) {
-      ctx->abandoned.store(true, std::memory_order_release);
-      return CMetadata();
-    }
-    if (wait_for_thread_etc(tid, B_RELATIVE_TIMEOUT, 100000, &exit) == B_OK) {
-      std::string err = ctx->error;
-      CMetadata *res = ctx->result;
-      delete ctx;
-
-      if (!err.empty()) {
-        delete res;
-        throw std::runtime_error(err);
-      }
-      if (res) {
-        CMetadata m = *res;
-        delete res;
-        return m;
-      }
-      return CMetadata();
-    }
+  BString fKey;
+  bool fClaimed;
+};
+
+static void
+ArchiveHits(const std::vector<MBHit> &hits, BMessage &data)
+{
+  for (const MBHit &hit : hits) {
+    BMessage item;
+    item.AddString("recordingId", hit.recordingId);
+    item.AddString("title", hit.title);
+    item.AddString("artist", hit.artist);
+    item.AddString("releaseId", hit.releaseId);
+    item.AddString("releaseTitle", hit.releaseTitle);
+    item.AddInt32("year", (int32)hit.year);
+    item.AddString("country", hit.country);
+    item.AddString("genre", hit.genre);
+    item.AddInt32("score", hit.score);
+    item.AddInt32("trackCount", hit.trackCount);
+    data.AddMessage("hit", &item);
+  }
+}
+
+static std::vector<MBHit>
+UnarchiveHits(const BMessage &data)
+{
+  std::vector<MBHit> hits;
+  BMessage item;
+  for (int32 i = 0; data.FindMessage("hit", i, &item) == B_OK; i++) {
+    MBHit hit;
+    hit.recordingId = item.GetString("recordingId", "");
+    hit.title = item.GetString("title", "");
+    hit.artist = item.GetString("artist", "");
+    hit.releaseId = item.GetString("releaseId", "");
+    hit.releaseTitle = item.GetString("releaseTitle", "");
+    hit.year = (uint32)item.GetInt32("year", 0);
+    hit.country = item.GetString("country", "");
+    hit.genre = item.GetString("genre", "");
+    hit.score = item.GetInt32("score", 0);
+    hit.trackCount = item.GetInt32("trackCount", 0);
+    hits.push_back(hit);
+  }
+  return hits;
+}
+
+static void
+ArchiveRelease(const MBRelease &release, BMessage &data)
+{
+  data.AddString("releaseGroupId", release.releaseGroupId);
+  data.AddString("album", release.album);
+  data.AddString("albumArtist", release.albumArtist);
+  data.AddInt32("year", (int32)release.year);
+  for (const MBTrack &track : release.tracks) {
+    BMessage item;
+    item.AddInt32("disc", (int32)track.disc);
+    item.AddInt32("track", (int32)track.track);
+    item.AddString("title", track.title);
+    item.AddString("recordingId", track.recordingId);
+    item.AddInt32("length", track.length);
+    data.AddMessage("track", &item);
   }
+}
 
-  ctx->abandoned.store(true, std::memory_order_release);
-  throw std::runtime_error("Timeout waiting for MusicBrainz");
+static void
+UnarchiveRelease(const BMessage &data, MBRelease &release)
+{
+  release.releaseGroupId = data.GetString("releaseGroupId", "");
+  release.album = data.GetString("album", "");
+  release.albumArtist = data.GetString("albumArtist", "");
+  release.year = (uint32)data.GetInt32("year", 0);
+  BMessage item;
+  for (int32 i = 0; data.FindMessage("track", i, &item) == B_OK; i++) {
+    MBTrack track;
+    track.disc = (uint32)item.GetInt32("disc", 1);
+    track.track = (uint32)item.GetInt32("track", 0);
+    track.title = item.GetString("title", "");
+    track.recordingId = item.GetString("recordingId", "");
+    track.length = item.GetInt32("length", 0);
+    release.tracks.push_back(track);
+  }
 }
 
 MusicBrainzApiClient::MusicBrainzApiClient(const BString &contact)
     : fContact(contact) {}
 
 /**
- * @brief Enforces MusicBrainz rate limiting (approx. 1 request per second).
+ * @brief Waits for the rate limit of the host serving `url`, at the priority
+ * of the calling thread.
+ * @return False if cancelled while waiting.
  */
-void MusicBrainzApiClient::_RespectRateLimit() {
-  bigtime_t now = system_time();
-  bigtime_t diff = now - fLastCall;
-  if (diff < 1100000) {
-    snooze(1100000 - diff);
-  }
+bool MusicBrainzApiClient::_Acquire(const BString &url,
+                                    const std::function<bool()> &shouldCancel) {
+  MusicBrainzRequestScheduler &scheduler = MusicBrainzRequestScheduler::Default();
+  return scheduler.Acquire(MusicBrainzRequestScheduler::HostFor(url),
+                           MusicBrainzRequestScheduler::CurrentPriority(),
+                           shouldCancel);
 }
 
 /**
@@ -485,6 +475,26 @@ MusicBrainzApiClient::SearchRecording(const MBRecordingSearchOptions &options,
     for (const auto &query : queries) {
       DEBUG_PRINT("Search Query: '%s'\n", query.String());
 
+      CQuery::tParamMap params;
+      params["query"] = query.String();
+      BString limit;
+      limit.SetToFormat("%ld", (long)ClampSearchLimit(options.limit));
+      params["limit"] = limit.String();
+
+      // Hits answer without waiting for the rate limit.
+      const BString url = QueryUrl("recording", "", params);
+      UrlClaim claim(url, shouldCancel);
+      if (!claim.Claimed())
+        return results;
+      BMessage cached;
+      if (MusicBrainzResponseCache::Default().Get(
+              url, MusicBrainzResponseCache::kSearchMaxAge, cached)) {
+        results = UnarchiveHits(cached);
+        if (!results.empty())
+          break;
+        continue;
+      }
+
       int retries = 3;
       while (retries > 0) {
         if (shouldCancel && shouldCancel()) {
@@ -492,17 +502,10 @@ MusicBrainzApiClient::SearchRecording(const MBRecordingSearchOptions &options,
           return results;
         }
         try {
-
-          CQuery::tParamMap params;
-          params["query"] = query.String();
-          BString limit;
-          limit.SetToFormat("%ld", (long)ClampSearchLimit(options.limit));
-          params["limit"] = limit.String();
-
-          _RespectRateLimit();
-          fLastCall = system_time();
-          meta =
-              RunQueryWithTimeout(ua, "recording", "", "", params, shouldCancel);
+          if (!_Acquire(url, shouldCancel))
+            return results;
+          meta = MusicBrainzQueryPool::Default().Run(ua, "recording", "", "",
+                                                     params, shouldCancel);
           break;
         } catch (const std::exception &e) {
           DEBUG_PRINT("Exception in Query: %s. Retries left: %d\n",
@@ -577,7 +580,7 @@ MusicBrainzApiClient::SearchRecording(const MBRecordingSearchOptions &options,
                     }
                     specificHit.trackCount = totalTracks;
 
-                    results.push_back(specificHit);
+                    results.push_back(std::move(specificHit));
                   }
                 }
               } else {
@@ -590,8 +593,13 @@ MusicBrainzApiClient::SearchRecording(const MBRecordingSearchOptions &options,
           }
         }
       }
-      if (!results.empty())
+      // Empty answers are not kept: they may stand for a failed query.
+      if (!results.empty()) {
+        BMessage data;
+        ArchiveHits(results, data);
+        MusicBrainzResponseCache::Default().Put(url, data);
         break;
+      }
     }
 
   } catch (const std::bad_alloc &) {
@@ -632,21 +640,35 @@ MusicBrainzApiClient::SearchRelease(const MBReleaseSearchOptions &options,
     for (const auto &query : queries) {
       DEBUG_PRINT("Release Search Query: '%s'\n", query.String());
 
+      CQuery::tParamMap params;
+      params["query"] = query.String();
+      params["inc"] = "media artist-credits";
+      BString limit;
+      limit.SetToFormat("%ld", (long)ClampSearchLimit(options.limit));
+      params["limit"] = limit.String();
+
+      const BString url = QueryUrl("release", "", params);
+      UrlClaim claim(url, shouldCancel);
+      if (!claim.Claimed())
+        return results;
+      BMessage cached;
+      if (MusicBrainzResponseCache::Default().Get(
+              url, MusicBrainzResponseCache::kSearchMaxAge, cached)) {
+        results = UnarchiveHits(cached);
+        if (!results.empty())
+          break;
+        continue;
+      }
+
       int retries = 3;
       while (retries > 0) {
         if (shouldCancel && shouldCancel())
           return results;
         try {
-          CQuery::tParamMap params;
-          params["query"] = query.String();
-          params["inc"] = "media artist-credits";
-          BString limit;
-          limit.SetToFormat("%ld", (long)ClampSearchLimit(options.limit));
-          params["limit"] = limit.String();
-          _RespectRateLimit();
-          fLastCall = system_time();
-          meta = RunQueryWithTimeout(ua, "release", "", "", params,
-                                     shouldCancel);
+          if (!_Acquire(url, shouldCancel))
+            return results;
+          meta = MusicBrainzQueryPool::Default().Run(ua, "release", "", "",
+                                                     params, shouldCancel);
           break;
         } catch (const std::exception &e) {
           DEBUG_PRINT("Exception in Release Query: %s. Retries left: %d\n",
@@ -715,8 +737,12 @@ MusicBrainzApiClient::SearchRelease(const MBReleaseSearchOptions &options,
           }
         }
       }
-      if (!results.empty())
+      if (!results.empty()) {
+        BMessage data;
+        ArchiveHits(results, data);
+        MusicBrainzResponseCache::Default().Put(url, data);
         break;
+      }
     }
   } catch (const std::bad_alloc &) {
     throw;
@@ -746,18 +772,29 @@ MusicBrainzApiClient::GetReleaseDetails(const BString &releaseId,
   try {
     if (shouldCancel && shouldCancel())
       return out;
-    _RespectRateLimit();
-
-    BString ua;
-    ua.SetToFormat("Beton/0.1 (%s)", fContact.String());
-
-    fLastCall = system_time();
 
     CQuery::tParamMap params;
     params["inc"] = "recordings media artist-credits release-groups";
 
-    CMetadata meta = RunQueryWithTimeout(ua, "release", releaseId.String(), "",
-                                         params, shouldCancel);
+    const BString url = QueryUrl("release", releaseId, params);
+    UrlClaim claim(url, shouldCancel);
+    if (!claim.Claimed())
+      return out;
+    BMessage cached;
+    if (MusicBrainzResponseCache::Default().Get(
+            url, MusicBrainzResponseCache::kEntityMaxAge, cached)) {
+      UnarchiveRelease(cached, out);
+      return out;
+    }
+
+    if (!_Acquire(url, shouldCancel))
+      return out;
+
+    BString ua;
+    ua.SetToFormat("Beton/0.1 (%s)", fContact.String());
+
+    CMetadata meta = MusicBrainzQueryPool::Default().Run(
+        ua, "release", releaseId.String(), "", params, shouldCancel);
 
     auto rel = meta.Release();
     if (!rel)
@@ -798,7 +835,7 @@ MusicBrainzApiClient::GetReleaseDetails(const BString &releaseId,
                   mt.title = r->Title().c_str();
                   mt.recordingId = r->ID().c_str();
                 }
-                out.tracks.push_back(mt);
+                out.tracks.push_back(std::move(mt));
               }
             }
           }
@@ -806,6 +843,9 @@ MusicBrainzApiClient::GetReleaseDetails(const BString &releaseId,
       }
     }
 
+    BMessage data;
+    ArchiveRelease(out, data);
+    MusicBrainzResponseCache::Default().Put(url, data);
   } catch (const std::bad_alloc &) {
     throw;
   } catch (const std::exception &e) {
@@ -818,6 +858,67 @@ MusicBrainzApiClient::GetReleaseDetails(const BString &releaseId,
   return out;
 }
 
+/** @brief Cache key naming the release a release group's cover came from. */
+static BString
+GroupCoverKey(const BString &groupId)
+{
+  BString key("https://coverartarchive.org/release-group/");
+  key << groupId << "/front";
+  return key;
+}
+
+/**
+ * @brief Release MBID in a Cover Art Archive URL or in the archive.org URL
+ * it redirects to (".../mbid-<release>/mbid-<release>-<image>.jpg").
+ */
+static BString
+ReleaseIdFromCoverUrl(const BString &url)
+{
+  static const char *const kMarkers[] = {"/release/", "/mbid-"};
+  for (const char *marker : kMarkers) {
+    int32 at = url.FindFirst(marker);
+    if (at < 0)
+      continue;
+    BString id;
+    url.CopyInto(id, at + (int32)strlen(marker), 36);
+    if (id.Length() == 36)
+      return id;
+  }
+  return "";
+}
+
+/**
+ * @brief Cached thumbnail of `releaseId` at least `size` pixels wide; the
+ * views scale it down.
+ */
+static bool
+GetCachedCover(const BString &releaseId, int size,
+               std::vector<uint8_t> &outBytes, BString *outMime)
+{
+  static const int kCachedSizes[] = {250, 500, 1200};
+  if (size == MusicBrainzApiClient::kCoverOriginal)
+    return false;
+  for (int cachedSize : kCachedSizes) {
+    if (cachedSize < size)
+      continue;
+    BMessage cached;
+    const void *bytes = nullptr;
+    ssize_t length = 0;
+    if (MusicBrainzResponseCache::Default().Get(
+            MusicBrainzApiClient::BuildFrontCoverUrl(releaseId, cachedSize),
+            MusicBrainzResponseCache::kEntityMaxAge, cached) &&
+        cached.FindData("bytes", B_RAW_TYPE, &bytes, &length) == B_OK &&
+        length > 0) {
+      const uint8_t *begin = static_cast<const uint8_t *>(bytes);
+      outBytes.assign(begin, begin + length);
+      if (outMime)
+        *outMime = cached.GetString("mime", "");
+      return true;
+    }
+  }
+  return false;
+}
+
 /**
  * @brief Fetches cover art from the Cover Art Archive.
  *
@@ -840,28 +941,71 @@ bool MusicBrainzApiClient::FetchCover(const BString &entityId,
   if (outMime)
     outMime->Truncate(0);
 
-  BString urlStr;
-  BString entity = isReleaseGroup ? "release-group" : "release";
+  // A release group's cover is that of one of its releases.
+  BString releaseId = entityId;
+  if (isReleaseGroup) {
+    BMessage alias;
+    releaseId = MusicBrainzResponseCache::Default().Get(
+                    GroupCoverKey(entityId),
+                    MusicBrainzResponseCache::kEntityMaxAge, alias)
+                    ? alias.GetString("release", "")
+                    : "";
+  }
+  if (!releaseId.IsEmpty() &&
+      GetCachedCover(releaseId, sizeHint, outBytes, outMime))
+    return true;
 
-  if (sizeHint > 0 && !isReleaseGroup)
-    urlStr.SetToFormat("https://coverartarchive.org/%s/%s/front-%d",
-                       entity.String(), entityId.String(), sizeHint);
-  else
-    urlStr.SetToFormat("https://coverartarchive.org/%s/%s/front",
-                       entity.String(), entityId.String());
+  BString urlStr;
+  if (isReleaseGroup) {
+    urlStr = GroupCoverKey(entityId);
+    if (sizeHint > 0)
+      urlStr << "-" << sizeHint;
+  } else {
+    urlStr = BuildFrontCoverUrl(entityId, sizeHint);
+  }
 
   DEBUG_PRINT("FetchCover: URL='%s'\n", urlStr.String());
 
-  int status = _FetchUrl(urlStr, outBytes, outMime);
+  UrlClaim claim(urlStr, shouldCancel);
+  if (!claim.Claimed())
+    return false;
+  // The thread we waited for may have just stored it.
+  if (!releaseId.IsEmpty() &&
+      GetCachedCover(releaseId, sizeHint, outBytes, outMime))
+    return true;
+
+  BString mime;
+  BString finalUrl;
+  int status = _FetchUrl(urlStr, outBytes, &mime, shouldCancel, 3, &finalUrl);
 
-  if (status == 200)
+  if (status == 200) {
+    if (outMime)
+      *outMime = mime;
+    BString fetchedId = ReleaseIdFromCoverUrl(finalUrl);
+    if (fetchedId.IsEmpty() && !isReleaseGroup)
+      fetchedId = entityId;
+    if (fetchedId.IsEmpty())
+      return true;
+    if (isReleaseGroup) {
+      BMessage alias;
+      alias.AddString("release", fetchedId);
+      MusicBrainzResponseCache::Default().Put(GroupCoverKey(entityId), alias);
+    }
+    if (sizeHint > 0) {
+      BMessage data;
+      data.AddData("bytes", B_RAW_TYPE, outBytes.data(), outBytes.size());
+      data.AddString("mime", mime);
+      MusicBrainzResponseCache::Default().Put(
+          BuildFrontCoverUrl(fetchedId, sizeHint), data);
+    }
     return true;
+  }
 
-  if (sizeHint > 0 && status == 404 && !isReleaseGroup) {
+  if (sizeHint > 0 && status == 404) {
     DEBUG_PRINT("FetchCover: 404 with size hint, retrying without "
                 "size...\n");
-    return FetchCover(entityId, outBytes, outMime, 0, isReleaseGroup,
-                      shouldCancel);
+    return FetchCover(entityId, outBytes, outMime, kCoverOriginal,
+                      isReleaseGroup, shouldCancel);
   }
 
   return false;
@@ -870,17 +1014,23 @@ bool MusicBrainzApiClient::FetchCover(const BString &entityId,
 /**
  * @brief Internal helper to fetch data from a URL with redirect support.
  *
- * Uses Haiku's BUrlRequest and friends.
+ * Goes through the shared HttpConnectionPool, so consecutive lookups reuse
+ * one connection to the MusicBrainz server.
  *
  * @param urlStr The URL to fetch.
  * @param outBytes Output buffer.
  * @param outMime Output MIME string.
+ * @param shouldCancel Cancellation callback, polled while waiting for the
+ * rate limit.
  * @param maxRedirects Maximum number of redirects to follow.
+ * @param outFinalUrl Optional output of the URL the answer came from.
  * @return HTTP status code or 0 on error.
  */
 int MusicBrainzApiClient::_FetchUrl(const BString &urlStr,
                                  std::vector<uint8_t> &outBytes,
-                                 BString *outMime, int maxRedirects) {
+                                 BString *outMime,
+                                 const std::function<bool()> &shouldCancel,
+                                 int maxRedirects, BString *outFinalUrl) {
 
   if (maxRedirects < 0) {
     DEBUG_PRINT("_FetchUrl: Max redirects reached.\n");
@@ -889,63 +1039,37 @@ int MusicBrainzApiClient::_FetchUrl(const BString &urlStr,
 
   DEBUG_PRINT("_FetchUrl: Requesting '%s' (redirects left=%d)\n",
               urlStr.String(), maxRedirects);
+  if (outFinalUrl)
+    *outFinalUrl = urlStr;
 
   try {
-    _RespectRateLimit();
-    fLastCall = system_time();
-
-    BMallocIO sink;
-#if B_HAIKU_VERSION <= B_HAIKU_VERSION_1_BETA_5
-    BUrl url(urlStr.String());
-#else
-    BUrl url(urlStr.String(), true);
-#endif
-    std::unique_ptr<BUrlRequest> req(
-        BUrlProtocolRoster::MakeRequest(url, &sink));
-    if (!req) {
-      DEBUG_PRINT("_FetchUrl: Failed to make request object.\n");
+    if (!_Acquire(urlStr, shouldCancel))
       return 0;
-    }
-
-    if (auto http = dynamic_cast<BHttpRequest *>(req.get())) {
-      BString ua;
-      ua.SetToFormat("Beton/0.1 (%s)", fContact.String());
-      http->SetUserAgent(ua.String());
-      http->SetFollowLocation(false);
-    }
-
-    thread_id tid = req->Run();
-    if (tid >= 0) {
-      rename_thread(tid, "MB Request");
-      status_t exit;
 
-      if (wait_for_thread_etc(tid, B_RELATIVE_TIMEOUT, 20000000, &exit) !=
-          B_OK) {
-        DEBUG_PRINT(
-            "_FetchUrl: Timeout waiting for request thread.\n");
-        req->Stop();
-        wait_for_thread_etc(tid, B_RELATIVE_TIMEOUT, 2000000, &exit);
-
-        return 408;
-      }
+    HttpConnectionPool::Request request;
+    request.url = urlStr;
+    request.userAgent.SetToFormat("Beton/0.1 (%s)", fContact.String());
+    request.timeout = 20000000;
+    HttpConnectionPool::Response response;
+    status_t error = HttpConnectionPool::Default().Fetch(request, response);
+    if (error == B_TIMED_OUT) {
+      DEBUG_PRINT("_FetchUrl: Request timed out.\n");
+      return 408;
     }
-
-    const BUrlResult &baseRes = req->Result();
-    const BHttpResult *httpRes = dynamic_cast<const BHttpResult *>(&baseRes);
-    if (!httpRes) {
-      DEBUG_PRINT("_FetchUrl: Result is not BHttpResult.\n");
+    if (error != B_OK) {
+      DEBUG_PRINT("_FetchUrl: Request failed: %s\n", strerror(error));
       return 0;
     }
 
-    int status = httpRes->StatusCode();
+    int status = response.status;
     DEBUG_PRINT("_FetchUrl: HTTP Status=%d\n", status);
 
     if (status == 301 || status == 302 || status == 307) {
-      BString loc = httpRes->Headers().HeaderValue("Location");
-      if (!loc.IsEmpty()) {
+      if (!response.location.IsEmpty()) {
         DEBUG_PRINT("_FetchUrl: Redirecting to '%s'\n",
-                    loc.String());
-        return _FetchUrl(loc, outBytes, outMime, maxRedirects - 1);
+                    response.location.String());
+        return _FetchUrl(response.location, outBytes, outMime, shouldCancel,
+                         maxRedirects - 1, outFinalUrl);
       } else {
         DEBUG_PRINT("_FetchUrl: Redirect status %d but no Location "
                     "header.\n",
@@ -956,20 +1080,16 @@ int MusicBrainzApiClient::_FetchUrl(const BString &urlStr,
     if (status != 200)
       return status;
 
-    BString ctype = httpRes->Headers().HeaderValue("Content-Type");
     if (outMime)
-      *outMime = ctype;
+      *outMime = response.contentType;
 
-    const void *buf = sink.Buffer();
-    const size_t len = sink.BufferLength();
-    DEBUG_PRINT("_FetchUrl: Got %zu bytes, type='%s'\n", len,
-                ctype.String());
+    DEBUG_PRINT("_FetchUrl: Got %zu bytes, type='%s'\n", response.body.size(),
+                response.contentType.String());
 
-    if (!buf || len == 0)
+    if (response.body.empty())
       return 500;
 
-    outBytes.resize(len);
-    std::memcpy(outBytes.data(), buf, len);
+    outBytes.swap(response.body);
     return 200;
 
   } catch (const std::bad_alloc &) {
@@ -989,22 +1109,35 @@ MusicBrainzApiClient::BestReleaseForRecording(const BString &recordingId,
   try {
     if (shouldCancel && shouldCancel())
       return "";
-    _RespectRateLimit();
-
-    BString ua;
-    ua.SetToFormat("Beton/0.1 (%s)", fContact.String());
-
-    fLastCall = system_time();
 
     CQuery::tParamMap params;
     params["inc"] = "releases";
 
-    CMetadata meta = RunQueryWithTimeout(ua, "recording", recordingId.String(),
-                                         "", params, shouldCancel);
+    const BString url = QueryUrl("recording", recordingId, params);
+    UrlClaim claim(url, shouldCancel);
+    if (!claim.Claimed())
+      return "";
+    BMessage cached;
+    if (MusicBrainzResponseCache::Default().Get(
+            url, MusicBrainzResponseCache::kEntityMaxAge, cached))
+      return BString(cached.GetString("releaseId", ""));
+
+    if (!_Acquire(url, shouldCancel))
+      return "";
+
+    BString ua;
+    ua.SetToFormat("Beton/0.1 (%s)", fContact.String());
+
+    CMetadata meta = MusicBrainzQueryPool::Default().Run(
+        ua, "recording", recordingId.String(), "", params, shouldCancel);
 
     if (auto rec = meta.Recording()) {
       if (auto rl = rec->ReleaseList(); rl && rl->NumItems() > 0) {
-        return BString(rl->Item(0)->ID().c_str());
+        BString releaseId(rl->Item(0)->ID().c_str());
+        BMessage data;
+        data.AddString("releaseId", releaseId);
+        MusicBrainzResponseCache::Default().Put(url, data);
+        return releaseId;
       }
     }
   } catch (const std::bad_alloc &) {
@@ -111,6 +111,13 @@ struct MBReleaseSearchOptions {
  * Provides methods for searching recordings, fetching release details,
  * and downloading cover art. It handles rate limiting and runs queries via
  * `libmusicbrainz5` (Lucene queries).
+ *
+ * Answers are kept in the MusicBrainzResponseCache and served from there
+ * without waiting for the rate limit: searches for a day, releases,
+ * recordings and covers looked up by MBID for a month.
+ *
+ * Requests that reach the network wait their turn with the
+ * MusicBrainzRequestScheduler, at the priority of the calling thread.
  */
 class MusicBrainzApiClient {
 public:
@@ -177,12 +184,21 @@ public:
   MBRelease GetReleaseDetails(const BString &releaseId,
                               std::function<bool()> shouldCancel = nullptr);
 
+  /** @brief Size hint asking for the uploaded image rather than a thumbnail. */
+  static const int kCoverOriginal = 0;
+
   /**
    * @brief Downloads cover art from Cover Art Archive.
+   *
+   * Thumbnails are cached by the MBID of the release they belong to, so a
+   * release group and its releases share one entry, and a cached thumbnail
+   * at least as large as `sizeHint` is used instead of a download. The
+   * original is never cached; it is only fetched to be embedded.
+   *
    * @param entityId Release or Release Group ID.
    * @param outBytes Vector to write image data to.
    * @param outMime Optional pointer to write MIME type (e.g. "image/jpeg").
-   * @param sizeHint Size hint (250, 500, 1200, or 0 for original).
+   * @param sizeHint Size hint (250, 500, 1200, or kCoverOriginal).
    * @param isReleaseGroup Set to true if entityId is a Release Group.
    * @param shouldCancel Callback for cancellation.
    * @return True if successful.
@@ -192,23 +208,40 @@ public:
                   bool isReleaseGroup = false,
                   std::function<bool()> shouldCancel = nullptr);
 
+  /**
+   * @brief Smallest Cover Art Archive thumbnail at least `width` pixels
+   * wide, or kCoverOriginal past the largest one.
+   */
+  static int CoverSizeFor(float width) {
+    static const int kSizes[] = {250, 500, 1200};
+    for (int size : kSizes) {
+      if (width <= size)
+        return size;
+    }
+    return kCoverOriginal;
+  }
+
   /**
    * @brief Helper to build a front cover URL string.
+   * @param size Thumbnail width, or kCoverOriginal.
    */
-  static BString BuildFrontCoverUrl(const BString &releaseId) {
+  static BString BuildFrontCoverUrl(const BString &releaseId,
+                                    int size = kCoverOriginal) {
     BString url("https://coverartarchive.org/release/");
     url << releaseId << "/front";
+    if (size > 0)
+      url << "-" << size;
     return url;
   }
 
 private:
   BString fContact;
-  bigtime_t fLastCall = 0;
 
-  void _RespectRateLimit();
+  bool _Acquire(const BString &url, const std::function<bool()> &shouldCancel);
 
   int _FetchUrl(const BString &url, std::vector<uint8_t> &outBytes,
-                BString *outMime, int maxRedirects = 3);
+                BString *outMime, const std::function<bool()> &shouldCancel,
+                int maxRedirects = 3, BString *outFinalUrl = nullptr);
 };
 
 #endif // BETON_MUSICBRAINZ_API_CLIENT_H
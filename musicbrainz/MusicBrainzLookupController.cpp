@@ -5,9 +5,11 @@
 
 #include "Debug.h"
 #include "MusicBrainzMatcherWindow.h"
+#include "MusicBrainzRequestScheduler.h"
 #include "TrackMatchingUtils.h"
 #include "MetadataPropertiesWindow.h"
 #include "MetadataTagIO.h"
+#include "MetadataWriteQueue.h"
 
 #include <Catalog.h>
 #include <Directory.h>
@@ -17,6 +19,7 @@
 #include <Messenger.h>
 #include <Path.h>
 #include <algorithm>
+#include <map>
 #include <set>
 #include <atomic>
 #include <cinttypes>
@@ -29,32 +32,6 @@
 #undef B_TRANSLATION_CONTEXT
 #define B_TRANSLATION_CONTEXT "MusicBrainzLookupController"
 
-/**
- * @brief Adds `TagData` fields to a media-update message payload.
- */
-static void AddTagDataToMediaUpdate(BMessage &update, const TagData &td) {
-  update.AddString("title", td.title);
-  update.AddString("artist", td.artist);
-  update.AddString("album", td.album);
-  update.AddString("genre", td.genre);
-  update.AddString("comment", td.comment);
-  update.AddString("albumArtist", td.albumArtist);
-  update.AddString("composer", td.composer);
-  update.AddString("mbAlbumId", td.mbAlbumID);
-  update.AddString("mbArtistId", td.mbArtistID);
-  update.AddString("mbTrackId", td.mbTrackID);
-  update.AddInt32("year", td.year);
-  update.AddInt32("track", td.track);
-  update.AddInt32("trackTotal", td.trackTotal);
-  update.AddInt32("disc", td.disc);
-  update.AddInt32("discTotal", td.discTotal);
-  update.AddInt32("duration", td.lengthSec);
-  update.AddInt32("bitrate", td.bitrate);
-  update.AddInt32("sampleRate", td.sampleRate);
-  update.AddInt32("channels", td.channels);
-  update.AddInt32("rating", td.rating);
-}
-
 static void ReadMetadataForConfiguredTargets(const BString &filePath,
                                              TagData &td) {
   BPath path(filePath.String());
@@ -66,20 +43,206 @@ static void ReadMetadataForConfiguredTargets(const BString &filePath,
     MetadataTagIO::ReadTags(path, td);
 }
 
-static void WriteMetadataForConfiguredTargets(const BString &filePath,
+static bool WriteMetadataForConfiguredTargets(const BString &filePath,
                                               const TagData &td,
                                               const CoverBlob *cover) {
   BPath path(filePath.String());
   MetadataWriteTargets targets = MetadataTagIO::WriteTargetsForPath(filePath);
+  bool ok = true;
 
+  // Tags and cover go into the file with one save.
   if (targets.tags)
-    MetadataTagIO::WriteTags(path, td);
-
-  if (cover && cover->size() > 0)
-    MetadataTagIO::WriteEmbeddedCover(path, *cover);
+    ok = MetadataTagIO::WriteTagsToFile(path, td, cover);
+  else if (cover && cover->size() > 0)
+    ok = MetadataTagIO::WriteEmbeddedCover(path, *cover);
 
   if (targets.bfs)
-    MetadataTagIO::WriteBfsAttributes(path, td, nullptr);
+    ok = MetadataTagIO::WriteBfsAttributes(path, td, nullptr) && ok;
+  return ok;
+}
+
+/**
+ * @brief Sets up a write queue reporting to the window, the library cache
+ * and `replyTo`.
+ */
+static void AddApplyTargets(MetadataWriteQueue &queue, MainWindow *window,
+                            const BMessenger &replyTo) {
+  queue.AddTarget(BMessenger(window));
+  if (window->fMediaLibraryCache)
+    queue.AddTarget(BMessenger(window->fMediaLibraryCache));
+  queue.AddTarget(replyTo);
+  queue.SetStatusTarget(BMessenger(window));
+}
+
+/** @brief A file of an album being matched, with its current tags. */
+struct AlbumFile {
+  BString path;
+  TagData tags;
+  TrackMatchingUtils::MatchText title;
+};
+
+/** @brief Files thought to belong to one release. */
+struct AlbumGroup {
+  BString releaseId; ///< Known from the tags, or empty
+  BString artist;
+  BString album;
+  uint32 trackTotal = 0; ///< From the tags, or 0
+  std::vector<AlbumFile> files;
+};
+
+/**
+ * @brief Groups `files` by their MusicBrainz album ID, or else by album
+ * artist and album title. Files without either are left out.
+ */
+static std::vector<AlbumGroup> GroupByAlbum(const std::vector<BString> &files) {
+  std::vector<AlbumGroup> groups;
+  std::map<BString, size_t> index;
+  for (const BString &path : files) {
+    AlbumFile file;
+    file.path = path;
+    ReadMetadataForConfiguredTargets(path, file.tags);
+    const TagData &td = file.tags;
+    file.title = TrackMatchingUtils::PrepareText(td.title.String());
+
+    const BString &artist = td.albumArtist.IsEmpty() ? td.artist : td.albumArtist;
+    BString key;
+    if (td.mbAlbumID.Length() >= 30)
+      key << "id:" << td.mbAlbumID;
+    else if (!td.album.IsEmpty())
+      key << TrackMatchingUtils::NormalizeKey(artist.String()) << "\t"
+          << TrackMatchingUtils::NormalizeKey(td.album.String());
+    else
+      continue;
+
+    auto found = index.find(key);
+    if (found == index.end()) {
+      found = index.insert(std::make_pair(key, groups.size())).first;
+      AlbumGroup group;
+      if (td.mbAlbumID.Length() >= 30)
+        group.releaseId = td.mbAlbumID;
+      group.artist = artist;
+      group.album = td.album;
+      groups.push_back(group);
+    }
+    AlbumGroup &group = groups[found->second];
+    group.trackTotal = std::max(group.trackTotal, td.trackTotal);
+    group.files.push_back(file);
+  }
+  return groups;
+}
+
+/**
+ * @brief How well a file fits a release track: track number, duration and
+ * title each add to the score; a clearly different duration takes away.
+ */
+static float TrackMatchScore(const AlbumFile &file, const MBTrack &track,
+                             const TrackMatchingUtils::MatchText &title) {
+  const TagData &td = file.tags;
+  float score = 0;
+
+  uint32 number = td.track;
+  if (number == 0) {
+    BPath path(file.path.String());
+    number = (uint32)TrackMatchingUtils::ExtractTrackNumber(path.Leaf());
+  }
+  if (number > 0 && number == track.track &&
+      (td.disc == 0 || td.disc == track.disc))
+    score += 3;
+
+  if (td.lengthSec > 0 && track.length > 0) {
+    int diff = abs((int)td.lengthSec - track.length);
+    if (diff <= 3)
+      score += 2;
+    else if (diff < 15)
+      score += 1;
+    else
+      score -= 3;
+  }
+
+  if (!file.title.key.IsEmpty())
+    score += 3 * TrackMatchingUtils::Similarity(file.title, title);
+  return score;
+}
+
+/**
+ * @brief Assigns each file of `group` a track of `release`, best pairs
+ * first.
+ * @return Track index per file, or an empty vector unless every file found
+ * a track scoring at least kMinTrackScore.
+ */
+static std::vector<int> AssignTracks(const AlbumGroup &group,
+                                     const MBRelease &release) {
+  static const float kMinTrackScore = 3.5f;
+
+  struct Pair {
+    float score;
+    size_t file;
+    size_t track;
+  };
+  std::vector<TrackMatchingUtils::MatchText> titles;
+  for (const MBTrack &track : release.tracks)
+    titles.push_back(TrackMatchingUtils::PrepareText(track.title.String()));
+
+  std::vector<Pair> pairs;
+  for (size_t f = 0; f < group.files.size(); f++) {
+    for (size_t t = 0; t < release.tracks.size(); t++) {
+      float score =
+          TrackMatchScore(group.files[f], release.tracks[t], titles[t]);
+      if (score >= kMinTrackScore)
+        pairs.push_back({score, f, t});
+    }
+  }
+  std::stable_sort(pairs.begin(), pairs.end(),
+                   [](const Pair &a, const Pair &b) { return a.score > b.score; });
+
+  std::vector<int> assignment(group.files.size(), -1);
+  std::vector<bool> trackUsed(release.tracks.size(), false);
+  size_t assigned = 0;
+  for (const Pair &pair : pairs) {
+    if (assignment[pair.file] >= 0 || trackUsed[pair.track])
+      continue;
+    assignment[pair.file] = (int)pair.track;
+    trackUsed[pair.track] = true;
+    assigned++;
+  }
+
+  if (assigned < group.files.size())
+    assignment.clear();
+  return assignment;
+}
+
+/**
+ * @brief Release ID for `group`: its tagged one, or the best-titled hit of
+ * one release search.
+ */
+static BString ResolveAlbumRelease(MusicBrainzApiClient *client,
+                                   const AlbumGroup &group,
+                                   const std::function<bool()> &abortCheck) {
+  if (!group.releaseId.IsEmpty())
+    return group.releaseId;
+
+  MBReleaseSearchOptions options;
+  options.artist = group.artist;
+  options.release = group.album;
+  options.tracks = group.trackTotal > 0 ? (int32)group.trackTotal
+                                        : (int32)group.files.size();
+  options.limit = 10;
+  std::vector<MBHit> hits = client->SearchRelease(options, abortCheck);
+
+  TrackMatchingUtils::MatchText album =
+      TrackMatchingUtils::PrepareText(group.album.String());
+  BString best;
+  float bestSimilarity = 0.8f;
+  for (const MBHit &hit : hits) {
+    float similarity = TrackMatchingUtils::Similarity(
+        album, TrackMatchingUtils::PrepareText(hit.releaseTitle.String()),
+        bestSimilarity);
+    if (similarity > bestSimilarity) {
+      best = hit.releaseId;
+      bestSimilarity = similarity;
+    }
+  }
+  return best;
 }
 
 /**
@@ -122,6 +285,11 @@ bool MusicBrainzLookupController::HandleMessage(BMessage *msg) {
     break;
   }
 
+  case MSG_MB_MATCH_ALBUMS: {
+    MatchAlbums(msg);
+    break;
+  }
+
   case MSG_COVER_FETCH_MB: {
     FetchCover(msg);
     break;
@@ -251,8 +419,10 @@ void MusicBrainzLookupController::StartSearch(BMessage *msg) {
   fWindow->UpdateStatus(B_TRANSLATE("Searching on MusicBrainz..."));
 
   MainWindow *window = fWindow;
-  window->LaunchThread("MBSearch", [window, recordingOptions, releaseOptions,
-                                    albumSearch, replyTo, gen]() {
+  int targetCount = (int)fWindow->fPendingFiles.size();
+  window->QueueJob(kLaneIO, "MBSearch", [window, recordingOptions,
+                                         releaseOptions, albumSearch, replyTo,
+                                         gen, targetCount]() {
     if (!window->fMbClient) {
       DEBUG_PRINT("Search thread abort: fMbClient is null\n");
       return;
@@ -270,6 +440,19 @@ void MusicBrainzLookupController::StartSearch(BMessage *msg) {
     DEBUG_PRINT("MusicBrainz search returned %zu hits\n",
                 hits.size());
 
+    // Ranked here rather than on the window thread: closest track count to
+    // the selection first, then newest.
+    if (targetCount > 0) {
+      std::stable_sort(hits.begin(), hits.end(),
+                       [targetCount](const MBHit &a, const MBHit &b) {
+                         int diffA = std::abs(a.trackCount - targetCount);
+                         int diffB = std::abs(b.trackCount - targetCount);
+                         if (diffA != diffB)
+                           return diffA < diffB;
+                         return a.year > b.year;
+                       });
+    }
+
     std::vector<MBHit> *hitsPtr = new std::vector<MBHit>(hits);
     BMessage completion(MSG_MB_SEARCH_COMPLETE);
     completion.AddPointer("hits", hitsPtr);
@@ -337,19 +520,6 @@ void MusicBrainzLookupController::HandleSearchComplete(BMessage *msg) {
       hits->size(), (long)(int32)replyTo.IsValid());
 
   if (replyTo.IsValid()) {
-    int targetCount = (int)fWindow->fPendingFiles.size();
-    if (targetCount > 0) {
-      std::sort(hits->begin(), hits->end(),
-                [targetCount](const MBHit &a, const MBHit &b) {
-                  int diffA = std::abs(a.trackCount - targetCount);
-                  int diffB = std::abs(b.trackCount - targetCount);
-                  if (diffA != diffB)
-                    return diffA < diffB;
-
-                  return a.year > b.year;
-                });
-    }
-
     BMessage resp(MSG_MB_RESULTS);
     resp.AddBool("album_results", albumSearch);
     std::set<std::string> seenReleases;
@@ -431,13 +601,18 @@ void MusicBrainzLookupController::ApplyMetadata(BMessage *msg) {
 
   MainWindow *window = fWindow;
   int32 gen = window->fMbSearchGeneration.load(std::memory_order_acquire);
-  window->LaunchThread("MBApply", [window, recId, relId, files, albumMode,
-                                   replyTo, gen]() mutable {
+  window->QueueJob(kLaneIO, "MBApply", [window, recId, relId, files,
+                                        albumMode, replyTo, gen]() mutable {
     if (!window->fMbClient) {
       DEBUG_PRINT("Apply thread abort: fMbClient is null\n");
       return;
     }
 
+    // Writing tags and covers out can wait behind a search the user starts
+    // meanwhile.
+    MusicBrainzRequestScheduler::PriorityScope priority(
+        MusicBrainzRequestScheduler::kBackground);
+
     auto abortStatus = [window]() {
       BMessage statusDone(MSG_STATUS_UPDATE);
       statusDone.AddString("text", B_TRANSLATE("Cancelled."));
@@ -497,7 +672,8 @@ void MusicBrainzLookupController::ApplyMetadata(BMessage *msg) {
       DEBUG_PRINT("Trying to fetch cover for Release Group: %s\n",
                   rel.releaseGroupId.String());
       hasCover = window->fMbClient->FetchCover(
-          rel.releaseGroupId, coverData, &coverMime, 500, true, abortCheck);
+          rel.releaseGroupId, coverData, &coverMime,
+          MusicBrainzApiClient::kCoverOriginal, true, abortCheck);
     }
 
     if (window->fMbSearchGeneration.load(std::memory_order_acquire) != gen) {
@@ -509,7 +685,8 @@ void MusicBrainzLookupController::ApplyMetadata(BMessage *msg) {
       DEBUG_PRINT("No Group cover, trying Release: %s\n",
                   effectiveRelId.String());
       hasCover = window->fMbClient->FetchCover(
-          effectiveRelId, coverData, &coverMime, 500, true, abortCheck);
+          effectiveRelId, coverData, &coverMime,
+          MusicBrainzApiClient::kCoverOriginal, false, abortCheck);
     }
 
     if (window->fMbSearchGeneration.load(std::memory_order_acquire) != gen) {
@@ -565,6 +742,7 @@ void MusicBrainzLookupController::ApplyMetadata(BMessage *msg) {
                 "%s\n",
                 files.size(), albumMode ? "Album" : "Track");
 
+    int32 failed = 0;
     if (albumMode) {
       std::sort(files.begin(), files.end());
 
@@ -647,37 +825,35 @@ void MusicBrainzLookupController::ApplyMetadata(BMessage *msg) {
         DEBUG_PRINT("Auto-Match confident. Applying tags "
                     "directly.\n");
 
+        MetadataWriteQueue queue;
+        AddApplyTargets(queue, window, replyTo);
         for (size_t i = 0; i < files.size(); i++) {
           int tIdx = fileToTrackMap[i];
           if (tIdx < 0)
             continue;
 
           const MBTrack &trk = rel.tracks[tIdx];
-          TagData td;
-          ReadMetadataForConfiguredTargets(files[i], td);
-
-          td.artist = rel.albumArtist;
-          td.album = rel.album;
-          td.title = trk.title;
-          td.year = rel.year;
-          td.track = trk.track;
-          td.trackTotal = (uint32)rel.tracks.size();
-          td.disc = trk.disc;
-          td.albumArtist = rel.albumArtist;
-          td.mbAlbumID = rel.releaseId;
-          td.mbTrackID = trk.recordingId;
-
-          WriteMetadataForConfiguredTargets(files[i], td, &coverBlob);
-          BMessage update(MSG_MEDIA_ITEM_FOUND);
-          update.AddString("path", files[i]);
-          AddTagDataToMediaUpdate(update, td);
-
-          BMessenger(window).SendMessage(&update);
-          if (window->fMediaLibraryCache)
-            BMessenger(window->fMediaLibraryCache).SendMessage(&update);
-          if (replyTo.IsValid())
-            replyTo.SendMessage(&update);
+          queue.Add(files[i],
+              [&rel, &trk](const BString &path, TagData &td) {
+                ReadMetadataForConfiguredTargets(path, td);
+
+                td.artist = rel.albumArtist;
+                td.album = rel.album;
+                td.title = trk.title;
+                td.year = rel.year;
+                td.track = trk.track;
+                td.trackTotal = (uint32)rel.tracks.size();
+                td.disc = trk.disc;
+                td.albumArtist = rel.albumArtist;
+                td.mbAlbumID = rel.releaseId;
+                td.mbTrackID = trk.recordingId;
+                return true;
+              },
+              [&coverBlob](const BString &path, const TagData &td) {
+                return WriteMetadataForConfiguredTargets(path, td, &coverBlob);
+              });
         }
+        failed += queue.Run();
         BMessage statusMsg(MSG_STATUS_UPDATE);
         statusMsg.AddString(
             "text", B_TRANSLATE("Metadata applied successfully (Auto-Match)."));
@@ -715,60 +891,61 @@ void MusicBrainzLookupController::ApplyMetadata(BMessage *msg) {
         }
       }
     } else {
-      for (const auto &path : files) {
-        TagData td;
-        ReadMetadataForConfiguredTargets(path, td);
-
-        const MBTrack *trkMatch = nullptr;
-        for (const auto &t : rel.tracks) {
-          if (t.recordingId == recId) {
-            trkMatch = &t;
-            break;
-          }
+      const MBTrack *trkMatch = nullptr;
+      for (const auto &t : rel.tracks) {
+        if (t.recordingId == recId) {
+          trkMatch = &t;
+          break;
         }
+      }
 
-        if (trkMatch) {
-          DEBUG_PRINT("Applying Track Mode: File '%s' -> Track "
-                      "Match '%s'\n",
-                      path.String(), trkMatch->title.String());
-        } else {
-          DEBUG_PRINT("Warning: Track Mode, but bad recID match "
-                      "for file '%s'\n",
-                      path.String());
-        }
-
-        td.artist = rel.albumArtist;
-        td.album = rel.album;
-        td.year = rel.year;
-        td.mbAlbumID = rel.releaseId;
-        td.mbTrackID = recId;
-
-        if (trkMatch) {
-          td.title = trkMatch->title;
-          td.track = trkMatch->track;
-          td.disc = trkMatch->disc;
-        }
-
-        WriteMetadataForConfiguredTargets(path, td, &coverBlob);
-
-        BMessage update(MSG_MEDIA_ITEM_FOUND);
-        update.AddString("path", path);
-        AddTagDataToMediaUpdate(update, td);
+      MetadataWriteQueue queue;
+      AddApplyTargets(queue, window, replyTo);
+      for (const auto &file : files) {
+        queue.Add(file,
+            [&rel, &recId, trkMatch](const BString &path, TagData &td) {
+              ReadMetadataForConfiguredTargets(path, td);
+
+              if (trkMatch) {
+                DEBUG_PRINT("Applying Track Mode: File '%s' -> Track "
+                            "Match '%s'\n",
+                            path.String(), trkMatch->title.String());
+              } else {
+                DEBUG_PRINT("Warning: Track Mode, but bad recID match "
+                            "for file '%s'\n",
+                            path.String());
+              }
 
-        DEBUG_PRINT("MSG_MEDIA_ITEM_FOUND sending (Path=%s, "
-                    "Year=%lu)\n",
-                    path.String(), (unsigned long)td.year);
+              td.artist = rel.albumArtist;
+              td.album = rel.album;
+              td.year = rel.year;
+              td.mbAlbumID = rel.releaseId;
+              td.mbTrackID = recId;
 
-        BMessenger(window).SendMessage(&update);
-        if (window->fMediaLibraryCache)
-          BMessenger(window->fMediaLibraryCache).SendMessage(&update);
-        if (replyTo.IsValid())
-          replyTo.SendMessage(&update);
+              if (trkMatch) {
+                td.title = trkMatch->title;
+                td.track = trkMatch->track;
+                td.disc = trkMatch->disc;
+              }
+              return true;
+            },
+            [&coverBlob](const BString &path, const TagData &td) {
+              return WriteMetadataForConfiguredTargets(path, td, &coverBlob);
+            });
       }
+      failed += queue.Run();
     }
 
     BMessage doneMsg(MSG_STATUS_UPDATE);
-    doneMsg.AddString("text", B_TRANSLATE("Metadata successfully saved."));
+    if (failed > 0) {
+      BString text;
+      text.SetToFormat(B_TRANSLATE("Metadata saved, %ld files could not be "
+                                   "written."),
+                       (long)failed);
+      doneMsg.AddString("text", text);
+    } else {
+      doneMsg.AddString("text", B_TRANSLATE("Metadata successfully saved."));
+    }
     BMessenger(window).SendMessage(&doneMsg);
 
     if (!files.empty()) {
@@ -781,6 +958,126 @@ void MusicBrainzLookupController::ApplyMetadata(BMessage *msg) {
   });
 }
 
+/**
+ * @brief Matches the files album by album: one release search and one
+ * release lookup per album instead of a search per track.
+ *
+ * Albums whose files do not all find a track with confidence are left
+ * untouched.
+ */
+void MusicBrainzLookupController::MatchAlbums(BMessage *msg) {
+  if (!fWindow || !msg)
+    return;
+
+  std::vector<BString> files;
+  BString f;
+  for (int32 i = 0; msg->FindString("file", i, &f) == B_OK; i++)
+    files.push_back(f);
+  if (files.empty())
+    return;
+
+  BMessenger replyTo = msg->ReturnAddress();
+  int32 gen =
+      fWindow->fMbSearchGeneration.fetch_add(1, std::memory_order_release) + 1;
+  fWindow->UpdateStatus(B_TRANSLATE("Matching albums on MusicBrainz..."));
+
+  MainWindow *window = fWindow;
+  window->QueueJob(kLaneIO, "MBAlbumMatch", [window, files, replyTo, gen]() {
+    if (!window->fMbClient)
+      return;
+
+    MusicBrainzRequestScheduler::PriorityScope priority(
+        MusicBrainzRequestScheduler::kBackground);
+    auto abortCheck = [window, gen]() {
+      return window->fMbSearchGeneration.load(std::memory_order_acquire) != gen;
+    };
+
+    std::vector<AlbumGroup> groups = GroupByAlbum(files);
+    DEBUG_PRINT("Album match: %zu files in %zu albums\n", files.size(),
+                groups.size());
+
+    int32 matched = 0;
+    int32 failed = 0;
+    for (size_t g = 0; g < groups.size() && !abortCheck(); g++) {
+      const AlbumGroup &group = groups[g];
+      BString text;
+      text.SetToFormat(B_TRANSLATE("Matching album %ld of %ld: %s"),
+                       (long)(g + 1), (long)groups.size(),
+                       group.album.String());
+      BMessage status(MSG_STATUS_UPDATE);
+      status.AddString("text", text);
+      BMessenger(window).SendMessage(&status);
+
+      BString releaseId =
+          ResolveAlbumRelease(window->fMbClient, group, abortCheck);
+      if (releaseId.IsEmpty() || abortCheck())
+        continue;
+
+      MBRelease rel = window->fMbClient->GetReleaseDetails(releaseId, abortCheck);
+      std::vector<int> assignment = AssignTracks(group, rel);
+      if (assignment.empty() || abortCheck()) {
+        DEBUG_PRINT("Album match: no confident match for '%s'\n",
+                    group.album.String());
+        continue;
+      }
+
+      CoverBlob coverBlob;
+      std::vector<uint8_t> coverData;
+      BString coverMime;
+      if (window->fMbClient->FetchCover(releaseId, coverData, &coverMime,
+                                        MusicBrainzApiClient::kCoverOriginal,
+                                        false, abortCheck))
+        coverBlob.assign(coverData.data(), coverData.size());
+      if (abortCheck())
+        break;
+
+      MetadataWriteQueue queue;
+      AddApplyTargets(queue, window, replyTo);
+      for (size_t i = 0; i < group.files.size(); i++) {
+        const MBTrack &trk = rel.tracks[assignment[i]];
+        queue.Add(group.files[i].path,
+            [&rel, &trk](const BString &path, TagData &td) {
+              ReadMetadataForConfiguredTargets(path, td);
+
+              td.artist = rel.albumArtist;
+              td.album = rel.album;
+              td.title = trk.title;
+              td.year = rel.year;
+              td.track = trk.track;
+              td.trackTotal = (uint32)rel.tracks.size();
+              td.disc = trk.disc;
+              td.albumArtist = rel.albumArtist;
+              td.mbAlbumID = rel.releaseId;
+              td.mbTrackID = trk.recordingId;
+              return true;
+            },
+            [&coverBlob](const BString &path, const TagData &td) {
+              return WriteMetadataForConfiguredTargets(path, td, &coverBlob);
+            });
+      }
+      failed += queue.Run();
+      matched++;
+    }
+
+    BString text;
+    if (failed > 0)
+      text.SetToFormat(B_TRANSLATE("Matched %ld of %ld albums, %ld files "
+                                   "could not be written."),
+                       (long)matched, (long)groups.size(), (long)failed);
+    else
+      text.SetToFormat(B_TRANSLATE("Matched %ld of %ld albums."),
+                       (long)matched, (long)groups.size());
+    BMessage done(MSG_STATUS_UPDATE);
+    done.AddString("text", text);
+    BMessenger(window).SendMessage(&done);
+
+    BMessage reply(MSG_MB_ALBUMS_MATCHED);
+    reply.AddInt32("matched", matched);
+    reply.AddInt32("albums", (int32)groups.size());
+    replyTo.SendMessage(&reply);
+  });
+}
+
 /**
  * @brief Applies user-confirmed matcher mapping in a background thread.
  */
@@ -815,49 +1112,47 @@ void MusicBrainzLookupController::ApplyMatch(BMessage *msg) {
   BMessenger cacheTarget(fWindow->fMediaLibraryCache);
   BMessenger propertiesTarget(fWindow->fMetadataPropertiesWindow);
 
-  fWindow->LaunchThread("MBMatchApply", [matchedFiles, trackMap,
-                                          pendingRelease, pendingCoverBlob,
-                                          target, cacheTarget,
-                                          propertiesTarget]() {
+  fWindow->QueueJob(kLaneBackground, "MBMatchApply",
+                    [matchedFiles, trackMap, pendingRelease, pendingCoverBlob,
+                     target, cacheTarget, propertiesTarget]() {
+    MetadataWriteQueue queue;
+    queue.AddTarget(target);
+    queue.AddTarget(cacheTarget);
+    queue.AddTarget(propertiesTarget);
+    queue.SetStatusTarget(target);
     for (size_t idx = 0; idx < matchedFiles.size(); idx++) {
       int32 trackIndex = trackMap[idx];
       if (trackIndex < 0 || trackIndex >= (int32)pendingRelease.tracks.size())
         continue;
 
       const MBTrack &trk = pendingRelease.tracks[trackIndex];
-      BString filePath = matchedFiles[idx];
-
-      TagData td;
-      ReadMetadataForConfiguredTargets(filePath, td);
-
-      td.artist = pendingRelease.albumArtist;
-      td.album = pendingRelease.album;
-      td.title = trk.title;
-      td.year = pendingRelease.year;
-      td.track = trk.track;
-      td.trackTotal = (uint32)pendingRelease.tracks.size();
-      td.disc = trk.disc;
-      td.albumArtist = pendingRelease.albumArtist;
-      td.mbAlbumID = pendingRelease.releaseId;
-      td.mbTrackID = trk.recordingId;
-
-      DEBUG_PRINT("Applying Tags to '%s':\n", filePath.String());
-      DEBUG_PRINT("    Title: %s\n", td.title.String());
-      DEBUG_PRINT("    MB Track ID: %s\n", td.mbTrackID.String());
-      DEBUG_PRINT("    MB Album ID: %s\n", td.mbAlbumID.String());
-
-      WriteMetadataForConfiguredTargets(filePath, td, &pendingCoverBlob);
-
-      BMessage update(MSG_MEDIA_ITEM_FOUND);
-      update.AddString("path", filePath);
-      AddTagDataToMediaUpdate(update, td);
-
-      target.SendMessage(&update);
-      if (cacheTarget.IsValid())
-        cacheTarget.SendMessage(&update);
-      if (propertiesTarget.IsValid())
-        propertiesTarget.SendMessage(&update);
+      queue.Add(matchedFiles[idx],
+          [&pendingRelease, &trk](const BString &filePath, TagData &td) {
+            ReadMetadataForConfiguredTargets(filePath, td);
+
+            td.artist = pendingRelease.albumArtist;
+            td.album = pendingRelease.album;
+            td.title = trk.title;
+            td.year = pendingRelease.year;
+            td.track = trk.track;
+            td.trackTotal = (uint32)pendingRelease.tracks.size();
+            td.disc = trk.disc;
+            td.albumArtist = pendingRelease.albumArtist;
+            td.mbAlbumID = pendingRelease.releaseId;
+            td.mbTrackID = trk.recordingId;
+
+            DEBUG_PRINT("Applying Tags to '%s':\n", filePath.String());
+            DEBUG_PRINT("    Title: %s\n", td.title.String());
+            DEBUG_PRINT("    MB Track ID: %s\n", td.mbTrackID.String());
+            DEBUG_PRINT("    MB Album ID: %s\n", td.mbAlbumID.String());
+            return true;
+          },
+          [&pendingCoverBlob](const BString &filePath, const TagData &td) {
+            return WriteMetadataForConfiguredTargets(filePath, td,
+                                                     &pendingCoverBlob);
+          });
     }
+    queue.Run();
 
     BMessage statusMsg(MSG_STATUS_UPDATE);
     statusMsg.AddString("text", B_TRANSLATE("Metadata applied successfully "
@@ -889,10 +1184,12 @@ void MusicBrainzLookupController::FetchCover(BMessage *msg) {
   BMessenger replyTo;
   if (msg->FindMessenger("original_reply_to", &replyTo) != B_OK)
     replyTo = msg->ReturnAddress();
+  const int size = msg->GetInt32("size", 500);
 
   MainWindow *window = fWindow;
   int32 gen = window->fMbSearchGeneration.load(std::memory_order_acquire);
-  window->LaunchThread("CoverFetchMB", [window, path, replyTo, gen]() {
+  window->QueueJob(kLaneIO, "CoverFetchMB",
+                   [window, path, replyTo, gen, size]() {
     DEBUG_PRINT("MB Thread started for %s (Gen=%ld)\n",
                 path.String(), (long)gen);
     if (!window->fMbClient) {
@@ -971,7 +1268,7 @@ void MusicBrainzLookupController::FetchCover(BMessage *msg) {
     BString mime;
     bool sentCoverReply = false;
     DEBUG_PRINT("Fetching cover for %s...\n", relId.String());
-    if (window->fMbClient->FetchCover(relId, data, &mime, 500, false,
+    if (window->fMbClient->FetchCover(relId, data, &mime, size, false,
                                       abortCheck)) {
       if (window->fMbSearchGeneration.load(std::memory_order_acquire) != gen)
         return;
@@ -981,6 +1278,7 @@ void MusicBrainzLookupController::FetchCover(BMessage *msg) {
       reply.AddData("bytes", B_RAW_TYPE, data.data(), data.size());
       if (!mime.IsEmpty())
         reply.AddString("mime", mime.String());
+      reply.AddString("mbid", relId);
       replyTo.SendMessage(&reply);
       sentCoverReply = true;
     } else {
@@ -998,7 +1296,7 @@ void MusicBrainzLookupController::FetchCover(BMessage *msg) {
         DEBUG_PRINT("Found Release Group ID: %s. Fetching...\n",
                     mbRel.releaseGroupId.String());
         if (window->fMbClient->FetchCover(mbRel.releaseGroupId, data, &mime,
-                                          500, true, abortCheck)) {
+                                          size, true, abortCheck)) {
           if (window->fMbSearchGeneration.load(std::memory_order_acquire) != gen)
             return;
           DEBUG_PRINT("FetchCover (Group) success! %zu bytes, "
@@ -1008,6 +1306,8 @@ void MusicBrainzLookupController::FetchCover(BMessage *msg) {
           reply.AddData("bytes", B_RAW_TYPE, data.data(), data.size());
           if (!mime.IsEmpty())
             reply.AddString("mime", mime.String());
+          reply.AddString("mbid", mbRel.releaseGroupId);
+          reply.AddBool("release_group", true);
           replyTo.SendMessage(&reply);
           sentCoverReply = true;
         } else {
@@ -1026,3 +1326,50 @@ void MusicBrainzLookupController::FetchCover(BMessage *msg) {
     BMessenger(window).SendMessage(&statusDone);
   });
 }
+
+/**
+ * @brief Replaces the preview thumbnail in a cover apply request with the
+ * full-size image and passes the request on.
+ *
+ * Falls back to embedding the thumbnail if the original cannot be fetched.
+ */
+void MusicBrainzLookupController::FetchFullCover(BMessage *msg) {
+  if (!fWindow || !msg)
+    return;
+
+  const BString mbid = msg->GetString("cover_mbid", "");
+  const bool isGroup = msg->GetBool("cover_release_group", false);
+  BMessage request(*msg);
+  request.RemoveName("cover_mbid");
+  request.RemoveName("cover_release_group");
+
+  BMessage status(MSG_STATUS_UPDATE);
+  status.AddString("text", B_TRANSLATE("Fetching full-size cover..."));
+  BMessenger(fWindow).SendMessage(&status);
+
+  MainWindow *window = fWindow;
+  window->QueueJob(kLaneIO, "CoverFetchFull",
+                   [window, mbid, isGroup, request]() {
+    BMessage apply(request);
+    std::vector<uint8_t> data;
+    BString mime;
+    if (window->fMbClient &&
+        window->fMbClient->FetchCover(mbid, data, &mime,
+                                      MusicBrainzApiClient::kCoverOriginal,
+                                      isGroup)) {
+      apply.RemoveName("bytes");
+      apply.AddData("bytes", B_RAW_TYPE, data.data(), data.size());
+      apply.RemoveName("mime");
+      if (!mime.IsEmpty())
+        apply.AddString("mime", mime);
+    } else {
+      DEBUG_PRINT("Full-size cover for %s failed, embedding the preview\n",
+                  mbid.String());
+    }
+    BMessenger(window).SendMessage(&apply);
+
+    BMessage statusDone(MSG_STATUS_UPDATE);
+    statusDone.AddString("text", B_TRANSLATE("Ready."));
+    BMessenger(window).SendMessage(&statusDone);
+  });
+}
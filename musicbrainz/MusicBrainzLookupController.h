@@ -46,6 +46,13 @@ public:
    */
   void ApplyMetadata(BMessage *msg);
 
+  /**
+   * @brief Matches the given files to releases album by album and writes
+   * the tags of every confident match.
+   * @param msg Request carrying "file" paths.
+   */
+  void MatchAlbums(BMessage *msg);
+
   /**
    * @brief Applies manual track-to-file mapping from matcher dialog.
    * @param msg Mapping result message.
@@ -58,6 +65,12 @@ public:
    */
   void FetchCover(BMessage *msg);
 
+  /**
+   * @brief Embeds the full-size version of a cover previewed as a thumbnail.
+   * @param msg Cover apply request carrying "cover_mbid".
+   */
+  void FetchFullCover(BMessage *msg);
+
 private:
   /** @brief Owning main window context. */
   MainWindow *fWindow;
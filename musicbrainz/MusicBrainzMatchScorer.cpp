@@ -0,0 +1,236 @@
+#include "MusicBrainzMatchScorer.h"
+#include "Messages.h"
+#include "MetadataTagIO.h"
+#include "ParallelAlgorithms.h"
+#include "TrackMatchingUtils.h"
+
+#include <Message.h>
+#include <Path.h>
+
+#include <algorithm>
+#include <ctype.h>
+#include <map>
+#include <stdio.h>
+#include <stdlib.h>
+
+namespace {
+
+/** @brief A release track, prepared once for every file. */
+struct TrackKey {
+  int32 length = 0; ///< Seconds, 0 if unknown
+  int32 number = 0;
+  TrackMatchingUtils::MatchText name;
+};
+
+/** @brief What a file is matched on. */
+struct FileKey {
+  int32 length = 0;
+  int32 number = 0;
+  TrackMatchingUtils::MatchText name; ///< File name without number/extension
+};
+
+int32 ParseDuration(const BString &duration) {
+  int minutes = 0;
+  int seconds = 0;
+  if (sscanf(duration.String(), "%d:%d", &minutes, &seconds) >= 2)
+    return minutes * 60 + seconds;
+  return 0;
+}
+
+FileKey PrepareFile(const BString &path) {
+  FileKey key;
+  TagData td;
+  MetadataTagIO::ReadTags(BPath(path.String()), td);
+  key.length = (int32)td.lengthSec;
+
+  BString name = BPath(path.String()).Leaf();
+  key.number = td.track > 0 ? (int32)td.track
+                            : TrackMatchingUtils::ExtractTrackNumber(name.String());
+
+  int32 dot = name.FindLast('.');
+  if (dot > 0)
+    name.Truncate(dot);
+  const char *p = name.String();
+  while (*p && (isdigit(*p) || isspace(*p) || *p == '-' || *p == '.' ||
+                *p == '_'))
+    p++;
+  key.name = TrackMatchingUtils::PrepareText(p);
+  return key;
+}
+
+/**
+ * @brief Weighted score of a file/track pairing: a close duration counts
+ * most, then the track number, then the name.
+ */
+int32 Score(const FileKey &file, const TrackKey &track) {
+  int32 score = 0;
+  if (track.length > 0 && file.length > 0) {
+    int32 diff = abs(track.length - file.length);
+    if (diff <= 1)
+      score += 50;
+    else if (diff <= 3)
+      score += 30;
+    else if (diff <= MusicBrainzMatchScorer::kDurationWindow)
+      score -= 20;
+    else
+      score -= 50;
+  }
+
+  if (file.number > 0 && file.number == track.number)
+    score += 40;
+
+  if (!file.name.key.IsEmpty() && !track.name.key.IsEmpty()) {
+    if (file.name.key.FindFirst(track.name.key) >= 0) {
+      score += 25;
+    } else {
+      float similarity =
+          TrackMatchingUtils::Similarity(file.name, track.name, 0.5f);
+      if (similarity > 0.8f)
+        score += 20;
+      else if (similarity > 0.5f)
+        score += 10;
+    }
+  }
+  return score;
+}
+
+} // namespace
+
+MusicBrainzMatchScorer::MusicBrainzMatchScorer(const BMessenger &target)
+    : fTarget(target), fGeneration(0), fThread(-1), fCancel(false) {}
+
+MusicBrainzMatchScorer::~MusicBrainzMatchScorer() { Cancel(); }
+
+status_t MusicBrainzMatchScorer::Start(
+    const std::vector<BString> &files,
+    const std::vector<MusicBrainzMatchTrackInfo> &tracks, int32 generation) {
+  Cancel();
+
+  fFiles = files;
+  fTracks = tracks;
+  fGeneration = generation;
+  fCancel = false;
+  fThread = spawn_thread(_ThreadEntry, "MusicBrainzMatchScorer",
+                         B_NORMAL_PRIORITY, this);
+  if (fThread < 0) {
+    status_t status = fThread;
+    fThread = -1;
+    return status;
+  }
+  return resume_thread(fThread);
+}
+
+void MusicBrainzMatchScorer::Cancel() {
+  fCancel = true;
+  if (fThread >= 0) {
+    status_t result;
+    wait_for_thread(fThread, &result);
+    fThread = -1;
+  }
+}
+
+int32 MusicBrainzMatchScorer::_ThreadEntry(void *data) {
+  static_cast<MusicBrainzMatchScorer *>(data)->_Run();
+  return 0;
+}
+
+void MusicBrainzMatchScorer::_Send(BMessage &message) {
+  // A timeout keeps Cancel() from deadlocking against a full window port.
+  for (;;) {
+    status_t status = fTarget.SendMessage(&message, (BHandler *)nullptr,
+                                          kSendTimeout);
+    if ((status != B_TIMED_OUT && status != B_WOULD_BLOCK) || fCancel)
+      return;
+  }
+}
+
+void MusicBrainzMatchScorer::_Run() {
+  std::vector<TrackKey> tracks(fTracks.size());
+  std::vector<int32> byLength;
+  std::vector<int32> unknownLength;
+  std::map<int32, std::vector<int32>> byNumber;
+  for (size_t t = 0; t < fTracks.size(); t++) {
+    tracks[t].length = ParseDuration(fTracks[t].duration);
+    tracks[t].number = fTracks[t].index;
+    tracks[t].name = TrackMatchingUtils::PrepareText(fTracks[t].name.String());
+    if (tracks[t].length > 0)
+      byLength.push_back((int32)t);
+    else
+      unknownLength.push_back((int32)t);
+    byNumber[tracks[t].number].push_back((int32)t);
+  }
+  std::sort(byLength.begin(), byLength.end(), [&](int32 a, int32 b) {
+    return tracks[a].length < tracks[b].length;
+  });
+
+  std::atomic<int32> next(0);
+  const int32 fileCount = (int32)fFiles.size();
+  int32 workers = std::min(ParallelAlgorithms::WorkerCount(),
+                           std::max((int32)1, fileCount));
+  ParallelAlgorithms::Run(workers, [&](int32) {
+    std::vector<bool> seen(tracks.size());
+    std::vector<std::pair<int32, int32>> scored; // score, track
+    for (;;) {
+      int32 f = next.fetch_add(1);
+      if (f >= fileCount || fCancel)
+        return;
+
+      FileKey file = PrepareFile(fFiles[f]);
+      std::fill(seen.begin(), seen.end(), false);
+      scored.clear();
+      auto consider = [&](int32 t) {
+        if (seen[t])
+          return;
+        seen[t] = true;
+        int32 score = Score(file, tracks[t]);
+        if (score >= 0)
+          scored.push_back(std::make_pair(score, t));
+      };
+
+      if (file.length > 0) {
+        auto first = std::lower_bound(
+            byLength.begin(), byLength.end(), file.length - kDurationWindow,
+            [&](int32 t, int32 length) { return tracks[t].length < length; });
+        for (auto it = first; it != byLength.end() &&
+                              tracks[*it].length <= file.length + kDurationWindow;
+             ++it)
+          consider(*it);
+        for (int32 t : unknownLength)
+          consider(t);
+        auto numbered = byNumber.find(file.number);
+        if (file.number > 0 && numbered != byNumber.end()) {
+          for (int32 t : numbered->second)
+            consider(t);
+        }
+      } else {
+        for (size_t t = 0; t < tracks.size(); t++)
+          consider((int32)t);
+      }
+
+      size_t top = std::min(scored.size(), (size_t)kTopCount);
+      std::partial_sort(scored.begin(), scored.begin() + top, scored.end(),
+                        [](const std::pair<int32, int32> &a,
+                           const std::pair<int32, int32> &b) {
+                          if (a.first != b.first)
+                            return a.first > b.first;
+                          return a.second < b.second;
+                        });
+
+      BMessage message(MSG_MATCH_SCORES);
+      message.AddInt32("generation", fGeneration);
+      message.AddInt32("file", f);
+      for (size_t i = 0; i < top; i++) {
+        message.AddInt32("track", scored[i].second);
+        message.AddInt32("score", scored[i].first);
+      }
+      _Send(message);
+    }
+  });
+
+  if (fCancel)
+    return;
+  BMessage done(MSG_MATCH_SCORES);
+  done.AddInt32("generation", fGeneration);
+  done.AddBool("done", true);
+  _Send(done);
+}
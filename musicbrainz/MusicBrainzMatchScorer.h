@@ -0,0 +1,64 @@
+#ifndef BETON_MUSICBRAINZ_MATCH_SCORER_H
+#define BETON_MUSICBRAINZ_MATCH_SCORER_H
+
+#include "MusicBrainzMatcherWindow.h"
+
+#include <Messenger.h>
+#include <OS.h>
+#include <String.h>
+#include <atomic>
+#include <vector>
+
+/**
+ * @class MusicBrainzMatchScorer
+ * @brief Scores local files against release tracks off the window thread.
+ *
+ * Every file is scored against the tracks on duration, track number and
+ * title (see the weights in MusicBrainzMatchScorer.cpp). Tracks are
+ * prepared once and kept sorted by length, so a file only scores those
+ * within kDurationWindow seconds of its own length plus those with its
+ * track number. Any other pairing would score below zero and never be
+ * picked. Files are spread over ParallelAlgorithms workers.
+ *
+ * As soon as a file is scored, its best kTopCount tracks are sent to the
+ * target as `MSG_MATCH_SCORES`, carrying "generation", "file" (index) and
+ * "track"/"score" pairs, best first. A last message with "done" follows.
+ */
+class MusicBrainzMatchScorer {
+public:
+  static constexpr int32 kTopCount = 5;
+  static constexpr int32 kDurationWindow = 10; ///< Seconds
+
+  explicit MusicBrainzMatchScorer(const BMessenger &target);
+  ~MusicBrainzMatchScorer();
+
+  /**
+   * @brief Starts scoring; cancels a run still in progress.
+   * @param generation Echoed in every message so stale ones can be dropped.
+   * @return B_OK, or the error from spawning the thread.
+   */
+  status_t Start(const std::vector<BString> &files,
+                 const std::vector<MusicBrainzMatchTrackInfo> &tracks,
+                 int32 generation);
+
+  /** @brief Stops the current run and waits for its thread. */
+  void Cancel();
+
+private:
+  static int32 _ThreadEntry(void *data);
+  void _Run();
+
+  static constexpr bigtime_t kSendTimeout = 100000;
+
+  /** @brief Sends `message`, retrying while the target's queue is full. */
+  void _Send(BMessage &message);
+
+  BMessenger fTarget;
+  std::vector<BString> fFiles;
+  std::vector<MusicBrainzMatchTrackInfo> fTracks;
+  int32 fGeneration;
+  thread_id fThread;
+  std::atomic<bool> fCancel;
+};
+
+#endif // BETON_MUSICBRAINZ_MATCH_SCORER_H
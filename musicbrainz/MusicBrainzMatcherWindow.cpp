@@ -3,7 +3,7 @@
 #include "MusicBrainzMatcherWindow.h"
 #include "Debug.h"
 #include "Messages.h"
-#include "MetadataTagIO.h"
+#include "MusicBrainzMatchScorer.h"
 
 #include <Bitmap.h>
 #include <Button.h>
@@ -119,7 +119,7 @@ MusicBrainzMatcherWindow::MusicBrainzMatcherWindow(const std::vector<BString> &f
     : BWindow(BRect(100, 100, 800, 650), B_TRANSLATE("Adjust Album Matching"),
               B_TITLED_WINDOW, B_ASYNCHRONOUS_CONTROLS),
       fFiles(files), fTracks(tracks), fInitialMapping(initialMapping),
-      fTarget(target) {
+      fTarget(target), fScorer(nullptr), fScoreGeneration(0) {
   DEBUG_PRINT("Files: %lu, Tracks: %lu\n", fFiles.size(),
               fTracks.size());
 
@@ -130,6 +130,7 @@ MusicBrainzMatcherWindow::MusicBrainzMatcherWindow(const std::vector<BString> &f
 
 MusicBrainzMatcherWindow::~MusicBrainzMatcherWindow() {
   DEBUG_PRINT("Destructor called.\n");
+  delete fScorer;
 }
 
 /**
@@ -319,6 +320,25 @@ void MusicBrainzMatcherWindow::MessageReceived(BMessage *msg) {
   case MSG_SMART_MATCH:
     _SmartMatch();
     break;
+  case MSG_MATCH_SCORES: {
+    if (msg->GetInt32("generation", -1) != fScoreGeneration)
+      break;
+    if (msg->GetBool("done", false)) {
+      _AssignCandidates();
+      break;
+    }
+    int32 file = msg->GetInt32("file", -1);
+    int32 track;
+    int32 score;
+    for (int32 i = 0; msg->FindInt32("track", i, &track) == B_OK &&
+                      msg->FindInt32("score", i, &score) == B_OK;
+         i++) {
+      if (file >= 0 && file < (int32)fFiles.size() && track >= 0 &&
+          track < (int32)fTracks.size())
+        fCandidates.push_back({score, (size_t)file, (size_t)track});
+    }
+    break;
+  }
   case MSG_MATCH_CANCEL:
     Quit();
     break;
@@ -361,53 +381,29 @@ void MusicBrainzMatcherWindow::_Apply() {
 }
 
 /**
- * @brief Helper to calculate Levenshtein distance for fuzzy string matching.
+ * @brief Starts weighted automatic matching of files to tracks.
+ *
+ * The MusicBrainzMatchScorer scores every file against the tracks on
+ * duration, track number and name in the background. Its candidates come
+ * back as MSG_MATCH_SCORES; once all are in, _AssignCandidates() fills the
+ * track list.
  */
-int _LevenshteinDistance(const char *s1, const char *s2) {
-  int len1 = strlen(s1);
-  int len2 = strlen(s2);
-  std::vector<std::vector<int>> d(len1 + 1, std::vector<int>(len2 + 1));
-
-  for (int i = 0; i <= len1; i++)
-    d[i][0] = i;
-  for (int j = 0; j <= len2; j++)
-    d[0][j] = j;
-
-  for (int i = 1; i <= len1; i++) {
-    for (int j = 1; j <= len2; j++) {
-      int cost = (tolower(s1[i - 1]) == tolower(s2[j - 1])) ? 0 : 1;
-      d[i][j] =
-          std::min({d[i - 1][j] + 1, d[i][j - 1] + 1, d[i - 1][j - 1] + cost});
-    }
-  }
-  return d[len1][len2];
-}
+void MusicBrainzMatcherWindow::_SmartMatch() {
+  DEBUG_PRINT("_SmartMatch (Weighted Scoring) start\n");
 
-static int ParseDuration(const BString &durStr) {
-  if (durStr.IsEmpty())
-    return 0;
-  int min = 0, sec = 0;
-  if (sscanf(durStr.String(), "%d:%d", &min, &sec) >= 2) {
-    return min * 60 + sec;
-  }
-  return 0;
+  fCandidates.clear();
+  fScoreGeneration++;
+  if (!fScorer)
+    fScorer = new MusicBrainzMatchScorer(BMessenger(this));
+  if (fScorer->Start(fFiles, fTracks, fScoreGeneration) != B_OK)
+    _AssignCandidates();
 }
 
 /**
- * @brief Attempts to automatically match files to tracks.
- *
- * Uses a weighted scoring system to determine the best match:
- * 1. Duration Match: Checks if file length matches track length (within
- * tolerance).
- * 2. Track Number Match: Checks if metadata track number matches MB index.
- * 3. Name Similarity: Checks for substring matches or Levenshtein distance
- * between filename and track name.
- *
- * Populates the track list with the best guesses.
+ * @brief Assigns each file the best-scoring free track from the collected
+ * candidates and rebuilds the track list.
  */
-void MusicBrainzMatcherWindow::_SmartMatch() {
-  DEBUG_PRINT("_SmartMatch (Weighted Scoring) start\n");
-
+void MusicBrainzMatcherWindow::_AssignCandidates() {
   if (fTrackListView) {
     for (int32 i = 0; i < fTrackListView->CountItems(); i++) {
       delete fTrackListView->ItemAt(i);
@@ -415,103 +411,16 @@ void MusicBrainzMatcherWindow::_SmartMatch() {
     fTrackListView->MakeEmpty();
   }
 
-  struct Score {
-    int score;
-    size_t fileIdx;
-    size_t trackIdx;
-  };
-
-  std::vector<Score> allScores;
-  allScores.reserve(fFiles.size() * fTracks.size());
-
-  struct FileInfo {
-    int durationSec;
-    int trackNum;
-    BString cleanName;
-  };
-
-  /// Pre-calculate file info (tags, duration, clean name)
-  std::vector<FileInfo> fileInfos(fFiles.size());
-  for (size_t i = 0; i < fFiles.size(); i++) {
-    TagData td;
-    MetadataTagIO::ReadTags(BPath(fFiles[i].String()), td);
-    fileInfos[i].durationSec = td.lengthSec;
-
-    if (td.track > 0) {
-      fileInfos[i].trackNum = td.track;
-    } else {
-      /// Fallback: Try reading track number from filename
-      BString fn = BPath(fFiles[i].String()).Leaf();
-      const char *s = fn.String();
-      while (*s && !isdigit(*s))
-        s++;
-      fileInfos[i].trackNum = (*s) ? atoi(s) : 0;
-    }
-
-    /// Heuristic: Clean filename for similarity check
-    BString fn = BPath(fFiles[i].String()).Leaf();
-    int lastDot = fn.FindLast('.');
-    if (lastDot > 0)
-      fn.Truncate(lastDot);
-
-    const char *p = fn.String();
-    while (*p &&
-           (isdigit(*p) || isspace(*p) || *p == '-' || *p == '.' || *p == '_'))
-      p++;
-    fileInfos[i].cleanName = p;
-  }
-
-  /// Calculate scores matrix
-  for (size_t i = 0; i < fFiles.size(); i++) {
-    for (size_t k = 0; k < fTracks.size(); k++) {
-      int score = 0;
-      const MusicBrainzMatchTrackInfo &trk = fTracks[k];
-      const FileInfo &file = fileInfos[i];
-
-      /// 1. Duration Match
-      int trkLen = ParseDuration(trk.duration);
-      if (trkLen > 0 && file.durationSec > 0) {
-        int diff = std::abs(trkLen - file.durationSec);
-        if (diff <= 1)
-          score += 50;
-        else if (diff <= 3)
-          score += 30;
-        else if (diff <= 10)
-          score -= 20;
-        else
-          score -= 50;
-      }
-
-      /// 2. Track Number Match
-      if (file.trackNum > 0 && file.trackNum == trk.index) {
-        score += 40;
-      }
-
-      /// 3. Name Similarity
-      if (!file.cleanName.IsEmpty() && !trk.name.IsEmpty()) {
-        if (file.cleanName.IFindFirst(trk.name) >= 0) {
-          score += 25;
-        } else {
-          int dist =
-              _LevenshteinDistance(file.cleanName.String(), trk.name.String());
-          int maxLen = std::max(file.cleanName.Length(), trk.name.Length());
-          if (maxLen > 0) {
-            float sim = 1.0f - (float)dist / (float)maxLen;
-            if (sim > 0.8f)
-              score += 20;
-            else if (sim > 0.5f)
-              score += 10;
-          }
-        }
-      }
-
-      allScores.push_back({score, i, k});
-    }
-  }
-
-  /// Greedy Assignment based on score
+  /// Greedy Assignment based on score; candidates arrive in any file order
+  std::vector<Candidate> allScores = fCandidates;
   std::sort(allScores.begin(), allScores.end(),
-            [](const Score &a, const Score &b) { return a.score > b.score; });
+            [](const Candidate &a, const Candidate &b) {
+              if (a.score != b.score)
+                return a.score > b.score;
+              if (a.fileIdx != b.fileIdx)
+                return a.fileIdx < b.fileIdx;
+              return a.trackIdx < b.trackIdx;
+            });
 
   std::vector<MusicBrainzMatchTrackInfo *> assignments(fFiles.size(), nullptr);
   std::vector<bool> fileAssigned(fFiles.size(), false);
@@ -9,6 +9,7 @@
 
 class BListView;
 class BButton;
+class MusicBrainzMatchScorer;
 
 /**
  * @struct MusicBrainzMatchTrackInfo
@@ -42,6 +43,14 @@ private:
   void _BuildUI();
   void _Apply();
   void _SmartMatch();
+  void _AssignCandidates();
+
+  /** @brief A file/track pairing proposed by the scorer. */
+  struct Candidate {
+    int32 score;
+    size_t fileIdx;
+    size_t trackIdx;
+  };
 
   /** @name Data */
   ///@{
@@ -51,6 +60,13 @@ private:
   BMessenger fTarget;
   ///@}
 
+  /** @name Smart Matching */
+  ///@{
+  MusicBrainzMatchScorer *fScorer;
+  int32 fScoreGeneration;
+  std::vector<Candidate> fCandidates; ///< Best tracks per file, as they come
+  ///@}
+
   /** @name UI Components */
   ///@{
   BListView *fFileListView;
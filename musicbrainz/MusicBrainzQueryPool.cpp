@@ -0,0 +1,265 @@
+#include "MusicBrainzQueryPool.h"
+#include "Debug.h"
+
+#include <Autolock.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <fcntl.h>
+#include <stdexcept>
+#include <unistd.h>
+
+using namespace MusicBrainz5;
+
+/**
+ * @class ScopedSilence
+ * @brief Helper to silence libmusicbrainz5's stdout/stderr output during
+ * queries.
+ *
+ * libmusicbrainz5 can be chatty on stderr. This class redirects stderr to
+ * /dev/null while any query runs. The redirection is shared: the first
+ * query sets it up and the last one to finish restores stderr, so workers
+ * do not serialize on it.
+ */
+class ScopedSilence {
+public:
+  ScopedSilence() {
+    BAutolock lock(&sLocker);
+    if (sUsers++ > 0)
+      return;
+    fflush(stderr);
+    sOldStdErr = dup(STDERR_FILENO);
+    int devNull = open("/dev/null", O_WRONLY);
+    dup2(devNull, STDERR_FILENO);
+    close(devNull);
+  }
+
+  ~ScopedSilence() {
+    BAutolock lock(&sLocker);
+    if (--sUsers > 0)
+      return;
+    fflush(stderr);
+    dup2(sOldStdErr, STDERR_FILENO);
+    close(sOldStdErr);
+  }
+
+private:
+  static BLocker sLocker;
+  static int32 sUsers;
+  static int sOldStdErr;
+};
+
+BLocker ScopedSilence::sLocker("SilenceLocker");
+int32 ScopedSilence::sUsers = 0;
+int ScopedSilence::sOldStdErr = -1;
+
+struct MusicBrainzQueryPool::Job {
+  enum State { kQueued, kRunning, kAbandoned, kDone };
+
+  BString userAgent;
+  std::string entity;
+  std::string id;
+  std::string resource;
+  CQuery::tParamMap params;
+
+  State state = kQueued; ///< Guarded by the pool lock
+  std::unique_ptr<CMetadata> result;
+  std::string error;
+  sem_id done = -1;
+
+  ~Job() {
+    if (done >= B_OK)
+      delete_sem(done);
+  }
+};
+
+MusicBrainzQueryPool &MusicBrainzQueryPool::Default() {
+  // Never destroyed: quitting must not wait for a query stuck in the network.
+  static MusicBrainzQueryPool *sPool = new MusicBrainzQueryPool();
+  return *sPool;
+}
+
+MusicBrainzQueryPool::MusicBrainzQueryPool()
+    : fLock("MusicBrainzQueryPool"),
+      fWakeup(create_sem(0, "mb_query_wakeup")),
+      fWorkers(0),
+      fRunning(0),
+      fAbandoned(0) {}
+
+CMetadata MusicBrainzQueryPool::Run(const BString &userAgent,
+                                    const std::string &entity,
+                                    const std::string &id,
+                                    const std::string &resource,
+                                    const CQuery::tParamMap &params,
+                                    const std::function<bool()> &shouldCancel,
+                                    bigtime_t timeout) {
+  std::shared_ptr<Job> job = std::make_shared<Job>();
+  job->userAgent = userAgent;
+  job->entity = entity;
+  job->id = id;
+  job->resource = resource;
+  job->params = params;
+  job->done = create_sem(0, "mb_query_done");
+  if (job->done < B_OK || fWakeup < B_OK)
+    return CMetadata();
+
+  {
+    BAutolock lock(&fLock);
+    while (fWorkers - fAbandoned < kWorkerCount) {
+      int32 workers = fWorkers;
+      _SpawnWorkerLocked();
+      if (fWorkers == workers)
+        break;
+    }
+    if (fWorkers - fAbandoned <= 0)
+      return CMetadata();
+    fQueue.push_back(job);
+  }
+  release_sem(fWakeup);
+
+  const bigtime_t deadline = system_time() + timeout;
+  while (acquire_sem_etc(job->done, 1, B_RELATIVE_TIMEOUT, kPollInterval) !=
+         B_OK) {
+    bool cancelled = shouldCancel && shouldCancel();
+    if (!cancelled && system_time() < deadline)
+      continue;
+
+    BAutolock lock(&fLock);
+    if (job->state == Job::kDone)
+      break;
+    _GiveUpLocked(job);
+    if (cancelled) {
+      fCancelled.fetch_add(1, std::memory_order_relaxed);
+      return CMetadata();
+    }
+    fTimedOut.fetch_add(1, std::memory_order_relaxed);
+    throw std::runtime_error("Timeout waiting for MusicBrainz");
+  }
+
+  // The worker filled the job in before marking it done.
+  if (!job->error.empty()) {
+    fFailed.fetch_add(1, std::memory_order_relaxed);
+    throw std::runtime_error(job->error);
+  }
+  fCompleted.fetch_add(1, std::memory_order_relaxed);
+  return job->result ? *job->result : CMetadata();
+}
+
+BString MusicBrainzQueryPool::Report() const {
+  int32 queued, running, abandoned, workers;
+  {
+    BAutolock lock(&fLock);
+    queued = (int32)fQueue.size();
+    running = fRunning;
+    abandoned = fAbandoned;
+    workers = fWorkers;
+  }
+  BString report;
+  report.SetToFormat("MusicBrainz queries: %" B_PRId32 " queued, %" B_PRId32
+                     " running, %" B_PRId32 " abandoned on %" B_PRId32
+                     " threads (%" B_PRIu32 " done, %" B_PRIu32
+                     " failed, %" B_PRIu32 " cancelled, %" B_PRIu32
+                     " timed out)\n",
+                     queued, running, abandoned, workers,
+                     fCompleted.load(std::memory_order_relaxed),
+                     fFailed.load(std::memory_order_relaxed),
+                     fCancelled.load(std::memory_order_relaxed),
+                     fTimedOut.load(std::memory_order_relaxed));
+  return report;
+}
+
+void MusicBrainzQueryPool::ResetStats() {
+  fCompleted.store(0, std::memory_order_relaxed);
+  fFailed.store(0, std::memory_order_relaxed);
+  fCancelled.store(0, std::memory_order_relaxed);
+  fTimedOut.store(0, std::memory_order_relaxed);
+}
+
+int32 MusicBrainzQueryPool::_WorkerThread(void *data) {
+  static_cast<MusicBrainzQueryPool *>(data)->_Work();
+  return 0;
+}
+
+void MusicBrainzQueryPool::_Work() {
+  std::unique_ptr<CQuery> query;
+  BString queryAgent;
+
+  for (;;) {
+    if (acquire_sem(fWakeup) != B_OK)
+      return;
+
+    std::shared_ptr<Job> job;
+    {
+      BAutolock lock(&fLock);
+      // A cancelled job leaves its wakeup behind.
+      if (fQueue.empty())
+        continue;
+      job = fQueue.front();
+      fQueue.pop_front();
+      job->state = Job::kRunning;
+      fRunning++;
+    }
+
+    CMetadata *result = nullptr;
+    std::string error;
+    try {
+      ScopedSilence silence;
+      if (!query || queryAgent != job->userAgent) {
+        query.reset(new CQuery(job->userAgent.String()));
+        queryAgent = job->userAgent;
+      }
+      result = new CMetadata(
+          query->Query(job->entity, job->id, job->resource, job->params));
+    } catch (const std::exception &ex) {
+      error = ex.what();
+    } catch (...) {
+      error = "Unknown non-std exception in MusicBrainz query";
+    }
+    // Do not trust a query object that has just thrown.
+    if (!error.empty())
+      query.reset();
+
+    BAutolock lock(&fLock);
+    if (job->state == Job::kAbandoned) {
+      fAbandoned--;
+      delete result;
+      DEBUG_PRINT("[MBQueryPool] abandoned query to %s finished\n",
+                  job->entity.c_str());
+    } else {
+      fRunning--;
+      job->result.reset(result);
+      job->error = error;
+      job->state = Job::kDone;
+      release_sem(job->done);
+    }
+    // Replacements were started while this thread was stuck.
+    if (fWorkers - fAbandoned > kWorkerCount) {
+      fWorkers--;
+      return;
+    }
+  }
+}
+
+void MusicBrainzQueryPool::_SpawnWorkerLocked() {
+  thread_id thread = spawn_thread(_WorkerThread, "mb_query_worker",
+                                  B_NORMAL_PRIORITY, this);
+  if (thread < B_OK)
+    return;
+  resume_thread(thread);
+  fWorkers++;
+}
+
+/** @brief Withdraws a queued job, or leaves a running one to its worker. */
+void MusicBrainzQueryPool::_GiveUpLocked(const std::shared_ptr<Job> &job) {
+  if (job->state == Job::kQueued) {
+    auto it = std::find(fQueue.begin(), fQueue.end(), job);
+    if (it != fQueue.end())
+      fQueue.erase(it);
+    return;
+  }
+  job->state = Job::kAbandoned;
+  fRunning--;
+  fAbandoned++;
+  if (fAbandoned <= kMaxAbandoned)
+    _SpawnWorkerLocked();
+}
@@ -0,0 +1,90 @@
+#ifndef BETON_MUSICBRAINZ_QUERY_POOL_H
+#define BETON_MUSICBRAINZ_QUERY_POOL_H
+
+#include <Locker.h>
+#include <OS.h>
+#include <String.h>
+#include <SupportDefs.h>
+
+#include <musicbrainz5/Metadata.h>
+#include <musicbrainz5/Query.h>
+
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <string>
+
+/**
+ * @class MusicBrainzQueryPool
+ * @brief Runs blocking libmusicbrainz5 queries on a few persistent threads.
+ *
+ * libmusicbrainz5 queries block and can hang when the network stalls, so
+ * callers wait for them here with a timeout. kWorkerCount threads take
+ * queries from a queue; each keeps its CQuery between queries and only
+ * builds a new one when the User-Agent changes or a query failed.
+ *
+ * A caller that times out or is cancelled before its query started simply
+ * removes it from the queue. One that gives up on a running query leaves
+ * the worker to finish it and throw the answer away; such a worker counts
+ * as abandoned, and a replacement is started as long as fewer than
+ * kMaxAbandoned are stuck, so a dead server cannot pile up threads.
+ *
+ * Report() shows the counters in the audio health window.
+ */
+class MusicBrainzQueryPool {
+public:
+  static const int32 kWorkerCount = 2;
+  static const int32 kMaxAbandoned = 4;
+  static const bigtime_t kDefaultTimeout = 20000000;
+  static const bigtime_t kPollInterval = 100000;
+
+  static MusicBrainzQueryPool &Default();
+
+  /**
+   * @brief Runs `CQuery::Query(entity, id, resource, params)` on a worker.
+   *
+   * Polls `shouldCancel` every kPollInterval.
+   * @return The answer, or empty metadata if cancelled.
+   * @throws std::runtime_error if the query failed or took longer than
+   * `timeout`.
+   */
+  MusicBrainz5::CMetadata Run(const BString &userAgent,
+                              const std::string &entity,
+                              const std::string &id,
+                              const std::string &resource,
+                              const MusicBrainz5::CQuery::tParamMap &params,
+                              const std::function<bool()> &shouldCancel,
+                              bigtime_t timeout = kDefaultTimeout);
+
+  /** @name Counters */
+  ///@{
+  /** @brief One line: queued, running and abandoned queries, outcomes. */
+  BString Report() const;
+  void ResetStats();
+  ///@}
+
+private:
+  struct Job;
+
+  MusicBrainzQueryPool();
+
+  static int32 _WorkerThread(void *data);
+  void _Work();
+  void _SpawnWorkerLocked();
+  void _GiveUpLocked(const std::shared_ptr<Job> &job);
+
+  mutable BLocker fLock; ///< Guards the queue, job states and thread counts
+  sem_id fWakeup;        ///< Released once per queued job
+  std::deque<std::shared_ptr<Job>> fQueue;
+  int32 fWorkers;   ///< Threads alive, abandoned ones included
+  int32 fRunning;   ///< Queries running for a waiting caller
+  int32 fAbandoned; ///< Queries still running for nobody
+
+  std::atomic<uint32> fCompleted{0};
+  std::atomic<uint32> fFailed{0};
+  std::atomic<uint32> fCancelled{0};
+  std::atomic<uint32> fTimedOut{0};
+};
+
+#endif // BETON_MUSICBRAINZ_QUERY_POOL_H
@@ -0,0 +1,133 @@
+#include "MusicBrainzRequestScheduler.h"
+
+#include <Autolock.h>
+
+#include <algorithm>
+
+namespace {
+thread_local MusicBrainzRequestScheduler::Priority sThreadPriority =
+    MusicBrainzRequestScheduler::kInteractive;
+}
+
+MusicBrainzRequestScheduler::PriorityScope::PriorityScope(Priority priority)
+    : fPrevious(sThreadPriority) {
+  sThreadPriority = priority;
+}
+
+MusicBrainzRequestScheduler::PriorityScope::~PriorityScope() {
+  sThreadPriority = fPrevious;
+}
+
+MusicBrainzRequestScheduler::Priority
+MusicBrainzRequestScheduler::CurrentPriority() {
+  return sThreadPriority;
+}
+
+MusicBrainzRequestScheduler &MusicBrainzRequestScheduler::Default() {
+  static MusicBrainzRequestScheduler sScheduler;
+  return sScheduler;
+}
+
+MusicBrainzRequestScheduler::MusicBrainzRequestScheduler()
+    : fLock("MusicBrainzRequestScheduler"), fNextTicket(1) {
+  fBuckets[kMusicBrainz].interval = kMusicBrainzInterval;
+  fBuckets[kMusicBrainz].burst = 1;
+  fBuckets[kCoverArtArchive].interval = kCoverArtInterval;
+  fBuckets[kCoverArtArchive].burst = kCoverArtBurst;
+  for (Bucket &bucket : fBuckets)
+    bucket.tokens = bucket.burst;
+}
+
+MusicBrainzRequestScheduler::Host
+MusicBrainzRequestScheduler::HostFor(const BString &url) {
+  // Covers are redirected from coverartarchive.org to archive.org.
+  if (url.IFindFirst("archive.org/") >= 0)
+    return kCoverArtArchive;
+  return kMusicBrainz;
+}
+
+bool MusicBrainzRequestScheduler::Acquire(
+    Host host, Priority priority, const std::function<bool()> &shouldCancel) {
+  Bucket &bucket = fBuckets[host];
+  uint64 ticket;
+  {
+    BAutolock lock(&fLock);
+    ticket = fNextTicket++;
+    bucket.waiting[priority].push_back(ticket);
+  }
+
+  for (;;) {
+    bigtime_t wait = kPollInterval;
+    {
+      BAutolock lock(&fLock);
+      if (shouldCancel && shouldCancel()) {
+        _RemoveLocked(bucket, ticket);
+        return false;
+      }
+      bigtime_t now = system_time();
+      _RefillLocked(bucket, now);
+      if (_IsNextLocked(bucket, ticket)) {
+        if (bucket.tokens >= 1) {
+          bucket.tokens -= 1;
+          _RemoveLocked(bucket, ticket);
+          return true;
+        }
+        wait = (bigtime_t)((1 - bucket.tokens) * bucket.interval);
+      }
+    }
+    // Threads further back only watch for cancellation and their turn.
+    snooze(std::max((bigtime_t)1000, std::min(wait, kPollInterval)));
+  }
+}
+
+bool MusicBrainzRequestScheduler::Claim(
+    const BString &key, const std::function<bool()> &shouldCancel) {
+  for (;;) {
+    {
+      BAutolock lock(&fLock);
+      if (fInFlight.insert(key).second)
+        return true;
+    }
+    if (shouldCancel && shouldCancel())
+      return false;
+    snooze(kPollInterval);
+  }
+}
+
+void MusicBrainzRequestScheduler::Release(const BString &key) {
+  BAutolock lock(&fLock);
+  fInFlight.erase(key);
+}
+
+void MusicBrainzRequestScheduler::_RefillLocked(Bucket &bucket,
+                                                bigtime_t now) {
+  if (bucket.refilled == 0) {
+    bucket.refilled = now;
+    return;
+  }
+  bucket.tokens = std::min((double)bucket.burst,
+                           bucket.tokens + (double)(now - bucket.refilled) /
+                                               bucket.interval);
+  bucket.refilled = now;
+}
+
+/** @brief Whether `ticket` is the first of the highest waiting class. */
+bool MusicBrainzRequestScheduler::_IsNextLocked(const Bucket &bucket,
+                                                uint64 ticket) {
+  for (const std::deque<uint64> &queue : bucket.waiting) {
+    if (!queue.empty())
+      return queue.front() == ticket;
+  }
+  return false;
+}
+
+void MusicBrainzRequestScheduler::_RemoveLocked(Bucket &bucket,
+                                                uint64 ticket) {
+  for (std::deque<uint64> &queue : bucket.waiting) {
+    auto it = std::find(queue.begin(), queue.end(), ticket);
+    if (it != queue.end()) {
+      queue.erase(it);
+      return;
+    }
+  }
+}
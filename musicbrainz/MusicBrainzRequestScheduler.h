@@ -0,0 +1,105 @@
+#ifndef BETON_MUSICBRAINZ_REQUEST_SCHEDULER_H
+#define BETON_MUSICBRAINZ_REQUEST_SCHEDULER_H
+
+#include <Locker.h>
+#include <OS.h>
+#include <String.h>
+#include <SupportDefs.h>
+
+#include <deque>
+#include <functional>
+#include <set>
+
+/**
+ * @class MusicBrainzRequestScheduler
+ * @brief Decides when the MusicBrainz client may send its next request.
+ *
+ * Each service host has a token bucket: MusicBrainz one request every
+ * kMusicBrainzInterval, the Cover Art Archive (and the archive.org servers
+ * it redirects to) one every kCoverArtInterval with bursts of
+ * kCoverArtBurst. Threads asking for a token queue per host; interactive
+ * requests are always served before background ones, and requests of one
+ * class in the order they asked.
+ *
+ * Claim() keeps identical requests from running twice at once: a thread
+ * asking for a URL another thread is fetching waits for it to finish and
+ * then finds the answer in the MusicBrainzResponseCache.
+ *
+ * The priority of a request is that of the thread making it, interactive
+ * unless a PriorityScope says otherwise.
+ *
+ * Waiting threads poll their `shouldCancel` callback every kPollInterval.
+ * All methods are thread-safe.
+ */
+class MusicBrainzRequestScheduler {
+public:
+  enum Host { kMusicBrainz = 0, kCoverArtArchive, kHostCount };
+
+  enum Priority {
+    kInteractive = 0, ///< The user waits for the answer
+    kBackground,      ///< Batches; yield to interactive requests
+    kPriorityCount
+  };
+
+  static const bigtime_t kMusicBrainzInterval = 1100000;
+  static const bigtime_t kCoverArtInterval = 250000;
+  static const int32 kCoverArtBurst = 4;
+  static const bigtime_t kPollInterval = 50000;
+
+  /** @brief Runs the requests of the calling thread at another priority. */
+  class PriorityScope {
+  public:
+    explicit PriorityScope(Priority priority);
+    ~PriorityScope();
+
+  private:
+    Priority fPrevious;
+  };
+
+  static MusicBrainzRequestScheduler &Default();
+
+  /** @brief Priority of the calling thread's requests. */
+  static Priority CurrentPriority();
+
+  /** @brief Bucket a request to `url` draws from. */
+  static Host HostFor(const BString &url);
+
+  /**
+   * @brief Waits for a token of `host`.
+   * @return False if `shouldCancel` returned true first.
+   */
+  bool Acquire(Host host, Priority priority,
+               const std::function<bool()> &shouldCancel);
+
+  /**
+   * @brief Marks `key` as being fetched by the calling thread; waits first
+   * while another thread fetches it.
+   * @return False if `shouldCancel` returned true while waiting.
+   */
+  bool Claim(const BString &key, const std::function<bool()> &shouldCancel);
+
+  /** @brief Ends a Claim(). */
+  void Release(const BString &key);
+
+private:
+  struct Bucket {
+    bigtime_t interval = 0;
+    int32 burst = 1;
+    double tokens = 1;
+    bigtime_t refilled = 0;
+    std::deque<uint64> waiting[kPriorityCount]; ///< Tickets, oldest first
+  };
+
+  MusicBrainzRequestScheduler();
+
+  void _RefillLocked(Bucket &bucket, bigtime_t now);
+  static bool _IsNextLocked(const Bucket &bucket, uint64 ticket);
+  static void _RemoveLocked(Bucket &bucket, uint64 ticket);
+
+  BLocker fLock;
+  Bucket fBuckets[kHostCount];
+  uint64 fNextTicket;
+  std::set<BString> fInFlight;
+};
+
+#endif // BETON_MUSICBRAINZ_REQUEST_SCHEDULER_H
@@ -0,0 +1,217 @@
+#include "MusicBrainzResponseCache.h"
+#include "Debug.h"
+
+#include <Autolock.h>
+#include <Directory.h>
+#include <Entry.h>
+#include <File.h>
+#include <FindDirectory.h>
+#include <OS.h>
+
+#include <algorithm>
+#include <ctype.h>
+#include <vector>
+
+MusicBrainzResponseCache &MusicBrainzResponseCache::Default() {
+  static MusicBrainzResponseCache sCache;
+  return sCache;
+}
+
+MusicBrainzResponseCache::MusicBrainzResponseCache()
+    : fLock("MusicBrainzResponseCache"), fInitialized(false), fTotalSize(0) {}
+
+BString MusicBrainzResponseCache::NormalizeUrl(const BString &url) {
+  BString lower(url);
+  lower.ToLower();
+
+  BString collapsed;
+  bool space = false;
+  for (const char *p = lower.String(); *p != '\0'; p++) {
+    if (isspace((unsigned char)*p)) {
+      space = true;
+      continue;
+    }
+    if (space && !collapsed.IsEmpty())
+      collapsed << ' ';
+    space = false;
+    collapsed << *p;
+  }
+
+  int32 query = collapsed.FindFirst('?');
+  if (query < 0)
+    return collapsed;
+
+  std::vector<BString> params;
+  int32 start = query + 1;
+  while (start <= collapsed.Length()) {
+    int32 end = collapsed.FindFirst('&', start);
+    if (end < 0)
+      end = collapsed.Length();
+    BString param;
+    collapsed.CopyInto(param, start, end - start);
+    if (!param.IsEmpty())
+      params.push_back(param);
+    start = end + 1;
+  }
+  std::sort(params.begin(), params.end());
+
+  BString normalized;
+  collapsed.CopyInto(normalized, 0, query);
+  for (size_t i = 0; i < params.size(); i++)
+    normalized << (i == 0 ? "?" : "&") << params[i];
+  return normalized;
+}
+
+bool MusicBrainzResponseCache::Get(const BString &url, int64 maxAge,
+                                   BMessage &data) {
+  const BString normalized = NormalizeUrl(url);
+  BString path;
+  {
+    BAutolock lock(&fLock);
+    if (_InitLocked() != B_OK)
+      return false;
+    path = _PathFor(normalized);
+  }
+
+  BFile file(path.String(), B_READ_ONLY);
+  BMessage entry;
+  if (file.InitCheck() != B_OK || entry.Unflatten(&file) != B_OK)
+    return false;
+
+  // Two URLs with the same hash replace each other's entry.
+  int64 stored = entry.GetInt64("stored", 0);
+  if (normalized != entry.GetString("url", "") ||
+      entry.FindMessage("data", &data) != B_OK)
+    return false;
+  if ((int64)real_time_clock() - stored > maxAge) {
+    DEBUG_PRINT("MusicBrainzResponseCache: stale %s\n", normalized.String());
+    return false;
+  }
+  return true;
+}
+
+void MusicBrainzResponseCache::Put(const BString &url, const BMessage &data) {
+  const BString normalized = NormalizeUrl(url);
+  BAutolock lock(&fLock);
+  if (_InitLocked() != B_OK)
+    return;
+
+  BMessage entry;
+  entry.AddString("url", normalized);
+  entry.AddInt64("stored", (int64)real_time_clock());
+  entry.AddMessage("data", &data);
+
+  // Written aside and renamed, so a reader never sees half an entry.
+  const BString path = _PathFor(normalized);
+  BString partPath(path);
+  partPath << ".part";
+  off_t size = 0;
+  {
+    BFile file(partPath.String(), B_WRITE_ONLY | B_CREATE_FILE | B_ERASE_FILE);
+    if (file.InitCheck() != B_OK || entry.Flatten(&file) != B_OK ||
+        file.GetSize(&size) != B_OK) {
+      BEntry(partPath.String()).Remove();
+      return;
+    }
+  }
+
+  off_t replaced = 0;
+  BEntry old(path.String());
+  if (old.Exists())
+    old.GetSize(&replaced);
+  BEntry part(partPath.String());
+  if (part.Rename(path.String(), true) != B_OK) {
+    part.Remove();
+    return;
+  }
+
+  fTotalSize += size - replaced;
+  if (fTotalSize > kSizeLimit)
+    _EvictLocked();
+}
+
+/** @brief File of the entry for a normalized URL: its 64-bit FNV-1a. */
+BString MusicBrainzResponseCache::_PathFor(const BString &normalized) const {
+  uint64 hash = 14695981039346656037ULL;
+  for (const char *p = normalized.String(); *p != '\0'; p++) {
+    hash ^= (uint8)*p;
+    hash *= 1099511628211ULL;
+  }
+  BString path;
+  path.SetToFormat("%s/%016llx", fDirectory.Path(), (unsigned long long)hash);
+  return path;
+}
+
+status_t MusicBrainzResponseCache::_InitLocked() {
+  if (fInitialized)
+    return fDirectory.InitCheck();
+  fInitialized = true;
+
+  status_t status = find_directory(B_USER_CACHE_DIRECTORY, &fDirectory);
+  if (status != B_OK)
+    return status;
+  fDirectory.Append("BeTon/musicbrainz");
+  create_directory(fDirectory.Path(), 0755);
+
+  BDirectory dir(fDirectory.Path());
+  status = dir.InitCheck();
+  if (status != B_OK) {
+    fDirectory.Unset();
+    return status;
+  }
+
+  BEntry entry;
+  while (dir.GetNextEntry(&entry) == B_OK) {
+    char name[B_FILE_NAME_LENGTH];
+    off_t size = 0;
+    if (entry.GetName(name) == B_OK && BString(name).EndsWith(".part"))
+      entry.Remove();
+    else if (entry.GetSize(&size) == B_OK)
+      fTotalSize += size;
+  }
+  return B_OK;
+}
+
+/**
+ * @brief Removes the oldest entries until the cache is back under three
+ * quarters of its limit.
+ */
+void MusicBrainzResponseCache::_EvictLocked() {
+  struct Entry {
+    BString name;
+    off_t size;
+    time_t modified;
+  };
+
+  BDirectory dir(fDirectory.Path());
+  if (dir.InitCheck() != B_OK)
+    return;
+
+  std::vector<Entry> entries;
+  fTotalSize = 0;
+  BEntry entry;
+  while (dir.GetNextEntry(&entry) == B_OK) {
+    Entry item;
+    char name[B_FILE_NAME_LENGTH];
+    if (entry.GetName(name) != B_OK || entry.GetSize(&item.size) != B_OK ||
+        entry.GetModificationTime(&item.modified) != B_OK)
+      continue;
+    item.name = name;
+    fTotalSize += item.size;
+    if (!item.name.EndsWith(".part"))
+      entries.push_back(item);
+  }
+
+  std::sort(entries.begin(), entries.end(),
+            [](const Entry &a, const Entry &b) {
+              return a.modified < b.modified;
+            });
+
+  const off_t target = kSizeLimit / 4 * 3;
+  for (const Entry &item : entries) {
+    if (fTotalSize <= target)
+      break;
+    if (BEntry(&dir, item.name.String()).Remove() == B_OK)
+      fTotalSize -= item.size;
+  }
+}
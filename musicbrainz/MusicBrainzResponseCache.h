@@ -0,0 +1,61 @@
+#ifndef BETON_MUSICBRAINZ_RESPONSE_CACHE_H
+#define BETON_MUSICBRAINZ_RESPONSE_CACHE_H
+
+#include <Locker.h>
+#include <Message.h>
+#include <Path.h>
+#include <String.h>
+#include <SupportDefs.h>
+
+/**
+ * @class MusicBrainzResponseCache
+ * @brief On-disk cache of MusicBrainz and Cover Art Archive answers.
+ *
+ * Entries are keyed by the normalized request URL (NormalizeUrl()) and hold
+ * what the client made of the answer as a BMessage, along with the time it
+ * was stored. The caller decides how old an entry may be: searches go
+ * stale after kSearchMaxAge, lookups of one entity by MBID, which rarely
+ * change, after kEntityMaxAge.
+ *
+ * Entries live under ~/config/cache/BeTon/musicbrainz, one file per URL
+ * named after its hash; once past kSizeLimit the oldest ones are removed.
+ *
+ * All methods are thread-safe.
+ */
+class MusicBrainzResponseCache {
+public:
+  static const off_t kSizeLimit = 64LL * 1024 * 1024;
+  static const int64 kSearchMaxAge = 24 * 3600;      ///< Seconds
+  static const int64 kEntityMaxAge = 30 * 24 * 3600; ///< Seconds
+
+  static MusicBrainzResponseCache &Default();
+
+  /**
+   * @brief Lower-cases `url`, collapses runs of spaces and sorts the query
+   * parameters, so equal requests map to one key.
+   */
+  static BString NormalizeUrl(const BString &url);
+
+  /**
+   * @brief Entry stored for `url` at most `maxAge` seconds ago.
+   * @return False on a miss or a stale entry.
+   */
+  bool Get(const BString &url, int64 maxAge, BMessage &data);
+
+  /** @brief Stores `data` for `url`, replacing an older entry. */
+  void Put(const BString &url, const BMessage &data);
+
+private:
+  MusicBrainzResponseCache();
+
+  status_t _InitLocked();
+  BString _PathFor(const BString &normalized) const;
+  void _EvictLocked();
+
+  BLocker fLock;
+  BPath fDirectory;
+  bool fInitialized;
+  off_t fTotalSize;
+};
+
+#endif // BETON_MUSICBRAINZ_RESPONSE_CACHE_H
@@ -0,0 +1,644 @@
+#include "HlsSegmentFetcher.h"
+#include "Debug.h"
+#include "HttpConnectionPool.h"
+
+#include <Autolock.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+
+/** @brief Longest playlist accepted. */
+static const size_t kMaxPlaylistBytes = 1024 * 1024;
+/** @brief Longest segment accepted; audio segments are far smaller. */
+static const size_t kMaxSegmentBytes = 32 * 1024 * 1024;
+/** @brief Pause before a failed segment is tried again. */
+static const bigtime_t kRetryDelay = 250000;
+/** @brief Variant bandwidth started with, before anything was measured. */
+static const int64 kStartBandwidth = 192000;
+/** @brief Throughput a higher variant needs, relative to its bandwidth. */
+static const double kUpHeadroom = 1.5;
+/** @brief Downloads shorter than this say little about the link. */
+static const bigtime_t kMinSampleTime = 20000;
+
+/** @brief See HlsSegmentFetcher::SetBandwidthCap(). */
+static std::atomic<int64> sBandwidthCap(0);
+
+/** @brief What one load of a master or media playlist found. */
+struct HlsSegmentFetcher::Playlist {
+  struct Entry {
+    BString url;
+    BString map;
+    bool discontinuity = false;
+  };
+
+  bool master = false;
+  std::vector<Variant> variants; ///< Of a master playlist, by bandwidth
+  int64 mediaSequence = 0;
+  bigtime_t targetDuration = 0;
+  bool ended = false;
+  bool supported = true; ///< False for encryption and byte ranges
+  std::vector<Entry> segments;
+};
+
+namespace {
+
+/** @brief Value of attribute `name` in a tag line, unquoted. */
+BString Attribute(const BString &line, const char *name) {
+  BString key(name);
+  key << '=';
+  int32 start = line.FindFirst(':');
+  while (start >= 0) {
+    int32 at = line.FindFirst(key, start);
+    if (at < 0)
+      return "";
+    // A whole attribute name, not the tail of a longer one.
+    if (at == 0 || line[at - 1] == ':' || line[at - 1] == ',') {
+      int32 valueStart = at + key.Length();
+      int32 valueEnd;
+      if (valueStart < line.Length() && line[valueStart] == '"') {
+        valueStart++;
+        valueEnd = line.FindFirst('"', valueStart);
+      } else {
+        valueEnd = line.FindFirst(',', valueStart);
+      }
+      if (valueEnd < 0)
+        valueEnd = line.Length();
+      BString value;
+      line.CopyInto(value, valueStart, valueEnd - valueStart);
+      return value;
+    }
+    start = at + 1;
+  }
+  return "";
+}
+
+} // namespace
+
+HlsSegmentFetcher::HlsSegmentFetcher()
+    : fVariant(0), fTargetDuration(0), fLock("hls segment fetcher"),
+      fNextSequence(0), fOffset(0), fEnded(false), fHeadPending(false),
+      fSwitched(false), fLoading(0), fThroughput(0), fBufferedAhead(0),
+      fQuit(false), fWork(-1), fArrived(-1), fWake(-1), fPlaylistThread(-1) {
+  for (int32 i = 0; i < kParallel; i++)
+    fWorkers[i] = -1;
+}
+
+HlsSegmentFetcher::~HlsSegmentFetcher() { Close(); }
+
+status_t HlsSegmentFetcher::Open(const BString &url) {
+  Close();
+  fQuit = false;
+
+  Playlist playlist;
+  status_t status = _FetchPlaylist(url, playlist, &fQuit);
+  fUrl = url;
+  fVariants.clear();
+  fVariant = 0;
+  if (status == B_OK && playlist.master) {
+    if (playlist.variants.empty())
+      return B_NOT_SUPPORTED;
+    fVariants = playlist.variants;
+    // Nothing measured yet: the best variant a modest link carries.
+    fVariant = _PickVariant(kStartBandwidth);
+    fUrl = fVariants[fVariant].url;
+    playlist = Playlist();
+    status = _FetchPlaylist(fUrl, playlist, &fQuit);
+  }
+  if (status != B_OK)
+    return status;
+  if (playlist.master || playlist.ended || !playlist.supported ||
+      playlist.segments.empty())
+    return B_NOT_SUPPORTED;
+
+  fTargetDuration = std::max<bigtime_t>(playlist.targetDuration, 1000000);
+  // Start a few segments behind the live edge, as libavformat does.
+  int32 first = std::max<int32>(0, (int32)playlist.segments.size() -
+                                       kLiveStart);
+  fNextSequence = playlist.mediaSequence + first;
+  fFirstSegmentUrl = playlist.segments[first].url;
+
+  fWork = create_sem(0, "hls segment work");
+  fArrived = create_sem(0, "hls segment arrived");
+  fWake = create_sem(0, "hls playlist wake");
+  if (fWork < 0 || fArrived < 0 || fWake < 0) {
+    Close();
+    return B_NO_MORE_SEMS;
+  }
+
+  int32 added;
+  _Append(playlist, added);
+
+  fPlaylistThread = spawn_thread(_PlaylistEntry, "hls playlist",
+                                 B_NORMAL_PRIORITY, this);
+  for (int32 i = 0; i < kParallel; i++)
+    fWorkers[i] = spawn_thread(_WorkerEntry, "hls segment", B_NORMAL_PRIORITY,
+                               this);
+  if (fPlaylistThread < 0 || fWorkers[0] < 0) {
+    Close();
+    return B_NO_MORE_THREADS;
+  }
+  resume_thread(fPlaylistThread);
+  for (int32 i = 0; i < kParallel; i++) {
+    if (fWorkers[i] >= 0)
+      resume_thread(fWorkers[i]);
+  }
+  DEBUG_PRINT("HLS fetcher: %s, %zu segments, target %lld ms, variant "
+              "%ld of %zu\n",
+              fUrl.String(), playlist.segments.size(),
+              (long long)fTargetDuration / 1000, (long)fVariant,
+              fVariants.size());
+  return B_OK;
+}
+
+void HlsSegmentFetcher::Close() {
+  fQuit = true;
+  if (fWake >= 0)
+    release_sem(fWake);
+  if (fWork >= 0)
+    release_sem_etc(fWork, kParallel, 0);
+  if (fArrived >= 0)
+    release_sem(fArrived);
+
+  status_t exit;
+  if (fPlaylistThread >= 0)
+    wait_for_thread(fPlaylistThread, &exit);
+  fPlaylistThread = -1;
+  for (int32 i = 0; i < kParallel; i++) {
+    if (fWorkers[i] >= 0)
+      wait_for_thread(fWorkers[i], &exit);
+    fWorkers[i] = -1;
+  }
+
+  if (fWork >= 0)
+    delete_sem(fWork);
+  if (fArrived >= 0)
+    delete_sem(fArrived);
+  if (fWake >= 0)
+    delete_sem(fWake);
+  fWork = fArrived = fWake = -1;
+
+  for (Segment *segment : fSegments)
+    delete segment;
+  fSegments.clear();
+  fOffset = 0;
+  fEnded = false;
+  fLastMap = "";
+  fMapData.clear();
+  fMapDataUrl = "";
+  fHead.clear();
+  fHeadPending = false;
+  fSwitched = false;
+  fLoading = 0;
+  fThroughput = 0;
+  fBufferedAhead = 0;
+}
+
+ssize_t HlsSegmentFetcher::Read(void *buffer, size_t size,
+                                bigtime_t timeout) {
+  const bigtime_t deadline = system_time() + timeout;
+  BAutolock lock(fLock);
+  for (;;) {
+    if (!fSegments.empty()) {
+      Segment *segment = fSegments.front();
+      if (segment->state == Segment::kFailed) {
+        DEBUG_PRINT("HLS fetcher: skipping segment %lld\n",
+                    (long long)segment->sequence);
+        delete segment;
+        fSegments.pop_front();
+        fOffset = 0;
+        release_sem(fWork);
+        continue;
+      }
+
+      if (segment->state == Segment::kDone) {
+        if (fOffset == 0) {
+          if (segment->discontinuity)
+            DEBUG_PRINT("HLS fetcher: discontinuity at segment %lld\n",
+                        (long long)segment->sequence);
+          const size_t headSize = std::min(
+              kHeadBytes, segment->data.size() - segment->mapBytes);
+          fHead.assign(segment->data.begin() + segment->mapBytes,
+                       segment->data.begin() + segment->mapBytes + headSize);
+          fHeadPending = true;
+        }
+
+        const size_t count =
+            std::min(size, segment->data.size() - fOffset);
+        memcpy(buffer, segment->data.data() + fOffset, count);
+        fOffset += count;
+        if (fOffset >= segment->data.size()) {
+          delete segment;
+          fSegments.pop_front();
+          fOffset = 0;
+          release_sem(fWork);
+        }
+        if (count > 0)
+          return (ssize_t)count;
+        continue;
+      }
+    } else if (fEnded) {
+      return 0;
+    }
+
+    if (fQuit)
+      return B_INTERRUPTED;
+    bigtime_t left = deadline - system_time();
+    if (left <= 0)
+      return B_TIMED_OUT;
+    fLock.Unlock();
+    acquire_sem_etc(fArrived, 1, B_RELATIVE_TIMEOUT, left);
+    fLock.Lock();
+  }
+}
+
+bool HlsSegmentFetcher::TakeSegmentHead(std::vector<uint8> &head) {
+  BAutolock lock(fLock);
+  if (!fHeadPending)
+    return false;
+  head.swap(fHead);
+  fHead.clear();
+  fHeadPending = false;
+  return true;
+}
+
+void HlsSegmentFetcher::SetBandwidthCap(int64 bitsPerSecond) {
+  sBandwidthCap.store(std::max<int64>(0, bitsPerSecond),
+                      std::memory_order_relaxed);
+}
+
+int64 HlsSegmentFetcher::BandwidthCap() {
+  return sBandwidthCap.load(std::memory_order_relaxed);
+}
+
+BString HlsSegmentFetcher::ResolveUrl(const BString &playlistUrl,
+                                      const BString &uri) {
+  if (uri.IStartsWith("http://") || uri.IStartsWith("https://"))
+    return uri;
+
+  BString resolved;
+  if (uri.StartsWith("/")) {
+    int32 scheme = playlistUrl.FindFirst("://");
+    if (scheme >= 0) {
+      int32 hostEnd = playlistUrl.FindFirst('/', scheme + 3);
+      if (hostEnd >= 0) {
+        playlistUrl.CopyInto(resolved, 0, hostEnd);
+        return resolved << uri;
+      }
+    }
+  }
+
+  int32 slash = playlistUrl.FindLast('/');
+  if (slash < 0)
+    return uri;
+  playlistUrl.CopyInto(resolved, 0, slash + 1);
+  return resolved << uri;
+}
+
+/** @brief Loads and parses the playlist at `url`. */
+status_t HlsSegmentFetcher::_FetchPlaylist(const BString &url,
+                                          Playlist &playlist,
+                                          const std::atomic<bool> *cancel) {
+  HttpConnectionPool::Request request;
+  request.url = url;
+  request.userAgent = "Mozilla/5.0 (Haiku; x86_64) Beton/1.0";
+  request.maxRedirects = 5;
+  request.maxBytes = kMaxPlaylistBytes;
+  request.cancel = cancel;
+  HttpConnectionPool::Response response;
+  status_t status = HttpConnectionPool::Default().Fetch(request, response);
+  if (status != B_OK)
+    return status;
+  if (response.status < 200 || response.status >= 300 || response.truncated)
+    return B_ERROR;
+
+  BString text((const char *)response.body.data(), response.body.size());
+  if (!text.StartsWith("#EXTM3U"))
+    return B_BAD_DATA;
+
+  BString audioRendition;
+  BString map;
+  bool discontinuity = false;
+  bool variantNext = false;
+  int64 variantBandwidth = 0;
+  BString line;
+  for (int32 start = 0; start < text.Length();) {
+    int32 end = text.FindFirst('\n', start);
+    if (end < 0)
+      end = text.Length();
+    text.CopyInto(line, start, end - start);
+    start = end + 1;
+    line.Trim();
+    if (line.IsEmpty())
+      continue;
+
+    if (line.StartsWith("#EXT-X-STREAM-INF:")) {
+      playlist.master = true;
+      variantNext = true;
+      variantBandwidth = atoll(Attribute(line, "BANDWIDTH").String());
+    } else if (line.StartsWith("#EXT-X-MEDIA:")) {
+      // An audio rendition of its own is what an audio player wants.
+      BString uri = Attribute(line, "URI");
+      if (Attribute(line, "TYPE") == "AUDIO" && !uri.IsEmpty() &&
+          (audioRendition.IsEmpty() || Attribute(line, "DEFAULT") == "YES"))
+        audioRendition = ResolveUrl(url, uri);
+    } else if (line.StartsWith("#EXT-X-TARGETDURATION:")) {
+      playlist.targetDuration = (bigtime_t)(atof(line.String() + 22) * 1e6);
+    } else if (line.StartsWith("#EXT-X-MEDIA-SEQUENCE:")) {
+      playlist.mediaSequence = atoll(line.String() + 22);
+    } else if (line.StartsWith("#EXT-X-DISCONTINUITY") &&
+               !line.StartsWith("#EXT-X-DISCONTINUITY-SEQUENCE")) {
+      discontinuity = true;
+    } else if (line.StartsWith("#EXT-X-MAP:")) {
+      if (!Attribute(line, "BYTERANGE").IsEmpty())
+        playlist.supported = false;
+      map = ResolveUrl(url, Attribute(line, "URI"));
+    } else if (line.StartsWith("#EXT-X-KEY:")) {
+      if (Attribute(line, "METHOD") != "NONE")
+        playlist.supported = false;
+    } else if (line.StartsWith("#EXT-X-BYTERANGE")) {
+      playlist.supported = false;
+    } else if (line.StartsWith("#EXT-X-ENDLIST")) {
+      playlist.ended = true;
+    } else if (line[0] != '#') {
+      BString resolved = ResolveUrl(url, line);
+      if (variantNext) {
+        Variant variant;
+        variant.url = resolved;
+        variant.bandwidth = variantBandwidth;
+        playlist.variants.push_back(variant);
+        variantNext = false;
+      } else {
+        Playlist::Entry entry;
+        entry.url = resolved;
+        entry.map = map;
+        entry.discontinuity = discontinuity;
+        playlist.segments.push_back(entry);
+        discontinuity = false;
+      }
+    }
+  }
+
+  // Variants then differ in video only, so there is nothing to adapt.
+  if (playlist.master && !audioRendition.IsEmpty()) {
+    playlist.variants.assign(1, Variant());
+    playlist.variants[0].url = audioRendition;
+  }
+  std::stable_sort(playlist.variants.begin(), playlist.variants.end(),
+                   [](const Variant &a, const Variant &b) {
+                     return a.bandwidth < b.bandwidth;
+                   });
+  return B_OK;
+}
+
+/** @brief Adds the segments of `playlist` not seen yet; locks. */
+void HlsSegmentFetcher::_Append(const Playlist &playlist, int32 &added) {
+  BAutolock lock(fLock);
+  added = 0;
+  fEnded = playlist.ended;
+
+  int64 sequence = playlist.mediaSequence;
+  // Another variant numbering its segments differently: start near its
+  // live edge instead of waiting for it to catch up.
+  const int64 last = sequence + (int64)playlist.segments.size();
+  if (fSwitched && last + kMaxQueued < fNextSequence) {
+    fNextSequence = std::max<int64>(
+        sequence, last - std::min<int64>(kLiveStart, last - sequence));
+  }
+  // Fell out of the playlist window: continue at its oldest segment.
+  bool jumped = false;
+  if (sequence > fNextSequence) {
+    jumped = !fSegments.empty() || fNextSequence > 0;
+    fNextSequence = sequence;
+  }
+  for (const Playlist::Entry &entry : playlist.segments) {
+    if (sequence++ < fNextSequence)
+      continue;
+    Segment *segment = new Segment;
+    segment->sequence = sequence - 1;
+    segment->url = entry.url;
+    segment->map = entry.map;
+    segment->discontinuity = entry.discontinuity || jumped || fSwitched;
+    segment->needsMap = !entry.map.IsEmpty() &&
+                        (entry.map != fLastMap || segment->discontinuity ||
+                         fSegments.empty());
+    fLastMap = entry.map;
+    fSegments.push_back(segment);
+    jumped = false;
+    fSwitched = false;
+    added++;
+  }
+  fNextSequence = std::max(fNextSequence, sequence);
+
+  // The reader stalled for long: give up the oldest unread segments past
+  // the download window and go on closer to the live edge.
+  while ((int32)fSegments.size() > kMaxQueued) {
+    delete fSegments[kAhead];
+    fSegments.erase(fSegments.begin() + kAhead);
+    Segment *next = fSegments[kAhead];
+    next->discontinuity = true;
+    next->needsMap = !next->map.IsEmpty();
+  }
+
+  if (added > 0)
+    release_sem_etc(fWork, kParallel, 0);
+}
+
+/**
+ * @brief Highest variant within the cap whose bandwidth is at most `limit`;
+ * the lowest one if none is.
+ */
+int32 HlsSegmentFetcher::_PickVariant(int64 limit) const {
+  const int64 cap = BandwidthCap();
+  if (cap > 0)
+    limit = std::min(limit, cap);
+  int32 picked = 0;
+  for (int32 i = 1; i < (int32)fVariants.size(); i++) {
+    if (fVariants[i].bandwidth <= limit)
+      picked = i;
+  }
+  return picked;
+}
+
+/**
+ * @brief Moves to another variant when the cap, the measured throughput or
+ * the audio buffered ahead call for it; playlist thread.
+ *
+ * Queued segments nobody started on are dropped and come again from the
+ * new variant's playlist, which the caller loads next.
+ */
+void HlsSegmentFetcher::_AdaptVariant() {
+  if (fVariants.size() < 2)
+    return;
+
+  BAutolock lock(fLock);
+  const int64 bandwidth = fVariants[fVariant].bandwidth;
+  // Downloaded but unread segments play before anything fetched now.
+  bigtime_t buffered = fBufferedAhead.load(std::memory_order_relaxed);
+  for (const Segment *segment : fSegments) {
+    if (segment->state == Segment::kDone)
+      buffered += fTargetDuration;
+  }
+
+  int32 target = std::min(fVariant, _PickVariant(INT64_MAX));
+  if (target == fVariant && fThroughput > 0) {
+    const int32 up = _PickVariant((int64)(fThroughput / kUpHeadroom));
+    if (up > fVariant && buffered >= 2 * fTargetDuration)
+      target = up;
+    else if (buffered < fTargetDuration && fThroughput < bandwidth)
+      target = std::min(fVariant - 1, _PickVariant((int64)fThroughput));
+    target = std::max<int32>(0, target);
+  }
+  if (target == fVariant)
+    return;
+
+  DEBUG_PRINT("HLS fetcher: variant %ld -> %ld (%lld bit/s), throughput "
+              "%.0f bit/s, buffered %lld ms\n",
+              (long)fVariant, (long)target,
+              (long long)fVariants[target].bandwidth, fThroughput,
+              (long long)buffered / 1000);
+  while (!fSegments.empty() && fSegments.back()->state == Segment::kQueued) {
+    fNextSequence = fSegments.back()->sequence;
+    delete fSegments.back();
+    fSegments.pop_back();
+  }
+  fLastMap = "";
+  fSwitched = true;
+  fVariant = target;
+  fUrl = fVariants[target].url;
+}
+
+int32 HlsSegmentFetcher::_PlaylistEntry(void *cookie) {
+  static_cast<HlsSegmentFetcher *>(cookie)->_PlaylistLoop();
+  return 0;
+}
+
+/**
+ * @brief Reloads the media playlist: after a target duration when it
+ * changed, after half of one when it did not (RFC 8216, 6.3.4).
+ */
+void HlsSegmentFetcher::_PlaylistLoop() {
+  bigtime_t interval = fTargetDuration;
+  while (!fQuit) {
+    acquire_sem_etc(fWake, 1, B_RELATIVE_TIMEOUT, interval);
+    if (fQuit)
+      break;
+
+    _AdaptVariant();
+    Playlist playlist;
+    int32 added = 0;
+    if (_FetchPlaylist(fUrl, playlist, &fQuit) == B_OK && !playlist.master)
+      _Append(playlist, added);
+    interval = added > 0 ? fTargetDuration : fTargetDuration / 2;
+
+    BAutolock lock(fLock);
+    if (fEnded)
+      break;
+  }
+}
+
+int32 HlsSegmentFetcher::_WorkerEntry(void *cookie) {
+  static_cast<HlsSegmentFetcher *>(cookie)->_WorkerLoop();
+  return 0;
+}
+
+/** @brief Downloads the first queued segment of the window, repeatedly. */
+void HlsSegmentFetcher::_WorkerLoop() {
+  while (!fQuit) {
+    Segment *segment = nullptr;
+    int32 sharing = 0; ///< Downloads the link is split between
+    if (fLock.Lock()) {
+      const size_t window = std::min<size_t>(kAhead, fSegments.size());
+      for (size_t i = 0; i < window; i++) {
+        if (fSegments[i]->state == Segment::kQueued) {
+          segment = fSegments[i];
+          segment->state = Segment::kLoading;
+          sharing = ++fLoading;
+          break;
+        }
+      }
+      fLock.Unlock();
+    }
+    if (segment == nullptr) {
+      acquire_sem_etc(fWork, 1, B_RELATIVE_TIMEOUT, 1000000);
+      continue;
+    }
+
+    // The reader only drops a segment once it is done or failed, so this
+    // one stays put while it loads.
+    double throughput = 0;
+    bool loaded = _Download(*segment, throughput);
+    if (!loaded && !fQuit)
+      snooze(kRetryDelay);
+
+    BAutolock lock(fLock);
+    fLoading--;
+    if (throughput > 0) {
+      // Parallel downloads each see a share of the link.
+      throughput *= std::max<int32>(sharing, fLoading + 1);
+      fThroughput = fThroughput > 0 ? 0.7 * fThroughput + 0.3 * throughput
+                                    : throughput;
+    }
+    if (loaded)
+      segment->state = Segment::kDone;
+    else if (++segment->attempts >= kMaxAttempts)
+      segment->state = Segment::kFailed;
+    else
+      segment->state = Segment::kQueued;
+    release_sem(fArrived);
+    release_sem(fWork);
+  }
+}
+
+/**
+ * @brief Fetches `segment`, with its map in front if it needs one.
+ * @param throughput Set to the segment's bit/s when it was long enough to
+ * measure.
+ */
+bool HlsSegmentFetcher::_Download(Segment &segment, double &throughput) {
+  HttpConnectionPool::Request request;
+  request.userAgent = "Mozilla/5.0 (Haiku; x86_64) Beton/1.0";
+  request.maxRedirects = 5;
+  request.maxBytes = kMaxSegmentBytes;
+  request.timeout = std::max<bigtime_t>(2 * fTargetDuration, 10000000);
+  request.cancel = &fQuit;
+  HttpConnectionPool::Response response;
+
+  std::vector<uint8> data;
+  if (segment.needsMap) {
+    if (fLock.Lock()) {
+      if (fMapDataUrl == segment.map)
+        data = fMapData;
+      fLock.Unlock();
+    }
+    if (data.empty()) {
+      request.url = segment.map;
+      if (HttpConnectionPool::Default().Fetch(request, response) != B_OK ||
+          response.status < 200 || response.status >= 300 ||
+          response.truncated)
+        return false;
+      data.swap(response.body);
+      BAutolock lock(fLock);
+      fMapData = data;
+      fMapDataUrl = segment.map;
+    }
+  }
+  const size_t mapBytes = data.size();
+
+  request.url = segment.url;
+  const bigtime_t start = system_time();
+  if (HttpConnectionPool::Default().Fetch(request, response) != B_OK ||
+      response.status < 200 || response.status >= 300 || response.truncated) {
+    DEBUG_PRINT("HLS fetcher: segment %lld failed (HTTP %ld)\n",
+                (long long)segment.sequence, (long)response.status);
+    return false;
+  }
+  const bigtime_t elapsed = system_time() - start;
+  if (elapsed >= kMinSampleTime)
+    throughput = response.body.size() * 8e6 / elapsed;
+  data.insert(data.end(), response.body.begin(), response.body.end());
+  segment.data.swap(data);
+  segment.mapBytes = mapBytes;
+  return true;
+}
@@ -0,0 +1,157 @@
+#ifndef BETON_HLS_SEGMENT_FETCHER_H
+#define BETON_HLS_SEGMENT_FETCHER_H
+
+#include <Locker.h>
+#include <OS.h>
+#include <String.h>
+#include <SupportDefs.h>
+#include <atomic>
+#include <deque>
+#include <vector>
+
+/**
+ * @class HlsSegmentFetcher
+ * @brief Downloads the segments of a live HLS stream several at a time and
+ * hands them to the demuxer as one byte stream.
+ *
+ * libavformat's HLS demuxer fetches one segment after the other, so a
+ * single slow segment stalls the decoder. Here a playlist thread reloads
+ * the media playlist every target duration and kParallel worker threads
+ * keep the next kAhead segments downloading through the shared
+ * HttpConnectionPool. Read() returns their bytes strictly in playlist
+ * order; a segment that still fails after kMaxAttempts is skipped, so the
+ * stream jumps over it instead of stopping.
+ *
+ * A master playlist is played adaptively: each reload of the media
+ * playlist compares the measured segment throughput and the audio buffered
+ * ahead with the variants' bandwidths, moves up when there is headroom and
+ * down when the buffer drains. A switch takes effect at the next segment
+ * not yet being downloaded, which is marked as a discontinuity.
+ * SetBandwidthCap() limits the variants considered.
+ *
+ * An EXT-X-MAP initialization section is put in front of the first segment
+ * that uses it, and again after each EXT-X-DISCONTINUITY. Timestamps are
+ * not rewritten; the decoder does not use them.
+ *
+ * Only live media playlists are taken. Open() refuses VOD playlists (so
+ * seeking keeps going through libavformat), encrypted segments and byte
+ * ranges; the caller then falls back to the HLS demuxer.
+ */
+class HlsSegmentFetcher {
+public:
+  static const int32 kParallel = 3;    ///< Downloads at the same time
+  static const int32 kAhead = 4;       ///< Segments fetched from the reader's on
+  static const int32 kLiveStart = 3;   ///< Segments from the live edge to start
+  static const int32 kMaxAttempts = 3; ///< Per segment
+  static const int32 kMaxQueued = 64;  ///< Older unread segments are dropped
+  /// Head of each segment kept for TakeSegmentHead().
+  static const size_t kHeadBytes = 128 * 1024;
+
+  HlsSegmentFetcher();
+  ~HlsSegmentFetcher();
+
+  /**
+   * @brief Loads the playlist at `url`, resolving a master playlist to a
+   * variant within the bandwidth cap, and starts downloading.
+   * @return B_NOT_SUPPORTED if the stream needs libavformat's demuxer.
+   */
+  status_t Open(const BString &url);
+  /** @brief Stops and joins all threads. */
+  void Close();
+
+  /**
+   * @brief Next bytes of the stream.
+   * @return Bytes read, 0 once a stream that ended is read through, or
+   * B_TIMED_OUT when nothing arrived within `timeout`.
+   */
+  ssize_t Read(void *buffer, size_t size, bigtime_t timeout);
+
+  /** @brief First segment URL, for container probing. */
+  const BString &FirstSegmentUrl() const { return fFirstSegmentUrl; }
+
+  /**
+   * @brief The head of the last segment Read() entered since the previous
+   * call, for timed metadata; false if it did not enter one.
+   */
+  bool TakeSegmentHead(std::vector<uint8> &head);
+
+  /**
+   * @brief Audio the player has buffered ahead of the demuxer; the longer
+   * it is, the safer a move to a higher variant.
+   */
+  void SetBufferedAhead(bigtime_t ahead) {
+    fBufferedAhead.store(ahead, std::memory_order_relaxed);
+  }
+
+  /**
+   * @brief Highest variant bandwidth in bit/s any fetcher picks from its
+   * next playlist reload on; 0 for no limit.
+   */
+  static void SetBandwidthCap(int64 bitsPerSecond);
+  static int64 BandwidthCap();
+
+  /** @brief `uri` from the playlist at `playlistUrl`, made absolute. */
+  static BString ResolveUrl(const BString &playlistUrl, const BString &uri);
+
+private:
+  struct Segment {
+    int64 sequence = 0;
+    BString url;
+    BString map; ///< URL of its EXT-X-MAP, if any
+    bool discontinuity = false;
+    bool needsMap = false; ///< Map goes in front of the data
+    size_t mapBytes = 0;   ///< Of data, taken by the map
+    enum State { kQueued, kLoading, kDone, kFailed } state = kQueued;
+    int32 attempts = 0;
+    std::vector<uint8> data;
+  };
+
+  struct Playlist;
+
+  struct Variant {
+    BString url;
+    int64 bandwidth = 0; ///< bit/s, from EXT-X-STREAM-INF
+  };
+
+  static status_t _FetchPlaylist(const BString &url, Playlist &playlist,
+                                 const std::atomic<bool> *cancel);
+  void _Append(const Playlist &playlist, int32 &added);
+  int32 _PickVariant(int64 limit) const;
+  void _AdaptVariant();
+  static int32 _PlaylistEntry(void *cookie);
+  void _PlaylistLoop();
+  static int32 _WorkerEntry(void *cookie);
+  void _WorkerLoop();
+  bool _Download(Segment &segment, double &throughput);
+
+  BString fUrl; ///< Media playlist
+  std::vector<Variant> fVariants; ///< Of the master playlist, by bandwidth
+  int32 fVariant;                 ///< Index of the one playing
+  BString fFirstSegmentUrl;
+  bigtime_t fTargetDuration;
+
+  BLocker fLock; ///< Guards everything below
+  std::deque<Segment *> fSegments; ///< From the reader's segment on
+  int64 fNextSequence; ///< First sequence not yet in fSegments
+  BString fLastMap;    ///< Map of the last segment in fSegments
+  std::vector<uint8> fMapData;
+  BString fMapDataUrl;
+  size_t fOffset; ///< Into fSegments.front()
+  bool fEnded;    ///< EXT-X-ENDLIST appeared
+  std::vector<uint8> fHead;
+  bool fHeadPending;
+  bool fSwitched;    ///< Next appended segment starts another variant
+  int32 fLoading;    ///< Segments downloading right now
+  double fThroughput; ///< Estimate in bit/s; 0 until a segment arrived
+
+  std::atomic<bigtime_t> fBufferedAhead;
+
+  std::atomic<bool> fQuit;
+  sem_id fWork;     ///< Released when a segment can be downloaded
+  sem_id fArrived;  ///< Released when a segment finished
+  sem_id fWake;     ///< Cuts the playlist thread's sleep short on Close()
+  thread_id fPlaylistThread;
+  thread_id fWorkers[kParallel];
+};
+
+#endif // BETON_HLS_SEGMENT_FETCHER_H
@@ -0,0 +1,616 @@
+#include "HttpConnectionPool.h"
+#include "Debug.h"
+
+#include <Autolock.h>
+#include <NetworkAddress.h>
+#include <SecureSocket.h>
+#include <Socket.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+
+/** @brief Longest status or header line accepted. */
+static const int32 kMaxLineBytes = 64 * 1024;
+/**
+ * @brief Body bytes past maxBytes still read to keep the connection; a
+ * longer excess costs more than a new connection.
+ */
+static const uint64 kMaxDrainBytes = 512 * 1024;
+/** @brief How often a cancelable request checks its flag. */
+static const bigtime_t kCancelPoll = 250000;
+
+struct HttpConnectionPool::Connection {
+  ~Connection() { delete socket; }
+
+  BString key;
+  BSocket *socket = nullptr;
+  bigtime_t idleUntil = 0;
+};
+
+struct HttpConnectionPool::Url {
+  bool SetTo(const BString &url);
+  /** @brief Scheme, host and port: connections are shared per key. */
+  BString Key() const;
+  BString HostHeader() const;
+
+  bool secure = false;
+  BString host;
+  uint16 port = 80;
+  BString target; ///< Path and query, as sent in the request line
+};
+
+bool HttpConnectionPool::Url::SetTo(const BString &url) {
+  int32 start;
+  if (url.ICompare("http://", 7) == 0) {
+    secure = false;
+    port = 80;
+    start = 7;
+  } else if (url.ICompare("https://", 8) == 0) {
+    secure = true;
+    port = 443;
+    start = 8;
+  } else {
+    return false;
+  }
+
+  int32 end = start;
+  while (end < url.Length() && url[end] != '/' && url[end] != '?' &&
+         url[end] != '#')
+    end++;
+  BString authority;
+  url.CopyInto(authority, start, end - start);
+  int32 at = authority.FindLast('@');
+  if (at >= 0)
+    authority.Remove(0, at + 1);
+
+  int32 colon = -1;
+  if (authority.StartsWith("[")) {
+    int32 close = authority.FindFirst(']');
+    if (close < 0)
+      return false;
+    authority.CopyInto(host, 1, close - 1);
+    if (close + 1 < authority.Length() && authority[close + 1] == ':')
+      colon = close + 1;
+  } else {
+    colon = authority.FindLast(':');
+    authority.CopyInto(host, 0, colon >= 0 ? colon : authority.Length());
+  }
+  if (colon >= 0) {
+    int value = atoi(authority.String() + colon + 1);
+    if (value <= 0 || value > 65535)
+      return false;
+    port = (uint16)value;
+  }
+  if (host.IsEmpty())
+    return false;
+
+  // Bytes that cannot appear in a request line are escaped; everything else
+  // is sent as the caller encoded it.
+  target.Truncate(0);
+  const char *rest = url.String() + end;
+  if (*rest != '/')
+    target << '/';
+  for (; *rest != '\0' && *rest != '#'; rest++) {
+    unsigned char c = (unsigned char)*rest;
+    if (c <= 0x20 || c >= 0x7f) {
+      char escaped[4];
+      snprintf(escaped, sizeof(escaped), "%%%02X", c);
+      target << escaped;
+    } else {
+      target << (char)c;
+    }
+  }
+  return true;
+}
+
+BString HttpConnectionPool::Url::Key() const {
+  BString key;
+  key << (secure ? "https://" : "http://") << host << ':' << (int32)port;
+  return key;
+}
+
+BString HttpConnectionPool::Url::HostHeader() const {
+  BString header;
+  if (host.FindFirst(':') >= 0)
+    header << '[' << host << ']';
+  else
+    header << host;
+  if (port != (secure ? 443 : 80))
+    header << ':' << (int32)port;
+  return header;
+}
+
+namespace {
+
+/**
+ * @class ResponseReader
+ * @brief Buffered reads from a socket against the request deadline.
+ */
+class ResponseReader {
+public:
+  ResponseReader(BSocket *socket, bigtime_t deadline,
+                 const std::atomic<bool> *cancel)
+      : fSocket(socket), fDeadline(deadline), fCancel(cancel), fStart(0),
+        fEnd(0), fReceived(false) {}
+
+  /** @brief One line without its CR LF; false on close or timeout. */
+  bool ReadLine(BString &line) {
+    line.Truncate(0);
+    for (;;) {
+      for (size_t i = fStart; i < fEnd; i++) {
+        if (fBuffer[i] == '\n') {
+          line.Append((const char *)fBuffer + fStart, i - fStart);
+          fStart = i + 1;
+          if (line.EndsWith("\r"))
+            line.Truncate(line.Length() - 1);
+          return true;
+        }
+      }
+      line.Append((const char *)fBuffer + fStart, fEnd - fStart);
+      fStart = fEnd;
+      if (line.Length() > kMaxLineBytes || !_Fill())
+        return false;
+    }
+  }
+
+  /** @brief Up to `size` bytes; 0 on close or timeout. */
+  ssize_t Read(void *buffer, size_t size) {
+    if (fStart == fEnd && !_Fill())
+      return 0;
+    size_t count = std::min(size, fEnd - fStart);
+    memcpy(buffer, fBuffer + fStart, count);
+    fStart += count;
+    return (ssize_t)count;
+  }
+
+  /** @brief Whether the server sent anything at all. */
+  bool Received() const { return fReceived; }
+  bool Canceled() const {
+    return fCancel != nullptr && fCancel->load(std::memory_order_relaxed);
+  }
+  size_t Pending() const { return fEnd - fStart; }
+
+private:
+  /** @brief Refills the (consumed) buffer from the socket. */
+  bool _Fill() {
+    for (;;) {
+      bigtime_t left = fDeadline - system_time();
+      if (left <= 0 || Canceled())
+        return false;
+      fSocket->SetTimeout(fCancel != nullptr ? std::min(left, kCancelPoll)
+                                             : left);
+      ssize_t read = fSocket->Read(fBuffer, sizeof(fBuffer));
+      if (read > 0) {
+        fStart = 0;
+        fEnd = (size_t)read;
+        fReceived = true;
+        return true;
+      }
+      if (read != B_WOULD_BLOCK && read != B_TIMED_OUT)
+        return false;
+    }
+  }
+
+  BSocket *fSocket;
+  bigtime_t fDeadline;
+  const std::atomic<bool> *fCancel;
+  uint8 fBuffer[16 * 1024];
+  size_t fStart;
+  size_t fEnd;
+  bool fReceived;
+};
+
+bool WriteAll(BSocket *socket, const BString &data, bigtime_t deadline) {
+  const char *next = data.String();
+  size_t left = data.Length();
+  while (left > 0) {
+    bigtime_t remaining = deadline - system_time();
+    if (remaining <= 0)
+      return false;
+    socket->SetTimeout(remaining);
+    ssize_t written = socket->Write(next, left);
+    if (written <= 0)
+      return false;
+    next += written;
+    left -= written;
+  }
+  return true;
+}
+
+/**
+ * @brief Reads `length` body bytes, or everything up to the close with
+ * `untilClose`; bytes past maxBytes are dropped.
+ *
+ * A 2xx body goes to the request's bodySink when it has one; `kept`
+ * counts the bytes delivered so far.
+ * @return false if the connection cannot carry another request.
+ */
+bool ReadBody(ResponseReader &reader, uint64 length, bool untilClose,
+              const HttpConnectionPool::Request &request,
+              HttpConnectionPool::Response &response, uint64 &kept,
+              uint64 &dropped) {
+  const size_t maxBytes = request.maxBytes;
+  const bool sink = request.bodySink && response.status >= 200 &&
+                    response.status < 300;
+  uint8 chunk[8192];
+  for (;;) {
+    if (!untilClose && length == 0)
+      return true;
+    size_t room = maxBytes - (size_t)std::min<uint64>(maxBytes, kept);
+    if (room == 0 && (untilClose || dropped + length > kMaxDrainBytes)) {
+      response.truncated = true;
+      return false;
+    }
+
+    size_t size = sizeof(chunk);
+    if (!untilClose)
+      size = (size_t)std::min<uint64>(size, length);
+    ssize_t read = reader.Read(chunk, size);
+    if (read <= 0) {
+      if (!untilClose)
+        response.truncated = true;
+      return false;
+    }
+
+    size_t keep = std::min((size_t)read, room);
+    if (sink) {
+      if (keep > 0)
+        request.bodySink(chunk, keep);
+    } else {
+      response.body.insert(response.body.end(), chunk, chunk + keep);
+    }
+    kept += keep;
+    if (keep < (size_t)read) {
+      dropped += read - keep;
+      response.truncated = true;
+    }
+    if (!untilClose)
+      length -= read;
+  }
+}
+
+/**
+ * @brief Reads status, headers and body of one reply.
+ *
+ * `reusable` tells whether the connection may carry another request and
+ * `keepAlive` for how long the server keeps it open.
+ */
+status_t ReadResponse(ResponseReader &reader,
+                      const HttpConnectionPool::Request &request,
+                      HttpConnectionPool::Response &response, bool &reusable,
+                      bigtime_t &keepAlive) {
+  BString line;
+  uint64 length = 0;
+  bool hasLength = false;
+  bool chunked = false;
+  bool close = false;
+
+  // Interim 1xx replies (100 Continue) come before the real one.
+  const bigtime_t sent = system_time();
+  do {
+    if (!reader.ReadLine(line))
+      return B_IO_ERROR;
+    response.replyTime = system_time() - sent;
+    // SHOUTcast v1 servers answer "ICY 200 OK" and then close when done.
+    const bool icy = line.StartsWith("ICY ");
+    if (!line.StartsWith("HTTP/1.") && !icy)
+      return B_BAD_DATA;
+    int32 space = line.FindFirst(' ');
+    response.status = space > 0 ? atoi(line.String() + space + 1) : 0;
+    if (response.status < 100)
+      return B_BAD_DATA;
+
+    length = 0;
+    hasLength = false;
+    chunked = false;
+    close = line.StartsWith("HTTP/1.0") || icy;
+    keepAlive = HttpConnectionPool::kDefaultKeepAlive;
+    response.contentType.Truncate(0);
+    response.location.Truncate(0);
+    response.headers.Truncate(0);
+    for (;;) {
+      if (!reader.ReadLine(line))
+        return B_IO_ERROR;
+      if (line.IsEmpty())
+        break;
+      int32 colon = line.FindFirst(':');
+      if (colon <= 0)
+        continue;
+      response.headers << line << "\r\n";
+      BString name;
+      BString value;
+      line.CopyInto(name, 0, colon);
+      line.CopyInto(value, colon + 1, line.Length() - colon - 1);
+      value.Trim();
+
+      if (name.ICompare("Content-Length") == 0) {
+        length = strtoull(value.String(), nullptr, 10);
+        hasLength = true;
+      } else if (name.ICompare("Transfer-Encoding") == 0) {
+        chunked = value.IFindFirst("chunked") >= 0;
+      } else if (name.ICompare("Connection") == 0) {
+        if (value.IFindFirst("close") >= 0)
+          close = true;
+        else if (value.IFindFirst("keep-alive") >= 0)
+          close = false;
+      } else if (name.ICompare("Keep-Alive") == 0) {
+        int32 timeout = value.IFindFirst("timeout=");
+        if (timeout >= 0) {
+          // A second short, so the server does not close it under a request.
+          long seconds = atol(value.String() + timeout + 8);
+          keepAlive = std::max<bigtime_t>(0, seconds - 1) * 1000000;
+        }
+      } else if (name.ICompare("Content-Type") == 0) {
+        response.contentType = value;
+      } else if (name.ICompare("Location") == 0) {
+        response.location = value;
+      }
+    }
+  } while (response.status < 200);
+
+  reusable = !close;
+  if (request.method == "HEAD" || response.status == 204 ||
+      response.status == 304)
+    return B_OK;
+
+  uint64 kept = 0;
+  uint64 dropped = 0;
+  if (chunked) {
+    for (;;) {
+      if (!reader.ReadLine(line)) {
+        response.truncated = true;
+        reusable = false;
+        return B_OK;
+      }
+      uint64 size = strtoull(line.String(), nullptr, 16);
+      if (size == 0)
+        break;
+      if (!ReadBody(reader, size, false, request, response, kept, dropped) ||
+          !reader.ReadLine(line)) {
+        reusable = false;
+        return B_OK;
+      }
+    }
+    do {
+      if (!reader.ReadLine(line)) {
+        reusable = false;
+        return B_OK;
+      }
+    } while (!line.IsEmpty());
+  } else if (hasLength) {
+    if (!ReadBody(reader, length, false, request, response, kept, dropped))
+      reusable = false;
+  } else {
+    ReadBody(reader, 0, true, request, response, kept, dropped);
+    reusable = false;
+  }
+  return B_OK;
+}
+
+/** @brief `location` of a redirect from `base`, made absolute. */
+BString ResolveLocation(const BString &base, const BString &location) {
+  if (location.IFindFirst("http://") == 0 ||
+      location.IFindFirst("https://") == 0)
+    return location;
+
+  BString resolved;
+  int32 scheme = base.FindFirst("://");
+  if (scheme < 0)
+    return location;
+  if (location.StartsWith("//")) {
+    base.CopyInto(resolved, 0, scheme + 1);
+    return resolved << location;
+  }
+
+  int32 pathStart = base.FindFirst('/', scheme + 3);
+  if (location.StartsWith("/") || pathStart < 0) {
+    base.CopyInto(resolved, 0, pathStart >= 0 ? pathStart : base.Length());
+    if (!location.StartsWith("/"))
+      resolved << '/';
+    return resolved << location;
+  }
+
+  int32 query = base.FindFirst('?', pathStart);
+  int32 slash = base.FindLast('/', query >= 0 ? query : base.Length());
+  base.CopyInto(resolved, 0, slash + 1);
+  return resolved << location;
+}
+
+} // namespace
+
+HttpConnectionPool::HttpConnectionPool() : fLock("http connection pool") {}
+
+HttpConnectionPool::~HttpConnectionPool() { CloseIdle(); }
+
+HttpConnectionPool &HttpConnectionPool::Default() {
+  static HttpConnectionPool sPool;
+  return sPool;
+}
+
+status_t HttpConnectionPool::Fetch(const Request &request,
+                                   Response &response) {
+  BString url = request.url;
+  for (int32 redirects = 0;; redirects++) {
+    response = Response();
+    status_t status = _FetchOnce(request, url, response);
+    if (status == B_CANCELED)
+      return status;
+    if (status != B_OK) {
+      fFailed.fetch_add(1, std::memory_order_relaxed);
+      DEBUG_PRINT("http pool: %s %s failed: %s\n", request.method.String(),
+                  url.String(), strerror(status));
+      return status;
+    }
+
+    bool redirect = response.status >= 300 && response.status < 400 &&
+                    response.status != 304 && !response.location.IsEmpty();
+    if (!redirect || redirects >= request.maxRedirects)
+      return B_OK;
+    url = ResolveLocation(url, response.location);
+  }
+}
+
+void HttpConnectionPool::CloseIdle() {
+  BAutolock lock(fLock);
+  for (auto &host : fIdle) {
+    for (Connection *connection : host.second)
+      delete connection;
+  }
+  fIdle.clear();
+}
+
+BString HttpConnectionPool::Report() const {
+  BString report;
+  report.SetToFormat("HTTP requests: %" B_PRIu32 " (%" B_PRIu32
+                     " on reused connections, %" B_PRIu32 " new, %" B_PRIu32
+                     " TLS; %" B_PRIu32 " retried, %" B_PRIu32 " failed)\n",
+                     fRequests.load(std::memory_order_relaxed),
+                     fReused.load(std::memory_order_relaxed),
+                     fOpened.load(std::memory_order_relaxed),
+                     fSecureOpened.load(std::memory_order_relaxed),
+                     fRetried.load(std::memory_order_relaxed),
+                     fFailed.load(std::memory_order_relaxed));
+  return report;
+}
+
+void HttpConnectionPool::ResetStats() {
+  fRequests.store(0, std::memory_order_relaxed);
+  fReused.store(0, std::memory_order_relaxed);
+  fOpened.store(0, std::memory_order_relaxed);
+  fSecureOpened.store(0, std::memory_order_relaxed);
+  fRetried.store(0, std::memory_order_relaxed);
+  fFailed.store(0, std::memory_order_relaxed);
+}
+
+/** @brief One request on a pooled or new connection, no redirects. */
+status_t HttpConnectionPool::_FetchOnce(const Request &request,
+                                        const BString &url,
+                                        Response &response) {
+  Url target;
+  if (!target.SetTo(url))
+    return B_BAD_VALUE;
+  const bigtime_t deadline = system_time() + request.timeout;
+
+  BString head;
+  head << request.method << ' ' << target.target << " HTTP/1.1\r\n"
+       << "Host: " << target.HostHeader() << "\r\n"
+       << "User-Agent: " << request.userAgent << "\r\n"
+       << "Accept: */*\r\n"
+       << "Accept-Encoding: identity\r\n"
+       << "Connection: keep-alive\r\n";
+  if (!request.body.IsEmpty() || request.method == "POST")
+    head << "Content-Length: " << request.body.Length() << "\r\n";
+  head << request.headers << "\r\n" << request.body;
+
+  fRequests.fetch_add(1, std::memory_order_relaxed);
+  for (int32 attempt = 0;; attempt++) {
+    Connection *connection = attempt == 0 ? _Checkout(target.Key()) : nullptr;
+    const bool reused = connection != nullptr;
+    if (!reused) {
+      status_t status = _Open(target, deadline, connection);
+      if (status != B_OK)
+        return status;
+    }
+    std::unique_ptr<Connection> owner(connection);
+
+    ResponseReader reader(connection->socket, deadline, request.cancel);
+    bool reusable = false;
+    bigtime_t keepAlive = 0;
+    status_t status = WriteAll(connection->socket, head, deadline)
+                          ? ReadResponse(reader, request, response, reusable,
+                                         keepAlive)
+                          : B_IO_ERROR;
+    if (status != B_OK && reader.Canceled())
+      return B_CANCELED;
+    if (status != B_OK) {
+      // The server closed the idle connection before it got the request.
+      if (reused && !reader.Received()) {
+        fRetried.fetch_add(1, std::memory_order_relaxed);
+        response = Response();
+        continue;
+      }
+      return status;
+    }
+
+    if (reusable && keepAlive > 0 && reader.Pending() == 0) {
+      connection->idleUntil = system_time() + keepAlive;
+      _Checkin(owner.release());
+    }
+    return B_OK;
+  }
+}
+
+status_t HttpConnectionPool::_Open(const Url &url, bigtime_t deadline,
+                                   Connection *&connection) {
+  BNetworkAddress address(url.host.String(), url.port);
+  status_t status = address.InitCheck();
+  if (status != B_OK)
+    return status;
+
+  BSocket *socket = url.secure ? new BSecureSocket : new BSocket;
+  bigtime_t left = deadline - system_time();
+  status = left > 0 ? socket->Connect(address, left) : B_TIMED_OUT;
+  if (status != B_OK) {
+    delete socket;
+    return status;
+  }
+
+  fOpened.fetch_add(1, std::memory_order_relaxed);
+  if (url.secure)
+    fSecureOpened.fetch_add(1, std::memory_order_relaxed);
+  connection = new Connection;
+  connection->key = url.Key();
+  connection->socket = socket;
+  return B_OK;
+}
+
+/** @brief Takes the most recent live idle connection to `key`, if any. */
+HttpConnectionPool::Connection *
+HttpConnectionPool::_Checkout(const BString &key) {
+  BAutolock lock(fLock);
+  auto found = fIdle.find(key);
+  if (found == fIdle.end())
+    return nullptr;
+
+  std::vector<Connection *> &idle = found->second;
+  const bigtime_t now = system_time();
+  while (!idle.empty()) {
+    Connection *connection = idle.back();
+    idle.pop_back();
+    // An idle connection only turns readable when the server closed it.
+    if (connection->idleUntil > now && connection->socket->IsConnected() &&
+        connection->socket->WaitForReadable(0) != B_OK) {
+      fReused.fetch_add(1, std::memory_order_relaxed);
+      return connection;
+    }
+    delete connection;
+  }
+  return nullptr;
+}
+
+/** @brief Keeps `connection` for the next request, dropping expired ones. */
+void HttpConnectionPool::_Checkin(Connection *connection) {
+  BAutolock lock(fLock);
+  const bigtime_t now = system_time();
+  for (auto &host : fIdle) {
+    std::vector<Connection *> &idle = host.second;
+    for (size_t i = 0; i < idle.size();) {
+      if (idle[i]->idleUntil <= now) {
+        delete idle[i];
+        idle.erase(idle.begin() + i);
+      } else {
+        i++;
+      }
+    }
+  }
+
+  std::vector<Connection *> &idle = fIdle[connection->key];
+  if ((int32)idle.size() >= kMaxIdlePerHost) {
+    delete idle.front();
+    idle.erase(idle.begin());
+  }
+  idle.push_back(connection);
+}
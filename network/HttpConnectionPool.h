@@ -0,0 +1,108 @@
+#ifndef BETON_HTTP_CONNECTION_POOL_H
+#define BETON_HTTP_CONNECTION_POOL_H
+
+#include <Locker.h>
+#include <OS.h>
+#include <String.h>
+#include <SupportDefs.h>
+#include <atomic>
+#include <functional>
+#include <map>
+#include <vector>
+
+class BSocket;
+
+/**
+ * @class HttpConnectionPool
+ * @brief Keep-alive HTTP/1.1 client shared by Beton's short requests:
+ * HLS playlist polling, stream URL resolution, cover downloads, MusicBrainz
+ * and DLNA.
+ *
+ * BUrlRequest opens a new connection, and for HTTPS does a new TLS
+ * handshake, for every request. Here a finished connection goes back into
+ * a per host idle list and the next request to that host sends on it, so a
+ * TLS session is negotiated once per connection instead of once per
+ * request. Idle connections are dropped after the server's keep-alive
+ * timeout (kDefaultKeepAlive when it gives none) or when the server closed
+ * them; a request that finds its reused connection closed before any reply
+ * is sent again on a new one.
+ *
+ * Fetch() is synchronous and thread-safe; a connection belongs to one
+ * request at a time. Bodies are read whole into memory, or handed to a
+ * Request::bodySink as they arrive; this is not for audio streams.
+ */
+class HttpConnectionPool {
+public:
+  static const int32 kMaxIdlePerHost = 4;
+  static const bigtime_t kDefaultKeepAlive = 15000000;
+
+  struct Request {
+    BString method = "GET";
+    BString url;
+    BString userAgent = "Beton/1.0 (Haiku OS)";
+    BString headers; ///< Extra header lines, each ending in "\r\n"
+    BString body;
+    int32 maxRedirects = 0; ///< Redirects followed before returning one
+    size_t maxBytes = 16 * 1024 * 1024; ///< Longer bodies are cut here
+    bigtime_t timeout = 10000000; ///< Per request and per redirect
+    /// Polled while waiting for the reply; true gives up with B_CANCELED.
+    const std::atomic<bool> *cancel = nullptr;
+    /// Receives the body of a 2xx reply as it is read, instead of
+    /// Response::body; maxBytes still applies.
+    std::function<void(const uint8 *data, size_t size)> bodySink;
+  };
+
+  struct Response {
+    int32 status = 0;
+    BString contentType;
+    BString location; ///< Of the last reply, unless it was followed
+    BString headers;  ///< Of the last reply, each line ending in "\r\n"
+    /// From sending the last request to its status line.
+    bigtime_t replyTime = 0;
+    std::vector<uint8> body;
+    bool truncated = false; ///< The body was longer than maxBytes
+  };
+
+  HttpConnectionPool();
+  ~HttpConnectionPool();
+
+  static HttpConnectionPool &Default();
+
+  /**
+   * @brief Sends `request` and reads the reply into `response`.
+   * @return B_OK once a reply was read, whatever its status code.
+   */
+  status_t Fetch(const Request &request, Response &response);
+
+  /** @brief Closes every idle connection. */
+  void CloseIdle();
+
+  /** @name Counters */
+  ///@{
+  /** @brief One line: requests, reused and new connections, failures. */
+  BString Report() const;
+  void ResetStats();
+  ///@}
+
+private:
+  struct Connection;
+  struct Url;
+
+  status_t _FetchOnce(const Request &request, const BString &url,
+                      Response &response);
+  status_t _Open(const Url &url, bigtime_t deadline, Connection *&connection);
+  Connection *_Checkout(const BString &key);
+  void _Checkin(Connection *connection);
+
+  BLocker fLock; ///< Guards fIdle
+  std::map<BString, std::vector<Connection *>> fIdle;
+
+  std::atomic<uint32> fRequests{0};
+  std::atomic<uint32> fReused{0};
+  std::atomic<uint32> fOpened{0};
+  std::atomic<uint32> fSecureOpened{0};
+  std::atomic<uint32> fRetried{0};
+  std::atomic<uint32> fFailed{0};
+};
+
+#endif // BETON_HTTP_CONNECTION_POOL_H
@@ -3,20 +3,37 @@
 #include "Debug.h"
 
 #include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
 #include <netinet/in.h>
+#include <netinet/tcp.h>
 #include <arpa/inet.h>
 #include <unistd.h>
+#include <errno.h>
 #include <fcntl.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
-#include <File.h>
+#include <algorithm>
+#include <random>
+
+#include <Autolock.h>
 #include <Url.h>
 #include <NetworkInterface.h>
 #include <NetworkRoster.h>
 
+/** @brief Bytes per file read; a multiple of the page size. */
+static const size_t kReadChunk = 256 * 1024;
+/** @brief Socket send buffer, about a second of hi-res FLAC. */
+static const int kSendBufferSize = 512 * 1024;
+/** @brief Longest wait for a transcode before a range of it is sent. */
+static const bigtime_t kTranscodeWait = 120000000;
+
 LocalFileHttpServer::LocalFileHttpServer()
-    : fServerThread(-1), fRunning(false), fServerSocket(-1), fPort(0)
+    : fServerThread(-1), fRunning(false), fServerSocket(-1), fPort(0),
+      fClientsReady(-1), fLock("LocalFileHttpServer"),
+      fTokenSource(std::random_device()())
 {
     /// Try to get a non-localhost IP address to construct public URLs
     fMyIpAddress = "127.0.0.1";
@@ -86,14 +103,31 @@ status_t LocalFileHttpServer::Start()
 
     DEBUG_PRINT("Listening on %s:%d\n", fMyIpAddress.String(), fPort);
 
+    fClientsReady = create_sem(0, "local http clients");
+    if (fClientsReady < 0) {
+        close(fServerSocket);
+        fServerSocket = -1;
+        return B_ERROR;
+    }
+
     fRunning = true;
+    for (int32 i = 0; i < kWorkerCount; i++) {
+        thread_id worker = spawn_thread(_WorkerThreadEntry, "LocalHttpClient", B_NORMAL_PRIORITY, this);
+        if (worker < 0)
+            break;
+        fWorkers.push_back(worker);
+        resume_thread(worker);
+    }
+
     fServerThread = spawn_thread(_ServerThreadEntry, "LocalFileHttpServer", B_NORMAL_PRIORITY, this);
-    if (fServerThread >= 0) {
+    if (fServerThread >= 0 && !fWorkers.empty()) {
         resume_thread(fServerThread);
     } else {
-        fRunning = false;
-        close(fServerSocket);
-        fServerSocket = -1;
+        if (fServerThread >= 0) {
+            kill_thread(fServerThread);
+            fServerThread = -1;
+        }
+        Stop();
         return B_ERROR;
     }
 
@@ -110,17 +144,75 @@ void LocalFileHttpServer::Stop()
         fServerSocket = -1;
     }
 
+    status_t exitValue;
     if (fServerThread >= 0) {
-        status_t exitValue;
         wait_for_thread(fServerThread, &exitValue);
         fServerThread = -1;
     }
+
+    {
+        /// Unblock workers in recv() or send().
+        BAutolock lock(fLock);
+        for (int socket : fActive)
+            shutdown(socket, SHUT_RDWR);
+    }
+    for (size_t i = 0; i < fWorkers.size(); i++)
+        release_sem(fClientsReady);
+    for (thread_id worker : fWorkers)
+        wait_for_thread(worker, &exitValue);
+    fWorkers.clear();
+    delete_sem(fClientsReady);
+    fClientsReady = -1;
+
+    /// Nothing reads the outputs any more.
+    TranscodeCache::Default().CancelAll();
+
+    BAutolock lock(fLock);
+    for (int socket : fPending)
+        close(socket);
+    fPending.clear();
 }
 
 status_t LocalFileHttpServer::ServeFile(const BString& absolutePath, BString& outUrl)
 {
-    fCurrentFile = absolutePath;
-    
+    BString token;
+    {
+        BAutolock lock(fLock);
+        const bigtime_t now = system_time();
+
+        /// Unused files expire; the newest ones stay, however old.
+        while (fFiles.size() >= (size_t)kMaxServedFiles) {
+            auto oldest = fFiles.begin();
+            for (auto it = fFiles.begin(); it != fFiles.end(); ++it) {
+                if (it->second.lastUsed < oldest->second.lastUsed)
+                    oldest = it;
+            }
+            fFiles.erase(oldest);
+        }
+        for (auto it = fFiles.begin(); it != fFiles.end();) {
+            if (now - it->second.lastUsed > kServedFileLifetime)
+                it = fFiles.erase(it);
+            else
+                ++it;
+        }
+
+        /// A path already served keeps its token, so its URL stays valid.
+        for (auto it = fFiles.begin(); it != fFiles.end(); ++it) {
+            if (it->second.path == absolutePath) {
+                token = it->first;
+                it->second.lastUsed = now;
+                break;
+            }
+        }
+        if (token.IsEmpty()) {
+            std::uniform_int_distribution<uint64> bits;
+            do {
+                token.SetToFormat("%016llx", (unsigned long long)bits(fTokenSource));
+            } while (fFiles.find(token) != fFiles.end());
+            fFiles[token] = ServedFile{absolutePath, now, -1};
+        }
+    }
+
     /// Create the URL
     /// DLNA renderers are picky, so URL encode the filename
     BString filename = absolutePath;
@@ -129,13 +221,56 @@ status_t LocalFileHttpServer::ServeFile(const BString& absolutePath, BString& ou
         filename.Remove(0, lastSlash + 1);
     }
     if (filename.IsEmpty()) filename = "stream.mp3";
-    
-    outUrl.SetToFormat("http://%s:%d/%s", fMyIpAddress.String(), fPort, _UrlEncode(filename).String());
+
+    outUrl.SetToFormat("http://%s:%d/%s/%s", fMyIpAddress.String(), fPort,
+                       token.String(), _UrlEncode(filename).String());
     DEBUG_PRINT("Serving file: %s as %s\n", absolutePath.String(), outUrl.String());
-    
+
     return B_OK;
 }
 
+BString LocalFileHttpServer::EventUrl() const
+{
+    if (!fRunning)
+        return "";
+    BString url;
+    url.SetToFormat("http://%s:%d/event", fMyIpAddress.String(), fPort);
+    return url;
+}
+
+BString LocalFileHttpServer::BaseUrl() const
+{
+    if (!fRunning)
+        return "";
+    BString url;
+    url.SetToFormat("http://%s:%d", fMyIpAddress.String(), fPort);
+    return url;
+}
+
+/** @brief Format segment of library URLs, by TranscodeCache::Format. */
+static const char* const kLibraryFormats[] = { "o", "mp3", "lpcm" };
+
+BString LocalFileHttpServer::LibraryUrl(const BString& id, const BString& name,
+                                        TranscodeCache::Format format) const
+{
+    BString url;
+    url.SetToFormat("http://%s:%d/lib/%s/%s/%s", fMyIpAddress.String(), fPort,
+                    kLibraryFormats[format], _UrlEncode(id).String(),
+                    _UrlEncode(name.IsEmpty() ? BString("track") : name).String());
+    return url;
+}
+
+void LocalFileHttpServer::SetSinkProtocolInfo(const BString& sinkProtocolInfo)
+{
+    BAutolock lock(fLock);
+    if (sinkProtocolInfo == fSinkProtocolInfo)
+        return;
+    fSinkProtocolInfo = sinkProtocolInfo;
+    /// Another renderer; every file is checked again.
+    for (auto& file : fFiles)
+        file.second.format = -1;
+}
+
 int32 LocalFileHttpServer::_ServerThreadEntry(void* data)
 {
     LocalFileHttpServer* server = static_cast<LocalFileHttpServer*>(data);
@@ -159,90 +294,258 @@ void LocalFileHttpServer::_ServerLoop()
             continue;
         }
 
-        ClientData* cd = new ClientData();
-        cd->server = this;
-        cd->socket = clientSocket;
-
-        thread_id cThread = spawn_thread(_ClientThreadEntry, "LocalHttpClient", B_NORMAL_PRIORITY, cd);
-        if (cThread >= 0) {
-            resume_thread(cThread);
-        } else {
+        /// Idle clients time out instead of holding a worker.
+        struct timeval timeout;
+        timeout.tv_sec = kIdleTimeout / 1000000;
+        timeout.tv_usec = kIdleTimeout % 1000000;
+        setsockopt(clientSocket, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+        setsockopt(clientSocket, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+
+        {
+            BAutolock lock(fLock);
+            if (fPending.size() + fActive.size() < (size_t)kMaxConnections) {
+                fPending.push_back(clientSocket);
+                clientSocket = -1;
+            }
+        }
+        if (clientSocket >= 0) {
+            DEBUG_PRINT("Too many connections, refusing one\n");
+            const char* busy = "HTTP/1.1 503 Service Unavailable\r\n"
+                               "Retry-After: 1\r\nConnection: close\r\n\r\n";
+            send(clientSocket, busy, strlen(busy), 0);
             close(clientSocket);
-            delete cd;
+            continue;
         }
+        release_sem(fClientsReady);
     }
 }
 
-int32 LocalFileHttpServer::_ClientThreadEntry(void* data)
+int32 LocalFileHttpServer::_WorkerThreadEntry(void* data)
 {
-    ClientData* cd = static_cast<ClientData*>(data);
-    cd->server->_HandleClient(cd->socket);
-    delete cd;
+    static_cast<LocalFileHttpServer*>(data)->_WorkerLoop();
     return 0;
 }
 
-void LocalFileHttpServer::_HandleClient(int clientSocket)
+void LocalFileHttpServer::_WorkerLoop()
 {
-    char buffer[4096];
-    ssize_t bytesRead = recv(clientSocket, buffer, sizeof(buffer) - 1, 0);
-    
-    if (bytesRead <= 0) {
+    while (acquire_sem(fClientsReady) == B_OK && fRunning) {
+        int clientSocket;
+        {
+            BAutolock lock(fLock);
+            if (fPending.empty())
+                continue;
+            clientSocket = fPending.front();
+            fPending.pop_front();
+            fActive.push_back(clientSocket);
+        }
+
+        _HandleClient(clientSocket);
+
+        BAutolock lock(fLock);
+        fActive.erase(std::find(fActive.begin(), fActive.end(), clientSocket));
         close(clientSocket);
-        return;
     }
-    buffer[bytesRead] = '\0';
-    BString request(buffer);
+}
+
+void LocalFileHttpServer::_HandleClient(int clientSocket)
+{
+    /// The header goes out in its own send(); with Nagle on, a small body
+    /// after it waits for the peer's delayed ACK. The larger send buffer
+    /// keeps the link busy while the next chunk is read.
+    int noDelay = 1;
+    setsockopt(clientSocket, IPPROTO_TCP, TCP_NODELAY, &noDelay, sizeof(noDelay));
+    int sendBuffer = kSendBufferSize;
+    setsockopt(clientSocket, SOL_SOCKET, SO_SNDBUF, &sendBuffer, sizeof(sendBuffer));
+
+    /// Bytes received past the request being answered: pipelined requests.
+    BString received;
+    for (int32 served = 0; fRunning; served++) {
+        BString request;
+        if (!_ReadRequest(clientSocket, received, request))
+            return;
+        if (!_Respond(clientSocket, request))
+            return;
+
+        /// A kept-alive connection waits less than a new one, and gives
+        /// its worker up while other clients queue.
+        if (served == 0) {
+            struct timeval timeout;
+            timeout.tv_sec = kKeepAliveTimeout / 1000000;
+            timeout.tv_usec = kKeepAliveTimeout % 1000000;
+            setsockopt(clientSocket, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+        }
+        BAutolock lock(fLock);
+        if (!fPending.empty() && received.IsEmpty())
+            return;
+    }
+}
 
+bool LocalFileHttpServer::_ReadRequest(int clientSocket, BString& received, BString& request)
+{
+    int32 end;
+    int32 length = -1;
+    for (;;) {
+        end = received.FindFirst("\r\n\r\n");
+        if (end >= 0 && length < 0) {
+            BString header;
+            received.CopyInto(header, 0, end + 4);
+            length = end + 4 + atoi(HeaderValue(header, "Content-Length").String());
+        }
+        if (length >= 0 && received.Length() >= length)
+            break;
+        if (received.Length() >= kMaxRequestSize || length > kMaxRequestSize)
+            return false;
+        char buffer[4096];
+        ssize_t bytesRead = recv(clientSocket, buffer, sizeof(buffer), 0);
+        if (bytesRead <= 0)
+            return false; ///< Closed, idle timeout or stopped
+        received.Append(buffer, bytesRead);
+    }
+
+    received.CopyInto(request, 0, length);
+    received.Remove(0, length);
+    return true;
+}
+
+/**
+ * @brief Answers one request.
+ * @return True if the connection stays open for the next one.
+ */
+bool LocalFileHttpServer::_Respond(int clientSocket, const BString& request)
+{
     DEBUG_PRINT("Received request: %s\n", request.String());
 
-    if (!request.StartsWith("GET ")) {
-        const char* badMethod = "HTTP/1.1 405 Method Not Allowed\r\n\r\n";
-        send(clientSocket, badMethod, strlen(badMethod), 0);
-        close(clientSocket);
-        return;
+    int32 lineEnd = request.FindFirst("\r\n");
+    BString requestLine;
+    request.CopyInto(requestLine, 0, lineEnd);
+    int32 targetStart = requestLine.FindFirst(' ') + 1;
+    int32 targetEnd = requestLine.FindFirst(' ', targetStart);
+    if (targetStart <= 0 || targetEnd < 0) {
+        _SendStatus(clientSocket, "400 Bad Request", false);
+        return false;
     }
 
-    if (fCurrentFile.IsEmpty()) {
-        const char* notFound = "HTTP/1.1 404 Not Found\r\n\r\n";
-        send(clientSocket, notFound, strlen(notFound), 0);
-        close(clientSocket);
-        return;
+    BString method, target, version;
+    requestLine.CopyInto(method, 0, targetStart - 1);
+    requestLine.CopyInto(target, targetStart, targetEnd - targetStart);
+    requestLine.CopyInto(version, targetEnd + 1, requestLine.Length() - targetEnd - 1);
+
+    /// HTTP/1.1 keeps the connection unless asked not to, 1.0 only if asked.
+    BString connection = HeaderValue(request, "Connection");
+    bool keepAlive = version == "HTTP/1.1"
+        ? connection.ICompare("close") != 0
+        : connection.ICompare("keep-alive") == 0;
+
+    if (method == "NOTIFY") {
+        /// UPnP events: "412 Precondition Failed" ends an unknown subscription.
+        int32 bodyStart = request.FindFirst("\r\n\r\n") + 4;
+        BString body;
+        request.CopyInto(body, bodyStart, request.Length() - bodyStart);
+        bool accepted = target.StartsWith("/event") && fEventHandler
+            && fEventHandler(HeaderValue(request, "SID"), body);
+        _SendStatus(clientSocket, accepted ? "200 OK" : "412 Precondition Failed",
+                    keepAlive);
+        return keepAlive;
     }
 
-    BFile file(fCurrentFile.String(), B_READ_ONLY);
-    if (file.InitCheck() != B_OK) {
-        const char* notFound = "HTTP/1.1 404 Not Found\r\n\r\n";
-        send(clientSocket, notFound, strlen(notFound), 0);
-        close(clientSocket);
-        return;
+    bool isHead = method == "HEAD";
+    if (target.StartsWith("/upnp/")) {
+        Response response;
+        BString localTarget;
+        target.CopyInto(localTarget, 6, target.Length() - 6);
+        if (!fRequestHandler
+            || !fRequestHandler(isHead ? BString("GET") : method, localTarget,
+                                request, response)) {
+            _SendStatus(clientSocket, "404 Not Found", keepAlive);
+            return keepAlive;
+        }
+        return _SendResponse(clientSocket, response, isHead, keepAlive);
+    }
+
+    if (method != "GET" && !isHead) {
+        _SendStatus(clientSocket, "405 Method Not Allowed", keepAlive);
+        return keepAlive;
     }
 
-    off_t fileSize = 0;
-    file.GetSize(&fileSize);
+    TranscodeCache::Format format;
+    BString path = target.StartsWith("/lib/")
+        ? _PathForLibraryTarget(target, format)
+        : _PathForTarget(target, format);
+    if (path.IsEmpty()) {
+        _SendStatus(clientSocket, "404 Not Found", keepAlive);
+        return keepAlive;
+    }
+
+    if (format != TranscodeCache::kPassThrough) {
+        BReference<TranscodeCache::Job> job =
+            TranscodeCache::Default().Acquire(path.String(), format);
+        if (job.IsSet()) {
+            /// A running transcode is only known from its start; a range
+            /// further on waits for the whole output.
+            BString range = HeaderValue(request, "Range");
+            if (!job->IsComplete() && !range.IsEmpty() && range != "bytes=0-")
+                job->WaitForCompletion(kTranscodeWait);
+            if (job->IsComplete()) {
+                return _SendFile(clientSocket, job->OutputPath(),
+                                 TranscodeCache::MimeType(format), request,
+                                 isHead, keepAlive);
+            }
+            if (job->IsValid()) {
+                _SendTranscoding(clientSocket, job.Get(), isHead);
+                return false;
+            }
+        }
+        DEBUG_PRINT("Transcoding %s failed, sending it as it is\n", path.String());
+    }
+
+    return _SendFile(clientSocket, path, MimeTypeForPath(path), request, isHead,
+                     keepAlive);
+}
+
+const char* LocalFileHttpServer::MimeTypeForPath(const BString& path)
+{
+    BString lowerFile = path;
+    lowerFile.ToLower();
+    if (lowerFile.EndsWith(".mp3")) return "audio/mpeg";
+    if (lowerFile.EndsWith(".flac")) return "audio/flac";
+    if (lowerFile.EndsWith(".ogg")) return "audio/ogg";
+    if (lowerFile.EndsWith(".m4a")) return "audio/mp4";
+    if (lowerFile.EndsWith(".wav")) return "audio/wav";
+#if ENABLE_MIDI_PLAYBACK
+    if (lowerFile.EndsWith(".mid") || lowerFile.EndsWith(".midi"))
+        return "audio/midi";
+#endif
+    return "application/octet-stream";
+}
+
+bool LocalFileHttpServer::_SendFile(int clientSocket, const BString& path,
+                                    const char* mimeType, const BString& request,
+                                    bool isHead, bool keepAlive)
+{
+    struct stat st;
+    if (stat(path.String(), &st) != 0 || !S_ISREG(st.st_mode)) {
+        _SendStatus(clientSocket, "404 Not Found", keepAlive);
+        return keepAlive;
+    }
+
+    off_t fileSize = st.st_size;
 
     /// Check for Range header
     off_t startPos = 0;
     off_t endPos = fileSize - 1;
     bool isPartial = false;
 
-    int32 rangeIdx = request.IFindFirst("Range: bytes=");
-    if (rangeIdx >= 0) {
-        int32 startNumIdx = rangeIdx + 13;
-        int32 endNumIdx = request.FindFirst('-', startNumIdx);
-        if (endNumIdx > startNumIdx) {
+    BString range = HeaderValue(request, "Range");
+    if (range.IStartsWith("bytes=")) {
+        int32 dash = range.FindFirst('-');
+        if (dash > 6) {
             BString startStr;
-            request.CopyInto(startStr, startNumIdx, endNumIdx - startNumIdx);
+            range.CopyInto(startStr, 6, dash - 6);
             startPos = atoll(startStr.String());
-            
-            int32 lineEndR = request.FindFirst('\r', endNumIdx);
-            int32 lineEndN = request.FindFirst('\n', endNumIdx);
-            int32 lineEnd = lineEndR;
-            if (lineEnd < 0) lineEnd = lineEndN;
-            else if (lineEndN >= 0 && lineEndN < lineEnd) lineEnd = lineEndN;
-
-            if (lineEnd > endNumIdx + 1) {
+
+            if (dash + 1 < range.Length()) {
                 BString endStr;
-                request.CopyInto(endStr, endNumIdx + 1, lineEnd - (endNumIdx + 1));
+                range.CopyInto(endStr, dash + 1, range.Length() - dash - 1);
                 endPos = atoll(endStr.String());
             }
             isPartial = true;
@@ -254,10 +557,8 @@ void LocalFileHttpServer::_HandleClient(int clientSocket)
     }
 
     if (startPos > endPos || startPos >= fileSize) {
-        const char* badRange = "HTTP/1.1 416 Range Not Satisfiable\r\n\r\n";
-        send(clientSocket, badRange, strlen(badRange), 0);
-        close(clientSocket);
-        return;
+        _SendStatus(clientSocket, "416 Range Not Satisfiable", keepAlive);
+        return keepAlive;
     }
 
     off_t contentLength = endPos - startPos + 1;
@@ -271,48 +572,187 @@ void LocalFileHttpServer::_HandleClient(int clientSocket)
         responseHeader = "HTTP/1.1 200 OK\r\n";
     }
 
-    BString mimeType = "application/octet-stream";
-    BString lowerFile = fCurrentFile;
-    lowerFile.ToLower();
-    if (lowerFile.EndsWith(".mp3")) mimeType = "audio/mpeg";
-    else if (lowerFile.EndsWith(".flac")) mimeType = "audio/flac";
-    else if (lowerFile.EndsWith(".ogg")) mimeType = "audio/ogg";
-    else if (lowerFile.EndsWith(".m4a")) mimeType = "audio/mp4";
-    else if (lowerFile.EndsWith(".wav")) mimeType = "audio/wav";
-#if ENABLE_MIDI_PLAYBACK
-    else if (lowerFile.EndsWith(".mid") || lowerFile.EndsWith(".midi")) {
-        mimeType = "audio/midi";
-    }
-#endif
-
     responseHeader << "Content-Type: " << mimeType << "\r\n"
                    << "Content-Length: " << contentLength << "\r\n"
                    << "Accept-Ranges: bytes\r\n"
+                   << "Connection: " << (keepAlive ? "keep-alive" : "close") << "\r\n\r\n";
+
+    if (!_SendAll(clientSocket, responseHeader.String(), responseHeader.Length()))
+        return false;
+    if (isHead)
+        return keepAlive;
+
+    int fd = open(path.String(), O_RDONLY);
+    if (fd < 0)
+        return false; ///< Removed since the stat(); the header promised data
+
+    bigtime_t start = system_time();
+    off_t sent = _SendRange(clientSocket, fd, startPos, contentLength);
+    bigtime_t elapsed = std::max<bigtime_t>(system_time() - start, 1);
+    DEBUG_PRINT("Sent %lld of %lld bytes in %lld ms (%.1f MB/s)\n",
+                (long long)sent, (long long)contentLength,
+                (long long)(elapsed / 1000), sent / (double)elapsed);
+    close(fd);
+    return keepAlive && sent == contentLength;
+}
+
+void LocalFileHttpServer::_SendTranscoding(int clientSocket, TranscodeCache::Job* job,
+                                           bool isHead)
+{
+    BString responseHeader;
+    responseHeader << "HTTP/1.1 200 OK\r\n"
+                   << "Content-Type: " << TranscodeCache::MimeType(job->OutputFormat())
+                   << "\r\n"
                    << "Connection: close\r\n\r\n";
+    if (!_SendAll(clientSocket, responseHeader.String(), responseHeader.Length())
+        || isHead)
+        return;
+
+    char* buffer = static_cast<char*>(malloc(kReadChunk));
+    if (buffer == NULL)
+        return;
+    off_t position = 0;
+    while (fRunning) {
+        ssize_t bytesRead = job->ReadAt(position, buffer, kReadChunk, kIdleTimeout);
+        if (bytesRead <= 0 || !_SendAll(clientSocket, buffer, bytesRead))
+            break;
+        position += bytesRead;
+    }
+    free(buffer);
+    DEBUG_PRINT("Sent %lld transcoded bytes\n", (long long)position);
+}
+
+bool LocalFileHttpServer::_SendResponse(int clientSocket, const Response& response,
+                                        bool isHead, bool keepAlive)
+{
+    BString header;
+    header << "HTTP/1.1 " << response.status << "\r\n"
+           << "Content-Type: " << response.contentType << "\r\n"
+           << "Content-Length: " << response.body.Length() << "\r\n"
+           << response.headers
+           << "Connection: " << (keepAlive ? "keep-alive" : "close") << "\r\n\r\n";
+    if (!_SendAll(clientSocket, header.String(), header.Length()))
+        return false;
+    if (!isHead && !_SendAll(clientSocket, response.body.String(), response.body.Length()))
+        return false;
+    return keepAlive;
+}
+
+void LocalFileHttpServer::_SendStatus(int clientSocket, const char* status, bool keepAlive)
+{
+    BString response;
+    response.SetToFormat("HTTP/1.1 %s\r\nContent-Length: 0\r\nConnection: %s\r\n\r\n",
+                         status, keepAlive ? "keep-alive" : "close");
+    _SendAll(clientSocket, response.String(), response.Length());
+}
 
-    send(clientSocket, responseHeader.String(), responseHeader.Length(), 0);
+BString LocalFileHttpServer::HeaderValue(const BString& request, const char* name)
+{
+    BString key;
+    key << "\r\n" << name << ":";
+    int32 start = request.IFindFirst(key);
+    if (start < 0)
+        return "";
+    start += key.Length();
+    int32 end = request.FindFirst("\r\n", start);
+    BString value;
+    request.CopyInto(value, start, end - start);
+    value.Trim();
+    return value;
+}
 
-    file.Seek(startPos, SEEK_SET);
+BString LocalFileHttpServer::_PathForTarget(const BString& target,
+                                            TranscodeCache::Format& format)
+{
+    /// "/<token>/<name>"; the name is only there for renderers that look at it.
+    int32 tokenEnd = target.FindFirst('/', 1);
+    BString token;
+    target.CopyInto(token, 1, (tokenEnd < 0 ? target.Length() : tokenEnd) - 1);
+
+    BString path;
+    BString sink;
+    {
+        BAutolock lock(fLock);
+        auto it = fFiles.find(token);
+        if (it == fFiles.end())
+            return "";
+        it->second.lastUsed = system_time();
+        path = it->second.path;
+        if (it->second.format >= 0) {
+            format = (TranscodeCache::Format)it->second.format;
+            return path;
+        }
+        sink = fSinkProtocolInfo;
+    }
 
-    char fileBuf[32768];
-    off_t remaining = contentLength;
-    while (remaining > 0 && fRunning) {
-        size_t toRead = std::min((off_t)sizeof(fileBuf), remaining);
-        ssize_t readBytes = file.Read(fileBuf, toRead);
-        if (readBytes <= 0) break;
+    /// Probing opens the file, so it is done once per file and renderer.
+    format = TranscodeCache::FormatFor(path.String(), sink);
+    BAutolock lock(fLock);
+    auto it = fFiles.find(token);
+    if (it != fFiles.end() && fSinkProtocolInfo == sink)
+        it->second.format = format;
+    return path;
+}
 
-        ssize_t sent = 0;
-        while (sent < readBytes && fRunning) {
-            ssize_t s = send(clientSocket, fileBuf + sent, readBytes - sent, 0);
-            if (s < 0) break;
-            sent += s;
+BString LocalFileHttpServer::_PathForLibraryTarget(const BString& target,
+                                                   TranscodeCache::Format& format)
+{
+    /// "/lib/<format>/<id>/<name>"; the client picked the format from the
+    /// resources it was offered, so the sink is not consulted.
+    int32 formatEnd = target.FindFirst('/', 5);
+    int32 idEnd = formatEnd < 0 ? -1 : target.FindFirst('/', formatEnd + 1);
+    if (idEnd < 0 || !fLibraryResolver)
+        return "";
+
+    BString formatName, id;
+    target.CopyInto(formatName, 5, formatEnd - 5);
+    target.CopyInto(id, formatEnd + 1, idEnd - formatEnd - 1);
+
+    for (int32 i = TranscodeCache::kPassThrough; i <= TranscodeCache::kLpcm; i++) {
+        if (formatName == kLibraryFormats[i]) {
+            format = (TranscodeCache::Format)i;
+            return fLibraryResolver(_UrlDecode(id));
         }
-        if (sent < readBytes) break; ///< Network error
-        
-        remaining -= readBytes;
     }
+    return "";
+}
 
-    close(clientSocket);
+bool LocalFileHttpServer::_SendAll(int socket, const void* data, size_t size)
+{
+    const char* bytes = static_cast<const char*>(data);
+    while (size > 0 && fRunning) {
+        ssize_t s = send(socket, bytes, size, 0);
+        if (s < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        bytes += s;
+        size -= s;
+    }
+    return size == 0;
+}
+
+off_t LocalFileHttpServer::_SendRange(int socket, int fd, off_t start, off_t length)
+{
+    /// Haiku has no sendfile(). Large reads into a page aligned buffer
+    /// measured faster than mapping windows of the file, which also
+    /// faults when the file shrinks while it is sent.
+    char* buffer = static_cast<char*>(aligned_alloc(B_PAGE_SIZE, kReadChunk));
+    if (buffer == nullptr)
+        return 0;
+    const off_t end = start + length;
+    off_t position = start;
+    while (position < end && fRunning) {
+        /// The first read ends on a chunk boundary; later ones are aligned.
+        size_t toRead = (size_t)std::min<off_t>(
+            kReadChunk - position % kReadChunk, end - position);
+        ssize_t readBytes = pread(fd, buffer, toRead, position);
+        if (readBytes <= 0 || !_SendAll(socket, buffer, readBytes))
+            break;
+        position += readBytes;
+    }
+    free(buffer);
+    return position - start;
 }
 
 BString LocalFileHttpServer::_UrlEncode(const BString& str)
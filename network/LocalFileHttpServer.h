@@ -1,17 +1,65 @@
 #ifndef BETON_LOCAL_FILE_HTTP_SERVER_H
 #define BETON_LOCAL_FILE_HTTP_SERVER_H
 
+#include "TranscodeCache.h"
+
+#include <Locker.h>
 #include <String.h>
 #include <OS.h>
 #include <atomic>
+#include <deque>
+#include <functional>
+#include <map>
+#include <random>
 #include <vector>
 
 /**
  * @class LocalFileHttpServer
  * @brief A minimal, embedded HTTP server for streaming local files to DLNA renderers.
+ *
+ * File data is sent with large page aligned reads, over a socket with Nagle
+ * off and a large send buffer.
+ *
+ * Accepted connections are queued for a fixed pool of kWorkerCount worker
+ * threads, so renderers that probe with many short Range requests do not
+ * create a thread each. At most kMaxConnections are served or waiting;
+ * further ones are answered with 503 at once. A client that sends no
+ * request, or takes no data, for kIdleTimeout is dropped.
+ *
+ * Connections are kept alive (HTTP/1.1, or 1.0 with "Connection:
+ * keep-alive") and pipelined requests are answered in order; HEAD is
+ * answered from the file's size alone. Each served file gets its own
+ * opaque token URL, so the next track can be handed to a renderer while
+ * the current one still plays. Up to kMaxServedFiles stay served; one
+ * that no request touched for kServedFileLifetime expires.
+ *
+ * A file the renderer cannot play, as told by SetSinkProtocolInfo(), is
+ * served transcoded by TranscodeCache. While the transcode runs the
+ * response has no length and follows the output as it is written; once it
+ * is complete the cached output is served like any file, with ranges.
+ *
+ * UPnP event NOTIFY requests to EventUrl() go to the handler set with
+ * SetEventHandler(), so DLNA servers can announce content changes and
+ * renderers their state.
+ *
+ * When BeTon is a media server itself, requests below "/upnp/" (device
+ * description, service descriptions and SOAP control) go to the handler set
+ * with SetRequestHandler(). Library tracks are served under stable
+ * "/lib/<format>/<id>/<name>" URLs from LibraryUrl(); the resolver set with
+ * SetLibraryResolver() maps the id to a path for each request, and the
+ * format in the URL picks the original file or a TranscodeCache output.
  */
 class LocalFileHttpServer {
 public:
+    static const int32 kWorkerCount = 4;
+    static const int32 kMaxConnections = 16;
+    static const bigtime_t kIdleTimeout = 15000000;
+    /** @brief Wait for the next request on a kept-alive connection. */
+    static const bigtime_t kKeepAliveTimeout = 5000000;
+    static const int32 kMaxRequestSize = 16 * 1024;
+    static const int32 kMaxServedFiles = 8;
+    static const bigtime_t kServedFileLifetime = 6 * 60 * 60 * 1000000LL;
+
     /**
      * @brief Constructs the local HTTP file server.
      */
@@ -34,41 +82,181 @@ public:
     void Stop();
 
     /**
-     * @brief Serves a specific local file.
+     * @brief Serves a local file in addition to the ones already served.
      * @param absolutePath The path to the file to serve.
-     * @param outUrl Populated with the HTTP URL that points to this file.
+     * @param outUrl Populated with the HTTP URL that points to this file;
+     * the same URL for a path that is already served.
      * @return B_OK on success.
      */
     status_t ServeFile(const BString& absolutePath, BString& outUrl);
 
-private:
     /**
-     * @brief Per-client handoff data for spawned client handler thread.
+     * @brief Sets the formats the renderer plays (its GetProtocolInfo Sink).
+     *
+     * Served files are checked against it on their next request; an empty
+     * list serves every file as it is.
+     */
+    void SetSinkProtocolInfo(const BString& sinkProtocolInfo);
+
+    /**
+     * @brief Takes a NOTIFY request's SID header and body; false rejects
+     * the subscription. Called on a worker thread.
+     */
+    typedef std::function<bool(const BString& sid, const BString& body)> EventHandler;
+
+    /**
+     * @brief Sets the handler of UPnP event NOTIFY requests to EventUrl().
+     * Set it before Start().
      */
-    struct ClientData {
-        LocalFileHttpServer* server;
-        int socket;
+    void SetEventHandler(const EventHandler& handler) { fEventHandler = handler; }
+
+    /**
+     * @brief URL to give as the CALLBACK of event subscriptions; empty
+     * while the server is not running.
+     */
+    BString EventUrl() const;
+
+    /** @brief Answer of a RequestHandler. */
+    struct Response {
+        BString status = "200 OK";
+        BString contentType = "text/xml; charset=\"utf-8\"";
+        BString headers;  ///< Extra header lines, each ending in "\r\n"
+        BString body;
     };
 
+    /**
+     * @brief Takes the method, the target below "/upnp/", the whole
+     * request (header and body) and fills `response`; false answers 404.
+     * Called on a worker thread.
+     */
+    typedef std::function<bool(const BString& method, const BString& target,
+                               const BString& request, Response& response)>
+        RequestHandler;
+
+    /**
+     * @brief Sets the handler of requests below "/upnp/". Set it before
+     * Start().
+     */
+    void SetRequestHandler(const RequestHandler& handler) { fRequestHandler = handler; }
+
+    /**
+     * @brief Maps the id of a LibraryUrl() to the path of the file; empty
+     * if unknown. Called on a worker thread.
+     */
+    typedef std::function<BString(const BString& id)> LibraryResolver;
+
+    /**
+     * @brief Sets the resolver of "/lib/" URLs. Set it before Start().
+     */
+    void SetLibraryResolver(const LibraryResolver& resolver) { fLibraryResolver = resolver; }
+
+    /**
+     * @brief URL of a library track, served as it is or as `format`.
+     * @param id Passed back to the library resolver.
+     * @param name File name; only there for clients that look at it.
+     */
+    BString LibraryUrl(const BString& id, const BString& name,
+                       TranscodeCache::Format format) const;
+
+    /** @brief "http://<address>:<port>"; empty while not running. */
+    BString BaseUrl() const;
+
+    /**
+     * @brief Value of header `name` in `request`, trimmed; empty if absent.
+     */
+    static BString HeaderValue(const BString& request, const char* name);
+
+    /** @brief MIME type of an audio file, from its extension. */
+    static const char* MimeTypeForPath(const BString& path);
+
+    /** @brief Non-loopback IPv4 address the server is reached at. */
+    const BString& Address() const { return fMyIpAddress; }
+
+private:
     /**
      * @brief Static thread entry for the accept loop.
      */
     static int32 _ServerThreadEntry(void* data);
 
     /**
-     * @brief Static thread entry for one client connection.
+     * @brief Static thread entry for a pool worker.
      */
-    static int32 _ClientThreadEntry(void* data);
+    static int32 _WorkerThreadEntry(void* data);
 
     /**
-     * @brief Accept loop that spawns client workers.
+     * @brief Accept loop that queues clients for the workers.
      */
     void _ServerLoop();
 
+    /**
+     * @brief Serves queued clients until the server stops.
+     */
+    void _WorkerLoop();
+
     /**
      * @brief Handles a single HTTP client request/response.
      */
     void _HandleClient(int clientSocket);
+
+    /**
+     * @brief Moves the next complete request header, and its body if it has
+     * one, out of `received`, receiving more as needed.
+     * @return False if the client closed, timed out or sent too much.
+     */
+    bool _ReadRequest(int clientSocket, BString& received, BString& request);
+
+    bool _Respond(int clientSocket, const BString& request);
+
+    /**
+     * @brief Sends the file at `path` as `mimeType`, or the range of it
+     * the request asks for.
+     * @return True if the connection stays open for the next request.
+     */
+    bool _SendFile(int clientSocket, const BString& path, const char* mimeType,
+                   const BString& request, bool isHead, bool keepAlive);
+
+    /**
+     * @brief Sends the output of a running transcode as it is written,
+     * without a length; the connection closes at its end.
+     */
+    void _SendTranscoding(int clientSocket, TranscodeCache::Job* job, bool isHead);
+
+    /**
+     * @brief Sends a response without a body.
+     */
+    void _SendStatus(int clientSocket, const char* status, bool keepAlive);
+
+    /**
+     * @brief Path served under request target `target`; empty if unknown.
+     * @param format Set to the format the path is served in.
+     */
+    BString _PathForTarget(const BString& target, TranscodeCache::Format& format);
+
+    /**
+     * @brief Path of a "/lib/<format>/<id>/<name>" target, through the
+     * library resolver; empty if unknown.
+     */
+    BString _PathForLibraryTarget(const BString& target, TranscodeCache::Format& format);
+
+    /**
+     * @brief Sends a RequestHandler's answer.
+     * @return True if the connection stays open for the next request.
+     */
+    bool _SendResponse(int clientSocket, const Response& response, bool isHead,
+                       bool keepAlive);
+
+    /**
+     * @brief Sends all of `data`, retrying partial sends.
+     * @return False on a network error or when the server stops.
+     */
+    bool _SendAll(int socket, const void* data, size_t size);
+
+    /**
+     * @brief Sends `length` bytes of `fd` from `start` with large page
+     * aligned reads.
+     * @return Bytes sent.
+     */
+    off_t _SendRange(int socket, int fd, off_t start, off_t length);
     
     /**
      * @brief URL-decodes a request path fragment.
@@ -78,7 +266,7 @@ private:
     /**
      * @brief URL-encodes a path fragment for renderer-safe URLs.
      */
-    BString _UrlEncode(const BString& str);
+    static BString _UrlEncode(const BString& str);
 
     /** @brief Accept-loop thread id. */
     thread_id fServerThread;
@@ -89,8 +277,34 @@ private:
     /** @brief Bound TCP port. */
     int fPort;
     
-    /** @brief Absolute path currently exposed via HTTP endpoint. */
-    BString fCurrentFile;
+    /** @brief Pool worker thread ids. */
+    std::vector<thread_id> fWorkers;
+    /** @brief Counts fPending; workers wait on it. */
+    sem_id fClientsReady;
+
+    /** @brief Guards the fields below. */
+    BLocker fLock;
+    /** @brief Accepted sockets waiting for a worker. */
+    std::deque<int> fPending;
+    /** @brief Sockets a worker is serving; shut down by Stop(). */
+    std::vector<int> fActive;
+    struct ServedFile {
+        BString path;
+        bigtime_t lastUsed;
+        int32 format; ///< TranscodeCache::Format, -1 until first requested
+    };
+
+    /** @brief Files exposed via HTTP, by URL token. */
+    std::map<BString, ServedFile> fFiles;
+    std::mt19937_64 fTokenSource;
+    /** @brief Formats the renderer plays, from SetSinkProtocolInfo(). */
+    BString fSinkProtocolInfo;
+    /** @brief Receives event NOTIFY requests. */
+    EventHandler fEventHandler;
+    /** @brief Answers requests below "/upnp/". */
+    RequestHandler fRequestHandler;
+    /** @brief Maps library URL ids to paths. */
+    LibraryResolver fLibraryResolver;
     /** @brief Non-loopback IPv4 used to build renderer-facing URLs. */
     BString fMyIpAddress;
 };
@@ -1,7 +1,13 @@
 #include "NetworkAudioStreamIO.h"
 #include "Debug.h"
+#include "HlsSegmentFetcher.h"
+#include "HttpConnectionPool.h"
 #include "Messages.h"
+#include "StreamSpillCache.h"
+#include "TimeShiftBuffer.h"
+#include "Trace.h"
 
+#include <Autolock.h>
 #include <Locker.h>
 #include <MediaFile.h>
 #include <MediaIO.h>
@@ -12,6 +18,7 @@
 #include <cstdio>
 #include <cstdlib>
 #include <cstring>
+#include <deque>
 #include <memory>
 #include <string>
 #include <vector>
@@ -32,6 +39,8 @@ extern "C" {
 namespace {
 
 std::atomic<bool> sFfmpegNetworkInitialized(false);
+/** @brief See NetworkAudioStreamIO::SetTimeShiftWindow(). */
+std::atomic<bigtime_t> sTimeShiftWindow(0);
 
 void EnsureFfmpegNetworkInitialized() {
   bool expected = false;
@@ -247,6 +256,20 @@ float PcmPeakFloat(const uint8 *data, size_t size) {
   return peak;
 }
 
+/** @brief Probe budget for radio formats whose frames describe themselves. */
+const int64_t kFastStartProbeBytes = 32 * 1024;
+const int64_t kFastStartAnalyzeDuration = 500000;
+
+/**
+ * @brief Whether the codec of `format` is known from its first frames:
+ * MP3 and ADTS AAC, which is what ICY radio sends almost always.
+ */
+bool IsFastStartFormat(const AVInputFormat *format) {
+  if (format == nullptr || format->name == nullptr)
+    return false;
+  return strcmp(format->name, "mp3") == 0 || strcmp(format->name, "aac") == 0;
+}
+
 const char *SampleFmtName(AVSampleFormat format) {
   const char *name = av_get_sample_fmt_name(format);
   return name ? name : "?";
@@ -282,52 +305,28 @@ std::string TrimString(const std::string &value) {
 
 std::string ResolveHlsUrl(const std::string &playlistUrl,
                           const std::string &segmentUrl) {
-  if (StartsWithString(segmentUrl, "http://") ||
-      StartsWithString(segmentUrl, "https://")) {
-    return segmentUrl;
-  }
-
-  if (!segmentUrl.empty() && segmentUrl[0] == '/') {
-    size_t scheme = playlistUrl.find("://");
-    if (scheme != std::string::npos) {
-      size_t hostEnd = playlistUrl.find('/', scheme + 3);
-      if (hostEnd != std::string::npos)
-        return playlistUrl.substr(0, hostEnd) + segmentUrl;
-    }
-  }
-
-  size_t slash = playlistUrl.rfind('/');
-  if (slash == std::string::npos)
-    return segmentUrl;
-
-  return playlistUrl.substr(0, slash + 1) + segmentUrl;
+  return HlsSegmentFetcher::ResolveUrl(playlistUrl.c_str(), segmentUrl.c_str())
+      .String();
 }
 
 bool ReadUrlBytes(const std::string &url, std::vector<uint8> &out,
                   size_t maxBytes) {
   out.clear();
 
-  AVDictionary *options = nullptr;
-  av_dict_set(&options, "user_agent",
-              "Mozilla/5.0 (Haiku; x86_64) Beton/1.0", 0);
-  av_dict_set(&options, "rw_timeout", "3000000", 0);
-
-  AVIOContext *io = nullptr;
-  int result = avio_open2(&io, url.c_str(), AVIO_FLAG_READ, nullptr, &options);
-  av_dict_free(&options);
-  if (result < 0)
+  // Polled every few seconds: the pool keeps the connection (and its TLS
+  // session) to the playlist host open between polls.
+  HttpConnectionPool::Request request;
+  request.url = url.c_str();
+  request.userAgent = "Mozilla/5.0 (Haiku; x86_64) Beton/1.0";
+  request.maxRedirects = 5;
+  request.maxBytes = maxBytes;
+  request.timeout = 3000000;
+  HttpConnectionPool::Response response;
+  if (HttpConnectionPool::Default().Fetch(request, response) != B_OK ||
+      response.status < 200 || response.status >= 300)
     return false;
 
-  std::vector<uint8> buffer(8192);
-  while (out.size() < maxBytes) {
-    int toRead = (int)std::min(buffer.size(), maxBytes - out.size());
-    result = avio_read(io, buffer.data(), toRead);
-    if (result <= 0)
-      break;
-    out.insert(out.end(), buffer.begin(), buffer.begin() + result);
-  }
-
-  avio_closep(&io);
+  out.swap(response.body);
   return !out.empty();
 }
 
@@ -618,20 +617,527 @@ void MergeFfmpegMetadata(AVDictionary *dict, TimedId3Fields &fields) {
   }
 }
 
+/**
+ * @brief FFmpeg input for a seekable HTTP file that keeps every downloaded
+ * block in a StreamSpillCache.
+ *
+ * Reads are served block by block: from the block just fetched, from the
+ * cache, or by reading the block from the remote connection, which issues
+ * a Range request only when the block does not follow the last one read.
+ */
+class CachedHttpInput {
+public:
+  ~CachedHttpInput() {
+    if (fContext != nullptr) {
+      av_freep(&fContext->buffer);
+      avio_context_free(&fContext);
+    }
+    if (fRemote != nullptr)
+      avio_closep(&fRemote);
+  }
+
+  /** @brief Opens `url`; false if it is not a seekable file of known size. */
+  bool Open(const BString &url, const AVIOInterruptCB *interrupt,
+            AVDictionary *options) {
+    AVDictionary *remoteOptions = nullptr;
+    av_dict_copy(&remoteOptions, options, 0);
+    int ret = avio_open2(&fRemote, url.String(), AVIO_FLAG_READ, interrupt,
+                         &remoteOptions);
+    av_dict_free(&remoteOptions);
+    if (ret < 0)
+      return false;
+    int64_t size = avio_size(fRemote);
+    if (size <= 0 || (fRemote->seekable & AVIO_SEEKABLE_NORMAL) == 0 ||
+        fCache.SetTo(url, size) != B_OK) {
+      avio_closep(&fRemote);
+      return false;
+    }
+
+    const int kBufferSize = 64 * 1024;
+    uint8 *buffer = (uint8 *)av_malloc(kBufferSize);
+    fContext = buffer != nullptr
+                   ? avio_alloc_context(buffer, kBufferSize, 0, this, _Read,
+                                        nullptr, _Seek)
+                   : nullptr;
+    if (fContext == nullptr) {
+      av_free(buffer);
+      avio_closep(&fRemote);
+      return false;
+    }
+    return true;
+  }
+
+  AVIOContext *Context() const { return fContext; }
+
+private:
+  static int _Read(void *opaque, uint8_t *buffer, int size) {
+    CachedHttpInput *self = static_cast<CachedHttpInput *>(opaque);
+    const off_t position = self->fPosition;
+    if (position >= self->fCache.Size())
+      return AVERROR_EOF;
+
+    const int64 block = position / StreamSpillCache::kBlockSize;
+    const size_t offset = position % StreamSpillCache::kBlockSize;
+    const size_t count = std::min(
+        (size_t)size, self->fCache.BlockLength(block) - offset);
+    ssize_t read = -1;
+    if (block != self->fHeldBlock && self->fCache.HasBlock(block))
+      read = self->fCache.ReadBlock(block, offset, buffer, count);
+    if (read <= 0) {
+      if (block != self->fHeldBlock) {
+        int ret = self->_Fetch(block);
+        if (ret < 0)
+          return ret;
+      }
+      memcpy(buffer, self->fBlock.data() + offset, count);
+      read = (ssize_t)count;
+    }
+    self->fPosition += read;
+    return (int)read;
+  }
+
+  static int64_t _Seek(void *opaque, int64_t offset, int whence) {
+    CachedHttpInput *self = static_cast<CachedHttpInput *>(opaque);
+    const int64_t size = self->fCache.Size();
+    switch (whence & ~AVSEEK_FORCE) {
+    case AVSEEK_SIZE:
+      return size;
+    case SEEK_SET:
+      break;
+    case SEEK_CUR:
+      offset += self->fPosition;
+      break;
+    case SEEK_END:
+      offset += size;
+      break;
+    default:
+      return AVERROR(EINVAL);
+    }
+    if (offset < 0)
+      return AVERROR(EINVAL);
+    self->fPosition = offset;
+    return offset;
+  }
+
+  /** @brief Downloads `block` into fBlock and the cache. */
+  int _Fetch(int64 block) {
+    const off_t start = block * (off_t)StreamSpillCache::kBlockSize;
+    const size_t length = fCache.BlockLength(block);
+    fHeldBlock = -1;
+    if (avio_tell(fRemote) != start) {
+      int64_t ret = avio_seek(fRemote, start, SEEK_SET);
+      if (ret < 0)
+        return (int)ret;
+    }
+    fBlock.resize(length);
+    size_t got = 0;
+    while (got < length) {
+      int ret = avio_read(fRemote, fBlock.data() + got, (int)(length - got));
+      if (ret <= 0)
+        return ret == 0 ? AVERROR_EOF : ret;
+      got += ret;
+    }
+    fHeldBlock = block;
+    fCache.WriteBlock(block, fBlock.data());
+    return 0;
+  }
+
+  AVIOContext *fRemote = nullptr;
+  AVIOContext *fContext = nullptr;
+  StreamSpillCache fCache;
+  off_t fPosition = 0;
+  std::vector<uint8> fBlock;
+  int64 fHeldBlock = -1; ///< Block in fBlock
+};
+
+/**
+ * @class FetchedHlsInput
+ * @brief AVIO read callback over an HlsSegmentFetcher, for live HLS.
+ *
+ * The demuxer sees the segments as one continuous stream; it cannot seek.
+ */
+class FetchedHlsInput {
+public:
+  ~FetchedHlsInput() {
+    if (fContext != nullptr) {
+      av_freep(&fContext->buffer);
+      avio_context_free(&fContext);
+    }
+  }
+
+  /** @brief Opens `url`; false if the fetcher does not take the stream. */
+  bool Open(const BString &url, const AVIOInterruptCB *interrupt) {
+    if (fFetcher.Open(url) != B_OK)
+      return false;
+
+    const int kBufferSize = 64 * 1024;
+    uint8 *buffer = (uint8 *)av_malloc(kBufferSize);
+    fContext = buffer != nullptr
+                   ? avio_alloc_context(buffer, kBufferSize, 0, this, _Read,
+                                        nullptr, nullptr)
+                   : nullptr;
+    if (fContext == nullptr) {
+      av_free(buffer);
+      fFetcher.Close();
+      return false;
+    }
+    fInterrupt = *interrupt;
+    return true;
+  }
+
+  AVIOContext *Context() const { return fContext; }
+  HlsSegmentFetcher &Fetcher() { return fFetcher; }
+  /** @brief Replaces the callback that interrupts waiting reads. */
+  void SetInterrupt(const AVIOInterruptCB *interrupt) {
+    fInterrupt = *interrupt;
+  }
+
+private:
+  static int _Read(void *opaque, uint8_t *buffer, int size) {
+    FetchedHlsInput *self = static_cast<FetchedHlsInput *>(opaque);
+    for (;;) {
+      if (self->fInterrupt.callback != nullptr &&
+          self->fInterrupt.callback(self->fInterrupt.opaque))
+        return AVERROR_EXIT;
+      ssize_t read = self->fFetcher.Read(buffer, size, 100000);
+      if (read > 0)
+        return (int)read;
+      if (read == 0)
+        return AVERROR_EOF;
+      if (read != B_TIMED_OUT)
+        return AVERROR_EXIT;
+    }
+  }
+
+  HlsSegmentFetcher fFetcher;
+  AVIOContext *fContext = nullptr;
+  AVIOInterruptCB fInterrupt = {};
+};
+
+/** @brief Stream time between two marks of the time-shift index. */
+const bigtime_t kTimeShiftMarkInterval = 500000;
+
+/**
+ * @class TimeShiftInput
+ * @brief FFmpeg input over a TimeShiftBuffer, which a recorder thread fills
+ * from the live source.
+ *
+ * The recorder keeps reading the network while playback is paused, so the
+ * stream resumes where it was paused instead of reconnecting. The demuxer
+ * reads the ring at its own position and seeks in it by byte; the decode
+ * loop marks which stream time each offset plays at, which maps seek
+ * times to offsets. ICY metadata is kept with the offset it arrived at and
+ * handed out when the demuxer gets there, so titles follow the delay.
+ */
+class TimeShiftInput {
+public:
+  ~TimeShiftInput() { Close(); }
+
+  /** @brief Records from a connection of its own to `url`. */
+  bool OpenUrl(const BString &url, AVDictionary *options, size_t capacity,
+               const AVIOInterruptCB *interrupt) {
+    AVDictionary *remoteOptions = nullptr;
+    av_dict_copy(&remoteOptions, options, 0);
+    int ret = avio_open2(&fRemote, url.String(), AVIO_FLAG_READ,
+                         RecorderInterrupt(), &remoteOptions);
+    av_dict_free(&remoteOptions);
+    if (ret < 0)
+      return false;
+    if (!OpenSource(fRemote, capacity, interrupt)) {
+      avio_closep(&fRemote);
+      return false;
+    }
+    return true;
+  }
+
+  /**
+   * @brief Records from `source`, which must outlive this input and be
+   * interrupted by RecorderInterrupt().
+   */
+  bool OpenSource(AVIOContext *source, size_t capacity,
+                  const AVIOInterruptCB *interrupt) {
+    if (fBuffer.SetTo(capacity) != B_OK)
+      return false;
+
+    const int kBufferSize = 64 * 1024;
+    uint8 *buffer = (uint8 *)av_malloc(kBufferSize);
+    fContext = buffer != nullptr
+                   ? avio_alloc_context(buffer, kBufferSize, 0, this, _Read,
+                                        nullptr, _Seek)
+                   : nullptr;
+    if (fContext == nullptr) {
+      av_free(buffer);
+      fBuffer.Close();
+      return false;
+    }
+    fInterrupt = *interrupt;
+    fSource = source;
+    fRecorder = spawn_thread(_RecordEntry, "time_shift_record",
+                             B_NORMAL_PRIORITY, this);
+    if (fRecorder < 0) {
+      Close();
+      return false;
+    }
+    resume_thread(fRecorder);
+    return true;
+  }
+
+  /** @brief Stops the recorder; call before closing its source. */
+  void Close() {
+    fQuit = true;
+    fBuffer.SetEnded();
+    if (fRecorder >= 0) {
+      status_t exitValue;
+      wait_for_thread(fRecorder, &exitValue);
+      fRecorder = -1;
+    }
+    if (fContext != nullptr) {
+      av_freep(&fContext->buffer);
+      avio_context_free(&fContext);
+    }
+    if (fRemote != nullptr)
+      avio_closep(&fRemote);
+    fBuffer.Close();
+  }
+
+  AVIOContext *Context() const { return fContext; }
+  const AVIOInterruptCB *RecorderInterrupt() const {
+    return &fRecorderInterrupt;
+  }
+
+  /** @brief Notes that the packet at `offset` plays at stream `time`. */
+  void Mark(bigtime_t time, int64_t offset) {
+    if (offset < 0)
+      return;
+    BAutolock lock(fLock);
+    if (!fMarks.empty() && (time - fMarks.back().time < kTimeShiftMarkInterval ||
+                            offset <= fMarks.back().offset))
+      return;
+    fMarks.push_back({time, offset});
+    const off_t start = fBuffer.Start();
+    while (fMarks.size() > 1 && fMarks[1].offset <= start)
+      fMarks.pop_front();
+  }
+
+  /**
+   * @brief Offset to seek to for stream time `time`, clamped to the
+   * window; sets `time` to when that offset plays.
+   */
+  off_t OffsetForTime(bigtime_t &time) {
+    BAutolock lock(fLock);
+    const off_t start = fBuffer.Start();
+    auto first = fMarks.begin();
+    while (first != fMarks.end() && first->offset < start)
+      ++first;
+    if (first == fMarks.end()) {
+      time = fMarks.empty() ? 0 : fMarks.back().time;
+      return start;
+    }
+    if (time <= first->time) {
+      time = first->time;
+      return first->offset;
+    }
+    const TimeMark &last = fMarks.back();
+    if (time >= last.time) {
+      // Past what was decoded: extrapolate at the window's byte rate.
+      const double rate = _BytesPerMicrosecond(*first, last);
+      off_t offset = rate > 0
+                         ? last.offset + (off_t)((time - last.time) * rate)
+                         : last.offset;
+      offset = std::min(offset, fBuffer.End());
+      time = last.time +
+             (rate > 0 ? (bigtime_t)((offset - last.offset) / rate) : 0);
+      return offset;
+    }
+    auto next = std::upper_bound(
+        first, fMarks.end(), time,
+        [](bigtime_t t, const TimeMark &mark) { return t < mark.time; });
+    --next;
+    time = next->time;
+    return next->offset;
+  }
+
+  /** @brief Stream times of the oldest and newest bytes in the window. */
+  void Window(bigtime_t &start, bigtime_t &end) {
+    BAutolock lock(fLock);
+    const off_t startOffset = fBuffer.Start();
+    auto first = fMarks.begin();
+    while (first != fMarks.end() && first->offset < startOffset)
+      ++first;
+    if (first == fMarks.end()) {
+      start = end = fMarks.empty() ? 0 : fMarks.back().time;
+      return;
+    }
+    const TimeMark &last = fMarks.back();
+    const double rate = _BytesPerMicrosecond(*first, last);
+    start = first->time;
+    end = last.time;
+    if (rate > 0)
+      end += (bigtime_t)((fBuffer.End() - last.offset) / rate);
+  }
+
+  /** @brief Newest ICY metadata packet at or before `offset`. */
+  bool IcyMetadataAt(int64_t offset, BString &packet) {
+    BAutolock lock(fLock);
+    bool found = false;
+    for (const IcyPacket &icy : fIcy) {
+      if (icy.offset > offset)
+        break;
+      packet = icy.packet;
+      found = true;
+    }
+    return found;
+  }
+
+private:
+  struct TimeMark {
+    bigtime_t time;
+    off_t offset;
+  };
+  struct IcyPacket {
+    off_t offset;
+    BString packet;
+  };
+
+  static double _BytesPerMicrosecond(const TimeMark &first,
+                                     const TimeMark &last) {
+    if (last.time <= first.time)
+      return 0;
+    return (double)(last.offset - first.offset) / (last.time - first.time);
+  }
+
+  static int _Read(void *opaque, uint8_t *buffer, int size) {
+    TimeShiftInput *self = static_cast<TimeShiftInput *>(opaque);
+    for (;;) {
+      if (self->fInterrupt.callback != nullptr &&
+          self->fInterrupt.callback(self->fInterrupt.opaque))
+        return AVERROR_EXIT;
+      ssize_t read =
+          self->fBuffer.Read(self->fPosition, buffer, size, 100000);
+      if (read > 0)
+        return (int)read;
+      if (read == 0)
+        return AVERROR_EOF;
+      if (read != B_TIMED_OUT)
+        return AVERROR(EIO);
+    }
+  }
+
+  static int64_t _Seek(void *opaque, int64_t offset, int whence) {
+    TimeShiftInput *self = static_cast<TimeShiftInput *>(opaque);
+    switch (whence & ~AVSEEK_FORCE) {
+    case AVSEEK_SIZE:
+      return AVERROR(ENOSYS); // Live: no size
+    case SEEK_SET:
+      break;
+    case SEEK_CUR:
+      offset += self->fPosition;
+      break;
+    case SEEK_END:
+      offset += self->fBuffer.End();
+      break;
+    default:
+      return AVERROR(EINVAL);
+    }
+    if (offset < self->fBuffer.Start() || offset > self->fBuffer.End())
+      return AVERROR(EINVAL);
+    self->fPosition = offset;
+    return offset;
+  }
+
+  static int _RecorderInterrupted(void *opaque) {
+    return static_cast<TimeShiftInput *>(opaque)->fQuit.load() ? 1 : 0;
+  }
+
+  static int32 _RecordEntry(void *arg) {
+    static_cast<TimeShiftInput *>(arg)->_Record();
+    return 0;
+  }
+
+  /** @brief Copies the source into the ring until it ends or Close(). */
+  void _Record() {
+    /// Failed reads in a row before the source counts as gone.
+    static const int kMaxRetries = 10;
+    std::vector<uint8> chunk(16 * 1024);
+    BString lastIcy;
+    int retries = 0;
+    while (!fQuit.load()) {
+      int read = avio_read(fSource, chunk.data(), (int)chunk.size());
+      if (read > 0) {
+        retries = 0;
+        const off_t offset = fBuffer.End();
+        if (fBuffer.Append(chunk.data(), read) != B_OK)
+          break;
+        _PollIcy(offset, lastIcy);
+        continue;
+      }
+      if (fQuit.load() || read == AVERROR_EOF || ++retries >= kMaxRetries)
+        break;
+      // A custom AVIO context stays at EOF once a read failed.
+      fSource->eof_reached = 0;
+      fSource->error = 0;
+      snooze(1000000);
+    }
+    DEBUG_PRINT("Time shift recorder stopped at %lld bytes\n",
+                (long long)fBuffer.End());
+    fBuffer.SetEnded();
+  }
+
+  void _PollIcy(off_t offset, BString &lastIcy) {
+    if (fSource != fRemote)
+      return;
+    uint8_t *value = nullptr;
+    if (av_opt_get(fSource, "icy_metadata_packet", AV_OPT_SEARCH_CHILDREN,
+                   &value) < 0 ||
+        value == nullptr) {
+      return;
+    }
+    BString packet((const char *)value);
+    av_free(value);
+    if (packet.IsEmpty() || packet == lastIcy)
+      return;
+    lastIcy = packet;
+
+    BAutolock lock(fLock);
+    fIcy.push_back({offset, packet});
+    const off_t start = fBuffer.Start();
+    while (fIcy.size() > 1 && fIcy[1].offset <= start)
+      fIcy.pop_front();
+  }
+
+  TimeShiftBuffer fBuffer;
+  AVIOContext *fRemote = nullptr;  ///< Own connection, for OpenUrl()
+  AVIOContext *fSource = nullptr;  ///< What the recorder reads
+  AVIOContext *fContext = nullptr; ///< What the demuxer reads
+  off_t fPosition = 0;             ///< Demuxer position in the stream
+  AVIOInterruptCB fInterrupt = {};
+  AVIOInterruptCB fRecorderInterrupt = {_RecorderInterrupted, this};
+  std::atomic<bool> fQuit{false};
+  thread_id fRecorder = -1;
+
+  BLocker fLock{"time shift"}; ///< Guards fMarks and fIcy
+  std::deque<TimeMark> fMarks; ///< By time and offset
+  std::deque<IcyPacket> fIcy;  ///< By offset
+};
+
 } /// namespace
 
 /**
- * @brief Constructs NetworkAudioStreamIO with an 8 MB ring buffer.
+ * @brief Constructs NetworkAudioStreamIO; Open() sizes the ring buffer.
  * @param target The BMessenger to send metadata updates to.
  */
 NetworkAudioStreamIO::NetworkAudioStreamIO(BMessenger target, BUrlContext *context)
-    : fBuffer(new uint8[kBufferCapacity]), fWritePos(0), fTotalWritten(0),
-      fReadPos(0), fValidStart(0), fTarget(target), fMode(MODE_ICY),
+    : fBuffer(nullptr), fCapacity(0), fMemory(kMemoryStreams), fWritePos(0),
+      fTotalWritten(0), fReadPos(0), fValidStart(0), fReaderWaiting(false),
+      fWriterWaiting(false), fTarget(target), fMode(MODE_ICY),
       fContext(context), fRunning(false), fRequestRunning(false),
       fExpectedSize(0), fFfmpegThread(-1), fHlsFormatKnown(false),
-      fLastHlsMetadataPoll(0), fLastPcmReadDebugLog(0),
-      fFfmpegReadDeadline(0), fPendingSeekTime(-1) {
+      fLastHlsMetadataPoll(0),
+      fFfmpegReadDeadline(0), fPendingSeekTime(-1), fShiftStart(-1),
+      fShiftEnd(-1), fRecorder(target), fRecordRequest(kRecordStop),
+      fRecordLock("stream recording"), fDecodedTotal(0) {
   fDataReady = create_sem(0, "stream_data_ready");
+  fSpaceReady = create_sem(0, "stream_space_ready");
   fHlsFormatReady = create_sem(0, "hls_format_ready");
   memset(&fHlsFormat, 0, sizeof(fHlsFormat));
 }
@@ -640,11 +1146,72 @@ NetworkAudioStreamIO::~NetworkAudioStreamIO() {
   Stop();
   if (fDataReady >= 0)
     delete_sem(fDataReady);
+  if (fSpaceReady >= 0)
+    delete_sem(fSpaceReady);
   if (fHlsFormatReady >= 0)
     delete_sem(fHlsFormatReady);
   delete[] fBuffer;
 }
 
+/** @brief Ring capacity for `mode`; see the constants in the header. */
+size_t NetworkAudioStreamIO::_CapacityFor(Mode mode) {
+  switch (mode) {
+  case MODE_HLS:
+    return kHlsCapacity;
+  case MODE_DLNA:
+    return kDlnaCapacity;
+  case MODE_ICY:
+  default:
+    return kIcyCapacity;
+  }
+}
+
+/** @brief Bytes the writer may add before it would overwrite history. */
+size_t NetworkAudioStreamIO::_Space() const {
+  off_t unread = fTotalWritten.load(std::memory_order_relaxed) -
+                 fReadPos.load(std::memory_order_seq_cst);
+  off_t limit = (off_t)(fCapacity - kHistoryBytes);
+  return unread >= limit ? 0 : (size_t)(unread < 0 ? limit : limit - unread);
+}
+
+/**
+ * @brief Blocks the reader at `readPos` until data arrives, the stream
+ * ends or `timeout` passes; true if data is available.
+ *
+ * The flag is raised before the last check, so a writer publishing in
+ * between sees it and releases the semaphore.
+ */
+bool NetworkAudioStreamIO::_WaitForData(off_t readPos,
+                                        bigtime_t timeout) const {
+  const bigtime_t deadline = system_time() + timeout;
+  for (;;) {
+    fReaderWaiting.store(true, std::memory_order_seq_cst);
+    if (fTotalWritten.load(std::memory_order_seq_cst) > readPos ||
+        !fRequestRunning.load(std::memory_order_relaxed)) {
+      fReaderWaiting.store(false, std::memory_order_relaxed);
+      return fTotalWritten.load(std::memory_order_acquire) > readPos;
+    }
+    bigtime_t left = deadline - system_time();
+    if (left <= 0 || acquire_sem_etc(fDataReady, 1, B_RELATIVE_TIMEOUT,
+                                     left) != B_OK) {
+      fReaderWaiting.store(false, std::memory_order_relaxed);
+      return fTotalWritten.load(std::memory_order_acquire) > readPos;
+    }
+  }
+}
+
+/** @brief Wakes a reader blocked in _WaitForData(), if there is one. */
+void NetworkAudioStreamIO::_WakeReader() {
+  if (fReaderWaiting.exchange(false, std::memory_order_seq_cst))
+    release_sem(fDataReady);
+}
+
+/** @brief Wakes the writer blocked on a full ring, if it is. */
+void NetworkAudioStreamIO::_WakeWriter() {
+  if (fWriterWaiting.exchange(false, std::memory_order_seq_cst))
+    release_sem(fSpaceReady);
+}
+
 ssize_t NetworkAudioStreamIO::Read(void *buffer, size_t size) {
   if (!buffer || size == 0)
     return 0;
@@ -668,74 +1235,67 @@ ssize_t NetworkAudioStreamIO::Read(void *buffer, size_t size) {
       if (!fRequestRunning.load(std::memory_order_relaxed))
         return (ssize_t)totalRead; ///< Return what we have, 0 means EOF
 
-      acquire_sem_etc(fDataReady, 1, B_RELATIVE_TIMEOUT, 500000);
+      _WaitForData(readPos, 500000);
       continue;
     }
 
     size_t toRead = std::min(size - totalRead, (size_t)available);
-    size_t bufOffset = (size_t)(readPos % kBufferCapacity);
-    size_t chunk = std::min(toRead, kBufferCapacity - bufOffset);
+    size_t bufOffset = (size_t)(readPos % fCapacity);
+    size_t chunk = std::min(toRead, fCapacity - bufOffset);
 
     memcpy(dst + totalRead, fBuffer + bufOffset, chunk);
     totalRead += chunk;
     readPos += chunk;
-    fReadPos.store(readPos, std::memory_order_relaxed);
 
     if (chunk < toRead) {
       size_t rest = toRead - chunk;
       memcpy(dst + totalRead, fBuffer, rest);
       totalRead += rest;
       readPos += rest;
-      fReadPos.store(readPos, std::memory_order_relaxed);
     }
+    fReadPos.store(readPos, std::memory_order_seq_cst);
+    _WakeWriter();
   }
 
   return (ssize_t)totalRead;
 }
 
 ssize_t NetworkAudioStreamIO::Write(const void *buffer, size_t size) {
-  if (!buffer || size == 0)
+  if (!buffer || size == 0 || fBuffer == nullptr)
     return 0;
 
-  if (fTotalWritten == 0) {
-  }
-
   const uint8 *src = (const uint8 *)buffer;
   size_t totalWritten = 0;
 
-  while (totalWritten < size) {
-    if (!fRunning)
-      break;
-
-    off_t writePos = fWritePos.load(std::memory_order_relaxed);
-    off_t totalWrittenBytes = fTotalWritten.load(std::memory_order_relaxed);
-    off_t readPos = fReadPos.load(std::memory_order_relaxed);
-
-    off_t unread = totalWrittenBytes - readPos;
-    /// Reserve 1MB (1048576 bytes) of history space in the buffer.
-    /// This allows BMediaFile to seek backwards by up to 1MB without triggering
-    /// a network restart!
-    off_t maxFuture = (off_t)kBufferCapacity - 1048576;
-
-    if (unread >= maxFuture) {
-      snooze(10000); ///< 10ms backpressure
+  while (totalWritten < size && fRunning) {
+    size_t space = _Space();
+    if (space == 0) {
+      /// Full: sleep until the reader frees space, Stop() or a seek.
+      if (fPendingSeekTime.load(std::memory_order_acquire) >= 0)
+        break;
+      fWriterWaiting.store(true, std::memory_order_seq_cst);
+      if (_Space() == 0 && fRunning &&
+          fPendingSeekTime.load(std::memory_order_acquire) < 0)
+        acquire_sem(fSpaceReady);
+      fWriterWaiting.store(false, std::memory_order_relaxed);
       continue;
     }
 
-    size_t chunkAllowed = unread < 0 ? maxFuture : maxFuture - (size_t)unread;
-    size_t bufOffset = (size_t)(writePos % kBufferCapacity);
-    size_t toWrite = std::min(size - totalWritten, kBufferCapacity - bufOffset);
-    toWrite = std::min(toWrite, chunkAllowed);
+    off_t writePos = fWritePos.load(std::memory_order_relaxed);
+    off_t totalWrittenBytes = fTotalWritten.load(std::memory_order_relaxed);
+    size_t bufOffset = (size_t)(writePos % fCapacity);
+    size_t toWrite = std::min(size - totalWritten, fCapacity - bufOffset);
+    toWrite = std::min(toWrite, space);
 
     memcpy(fBuffer + bufOffset, src + totalWritten, toWrite);
 
     fWritePos.store(writePos + toWrite, std::memory_order_relaxed);
-    fTotalWritten.store(totalWrittenBytes + toWrite, std::memory_order_release);
+    fTotalWritten.store(totalWrittenBytes + toWrite, std::memory_order_seq_cst);
+    _WakeReader();
 
     totalWritten += toWrite;
   }
 
-  release_sem(fDataReady);
   return (ssize_t)totalWritten;
 }
 
@@ -806,7 +1366,8 @@ status_t NetworkAudioStreamIO::WaitForData(size_t minBytes,
   while (fTotalWritten.load(std::memory_order_acquire) < (off_t)minBytes) {
     if (!fRunning)
       return B_ERROR;
-    if (system_time() >= deadline) {
+    bigtime_t left = deadline - system_time();
+    if (left <= 0) {
       if (fTotalWritten.load(std::memory_order_acquire) > 32768) {
         DEBUG_PRINT("WaitForData timed out, but proceeding "
                     "with %zu bytes\n",
@@ -815,19 +1376,43 @@ status_t NetworkAudioStreamIO::WaitForData(size_t minBytes,
       }
       return B_TIMED_OUT;
     }
-    snooze(50000);
+    /// Woken by every write while waiting, so each check sees new data.
+    _WaitForData(fTotalWritten.load(std::memory_order_acquire), left);
   }
   DEBUG_PRINT("WaitForData: %zu bytes buffered\n",
               (size_t)fTotalWritten.load(std::memory_order_acquire));
   return B_OK;
 }
 
+void NetworkAudioStreamIO::SetTimeShiftWindow(bigtime_t window) {
+  sTimeShiftWindow.store(std::max<bigtime_t>(0, window),
+                         std::memory_order_relaxed);
+}
+
+bigtime_t NetworkAudioStreamIO::TimeShiftWindow() {
+  return sTimeShiftWindow.load(std::memory_order_relaxed);
+}
+
+void NetworkAudioStreamIO::StartRecording(const BString &directory,
+                                          const BString &station) {
+  {
+    BAutolock lock(fRecordLock);
+    fRecordDirectory = directory;
+    fRecordStation = station;
+  }
+  fRecordRequest.store(kRecordStart, std::memory_order_relaxed);
+}
+
+void NetworkAudioStreamIO::StopRecording() {
+  fRecordRequest.store(kRecordStop, std::memory_order_relaxed);
+}
+
 status_t NetworkAudioStreamIO::SeekToTime(bigtime_t position) {
-  if (fMode != MODE_DLNA || position < 0 || !fRunning)
+  if ((fMode != MODE_DLNA && !IsTimeShifted()) || position < 0 || !fRunning)
     return B_NOT_ALLOWED;
 
   fPendingSeekTime.store(position, std::memory_order_release);
-  release_sem(fDataReady);
+  _WakeWriter();
   return B_OK;
 }
 
@@ -871,32 +1456,20 @@ ssize_t NetworkAudioStreamIO::ReadPcm(void *buffer, size_t size) {
       memset(buffer, 0, size);
       return B_ERROR;
     }
-    acquire_sem_etc(fDataReady, 1, B_RELATIVE_TIMEOUT, 200000);
+    _WaitForData(readPos, 200000);
     readPos = fReadPos.load(std::memory_order_relaxed);
     totalWritten = fTotalWritten.load(std::memory_order_acquire);
     available = totalWritten > readPos ? (size_t)(totalWritten - readPos) : 0;
     if (available == 0) {
-#if 0
-      bigtime_t now = system_time();
-      bigtime_t last =
-          fLastPcmReadDebugLog.load(std::memory_order_relaxed);
-      if (now - last >= 1000000 &&
-          fLastPcmReadDebugLog.compare_exchange_strong(last, now)) {
-        DEBUG_PRINT("ReadPcm underrun: requested=%zu totalWritten=%lld "
-                    "readPos=%lld running=%d requestRunning=%d\n",
-                    size, (long long)totalWritten, (long long)readPos,
-                    (int)fRunning.load(std::memory_order_relaxed),
-                    (int)fRequestRunning.load(std::memory_order_relaxed));
-      }
-#endif
+      TRACE_INSTANT(kTracePlayback, "stream underrun", (int64)size);
       memset(buffer, 0, size);
       return (ssize_t)size;
     }
   }
 
   size_t toRead = std::min(size, available);
-  size_t bufOffset = (size_t)readPos % kBufferCapacity;
-  size_t chunk = std::min(toRead, kBufferCapacity - bufOffset);
+  size_t bufOffset = (size_t)(readPos % fCapacity);
+  size_t chunk = std::min(toRead, fCapacity - bufOffset);
 
   memcpy(dst, fBuffer + bufOffset, chunk);
   totalRead += chunk;
@@ -908,24 +1481,13 @@ ssize_t NetworkAudioStreamIO::ReadPcm(void *buffer, size_t size) {
     totalRead += rest;
     readPos += rest;
   }
-  fReadPos.store(readPos, std::memory_order_relaxed);
+  fReadPos.store(readPos, std::memory_order_seq_cst);
+  _WakeWriter();
 
   if (totalRead < size) {
     memset(dst + totalRead, 0, size - totalRead);
   }
 
-#if 0
-  bigtime_t now = system_time();
-  bigtime_t last = fLastPcmReadDebugLog.load(std::memory_order_relaxed);
-  if (now - last >= 1000000 &&
-      fLastPcmReadDebugLog.compare_exchange_strong(last, now)) {
-    DEBUG_PRINT("ReadPcm: requested=%zu read=%zu silenceFill=%zu peak=%.6f "
-                "totalWritten=%lld readPos=%lld availableBefore=%zu\n",
-                size, totalRead, size - totalRead, PcmPeakFloat(dst, totalRead),
-                (long long)totalWritten, (long long)readPos, available);
-  }
-#endif
-
   return (ssize_t)size;
 }
 
@@ -945,6 +1507,9 @@ status_t NetworkAudioStreamIO::Open(const BString &url, Mode mode,
   if (fDataReady >= 0)
     delete_sem(fDataReady);
   fDataReady = create_sem(0, "stream_data_ready");
+  if (fSpaceReady >= 0)
+    delete_sem(fSpaceReady);
+  fSpaceReady = create_sem(0, "stream_space_ready");
 
   if (fHlsFormatReady >= 0)
     delete_sem(fHlsFormatReady);
@@ -953,6 +1518,15 @@ status_t NetworkAudioStreamIO::Open(const BString &url, Mode mode,
   fUrl = url;
   fMode = mode;
   fRunning = true;
+  const size_t capacity = _CapacityFor(mode);
+  if (capacity != fCapacity) {
+    delete[] fBuffer;
+    fBuffer = new uint8[capacity];
+    fCapacity = capacity;
+    fMemory.Set(capacity);
+  }
+  fReaderWaiting = false;
+  fWriterWaiting = false;
   fWritePos = 0;
   fTotalWritten = 0;
   fReadPos = 0;
@@ -965,9 +1539,13 @@ status_t NetworkAudioStreamIO::Open(const BString &url, Mode mode,
   fPendingHlsMetadata.clear();
   fHlsFormatKnown = false;
   fLastHlsMetadataPoll = 0;
-  fLastPcmReadDebugLog = 0;
   fFfmpegReadDeadline = 0;
   fPendingSeekTime = -1;
+  fShiftStart = -1;
+  fShiftEnd = -1;
+  // A recording belongs to the stream it was started on.
+  fRecordRequest = kRecordStop;
+  fDecodedTotal = 0;
   memset(&fHlsFormat, 0, sizeof(fHlsFormat));
 
   EnsureFfmpegNetworkInitialized();
@@ -993,6 +1571,8 @@ void NetworkAudioStreamIO::Stop() {
 
   if (fDataReady >= 0)
     release_sem(fDataReady);
+  if (fSpaceReady >= 0)
+    release_sem(fSpaceReady);
   if (fHlsFormatReady >= 0)
     release_sem(fHlsFormatReady);
 
@@ -1037,6 +1617,9 @@ void NetworkAudioStreamIO::_NotifyMetadata(const BString &title,
   if (title == fLastStreamTitle && url == fLastStreamUrl)
     return;
 
+  if (fRecorder.IsRecording() && title != fLastStreamTitle &&
+      !title.IsEmpty())
+    fRecorder.Split(BString(), title, BString(), fDecodedTotal);
   fLastStreamTitle = title;
   fLastStreamUrl = url;
 
@@ -1050,10 +1633,15 @@ void NetworkAudioStreamIO::_NotifyMetadata(const BString &title,
   }
 }
 
+/**
+ * @param heardAt Stream time the metadata applies to, if it was held back
+ * until heard; otherwise it applies to the audio demuxed next.
+ */
 void NetworkAudioStreamIO::_NotifyMetadata(const BString &artist,
                                       const BString &title,
                                       const BString &album,
-                                      const BString &url) {
+                                      const BString &url,
+                                      bigtime_t heardAt) {
   BString streamTitle = title;
   if (!artist.IsEmpty() && !title.IsEmpty()) {
     streamTitle = artist;
@@ -1065,6 +1653,11 @@ void NetworkAudioStreamIO::_NotifyMetadata(const BString &artist,
   if (streamTitle == fLastStreamTitle && url == fLastStreamUrl)
     return;
 
+  if (fRecorder.IsRecording() && streamTitle != fLastStreamTitle &&
+      !streamTitle.IsEmpty()) {
+    fRecorder.Split(artist, title, album,
+                    heardAt >= 0 ? heardAt : fDecodedTotal);
+  }
   fLastStreamTitle = streamTitle;
   fLastStreamUrl = url;
 
@@ -1152,8 +1745,13 @@ void NetworkAudioStreamIO::_ProcessHlsTimedMetadata(const uint8 *data,
   }
 }
 
+/**
+ * @brief Queues the emsg ID3 events of a segment whose audio is heard from
+ * `startTime` on.
+ */
 void NetworkAudioStreamIO::_QueueHlsSegmentMetadata(const uint8 *data,
-                                                    size_t size) {
+                                                    size_t size,
+                                                    bigtime_t startTime) {
   if (!data || size == 0)
     return;
 
@@ -1204,9 +1802,9 @@ void NetworkAudioStreamIO::_QueueHlsSegmentMetadata(const uint8 *data,
   for (const auto &event : segmentEvents)
     firstOffset = std::min(firstOffset, event.dueTime);
 
-  bigtime_t now = system_time();
   for (auto &event : segmentEvents) {
-    event.dueTime = now + std::max<bigtime_t>(0, event.dueTime - firstOffset);
+    event.dueTime =
+        startTime + std::max<bigtime_t>(0, event.dueTime - firstOffset);
     fPendingHlsMetadata.push_back(event);
   }
 
@@ -1298,7 +1896,8 @@ void NetworkAudioStreamIO::_PollHlsPlaylistMetadata() {
 
   DEBUG_PRINT("Scanning HLS segment metadata: %s (%zu bytes)\n",
               segmentUrl.c_str(), segmentBytes.size());
-  _QueueHlsSegmentMetadata(segmentBytes.data(), segmentBytes.size());
+  _QueueHlsSegmentMetadata(segmentBytes.data(), segmentBytes.size(),
+                           system_time());
 }
 
 void NetworkAudioStreamIO::_DispatchDueHlsMetadata() {
@@ -1311,10 +1910,53 @@ void NetworkAudioStreamIO::_DispatchDueHlsMetadata() {
     DEBUG_PRINT("HLS timed metadata due: artist='%s' title='%s' album='%s'\n",
                 event.artist.String(), event.title.String(),
                 event.album.String());
-    _NotifyMetadata(event.artist, event.title, event.album, event.url);
+    // Due now means heard now: the decoder is ahead by what is buffered.
+    _NotifyMetadata(event.artist, event.title, event.album, event.url,
+                    std::max<bigtime_t>(0, fDecodedTotal - _BufferedTime()));
   }
 }
 
+/** @brief Decoded audio not played yet. */
+bigtime_t NetworkAudioStreamIO::_BufferedTime() const {
+  const double bytesPerSecond = (double)fHlsFormat.frame_rate *
+                                fHlsFormat.channel_count * sizeof(float);
+  if (!fHlsFormatKnown || bytesPerSecond <= 0)
+    return 0;
+  return (bigtime_t)(HlsBufferedBytes(
+                         fTotalWritten.load(std::memory_order_acquire),
+                         fReadPos.load(std::memory_order_relaxed)) /
+                     bytesPerSecond * 1e6);
+}
+
+/**
+ * @brief Starts or stops the recorder as requested; on the stream thread,
+ * which alone feeds it.
+ */
+void NetworkAudioStreamIO::_UpdateRecording(const AVCodecParameters *codec,
+                                            const AVRational &timeBase) {
+  const bool wanted =
+      fRecordRequest.load(std::memory_order_relaxed) == kRecordStart;
+  if (wanted == fRecorder.IsRecording())
+    return;
+  if (!wanted) {
+    fRecorder.Stop();
+    return;
+  }
+
+  BString directory, station;
+  {
+    BAutolock lock(fRecordLock);
+    directory = fRecordDirectory;
+    station = fRecordStation;
+  }
+  if (fRecorder.Start(directory, station, fUrl, codec, timeBase) != B_OK) {
+    fRecordRequest.store(kRecordStop, std::memory_order_relaxed);
+    return;
+  }
+  // The first file gets the title already playing.
+  fRecorder.Split(BString(), fLastStreamTitle, BString(), fDecodedTotal);
+}
+
 int NetworkAudioStreamIO::_FfmpegInterruptCallback(void *arg) {
   NetworkAudioStreamIO *self = static_cast<NetworkAudioStreamIO *>(arg);
   if (!self || !self->fRunning.load(std::memory_order_relaxed))
@@ -1362,6 +2004,8 @@ void NetworkAudioStreamIO::_FfmpegLoop() {
   } else {
     av_dict_set(&opts, "max_reload", "8", 0);
     av_dict_set(&opts, "m3u8_hold_counters", "8", 0);
+    // Segments and playlist reloads on one keep-alive connection.
+    av_dict_set(&opts, "http_persistent", "1", 0);
   }
   av_dict_set(&opts, "reconnect_streamed", "1", 0);
   av_dict_set(&opts, "reconnect_on_network_error", "1", 0);
@@ -1370,7 +2014,57 @@ void NetworkAudioStreamIO::_FfmpegLoop() {
 
   DEBUG_PRINT("FFmpeg opening input: %s\n", fUrl.String());
   fFfmpegReadDeadline = system_time() + 15000000;
-  if (avformat_open_input(&fmtCtx, fUrl.String(), nullptr, &opts) < 0) {
+  // DLNA tracks are plain files: keep what was downloaded on disk, so
+  // seeking back or replaying does not fetch it again. Closed after fmtCtx.
+  CachedHttpInput cachedInput;
+  // Live HLS: segments download several at a time, ahead of the demuxer,
+  // which then reads them as one stream. Other playlists keep going
+  // through libavformat's HLS demuxer.
+  FetchedHlsInput fetchedInput;
+  // Live radio with time-shifting: a recorder copies the stream into a ring
+  // on disk, which the demuxer reads, so it can pause and seek back.
+  // Declared last, so the recorder stops before the fetcher it reads.
+  TimeShiftInput timeShift;
+  const size_t shiftCapacity =
+      (size_t)(TimeShiftWindow() / 1000000) * kTimeShiftBytesPerSecond;
+  const bool shift = shiftCapacity > 0 && fMode != MODE_DLNA &&
+                     (fUrl.IStartsWith("http://") ||
+                      fUrl.IStartsWith("https://"));
+  BString openUrl = fUrl;
+  if (fMode == MODE_DLNA &&
+      (fUrl.IStartsWith("http://") || fUrl.IStartsWith("https://")) &&
+      cachedInput.Open(fUrl, &fmtCtx->interrupt_callback, opts)) {
+    fmtCtx->pb = cachedInput.Context();
+    fmtCtx->flags |= AVFMT_FLAG_CUSTOM_IO;
+  } else if (isHls &&
+             fetchedInput.Open(fUrl, &fmtCtx->interrupt_callback)) {
+    fmtCtx->pb = fetchedInput.Context();
+    if (shift) {
+      // The recorder reads the fetcher now, and only Stop() ends it.
+      fetchedInput.SetInterrupt(timeShift.RecorderInterrupt());
+      if (timeShift.OpenSource(fetchedInput.Context(), shiftCapacity,
+                               &fmtCtx->interrupt_callback))
+        fmtCtx->pb = timeShift.Context();
+      else
+        fetchedInput.SetInterrupt(&fmtCtx->interrupt_callback);
+    }
+    fmtCtx->flags |= AVFMT_FLAG_CUSTOM_IO;
+    openUrl = fetchedInput.Fetcher().FirstSegmentUrl();
+  } else if (shift && !isHls &&
+             timeShift.OpenUrl(fUrl, opts, shiftCapacity,
+                               &fmtCtx->interrupt_callback)) {
+    fmtCtx->pb = timeShift.Context();
+    fmtCtx->flags |= AVFMT_FLAG_CUSTOM_IO;
+  }
+  const bool fetched = fetchedInput.Context() != nullptr;
+  const bool shifted = timeShift.Context() != nullptr;
+  if (shifted) {
+    DEBUG_PRINT("Time-shifting %s in %zu bytes\n", fUrl.String(),
+                shiftCapacity);
+    fShiftStart.store(0, std::memory_order_relaxed);
+    fShiftEnd.store(0, std::memory_order_relaxed);
+  }
+  if (avformat_open_input(&fmtCtx, openUrl.String(), nullptr, &opts) < 0) {
     DEBUG_PRINT("avformat_open_input failed for %s\n", fUrl.String());
     av_dict_free(&opts);
     avformat_close_input(&fmtCtx);
@@ -1384,6 +2078,13 @@ void NetworkAudioStreamIO::_FfmpegLoop() {
   fFfmpegReadDeadline = 0;
   av_dict_free(&opts);
 
+  // Radio in a self-describing format: its first frames are enough to know
+  // the codec, so do not read a second or more of audio before starting.
+  if (fMode == MODE_ICY && !isHls && IsFastStartFormat(fmtCtx->iformat)) {
+    fmtCtx->probesize = kFastStartProbeBytes;
+    fmtCtx->max_analyze_duration = kFastStartAnalyzeDuration;
+  }
+
   fFfmpegReadDeadline = system_time() + 15000000;
   if (avformat_find_stream_info(fmtCtx, nullptr) < 0) {
     DEBUG_PRINT("avformat_find_stream_info failed\n");
@@ -1528,6 +2229,16 @@ void NetworkAudioStreamIO::_FfmpegLoop() {
   /// recover from transient errors or segment-boundary hiccups.
   static const int kMaxHlsRetries = 10;
   int hlsRetries = 0;
+  std::vector<uint8> segmentHead;
+  // What swr converts from; a discontinuity may change it mid-stream.
+  int swrInRate = codecCtx->sample_rate;
+  AVSampleFormat swrInFormat = codecCtx->sample_fmt;
+  AVChannelLayout swrInLayout;
+  av_channel_layout_copy(&swrInLayout, &codecCtx->ch_layout);
+  bool decodeFailed = false;
+  // Stream time of the PCM decoded so far; the time-shift index maps it to
+  // offsets in the ring.
+  bigtime_t decodedTime = 0;
 #if 0
   bigtime_t lastDecodeDebugLog = 0;
   size_t decodedFramesSinceLog = 0;
@@ -1539,13 +2250,25 @@ void NetworkAudioStreamIO::_FfmpegLoop() {
 
   while (fRunning) {
     _DispatchDueHlsMetadata();
+    _UpdateRecording(stream->codecpar, stream->time_base);
 
     bigtime_t seekTime =
         fPendingSeekTime.exchange(-1, std::memory_order_acq_rel);
     if (seekTime >= 0) {
-      int64_t seekTarget = av_rescale_q(
-          seekTime, AVRational{1, 1000000}, stream->time_base);
-      ret = av_seek_frame(fmtCtx, audioIdx, seekTarget, AVSEEK_FLAG_BACKWARD);
+      if (shifted) {
+        // Live streams have no usable timestamps; seek by byte to the
+        // closest marked offset.
+        bigtime_t target = seekTime;
+        const off_t offset = timeShift.OffsetForTime(target);
+        ret = av_seek_frame(fmtCtx, -1, offset, AVSEEK_FLAG_BYTE);
+        if (ret >= 0)
+          decodedTime = target;
+      } else {
+        int64_t seekTarget = av_rescale_q(
+            seekTime, AVRational{1, 1000000}, stream->time_base);
+        ret = av_seek_frame(fmtCtx, audioIdx, seekTarget,
+                            AVSEEK_FLAG_BACKWARD);
+      }
       DEBUG_PRINT("FFmpeg seek to %lld us returned %d\n",
                   (long long)seekTime, ret);
       if (ret >= 0) {
@@ -1565,7 +2288,7 @@ void NetworkAudioStreamIO::_FfmpegLoop() {
     size_t hlsBuffered = HlsBufferedBytes(
         fTotalWritten.load(std::memory_order_acquire),
         fReadPos.load(std::memory_order_relaxed));
-    if (isHls && hlsBuffered >= hlsMetadataMinBuffer &&
+    if (isHls && !fetched && hlsBuffered >= hlsMetadataMinBuffer &&
         system_time() - fLastHlsMetadataPoll >= hlsMetadataPollInterval) {
       _PollHlsPlaylistMetadata();
       fLastHlsMetadataPoll = system_time();
@@ -1576,6 +2299,10 @@ void NetworkAudioStreamIO::_FfmpegLoop() {
     ret = av_read_frame(fmtCtx, pkt);
     fFfmpegReadDeadline = 0;
     if (ret < 0) {
+      if (fetched && ret == AVERROR_EOF) {
+        DEBUG_PRINT("HLS stream ended\n");
+        break;
+      }
       if (isHls && fRunning) {
         hlsRetries++;
         DEBUG_PRINT("av_read_frame error %d (HLS retry %d/%d)\n",
@@ -1585,6 +2312,11 @@ void NetworkAudioStreamIO::_FfmpegLoop() {
           break;
         }
         av_packet_unref(pkt);
+        if (fetched) {
+          // A custom AVIO context stays at EOF once a read failed.
+          fmtCtx->pb->eof_reached = 0;
+          fmtCtx->pb->error = 0;
+        }
         snooze(1000000);
         continue;
       }
@@ -1593,8 +2325,40 @@ void NetworkAudioStreamIO::_FfmpegLoop() {
     }
     hlsRetries = 0;
 
+    if (shifted) {
+      const int64_t offset = pkt->pos >= 0 ? pkt->pos : avio_tell(fmtCtx->pb);
+      timeShift.Mark(decodedTime, offset);
+      bigtime_t windowStart, windowEnd;
+      timeShift.Window(windowStart, windowEnd);
+      fShiftStart.store(windowStart, std::memory_order_relaxed);
+      fShiftEnd.store(windowEnd, std::memory_order_relaxed);
+      // The recorder saw ICY titles when they arrived; they apply now.
+      BString packet;
+      if (timeShift.IcyMetadataAt(offset, packet) &&
+          packet != fLastIcyPacket) {
+        fLastIcyPacket = packet;
+        _ParseIcyMeta(packet);
+      }
+    }
+
+    if (fetched) {
+      const double bytesPerSecond =
+          (double)fHlsFormat.frame_rate * channels * sizeof(float);
+      bigtime_t ahead = (bigtime_t)(HlsBufferedBytes(
+          fTotalWritten.load(std::memory_order_acquire),
+          fReadPos.load(std::memory_order_relaxed)) / bytesPerSecond * 1e6);
+      // The fetcher picks the variant by how much audio is left to play.
+      fetchedInput.Fetcher().SetBufferedAhead(ahead);
+      // Timed metadata of a segment the demuxer just entered is heard once
+      // the PCM buffered ahead of it has played.
+      if (fetchedInput.Fetcher().TakeSegmentHead(segmentHead))
+        _QueueHlsSegmentMetadata(segmentHead.data(), segmentHead.size(),
+                                 system_time() + ahead);
+    }
+
     _ProcessFfmpegMetadata(fmtCtx->metadata);
-    _PollFfmpegIcyMetadata(fmtCtx);
+    if (!shifted)
+      _PollFfmpegIcyMetadata(fmtCtx);
     if (pkt->stream_index >= 0 &&
         pkt->stream_index < (int)fmtCtx->nb_streams) {
       _ProcessFfmpegMetadata(fmtCtx->streams[pkt->stream_index]->metadata);
@@ -1629,13 +2393,44 @@ void NetworkAudioStreamIO::_FfmpegLoop() {
       continue;
     }
 
+    // Tee for the recorder: it takes a reference and writes on its thread.
+    fRecorder.Push(pkt, fDecodedTotal);
+
     ret = avcodec_send_packet(codecCtx, pkt);
     if (ret >= 0) {
       while (avcodec_receive_frame(codecCtx, frame) == 0) {
         if (!fRunning)
           break;
 
-        int outSamples = frame->nb_samples;
+        if (frame->sample_rate != swrInRate ||
+            frame->format != swrInFormat ||
+            (frame->ch_layout.nb_channels > 0 &&
+             av_channel_layout_compare(&frame->ch_layout, &swrInLayout) !=
+                 0)) {
+          // Keep the output in the format the player was told about.
+          DEBUG_PRINT("FFmpeg source format changed: rate=%d fmt=%s\n",
+                      frame->sample_rate,
+                      SampleFmtName((AVSampleFormat)frame->format));
+          swrInRate = frame->sample_rate;
+          swrInFormat = (AVSampleFormat)frame->format;
+          if (frame->ch_layout.nb_channels > 0) {
+            av_channel_layout_uninit(&swrInLayout);
+            av_channel_layout_copy(&swrInLayout, &frame->ch_layout);
+          }
+          swr_free(&swr);
+          if (swr_alloc_set_opts2(&swr, &outLayout, AV_SAMPLE_FMT_FLT,
+                                  (int)fHlsFormat.frame_rate, &swrInLayout,
+                                  swrInFormat, swrInRate, 0, nullptr) < 0 ||
+              swr_init(swr) < 0) {
+            DEBUG_PRINT("swr reinit failed\n");
+            decodeFailed = true;
+            break;
+          }
+        }
+
+        int outSamples = swr_get_out_samples(swr, frame->nb_samples);
+        if (outSamples <= 0)
+          continue;
         size_t outBytes = outSamples * channels * sizeof(float);
         uint8 *outBuf = new uint8[outBytes];
         uint8 *outPtr = outBuf;
@@ -1644,7 +2439,6 @@ void NetworkAudioStreamIO::_FfmpegLoop() {
             swr_convert(swr, (uint8_t **)&outPtr, outSamples,
                         (const uint8_t **)frame->extended_data,
                         frame->nb_samples);
-        (void)convertedSamples;
 #if 0
         lastSwrResult = convertedSamples;
 
@@ -1681,16 +2475,26 @@ void NetworkAudioStreamIO::_FfmpegLoop() {
           decodePeakSinceLog = 0.0f;
         }
 #else
-        Write(outBuf, outBytes);
+        if (convertedSamples > 0)
+          Write(outBuf, (size_t)convertedSamples * channels * sizeof(float));
 #endif
+        if (convertedSamples > 0) {
+          const bigtime_t duration = (bigtime_t)convertedSamples * 1000000 /
+                                     (bigtime_t)fHlsFormat.frame_rate;
+          decodedTime += duration;
+          fDecodedTotal += duration;
+        }
 
         delete[] outBuf;
       }
     }
     av_packet_unref(pkt);
+    if (decodeFailed)
+      break;
   }
 
-  if (fRunning) {
+  av_channel_layout_uninit(&swrInLayout);
+  if (fRunning && swr != nullptr) {
     avcodec_send_packet(codecCtx, nullptr);
     while (avcodec_receive_frame(codecCtx, frame) == 0) {
       int outSamples = frame->nb_samples;
@@ -1716,6 +2520,10 @@ void NetworkAudioStreamIO::_FfmpegLoop() {
     }
   }
 
+  // The stream is over, and with it the recording.
+  fRecorder.Stop();
+  fRecordRequest.store(kRecordStop, std::memory_order_relaxed);
+
   av_frame_free(&frame);
   av_packet_free(&pkt);
   swr_free(&swr);
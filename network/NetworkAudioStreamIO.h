@@ -2,6 +2,7 @@
 #define BETON_NETWORK_AUDIO_STREAM_IO_H
 
 #include <DataIO.h>
+#include <Locker.h>
 #include <MediaFile.h>
 #include <MediaTrack.h>
 #include <Messenger.h>
@@ -12,6 +13,9 @@
 
 #include <UrlContext.h>
 
+#include "MemoryStats.h"
+#include "StreamRecorder.h"
+
 struct AVDictionary;
 
 /**
@@ -21,6 +25,14 @@ struct AVDictionary;
  * FFmpeg opens HTTP/HTTPS, ICY/Icecast and HLS streams, decodes them to float
  * PCM, and writes the audio into the ring buffer. BSoundPlayer reads PCM
  * directly through ReadPcm().
+ *
+ * With a time-shift window set, live streams are recorded into a
+ * TimeShiftBuffer on disk and decoded from there: a paused stream keeps
+ * recording and resumes where it stopped, and SeekToTime() moves inside
+ * the recorded window.
+ *
+ * StartRecording() tees the demuxed packets into a StreamRecorder, which
+ * writes them to disk without decoding, one file per stream title.
  */
 class NetworkAudioStreamIO : public BPositionIO {
 public:
@@ -57,14 +69,61 @@ public:
 
     /**
      * @brief Requests a seek to absolute media time.
+     *
+     * For DLNA files and time-shifted live streams; a live stream's time
+     * counts from when it was opened and is clamped to the recorded window.
      * @param position Target position in microseconds.
      * @return B_OK if seek request was accepted.
      */
     status_t SeekToTime(bigtime_t position);
 
+    /** @name Time-Shifting */
+    ///@{
+    /// Ring bytes per second of window; enough for 320 kbit/s streams.
+    static const size_t kTimeShiftBytesPerSecond = 40 * 1000;
+
+    /**
+     * @brief Length of live stream kept to pause and seek back in; 0 turns
+     * time-shifting off. Applies to streams opened afterwards.
+     */
+    static void      SetTimeShiftWindow(bigtime_t window);
+    static bigtime_t TimeShiftWindow();
+
+    bool      IsTimeShifted() const {
+        return fShiftEnd.load(std::memory_order_relaxed) >= 0;
+    }
+    /** @brief Oldest stream time still recorded. */
+    bigtime_t TimeShiftStart() const {
+        return fShiftStart.load(std::memory_order_relaxed);
+    }
+    /** @brief Stream time of the newest recorded byte, the live edge. */
+    bigtime_t TimeShiftEnd() const {
+        return fShiftEnd.load(std::memory_order_relaxed);
+    }
+    ///@}
+
+    /** @name Recording */
+    ///@{
+    /**
+     * @brief Records the stream into `directory` from now on, one file per
+     * title; `station` names untitled files. Taken up by the stream thread
+     * once the codec is known.
+     */
+    void StartRecording(const BString& directory, const BString& station);
+    /** @brief Finishes the file being recorded. */
+    void StopRecording();
+    bool IsRecording() const {
+        return fRecordRequest.load(std::memory_order_relaxed) == kRecordStart;
+    }
+    ///@}
+
     bool     IsRunning() const { return fRunning; }
     bool     IsRequestRunning() const { return fRequestRunning; }
     Mode     GetMode() const { return fMode; }
+    /** @brief PCM bytes the decoder thread produced since Open(). */
+    off_t    DecodedBytes() const {
+        return fTotalWritten.load(std::memory_order_acquire);
+    }
 
     /** Legacy compatibility; FFmpeg streams should use WaitForFormat(). */
     status_t WaitForData(size_t minBytes, bigtime_t timeoutUs) const;
@@ -102,7 +161,8 @@ private:
     void _ParseIcyMeta(const BString& raw);
     void _NotifyMetadata(const BString& title, const BString& url);
     void _NotifyMetadata(const BString& artist, const BString& title,
-                         const BString& album, const BString& url);
+                         const BString& album, const BString& url,
+                         bigtime_t heardAt = -1);
     ///@}
 
     /** @name FFmpeg Stream Logic */
@@ -113,20 +173,43 @@ private:
     void _ProcessHlsTimedMetadata(const uint8* data, size_t size);
     void _PollFfmpegIcyMetadata(void* formatContext);
     void _PollHlsPlaylistMetadata();
-    void _QueueHlsSegmentMetadata(const uint8* data, size_t size);
+    void _QueueHlsSegmentMetadata(const uint8* data, size_t size,
+                                  bigtime_t startTime);
     void _DispatchDueHlsMetadata();
     static int _FfmpegInterruptCallback(void* arg);
     ///@}
 
-    /** @name Ring Buffer */
+    /** @name Ring Buffer
+     * Single producer (FFmpeg thread), single consumer. Each side raises
+     * its waiting flag before sleeping on its semaphore, and the other
+     * side releases the semaphore only when it sees the flag, so nobody
+     * polls and a wakeup comes exactly when data or space appears.
+     */
     ///@{
-    static const size_t kBufferCapacity = 4 * 1024 * 1024; ///< 4 MB
+    /// Capacities per mode, in bytes; 48 kHz stereo float is 375 KB/s.
+    static const size_t kIcyCapacity = 2 * 1024 * 1024;   ///< ~5 s, live
+    static const size_t kDlnaCapacity = 8 * 1024 * 1024;  ///< ~20 s
+    static const size_t kHlsCapacity = 16 * 1024 * 1024;  ///< Several segments
+    /// Read bytes kept behind the reader, so Seek() can step back a little.
+    static const size_t kHistoryBytes = 256 * 1024;
+
+    static size_t _CapacityFor(Mode mode);
+    size_t   _Space() const;
+    bool     _WaitForData(off_t readPos, bigtime_t timeout) const;
+    void     _WakeReader();
+    void     _WakeWriter();
+
     uint8*   fBuffer;
+    size_t   fCapacity;
+    MemoryAccount fMemory; ///< Accounts fBuffer
     std::atomic<off_t>   fWritePos;
     std::atomic<off_t>   fTotalWritten;
     std::atomic<off_t>   fReadPos;
     std::atomic<off_t>   fValidStart;
-    sem_id   fDataReady;
+    mutable std::atomic<bool> fReaderWaiting;
+    std::atomic<bool>    fWriterWaiting;
+    sem_id   fDataReady;  ///< Released by the writer for a waiting reader
+    sem_id   fSpaceReady; ///< Released by the reader for a waiting writer
     ///@}
 
     /** @name State */
@@ -163,11 +246,29 @@ private:
     sem_id                  fHlsFormatReady;  ///< Signaled when format known
     bool                    fHlsFormatKnown;  ///< True after decoder setup
     bigtime_t               fLastHlsMetadataPoll;
-    std::atomic<bigtime_t>  fLastPcmReadDebugLog;
     std::atomic<bigtime_t>  fFfmpegReadDeadline;
     std::atomic<bigtime_t>  fPendingSeekTime;
+    std::atomic<bigtime_t>  fShiftStart;  ///< -1 unless time-shifted
+    std::atomic<bigtime_t>  fShiftEnd;    ///< -1 unless time-shifted
     std::vector<HlsTimedMetadataEvent> fPendingHlsMetadata;
     ///@}
+
+    /** @name Recording State */
+    ///@{
+    enum { kRecordStop, kRecordStart };
+
+    void _UpdateRecording(const AVCodecParameters* codec,
+                          const AVRational& timeBase);
+    bigtime_t _BufferedTime() const;
+
+    StreamRecorder          fRecorder;       ///< Stream thread only
+    std::atomic<int32>      fRecordRequest;  ///< kRecordStop or kRecordStart
+    BLocker                 fRecordLock;     ///< Guards the two below
+    BString                 fRecordDirectory;
+    BString                 fRecordStation;
+    /// Audio decoded since Open(), never rewound; the recorder's clock.
+    bigtime_t               fDecodedTotal;
+    ///@}
 };
 
 #endif // BETON_NETWORK_AUDIO_STREAM_IO_H
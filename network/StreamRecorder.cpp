@@ -0,0 +1,376 @@
+#include "StreamRecorder.h"
+#include "Debug.h"
+#include "Messages.h"
+
+#include <Autolock.h>
+#include <Directory.h>
+#include <Entry.h>
+#include <Message.h>
+
+#include <algorithm>
+#include <ctime>
+#include <iterator>
+#include <utility>
+
+extern "C" {
+#include <libavcodec/avcodec.h>
+#include <libavformat/avformat.h>
+#include <libavutil/dict.h>
+#include <libavutil/mathematics.h>
+}
+
+/** @brief How often the writer looks for packets past the holdback. */
+static const bigtime_t kWriteInterval = 500000;
+/** @brief Longest file name, in characters, without the extension. */
+static const int32 kMaxNameChars = 120;
+
+namespace {
+
+struct RecordFormat {
+  AVCodecID codec;
+  const char *muxer;
+  const char *extension;
+};
+
+/// Containers that take the codec as it comes off the stream.
+const RecordFormat kRecordFormats[] = {
+    {AV_CODEC_ID_MP3, "mp3", "mp3"},
+    {AV_CODEC_ID_AAC, "ipod", "m4a"},
+    {AV_CODEC_ID_VORBIS, "ogg", "ogg"},
+    {AV_CODEC_ID_OPUS, "opus", "opus"},
+    {AV_CODEC_ID_FLAC, "flac", "flac"},
+};
+
+/** @brief `name` made usable as a file name. */
+BString FileName(BString name) {
+  name.ReplaceAll('/', '-');
+  name.Trim();
+  while (name.StartsWith("."))
+    name.Remove(0, 1);
+  name.TruncateChars(kMaxNameChars);
+  name.Trim();
+  return name;
+}
+
+} // namespace
+
+StreamRecorder::StreamRecorder(BMessenger target) : fTarget(target) {}
+
+StreamRecorder::~StreamRecorder() { Stop(); }
+
+status_t StreamRecorder::Start(const BString &directory,
+                               const BString &station,
+                               const BString &streamUrl,
+                               const AVCodecParameters *codec,
+                               const AVRational &timeBase) {
+  Stop();
+  if (codec == nullptr || timeBase.num <= 0 || timeBase.den <= 0)
+    return B_BAD_VALUE;
+
+  fCodec = avcodec_parameters_alloc();
+  if (fCodec == nullptr || avcodec_parameters_copy(fCodec, codec) < 0) {
+    avcodec_parameters_free(&fCodec);
+    return B_NO_MEMORY;
+  }
+  fTimeBaseNum = timeBase.num;
+  fTimeBaseDen = timeBase.den;
+  // Packets without a duration last one codec frame.
+  fLastDuration = 1;
+  if (codec->frame_size > 0 && codec->sample_rate > 0) {
+    fLastDuration = std::max<int64>(
+        1, av_rescale_q(codec->frame_size, AVRational{1, codec->sample_rate},
+                        timeBase));
+  }
+  fDirectory = directory;
+  fStation = station;
+  fStreamUrl = streamUrl;
+  fArtist = fTitle = fAlbum = "";
+
+  if (create_directory(fDirectory.String(), 0755) != B_OK) {
+    DEBUG_PRINT("StreamRecorder: cannot create %s\n", fDirectory.String());
+    avcodec_parameters_free(&fCodec);
+    return B_ERROR;
+  }
+
+  {
+    BAutolock lock(fLock);
+    fNewest = 0;
+    fStopping = false;
+  }
+  fWork = create_sem(0, "stream record work");
+  if (fWork < 0) {
+    avcodec_parameters_free(&fCodec);
+    return fWork;
+  }
+  fThread =
+      spawn_thread(_WriterEntry, "stream_record", B_LOW_PRIORITY, this);
+  if (fThread < 0) {
+    status_t status = fThread;
+    delete_sem(fWork);
+    fWork = -1;
+    avcodec_parameters_free(&fCodec);
+    return status;
+  }
+  resume_thread(fThread);
+  DEBUG_PRINT("StreamRecorder: recording %s into %s\n", streamUrl.String(),
+              directory.String());
+  return B_OK;
+}
+
+void StreamRecorder::Stop() {
+  if (fThread < 0)
+    return;
+
+  {
+    BAutolock lock(fLock);
+    fStopping = true;
+  }
+  release_sem(fWork);
+  status_t exitValue;
+  wait_for_thread(fThread, &exitValue);
+  fThread = -1;
+  delete_sem(fWork);
+  fWork = -1;
+
+  _ClearQueue();
+  avcodec_parameters_free(&fCodec);
+}
+
+void StreamRecorder::Push(const AVPacket *packet, bigtime_t time) {
+  if (fThread < 0 || packet == nullptr)
+    return;
+
+  // A reference to the packet's buffer, not a copy of the data.
+  AVPacket *copy = av_packet_clone(packet);
+  if (copy == nullptr)
+    return;
+  BAutolock lock(fLock);
+  fQueue.push_back({copy, time, BString(), BString(), BString()});
+  fNewest = std::max(fNewest, time);
+}
+
+void StreamRecorder::Split(const BString &artist, const BString &title,
+                           const BString &album, bigtime_t time) {
+  if (fThread < 0)
+    return;
+
+  Item split = {nullptr, time, artist, title, album};
+  if (artist.IsEmpty()) {
+    int32 dash = title.FindFirst(" - ");
+    if (dash > 0) {
+      title.CopyInto(split.artist, 0, dash);
+      title.CopyInto(split.title, dash + 3, title.Length() - dash - 3);
+    }
+  }
+
+  // Packets at or after `time` belong to the new title.
+  BAutolock lock(fLock);
+  auto it = fQueue.end();
+  while (it != fQueue.begin() && std::prev(it)->time >= time)
+    --it;
+  fQueue.insert(it, std::move(split));
+}
+
+int32 StreamRecorder::_WriterEntry(void *arg) {
+  static_cast<StreamRecorder *>(arg)->_Write();
+  return 0;
+}
+
+void StreamRecorder::_Write() {
+  for (;;) {
+    Item item;
+    bool have = false;
+    bool stopping;
+    {
+      BAutolock lock(fLock);
+      stopping = fStopping;
+      if (!fQueue.empty() &&
+          (stopping || fQueue.front().time <= fNewest - kHoldback)) {
+        item = std::move(fQueue.front());
+        fQueue.pop_front();
+        have = true;
+      }
+    }
+
+    if (!have) {
+      if (stopping)
+        break;
+      acquire_sem_etc(fWork, 1, B_RELATIVE_TIMEOUT, kWriteInterval);
+      continue;
+    }
+
+    if (item.packet == nullptr) {
+      // The next packet opens the file of the new title; a file without
+      // audio is dropped.
+      _CloseFile();
+      fArtist = item.artist;
+      fTitle = item.title;
+      fAlbum = item.album;
+      fOpenFailed = false;
+      continue;
+    }
+
+    if (fOutput == nullptr && !fOpenFailed)
+      fOpenFailed = !_OpenFile();
+    if (fOutput != nullptr)
+      _WritePacket(item.packet);
+    av_packet_free(&item.packet);
+  }
+
+  _CloseFile();
+}
+
+void StreamRecorder::_WritePacket(AVPacket *packet) {
+  AVStream *stream = fOutput->streams[0];
+  // Live timestamps jump at reconnects and discontinuities; the file gets
+  // its own, counted from zero.
+  const int64 duration =
+      packet->duration > 0 ? packet->duration : fLastDuration;
+  packet->pts = packet->dts = fNextTimestamp;
+  packet->duration = duration;
+  packet->stream_index = 0;
+  packet->pos = -1;
+  fNextTimestamp += duration;
+  fLastDuration = duration;
+  av_packet_rescale_ts(packet, AVRational{fTimeBaseNum, fTimeBaseDen},
+                       stream->time_base);
+
+  int ret = av_write_frame(fOutput, packet);
+  if (ret < 0) {
+    DEBUG_PRINT("StreamRecorder: writing a packet failed (%d)\n", ret);
+    return;
+  }
+  fPackets++;
+}
+
+/**
+ * @brief Opens a hidden file for the current title, in the container for
+ * the stream's codec, with the title's tags.
+ */
+bool StreamRecorder::_OpenFile() {
+  const char *muxer = "matroska";
+  fExtension = "mka";
+  for (const RecordFormat &format : kRecordFormats) {
+    if (format.codec == fCodec->codec_id) {
+      muxer = format.muxer;
+      fExtension = format.extension;
+      break;
+    }
+  }
+
+  fPartPath.SetToFormat("%s/.recording-%lld.%s", fDirectory.String(),
+                        (long long)system_time(), fExtension);
+  if (avformat_alloc_output_context2(&fOutput, nullptr, muxer,
+                                     fPartPath.String()) < 0 ||
+      fOutput == nullptr) {
+    DEBUG_PRINT("StreamRecorder: no %s muxer\n", muxer);
+    fOutput = nullptr;
+    return false;
+  }
+
+  AVStream *stream = avformat_new_stream(fOutput, nullptr);
+  if (stream == nullptr ||
+      avcodec_parameters_copy(stream->codecpar, fCodec) < 0) {
+    avformat_free_context(fOutput);
+    fOutput = nullptr;
+    return false;
+  }
+  stream->codecpar->codec_tag = 0;
+  stream->time_base = AVRational{fTimeBaseNum, fTimeBaseDen};
+
+  if (!fTitle.IsEmpty())
+    av_dict_set(&fOutput->metadata, "title", fTitle.String(), 0);
+  if (!fArtist.IsEmpty())
+    av_dict_set(&fOutput->metadata, "artist", fArtist.String(), 0);
+  const BString &album = fAlbum.IsEmpty() ? fStation : fAlbum;
+  if (!album.IsEmpty())
+    av_dict_set(&fOutput->metadata, "album", album.String(), 0);
+  av_dict_set(&fOutput->metadata, "comment", fStreamUrl.String(), 0);
+
+  if (avio_open(&fOutput->pb, fPartPath.String(), AVIO_FLAG_WRITE) < 0) {
+    DEBUG_PRINT("StreamRecorder: cannot create %s\n", fPartPath.String());
+    avformat_free_context(fOutput);
+    fOutput = nullptr;
+    return false;
+  }
+  int ret = avformat_write_header(fOutput, nullptr);
+  if (ret < 0) {
+    DEBUG_PRINT("StreamRecorder: %s refused the stream (%d)\n", muxer, ret);
+    avio_closep(&fOutput->pb);
+    avformat_free_context(fOutput);
+    fOutput = nullptr;
+    BEntry(fPartPath.String()).Remove();
+    return false;
+  }
+
+  fNextTimestamp = 0;
+  fPackets = 0;
+  return true;
+}
+
+/** @brief Finishes the file and moves it to its final name. */
+void StreamRecorder::_CloseFile() {
+  if (fOutput == nullptr)
+    return;
+
+  av_write_trailer(fOutput);
+  avio_closep(&fOutput->pb);
+  avformat_free_context(fOutput);
+  fOutput = nullptr;
+
+  BEntry entry(fPartPath.String());
+  if (fPackets == 0) {
+    entry.Remove();
+    return;
+  }
+  fPackets = 0;
+
+  BString path = _FinalPath(fExtension);
+  if (entry.Rename(path.String()) != B_OK) {
+    DEBUG_PRINT("StreamRecorder: cannot move %s to %s\n", fPartPath.String(),
+                path.String());
+    return;
+  }
+  DEBUG_PRINT("StreamRecorder: saved %s\n", path.String());
+
+  BMessage saved(MSG_RADIO_RECORDING_SAVED);
+  saved.AddString("path", path);
+  fTarget.SendMessage(&saved);
+}
+
+/**
+ * @brief Unused path for the current title: "Artist - Title", or the
+ * station and the time when the stream names no title.
+ */
+BString StreamRecorder::_FinalPath(const char *extension) const {
+  BString name;
+  if (!fArtist.IsEmpty() && !fTitle.IsEmpty())
+    name << fArtist << " - " << fTitle;
+  else if (!fTitle.IsEmpty())
+    name = fTitle;
+  name = FileName(name);
+  if (name.IsEmpty()) {
+    char date[32];
+    time_t now = time(nullptr);
+    strftime(date, sizeof(date), "%Y-%m-%d %H.%M", localtime(&now));
+    name = FileName(fStation);
+    if (!name.IsEmpty())
+      name << " ";
+    name << date;
+  }
+
+  BString path;
+  path.SetToFormat("%s/%s.%s", fDirectory.String(), name.String(), extension);
+  for (int32 copy = 2; BEntry(path.String()).Exists(); copy++) {
+    path.SetToFormat("%s/%s (%ld).%s", fDirectory.String(), name.String(),
+                     (long)copy, extension);
+  }
+  return path;
+}
+
+void StreamRecorder::_ClearQueue() {
+  BAutolock lock(fLock);
+  for (Item &item : fQueue)
+    av_packet_free(&item.packet);
+  fQueue.clear();
+}
@@ -0,0 +1,108 @@
+#ifndef BETON_STREAM_RECORDER_H
+#define BETON_STREAM_RECORDER_H
+
+#include <Locker.h>
+#include <Messenger.h>
+#include <OS.h>
+#include <String.h>
+#include <SupportDefs.h>
+#include <deque>
+
+struct AVCodecParameters;
+struct AVFormatContext;
+struct AVPacket;
+struct AVRational;
+
+/**
+ * @class StreamRecorder
+ * @brief Writes the compressed packets of a live stream to disk, one file
+ * per title, without decoding them.
+ *
+ * The stream thread hands over each demuxed packet with Push(), which only
+ * takes a reference; a low-priority thread remuxes them into a file of the
+ * stream's own codec (MP3, AAC in M4A, Ogg, Opus, FLAC, else Matroska).
+ * Split() starts a new file at a title change, with the title's tags in
+ * it. The file is written under a hidden name and moved to its final name
+ * when closed, so the library watcher only ever sees finished files.
+ *
+ * Times are stream times in the caller's clock. Packets are held back
+ * kHoldback behind the newest one, so a title change that is only known
+ * once its audio is heard still splits at the right packet.
+ *
+ * Each finished file is announced with MSG_RADIO_RECORDING_SAVED ("path").
+ */
+class StreamRecorder {
+public:
+  /// How far a split may lie behind the newest packet.
+  static const bigtime_t kHoldback = 60000000;
+
+  explicit StreamRecorder(BMessenger target);
+  ~StreamRecorder();
+
+  /**
+   * @brief Starts recording packets of a stream with `codec` and
+   * `timeBase` into `directory`.
+   * @param station Names files that have no title; album of every file.
+   */
+  status_t Start(const BString &directory, const BString &station,
+                 const BString &streamUrl, const AVCodecParameters *codec,
+                 const AVRational &timeBase);
+  /** @brief Writes the packets still held and closes the file. */
+  void Stop();
+  bool IsRecording() const { return fThread >= 0; }
+
+  /** @brief Records `packet`, which plays at `time`; does not block. */
+  void Push(const AVPacket *packet, bigtime_t time);
+  /**
+   * @brief Starts a new file at `time` for the given title. Without
+   * `artist`, a "Artist - Title" `title` is split into both.
+   */
+  void Split(const BString &artist, const BString &title,
+             const BString &album, bigtime_t time);
+
+private:
+  struct Item {
+    AVPacket *packet; ///< nullptr for a split
+    bigtime_t time;
+    BString artist;
+    BString title;
+    BString album;
+  };
+
+  static int32 _WriterEntry(void *arg);
+  void _Write();
+  void _WritePacket(AVPacket *packet);
+  bool _OpenFile();
+  void _CloseFile();
+  BString _FinalPath(const char *extension) const;
+  void _ClearQueue();
+
+  BMessenger fTarget;
+  thread_id fThread = -1;
+  sem_id fWork = -1;
+
+  BLocker fLock{"stream recorder"}; ///< Guards the fields below
+  std::deque<Item> fQueue;          ///< By time
+  bigtime_t fNewest = 0;
+  bool fStopping = false;
+
+  // Writer thread only.
+  BString fDirectory;
+  BString fStation;
+  BString fStreamUrl;
+  AVCodecParameters *fCodec = nullptr;
+  int fTimeBaseNum = 1;
+  int fTimeBaseDen = 1;
+  BString fArtist;
+  BString fTitle;
+  BString fAlbum;
+  AVFormatContext *fOutput = nullptr;
+  BString fPartPath;
+  const char *fExtension = "";
+  int64 fNextTimestamp = 0;
+  int64 fLastDuration = 0;
+  int64 fPackets = 0;
+  bool fOpenFailed = false; ///< Until the next title
+};
+
+#endif // BETON_STREAM_RECORDER_H
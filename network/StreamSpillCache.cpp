@@ -0,0 +1,197 @@
+#include "StreamSpillCache.h"
+#include "Debug.h"
+
+#include <Directory.h>
+#include <Entry.h>
+#include <FindDirectory.h>
+#include <Path.h>
+
+#include <algorithm>
+#include <sys/stat.h>
+
+static const uint32 kIndexMagic = 'BSsc';
+static const uint32 kIndexVersion = 1;
+
+/** @brief Directory of the spill cache in the user cache directory. */
+static BString CacheDirectory() {
+  BPath path;
+  find_directory(B_USER_CACHE_DIRECTORY, &path);
+  path.Append("BeTon/streams");
+  return BString(path.Path());
+}
+
+StreamSpillCache::StreamSpillCache() : fSize(0), fSlotCount(0), fDirty(false) {}
+
+StreamSpillCache::~StreamSpillCache() { Close(); }
+
+status_t StreamSpillCache::SetTo(const BString &url, off_t size) {
+  Close();
+  if (size <= 0 || size > kMaxCacheBytes)
+    return B_BAD_VALUE;
+
+  // 64-bit FNV-1a
+  uint64 hash = 14695981039346656037ULL;
+  for (int32 i = 0; i < url.Length(); i++) {
+    hash ^= (uint8)url.ByteAt(i);
+    hash *= 1099511628211ULL;
+  }
+  BString directory = CacheDirectory();
+  create_directory(directory.String(), 0755);
+  fPath.SetToFormat("%s/%016llx-%lld", directory.String(),
+                    (unsigned long long)hash, (long long)size);
+  fSize = size;
+
+  const int64 blocks = (size + kBlockSize - 1) / kBlockSize;
+  if (!_LoadIndex()) {
+    fSlots.assign((size_t)blocks, -1);
+    fSlotCount = 0;
+    _Trim(fPath, size);
+  }
+
+  BString dataPath(fPath);
+  dataPath << ".data";
+  status_t status = fData.SetTo(dataPath.String(),
+                                B_READ_WRITE | B_CREATE_FILE);
+  if (status != B_OK) {
+    DEBUG_PRINT("spill cache: cannot open %s\n", dataPath.String());
+    fPath = "";
+    fSize = 0;
+    fSlots.clear();
+    return status;
+  }
+  DEBUG_PRINT("spill cache: %ld of %lld blocks cached for %s\n",
+              (long)fSlotCount, (long long)blocks, url.String());
+  return B_OK;
+}
+
+void StreamSpillCache::Close() {
+  if (fPath.IsEmpty())
+    return;
+  _SaveIndex();
+  fData.Unset();
+  fPath = "";
+  fSize = 0;
+  fSlots.clear();
+  fSlotCount = 0;
+}
+
+size_t StreamSpillCache::BlockLength(int64 block) const {
+  off_t start = block * (off_t)kBlockSize;
+  if (block < 0 || start >= fSize)
+    return 0;
+  return (size_t)std::min<off_t>(kBlockSize, fSize - start);
+}
+
+bool StreamSpillCache::HasBlock(int64 block) const {
+  return block >= 0 && block < (int64)fSlots.size() && fSlots[block] >= 0;
+}
+
+ssize_t StreamSpillCache::ReadBlock(int64 block, size_t offset, void *buffer,
+                                    size_t size) {
+  if (!HasBlock(block) || offset >= BlockLength(block))
+    return B_BAD_VALUE;
+  size = std::min(size, BlockLength(block) - offset);
+  return fData.ReadAt((off_t)fSlots[block] * kBlockSize + offset, buffer,
+                      size);
+}
+
+status_t StreamSpillCache::WriteBlock(int64 block, const void *data) {
+  if (block < 0 || block >= (int64)fSlots.size())
+    return B_BAD_VALUE;
+  if (fSlots[block] >= 0)
+    return B_OK;
+  const size_t length = BlockLength(block);
+  ssize_t written = fData.WriteAt((off_t)fSlotCount * kBlockSize, data,
+                                  length);
+  if (written != (ssize_t)length)
+    return written < 0 ? (status_t)written : B_IO_ERROR;
+  fSlots[block] = fSlotCount++;
+  fDirty = true;
+  return B_OK;
+}
+
+bool StreamSpillCache::_LoadIndex() {
+  BString indexPath(fPath);
+  indexPath << ".index";
+  BFile file(indexPath.String(), B_READ_ONLY);
+  uint32 header[3];
+  const int64 blocks = (fSize + kBlockSize - 1) / kBlockSize;
+  if (file.InitCheck() != B_OK ||
+      file.Read(header, sizeof(header)) != (ssize_t)sizeof(header) ||
+      header[0] != kIndexMagic || header[1] != kIndexVersion ||
+      header[2] != (uint32)blocks)
+    return false;
+
+  fSlots.resize((size_t)blocks);
+  ssize_t bytes = (ssize_t)(fSlots.size() * sizeof(int32));
+  if (file.Read(fSlots.data(), bytes) != bytes) {
+    fSlots.clear();
+    return false;
+  }
+  fSlotCount = 0;
+  for (int32 slot : fSlots)
+    fSlotCount = std::max(fSlotCount, slot + 1);
+  return true;
+}
+
+void StreamSpillCache::_SaveIndex() {
+  if (!fDirty)
+    return;
+  fDirty = false;
+
+  BString indexPath(fPath);
+  indexPath << ".index";
+  BFile file(indexPath.String(), B_WRITE_ONLY | B_CREATE_FILE | B_ERASE_FILE);
+  uint32 header[3] = {kIndexMagic, kIndexVersion, (uint32)fSlots.size()};
+  ssize_t bytes = (ssize_t)(fSlots.size() * sizeof(int32));
+  if (file.InitCheck() != B_OK ||
+      file.Write(header, sizeof(header)) != (ssize_t)sizeof(header) ||
+      file.Write(fSlots.data(), bytes) != bytes)
+    DEBUG_PRINT("spill cache: could not write %s\n", indexPath.String());
+}
+
+/**
+ * @brief Removes the least recently used entries other than `keep` until
+ * `needed` more bytes fit in kMaxCacheBytes.
+ */
+void StreamSpillCache::_Trim(const BString &keep, off_t needed) {
+  BDirectory directory(CacheDirectory().String());
+  if (directory.InitCheck() != B_OK)
+    return;
+
+  struct Entry {
+    time_t used;
+    BString base;
+    off_t size;
+  };
+  std::vector<Entry> entries;
+  off_t total = 0;
+  BEntry entry;
+  while (directory.GetNextEntry(&entry) == B_OK) {
+    BPath path;
+    struct stat st;
+    if (entry.GetPath(&path) != B_OK || entry.GetStat(&st) != B_OK)
+      continue;
+    total += st.st_size;
+    BString base(path.Path());
+    if (!base.EndsWith(".data"))
+      continue;
+    base.Truncate(base.Length() - 5);
+    if (base != keep)
+      entries.push_back(Entry{st.st_mtime, base, st.st_size});
+  }
+
+  std::sort(entries.begin(), entries.end(),
+            [](const Entry &a, const Entry &b) { return a.used < b.used; });
+  for (const Entry &victim : entries) {
+    if (total + needed <= kMaxCacheBytes)
+      break;
+    BString dataPath(victim.base), indexPath(victim.base);
+    dataPath << ".data";
+    indexPath << ".index";
+    BEntry(dataPath.String()).Remove();
+    BEntry(indexPath.String()).Remove();
+    total -= victim.size;
+    DEBUG_PRINT("spill cache: dropped %s\n", dataPath.String());
+  }
+}
@@ -0,0 +1,60 @@
+#ifndef BETON_STREAM_SPILL_CACHE_H
+#define BETON_STREAM_SPILL_CACHE_H
+
+#include <File.h>
+#include <String.h>
+#include <SupportDefs.h>
+#include <vector>
+
+/**
+ * @class StreamSpillCache
+ * @brief On-disk copy of the parts of a remote file that were downloaded,
+ * so replaying or scrubbing it does not fetch them again.
+ *
+ * The remote file is split into kBlockSize blocks. Downloaded blocks are
+ * appended to a data file and an index maps each block to its slot there,
+ * so the data file never grows beyond what was fetched (BFS has no sparse
+ * files; writing at the offset of a late block would fill the gap). The
+ * index is saved on Close().
+ *
+ * Entries are keyed by URL and size and live in the user cache directory;
+ * the least recently used go once the cache exceeds kMaxCacheBytes. Not
+ * thread-safe; the stream thread owns its instance.
+ */
+class StreamSpillCache {
+public:
+  static const size_t kBlockSize = 256 * 1024;
+  static const off_t kMaxCacheBytes = 2048LL * 1024 * 1024;
+
+  StreamSpillCache();
+  ~StreamSpillCache();
+
+  /** @brief Opens or creates the entry for `url` of `size` bytes. */
+  status_t SetTo(const BString &url, off_t size);
+  /** @brief Saves the index and closes the entry. */
+  void Close();
+
+  off_t Size() const { return fSize; }
+  /** @brief Bytes in `block`; shorter than kBlockSize only for the last. */
+  size_t BlockLength(int64 block) const;
+  bool HasBlock(int64 block) const;
+
+  /** @brief Reads `size` bytes at `offset` into cached `block`. */
+  ssize_t ReadBlock(int64 block, size_t offset, void *buffer, size_t size);
+  /** @brief Stores the BlockLength() bytes of `block`. */
+  status_t WriteBlock(int64 block, const void *data);
+
+private:
+  bool _LoadIndex();
+  void _SaveIndex();
+  static void _Trim(const BString &keep, off_t needed);
+
+  BString fPath; ///< Entry path without the .data/.index suffix
+  BFile fData;
+  off_t fSize;
+  std::vector<int32> fSlots; ///< Slot in the data file per block, or -1
+  int32 fSlotCount;
+  bool fDirty;
+};
+
+#endif // BETON_STREAM_SPILL_CACHE_H
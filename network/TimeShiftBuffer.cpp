@@ -0,0 +1,168 @@
+#include "TimeShiftBuffer.h"
+#include "Debug.h"
+
+#include <Autolock.h>
+#include <Directory.h>
+#include <Entry.h>
+#include <FindDirectory.h>
+#include <Path.h>
+
+#include <algorithm>
+#include <atomic>
+#include <unistd.h>
+
+/** @brief Directory of the ring files in the user cache directory. */
+static BString RingDirectory() {
+  BPath path;
+  find_directory(B_USER_CACHE_DIRECTORY, &path);
+  path.Append("BeTon/timeshift");
+  return BString(path.Path());
+}
+
+TimeShiftBuffer::TimeShiftBuffer()
+    : fCapacity(0), fLock("TimeShiftBuffer"), fStart(0), fEnd(0),
+      fEnded(false), fReaderWaiting(false),
+      fDataReady(create_sem(0, "time shift data")) {}
+
+TimeShiftBuffer::~TimeShiftBuffer() {
+  Close();
+  delete_sem(fDataReady);
+}
+
+status_t TimeShiftBuffer::SetTo(size_t capacity) {
+  Close();
+  if (capacity == 0)
+    return B_BAD_VALUE;
+  if (fDataReady < 0)
+    return fDataReady;
+
+  static std::atomic<int32> sNextRing(0);
+  BString directory = RingDirectory();
+  create_directory(directory.String(), 0755);
+  fPath.SetToFormat("%s/ring-%ld-%ld", directory.String(),
+                    (long)getpid(), (long)sNextRing.fetch_add(1));
+  status_t status = fFile.SetTo(fPath.String(), B_READ_WRITE | B_CREATE_FILE |
+                                                    B_ERASE_FILE);
+  if (status != B_OK) {
+    DEBUG_PRINT("TimeShiftBuffer: cannot create %s\n", fPath.String());
+    fPath = "";
+    return status;
+  }
+
+  BAutolock lock(fLock);
+  fCapacity = capacity;
+  fStart = fEnd = 0;
+  fEnded = false;
+  return B_OK;
+}
+
+void TimeShiftBuffer::Close() {
+  {
+    BAutolock lock(fLock);
+    fEnded = true;
+    if (fReaderWaiting) {
+      fReaderWaiting = false;
+      release_sem(fDataReady);
+    }
+  }
+  fFile.Unset();
+  if (!fPath.IsEmpty()) {
+    BEntry(fPath.String()).Remove();
+    fPath = "";
+  }
+}
+
+status_t TimeShiftBuffer::Append(const void *data, size_t size) {
+  if (fFile.InitCheck() != B_OK)
+    return B_NO_INIT;
+
+  const uint8 *bytes = static_cast<const uint8 *>(data);
+  while (size > 0) {
+    off_t end;
+    size_t chunk;
+    {
+      // The bytes about to be overwritten leave the window first, so a
+      // reader that raced with the write notices and reads again.
+      BAutolock lock(fLock);
+      end = fEnd;
+      chunk = std::min(size, fCapacity - (size_t)(end % fCapacity));
+      fStart = std::max(fStart, end + (off_t)chunk - (off_t)fCapacity);
+    }
+
+    ssize_t written = fFile.WriteAt(end % fCapacity, bytes, chunk);
+    if (written < (ssize_t)chunk)
+      return written < 0 ? (status_t)written : B_IO_ERROR;
+
+    BAutolock lock(fLock);
+    fEnd = end + chunk;
+    if (fReaderWaiting) {
+      fReaderWaiting = false;
+      release_sem(fDataReady);
+    }
+    bytes += chunk;
+    size -= chunk;
+  }
+  return B_OK;
+}
+
+void TimeShiftBuffer::SetEnded() {
+  BAutolock lock(fLock);
+  fEnded = true;
+  if (fReaderWaiting) {
+    fReaderWaiting = false;
+    release_sem(fDataReady);
+  }
+}
+
+ssize_t TimeShiftBuffer::Read(off_t &position, void *buffer, size_t size,
+                              bigtime_t timeout) {
+  const bigtime_t deadline = system_time() + timeout;
+  for (;;) {
+    size_t chunk = 0;
+    {
+      BAutolock lock(fLock);
+      position = std::max(position, fStart);
+      if (position < fEnd) {
+        chunk = std::min((size_t)(fEnd - position), size);
+        chunk = std::min(chunk, fCapacity - (size_t)(position % fCapacity));
+      } else if (fEnded) {
+        return 0;
+      } else {
+        fReaderWaiting = true;
+      }
+    }
+
+    if (chunk == 0) {
+      bigtime_t left = deadline - system_time();
+      if (left <= 0 ||
+          acquire_sem_etc(fDataReady, 1, B_RELATIVE_TIMEOUT, left) ==
+              B_TIMED_OUT) {
+        BAutolock lock(fLock);
+        fReaderWaiting = false;
+        if (position >= fEnd && !fEnded)
+          return B_TIMED_OUT;
+      }
+      continue;
+    }
+
+    ssize_t read = fFile.ReadAt(position % fCapacity, buffer, chunk);
+    if (read < 0)
+      return read;
+
+    BAutolock lock(fLock);
+    if (position < fStart)
+      continue; // Overwritten while it was read
+    position += read;
+    return read;
+  }
+}
+
+off_t TimeShiftBuffer::Start() const {
+  BAutolock lock(fLock);
+  return fStart;
+}
+
+off_t TimeShiftBuffer::End() const {
+  BAutolock lock(fLock);
+  return fEnd;
+}
@@ -0,0 +1,64 @@
+#ifndef BETON_TIME_SHIFT_BUFFER_H
+#define BETON_TIME_SHIFT_BUFFER_H
+
+#include <File.h>
+#include <Locker.h>
+#include <OS.h>
+#include <String.h>
+#include <SupportDefs.h>
+
+/**
+ * @class TimeShiftBuffer
+ * @brief The last Capacity() bytes of a live stream, as it came off the
+ * network, in a ring on disk.
+ *
+ * A recorder thread appends while the stream plays or is paused; the
+ * demuxer reads behind it at its own pace, so pausing keeps the stream
+ * and seeking moves inside the recorded window. Offsets count from the
+ * start of the stream: [Start(), End()) is what the ring still holds.
+ * Storing the compressed bytes keeps a window of many minutes small.
+ *
+ * One writer and one reader may use it at the same time. The file lives in
+ * the user cache directory and is removed on Close().
+ */
+class TimeShiftBuffer {
+public:
+  TimeShiftBuffer();
+  ~TimeShiftBuffer();
+
+  /** @brief Creates the ring file for `capacity` bytes. */
+  status_t SetTo(size_t capacity);
+  /** @brief Removes the ring file; waiting reads return 0. */
+  void Close();
+
+  /** @brief Appends `size` bytes, dropping the oldest once full. */
+  status_t Append(const void *data, size_t size);
+  /** @brief No more bytes will come; reads at End() return 0. */
+  void SetEnded();
+
+  /**
+   * @brief Reads up to `size` bytes at `position` and advances it; a
+   * position the ring has dropped moves up to Start() first.
+   * @return Bytes read, 0 at the end of an ended stream, or B_TIMED_OUT if
+   * nothing arrived within `timeout`.
+   */
+  ssize_t Read(off_t &position, void *buffer, size_t size, bigtime_t timeout);
+
+  off_t Start() const;
+  off_t End() const;
+  size_t Capacity() const { return fCapacity; }
+
+private:
+  BFile fFile;
+  BString fPath;
+  size_t fCapacity;
+
+  mutable BLocker fLock; ///< Guards the fields below
+  off_t fStart;
+  off_t fEnd;
+  bool fEnded;
+  bool fReaderWaiting;
+  sem_id fDataReady;
+};
+
+#endif // BETON_TIME_SHIFT_BUFFER_H
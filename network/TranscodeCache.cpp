@@ -0,0 +1,709 @@
+#include "TranscodeCache.h"
+#include "Debug.h"
+
+#include <Autolock.h>
+#include <Directory.h>
+#include <Entry.h>
+#include <FindDirectory.h>
+
+#include <algorithm>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+#include <vector>
+
+extern "C" {
+#include <libavcodec/avcodec.h>
+#include <libavformat/avformat.h>
+#include <libavutil/audio_fifo.h>
+#include <libavutil/channel_layout.h>
+#include <libswresample/swresample.h>
+}
+
+/** @brief Rate and layout of every output. */
+static const int kOutputRate = 44100;
+static const int64 kMp3BitRate = 320000;
+
+namespace {
+
+/** @brief MIME types a renderer may list for a source codec. */
+struct CodecMimes {
+  AVCodecID codec;
+  const char *mimes[4];
+};
+
+const CodecMimes kCodecMimes[] = {
+    {AV_CODEC_ID_MP3, {"audio/mpeg", "audio/mp3", nullptr}},
+    {AV_CODEC_ID_FLAC, {"audio/flac", "audio/x-flac", nullptr}},
+    {AV_CODEC_ID_VORBIS, {"audio/ogg", "application/ogg", "audio/x-ogg"}},
+    {AV_CODEC_ID_OPUS, {"audio/ogg", "audio/opus", nullptr}},
+    {AV_CODEC_ID_AAC, {"audio/mp4", "audio/x-m4a", "audio/aac"}},
+    {AV_CODEC_ID_ALAC, {"audio/mp4", "audio/x-m4a", nullptr}},
+    {AV_CODEC_ID_PCM_S16LE, {"audio/wav", "audio/x-wav", "audio/wave"}},
+    {AV_CODEC_ID_PCM_S24LE, {"audio/wav", "audio/x-wav", "audio/wave"}},
+};
+
+/**
+ * @brief Whether `sink` ("http-get:*:audio/mpeg:*,...") lists `mime` or
+ * accepts anything.
+ */
+bool SinkAccepts(const BString &sink, const char *mime) {
+  int32 start = 0;
+  while (start < sink.Length()) {
+    int32 end = sink.FindFirst(',', start);
+    if (end < 0)
+      end = sink.Length();
+    BString entry;
+    sink.CopyInto(entry, start, end - start);
+    start = end + 1;
+
+    // protocol:network:contentFormat:additionalInfo
+    int32 first = entry.FindFirst(':');
+    int32 second = first >= 0 ? entry.FindFirst(':', first + 1) : -1;
+    int32 third = second >= 0 ? entry.FindFirst(':', second + 1) : -1;
+    if (third < 0)
+      continue;
+    BString format;
+    entry.CopyInto(format, second + 1, third - second - 1);
+    format.Trim();
+    int32 parameters = format.FindFirst(';');
+    if (parameters >= 0)
+      format.Truncate(parameters);
+    if (format == "*" || format.ICompare(mime) == 0)
+      return true;
+  }
+  return false;
+}
+
+/** @brief Frees the FFmpeg state of one transcode on every exit path. */
+struct TranscodeState {
+  AVFormatContext *input = nullptr;
+  AVCodecContext *decoder = nullptr;
+  AVCodecContext *encoder = nullptr;
+  AVFormatContext *output = nullptr;
+  SwrContext *resampler = nullptr;
+  AVAudioFifo *fifo = nullptr;
+  AVFrame *frame = nullptr;
+  AVFrame *converted = nullptr;
+  AVPacket *packet = nullptr;
+  int outputFD = -1;
+
+  ~TranscodeState() {
+    if (output != nullptr) {
+      if (output->pb != nullptr)
+        avio_closep(&output->pb);
+      avformat_free_context(output);
+    }
+    if (outputFD >= 0)
+      close(outputFD);
+    av_audio_fifo_free(fifo);
+    swr_free(&resampler);
+    av_frame_free(&frame);
+    av_frame_free(&converted);
+    av_packet_free(&packet);
+    avcodec_free_context(&encoder);
+    avcodec_free_context(&decoder);
+    avformat_close_input(&input);
+  }
+};
+
+} // namespace
+
+// ============================================================================
+// TranscodeCache::Job
+// ============================================================================
+
+TranscodeCache::Job::Job(const BString &source, Format format,
+                         const BString &outputPath)
+    : fSource(source), fFormat(format), fOutputPath(outputPath),
+      fProgress(create_sem(0, "transcode progress")) {
+  fPartPath = outputPath;
+  fPartPath << ".part";
+}
+
+TranscodeCache::Job::~Job() {
+  if (fReadFD >= 0)
+    close(fReadFD);
+  delete_sem(fProgress);
+}
+
+bool TranscodeCache::Job::IsComplete() const {
+  BAutolock lock(fLock);
+  return fDone && fStatus == B_OK;
+}
+
+bool TranscodeCache::Job::IsValid() const {
+  BAutolock lock(fLock);
+  return fStatus == B_OK;
+}
+
+BString TranscodeCache::Job::OutputPath() const {
+  BAutolock lock(fLock);
+  return fDone && fStatus == B_OK ? fOutputPath : BString();
+}
+
+ssize_t TranscodeCache::Job::ReadAt(off_t position, void *buffer, size_t size,
+                                    bigtime_t timeout) {
+  const bigtime_t deadline = system_time() + timeout;
+  for (;;) {
+    {
+      BAutolock lock(fLock);
+      if (position < fWritten) {
+        size = (size_t)std::min<off_t>(size, fWritten - position);
+        break;
+      }
+      if (fDone)
+        return fStatus == B_OK ? 0 : fStatus;
+      fWaiting++;
+    }
+    if (!_Wait(deadline))
+      return B_TIMED_OUT;
+  }
+
+  ssize_t bytesRead = pread(fReadFD, buffer, size, position);
+  return bytesRead < 0 ? (ssize_t)errno : bytesRead;
+}
+
+bool TranscodeCache::Job::WaitForCompletion(bigtime_t timeout) {
+  const bigtime_t deadline = system_time() + timeout;
+  for (;;) {
+    {
+      BAutolock lock(fLock);
+      if (fDone)
+        return fStatus == B_OK;
+      fWaiting++;
+    }
+    if (!_Wait(deadline))
+      return false;
+  }
+}
+
+/** @brief Waits for the next progress; false once `deadline` passed. */
+bool TranscodeCache::Job::_Wait(bigtime_t deadline) {
+  if (acquire_sem_etc(fProgress, 1, B_ABSOLUTE_TIMEOUT, deadline) == B_OK)
+    return true;
+  // The count taken for this waiter may still be released; a spare one
+  // only wakes the next waiter early, and it checks again.
+  BAutolock lock(fLock);
+  if (fWaiting > 0)
+    fWaiting--;
+  return false;
+}
+
+/** @brief Makes `written` bytes readable and wakes the readers. */
+void TranscodeCache::Job::_Published(off_t written) {
+  BAutolock lock(fLock);
+  fWritten = written;
+  if (fWaiting > 0) {
+    release_sem_etc(fProgress, fWaiting, 0);
+    fWaiting = 0;
+  }
+}
+
+status_t TranscodeCache::Job::_Start() {
+  if (fProgress < 0)
+    return fProgress;
+
+  int fd = open(fPartPath.String(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0)
+    return errno;
+  close(fd);
+  fReadFD = open(fPartPath.String(), O_RDONLY);
+  if (fReadFD < 0)
+    return errno;
+
+  fThread = spawn_thread(_ThreadEntry, "transcode", B_LOW_PRIORITY, this);
+  if (fThread < 0)
+    return fThread;
+  resume_thread(fThread);
+  return B_OK;
+}
+
+int32 TranscodeCache::Job::_ThreadEntry(void *data) {
+  static_cast<Job *>(data)->_Run();
+  return 0;
+}
+
+void TranscodeCache::Job::_Run() {
+  const bigtime_t start = system_time();
+  status_t status = _Transcode();
+  if (status == B_OK && fCancelled)
+    status = B_CANCELED;
+
+  off_t size = 0;
+  if (status == B_OK) {
+    BEntry part(fPartPath.String());
+    part.GetSize(&size);
+    status = part.Rename(fOutputPath.String(), true);
+  }
+  if (status != B_OK)
+    BEntry(fPartPath.String()).Remove();
+  DEBUG_PRINT("TranscodeCache: %s -> %s: %s after %lld ms\n", fSource.String(),
+              MimeType(fFormat), strerror(status),
+              (long long)((system_time() - start) / 1000));
+
+  {
+    BAutolock lock(fLock);
+    fDone = true;
+    fStatus = status;
+    if (fWaiting > 0) {
+      release_sem_etc(fProgress, fWaiting, 0);
+      fWaiting = 0;
+    }
+  }
+  // May release the last reference; nothing below touches the job.
+  TranscodeCache::Default()._Finished(this, status == B_OK ? size : 0);
+}
+
+/**
+ * @brief Decodes the source, resamples it to 44.1 kHz stereo and writes it
+ * in fFormat to fPartPath, publishing each write to the readers.
+ */
+status_t TranscodeCache::Job::_Transcode() {
+  TranscodeState s;
+
+  if (avformat_open_input(&s.input, fSource.String(), nullptr, nullptr) < 0 ||
+      avformat_find_stream_info(s.input, nullptr) < 0)
+    return B_BAD_DATA;
+
+  const AVCodec *decoderCodec = nullptr;
+  int streamIndex = av_find_best_stream(s.input, AVMEDIA_TYPE_AUDIO, -1, -1,
+                                        &decoderCodec, 0);
+  if (streamIndex < 0 || decoderCodec == nullptr)
+    return B_BAD_DATA;
+
+  s.decoder = avcodec_alloc_context3(decoderCodec);
+  if (s.decoder == nullptr ||
+      avcodec_parameters_to_context(
+          s.decoder, s.input->streams[streamIndex]->codecpar) < 0 ||
+      avcodec_open2(s.decoder, decoderCodec, nullptr) < 0)
+    return B_BAD_DATA;
+  if (s.decoder->ch_layout.nb_channels <= 0)
+    av_channel_layout_default(&s.decoder->ch_layout, 2);
+
+  const AVChannelLayout stereo = AV_CHANNEL_LAYOUT_STEREO;
+  const AVSampleFormat sampleFormat =
+      fFormat == kMp3 ? AV_SAMPLE_FMT_S16P : AV_SAMPLE_FMT_S16;
+  if (swr_alloc_set_opts2(&s.resampler, &stereo, sampleFormat, kOutputRate,
+                          &s.decoder->ch_layout, s.decoder->sample_fmt,
+                          s.decoder->sample_rate, 0, nullptr) < 0 ||
+      swr_init(s.resampler) < 0)
+    return B_ERROR;
+
+  if (fFormat == kMp3) {
+    const AVCodec *encoderCodec = avcodec_find_encoder(AV_CODEC_ID_MP3);
+    if (encoderCodec == nullptr)
+      return B_NOT_SUPPORTED;
+    s.encoder = avcodec_alloc_context3(encoderCodec);
+    if (s.encoder == nullptr)
+      return B_NO_MEMORY;
+    s.encoder->sample_fmt = sampleFormat;
+    s.encoder->sample_rate = kOutputRate;
+    av_channel_layout_copy(&s.encoder->ch_layout, &stereo);
+    s.encoder->bit_rate = kMp3BitRate;
+    s.encoder->time_base = AVRational{1, kOutputRate};
+    if (avcodec_open2(s.encoder, encoderCodec, nullptr) < 0)
+      return B_NOT_SUPPORTED;
+
+    if (avformat_alloc_output_context2(&s.output, nullptr, "mp3",
+                                       fPartPath.String()) < 0)
+      return B_NOT_SUPPORTED;
+    AVStream *stream = avformat_new_stream(s.output, nullptr);
+    if (stream == nullptr ||
+        avcodec_parameters_from_context(stream->codecpar, s.encoder) < 0)
+      return B_NO_MEMORY;
+    stream->time_base = s.encoder->time_base;
+    // Renderers show the tags; the Xing header would be rewritten at the
+    // end, after readers took the start of the file.
+    av_dict_copy(&s.output->metadata, s.input->metadata, 0);
+    if (avio_open(&s.output->pb, fPartPath.String(), AVIO_FLAG_WRITE) < 0)
+      return B_IO_ERROR;
+    AVDictionary *options = nullptr;
+    av_dict_set(&options, "write_xing", "0", 0);
+    int ret = avformat_write_header(s.output, &options);
+    av_dict_free(&options);
+    if (ret < 0)
+      return B_ERROR;
+
+    s.fifo = av_audio_fifo_alloc(sampleFormat, 2, s.encoder->frame_size * 4);
+    if (s.fifo == nullptr)
+      return B_NO_MEMORY;
+  } else {
+    s.outputFD = open(fPartPath.String(), O_WRONLY | O_TRUNC);
+    if (s.outputFD < 0)
+      return errno;
+  }
+
+  s.frame = av_frame_alloc();
+  s.converted = av_frame_alloc();
+  s.packet = av_packet_alloc();
+  if (s.frame == nullptr || s.converted == nullptr || s.packet == nullptr)
+    return B_NO_MEMORY;
+
+  off_t written = 0;
+  int64 nextPts = 0;
+  status_t status = B_OK;
+
+  auto publish = [&]() {
+    if (s.output != nullptr) {
+      avio_flush(s.output->pb);
+      written = avio_tell(s.output->pb);
+    }
+    _Published(written);
+  };
+
+  // Encodes and writes what the encoder hands back; `frame` nullptr drains.
+  auto encode = [&](AVFrame *frame) -> status_t {
+    if (avcodec_send_frame(s.encoder, frame) < 0)
+      return B_ERROR;
+    while (avcodec_receive_packet(s.encoder, s.packet) == 0) {
+      s.packet->stream_index = 0;
+      av_packet_rescale_ts(s.packet, s.encoder->time_base,
+                           s.output->streams[0]->time_base);
+      int ret = av_write_frame(s.output, s.packet);
+      av_packet_unref(s.packet);
+      if (ret < 0)
+        return B_IO_ERROR;
+    }
+    return B_OK;
+  };
+
+  // Encodes whole encoder frames from the FIFO; all of it when `flush`.
+  auto encodeFifo = [&](bool flush) -> status_t {
+    const int frameSize = s.encoder->frame_size;
+    while (av_audio_fifo_size(s.fifo) >= frameSize ||
+           (flush && av_audio_fifo_size(s.fifo) > 0)) {
+      AVFrame *out = av_frame_alloc();
+      if (out == nullptr)
+        return B_NO_MEMORY;
+      out->nb_samples = std::min(av_audio_fifo_size(s.fifo), frameSize);
+      out->format = sampleFormat;
+      out->sample_rate = kOutputRate;
+      av_channel_layout_copy(&out->ch_layout, &stereo);
+      status_t result = B_NO_MEMORY;
+      if (av_frame_get_buffer(out, 0) == 0 &&
+          av_audio_fifo_read(s.fifo, (void **)out->data, out->nb_samples) ==
+              out->nb_samples) {
+        out->pts = nextPts;
+        nextPts += out->nb_samples;
+        result = encode(out);
+      }
+      av_frame_free(&out);
+      if (result != B_OK)
+        return result;
+    }
+    return B_OK;
+  };
+
+  // Resamples `frame` (nullptr flushes the resampler) and hands it on.
+  auto convert = [&](const AVFrame *frame) -> status_t {
+    int capacity = swr_get_out_samples(s.resampler,
+                                       frame != nullptr ? frame->nb_samples : 0);
+    if (capacity <= 0)
+      return B_OK;
+    if (s.converted->nb_samples < capacity) {
+      av_frame_unref(s.converted);
+      s.converted->nb_samples = capacity;
+      s.converted->format = sampleFormat;
+      s.converted->sample_rate = kOutputRate;
+      av_channel_layout_copy(&s.converted->ch_layout, &stereo);
+      if (av_frame_get_buffer(s.converted, 0) < 0)
+        return B_NO_MEMORY;
+    }
+    int samples = swr_convert(
+        s.resampler, s.converted->data, capacity,
+        frame != nullptr ? (const uint8 **)frame->extended_data : nullptr,
+        frame != nullptr ? frame->nb_samples : 0);
+    if (samples <= 0)
+      return samples < 0 ? B_ERROR : B_OK;
+
+    if (s.fifo != nullptr) {
+      if (av_audio_fifo_write(s.fifo, (void **)s.converted->data, samples) <
+          samples)
+        return B_NO_MEMORY;
+      return encodeFifo(false);
+    }
+
+    // L16 is big-endian.
+    const size_t bytes = (size_t)samples * 2 * sizeof(int16);
+    int16 *pcm = reinterpret_cast<int16 *>(s.converted->data[0]);
+    for (size_t i = 0; i < bytes / sizeof(int16); i++)
+      pcm[i] = (int16)B_HOST_TO_BENDIAN_INT16((uint16)pcm[i]);
+    if (write(s.outputFD, pcm, bytes) != (ssize_t)bytes)
+      return B_IO_ERROR;
+    written += bytes;
+    return B_OK;
+  };
+
+  // Decodes `packet` (nullptr drains the decoder) and converts the frames.
+  auto decode = [&](const AVPacket *packet) -> status_t {
+    if (avcodec_send_packet(s.decoder, packet) < 0 && packet != nullptr)
+      return B_OK; // A damaged packet; go on with the next one
+    while (avcodec_receive_frame(s.decoder, s.frame) == 0) {
+      status_t result = convert(s.frame);
+      av_frame_unref(s.frame);
+      if (result != B_OK)
+        return result;
+    }
+    return B_OK;
+  };
+
+  int32 packets = 0;
+  while (status == B_OK && !fCancelled) {
+    int ret = av_read_frame(s.input, s.packet);
+    if (ret < 0)
+      break;
+    if (s.packet->stream_index == streamIndex)
+      status = decode(s.packet);
+    av_packet_unref(s.packet);
+    // A few dozen packets are a fraction of a second of output.
+    if (++packets % 32 == 0)
+      publish();
+  }
+  if (fCancelled)
+    return B_CANCELED;
+
+  if (status == B_OK)
+    status = decode(nullptr);
+  if (status == B_OK)
+    status = convert(nullptr);
+  if (status == B_OK && s.fifo != nullptr)
+    status = encodeFifo(true);
+  if (status == B_OK && s.encoder != nullptr)
+    status = encode(nullptr);
+  if (status == B_OK && s.output != nullptr &&
+      av_write_trailer(s.output) < 0)
+    status = B_IO_ERROR;
+  if (status == B_OK)
+    publish();
+  return status;
+}
+
+// ============================================================================
+// TranscodeCache
+// ============================================================================
+
+TranscodeCache &TranscodeCache::Default() {
+  static TranscodeCache sCache;
+  return sCache;
+}
+
+TranscodeCache::TranscodeCache()
+    : fLock("TranscodeCache"), fInitialized(false), fTotalSize(0) {}
+
+const char *TranscodeCache::MimeType(Format format) {
+  switch (format) {
+  case kMp3:
+    return "audio/mpeg";
+  case kLpcm:
+    return "audio/L16;rate=44100;channels=2";
+  default:
+    return "application/octet-stream";
+  }
+}
+
+TranscodeCache::Format TranscodeCache::FormatFor(const char *path,
+                                                 const BString &sink) {
+  // Without the renderer's list there is nothing to go by.
+  if (sink.IsEmpty())
+    return kPassThrough;
+
+  AVFormatContext *input = nullptr;
+  if (avformat_open_input(&input, path, nullptr, nullptr) < 0)
+    return kPassThrough;
+  AVCodecID codec = AV_CODEC_ID_NONE;
+  int rate = 0;
+  int channels = 0;
+  if (avformat_find_stream_info(input, nullptr) >= 0) {
+    int index =
+        av_find_best_stream(input, AVMEDIA_TYPE_AUDIO, -1, -1, nullptr, 0);
+    if (index >= 0) {
+      const AVCodecParameters *parameters = input->streams[index]->codecpar;
+      codec = parameters->codec_id;
+      rate = parameters->sample_rate;
+      channels = parameters->ch_layout.nb_channels;
+    }
+  }
+  avformat_close_input(&input);
+  if (codec == AV_CODEC_ID_NONE)
+    return kPassThrough;
+
+  bool accepted = false;
+  for (const CodecMimes &entry : kCodecMimes) {
+    if (entry.codec != codec)
+      continue;
+    for (const char *mime : entry.mimes) {
+      if (mime != nullptr && SinkAccepts(sink, mime))
+        accepted = true;
+    }
+  }
+  if (accepted && rate <= kMaxPassThroughRate && channels <= 2)
+    return kPassThrough;
+
+  if (SinkAccepts(sink, "audio/mpeg") &&
+      avcodec_find_encoder(AV_CODEC_ID_MP3) != nullptr)
+    return kMp3;
+  if (SinkAccepts(sink, "audio/L16"))
+    return kLpcm;
+  return kPassThrough;
+}
+
+BReference<TranscodeCache::Job> TranscodeCache::Acquire(const char *path,
+                                                        Format format) {
+  struct stat st;
+  if (format == kPassThrough || stat(path, &st) != 0)
+    return nullptr;
+
+  // 64-bit FNV-1a of what makes the output differ.
+  BString identity;
+  identity.SetToFormat("%s|%lld|%lld|%d", path, (long long)st.st_size,
+                       (long long)st.st_mtime, (int)format);
+  uint64 hash = 14695981039346656037ULL;
+  for (int32 i = 0; i < identity.Length(); i++) {
+    hash ^= (uint8)identity.ByteAt(i);
+    hash *= 1099511628211ULL;
+  }
+
+  BAutolock lock(fLock);
+  if (_InitLocked() != B_OK)
+    return nullptr;
+
+  BString name;
+  name.SetToFormat("%016llx.%s", (unsigned long long)hash,
+                   format == kMp3 ? "mp3" : "pcm");
+  BPath output(fDirectory);
+  output.Append(name.String());
+  BString outputPath = output.Path();
+
+  auto running = fRunning.find(outputPath);
+  if (running != fRunning.end())
+    return BReference<Job>(running->second);
+
+  BReference<Job> job(new Job(path, format, outputPath), true);
+  BEntry cached(outputPath.String());
+  off_t size = 0;
+  if (cached.GetSize(&size) == B_OK) {
+    job->fReadFD = open(outputPath.String(), O_RDONLY);
+    if (job->fReadFD >= 0) {
+      // Eviction goes by modification time, so a hit marks it fresh.
+      cached.SetModificationTime(time(nullptr));
+      job->fWritten = size;
+      job->fDone = true;
+      return job;
+    }
+  }
+
+  status_t status = job->_Start();
+  if (status != B_OK) {
+    DEBUG_PRINT("TranscodeCache: cannot start %s: %s\n", path,
+                strerror(status));
+    BEntry(job->fPartPath.String()).Remove();
+    return nullptr;
+  }
+  job->AcquireReference();
+  fRunning[outputPath] = job.Get();
+  return job;
+}
+
+void TranscodeCache::CancelAll() {
+  std::vector<thread_id> threads;
+  {
+    BAutolock lock(fLock);
+    for (auto &entry : fRunning) {
+      entry.second->fCancelled = true;
+      threads.push_back(entry.second->fThread);
+    }
+  }
+  status_t exitValue;
+  for (thread_id thread : threads)
+    wait_for_thread(thread, &exitValue);
+}
+
+void TranscodeCache::_Finished(Job *job, off_t size) {
+  {
+    BAutolock lock(fLock);
+    fRunning.erase(job->fOutputPath);
+    fTotalSize += size;
+    if (fTotalSize > kSizeLimit)
+      _EvictLocked();
+  }
+  job->ReleaseReference();
+}
+
+status_t TranscodeCache::_InitLocked() {
+  if (fInitialized)
+    return fDirectory.InitCheck();
+  fInitialized = true;
+
+  status_t status = find_directory(B_USER_CACHE_DIRECTORY, &fDirectory);
+  if (status != B_OK)
+    return status;
+  fDirectory.Append("BeTon/transcode");
+  create_directory(fDirectory.Path(), 0755);
+
+  BDirectory dir(fDirectory.Path());
+  status = dir.InitCheck();
+  if (status != B_OK) {
+    fDirectory.Unset();
+    return status;
+  }
+
+  // Outputs a previous run left unfinished are useless.
+  BEntry entry;
+  while (dir.GetNextEntry(&entry) == B_OK) {
+    char name[B_FILE_NAME_LENGTH];
+    off_t size = 0;
+    if (entry.GetName(name) == B_OK && BString(name).EndsWith(".part"))
+      entry.Remove();
+    else if (entry.GetSize(&size) == B_OK)
+      fTotalSize += size;
+  }
+  return B_OK;
+}
+
+/**
+ * @brief Removes the least recently used outputs until the cache is back
+ * under three quarters of its limit. Running transcodes are kept.
+ */
+void TranscodeCache::_EvictLocked() {
+  struct Entry {
+    BString name;
+    off_t size;
+    time_t modified;
+  };
+
+  BDirectory dir(fDirectory.Path());
+  if (dir.InitCheck() != B_OK)
+    return;
+
+  std::vector<Entry> entries;
+  fTotalSize = 0;
+  BEntry entry;
+  while (dir.GetNextEntry(&entry) == B_OK) {
+    Entry item;
+    char name[B_FILE_NAME_LENGTH];
+    if (entry.GetName(name) != B_OK || entry.GetSize(&item.size) != B_OK ||
+        entry.GetModificationTime(&item.modified) != B_OK)
+      continue;
+    item.name = name;
+    fTotalSize += item.size;
+    if (!item.name.EndsWith(".part"))
+      entries.push_back(item);
+  }
+
+  std::sort(entries.begin(), entries.end(),
+            [](const Entry &a, const Entry &b) {
+              return a.modified < b.modified;
+            });
+
+  // Readers keep their file open, so removing one under them is safe.
+  const off_t target = kSizeLimit / 4 * 3;
+  for (const Entry &item : entries) {
+    if (fTotalSize <= target)
+      break;
+    if (BEntry(&dir, item.name.String()).Remove() == B_OK)
+      fTotalSize -= item.size;
+  }
+}
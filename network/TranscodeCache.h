@@ -0,0 +1,128 @@
+#ifndef BETON_TRANSCODE_CACHE_H
+#define BETON_TRANSCODE_CACHE_H
+
+#include <Locker.h>
+#include <OS.h>
+#include <Path.h>
+#include <Referenceable.h>
+#include <String.h>
+#include <SupportDefs.h>
+#include <atomic>
+#include <map>
+
+/**
+ * @class TranscodeCache
+ * @brief Converts local files a DLNA renderer cannot play into a format it
+ * can, into a cache on disk.
+ *
+ * FormatFor() compares a file with the renderer's sink protocol info
+ * (ConnectionManager GetProtocolInfo) and picks MP3 at 320 kbit/s or
+ * 16-bit 44.1 kHz LPCM when the renderer lacks the file's format or it
+ * exceeds kMaxPassThroughRate. Acquire() returns the cached output, or
+ * starts a transcode on its own thread and returns it while it runs:
+ * readers follow the growing file with Job::ReadAt(), so the network send
+ * starts with the first encoded bytes.
+ *
+ * Outputs live under ~/config/cache/BeTon/transcode, keyed by the source's
+ * path, size, modification time and the output format; once past
+ * kSizeLimit the least recently used ones are removed.
+ *
+ * All methods are thread-safe.
+ */
+class TranscodeCache {
+public:
+  enum Format {
+    kPassThrough = 0, ///< Serve the file as it is
+    kMp3,             ///< MP3, 320 kbit/s, 44.1 kHz stereo
+    kLpcm             ///< audio/L16: 16-bit big-endian, 44.1 kHz stereo
+  };
+
+  /// Highest sample rate a renderer is trusted to play natively.
+  static const int32 kMaxPassThroughRate = 96000;
+  static const off_t kSizeLimit = 2048LL * 1024 * 1024;
+
+  /** @brief One output file, complete or still being written. */
+  class Job : public BReferenceable {
+  public:
+    ~Job();
+
+    Format OutputFormat() const { return fFormat; }
+    bool IsComplete() const;
+    /** @brief False once the transcode failed or was cancelled. */
+    bool IsValid() const;
+    /** @brief The complete output; empty while it is written. */
+    BString OutputPath() const;
+
+    /**
+     * @brief Reads up to `size` output bytes at `position`, waiting up to
+     * `timeout` for the transcoder to write them.
+     * @return Bytes read, 0 at the end of the output, or an error.
+     */
+    ssize_t ReadAt(off_t position, void *buffer, size_t size,
+                   bigtime_t timeout);
+    /** @brief Waits up to `timeout` for the output to be complete. */
+    bool WaitForCompletion(bigtime_t timeout);
+
+  private:
+    friend class TranscodeCache;
+
+    Job(const BString &source, Format format, const BString &outputPath);
+
+    status_t _Start();
+    static int32 _ThreadEntry(void *data);
+    void _Run();
+    status_t _Transcode();
+    void _Published(off_t written);
+    bool _Wait(bigtime_t deadline);
+
+    BString fSource;
+    Format fFormat;
+    BString fOutputPath;
+    BString fPartPath;
+    int fReadFD = -1;
+    thread_id fThread = -1;
+    std::atomic<bool> fCancelled{false};
+
+    mutable BLocker fLock{"transcode job"}; ///< Guards the fields below
+    off_t fWritten = 0;
+    bool fDone = false;
+    status_t fStatus = B_OK;
+    int32 fWaiting = 0;
+    sem_id fProgress;
+  };
+
+  static TranscodeCache &Default();
+
+  /**
+   * @brief Format to serve `path` in to a renderer with `sinkProtocolInfo`;
+   * kPassThrough when it plays the file, or nothing fits.
+   */
+  static Format FormatFor(const char *path, const BString &sinkProtocolInfo);
+  static const char *MimeType(Format format);
+
+  /**
+   * @brief The output of `path` in `format`: from the cache, from a
+   * transcode already running, or from a new one.
+   * @return nullptr if the output cannot be created.
+   */
+  BReference<Job> Acquire(const char *path, Format format);
+
+  /** @brief Cancels running transcodes and waits for them. */
+  void CancelAll();
+
+private:
+  TranscodeCache();
+
+  status_t _InitLocked();
+  void _EvictLocked();
+  void _Finished(Job *job, off_t size);
+
+  BLocker fLock;
+  BPath fDirectory;
+  bool fInitialized;
+  off_t fTotalSize;
+  /// Running transcodes by output path; each holds a reference.
+  std::map<BString, Job *> fRunning;
+};
+
+#endif // BETON_TRANSCODE_CACHE_H
@@ -0,0 +1,240 @@
+#include "AnalysisTap.h"
+#include "Debug.h"
+#include "PcmKernels.h"
+
+#include <Autolock.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+/** @brief Ring size; several intervals of 96 kHz float stereo. */
+static const size_t kRingBytes = 256 * 1024;
+
+/** @brief Power (linear, squared amplitude) in dBFS, floored. */
+static float PowerToDb(double power) {
+  const double kFloorPower = std::pow(10.0, AnalysisTap::kFloor / 10.0);
+  return power > kFloorPower ? (float)(10.0 * std::log10(power))
+                             : AnalysisTap::kFloor;
+}
+
+AnalysisTap::AnalysisTap()
+    : fAttached(0), fLock("analysis tap"), fThread(-1), fQuit(false),
+      fFormat(0), fChannels(0), fFrameRate(0.0f), fHistory(kFftSize, 0.0f),
+      fHistoryPos(0), fWindow(kFftSize), fSpectrum(kFftSize), fSerial(0) {
+  fRing.SetCapacity(kRingBytes);
+  for (int32 i = 0; i < kFftSize; i++)
+    fWindow[i] = 0.5f - 0.5f * std::cos(2.0 * M_PI * i / (kFftSize - 1));
+}
+
+AnalysisTap::~AnalysisTap() {
+  BAutolock lock(fLock);
+  if (fThread >= 0) {
+    fQuit.store(true, std::memory_order_relaxed);
+    status_t ignored;
+    wait_for_thread(fThread, &ignored);
+  }
+}
+
+void AnalysisTap::Attach() {
+  BAutolock lock(fLock);
+  if (fAttached.load(std::memory_order_relaxed) == 0) {
+    fQuit.store(false, std::memory_order_relaxed);
+    fThread = spawn_thread(_Entry, "audio analysis", B_LOW_PRIORITY, this);
+    if (fThread < 0 || resume_thread(fThread) != B_OK) {
+      DEBUG_PRINT("analysis tap: no thread (%ld)\n", (long)fThread);
+      fThread = -1;
+    }
+  }
+  fAttached.fetch_add(1, std::memory_order_relaxed);
+}
+
+void AnalysisTap::Detach() {
+  BAutolock lock(fLock);
+  if (fAttached.load(std::memory_order_relaxed) == 0 ||
+      fAttached.fetch_sub(1, std::memory_order_relaxed) > 1)
+    return;
+  if (fThread >= 0) {
+    fQuit.store(true, std::memory_order_relaxed);
+    status_t ignored;
+    wait_for_thread(fThread, &ignored);
+    fThread = -1;
+  }
+}
+
+bool AnalysisTap::Read(Snapshot &out) const {
+  // The analysis writes the other buffer; only a publish during the copy
+  // may reuse this one.
+  for (int32 attempt = 0; attempt < 4; attempt++) {
+    uint32 serial = fSerial.load(std::memory_order_acquire);
+    if (serial == 0)
+      return false;
+    out = fSnapshots[serial & 1];
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (fSerial.load(std::memory_order_relaxed) == serial)
+      return true;
+  }
+  return false;
+}
+
+void AnalysisTap::_Feed(const void *data, size_t size,
+                        const media_raw_audio_format &format) {
+  fFormat.store(format.format, std::memory_order_relaxed);
+  fChannels.store((int32)format.channel_count, std::memory_order_relaxed);
+  fFrameRate.store(format.frame_rate, std::memory_order_relaxed);
+
+  size_t frameSize =
+      (format.format & media_raw_audio_format::B_AUDIO_SIZE_MASK) *
+      format.channel_count;
+  if (frameSize == 0)
+    return;
+  // Whole buffers only, so the ring always holds whole frames; a full ring
+  // means the analysis fell behind and this buffer is not needed.
+  size -= size % frameSize;
+  if (size <= fRing.Space())
+    fRing.Write(data, size);
+}
+
+int32 AnalysisTap::_Entry(void *cookie) {
+  static_cast<AnalysisTap *>(cookie)->_Run();
+  return 0;
+}
+
+void AnalysisTap::_Run() {
+  std::vector<uint8> raw(kRingBytes);
+  std::vector<float> samples;
+  uint32 format = 0;
+  int32 channels = 0;
+  bool stale = true; ///< Ring holds data from before the attach
+
+  while (!fQuit.load(std::memory_order_relaxed)) {
+    snooze(kInterval);
+
+    uint32 currentFormat = fFormat.load(std::memory_order_relaxed);
+    int32 currentChannels = fChannels.load(std::memory_order_relaxed);
+    float frameRate = fFrameRate.load(std::memory_order_relaxed);
+    if (stale || currentFormat != format || currentChannels != channels) {
+      while (fRing.Read(raw.data(), raw.size()) > 0) {
+      }
+      std::fill(fHistory.begin(), fHistory.end(), 0.0f);
+      format = currentFormat;
+      channels = currentChannels;
+      stale = false;
+    }
+
+    const size_t sampleSize =
+        format & media_raw_audio_format::B_AUDIO_SIZE_MASK;
+    const size_t frameSize = sampleSize * channels;
+    size_t frames = 0;
+    if (PcmKernels::Supports(format) && frameSize > 0 && frameRate > 0) {
+      size_t bytes = fRing.Available();
+      bytes = std::min(bytes, raw.size());
+      bytes -= bytes % frameSize;
+      frames = fRing.Read(raw.data(), bytes) / frameSize;
+    }
+
+    const size_t count = frames * channels;
+    samples.resize(count);
+    switch (format) {
+    case media_raw_audio_format::B_AUDIO_FLOAT:
+      memcpy(samples.data(), raw.data(), count * sizeof(float));
+      break;
+    case media_raw_audio_format::B_AUDIO_SHORT:
+      PcmKernels::Int16ToFloat(reinterpret_cast<const int16 *>(raw.data()),
+                               samples.data(), count);
+      break;
+    case media_raw_audio_format::B_AUDIO_INT:
+      PcmKernels::Int32ToFloat(reinterpret_cast<const int32 *>(raw.data()),
+                               samples.data(), count);
+      break;
+    }
+    _Analyze(samples, channels, frames, frameRate);
+  }
+}
+
+/** @brief Measures one interval of frames and publishes a snapshot. */
+void AnalysisTap::_Analyze(const std::vector<float> &samples, int32 channels,
+                           size_t frames, float frameRate) {
+  const uint32 serial = fSerial.load(std::memory_order_relaxed) + 1;
+  Snapshot &snapshot = fSnapshots[serial & 1];
+  snapshot.serial = serial;
+  snapshot.channels = std::min(channels, kMaxChannels);
+
+  for (int32 channel = 0; channel < kMaxChannels; channel++) {
+    double sum = 0.0;
+    float peak = 0.0f;
+    if (channel < channels) {
+      for (size_t frame = 0; frame < frames; frame++) {
+        float value = samples[frame * channels + channel];
+        sum += (double)value * value;
+        peak = std::max(peak, std::fabs(value));
+      }
+    }
+    snapshot.rms[channel] = frames > 0 ? PowerToDb(sum / frames) : kFloor;
+    snapshot.peak[channel] = PowerToDb((double)peak * peak);
+  }
+
+  if (frames == 0) {
+    // Paused or stopped: let the display fall back to silence.
+    std::fill(snapshot.bands, snapshot.bands + kBands, kFloor);
+  } else {
+    for (size_t frame = 0; frame < frames; frame++) {
+      float mono = 0.0f;
+      for (int32 channel = 0; channel < channels; channel++)
+        mono += samples[frame * channels + channel];
+      fHistory[fHistoryPos] = mono / channels;
+      fHistoryPos = (fHistoryPos + 1) % kFftSize;
+    }
+    _Transform(frameRate, snapshot.bands);
+  }
+
+  fSerial.store(serial, std::memory_order_release);
+}
+
+/** @brief Windowed FFT of fHistory, summed into kBands log-spaced bands. */
+void AnalysisTap::_Transform(float frameRate, float *bands) {
+  const size_t n = kFftSize;
+  for (size_t i = 0; i < n; i++)
+    fSpectrum[i] = fWindow[i] * fHistory[(fHistoryPos + i) % n];
+
+  // Iterative radix-2 Cooley-Tukey.
+  for (size_t i = 1, j = 0; i < n; i++) {
+    size_t bit = n >> 1;
+    for (; j & bit; bit >>= 1)
+      j ^= bit;
+    j ^= bit;
+    if (i < j)
+      std::swap(fSpectrum[i], fSpectrum[j]);
+  }
+  for (size_t length = 2; length <= n; length <<= 1) {
+    const double angle = -2.0 * M_PI / length;
+    const std::complex<float> step((float)std::cos(angle),
+                                   (float)std::sin(angle));
+    for (size_t i = 0; i < n; i += length) {
+      std::complex<float> twiddle(1.0f, 0.0f);
+      for (size_t j = 0; j < length / 2; j++) {
+        std::complex<float> even = fSpectrum[i + j];
+        std::complex<float> odd = fSpectrum[i + j + length / 2] * twiddle;
+        fSpectrum[i + j] = even + odd;
+        fSpectrum[i + j + length / 2] = even - odd;
+        twiddle *= step;
+      }
+    }
+  }
+
+  // A full-scale sine peaks at n / 4 through the Hann window.
+  const double scale = 16.0 / ((double)n * n);
+  const double low = 40.0;
+  const double high = std::min(16000.0, frameRate / 2.0);
+  const double binWidth = frameRate / n;
+  for (int32 band = 0; band < kBands; band++) {
+    double from = low * std::pow(high / low, (double)band / kBands);
+    double to = low * std::pow(high / low, (double)(band + 1) / kBands);
+    size_t first = std::max<size_t>(1, (size_t)(from / binWidth));
+    size_t last = std::min(n / 2, std::max(first + 1, (size_t)(to / binWidth)));
+    double power = 0.0;
+    for (size_t bin = first; bin < last; bin++)
+      power += std::norm(fSpectrum[bin]);
+    bands[band] = PowerToDb(power * scale);
+  }
+}
@@ -0,0 +1,99 @@
+#ifndef BETON_ANALYSIS_TAP_H
+#define BETON_ANALYSIS_TAP_H
+
+#include "PcmRingBuffer.h"
+
+#include <Locker.h>
+#include <MediaDefs.h>
+#include <OS.h>
+#include <atomic>
+#include <complex>
+#include <vector>
+
+/**
+ * @class AnalysisTap
+ * @brief Level meter and spectrum of what the sound player plays, for
+ * visualizations.
+ *
+ * The sound player callback hands every buffer, after fades, to Feed(),
+ * which copies it into a lock-free PcmRingBuffer. A low-priority thread
+ * drains the ring every kInterval, computes RMS and peak per channel and a
+ * Hann-windowed FFT of the mono mix, and publishes a Snapshot. Snapshots
+ * are double-buffered behind a sequence number, so Read() never blocks the
+ * analysis and the analysis never waits for a reader.
+ *
+ * Nothing runs until a visualizer calls Attach(): with no one attached,
+ * Feed() is a single relaxed load and there is no analysis thread.
+ */
+class AnalysisTap {
+public:
+  static const int32 kFftSize = 1024;
+  static const int32 kBands = 24;      ///< Log-spaced, 40 Hz to 16 kHz
+  static const int32 kMaxChannels = 2; ///< Metered channels
+  static const bigtime_t kInterval = 40000;
+  static constexpr float kFloor = -90.0f; ///< dBFS reported for silence
+
+  struct Snapshot {
+    uint32 serial = 0; ///< Bumped per analysis; 0 before the first
+    int32 channels = 0;
+    float rms[kMaxChannels];  ///< dBFS
+    float peak[kMaxChannels]; ///< dBFS
+    float bands[kBands];      ///< dBFS
+  };
+
+  AnalysisTap();
+  ~AnalysisTap();
+
+  /** @name Visualizers */
+  ///@{
+  /** @brief Starts the analysis for one more visualizer. */
+  void Attach();
+  /** @brief Undoes Attach(); the last one stops the analysis thread. */
+  void Detach();
+  /** @brief Copies the latest snapshot; false before the first one. */
+  bool Read(Snapshot &out) const;
+  ///@}
+
+  /** @brief Sound player callback: copies `size` bytes of `format`. */
+  void Feed(const void *data, size_t size,
+            const media_raw_audio_format &format) {
+    if (fAttached.load(std::memory_order_relaxed) > 0)
+      _Feed(data, size, format);
+  }
+
+private:
+  void _Feed(const void *data, size_t size,
+             const media_raw_audio_format &format);
+
+  static int32 _Entry(void *cookie);
+  void _Run();
+  void _Analyze(const std::vector<float> &samples, int32 channels,
+                size_t frames, float frameRate);
+  void _Transform(float frameRate, float *bands);
+
+  std::atomic<int32> fAttached;
+  BLocker fLock; ///< Serializes Attach() and Detach()
+  thread_id fThread;
+  std::atomic<bool> fQuit;
+
+  /** @name Callback to analysis thread */
+  ///@{
+  PcmRingBuffer fRing;
+  std::atomic<uint32> fFormat;
+  std::atomic<int32> fChannels;
+  std::atomic<float> fFrameRate;
+  ///@}
+
+  /** @name Analysis thread */
+  ///@{
+  std::vector<float> fHistory; ///< Last kFftSize mono frames, circular
+  size_t fHistoryPos;
+  std::vector<float> fWindow;
+  std::vector<std::complex<float>> fSpectrum;
+  ///@}
+
+  Snapshot fSnapshots[2];
+  std::atomic<uint32> fSerial; ///< Snapshot fSerial & 1 is the current one
+};
+
+#endif // BETON_ANALYSIS_TAP_H
@@ -0,0 +1,146 @@
+#include "AudioHealthStats.h"
+
+#include <algorithm>
+
+AudioHealthStats::AudioHealthStats() {}
+
+template <typename T>
+static void AtomicMax(std::atomic<T> &target, T value) {
+  T current = target.load(std::memory_order_relaxed);
+  while (value > current &&
+         !target.compare_exchange_weak(current, value,
+                                       std::memory_order_relaxed))
+    ;
+}
+
+template <typename T>
+static void AtomicMin(std::atomic<T> &target, T value) {
+  T current = target.load(std::memory_order_relaxed);
+  while (value < current &&
+         !target.compare_exchange_weak(current, value,
+                                       std::memory_order_relaxed))
+    ;
+}
+
+void AudioHealthStats::Histogram::Record(bigtime_t value) {
+  if (value < 0)
+    return;
+  int32 bucket = 0;
+  while (bucket < kBuckets - 1 && value >= ((bigtime_t)2 << bucket))
+    bucket++;
+  fCounts[bucket].fetch_add(1, std::memory_order_relaxed);
+  fTotal.fetch_add((uint64)value, std::memory_order_relaxed);
+  AtomicMax(fMax, (uint64)value);
+}
+
+void AudioHealthStats::Histogram::Reset() {
+  for (auto &count : fCounts)
+    count.store(0, std::memory_order_relaxed);
+  fTotal.store(0, std::memory_order_relaxed);
+  fMax.store(0, std::memory_order_relaxed);
+}
+
+void AudioHealthStats::Histogram::Format(const char *label,
+                                         BString &out) const {
+  uint32 counts[kBuckets];
+  uint64 count = 0;
+  for (int32 i = 0; i < kBuckets; i++) {
+    counts[i] = fCounts[i].load(std::memory_order_relaxed);
+    count += counts[i];
+  }
+
+  // Upper bound of the bucket holding the given fraction.
+  auto percentile = [&](double fraction) -> bigtime_t {
+    uint64 wanted = (uint64)(count * fraction + 0.5);
+    uint64 seen = 0;
+    for (int32 i = 0; i < kBuckets; i++) {
+      seen += counts[i];
+      if (seen >= wanted && seen > 0)
+        return (bigtime_t)2 << i;
+    }
+    return 0;
+  };
+
+  BString line;
+  line.SetToFormat("%-12s %10" B_PRIu64 " %8" B_PRIu64 " %8" B_PRIdBIGTIME
+                   " %8" B_PRIdBIGTIME " %9" B_PRIu64 "\n",
+                   label, count,
+                   count > 0 ? fTotal.load(std::memory_order_relaxed) / count
+                             : 0,
+                   percentile(0.5), percentile(0.99),
+                   fMax.load(std::memory_order_relaxed));
+  out << line;
+}
+
+void AudioHealthStats::RecordFill(size_t available, size_t capacity) {
+  if (capacity == 0)
+    return;
+  uint32 perMille = (uint32)std::min<uint64>(
+      1000, (uint64)available * 1000 / capacity);
+  int32 bucket = std::min<int32>(kFillBuckets - 1, perMille / 100);
+  fFill[bucket].fetch_add(1, std::memory_order_relaxed);
+  fFillTotal.fetch_add(perMille, std::memory_order_relaxed);
+  AtomicMin(fFillMin, perMille);
+}
+
+void AudioHealthStats::RecordNetworkRead(ssize_t read, size_t size) {
+  fNetworkReads.fetch_add(1, std::memory_order_relaxed);
+  if (read < 0)
+    fFailedReads.fetch_add(1, std::memory_order_relaxed);
+  else if ((size_t)read < size)
+    fShortReads.fetch_add(1, std::memory_order_relaxed);
+}
+
+void AudioHealthStats::Reset() {
+  fCallback.Reset();
+  fRead.Reset();
+  for (auto &count : fFill)
+    count.store(0, std::memory_order_relaxed);
+  fFillTotal.store(0, std::memory_order_relaxed);
+  fFillMin.store(1000, std::memory_order_relaxed);
+  fUnderruns.store(0, std::memory_order_relaxed);
+  fNetworkReads.store(0, std::memory_order_relaxed);
+  fShortReads.store(0, std::memory_order_relaxed);
+  fFailedReads.store(0, std::memory_order_relaxed);
+}
+
+BString AudioHealthStats::Report() const {
+  BString report;
+  report.SetToFormat("%-12s %10s %8s %8s %8s %9s\n", "", "Count", "Mean us",
+                     "p50 us", "p99 us", "Max us");
+  fCallback.Format("Callback", report);
+  fRead.Format("ReadFrames", report);
+
+  uint64 fills = 0;
+  uint32 counts[kFillBuckets];
+  for (int32 i = 0; i < kFillBuckets; i++) {
+    counts[i] = fFill[i].load(std::memory_order_relaxed);
+    fills += counts[i];
+  }
+  BString line;
+  report << "\nRing fill at callback";
+  if (fills > 0) {
+    line.SetToFormat(": mean %.0f %%, min %.0f %%\n",
+                     fFillTotal.load(std::memory_order_relaxed) /
+                         (fills * 10.0),
+                     fFillMin.load(std::memory_order_relaxed) / 10.0);
+    report << line;
+    for (int32 i = 0; i < kFillBuckets; i++) {
+      line.SetToFormat("  %3ld-%3ld %% %10" B_PRIu32 "\n", (long)i * 10,
+                       (long)i * 10 + 10, counts[i]);
+      report << line;
+    }
+  } else {
+    report << ": -\n";
+  }
+
+  line.SetToFormat("\nUnderruns: %ld\n", (long)Underruns());
+  report << line;
+  line.SetToFormat("Network reads: %" B_PRIu32 " (%" B_PRIu32 " short, %"
+                   B_PRIu32 " failed)\n",
+                   fNetworkReads.load(std::memory_order_relaxed),
+                   fShortReads.load(std::memory_order_relaxed),
+                   fFailedReads.load(std::memory_order_relaxed));
+  report << line;
+  return report;
+}
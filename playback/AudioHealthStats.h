@@ -0,0 +1,90 @@
+#ifndef BETON_AUDIO_HEALTH_STATS_H
+#define BETON_AUDIO_HEALTH_STATS_H
+
+#include <OS.h>
+#include <String.h>
+#include <SupportDefs.h>
+#include <atomic>
+
+/**
+ * @class AudioHealthStats
+ * @brief Counters of the playback path, for diagnosing dropouts.
+ *
+ * Records how long each sound player callback took and how full the
+ * decode-ahead ring was when it ran, how long each `ReadFrames()` of the
+ * decoder thread took, underruns, and short or failed `ReadPcm()` calls on
+ * network streams. Durations go into log2 histograms, the fill level into
+ * ten linear buckets.
+ *
+ * Everything is a relaxed atomic in fixed storage: recording never locks,
+ * allocates or makes a system call besides `system_time()`, so it is safe
+ * in the real-time callback. Report() may run concurrently and sees a
+ * slightly torn but harmless snapshot.
+ */
+class AudioHealthStats {
+public:
+  AudioHealthStats();
+
+  /**
+   * @class Histogram
+   * @brief Log2 histogram of microseconds; bucket i holds [2^i, 2^(i+1)).
+   */
+  class Histogram {
+  public:
+    static const int32 kBuckets = 24;
+
+    void Record(bigtime_t value);
+    void Reset();
+    /** @brief One row: count, mean, p50, p99 and max. */
+    void Format(const char *label, BString &out) const;
+
+  private:
+    std::atomic<uint32> fCounts[kBuckets] = {};
+    std::atomic<uint64> fTotal{0};
+    std::atomic<uint64> fMax{0};
+  };
+
+  /**
+   * @class CallbackScope
+   * @brief Times one sound player callback.
+   */
+  class CallbackScope {
+  public:
+    explicit CallbackScope(AudioHealthStats &stats)
+        : fStats(stats), fStart(system_time()) {}
+    ~CallbackScope() { fStats.fCallback.Record(system_time() - fStart); }
+
+  private:
+    AudioHealthStats &fStats;
+    bigtime_t fStart;
+  };
+
+  /** @brief Ring fill level seen by a callback, `available` of `capacity`. */
+  void RecordFill(size_t available, size_t capacity);
+  void RecordRead(bigtime_t elapsed) { fRead.Record(elapsed); }
+  void RecordUnderrun() { fUnderruns.fetch_add(1, std::memory_order_relaxed); }
+  /** @brief A network `ReadPcm()` that returned `read` of `size` bytes. */
+  void RecordNetworkRead(ssize_t read, size_t size);
+
+  int32 Underruns() const { return fUnderruns.load(); }
+
+  void Reset();
+
+  /** @brief Plain text table of all counters. */
+  BString Report() const;
+
+private:
+  static const int32 kFillBuckets = 10;
+
+  Histogram fCallback;
+  Histogram fRead;
+  std::atomic<uint32> fFill[kFillBuckets] = {};
+  std::atomic<uint64> fFillTotal{0}; ///< Sum of per mille values
+  std::atomic<uint32> fFillMin{1000}; ///< Per mille
+  std::atomic<int32> fUnderruns{0};
+  std::atomic<uint32> fNetworkReads{0};
+  std::atomic<uint32> fShortReads{0};
+  std::atomic<uint32> fFailedReads{0};
+};
+
+#endif // BETON_AUDIO_HEALTH_STATS_H
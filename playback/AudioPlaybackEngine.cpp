@@ -1,9 +1,17 @@
 #include "AudioPlaybackEngine.h"
+#include "CrossfadeMixer.h"
+#include "PcmKernels.h"
 #include "DLNAService.h"
 #include "Debug.h"
+#include "HlsSegmentFetcher.h"
+#include "HttpConnectionPool.h"
 #include "LocalFileHttpServer.h"
 #include "Messages.h"
+#include "MidiTiming.h"
 #include "NetworkAudioStreamIO.h"
+#include "ReadAheadFile.h"
+#include "SeekIndex.h"
+#include "Trace.h"
 
 #include <Entry.h>
 #include <File.h>
@@ -26,6 +34,13 @@ static void EmptyMidiFileHook(int32) {}
 
 static constexpr bigtime_t kAudioFadeDurationUs = 80000;
 
+/** @brief Whether a sound player made for `a` can play `b` unchanged. */
+static bool SamePlayerFormat(const media_raw_audio_format &a,
+                             const media_raw_audio_format &b) {
+  return a.frame_rate == b.frame_rate && a.channel_count == b.channel_count &&
+         a.format == b.format && a.byte_order == b.byte_order;
+}
+
 static int64 FadeFrameCount(const media_raw_audio_format &format) {
   if (format.frame_rate <= 0)
     return 1;
@@ -34,203 +49,140 @@ static int64 FadeFrameCount(const media_raw_audio_format &format) {
                             1000000.0f));
 }
 
-#if ENABLE_MIDI_PLAYBACK
-struct MidiTempoEvent {
-  uint32 tick;
-  uint32 tempo;
-};
-
-static uint16 ReadBE16(const uint8 *data) {
-  return ((uint16)data[0] << 8) | data[1];
+#if ENABLE_DLNA_OUTPUT
+/** @brief Duration of the file at `path`, for tracks a renderer plays. */
+static bigtime_t RemoteTrackDuration(const char *path) {
+  bigtime_t duration = 0;
+  entry_ref ref;
+  if (get_ref_for_path(path, &ref) == B_OK) {
+    BMediaFile file(&ref);
+    if (file.InitCheck() == B_OK) {
+      BMediaTrack *track = file.TrackAt(0);
+      if (track) {
+        duration = track->Duration();
+        file.ReleaseTrack(track);
+      }
+    }
+  }
+  return duration;
 }
+#endif
 
-static uint32 ReadBE32(const uint8 *data) {
-  return ((uint32)data[0] << 24) | ((uint32)data[1] << 16) |
-         ((uint32)data[2] << 8) | data[3];
-}
+AudioPlaybackEngine::AudioPlaybackEngine() {}
 
-static bool ReadMidiVar(const uint8 *data, size_t size, size_t &offset,
-                        uint32 &value) {
-  value = 0;
-  for (int i = 0; i < 4; i++) {
-    if (offset >= size)
-      return false;
-    uint8 byte = data[offset++];
-    value = (value << 7) | (byte & 0x7f);
-    if ((byte & 0x80) == 0)
-      return true;
-  }
-  return true;
+AudioPlaybackEngine::~AudioPlaybackEngine() {
+  Stop();
+  _DeletePlayer();
 }
 
-static bool SkipMidiData(const uint8 *data, size_t size, size_t &offset,
-                         size_t count) {
-  if (offset + count > size)
-    return false;
-  offset += count;
-  return true;
-}
+/**
+ * @brief Sets the messenger for notifying the UI about playback events.
+ *
+ * @param target The messenger (usually the MainWindow).
+ */
+void AudioPlaybackEngine::SetTarget(BMessenger target) { fTarget = target; }
 
-static bool ComputeMidiDuration(const entry_ref &ref, bigtime_t &duration,
-                                int32 &tickDuration) {
-  duration = 0;
-  tickDuration = 0;
+#if ENABLE_DLNA_OUTPUT
+/** @brief Queues loading `url` on the renderer and starting it. */
+void AudioPlaybackEngine::_PostRemotePlay(const BString &url,
+                                          const BString &title) {
+  // A new track makes queued seeks of the previous one pointless.
+  fRemoteCommands.Cancel(kRemoteSeek);
+  DLNAService *mgr = fDlnaManager;
+  LocalFileHttpServer *server = fLocalFileHttpServer;
+  fRemoteCommands.Post([mgr, server, url, title] {
+    // The renderer requests the URL only after this, so files it cannot
+    // play are served transcoded from the first request on.
+    if (server != nullptr) {
+      server->SetSinkProtocolInfo(mgr->SinkProtocolInfo());
+      mgr->SubscribeRendererEvents(server->EventUrl());
+    }
+    mgr->SetAVTransportURI(url, title);
+    mgr->RendererPlay();
+  });
+}
 
-  BFile file(&ref, B_READ_ONLY);
-  if (file.InitCheck() != B_OK)
-    return false;
+/**
+ * @brief Serves queue entry `index` and queues it on the renderer, which
+ * then buffers it and starts it without a gap; -1 clears what an earlier
+ * entry armed.
+ */
+void AudioPlaybackEngine::_QueueRemoteEntry(int32 index) {
+  if (fDlnaManager == nullptr || fLocalFileHttpServer == nullptr)
+    return;
 
-  off_t fileSize = 0;
-  if (file.GetSize(&fileSize) != B_OK || fileSize < 14 ||
-      fileSize > 16 * 1024 * 1024) {
-    return false;
+  BString url;
+  if (index >= 0) {
+    // MIDI is played by the local synth, so it starts the normal way.
+    BString path = fQueue->PathAt(index);
+    BString lowerPath = path;
+    lowerPath.ToLower();
+    if (!lowerPath.EndsWith(".mid") && !lowerPath.EndsWith(".midi"))
+      fLocalFileHttpServer->ServeFile(path, url);
+  }
+  {
+    BAutolock lock(fGaplessLock);
+    // A stream's successor comes from SetRemoteNextUrl(); leave it be.
+    if (url.IsEmpty() && fRemoteNextIndex < 0)
+      return;
+    fRemoteNextIndex = url.IsEmpty() ? -1 : index;
+    fRemoteNextUrl = url;
   }
 
-  std::vector<uint8> bytes((size_t)fileSize);
-  if (file.Read(bytes.data(), bytes.size()) != (ssize_t)bytes.size())
-    return false;
-
-  const uint8 *data = bytes.data();
-  size_t size = bytes.size();
-  size_t offset = 0;
-  if (memcmp(data, "MThd", 4) != 0)
-    return false;
-  offset += 4;
-
-  uint32 headerSize = ReadBE32(data + offset);
-  offset += 4;
-  if (headerSize < 6 || offset + headerSize > size)
-    return false;
-
-  uint16 tracks = ReadBE16(data + offset + 2);
-  int16 division = (int16)ReadBE16(data + offset + 4);
-  offset += headerSize;
-
-  uint32 maxTick = 0;
-  std::vector<MidiTempoEvent> tempos;
-  tempos.push_back({0, 500000});
-
-  for (uint16 track = 0; track < tracks && offset + 8 <= size; track++) {
-    if (memcmp(data + offset, "MTrk", 4) != 0)
-      break;
-    offset += 4;
-    uint32 trackSize = ReadBE32(data + offset);
-    offset += 4;
-    if (offset + trackSize > size)
-      return false;
-
-    size_t trackEnd = offset + trackSize;
-    uint32 tick = 0;
-    uint8 runningStatus = 0;
-    while (offset < trackEnd) {
-      uint32 delta = 0;
-      if (!ReadMidiVar(data, trackEnd, offset, delta))
-        return false;
-      tick += delta;
-      maxTick = std::max(maxTick, tick);
-      if (offset >= trackEnd)
-        break;
-
-      uint8 status = data[offset++];
-      if (status < 0x80) {
-        if (runningStatus == 0)
-          return false;
-        offset--;
-        status = runningStatus;
-      } else if (status < 0xf0) {
-        runningStatus = status;
-      }
+  DLNAService *mgr = fDlnaManager;
+  fRemoteCommands.Post([mgr, url] { mgr->SetNextAVTransportURI(url, ""); });
+}
 
-      if (status == 0xff) {
-        if (offset >= trackEnd)
-          return false;
-        uint8 metaType = data[offset++];
-        uint32 length = 0;
-        if (!ReadMidiVar(data, trackEnd, offset, length))
-          return false;
-        if (offset + length > trackEnd)
-          return false;
-        if (metaType == 0x51 && length == 3) {
-          uint32 tempo = ((uint32)data[offset] << 16) |
-                         ((uint32)data[offset + 1] << 8) | data[offset + 2];
-          if (tempo > 0)
-            tempos.push_back({tick, tempo});
-        }
-        offset += length;
-      } else if (status == 0xf0 || status == 0xf7) {
-        uint32 length = 0;
-        if (!ReadMidiVar(data, trackEnd, offset, length) ||
-            !SkipMidiData(data, trackEnd, offset, length)) {
-          return false;
-        }
-      } else {
-        uint8 type = status & 0xf0;
-        size_t dataBytes = (type == 0xc0 || type == 0xd0) ? 1 : 2;
-        if (!SkipMidiData(data, trackEnd, offset, dataBytes))
-          return false;
-      }
-    }
-    offset = trackEnd;
-  }
+/** @brief Forgets the armed successor; the renderer drops it with a new URI. */
+void AudioPlaybackEngine::_ForgetRemoteNext() {
+  BAutolock lock(fGaplessLock);
+  fRemoteNextIndex = -1;
+  fRemoteNextUrl = "";
+  fRemoteNextTitle = "";
+  fRemoteNextDuration = 0;
+}
 
-  if (maxTick == 0)
+/** @brief The renderer moved on to the armed successor; make it current. */
+bool AudioPlaybackEngine::_CompleteRemoteHandoff() {
+  int32 index;
+  BString url;
+  BString title;
+  bigtime_t duration;
+  {
+    BAutolock lock(fGaplessLock);
+    index = fRemoteNextIndex;
+    url = fRemoteNextUrl;
+    title = fRemoteNextTitle;
+    duration = fRemoteNextDuration;
+    fGaplessIndex = -1;
+    fGaplessPath.clear();
+  }
+  _ForgetRemoteNext();
+  if (url.IsEmpty())
     return false;
-  tickDuration = (int32)std::min(maxTick, (uint32)0x7fffffff);
 
-  if (division < 0) {
-    int8 fpsByte = (int8)((division >> 8) & 0xff);
-    int fps = -fpsByte;
-    int subframes = division & 0xff;
-    if (fps <= 0 || subframes <= 0)
+  if (index >= 0) {
+    if (!fQueue.IsSet() || !fQueue->IsValid(index))
       return false;
-    duration = ((bigtime_t)maxTick * 1000000LL) / (fps * subframes);
-    return duration > 0;
+    fCurrentIdx = index;
+    fDuration = RemoteTrackDuration(fQueue->PathAt(index).String());
+  } else {
+    fDuration = duration;
   }
 
-  uint16 ticksPerQuarter = (uint16)division;
-  if (ticksPerQuarter == 0)
-    return false;
-
-  std::sort(tempos.begin(), tempos.end(),
-            [](const MidiTempoEvent &a, const MidiTempoEvent &b) {
-              return a.tick < b.tick;
-            });
-
-  uint32 lastTick = 0;
-  uint32 currentTempo = 500000;
-  bigtime_t total = 0;
-  for (const auto &event : tempos) {
-    if (event.tick > maxTick)
-      break;
-    if (event.tick > lastTick) {
-      total += ((bigtime_t)(event.tick - lastTick) * currentTempo) /
-               ticksPerQuarter;
-      lastTick = event.tick;
-    }
-    currentTempo = event.tempo;
-  }
-  if (maxTick > lastTick) {
-    total += ((bigtime_t)(maxTick - lastTick) * currentTempo) /
-             ticksPerQuarter;
+  if (fTarget.IsValid()) {
+    BMessage m(MSG_NOW_PLAYING);
+    m.AddInt32("index", (int32)fCurrentIdx);
+    m.AddBool("streaming", true);
+    m.AddString("path", url);
+    if (!title.IsEmpty())
+      m.AddString("title", title);
+    m.AddBool("gapless", true);
+    fTarget.SendMessage(&m);
   }
-
-  duration = total;
-  return duration > 0;
+  return true;
 }
-#endif
-
-AudioPlaybackEngine::AudioPlaybackEngine() {}
-
-AudioPlaybackEngine::~AudioPlaybackEngine() { Stop(); }
 
-/**
- * @brief Sets the messenger for notifying the UI about playback events.
- *
- * @param target The messenger (usually the MainWindow).
- */
-void AudioPlaybackEngine::SetTarget(BMessenger target) { fTarget = target; }
-
-#if ENABLE_DLNA_OUTPUT
 void AudioPlaybackEngine::SetRemoteOutputManagers(
     DLNAService *dlna, LocalFileHttpServer *localServer) {
   fDlnaManager = dlna;
@@ -239,23 +191,67 @@ void AudioPlaybackEngine::SetRemoteOutputManagers(
 #endif
 
 /**
- * @brief Starts the BMessageRunner that sends periodic time updates to the UI.
+ * @brief Publishes the device local playback reads from (-1 = none).
+ *
+ * The window forwards it to the library cache, which throttles scans on the
+ * same disk.
+ */
+void AudioPlaybackEngine::_SetPlaybackDevice(dev_t device) {
+  if (fPlaybackDevice.exchange(device) == device)
+    return;
+  if (fTarget.IsValid()) {
+    BMessage m(MSG_PLAYBACK_DEVICE);
+    m.AddInt32("device", (int32)device);
+    fTarget.SendMessage(&m);
+  }
+}
+
+/**
+ * @brief Publishes the new track to the clock.
+ *
+ * The audio callback keeps the position current for local files and
+ * streams. MIDI and remote renderers have no callback here, so for them a
+ * BMessageRunner asks the UI to call RefreshClock() periodically.
  */
 void AudioPlaybackEngine::_StartTimeUpdates() {
+  fClock.SetTrack(fDuration, (float)fCurrentSampleRate.load(),
+                  fCurrentChannels.load(), CurrentPosition());
+  if (!_IsPolledClock())
+    return;
+  RefreshClock();
   if (fUpdateRunner == nullptr && fTarget.IsValid()) {
-    fUpdateRunner =
-        new BMessageRunner(fTarget, new BMessage(MSG_TIME_UPDATE), 500000);
+    fUpdateRunner = new BMessageRunner(fTarget, new BMessage(MSG_TIME_UPDATE),
+                                       kTimeUpdateInterval);
   }
 }
 
 /**
- * @brief Stops the periodic time updates.
+ * @brief Stops the periodic time updates and clears the clock.
  */
 void AudioPlaybackEngine::_StopTimeUpdates() {
   if (fUpdateRunner) {
     delete fUpdateRunner;
     fUpdateRunner = nullptr;
   }
+  fClock.SetTrack(0, 0.0f, 0);
+}
+
+/** @brief True if no audio callback publishes the position. */
+bool AudioPlaybackEngine::_IsPolledClock() const {
+#if ENABLE_DLNA_OUTPUT
+  if (fIsRemotePlaying.load(std::memory_order_relaxed) ||
+      (fDlnaManager && fDlnaManager->IsRemoteOutput()))
+    return true;
+#endif
+  return fIsMidiPlaying.load(std::memory_order_relaxed);
+}
+
+void AudioPlaybackEngine::RefreshClock() {
+  if (!_IsPolledClock())
+    return;
+  // Runs on between polls, a little longer than one interval.
+  fClock.SetPosition(CurrentPosition(),
+                     IsPlaying() ? kTimeUpdateInterval * 2 : 0);
 }
 
 /**
@@ -272,10 +268,11 @@ void AudioPlaybackEngine::_CleanupMedia() {
     snooze(50000);
   }
 
+  // The player outlives the track (see _PreparePlayer()); once stopped it no
+  // longer calls back into what is freed below.
   if (fPlayer) {
-    snooze(20000);
-    delete fPlayer;
-    fPlayer = nullptr;
+    fPlayer->SetHasData(false);
+    fPlayer->Stop();
   }
 
   bigtime_t callbackDeadline = system_time() + 500000;
@@ -284,6 +281,8 @@ void AudioPlaybackEngine::_CleanupMedia() {
     snooze(1000);
   }
 
+  _StopDecoder();
+
   if (fTrack) {
     fMediaFile->ReleaseTrack(fTrack);
     fTrack = nullptr;
@@ -296,6 +295,67 @@ void AudioPlaybackEngine::_CleanupMedia() {
     delete fNetworkStream;
     fNetworkStream = nullptr;
   }
+  fPrimed.clear();
+}
+
+/**
+ * @brief Format the sound player runs at for a track that decodes to
+ * `format`: the same, or float stereo at the fixed output rate.
+ */
+media_raw_audio_format AudioPlaybackEngine::_OutputFormatFor(
+    const media_raw_audio_format &format) const {
+  int32 rate = fOutputRate.load(std::memory_order_relaxed);
+  if (rate <= 0 || !FormatConverter::Supports(format))
+    return format;
+
+  media_raw_audio_format output = format;
+  output.frame_rate = rate;
+  output.channel_count = 2;
+  output.format = media_raw_audio_format::B_AUDIO_FLOAT;
+  output.byte_order = B_MEDIA_HOST_ENDIAN;
+  output.buffer_size = kOutputBufferFrames * 2 * sizeof(float);
+  return output;
+}
+
+/**
+ * @brief Makes fPlayer play `format`, keeping the current player if it
+ * already does.
+ *
+ * A new player registers a node with the media_server and connects it to
+ * the mixer, which used to be most of the time a track change took.
+ */
+status_t AudioPlaybackEngine::_PreparePlayer(
+    const media_raw_audio_format &format) {
+  if (fPlayer != nullptr && SamePlayerFormat(fPlayerFormat, format)) {
+    fCurrentOutputRate.store((int32)format.frame_rate);
+    return B_OK;
+  }
+
+  _DeletePlayer();
+  bigtime_t start = system_time();
+  fPlayer = new BSoundPlayer(&format, "Orchester", &_PlayBuffer, NULL, this);
+  status_t status = fPlayer->InitCheck();
+  if (status != B_OK) {
+    DEBUG_PRINT("BSoundPlayer init failed: %s (%ld)\n", strerror(status),
+                (long)status);
+    _DeletePlayer();
+    return status;
+  }
+  fPlayerFormat = format;
+  fCurrentOutputRate.store((int32)format.frame_rate);
+  DEBUG_PRINT("new sound player: rate=%.0f Hz, channels=%ld in %lld us\n",
+              format.frame_rate, (long)format.channel_count,
+              (long long)(system_time() - start));
+  return B_OK;
+}
+
+void AudioPlaybackEngine::_DeletePlayer() {
+  if (fPlayer == nullptr)
+    return;
+  fPlayer->SetHasData(false);
+  fPlayer->Stop();
+  delete fPlayer;
+  fPlayer = nullptr;
 }
 
 /**
@@ -312,26 +372,11 @@ void AudioPlaybackEngine::SetVolume(float vol) {
 
 #if ENABLE_DLNA_OUTPUT
   if (fDlnaManager && fDlnaManager->IsRemoteOutput()) {
-    static std::atomic<bool> sIsSettingVolume(false);
-    if (sIsSettingVolume.exchange(true))
-      return; ///< Prevent thread explosion while dragging volume slider
-
+    // A slider drag posts many of these; only the latest is sent.
+    DLNAService *mgr = fDlnaManager;
     int32 percent = (int32)(vol * 100);
-    struct VolData {
-      DLNAService *mgr;
-      int32 vol;
-    };
-    VolData *data = new VolData{fDlnaManager, percent};
-    thread_id tid = spawn_thread(
-        [](void *arg) -> int32 {
-          VolData *d = (VolData *)arg;
-          d->mgr->SetRendererVolume(d->vol);
-          delete d;
-          sIsSettingVolume = false;
-          return 0;
-        },
-        "dlna_vol", B_NORMAL_PRIORITY, data);
-    resume_thread(tid);
+    fRemoteCommands.Post([mgr, percent] { mgr->SetRendererVolume(percent); },
+                         kRemoteVolume);
     return;
   }
 #endif
@@ -382,49 +427,20 @@ void AudioPlaybackEngine::_ApplyFade(void *buffer, size_t size,
   if (fadeIn <= 0 && fadeOut <= 0)
     return;
 
-  auto gainForFrame = [&](int64 frame) {
-    float gain = 1.0f;
-    if (fadeIn > 0)
-      gain *= static_cast<float>(totalFrames - fadeIn + frame) / totalFrames;
-    if (fadeOut > 0)
-      gain *= static_cast<float>(fadeOut - frame) / totalFrames;
-    if (gain < 0.0f)
-      return 0.0f;
-    if (gain > 1.0f)
-      return 1.0f;
-    return gain;
-  };
-
-  if (format.format == media_raw_audio_format::B_AUDIO_FLOAT) {
-    float *samples = static_cast<float *>(buffer);
-    for (int64 frame = 0; frame < frames; ++frame) {
-      float gain = gainForFrame(frame);
-      for (int channel = 0; channel < channelCount; ++channel)
-        samples[frame * channelCount + channel] *= gain;
-    }
-  } else if (bytesPerSample == 2) {
-    int16 *samples = static_cast<int16 *>(buffer);
-    for (int64 frame = 0; frame < frames; ++frame) {
-      float gain = gainForFrame(frame);
-      for (int channel = 0; channel < channelCount; ++channel) {
-        int32 scaled =
-            static_cast<int32>(samples[frame * channelCount + channel] * gain);
-        samples[frame * channelCount + channel] =
-            static_cast<int16>(
-                std::max<int32>(-32768, std::min<int32>(32767, scaled)));
-      }
-    }
-  } else if (bytesPerSample == 4) {
-    int32 *samples = static_cast<int32 *>(buffer);
-    for (int64 frame = 0; frame < frames; ++frame) {
-      float gain = gainForFrame(frame);
-      for (int channel = 0; channel < channelCount; ++channel) {
-        double scaled = samples[frame * channelCount + channel] * gain;
-        samples[frame * channelCount + channel] =
-            static_cast<int32>(std::max<double>(
-                -2147483648.0, std::min<double>(2147483647.0, scaled)));
-      }
-    }
+  // Both ramps are linear, so each is one kernel call over the frames it
+  // still covers. Past its end a fade-in leaves gain 1, a fade-out 0.
+  const float step = 1.0f / totalFrames;
+  if (fadeIn > 0)
+    PcmKernels::ApplyGainRamp(buffer, format.format, channelCount,
+                              std::min(frames, fadeIn),
+                              (totalFrames - fadeIn) * step, step);
+  if (fadeOut > 0) {
+    int64 ramp = std::min(frames, fadeOut);
+    PcmKernels::ApplyGainRamp(buffer, format.format, channelCount, ramp,
+                              fadeOut * step, -step);
+    if (ramp < frames && PcmKernels::Supports(format.format))
+      memset(static_cast<uint8 *>(buffer) + ramp * frameSize, 0,
+             (size_t)((frames - ramp) * frameSize));
   }
 
   if (fadeIn > 0)
@@ -511,23 +527,28 @@ void AudioPlaybackEngine::_SilenceMidi() {
  * @param trackIndex Index of the track in fQueue to play.
  */
 void AudioPlaybackEngine::Play(size_t trackIndex) {
+  TRACE_SCOPE(kTracePlayback, "play", (int64)trackIndex);
   DEBUG_PRINT("Play(%zu) called\n", trackIndex);
 
   fCurrentBitrate.store(0);
   fCurrentSampleRate.store(0);
   fCurrentChannels.store(0);
+  fCurrentOutputRate.store(0);
 
   Stop(true);
   snooze(10000);
+  const bigtime_t startTime = system_time();
 
-  if (trackIndex >= fQueue.size()) {
-    DEBUG_PRINT("index %zu out of range (queue size %zu)\n", trackIndex,
-                fQueue.size());
+  if (!fQueue.IsSet() || !fQueue->IsValid((int32)trackIndex)) {
+    DEBUG_PRINT("index %zu not in the queue (%ld positions)\n", trackIndex,
+                (long)QueueSize());
     return;
   }
 
   fCurrentIdx = trackIndex;
-  const char *path = fQueue[trackIndex].c_str();
+  const BString queuePath = fQueue->PathAt((int32)trackIndex);
+  const char *path = queuePath.String();
+  _PublishGain((int32)trackIndex);
   DEBUG_PRINT("opening: %s\n", path);
 
 #if ENABLE_DLNA_OUTPUT || ENABLE_MIDI_PLAYBACK
@@ -543,34 +564,10 @@ void AudioPlaybackEngine::Play(size_t trackIndex) {
     if (fLocalFileHttpServer) {
       fLocalFileHttpServer->ServeFile(BString(path), targetUrl);
     }
+    fDuration = RemoteTrackDuration(path);
 
-    entry_ref ref;
-    if (get_ref_for_path(path, &ref) == B_OK) {
-      BMediaFile tempFile(&ref);
-      if (tempFile.InitCheck() == B_OK) {
-        BMediaTrack *tempTrack = tempFile.TrackAt(0);
-        if (tempTrack) {
-          fDuration = tempTrack->Duration();
-          tempFile.ReleaseTrack(tempTrack);
-        }
-      }
-    }
-
-    struct PlayData {
-      DLNAService *mgr;
-      BString url;
-    };
-    PlayData *data = new PlayData{fDlnaManager, targetUrl};
-    thread_id tid = spawn_thread(
-        [](void *arg) -> int32 {
-          PlayData *d = (PlayData *)arg;
-          d->mgr->SetAVTransportURI(d->url, "");
-          d->mgr->RendererPlay();
-          delete d;
-          return 0;
-        },
-        "dlna_play", B_NORMAL_PRIORITY, data);
-    resume_thread(tid);
+    _ForgetRemoteNext();
+    _PostRemotePlay(targetUrl, "");
 
     fPlaying = true;
     fIsRemotePlaying = true;
@@ -598,7 +595,7 @@ void AudioPlaybackEngine::Play(size_t trackIndex) {
   }
 
 #if ENABLE_MIDI_PLAYBACK
-  if (isMidiFile) {
+  if (isMidiFile && !LocalMediaFile::RendersMidi()) {
     fMidiSynth = new BMidiSynthFile();
     st = fMidiSynth->LoadFile(&ref);
     if (st != B_OK) {
@@ -617,11 +614,13 @@ void AudioPlaybackEngine::Play(size_t trackIndex) {
     fPaused = false;
     fAtEnd = false;
     fCurrentPos = 0;
-    int32 midiTickDuration = 0;
-    if (ComputeMidiDuration(ref, fDuration, midiTickDuration))
-      fMidiTickDuration.store(midiTickDuration, std::memory_order_relaxed);
-    else
+    MidiTiming timing;
+    if (timing.SetTo(ref)) {
+      fDuration = timing.Duration();
+      fMidiTickDuration.store(timing.TickCount(), std::memory_order_relaxed);
+    } else {
       fDuration = (bigtime_t)fMidiSynth->Duration() * 1000LL;
+    }
 
     st = _StartMidiAt(0);
     if (st != B_OK) {
@@ -643,28 +642,38 @@ void AudioPlaybackEngine::Play(size_t trackIndex) {
   }
 #endif
 
-  fMediaFile = new BMediaFile(&ref);
-  st = fMediaFile->InitCheck();
-  if (st != B_OK) {
-    DEBUG_PRINT("BMediaFile::InitCheck failed: %s (%ld)\n",
-                strerror(st), (long)st);
-    _CleanupMedia();
-    return;
-  }
+  // A prefetched track is open already and brings its first frames along.
+  media_format mf{};
+  TrackPrefetcher::Track prefetched;
+  const bool warm = fPrefetcher.Take(path, prefetched);
+  if (warm) {
+    fMediaFile = prefetched.file;
+    fTrack = prefetched.track;
+    mf = prefetched.format;
+    fPrimed.swap(prefetched.primed);
+  } else {
+    fMediaFile = LocalMediaFile::Open(ref);
+    st = fMediaFile->InitCheck();
+    if (st != B_OK) {
+      DEBUG_PRINT("BMediaFile::InitCheck failed: %s (%ld)\n",
+                  strerror(st), (long)st);
+      _CleanupMedia();
+      return;
+    }
 
-  fTrack = fMediaFile->TrackAt(0);
-  if (!fTrack) {
-    DEBUG_PRINT("TrackAt(0) returned nullptr\n");
-    _CleanupMedia();
-    return;
+    fTrack = fMediaFile->TrackAt(0);
+    if (!fTrack) {
+      DEBUG_PRINT("TrackAt(0) returned nullptr\n");
+      _CleanupMedia();
+      return;
+    }
   }
 
   fDuration = fTrack->Duration();
   DEBUG_PRINT("duration: %lld us (%.2f s)\n", (long long)fDuration,
               fDuration / 1e6);
 
-  media_format mf{};
-  st = fTrack->DecodedFormat(&mf);
+  st = warm ? B_OK : fTrack->DecodedFormat(&mf);
     
     media_format encFmt;
     fTrack->EncodedFormat(&encFmt);
@@ -696,9 +705,18 @@ void AudioPlaybackEngine::Play(size_t trackIndex) {
               raf.byte_order == B_MEDIA_BIG_ENDIAN ? "BE" : "LE",
               (long)raf.buffer_size);
 
-  fPlayer = new BSoundPlayer(&raf, "Orchester", &_PlayBuffer, NULL, this);
-  if (!fPlayer) {
-    DEBUG_PRINT("BSoundPlayer new failed\n");
+  const media_raw_audio_format output = _OutputFormatFor(raf);
+  fCurrentPos = 0;
+  fDecodePath = path;
+  st = _StartDecoder(raf, output);
+  if (st != B_OK) {
+    DEBUG_PRINT("decoder thread failed: %s (%ld)\n", strerror(st), (long)st);
+    _CleanupMedia();
+    return;
+  }
+
+  st = _PreparePlayer(output);
+  if (st != B_OK) {
     _CleanupMedia();
     return;
   }
@@ -706,6 +724,7 @@ void AudioPlaybackEngine::Play(size_t trackIndex) {
   fPlayer->SetVolume(fVolume);
   _BeginFadeIn();
 
+  fAtEnd.store(false, std::memory_order_relaxed);
   fPlayer->Start();
   fPlayer->SetHasData(true);
 
@@ -716,14 +735,17 @@ void AudioPlaybackEngine::Play(size_t trackIndex) {
     fTarget.SendMessage(&m);
   }
 
-  fAtEnd.store(false, std::memory_order_relaxed);
   fPlaying.store(true, std::memory_order_relaxed);
   fPaused.store(false, std::memory_order_relaxed);
-  fCurrentPos = 0;
 
+  fLocalDevice = ref.device;
+  _SetPlaybackDevice(fLocalDevice);
   _StartTimeUpdates();
 
-  DEBUG_PRINT("started OK\n");
+  DEBUG_PRINT("started OK in %lld us%s%s\n",
+              (long long)(system_time() - startTime),
+              fConverting ? " (converted)" : "", warm ? " (prefetched)" : "");
+  _UpdatePrefetch();
 }
 
 /**
@@ -740,12 +762,15 @@ void AudioPlaybackEngine::PlayUrl(const BUrl &url, const char *title,
   fCurrentBitrate.store(0);
   fCurrentSampleRate.store(0);
   fCurrentChannels.store(0);
+  fCurrentOutputRate.store(0);
 
   BAutolock lock(fPlayLock);
   DEBUG_PRINT("PlayUrl(%s, duration=%ld) called\n",
               url.UrlString().String(), (long)durationSeconds);
 
   _StopLocked(true);
+  fLocalDevice = -1;
+  _SetPlaybackDevice(-1);
   snooze(10000);
 
 #if ENABLE_DLNA_OUTPUT
@@ -761,22 +786,8 @@ void AudioPlaybackEngine::PlayUrl(const BUrl &url, const char *title,
         fLocalFileHttpServer->ServeFile(targetUrl, targetUrl);
       }
     }
-    struct PlayData {
-      DLNAService *mgr;
-      BString url;
-      BString title;
-    };
-    PlayData *data = new PlayData{fDlnaManager, targetUrl, title ? title : ""};
-    thread_id tid = spawn_thread(
-        [](void *arg) -> int32 {
-          PlayData *d = (PlayData *)arg;
-          d->mgr->SetAVTransportURI(d->url, d->title);
-          d->mgr->RendererPlay();
-          delete d;
-          return 0;
-        },
-        "dlna_play", B_NORMAL_PRIORITY, data);
-    resume_thread(tid);
+    _ForgetRemoteNext();
+    _PostRemotePlay(targetUrl, title ? title : "");
 
     fPlaying = true;
     fIsRemotePlaying = true;
@@ -855,8 +866,8 @@ void AudioPlaybackEngine::PlayUrl(const BUrl &url, const char *title,
                 prebufferBytes, (long)prebufferStatus);
   }
 
-  fPlayer = new BSoundPlayer(&raf, "Orchester", &_PlayBuffer, NULL, this);
-  if (!fPlayer) {
+  st = _PreparePlayer(raf);
+  if (st != B_OK) {
     _CleanupMedia();
     fIsStreaming.store(false, std::memory_order_relaxed);
     return;
@@ -894,13 +905,7 @@ void AudioPlaybackEngine::Pause() {
 #if ENABLE_DLNA_OUTPUT
   if (fIsRemotePlaying && fDlnaManager) {
     DLNAService *mgr = fDlnaManager;
-    thread_id tid = spawn_thread(
-        [](void *arg) -> int32 {
-          ((DLNAService *)arg)->RendererPause();
-          return 0;
-        },
-        "dlna_pause", B_NORMAL_PRIORITY, mgr);
-    resume_thread(tid);
+    fRemoteCommands.Post([mgr] { mgr->RendererPause(); });
     fPaused.store(true, std::memory_order_relaxed);
     fPlaying.store(false, std::memory_order_relaxed);
     return;
@@ -914,6 +919,7 @@ void AudioPlaybackEngine::Pause() {
     fFadeOutFrames.store(0, std::memory_order_relaxed);
     fPaused.store(true, std::memory_order_relaxed);
     fPlaying.store(false, std::memory_order_relaxed);
+    _SetPlaybackDevice(-1);
   }
   if (fMidiSynth && fPlaying.load(std::memory_order_relaxed)) {
     BAutolock midiLock(&fMidiLock);
@@ -938,13 +944,7 @@ void AudioPlaybackEngine::Resume() {
 #if ENABLE_DLNA_OUTPUT
   if (fIsRemotePlaying && fDlnaManager) {
     DLNAService *mgr = fDlnaManager;
-    thread_id tid = spawn_thread(
-        [](void *arg) -> int32 {
-          ((DLNAService *)arg)->RendererPlay();
-          return 0;
-        },
-        "dlna_resume", B_NORMAL_PRIORITY, mgr);
-    resume_thread(tid);
+    fRemoteCommands.Post([mgr] { mgr->RendererPlay(); });
     fPaused.store(false, std::memory_order_relaxed);
     fPlaying.store(true, std::memory_order_relaxed);
     return;
@@ -957,6 +957,7 @@ void AudioPlaybackEngine::Resume() {
     fPlayer->SetHasData(true);
     fPaused.store(false, std::memory_order_relaxed);
     fPlaying.store(true, std::memory_order_relaxed);
+    _SetPlaybackDevice(fLocalDevice);
   }
   if (fMidiSynth && fPaused.load(std::memory_order_relaxed)) {
     BAutolock midiLock(&fMidiLock);
@@ -986,15 +987,12 @@ void AudioPlaybackEngine::_StopLocked(bool switching) {
 
 #if ENABLE_DLNA_OUTPUT
   if (fIsRemotePlaying && fDlnaManager && !switching) {
+    // Whatever is still queued for this track is moot now.
+    fRemoteCommands.Cancel(kRemoteSeek);
     DLNAService *mgr = fDlnaManager;
-    thread_id tid = spawn_thread(
-        [](void *arg) -> int32 {
-          ((DLNAService *)arg)->RendererStop();
-          return 0;
-        },
-        "dlna_stop", B_NORMAL_PRIORITY, mgr);
-    resume_thread(tid);
+    fRemoteCommands.Post([mgr] { mgr->RendererStop(); });
     fIsRemotePlaying = false;
+    _ForgetRemoteNext();
   }
 #endif
 
@@ -1007,6 +1005,11 @@ void AudioPlaybackEngine::_StopLocked(bool switching) {
   }
 
   _StopTimeUpdates();
+  // A track change keeps the device, so scans are not released in between.
+  if (!switching) {
+    fLocalDevice = -1;
+    _SetPlaybackDevice(-1);
+  }
   fAtEnd = true;
   fPlaying.store(false, std::memory_order_relaxed);
   fPaused.store(false, std::memory_order_relaxed);
@@ -1039,9 +1042,10 @@ void AudioPlaybackEngine::_StopLocked(bool switching) {
  * @brief Plays the next track in the queue, if available.
  */
 void AudioPlaybackEngine::PlayNext() {
-  if (!fQueue.empty()) {
-    if (fCurrentIdx + 1 < fQueue.size()) {
-      fCurrentIdx++;
+  if (fQueue.IsSet() && !fQueue->IsEmpty()) {
+    int32 next = fQueue->Next((int32)fCurrentIdx);
+    if (next >= 0) {
+      fCurrentIdx = next;
       Play(fCurrentIdx);
     } else {
       Stop();
@@ -1053,9 +1057,10 @@ void AudioPlaybackEngine::PlayNext() {
  * @brief Plays the previous track in the queue, if available.
  */
 void AudioPlaybackEngine::PlayPrev() {
-  if (!fQueue.empty()) {
-    if (fCurrentIdx > 0) {
-      fCurrentIdx--;
+  if (fQueue.IsSet() && !fQueue->IsEmpty()) {
+    int32 previous = fQueue->Previous((int32)fCurrentIdx);
+    if (previous >= 0) {
+      fCurrentIdx = previous;
       Play(fCurrentIdx);
     } else {
       Stop();
@@ -1073,44 +1078,15 @@ void AudioPlaybackEngine::SeekTo(bigtime_t pos) {
   if (fDlnaManager &&
       (fIsRemotePlaying.load(std::memory_order_relaxed) ||
        fDlnaManager->IsRemoteOutput())) {
-    static std::atomic<bool> sIsSeeking(false);
-    static std::atomic<bigtime_t> sPendingSeek(-1);
-    if (sIsSeeking.exchange(true)) {
-      sPendingSeek.store(pos, std::memory_order_relaxed);
-      return;
-    }
-
-    struct SeekData {
-      DLNAService *mgr;
-      bigtime_t pos;
-    };
-    SeekData *data = new SeekData{fDlnaManager, pos};
-    thread_id tid = spawn_thread(
-        [](void *arg) -> int32 {
-          SeekData *d = (SeekData *)arg;
-          for (;;) {
-            status_t err = d->mgr->RendererSeek(d->pos);
-            DEBUG_PRINT("DLNA seek to %lld returned %ld\n",
-                        (long long)d->pos, (long)err);
-
-            bigtime_t pending =
-                sPendingSeek.exchange(-1, std::memory_order_relaxed);
-            if (pending < 0 || pending == d->pos)
-              break;
-            d->pos = pending;
-          }
-          delete d;
-          sIsSeeking = false;
-          return 0;
+    // Only the latest target of a seek bar drag is sent.
+    DLNAService *mgr = fDlnaManager;
+    fRemoteCommands.Post(
+        [mgr, pos] {
+          status_t err = mgr->RendererSeek(pos);
+          DEBUG_PRINT("DLNA seek to %lld returned %ld\n", (long long)pos,
+                      (long)err);
         },
-        "dlna_seek", B_NORMAL_PRIORITY, data);
-    if (tid >= 0) {
-      resume_thread(tid);
-    } else {
-      delete data;
-      sPendingSeek.store(-1, std::memory_order_relaxed);
-      sIsSeeking = false;
-    }
+        kRemoteSeek);
     return;
   }
 #endif
@@ -1120,18 +1096,32 @@ void AudioPlaybackEngine::SeekTo(bigtime_t pos) {
   }
 
   if (fNetworkStream &&
-      fNetworkStream->GetMode() == NetworkAudioStreamIO::MODE_DLNA) {
+      (fNetworkStream->GetMode() == NetworkAudioStreamIO::MODE_DLNA ||
+       fNetworkStream->IsTimeShifted())) {
+    // A time-shifted live stream seeks inside its recorded window.
+    if (fNetworkStream->IsTimeShifted())
+      pos = std::max(pos, fNetworkStream->TimeShiftStart());
     status_t ret = fNetworkStream->SeekToTime(pos);
-    DEBUG_PRINT("DLNA local stream seek to %lld returned %ld\n",
+    DEBUG_PRINT("network stream seek to %lld returned %ld\n",
                 (long long)pos, (long)ret);
-    if (ret == B_OK)
+    if (ret == B_OK) {
       fCurrentPos = pos;
+      fClock.SetPosition(pos, 0);
+    }
     return;
   }
 
   if (!fTrack || fIsStreaming.load(std::memory_order_relaxed) || fIsMidiPlaying)
     return;
 
+  // The decoder thread owns the track; it seeks and flushes the ring.
+  if (fDecoderThread >= 0) {
+    fSeekTarget.store(pos, std::memory_order_relaxed);
+    fSeekSerial.fetch_add(1, std::memory_order_release);
+    fClock.SetPosition(pos, 0);
+    return;
+  }
+
   bigtime_t newTime = pos;
   status_t ret = fTrack->SeekToTime(&newTime, B_MEDIA_SEEK_CLOSEST_BACKWARD);
   if (ret == B_OK) {
@@ -1139,6 +1129,791 @@ void AudioPlaybackEngine::SeekTo(bigtime_t pos) {
   }
 }
 
+void AudioPlaybackEngine::SetDecodeAhead(bigtime_t depth) {
+  fDecodeAhead = std::max<bigtime_t>(depth, 50000);
+}
+
+void AudioPlaybackEngine::SetCrossfade(bigtime_t duration) {
+  fCrossfade.store(std::max<bigtime_t>(0, std::min(duration, kMaxCrossfade)),
+                   std::memory_order_relaxed);
+}
+
+void AudioPlaybackEngine::SetOutputRate(int32 rate) {
+  fOutputRate.store(std::max<int32>(0, rate), std::memory_order_relaxed);
+}
+
+void AudioPlaybackEngine::SetStreamBandwidthCap(int64 bitsPerSecond) {
+  HlsSegmentFetcher::SetBandwidthCap(bitsPerSecond);
+}
+
+void AudioPlaybackEngine::SetTimeShiftWindow(bigtime_t window) {
+  NetworkAudioStreamIO::SetTimeShiftWindow(window);
+}
+
+bool AudioPlaybackEngine::IsTimeShifted() const {
+  return fNetworkStream != nullptr && fNetworkStream->IsTimeShifted();
+}
+
+status_t AudioPlaybackEngine::StartRecording(const BString &directory,
+                                             const BString &station) {
+  if (fNetworkStream == nullptr || !fNetworkStream->IsRunning())
+    return B_NOT_ALLOWED;
+  fNetworkStream->StartRecording(directory, station);
+  return B_OK;
+}
+
+void AudioPlaybackEngine::StopRecording() {
+  if (fNetworkStream != nullptr)
+    fNetworkStream->StopRecording();
+}
+
+bool AudioPlaybackEngine::IsRecording() const {
+  return fNetworkStream != nullptr && fNetworkStream->IsRecording();
+}
+
+void AudioPlaybackEngine::SetDsp(const DspSettings &settings) {
+  fDsp.SetSettings(settings);
+}
+
+void AudioPlaybackEngine::SetNormalization(int32 mode) {
+  if (mode < ReplayGain::kOff || mode > ReplayGain::kAlbum)
+    mode = ReplayGain::kOff;
+  fNormalization.store(mode, std::memory_order_relaxed);
+  fGainSerial.fetch_add(1, std::memory_order_release);
+}
+
+/**
+ * @brief Linear normalization factor of queue entry `index`; unity unless
+ * it was published by _PublishGain().
+ */
+float AudioPlaybackEngine::_GainFor(int32 index) {
+  int32 mode = fNormalization.load(std::memory_order_relaxed);
+  BAutolock lock(fGaplessLock);
+  for (const auto &entry : fPublishedGains) {
+    if (entry.first == index)
+      return entry.second.Factor(mode);
+  }
+  return 1.0f;
+}
+
+/**
+ * @brief Hands the gains of queue entry `index` to the decoder thread,
+ * which never reads the queue itself.
+ *
+ * A few entries are kept, enough for the current, the armed and a track
+ * still fading out.
+ */
+void AudioPlaybackEngine::_PublishGain(int32 index) {
+  if (!fQueue.IsSet() || !fQueue->IsValid(index))
+    return;
+  ReplayGain gain = fQueue->GainAt(index);
+  {
+    BAutolock lock(fGaplessLock);
+    auto it = std::find_if(
+        fPublishedGains.begin(), fPublishedGains.end(),
+        [index](const std::pair<int32, ReplayGain> &entry) {
+          return entry.first == index;
+        });
+    if (it != fPublishedGains.end())
+      fPublishedGains.erase(it);
+    else if (fPublishedGains.size() >= kPublishedGains)
+      fPublishedGains.erase(fPublishedGains.begin());
+    fPublishedGains.push_back(std::make_pair(index, gain));
+  }
+  fGainSerial.fetch_add(1, std::memory_order_release);
+}
+
+/** @brief Scales `size` bytes of decoded frames by `gain` in place. */
+void AudioPlaybackEngine::_ApplyGain(void *data, size_t size, float gain) {
+  if (gain == 1.0f || size == 0 || !PcmKernels::Supports(fDecodeFormat.format))
+    return;
+  PcmKernels::ApplyGainRamp(data, fDecodeFormat.format,
+                            (int32)fDecodeFormat.channel_count,
+                            (int64)(size / fDecodeFrameSize), gain, 0.0f);
+}
+
+status_t AudioPlaybackEngine::_ReadFrames(BMediaTrack *track, void *buffer,
+                                          int64 *frames) {
+  bigtime_t start = system_time();
+  status_t status = track->ReadFrames(buffer, frames);
+  fHealth.RecordRead(system_time() - start);
+  return status;
+}
+
+/**
+ * @brief Sizes the ring for `output` and starts the decoder thread, which
+ * reads `format` and converts it if the two differ.
+ *
+ * Waits briefly for the first chunk so playback does not open on an
+ * underrun.
+ */
+status_t AudioPlaybackEngine::_StartDecoder(
+    const media_raw_audio_format &format,
+    const media_raw_audio_format &output) {
+  const int bytesPerSample =
+      format.format & media_raw_audio_format::B_AUDIO_SIZE_MASK;
+  const size_t frameSize = (size_t)bytesPerSample * format.channel_count;
+  if (frameSize == 0 || format.frame_rate <= 0)
+    return B_BAD_VALUE;
+
+  fDecodeFormat = format;
+  fDecodeFrameSize = frameSize;
+  fDecodeChunkSize = format.buffer_size > 0 ? format.buffer_size
+                                            : 4096 * frameSize;
+
+  status_t status = B_OK;
+  size_t outputChunkSize = fDecodeChunkSize;
+  fConverting = !SamePlayerFormat(format, output);
+  if (fConverting) {
+    status = fConverter.SetTo(format, output.frame_rate,
+                              (int32)output.channel_count);
+    if (status != B_OK)
+      return status;
+    outputChunkSize = fConverter.MaxOutputSize(fDecodeChunkSize);
+  }
+  fOutputFrameSize =
+      (size_t)(output.format & media_raw_audio_format::B_AUDIO_SIZE_MASK) *
+      output.channel_count;
+
+  size_t depth = (size_t)(output.frame_rate * (fDecodeAhead / 1000000.0)) *
+                 fOutputFrameSize;
+  status = fRing.SetCapacity(std::max(depth, 2 * outputChunkSize));
+  if (status != B_OK)
+    return status;
+
+  fDecoderQuit.store(false, std::memory_order_relaxed);
+  fDecodeEnded.store(false, std::memory_order_relaxed);
+  fUnderruns.store(0, std::memory_order_relaxed);
+  fDecoderThread = spawn_thread(_DecoderEntry, "audio decoder",
+                                B_URGENT_DISPLAY_PRIORITY, this);
+  if (fDecoderThread < 0) {
+    status = fDecoderThread;
+    fDecoderThread = -1;
+    return status;
+  }
+  resume_thread(fDecoderThread);
+
+  bigtime_t deadline = system_time() + 200000;
+  while (fRing.Available() == 0 &&
+         !fDecodeEnded.load(std::memory_order_acquire) &&
+         system_time() < deadline)
+    snooze(2000);
+  return B_OK;
+}
+
+void AudioPlaybackEngine::_StopDecoder() {
+  if (fDecoderThread < 0)
+    return;
+
+  fDecoderQuit.store(true, std::memory_order_relaxed);
+  status_t result;
+  wait_for_thread(fDecoderThread, &result);
+  fDecoderThread = -1;
+  fRing.Clear();
+  _ReleaseHandoff();
+
+  int32 underruns = fUnderruns.load(std::memory_order_relaxed);
+  if (underruns > 0)
+    DEBUG_PRINT("decoder: %ld underruns\n", (long)underruns);
+}
+
+int32 AudioPlaybackEngine::_DecoderEntry(void *cookie) {
+  static_cast<AudioPlaybackEngine *>(cookie)->_DecodeLoop();
+  return 0;
+}
+
+void AudioPlaybackEngine::_DecodeLoop() {
+  std::vector<uint8> chunk(fDecodeChunkSize);
+  size_t pending = 0; ///< Decoded bytes not yet in the ring
+  size_t pendingOffset = 0;
+  // With a fixed output rate, `pending` counts bytes of `converted`.
+  std::vector<uint8> converted;
+  bool flushed = false; ///< The converter's tail went out after EOF
+  if (fConverting)
+    fConverter.Reset();
+  fDsp.Prepare(fDecodeFormat, (int64)(fDecodeChunkSize / fDecodeFrameSize));
+  int32 seekSerial = fSeekSerial.load(std::memory_order_acquire);
+
+  BMediaTrack *track = fTrack;
+  bigtime_t duration = fDuration;
+  bigtime_t decodedPos = 0;
+  const float frameRate = fDecodeFormat.frame_rate;
+
+  // Points are only recorded while the position is known exactly: from the
+  // start, after a seek to a point, and across a gapless switch.
+  SeekIndex seekIndex;
+  seekIndex.SetTo(fDecodePath.c_str(), frameRate);
+  bool indexing = true;
+  int64 decodedFrames = 0; ///< Exact position while `indexing`
+  int64 skipFrames = 0;    ///< Decoded frames to drop to reach a seek target
+
+  // Frames the prefetcher decoded already; the track continues after them.
+  std::vector<uint8> primed;
+  primed.swap(fPrimed);
+  size_t primedOffset = 0;
+
+  // Normalization factors of the current and the outgoing track.
+  int32 trackIndex = (int32)fCurrentIdx;
+  int32 outgoingIndex = -1;
+  int32 gainSerial = fGainSerial.load(std::memory_order_acquire);
+  float gain = _GainFor(trackIndex);
+  float outgoingGain = 1.0f;
+
+  // The primed next track, if any.
+  BMediaFile *nextFile = nullptr;
+  BMediaTrack *nextTrack = nullptr;
+  std::vector<uint8> nextChunk;
+  size_t nextPrimed = 0;
+  int32 nextIndex = -1;
+  float nextGain = 1.0f;
+  bool nextTried = false;
+
+  // While crossfading, `track` is the incoming track and `outgoing` the one
+  // fading out; the incoming frames wait in their own ring to be mixed in.
+  const bool canMix = CrossfadeMixer::Supports(fDecodeFormat);
+  BMediaTrack *outgoing = nullptr;
+  CrossfadeMixer mixer;
+  PcmRingBuffer incoming;
+  std::vector<uint8> incomingChunk;
+  std::vector<uint8> mixChunk;
+  bool incomingEnded = false;
+  if (canMix && incoming.SetCapacity(2 * fDecodeChunkSize) == B_OK) {
+    incomingChunk.resize(fDecodeChunkSize);
+    mixChunk.resize(fDecodeChunkSize);
+  }
+
+  // Shorter than the time one chunk plays at any common rate.
+  const bigtime_t kIdleWait = 5000;
+
+  while (!fDecoderQuit.load(std::memory_order_relaxed)) {
+    // The primed chunk of the next track keeps the factor it was read with.
+    int32 currentGainSerial = fGainSerial.load(std::memory_order_acquire);
+    if (currentGainSerial != gainSerial) {
+      gainSerial = currentGainSerial;
+      gain = _GainFor(trackIndex);
+      outgoingGain = _GainFor(outgoingIndex);
+    }
+
+    int32 serial = fSeekSerial.load(std::memory_order_acquire);
+    if (serial != seekSerial) {
+      seekSerial = serial;
+      bigtime_t newTime = fSeekTarget.load(std::memory_order_relaxed);
+      int64 target = (int64)(newTime * (double)frameRate / 1000000.0);
+      int64 landed = 0;
+      bool exact = false;
+      if (seekIndex.Seek(track, target, landed, exact) == B_OK) {
+        // Decode forward from where the decoder landed to the target.
+        skipFrames = landed < target &&
+                             (target - landed) * 1000000.0 / frameRate <=
+                                 SeekIndex::kMaxSkip
+                         ? target - landed
+                         : 0;
+        decodedFrames = landed + skipFrames;
+        newTime = (bigtime_t)(decodedFrames * 1000000.0 / frameRate);
+        indexing = exact;
+        // A seek during a crossfade lands in the incoming track.
+        if (outgoing != nullptr) {
+          _EndOverlap();
+          outgoing = nullptr;
+        }
+        incoming.Clear();
+        incomingEnded = false;
+        primed.clear();
+        primedOffset = 0;
+        pending = 0;
+        fRing.DiscardWritten();
+        if (fConverting)
+          fConverter.Reset();
+        fDsp.Reset();
+        flushed = false;
+        fCurrentPos = newTime;
+        decodedPos = newTime;
+        if (nextFile == nullptr)
+          nextTried = false;
+        // A seek inside the switched-to track moves its boundary along.
+        if (fHandoffState.load(std::memory_order_acquire) ==
+            kHandoffSwitched) {
+          fHandoffBase.store(newTime, std::memory_order_relaxed);
+          fHandoffPosition.store(fRing.WritePosition(),
+                                 std::memory_order_relaxed);
+        }
+        fDecodeEnded.store(false, std::memory_order_release);
+      }
+    }
+
+    bigtime_t crossfade = 0;
+    if (!mixChunk.empty())
+      crossfade = std::min(fCrossfade.load(std::memory_order_relaxed),
+                           duration / 2);
+    bigtime_t lead = std::max(kGaplessLead, crossfade + 1000000);
+
+    if (!nextTried && duration > 0 && decodedPos >= duration - lead &&
+        fHandoffState.load(std::memory_order_acquire) == kHandoffNone) {
+      nextTried = true;
+      if (_OpenGaplessNext(nextFile, nextTrack, nextChunk, nextPrimed,
+                           nextIndex)) {
+        nextGain = _GainFor(nextIndex);
+        _ApplyGain(nextChunk.data(), nextPrimed, nextGain);
+      }
+    }
+
+    if (pending == 0) {
+      if (outgoing == nullptr && nextFile != nullptr && crossfade > 0 &&
+          decodedPos >= duration - crossfade &&
+          primedOffset >= primed.size() && _StillArmed(nextIndex)) {
+        bigtime_t overlap =
+            std::min(duration - decodedPos, nextTrack->Duration() / 2);
+        _PublishSwitch(nextFile, nextTrack, nextIndex);
+        {
+          BAutolock lock(fGaplessLock);
+          fOverlapActive = true;
+        }
+        outgoing = track;
+        outgoingIndex = trackIndex;
+        outgoingGain = gain;
+        track = nextTrack;
+        trackIndex = nextIndex;
+        gain = nextGain;
+        duration = nextTrack->Duration();
+        decodedPos = 0;
+        seekIndex.SetTo(fHandoffPath.c_str(), frameRate);
+        indexing = false;
+        skipFrames = 0;
+        incoming.Clear();
+        incoming.Write(nextChunk.data(), nextPrimed);
+        incomingEnded = false;
+        mixer.Reset(fDecodeFormat,
+                    (int64)(overlap * (double)frameRate / 1000000.0));
+        nextFile = nullptr;
+        nextTrack = nullptr;
+        nextTried = false;
+        DEBUG_PRINT("decoder: crossfading into queue index %ld\n",
+                    (long)nextIndex);
+      }
+
+      if (fDecodeEnded.load(std::memory_order_relaxed)) {
+        snooze(kIdleWait);
+        continue;
+      }
+      int64 frames = (int64)(chunk.size() / fDecodeFrameSize);
+
+      if (outgoing != nullptr) {
+        status_t ret = _ReadFrames(outgoing, chunk.data(), &frames);
+        if (ret != B_OK || frames <= 0) {
+          // The outgoing track ran out; the incoming one goes on alone.
+          _EndOverlap();
+          outgoing = nullptr;
+          continue;
+        }
+        size_t bytes =
+            std::min(chunk.size(), (size_t)frames * fDecodeFrameSize);
+        _ApplyGain(chunk.data(), bytes, outgoingGain);
+        while (incoming.Available() < bytes && !incomingEnded) {
+          int64 incomingFrames =
+              (int64)(incomingChunk.size() / fDecodeFrameSize);
+          if (_ReadFrames(track, incomingChunk.data(), &incomingFrames) !=
+                  B_OK ||
+              incomingFrames <= 0) {
+            incomingEnded = true;
+            break;
+          }
+          size_t incomingBytes =
+              std::min(incomingChunk.size(),
+                       (size_t)incomingFrames * fDecodeFrameSize);
+          _ApplyGain(incomingChunk.data(), incomingBytes, gain);
+          incoming.Write(incomingChunk.data(), incomingBytes);
+        }
+        size_t have = incoming.Read(mixChunk.data(), bytes);
+        memset(mixChunk.data() + have, 0, bytes - have);
+        mixer.Mix(chunk.data(), mixChunk.data(), frames);
+        pending = bytes;
+        pendingOffset = 0;
+        decodedPos += (bigtime_t)(frames * 1000000LL / frameRate);
+        if (mixer.Done()) {
+          _EndOverlap();
+          outgoing = nullptr;
+        }
+      } else if (incoming.Available() > 0) {
+        pending = incoming.Read(chunk.data(), chunk.size());
+        pendingOffset = 0;
+        decodedPos += (bigtime_t)(pending / fDecodeFrameSize * 1000000LL /
+                                  frameRate);
+      } else {
+        const bool fromPrimed = !incomingEnded && primedOffset < primed.size();
+        status_t ret = B_LAST_BUFFER_ERROR;
+        if (fromPrimed) {
+          size_t bytes = std::min(chunk.size(), primed.size() - primedOffset);
+          memcpy(chunk.data(), primed.data() + primedOffset, bytes);
+          primedOffset += bytes;
+          frames = (int64)(bytes / fDecodeFrameSize);
+          ret = B_OK;
+        } else if (!incomingEnded) {
+          ret = _ReadFrames(track, chunk.data(), &frames);
+        }
+        if (ret == B_OK && frames > 0 && skipFrames > 0) {
+          int64 drop = std::min(frames, skipFrames);
+          skipFrames -= drop;
+          frames -= drop;
+          memmove(chunk.data(), chunk.data() + drop * fDecodeFrameSize,
+                  (size_t)frames * fDecodeFrameSize);
+          if (frames == 0)
+            continue;
+        }
+        if (ret == B_OK && frames > 0) {
+          pending = std::min(chunk.size(), (size_t)frames * fDecodeFrameSize);
+          _ApplyGain(chunk.data(), pending, gain);
+          pendingOffset = 0;
+          decodedPos += (bigtime_t)(frames * 1000000LL / frameRate);
+          decodedFrames += frames;
+          if (indexing && !fromPrimed)
+            seekIndex.Record(decodedFrames, track->CurrentFrame());
+        } else {
+          if (nextFile == nullptr || !_StillArmed(nextIndex)) {
+            if (!fConverting || flushed) {
+              fDecodeEnded.store(true, std::memory_order_release);
+              continue;
+            }
+            // Silence pushes out the frames the resampler still holds.
+            flushed = true;
+            pending = std::min(chunk.size(),
+                               (size_t)fConverter.Latency() * fDecodeFrameSize);
+            memset(chunk.data(), 0, pending);
+            pendingOffset = 0;
+          } else {
+            // Continue with the primed track right behind the last chunk.
+            _PublishSwitch(nextFile, nextTrack, nextIndex);
+            track = nextTrack;
+            trackIndex = nextIndex;
+            gain = nextGain;
+            duration = nextTrack->Duration();
+            decodedPos = (bigtime_t)(nextPrimed / fDecodeFrameSize *
+                                     1000000LL / frameRate);
+            seekIndex.SetTo(fHandoffPath.c_str(), frameRate);
+            indexing = true;
+            decodedFrames = (int64)(nextPrimed / fDecodeFrameSize);
+            skipFrames = 0;
+            chunk.swap(nextChunk);
+            pending = nextPrimed;
+            pendingOffset = 0;
+            incomingEnded = false;
+            nextFile = nullptr;
+            nextTrack = nullptr;
+            nextTried = false;
+            DEBUG_PRINT("decoder: gapless switch to queue index %ld\n",
+                        (long)nextIndex);
+          }
+        }
+      }
+
+      // Then the DSP chain, on the mixed stream in its native format.
+      if (pending > 0)
+        fDsp.Process(chunk.data(), (int64)(pending / fDecodeFrameSize));
+
+      // Conversion is the last step, after gain, mixing and the DSP chain.
+      if (pending > 0 && fConverting)
+        pending = fConverter.Convert(chunk.data(), pending, converted);
+    }
+
+    // Whole frames only, so the callback never reads half a frame.
+    const uint8 *source = fConverting ? converted.data() : chunk.data();
+    size_t space = fRing.Space();
+    size_t amount = std::min(pending, space - space % fOutputFrameSize);
+    size_t written = fRing.Write(source + pendingOffset, amount);
+    pending -= written;
+    pendingOffset += written;
+    if (pending > 0)
+      snooze(kIdleWait);
+  }
+
+  seekIndex.Save();
+  if (outgoing != nullptr)
+    _EndOverlap();
+  if (nextFile != nullptr) {
+    nextFile->ReleaseTrack(nextTrack);
+    delete nextFile;
+  }
+}
+
+/**
+ * @brief Whether `index` is still the armed next entry; copies its path for
+ * the handoff if so.
+ */
+bool AudioPlaybackEngine::_StillArmed(int32 index) {
+  BAutolock lock(fGaplessLock);
+  if (fGaplessIndex != index)
+    return false;
+  fHandoffPath = fGaplessPath;
+  return true;
+}
+
+/**
+ * @brief Publishes that the ring continues with `track` from its current
+ * write position on (decoder thread).
+ */
+void AudioPlaybackEngine::_PublishSwitch(BMediaFile *file, BMediaTrack *track,
+                                         int32 index) {
+  fHandoffFile = file;
+  fHandoffTrack = track;
+  fHandoffIndex = index;
+  fHandoffBase.store(0, std::memory_order_relaxed);
+  fHandoffPosition.store(fRing.WritePosition(), std::memory_order_relaxed);
+  fHandoffState.store(kHandoffSwitched, std::memory_order_release);
+}
+
+/**
+ * @brief Ends a crossfade on the decoder side; frees the outgoing track if
+ * CompleteGaplessHandoff() already retired it.
+ */
+void AudioPlaybackEngine::_EndOverlap() {
+  BMediaFile *file = nullptr;
+  BMediaTrack *track = nullptr;
+  {
+    BAutolock lock(fGaplessLock);
+    fOverlapActive = false;
+    file = fRetiredFile;
+    track = fRetiredTrack;
+    fRetiredFile = nullptr;
+    fRetiredTrack = nullptr;
+  }
+  if (file != nullptr) {
+    file->ReleaseTrack(track);
+    delete file;
+  }
+}
+
+/**
+ * @brief Opens and primes the armed next entry (decoder thread).
+ * @return true if it decodes to exactly the current format.
+ */
+bool AudioPlaybackEngine::_OpenGaplessNext(BMediaFile *&file,
+                                           BMediaTrack *&track,
+                                           std::vector<uint8> &chunk,
+                                           size_t &primed, int32 &index) {
+  std::string path;
+  {
+    BAutolock lock(fGaplessLock);
+    index = fGaplessIndex;
+    path = fGaplessPath;
+  }
+  if (index < 0 || path.empty())
+    return false;
+
+  BString lower(path.c_str());
+  lower.ToLower();
+  if ((lower.EndsWith(".mid") || lower.EndsWith(".midi")) &&
+      !LocalMediaFile::RendersMidi())
+    return false;
+
+  entry_ref ref;
+  if (get_ref_for_path(path.c_str(), &ref) != B_OK)
+    return false;
+
+  file = LocalMediaFile::Open(ref);
+  track = file->InitCheck() == B_OK ? file->TrackAt(0) : nullptr;
+  bool ok = track != nullptr;
+
+  if (ok) {
+    media_format format;
+    format.type = B_MEDIA_RAW_AUDIO;
+    format.u.raw_audio = fDecodeFormat;
+    const media_raw_audio_format &raw = format.u.raw_audio;
+    ok = track->DecodedFormat(&format) == B_OK &&
+         format.type == B_MEDIA_RAW_AUDIO &&
+         raw.frame_rate == fDecodeFormat.frame_rate &&
+         raw.channel_count == fDecodeFormat.channel_count &&
+         raw.format == fDecodeFormat.format &&
+         raw.byte_order == fDecodeFormat.byte_order &&
+         raw.buffer_size <= fDecodeChunkSize;
+  }
+
+  if (ok) {
+    chunk.resize(fDecodeChunkSize);
+    int64 frames = (int64)(chunk.size() / fDecodeFrameSize);
+    ok = _ReadFrames(track, chunk.data(), &frames) == B_OK && frames > 0;
+    primed = ok ? std::min(chunk.size(), (size_t)frames * fDecodeFrameSize)
+                : 0;
+  }
+
+  if (!ok) {
+    DEBUG_PRINT("decoder: %s cannot follow gaplessly\n", path.c_str());
+    if (track != nullptr)
+      file->ReleaseTrack(track);
+    delete file;
+    file = nullptr;
+    track = nullptr;
+  }
+  return ok;
+}
+
+/**
+ * @brief Frees a switched-to track nobody adopted; decoder must be stopped.
+ */
+void AudioPlaybackEngine::_ReleaseHandoff() {
+  if (fHandoffFile != nullptr) {
+    fHandoffFile->ReleaseTrack(fHandoffTrack);
+    delete fHandoffFile;
+  }
+  if (fRetiredFile != nullptr) {
+    fRetiredFile->ReleaseTrack(fRetiredTrack);
+    delete fRetiredFile;
+  }
+  fRetiredFile = nullptr;
+  fRetiredTrack = nullptr;
+  fOverlapActive = false;
+  fHandoffFile = nullptr;
+  fHandoffTrack = nullptr;
+  fHandoffIndex = -1;
+  fHandoffState.store(kHandoffNone, std::memory_order_release);
+}
+
+void AudioPlaybackEngine::SetGaplessNext(int32 index) {
+  const bool valid = fQueue.IsSet() && fQueue->IsValid(index);
+  if (valid)
+    _PublishGain(index);
+  {
+    BAutolock lock(fGaplessLock);
+    if (valid) {
+      fGaplessIndex = index;
+      fGaplessPath = fQueue->PathAt(index).String();
+    } else {
+      fGaplessIndex = -1;
+      fGaplessPath.clear();
+    }
+  }
+  _UpdatePrefetch();
+#if ENABLE_DLNA_OUTPUT
+  if (fIsRemotePlaying.load(std::memory_order_relaxed))
+    _QueueRemoteEntry(valid ? index : -1);
+#endif
+}
+
+void AudioPlaybackEngine::SetRemoteNextUrl(const BString &url,
+                                           const BString &title,
+                                           int32 durationSeconds) {
+#if ENABLE_DLNA_OUTPUT
+  if (!fIsRemotePlaying.load(std::memory_order_relaxed) ||
+      fDlnaManager == nullptr)
+    return;
+  {
+    BAutolock lock(fGaplessLock);
+    fRemoteNextIndex = -1;
+    fRemoteNextUrl = url;
+    fRemoteNextTitle = title;
+    fRemoteNextDuration = (bigtime_t)durationSeconds * 1000000;
+  }
+  DLNAService *mgr = fDlnaManager;
+  fRemoteCommands.Post([mgr, url, title] {
+    mgr->SetNextAVTransportURI(url, title);
+  });
+#else
+  (void)url;
+  (void)title;
+  (void)durationSeconds;
+#endif
+}
+
+/**
+ * @brief Points the prefetcher at the armed gapless entry and the entries
+ * after the current one.
+ */
+void AudioPlaybackEngine::_UpdatePrefetch() {
+#if ENABLE_DLNA_OUTPUT
+  if (fIsRemotePlaying.load(std::memory_order_relaxed)) {
+    fPrefetcher.Clear();
+    return;
+  }
+#endif
+  std::vector<std::string> wanted;
+  {
+    BAutolock lock(fGaplessLock);
+    if (!fGaplessPath.empty())
+      wanted.push_back(fGaplessPath);
+  }
+  if (fQueue.IsSet()) {
+    for (int32 i = fQueue->Next((int32)fCurrentIdx);
+         i >= 0 && (int32)wanted.size() <= TrackPrefetcher::kDepth;
+         i = fQueue->Next(i))
+      wanted.push_back(fQueue->PathAt(i).String());
+  }
+
+  // Unless they are rendered, MIDI files are played by the synth.
+  if (!LocalMediaFile::RendersMidi()) {
+    wanted.erase(std::remove_if(wanted.begin(), wanted.end(),
+                                [](const std::string &path) {
+                                  BString lower(path.c_str());
+                                  lower.ToLower();
+                                  return lower.EndsWith(".mid") ||
+                                         lower.EndsWith(".midi");
+                                }),
+                 wanted.end());
+  }
+  fPrefetcher.SetWanted(wanted);
+}
+
+bool AudioPlaybackEngine::CompleteGaplessHandoff() {
+  BAutolock lock(fPlayLock);
+#if ENABLE_DLNA_OUTPUT
+  if (fIsRemotePlaying.load(std::memory_order_relaxed))
+    return _CompleteRemoteHandoff();
+#endif
+  if (fHandoffState.load(std::memory_order_acquire) != kHandoffReached ||
+      fHandoffFile == nullptr)
+    return false;
+
+  // After a gapless switch the decoder is done with the old track; during a
+  // crossfade it still reads it and frees it once the overlap ends.
+  BMediaFile *oldFile = fMediaFile;
+  BMediaTrack *oldTrack = fTrack;
+  std::string path = fHandoffPath;
+  {
+    BAutolock gaplessLock(fGaplessLock);
+    if (fOverlapActive) {
+      fRetiredFile = oldFile;
+      fRetiredTrack = oldTrack;
+      oldFile = nullptr;
+    }
+    fGaplessIndex = -1;
+    fGaplessPath.clear();
+  }
+  if (oldFile != nullptr) {
+    oldFile->ReleaseTrack(oldTrack);
+    delete oldFile;
+  }
+
+  fMediaFile = fHandoffFile;
+  fTrack = fHandoffTrack;
+  fHandoffFile = nullptr;
+  fHandoffTrack = nullptr;
+
+  fCurrentIdx = fHandoffIndex;
+  fDuration = fTrack->Duration();
+  fClock.SetTrack(fDuration, (float)fCurrentSampleRate.load(),
+                  fCurrentChannels.load(), fCurrentPos.load());
+  media_format encFmt;
+  fTrack->EncodedFormat(&encFmt);
+  fCurrentBitrate.store(encFmt.type == B_MEDIA_ENCODED_AUDIO
+                            ? encFmt.u.encoded_audio.bit_rate / 1000
+                            : 0);
+
+  fHandoffState.store(kHandoffNone, std::memory_order_release);
+
+  entry_ref ref;
+  if (get_ref_for_path(path.c_str(), &ref) == B_OK) {
+    fLocalDevice = ref.device;
+    _SetPlaybackDevice(fLocalDevice);
+  }
+
+  if (fTarget.IsValid()) {
+    BMessage m(MSG_NOW_PLAYING);
+    m.AddInt32("index", (int32)fCurrentIdx);
+    m.AddString("path", path.c_str());
+    m.AddBool("gapless", true);
+    fTarget.SendMessage(&m);
+  }
+  _UpdatePrefetch();
+  return true;
+}
+
 bool AudioPlaybackEngine::IsPlaying() const {
   return fPlaying.load(std::memory_order_relaxed) &&
          !fPaused.load(std::memory_order_relaxed);
@@ -1159,6 +1934,11 @@ void AudioPlaybackEngine::Shutdown() {
   }
 
   _CleanupMedia();
+  _DeletePlayer();
+  fPrefetcher.Clear();
+#if ENABLE_DLNA_OUTPUT
+  fRemoteCommands.Quit();
+#endif
   fTarget = BMessenger();
   fPlaying.store(false, std::memory_order_relaxed);
   fPaused.store(false, std::memory_order_relaxed);
@@ -1170,9 +1950,25 @@ bool AudioPlaybackEngine::IsPaused() const {
 
 int32 AudioPlaybackEngine::CurrentIndex() const { return fCurrentIdx; }
 
-void AudioPlaybackEngine::SetQueue(const std::vector<std::string> &queue) {
-  fQueue = queue;
+void AudioPlaybackEngine::SetQueue(PlaybackQueue *queue) {
+  fQueue.SetTo(queue);
   fCurrentIdx = 0;
+  // Entries still in the queue stay warm for the Play() that follows.
+  fPrefetcher.Retain([queue](const std::string &path) {
+    if (queue == nullptr)
+      return false;
+    for (int32 i = queue->First(); i >= 0; i = queue->Next(i)) {
+      if (queue->PathAt(i) == path.c_str())
+        return true;
+    }
+    return false;
+  });
+  {
+    BAutolock lock(fGaplessLock);
+    fPublishedGains.clear();
+  }
+  fGainSerial.fetch_add(1, std::memory_order_release);
+  SetGaplessNext(-1);
 }
 
 bigtime_t AudioPlaybackEngine::CurrentPosition() const {
@@ -1236,11 +2032,25 @@ bigtime_t AudioPlaybackEngine::Duration() const {
   return fDuration;
 }
 
+BString AudioPlaybackEngine::HealthReport() const {
+  BString report;
+  report.SetToFormat("Track: %ld Hz, %ld channels, %ld kbit/s\n"
+                     "Output: %ld Hz%s, decode ahead %lld ms\n\n",
+                     (long)CurrentSampleRate(), (long)CurrentChannels(),
+                     (long)CurrentBitrate(), (long)CurrentOutputRate(),
+                     fConverting ? " (converted)" : "",
+                     (long long)fDecodeAhead / 1000);
+  report << fHealth.Report();
+  report << HttpConnectionPool::Default().Report();
+  return report;
+}
+
 /**
  * @brief Static audio buffer callback for BSoundPlayer.
  *
- * Reads decoded frames from BMediaTrack and fills the audio buffer.
- * Handles end-of-track detection and notification.
+ * Copies decoded frames from the decode-ahead ring (or the network stream)
+ * into the audio buffer. A short ring is counted as an underrun and padded
+ * with silence; an empty ring after the decoder finished ends the track.
  */
 void AudioPlaybackEngine::_PlayBuffer(
     void *cookie, void *buffer, size_t size,
@@ -1252,6 +2062,7 @@ void AudioPlaybackEngine::_PlayBuffer(
   }
 
   self->fInCallback.store(true, std::memory_order_relaxed);
+  AudioHealthStats::CallbackScope healthScope(self->fHealth);
 
   if (self->fShuttingDown.load(std::memory_order_relaxed) ||
       self->fAtEnd.load(std::memory_order_relaxed)) {
@@ -1262,6 +2073,7 @@ void AudioPlaybackEngine::_PlayBuffer(
 
   if (self->fNetworkStream) {
     ssize_t read = self->fNetworkStream->ReadPcm(buffer, size);
+    self->fHealth.RecordNetworkRead(read, size);
     if (read < 0) {
       memset(buffer, 0, size);
       if (self->fIsStreaming.load(std::memory_order_relaxed)) {
@@ -1292,14 +2104,20 @@ void AudioPlaybackEngine::_PlayBuffer(
       if ((size_t)read < size)
         memset((uint8 *)buffer + read, 0, size - read);
       self->_ApplyFade(buffer, (size_t)read, format);
+      self->fAnalysis.Feed(buffer, (size_t)read, format);
       const int bytesPerSample =
           format.format & media_raw_audio_format::B_AUDIO_SIZE_MASK;
       const int frameSize = bytesPerSample * format.channel_count;
       if (frameSize > 0) {
         int64 frames = (int64)read / frameSize;
-        self->fCurrentPos +=
+        bigtime_t span =
             (bigtime_t)((frames * 1000000LL) / (int)format.frame_rate);
+        self->fCurrentPos += span;
+        self->fClock.SetPosition(self->fCurrentPos.load(), span);
       }
+      // The seek bar of a time-shifted stream ends at the live edge.
+      if (self->fNetworkStream->IsTimeShifted())
+        self->fClock.SetDuration(self->fNetworkStream->TimeShiftEnd());
     }
     self->fInCallback.store(false, std::memory_order_relaxed);
     return;
@@ -1311,21 +2129,61 @@ void AudioPlaybackEngine::_PlayBuffer(
     return;
   }
 
+  // Decoding happens on the decoder thread; here we only copy. The end
+  // flag is read first, so "ended and empty" cannot miss a final chunk.
   const int bytesPerSample =
       format.format & media_raw_audio_format::B_AUDIO_SIZE_MASK;
   const int frameSize = bytesPerSample * format.channel_count;
-  int64 frames = frameSize > 0 ? (int64)(size / frameSize) : 0;
-  status_t ret = B_ERROR;
-  if (self->fTrack && frames > 0)
-    ret = self->fTrack->ReadFrames(buffer, &frames);
+  const bool decodeEnded =
+      self->fDecodeEnded.load(std::memory_order_acquire);
+  self->fHealth.RecordFill(self->fRing.Available(), self->fRing.Capacity());
+  uint64 start = 0;
+  size_t produced = self->fRing.Read(buffer, size, &start);
+
+  // Crossing into a gaplessly appended track restarts the position there.
+  bool handedOff = false;
+  if (self->fHandoffState.load(std::memory_order_acquire) ==
+          kHandoffSwitched &&
+      self->fHandoffPosition.load(std::memory_order_relaxed) <=
+          start + produced) {
+    uint64 boundary = std::max(
+        start, self->fHandoffPosition.load(std::memory_order_relaxed));
+    int64 frames =
+        frameSize > 0 ? (int64)((start + produced - boundary) / frameSize) : 0;
+    self->fCurrentPos =
+        self->fHandoffBase.load(std::memory_order_relaxed) +
+        (bigtime_t)((frames * 1000000LL) / (int)format.frame_rate);
+    self->fHandoffState.store(kHandoffReached, std::memory_order_release);
+    handedOff = true;
+    if (self->fTarget.IsValid()) {
+      BMessage m(MSG_TRACK_ENDED);
+      m.AddBool("gapless", true);
+      self->fTarget.SendMessage(&m);
+    }
+  }
 
-  if (ret == B_OK && frames > 0) {
-    self->fCurrentPos +=
+  if (produced > 0 && frameSize > 0) {
+    int64 frames = (int64)(produced / frameSize);
+    bigtime_t span =
         (bigtime_t)((frames * 1000000LL) / (int)format.frame_rate);
-    size_t produced = (size_t)frames * frameSize;
+    if (!handedOff)
+      self->fCurrentPos += span;
+    self->fClock.SetPosition(self->fCurrentPos.load(), span);
     self->_ApplyFade(buffer, produced, format);
-    if (produced < size)
+    self->fAnalysis.Feed(buffer, produced, format);
+    if (produced < size) {
       memset((uint8 *)buffer + produced, 0, size - produced);
+      if (!decodeEnded) {
+        self->fUnderruns.fetch_add(1, std::memory_order_relaxed);
+        self->fHealth.RecordUnderrun();
+        TRACE_INSTANT(kTracePlayback, "underrun", (int64)(size - produced));
+      }
+    }
+  } else if (!decodeEnded) {
+    memset(buffer, 0, size);
+    self->fUnderruns.fetch_add(1, std::memory_order_relaxed);
+    self->fHealth.RecordUnderrun();
+    TRACE_INSTANT(kTracePlayback, "underrun", (int64)size);
   } else if (self->fIsStreaming.load(std::memory_order_relaxed)) {
     /// If the network request is finished, this is a real EOF
     bool isFinished =
@@ -1,8 +1,18 @@
 #ifndef BETON_AUDIO_PLAYBACK_ENGINE_H
 #define BETON_AUDIO_PLAYBACK_ENGINE_H
 
+#include "AnalysisTap.h"
+#include "AudioHealthStats.h"
+#include "CommandExecutor.h"
 #include "Config.h"
+#include "DspChain.h"
+#include "FormatConverter.h"
 #include "Messages.h"
+#include "PcmRingBuffer.h"
+#include "PlaybackClock.h"
+#include "PlaybackQueue.h"
+#include "ReplayGain.h"
+#include "TrackPrefetcher.h"
 
 #include <Autolock.h>
 #include <Locker.h>
@@ -25,6 +35,65 @@
  * and playing them using BSoundPlayer. Manages a playback queue and
  * supports basic controls (play, pause, next, prev, seek, volume).
  *
+ * Local files are decoded ahead by a dedicated thread into a PcmRingBuffer,
+ * so a slow read or an expensive frame never stalls the sound player; the
+ * callback only copies from the ring and counts underruns. Seeks are handed
+ * to the decoder thread, which owns the BMediaTrack while playing.
+ *
+ * Gapless: the queue owner names the entry that follows with
+ * SetGaplessNext(). A few seconds before the end the decoder opens and
+ * primes it, and if its decoded format equals the current one it goes on
+ * writing the new track into the same ring at EOF. When the callback plays
+ * past that point it sends `MSG_TRACK_ENDED` with "gapless" = true, and the
+ * receiver calls CompleteGaplessHandoff() instead of Play(). With another
+ * format the track ends normally.
+ *
+ * On a DLNA renderer the armed entry is served ahead and queued with
+ * SetNextAVTransportURI; the renderer buffers it and switches by itself,
+ * and DLNAService reports the switch as a gapless `MSG_TRACK_ENDED`.
+ *
+ * Crossfade (SetCrossfade()) uses the same handoff, only earlier: for the
+ * last seconds of a track the decoder reads both tracks, stages the incoming
+ * one in a second ring and writes their equal-power mix (CrossfadeMixer)
+ * into the playback ring. The callback is unchanged; the handoff boundary
+ * is the start of the overlap.
+ *
+ * Normalization (SetNormalization()) scales every decoded chunk by the
+ * track or album gain the queue owner passed to SetQueue(), before it is
+ * mixed or written to the ring, so fades and crossfades work on leveled
+ * audio.
+ *
+ * DSP (SetDsp()): after mixing, each chunk of a local track passes a
+ * DspChain (preamp, parametric equalizer, limiter) in the decoder thread,
+ * ahead of the output conversion. Streams are not processed.
+ *
+ * Output (SetOutputRate()): the sound player is kept from track to track
+ * and only replaced when the format it plays has to change. By default it
+ * plays each track's native format, so a track with another rate or layout
+ * still costs a new player. With a fixed output rate the decoder runs every
+ * local track through a FormatConverter into float stereo at that rate as
+ * the last step before the ring, and the one player is never replaced.
+ * Streams always play natively.
+ *
+ * Seeking in local tracks decodes forward from where the decoder lands to
+ * the exact target; a SeekIndex cached per file lets it land on a known
+ * point at most SeekIndex::kSpacing before the target.
+ *
+ * Prefetch: while a local track plays, a TrackPrefetcher opens the armed
+ * gapless entry and the next queue entries and decodes their first frames,
+ * so Play() on one of them starts without opening the file.
+ *
+ * Health() counts callback times, ring fill, underruns and decoder read
+ * times for every track; HealthReport() formats them with the current
+ * formats for the debug window.
+ *
+ * Analysis() taps what the callback plays, after fades, for level meters
+ * and spectrum displays; it costs nothing while no one is attached.
+ *
+ * Remote (DLNA) transport actions are blocking SOAP requests. They run in
+ * order on one CommandExecutor thread; volume changes and seeks coalesce
+ * to their latest value, and pending seeks are dropped on stop or load.
+ *
  * Uses atomic flags to coordinate between the UI thread and the real-time
  * audio callback thread.
  */
@@ -61,6 +130,63 @@ public:
   void PlayNext();                   ///< Advances to next track in queue.
   void PlayPrev();                   ///< Returns to previous track.
   void SeekTo(bigtime_t pos);        ///< Seeks to position in microseconds.
+  /** @brief Decode-ahead depth used from the next local track on. */
+  void SetDecodeAhead(bigtime_t depth);
+  /** @brief Queue index to join without a gap at EOF; -1 for none. */
+  void SetGaplessNext(int32 index);
+  /**
+   * @brief Stream a DLNA renderer plays after the current one, without a
+   * gap; empty for none. Ignored unless a renderer plays.
+   */
+  void SetRemoteNextUrl(const BString &url, const BString &title,
+                        int32 durationSeconds);
+  /** @brief Overlap between consecutive local tracks; 0 plays gaplessly. */
+  void SetCrossfade(bigtime_t duration);
+  bigtime_t Crossfade() const {
+    return fCrossfade.load(std::memory_order_relaxed);
+  }
+  /** @brief ReplayGain::Mode applied from the next decoded chunk on. */
+  void SetNormalization(int32 mode);
+  int32 Normalization() const {
+    return fNormalization.load(std::memory_order_relaxed);
+  }
+  /** @brief Preamp, equalizer and limiter, applied from the next chunk on. */
+  void SetDsp(const DspSettings &settings);
+  /**
+   * @brief Frame rate local tracks are converted to from the next Play()
+   * on; 0 passes each track's native format through.
+   */
+  void SetOutputRate(int32 rate);
+  int32 OutputRate() const {
+    return fOutputRate.load(std::memory_order_relaxed);
+  }
+  /**
+   * @brief Highest HLS variant bandwidth, in bit/s, adaptive streams move
+   * up to; 0 for no limit. Applies from the stream's next playlist reload.
+   */
+  void SetStreamBandwidthCap(int64 bitsPerSecond);
+  /**
+   * @brief How much of a live stream is recorded to pause and seek back
+   * in; 0 turns time-shifting off. Applies from the next stream.
+   */
+  void SetTimeShiftWindow(bigtime_t window);
+  /** @brief True while a live stream plays from its time-shift buffer. */
+  bool IsTimeShifted() const;
+  /**
+   * @brief Records the playing stream into `directory`, one file per
+   * title, without decoding it; ends with the stream.
+   * @return B_NOT_ALLOWED if no stream is playing.
+   */
+  status_t StartRecording(const BString &directory, const BString &station);
+  void StopRecording();
+  bool IsRecording() const;
+  /**
+   * @brief Makes the track the decoder switched to the current one.
+   *
+   * Call on a gapless `MSG_TRACK_ENDED`; sends `MSG_NOW_PLAYING`.
+   * @return false if playback was stopped or restarted in the meantime.
+   */
+  bool CompleteGaplessHandoff();
   void PlayUrl(const BUrl &url, const char *title = nullptr,
                int32 durationSeconds = 0,
                BPrivate::Network::BUrlContext *context = nullptr);
@@ -73,13 +199,33 @@ public:
   bool IsStreaming() const {
     return fIsStreaming.load(std::memory_order_relaxed);
   }
+  /** @brief True while the system synth plays a MIDI file; it cannot seek. */
+  bool IsMidiSynthPlaying() const {
+    return fIsMidiPlaying.load(std::memory_order_relaxed);
+  }
   int32 CurrentIndex() const; ///< Index of currently playing track.
+  /**
+   * @brief Device the current local track is read from, or -1 while nothing
+   * local is playing (stopped, paused or streaming).
+   *
+   * Changes are also sent to the target as `MSG_PLAYBACK_DEVICE`.
+   */
+  dev_t PlaybackDevice() const { return fPlaybackDevice.load(); }
   ///@}
 
   /** @name Queue Management */
   ///@{
-  void SetQueue(const std::vector<std::string> &queue);
-  int32 QueueSize() const { return static_cast<int32>(fQueue.size()); }
+  /**
+   * @brief Replaces the queue; `queue` is shared, not copied, and may be
+   * nullptr. Its entries carry the loudness used for normalization.
+   */
+  void SetQueue(PlaybackQueue *queue);
+  /** @brief The shared queue, or nullptr. */
+  PlaybackQueue *Queue() const { return fQueue.Get(); }
+  /** @brief Number of queue positions, removed ones included. */
+  int32 QueueSize() const {
+    return fQueue.IsSet() ? fQueue->CountPositions() : 0;
+  }
   ///@}
 
   /** @name Time Info */
@@ -91,8 +237,39 @@ public:
     int32 CurrentSampleRate() const { return fCurrentSampleRate.load(); }
     int32 CurrentChannels() const { return fCurrentChannels.load(); }
  ///< Duration of current track in microseconds.
+  /** @brief Frame rate the sound player runs at; 0 while stopped. */
+  int32 CurrentOutputRate() const { return fCurrentOutputRate.load(); }
+  /** @brief Callbacks of the current track that found the ring short. */
+  int32 Underruns() const { return fUnderruns.load(); }
+  /**
+   * @brief Position, duration and format for views to read while drawing;
+   * safe from any thread.
+   */
+  const PlaybackClock &Clock() const { return fClock; }
+  /**
+   * @brief Publishes the position of MIDI or remote playback to Clock();
+   * call on `MSG_TIME_UPDATE`, which is only sent for those.
+   */
+  void RefreshClock();
+  ///@}
+
+  /** @name Health */
+  ///@{
+  /** @brief Counters since start or the last Reset(). */
+  AudioHealthStats &Health() { return fHealth; }
+  /** @brief Current formats, Health() and HTTP connection reuse as text. */
+  BString HealthReport() const;
+  /** @brief Levels and spectrum of the output; see AnalysisTap::Attach(). */
+  AnalysisTap &Analysis() { return fAnalysis; }
   ///@}
 
+  static constexpr bigtime_t kDefaultDecodeAhead = 500000;
+  /** @brief How long before the end the next track is opened. */
+  static constexpr bigtime_t kGaplessLead = 3000000;
+  static constexpr bigtime_t kMaxCrossfade = 12000000;
+  /** @brief Sound player buffer at a fixed output rate. */
+  static constexpr size_t kOutputBufferFrames = 2048;
+
 private:
   /**
    * @brief Audio callback function for BSoundPlayer.
@@ -102,8 +279,36 @@ private:
   static void _PlayBuffer(void *cookie, void *buffer, size_t size,
                           const media_raw_audio_format &format);
 
+  /** @name Decode-ahead thread */
+  ///@{
+  status_t _StartDecoder(const media_raw_audio_format &format,
+                         const media_raw_audio_format &output);
+  void _StopDecoder();
+  static int32 _DecoderEntry(void *cookie);
+  void _DecodeLoop();
+  bool _OpenGaplessNext(BMediaFile *&file, BMediaTrack *&track,
+                        std::vector<uint8> &chunk, size_t &primed,
+                        int32 &index);
+  void _ReleaseHandoff();
+  bool _StillArmed(int32 index);
+  void _PublishSwitch(BMediaFile *file, BMediaTrack *track, int32 index);
+  void _EndOverlap();
+  float _GainFor(int32 index);
+  void _PublishGain(int32 index);
+  void _ApplyGain(void *data, size_t size, float gain);
+  /** @brief BMediaTrack::ReadFrames(), timed into Health(). */
+  status_t _ReadFrames(BMediaTrack *track, void *buffer, int64 *frames);
+  ///@}
+
+  media_raw_audio_format
+  _OutputFormatFor(const media_raw_audio_format &format) const;
+  status_t _PreparePlayer(const media_raw_audio_format &format);
+  void _DeletePlayer();
+  void _SetPlaybackDevice(dev_t device);
+  void _UpdatePrefetch();
   void _StartTimeUpdates();
   void _StopTimeUpdates();
+  bool _IsPolledClock() const;
   void _CleanupMedia();
   void _StopLocked(bool switching);
   void _BeginFadeIn();
@@ -121,6 +326,7 @@ private:
   /** @name Media Kit Objects */
   ///@{
   BSoundPlayer *fPlayer = nullptr;
+  media_raw_audio_format fPlayerFormat{}; ///< What fPlayer was made for
   BMediaFile *fMediaFile = nullptr;
   BMediaTrack *fTrack = nullptr;
   class BMidiSynthFile *fMidiSynth = nullptr;
@@ -135,6 +341,66 @@ private:
   BLocker fMidiLock;
   ///@}
 
+  /** @name Decode-ahead */
+  ///@{
+  PcmRingBuffer fRing;
+  thread_id fDecoderThread = -1;
+  size_t fDecodeChunkSize = 0; ///< Bytes per ReadFrames() call
+  size_t fDecodeFrameSize = 0;
+  bigtime_t fDecodeAhead = kDefaultDecodeAhead;
+  std::atomic<bool> fDecoderQuit{false};
+  std::atomic<bool> fDecodeEnded{false}; ///< Track exhausted or failed
+  std::atomic<int32> fSeekSerial{0};       ///< Bumped by SeekTo()
+  std::atomic<bigtime_t> fSeekTarget{0};
+  std::atomic<int32> fUnderruns{0};
+  AudioHealthStats fHealth;
+  AnalysisTap fAnalysis; ///< Fed by the callback while a visualizer listens
+  media_raw_audio_format fDecodeFormat{};
+  std::string fDecodePath; ///< File the decoder starts with (SeekIndex)
+  std::vector<uint8> fPrimed; ///< Prefetched frames the decoder starts with
+  ///@}
+
+  TrackPrefetcher fPrefetcher;
+
+  DspChain fDsp; ///< Decoder thread, except SetSettings()
+
+  /** @name Output conversion */
+  ///@{
+  std::atomic<int32> fOutputRate{0};
+  FormatConverter fConverter; ///< Decoder thread while it runs
+  bool fConverting = false;   ///< The ring holds converted frames
+  size_t fOutputFrameSize = 0; ///< Bytes per frame in the ring
+  ///@}
+
+  /** @name Gapless handoff */
+  ///@{
+  enum { kHandoffNone = 0, kHandoffSwitched = 1, kHandoffReached = 2 };
+  BLocker fGaplessLock;
+  int32 fGaplessIndex = -1;   ///< Guarded by fGaplessLock
+  std::string fGaplessPath;   ///< Guarded by fGaplessLock
+  /** Decoder writes the fields below only in kHandoffNone. */
+  std::atomic<int32> fHandoffState{kHandoffNone};
+  std::atomic<bigtime_t> fHandoffBase{0}; ///< Track time at the boundary
+  std::atomic<uint64> fHandoffPosition{0}; ///< Ring position of track start
+  BMediaFile *fHandoffFile = nullptr;
+  BMediaTrack *fHandoffTrack = nullptr;
+  int32 fHandoffIndex = -1;
+  std::string fHandoffPath;
+  std::atomic<bigtime_t> fCrossfade{0};
+  bool fOverlapActive = false;          ///< Guarded by fGaplessLock
+  BMediaFile *fRetiredFile = nullptr;   ///< Guarded by fGaplessLock
+  BMediaTrack *fRetiredTrack = nullptr; ///< Outgoing track of a crossfade
+  ///@}
+
+  /** @name Normalization */
+  ///@{
+  static const size_t kPublishedGains = 4;
+  /** @brief Gains by queue index (see _PublishGain()); fGaplessLock. */
+  std::vector<std::pair<int32, ReplayGain>> fPublishedGains;
+  std::atomic<int32> fNormalization{ReplayGain::kOff};
+  std::atomic<int32> fGainSerial{0}; ///< Bumped when gains must be re-read
+  ///@}
+
   /** @name Playback Position, Volume and Index */
   ///@{
   std::atomic<bigtime_t> fCurrentPos{0};
@@ -143,6 +409,7 @@ private:
   std::atomic<int32> fCurrentBitrate{0};
   std::atomic<int32> fCurrentSampleRate{0};
   std::atomic<int32> fCurrentChannels{0};
+  std::atomic<int32> fCurrentOutputRate{0};
   std::atomic<int64> fFadeInFrames{0};
   std::atomic<int64> fFadeOutFrames{0};
 
@@ -151,7 +418,7 @@ private:
 
   /** @name Queue, Thread Safety and Playback*/
   ///@{
-  std::vector<std::string> fQueue;
+  BReference<PlaybackQueue> fQueue;
   std::atomic<bool> fPlaying{false};
   std::atomic<bool> fPaused{false};
   std::atomic<bool> fAtEnd{false};
@@ -159,15 +426,29 @@ private:
   std::atomic<bool> fInCallback{false};
   std::atomic<bool> fStopping{false};
   std::atomic<bool> fIsStreaming{false}; ///< True when playing a URL stream.
+  dev_t fLocalDevice = -1; ///< Device of the loaded local file.
+  std::atomic<dev_t> fPlaybackDevice{-1}; ///< See PlaybackDevice().
   class NetworkAudioStreamIO *fNetworkStream = nullptr;
   ///@}
 
   /** @name Notification */
   ///@{
-  BMessageRunner *fUpdateRunner = nullptr;
+  static const bigtime_t kTimeUpdateInterval = 500000;
+  BMessageRunner *fUpdateRunner = nullptr; ///< MIDI and remote output only
   BMessenger fTarget;
+  PlaybackClock fClock;
   ///@}
 
+#if ENABLE_DLNA_OUTPUT
+  /** @brief CommandExecutor keys for coalesced renderer actions. */
+  enum { kRemoteVolume = 1, kRemoteSeek = 2 };
+
+  void _PostRemotePlay(const BString &url, const BString &title);
+  void _QueueRemoteEntry(int32 index);
+  void _ForgetRemoteNext();
+  bool _CompleteRemoteHandoff();
+#endif
+
   BPrivate::Network::BUrlContext fUrlContext;
   BLocker fPlayLock;
 
@@ -175,6 +456,12 @@ private:
   DLNAService *fDlnaManager = nullptr;
   LocalFileHttpServer *fLocalFileHttpServer = nullptr;
   std::atomic<bool> fIsRemotePlaying{false};
+  CommandExecutor fRemoteCommands{"dlna commands"};
+  /** @brief Successor armed on the renderer; guarded by fGaplessLock. */
+  int32 fRemoteNextIndex = -1; ///< Queue index; -1 for a stream
+  BString fRemoteNextUrl;
+  BString fRemoteNextTitle;
+  bigtime_t fRemoteNextDuration = 0;
 #endif
 };
 
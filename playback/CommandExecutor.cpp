@@ -0,0 +1,112 @@
+#include "CommandExecutor.h"
+#include "Debug.h"
+
+#include <Autolock.h>
+
+#include <algorithm>
+
+CommandExecutor::CommandExecutor(const char *name, size_t capacity)
+    : fLock(name), fName(name), fCapacity(std::max<size_t>(1, capacity)),
+      fSem(create_sem(0, name)), fThread(-1), fQuitting(false) {}
+
+CommandExecutor::~CommandExecutor() {
+  Quit();
+  delete_sem(fSem);
+}
+
+status_t CommandExecutor::Post(Command command, uint32 key) {
+  bool wake = true;
+  {
+    BAutolock lock(fLock);
+    if (fQuitting || fSem < 0)
+      return B_NOT_ALLOWED;
+
+    if (key != 0) {
+      auto it = std::find_if(fQueue.begin(), fQueue.end(),
+                             [key](const Entry &entry) {
+                               return entry.key == key;
+                             });
+      if (it != fQueue.end()) {
+        // Its semaphore count carries over to the replacement.
+        fQueue.erase(it);
+        wake = false;
+      }
+    }
+    if (fQueue.size() >= fCapacity) {
+      DEBUG_PRINT("%s: queue full, command dropped\n", fName);
+      return B_WOULD_BLOCK;
+    }
+    fQueue.push_back(Entry{key, std::move(command)});
+
+    if (fThread < 0) {
+      fThread = spawn_thread(_ThreadEntry, fName, B_NORMAL_PRIORITY, this);
+      if (fThread < 0) {
+        status_t status = fThread;
+        fQueue.pop_back();
+        return status;
+      }
+      resume_thread(fThread);
+    }
+  }
+  if (wake)
+    release_sem(fSem);
+  return B_OK;
+}
+
+int32 CommandExecutor::Cancel(uint32 key) {
+  BAutolock lock(fLock);
+  size_t before = fQueue.size();
+  if (key == 0)
+    fQueue.clear();
+  else
+    fQueue.erase(std::remove_if(fQueue.begin(), fQueue.end(),
+                                [key](const Entry &entry) {
+                                  return entry.key == key;
+                                }),
+                 fQueue.end());
+  // The thread skips the wake-ups of dropped commands.
+  return (int32)(before - fQueue.size());
+}
+
+void CommandExecutor::Quit() {
+  thread_id thread;
+  {
+    BAutolock lock(fLock);
+    fQuitting = true;
+    fQueue.clear();
+    thread = fThread;
+    fThread = -1;
+  }
+  if (thread < 0)
+    return;
+  release_sem(fSem);
+  status_t result;
+  wait_for_thread(thread, &result);
+}
+
+int32 CommandExecutor::_ThreadEntry(void *data) {
+  static_cast<CommandExecutor *>(data)->_Run();
+  return 0;
+}
+
+void CommandExecutor::_Run() {
+  for (;;) {
+    status_t status = acquire_sem(fSem);
+    if (status == B_INTERRUPTED)
+      continue;
+    if (status != B_OK)
+      break;
+
+    Command command;
+    {
+      BAutolock lock(fLock);
+      if (fQuitting)
+        break;
+      if (fQueue.empty())
+        continue;
+      command = std::move(fQueue.front().command);
+      fQueue.pop_front();
+    }
+    command();
+  }
+}
@@ -0,0 +1,63 @@
+#ifndef BETON_COMMAND_EXECUTOR_H
+#define BETON_COMMAND_EXECUTOR_H
+
+#include <Locker.h>
+#include <OS.h>
+#include <SupportDefs.h>
+#include <deque>
+#include <functional>
+
+/**
+ * @class CommandExecutor
+ * @brief Runs blocking commands one after another on a single thread.
+ *
+ * Commands run in the order they were posted. A command posted with a
+ * non-zero key replaces any queued command with the same key, and moves to
+ * the end of the queue, so only the latest volume or seek target of a
+ * burst is sent. The queue is bounded; Post() fails when it is full.
+ *
+ * The thread is spawned by the first Post(). Quit() drops queued commands
+ * and waits for the running one.
+ */
+class CommandExecutor {
+public:
+  typedef std::function<void()> Command;
+
+  explicit CommandExecutor(const char *name, size_t capacity = 32);
+  ~CommandExecutor();
+
+  /**
+   * @brief Queues `command`.
+   * @param key Coalescing key; 0 never coalesces.
+   * @return B_WOULD_BLOCK if the queue is full, B_NOT_ALLOWED after Quit().
+   */
+  status_t Post(Command command, uint32 key = 0);
+
+  /**
+   * @brief Drops queued commands with `key`, or all of them for 0.
+   * @return Number of commands dropped. The running one finishes.
+   */
+  int32 Cancel(uint32 key = 0);
+
+  /** @brief Drops queued commands, stops the thread and waits for it. */
+  void Quit();
+
+private:
+  struct Entry {
+    uint32 key;
+    Command command;
+  };
+
+  static int32 _ThreadEntry(void *data);
+  void _Run();
+
+  BLocker fLock;
+  std::deque<Entry> fQueue; ///< Guarded by fLock
+  const char *fName;
+  size_t fCapacity;
+  sem_id fSem;              ///< One count per queued command
+  thread_id fThread;
+  bool fQuitting;           ///< Guarded by fLock
+};
+
+#endif // BETON_COMMAND_EXECUTOR_H
@@ -0,0 +1,44 @@
+#include "CrossfadeMixer.h"
+#include "PcmKernels.h"
+
+#include <algorithm>
+#include <cmath>
+
+bool CrossfadeMixer::Supports(const media_raw_audio_format &format) {
+  return format.channel_count > 0 && PcmKernels::Supports(format.format);
+}
+
+void CrossfadeMixer::Reset(const media_raw_audio_format &format,
+                           int64 frames) {
+  fFormat = format.format;
+  fChannels = (int32)format.channel_count;
+  fFrames = std::max<int64>(1, frames);
+  fPosition = 0;
+}
+
+void CrossfadeMixer::_ComputeGains(int64 frames) {
+  size_t samples = (size_t)(frames * fChannels);
+  fGainOut.resize(samples);
+  fGainIn.resize(samples);
+
+  const float kQuarter = (float)M_PI / 2.0f;
+  for (int64 frame = 0; frame < frames; frame++) {
+    float t = std::min(1.0f, (float)(fPosition + frame) / fFrames);
+    float gainOut = cosf(t * kQuarter);
+    float gainIn = sinf(t * kQuarter);
+    for (int32 channel = 0; channel < fChannels; channel++) {
+      fGainOut[frame * fChannels + channel] = gainOut;
+      fGainIn[frame * fChannels + channel] = gainIn;
+    }
+  }
+}
+
+void CrossfadeMixer::Mix(void *outgoing, const void *incoming, int64 frames) {
+  if (frames <= 0 || fChannels <= 0)
+    return;
+
+  _ComputeGains(frames);
+  PcmKernels::Mix(outgoing, incoming, fFormat, (size_t)(frames * fChannels),
+                  fGainOut.data(), fGainIn.data());
+  fPosition += frames;
+}
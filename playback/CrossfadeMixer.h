@@ -0,0 +1,45 @@
+#ifndef BETON_CROSSFADE_MIXER_H
+#define BETON_CROSSFADE_MIXER_H
+
+#include <MediaDefs.h>
+#include <SupportDefs.h>
+#include <vector>
+
+/**
+ * @class CrossfadeMixer
+ * @brief Mixes an incoming stream into an outgoing one along an
+ * equal-power curve.
+ *
+ * The outgoing gain follows cos and the incoming gain sin over the overlap,
+ * so the summed power stays constant. Gains are expanded per sample once per
+ * block, which leaves the mixing itself to PcmKernels::Mix().
+ */
+class CrossfadeMixer {
+public:
+  /** @brief Whether Mix() can handle `format`. */
+  static bool Supports(const media_raw_audio_format &format);
+
+  /** @brief Starts a new overlap of `frames` frames. */
+  void Reset(const media_raw_audio_format &format, int64 frames);
+
+  /**
+   * @brief Mixes `frames` frames of `incoming` into `outgoing` in place and
+   * advances along the curve.
+   */
+  void Mix(void *outgoing, const void *incoming, int64 frames);
+
+  /** @brief True once the whole curve was applied. */
+  bool Done() const { return fPosition >= fFrames; }
+
+private:
+  void _ComputeGains(int64 frames);
+
+  uint32 fFormat = 0;
+  int32 fChannels = 0;
+  int64 fFrames = 0;
+  int64 fPosition = 0;
+  std::vector<float> fGainOut; ///< Per sample of the current block
+  std::vector<float> fGainIn;
+};
+
+#endif // BETON_CROSSFADE_MIXER_H
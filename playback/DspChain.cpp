@@ -0,0 +1,314 @@
+#include "DspChain.h"
+#include "PcmKernels.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+inline double DbToLinear(double db) { return std::pow(10.0, db / 20.0); }
+
+/** @brief Gain in front of the equalizer; ramps over a chunk on changes. */
+class PreampStage : public DspStage {
+public:
+  void Configure(const DspSettings &settings, float, int32 channels) override {
+    fChannels = channels;
+    fTarget = (float)DbToLinear(settings.preamp);
+  }
+  void Reset() override { fGain = fTarget; }
+  void Process(float *samples, int64 frames) override {
+    if (fGain == 1.0f && fTarget == 1.0f)
+      return;
+    float step = (fTarget - fGain) / frames;
+    PcmKernels::ApplyGainRamp(samples, media_raw_audio_format::B_AUDIO_FLOAT,
+                              fChannels, frames, fGain, step);
+    fGain = fTarget;
+  }
+
+private:
+  int32 fChannels = 0;
+  float fGain = 1.0f;
+  float fTarget = 1.0f;
+};
+
+/**
+ * @brief Biquads after the Audio EQ Cookbook (R. Bristow-Johnson), in
+ * transposed direct form II with double state per channel.
+ */
+class EqualizerStage : public DspStage {
+public:
+  void Configure(const DspSettings &settings, float frameRate,
+                 int32 channels) override {
+    if (channels != fChannels)
+      fState.assign((size_t)channels * DspSettings::kBands, State());
+    fChannels = channels;
+
+    fFilters.clear();
+    for (int32 i = 0; i < DspSettings::kBands; i++) {
+      Filter filter;
+      filter.band = i;
+      if (_Design(settings.bands[i], frameRate, filter))
+        fFilters.push_back(filter);
+    }
+  }
+  void Reset() override { std::fill(fState.begin(), fState.end(), State()); }
+  void Process(float *samples, int64 frames) override {
+    for (const Filter &f : fFilters) {
+      for (int32 channel = 0; channel < fChannels; channel++) {
+        State &s = fState[(size_t)channel * DspSettings::kBands + f.band];
+        double z1 = s.z1, z2 = s.z2;
+        float *p = samples + channel;
+        for (int64 frame = 0; frame < frames; frame++, p += fChannels) {
+          double x = *p;
+          double y = f.b0 * x + z1;
+          z1 = f.b1 * x - f.a1 * y + z2;
+          z2 = f.b2 * x - f.a2 * y;
+          *p = (float)y;
+        }
+        // Long silences would otherwise decay into denormals.
+        s.z1 = std::fabs(z1) < 1e-20 ? 0.0 : z1;
+        s.z2 = std::fabs(z2) < 1e-20 ? 0.0 : z2;
+      }
+    }
+  }
+
+private:
+  struct Filter {
+    int32 band;
+    double b0, b1, b2, a1, a2; ///< Normalized by a0
+  };
+  struct State {
+    double z1 = 0.0, z2 = 0.0;
+  };
+
+  /** @brief Computes the coefficients; false if the band does nothing. */
+  static bool _Design(const DspSettings::Band &band, float frameRate,
+                      Filter &filter) {
+    if (band.gain == 0.0f || band.frequency <= 0.0f || band.q <= 0.0f ||
+        band.frequency >= frameRate * 0.49f)
+      return false;
+
+    const double A = std::pow(10.0, band.gain / 40.0);
+    const double w0 = 2.0 * M_PI * band.frequency / frameRate;
+    const double cosW = std::cos(w0);
+    const double alpha = std::sin(w0) / (2.0 * band.q);
+    const double shelf = 2.0 * std::sqrt(A) * alpha;
+    double b0, b1, b2, a0, a1, a2;
+
+    switch (band.type) {
+    case DspSettings::kLowShelf:
+      b0 = A * ((A + 1) - (A - 1) * cosW + shelf);
+      b1 = 2 * A * ((A - 1) - (A + 1) * cosW);
+      b2 = A * ((A + 1) - (A - 1) * cosW - shelf);
+      a0 = (A + 1) + (A - 1) * cosW + shelf;
+      a1 = -2 * ((A - 1) + (A + 1) * cosW);
+      a2 = (A + 1) + (A - 1) * cosW - shelf;
+      break;
+    case DspSettings::kHighShelf:
+      b0 = A * ((A + 1) + (A - 1) * cosW + shelf);
+      b1 = -2 * A * ((A - 1) + (A + 1) * cosW);
+      b2 = A * ((A + 1) + (A - 1) * cosW - shelf);
+      a0 = (A + 1) - (A - 1) * cosW + shelf;
+      a1 = 2 * ((A - 1) - (A + 1) * cosW);
+      a2 = (A + 1) - (A - 1) * cosW - shelf;
+      break;
+    default:
+      b0 = 1 + alpha * A;
+      b1 = -2 * cosW;
+      b2 = 1 - alpha * A;
+      a0 = 1 + alpha / A;
+      a1 = -2 * cosW;
+      a2 = 1 - alpha / A;
+      break;
+    }
+
+    filter.b0 = b0 / a0;
+    filter.b1 = b1 / a0;
+    filter.b2 = b2 / a0;
+    filter.a1 = a1 / a0;
+    filter.a2 = a2 / a0;
+    return true;
+  }
+
+  int32 fChannels = 0;
+  std::vector<Filter> fFilters;
+  std::vector<State> fState; ///< Per channel and band
+};
+
+/**
+ * @brief Peak limiter: attacks within the frame that would clip, releases
+ * over about 50 ms. No look-ahead, so it adds no latency.
+ */
+class LimiterStage : public DspStage {
+public:
+  void Configure(const DspSettings &settings, float frameRate,
+                 int32 channels) override {
+    fEnabled = settings.limiter;
+    fChannels = channels;
+    fCeiling = (float)DbToLinear(std::min(settings.ceiling, 0.0f));
+    fRelease = (float)std::exp(-1.0 / (0.05 * frameRate));
+  }
+  void Reset() override { fGain = 1.0f; }
+  void Process(float *samples, int64 frames) override {
+    if (!fEnabled)
+      return;
+    for (int64 frame = 0; frame < frames; frame++) {
+      float *p = samples + frame * fChannels;
+      float peak = 0.0f;
+      for (int32 channel = 0; channel < fChannels; channel++)
+        peak = std::max(peak, std::fabs(p[channel]));
+
+      float target = peak > fCeiling ? fCeiling / peak : 1.0f;
+      if (target < fGain)
+        fGain = target;
+      else
+        fGain = target + (fGain - target) * fRelease;
+      if (fGain == 1.0f)
+        continue;
+      for (int32 channel = 0; channel < fChannels; channel++)
+        p[channel] *= fGain;
+    }
+  }
+
+private:
+  bool fEnabled = false;
+  int32 fChannels = 0;
+  float fCeiling = 1.0f;
+  float fRelease = 0.0f;
+  float fGain = 1.0f;
+};
+
+} // namespace
+
+DspSettings::DspSettings() { ResetBands(); }
+
+void DspSettings::ResetBands() {
+  static const Band kDefaults[kBands] = {
+      {kLowShelf, 100.0f, 0.0f, 0.707f},
+      {kPeaking, 250.0f, 0.0f, 1.0f},
+      {kPeaking, 1000.0f, 0.0f, 1.0f},
+      {kPeaking, 4000.0f, 0.0f, 1.0f},
+      {kHighShelf, 10000.0f, 0.0f, 0.707f},
+  };
+  std::copy(kDefaults, kDefaults + kBands, bands);
+}
+
+void DspSettings::Archive(BMessage *into) const {
+  into->AddBool("enabled", enabled);
+  into->AddFloat("preamp", preamp);
+  into->AddBool("limiter", limiter);
+  into->AddFloat("ceiling", ceiling);
+  for (int32 i = 0; i < kBands; i++) {
+    into->AddInt32("band_type", bands[i].type);
+    into->AddFloat("band_frequency", bands[i].frequency);
+    into->AddFloat("band_gain", bands[i].gain);
+    into->AddFloat("band_q", bands[i].q);
+  }
+}
+
+void DspSettings::Unarchive(const BMessage &from) {
+  enabled = from.GetBool("enabled", enabled);
+  preamp = std::max(-24.0f, std::min(24.0f, from.GetFloat("preamp", preamp)));
+  limiter = from.GetBool("limiter", limiter);
+  ceiling = from.GetFloat("ceiling", ceiling);
+  for (int32 i = 0; i < kBands; i++) {
+    Band &band = bands[i];
+    from.FindInt32("band_type", i, &band.type);
+    from.FindFloat("band_frequency", i, &band.frequency);
+    from.FindFloat("band_gain", i, &band.gain);
+    from.FindFloat("band_q", i, &band.q);
+  }
+}
+
+DspChain::DspChain()
+    : fPending(nullptr), fFormat(0), fFrameRate(0), fChannels(0),
+      fActive(false) {
+  fStages.emplace_back(new PreampStage());
+  fStages.emplace_back(new EqualizerStage());
+  fStages.emplace_back(new LimiterStage());
+}
+
+DspChain::~DspChain() { delete fPending.exchange(nullptr); }
+
+void DspChain::SetSettings(const DspSettings &settings) {
+  // Whoever swaps a pointer out owns it; the decoder takes the last one.
+  delete fPending.exchange(new DspSettings(settings),
+                           std::memory_order_acq_rel);
+}
+
+void DspChain::Prepare(const media_raw_audio_format &format,
+                       int64 maxFrames) {
+  fFormat = format.format;
+  fFrameRate = format.frame_rate;
+  fChannels = (int32)format.channel_count;
+  if (fFormat != media_raw_audio_format::B_AUDIO_FLOAT && maxFrames > 0)
+    fScratch.resize((size_t)(maxFrames * fChannels));
+  _TakePending();
+  _Configure();
+  Reset();
+}
+
+void DspChain::Reset() {
+  for (auto &stage : fStages)
+    stage->Reset();
+}
+
+void DspChain::Process(void *samples, int64 frames) {
+  _TakePending();
+  if (!fActive || frames <= 0)
+    return;
+
+  const size_t count = (size_t)(frames * fChannels);
+  float *floats = static_cast<float *>(samples);
+  switch (fFormat) {
+  case media_raw_audio_format::B_AUDIO_SHORT:
+    if (fScratch.size() < count)
+      fScratch.resize(count);
+    floats = fScratch.data();
+    PcmKernels::Int16ToFloat(static_cast<const int16 *>(samples), floats,
+                             count);
+    break;
+  case media_raw_audio_format::B_AUDIO_INT:
+    if (fScratch.size() < count)
+      fScratch.resize(count);
+    floats = fScratch.data();
+    PcmKernels::Int32ToFloat(static_cast<const int32 *>(samples), floats,
+                             count);
+    break;
+  }
+
+  for (auto &stage : fStages)
+    stage->Process(floats, frames);
+
+  switch (fFormat) {
+  case media_raw_audio_format::B_AUDIO_SHORT:
+    PcmKernels::FloatToInt16(floats, static_cast<int16 *>(samples), count);
+    break;
+  case media_raw_audio_format::B_AUDIO_INT:
+    PcmKernels::FloatToInt32(floats, static_cast<int32 *>(samples), count);
+    break;
+  }
+}
+
+/** @brief Adopts settings published by SetSettings(), if any. */
+void DspChain::_TakePending() {
+  DspSettings *pending = fPending.exchange(nullptr, std::memory_order_acq_rel);
+  if (pending == nullptr)
+    return;
+  bool wasEnabled = fSettings.enabled;
+  fSettings = *pending;
+  delete pending;
+  _Configure();
+  // Switching on starts from silence rather than stale filter history.
+  if (fSettings.enabled && !wasEnabled)
+    Reset();
+}
+
+void DspChain::_Configure() {
+  fActive = fSettings.enabled && fChannels > 0 && fFrameRate > 0 &&
+            PcmKernels::Supports(fFormat);
+  if (!fActive)
+    return;
+  for (auto &stage : fStages)
+    stage->Configure(fSettings, fFrameRate, fChannels);
+}
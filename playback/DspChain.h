@@ -0,0 +1,113 @@
+#ifndef BETON_DSP_CHAIN_H
+#define BETON_DSP_CHAIN_H
+
+#include <MediaDefs.h>
+#include <Message.h>
+#include <SupportDefs.h>
+#include <atomic>
+#include <memory>
+#include <vector>
+
+/**
+ * @brief User settings of the DSP chain, as the equalizer window and the
+ * settings file see them.
+ */
+struct DspSettings {
+  enum BandType { kPeaking = 0, kLowShelf = 1, kHighShelf = 2 };
+
+  struct Band {
+    int32 type;
+    float frequency; ///< Hz; centre of a peak, corner of a shelf
+    float gain;      ///< dB
+    float q;
+  };
+
+  static const int32 kBands = 5;
+
+  DspSettings();
+
+  bool enabled = false;
+  float preamp = 0.0f; ///< dB
+  Band bands[kBands];
+  bool limiter = true;
+  float ceiling = -0.3f; ///< dBFS the limiter holds the peaks at
+
+  /** @brief Resets the bands to a flat five-band layout. */
+  void ResetBands();
+
+  /** @brief Stores the settings in `into` (fields, not a sub-message). */
+  void Archive(BMessage *into) const;
+  /** @brief Reads what Archive() stored; missing fields keep their value. */
+  void Unarchive(const BMessage &from);
+};
+
+/**
+ * @class DspStage
+ * @brief One processing step of a DspChain.
+ *
+ * Stages work on interleaved floats in the decoder thread. Configure() may
+ * allocate; Process() must not.
+ */
+class DspStage {
+public:
+  virtual ~DspStage() {}
+
+  /**
+   * @brief Takes over `settings` for the given stream layout; stages keep
+   * their state when only the settings changed.
+   */
+  virtual void Configure(const DspSettings &settings, float frameRate,
+                         int32 channels) = 0;
+  /** @brief Forgets the signal history (after a seek or a new stream). */
+  virtual void Reset() = 0;
+  /** @brief Processes `frames` frames in place. */
+  virtual void Process(float *samples, int64 frames) = 0;
+};
+
+/**
+ * @class DspChain
+ * @brief Preamp, parametric equalizer and limiter between decoding and the
+ * ring buffer.
+ *
+ * The chain runs in the decoder thread, a chunk at a time, so the sound
+ * player callback stays as cheap as before. Float streams are processed in
+ * place; int16 and int32 streams go through a float scratch buffer using
+ * the PcmKernels conversions.
+ *
+ * SetSettings() may be called from any thread without locking: it
+ * publishes a copy through an atomic pointer, and the decoder picks it up
+ * before the next chunk and derives the biquad coefficients from it.
+ */
+class DspChain {
+public:
+  DspChain();
+  ~DspChain();
+
+  /** @brief Publishes new settings; safe from any thread. */
+  void SetSettings(const DspSettings &settings);
+
+  /** @name Decoder thread */
+  ///@{
+  /** @brief Prepares for a stream of `format`, `maxFrames` per chunk. */
+  void Prepare(const media_raw_audio_format &format, int64 maxFrames);
+  /** @brief Forgets the signal history, e.g. after a seek. */
+  void Reset();
+  /** @brief Processes `frames` interleaved frames of the prepared format. */
+  void Process(void *samples, int64 frames);
+  ///@}
+
+private:
+  void _TakePending();
+  void _Configure();
+
+  std::atomic<DspSettings *> fPending; ///< Owned; exchanged, never shared
+  DspSettings fSettings;
+  std::vector<std::unique_ptr<DspStage>> fStages;
+  std::vector<float> fScratch;
+  uint32 fFormat;
+  float fFrameRate;
+  int32 fChannels;
+  bool fActive; ///< Enabled and prepared for a supported format
+};
+
+#endif // BETON_DSP_CHAIN_H
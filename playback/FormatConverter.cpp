@@ -0,0 +1,266 @@
+#include "FormatConverter.h"
+#include "PcmKernels.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+/** @brief Filter length at a ratio of 1 or more; stopband about -90 dB. */
+static const int32 kBaseTaps = 64;
+static const int32 kMaxTaps = 256;
+/** @brief -6 dB point relative to the lower of both Nyquist frequencies. */
+static const double kCutoff = 0.92;
+static const double kKaiserBeta = 9.0;
+
+/** @brief Zeroth-order modified Bessel function of the first kind. */
+static double BesselI0(double x) {
+  double sum = 1.0;
+  double term = 1.0;
+  for (int32 k = 1; k < 50; k++) {
+    term *= (x / (2.0 * k)) * (x / (2.0 * k));
+    sum += term;
+    if (term < sum * 1e-12)
+      break;
+  }
+  return sum;
+}
+
+FormatConverter::FormatConverter() {}
+
+bool FormatConverter::Supports(const media_raw_audio_format &input) {
+  if (input.channel_count == 0 || input.frame_rate <= 0 ||
+      input.byte_order != B_MEDIA_HOST_ENDIAN)
+    return false;
+  return input.format == media_raw_audio_format::B_AUDIO_FLOAT ||
+         input.format == media_raw_audio_format::B_AUDIO_INT ||
+         input.format == media_raw_audio_format::B_AUDIO_SHORT;
+}
+
+status_t FormatConverter::SetTo(const media_raw_audio_format &input,
+                                float outputRate, int32 outputChannels) {
+  if (!Supports(input) || outputRate <= 0 || outputChannels <= 0)
+    return B_BAD_VALUE;
+
+  fInputFormat = input.format;
+  fInputChannels = (int32)input.channel_count;
+  fOutputChannels = outputChannels;
+  fInputFrameSize = (size_t)(input.format &
+                             media_raw_audio_format::B_AUDIO_SIZE_MASK) *
+                    fInputChannels;
+  fRatio = (double)outputRate / input.frame_rate;
+  fStep = (double)input.frame_rate / outputRate;
+  fResample = input.frame_rate != outputRate;
+
+  _BuildMatrix();
+  if (fResample) {
+    double scale = std::min(1.0, fRatio);
+    int32 taps = (int32)std::ceil(kBaseTaps / scale);
+    fTaps = std::min(kMaxTaps, (taps + 3) & ~3);
+    _BuildTable(kCutoff * scale);
+  } else {
+    fTaps = 0;
+    fTable.clear();
+  }
+  fHistory.assign(fOutputChannels, std::vector<float>());
+  fCoeffs.assign(fTaps, 0.0f);
+  Reset();
+  return B_OK;
+}
+
+/**
+ * @brief Fills the channel matrix; front left/right in the first two
+ * channels, then centre, LFE and surrounds as the Media Kit orders them.
+ */
+void FormatConverter::_BuildMatrix() {
+  const int32 in = fInputChannels;
+  const int32 out = fOutputChannels;
+  fMatrix.assign((size_t)out * in, 0.0f);
+
+  if (in == out) {
+    for (int32 c = 0; c < in; c++)
+      fMatrix[c * in + c] = 1.0f;
+    return;
+  }
+  if (in == 1) {
+    for (int32 o = 0; o < out; o++)
+      fMatrix[o] = 1.0f;
+    return;
+  }
+  if (out == 1) {
+    for (int32 i = 0; i < in; i++)
+      fMatrix[i] = 1.0f / in;
+    return;
+  }
+
+  // Fold down to stereo; further output channels stay silent.
+  const float kMinus3dB = 0.70710678f;
+  for (int32 i = 0; i < in; i++) {
+    float left = 0.0f;
+    float right = 0.0f;
+    if (i == 0)
+      left = 1.0f;
+    else if (i == 1)
+      right = 1.0f;
+    else if (i == 2 && in >= 3)
+      left = right = kMinus3dB;
+    else if (i == 3 && in >= 6)
+      continue; // LFE
+    else if (i % 2 == 0)
+      left = kMinus3dB;
+    else
+      right = kMinus3dB;
+    fMatrix[0 * in + i] = left;
+    fMatrix[1 * in + i] = right;
+  }
+  for (int32 o = 0; o < 2; o++) {
+    float sum = 0.0f;
+    for (int32 i = 0; i < in; i++)
+      sum += fMatrix[o * in + i];
+    for (int32 i = 0; i < in && sum > 1.0f; i++)
+      fMatrix[o * in + i] /= sum;
+  }
+}
+
+/**
+ * @brief Tabulates the windowed sinc so that row `p` weighs the fTaps input
+ * frames around an output frame `p / kPhases` past an input frame, oldest
+ * first. Every row is normalized to unity gain at DC.
+ */
+void FormatConverter::_BuildTable(double cutoff) {
+  const int32 half = fTaps / 2;
+  const double norm = BesselI0(kKaiserBeta);
+  fTable.assign((size_t)(kPhases + 1) * fTaps, 0.0f);
+
+  std::vector<double> row(fTaps);
+  for (int32 p = 0; p <= kPhases; p++) {
+    const double frac = (double)p / kPhases;
+    double sum = 0;
+    for (int32 k = 0; k < fTaps; k++) {
+      double x = frac + half - 1 - k;
+      double u = x / half;
+      double window =
+          u * u < 1.0 ? BesselI0(kKaiserBeta * std::sqrt(1.0 - u * u)) / norm
+                      : 0.0;
+      double arg = M_PI * cutoff * x;
+      double sinc = x == 0 ? 1.0 : std::sin(arg) / arg;
+      row[k] = cutoff * sinc * window;
+      sum += row[k];
+    }
+    for (int32 k = 0; k < fTaps; k++)
+      fTable[(size_t)p * fTaps + k] = (float)(row[k] / sum);
+  }
+}
+
+void FormatConverter::Reset() {
+  // The first output frame is centred on the first input frame, so half a
+  // filter of silence goes before it.
+  const int32 lead = fResample ? fTaps / 2 - 1 : 0;
+  for (std::vector<float> &history : fHistory)
+    history.assign(lead, 0.0f);
+  fTime = lead;
+}
+
+size_t FormatConverter::MaxOutputSize(size_t size) const {
+  if (fInputFrameSize == 0)
+    return 0;
+  size_t frames = size / fInputFrameSize;
+  size_t outFrames =
+      fResample ? (size_t)std::ceil((frames + 1) * fRatio) + 1 : frames;
+  return outFrames * fOutputChannels * sizeof(float);
+}
+
+size_t FormatConverter::Convert(const void *data, size_t size,
+                                std::vector<uint8> &output) {
+  if (fInputFrameSize == 0)
+    return 0;
+  const size_t frames = size / fInputFrameSize;
+  const size_t count = frames * fInputChannels;
+  const int32 in = fInputChannels;
+  const int32 out = fOutputChannels;
+
+  fSamples.resize(count);
+  if (fInputFormat == media_raw_audio_format::B_AUDIO_FLOAT) {
+    memcpy(fSamples.data(), data, count * sizeof(float));
+  } else if (fInputFormat == media_raw_audio_format::B_AUDIO_SHORT) {
+    PcmKernels::Int16ToFloat(static_cast<const int16 *>(data),
+                             fSamples.data(), count);
+  } else {
+    const int32 *samples = static_cast<const int32 *>(data);
+    for (size_t i = 0; i < count; i++)
+      fSamples[i] = samples[i] * (1.0f / 2147483648.0f);
+  }
+
+  size_t needed = MaxOutputSize(size);
+  if (output.size() < needed)
+    output.resize(needed);
+  float *dest = reinterpret_cast<float *>(output.data());
+
+  if (!fResample) {
+    for (size_t f = 0; f < frames; f++) {
+      const float *src = fSamples.data() + f * in;
+      for (int32 o = 0; o < out; o++) {
+        const float *weights = fMatrix.data() + o * in;
+        float sum = 0.0f;
+        for (int32 i = 0; i < in; i++)
+          sum += weights[i] * src[i];
+        *dest++ = sum;
+      }
+    }
+    return frames * out * sizeof(float);
+  }
+
+  for (int32 o = 0; o < out; o++) {
+    std::vector<float> &history = fHistory[o];
+    const float *weights = fMatrix.data() + o * in;
+    size_t base = history.size();
+    history.resize(base + frames);
+    for (size_t f = 0; f < frames; f++) {
+      const float *src = fSamples.data() + f * in;
+      float sum = 0.0f;
+      for (int32 i = 0; i < in; i++)
+        sum += weights[i] * src[i];
+      history[base + f] = sum;
+    }
+  }
+
+  const int32 half = fTaps / 2;
+  const size_t available = fHistory[0].size();
+  const size_t capacity = output.size() / (out * sizeof(float));
+  size_t produced = 0;
+  while (produced < capacity) {
+    const size_t index = (size_t)fTime;
+    if (index + half >= available)
+      break;
+
+    // Blend the two nearest rows of the table for this fractional offset.
+    double position = (fTime - index) * kPhases;
+    int32 phase = std::min((int32)position, kPhases - 1);
+    float blend = (float)(position - phase);
+    const float *lower = fTable.data() + (size_t)phase * fTaps;
+    const float *upper = lower + fTaps;
+    for (int32 k = 0; k < fTaps; k++)
+      fCoeffs[k] = lower[k] + (upper[k] - lower[k]) * blend;
+
+    // Four independent lanes, as in LoudnessMeter, so the dot product
+    // vectorizes without reassociating floating point math.
+    const size_t first = index + 1 - half;
+    for (int32 o = 0; o < out; o++) {
+      const float *window = fHistory[o].data() + first;
+      float lanes[4] = {0, 0, 0, 0};
+      for (int32 k = 0; k < fTaps; k += 4)
+        for (int32 lane = 0; lane < 4; lane++)
+          lanes[lane] += fCoeffs[k + lane] * window[k + lane];
+      dest[produced * out + o] = (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+    }
+    produced++;
+    fTime += fStep;
+  }
+
+  // Keep the frames the next output still reaches back to.
+  size_t keepFrom = std::min(available, (size_t)fTime + 1 - half);
+  for (std::vector<float> &history : fHistory)
+    history.erase(history.begin(), history.begin() + keepFrom);
+  fTime -= keepFrom;
+
+  return produced * out * sizeof(float);
+}
@@ -0,0 +1,77 @@
+#ifndef BETON_FORMAT_CONVERTER_H
+#define BETON_FORMAT_CONVERTER_H
+
+#include <MediaDefs.h>
+#include <SupportDefs.h>
+#include <vector>
+
+/**
+ * @class FormatConverter
+ * @brief Turns decoded PCM into float frames of a fixed channel count and
+ * frame rate, so one sound player can play tracks of any format.
+ *
+ * Samples are converted to float and remixed into one planar history per
+ * output channel: mono is copied to every side, layouts with more channels
+ * are folded down with -3 dB centre and surround weights (LFE dropped) and
+ * scaled so the fold-down cannot clip.
+ *
+ * Rate changes use a polyphase Kaiser-windowed sinc. The impulse response is
+ * tabulated at kPhases fractional offsets and interpolated linearly between
+ * two of them, so one table serves any ratio. When downsampling, the cutoff
+ * follows the output Nyquist frequency and the filter grows accordingly.
+ * The resampler holds back Latency() input frames; pushing that many silent
+ * frames at the end of a stream lets them out.
+ */
+class FormatConverter {
+public:
+  FormatConverter();
+
+  /** @brief Whether SetTo() accepts `input` (float, int32 or int16). */
+  static bool Supports(const media_raw_audio_format &input);
+
+  /** @brief Prepares the conversion and clears the history. */
+  status_t SetTo(const media_raw_audio_format &input, float outputRate,
+                 int32 outputChannels);
+
+  /** @brief Drops the history, e.g. after a seek. */
+  void Reset();
+
+  /**
+   * @brief Converts `size` bytes of whole input frames.
+   * @param output Receives the float frames; grown if too small.
+   * @return Bytes of `output` that are valid.
+   */
+  size_t Convert(const void *data, size_t size, std::vector<uint8> &output);
+
+  /** @brief Upper bound of Convert() output for `size` input bytes. */
+  size_t MaxOutputSize(size_t size) const;
+
+  /** @brief Input frames the resampler keeps back; 0 without resampling. */
+  int32 Latency() const { return fResample ? fTaps / 2 : 0; }
+
+private:
+  /** @brief Fractional offsets of the tabulated impulse response. */
+  static const int32 kPhases = 256;
+
+  void _BuildMatrix();
+  void _BuildTable(double cutoff);
+
+  uint32 fInputFormat = 0;
+  int32 fInputChannels = 0;
+  int32 fOutputChannels = 0;
+  size_t fInputFrameSize = 0;
+  double fRatio = 1.0; ///< Output frames per input frame
+  double fStep = 1.0;  ///< Input frames per output frame
+  bool fResample = false;
+  int32 fTaps = 0;
+
+  std::vector<float> fMatrix; ///< fOutputChannels x fInputChannels
+  std::vector<float> fTable;  ///< (kPhases + 1) rows of fTaps coefficients
+  std::vector<std::vector<float>> fHistory; ///< Remixed input per channel
+  double fTime = 0; ///< Next output position, in frames of fHistory
+
+  std::vector<float> fSamples; ///< Input as float, interleaved
+  std::vector<float> fCoeffs;  ///< Interpolated row of the current frame
+};
+
+#endif // BETON_FORMAT_CONVERTER_H
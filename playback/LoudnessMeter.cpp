@@ -0,0 +1,196 @@
+#include "LoudnessMeter.h"
+
+#include <algorithm>
+#include <cmath>
+
+/** @brief Interpolation filter length per oversampling phase. */
+static const int32 kPeakTaps = 12;
+/** @brief ReplayGain 2.0 reference level. */
+static const double kReferenceLufs = -18.0;
+/** @brief Block loudness is -0.691 + 10 log10(energy). */
+static const double kLoudnessOffset = -0.691;
+
+static double EnergyToLufs(double energy) {
+  return kLoudnessOffset + 10.0 * std::log10(energy);
+}
+
+static double LufsToEnergy(double lufs) {
+  return std::pow(10.0, (lufs - kLoudnessOffset) / 10.0);
+}
+
+LoudnessMeter::LoudnessMeter() {}
+
+status_t LoudnessMeter::Reset(float sampleRate, int32 channels) {
+  fChannels.clear();
+  fBlocks.clear();
+  fTruePeak = 0;
+  fStepFilled = 0;
+  fStepSum = 0;
+  fStepCount = 0;
+  fStepIndex = 0;
+  if (sampleRate < 8000 || channels <= 0)
+    return B_BAD_VALUE;
+
+  // K-weighting of BS.1770 for any rate, with the analog prototypes of
+  // libebur128: a +4 dB shelf around 1.7 kHz, then a 38 Hz high pass.
+  Biquad shelf;
+  {
+    const double f0 = 1681.974450955533, gain = 3.999843853973347,
+                 q = 0.7071752369554196;
+    double k = std::tan(M_PI * f0 / sampleRate);
+    double vh = std::pow(10.0, gain / 20.0);
+    double vb = std::pow(vh, 0.4996667741545416);
+    double a0 = 1.0 + k / q + k * k;
+    shelf.b0 = (vh + vb * k / q + k * k) / a0;
+    shelf.b1 = 2.0 * (k * k - vh) / a0;
+    shelf.b2 = (vh - vb * k / q + k * k) / a0;
+    shelf.a1 = 2.0 * (k * k - 1.0) / a0;
+    shelf.a2 = (1.0 - k / q + k * k) / a0;
+  }
+  Biquad highPass;
+  {
+    const double f0 = 38.13547087602444, q = 0.5003270373238773;
+    double k = std::tan(M_PI * f0 / sampleRate);
+    double a0 = 1.0 + k / q + k * k;
+    highPass.b0 = 1.0;
+    highPass.b1 = -2.0;
+    highPass.b2 = 1.0;
+    highPass.a1 = 2.0 * (k * k - 1.0) / a0;
+    highPass.a2 = (1.0 - k / q + k * k) / a0;
+  }
+
+  fOversample = sampleRate < 96000 ? 4 : (sampleRate < 192000 ? 2 : 1);
+  fTaps = fOversample > 1 ? kPeakTaps : 0;
+
+  fChannels.resize(channels);
+  for (int32 i = 0; i < channels; i++) {
+    Channel &channel = fChannels[i];
+    channel.shelf = shelf;
+    channel.highPass = highPass;
+    // 5.1 order L R C LFE Ls Rs: no LFE, surrounds +1.5 dB.
+    if (channels >= 6 && i == 3)
+      channel.weight = 0.0;
+    else if (channels >= 6 && (i == 4 || i == 5))
+      channel.weight = 1.41;
+    channel.history.assign(2 * fTaps, 0.0f);
+    channel.historyPos = 0;
+  }
+
+  // Hann-windowed sinc at the input Nyquist frequency, split into phases
+  // and stored newest-sample-last so each phase is one contiguous dot
+  // product. Every phase is normalized to unity gain at DC.
+  fPhases.assign((size_t)fOversample * fTaps, 0.0f);
+  const int32 length = fOversample * fTaps;
+  const double center = (length - 1) / 2.0;
+  for (int32 phase = 0; phase < fOversample && fTaps > 0; phase++) {
+    double sum = 0;
+    std::vector<double> coeffs(fTaps);
+    for (int32 k = 0; k < fTaps; k++) {
+      int32 n = phase + k * fOversample;
+      double x = (n - center) / fOversample;
+      double sinc = x == 0 ? 1.0 : std::sin(M_PI * x) / (M_PI * x);
+      double window = 0.5 - 0.5 * std::cos(2.0 * M_PI * (n + 0.5) / length);
+      coeffs[k] = sinc * window;
+      sum += coeffs[k];
+    }
+    for (int32 k = 0; k < fTaps; k++)
+      fPhases[phase * fTaps + (fTaps - 1 - k)] = (float)(coeffs[k] / sum);
+  }
+
+  fStepFrames = std::max<int64>(1, (int64)std::lround(sampleRate / 10.0));
+  return B_OK;
+}
+
+/**
+ * @brief Pushes `sample` into the channel history and returns the largest
+ * absolute value among it and the interpolated points before it.
+ *
+ * The dot products use four independent lanes so they map onto SIMD
+ * registers without reassociating floating point math.
+ */
+float LoudnessMeter::_InterpolatedPeak(Channel &channel, float sample) {
+  float peak = std::fabs(sample);
+  if (fTaps == 0)
+    return peak;
+
+  float *history = channel.history.data();
+  history[channel.historyPos] = sample;
+  history[channel.historyPos + fTaps] = sample;
+  channel.historyPos = (channel.historyPos + 1) % fTaps;
+  const float *window = history + channel.historyPos;
+
+  for (int32 phase = 1; phase < fOversample; phase++) {
+    const float *coeffs = fPhases.data() + phase * fTaps;
+    float lanes[4] = {0, 0, 0, 0};
+    for (int32 k = 0; k < fTaps; k += 4)
+      for (int32 lane = 0; lane < 4; lane++)
+        lanes[lane] += coeffs[k + lane] * window[k + lane];
+    float value = std::fabs((lanes[0] + lanes[1]) + (lanes[2] + lanes[3]));
+    peak = value > peak ? value : peak;
+  }
+  return peak;
+}
+
+void LoudnessMeter::Add(const float *samples, int64 frames) {
+  const int32 channels = (int32)fChannels.size();
+  if (channels == 0)
+    return;
+
+  float truePeak = fTruePeak;
+  for (int64 frame = 0; frame < frames; frame++) {
+    const float *in = samples + frame * channels;
+    for (int32 c = 0; c < channels; c++) {
+      Channel &channel = fChannels[c];
+      // The recursive filters stay scalar: each output feeds the next.
+      double y = channel.highPass.Process(channel.shelf.Process(in[c]));
+      fStepSum += channel.weight * y * y;
+      float peak = _InterpolatedPeak(channel, in[c]);
+      truePeak = peak > truePeak ? peak : truePeak;
+    }
+
+    if (++fStepFilled < fStepFrames)
+      continue;
+
+    fSteps[fStepIndex] = fStepSum;
+    fStepIndex = (fStepIndex + 1) % 4;
+    fStepCount = std::min(fStepCount + 1, (int32)4);
+    fStepSum = 0;
+    fStepFilled = 0;
+    if (fStepCount == 4)
+      fBlocks.push_back((fSteps[0] + fSteps[1] + fSteps[2] + fSteps[3]) /
+                        (4.0 * fStepFrames));
+  }
+  fTruePeak = truePeak;
+}
+
+double LoudnessMeter::Integrated(const std::vector<double> &blocks) {
+  const double absoluteGate = LufsToEnergy(-70.0);
+  double sum = 0;
+  size_t count = 0;
+  for (double energy : blocks) {
+    if (energy > absoluteGate) {
+      sum += energy;
+      count++;
+    }
+  }
+  if (count == 0)
+    return -HUGE_VAL;
+
+  // -10 LU relative to the absolute-gated mean is a factor of 10 in energy.
+  const double relativeGate = sum / count * 0.1;
+  sum = 0;
+  count = 0;
+  for (double energy : blocks) {
+    if (energy > absoluteGate && energy > relativeGate) {
+      sum += energy;
+      count++;
+    }
+  }
+  return count > 0 ? EnergyToLufs(sum / count) : -HUGE_VAL;
+}
+
+double LoudnessMeter::GainFor(double lufs) {
+  if (!std::isfinite(lufs))
+    return 0.0;
+  return kReferenceLufs - lufs;
+}
@@ -0,0 +1,86 @@
+#ifndef BETON_LOUDNESS_METER_H
+#define BETON_LOUDNESS_METER_H
+
+#include <SupportDefs.h>
+#include <vector>
+
+/**
+ * @class LoudnessMeter
+ * @brief Integrated loudness and true peak of a stream after EBU R128
+ * (ITU-R BS.1770-4).
+ *
+ * Samples are K-weighted (high shelf and high pass, two biquads per
+ * channel), squared, weighted per channel and summed into 400 ms blocks
+ * that overlap by 75 %. The integrated value is the power mean of the
+ * blocks above the -70 LUFS absolute gate and 10 LU below the mean of
+ * those. True peak is taken on a 4x oversampled signal (2x from 96 kHz).
+ *
+ * The per-block energies are kept, so an album value can be gated over the
+ * blocks of all its tracks (Integrated() on the concatenation).
+ */
+class LoudnessMeter {
+public:
+  LoudnessMeter();
+
+  /** @brief Starts a new measurement; B_BAD_VALUE for unusable formats. */
+  status_t Reset(float sampleRate, int32 channels);
+
+  /** @brief Adds `frames` interleaved float frames. */
+  void Add(const float *samples, int64 frames);
+
+  /** @brief Gated loudness in LUFS; -HUGE_VAL if everything was gated. */
+  double Integrated() const { return Integrated(fBlocks); }
+
+  /** @brief Largest absolute inter-sample value seen, 1.0 = full scale. */
+  float TruePeak() const { return fTruePeak; }
+
+  /** @brief Mean-square energy of every completed 400 ms block. */
+  const std::vector<double> &Blocks() const { return fBlocks; }
+
+  /** @brief Gated loudness of an arbitrary set of block energies. */
+  static double Integrated(const std::vector<double> &blocks);
+
+  /** @brief ReplayGain 2.0 gain (dB) that brings `lufs` to -18 LUFS. */
+  static double GainFor(double lufs);
+
+private:
+  /** @brief Direct form II transposed biquad; double for the low poles. */
+  struct Biquad {
+    double b0 = 1, b1 = 0, b2 = 0, a1 = 0, a2 = 0;
+    double z1 = 0, z2 = 0;
+
+    double Process(double x) {
+      double y = b0 * x + z1;
+      z1 = b1 * x - a1 * y + z2;
+      z2 = b2 * x - a2 * y;
+      return y;
+    }
+  };
+
+  struct Channel {
+    Biquad shelf;
+    Biquad highPass;
+    double weight = 1.0;
+    std::vector<float> history; ///< Last samples twice, for true peak
+    int32 historyPos = 0;
+  };
+
+  float _InterpolatedPeak(Channel &channel, float sample);
+
+  std::vector<Channel> fChannels;
+  /** @brief Polyphase interpolation filter, `fTaps` coefficients per phase. */
+  std::vector<float> fPhases;
+  int32 fOversample = 1;
+  int32 fTaps = 0;
+
+  int64 fStepFrames = 0;   ///< Frames per 100 ms step
+  int64 fStepFilled = 0;
+  double fStepSum = 0;     ///< Weighted sum of squares of the current step
+  double fSteps[4] = {0, 0, 0, 0};
+  int32 fStepCount = 0;    ///< Completed steps, saturating at 4
+  int32 fStepIndex = 0;
+  std::vector<double> fBlocks;
+  float fTruePeak = 0;
+};
+
+#endif // BETON_LOUDNESS_METER_H
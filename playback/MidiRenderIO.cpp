@@ -0,0 +1,223 @@
+#include "MidiRenderIO.h"
+
+#if ENABLE_MIDI_RENDERING
+
+#include "Debug.h"
+
+#include <Directory.h>
+#include <FindDirectory.h>
+#include <Path.h>
+
+#include <fluidsynth.h>
+
+#include <algorithm>
+#include <cstring>
+
+/** @brief First soundfont in the synth directory, empty if there is none. */
+static const BString &SoundFont() {
+  static const BString sPath = [] {
+    BString found;
+    BPath path;
+    if (find_directory(B_SYNTH_DIRECTORY, &path) != B_OK)
+      return found;
+    BDirectory directory(path.Path());
+    BEntry entry;
+    while (directory.GetNextEntry(&entry, true) == B_OK) {
+      BPath file;
+      if (entry.GetPath(&file) != B_OK)
+        continue;
+      BString name(file.Leaf());
+      name.ToLower();
+      if ((name.EndsWith(".sf2") || name.EndsWith(".sf3")) &&
+          (found.IsEmpty() || found.Compare(file.Path()) > 0))
+        found = file.Path();
+    }
+    return found;
+  }();
+  return sPath;
+}
+
+static void WriteLE16(uint8 *data, uint16 value) {
+  data[0] = value & 0xff;
+  data[1] = value >> 8;
+}
+
+static void WriteLE32(uint8 *data, uint32 value) {
+  WriteLE16(data, value & 0xffff);
+  WriteLE16(data + 2, value >> 16);
+}
+
+bool MidiRenderIO::Available() { return !SoundFont().IsEmpty(); }
+
+MidiRenderIO::MidiRenderIO(const entry_ref &ref)
+    : fStatus(B_NO_INIT), fSettings(nullptr), fSynth(nullptr),
+      fPlayer(nullptr), fFrames(0), fSize(0), fPosition(0),
+      fNextSegment(0) {
+  BPath path(&ref);
+  if (!Available() || path.InitCheck() != B_OK || !fTiming.SetTo(ref))
+    return;
+
+  fSettings = new_fluid_settings();
+  fluid_settings_setnum(fSettings, "synth.sample-rate", kFrameRate);
+  // Advance the song with the rendered samples rather than the clock.
+  fluid_settings_setstr(fSettings, "player.timing-source", "sample");
+  fSynth = new_fluid_synth(fSettings);
+  if (fSynth == nullptr ||
+      fluid_synth_sfload(fSynth, SoundFont().String(), 1) == FLUID_FAILED) {
+    DEBUG_PRINT("midi render: cannot load %s\n", SoundFont().String());
+    return;
+  }
+  fPlayer = new_fluid_player(fSynth);
+  if (fPlayer == nullptr ||
+      fluid_player_add(fPlayer, path.Path()) != FLUID_OK ||
+      fluid_player_play(fPlayer) != FLUID_OK) {
+    DEBUG_PRINT("midi render: cannot play %s\n", path.Path());
+    return;
+  }
+
+  fFrames = (fTiming.Duration() + kTail) * kFrameRate / 1000000LL;
+  const uint32 frameSize = kChannels * sizeof(int16);
+  const uint32 dataSize = (uint32)std::min<int64>(fFrames * frameSize,
+                                                  0x7fff0000);
+  fFrames = dataSize / frameSize;
+  fSize = kHeaderSize + dataSize;
+
+  memcpy(fHeader, "RIFF", 4);
+  WriteLE32(fHeader + 4, (uint32)(fSize - 8));
+  memcpy(fHeader + 8, "WAVEfmt ", 8);
+  WriteLE32(fHeader + 16, 16);
+  WriteLE16(fHeader + 20, 1); // PCM
+  WriteLE16(fHeader + 22, kChannels);
+  WriteLE32(fHeader + 24, kFrameRate);
+  WriteLE32(fHeader + 28, kFrameRate * frameSize);
+  WriteLE16(fHeader + 32, frameSize);
+  WriteLE16(fHeader + 34, 16);
+  memcpy(fHeader + 36, "data", 4);
+  WriteLE32(fHeader + 40, dataSize);
+  fStatus = B_OK;
+}
+
+MidiRenderIO::~MidiRenderIO() {
+  if (fPlayer != nullptr) {
+    fluid_player_stop(fPlayer);
+    delete_fluid_player(fPlayer);
+  }
+  if (fSynth != nullptr)
+    delete_fluid_synth(fSynth);
+  if (fSettings != nullptr)
+    delete_fluid_settings(fSettings);
+}
+
+ssize_t MidiRenderIO::ReadAt(off_t position, void *buffer, size_t size) {
+  if (fStatus != B_OK)
+    return fStatus;
+  if (position < 0)
+    return B_BAD_VALUE;
+  if (position >= fSize || size == 0)
+    return 0;
+  size = (size_t)std::min<off_t>(size, fSize - position);
+
+  uint8 *out = static_cast<uint8 *>(buffer);
+  size_t copied = 0;
+  if (position < (off_t)kHeaderSize) {
+    copied = std::min(size, kHeaderSize - (size_t)position);
+    memcpy(out, fHeader + position, copied);
+  }
+
+  const size_t segmentBytes = kSegmentFrames * kChannels * sizeof(int16);
+  while (copied < size) {
+    const off_t data = position + copied - kHeaderSize;
+    const Segment *segment = _SegmentAt(data / segmentBytes);
+    const size_t offset = data % segmentBytes;
+    const size_t available = segment->samples.size() * sizeof(int16);
+    if (offset >= available)
+      break;
+    size_t count = std::min(size - copied, available - offset);
+    memcpy(out + copied,
+           reinterpret_cast<const uint8 *>(segment->samples.data()) + offset,
+           count);
+    copied += count;
+  }
+  return copied;
+}
+
+ssize_t MidiRenderIO::WriteAt(off_t, const void *, size_t) {
+  return B_NOT_ALLOWED;
+}
+
+off_t MidiRenderIO::Seek(off_t position, uint32 seekMode) {
+  switch (seekMode) {
+  case SEEK_SET:
+    break;
+  case SEEK_CUR:
+    position += fPosition;
+    break;
+  case SEEK_END:
+    position += fSize;
+    break;
+  default:
+    return B_BAD_VALUE;
+  }
+  if (position < 0)
+    return B_BAD_VALUE;
+  fPosition = position;
+  return fPosition;
+}
+
+status_t MidiRenderIO::SetSize(off_t) { return B_NOT_ALLOWED; }
+
+status_t MidiRenderIO::GetSize(off_t *size) const {
+  if (fStatus != B_OK)
+    return fStatus;
+  *size = fSize;
+  return B_OK;
+}
+
+/** @brief Segment `index`, from the cache or freshly rendered. */
+const MidiRenderIO::Segment *MidiRenderIO::_SegmentAt(int64 index) {
+  auto it = std::find_if(fCache.begin(), fCache.end(),
+                         [index](const Segment &segment) {
+                           return segment.index == index;
+                         });
+  if (it != fCache.end()) {
+    std::rotate(it, it + 1, fCache.end());
+    return &fCache.back();
+  }
+
+  if (fCache.size() < kSegments) {
+    fCache.emplace_back();
+  } else {
+    // Recycle the least recently used buffer.
+    std::rotate(fCache.begin(), fCache.begin() + 1, fCache.end());
+  }
+  Segment &segment = fCache.back();
+  segment.index = index;
+  _Render(index, segment);
+  return &segment;
+}
+
+void MidiRenderIO::_Render(int64 index, Segment &segment) {
+  const int64 start = index * kSegmentFrames;
+  const int64 frames = std::max<int64>(
+      0, std::min<int64>(kSegmentFrames, fFrames - start));
+  segment.samples.resize(frames * kChannels);
+  if (frames == 0)
+    return;
+
+  if (index != fNextSegment) {
+    const bigtime_t time = start * 1000000LL / kFrameRate;
+    fluid_synth_all_sounds_off(fSynth, -1);
+    if (fluid_player_get_status(fPlayer) != FLUID_PLAYER_PLAYING)
+      fluid_player_play(fPlayer);
+    fluid_player_seek(fPlayer, fTiming.TickAt(time));
+  }
+  int16 *samples = segment.samples.data();
+  fluid_synth_write_s16(fSynth, (int)frames, samples, 0, kChannels, samples,
+                        1, kChannels);
+  fNextSegment = index + 1;
+}
+
+MidiMediaFile::MidiMediaFile(const entry_ref &ref)
+    : MidiRenderSource(ref), BMediaFile(&fSource) {}
+
+#endif // ENABLE_MIDI_RENDERING
@@ -0,0 +1,96 @@
+#ifndef BETON_MIDI_RENDER_IO_H
+#define BETON_MIDI_RENDER_IO_H
+
+#include "Config.h"
+
+#if ENABLE_MIDI_RENDERING
+
+#include "MidiTiming.h"
+
+#include <DataIO.h>
+#include <Entry.h>
+#include <MediaFile.h>
+#include <String.h>
+#include <vector>
+
+struct _fluid_hashtable_t;
+struct _fluid_synth_t;
+struct _fluid_player_t;
+
+/**
+ * @class MidiRenderIO
+ * @brief A MIDI file rendered by FluidSynth, presented as a WAVE file.
+ *
+ * The Media Kit's WAVE reader sees a 16-bit stereo file of the song's
+ * length plus kTail for the last notes to ring out; reading it renders the
+ * song in segments of kSegmentFrames. The most recently used kSegments are
+ * kept, so seeking back within them and the extractor's probing cost
+ * nothing. A read past the segment the synth stopped at seeks the player
+ * to the tick of that time (MidiTiming) and silences held voices; notes
+ * struck before the target are not heard, as with any MIDI seek.
+ *
+ * The decoder thread reads ahead of the sound player, so the rendering is
+ * look-ahead like decoding any other file. Not thread-safe.
+ */
+class MidiRenderIO : public BPositionIO {
+public:
+  static const int32 kFrameRate = 44100;
+  static const int32 kChannels = 2;
+  static const int64 kSegmentFrames = 44100; ///< One second
+  static const size_t kSegments = 32;
+  static const bigtime_t kTail = 2000000;
+
+  explicit MidiRenderIO(const entry_ref &ref);
+  ~MidiRenderIO();
+
+  status_t InitCheck() const { return fStatus; }
+
+  /** @brief Whether a soundfont is installed, so MIDI can be rendered. */
+  static bool Available();
+
+  ssize_t ReadAt(off_t position, void *buffer, size_t size) override;
+  ssize_t WriteAt(off_t position, const void *buffer, size_t size) override;
+  off_t Seek(off_t position, uint32 seekMode) override;
+  off_t Position() const override { return fPosition; }
+  status_t SetSize(off_t size) override;
+  status_t GetSize(off_t *size) const override;
+
+private:
+  struct Segment {
+    int64 index;
+    std::vector<int16> samples;
+  };
+
+  static const size_t kHeaderSize = 44;
+
+  const Segment *_SegmentAt(int64 index);
+  void _Render(int64 index, Segment &segment);
+
+  status_t fStatus;
+  MidiTiming fTiming;
+  _fluid_hashtable_t *fSettings;
+  _fluid_synth_t *fSynth;
+  _fluid_player_t *fPlayer;
+  uint8 fHeader[kHeaderSize];
+  int64 fFrames;
+  off_t fSize;
+  off_t fPosition;
+  int64 fNextSegment; ///< Segment the synth renders next without a seek
+  std::vector<Segment> fCache; ///< Least recently used first
+};
+
+/** @brief Owns the source of a MidiMediaFile; a base so it outlives it. */
+struct MidiRenderSource {
+  explicit MidiRenderSource(const entry_ref &ref) : fSource(ref) {}
+  MidiRenderIO fSource;
+};
+
+/** @brief BMediaFile of a MIDI file, decoded through a MidiRenderIO. */
+class MidiMediaFile : private MidiRenderSource, public BMediaFile {
+public:
+  explicit MidiMediaFile(const entry_ref &ref);
+};
+
+#endif // ENABLE_MIDI_RENDERING
+
+#endif // BETON_MIDI_RENDER_IO_H
@@ -0,0 +1,216 @@
+#include "MidiTiming.h"
+
+#include <File.h>
+
+#include <algorithm>
+#include <cstring>
+
+static uint16 ReadBE16(const uint8 *data) {
+  return ((uint16)data[0] << 8) | data[1];
+}
+
+static uint32 ReadBE32(const uint8 *data) {
+  return ((uint32)data[0] << 24) | ((uint32)data[1] << 16) |
+         ((uint32)data[2] << 8) | data[3];
+}
+
+static bool ReadMidiVar(const uint8 *data, size_t size, size_t &offset,
+                        uint32 &value) {
+  value = 0;
+  for (int i = 0; i < 4; i++) {
+    if (offset >= size)
+      return false;
+    uint8 byte = data[offset++];
+    value = (value << 7) | (byte & 0x7f);
+    if ((byte & 0x80) == 0)
+      return true;
+  }
+  return true;
+}
+
+static bool SkipMidiData(const uint8 *data, size_t size, size_t &offset,
+                         size_t count) {
+  if (offset + count > size)
+    return false;
+  offset += count;
+  return true;
+}
+
+MidiTiming::MidiTiming()
+    : fDuration(0), fTickCount(0), fTicksPerQuarter(0), fTicksPerSecond(0) {}
+
+bool MidiTiming::SetTo(const entry_ref &ref) {
+  fDuration = 0;
+  fTickCount = 0;
+  fTicksPerQuarter = 0;
+  fTicksPerSecond = 0;
+  fTempos.clear();
+
+  BFile file(&ref, B_READ_ONLY);
+  if (file.InitCheck() != B_OK)
+    return false;
+
+  off_t fileSize = 0;
+  if (file.GetSize(&fileSize) != B_OK || fileSize < 14 ||
+      fileSize > 16 * 1024 * 1024) {
+    return false;
+  }
+
+  std::vector<uint8> bytes((size_t)fileSize);
+  if (file.Read(bytes.data(), bytes.size()) != (ssize_t)bytes.size())
+    return false;
+
+  const uint8 *data = bytes.data();
+  size_t size = bytes.size();
+  size_t offset = 0;
+  if (memcmp(data, "MThd", 4) != 0)
+    return false;
+  offset += 4;
+
+  uint32 headerSize = ReadBE32(data + offset);
+  offset += 4;
+  if (headerSize < 6 || offset + headerSize > size)
+    return false;
+
+  uint16 tracks = ReadBE16(data + offset + 2);
+  int16 division = (int16)ReadBE16(data + offset + 4);
+  offset += headerSize;
+
+  uint32 maxTick = 0;
+  std::vector<Tempo> tempos;
+  tempos.push_back({0, 500000, 0});
+
+  for (uint16 track = 0; track < tracks && offset + 8 <= size; track++) {
+    if (memcmp(data + offset, "MTrk", 4) != 0)
+      break;
+    offset += 4;
+    uint32 trackSize = ReadBE32(data + offset);
+    offset += 4;
+    if (offset + trackSize > size)
+      return false;
+
+    size_t trackEnd = offset + trackSize;
+    uint32 tick = 0;
+    uint8 runningStatus = 0;
+    while (offset < trackEnd) {
+      uint32 delta = 0;
+      if (!ReadMidiVar(data, trackEnd, offset, delta))
+        return false;
+      tick += delta;
+      maxTick = std::max(maxTick, tick);
+      if (offset >= trackEnd)
+        break;
+
+      uint8 status = data[offset++];
+      if (status < 0x80) {
+        if (runningStatus == 0)
+          return false;
+        offset--;
+        status = runningStatus;
+      } else if (status < 0xf0) {
+        runningStatus = status;
+      }
+
+      if (status == 0xff) {
+        if (offset >= trackEnd)
+          return false;
+        uint8 metaType = data[offset++];
+        uint32 length = 0;
+        if (!ReadMidiVar(data, trackEnd, offset, length))
+          return false;
+        if (offset + length > trackEnd)
+          return false;
+        if (metaType == 0x51 && length == 3) {
+          uint32 tempo = ((uint32)data[offset] << 16) |
+                         ((uint32)data[offset + 1] << 8) | data[offset + 2];
+          if (tempo > 0)
+            tempos.push_back({tick, tempo, 0});
+        }
+        offset += length;
+      } else if (status == 0xf0 || status == 0xf7) {
+        uint32 length = 0;
+        if (!ReadMidiVar(data, trackEnd, offset, length) ||
+            !SkipMidiData(data, trackEnd, offset, length)) {
+          return false;
+        }
+      } else {
+        uint8 type = status & 0xf0;
+        size_t dataBytes = (type == 0xc0 || type == 0xd0) ? 1 : 2;
+        if (!SkipMidiData(data, trackEnd, offset, dataBytes))
+          return false;
+      }
+    }
+    offset = trackEnd;
+  }
+
+  if (maxTick == 0)
+    return false;
+  const int32 tickCount = (int32)std::min(maxTick, (uint32)0x7fffffff);
+
+  if (division < 0) {
+    int8 fpsByte = (int8)((division >> 8) & 0xff);
+    int fps = -fpsByte;
+    int subframes = division & 0xff;
+    if (fps <= 0 || subframes <= 0)
+      return false;
+    fTicksPerSecond = fps * subframes;
+    fDuration = ((bigtime_t)maxTick * 1000000LL) / fTicksPerSecond;
+    fTickCount = tickCount;
+    return fDuration > 0;
+  }
+
+  uint16 ticksPerQuarter = (uint16)division;
+  if (ticksPerQuarter == 0)
+    return false;
+
+  std::stable_sort(tempos.begin(), tempos.end(),
+                   [](const Tempo &a, const Tempo &b) {
+                     return a.tick < b.tick;
+                   });
+
+  // Keep the last change per tick, each with the time it takes effect.
+  uint32 lastTick = 0;
+  uint32 currentTempo = 500000;
+  bigtime_t total = 0;
+  for (const auto &event : tempos) {
+    if (event.tick > maxTick)
+      break;
+    if (event.tick > lastTick) {
+      total += ((bigtime_t)(event.tick - lastTick) * currentTempo) /
+               ticksPerQuarter;
+      lastTick = event.tick;
+    }
+    currentTempo = event.tempo;
+    if (!fTempos.empty() && fTempos.back().tick == event.tick)
+      fTempos.back().tempo = event.tempo;
+    else
+      fTempos.push_back({event.tick, event.tempo, total});
+  }
+  if (maxTick > lastTick) {
+    total += ((bigtime_t)(maxTick - lastTick) * currentTempo) /
+             ticksPerQuarter;
+  }
+
+  fDuration = total;
+  fTickCount = tickCount;
+  fTicksPerQuarter = ticksPerQuarter;
+  return fDuration > 0;
+}
+
+int32 MidiTiming::TickAt(bigtime_t time) const {
+  if (time <= 0 || fTickCount == 0)
+    return 0;
+  if (time >= fDuration)
+    return fTickCount;
+  if (fTicksPerQuarter == 0)
+    return (int32)std::min<bigtime_t>(fTickCount,
+                                      time * fTicksPerSecond / 1000000LL);
+
+  auto it = std::upper_bound(fTempos.begin(), fTempos.end(), time,
+                             [](bigtime_t value, const Tempo &tempo) {
+                               return value < tempo.start;
+                             });
+  const Tempo &tempo = *(it - 1);
+  bigtime_t ticks = (time - tempo.start) * fTicksPerQuarter / tempo.tempo;
+  return (int32)std::min<bigtime_t>(fTickCount, tempo.tick + ticks);
+}
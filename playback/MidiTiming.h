@@ -0,0 +1,44 @@
+#ifndef BETON_MIDI_TIMING_H
+#define BETON_MIDI_TIMING_H
+
+#include <Entry.h>
+#include <SupportDefs.h>
+#include <vector>
+
+/**
+ * @class MidiTiming
+ * @brief Length and tempo map of a Standard MIDI File.
+ *
+ * Reads the header and every track once, for the duration the synth does
+ * not report reliably and for converting playback times into ticks when
+ * seeking rendered MIDI.
+ */
+class MidiTiming {
+public:
+  MidiTiming();
+
+  /** @brief Parses the file of `ref`; false if it is not a usable SMF. */
+  bool SetTo(const entry_ref &ref);
+
+  bigtime_t Duration() const { return fDuration; }
+  /** @brief Tick of the last event. */
+  int32 TickCount() const { return fTickCount; }
+
+  /** @brief Tick reached after `time` of playback, clamped to the end. */
+  int32 TickAt(bigtime_t time) const;
+
+private:
+  struct Tempo {
+    uint32 tick;
+    uint32 tempo;       ///< Microseconds per quarter note
+    bigtime_t start;    ///< Time of `tick`
+  };
+
+  bigtime_t fDuration;
+  int32 fTickCount;
+  uint16 fTicksPerQuarter; ///< 0 for SMPTE timing
+  int32 fTicksPerSecond;   ///< SMPTE timing only
+  std::vector<Tempo> fTempos;
+};
+
+#endif // BETON_MIDI_TIMING_H
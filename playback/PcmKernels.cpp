@@ -0,0 +1,288 @@
+#include "PcmKernels.h"
+
+#include <MediaDefs.h>
+
+#include <algorithm>
+#include <cmath>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#define PCM_KERNELS_SIMD 1
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#define PCM_KERNELS_SIMD 1
+#endif
+
+namespace {
+
+// Largest float below 2^31; rounding anything larger would overflow.
+const float kInt32Max = 2147483520.0f;
+
+#if defined(__SSE2__)
+
+typedef __m128 F4;
+
+inline F4 Load(const float *p) { return _mm_loadu_ps(p); }
+inline void Store(float *p, F4 v) { _mm_storeu_ps(p, v); }
+inline F4 Splat(float f) { return _mm_set1_ps(f); }
+inline F4 Lanes(float a, float b, float c, float d) {
+  return _mm_setr_ps(a, b, c, d);
+}
+inline F4 Add(F4 a, F4 b) { return _mm_add_ps(a, b); }
+inline F4 Mul(F4 a, F4 b) { return _mm_mul_ps(a, b); }
+
+inline void LoadInt16(const int16 *p, F4 &lo, F4 &hi) {
+  __m128i v = _mm_loadu_si128((const __m128i *)p);
+  // Unpacking into the high word and shifting back sign-extends.
+  lo = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16));
+  hi = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpackhi_epi16(v, v), 16));
+}
+inline void StoreInt16(int16 *p, F4 lo, F4 hi) {
+  _mm_storeu_si128((__m128i *)p, _mm_packs_epi32(_mm_cvtps_epi32(lo),
+                                                 _mm_cvtps_epi32(hi)));
+}
+inline F4 LoadInt32(const int32 *p) {
+  return _mm_cvtepi32_ps(_mm_loadu_si128((const __m128i *)p));
+}
+inline void StoreInt32(int32 *p, F4 v) {
+  v = _mm_max_ps(_mm_min_ps(v, Splat(kInt32Max)), Splat(-kInt32Max));
+  _mm_storeu_si128((__m128i *)p, _mm_cvtps_epi32(v));
+}
+
+#elif defined(__ARM_NEON)
+
+typedef float32x4_t F4;
+
+inline F4 Load(const float *p) { return vld1q_f32(p); }
+inline void Store(float *p, F4 v) { vst1q_f32(p, v); }
+inline F4 Splat(float f) { return vdupq_n_f32(f); }
+inline F4 Lanes(float a, float b, float c, float d) {
+  const float lanes[4] = {a, b, c, d};
+  return vld1q_f32(lanes);
+}
+inline F4 Add(F4 a, F4 b) { return vaddq_f32(a, b); }
+inline F4 Mul(F4 a, F4 b) { return vmulq_f32(a, b); }
+
+inline int32x4_t Round(F4 v) {
+#if defined(__aarch64__)
+  return vcvtnq_s32_f32(v);
+#else
+  return vcvtq_s32_f32(v);
+#endif
+}
+inline void LoadInt16(const int16 *p, F4 &lo, F4 &hi) {
+  int16x8_t v = vld1q_s16(p);
+  lo = vcvtq_f32_s32(vmovl_s16(vget_low_s16(v)));
+  hi = vcvtq_f32_s32(vmovl_s16(vget_high_s16(v)));
+}
+inline void StoreInt16(int16 *p, F4 lo, F4 hi) {
+  vst1q_s16(p, vcombine_s16(vqmovn_s32(Round(lo)), vqmovn_s32(Round(hi))));
+}
+inline F4 LoadInt32(const int32 *p) { return vcvtq_f32_s32(vld1q_s32(p)); }
+inline void StoreInt32(int32 *p, F4 v) {
+  v = vmaxq_f32(vminq_f32(v, Splat(kInt32Max)), Splat(-kInt32Max));
+  vst1q_s32(p, Round(v));
+}
+
+#endif
+
+inline int16 SaturateInt16(float value) {
+  int32 rounded = (int32)lrintf(value);
+  return (int16)std::max<int32>(-32768, std::min<int32>(32767, rounded));
+}
+
+inline int32 SaturateInt32(double value) {
+  return (int32)std::max<double>(-2147483648.0,
+                                 std::min<double>(2147483647.0, value));
+}
+
+/** @brief Scalar ramp for any layout, starting at frame `first`. */
+template <typename Sample, typename Scale>
+void RampScalar(Sample *samples, int32 channels, int64 first, int64 frames,
+                float start, float step, Scale scale) {
+  for (int64 frame = first; frame < frames; frame++) {
+    float gain = start + frame * step;
+    for (int32 channel = 0; channel < channels; channel++) {
+      Sample &sample = samples[frame * channels + channel];
+      sample = scale(sample, gain);
+    }
+  }
+}
+
+} // namespace
+
+bool PcmKernels::Supports(uint32 format) {
+  return format == media_raw_audio_format::B_AUDIO_FLOAT ||
+         format == media_raw_audio_format::B_AUDIO_SHORT ||
+         format == media_raw_audio_format::B_AUDIO_INT;
+}
+
+void PcmKernels::ApplyGainRamp(void *samples, uint32 format, int32 channels,
+                               int64 frames, float start, float step) {
+  if (samples == nullptr || channels <= 0 || frames <= 0)
+    return;
+
+  int64 done = 0; ///< Frames handled by the vector loop
+#if PCM_KERNELS_SIMD
+  if (channels == 1 || channels == 2 || channels == 4) {
+    // Four samples cover 4 / channels frames; lane gains follow the frame.
+    const float perLane = 1.0f / channels;
+    F4 frame = Lanes(0.0f, std::floor(perLane), std::floor(2 * perLane),
+                     std::floor(3 * perLane));
+    const F4 advance = Splat(4.0f / channels);
+    const F4 vStart = Splat(start);
+    const F4 vStep = Splat(step);
+    const size_t count = (size_t)(frames * channels);
+    size_t i = 0;
+
+    switch (format) {
+    case media_raw_audio_format::B_AUDIO_FLOAT: {
+      float *p = static_cast<float *>(samples);
+      for (; i + 4 <= count; i += 4) {
+        Store(p + i, Mul(Load(p + i), Add(vStart, Mul(frame, vStep))));
+        frame = Add(frame, advance);
+      }
+      break;
+    }
+    case media_raw_audio_format::B_AUDIO_SHORT: {
+      int16 *p = static_cast<int16 *>(samples);
+      for (; i + 8 <= count; i += 8) {
+        F4 lo, hi;
+        LoadInt16(p + i, lo, hi);
+        F4 gainLo = Add(vStart, Mul(frame, vStep));
+        frame = Add(frame, advance);
+        F4 gainHi = Add(vStart, Mul(frame, vStep));
+        frame = Add(frame, advance);
+        StoreInt16(p + i, Mul(lo, gainLo), Mul(hi, gainHi));
+      }
+      break;
+    }
+    case media_raw_audio_format::B_AUDIO_INT: {
+      int32 *p = static_cast<int32 *>(samples);
+      for (; i + 4 <= count; i += 4) {
+        StoreInt32(p + i,
+                   Mul(LoadInt32(p + i), Add(vStart, Mul(frame, vStep))));
+        frame = Add(frame, advance);
+      }
+      break;
+    }
+    }
+    done = (int64)(i / channels);
+  }
+#endif
+
+  switch (format) {
+  case media_raw_audio_format::B_AUDIO_FLOAT:
+    RampScalar(static_cast<float *>(samples), channels, done, frames, start,
+               step, [](float s, float g) { return s * g; });
+    break;
+  case media_raw_audio_format::B_AUDIO_SHORT:
+    RampScalar(static_cast<int16 *>(samples), channels, done, frames, start,
+               step, [](int16 s, float g) { return SaturateInt16(s * g); });
+    break;
+  case media_raw_audio_format::B_AUDIO_INT:
+    RampScalar(static_cast<int32 *>(samples), channels, done, frames, start,
+               step,
+               [](int32 s, float g) { return SaturateInt32((double)s * g); });
+    break;
+  }
+}
+
+void PcmKernels::Mix(void *out, const void *in, uint32 format, size_t count,
+                     const float *gainOut, const float *gainIn) {
+  size_t i = 0;
+  switch (format) {
+  case media_raw_audio_format::B_AUDIO_FLOAT: {
+    float *o = static_cast<float *>(out);
+    const float *n = static_cast<const float *>(in);
+#if PCM_KERNELS_SIMD
+    for (; i + 4 <= count; i += 4)
+      Store(o + i, Add(Mul(Load(o + i), Load(gainOut + i)),
+                       Mul(Load(n + i), Load(gainIn + i))));
+#endif
+    for (; i < count; i++)
+      o[i] = o[i] * gainOut[i] + n[i] * gainIn[i];
+    break;
+  }
+  case media_raw_audio_format::B_AUDIO_SHORT: {
+    int16 *o = static_cast<int16 *>(out);
+    const int16 *n = static_cast<const int16 *>(in);
+#if PCM_KERNELS_SIMD
+    for (; i + 8 <= count; i += 8) {
+      F4 oLo, oHi, nLo, nHi;
+      LoadInt16(o + i, oLo, oHi);
+      LoadInt16(n + i, nLo, nHi);
+      StoreInt16(o + i,
+                 Add(Mul(oLo, Load(gainOut + i)), Mul(nLo, Load(gainIn + i))),
+                 Add(Mul(oHi, Load(gainOut + i + 4)),
+                     Mul(nHi, Load(gainIn + i + 4))));
+    }
+#endif
+    for (; i < count; i++)
+      o[i] = SaturateInt16(o[i] * gainOut[i] + n[i] * gainIn[i]);
+    break;
+  }
+  case media_raw_audio_format::B_AUDIO_INT: {
+    int32 *o = static_cast<int32 *>(out);
+    const int32 *n = static_cast<const int32 *>(in);
+#if PCM_KERNELS_SIMD
+    for (; i + 4 <= count; i += 4)
+      StoreInt32(o + i, Add(Mul(LoadInt32(o + i), Load(gainOut + i)),
+                            Mul(LoadInt32(n + i), Load(gainIn + i))));
+#endif
+    for (; i < count; i++)
+      o[i] = SaturateInt32((double)o[i] * gainOut[i] +
+                           (double)n[i] * gainIn[i]);
+    break;
+  }
+  }
+}
+
+void PcmKernels::Int16ToFloat(const int16 *in, float *out, size_t count) {
+  const float kScale = 1.0f / 32768.0f;
+  size_t i = 0;
+#if PCM_KERNELS_SIMD
+  for (; i + 8 <= count; i += 8) {
+    F4 lo, hi;
+    LoadInt16(in + i, lo, hi);
+    Store(out + i, Mul(lo, Splat(kScale)));
+    Store(out + i + 4, Mul(hi, Splat(kScale)));
+  }
+#endif
+  for (; i < count; i++)
+    out[i] = in[i] * kScale;
+}
+
+void PcmKernels::Int32ToFloat(const int32 *in, float *out, size_t count) {
+  const float kScale = 1.0f / 2147483648.0f;
+  size_t i = 0;
+#if PCM_KERNELS_SIMD
+  for (; i + 4 <= count; i += 4)
+    Store(out + i, Mul(LoadInt32(in + i), Splat(kScale)));
+#endif
+  for (; i < count; i++)
+    out[i] = in[i] * kScale;
+}
+
+void PcmKernels::FloatToInt16(const float *in, int16 *out, size_t count) {
+  const float kScale = 32768.0f;
+  size_t i = 0;
+#if PCM_KERNELS_SIMD
+  for (; i + 8 <= count; i += 8)
+    StoreInt16(out + i, Mul(Load(in + i), Splat(kScale)),
+               Mul(Load(in + i + 4), Splat(kScale)));
+#endif
+  for (; i < count; i++)
+    out[i] = SaturateInt16(in[i] * kScale);
+}
+
+void PcmKernels::FloatToInt32(const float *in, int32 *out, size_t count) {
+  const float kScale = 2147483648.0f;
+  size_t i = 0;
+#if PCM_KERNELS_SIMD
+  for (; i + 4 <= count; i += 4)
+    StoreInt32(out + i, Mul(Load(in + i), Splat(kScale)));
+#endif
+  for (; i < count; i++)
+    out[i] = SaturateInt32((double)in[i] * kScale);
+}
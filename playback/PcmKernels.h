@@ -0,0 +1,49 @@
+#ifndef BETON_PCM_KERNELS_H
+#define BETON_PCM_KERNELS_H
+
+#include <SupportDefs.h>
+
+/**
+ * @class PcmKernels
+ * @brief Vector DSP kernels for interleaved PCM in the playback path.
+ *
+ * `format` arguments take `media_raw_audio_format::format` values; float,
+ * int16 and int32 samples are handled. The kernels process four samples per
+ * step with SSE2 (x86) or NEON (ARM) and fall back to scalar code elsewhere
+ * and for the tail of a buffer. Integer results saturate.
+ *
+ * None of them allocates or locks, so they are safe in the sound player
+ * callback.
+ */
+class PcmKernels {
+public:
+  /** @brief Whether the gain and mix kernels handle `format`. */
+  static bool Supports(uint32 format);
+
+  /**
+   * @brief Scales `frames` frames by a linear ramp: frame `i` is multiplied
+   * by `start + i * step`.
+   *
+   * Mono, stereo and quad ramps are vectorized; other layouts are scalar.
+   */
+  static void ApplyGainRamp(void *samples, uint32 format, int32 channels,
+                            int64 frames, float start, float step);
+
+  /**
+   * @brief `out[i] = out[i] * gainOut[i] + in[i] * gainIn[i]` over `count`
+   * samples.
+   */
+  static void Mix(void *out, const void *in, uint32 format, size_t count,
+                  const float *gainOut, const float *gainIn);
+
+  /** @brief Converts int16 samples to floats in [-1, 1). */
+  static void Int16ToFloat(const int16 *in, float *out, size_t count);
+  /** @brief Converts int32 samples to floats in [-1, 1). */
+  static void Int32ToFloat(const int32 *in, float *out, size_t count);
+  /** @brief Converts floats in [-1, 1) back to int16 samples. */
+  static void FloatToInt16(const float *in, int16 *out, size_t count);
+  /** @brief Converts floats in [-1, 1) back to int32 samples. */
+  static void FloatToInt32(const float *in, int32 *out, size_t count);
+};
+
+#endif // BETON_PCM_KERNELS_H
@@ -0,0 +1,82 @@
+#include "PcmRingBuffer.h"
+
+#include <algorithm>
+#include <cstring>
+#include <new>
+
+PcmRingBuffer::PcmRingBuffer()
+    : fData(nullptr), fCapacity(0), fWrite(0), fRead(0), fDiscardUntil(0) {}
+
+PcmRingBuffer::~PcmRingBuffer() { delete[] fData; }
+
+status_t PcmRingBuffer::SetCapacity(size_t bytes) {
+  size_t capacity = 4096;
+  while (capacity < bytes)
+    capacity <<= 1;
+
+  if (capacity != fCapacity) {
+    uint8 *data = new (std::nothrow) uint8[capacity];
+    if (data == nullptr)
+      return B_NO_MEMORY;
+    delete[] fData;
+    fData = data;
+    fCapacity = capacity;
+  }
+  Clear();
+  return B_OK;
+}
+
+void PcmRingBuffer::Clear() {
+  fWrite.store(0, std::memory_order_relaxed);
+  fRead.store(0, std::memory_order_relaxed);
+  fDiscardUntil.store(0, std::memory_order_release);
+}
+
+size_t PcmRingBuffer::Space() const {
+  uint64 used = fWrite.load(std::memory_order_relaxed) -
+                fRead.load(std::memory_order_acquire);
+  return fCapacity - (size_t)used;
+}
+
+size_t PcmRingBuffer::Write(const void *data, size_t size) {
+  if (fData == nullptr)
+    return 0;
+
+  uint64 write = fWrite.load(std::memory_order_relaxed);
+  size = std::min(size, Space());
+  size_t offset = (size_t)(write & (fCapacity - 1));
+  size_t first = std::min(size, fCapacity - offset);
+  memcpy(fData + offset, data, first);
+  memcpy(fData, (const uint8 *)data + first, size - first);
+  fWrite.store(write + size, std::memory_order_release);
+  return size;
+}
+
+void PcmRingBuffer::DiscardWritten() {
+  fDiscardUntil.store(fWrite.load(std::memory_order_relaxed),
+                      std::memory_order_release);
+}
+
+size_t PcmRingBuffer::Available() const {
+  uint64 read = std::max(fRead.load(std::memory_order_relaxed),
+                         fDiscardUntil.load(std::memory_order_acquire));
+  return (size_t)(fWrite.load(std::memory_order_acquire) - read);
+}
+
+size_t PcmRingBuffer::Read(void *data, size_t size, uint64 *start) {
+  if (fData == nullptr)
+    return 0;
+
+  uint64 read = std::max(fRead.load(std::memory_order_relaxed),
+                         fDiscardUntil.load(std::memory_order_acquire));
+  if (start != nullptr)
+    *start = read;
+  uint64 write = fWrite.load(std::memory_order_acquire);
+  size = std::min(size, (size_t)(write - read));
+  size_t offset = (size_t)(read & (fCapacity - 1));
+  size_t first = std::min(size, fCapacity - offset);
+  memcpy(data, fData + offset, first);
+  memcpy((uint8 *)data + first, fData, size - first);
+  fRead.store(read + size, std::memory_order_release);
+  return size;
+}
@@ -0,0 +1,70 @@
+#ifndef BETON_PCM_RING_BUFFER_H
+#define BETON_PCM_RING_BUFFER_H
+
+#include <SupportDefs.h>
+#include <atomic>
+
+/**
+ * @class PcmRingBuffer
+ * @brief Lock-free single-producer/single-consumer byte ring for PCM data.
+ *
+ * The decoder thread writes and the audio callback reads; neither side
+ * blocks or allocates. Read and write positions are free-running 64-bit
+ * counters, so the fill level is always `write - read`.
+ *
+ * Flushing (after a seek) is done by the producer through DiscardWritten():
+ * it only publishes a mark, and the consumer skips everything before it on
+ * its next Read(). The consumer thus never waits for the producer, and the
+ * producer never touches the read position.
+ */
+class PcmRingBuffer {
+public:
+  PcmRingBuffer();
+  ~PcmRingBuffer();
+
+  /**
+   * @brief (Re)allocates the ring and empties it.
+   *
+   * Must not be called while a producer or consumer is active.
+   * @param bytes Minimum capacity; rounded up to a power of two.
+   */
+  status_t SetCapacity(size_t bytes);
+  size_t Capacity() const { return fCapacity; }
+
+  /** @brief Empties the ring; same restrictions as SetCapacity(). */
+  void Clear();
+
+  /** @name Producer side */
+  ///@{
+  /** @brief Copies up to `size` bytes in; returns the number written. */
+  size_t Write(const void *data, size_t size);
+  /** @brief Free space, as seen by the producer. */
+  size_t Space() const;
+  /** @brief Makes the consumer drop everything written so far. */
+  void DiscardWritten();
+  /** @brief Total bytes written since the last Clear(). */
+  uint64 WritePosition() const {
+    return fWrite.load(std::memory_order_relaxed);
+  }
+  ///@}
+
+  /** @name Consumer side */
+  ///@{
+  /**
+   * @brief Copies up to `size` bytes out; returns the number read.
+   * @param start If given, receives the stream position of the first byte.
+   */
+  size_t Read(void *data, size_t size, uint64 *start = nullptr);
+  /** @brief Bytes ready to be read, discarded data excluded. */
+  size_t Available() const;
+  ///@}
+
+private:
+  uint8 *fData;
+  size_t fCapacity;
+  std::atomic<uint64> fWrite;
+  std::atomic<uint64> fRead;
+  std::atomic<uint64> fDiscardUntil;
+};
+
+#endif // BETON_PCM_RING_BUFFER_H
@@ -0,0 +1,78 @@
+#include "PlaybackClock.h"
+
+#include <algorithm>
+
+bigtime_t PlaybackClock::State::PositionAt(bigtime_t now) const {
+  bigtime_t elapsed = std::max<bigtime_t>(0, std::min(now - stamp, span));
+  bigtime_t result = position + elapsed;
+  if (duration > 0)
+    result = std::min(result, duration);
+  return std::max<bigtime_t>(0, result);
+}
+
+PlaybackClock::PlaybackClock()
+    : fSequence(0), fPosition(0), fStamp(0), fSpan(0), fDuration(0),
+      fFrameRate(0.0f), fChannels(0) {}
+
+void PlaybackClock::SetTrack(bigtime_t duration, float frameRate,
+                             int32 channels, bigtime_t position) {
+  uint32 sequence = _BeginWrite();
+  fDuration.store(duration, std::memory_order_relaxed);
+  fFrameRate.store(frameRate, std::memory_order_relaxed);
+  fChannels.store(channels, std::memory_order_relaxed);
+  fPosition.store(position, std::memory_order_relaxed);
+  fStamp.store(system_time(), std::memory_order_relaxed);
+  fSpan.store(0, std::memory_order_relaxed);
+  _EndWrite(sequence);
+}
+
+void PlaybackClock::SetPosition(bigtime_t position, bigtime_t span) {
+  uint32 sequence = _BeginWrite();
+  fPosition.store(position, std::memory_order_relaxed);
+  fStamp.store(system_time(), std::memory_order_relaxed);
+  fSpan.store(span, std::memory_order_relaxed);
+  _EndWrite(sequence);
+}
+
+void PlaybackClock::SetDuration(bigtime_t duration) {
+  uint32 sequence = _BeginWrite();
+  fDuration.store(duration, std::memory_order_relaxed);
+  _EndWrite(sequence);
+}
+
+PlaybackClock::State PlaybackClock::Read() const {
+  State state;
+  for (;;) {
+    uint32 sequence = fSequence.load(std::memory_order_acquire);
+    if (sequence & 1)
+      continue;
+    state.position = fPosition.load(std::memory_order_relaxed);
+    state.stamp = fStamp.load(std::memory_order_relaxed);
+    state.span = fSpan.load(std::memory_order_relaxed);
+    state.duration = fDuration.load(std::memory_order_relaxed);
+    state.frameRate = fFrameRate.load(std::memory_order_relaxed);
+    state.channels = fChannels.load(std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (fSequence.load(std::memory_order_relaxed) == sequence)
+      return state;
+  }
+}
+
+/** @brief Makes the sequence odd; spins only while another write runs. */
+uint32 PlaybackClock::_BeginWrite() {
+  uint32 sequence = fSequence.load(std::memory_order_relaxed);
+  for (;;) {
+    if ((sequence & 1) == 0 &&
+        fSequence.compare_exchange_weak(sequence, sequence + 1,
+                                        std::memory_order_acquire,
+                                        std::memory_order_relaxed))
+      break;
+    sequence = fSequence.load(std::memory_order_relaxed);
+  }
+  std::atomic_thread_fence(std::memory_order_release);
+  return sequence + 1;
+}
+
+void PlaybackClock::_EndWrite(uint32 sequence) {
+  fSequence.store(sequence + 1, std::memory_order_release);
+}
@@ -0,0 +1,66 @@
+#ifndef BETON_PLAYBACK_CLOCK_H
+#define BETON_PLAYBACK_CLOCK_H
+
+#include <OS.h>
+#include <SupportDefs.h>
+#include <atomic>
+
+/**
+ * @class PlaybackClock
+ * @brief Position, duration and format of what is playing, published
+ * through a seqlock so views can read it while they draw.
+ *
+ * The sound player callback publishes the position after every buffer with
+ * the time it was taken and how long the buffer plays; readers extrapolate
+ * from there by at most that span, so the position moves smoothly between
+ * callbacks and stops where the audio stops. Track changes are published
+ * from the window thread.
+ *
+ * Writers take the sequence from even to odd with a compare-and-swap and
+ * never wait for readers; readers retry while a write is in flight. No side
+ * locks or allocates.
+ */
+class PlaybackClock {
+public:
+  struct State {
+    bigtime_t position = 0; ///< At `stamp`
+    bigtime_t stamp = 0;    ///< system_time() the position was taken
+    bigtime_t span = 0;     ///< How far past `stamp` it may be extrapolated
+    bigtime_t duration = 0; ///< 0 while nothing plays
+    float frameRate = 0.0f;
+    int32 channels = 0;
+
+    /** @brief Position at `now`, extrapolated and clamped to the track. */
+    bigtime_t PositionAt(bigtime_t now) const;
+  };
+
+  PlaybackClock();
+
+  /** @brief Publishes a new track; the position restarts at `position`. */
+  void SetTrack(bigtime_t duration, float frameRate, int32 channels,
+                bigtime_t position = 0);
+  /**
+   * @brief Publishes the position; it advances for `span` from now on
+   * (0 for a paused or stopped position).
+   */
+  void SetPosition(bigtime_t position, bigtime_t span);
+  /** @brief Publishes a new duration, for a track that grows as it plays. */
+  void SetDuration(bigtime_t duration);
+
+  /** @brief A consistent copy of the published state. */
+  State Read() const;
+
+private:
+  uint32 _BeginWrite();
+  void _EndWrite(uint32 sequence);
+
+  std::atomic<uint32> fSequence; ///< Odd while a write is in flight
+  std::atomic<bigtime_t> fPosition;
+  std::atomic<bigtime_t> fStamp;
+  std::atomic<bigtime_t> fSpan;
+  std::atomic<bigtime_t> fDuration;
+  std::atomic<float> fFrameRate;
+  std::atomic<int32> fChannels;
+};
+
+#endif // BETON_PLAYBACK_CLOCK_H
@@ -1,11 +1,18 @@
 #include "PlaybackMessageHandler.h"
 
+#include "HttpConnectionPool.h"
 #include "MainWindow.h"
+#include "MediaLibraryCache.h"
 #include "Messages.h"
+#include "MusicBrainzQueryPool.h"
 #include "PlaybackTransportController.h"
 #include "PlaybackQueueManager.h"
+#include "ReplayGain.h"
 
+#include <Menu.h>
+#include <MenuItem.h>
 #include <Message.h>
+#include <algorithm>
 
 /**
  * @brief Constructs playback message handler.
@@ -67,9 +74,128 @@ bool PlaybackMessageHandler::HandleMessage(BMessage *msg) {
     return true;
   }
 
+  case MSG_PLAYBACK_DEVICE:
+    // Lets the cache throttle scans of the disk that is playing.
+    if (fWindow->fMediaLibraryCache)
+      BMessenger(fWindow->fMediaLibraryCache).SendMessage(msg);
+    return true;
+
+  case MSG_SET_CROSSFADE: {
+    fWindow->fCrossfadeSeconds =
+        std::max<int32>(0, msg->GetInt32("seconds", 0));
+    if (fWindow->fPlaybackEngine)
+      fWindow->fPlaybackEngine->SetCrossfade(
+          (bigtime_t)fWindow->fCrossfadeSeconds * 1000000);
+    if (fWindow->fCrossfadeMenu) {
+      for (int32 i = 0; BMenuItem *item = fWindow->fCrossfadeMenu->ItemAt(i);
+           i++) {
+        BMessage *itemMsg = item->Message();
+        item->SetMarked(itemMsg && itemMsg->GetInt32("seconds", -1) ==
+                                       fWindow->fCrossfadeSeconds);
+      }
+    }
+    return true;
+  }
+
+  case MSG_AUDIO_HEALTH_REPORT: {
+    BMessage reply(MSG_AUDIO_HEALTH_REPORT);
+    if (fWindow->fPlaybackEngine) {
+      BString report = fWindow->fPlaybackEngine->HealthReport();
+      if (fWindow->fDlnaManager)
+        report << fWindow->fDlnaManager->ActionReport();
+      report << MusicBrainzQueryPool::Default().Report();
+      reply.AddString("report", report);
+    }
+    msg->SendReply(&reply);
+    return true;
+  }
+
+  case MSG_AUDIO_HEALTH_RESET:
+    if (fWindow->fPlaybackEngine)
+      fWindow->fPlaybackEngine->Health().Reset();
+    HttpConnectionPool::Default().ResetStats();
+    MusicBrainzQueryPool::Default().ResetStats();
+    if (fWindow->fDlnaManager)
+      fWindow->fDlnaManager->ResetActionStats();
+    return true;
+
+  case MSG_SET_OUTPUT_RATE: {
+    fWindow->fOutputRate = std::max<int32>(0, msg->GetInt32("rate", 0));
+    if (fWindow->fPlaybackEngine)
+      fWindow->fPlaybackEngine->SetOutputRate(fWindow->fOutputRate);
+    if (fWindow->fOutputRateMenu) {
+      for (int32 i = 0; BMenuItem *item = fWindow->fOutputRateMenu->ItemAt(i);
+           i++) {
+        BMessage *itemMsg = item->Message();
+        item->SetMarked(itemMsg &&
+                        itemMsg->GetInt32("rate", -1) == fWindow->fOutputRate);
+      }
+    }
+    return true;
+  }
+
+  case MSG_SET_STREAM_QUALITY: {
+    fWindow->fStreamQualityKbps = std::max<int32>(0, msg->GetInt32("kbps", 0));
+    if (fWindow->fPlaybackEngine)
+      fWindow->fPlaybackEngine->SetStreamBandwidthCap(
+          (int64)fWindow->fStreamQualityKbps * 1000);
+    if (fWindow->fStreamQualityMenu) {
+      for (int32 i = 0;
+           BMenuItem *item = fWindow->fStreamQualityMenu->ItemAt(i); i++) {
+        BMessage *itemMsg = item->Message();
+        item->SetMarked(itemMsg && itemMsg->GetInt32("kbps", -1) ==
+                                       fWindow->fStreamQualityKbps);
+      }
+    }
+    return true;
+  }
+
+  case MSG_SET_TIME_SHIFT: {
+    fWindow->fTimeShiftMinutes =
+        std::max<int32>(0, msg->GetInt32("minutes", 0));
+    if (fWindow->fPlaybackEngine)
+      fWindow->fPlaybackEngine->SetTimeShiftWindow(
+          (bigtime_t)fWindow->fTimeShiftMinutes * 60 * 1000000);
+    if (fWindow->fTimeShiftMenu) {
+      for (int32 i = 0;
+           BMenuItem *item = fWindow->fTimeShiftMenu->ItemAt(i); i++) {
+        BMessage *itemMsg = item->Message();
+        item->SetMarked(itemMsg && itemMsg->GetInt32("minutes", -1) ==
+                                       fWindow->fTimeShiftMinutes);
+      }
+    }
+    return true;
+  }
+
+  case MSG_SET_NORMALIZATION: {
+    int32 mode = msg->GetInt32("mode", 0);
+    if (mode < ReplayGain::kOff || mode > ReplayGain::kAlbum)
+      mode = ReplayGain::kOff;
+    fWindow->fNormalizationMode = mode;
+    if (fWindow->fPlaybackEngine)
+      fWindow->fPlaybackEngine->SetNormalization(mode);
+    if (fWindow->fNormalizationMenu) {
+      for (int32 i = 0;
+           BMenuItem *item = fWindow->fNormalizationMenu->ItemAt(i); i++) {
+        BMessage *itemMsg = item->Message();
+        if (itemMsg && itemMsg->what == MSG_SET_NORMALIZATION)
+          item->SetMarked(itemMsg->GetInt32("mode", -1) == mode);
+      }
+    }
+    return true;
+  }
+
+  case MSG_SET_DSP: {
+    fWindow->fDspSettings.Unarchive(*msg);
+    if (fWindow->fPlaybackEngine)
+      fWindow->fPlaybackEngine->SetDsp(fWindow->fDspSettings);
+    return true;
+  }
+
   case MSG_TRACK_ENDED:
     if (fWindow->fPlaybackQueueManager)
-      fWindow->fPlaybackQueueManager->HandleTrackEnded();
+      fWindow->fPlaybackQueueManager->HandleTrackEnded(
+          msg->GetBool("gapless", false));
     return true;
 
   case MSG_MUTE_TOGGLE: {
@@ -112,9 +238,16 @@ bool PlaybackMessageHandler::HandleMessage(BMessage *msg) {
   case MSG_NOW_PLAYING: {
     if (fWindow->fPlaybackTransportController)
       fWindow->fPlaybackTransportController->HandleNowPlaying(msg);
+    if (fWindow->fPlaybackQueueManager)
+      fWindow->fPlaybackQueueManager->ArmGapless();
     break;
   }
 
+  case MSG_WAVEFORM_READY:
+    if (fWindow->fPlaybackTransportController)
+      fWindow->fPlaybackTransportController->HandleWaveformReady(msg);
+    return true;
+
   default:
     return false;
   }
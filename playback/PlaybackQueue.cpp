@@ -0,0 +1,125 @@
+#include "PlaybackQueue.h"
+
+#include <algorithm>
+
+PlaybackQueue::PlaybackQueue()
+    : fLive(0), fShuffleCursor(-1), fDealRng(std::random_device{}()) {}
+
+int32 PlaybackQueue::Append(const BString &path, const ReplayGain &gain) {
+  fTracks.push_back(Track{path, gain});
+  fOrder.push_back((uint32)(fTracks.size() - 1));
+  fLive++;
+
+  int32 position = (int32)fOrder.size() - 1;
+  if (!fShuffle.empty()) {
+    // Deal it into a random slot of what has not played yet.
+    fShuffle.push_back(position);
+    size_t first = (size_t)(fShuffleCursor + 1);
+    size_t slot = std::uniform_int_distribution<size_t>(
+        first, fShuffle.size() - 1)(fDealRng);
+    std::swap(fShuffle[slot], fShuffle.back());
+  }
+  return position;
+}
+
+void PlaybackQueue::Remove(int32 position) {
+  if (!IsValid(position))
+    return;
+  fOrder[position] = kHole;
+  fLive--;
+}
+
+void PlaybackQueue::Reserve(size_t count) {
+  fTracks.reserve(count);
+  fOrder.reserve(count);
+}
+
+bool PlaybackQueue::IsValid(int32 position) const {
+  return position >= 0 && position < (int32)fOrder.size() &&
+         fOrder[position] != kHole;
+}
+
+const BString &PlaybackQueue::PathAt(int32 position) const {
+  static const BString kNoPath;
+  return IsValid(position) ? fTracks[fOrder[position]].path : kNoPath;
+}
+
+ReplayGain PlaybackQueue::GainAt(int32 position) const {
+  return IsValid(position) ? fTracks[fOrder[position]].gain : ReplayGain();
+}
+
+int32 PlaybackQueue::Next(int32 position) const {
+  for (int32 i = std::max<int32>(position + 1, 0); i < (int32)fOrder.size();
+       i++) {
+    if (fOrder[i] != kHole)
+      return i;
+  }
+  return -1;
+}
+
+int32 PlaybackQueue::Previous(int32 position) const {
+  for (int32 i = std::min<int32>(position, (int32)fOrder.size()) - 1; i >= 0;
+       i--) {
+    if (fOrder[i] != kHole)
+      return i;
+  }
+  return -1;
+}
+
+void PlaybackQueue::Shuffle(std::mt19937 &rng, int32 first) {
+  fShuffle.clear();
+  fShuffle.reserve(fLive);
+  for (int32 i = 0; i < (int32)fOrder.size(); i++) {
+    if (fOrder[i] != kHole && i != first)
+      fShuffle.push_back(i);
+  }
+  for (size_t i = fShuffle.size(); i > 1; i--) {
+    size_t j = std::uniform_int_distribution<size_t>(0, i - 1)(rng);
+    std::swap(fShuffle[i - 1], fShuffle[j]);
+  }
+
+  fShuffleCursor = -1;
+  if (IsValid(first)) {
+    fShuffle.insert(fShuffle.begin(), first);
+    fShuffleCursor = 0;
+  }
+}
+
+void PlaybackQueue::ClearShuffle() {
+  fShuffle.clear();
+  fShuffleCursor = -1;
+}
+
+int32 PlaybackQueue::PeekShuffle(int32 direction) const {
+  int32 cursor = fShuffleCursor;
+  return _ShuffleStep(direction, cursor);
+}
+
+int32 PlaybackQueue::StepShuffle(int32 direction) {
+  return _ShuffleStep(direction, fShuffleCursor);
+}
+
+void PlaybackQueue::SyncShuffle(int32 position) {
+  if (fShuffleCursor + 1 < (int32)fShuffle.size() &&
+      fShuffle[fShuffleCursor + 1] == position) {
+    fShuffleCursor++;
+    return;
+  }
+  auto it = std::find(fShuffle.begin(), fShuffle.end(), position);
+  if (it != fShuffle.end())
+    fShuffleCursor = (int32)(it - fShuffle.begin());
+}
+
+/** @brief Moves `cursor` to the next live entry in `direction`. */
+int32 PlaybackQueue::_ShuffleStep(int32 direction, int32 &cursor) const {
+  int32 i = cursor;
+  for (;;) {
+    i += direction > 0 ? 1 : -1;
+    if (i < 0 || i >= (int32)fShuffle.size())
+      return -1;
+    if (IsValid(fShuffle[i])) {
+      cursor = i;
+      return fShuffle[i];
+    }
+  }
+}
@@ -0,0 +1,106 @@
+#ifndef BETON_PLAYBACK_QUEUE_H
+#define BETON_PLAYBACK_QUEUE_H
+
+#include "ReplayGain.h"
+
+#include <Referenceable.h>
+#include <String.h>
+#include <SupportDefs.h>
+#include <random>
+#include <vector>
+
+/**
+ * @class PlaybackQueue
+ * @brief Play order of the local queue: positions referring to a table of
+ * tracks by ID, plus the shuffle order over those positions.
+ *
+ * The track table holds each track's path and gains once; BString shares
+ * the path buffer with the MediaItem it came from, so building a queue of
+ * the whole library copies no characters. Positions are what the engine and
+ * MSG_NOW_PLAYING call the queue index.
+ *
+ * Append() and Remove() are O(1) amortized: a removed position stays in
+ * place as a hole that Next(), Previous() and the shuffle order skip, so
+ * the positions of all other entries stay valid.
+ *
+ * Shuffle() lays out a Fisher–Yates permutation of the live positions. The
+ * cursor into it is both the history (StepShuffle(-1) walks back through
+ * what played) and what plays next; appended entries are dealt into the
+ * part not yet played.
+ *
+ * Shared by reference between the queue manager and the engine; both use
+ * it from the window thread only.
+ */
+class PlaybackQueue : public BReferenceable {
+public:
+  PlaybackQueue();
+
+  /** @brief Adds a track to the table and appends it; returns its position. */
+  int32 Append(const BString &path, const ReplayGain &gain);
+  /** @brief Makes `position` a hole; no other position moves. */
+  void Remove(int32 position);
+  void Reserve(size_t count);
+
+  /** @brief Number of positions, holes included. */
+  int32 CountPositions() const { return (int32)fOrder.size(); }
+  /** @brief Number of entries that can play. */
+  int32 CountEntries() const { return fLive; }
+  bool IsEmpty() const { return fLive == 0; }
+
+  /** @brief True if `position` is in range and not a hole. */
+  bool IsValid(int32 position) const;
+  /** @brief Path at `position`; empty for holes and out of range. */
+  const BString &PathAt(int32 position) const;
+  /** @brief Gains at `position`; unity for holes and out of range. */
+  ReplayGain GainAt(int32 position) const;
+
+  /** @brief Next/previous live position in queue order, or -1. */
+  int32 Next(int32 position) const;
+  int32 Previous(int32 position) const;
+  /** @brief First live position, or -1. */
+  int32 First() const { return Next(-1); }
+
+  /** @name Shuffle */
+  ///@{
+  /**
+   * @brief Lays out a new shuffle order; `first` (if valid) opens it and
+   * becomes the current entry.
+   */
+  void Shuffle(std::mt19937 &rng, int32 first);
+  /** @brief Forgets the shuffle order. */
+  void ClearShuffle();
+  bool IsShuffled() const { return !fShuffle.empty(); }
+  /**
+   * @brief Entry before (-1) or after (+1) the current one in shuffle
+   * order, or -1 at either end.
+   */
+  int32 PeekShuffle(int32 direction) const;
+  /** @brief Moves the shuffle cursor like PeekShuffle(); returns the entry. */
+  int32 StepShuffle(int32 direction);
+  /**
+   * @brief Moves the cursor onto `position` if the shuffle order holds it
+   * (e.g. after the engine played it gaplessly).
+   */
+  void SyncShuffle(int32 position);
+  ///@}
+
+private:
+  struct Track {
+    BString path;
+    ReplayGain gain;
+  };
+
+  static const uint32 kHole = 0xffffffff;
+
+  int32 _ShuffleStep(int32 direction, int32 &cursor) const;
+
+  std::vector<Track> fTracks; ///< Indexed by track ID
+  std::vector<uint32> fOrder; ///< Track ID per position, kHole if removed
+  int32 fLive;
+
+  std::vector<int32> fShuffle; ///< Positions in shuffle order
+  int32 fShuffleCursor;        ///< Index into fShuffle of the current entry
+  std::mt19937 fDealRng;       ///< Places appended entries
+};
+
+#endif // BETON_PLAYBACK_QUEUE_H
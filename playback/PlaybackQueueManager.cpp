@@ -7,6 +7,7 @@
 #include "MainWindow.h"
 #include "AudioPlaybackEngine.h"
 #include "Messages.h"
+#include "PlaybackQueue.h"
 #include "RadioStationController.h"
 #include "ViewStateController.h"
 
@@ -94,26 +95,14 @@ PlaybackQueueManager::PlaySelectedQueue()
     return;
   }
 
-  std::vector<std::string> queue;
-  queue.reserve(cv->CountRows());
-  for (int32 i = 0; i < cv->CountRows(); ++i) {
-    const MediaItem *mi = cv->ItemAt(i);
-    if (!mi || mi->missing)
-      continue;
-
-    queue.push_back(mi->path.String());
-  }
-
-  if (queue.empty())
+  BReference<PlaybackQueue> queue(new PlaybackQueue(), true);
+  cv->BuildQueue(*queue);
+  if (queue->IsEmpty())
     return;
 
   int32 queueIdx = QueueIndexForContentRow(cv, sel);
   DEBUG_PRINT("MSG_PLAY_BTN: restart sel=%ld\n", (long)queueIdx);
-  _ClearDlnaQueue();
-  fActiveSource = fWindow->fIsLibraryMode ? SourceLibrary : SourcePlaylist;
-  fWindow->fPlaybackEngine->Stop();
-  fWindow->fPlaybackEngine->SetQueue(queue);
-  fWindow->fPlaybackEngine->Play(queueIdx);
+  _StartQueue(queue.Get(), queueIdx);
 }
 
 /**
@@ -131,11 +120,10 @@ PlaybackQueueManager::PlayNext()
     if (fRepeatMode == RepeatOne) {
       fWindow->fPlaybackEngine->Play(fWindow->fPlaybackEngine->CurrentIndex());
     } else if (fShuffleEnabled) {
-      int32 count = fWindow->fPlaybackEngine->QueueSize();
-      if (count > 0) {
-        fShuffleHistory.push_back(fWindow->fPlaybackEngine->CurrentIndex());
-        fWindow->fPlaybackEngine->Play(_RandomIndex(count));
-      }
+      // Pressing Next never runs out; it starts another pass.
+      int32 next = _ShuffleNext(true);
+      if (next >= 0)
+        fWindow->fPlaybackEngine->Play(next);
     } else {
       fWindow->fPlaybackEngine->PlayNext();
     }
@@ -156,11 +144,10 @@ PlaybackQueueManager::PlayPrevious()
 
   if (fWindow && fWindow->fPlaybackEngine) {
     if (fShuffleEnabled) {
-      if (!fShuffleHistory.empty()) {
-        int32 prev = fShuffleHistory.back();
-        fShuffleHistory.pop_back();
+      PlaybackQueue *queue = fWindow->fPlaybackEngine->Queue();
+      int32 prev = queue != nullptr ? queue->StepShuffle(-1) : -1;
+      if (prev >= 0)
         fWindow->fPlaybackEngine->Play(prev);
-      }
     } else {
       fWindow->fPlaybackEngine->PlayPrev();
     }
@@ -172,11 +159,29 @@ PlaybackQueueManager::PlayPrevious()
  * @brief Advances playback after natural track end.
  */
 void
-PlaybackQueueManager::HandleTrackEnded()
+PlaybackQueueManager::HandleTrackEnded(bool gaplessHandoff)
 {
   if (!fWindow)
     return;
 
+  if (gaplessHandoff) {
+    // The next track is already audible; only the bookkeeping is left.
+    if (!fWindow->fPlaybackEngine)
+      return;
+    if (!fWindow->fPlaybackEngine->CompleteGaplessHandoff())
+      return;
+    // A renderer moved on to the DLNA item armed for it.
+    if (fActiveSource == SourceDLNA) {
+      if (fWindow->fDlnaController)
+        fWindow->fDlnaController->CompleteArmedHandoff();
+      return;
+    }
+    PlaybackQueue *queue = fWindow->fPlaybackEngine->Queue();
+    if (fShuffleEnabled && fRepeatMode != RepeatOne && queue != nullptr)
+      queue->SyncShuffle(fWindow->fPlaybackEngine->CurrentIndex());
+    return;
+  }
+
   DLNAViewController *dlna = fWindow->fDlnaController;
   if (fActiveSource == SourceDLNA && dlna &&
       dlna->HasPlayQueue() && dlna->CurrentPlayIndex() >= 0) {
@@ -208,21 +213,20 @@ PlaybackQueueManager::HandleTrackEnded()
     if (fRepeatMode == RepeatOne) {
       fWindow->fPlaybackEngine->Play(fWindow->fPlaybackEngine->CurrentIndex());
     } else if (fShuffleEnabled) {
-      int32 count = fWindow->fPlaybackEngine->QueueSize();
-      if (count > 0) {
-        fShuffleHistory.push_back(fWindow->fPlaybackEngine->CurrentIndex());
-        fWindow->fPlaybackEngine->Play(_RandomIndex(count));
-      }
-    } else if (fRepeatMode == RepeatAll) {
-      if (fWindow->fPlaybackEngine->CurrentIndex() + 1 <
-          fWindow->fPlaybackEngine->QueueSize())
-        fWindow->fPlaybackEngine->PlayNext();
+      // A pass ends after every entry played once, unless repeating.
+      int32 next = _ShuffleNext(fRepeatMode == RepeatAll);
+      if (next >= 0)
+        fWindow->fPlaybackEngine->Play(next);
       else
-        fWindow->fPlaybackEngine->Play(0);
+        fWindow->PostMessage(MSG_STOP);
     } else {
-      if (fWindow->fPlaybackEngine->CurrentIndex() + 1 <
-          fWindow->fPlaybackEngine->QueueSize())
+      PlaybackQueue *queue = fWindow->fPlaybackEngine->Queue();
+      int32 current = fWindow->fPlaybackEngine->CurrentIndex();
+      if (queue != nullptr && queue->Next(current) >= 0)
         fWindow->fPlaybackEngine->PlayNext();
+      else if (queue != nullptr && fRepeatMode == RepeatAll &&
+               queue->First() >= 0)
+        fWindow->fPlaybackEngine->Play(queue->First());
       else
         fWindow->PostMessage(MSG_STOP);
     }
@@ -235,6 +239,55 @@ PlaybackQueueManager::HandleTrackEnded()
   }
 }
 
+/**
+ * @brief Arms the entry natural progression would pick next.
+ *
+ * For a DLNA play queue on a renderer the next item is armed there. Shuffle
+ * picks its item only at the end, and a repeated item cannot be told from
+ * itself, so neither is armed.
+ */
+void
+PlaybackQueueManager::ArmGapless()
+{
+  if (!fWindow || !fWindow->fPlaybackEngine)
+    return;
+
+  AudioPlaybackEngine *engine = fWindow->fPlaybackEngine;
+  PlaybackQueue *queue = engine->Queue();
+  int32 next = -1;
+  if ((fActiveSource == SourceLibrary || fActiveSource == SourcePlaylist) &&
+      queue != nullptr && !queue->IsEmpty()) {
+    int32 current = engine->CurrentIndex();
+    if (fRepeatMode == RepeatOne) {
+      next = current;
+    } else if (fShuffleEnabled) {
+      // The shuffle order is laid out ahead, so the primed track is the
+      // one that plays. The end of a pass is left to HandleTrackEnded().
+      if (!queue->IsShuffled())
+        queue->Shuffle(fRng, current);
+      next = queue->PeekShuffle(1);
+    } else {
+      next = queue->Next(current);
+      if (next < 0 && fRepeatMode == RepeatAll)
+        next = queue->First();
+    }
+  }
+  engine->SetGaplessNext(next);
+
+  DLNAViewController *dlna = fWindow->fDlnaController;
+  if (fActiveSource == SourceDLNA && dlna && dlna->CurrentPlayIndex() >= 0) {
+    int32 current = dlna->CurrentPlayIndex();
+    int32 dlnaNext = -1;
+    if (!fShuffleEnabled && fRepeatMode != RepeatOne) {
+      if (current + 1 < dlna->PlayQueueSize())
+        dlnaNext = current + 1;
+      else if (fRepeatMode == RepeatAll)
+        dlnaNext = 0;
+    }
+    dlna->ArmNext(dlnaNext);
+  }
+}
+
 /**
  * @brief Toggles shuffle mode and updates related button state.
  */
@@ -246,6 +299,8 @@ PlaybackQueueManager::ToggleShuffle()
 
   fShuffleEnabled = !fShuffleEnabled;
   fShuffleHistory.clear();
+  _ResetShuffle();
+  ArmGapless();
   _UpdateShuffleIcon();
   if (fWindow->fViewStateController) {
     fWindow->fViewStateController->UpdateTooltips();
@@ -268,6 +323,7 @@ PlaybackQueueManager::ToggleRepeat()
   } else {
     fRepeatMode = RepeatOff;
   }
+  ArmGapless();
   _UpdateRepeatIcon();
   if (fWindow->fViewStateController) {
     fWindow->fViewStateController->UpdateTooltips();
@@ -294,6 +350,8 @@ PlaybackQueueManager::SetShuffleEnabled(bool enabled)
 
   fShuffleEnabled = enabled;
   fShuffleHistory.clear();
+  _ResetShuffle();
+  ArmGapless();
   _UpdateShuffleIcon();
 }
 
@@ -309,6 +367,7 @@ PlaybackQueueManager::SetRepeatModeValue(int32 mode)
     fRepeatMode = RepeatOne;
   else
     fRepeatMode = RepeatOff;
+  ArmGapless();
   _UpdateRepeatIcon();
 }
 
@@ -361,21 +420,72 @@ PlaybackQueueManager::PlayLocalSelection(MediaTableView *view,
     return;
   }
 
-  std::vector<std::string> queue;
-  view->BuildQueue(queue);
-
-  if (queue.empty())
+  BReference<PlaybackQueue> queue(new PlaybackQueue(), true);
+  view->BuildQueue(*queue);
+  if (queue->IsEmpty())
     return;
 
   int32 queueIdx = QueueIndexForContentRow(view, rowIndex);
-  DEBUG_PRINT("MSG_PLAY: start index=%ld (queue=%zu)\n",
-              (long)queueIdx, queue.size());
+  DEBUG_PRINT("MSG_PLAY: start index=%ld (queue=%ld)\n",
+              (long)queueIdx, (long)queue->CountEntries());
+  _StartQueue(queue.Get(), queueIdx);
+  _SetPlayPauseIcon();
+}
+
+/**
+ * @brief Hands a freshly built local queue to the engine and plays
+ * `position`; with shuffle on, the shuffle order opens with it.
+ */
+void
+PlaybackQueueManager::_StartQueue(PlaybackQueue *queue, int32 position)
+{
   _ClearDlnaQueue();
   fActiveSource = fWindow->fIsLibraryMode ? SourceLibrary : SourcePlaylist;
+  if (fShuffleEnabled)
+    queue->Shuffle(fRng, position);
   fWindow->fPlaybackEngine->Stop();
   fWindow->fPlaybackEngine->SetQueue(queue);
-  fWindow->fPlaybackEngine->Play(queueIdx);
-  _SetPlayPauseIcon();
+  fWindow->fPlaybackEngine->Play(position);
+}
+
+/**
+ * @brief Steps the local shuffle order forward.
+ * @param wrap At the end of a pass, lay out the next one instead of
+ * returning -1. The entry that just played opens it, so it does not repeat.
+ */
+int32
+PlaybackQueueManager::_ShuffleNext(bool wrap)
+{
+  PlaybackQueue *queue = fWindow->fPlaybackEngine->Queue();
+  if (queue == nullptr || queue->IsEmpty())
+    return -1;
+
+  int32 current = fWindow->fPlaybackEngine->CurrentIndex();
+  if (!queue->IsShuffled())
+    queue->Shuffle(fRng, current);
+  int32 next = queue->StepShuffle(1);
+  if (next < 0 && wrap) {
+    queue->Shuffle(fRng, current);
+    next = queue->StepShuffle(1);
+    if (next < 0)
+      next = current; // A single entry
+  }
+  return next;
+}
+
+/** @brief Lays out or drops the local shuffle order to match the mode. */
+void
+PlaybackQueueManager::_ResetShuffle()
+{
+  if (!fWindow->fPlaybackEngine)
+    return;
+  PlaybackQueue *queue = fWindow->fPlaybackEngine->Queue();
+  if (queue == nullptr)
+    return;
+  if (fShuffleEnabled)
+    queue->Shuffle(fRng, fWindow->fPlaybackEngine->CurrentIndex());
+  else
+    queue->ClearShuffle();
 }
 
 int32
@@ -7,10 +7,15 @@
 
 class MediaTableView;
 class MainWindow;
+class PlaybackQueue;
 
 /**
  * @class PlaybackQueueManager
  * @brief Controls queue navigation, repeat/shuffle, and source-aware next/prev.
+ *
+ * Local playback builds a PlaybackQueue from the content view and shares it
+ * with the engine. With shuffle on, navigation follows that queue's shuffle
+ * order.
  */
 class PlaybackQueueManager {
 public:
@@ -41,8 +46,19 @@ public:
   /** @brief Plays previous item according to source and shuffle history. */
   void PlayPrevious();
   
-  /** @brief Handles end-of-track progression. */
-  void HandleTrackEnded();
+  /**
+   * @brief Handles end-of-track progression.
+   * @param gaplessHandoff The engine already continued into the armed track.
+   */
+  void HandleTrackEnded(bool gaplessHandoff = false);
+
+  /**
+   * @brief Tells the engine which entry follows the current one, so it can
+   * open it early and play it without a gap.
+   *
+   * Called on every track change and repeat/shuffle change.
+   */
+  void ArmGapless();
   
   /** @brief Toggles shuffle mode and updates shuffle icon state. */
   void ToggleShuffle();
@@ -74,6 +90,12 @@ public:
 private:
   /** @brief Returns random queue index in range `[0, count)`. */
   int32 _RandomIndex(int32 count);
+  /** @brief Starts `queue` at `position` as the local source. */
+  void _StartQueue(PlaybackQueue *queue, int32 position);
+  /** @brief Next entry of the local shuffle order, or -1. */
+  int32 _ShuffleNext(bool wrap);
+  /** @brief Shuffles or unshuffles the local queue to match the mode. */
+  void _ResetShuffle();
   /** @brief Updates shuffle button icon to current shuffle state. */
   void _UpdateShuffleIcon();
   /** @brief Updates repeat button icon to current repeat state. */
@@ -102,7 +124,10 @@ private:
   /** @brief Random generator used for shuffle picks. */
   std::mt19937 fRng{std::random_device{}()};
   
-  /** @brief Stack-like history for shuffle previous navigation. */
+  /**
+   * @brief Stack-like history for shuffle previous navigation of DLNA and
+   * radio; the local queue keeps its own shuffle order.
+   */
   std::vector<int32> fShuffleHistory;
 };
 
@@ -17,7 +17,8 @@
  */
 PlaybackSeekBarView::PlaybackSeekBarView(const char *name)
     : BView(name, B_WILL_DRAW | B_FULL_UPDATE_ON_RESIZE), fDuration(0),
-      fPosition(0), fTracking(false) {
+      fPosition(0), fTracking(false), fClock(nullptr), fPacing(true),
+      fFrameRunner(nullptr), fFrameRunnerInterval(0) {
   SetViewColor(B_TRANSPARENT_COLOR);
   fBg = tint_color(ui_color(B_PANEL_BACKGROUND_COLOR), B_DARKEN_1_TINT);
   fFill = ui_color(B_CONTROL_HIGHLIGHT_COLOR);
@@ -32,7 +33,16 @@ PlaybackSeekBarView::PlaybackSeekBarView(const char *name)
   SetExplicitPreferredSize(BSize(fontHeight * 24, fontHeight));
 }
 
-void PlaybackSeekBarView::AttachedToWindow() { SetLowColor(ViewColor()); }
+void PlaybackSeekBarView::AttachedToWindow() {
+  SetLowColor(ViewColor());
+  _UpdatePacing();
+}
+
+void PlaybackSeekBarView::DetachedFromWindow() {
+  delete fFrameRunner;
+  fFrameRunner = nullptr;
+  BView::DetachedFromWindow();
+}
 
 /**
  * @brief Formats a time in microseconds to "MM:SS".
@@ -82,7 +92,77 @@ void PlaybackSeekBarView::SetColors(rgb_color bg, rgb_color fill, rgb_color bord
   Invalidate();
 }
 
-void PlaybackSeekBarView::Draw(BRect) { _DrawBar(Bounds()); }
+void PlaybackSeekBarView::SetWaveform(const WaveformOverview &overview) {
+  fWaveform = overview;
+  Invalidate();
+}
+
+void PlaybackSeekBarView::ClearWaveform() {
+  if (fWaveform.IsEmpty())
+    return;
+  fWaveform = WaveformOverview();
+  Invalidate();
+}
+
+void PlaybackSeekBarView::SetClock(const PlaybackClock *clock) {
+  fClock = clock;
+  _UpdatePacing();
+  Invalidate();
+}
+
+void PlaybackSeekBarView::SetFramePacing(bool enabled) {
+  fPacing = enabled;
+  _UpdatePacing();
+}
+
+/** @brief Runs the frame runner while there is a clock to follow. */
+void PlaybackSeekBarView::_UpdatePacing() {
+  bool wanted = fClock != nullptr && fPacing && Window() != nullptr;
+  if (wanted == (fFrameRunner != nullptr))
+    return;
+  delete fFrameRunner;
+  fFrameRunner = nullptr;
+  if (wanted) {
+    BMessage frame(MSG_SEEKBAR_FRAME);
+    fFrameRunnerInterval = kFrameInterval;
+    fFrameRunner =
+        new BMessageRunner(BMessenger(this), &frame, fFrameRunnerInterval);
+  }
+}
+
+/**
+ * @brief Takes position and duration from the clock.
+ * @param advancing Set if the clock runs, i.e. frames are worth drawing.
+ * @return true if the bar or the time text changed.
+ */
+bool PlaybackSeekBarView::_SyncClock(bool &advancing) {
+  advancing = false;
+  if (fClock == nullptr || fTracking)
+    return false;
+
+  const bigtime_t now = system_time();
+  PlaybackClock::State state = fClock->Read();
+  advancing = state.span > 0 && now - state.stamp < 1000000;
+  bigtime_t duration = std::max<bigtime_t>(0, state.duration);
+  bigtime_t position = state.PositionAt(now);
+
+  const float width = Bounds().Width();
+  auto column = [width](bigtime_t pos, bigtime_t dur) {
+    return dur > 0 ? (int32)(pos * width / dur) : -1;
+  };
+  bool changed = duration != fDuration ||
+                 column(position, duration) != column(fPosition, fDuration) ||
+                 position / 1000000 != fPosition / 1000000;
+  fDuration = duration;
+  fPosition = position;
+  return changed;
+}
+
+void PlaybackSeekBarView::Draw(BRect) {
+  bool advancing;
+  _SyncClock(advancing);
+  _DrawBar(Bounds());
+}
 
 /**
  * @brief Internal method to draw the seek bar.
@@ -112,6 +192,8 @@ void PlaybackSeekBarView::_DrawBar(const BRect &r) {
 
     SetHighColor(fFill);
     FillRoundRect(fillRect, 2, 2);
+    if (!fWaveform.IsEmpty())
+      _DrawWaveform(r, fillRect.right);
     BString left, right;
     FormatTime(fPosition, left);
     FormatTime(fDuration, right);
@@ -127,6 +209,48 @@ void PlaybackSeekBarView::_DrawBar(const BRect &r) {
   }
 }
 
+/**
+ * @brief Draws one vertical line per pixel column: peak in a light shade,
+ * RMS in a darker one, both tinted by whether the column is already played.
+ */
+void PlaybackSeekBarView::_DrawWaveform(const BRect &r, float progressRight) {
+  BRect inner = r;
+  inner.InsetBy(2, 2);
+  int32 columns = inner.IntegerWidth() + 1;
+  int32 count = (int32)fWaveform.peak.size();
+  if (columns <= 0 || count <= 0)
+    return;
+
+  float center = (inner.top + inner.bottom) / 2.0f;
+  float halfHeight = inner.Height() / 2.0f;
+
+  rgb_color playedPeak = tint_color(fFill, B_DARKEN_1_TINT);
+  rgb_color playedRms = tint_color(fFill, B_DARKEN_2_TINT);
+  rgb_color restPeak = tint_color(fBg, B_DARKEN_1_TINT);
+  rgb_color restRms = tint_color(fBg, B_DARKEN_2_TINT);
+
+  BeginLineArray(columns * 2);
+  for (int32 x = 0; x < columns; x++) {
+    int32 first = (int32)((int64)x * count / columns);
+    int32 last = std::max(first + 1, (int32)((int64)(x + 1) * count / columns));
+    uint8 peak = 0, rms = 0;
+    for (int32 i = first; i < last && i < count; i++) {
+      peak = std::max(peak, fWaveform.peak[i]);
+      rms = std::max(rms, fWaveform.rms[i]);
+    }
+
+    float px = inner.left + x;
+    bool played = px <= progressRight;
+    float peakExtent = halfHeight * peak / 255.0f;
+    float rmsExtent = halfHeight * rms / 255.0f;
+    AddLine(BPoint(px, center - peakExtent), BPoint(px, center + peakExtent),
+            played ? playedPeak : restPeak);
+    AddLine(BPoint(px, center - rmsExtent), BPoint(px, center + rmsExtent),
+            played ? playedRms : restRms);
+  }
+  EndLineArray();
+}
+
 void PlaybackSeekBarView::MouseDown(BPoint where) {
   _SeekFromPoint(where);
   fTracking = true;
@@ -160,6 +284,19 @@ void PlaybackSeekBarView::_SeekFromPoint(BPoint where) {
 }
 
 void PlaybackSeekBarView::MessageReceived(BMessage *msg) {
+  if (msg->what == MSG_SEEKBAR_FRAME) {
+    bool advancing;
+    if (_SyncClock(advancing))
+      Invalidate();
+    // Standing still, a few checks a second notice playback resuming.
+    bigtime_t interval = advancing ? kFrameInterval : kIdleInterval;
+    if (fFrameRunner != nullptr && interval != fFrameRunnerInterval) {
+      fFrameRunner->SetInterval(interval);
+      fFrameRunnerInterval = interval;
+    }
+    return;
+  }
+
   // Handle drag-and-drop color from Color Picker
   if (msg->WasDropped()) {
     rgb_color *color;
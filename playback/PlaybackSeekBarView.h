@@ -1,12 +1,17 @@
 #ifndef BETON_PLAYBACK_SEEK_BAR_VIEW_H
 #define BETON_PLAYBACK_SEEK_BAR_VIEW_H
 
+#include "PlaybackClock.h"
+#include "WaveformAnalyzer.h"
+
 #include <InterfaceDefs.h>
 #include <Message.h>
 #include <Rect.h>
 #include <SupportDefs.h>
 #include <View.h>
 
+class BMessageRunner;
+
 /**
  * @class PlaybackSeekBarView
  * @brief A custom BView that displays a playback progress bar and allows
@@ -15,6 +20,14 @@
  * The view displays the current playback position and total duration.
  * Users can click or drag on the bar to seek to a specific time.
  * It sends MSG_SEEK_REQUEST messages to the window when interaction occurs.
+ * When a waveform overview of the track is set, it is drawn behind the
+ * progress; without one the view is a plain progress bar.
+ *
+ * With a PlaybackClock set, position and duration are read from it while
+ * drawing. Redraws are paced by a runner of its own: every frame while the
+ * clock advances, a few times a second while it stands still, and not at
+ * all while frame pacing is off (the window is minimized). A frame only
+ * invalidates the view if the bar or the time text would change.
  */
 class PlaybackSeekBarView : public BView {
 public:
@@ -54,23 +67,55 @@ public:
    */
   void SetColors(rgb_color bg, rgb_color fill, rgb_color border);
 
+  /** @brief Shows `overview` behind the progress (copied). */
+  void SetWaveform(const WaveformOverview &overview);
+
+  /** @brief Removes the waveform overview. */
+  void ClearWaveform();
+
+  /**
+   * @brief Reads position and duration from `clock` (not owned); nullptr
+   * goes back to SetPosition() and SetDuration().
+   */
+  void SetClock(const PlaybackClock *clock);
+
+  /** @brief Turns redraw pacing on or off, e.g. while minimized. */
+  void SetFramePacing(bool enabled);
+
   void Draw(BRect updateRect) override;
   void MouseDown(BPoint where) override;
   void MouseUp(BPoint where) override;
   void MouseMoved(BPoint where, uint32 transit,
                   const BMessage *dragMessage) override;
   void AttachedToWindow() override;
+  void DetachedFromWindow() override;
   void MessageReceived(BMessage *msg) override;
 
 private:
+  static const bigtime_t kFrameInterval = 1000000 / 30;
+  static const bigtime_t kIdleInterval = 250000;
+
+  bool _SyncClock(bool &advancing);
+  void _UpdatePacing();
+
   void _SeekFromPoint(BPoint where);
   void _DrawBar(const BRect &r);
+  void _DrawWaveform(const BRect &r, float progressRight);
 
   /** @name State */
   ///@{
   bigtime_t fDuration;
   bigtime_t fPosition;
   bool fTracking;
+  WaveformOverview fWaveform;
+  ///@}
+
+  /** @name Clock and pacing */
+  ///@{
+  const PlaybackClock *fClock;
+  bool fPacing;
+  BMessageRunner *fFrameRunner;
+  bigtime_t fFrameRunnerInterval;
   ///@}
 
   /** @name Appearance */
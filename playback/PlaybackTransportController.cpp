@@ -13,16 +13,20 @@
 #include "RadioStationController.h"
 #include "PlaybackSeekBarView.h"
 #include "ViewStateController.h"
+#include "WaveformAnalyzer.h"
 
 #include <Button.h>
 #include <Catalog.h>
 #include <Message.h>
 #include <MessageRunner.h>
+#include <Messenger.h>
 #include <OS.h>
 #include <Slider.h>
 #include <String.h>
 #include <StringView.h>
 
+#include <memory>
+
 #undef B_TRANSLATION_CONTEXT
 #define B_TRANSLATION_CONTEXT "PlaybackTransportController"
 
@@ -33,6 +37,18 @@
 PlaybackTransportController::PlaybackTransportController(MainWindow *window)
     : fWindow(window)
 {
+  fWaveformAnalyzer = new WaveformAnalyzer(BMessenger(window));
+  fWaveformAnalyzer->Run();
+}
+
+/**
+ * @brief Aborts a running waveform analysis and stops its looper.
+ */
+PlaybackTransportController::~PlaybackTransportController()
+{
+  fWaveformAnalyzer->Cancel();
+  if (fWaveformAnalyzer->Lock())
+    fWaveformAnalyzer->Quit();
 }
 
 /**
@@ -45,7 +61,8 @@ PlaybackTransportController::TogglePlayPause()
     return;
 
   if (fWindow->fPlaybackEngine->IsPlaying()) {
-    if (fWindow->fIsRadioMode) {
+    // Live radio can only pause while it is recorded for time-shifting.
+    if (fWindow->fIsRadioMode && !fWindow->fPlaybackEngine->IsTimeShifted()) {
       StopPlayback();
     } else {
       fWindow->fPlaybackEngine->Pause();
@@ -97,7 +114,8 @@ PlaybackTransportController::StopPlayback()
 
   AudioPlaybackEngine *engine = fWindow->fPlaybackEngine;
   if (engine)
-    fWindow->LaunchThread("playback_stop", [engine]() { engine->Stop(); });
+    fWindow->QueueJob(kLaneInteractive, "playback_stop",
+                      [engine]() { engine->Stop(); });
 
   fNowPlayingPath = "";
   fNowPlayingIsValid = false;
@@ -114,6 +132,8 @@ PlaybackTransportController::StopPlayback()
   fWindow->fTitleView->SetText("");
   fWindow->fSeekBar->SetPosition(0);
   fWindow->fSeekBar->SetDuration(0);
+  fWindow->fSeekBar->ClearWaveform();
+  fWaveformAnalyzer->Cancel();
   if (fWindow->fLibraryManager && fWindow->fLibraryManager->ContentView())
     fWindow->fLibraryManager->ContentView()->SetNowPlayingPath("");
   if (fWindow->fViewStateController) {
@@ -133,9 +153,7 @@ PlaybackTransportController::HandleSeekRequest(BMessage *msg)
     return;
 
 #if ENABLE_MIDI_PLAYBACK
-  BString lowerPath = fNowPlayingPath;
-  lowerPath.ToLower();
-  if (lowerPath.EndsWith(".mid") || lowerPath.EndsWith(".midi")) {
+  if (fWindow->fPlaybackEngine->IsMidiSynthPlaying()) {
     fWindow->fSeekBar->SetPosition(fWindow->fPlaybackEngine->CurrentPosition());
     return;
   }
@@ -147,7 +165,8 @@ PlaybackTransportController::HandleSeekRequest(BMessage *msg)
 }
 
 /**
- * @brief Updates seek bar with current position and duration.
+ * @brief Publishes the polled position of MIDI or remote playback; the seek
+ * bar picks it up from the engine's clock on its next frame.
  */
 void
 PlaybackTransportController::UpdatePlaybackTime()
@@ -155,16 +174,7 @@ PlaybackTransportController::UpdatePlaybackTime()
   if (!fWindow || !fWindow->fPlaybackEngine)
     return;
 
-  bigtime_t dur = fWindow->fPlaybackEngine->Duration();
-  if (dur <= 0) {
-    fWindow->fSeekBar->SetDuration(0);
-    fWindow->fSeekBar->SetPosition(0);
-    return;
-  }
-
-  bigtime_t pos = fWindow->fPlaybackEngine->CurrentPosition();
-  fWindow->fSeekBar->SetDuration(dur);
-  fWindow->fSeekBar->SetPosition(pos);
+  fWindow->fPlaybackEngine->RefreshClock();
 }
 
 /**
@@ -254,6 +264,12 @@ PlaybackTransportController::HandleNowPlaying(BMessage *msg)
 
   _UpdateNowPlayingState(path, isStream, msg);
 
+  fWindow->fSeekBar->ClearWaveform();
+  if (isStream)
+    fWaveformAnalyzer->Cancel();
+  else
+    fWaveformAnalyzer->Request(path);
+
   BString tablePath = path;
   if (isStream && fWindow->fIsRadioMode && fWindow->fRadioStationController &&
       fWindow->fRadioStationController->HasActiveStation()) {
@@ -269,6 +285,25 @@ PlaybackTransportController::HandleNowPlaying(BMessage *msg)
     fWindow->fArtworkController->FetchNowPlayingCover(path, isStream);
 }
 
+/**
+ * @brief Applies a waveform overview unless the track changed meanwhile.
+ */
+void
+PlaybackTransportController::HandleWaveformReady(BMessage *msg)
+{
+  WaveformOverview *overview = nullptr;
+  if (!msg || msg->FindPointer("overview", (void **)&overview) != B_OK ||
+      !overview)
+    return;
+  std::unique_ptr<WaveformOverview> owner(overview);
+
+  BString path;
+  if (!fWindow || msg->FindString("path", &path) != B_OK ||
+      path != fNowPlayingPath)
+    return;
+  fWindow->fSeekBar->SetWaveform(*overview);
+}
+
 /**
  * @brief Updates internal now-playing cache and title label.
  */
@@ -325,9 +360,9 @@ PlaybackTransportController::_UpdateNowPlayingState(const BString &path,
     fWindow->fRadioStationController->ClearActiveCover();
   }
 
-  auto npIt = fWindow->fPathIndex.find(path);
-  if (npIt != fWindow->fPathIndex.end()) {
-    fNowPlayingItem = fWindow->fAllItems[npIt->second];
+  size_t npIndex = fWindow->fPathIndex.Find(path);
+  if (npIndex != MediaPathIndex::kNotFound) {
+    fNowPlayingItem = fWindow->fAllItems[npIndex];
     fNowPlayingIsValid = true;
     artist = fNowPlayingItem.artist;
     title = fNowPlayingItem.title;
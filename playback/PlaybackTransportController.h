@@ -7,6 +7,7 @@
 
 class BMessage;
 class MainWindow;
+class WaveformAnalyzer;
 
 /**
  * @class PlaybackTransportController
@@ -19,6 +20,7 @@ public:
    * @param window Owning main window context.
    */
   explicit PlaybackTransportController(MainWindow *window);
+  ~PlaybackTransportController();
 
   /** @brief Toggles play/pause according to current engine state. */
   void TogglePlayPause();
@@ -46,6 +48,9 @@ public:
   
   /** @brief Updates now-playing metadata context from playback notification. */
   void HandleNowPlaying(BMessage *msg);
+
+  /** @brief Shows a computed waveform if it is for the current track. */
+  void HandleWaveformReady(BMessage *msg);
   
   /** @brief Returns whether cached now-playing item data is valid. */
   bool NowPlayingIsValid() const;
@@ -78,6 +83,9 @@ private:
   
   /** @brief Indicates whether `fNowPlayingItem` contains valid data. */
   bool fNowPlayingIsValid = false;
+
+  /** @brief Background waveform overview computation for the seek bar. */
+  WaveformAnalyzer *fWaveformAnalyzer;
 };
 
 #endif // BETON_PLAYBACK_TRANSPORT_CONTROLLER_H
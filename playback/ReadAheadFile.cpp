@@ -0,0 +1,122 @@
+#include "ReadAheadFile.h"
+#include "MidiRenderIO.h"
+
+#include <String.h>
+
+#include <algorithm>
+#include <cstring>
+
+ReadAheadFile::ReadAheadFile(const entry_ref &ref)
+    : fFile(&ref, B_READ_ONLY), fStatus(fFile.InitCheck()), fSize(0),
+      fPosition(0), fWindowStart(0), fWindowLength(0), fNextRead(0) {
+  if (fStatus == B_OK)
+    fStatus = fFile.GetSize(&fSize);
+  if (fStatus == B_OK)
+    fWindow.resize(kWindowSize);
+}
+
+ssize_t ReadAheadFile::ReadAt(off_t position, void *buffer, size_t size) {
+  if (fStatus != B_OK)
+    return fStatus;
+  if (position < 0)
+    return B_BAD_VALUE;
+  if (position >= fSize || size == 0)
+    return 0;
+  size = (size_t)std::min<off_t>(size, fSize - position);
+
+  const bool sequential = position == fNextRead;
+  fNextRead = position + size;
+  const size_t window = sequential ? kWindowSize : kSeekWindowSize;
+
+  uint8 *out = static_cast<uint8 *>(buffer);
+  size_t copied = 0;
+  while (copied < size) {
+    const off_t at = position + copied;
+    const size_t remaining = size - copied;
+    if (at >= fWindowStart && at < fWindowStart + (off_t)fWindowLength) {
+      size_t count = std::min(remaining,
+                              (size_t)(fWindowStart + fWindowLength - at));
+      memcpy(out + copied, fWindow.data() + (at - fWindowStart), count);
+      copied += count;
+      continue;
+    }
+    if (remaining >= window) {
+      ssize_t read = fFile.ReadAt(at, out + copied, remaining);
+      if (read <= 0)
+        return copied > 0 ? (ssize_t)copied : read;
+      copied += read;
+      continue;
+    }
+    status_t status = _Fill(at, window);
+    if (status != B_OK)
+      return copied > 0 ? (ssize_t)copied : status;
+  }
+  return copied;
+}
+
+ssize_t ReadAheadFile::WriteAt(off_t, const void *, size_t) {
+  return B_NOT_ALLOWED;
+}
+
+off_t ReadAheadFile::Seek(off_t position, uint32 seekMode) {
+  switch (seekMode) {
+  case SEEK_SET:
+    break;
+  case SEEK_CUR:
+    position += fPosition;
+    break;
+  case SEEK_END:
+    position += fSize;
+    break;
+  default:
+    return B_BAD_VALUE;
+  }
+  if (position < 0)
+    return B_BAD_VALUE;
+  fPosition = position;
+  return fPosition;
+}
+
+status_t ReadAheadFile::SetSize(off_t) { return B_NOT_ALLOWED; }
+
+status_t ReadAheadFile::GetSize(off_t *size) const {
+  if (fStatus != B_OK)
+    return fStatus;
+  *size = fSize;
+  return B_OK;
+}
+
+/** @brief Loads the `window`-aligned block holding `position`. */
+status_t ReadAheadFile::_Fill(off_t position, size_t window) {
+  const off_t start = position - position % (off_t)window;
+  ssize_t read = fFile.ReadAt(start, fWindow.data(), window);
+  if (read < 0) {
+    fWindowLength = 0;
+    return (status_t)read;
+  }
+  fWindowStart = start;
+  fWindowLength = (size_t)read;
+  // A short read that ends before `position` means the file shrank.
+  return start + read > position ? B_OK : B_FILE_ERROR;
+}
+
+LocalMediaFile::LocalMediaFile(const entry_ref &ref)
+    : ReadAheadSource(ref), BMediaFile(&fSource) {}
+
+BMediaFile *LocalMediaFile::Open(const entry_ref &ref) {
+#if ENABLE_MIDI_RENDERING
+  BString name(ref.name);
+  name.ToLower();
+  if ((name.EndsWith(".mid") || name.EndsWith(".midi")) && RendersMidi())
+    return new MidiMediaFile(ref);
+#endif
+  return new LocalMediaFile(ref);
+}
+
+bool LocalMediaFile::RendersMidi() {
+#if ENABLE_MIDI_RENDERING
+  return MidiRenderIO::Available();
+#else
+  return false;
+#endif
+}
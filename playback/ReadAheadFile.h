@@ -0,0 +1,77 @@
+#ifndef BETON_READ_AHEAD_FILE_H
+#define BETON_READ_AHEAD_FILE_H
+
+#include <DataIO.h>
+#include <Entry.h>
+#include <File.h>
+#include <MediaFile.h>
+#include <vector>
+
+/**
+ * @class ReadAheadFile
+ * @brief Read-only BPositionIO over a local file that reads in large
+ * aligned blocks.
+ *
+ * Extractors ask for a few KB at a time. On network-mounted volumes every
+ * such read costs a round trip, so reads are served from a window filled
+ * with one aligned read: kWindowSize while access is sequential, the
+ * smaller kSeekWindowSize after a jump (header probing, tags at the end,
+ * seeking), so random access does not drag in a full window per read.
+ * Reads of at least a window go straight to the file.
+ *
+ * Not thread-safe, like BFile; each decoding thread opens its own.
+ */
+class ReadAheadFile : public BPositionIO {
+public:
+  static const size_t kWindowSize = 1024 * 1024;
+  static const size_t kSeekWindowSize = 64 * 1024;
+
+  explicit ReadAheadFile(const entry_ref &ref);
+
+  status_t InitCheck() const { return fStatus; }
+
+  ssize_t ReadAt(off_t position, void *buffer, size_t size) override;
+  ssize_t WriteAt(off_t position, const void *buffer, size_t size) override;
+  off_t Seek(off_t position, uint32 seekMode) override;
+  off_t Position() const override { return fPosition; }
+  status_t SetSize(off_t size) override;
+  status_t GetSize(off_t *size) const override;
+
+private:
+  status_t _Fill(off_t position, size_t window);
+
+  BFile fFile;
+  status_t fStatus;
+  off_t fSize;
+  off_t fPosition;
+  std::vector<uint8> fWindow;
+  off_t fWindowStart;
+  size_t fWindowLength;
+  off_t fNextRead; ///< Where a sequential reader reads next
+};
+
+/** @brief Owns the source of a LocalMediaFile; a base so it outlives it. */
+struct ReadAheadSource {
+  explicit ReadAheadSource(const entry_ref &ref) : fSource(ref) {}
+  ReadAheadFile fSource;
+};
+
+/**
+ * @class LocalMediaFile
+ * @brief BMediaFile of a local file, read through a ReadAheadFile.
+ *
+ * A drop-in for `BMediaFile(&ref)` wherever a local file is decoded: the
+ * engine, the prefetcher and the waveform and loudness workers. Open()
+ * also covers MIDI files when they are rendered (MidiMediaFile).
+ */
+class LocalMediaFile : private ReadAheadSource, public BMediaFile {
+public:
+  explicit LocalMediaFile(const entry_ref &ref);
+
+  /** @brief Opens `ref` for decoding; check InitCheck() of the result. */
+  static BMediaFile *Open(const entry_ref &ref);
+  /** @brief Whether MIDI files are rendered and decoded like the others. */
+  static bool RendersMidi();
+};
+
+#endif // BETON_READ_AHEAD_FILE_H
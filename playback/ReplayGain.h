@@ -0,0 +1,52 @@
+#ifndef BETON_REPLAY_GAIN_H
+#define BETON_REPLAY_GAIN_H
+
+#include <SupportDefs.h>
+#include <cmath>
+
+/**
+ * @struct ReplayGain
+ * @brief Gains of one queue entry, in the units of MediaItem: hundredths of
+ * a dB and millionths of full scale; a peak of 0 means "unknown".
+ */
+struct ReplayGain {
+  /** @brief Playback normalization modes (persisted). */
+  enum Mode { kOff = 0, kTrack = 1, kAlbum = 2 };
+
+  int32 trackGain = 0;
+  int32 trackPeak = 0;
+  int32 albumGain = 0;
+  int32 albumPeak = 0;
+
+  /** @brief Copies the loudness fields of a MediaItem (or alike). */
+  template <class Item> static ReplayGain Of(const Item &item) {
+    ReplayGain gain;
+    gain.trackGain = item.trackGain;
+    gain.trackPeak = item.trackPeak;
+    gain.albumGain = item.albumGain;
+    gain.albumPeak = item.albumPeak;
+    return gain;
+  }
+
+  /**
+   * @brief Linear factor for `mode`, limited so the peak does not clip.
+   *
+   * Album mode falls back to the track values where there are no album
+   * values; entries without any values play at unity gain.
+   */
+  float Factor(int32 mode) const {
+    int32 gain = trackGain;
+    int32 peak = trackPeak;
+    if (mode == kAlbum && albumPeak > 0) {
+      gain = albumGain;
+      peak = albumPeak;
+    }
+    if (mode == kOff || peak <= 0)
+      return 1.0f;
+    float factor = std::pow(10.0f, gain / 2000.0f);
+    float limit = 1000000.0f / peak;
+    return factor < limit ? factor : limit;
+  }
+};
+
+#endif // BETON_REPLAY_GAIN_H
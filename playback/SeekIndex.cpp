@@ -0,0 +1,159 @@
+#include "SeekIndex.h"
+#include "Debug.h"
+
+#include <Directory.h>
+#include <Entry.h>
+#include <File.h>
+#include <FindDirectory.h>
+#include <Path.h>
+#include <String.h>
+
+#include <algorithm>
+#include <sys/stat.h>
+
+/** @brief Cached tables kept; the least recently written go first. */
+static const int32 kMaxCachedFiles = 256;
+static const uint32 kCacheMagic = 'BSix';
+static const uint32 kCacheVersion = 1;
+
+/** @brief Directory of the seek index cache in the settings directory. */
+static BString CacheDirectory() {
+  BPath settingsPath;
+  find_directory(B_USER_SETTINGS_DIRECTORY, &settingsPath);
+  settingsPath.Append("BeTon/seek_index");
+  return BString(settingsPath.Path());
+}
+
+static BString CachePath(int64 inode, int64 mtime) {
+  BString path = CacheDirectory();
+  path << "/" << inode << "_" << mtime;
+  return path;
+}
+
+SeekIndex::SeekIndex()
+    : fFrameRate(0), fInode(0), fMtime(0), fValid(false), fDirty(false) {}
+
+void SeekIndex::SetTo(const char *path, float frameRate) {
+  Save();
+  fPoints.clear();
+  fValid = false;
+  fFrameRate = frameRate;
+
+  struct stat st;
+  if (path == nullptr || frameRate <= 0 || stat(path, &st) != 0)
+    return;
+  fInode = st.st_ino;
+  fMtime = st.st_mtime;
+  fValid = true;
+  _Load();
+}
+
+void SeekIndex::Record(int64 position, int64 frame) {
+  if (!fValid)
+    return;
+  if (fPoints.empty()) {
+    // Every table starts at the beginning of the file.
+    fPoints.push_back(Point{0, 0});
+    fDirty = true;
+  }
+  int64 spacing = (int64)(kSpacing * (double)fFrameRate / 1000000.0);
+  if (position < fPoints.back().position + spacing ||
+      frame <= fPoints.back().frame)
+    return;
+  fPoints.push_back(Point{position, frame});
+  fDirty = true;
+}
+
+status_t SeekIndex::Seek(BMediaTrack *track, int64 target, int64 &position,
+                         bool &exact) const {
+  const double rate = fFrameRate > 0 ? fFrameRate : 44100.0;
+  auto it = std::upper_bound(fPoints.begin(), fPoints.end(), target,
+                             [](int64 value, const Point &point) {
+                               return value < point.position;
+                             });
+  if (it != fPoints.begin()) {
+    const Point &point = *(it - 1);
+    int64 frame = point.frame;
+    if ((target - point.position) * 1000000.0 / rate <= kMaxSkip &&
+        track->SeekToFrame(&frame, B_MEDIA_SEEK_CLOSEST_BACKWARD) == B_OK &&
+        frame == point.frame) {
+      position = point.position;
+      exact = true;
+      return B_OK;
+    }
+  }
+
+  exact = false;
+  bigtime_t time = (bigtime_t)(target * 1000000.0 / rate);
+  status_t status = track->SeekToTime(&time, B_MEDIA_SEEK_CLOSEST_BACKWARD);
+  position = (int64)(time * rate / 1000000.0);
+  return status;
+}
+
+void SeekIndex::_Load() {
+  BFile file(CachePath(fInode, fMtime).String(), B_READ_ONLY);
+  uint32 header[3];
+  if (file.InitCheck() != B_OK ||
+      file.Read(header, sizeof(header)) != (ssize_t)sizeof(header) ||
+      header[0] != kCacheMagic || header[1] != kCacheVersion)
+    return;
+
+  fPoints.resize(header[2]);
+  ssize_t bytes = (ssize_t)(fPoints.size() * sizeof(Point));
+  if (file.Read(fPoints.data(), bytes) != bytes) {
+    fPoints.clear();
+    return;
+  }
+  DEBUG_PRINT("seek index: %ld points cached\n", (long)fPoints.size());
+}
+
+void SeekIndex::Save() {
+  if (!fValid || !fDirty)
+    return;
+  fDirty = false;
+
+  BString directory = CacheDirectory();
+  create_directory(directory.String(), 0755);
+  BString path = CachePath(fInode, fMtime);
+  bool isNew = !BEntry(path.String()).Exists();
+
+  BFile file(path.String(), B_WRITE_ONLY | B_CREATE_FILE | B_ERASE_FILE);
+  uint32 header[3] = {kCacheMagic, kCacheVersion, (uint32)fPoints.size()};
+  ssize_t bytes = (ssize_t)(fPoints.size() * sizeof(Point));
+  if (file.InitCheck() != B_OK ||
+      file.Write(header, sizeof(header)) != (ssize_t)sizeof(header) ||
+      file.Write(fPoints.data(), bytes) != bytes) {
+    DEBUG_PRINT("seek index: could not write %s\n", path.String());
+    return;
+  }
+  if (isNew)
+    _Prune();
+}
+
+/** @brief Removes the oldest tables beyond kMaxCachedFiles. */
+void SeekIndex::_Prune() {
+  BDirectory directory(CacheDirectory().String());
+  if (directory.InitCheck() != B_OK ||
+      directory.CountEntries() <= kMaxCachedFiles)
+    return;
+
+  std::vector<std::pair<time_t, BString>> files;
+  BEntry entry;
+  while (directory.GetNextEntry(&entry) == B_OK) {
+    time_t modified;
+    BPath path;
+    if (entry.GetModificationTime(&modified) == B_OK &&
+        entry.GetPath(&path) == B_OK)
+      files.push_back(std::make_pair(modified, BString(path.Path())));
+  }
+  if ((int32)files.size() <= kMaxCachedFiles)
+    return;
+
+  std::sort(files.begin(), files.end(),
+            [](const std::pair<time_t, BString> &a,
+               const std::pair<time_t, BString> &b) {
+              return a.first < b.first;
+            });
+  for (size_t i = 0; i < files.size() - kMaxCachedFiles; i++)
+    BEntry(files[i].second.String()).Remove();
+}
@@ -0,0 +1,80 @@
+#ifndef BETON_SEEK_INDEX_H
+#define BETON_SEEK_INDEX_H
+
+#include <MediaTrack.h>
+#include <SupportDefs.h>
+#include <vector>
+
+/**
+ * @class SeekIndex
+ * @brief Per-file table of exact positions for seeking, cached by
+ * (inode, mtime).
+ *
+ * The Media Kit exposes no byte offsets, so a point pairs the exact
+ * position of the audio decoded so far (frames counted from the start)
+ * with the frame the decoder reports at that moment. Points are recorded
+ * every kSpacing while a track decodes sequentially from the start or from
+ * a point, so the table grows with every playback.
+ *
+ * Seek() returns to the point at or before the target; the caller decodes
+ * and drops the frames in between to land exactly on it. Without a close point it
+ * falls back to the decoder's own time seek, which may land early (or, on
+ * VBR files without a table of contents, somewhere inexact); the caller
+ * still skips forward from where the decoder says it landed.
+ *
+ * Not thread-safe; the decoder thread owns its instance.
+ */
+class SeekIndex {
+public:
+  /** @brief Time between two points. */
+  static const bigtime_t kSpacing = 2000000;
+  /** @brief Longest stretch Seek() decodes forward to reach a target. */
+  static const bigtime_t kMaxSkip = 10000000;
+
+  SeekIndex();
+
+  /**
+   * @brief Saves the current table and loads the one cached for `path`,
+   * which decodes at `frameRate`.
+   */
+  void SetTo(const char *path, float frameRate);
+  /** @brief Writes the table to the cache if it grew. */
+  void Save();
+
+  /**
+   * @brief Appends a point if `position` lies kSpacing past the last one.
+   * Only valid while decoding continuously from a known position.
+   * @param position Frames decoded since the start of the file.
+   * @param frame The decoder's CurrentFrame() after those.
+   */
+  void Record(int64 position, int64 frame);
+
+  /**
+   * @brief Seeks `track` at or before frame `target`.
+   * @param position Set to the frame the decoder now is at.
+   * @param exact Set when `position` is exact (a recorded point).
+   * @return B_OK, or the decoder's error from the time seek.
+   */
+  status_t Seek(BMediaTrack *track, int64 target, int64 &position,
+                bool &exact) const;
+
+  int32 CountPoints() const { return (int32)fPoints.size(); }
+
+private:
+  struct Point {
+    int64 position;
+    int64 frame;
+  };
+
+  void _Load();
+  static void _Prune();
+
+  std::vector<Point> fPoints; ///< Ascending position
+  float fFrameRate;
+  int64 fInode;
+  int64 fMtime;
+  bool fValid;  ///< The current file could be stat()ed
+  bool fDirty;
+};
+
+#endif // BETON_SEEK_INDEX_H
@@ -0,0 +1,185 @@
+#include "TrackPrefetcher.h"
+#include "Debug.h"
+#include "ReadAheadFile.h"
+
+#include <Autolock.h>
+#include <Entry.h>
+
+#include <algorithm>
+
+TrackPrefetcher::TrackPrefetcher()
+    : fLock("track prefetch"), fLoader("track prefetch", kDepth * 2) {}
+
+TrackPrefetcher::~TrackPrefetcher() {
+  fLoader.Quit();
+  Clear();
+}
+
+void TrackPrefetcher::SetWanted(const std::vector<std::string> &paths) {
+  std::vector<std::string> wanted;
+  for (const std::string &path : paths) {
+    if ((int32)wanted.size() >= kDepth)
+      break;
+    if (!path.empty() &&
+        std::find(wanted.begin(), wanted.end(), path) == wanted.end())
+      wanted.push_back(path);
+  }
+  _Drop([&](const std::string &path) {
+    return std::find(wanted.begin(), wanted.end(), path) != wanted.end();
+  });
+
+  BAutolock lock(fLock);
+  for (const std::string &path : wanted) {
+    auto it = std::find_if(fEntries.begin(), fEntries.end(),
+                           [&](const Entry &entry) {
+                             return entry.path == path;
+                           });
+    if (it != fEntries.end())
+      continue;
+    Entry entry;
+    entry.path = path;
+    fEntries.push_back(std::move(entry));
+    fLoader.Post([this, path] { _Load(path); });
+  }
+}
+
+void TrackPrefetcher::Retain(
+    const std::function<bool(const std::string &)> &keep) {
+  _Drop(keep);
+}
+
+bool TrackPrefetcher::Take(const std::string &path, Track &out) {
+  BAutolock lock(fLock);
+  auto it = std::find_if(fEntries.begin(), fEntries.end(),
+                         [&](const Entry &entry) {
+                           return entry.path == path;
+                         });
+  if (it == fEntries.end())
+    return false;
+  bool ready = it->ready;
+  if (ready)
+    out = std::move(it->track);
+  // A load still running finds its entry gone and discards the result.
+  fEntries.erase(it);
+  return ready;
+}
+
+void TrackPrefetcher::Clear() {
+  fLoader.Cancel();
+  _Drop([](const std::string &) { return false; });
+}
+
+void TrackPrefetcher::Release(Track &track) {
+  if (track.file != nullptr) {
+    if (track.track != nullptr)
+      track.file->ReleaseTrack(track.track);
+    delete track.file;
+  }
+  track.file = nullptr;
+  track.track = nullptr;
+  track.primed.clear();
+}
+
+/** @brief Removes the entries `keep` rejects, closing their files unlocked. */
+void TrackPrefetcher::_Drop(
+    const std::function<bool(const std::string &)> &keep) {
+  std::vector<Track> dropped;
+  {
+    BAutolock lock(fLock);
+    for (auto it = fEntries.begin(); it != fEntries.end();) {
+      if (keep(it->path)) {
+        ++it;
+        continue;
+      }
+      if (it->ready)
+        dropped.push_back(std::move(it->track));
+      it = fEntries.erase(it);
+    }
+  }
+  for (Track &track : dropped)
+    Release(track);
+}
+
+/** @brief Opens `path` and decodes its first frames (loader thread). */
+void TrackPrefetcher::_Load(const std::string &path) {
+  {
+    BAutolock lock(fLock);
+    bool wanted = std::any_of(fEntries.begin(), fEntries.end(),
+                              [&](const Entry &entry) {
+                                return entry.path == path && !entry.ready;
+                              });
+    if (!wanted)
+      return;
+  }
+
+  const bigtime_t start = system_time();
+  Track result;
+  entry_ref ref;
+  status_t status = get_ref_for_path(path.c_str(), &ref);
+  if (status == B_OK) {
+    result.file = LocalMediaFile::Open(ref);
+    status = result.file->InitCheck();
+  }
+  if (status == B_OK) {
+    result.track = result.file->TrackAt(0);
+    if (result.track == nullptr)
+      status = B_ERROR;
+  }
+  if (status == B_OK) {
+    result.format = media_format();
+    status = result.track->DecodedFormat(&result.format);
+    if (status == B_OK && result.format.type != B_MEDIA_RAW_AUDIO)
+      status = B_BAD_TYPE;
+  }
+  if (status == B_OK) {
+    const media_raw_audio_format &raw = result.format.u.raw_audio;
+    size_t frameSize =
+        (size_t)(raw.format & media_raw_audio_format::B_AUDIO_SIZE_MASK) *
+        raw.channel_count;
+    size_t chunkSize = raw.buffer_size > 0 ? raw.buffer_size
+                                           : 4096 * frameSize;
+    if (frameSize == 0 || chunkSize > kMaxPrimedBytes) {
+      status = B_BAD_VALUE;
+    } else {
+      std::vector<uint8> chunk(chunkSize);
+      while (result.primed.size() + chunkSize <= kMaxPrimedBytes) {
+        int64 frames = (int64)(chunkSize / frameSize);
+        if (result.track->ReadFrames(chunk.data(), &frames) != B_OK ||
+            frames <= 0)
+          break;
+        size_t bytes = std::min(chunkSize, (size_t)frames * frameSize);
+        result.primed.insert(result.primed.end(), chunk.data(),
+                             chunk.data() + bytes);
+      }
+    }
+  }
+
+  if (status != B_OK) {
+    DEBUG_PRINT("prefetch: %s failed (%ld)\n", path.c_str(), (long)status);
+    Release(result);
+    BAutolock lock(fLock);
+    fEntries.erase(std::remove_if(fEntries.begin(), fEntries.end(),
+                                  [&](const Entry &entry) {
+                                    return entry.path == path;
+                                  }),
+                   fEntries.end());
+    return;
+  }
+
+  {
+    BAutolock lock(fLock);
+    auto it = std::find_if(fEntries.begin(), fEntries.end(),
+                           [&](const Entry &entry) {
+                             return entry.path == path && !entry.ready;
+                           });
+    if (it != fEntries.end()) {
+      it->track = std::move(result);
+      it->ready = true;
+      DEBUG_PRINT("prefetch: %s ready in %lld us (%zu bytes)\n",
+                  path.c_str(), (long long)(system_time() - start),
+                  it->track.primed.size());
+      return;
+    }
+  }
+  Release(result);
+}
@@ -0,0 +1,74 @@
+#ifndef BETON_TRACK_PREFETCHER_H
+#define BETON_TRACK_PREFETCHER_H
+
+#include "CommandExecutor.h"
+
+#include <Locker.h>
+#include <MediaDefs.h>
+#include <MediaFile.h>
+#include <MediaTrack.h>
+#include <functional>
+#include <string>
+#include <vector>
+
+/**
+ * @class TrackPrefetcher
+ * @brief Opens the tracks likely to play next and decodes their first
+ * frames in the background, so Play() can start without touching the disk.
+ *
+ * SetWanted() names the paths to keep warm (at most kDepth); entries for
+ * other paths are dropped, missing ones are loaded one after another on a
+ * CommandExecutor thread. Each entry holds the open file and track, the
+ * native decoded format and up to kMaxPrimedBytes of decoded audio, so the
+ * cache never holds more than kDepth * kMaxPrimedBytes of samples.
+ *
+ * Take() hands an entry that finished loading over to the caller; one still
+ * loading is dropped and the caller opens the file itself.
+ */
+class TrackPrefetcher {
+public:
+  /** @brief A prefetched track, owned by whoever holds it. */
+  struct Track {
+    BMediaFile *file = nullptr;
+    BMediaTrack *track = nullptr;
+    media_format format; ///< Native decoded format, as Play() asks for it
+    std::vector<uint8> primed; ///< Decoded frames from the start of the file
+  };
+
+  static const int32 kDepth = 2;
+  static const size_t kMaxPrimedBytes = 512 * 1024;
+
+  TrackPrefetcher();
+  ~TrackPrefetcher();
+
+  /** @brief Keeps the first kDepth of `paths` warm and drops all others. */
+  void SetWanted(const std::vector<std::string> &paths);
+
+  /** @brief Drops the entries whose path `keep` rejects; loads nothing. */
+  void Retain(const std::function<bool(const std::string &)> &keep);
+
+  /** @brief Moves the loaded entry for `path` into `out`. */
+  bool Take(const std::string &path, Track &out);
+
+  /** @brief Drops every entry and queued load. */
+  void Clear();
+
+  /** @brief Closes the file and track of `track`. */
+  static void Release(Track &track);
+
+private:
+  struct Entry {
+    std::string path;
+    bool ready = false; ///< Loaded; otherwise its load is queued or running
+    Track track;
+  };
+
+  void _Load(const std::string &path);
+  void _Drop(const std::function<bool(const std::string &)> &keep);
+
+  BLocker fLock;
+  std::vector<Entry> fEntries; ///< Guarded by fLock
+  CommandExecutor fLoader;
+};
+
+#endif // BETON_TRACK_PREFETCHER_H
@@ -0,0 +1,274 @@
+#include "WaveformAnalyzer.h"
+#include "Debug.h"
+#include "Messages.h"
+#include "PcmKernels.h"
+#include "ReadAheadFile.h"
+
+#include <Directory.h>
+#include <Entry.h>
+#include <File.h>
+#include <FindDirectory.h>
+#include <MediaFile.h>
+#include <MediaTrack.h>
+#include <Message.h>
+#include <OS.h>
+#include <Path.h>
+
+#include <algorithm>
+#include <cmath>
+#include <memory>
+#include <sys/stat.h>
+
+static const uint32 kWaveformMagic = 'BTwf';
+static const uint32 kWaveformVersion = 1;
+
+/** @brief Cache file header; followed by `count` peaks, then `count` RMS. */
+struct WaveformHeader {
+  uint32 magic;
+  uint32 version;
+  int32 count;
+};
+
+/**
+ * @brief Running peak and sum of squares of one bucket.
+ *
+ * Uses four independent lanes so the loop maps onto SIMD registers without
+ * needing the compiler to reassociate floating point math.
+ */
+struct BucketStats {
+  float peak[4] = {0, 0, 0, 0};
+  double sum[4] = {0, 0, 0, 0};
+  int64 samples = 0;
+
+  void Add(const float *data, int64 count) {
+    int64 i = 0;
+    for (; i + 4 <= count; i += 4) {
+      for (int lane = 0; lane < 4; lane++) {
+        float v = data[i + lane];
+        float a = std::fabs(v);
+        peak[lane] = a > peak[lane] ? a : peak[lane];
+        sum[lane] += v * v;
+      }
+    }
+    for (; i < count; i++) {
+      float a = std::fabs(data[i]);
+      peak[0] = a > peak[0] ? a : peak[0];
+      sum[0] += data[i] * data[i];
+    }
+    samples += count;
+  }
+
+  void Store(WaveformOverview &overview, int32 bucket) const {
+    float maxPeak = std::max(std::max(peak[0], peak[1]),
+                             std::max(peak[2], peak[3]));
+    double total = sum[0] + sum[1] + sum[2] + sum[3];
+    double rms = samples > 0 ? std::sqrt(total / samples) : 0.0;
+    overview.peak[bucket] =
+        (uint8)std::min(255.0f, maxPeak * 255.0f + 0.5f);
+    overview.rms[bucket] = (uint8)std::min(255.0, rms * 255.0 + 0.5);
+  }
+};
+
+WaveformAnalyzer::WaveformAnalyzer(const BMessenger &target)
+    : BLooper("WaveformAnalyzer", B_LOW_PRIORITY), fTarget(target),
+      fLatest(0) {}
+
+void WaveformAnalyzer::Request(const BString &path) {
+  BMessage request(MSG_WAVEFORM_REQUEST);
+  request.AddString("path", path);
+  request.AddInt32("ticket", fLatest.fetch_add(1) + 1);
+  PostMessage(&request);
+}
+
+void WaveformAnalyzer::Cancel() { fLatest.fetch_add(1); }
+
+void WaveformAnalyzer::MessageReceived(BMessage *msg) {
+  switch (msg->what) {
+  case MSG_WAVEFORM_REQUEST: {
+    BString path;
+    int32 ticket = 0;
+    if (msg->FindString("path", &path) != B_OK)
+      break;
+    msg->FindInt32("ticket", &ticket);
+    if (ticket != fLatest.load())
+      break;
+
+    std::unique_ptr<WaveformOverview> overview(new WaveformOverview);
+    BString key = _CacheKey(path.String());
+    if (key.IsEmpty())
+      break;
+
+    if (!_LoadCached(key, *overview)) {
+      bigtime_t start = system_time();
+      if (_Compute(path.String(), ticket, *overview) != B_OK)
+        break;
+      DEBUG_PRINT("WaveformAnalyzer: %s in %lld ms\n", path.String(),
+                  (long long)(system_time() - start) / 1000);
+      _StoreCached(key, *overview);
+    }
+
+    BMessage result(MSG_WAVEFORM_READY);
+    result.AddString("path", path);
+    result.AddPointer("overview", overview.get());
+    if (fTarget.SendMessage(&result) == B_OK)
+      overview.release();
+    break;
+  }
+
+  default:
+    BLooper::MessageReceived(msg);
+  }
+}
+
+BString WaveformAnalyzer::_CacheKey(const char *path) {
+  struct stat st;
+  BString key;
+  if (stat(path, &st) != 0)
+    return key;
+  key.SetToFormat("%lld-%lld-%lld", (long long)st.st_dev,
+                  (long long)st.st_ino, (long long)st.st_mtime);
+  return key;
+}
+
+static BPath WaveformCachePath(const BString &key) {
+  BPath path;
+  if (find_directory(B_USER_SETTINGS_DIRECTORY, &path) != B_OK)
+    return BPath();
+  path.Append("BeTon/waveforms");
+  create_directory(path.Path(), 0755);
+  path.Append(key.String());
+  return path;
+}
+
+bool WaveformAnalyzer::_LoadCached(const BString &key,
+                                   WaveformOverview &overview) {
+  BPath path = WaveformCachePath(key);
+  if (path.InitCheck() != B_OK)
+    return false;
+
+  BFile file(path.Path(), B_READ_ONLY);
+  WaveformHeader header;
+  if (file.InitCheck() != B_OK ||
+      file.Read(&header, sizeof(header)) != (ssize_t)sizeof(header) ||
+      header.magic != kWaveformMagic || header.version != kWaveformVersion ||
+      header.count != WaveformOverview::kBuckets)
+    return false;
+
+  overview.peak.resize(header.count);
+  overview.rms.resize(header.count);
+  if (file.Read(overview.peak.data(), header.count) != header.count ||
+      file.Read(overview.rms.data(), header.count) != header.count) {
+    overview.peak.clear();
+    overview.rms.clear();
+    return false;
+  }
+  return true;
+}
+
+void WaveformAnalyzer::_StoreCached(const BString &key,
+                                    const WaveformOverview &overview) {
+  BPath path = WaveformCachePath(key);
+  if (path.InitCheck() != B_OK)
+    return;
+
+  BFile file(path.Path(), B_WRITE_ONLY | B_CREATE_FILE | B_ERASE_FILE);
+  if (file.InitCheck() != B_OK)
+    return;
+
+  WaveformHeader header = {kWaveformMagic, kWaveformVersion,
+                           (int32)overview.peak.size()};
+  if (file.Write(&header, sizeof(header)) != (ssize_t)sizeof(header) ||
+      file.Write(overview.peak.data(), header.count) != header.count ||
+      file.Write(overview.rms.data(), header.count) != header.count) {
+    DEBUG_PRINT("WaveformAnalyzer: failed to write %s\n", path.Path());
+    file.Unset();
+    BEntry(path.Path()).Remove();
+  }
+}
+
+status_t WaveformAnalyzer::_Compute(const char *path, int32 ticket,
+                                    WaveformOverview &overview) {
+  entry_ref ref;
+  status_t status = get_ref_for_path(path, &ref);
+  if (status != B_OK)
+    return status;
+
+  std::unique_ptr<BMediaFile> file(LocalMediaFile::Open(ref));
+  if ((status = file->InitCheck()) != B_OK)
+    return status;
+  BMediaTrack *track = file->TrackAt(0);
+  if (track == nullptr)
+    return B_ERROR;
+
+  // Ask for floats; decoders that cannot deliver them usually give int16.
+  media_format format;
+  format.type = B_MEDIA_RAW_AUDIO;
+  format.u.raw_audio = media_raw_audio_format::wildcard;
+  format.u.raw_audio.format = media_raw_audio_format::B_AUDIO_FLOAT;
+  status = track->DecodedFormat(&format);
+
+  const media_raw_audio_format &raw = format.u.raw_audio;
+  int64 totalFrames = track->CountFrames();
+  int32 channels = (int32)raw.channel_count;
+  bool isFloat = raw.format == media_raw_audio_format::B_AUDIO_FLOAT;
+  bool isShort = raw.format == media_raw_audio_format::B_AUDIO_SHORT;
+  if (status != B_OK || totalFrames <= 0 || channels <= 0 ||
+      (!isFloat && !isShort)) {
+    file->ReleaseTrack(track);
+    return status != B_OK ? status : B_NOT_SUPPORTED;
+  }
+
+  size_t bufferSize = raw.buffer_size > 0 ? raw.buffer_size : 65536;
+  std::vector<char> buffer(bufferSize);
+  std::vector<float> converted;
+
+  overview.peak.assign(WaveformOverview::kBuckets, 0);
+  overview.rms.assign(WaveformOverview::kBuckets, 0);
+
+  BucketStats stats;
+  int32 bucket = 0;
+  int64 bucketEnd = totalFrames / WaveformOverview::kBuckets;
+  int64 position = 0;
+
+  while (bucket < WaveformOverview::kBuckets) {
+    if (ticket != fLatest.load()) {
+      status = B_CANCELED;
+      break;
+    }
+
+    int64 frames = 0;
+    if (track->ReadFrames(buffer.data(), &frames) != B_OK || frames <= 0)
+      break;
+
+    const float *samples = reinterpret_cast<const float *>(buffer.data());
+    if (isShort) {
+      const int16 *in = reinterpret_cast<const int16 *>(buffer.data());
+      converted.resize((size_t)frames * channels);
+      PcmKernels::Int16ToFloat(in, converted.data(), converted.size());
+      samples = converted.data();
+    }
+
+    // Split the chunk at bucket boundaries.
+    int64 offset = 0;
+    while (offset < frames && bucket < WaveformOverview::kBuckets) {
+      int64 run = std::min(frames - offset, bucketEnd - position);
+      stats.Add(samples + offset * channels, run * channels);
+      offset += run;
+      position += run;
+      if (position >= bucketEnd) {
+        stats.Store(overview, bucket);
+        stats = BucketStats();
+        bucket++;
+        bucketEnd = totalFrames * (bucket + 1) / WaveformOverview::kBuckets;
+      }
+    }
+  }
+
+  // CountFrames() is an estimate for some formats; keep a short tail.
+  if (status == B_OK && bucket < WaveformOverview::kBuckets &&
+      stats.samples > 0)
+    stats.Store(overview, bucket);
+
+  file->ReleaseTrack(track);
+  return status;
+}
@@ -0,0 +1,65 @@
+#ifndef BETON_WAVEFORM_ANALYZER_H
+#define BETON_WAVEFORM_ANALYZER_H
+
+#include <Looper.h>
+#include <Messenger.h>
+#include <String.h>
+#include <SupportDefs.h>
+#include <atomic>
+#include <vector>
+
+/**
+ * @struct WaveformOverview
+ * @brief Loudness overview of a whole track.
+ *
+ * The track is split into `kBuckets` equal stretches; each bucket holds the
+ * peak and RMS of all its samples (all channels) in 1/255 of full scale.
+ * The RMS values are also what a later ReplayGain pass would start from.
+ */
+struct WaveformOverview {
+  static const int32 kBuckets = 1024;
+
+  std::vector<uint8> peak;
+  std::vector<uint8> rms;
+
+  bool IsEmpty() const { return peak.empty(); }
+};
+
+/**
+ * @class WaveformAnalyzer
+ * @brief Looper that computes waveform overviews off the window thread.
+ *
+ * Results are cached on disk under `~/config/settings/BeTon/waveforms`,
+ * keyed by device, inode and modification time. Only the newest request is
+ * worked on: a new request aborts the decode of the previous one.
+ *
+ * Each result is sent to the target as `MSG_WAVEFORM_READY` with "path" and
+ * "overview" (a new `WaveformOverview` owned by the receiver).
+ */
+class WaveformAnalyzer : public BLooper {
+public:
+  explicit WaveformAnalyzer(const BMessenger &target);
+
+  /** @brief Queues the overview of the local file at `path`. */
+  void Request(const BString &path);
+
+  /** @brief Drops the pending request and aborts a running decode. */
+  void Cancel();
+
+  void MessageReceived(BMessage *msg) override;
+
+private:
+  static BString _CacheKey(const char *path);
+  static bool _LoadCached(const BString &key, WaveformOverview &overview);
+  static void _StoreCached(const BString &key,
+                           const WaveformOverview &overview);
+
+  /** @brief Decodes the file once and fills `overview`. */
+  status_t _Compute(const char *path, int32 ticket,
+                    WaveformOverview &overview);
+
+  BMessenger fTarget;
+  std::atomic<int32> fLatest;
+};
+
+#endif // BETON_WAVEFORM_ANALYZER_H
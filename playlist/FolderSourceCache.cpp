@@ -0,0 +1,84 @@
+#include "FolderSourceCache.h"
+#include "Debug.h"
+#include "Messages.h"
+
+#include <MessageRunner.h>
+#include <NodeMonitor.h>
+#include <PathMonitor.h>
+#include <string.h>
+
+static const uint32 kWatchFlags =
+    B_WATCH_RECURSIVELY | B_WATCH_NAME | B_WATCH_DIRECTORY | B_WATCH_STAT;
+
+FolderSourceCache::FolderSourceCache(const BMessenger &target)
+    : BHandler("FolderSourceCache"), fTarget(target), fNotifyRunner(nullptr) {
+}
+
+FolderSourceCache::~FolderSourceCache() {
+  if (!fFolders.empty())
+    BPrivate::BPathMonitor::StopWatching(BMessenger(this));
+  delete fNotifyRunner;
+}
+
+void FolderSourceCache::MessageReceived(BMessage *msg) {
+  switch (msg->what) {
+  case B_PATH_MONITOR: {
+    BString path;
+    if (msg->FindString("path", &path) == B_OK)
+      _Drop(path);
+    if (msg->FindString("from path", &path) == B_OK)
+      _Drop(path);
+    break;
+  }
+
+  default:
+    BHandler::MessageReceived(msg);
+  }
+}
+
+const std::vector<MediaItem> *
+FolderSourceCache::Find(const BString &folder) const {
+  auto it = fFolders.find(folder);
+  return it != fFolders.end() ? &it->second : nullptr;
+}
+
+void FolderSourceCache::Store(const BString &folder,
+                              const std::vector<MediaItem> &items) {
+  if (fFolders.find(folder) == fFolders.end()) {
+    status_t status = BPrivate::BPathMonitor::StartWatching(
+        folder.String(), kWatchFlags, BMessenger(this));
+    // Unwatched, it could go stale unnoticed.
+    if (status != B_OK) {
+      DEBUG_PRINT("FolderSourceCache: cannot watch %s: %s\n", folder.String(),
+                  strerror(status));
+      return;
+    }
+  }
+  fFolders[folder] = items;
+}
+
+/**
+ * @brief Forgets every stored folder that contains `path`.
+ */
+void FolderSourceCache::_Drop(const BString &path) {
+  bool dropped = false;
+  for (auto it = fFolders.begin(); it != fFolders.end();) {
+    const BString &folder = it->first;
+    if (path.StartsWith(folder) &&
+        (path.Length() == folder.Length() ||
+         path.ByteAt(folder.Length()) == '/')) {
+      DEBUG_PRINT("FolderSourceCache: %s changed\n", folder.String());
+      BPrivate::BPathMonitor::StopWatching(folder.String(), BMessenger(this));
+      it = fFolders.erase(it);
+      dropped = true;
+    } else {
+      ++it;
+    }
+  }
+  if (!dropped)
+    return;
+
+  delete fNotifyRunner;
+  BMessage changed(MSG_FOLDER_SOURCE_CHANGED);
+  fNotifyRunner = new BMessageRunner(fTarget, &changed, kNotifyDelay, 1);
+}
@@ -0,0 +1,50 @@
+#ifndef BETON_FOLDER_SOURCE_CACHE_H
+#define BETON_FOLDER_SOURCE_CACHE_H
+
+#include "MediaItem.h"
+
+#include <Handler.h>
+#include <Messenger.h>
+#include <String.h>
+#include <map>
+#include <vector>
+
+class BMessageRunner;
+
+/**
+ * @class FolderSourceCache
+ * @brief Remembers the items of folder sources outside the music library.
+ *
+ * Folders below a library source are answered from the library itself;
+ * any other folder has to be walked and its tags read, which this cache
+ * does once. Each stored folder is watched recursively with `BPathMonitor`,
+ * and the first change below it drops the folder; the target then gets a
+ * `MSG_FOLDER_SOURCE_CHANGED` once things have been quiet for
+ * `kNotifyDelay`, so a shown folder can be walked again.
+ *
+ * The handler is meant to be added to the main window.
+ */
+class FolderSourceCache : public BHandler {
+public:
+  static const bigtime_t kNotifyDelay = 750000;
+
+  explicit FolderSourceCache(const BMessenger &target);
+  ~FolderSourceCache() override;
+
+  void MessageReceived(BMessage *msg) override;
+
+  /** @brief Items stored for `folder`, or `nullptr`. */
+  const std::vector<MediaItem> *Find(const BString &folder) const;
+
+  /** @brief Stores the items of `folder` and starts watching it. */
+  void Store(const BString &folder, const std::vector<MediaItem> &items);
+
+private:
+  void _Drop(const BString &path);
+
+  BMessenger fTarget;
+  std::map<BString, std::vector<MediaItem>> fFolders;
+  BMessageRunner *fNotifyRunner;
+};
+
+#endif // BETON_FOLDER_SOURCE_CACHE_H
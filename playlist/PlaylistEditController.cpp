@@ -1,5 +1,4 @@
 #include "PlaylistEditController.h"
-#include <map>
 
 #include "MainWindow.h"
 #include "LibraryController.h"
@@ -11,6 +10,7 @@
 #include "PlaylistSidebarView.h"
 #include "PlaylistNameDialog.h"
 #include "SmartPlaylistGeneratorWindow.h"
+#include "SmartPlaylistManager.h"
 #include "Debug.h"
 #include "Messages.h"
 
@@ -22,7 +22,6 @@
 #include <Directory.h>
 #include <algorithm>
 #include <stack>
-#include <random>
 #include "Config.h"
 #include "PlaylistSelectionController.h"
 
@@ -227,6 +226,9 @@ void PlaylistEditController::RenamePlaylistFromPrompt(BMessage *msg) {
   BPath oldPath(dirPath.Path(), oldFile.String());
   BPath newPath(dirPath.Path(), newFile.String());
 
+  // A new or edited playlist may not be on disk yet.
+  fWindow->fPlaylistLibrary->FlushPlaylists();
+
   BEntry entry(oldPath.Path());
   if (entry.Exists() && entry.Rename(newPath.Path()) == B_OK) {
     DEBUG_PRINT("Playlist '%s' -> '%s' renamed\n",
@@ -300,9 +302,7 @@ void PlaylistEditController::MovePlaylistItem(BMessage *msg) {
     items.insert(items.begin() + newIndex, temp);
   }
 
-  cv->ClearEntries();
-  for (const auto &mi : items)
-    cv->AddEntry(mi);
+  cv->ApplyEntries(std::move(items));
 
   if (BRow *row = cv->RowAt(newIndex)) {
     cv->DeselectAll();
@@ -365,9 +365,7 @@ void PlaylistEditController::ReorderPlaylist(BMessage *msg) {
 
   cv->DeselectAll();
 
-  cv->ClearEntries();
-  for (const auto &mi : items)
-    cv->AddEntry(mi);
+  cv->ApplyEntries(std::move(items));
 
   cv->Invalidate();
   if (BView *scrollView = cv->ScrollView())
@@ -551,9 +549,7 @@ void PlaylistEditController::HandlePlaylistDrop(BMessage *msg) {
     items.insert(items.begin() + targetIndex, temp);
   }
 
-  cv->ClearEntries();
-  for (const auto &mi : items)
-    cv->AddEntry(mi);
+  cv->ApplyEntries(std::move(items));
 
   if (BRow *row = cv->RowAt(targetIndex)) {
     cv->DeselectAll();
@@ -651,100 +647,18 @@ void PlaylistEditController::GenerateSmartPlaylist(BMessage *msg) {
   bool shuffle = false;
   msg->FindBool("shuffle", &shuffle);
 
-  std::vector<BMessage> rules;
-  BMessage ruleMsg;
-  int32 i = 0;
-  while (msg->FindMessage("rule", i++, &ruleMsg) == B_OK)
-    rules.push_back(ruleMsg);
-
   int32 limitMode = 0;
   msg->FindInt32("limit_mode", &limitMode);
-  int32 limitValue = 0;
-  msg->FindInt32("limit_value", &limitValue);
-
-  std::vector<MediaItem> matches;
-  matches.reserve(fWindow->fAllItems.size());
-
-  for (const auto &item : fWindow->fAllItems) {
-    bool allRulesMatch = true;
-
-    for (const auto &r : rules) {
-      int32 type = 0;
-      r.FindInt32("type", &type);
-      BString val1;
-      r.FindString("val1", &val1);
-      BString val2;
-      r.FindString("val2", &val2);
-      bool exclude = false;
-      r.FindBool("exclude", &exclude);
-
-      bool currentRuleMatch = false;
-
-      if (type == 0) {
-        if (!val1.IsEmpty())
-          currentRuleMatch = (item.genre.ICompare(val1) == 0);
-      } else if (type == 1) {
-        if (!val1.IsEmpty())
-          currentRuleMatch = (item.artist.IFindFirst(val1) >= 0);
-      } else if (type == 2) {
-        int32 y1 = atoi(val1.String());
-        int32 y2 = atoi(val2.String());
-
-        bool inRange = true;
-        if (y1 > 0 && item.year < y1)
-          inRange = false;
-        if (y2 > 0 && item.year > y2)
-          inRange = false;
-        currentRuleMatch = inRange;
-      }
-
-      if (exclude) {
-        if (currentRuleMatch) {
-          allRulesMatch = false;
-          break;
-        }
-      } else if (!currentRuleMatch) {
-        allRulesMatch = false;
-        break;
-      }
-    }
-
-    if (allRulesMatch)
-      matches.push_back(item);
-  }
-
-  if (shuffle) {
-    std::random_device rd;
-    std::mt19937 g(rd());
-    std::shuffle(matches.begin(), matches.end(), g);
-  }
-
-  if (limitMode > 0 && !matches.empty()) {
-    if (limitMode == 1) {
-      if ((int32)matches.size() > limitValue)
-        matches.resize(limitValue);
-    } else if (limitMode == 2) {
-      int64 maxSeconds = (int64)limitValue * 60;
-      int64 currentSeconds = 0;
-      size_t cutIndex = matches.size();
-      for (size_t k = 0; k < matches.size(); ++k) {
-        currentSeconds += matches[k].duration;
-        if (currentSeconds > maxSeconds) {
-          cutIndex = k;
-          break;
-        }
-      }
-      if (cutIndex < matches.size())
-        matches.resize(cutIndex);
-    }
-  }
-
-  std::vector<BString> paths;
-  paths.reserve(matches.size());
-  for (const auto &m : matches)
-    paths.push_back(m.path);
+  bool live = true;
+  msg->FindBool("live", &live);
 
-  fWindow->fPlaylistLibrary->SavePlaylist(name, paths);
+  // Live playlists stay registered and follow library changes; a one-shot
+  // one is written the same way and then forgotten.
+  SmartPlaylistManager &smart = fWindow->fPlaylistLibrary->SmartPlaylists();
+  size_t count =
+      smart.Register(name, *msg, fWindow->fAllItems, &fWindow->fFacetIndex);
+  if (!live)
+    smart.Forget(name);
 
   BString statusMsg;
   statusMsg.SetToFormat(B_TRANSLATE("Playlist '%s' created"), name.String());
@@ -754,7 +668,7 @@ void PlaylistEditController::GenerateSmartPlaylist(BMessage *msg) {
     statusMsg << " " << B_TRANSLATE("(limited)");
 
   BString countStr;
-  countStr.SetToFormat(B_TRANSLATE(": %zu tracks."), matches.size());
+  countStr.SetToFormat(B_TRANSLATE(": %zu tracks."), count);
   statusMsg << countStr;
 
   fWindow->UpdateStatus(statusMsg);
@@ -786,17 +700,8 @@ void PlaylistEditController::DeleteSelectedPlaylistItems() {
       }
     }
 
-    for (const auto &path : removedPaths) {
-      for (int32 i = 0; i < cv->CountRows(); i++) {
-        const MediaItem *mi = cv->ItemAt(i);
-        if (mi && mi->path == path) {
-          BRow *r = cv->RowAt(i);
-          cv->RemoveRow(r);
-          delete r;
-          break;
-        }
-      }
-    }
+    for (const auto &path : removedPaths)
+      cv->RemoveEntry(path);
 
     std::vector<BString> remainingPaths;
     for (int32 i = 0; i < cv->CountRows(); i++) {
@@ -849,114 +754,16 @@ void PlaylistEditController::MoveSelectedItemsToTrash() {
     return;
   }
 
-  std::vector<BMessage> undoMsgs;
-  std::vector<BMessage> redoMsgs;
-
-  // 1. Save before paths of the playlist when the current source is a playlist.
-  std::vector<BString> beforePaths;
+  // One job moves the whole selection; the playlist, library and undo
+  // history are updated once it finished.
+  BMessage request(MSG_FILES_MOVE);
+  for (const auto &path : selectedPaths)
+    request.AddString("from", path);
+  request.AddString("directory", trashPath.Path());
+  request.AddBool("trash", true);
   if (updatesPlaylist)
-    beforePaths = fWindow->fPlaylistLibrary->LoadPlaylist(fWindow->fCurrentPlaylistName);
-
-  // 2. Move files to trash
-  for (const auto &path : selectedPaths) {
-    BEntry entry(path.String(), true);
-    if (!entry.Exists())
-      continue;
-
-    char leafName[B_FILE_NAME_LENGTH];
-    entry.GetName(leafName);
-
-    BPath targetTrashPath(trashPath.Path(), leafName);
-    BEntry testEntry(targetTrashPath.Path());
-    if (testEntry.Exists()) {
-      BString nameStr(leafName);
-      int32 extIdx = nameStr.FindLast('.');
-      BString base;
-      BString ext;
-      if (extIdx != B_ERROR) {
-        nameStr.CopyInto(base, 0, extIdx);
-        nameStr.CopyInto(ext, extIdx, nameStr.Length() - extIdx);
-      } else {
-        base = nameStr;
-      }
-      int32 counter = 1;
-      do {
-        BString newLeafName;
-        newLeafName << base << " " << counter << ext;
-        targetTrashPath.SetTo(trashPath.Path(), newLeafName.String());
-        testEntry.SetTo(targetTrashPath.Path());
-        counter++;
-      } while (testEntry.Exists());
-    }
-
-    BString uniqueTrashPath = targetTrashPath.Path();
-
-    // Build the file move message
-    BMessage moveMsg(MSG_FILE_MOVE);
-    moveMsg.AddString("from", path);
-    moveMsg.AddString("to", uniqueTrashPath);
-    moveMsg.AddBool("undo_replay", true); // prevent individual undo recording
-
-    // Execute the file move synchronously
-    fWindow->fLibraryController->HandleFileMove(&moveMsg);
-
-    // Record for Undo/Redo
-    BMessage u(MSG_FILE_MOVE);
-    u.AddString("from", uniqueTrashPath);
-    u.AddString("to", path);
-    undoMsgs.push_back(u);
-
-    BMessage r(MSG_FILE_MOVE);
-    r.AddString("from", path);
-    r.AddString("to", uniqueTrashPath);
-    redoMsgs.push_back(r);
-  }
-
-  if (updatesPlaylist) {
-    // 3. Compute after paths of the playlist (remove selected ones)
-    std::vector<BString> afterPaths;
-    for (const auto &p : beforePaths) {
-      if (std::find(selectedPaths.begin(), selectedPaths.end(), p) == selectedPaths.end()) {
-        afterPaths.push_back(p);
-      }
-    }
-
-    // Save the new playlist on disk
-    fWindow->fPlaylistLibrary->SavePlaylist(fWindow->fCurrentPlaylistName, afterPaths);
-
-    // Refresh the active ColumnView
-    int32 selected = fWindow->fPlaylistLibrary->View()->CurrentSelection();
-    if (selected >= 0) {
-      BMessage selMsg(MSG_PLAYLIST_SELECTION);
-      selMsg.AddInt32("index", selected);
-      selMsg.AddString("name", fWindow->fCurrentPlaylistName);
-      fWindow->fPlaylistSelectionController->HandlePlaylistSelection(&selMsg);
-    }
-
-    // 4. Record playlist changes
-    BMessage uPlaylist(MSG_RESTORE_PLAYLIST_PATHS);
-    uPlaylist.AddString("playlist", fWindow->fCurrentPlaylistName);
-    for (const auto &p : beforePaths) {
-      uPlaylist.AddString("paths", p);
-    }
-    undoMsgs.push_back(uPlaylist);
-
-    BMessage rPlaylist(MSG_RESTORE_PLAYLIST_PATHS);
-    rPlaylist.AddString("playlist", fWindow->fCurrentPlaylistName);
-    for (const auto &p : afterPaths) {
-      rPlaylist.AddString("paths", p);
-    }
-    redoMsgs.push_back(rPlaylist);
-  }
-
-  // 5. Register with UndoManager
-  if (fWindow->fUndoManager) {
-    fWindow->fUndoManager->RecordAction(undoMsgs, redoMsgs);
-  }
-
-  BString statusMsg;
-  statusMsg.SetToFormat(B_TRANSLATE("Moved %zu items to Trash."), selectedPaths.size());
-  fWindow->UpdateStatus(statusMsg);
+    request.AddString("playlist", fWindow->fCurrentPlaylistName);
+  fWindow->fLibraryController->HandleFilesMove(&request);
 }
 
 void PlaylistEditController::RestorePlaylistPaths(BMessage *msg) {
@@ -1076,118 +883,11 @@ void PlaylistEditController::MoveSelectedItemsTo(const entry_ref *targetDirRef)
     return;
   }
 
-  std::map<BString, BString> movedPathsMap;
-  std::vector<BMessage> undoMsgs;
-  std::vector<BMessage> redoMsgs;
-
-  // 1. Save before paths of the playlist when the current source is a playlist.
-  std::vector<BString> beforePaths;
+  BMessage request(MSG_FILES_MOVE);
+  for (const auto &path : selectedPaths)
+    request.AddString("from", path);
+  request.AddString("directory", targetDirPath.Path());
   if (updatesPlaylist)
-    beforePaths = fWindow->fPlaylistLibrary->LoadPlaylist(fWindow->fCurrentPlaylistName);
-
-  // 2. Move files to target directory
-  for (const auto &path : selectedPaths) {
-    BEntry entry(path.String(), true);
-    if (!entry.Exists())
-      continue;
-
-    char leafName[B_FILE_NAME_LENGTH];
-    entry.GetName(leafName);
-
-    BPath targetFilePath(targetDirPath.Path(), leafName);
-    BEntry testEntry(targetFilePath.Path());
-    if (testEntry.Exists()) {
-      BString nameStr(leafName);
-      int32 extIdx = nameStr.FindLast('.');
-      BString base;
-      BString ext;
-      if (extIdx != B_ERROR) {
-        nameStr.CopyInto(base, 0, extIdx);
-        nameStr.CopyInto(ext, extIdx, nameStr.Length() - extIdx);
-      } else {
-        base = nameStr;
-      }
-      int32 counter = 1;
-      do {
-        BString newLeafName;
-        newLeafName << base << " " << counter << ext;
-        targetFilePath.SetTo(targetDirPath.Path(), newLeafName.String());
-        testEntry.SetTo(targetFilePath.Path());
-        counter++;
-      } while (testEntry.Exists());
-    }
-
-    BString uniqueTargetPath = targetFilePath.Path();
-
-    // Build the file move message
-    BMessage moveMsg(MSG_FILE_MOVE);
-    moveMsg.AddString("from", path);
-    moveMsg.AddString("to", uniqueTargetPath);
-    moveMsg.AddBool("undo_replay", true); // prevent individual undo recording
-
-    // Execute the file move synchronously
-    fWindow->fLibraryController->HandleFileMove(&moveMsg);
-
-    // Record for Undo/Redo
-    BMessage u(MSG_FILE_MOVE);
-    u.AddString("from", uniqueTargetPath);
-    u.AddString("to", path);
-    undoMsgs.push_back(u);
-
-    BMessage r(MSG_FILE_MOVE);
-    r.AddString("from", path);
-    r.AddString("to", uniqueTargetPath);
-    redoMsgs.push_back(r);
-
-    movedPathsMap[path] = uniqueTargetPath;
-  }
-
-  if (updatesPlaylist) {
-    // 3. Compute after paths of the playlist (substitute paths)
-    std::vector<BString> afterPaths;
-    for (const auto &p : beforePaths) {
-      auto it = movedPathsMap.find(p);
-      if (it != movedPathsMap.end()) {
-        afterPaths.push_back(it->second);
-      } else {
-        afterPaths.push_back(p);
-      }
-    }
-
-    // Save the new playlist on disk
-    fWindow->fPlaylistLibrary->SavePlaylist(fWindow->fCurrentPlaylistName, afterPaths);
-
-    // Refresh the active ColumnView
-    int32 selected = fWindow->fPlaylistLibrary->View()->CurrentSelection();
-    if (selected >= 0) {
-      BMessage selMsg(MSG_PLAYLIST_SELECTION);
-      selMsg.AddInt32("index", selected);
-      selMsg.AddString("name", fWindow->fCurrentPlaylistName);
-      fWindow->fPlaylistSelectionController->HandlePlaylistSelection(&selMsg);
-    }
-
-    // 4. Record playlist changes
-    BMessage uPlaylist(MSG_RESTORE_PLAYLIST_PATHS);
-    uPlaylist.AddString("playlist", fWindow->fCurrentPlaylistName);
-    for (const auto &p : beforePaths) {
-      uPlaylist.AddString("paths", p);
-    }
-    undoMsgs.push_back(uPlaylist);
-
-    BMessage rPlaylist(MSG_RESTORE_PLAYLIST_PATHS);
-    rPlaylist.AddString("playlist", fWindow->fCurrentPlaylistName);
-    for (const auto &p : afterPaths) {
-      rPlaylist.AddString("paths", p);
-    }
-    redoMsgs.push_back(rPlaylist);
-  }
-
-  // 5. Register with UndoManager
-  if (fWindow->fUndoManager) {
-    fWindow->fUndoManager->RecordAction(undoMsgs, redoMsgs);
-  }
-
-  BString statusMsg;
-  statusMsg.SetToFormat(B_TRANSLATE("Moved %zu items to %s."), selectedPaths.size(), targetDirPath.Leaf());
-  fWindow->UpdateStatus(statusMsg);
+    request.AddString("playlist", fWindow->fCurrentPlaylistName);
+  fWindow->fLibraryController->HandleFilesMove(&request);
 }
@@ -1,12 +1,22 @@
 #include "PlaylistLibrary.h"
 #include "Debug.h"
+#include "Messages.h"
 #include "PlaylistSidebarView.h"
+#include "SmartPlaylistManager.h"
 #include <Directory.h>
 #include <Entry.h>
 #include <File.h>
 #include <FindDirectory.h>
+#include <MessageRunner.h>
 #include <Path.h>
+#include <algorithm>
 #include <stdio.h>
+#include <string.h>
+
+/// How long changes are collected before the playlists are written.
+static const bigtime_t kFlushDelay = 500000;
+/// Suffix of the file a playlist is written to before it replaces the old.
+static const char *kTempSuffix = ".tmp";
 
 static BString
 FolderLabelFromPath(const BString &path)
@@ -18,29 +28,32 @@ FolderLabelFromPath(const BString &path)
   return path;
 }
 
-PlaylistLibrary::PlaylistLibrary(BMessenger target) : fTarget(target) {
+PlaylistLibrary::PlaylistLibrary(BMessenger target)
+    : fTarget(target), fFlushRunner(nullptr) {
   fPlaylistView = new PlaylistSidebarView("playlist", fTarget, this);
+  fSmartPlaylists = new SmartPlaylistManager(this);
+  fSmartPlaylists->Load();
 }
 
-PlaylistLibrary::~PlaylistLibrary() {}
+PlaylistLibrary::~PlaylistLibrary() {
+  FlushPlaylists();
+  delete fSmartPlaylists;
+}
 
 PlaylistSidebarView *PlaylistLibrary::View() const { return fPlaylistView; }
 
 void PlaylistLibrary::LoadAvailablePlaylists() {
-  if (fPlaylistView->FindIndexByName("Radio") < 0)
-    fPlaylistView->AddItem("Radio", false, PlaylistItemKind::Radio);
-  if (fPlaylistView->FindIndexByName("DLNA") < 0)
-    fPlaylistView->AddItem("DLNA", false, PlaylistItemKind::DLNA);
-
-  BPath path;
-  if (find_directory(B_USER_SETTINGS_DIRECTORY, &path) != B_OK)
-    return;
+  BMessage files;
+  ListPlaylistFiles(fPlaylistBasePath, files);
+  AddAvailablePlaylists(files);
+}
 
-  if (fPlaylistBasePath.IsEmpty())
+void PlaylistLibrary::ListPlaylistFiles(const BString &folder,
+                                        BMessage &files) {
+  if (folder.IsEmpty())
     return;
-  path.SetTo(fPlaylistBasePath);
-  create_directory(path.Path(), 0777);
-  BDirectory dir(path.Path());
+  create_directory(folder.String(), 0777);
+  BDirectory dir(folder.String());
   if (dir.InitCheck() != B_OK)
     return;
 
@@ -51,11 +64,29 @@ void PlaylistLibrary::LoadAvailablePlaylists() {
       continue;
 
     BString name = filePath.Leaf();
+    if (name.EndsWith(kTempSuffix))
+      continue;
     if (name.EndsWith(".m3u"))
       name.Truncate(name.Length() - 4);
 
+    files.AddString("name", name);
+    files.AddString("path", filePath.Path());
+  }
+}
+
+void PlaylistLibrary::AddAvailablePlaylists(const BMessage &files) {
+  if (fPlaylistView->FindIndexByName("Radio") < 0)
+    fPlaylistView->AddItem("Radio", false, PlaylistItemKind::Radio);
+  if (fPlaylistView->FindIndexByName("DLNA") < 0)
+    fPlaylistView->AddItem("DLNA", false, PlaylistItemKind::DLNA);
+
+  BString name;
+  BString path;
+  for (int32 i = 0; files.FindString("name", i, &name) == B_OK &&
+                    files.FindString("path", i, &path) == B_OK;
+       i++) {
     if (fPlaylistView->FindIndexByName(name) < 0)
-      fPlaylistView->AddItem(name, filePath.Path());
+      fPlaylistView->AddItem(name, path);
   }
 
   for (auto &source : fFolderSources) {
@@ -81,79 +112,149 @@ void PlaylistLibrary::LoadAvailablePlaylists() {
 }
 
 /**
- * @brief Loads a playlist from disk.
+ * @brief Returns the tracks of a playlist.
  * @param name The name of the playlist (without extension).
  * @return std::vector<BString> List of file paths in the playlist.
  */
 std::vector<BString> PlaylistLibrary::LoadPlaylist(const BString &name) {
-  std::vector<BString> paths;
-  BPath dirPath;
-  if (find_directory(B_USER_SETTINGS_DIRECTORY, &dirPath) != B_OK)
-    return paths;
-
-  if (fPlaylistBasePath.IsEmpty())
-    return paths;
-  dirPath.SetTo(fPlaylistBasePath);
-  BString playlistFile = name;
-  playlistFile += ".m3u";
-  dirPath.Append(playlistFile.String());
-
-  BFile file(dirPath.Path(), B_READ_ONLY);
-  if (file.InitCheck() != B_OK)
-    return paths;
-
-  BString line;
-  char ch;
-  while (file.Read(&ch, 1) == 1) {
-    if (ch == '\n') {
-      line.Trim();
-      if (!line.IsEmpty() && !line.StartsWith("#")) {
-        paths.push_back(line);
-      }
-      line.Truncate(0);
-    } else {
-      line += ch;
-    }
-  }
-
-  return paths;
+  CachedPlaylist *playlist = _Cached(name);
+  if (playlist == nullptr)
+    return std::vector<BString>();
+  return playlist->paths;
 }
 
 /**
- * @brief Saves a playlist to disk.
+ * @brief Replaces the tracks of a playlist; the file is written shortly.
  * @param name The name of the playlist (without extension).
  * @param paths List of file paths to save.
  */
 void PlaylistLibrary::SavePlaylist(const BString &name,
                                    const std::vector<BString> &paths) {
-  BPath dirPath;
-  if (find_directory(B_USER_SETTINGS_DIRECTORY, &dirPath) != B_OK)
+  if (_PlaylistPath(name).InitCheck() != B_OK)
     return;
 
-  if (fPlaylistBasePath.IsEmpty())
-    return;
-  dirPath.SetTo(fPlaylistBasePath);
-  create_directory(dirPath.Path(), 0777);
+  CachedPlaylist &playlist = fPlaylists[name];
+  playlist.paths = paths;
+  _MarkDirty(name, playlist);
+}
+
+void PlaylistLibrary::FlushPlaylists() {
+  delete fFlushRunner;
+  fFlushRunner = nullptr;
 
+  for (auto &entry : fPlaylists) {
+    if (entry.second.dirty && !_Write(entry.first, entry.second))
+      DEBUG_PRINT("Could not save playlist '%s'\n", entry.first.String());
+  }
+}
+
+BPath PlaylistLibrary::_PlaylistPath(const BString &name) const {
+  if (fPlaylistBasePath.IsEmpty())
+    return BPath();
   BString fileName = name;
-  fileName.Append(".m3u");
-  BPath playlistPath(dirPath.Path(), fileName.String());
+  fileName += ".m3u";
+  return BPath(fPlaylistBasePath.String(), fileName.String());
+}
 
-  BFile file(playlistPath.Path(), B_WRITE_ONLY | B_CREATE_FILE | B_ERASE_FILE);
-  if (file.InitCheck() != B_OK)
-    return;
+/**
+ * @brief Returns playlist `name`, parsing its file if it was not read yet
+ * or was changed by something else since.
+ */
+PlaylistLibrary::CachedPlaylist *
+PlaylistLibrary::_Cached(const BString &name) {
+  BPath path = _PlaylistPath(name);
+  if (path.InitCheck() != B_OK)
+    return nullptr;
+
+  CachedPlaylist &playlist = fPlaylists[name];
+  if (playlist.dirty)
+    return &playlist;
+
+  BEntry entry(path.Path());
+  time_t modified = 0;
+  off_t size = 0;
+  if (entry.GetModificationTime(&modified) != B_OK ||
+      entry.GetSize(&size) != B_OK) {
+    playlist = CachedPlaylist();
+    return &playlist;
+  }
+  if (modified == playlist.modified && size == playlist.size)
+    return &playlist;
+
+  BFile file(&entry, B_READ_ONLY);
+  std::vector<char> data((size_t)size);
+  ssize_t length = file.InitCheck() == B_OK && size > 0
+                       ? file.Read(data.data(), data.size())
+                       : 0;
+  if (length < 0)
+    length = 0;
+
+  playlist.paths.clear();
+  const char *line = data.data();
+  const char *end = line + length;
+  while (line < end) {
+    const char *newline = (const char *)memchr(line, '\n', end - line);
+    const char *lineEnd = newline != nullptr ? newline : end;
+    BString path(line, lineEnd - line);
+    path.Trim();
+    if (!path.IsEmpty() && !path.StartsWith("#"))
+      playlist.paths.push_back(path);
+    line = lineEnd + 1;
+  }
+  playlist.appendable = length == 0 || data[length - 1] == '\n';
+  playlist.modified = modified;
+  playlist.size = size;
+  return &playlist;
+}
 
-  for (const auto &path : paths) {
-    file.Write(path.String(), path.Length());
-    file.Write("\n", 1);
+void PlaylistLibrary::_MarkDirty(const BString &name,
+                                 CachedPlaylist &playlist) {
+  playlist.dirty = true;
+  if (fFlushRunner == nullptr) {
+    BMessage flush(MSG_PLAYLIST_FLUSH);
+    fFlushRunner = new BMessageRunner(fTarget, &flush, kFlushDelay, 1);
   }
 
-  DEBUG_PRINT("Playlist '%s' saved (%zu entries)\n", name.String(),
-              paths.size());
+  if (fPlaylistView->FindIndexByName(name) < 0)
+    fPlaylistView->AddItem(name, _PlaylistPath(name).Path());
+}
+
+/**
+ * @brief Writes `playlist` next to its file and then moves it over it, so
+ * the file is never seen half written.
+ */
+bool PlaylistLibrary::_Write(const BString &name, CachedPlaylist &playlist) {
+  BPath path = _PlaylistPath(name);
+  if (path.InitCheck() != B_OK)
+    return false;
+  create_directory(fPlaylistBasePath.String(), 0777);
 
-  if (fPlaylistView->FindIndexByName(name) < 0) {
-    fPlaylistView->AddItem(name, playlistPath.Path());
+  BString data;
+  for (const auto &track : playlist.paths)
+    data << track << "\n";
+
+  BString tempPath = path.Path();
+  tempPath << kTempSuffix;
+  BFile file(tempPath.String(), B_WRITE_ONLY | B_CREATE_FILE | B_ERASE_FILE);
+  if (file.InitCheck() != B_OK)
+    return false;
+  bool written = file.Write(data.String(), data.Length()) == data.Length() &&
+                 file.Sync() == B_OK;
+  file.Unset();
+
+  BEntry temp(tempPath.String());
+  if (!written || temp.Rename(path.Path(), true) != B_OK) {
+    temp.Remove();
+    return false;
   }
+
+  playlist.dirty = false;
+  playlist.appendable = true;
+  temp.GetModificationTime(&playlist.modified);
+  temp.GetSize(&playlist.size);
+  DEBUG_PRINT("Playlist '%s' saved (%zu entries)\n", name.String(),
+              playlist.paths.size());
+  return true;
 }
 
 void PlaylistLibrary::AddPlaylistEntry(const BString &name,
@@ -287,6 +388,9 @@ void PlaylistLibrary::CreatePlaylistFile(const BString &name) {
 }
 
 void PlaylistLibrary::DeletePlaylist(const BString &name) {
+  fSmartPlaylists->Forget(name);
+  fPlaylists.erase(name);
+
   BPath dirPath;
   if (find_directory(B_USER_SETTINGS_DIRECTORY, &dirPath) != B_OK)
     return;
@@ -314,25 +418,54 @@ void PlaylistLibrary::AddItemToPlaylist(const BString &playlistName, const BStri
   DEBUG_PRINT("AddItemToPlaylist called: %s -> %s\n",
               path.String(), playlistName.String());
 
-  std::vector<BString> items = LoadPlaylist(playlistName);
-  for (const auto &item : items) {
+  CachedPlaylist *playlist = _Cached(playlistName);
+  if (playlist == nullptr)
+    return;
+  for (const auto &item : playlist->paths) {
     if (item.Compare(path) == 0) {
       DEBUG_PRINT("Path already exists, skipping\n");
       return;
     }
   }
 
-  items.push_back(path);
-  SavePlaylist(playlistName, items);
-  DEBUG_PRINT("Path added and saved\n");
+  playlist->paths.push_back(path);
+  if (playlist->dirty || !playlist->appendable) {
+    _MarkDirty(playlistName, *playlist);
+    return;
+  }
+
+  // The file holds everything before this track: just add its line.
+  BPath playlistPath = _PlaylistPath(playlistName);
+  BFile file(playlistPath.Path(), B_WRITE_ONLY | B_OPEN_AT_END);
+  BString line = path;
+  line << "\n";
+  if (file.InitCheck() != B_OK ||
+      file.Write(line.String(), line.Length()) != line.Length()) {
+    _MarkDirty(playlistName, *playlist);
+    return;
+  }
+  file.GetModificationTime(&playlist->modified);
+  file.GetSize(&playlist->size);
+  DEBUG_PRINT("Path appended\n");
 }
 
 void PlaylistLibrary::RenamePlaylist(const BString &oldName,
                                      const BString &newName) {
+  auto it = fPlaylists.find(oldName);
+  if (it != fPlaylists.end() && oldName != newName) {
+    fPlaylists[newName] = std::move(it->second);
+    fPlaylists.erase(oldName);
+  }
+  fSmartPlaylists->Rename(oldName, newName);
   fPlaylistView->RenameItem(oldName, newName);
 }
 
 void PlaylistLibrary::SetPlaylistFolderPath(const BString &path) {
+  if (path == fPlaylistBasePath)
+    return;
+  // Names refer to files of the old folder until here.
+  FlushPlaylists();
+  fPlaylists.clear();
   fPlaylistBasePath = path;
 }
 
@@ -347,17 +480,22 @@ void PlaylistLibrary::ReorderPlaylistItem(const BString &name, int32 fromIndex,
   if (fromIndex == toIndex)
     return;
 
-  std::vector<BString> paths = LoadPlaylist(name);
+  CachedPlaylist *playlist = _Cached(name);
+  if (playlist == nullptr)
+    return;
+  std::vector<BString> &paths = playlist->paths;
   if (fromIndex < 0 || fromIndex >= (int32)paths.size())
     return;
   if (toIndex < 0 || toIndex >= (int32)paths.size())
     return;
 
   // Move the item within the in-memory list.
-  BString item = paths[fromIndex];
-  paths.erase(paths.begin() + fromIndex);
-  paths.insert(paths.begin() + toIndex, item);
-
-  // Persist the updated order to disk.
-  SavePlaylist(name, paths);
+  if (fromIndex < toIndex)
+    std::rotate(paths.begin() + fromIndex, paths.begin() + fromIndex + 1,
+                paths.begin() + toIndex + 1);
+  else
+    std::rotate(paths.begin() + toIndex, paths.begin() + fromIndex,
+                paths.begin() + fromIndex + 1);
+
+  _MarkDirty(name, *playlist);
 }
@@ -3,11 +3,24 @@
 
 #include <Message.h>
 #include <Messenger.h>
+#include <Path.h>
 #include <String.h>
+#include <map>
 #include <vector>
 
+class BMessageRunner;
 class PlaylistSidebarView;
+class SmartPlaylistManager;
 
+/**
+ * @class PlaylistLibrary
+ * @brief The playlist sidebar's model and the store behind its .m3u files.
+ *
+ * A playlist is parsed once and then kept in memory. Changes are made to
+ * that copy and written back shortly after, replacing the file atomically,
+ * so a run of edits costs one write. Appending to a playlist whose file is
+ * up to date only appends a line to it.
+ */
 class PlaylistLibrary {
 public:
   PlaylistLibrary(BMessenger target);
@@ -15,10 +28,28 @@ public:
 
   PlaylistSidebarView *View() const;
 
+  /** @brief Generated playlists that follow library changes. */
+  SmartPlaylistManager &SmartPlaylists() const { return *fSmartPlaylists; }
+
   void LoadAvailablePlaylists();
+
+  /**
+   * @brief Lists the playlist files in `folder` as "name"/"path" pairs,
+   * creating the folder if needed. Any thread may call it.
+   */
+  static void ListPlaylistFiles(const BString &folder, BMessage &files);
+
+  /**
+   * @brief Adds the fixed entries, the files listed by ListPlaylistFiles()
+   * and the folder sources to the sidebar, skipping names already shown.
+   */
+  void AddAvailablePlaylists(const BMessage &files);
   std::vector<BString> LoadPlaylist(const BString &name);
   void SavePlaylist(const BString &name, const std::vector<BString> &paths);
 
+  /** @brief Writes every playlist changed since its last write. */
+  void FlushPlaylists();
+
   void AddPlaylistEntry(const BString &name, const BString &fullPath);
   int32 AddFolderSource(const BString &path, const BString &label = "");
   bool RemoveFolderSource(const BString &name);
@@ -42,9 +73,23 @@ public:
   int32 CountItems() const;
 
 private:
+  struct CachedPlaylist {
+    std::vector<BString> paths;
+    bool dirty = false;      ///< Not yet written to the file
+    bool appendable = false; ///< The file ends after a complete line
+    time_t modified = 0;     ///< File time and size when last read or
+    off_t size = 0;          ///< written, to notice outside edits
+  };
+
+  BPath _PlaylistPath(const BString &name) const;
+  CachedPlaylist *_Cached(const BString &name);
+  void _MarkDirty(const BString &name, CachedPlaylist &playlist);
+  bool _Write(const BString &name, CachedPlaylist &playlist);
+
   /** @name Data */
   ///@{
   PlaylistSidebarView *fPlaylistView;
+  SmartPlaylistManager *fSmartPlaylists;
   BMessenger fTarget;
   BString fPlaylistBasePath;
   struct FolderSource {
@@ -52,6 +97,8 @@ private:
     BString path;
   };
   std::vector<FolderSource> fFolderSources;
+  std::map<BString, CachedPlaylist> fPlaylists; ///< Parsed so far
+  BMessageRunner *fFlushRunner;
   ///@}
 };
 
@@ -2,6 +2,8 @@
 
 #include "MainWindow.h"
 #include "PlaylistEditController.h"
+#include "PlaylistLibrary.h"
+#include "PlaylistSelectionController.h"
 #include "Messages.h"
 
 #include <Message.h>
@@ -70,6 +72,16 @@ bool PlaylistMessageHandler::HandleMessage(BMessage *msg) {
     break;
   }
 
+  case MSG_PLAYLIST_FLUSH: {
+    fWindow->fPlaylistLibrary->FlushPlaylists();
+    break;
+  }
+
+  case MSG_FOLDER_SOURCE_CHANGED: {
+    fWindow->fPlaylistSelectionController->RefreshFolderSource();
+    break;
+  }
+
   case B_SIMPLE_DATA: {
     fWindow->fPlaylistEditController->HandlePlaylistDrop(msg);
     break;
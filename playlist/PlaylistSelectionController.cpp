@@ -4,6 +4,7 @@
 #include "AudioPlaybackEngine.h"
 #include "DLNAViewController.h"
 #include "Debug.h"
+#include "FolderSourceCache.h"
 #include "NowPlayingInfoPanel.h"
 #include "LibraryBrowserController.h"
 #include "MainWindow.h"
@@ -26,7 +27,20 @@
 #include <vector>
 
 PlaylistSelectionController::PlaylistSelectionController(MainWindow *window)
-    : fWindow(window) {}
+    : fWindow(window),
+      fFolderCache(new FolderSourceCache(BMessenger(window))) {
+  fWindow->AddHandler(fFolderCache);
+}
+
+PlaylistSelectionController::~PlaylistSelectionController() {
+  fWindow->RemoveHandler(fFolderCache);
+  delete fFolderCache;
+}
+
+void PlaylistSelectionController::RefreshFolderSource() {
+  if (fWindow->fIsFolderMode)
+    ShowFolderPlaylistSource(fWindow->fCurrentPlaylistName);
+}
 
 void PlaylistSelectionController::HandlePlaylistSelection(BMessage *msg) {
   if (!fWindow || !msg)
@@ -232,67 +246,83 @@ void PlaylistSelectionController::ShowFolderPlaylistSource(const BString &name)
 
   BString folderPath = fWindow->fPlaylistLibrary->FolderPathForName(name);
   std::vector<MediaItem> items;
-  std::vector<BString> paths;
 
-  BEntry entry(folderPath.String(), true);
-  entry_ref ref;
-  if (entry.InitCheck() == B_OK && entry.Exists() &&
-      entry.GetRef(&ref) == B_OK && fWindow->fPlaylistEditController) {
-    fWindow->fPlaylistEditController->ResolveRefRecursively(ref, paths);
-  }
-
-  items.reserve(paths.size());
-  for (const auto &path : paths) {
-    MediaItem item;
-    item.path = path;
-
-    BPath bpath(path.String());
-    BPath parentPath;
-    if (bpath.GetParent(&parentPath) == B_OK)
-      item.base = parentPath.Path();
-    else
-      item.base = folderPath;
-    item.title = bpath.Leaf() ? bpath.Leaf() : path.String();
-
-    struct stat st;
-    if (stat(path.String(), &st) == 0) {
-      item.size = st.st_size;
-      item.mtime = st.st_mtime;
-      item.inode = st.st_ino;
-    } else {
-      item.missing = true;
+  // The library already holds every file below its sources.
+  LibrarySnapshot *library = fWindow->fAllItems.Snapshot();
+  if (fWindow->fCacheLoaded && library != nullptr && !folderPath.IsEmpty() &&
+      !MusicSourceSettings::GetSourceForPath(folderPath).path.IsEmpty()) {
+    std::vector<uint32> positions;
+    library->FindBelow(folderPath, positions);
+    items.reserve(positions.size());
+    for (uint32 position : positions)
+      items.push_back(library->Items()[position]);
+  } else if (const std::vector<MediaItem> *cached =
+                 fFolderCache->Find(folderPath)) {
+    items = *cached;
+  } else {
+    std::vector<BString> paths;
+    BEntry entry(folderPath.String(), true);
+    entry_ref ref;
+    if (entry.InitCheck() == B_OK && entry.Exists() &&
+        entry.GetRef(&ref) == B_OK && fWindow->fPlaylistEditController) {
+      fWindow->fPlaylistEditController->ResolveRefRecursively(ref, paths);
     }
 
-    TagData td;
-    MetadataWriteTargets targets = MetadataTagIO::WriteTargetsForPath(path);
-    bool readOk = (!targets.tags && targets.bfs)
-        ? MetadataTagIO::ReadBfsAttributes(bpath, td)
-        : MetadataTagIO::ReadTags(bpath, td);
-    if (readOk) {
-      if (!td.title.IsEmpty())
-        item.title = td.title;
-      item.artist = td.artist;
-      item.album = td.album;
-      item.albumArtist = td.albumArtist;
-      item.composer = td.composer;
-      item.genre = td.genre;
-      item.comment = td.comment;
-      item.mbTrackId = td.mbTrackID;
-      item.mbAlbumId = td.mbAlbumID;
-      item.mbArtistId = td.mbArtistID;
-      item.year = td.year;
-      item.track = td.track;
-      item.trackTotal = td.trackTotal;
-      item.disc = td.disc;
-      item.discTotal = td.discTotal;
-      item.duration = td.lengthSec;
-      item.bitrate = td.bitrate;
-      item.sampleRate = td.sampleRate;
-      item.channels = td.channels;
-      item.rating = td.rating;
+    items.reserve(paths.size());
+    for (const auto &path : paths) {
+      MediaItem item;
+      item.path = path;
+
+      BPath bpath(path.String());
+      BPath parentPath;
+      if (bpath.GetParent(&parentPath) == B_OK)
+        item.base = parentPath.Path();
+      else
+        item.base = folderPath;
+      item.title = bpath.Leaf() ? bpath.Leaf() : path.String();
+
+      struct stat st;
+      if (stat(path.String(), &st) == 0) {
+        item.size = st.st_size;
+        item.mtime = st.st_mtime;
+        item.inode = st.st_ino;
+      } else {
+        item.missing = true;
+      }
+
+      TagData td;
+      MetadataWriteTargets targets = MetadataTagIO::WriteTargetsForPath(path);
+      bool readOk = (!targets.tags && targets.bfs)
+          ? MetadataTagIO::ReadBfsAttributes(bpath, td)
+          : MetadataTagIO::ReadTags(bpath, td);
+      if (readOk) {
+        if (!td.title.IsEmpty())
+          item.title = td.title;
+        item.artist = td.artist;
+        item.album = td.album;
+        item.albumArtist = td.albumArtist;
+        item.composer = td.composer;
+        item.genre = td.genre;
+        item.comment = td.comment;
+        item.mbTrackId = td.mbTrackID;
+        item.mbAlbumId = td.mbAlbumID;
+        item.mbArtistId = td.mbArtistID;
+        item.year = td.year;
+        item.track = td.track;
+        item.trackTotal = td.trackTotal;
+        item.disc = td.disc;
+        item.discTotal = td.discTotal;
+        item.duration = td.lengthSec;
+        item.bitrate = td.bitrate;
+        item.sampleRate = td.sampleRate;
+        item.channels = td.channels;
+        item.rating = td.rating;
+      }
+
+      items.push_back(item);
     }
 
-    items.push_back(item);
+    fFolderCache->Store(folderPath, items);
   }
 
   fWindow->fLibraryManager->SetActiveItems(items);
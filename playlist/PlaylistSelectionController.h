@@ -5,27 +5,33 @@
 
 class BMessage;
 class BString;
+class FolderSourceCache;
 class MainWindow;
 
 class PlaylistSelectionController {
 public:
   explicit PlaylistSelectionController(MainWindow *window);
+  ~PlaylistSelectionController();
 
   void HandlePlaylistSelection(BMessage *msg);
   void ResetAndHideFilters();
+  void ShowSelectedPlaylistSource(const BString &name);
+
+  /** @brief Shows the selected folder source again if it is on display. */
+  void RefreshFolderSource();
 
 private:
   void RestoreInitialPlaylistSelection();
   PlaylistItemKind PlaylistKindFromSelection(BMessage *msg,
                                              const BString &name) const;
   void ApplyPlaylistFilterVisibility();
-  void ShowSelectedPlaylistSource(const BString &name);
   void ShowRadioPlaylistSource();
   void ShowLibraryPlaylistSource();
   void ShowRegularPlaylistSource(const BString &name);
   void ShowFolderPlaylistSource(const BString &name);
 
   MainWindow *fWindow;
+  FolderSourceCache *fFolderCache; ///< Folders outside the library
 };
 
 #endif // BETON_PLAYLIST_SELECTION_CONTROLLER_H
@@ -1,5 +1,6 @@
 #include "PlaylistSidebarView.h"
 #include "Debug.h"
+#include "IconCache.h"
 #include "Messages.h"
 #include "PlaylistNameDialog.h"
 #include "PlaylistLibrary.h"
@@ -9,11 +10,9 @@
 #include <Directory.h>
 #include <Entry.h>
 #include <FindDirectory.h>
-#include <IconUtils.h>
 #include <InterfaceDefs.h>
 #include <MenuItem.h>
 #include <Path.h>
-#include <Resources.h>
 #include <String.h>
 #include <TextControl.h>
 #include <algorithm>
@@ -30,30 +29,6 @@ static constexpr int32 ICON_RADIO_ID = 1003;
 static constexpr int32 ICON_DLNA_ID = 1004;
 static constexpr int32 ICON_FOLDER_ID = 1006;
 
-static BBitmap *LoadVectorIconFromResourceID(int32 id, float size) {
-  if (!be_app || !be_app->AppResources())
-    return nullptr;
-
-  size_t len = 0;
-  const void *data =
-      be_app->AppResources()->LoadResource(B_VECTOR_ICON_TYPE, id, &len);
-  if (!data || len == 0) {
-    DEBUG_PRINT("Icon ID %ld not found\n", (long)id);
-    return nullptr;
-  }
-
-  BRect r(0, 0, size - 1, size - 1);
-  auto *bmp = new BBitmap(r, 0, B_RGBA32);
-  if (BIconUtils::GetVectorIcon(static_cast<const uint8 *>(data), len, bmp) !=
-      B_OK) {
-    delete bmp;
-    DEBUG_PRINT("Icon ID %ld: decoding failed\n",
-            (long)id);
-    return nullptr;
-  }
-  return bmp;
-}
-
 static float BaselineForRow(BView *v, const BRect &rowRect) {
   font_height fh;
   v->GetFontHeight(&fh);
@@ -443,31 +418,27 @@ void PlaylistSidebarView::SetHoverIndex(int32 idx) {
 }
 
 void PlaylistSidebarView::_EnsureIconsLoaded() const {
-  if (!fIconLibrary) {
-    float rowH = const_cast<PlaylistSidebarView *>(this)->LineHeight();
-    fIconSize = rowH * 0.7f;
-    fIconLibrary = LoadVectorIconFromResourceID(ICON_LIB_ID, fIconSize);
-  }
-  if (!fIconPlaylist)
-    fIconPlaylist = LoadVectorIconFromResourceID(ICON_PL_ID, fIconSize);
-  if (!fIconFolder) {
-    fIconFolder = LoadVectorIconFromResourceID(ICON_FOLDER_ID, fIconSize);
-    if (!fIconFolder)
-      fIconFolder = fIconPlaylist;
-  }
-  if (!fIconRadio) {
-    fIconRadio = LoadVectorIconFromResourceID(ICON_RADIO_ID, fIconSize);
-    if (!fIconRadio)
-      fIconRadio = fIconPlaylist;
-  }
-  if (!fIconDlna) {
-    fIconDlna = LoadVectorIconFromResourceID(ICON_DLNA_ID, fIconSize);
-    if (!fIconDlna)
-      fIconDlna = fIconRadio;
-  }
+  if (fIconsLoaded)
+    return;
+  fIconsLoaded = true;
+  float rowH = const_cast<PlaylistSidebarView *>(this)->LineHeight();
+  fIconSize = rowH * 0.7f;
+
+  IconCache &cache = IconCache::Default();
+  fIconLibrary = cache.Get(ICON_LIB_ID, fIconSize);
+  fIconPlaylist = cache.Get(ICON_PL_ID, fIconSize);
+  fIconFolder = cache.Get(ICON_FOLDER_ID, fIconSize);
+  if (!fIconFolder)
+    fIconFolder = fIconPlaylist;
+  fIconRadio = cache.Get(ICON_RADIO_ID, fIconSize);
+  if (!fIconRadio)
+    fIconRadio = fIconPlaylist;
+  fIconDlna = cache.Get(ICON_DLNA_ID, fIconSize);
+  if (!fIconDlna)
+    fIconDlna = fIconRadio;
 }
 
-BBitmap *PlaylistSidebarView::_IconFor(PlaylistItemKind kind) const {
+const BBitmap *PlaylistSidebarView::_IconFor(PlaylistItemKind kind) const {
   _EnsureIconsLoaded();
   switch (kind) {
   case PlaylistItemKind::Library:
@@ -565,7 +536,7 @@ void PlaylistSidebarView::Draw(BRect updateRect) {
         rowRect.top + floorf((rowRect.Height() + 1 - fIconSize) / 2.0f);
 
     if ((size_t)i < fRows.size()) {
-      if (BBitmap *icon = _IconFor(fRows[i].kind)) {
+      if (const BBitmap *icon = _IconFor(fRows[i].kind)) {
 
         SetDrawingMode(B_OP_ALPHA);
         SetBlendingMode(B_PIXEL_ALPHA, B_ALPHA_OVERLAY);
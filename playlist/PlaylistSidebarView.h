@@ -67,7 +67,7 @@ private:
   void SetHoverIndex(int32 idx);
 
   void _EnsureIconsLoaded() const;
-  BBitmap *_IconFor(PlaylistItemKind kind) const;
+  const BBitmap *_IconFor(PlaylistItemKind kind) const;
 
   int32 _FirstPlaylistIndex() const;
   void _ReorderItem(int32 from, int32 to);
@@ -85,11 +85,13 @@ private:
   BPoint fDragStartPoint;
   bool fIsDragging{false};
 
-  mutable BBitmap *fIconLibrary = nullptr;
-  mutable BBitmap *fIconPlaylist = nullptr;
-  mutable BBitmap *fIconFolder = nullptr;
-  mutable BBitmap *fIconRadio = nullptr;
-  mutable BBitmap *fIconDlna = nullptr;
+  /// Shared bitmaps owned by the IconCache
+  mutable const BBitmap *fIconLibrary = nullptr;
+  mutable const BBitmap *fIconPlaylist = nullptr;
+  mutable const BBitmap *fIconFolder = nullptr;
+  mutable const BBitmap *fIconRadio = nullptr;
+  mutable const BBitmap *fIconDlna = nullptr;
+  mutable bool fIconsLoaded = false;
 
   mutable float fIconSize = 16.0f;
   float fIconPadX = 6.0f;
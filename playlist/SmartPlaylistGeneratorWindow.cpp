@@ -1,5 +1,6 @@
 #include "SmartPlaylistGeneratorWindow.h"
 #include "Messages.h"
+#include "SmartPlaylistRules.h"
 
 #include <Button.h>
 #include <CardLayout.h>
@@ -40,12 +41,31 @@ BString Rule::ToString() const {
   if (exclude)
     s << B_TRANSLATE("NOT ");
 
-  if (type == 0)
+  switch (type) {
+  case SmartPlaylistRules::kGenre:
     s << B_TRANSLATE("Genre: ") << value;
-  else if (type == 1)
+    break;
+  case SmartPlaylistRules::kArtist:
     s << B_TRANSLATE("Artist: ") << value;
-  else if (type == 2)
+    break;
+  case SmartPlaylistRules::kYear:
     s << B_TRANSLATE("Year: ") << value << " - " << value2;
+    break;
+  case SmartPlaylistRules::kRating:
+    s << B_TRANSLATE("Rating: ") << value << " - " << value2;
+    break;
+  case SmartPlaylistRules::kBitrate:
+    s << B_TRANSLATE("Bitrate: ") << value << " - " << value2
+      << B_TRANSLATE(" kbit/s");
+    break;
+  case SmartPlaylistRules::kChanged: {
+    BString text;
+    text.SetToFormat(B_TRANSLATE("Changed in the last %s days"),
+                     value.String());
+    s << text;
+    break;
+  }
+  }
 
   return s;
 }
@@ -107,6 +127,12 @@ void SmartPlaylistGeneratorWindow::_BuildUI(const std::vector<BString> &genres)
       new BMenuItem(B_TRANSLATE("Artist"), new BMessage(MSG_TYPE_CHANGED)));
   typeMenu->AddItem(
       new BMenuItem(B_TRANSLATE("Year"), new BMessage(MSG_TYPE_CHANGED)));
+  typeMenu->AddItem(new BMenuItem(B_TRANSLATE("Rating (1-10)"),
+                                  new BMessage(MSG_TYPE_CHANGED)));
+  typeMenu->AddItem(new BMenuItem(B_TRANSLATE("Bitrate (kbit/s)"),
+                                  new BMessage(MSG_TYPE_CHANGED)));
+  typeMenu->AddItem(new BMenuItem(B_TRANSLATE("Recently changed"),
+                                  new BMessage(MSG_TYPE_CHANGED)));
   typeMenu->ItemAt(0)->SetMarked(true);
   typeMenu->SetTargetForItems(this);
 
@@ -152,13 +178,22 @@ void SmartPlaylistGeneratorWindow::_BuildUI(const std::vector<BString> &genres)
   }
 
   {
-    BGroupView *yearGroup = new BGroupView(B_HORIZONTAL, B_USE_DEFAULT_SPACING);
-    fYearFromInput =
-        new BTextControl("YearFrom", B_TRANSLATE("From:"), "", nullptr);
-    fYearToInput = new BTextControl("YearTo", B_TRANSLATE("To:"), "", nullptr);
-    yearGroup->AddChild(fYearFromInput);
-    yearGroup->AddChild(fYearToInput);
-    fInputCardLayout->AddView(yearGroup);
+    BGroupView *rangeGroup =
+        new BGroupView(B_HORIZONTAL, B_USE_DEFAULT_SPACING);
+    fRangeFromInput =
+        new BTextControl("RangeFrom", B_TRANSLATE("From:"), "", nullptr);
+    fRangeToInput =
+        new BTextControl("RangeTo", B_TRANSLATE("To:"), "", nullptr);
+    rangeGroup->AddChild(fRangeFromInput);
+    rangeGroup->AddChild(fRangeToInput);
+    fInputCardLayout->AddView(rangeGroup);
+  }
+
+  {
+    BGroupView *daysGroup = new BGroupView(B_HORIZONTAL, B_USE_DEFAULT_SPACING);
+    fDaysInput = new BTextControl("Days", B_TRANSLATE("Days:"), "30", nullptr);
+    daysGroup->AddChild(fDaysInput);
+    fInputCardLayout->AddView(daysGroup);
   }
 
   fInputCardLayout->SetVisibleItem((int32)0);
@@ -188,6 +223,9 @@ void SmartPlaylistGeneratorWindow::_BuildUI(const std::vector<BString> &genres)
 
   fShuffleCheck =
       new BCheckBox("Shuffle", B_TRANSLATE("Shuffle Playback"), nullptr);
+  fLiveCheck =
+      new BCheckBox("Live", B_TRANSLATE("Keep up to date"), nullptr);
+  fLiveCheck->SetValue(B_CONTROL_ON);
 
   fGenerateBtn = new BButton("Generate", B_TRANSLATE("Generate"),
                              new BMessage(MSG_GEN_GENERATE));
@@ -234,7 +272,11 @@ void SmartPlaylistGeneratorWindow::_BuildUI(const std::vector<BString> &genres)
       .Add(fLimitValue)
       .End()
 
+      .AddGroup(B_HORIZONTAL, B_USE_DEFAULT_SPACING)
       .Add(fShuffleCheck)
+      .Add(fLiveCheck)
+      .AddGlue()
+      .End()
 
       .Add(new BSeparatorView(B_HORIZONTAL))
 
@@ -257,12 +299,25 @@ void SmartPlaylistGeneratorWindow::_UpdateInputFields() {
 
   BMenuItem *marked = fTypeField->Menu()->FindMarked();
   int32 type = marked ? fTypeField->Menu()->IndexOf(marked) : 0;
-  if (type < 0)
-    type = 0;
-  if (type > 2)
-    type = 2;
 
-  fInputCardLayout->SetVisibleItem(type);
+  // Cards: genre menu, text, from/to range, days.
+  int32 card = 0;
+  switch (type) {
+  case SmartPlaylistRules::kArtist:
+    card = 1;
+    break;
+  case SmartPlaylistRules::kYear:
+  case SmartPlaylistRules::kRating:
+  case SmartPlaylistRules::kBitrate:
+    card = 2;
+    break;
+  case SmartPlaylistRules::kChanged:
+    card = 3;
+    break;
+  default:
+    break;
+  }
+  fInputCardLayout->SetVisibleItem(card);
 }
 
 /**
@@ -273,19 +328,23 @@ void SmartPlaylistGeneratorWindow::_AddRule() {
   r.type = fTypeField->Menu()->IndexOf(fTypeField->Menu()->FindMarked());
   r.exclude = (fExcludeCheck->Value() == B_CONTROL_ON);
 
-  if (r.type == 0) {
+  if (r.type == SmartPlaylistRules::kGenre) {
     BMenuItem *item = fGenreSelect->Menu()->FindMarked();
     if (!item)
       return;
     r.value = item->Label();
-  } else if (r.type == 1) {
+  } else if (r.type == SmartPlaylistRules::kArtist) {
     r.value = fArtistInput->Text();
     if (r.value.IsEmpty())
       return;
+  } else if (r.type == SmartPlaylistRules::kChanged) {
+    r.value = fDaysInput->Text();
+    if (atoi(r.value.String()) <= 0)
+      return;
   } else {
-    r.value = fYearFromInput->Text();
-    r.value2 = fYearToInput->Text();
-    if (r.value.IsEmpty())
+    r.value = fRangeFromInput->Text();
+    r.value2 = fRangeToInput->Text();
+    if (r.value.IsEmpty() && r.value2.IsEmpty())
       return;
   }
 
@@ -351,6 +410,7 @@ void SmartPlaylistGeneratorWindow::MessageReceived(BMessage *msg) {
     }
 
     genMsg.AddBool("shuffle", fShuffleCheck->Value() == B_CONTROL_ON);
+    genMsg.AddBool("live", fLiveCheck->Value() == B_CONTROL_ON);
 
     fTarget.SendMessage(&genMsg);
     Quit();
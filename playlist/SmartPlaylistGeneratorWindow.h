@@ -21,9 +21,9 @@ class BCardLayout;
  * @brief Represents a single filtering rule for playlist generation.
  */
 struct Rule {
-  int32 type;     ///< 0=Genre, 1=Artist, 2=Year.
-  BString value;  ///< Primary search value (e.g. "Rock", "Metallica", "1990").
-  BString value2; ///< Secondary value (e.g. "2000" for year range).
+  int32 type;     ///< A SmartPlaylistRules::Type.
+  BString value;  ///< Primary value (e.g. "Rock", "Metallica", "1990", days).
+  BString value2; ///< Upper bound of a range (e.g. "2000" for years).
   bool exclude;   ///< If true, the rule is negated (NOT).
 
   /**
@@ -37,7 +37,9 @@ struct Rule {
  * @brief Window for creating playlists from rule-based criteria.
  *
  * Allows the user to define rules (positive or negative) based on Genre,
- * Artist, or Year, and specify optional limits and shuffle mode.
+ * Artist, Year, Rating, Bitrate or recent changes, and specify optional
+ * limits and shuffle mode. A playlist kept up to date is registered with
+ * the SmartPlaylistManager and follows later library changes.
  */
 class SmartPlaylistGeneratorWindow : public BWindow {
 public:
@@ -72,11 +74,13 @@ private:
 
   BCardLayout *fInputCardLayout;
   BTextControl *fArtistInput;
-  BTextControl *fYearFromInput;
-  BTextControl *fYearToInput;
+  BTextControl *fRangeFromInput; ///< Year, rating or bitrate
+  BTextControl *fRangeToInput;
+  BTextControl *fDaysInput;
   BMenuField *fGenreSelect;
   BCheckBox *fExcludeCheck;
   BCheckBox *fShuffleCheck;
+  BCheckBox *fLiveCheck; ///< Register with the SmartPlaylistManager
   BButton *fAddRuleBtn;
   ///@}
 
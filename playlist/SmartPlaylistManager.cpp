@@ -0,0 +1,278 @@
+#include "SmartPlaylistManager.h"
+
+#include "Debug.h"
+#include "LibrarySnapshot.h"
+#include "MediaItem.h"
+#include "PlaylistLibrary.h"
+#include "SmartPlaylistRules.h"
+
+#include <File.h>
+#include <FindDirectory.h>
+#include <OS.h>
+#include <Path.h>
+
+#include <map>
+#include <set>
+
+/**
+ * @brief Returns the path of the smart playlist definitions.
+ */
+static BString DefinitionsPath() {
+  BPath settingsPath;
+  find_directory(B_USER_SETTINGS_DIRECTORY, &settingsPath);
+  settingsPath.Append("BeTon/smart_playlists.settings");
+  return BString(settingsPath.Path());
+}
+
+namespace {
+
+/** @brief One match of a playlist, at its place in the ranking. */
+struct Member {
+  uint64 rank;
+  BString path;
+  int32 duration;
+};
+
+struct MemberOrder {
+  bool operator()(const Member &a, const Member &b) const {
+    if (a.rank != b.rank)
+      return a.rank < b.rank;
+    return a.path < b.path;
+  }
+};
+
+} // namespace
+
+struct SmartPlaylistManager::Playlist {
+  BString name;
+  BMessage request; ///< The generator's MSG_GENERATE_PLAYLIST
+  uint32 seed = 0;  ///< Shuffle order
+  SmartPlaylistRules rules;
+  bool shuffle = false;
+  int32 limitMode = 0; ///< 0 none, 1 tracks, 2 minutes
+  int32 limitValue = 0;
+
+  std::set<Member, MemberOrder> ranked;
+  std::map<BString, int32> durations; ///< Matches by path
+  std::vector<BString> selected;      ///< What the file holds
+  bool dirty = false;
+
+  void Compile() {
+    rules.Compile(request, (int64)real_time());
+    shuffle = request.GetBool("shuffle", false);
+    limitMode = request.GetInt32("limit_mode", 0);
+    limitValue = request.GetInt32("limit_value", 0);
+  }
+
+  /** @brief Sort key of `path`: 0 in path order, a seeded hash shuffled. */
+  uint64 Rank(const BString &path) const {
+    if (!shuffle)
+      return 0;
+    uint64 hash = 14695981039346656037ULL ^ seed;
+    for (const char *c = path.String(); *c != '\0'; c++) {
+      hash ^= (uint8)*c;
+      hash *= 1099511628211ULL;
+    }
+    // FNV leaves similar paths close together; spread them.
+    hash ^= hash >> 31;
+    hash *= 0x7fb5d329728ea185ULL;
+    hash ^= hash >> 27;
+    return hash;
+  }
+
+  void Fill(const LibraryItems &items, const LibraryFacetIndex *facets) {
+    ranked.clear();
+    durations.clear();
+    std::vector<uint32> positions;
+    rules.Filter(items, facets, positions);
+    for (uint32 position : positions) {
+      const MediaItem &item = items[position];
+      ranked.insert({Rank(item.path), item.path, item.duration});
+      durations[item.path] = item.duration;
+    }
+    dirty = true;
+  }
+
+  void Update(const MediaItem &item) {
+    const bool match = rules.Matches(item);
+    auto it = durations.find(item.path);
+    if (it == durations.end()) {
+      if (!match)
+        return;
+      ranked.insert({Rank(item.path), item.path, item.duration});
+      durations[item.path] = item.duration;
+      dirty = true;
+    } else if (!match) {
+      Remove(item.path);
+    } else if (it->second != item.duration) {
+      const uint64 rank = Rank(item.path);
+      ranked.erase({rank, item.path, 0});
+      ranked.insert({rank, item.path, item.duration});
+      it->second = item.duration;
+      // Only a duration limit depends on it.
+      if (limitMode == 2)
+        dirty = true;
+    }
+  }
+
+  void Remove(const BString &path) {
+    if (durations.erase(path) == 0)
+      return;
+    ranked.erase({Rank(path), path, 0});
+    dirty = true;
+  }
+
+  /** @brief The head of the ranking within the limit. */
+  std::vector<BString> Select() const {
+    std::vector<BString> paths;
+    const int64 maxSeconds = (int64)limitValue * 60;
+    int64 seconds = 0;
+    for (const Member &member : ranked) {
+      if (limitMode == 1 && (int32)paths.size() >= limitValue)
+        break;
+      if (limitMode == 2) {
+        seconds += member.duration;
+        if (seconds > maxSeconds)
+          break;
+      }
+      paths.push_back(member.path);
+    }
+    return paths;
+  }
+};
+
+SmartPlaylistManager::SmartPlaylistManager(PlaylistLibrary *library)
+    : fLibrary(library), fReady(false) {}
+
+SmartPlaylistManager::~SmartPlaylistManager() {}
+
+void SmartPlaylistManager::Load() {
+  fPlaylists.clear();
+  fReady = false;
+
+  BFile file(DefinitionsPath().String(), B_READ_ONLY);
+  BMessage archive;
+  if (file.InitCheck() != B_OK || archive.Unflatten(&file) != B_OK)
+    return;
+
+  BMessage entry;
+  for (int32 i = 0; archive.FindMessage("playlist", i, &entry) == B_OK; i++) {
+    std::unique_ptr<Playlist> playlist(new Playlist);
+    playlist->name = entry.GetString("name", "");
+    playlist->seed = (uint32)entry.GetInt32("seed", 0);
+    if (playlist->name.IsEmpty() ||
+        entry.FindMessage("request", &playlist->request) != B_OK)
+      continue;
+    playlist->Compile();
+    fPlaylists.push_back(std::move(playlist));
+  }
+  DEBUG_PRINT("[SmartPlaylists] %zu registered\n", fPlaylists.size());
+}
+
+size_t SmartPlaylistManager::Register(const BString &name,
+                                      const BMessage &request,
+                                      const LibraryItems &items,
+                                      const LibraryFacetIndex *facets) {
+  Playlist *playlist = _Find(name);
+  if (playlist == nullptr) {
+    fPlaylists.emplace_back(new Playlist);
+    playlist = fPlaylists.back().get();
+    playlist->name = name;
+  }
+  playlist->request = request;
+  playlist->seed = (uint32)system_time();
+  playlist->Compile();
+  playlist->Fill(items, facets);
+  // Written even if empty, so the playlist appears.
+  playlist->dirty = false;
+  playlist->selected = playlist->Select();
+  fLibrary->SavePlaylist(name, playlist->selected);
+  _Save();
+  return playlist->selected.size();
+}
+
+void SmartPlaylistManager::Forget(const BString &name) {
+  for (auto it = fPlaylists.begin(); it != fPlaylists.end(); ++it) {
+    if ((*it)->name == name) {
+      fPlaylists.erase(it);
+      _Save();
+      return;
+    }
+  }
+}
+
+void SmartPlaylistManager::Rename(const BString &oldName,
+                                  const BString &newName) {
+  if (oldName == newName)
+    return;
+  if (Playlist *playlist = _Find(oldName)) {
+    Forget(newName);
+    playlist->name = newName;
+    _Save();
+  }
+}
+
+void SmartPlaylistManager::Rebuild(const LibraryItems &items,
+                                   const LibraryFacetIndex *facets) {
+  for (auto &playlist : fPlaylists) {
+    // "Changed in the last N days" counts from now.
+    playlist->Compile();
+    playlist->Fill(items, facets);
+    playlist->selected = fLibrary->LoadPlaylist(playlist->name);
+  }
+  fReady = true;
+}
+
+void SmartPlaylistManager::ItemChanged(const MediaItem &item) {
+  if (!fReady)
+    return;
+  for (auto &playlist : fPlaylists)
+    playlist->Update(item);
+}
+
+void SmartPlaylistManager::ItemRemoved(const BString &path) {
+  if (!fReady)
+    return;
+  for (auto &playlist : fPlaylists)
+    playlist->Remove(path);
+}
+
+void SmartPlaylistManager::Flush(std::vector<BString> *changed) {
+  for (auto &playlist : fPlaylists) {
+    if (!playlist->dirty)
+      continue;
+    playlist->dirty = false;
+    std::vector<BString> selected = playlist->Select();
+    if (selected == playlist->selected)
+      continue;
+    playlist->selected.swap(selected);
+    fLibrary->SavePlaylist(playlist->name, playlist->selected);
+    if (changed)
+      changed->push_back(playlist->name);
+  }
+}
+
+SmartPlaylistManager::Playlist *
+SmartPlaylistManager::_Find(const BString &name) const {
+  for (const auto &playlist : fPlaylists) {
+    if (playlist->name == name)
+      return playlist.get();
+  }
+  return nullptr;
+}
+
+void SmartPlaylistManager::_Save() const {
+  BMessage archive;
+  for (const auto &playlist : fPlaylists) {
+    BMessage entry;
+    entry.AddString("name", playlist->name);
+    entry.AddInt32("seed", (int32)playlist->seed);
+    entry.AddMessage("request", &playlist->request);
+    archive.AddMessage("playlist", &entry);
+  }
+
+  BFile file(DefinitionsPath().String(),
+             B_WRITE_ONLY | B_CREATE_FILE | B_ERASE_FILE);
+  if (file.InitCheck() != B_OK || archive.Flatten(&file) != B_OK)
+    DEBUG_PRINT("[SmartPlaylists] could not save definitions\n");
+}
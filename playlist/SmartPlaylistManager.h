@@ -0,0 +1,84 @@
+#ifndef BETON_SMART_PLAYLIST_MANAGER_H
+#define BETON_SMART_PLAYLIST_MANAGER_H
+
+#include <Message.h>
+#include <String.h>
+#include <SupportDefs.h>
+
+#include <memory>
+#include <vector>
+
+struct MediaItem;
+class LibraryFacetIndex;
+class LibraryItems;
+class PlaylistLibrary;
+
+/**
+ * @class SmartPlaylistManager
+ * @brief Keeps generated playlists up to date as the library changes.
+ *
+ * Every playlist made by the smart playlist generator is registered here
+ * with its request (rules, limit, shuffle), which is stored in
+ * ~/config/settings/BeTon/smart_playlists.settings. Rebuild() matches the
+ * whole library once after the cache loaded; from then on ItemChanged() and
+ * ItemRemoved() test only the items that changed against each playlist's
+ * compiled SmartPlaylistRules.
+ *
+ * The matches of a playlist are kept ranked: by path, or by a hash of the
+ * path seeded per playlist when it is shuffled, so a shuffled playlist
+ * keeps its order across edits. A limit selects the head of that ranking,
+ * which only has to be walked again when a match was added, dropped or
+ * changed length. Flush() rewrites the .m3u of every playlist whose
+ * selection actually changed.
+ *
+ * Editing a smart playlist by hand is overwritten on its next change.
+ * Not thread-safe; used from the main window's thread.
+ */
+class SmartPlaylistManager {
+public:
+  explicit SmartPlaylistManager(PlaylistLibrary *library);
+  ~SmartPlaylistManager();
+
+  /** @brief Reads the registered playlists from the settings. */
+  void Load();
+
+  /**
+   * @brief Registers (or replaces) playlist `name` with the rules of a
+   * MSG_GENERATE_PLAYLIST `request` and writes it from `items`.
+   * @return Number of tracks written.
+   */
+  size_t Register(const BString &name, const BMessage &request,
+                  const LibraryItems &items, const LibraryFacetIndex *facets);
+
+  /** @brief Stops updating `name`; its file is left alone. */
+  void Forget(const BString &name);
+
+  void Rename(const BString &oldName, const BString &newName);
+
+  /** @brief Matches every playlist against the whole library. */
+  void Rebuild(const LibraryItems &items, const LibraryFacetIndex *facets);
+
+  /** @brief Re-evaluates `item`, which was added or changed. */
+  void ItemChanged(const MediaItem &item);
+
+  /** @brief Drops the item at `path` from every playlist. */
+  void ItemRemoved(const BString &path);
+
+  /**
+   * @brief Writes the playlists whose tracks changed.
+   * @param changed Receives their names, if not null.
+   */
+  void Flush(std::vector<BString> *changed = nullptr);
+
+private:
+  struct Playlist;
+
+  Playlist *_Find(const BString &name) const;
+  void _Save() const;
+
+  PlaylistLibrary *fLibrary;
+  std::vector<std::unique_ptr<Playlist>> fPlaylists;
+  bool fReady; ///< Rebuild() ran; until then changes are not tracked
+};
+
+#endif // BETON_SMART_PLAYLIST_MANAGER_H
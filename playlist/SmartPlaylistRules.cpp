@@ -0,0 +1,141 @@
+#include "SmartPlaylistRules.h"
+
+#include "LibraryFacetIndex.h"
+#include "LibrarySnapshot.h"
+#include "ParallelAlgorithms.h"
+
+#include <Message.h>
+
+#include <algorithm>
+#include <stdlib.h>
+
+void SmartPlaylistRules::Compile(const BMessage &request, int64 now) {
+  fGenreRules.clear();
+  fArtistRules.clear();
+  fYearRules.clear();
+  fTrackRules.clear();
+
+  BMessage rule;
+  for (int32 i = 0; request.FindMessage("rule", i, &rule) == B_OK; i++) {
+    const Type type = (Type)rule.GetInt32("type", kGenre);
+    const BString val1 = rule.GetString("val1", "");
+    const BString val2 = rule.GetString("val2", "");
+    const bool exclude = rule.GetBool("exclude", false);
+
+    switch (type) {
+    case kGenre:
+      fGenreRules.push_back({val1, exclude});
+      break;
+    case kArtist:
+      fArtistRules.push_back({val1, exclude});
+      break;
+    case kYear:
+      fYearRules.push_back(
+          {type, atoi(val1.String()), atoi(val2.String()), exclude});
+      break;
+    case kRating:
+    case kBitrate:
+      fTrackRules.push_back(
+          {type, atoi(val1.String()), atoi(val2.String()), exclude});
+      break;
+    case kChanged: {
+      int64 days = atoi(val1.String());
+      if (days > 0)
+        fTrackRules.push_back({type, now - days * 24 * 3600, 0, exclude});
+      break;
+    }
+    default:
+      break;
+    }
+  }
+}
+
+bool SmartPlaylistRules::Matches(const MediaItem &item) const {
+  return _YearMatches(item.year) && _TrackMatches(item) &&
+         _CellMatches(item.genre, item.artist);
+}
+
+void SmartPlaylistRules::Filter(const LibraryItems &items,
+                                const LibraryFacetIndex *facets,
+                                std::vector<uint32> &positions) const {
+  positions.clear();
+  if (facets == nullptr || facets->Count() != items.Count()) {
+    ParallelAlgorithms::FilterPositions(
+        items.Count(),
+        [&](size_t position) { return Matches(items[position]); }, positions);
+    return;
+  }
+
+  std::vector<uint32> candidates;
+  for (const auto &genre : facets->Genres()) {
+    for (const auto &artist : genre.second) {
+      if (!_CellMatches(genre.first, artist.first))
+        continue;
+      for (const auto &album : artist.second) {
+        if (_YearMatches(album.first.year))
+          candidates.insert(candidates.end(), album.second.begin(),
+                            album.second.end());
+      }
+    }
+  }
+  // Keep library order, as a scan would.
+  std::sort(candidates.begin(), candidates.end());
+
+  if (fTrackRules.empty()) {
+    positions.swap(candidates);
+    return;
+  }
+
+  ParallelAlgorithms::FilterPositions(
+      candidates.size(),
+      [&](size_t i) { return _TrackMatches(items[candidates[i]]); },
+      positions);
+  for (uint32 &position : positions)
+    position = candidates[position];
+}
+
+bool SmartPlaylistRules::_CellMatches(const BString &genre,
+                                      const BString &artist) const {
+  // A rule without a value matches nothing, so it only passes excluded.
+  for (const TextRule &rule : fGenreRules) {
+    bool match = !rule.value.IsEmpty() && genre.ICompare(rule.value) == 0;
+    if (match == rule.exclude)
+      return false;
+  }
+  for (const TextRule &rule : fArtistRules) {
+    bool match = !rule.value.IsEmpty() && artist.IFindFirst(rule.value) >= 0;
+    if (match == rule.exclude)
+      return false;
+  }
+  return true;
+}
+
+bool SmartPlaylistRules::_YearMatches(int32 year) const {
+  for (const RangeRule &rule : fYearRules) {
+    if (!rule.Holds(year))
+      return false;
+  }
+  return true;
+}
+
+bool SmartPlaylistRules::_TrackMatches(const MediaItem &item) const {
+  for (const RangeRule &rule : fTrackRules) {
+    int64 value = 0;
+    switch (rule.type) {
+    case kRating:
+      value = item.rating;
+      break;
+    case kBitrate:
+      value = item.bitrate;
+      break;
+    case kChanged:
+      value = item.mtime;
+      break;
+    default:
+      break;
+    }
+    if (!rule.Holds(value))
+      return false;
+  }
+  return true;
+}
@@ -0,0 +1,85 @@
+#ifndef BETON_SMART_PLAYLIST_RULES_H
+#define BETON_SMART_PLAYLIST_RULES_H
+
+#include "MediaItem.h"
+
+#include <String.h>
+#include <SupportDefs.h>
+#include <vector>
+
+class BMessage;
+class LibraryFacetIndex;
+class LibraryItems;
+
+/**
+ * @class SmartPlaylistRules
+ * @brief The rules of a smart playlist request, compiled for matching.
+ *
+ * Compile() reads the "rule" messages once: numbers are parsed and every
+ * rule is sorted by what it looks at. Genre, artist and year are what the
+ * LibraryFacetIndex is keyed by, so Filter() decides them once per
+ * (genre, artist, album) cell and only checks the per-track rules (rating,
+ * bitrate, modification time) on the tracks of the cells that passed, in
+ * parallel. All rules must hold; a rule marked "exclude" must not.
+ *
+ * Read-only after Compile(), so matching may run on several threads.
+ */
+class SmartPlaylistRules {
+public:
+  /** @brief Values of a rule's "type" field. */
+  enum Type {
+    kGenre = 0, ///< "val1" equals the genre, ignoring case
+    kArtist,    ///< "val1" occurs in the artist, ignoring case
+    kYear,      ///< Year within "val1" - "val2"
+    kRating,    ///< Rating (1-10) within "val1" - "val2"
+    kBitrate,   ///< Bitrate in kbit/s within "val1" - "val2"
+    kChanged,   ///< File modified in the last "val1" days
+    kTypeCount
+  };
+
+  /**
+   * @brief Compiles the rules of a MSG_GENERATE_PLAYLIST request.
+   * @param now Current time in seconds since the epoch, for kChanged.
+   */
+  void Compile(const BMessage &request, int64 now);
+
+  /** @brief Whether `item` satisfies every rule. */
+  bool Matches(const MediaItem &item) const;
+
+  /**
+   * @brief Positions of the matching items, in ascending order.
+   * @param facets Index over `items`; ignored unless it is in sync.
+   */
+  void Filter(const LibraryItems &items, const LibraryFacetIndex *facets,
+              std::vector<uint32> &positions) const;
+
+private:
+  struct TextRule {
+    BString value;
+    bool exclude;
+  };
+
+  /** @brief Inclusive bounds; 0 leaves a side open. */
+  struct RangeRule {
+    Type type;
+    int64 low;
+    int64 high;
+    bool exclude;
+
+    bool Holds(int64 value) const {
+      bool inside = (low <= 0 || value >= low) && (high <= 0 || value <= high);
+      return inside != exclude;
+    }
+  };
+
+  bool _CellMatches(const BString &genre, const BString &artist) const;
+  bool _YearMatches(int32 year) const;
+  bool _TrackMatches(const MediaItem &item) const;
+
+  std::vector<TextRule> fGenreRules;
+  std::vector<TextRule> fArtistRules;
+  std::vector<RangeRule> fYearRules;
+  std::vector<RangeRule> fTrackRules;
+};
+
+#endif // BETON_SMART_PLAYLIST_RULES_H
@@ -0,0 +1,64 @@
+#include "RadioCoverCache.h"
+
+#include "CoverThumbnailCache.h"
+
+#include <Autolock.h>
+#include <Bitmap.h>
+
+RadioCoverCache::RadioCoverCache() {}
+
+RadioCoverCache::~RadioCoverCache() {
+  for (Entry &entry : fCovers)
+    delete entry.bitmap;
+}
+
+BBitmap *RadioCoverCache::Find(const BString &url) {
+  BAutolock lock(&fLock);
+  for (auto it = fCovers.begin(); it != fCovers.end(); ++it) {
+    if (it->url == url) {
+      fCovers.splice(fCovers.begin(), fCovers, it);
+      return new BBitmap(it->bitmap);
+    }
+  }
+  return nullptr;
+}
+
+BBitmap *RadioCoverCache::Load(const BString &url) {
+  if (BBitmap *cover = Find(url))
+    return cover;
+
+  BBitmap *cover =
+      CoverThumbnailCache::Default().Load(CoverThumbnailCache::KeyForUrl(url));
+  if (cover == nullptr)
+    return nullptr;
+
+  BAutolock lock(&fLock);
+  _AddLocked(url, new BBitmap(cover));
+  return cover;
+}
+
+void RadioCoverCache::Store(const BString &url, const BBitmap *cover) {
+  if (cover == nullptr)
+    return;
+
+  CoverThumbnailCache::Default().Store(CoverThumbnailCache::KeyForUrl(url),
+                                       cover);
+  BAutolock lock(&fLock);
+  _AddLocked(url, new BBitmap(cover));
+}
+
+void RadioCoverCache::_AddLocked(const BString &url, BBitmap *bitmap) {
+  for (auto it = fCovers.begin(); it != fCovers.end(); ++it) {
+    if (it->url == url) {
+      delete it->bitmap;
+      fCovers.erase(it);
+      break;
+    }
+  }
+
+  fCovers.push_front({url, bitmap});
+  while (fCovers.size() > kMemoryCovers) {
+    delete fCovers.back().bitmap;
+    fCovers.pop_back();
+  }
+}
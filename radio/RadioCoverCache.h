@@ -0,0 +1,55 @@
+#ifndef BETON_RADIO_COVER_CACHE_H
+#define BETON_RADIO_COVER_CACHE_H
+
+#include <Locker.h>
+#include <String.h>
+#include <SupportDefs.h>
+#include <list>
+
+class BBitmap;
+
+/**
+ * @class RadioCoverCache
+ * @brief Decoded now-playing covers of radio streams, by cover URL.
+ *
+ * Stations repeat their playlists, and with them the same cover URLs. The
+ * last kMemoryCovers covers stay decoded in memory; behind them the
+ * CoverThumbnailCache keeps them on disk, so a cover is downloaded once.
+ *
+ * All methods are thread-safe.
+ */
+class RadioCoverCache {
+public:
+  static const size_t kMemoryCovers = 8;
+
+  RadioCoverCache();
+  ~RadioCoverCache();
+
+  /**
+   * @brief Cover for `url` from memory only; cheap enough for the window.
+   * @return New bitmap owned by the caller, or nullptr on a miss.
+   */
+  BBitmap *Find(const BString &url);
+
+  /**
+   * @brief Cover for `url` from memory, else from disk.
+   * @return New bitmap owned by the caller, or nullptr on a miss.
+   */
+  BBitmap *Load(const BString &url);
+
+  /** @brief Keeps a copy of `cover` in memory and on disk. */
+  void Store(const BString &url, const BBitmap *cover);
+
+private:
+  struct Entry {
+    BString url;
+    BBitmap *bitmap;
+  };
+
+  void _AddLocked(const BString &url, BBitmap *bitmap);
+
+  BLocker fLock{"radio covers"};
+  std::list<Entry> fCovers; ///< Most recently used first
+};
+
+#endif // BETON_RADIO_COVER_CACHE_H
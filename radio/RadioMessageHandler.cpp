@@ -3,7 +3,9 @@
 #include "MainWindow.h"
 #include "Messages.h"
 #include "RadioStationController.h"
+#include "RadioStationLibrary.h"
 
+#include <MenuItem.h>
 #include <Message.h>
 
 RadioMessageHandler::RadioMessageHandler(MainWindow *window)
@@ -68,6 +70,56 @@ bool RadioMessageHandler::HandleMessage(BMessage *msg) {
     break;
   }
 
+  case MSG_RADIO_STARTED: {
+    if (fWindow->fRadioStationLibrary)
+      fWindow->fRadioStationLibrary->RecordStartTime(
+          msg->GetString("url", ""), msg->GetInt64("elapsed", 0));
+    break;
+  }
+
+  case MSG_RADIO_PROBED: {
+    if (fWindow->fRadioStationLibrary)
+      fWindow->fRadioStationLibrary->RecordProbe(
+          msg->GetString("url", ""),
+          msg->GetInt32("health", RadioStation::kHealthUnknown),
+          msg->GetInt32("latency", 0), msg->GetInt32("bitrate", 0),
+          msg->GetString("codec", ""));
+    break;
+  }
+
+  case MSG_RADIO_RECORD: {
+    if (fWindow->fRadioStationController)
+      fWindow->fRadioStationController->ToggleRecording();
+    break;
+  }
+
+  case MSG_RADIO_RECORDING_SAVED: {
+    if (fWindow->fRadioStationController)
+      fWindow->fRadioStationController->RecordingSaved(msg);
+    break;
+  }
+
+  case MSG_RADIO_MORE_STATIONS: {
+    if (fWindow->fRadioStationController)
+      fWindow->fRadioStationController->ShowMoreStations();
+    break;
+  }
+
+  case MSG_TOGGLE_RECORD_LIBRARY: {
+    fWindow->fRecordToLibrary = !fWindow->fRecordToLibrary;
+    if (fWindow->fRecordLibraryItem)
+      fWindow->fRecordLibraryItem->SetMarked(fWindow->fRecordToLibrary);
+    break;
+  }
+
+  case MSG_RADIO_PROBE_DONE: {
+    if (fWindow->fRadioStationLibrary)
+      fWindow->fRadioStationLibrary->SaveStations();
+    if (fWindow->fIsRadioMode && fWindow->fRadioStationController)
+      fWindow->fRadioStationController->ShowStations();
+    break;
+  }
+
   default:
     return false;
   }
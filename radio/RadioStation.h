@@ -2,6 +2,7 @@
 #define BETON_RADIO_STATION_H
 
 #include <String.h>
+#include <ctime>
 
 /**
  * @struct RadioStation
@@ -9,7 +10,8 @@
  *
  * Stores the station's display name, stream URL, genre classification,
  * and an optional logo URL. Used by RadioStationLibrary for persistence and
- * by the UI for display in radio mode.
+ * by the UI for display in radio mode. The health fields are filled in by
+ * RadioStationProber.
  */
 struct RadioStation {
   BString name;     ///< Display name of the station.
@@ -19,8 +21,30 @@ struct RadioStation {
   BString language; ///< Broadcast language (e.g. "German").
   BString logoUrl;  ///< Optional URL to station logo image.
   bool favorite;    ///< User favorite flag.
+  /// Average time from Play to audible sound in ms; 0 until played.
+  int32 startMs;
 
-  RadioStation() : favorite(false) {}
+  /** @brief What the last background probe found. */
+  enum Health {
+    kHealthUnknown,     ///< Not probed yet.
+    kHealthOk,          ///< Answered quickly with audio.
+    kHealthSlow,        ///< Answered with audio, but slowly.
+    kHealthOffline,     ///< Did not answer, or with an error.
+    kHealthUnsupported  ///< Answered with something that is not audio.
+  };
+
+  /** @name Probe results */
+  ///@{
+  int32 health;      ///< A Health value.
+  int32 latencyMs;   ///< Request to first reply line.
+  int32 bitrateKbps; ///< From the stream header or the ICY reply; 0 if unknown.
+  BString codec;     ///< "MP3", "AAC", "Ogg", "FLAC", "HLS" or empty.
+  time_t checkedAt;  ///< real_time_clock() of the probe; 0 if never.
+  ///@}
+
+  RadioStation()
+      : favorite(false), startMs(0), health(kHealthUnknown), latencyMs(0),
+        bitrateKbps(0), checkedAt(0) {}
 
   /**
    * @brief Convenience constructor for quick station creation.
@@ -32,7 +56,9 @@ struct RadioStation {
    */
   RadioStation(const BString &n, const BString &u, const BString &g = "",
                const BString &c = "", const BString &l = "")
-      : name(n), url(u), genre(g), country(c), language(l), favorite(false) {}
+      : name(n), url(u), genre(g), country(c), language(l), favorite(false),
+        startMs(0), health(kHealthUnknown), latencyMs(0), bitrateKbps(0),
+        checkedAt(0) {}
 };
 
 #endif // BETON_RADIO_STATION_H
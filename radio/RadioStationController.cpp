@@ -2,7 +2,9 @@
 
 #include "MediaTableView.h"
 #include "Debug.h"
+#include "MediaLibraryCache.h"
 #include "DLNAViewController.h"
+#include "HttpConnectionPool.h"
 #include "NowPlayingInfoPanel.h"
 #include "LibraryBrowserController.h"
 #include "MainWindow.h"
@@ -13,6 +15,7 @@
 #include "PlaylistLibrary.h"
 #include "RadioStationLibrary.h"
 #include "RadioStationEditorDialog.h"
+#include "RadioStationProber.h"
 
 #include <Alert.h>
 #include <Autolock.h>
@@ -20,22 +23,50 @@
 #include <Catalog.h>
 #include <DataIO.h>
 #include <FilePanel.h>
-#include <HttpRequest.h>
-#include <HttpResult.h>
+#include <FindDirectory.h>
 #include <MenuItem.h>
 #include <Path.h>
 #include <TranslationUtils.h>
 #include <Url.h>
-#include <UrlProtocolRoster.h>
 
+#include <algorithm>
 #include <atomic>
-#include <memory>
+#include <cstdint>
+#include <cstring>
+#include <vector>
 
 #undef B_TRANSLATION_CONTEXT
 #define B_TRANSLATION_CONTEXT "RadioStationController"
 
 namespace {
 
+/** @brief How long the mirrors of a station get to answer. */
+const bigtime_t kMirrorTimeout = 5000000;
+
+/** @brief Age after which a station is checked again, in seconds. */
+const time_t kProbeInterval = 6 * 60 * 60;
+
+BString HealthLabel(const RadioStation &rs) {
+  BString label;
+  switch (rs.health) {
+  case RadioStation::kHealthOk:
+    label = B_TRANSLATE("Online");
+    break;
+  case RadioStation::kHealthSlow:
+    label = B_TRANSLATE("Slow");
+    break;
+  case RadioStation::kHealthOffline:
+    return B_TRANSLATE("Offline");
+  case RadioStation::kHealthUnsupported:
+    return B_TRANSLATE("Unsupported");
+  default:
+    return label;
+  }
+  if (!rs.codec.IsEmpty())
+    label << " (" << rs.codec << ")";
+  return label;
+}
+
 bool IsLikelyCoverUrl(BString url) {
   url.Trim();
   if (!url.IStartsWith("http://") && !url.IStartsWith("https://"))
@@ -69,42 +100,137 @@ bool IsLikelyCoverUrl(BString url) {
 
 } // namespace
 
-RadioStationController::RadioStationController(MainWindow *window) : fWindow(window) {}
+RadioStationController::RadioStationController(MainWindow *window)
+    : fWindow(window) {
+  if (!fWindow || !fWindow->fRadioStationLibrary)
+    return;
+
+  // Checks wait while a station is being started or streamed.
+  fProber = new RadioStationProber(
+      fWindow->fRadioStationLibrary, BMessenger(fWindow), [this]() {
+        if (fWindow->fShuttingDown.load(std::memory_order_relaxed))
+          return false;
+        if (fWindow->fPlaybackEngine &&
+            fWindow->fPlaybackEngine->IsStreaming())
+          return false;
+        BAutolock lock(&fPlayLock);
+        return fPlayJob.Get() == nullptr;
+      });
+}
 
 RadioStationController::~RadioStationController() {
+  StopProbing();
+  delete fProber;
   delete fActiveCover;
 }
 
+void RadioStationController::StopProbing() {
+  if (fProber)
+    fProber->Stop();
+}
+
 void RadioStationController::ShowStations() {
   if (!fWindow || !fWindow->fRadioStationLibrary || !fWindow->fLibraryManager)
     return;
 
-  const auto &stations = fWindow->fRadioStationLibrary->AllStations();
+  RadioStationLibrary *library = fWindow->fRadioStationLibrary;
+  const auto &stations = library->AllStations();
+  BString query = fWindow->fSearchField->Text();
+  query.Trim();
+  if (query != fStationQuery) {
+    fStationQuery = query;
+    fStationLimit = kStationPage;
+  }
+
+  // Large libraries are searched through the indexes; the list view only
+  // filters what is shown.
+  const bool paged = IsPaged();
+  std::vector<const RadioStation *> ordered;
+  if (paged && !query.IsEmpty()) {
+    std::vector<int32> matches;
+    library->Search(query, matches);
+    ordered.reserve(matches.size());
+    for (int32 index : matches)
+      ordered.push_back(&stations[index]);
+  } else {
+    ordered.reserve(stations.size());
+    for (const auto &rs : stations)
+      ordered.push_back(&rs);
+  }
+
+  // Stations that started quickly before come first, then the ones that
+  // answered the prober quickly; dead ones go last.
+  std::stable_sort(ordered.begin(), ordered.end(),
+                   [](const RadioStation *a, const RadioStation *b) {
+                     auto dead = [](const RadioStation *s) {
+                       return s->health == RadioStation::kHealthOffline ||
+                              s->health == RadioStation::kHealthUnsupported;
+                     };
+                     auto rank = [](const RadioStation *s) {
+                       if (s->startMs > 0)
+                         return s->startMs;
+                       return s->latencyMs > 0 ? s->latencyMs : INT32_MAX;
+                     };
+                     if (dead(a) != dead(b))
+                       return dead(b);
+                     return rank(a) < rank(b);
+                   });
+
+  const size_t shown =
+      paged ? std::min(ordered.size(), (size_t)fStationLimit) : ordered.size();
+  fStationsHidden = static_cast<int32>(ordered.size() - shown);
   fWindow->fRadioItems.clear();
-  fWindow->fRadioItems.reserve(stations.size());
+  fWindow->fRadioItems.reserve(shown);
+
+  const time_t now = (time_t)real_time_clock();
+  for (size_t i = 0; i < shown; i++) {
+    const RadioStation &rs = *ordered[i];
+    if (fProber && now - rs.checkedAt > kProbeInterval)
+      fProber->Enqueue(rs.url);
 
-  for (const auto &rs : stations) {
     MediaItem mi;
     mi.title = rs.name;
     mi.genre = rs.genre;
     mi.artist = rs.country;
     mi.album = rs.language;
     mi.path = rs.url;
+    mi.albumArtist = HealthLabel(rs);
+    mi.track = rs.latencyMs;
+    mi.bitrate = rs.bitrateKbps;
+    mi.missing = rs.health == RadioStation::kHealthOffline;
     fWindow->fRadioItems.push_back(mi);
   }
 
   fWindow->fLibraryManager->SetRadioFilterMode(true);
   fWindow->fLibraryManager->UpdateFilteredViews(
-      fWindow->fRadioItems, true, "Radio", fWindow->fSearchField->Text());
+      fWindow->fRadioItems, true, "Radio",
+      paged ? "" : fWindow->fSearchField->Text());
 
   BString status;
-  status.SetToFormat("%ld stations", (long)stations.size());
+  if (fStationsHidden > 0) {
+    status.SetToFormat("%ld of %ld stations", (long)shown,
+                       (long)ordered.size());
+  } else {
+    status.SetToFormat("%ld stations", (long)ordered.size());
+  }
   fWindow->UpdateStatus(status, false);
 
-  DEBUG_PRINT("_ShowRadioStations: %zu stations\n",
+  DEBUG_PRINT("_ShowRadioStations: %zu of %zu stations\n", shown,
               stations.size());
 }
 
+void RadioStationController::ShowMoreStations() {
+  if (fStationsHidden <= 0)
+    return;
+  fStationLimit += kStationPage;
+  ShowStations();
+}
+
+bool RadioStationController::IsPaged() const {
+  return fWindow && fWindow->fRadioStationLibrary &&
+         fWindow->fRadioStationLibrary->CountStations() > kStationPage;
+}
+
 void RadioStationController::ShowAddStationDialog() {
   if (!fWindow)
     return;
@@ -252,12 +378,7 @@ int32 RadioStationController::FindStationIndex(const BString &stationUrl) const
   if (!fWindow || !fWindow->fRadioStationLibrary)
     return -1;
 
-  const auto &stations = fWindow->fRadioStationLibrary->AllStations();
-  for (size_t i = 0; i < stations.size(); ++i) {
-    if (stations[i].url == stationUrl)
-      return static_cast<int32>(i);
-  }
-  return -1;
+  return fWindow->fRadioStationLibrary->FindStation(stationUrl);
 }
 
 void RadioStationController::HandleMetadata(BMessage *msg) {
@@ -311,6 +432,13 @@ void RadioStationController::HandleMetadata(BMessage *msg) {
   }
 }
 
+/**
+ * @brief Shows the cover at `coverUrl`, from the cover cache if it was seen
+ * before.
+ *
+ * A URL that is already being downloaded is not requested again, and a
+ * download whose cover is no longer wanted is canceled.
+ */
 void RadioStationController::DownloadCover(const BString &coverUrl) {
   if (!fWindow)
     return;
@@ -319,57 +447,88 @@ void RadioStationController::DownloadCover(const BString &coverUrl) {
               coverUrl.String());
 
   MainWindow *window = fWindow;
+  if (BBitmap *cached = fCoverCache.Find(coverUrl)) {
+    BMessage update(MSG_COVER_BITMAP_READY);
+    update.AddString("path", coverUrl);
+    update.AddPointer("bitmap", cached);
+    if (window->PostMessage(&update) != B_OK)
+      delete cached;
+    CancelCoverDownloads(coverUrl);
+    return;
+  }
+
+  // Held until the job is in the map, which the job leaves under it.
+  BAutolock lock(&fCoverLock);
+  CancelCoverDownloadsLocked(coverUrl);
+  auto running = fCoverDownloads.find(coverUrl);
+  if (running != fCoverDownloads.end() && !running->second->IsCancelled() &&
+      !running->second->IsDone())
+    return;
+
   RadioStationController *radio = this;
-  fCoverDownloadThread =
-      fWindow->LaunchThread("radio_cover_dl", [coverUrl, window, radio]() {
-        BMallocIO sink;
-#if B_HAIKU_VERSION <= B_HAIKU_VERSION_1_BETA_5
-        BUrl burl(coverUrl.String());
-#else
-        BUrl burl(coverUrl.String(), true);
-#endif
-        std::unique_ptr<BPrivate::Network::BUrlRequest> req(
-            BPrivate::Network::BUrlProtocolRoster::MakeRequest(burl, &sink));
-        if (req) {
-          if (auto http =
-                  dynamic_cast<BPrivate::Network::BHttpRequest *>(req.get())) {
-            http->SetFollowLocation(true);
-            BPrivate::Network::BHttpHeaders headers;
-            headers.AddHeader("User-Agent", "Beton/1.0 (Haiku OS)");
-            http->SetHeaders(headers);
-          }
-          thread_id tid = req->Run();
-          status_t exit;
-          if (wait_for_thread_etc(tid, B_RELATIVE_TIMEOUT, 10000000, &exit) ==
-              B_OK) {
-            if (auto http =
-                    dynamic_cast<BPrivate::Network::BHttpRequest *>(req.get())) {
-              const BPrivate::Network::BHttpResult &result =
-                  dynamic_cast<const BPrivate::Network::BHttpResult &>(
-                      http->Result());
-              DEBUG_PRINT("Radio cover HTTP status: %ld, bytes=%zu\n",
-                          (long)result.StatusCode(), sink.BufferLength());
-            }
-            sink.Seek(0, SEEK_SET);
-            BBitmap *bitmap = BTranslationUtils::GetBitmap(&sink);
+  BReference<WorkerJob> job = fWindow->QueueJob(
+      kLaneIO, "radio_cover_dl", [coverUrl, window, radio]() {
+        WorkerJob *self = WorkerJob::Current();
+        BBitmap *bitmap = radio->fCoverCache.Load(coverUrl);
+        if (bitmap == nullptr && !self->IsCancelled()) {
+          HttpConnectionPool::Request request;
+          request.url = coverUrl;
+          request.maxRedirects = 5;
+          request.cancel = self->CancelFlag();
+          HttpConnectionPool::Response response;
+          status_t status =
+              HttpConnectionPool::Default().Fetch(request, response);
+          if (status == B_OK) {
+            DEBUG_PRINT("Radio cover HTTP status: %ld, bytes=%zu\n",
+                        (long)response.status, response.body.size());
+            BMemoryIO io(response.body.data(), response.body.size());
+            bitmap = BTranslationUtils::GetBitmap(&io);
             if (bitmap) {
-              BMessage update(MSG_COVER_BITMAP_READY);
-              update.AddString("path", coverUrl);
-              update.AddPointer("bitmap", bitmap);
-              if (window->PostMessage(&update) != B_OK)
-                delete bitmap;
+              radio->fCoverCache.Store(coverUrl, bitmap);
             } else {
               DEBUG_PRINT("Radio cover decode failed: %s (%zu bytes)\n",
-                          coverUrl.String(), sink.BufferLength());
+                          coverUrl.String(), response.body.size());
             }
           } else {
-            req->Stop();
-            DEBUG_PRINT("Radio cover download timeout: %s\n",
-                        coverUrl.String());
+            DEBUG_PRINT("Radio cover download failed: %s (%s)\n",
+                        coverUrl.String(), strerror(status));
           }
         }
-        radio->MarkCoverDownloadThreadDone();
+
+        {
+          BAutolock lock(&radio->fCoverLock);
+          auto it = radio->fCoverDownloads.find(coverUrl);
+          if (it != radio->fCoverDownloads.end() && it->second.Get() == self)
+            radio->fCoverDownloads.erase(it);
+        }
+
+        // A superseded cover is kept in the cache but not shown.
+        if (bitmap && !self->IsCancelled()) {
+          BMessage update(MSG_COVER_BITMAP_READY);
+          update.AddString("path", coverUrl);
+          update.AddPointer("bitmap", bitmap);
+          if (window->PostMessage(&update) != B_OK)
+            delete bitmap;
+        } else {
+          delete bitmap;
+        }
       });
+  if (job.Get() != nullptr)
+    fCoverDownloads[coverUrl] = job;
+}
+
+/** @brief Cancels the cover downloads of every URL but `keepUrl`. */
+void RadioStationController::CancelCoverDownloads(const BString &keepUrl) {
+  BAutolock lock(&fCoverLock);
+  CancelCoverDownloadsLocked(keepUrl);
+}
+
+void RadioStationController::CancelCoverDownloadsLocked(
+    const BString &keepUrl) {
+  for (auto &download : fCoverDownloads) {
+    if (download.first != keepUrl)
+      download.second->Cancel();
+  }
 }
 
 void RadioStationController::ShowUnsupportedAlert() {
@@ -430,6 +589,72 @@ void RadioStationController::ShowConnectionFailedAlert(BMessage *msg) {
   fWindow->UpdateStatus(B_TRANSLATE("Connection to radio station failed"));
 }
 
+void RadioStationController::ToggleRecording() {
+  if (!fWindow || !fWindow->fPlaybackEngine)
+    return;
+
+  AudioPlaybackEngine *engine = fWindow->fPlaybackEngine;
+  if (engine->IsRecording()) {
+    engine->StopRecording();
+    fWindow->UpdateStatus(B_TRANSLATE("Recording stopped"));
+    return;
+  }
+  if (!HasActiveStation())
+    return;
+
+  BString directory = RecordingDirectory(fActiveStationName);
+  if (directory.IsEmpty() ||
+      engine->StartRecording(directory, fActiveStationName) != B_OK) {
+    fWindow->UpdateStatus(B_TRANSLATE("Cannot record this station"));
+    return;
+  }
+  BString status;
+  status.SetToFormat(B_TRANSLATE("Recording %s"), fActiveStationName.String());
+  fWindow->UpdateStatus(status, true);
+}
+
+bool RadioStationController::IsRecording() const {
+  return fWindow && fWindow->fPlaybackEngine &&
+         fWindow->fPlaybackEngine->IsRecording();
+}
+
+void RadioStationController::RecordingSaved(BMessage *msg) {
+  if (!fWindow || !msg)
+    return;
+
+  BPath path(msg->GetString("path", ""));
+  BString status;
+  status.SetToFormat(B_TRANSLATE("Saved recording: %s"),
+                     path.Leaf() ? path.Leaf() : "");
+  fWindow->UpdateStatus(status, IsRecording());
+}
+
+/**
+ * @brief Folder of a station's recordings: below the first music folder
+ * when recordings go into the library, where the library watcher picks up
+ * each finished file, else below the home folder.
+ */
+BString
+RadioStationController::RecordingDirectory(const BString &stationName) const {
+  BPath path;
+  std::vector<BString> roots;
+  if (fWindow->fRecordToLibrary && fWindow->fMediaLibraryCache)
+    fWindow->fMediaLibraryCache->LoadDirectories(roots);
+  if (!roots.empty())
+    path.SetTo(roots.front().String());
+  else if (find_directory(B_USER_DIRECTORY, &path) != B_OK)
+    return BString();
+
+  BString station(stationName);
+  station.ReplaceAll('/', '-');
+  station.Trim();
+  if (station.IsEmpty() || station.StartsWith("."))
+    station.Prepend("Station ");
+  path.Append("Radio Recordings");
+  path.Append(station.String());
+  return BString(path.Path());
+}
+
 void RadioStationController::PlayStation(const MediaItem &station) {
   if (!fWindow)
     return;
@@ -494,8 +719,7 @@ void RadioStationController::ClearActiveCover() {
   delete fActiveCover;
   fActiveCover = nullptr;
   fActiveStreamCoverUrl = "";
-  if (fCoverDownloadThread >= 0)
-    fCoverDownloadThread = -1;
+  CancelCoverDownloads(BString());
 }
 
 bool RadioStationController::HasActiveStation() const {
@@ -534,14 +758,6 @@ const BString &RadioStationController::ActiveStreamCoverUrl() const {
   return fActiveStreamCoverUrl;
 }
 
-bool RadioStationController::IsCurrentCoverDownloadThread(thread_id thread) const {
-  return fCoverDownloadThread == thread;
-}
-
-void RadioStationController::MarkCoverDownloadThreadDone() {
-  fCoverDownloadThread = -1;
-}
-
 void RadioStationController::StoreActiveCover(const BBitmap *bitmap) {
   delete fActiveCover;
   fActiveCover = bitmap ? new BBitmap(bitmap) : nullptr;
@@ -563,12 +779,11 @@ void RadioStationController::QueuePlay(const BString &stationUrl,
   fPendingName = stationName;
   fPendingPlay = true;
 
-  if (fPlayThread >= 0)
+  if (fPlayJob.Get() != nullptr)
     return;
 
-  fPlayThread = fWindow->LaunchThread("radio_play", [this]() { PlayLoop(); });
-  if (fPlayThread < 0)
-    fPlayThread = -1;
+  fPlayJob =
+      fWindow->QueueJob(kLaneIO, "radio_play", [this]() { PlayLoop(); });
 }
 
 void RadioStationController::CancelQueuedPlay() {
@@ -583,16 +798,33 @@ void RadioStationController::CancelQueuedPlay() {
   fPendingName = "";
 }
 
-void RadioStationController::WaitForPlayThread() {
-  thread_id radioThread = -1;
+void RadioStationController::WaitForPlayJob() {
+  BReference<WorkerJob> job;
   {
     BAutolock lock(&fPlayLock);
-    radioThread = fPlayThread;
+    job = fPlayJob;
   }
-  if (radioThread >= 0) {
-    status_t exit;
-    wait_for_thread(radioThread, &exit);
+  if (job.Get() != nullptr)
+    job->Wait();
+}
+
+/**
+ * @brief Resolves a station URL to the stream to play; of several mirrors,
+ * the one that answers first.
+ */
+BString RadioStationController::ResolveStationUrl(const BString &stationUrl) {
+  std::vector<BString> mirrors;
+  BString resolved =
+      fWindow->fRadioStationLibrary->ResolveStreamUrl(stationUrl, &mirrors);
+  // Rather than wait out a dead first entry.
+  if (mirrors.size() > 1 &&
+      !fWindow->fShuttingDown.load(std::memory_order_relaxed)) {
+    BString fastest =
+        RadioStationLibrary::FirstRespondingUrl(mirrors, kMirrorTimeout);
+    if (!fastest.IsEmpty())
+      resolved = fastest;
   }
+  return resolved;
 }
 
 void RadioStationController::PlayLoop() {
@@ -607,7 +839,7 @@ void RadioStationController::PlayLoop() {
     {
       BAutolock lock(&fPlayLock);
       if (!fPendingPlay) {
-        fPlayThread = -1;
+        fPlayJob.Unset();
         return;
       }
 
@@ -617,14 +849,33 @@ void RadioStationController::PlayLoop() {
     }
 
     BMessage statusMsg(MSG_STATUS_UPDATE);
-    statusMsg.AddString("text", B_TRANSLATE("Resolving stream URL..."));
-    statusMsg.AddBool("isPermanent", true);
-    fWindow->PostMessage(&statusMsg);
-
-    BString resolved = fWindow->fRadioStationLibrary->ResolveStreamUrl(stationUrl);
-    if (generation != fPlayGeneration.load(std::memory_order_relaxed) ||
-        fWindow->fShuttingDown.load(std::memory_order_relaxed)) {
-      continue;
+    RadioStationLibrary *library = fWindow->fRadioStationLibrary;
+    const bigtime_t playStart = system_time();
+    BString resolved;
+    bool fresh = false;
+    // Optimistically play what the station resolved to last time; a stale
+    // entry is resolved again in the background for the next play.
+    const bool cached = library->CachedStreamUrl(stationUrl, resolved, fresh);
+    if (cached) {
+      DEBUG_PRINT("cached stream URL: %s%s\n", resolved.String(),
+                  fresh ? "" : " (revalidating)");
+      if (!fresh) {
+        fWindow->QueueJob(kLaneIO, "radio_revalidate", [this, stationUrl]() {
+          fWindow->fRadioStationLibrary->StoreResolvedUrl(
+              stationUrl, ResolveStationUrl(stationUrl));
+        });
+      }
+    } else {
+      statusMsg.AddString("text", B_TRANSLATE("Resolving stream URL..."));
+      statusMsg.AddBool("isPermanent", true);
+      fWindow->PostMessage(&statusMsg);
+
+      resolved = ResolveStationUrl(stationUrl);
+      if (generation != fPlayGeneration.load(std::memory_order_relaxed) ||
+          fWindow->fShuttingDown.load(std::memory_order_relaxed)) {
+        continue;
+      }
+      library->StoreResolvedUrl(stationUrl, resolved);
     }
 
     if (resolved == "ERR:UNSUPPORTED") {
@@ -662,6 +913,17 @@ void RadioStationController::PlayLoop() {
     }
 
     if (!fWindow->fPlaybackEngine->IsPlaying()) {
+      if (cached) {
+        // The stream may have moved: resolve it afresh and try once more.
+        library->InvalidateResolvedUrl(stationUrl);
+        BAutolock lock(&fPlayLock);
+        if (!fPendingPlay) {
+          fPendingUrl = stationUrl;
+          fPendingName = stationName;
+          fPendingPlay = true;
+        }
+        continue;
+      }
       BMessage failed(MSG_RADIO_CONNECTION_FAILED);
       failed.AddString("url", stationUrl);
       failed.AddString("name", stationName);
@@ -669,6 +931,11 @@ void RadioStationController::PlayLoop() {
       continue;
     }
 
+    BMessage started(MSG_RADIO_STARTED);
+    started.AddString("url", stationUrl);
+    started.AddInt64("elapsed", system_time() - playStart);
+    fWindow->PostMessage(&started);
+
     BString nowPlaying;
     nowPlaying.SetToFormat(B_TRANSLATE("Now playing: %s"),
                            stationName.String());
@@ -679,5 +946,5 @@ void RadioStationController::PlayLoop() {
   }
 
   BAutolock lock(&fPlayLock);
-  fPlayThread = -1;
+  fPlayJob.Unset();
 }
@@ -2,26 +2,46 @@
 #define BETON_RADIO_STATION_CONTROLLER_H
 
 #include "MediaItem.h"
+#include "RadioCoverCache.h"
+#include "WorkerPool.h"
 
 #include <Locker.h>
 #include <String.h>
 #include <SupportDefs.h>
 #include <atomic>
+#include <map>
 
 class BBitmap;
 class BMessage;
 class MainWindow;
+class RadioStationProber;
 
 /**
  * @class RadioStationController
  * @brief Coordinates radio station CRUD, playback handoff, and metadata UI sync.
+ *
+ * Stations not checked for kProbeInterval are handed to a
+ * RadioStationProber whenever the list is shown.
+ *
+ * A library larger than kStationPage is shown a page at a time, and the
+ * search field then queries the library's indexes instead of filtering the
+ * list.
  */
 class RadioStationController {
 public:
+  /// Stations shown at once, and added by ShowMoreStations().
+  static const int32 kStationPage = 500;
+
   explicit RadioStationController(MainWindow *window);
   ~RadioStationController();
 
   void ShowStations();
+  /** @brief Shows the next page of stations. */
+  void ShowMoreStations();
+  /** @brief True if the library is too large to show in one list. */
+  bool IsPaged() const;
+  /** @brief True if the shown list stops short of the matching stations. */
+  bool HasMoreStations() const { return fStationsHidden > 0; }
   void ShowAddStationDialog();
   void ShowEditStationDialog();
   void DeleteSelectedStation();
@@ -44,19 +64,31 @@ public:
   const BString &ActiveStreamTrackTitle() const;
   const BString &ActiveStreamAlbum() const;
   const BString &ActiveStreamCoverUrl() const;
-  bool IsCurrentCoverDownloadThread(thread_id thread) const;
-  void MarkCoverDownloadThreadDone();
   void StoreActiveCover(const BBitmap *bitmap);
   BBitmap *ActiveCover() const;
   void QueuePlay(const BString &stationUrl, const BString &stationName);
   void CancelQueuedPlay();
-  void WaitForPlayThread();
+  void WaitForPlayJob();
   void PlayLoop();
+  /** @brief Stops the background station checks; before shutdown. */
+  void StopProbing();
+  /**
+   * @brief Starts or stops recording the playing station into
+   * RecordingDirectory().
+   */
+  void ToggleRecording();
+  bool IsRecording() const;
+  /** @brief Reports a recorded title that was saved. */
+  void RecordingSaved(BMessage *msg);
 
 private:
   int32 SelectedStationIndex();
   int32 FindStationIndex(const BString &stationUrl) const;
   void DownloadCover(const BString &coverUrl);
+  void CancelCoverDownloads(const BString &keepUrl);
+  void CancelCoverDownloadsLocked(const BString &keepUrl);
+  BString ResolveStationUrl(const BString &stationUrl);
+  BString RecordingDirectory(const BString &stationName) const;
 
   MainWindow *fWindow;
   BString fActiveStationName;
@@ -68,14 +100,23 @@ private:
   BString fActiveStreamAlbum;
   BBitmap *fActiveCover = nullptr;
   BString fActiveStreamCoverUrl;
-  thread_id fCoverDownloadThread = -1;
+  RadioCoverCache fCoverCache;
+  BLocker fCoverLock{"radio cover downloads"}; ///< Guards fCoverDownloads
+  /// Cover downloads in flight by URL.
+  std::map<BString, BReference<WorkerJob>> fCoverDownloads;
 
   BLocker fPlayLock{"radio play"};
-  thread_id fPlayThread = -1;
+  BReference<WorkerJob> fPlayJob; ///< Guarded by fPlayLock
   std::atomic<int32> fPlayGeneration{0};
   BString fPendingUrl;
   BString fPendingName;
   bool fPendingPlay = false;
+
+  RadioStationProber *fProber = nullptr;
+
+  int32 fStationLimit = kStationPage;
+  int32 fStationsHidden = 0;
+  BString fStationQuery; ///< Search the current page was built for
 };
 
 #endif // BETON_RADIO_STATION_CONTROLLER_H
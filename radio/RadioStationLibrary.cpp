@@ -1,24 +1,35 @@
 #include "RadioStationLibrary.h"
 #include "Debug.h"
+#include "HttpConnectionPool.h"
+#include "LibrarySearchIndex.h"
 #include "Messages.h"
 
+#include <Autolock.h>
 #include <Directory.h>
+#include <Entry.h>
 #include <File.h>
 #include <FindDirectory.h>
+#include <Message.h>
 #include <Path.h>
-#include <Url.h>
-#include <UrlProtocolRoster.h>
-#include <UrlRequest.h>
-#include <private/netservices/HttpRequest.h>
-#include <private/netservices/HttpResult.h>
 
-#include <DataIO.h>
 #include <OS.h>
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
 #include <cstdio>
 #include <cstring>
 #include <memory>
 
-using namespace BPrivate::Network;
+/** @brief Body bytes read to sniff a URL of unknown type. */
+static const size_t kSniffBytes = 64 * 1024;
+/** @brief Longest playlist that is parsed. */
+static const size_t kPlaylistBytes = 1024 * 1024;
+/** @brief Mirrors FirstRespondingUrl() connects to at once. */
+static const size_t kMaxRacedMirrors = 4;
+/** @brief Journal records after which the settings file is rewritten. */
+static const int32 kMaxJournalRecords = 256;
+/** @brief `what` of a journal record: a station, added or changed. */
+static const uint32 kJournalStation = 'rjst';
 
 RadioStationLibrary::RadioStationLibrary(BMessenger target) : fTarget(target) {}
 
@@ -28,7 +39,7 @@ RadioStationLibrary::~RadioStationLibrary() {}
  * @brief Builds the full path to the radio settings file.
  * @return Absolute path string, e.g. ~/config/settings/Beton/radio.settings.
  */
-BString RadioStationLibrary::_SettingsPath() const {
+BString RadioStationLibrary::_SettingsPath() {
   BPath path;
   if (find_directory(B_USER_SETTINGS_DIRECTORY, &path) != B_OK)
     return "";
@@ -36,51 +47,106 @@ BString RadioStationLibrary::_SettingsPath() const {
   return BString(path.Path());
 }
 
+/** @brief Path of the journal next to the settings file. */
+BString RadioStationLibrary::_JournalPath() const {
+  BString path = _SettingsPath();
+  if (!path.IsEmpty())
+    path << ".journal";
+  return path;
+}
+
+void RadioStationLibrary::_Archive(const RadioStation &rs, BMessage &archive) {
+  archive.AddString("name", rs.name);
+  archive.AddString("url", rs.url);
+  archive.AddString("genre", rs.genre);
+  archive.AddString("country", rs.country);
+  archive.AddString("language", rs.language);
+  archive.AddString("logoUrl", rs.logoUrl);
+  archive.AddBool("favorite", rs.favorite);
+  archive.AddInt32("startMs", rs.startMs);
+  archive.AddInt32("health", rs.health);
+  archive.AddInt32("latencyMs", rs.latencyMs);
+  archive.AddInt32("bitrateKbps", rs.bitrateKbps);
+  archive.AddString("codec", rs.codec);
+  archive.AddInt64("checkedAt", (int64)rs.checkedAt);
+}
+
+RadioStation RadioStationLibrary::_Unarchive(const BMessage &archive) {
+  RadioStation rs;
+  rs.name = archive.GetString("name", "");
+  rs.url = archive.GetString("url", "");
+  rs.genre = archive.GetString("genre", "");
+  rs.country = archive.GetString("country", "");
+  rs.language = archive.GetString("language", "");
+  rs.logoUrl = archive.GetString("logoUrl", "");
+  rs.favorite = archive.GetBool("favorite", false);
+  rs.startMs = archive.GetInt32("startMs", 0);
+  rs.health = archive.GetInt32("health", RadioStation::kHealthUnknown);
+  rs.latencyMs = archive.GetInt32("latencyMs", 0);
+  rs.bitrateKbps = archive.GetInt32("bitrateKbps", 0);
+  rs.codec = archive.GetString("codec", "");
+  rs.checkedAt = (time_t)archive.GetInt64("checkedAt", 0);
+  return rs;
+}
+
 /**
  * @brief Loads radio stations from the BMessage-based settings file.
  *
  * The file format stores each station as a nested BMessage with
- * fields: name, url, genre, country, language, logoUrl, favorite.
+ * fields: name, url, genre, country, language, logoUrl, favorite, startMs,
+ * the probe results (health, latencyMs, bitrateKbps, codec, checkedAt) and
+ * the cached resolvedUrl with its resolvedAt time. The journal written since
+ * the last save is applied on top.
  *
  * @return True if at least one station was loaded.
  */
 bool RadioStationLibrary::LoadStations() {
-  fStations.clear();
+  BMessage archive;
+  ReadStations(archive);
+  return LoadStations(archive);
+}
 
+void RadioStationLibrary::ReadStations(BMessage &archive) {
   BString settingsPath = _SettingsPath();
   if (settingsPath.IsEmpty())
-    return false;
+    return;
 
   BFile file(settingsPath.String(), B_READ_ONLY);
   if (file.InitCheck() != B_OK) {
     DEBUG_PRINT("No settings file found: %s\n",
                 settingsPath.String());
-    return false;
+  } else if (archive.Unflatten(&file) != B_OK) {
+    DEBUG_PRINT("Could not unflatten settings\n");
+    archive.MakeEmpty();
   }
+}
 
-  BMessage archive;
-  if (archive.Unflatten(&file) != B_OK) {
-    DEBUG_PRINT("Could not unflatten settings\n");
+bool RadioStationLibrary::LoadStations(const BMessage &archive) {
+  fStations.clear();
+  _RebuildIndexes();
+  BAutolock resolvedLock(fResolvedLock);
+  fResolved.clear();
+
+  if (_SettingsPath().IsEmpty())
     return false;
-  }
 
   BMessage stationMsg;
   for (int32 i = 0; archive.FindMessage("station", i, &stationMsg) == B_OK;
        i++) {
-    RadioStation rs;
-    rs.name = stationMsg.GetString("name", "");
-    rs.url = stationMsg.GetString("url", "");
-    rs.genre = stationMsg.GetString("genre", "");
-    rs.country = stationMsg.GetString("country", "");
-    rs.language = stationMsg.GetString("language", "");
-    rs.logoUrl = stationMsg.GetString("logoUrl", "");
-    rs.favorite = stationMsg.GetBool("favorite", false);
-
-    if (!rs.url.IsEmpty()) {
-      fStations.push_back(rs);
-    }
+    RadioStation rs = _Unarchive(stationMsg);
+    if (rs.url.IsEmpty() || FindStation(rs.url) >= 0)
+      continue;
+
+    ResolvedUrl resolved;
+    resolved.url = stationMsg.GetString("resolvedUrl", "");
+    resolved.resolvedAt = (time_t)stationMsg.GetInt64("resolvedAt", 0);
+    if (!resolved.url.IsEmpty())
+      fResolved[rs.url] = resolved;
+    _Append(rs);
   }
 
+  _ReplayJournal();
+
   DEBUG_PRINT("Loaded %zu stations\n", fStations.size());
   return !fStations.empty();
 }
@@ -89,7 +155,9 @@ bool RadioStationLibrary::LoadStations() {
  * @brief Saves all radio stations to the settings file.
  *
  * Creates the Beton settings directory if it does not exist.
- * Each station is stored as a nested BMessage.
+ * Each station is stored as a nested BMessage. The journal is removed once
+ * the file is written; a journal that survives a crash in between only
+ * repeats what the file already holds.
  *
  * @return True on success.
  */
@@ -104,16 +172,16 @@ bool RadioStationLibrary::SaveStations() {
   dirPath.Append("BeTon");
   create_directory(dirPath.Path(), 0755);
 
+  BAutolock resolvedLock(fResolvedLock);
   BMessage archive;
   for (const auto &rs : fStations) {
     BMessage stationMsg;
-    stationMsg.AddString("name", rs.name);
-    stationMsg.AddString("url", rs.url);
-    stationMsg.AddString("genre", rs.genre);
-    stationMsg.AddString("country", rs.country);
-    stationMsg.AddString("language", rs.language);
-    stationMsg.AddString("logoUrl", rs.logoUrl);
-    stationMsg.AddBool("favorite", rs.favorite);
+    _Archive(rs, stationMsg);
+    auto resolved = fResolved.find(rs.url);
+    if (resolved != fResolved.end()) {
+      stationMsg.AddString("resolvedUrl", resolved->second.url);
+      stationMsg.AddInt64("resolvedAt", (int64)resolved->second.resolvedAt);
+    }
     archive.AddMessage("station", &stationMsg);
   }
 
@@ -130,19 +198,112 @@ bool RadioStationLibrary::SaveStations() {
     return false;
   }
 
+  BEntry(_JournalPath().String()).Remove();
+  fJournalRecords = 0;
+
   DEBUG_PRINT("Saved %zu stations to %s\n", fStations.size(),
               settingsPath.String());
   return true;
 }
 
 /**
- * @brief Adds a new station and persists immediately.
+ * @brief Appends one station record to the journal.
+ *
+ * Rewriting the settings file for a single change costs as much as the
+ * whole library; a record costs as much as the station.
+ */
+void RadioStationLibrary::_Journal(const RadioStation &station) {
+  if (fJournalRecords >= kMaxJournalRecords) {
+    SaveStations();
+    return;
+  }
+
+  BFile file(_JournalPath().String(),
+             B_WRITE_ONLY | B_CREATE_FILE | B_OPEN_AT_END);
+  BMessage record(kJournalStation);
+  _Archive(station, record);
+  if (file.InitCheck() != B_OK || record.Flatten(&file) != B_OK) {
+    SaveStations();
+    return;
+  }
+  fJournalRecords++;
+}
+
+/**
+ * @brief Applies the journal: each record replaces the station with its URL
+ * or adds it. A torn last record ends the replay.
+ */
+void RadioStationLibrary::_ReplayJournal() {
+  fJournalRecords = 0;
+  BFile file(_JournalPath().String(), B_READ_ONLY);
+  if (file.InitCheck() != B_OK)
+    return;
+
+  BMessage record;
+  while (record.Unflatten(&file) == B_OK) {
+    fJournalRecords++;
+    if (record.what != kJournalStation)
+      continue;
+    RadioStation rs = _Unarchive(record);
+    if (rs.url.IsEmpty())
+      continue;
+    int32 index = FindStation(rs.url);
+    if (index >= 0)
+      fStations[index] = rs;
+    else
+      _Append(rs);
+  }
+  // Names and genres of replaced stations may have changed.
+  if (fJournalRecords > 0)
+    _RebuildIndexes();
+  DEBUG_PRINT("Replayed %ld journal records\n", (long)fJournalRecords);
+}
+
+void RadioStationLibrary::_Append(const RadioStation &station) {
+  fStations.push_back(station);
+  _IndexStation(static_cast<int32>(fStations.size() - 1));
+}
+
+/** @brief Adds the station at `index` to the URL, name and genre indexes. */
+void RadioStationLibrary::_IndexStation(int32 index) {
+  const RadioStation &rs = fStations[index];
+  fUrlIndex.Insert(rs.url, (size_t)index);
+
+  std::string name = LibrarySearchIndex::Fold(rs.name.String());
+  size_t start = 0;
+  while (start < name.size()) {
+    size_t end = name.find(' ', start);
+    if (end == std::string::npos)
+      end = name.size();
+    if (end > start)
+      fNameIndex.emplace_back(name.substr(start, end - start), index);
+    start = end + 1;
+  }
+  fNameIndexSorted = false;
+
+  std::string genre = LibrarySearchIndex::Fold(rs.genre.String());
+  if (!genre.empty())
+    fGenres[genre].push_back(index);
+}
+
+/** @brief Indexes every station again, after indexes shifted or changed. */
+void RadioStationLibrary::_RebuildIndexes() {
+  fUrlIndex.Clear();
+  fUrlIndex.Reserve(fStations.size());
+  fNameIndex.clear();
+  fGenres.clear();
+  for (size_t i = 0; i < fStations.size(); i++)
+    _IndexStation(static_cast<int32>(i));
+}
+
+/**
+ * @brief Adds a new station and journals it.
  * @param station The station to add.
  * @return Index of the newly added station.
  */
 int32 RadioStationLibrary::AddStation(const RadioStation &station) {
-  fStations.push_back(station);
-  SaveStations();
+  _Append(station);
+  _Journal(station);
   DEBUG_PRINT("Added station '%s' (%s)\n",
               station.name.String(), station.url.String());
   return static_cast<int32>(fStations.size() - 1);
@@ -160,6 +321,7 @@ bool RadioStationLibrary::RemoveStation(int32 index) {
   DEBUG_PRINT("Removing station '%s'\n",
               fStations[index].name.String());
   fStations.erase(fStations.begin() + index);
+  _RebuildIndexes();
   SaveStations();
   return true;
 }
@@ -174,7 +336,20 @@ bool RadioStationLibrary::EditStation(int32 index, const RadioStation &station)
   if (index < 0 || index >= static_cast<int32>(fStations.size()))
     return false;
 
-  fStations[index] = station;
+  // Measurements of the same stream stay valid.
+  RadioStation &target = fStations[index];
+  RadioStation edited = station;
+  if (edited.url == target.url) {
+    edited.startMs = target.startMs;
+    edited.health = target.health;
+    edited.latencyMs = target.latencyMs;
+    edited.bitrateKbps = target.bitrateKbps;
+    edited.codec = target.codec;
+    edited.checkedAt = target.checkedAt;
+  }
+  target = edited;
+  _RebuildIndexes();
+  // A journal record for a new URL would add the station, not move it.
   SaveStations();
   DEBUG_PRINT("Edited station %ld: '%s'\n", (long)index,
               station.name.String());
@@ -195,6 +370,53 @@ int32 RadioStationLibrary::CountStations() const {
   return static_cast<int32>(fStations.size());
 }
 
+int32 RadioStationLibrary::FindStation(const BString &url) const {
+  size_t index = fUrlIndex.Find(url);
+  return index == MediaPathIndex::kNotFound ? -1 : static_cast<int32>(index);
+}
+
+/**
+ * @brief Looks `query` up in the sorted name words and the genres.
+ *
+ * Both are binary searches for the first key with the folded query as
+ * prefix, so a search costs the matches, not the library.
+ */
+void RadioStationLibrary::Search(const BString &query,
+                                 std::vector<int32> &indexes) {
+  indexes.clear();
+  BString trimmed = query;
+  trimmed.Trim();
+  const std::string folded = LibrarySearchIndex::Fold(trimmed.String());
+  if (folded.empty())
+    return;
+
+  if (!fNameIndexSorted) {
+    std::sort(fNameIndex.begin(), fNameIndex.end());
+    fNameIndexSorted = true;
+  }
+  // A query of several words matches names that start with it.
+  const std::string first = folded.substr(0, folded.find(' '));
+  for (auto it = std::lower_bound(fNameIndex.begin(), fNameIndex.end(),
+                                  NameKey(first, INT32_MIN));
+       it != fNameIndex.end() && it->first.compare(0, first.size(), first) == 0;
+       ++it) {
+    if (first.size() == folded.size() ||
+        LibrarySearchIndex::Fold(fStations[it->second].name.String())
+                .find(folded) != std::string::npos) {
+      indexes.push_back(it->second);
+    }
+  }
+
+  for (auto it = fGenres.lower_bound(folded);
+       it != fGenres.end() && it->first.compare(0, folded.size(), folded) == 0;
+       ++it) {
+    indexes.insert(indexes.end(), it->second.begin(), it->second.end());
+  }
+
+  std::sort(indexes.begin(), indexes.end());
+  indexes.erase(std::unique(indexes.begin(), indexes.end()), indexes.end());
+}
+
 /**
  * @brief Imports stations from an .m3u file.
  *
@@ -249,7 +471,9 @@ int32 RadioStationLibrary::ImportM3U(const char *path) {
       } else {
         rs.name = s;
       }
-      fStations.push_back(rs);
+      if (FindStation(rs.url) >= 0)
+        continue;
+      _Append(rs);
       imported++;
     }
   }
@@ -320,12 +544,13 @@ int32 RadioStationLibrary::ImportPLS(const char *path) {
 
   int32 imported = 0;
   for (size_t i = 0; i < urls.size(); i++) {
-    if (urls[i].StartsWith("http://") || urls[i].StartsWith("https://")) {
+    if ((urls[i].StartsWith("http://") || urls[i].StartsWith("https://")) &&
+        FindStation(urls[i]) < 0) {
       RadioStation rs;
       rs.url = urls[i];
       rs.name = (i < titles.size() && !titles[i].IsEmpty()) ? titles[i]
                                                              : urls[i];
-      fStations.push_back(rs);
+      _Append(rs);
       imported++;
     }
   }
@@ -347,11 +572,15 @@ int32 RadioStationLibrary::ImportPLS(const char *path) {
  * .m3u8 or .pls extension), it is returned unchanged.
  *
  * @param url The input URL (may be playlist or direct stream).
+ * @param mirrors Optional output for all stream URLs of the playlist.
  * @return The resolved direct stream URL.
  */
-BString RadioStationLibrary::ResolveStreamUrl(const BString &url) {
+BString RadioStationLibrary::ResolveStreamUrl(const BString &url,
+                                              std::vector<BString> *mirrors) {
   BString workUrl = url;
   workUrl.Trim();
+  if (mirrors != nullptr)
+    mirrors->clear();
 
   bool isM3U = workUrl.IEndsWith(".m3u") || workUrl.IEndsWith(".m3u8");
   bool isPLS = workUrl.IEndsWith(".pls");
@@ -368,57 +597,34 @@ BString RadioStationLibrary::ResolveStreamUrl(const BString &url) {
 
   DEBUG_PRINT("Resolving URL: %s\n", workUrl.String());
 
-  BMallocIO sink;
-#if B_HAIKU_VERSION <= B_HAIKU_VERSION_1_BETA_5
-  BUrl burl(workUrl.String());
-#else
-  BUrl burl(workUrl.String(), true);
-#endif
-
-  std::unique_ptr<BUrlRequest> req(
-      BUrlProtocolRoster::MakeRequest(burl, &sink, nullptr, &fUrlContext));
-  if (!req) {
-    DEBUG_PRINT("ResolveStreamUrl: no request object\n");
-    return workUrl;
-  }
-
-  BHttpRequest *http = dynamic_cast<BHttpRequest *>(req.get());
-  if (http) {
-    http->SetMethod(B_HTTP_HEAD);
-    http->SetFollowLocation(false);
-    BHttpHeaders headers;
-    headers.AddHeader("User-Agent", "Beton/1.0 (Haiku OS; VLC-like)");
-    http->SetHeaders(headers);
-  }
+  HttpConnectionPool &pool = HttpConnectionPool::Default();
+  HttpConnectionPool::Request request;
+  request.url = workUrl;
+  request.userAgent = "Beton/1.0 (Haiku OS; VLC-like)";
+  HttpConnectionPool::Response response;
 
-  thread_id tid = req->Run();
-  if (tid >= 0) {
-    status_t exit;
-    // HEAD should be quick; allow up to 10s for slow TLS handshakes.
-    if (wait_for_thread_etc(tid, B_RELATIVE_TIMEOUT, 10000000, &exit) != B_OK) {
-      DEBUG_PRINT("ResolveStreamUrl: HEAD timeout\n");
-      req->Stop();
-      wait_for_thread(tid, &exit);
-    }
-  }
+  // HEAD should be quick; allow up to 10s for slow TLS handshakes.
+  request.method = "HEAD";
+  status_t status = pool.Fetch(request, response);
+  if (status != B_OK)
+    DEBUG_PRINT("ResolveStreamUrl: HEAD failed: %s\n", strerror(status));
 
   // Evaluate HEAD response first (cheap probe before GET).
   bool identified = false;
-  if (http) {
-    const BHttpResult &res = dynamic_cast<const BHttpResult &>(http->Result());
-    int32 statusCode = res.StatusCode();
-    
-    // Follow explicit redirects ourselves because follow-location is disabled.
+  if (status == B_OK) {
+    int32 statusCode = response.status;
+
+    // Follow explicit redirects ourselves, so the target is resolved too.
     if (statusCode >= 300 && statusCode < 400) {
-       BString location = res.Headers().HeaderValue("Location");
-       if (!location.IsEmpty()) {
-          DEBUG_PRINT("Following redirect to: %s\n", location.String());
-          return ResolveStreamUrl(location);
+       if (!response.location.IsEmpty()) {
+          DEBUG_PRINT("Following redirect to: %s\n",
+                      response.location.String());
+          return ResolveStreamUrl(response.location, mirrors);
        }
     }
 
     if (statusCode == 200) {
-      BString contentType = res.ContentType();
+      BString contentType = response.contentType;
       contentType.ToLower();
 
       DEBUG_PRINT("HEAD Success: %s\n", contentType.String());
@@ -445,85 +651,53 @@ BString RadioStationLibrary::ResolveStreamUrl(const BString &url) {
     }
   }
 
-  // If HEAD is inconclusive, do a short GET-based content sniff.
+  // If HEAD is inconclusive, do a short GET-based content sniff. The body
+  // is capped: a direct stream would never end.
+  bool haveContent = false;
   if (!identified) {
-    sink.SetSize(0);
-    sink.Seek(0, SEEK_SET);
-    std::unique_ptr<BUrlRequest> getReq(
-        BUrlProtocolRoster::MakeRequest(burl, &sink, nullptr, &fUrlContext));
-    if (getReq) {
-      BHttpRequest *getHttp = dynamic_cast<BHttpRequest *>(getReq.get());
-      if (getHttp) {
-        getHttp->SetFollowLocation(false);
-        BHttpHeaders headers;
-        headers.AddHeader("User-Agent", "Beton/1.0 (Haiku OS; VLC-like)");
-        getHttp->SetHeaders(headers);
-      }
-      
-      tid = getReq->Run();
-      if (tid >= 0) {
-        status_t exit;
-        // Wait up to 10s for headers (TLS/remote endpoints can be slow).
-        if (wait_for_thread_etc(tid, B_RELATIVE_TIMEOUT, 10000000, &exit) != B_OK) {
-           DEBUG_PRINT("GET Sniff timed out (Stopping request)\n");
-           getReq->Stop();
-           wait_for_thread(tid, &exit);
+    request.method = "GET";
+    request.maxBytes = kSniffBytes;
+    if (pool.Fetch(request, response) == B_OK) {
+      int32 code = response.status;
+
+      // Handle redirects in the same way as in the HEAD branch.
+      if (code >= 300 && code < 400) {
+        if (!response.location.IsEmpty()) {
+           DEBUG_PRINT("Following GET redirect to: %s\n",
+                       response.location.String());
+           return ResolveStreamUrl(response.location, mirrors);
         }
-        
-        if (getHttp) {
-          const BHttpResult &res = dynamic_cast<const BHttpResult &>(getHttp->Result());
-          int32 code = res.StatusCode();
-          
-          // Handle redirects in the same way as in the HEAD branch.
-          if (code >= 300 && code < 400) {
-            BString location = res.Headers().HeaderValue("Location");
-            if (!location.IsEmpty()) {
-               DEBUG_PRINT("Following GET redirect to: %s\n", location.String());
-               return ResolveStreamUrl(location);
-            }
-          }
+      }
 
-          BString contentType = res.ContentType();
-          contentType.ToLower();
-          DEBUG_PRINT("GET Sniff: Status %ld, Type '%s'\n", (long)code, contentType.String());
-          
-          if (code >= 200 && code < 300) {
-            if (contentType.FindFirst("text/html") >= 0) return "ERR:UNSUPPORTED";
-            if (contentType.FindFirst("mpegurl") >= 0 || contentType.FindFirst("m3u") >= 0) isM3U = true;
-            else if (contentType.FindFirst("scpls") >= 0 || contentType.FindFirst("pls") >= 0) isPLS = true;
-            else if (contentType.FindFirst("audio/") >= 0 ||
-                     contentType.FindFirst("video/") >= 0 ||
-                     contentType.FindFirst("flv") >= 0) return workUrl;
-          }
-        }
+      BString contentType = response.contentType;
+      contentType.ToLower();
+      DEBUG_PRINT("GET Sniff: Status %ld, Type '%s'\n", (long)code, contentType.String());
+
+      if (code >= 200 && code < 300) {
+        if (contentType.FindFirst("text/html") >= 0) return "ERR:UNSUPPORTED";
+        if (contentType.FindFirst("mpegurl") >= 0 || contentType.FindFirst("m3u") >= 0) isM3U = true;
+        else if (contentType.FindFirst("scpls") >= 0 || contentType.FindFirst("pls") >= 0) isPLS = true;
+        else if (contentType.FindFirst("audio/") >= 0 ||
+                 contentType.FindFirst("video/") >= 0 ||
+                 contentType.FindFirst("flv") >= 0) return workUrl;
+        // A whole playlist came with the sniff; no need to fetch it again.
+        haveContent = !response.truncated;
       }
+    } else {
+      DEBUG_PRINT("GET Sniff failed\n");
     }
   }
 
   // If it looks like a playlist, fetch and parse it.
   if (isM3U || isPLS) {
-
-
-    DEBUG_PRINT("Fetching playlist content via GET...\n");
-    sink.SetSize(0);
-    sink.Seek(0, SEEK_SET);
-
-    std::unique_ptr<BUrlRequest> getReq(
-        BUrlProtocolRoster::MakeRequest(burl, &sink, nullptr, &fUrlContext));
-    if (getReq) {
-      if (auto getHttp = dynamic_cast<BHttpRequest *>(getReq.get())) {
-        getHttp->SetFollowLocation(true);
-      }
-      tid = getReq->Run();
-      if (tid >= 0) {
-        status_t exit;
-        if (wait_for_thread_etc(tid, B_RELATIVE_TIMEOUT, 10000000, &exit) !=
-            B_OK) {
-          DEBUG_PRINT("ResolveStreamUrl: GET timeout\n");
-          getReq->Stop();
-          wait_for_thread(tid, &exit);
-          return "ERR:CONNECTION";
-        }
+    if (!haveContent) {
+      DEBUG_PRINT("Fetching playlist content via GET...\n");
+      request.method = "GET";
+      request.maxBytes = kPlaylistBytes;
+      request.maxRedirects = 5;
+      if (pool.Fetch(request, response) != B_OK) {
+        DEBUG_PRINT("ResolveStreamUrl: GET failed\n");
+        return "ERR:CONNECTION";
       }
     }
   } else {
@@ -531,16 +705,15 @@ BString RadioStationLibrary::ResolveStreamUrl(const BString &url) {
     return workUrl;
   }
 
-  const void *buf = sink.Buffer();
-  size_t len = sink.BufferLength();
-  if (!buf || len == 0) {
+  if (response.body.empty()) {
     DEBUG_PRINT("ResolveStreamUrl: empty response\n");
     return workUrl;
   }
 
-  BString content((const char *)buf, len);
-  DEBUG_PRINT("ResolveStreamUrl: got %zu bytes\n", len);
+  BString content((const char *)response.body.data(), response.body.size());
+  DEBUG_PRINT("ResolveStreamUrl: got %zu bytes\n", response.body.size());
 
+  BString first;
   if (isM3U) {
     // Detect HLS manifests.
     if (content.FindFirst("#EXT-X-TARGETDURATION") >= 0 ||
@@ -578,13 +751,21 @@ BString RadioStationLibrary::ResolveStreamUrl(const BString &url) {
         if ((resolved.IEndsWith(".m3u") || resolved.IEndsWith(".m3u8") ||
              resolved.IEndsWith(".pls")) &&
             resolved != workUrl) {
+          if (!first.IsEmpty())
+            continue;
           DEBUG_PRINT("Found nested playlist: %s\n",
                       resolved.String());
-          return ResolveStreamUrl(resolved);
+          return ResolveStreamUrl(resolved, mirrors);
         }
 
-        DEBUG_PRINT("Resolved to: %s\n", resolved.String());
-        return resolved;
+        if (first.IsEmpty()) {
+          DEBUG_PRINT("Resolved to: %s\n", resolved.String());
+          first = resolved;
+        }
+        // The other entries are mirrors of the same station.
+        if (mirrors == nullptr)
+          break;
+        mirrors->push_back(resolved);
       }
     }
   } else if (isPLS) {
@@ -607,15 +788,187 @@ BString RadioStationLibrary::ResolveStreamUrl(const BString &url) {
           streamUrl.Trim();
           if (streamUrl.StartsWith("http://") ||
               streamUrl.StartsWith("https://")) {
-            DEBUG_PRINT("Resolved to: %s\n",
-                        streamUrl.String());
-            return streamUrl;
+            if (first.IsEmpty()) {
+              DEBUG_PRINT("Resolved to: %s\n",
+                          streamUrl.String());
+              first = streamUrl;
+            }
+            if (mirrors == nullptr)
+              break;
+            mirrors->push_back(streamUrl);
           }
         }
       }
     }
   }
 
+  if (!first.IsEmpty())
+    return first;
+
   DEBUG_PRINT("ResolveStreamUrl: no stream URL found\n");
   return workUrl;
 }
+
+namespace {
+
+/** @brief State the threads of one FirstRespondingUrl() call share. */
+struct MirrorRace {
+  BLocker lock{"mirror race"};
+  BString winner;
+  int32 pending = 0;
+  sem_id decided = -1; ///< Released by the winner or the last loser
+  std::atomic<bool> cancel{false};
+
+  ~MirrorRace() { delete_sem(decided); }
+};
+
+struct MirrorProbe {
+  std::shared_ptr<MirrorRace> race;
+  BString url;
+  bigtime_t timeout;
+};
+
+/** @brief Thread: whether `url` sends stream data. */
+int32 ProbeMirror(void *cookie) {
+  std::unique_ptr<MirrorProbe> probe(static_cast<MirrorProbe *>(cookie));
+  MirrorRace &race = *probe->race;
+
+  HttpConnectionPool::Request request;
+  request.url = probe->url;
+  request.userAgent = "Beton/1.0 (Haiku OS; VLC-like)";
+  request.maxRedirects = 5;
+  // The first bytes of the body prove the stream runs; it never ends.
+  request.maxBytes = 1;
+  request.timeout = probe->timeout;
+  request.cancel = &race.cancel;
+  HttpConnectionPool::Response response;
+  BString contentType;
+  bool answered =
+      HttpConnectionPool::Default().Fetch(request, response) == B_OK &&
+      response.status >= 200 && response.status < 300 &&
+      !response.body.empty();
+  if (answered) {
+    contentType = response.contentType;
+    contentType.ToLower();
+    answered = contentType.FindFirst("text/html") < 0;
+  }
+
+  BAutolock lock(race.lock);
+  if (answered && race.winner.IsEmpty()) {
+    race.winner = probe->url;
+    race.cancel = true;
+    release_sem(race.decided);
+  } else if (--race.pending == 0 && race.winner.IsEmpty()) {
+    release_sem(race.decided);
+  }
+  return 0;
+}
+
+} // namespace
+
+/**
+ * @brief Races GET requests to `urls`; the losers are canceled.
+ *
+ * Only the answer is kept: the caller opens the winner again for playback.
+ * Mirrors that do not answer do not delay the result.
+ */
+BString RadioStationLibrary::FirstRespondingUrl(
+    const std::vector<BString> &urls, bigtime_t timeout) {
+  std::shared_ptr<MirrorRace> race = std::make_shared<MirrorRace>();
+  race->decided = create_sem(0, "mirror race");
+  if (race->decided < 0)
+    return urls.empty() ? BString() : urls[0];
+
+  const bigtime_t start = system_time();
+  for (size_t i = 0; i < std::min(urls.size(), kMaxRacedMirrors); i++) {
+    MirrorProbe *probe = new MirrorProbe{race, urls[i], timeout};
+    thread_id thread = spawn_thread(ProbeMirror, "radio mirror probe",
+                                    B_NORMAL_PRIORITY, probe);
+    if (thread < 0) {
+      delete probe;
+      continue;
+    }
+    race->lock.Lock();
+    race->pending++;
+    race->lock.Unlock();
+    resume_thread(thread);
+  }
+
+  {
+    BAutolock lock(race->lock);
+    if (race->pending == 0 && race->winner.IsEmpty())
+      return BString();
+  }
+  acquire_sem_etc(race->decided, 1, B_RELATIVE_TIMEOUT, timeout);
+
+  BAutolock lock(race->lock);
+  race->cancel = true;
+  DEBUG_PRINT("FirstRespondingUrl: %s after %lld ms of %zu mirrors\n",
+              race->winner.IsEmpty() ? "(none)" : race->winner.String(),
+              (long long)(system_time() - start) / 1000, urls.size());
+  return race->winner;
+}
+
+bool RadioStationLibrary::CachedStreamUrl(const BString &url,
+                                          BString &resolved, bool &fresh) {
+  BAutolock lock(fResolvedLock);
+  auto found = fResolved.find(url);
+  if (found == fResolved.end())
+    return false;
+  resolved = found->second.url;
+  const time_t age = (time_t)real_time_clock() - found->second.resolvedAt;
+  fresh = age >= 0 && age < kResolvedTtl;
+  return true;
+}
+
+void RadioStationLibrary::StoreResolvedUrl(const BString &url,
+                                           const BString &resolved) {
+  // Failures are not cached: the next play must try again.
+  if (resolved.IsEmpty() || resolved.StartsWith("ERR:"))
+    return;
+  BAutolock lock(fResolvedLock);
+  ResolvedUrl &entry = fResolved[url];
+  entry.url = resolved;
+  entry.resolvedAt = (time_t)real_time_clock();
+}
+
+void RadioStationLibrary::InvalidateResolvedUrl(const BString &url) {
+  BAutolock lock(fResolvedLock);
+  if (fResolved.erase(url) > 0)
+    DEBUG_PRINT("Dropped cached stream URL of %s\n", url.String());
+}
+
+/**
+ * @brief Averages the new measurement into the station's start time, so
+ * one slow connect does not outweigh its history.
+ */
+void RadioStationLibrary::RecordStartTime(const BString &url,
+                                          bigtime_t elapsed) {
+  const int32 ms = (int32)std::min<bigtime_t>(elapsed / 1000, INT32_MAX);
+  int32 index = FindStation(url);
+  if (index < 0)
+    return;
+
+  RadioStation &station = fStations[index];
+  station.startMs = station.startMs > 0
+                        ? (station.startMs * 3 + std::max<int32>(ms, 1)) / 4
+                        : std::max<int32>(ms, 1);
+  DEBUG_PRINT("Station '%s' started in %ld ms (average %ld ms)\n",
+              station.name.String(), (long)ms, (long)station.startMs);
+  _Journal(station);
+}
+
+void RadioStationLibrary::RecordProbe(const BString &url, int32 health,
+                                      int32 latencyMs, int32 bitrateKbps,
+                                      const BString &codec) {
+  int32 index = FindStation(url);
+  if (index < 0)
+    return;
+
+  RadioStation &station = fStations[index];
+  station.health = health;
+  station.latencyMs = latencyMs;
+  station.bitrateKbps = bitrateKbps;
+  station.codec = codec;
+  station.checkedAt = (time_t)real_time_clock();
+}
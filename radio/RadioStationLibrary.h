@@ -1,11 +1,19 @@
 #ifndef BETON_RADIO_STATION_LIBRARY_H
 #define BETON_RADIO_STATION_LIBRARY_H
 
+#include "MediaEntryStore.h"
 #include "RadioStation.h"
+#include <Locker.h>
 #include <Messenger.h>
+#include <OS.h>
 #include <String.h>
+#include <ctime>
+#include <map>
+#include <string>
+#include <utility>
 #include <vector>
-#include <UrlContext.h>
+
+class BMessage;
 
 /**
  * @class RadioStationLibrary
@@ -16,6 +24,15 @@
  *
  * Supports manual station management (add/edit/remove) and
  * import from .m3u and .pls playlist files.
+ *
+ * Imported directories can hold tens of thousands of stations, so stations
+ * are indexed by URL (hash), by genre and by the words of their name, and
+ * single changes are appended to a journal next to the settings file
+ * instead of rewriting it; SaveStations() folds the journal back in.
+ *
+ * The stream URL each station last resolved to is kept with it, so a
+ * station that sits behind a playlist or a redirect can start without
+ * resolving it first. The cache is safe to use from the play thread.
  */
 class RadioStationLibrary {
 public:
@@ -33,7 +50,21 @@ public:
   bool LoadStations();
 
   /**
-   * @brief Saves all stations to the settings file on disk.
+   * @brief Reads the settings file into `archive` for LoadStations(const
+   * BMessage &); touches no library state, so any thread may call it.
+   */
+  static void ReadStations(BMessage &archive);
+
+  /**
+   * @brief Loads stations from an archive read by ReadStations(), then
+   * applies the journal.
+   * @return True if at least one station was loaded.
+   */
+  bool LoadStations(const BMessage &archive);
+
+  /**
+   * @brief Saves all stations to the settings file on disk and empties the
+   * journal.
    * @return True on success.
    */
   bool SaveStations();
@@ -81,20 +112,35 @@ public:
    */
   int32 CountStations() const;
 
+  /**
+   * @brief Index of the station with stream URL `url`.
+   * @return -1 if there is none.
+   */
+  int32 FindStation(const BString &url) const;
+
+  /**
+   * @brief Collects the stations a word of whose name, or whose genre,
+   * starts with `query`, case- and accent-insensitively.
+   * @param indexes Receives the station indexes in ascending order.
+   */
+  void Search(const BString &query, std::vector<int32> &indexes);
+
   ///@}
 
   /** @name Import */
   ///@{
 
   /**
-   * @brief Imports stations from an .m3u file.
+   * @brief Imports stations from an .m3u file; URLs already in the
+   * library are skipped.
    * @param path Path to the .m3u file.
    * @return Number of stations imported.
    */
   int32 ImportM3U(const char *path);
 
   /**
-   * @brief Imports stations from a .pls file.
+   * @brief Imports stations from a .pls file; URLs already in the library
+   * are skipped.
    * @param path Path to the .pls file.
    * @return Number of stations imported.
    */
@@ -106,19 +152,89 @@ public:
    * @brief Resolves a playlist URL (.m3u/.pls) to its first stream URL.
    *
    * @param url The input URL.
+   * @param mirrors Optional output: every stream URL of the playlist, the
+   * returned one first; left empty for a direct stream.
    * @return The resolved direct stream URL.
    */
-  BString ResolveStreamUrl(const BString &url);
+  BString ResolveStreamUrl(const BString &url,
+                           std::vector<BString> *mirrors = nullptr);
+
+  /**
+   * @brief Connects to all `urls` at once and returns the first that sends
+   * stream data; the others are abandoned.
+   * @return Empty if none answered within `timeout`.
+   */
+  static BString FirstRespondingUrl(const std::vector<BString> &urls,
+                                    bigtime_t timeout);
+
+  /** @name Resolved URL Cache */
+  ///@{
+
+  /// Age after which a cached URL is still tried, but resolved again too.
+  static const time_t kResolvedTtl = 24 * 60 * 60;
+
+  /**
+   * @brief The stream URL station URL `url` resolved to last time.
+   * @param fresh Set to false when the entry is older than kResolvedTtl.
+   * @return False if nothing is cached.
+   */
+  bool CachedStreamUrl(const BString &url, BString &resolved, bool &fresh);
+  /** @brief Remembers `resolved` for `url`; saved with the stations. */
+  void StoreResolvedUrl(const BString &url, const BString &resolved);
+  /** @brief Forgets the URL cached for `url`, after it failed to play. */
+  void InvalidateResolvedUrl(const BString &url);
+
+  ///@}
+
+  /**
+   * @brief Folds one measured time to first audio into the station with
+   * stream URL `url` and journals it.
+   */
+  void RecordStartTime(const BString &url, bigtime_t elapsed);
+
+  /**
+   * @brief Stores a RadioStationProber result in the station with stream
+   * URL `url`; saved with the next SaveStations().
+   */
+  void RecordProbe(const BString &url, int32 health, int32 latencyMs,
+                   int32 bitrateKbps, const BString &codec);
 
 private:
   /**
    * @brief Determines the full path to the radio settings file.
    */
-  BString _SettingsPath() const;
+  static BString _SettingsPath();
+  BString _JournalPath() const;
+
+  static void _Archive(const RadioStation &station, BMessage &archive);
+  static RadioStation _Unarchive(const BMessage &archive);
+
+  /** @brief Appends `station` to the journal; compacts a long journal. */
+  void _Journal(const RadioStation &station);
+  /** @brief Applies the journal written since the last SaveStations(). */
+  void _ReplayJournal();
+
+  /** @brief Appends `station` and indexes it. */
+  void _Append(const RadioStation &station);
+  void _IndexStation(int32 index);
+  void _RebuildIndexes();
+
+  struct ResolvedUrl {
+    BString url;
+    time_t resolvedAt = 0; ///< real_time_clock() seconds
+  };
+
+  typedef std::pair<std::string, int32> NameKey; ///< Folded word, index
 
   BMessenger fTarget;
   std::vector<RadioStation> fStations;
-  BPrivate::Network::BUrlContext fUrlContext;
+  MediaPathIndex fUrlIndex;                           ///< URL -> index
+  std::vector<NameKey> fNameIndex;                    ///< Sorted when searched
+  bool fNameIndexSorted = true;
+  std::map<std::string, std::vector<int32>> fGenres;  ///< Folded genre
+  int32 fJournalRecords = 0;
+  BLocker fResolvedLock{"radio resolved urls"};
+  std::map<BString, ResolvedUrl> fResolved; ///< By station URL
 };
 
 #endif // BETON_RADIO_STATION_LIBRARY_H
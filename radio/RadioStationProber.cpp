@@ -0,0 +1,313 @@
+#include "RadioStationProber.h"
+
+#include "Debug.h"
+#include "HttpConnectionPool.h"
+#include "Messages.h"
+#include "RadioStation.h"
+#include "RadioStationLibrary.h"
+
+#include <Autolock.h>
+#include <Message.h>
+
+#include <cstdlib>
+#include <cstring>
+#include <utility>
+
+/** @brief How often a worker looks again whether probing may go on. */
+static const bigtime_t kIdleRecheck = 500000;
+/** @brief Longest HLS playlist read to check it. */
+static const size_t kPlaylistProbeBytes = 64 * 1024;
+
+namespace {
+
+/** @brief Value of header `name` in `headers`, empty if it is not there. */
+BString HeaderValue(const BString &headers, const char *name) {
+  BString prefix(name);
+  prefix << ":";
+  int32 start = 0;
+  while (start < headers.Length()) {
+    int32 end = headers.FindFirst("\r\n", start);
+    if (end < 0)
+      end = headers.Length();
+    BString line;
+    headers.CopyInto(line, start, end - start);
+    if (line.IStartsWith(prefix)) {
+      line.Remove(0, prefix.Length());
+      line.Trim();
+      return line;
+    }
+    start = end + 2;
+  }
+  return BString();
+}
+
+/** @brief Length of the MPEG audio frame with header `h`, 0 if invalid. */
+int32 MpegFrame(const uint8 *h, int32 &bitrateKbps) {
+  static const int32 kMpeg1Layer3[] = {0,   32,  40,  48,  56,  64,  80, 96,
+                                       112, 128, 160, 192, 224, 256, 320};
+  static const int32 kMpeg2Layer3[] = {0,  8,  16, 24,  32,  40,  48, 56,
+                                       64, 80, 96, 112, 128, 144, 160};
+  static const int32 kRates[] = {44100, 48000, 32000};
+
+  if (h[0] != 0xFF || (h[1] & 0xE0) != 0xE0)
+    return 0;
+  const int32 version = (h[1] >> 3) & 3; // 3 MPEG-1, 2 MPEG-2, 0 MPEG-2.5
+  const int32 layer = (h[1] >> 1) & 3;   // 1 is Layer III
+  const int32 index = h[2] >> 4;
+  const int32 rateIndex = (h[2] >> 2) & 3;
+  if (version == 1 || layer != 1 || index == 0 || index == 15 ||
+      rateIndex == 3) {
+    return 0;
+  }
+
+  const bool mpeg1 = version == 3;
+  int32 rate = kRates[rateIndex];
+  if (!mpeg1)
+    rate /= version == 2 ? 2 : 4;
+  bitrateKbps = mpeg1 ? kMpeg1Layer3[index] : kMpeg2Layer3[index];
+  const int32 padding = (h[2] >> 1) & 1;
+  return (mpeg1 ? 144 : 72) * bitrateKbps * 1000 / rate + padding;
+}
+
+/** @brief Length of the ADTS (AAC) frame with header `h`, 0 if invalid. */
+int32 AdtsFrame(const uint8 *h) {
+  if (h[0] != 0xFF || (h[1] & 0xF6) != 0xF0)
+    return 0;
+  const int32 length = ((h[3] & 3) << 11) | (h[4] << 3) | (h[5] >> 5);
+  return length >= 7 ? length : 0;
+}
+
+/**
+ * @brief Codec of the stream starting with `data`; for MP3 also its bitrate.
+ *
+ * A frame sync only counts when another one follows where the frame ends,
+ * as the stream is joined in the middle of a frame.
+ */
+BString SniffCodec(const std::vector<uint8> &data, int32 &bitrateKbps) {
+  const size_t size = data.size();
+  if (size >= 4 && memcmp(data.data(), "OggS", 4) == 0)
+    return "Ogg";
+  if (size >= 4 && memcmp(data.data(), "fLaC", 4) == 0)
+    return "FLAC";
+
+  for (size_t i = 0; i + 6 <= size; i++) {
+    int32 kbps = 0;
+    int32 length = MpegFrame(&data[i], kbps);
+    if (length > 0 && i + length + 4 <= size) {
+      int32 nextKbps = 0;
+      if (MpegFrame(&data[i + length], nextKbps) > 0) {
+        bitrateKbps = kbps;
+        return "MP3";
+      }
+    }
+    length = AdtsFrame(&data[i]);
+    if (length > 0 && i + length + 7 <= size &&
+        AdtsFrame(&data[i + length]) > 0) {
+      return "AAC";
+    }
+  }
+  return BString();
+}
+
+/** @brief Codec named by a Content-Type, empty if it names none. */
+BString CodecOfType(BString type) {
+  type.ToLower();
+  if (type.FindFirst("mpeg") >= 0 || type.FindFirst("mp3") >= 0)
+    return "MP3";
+  if (type.FindFirst("aac") >= 0 || type.FindFirst("mp4") >= 0)
+    return "AAC";
+  if (type.FindFirst("ogg") >= 0 || type.FindFirst("opus") >= 0)
+    return "Ogg";
+  if (type.FindFirst("flac") >= 0)
+    return "FLAC";
+  return BString();
+}
+
+bool IsHlsUrl(BString url) {
+  int32 query = url.FindFirst('?');
+  if (query >= 0)
+    url.Truncate(query);
+  return url.IEndsWith(".m3u8");
+}
+
+} // namespace
+
+RadioStationProber::RadioStationProber(RadioStationLibrary *library,
+                                       BMessenger target,
+                                       std::function<bool()> isIdle)
+    : fLibrary(library), fTarget(target), fIsIdle(std::move(isIdle)),
+      fWork(create_sem(0, "radio probe work")) {}
+
+RadioStationProber::~RadioStationProber() { Stop(); }
+
+void RadioStationProber::Enqueue(const BString &url) {
+  if (url.IsEmpty() || fWork < 0 || fQuit.load(std::memory_order_relaxed))
+    return;
+
+  BAutolock lock(&fLock);
+  if (!fPending.insert(url).second)
+    return;
+  fQueue.push_back(url);
+
+  // Workers are started with the first station to check.
+  if (fWorkers.empty()) {
+    for (int32 i = 0; i < kConcurrency; i++) {
+      thread_id thread =
+          spawn_thread(_WorkerEntry, "radio probe", B_LOW_PRIORITY, this);
+      if (thread < 0)
+        break;
+      fWorkers.push_back(thread);
+      resume_thread(thread);
+    }
+  }
+  release_sem(fWork);
+}
+
+void RadioStationProber::Stop() {
+  fQuit.store(true, std::memory_order_relaxed);
+
+  std::vector<thread_id> workers;
+  {
+    BAutolock lock(&fLock);
+    workers.swap(fWorkers);
+    fQueue.clear();
+    fPending.clear();
+  }
+  // Wakes the waiting workers; running probes see fQuit through the cancel
+  // flag of their request.
+  if (fWork >= 0) {
+    delete_sem(fWork);
+    fWork = -1;
+  }
+  for (thread_id thread : workers) {
+    status_t exitValue;
+    wait_for_thread(thread, &exitValue);
+  }
+}
+
+int32 RadioStationProber::_WorkerEntry(void *arg) {
+  static_cast<RadioStationProber *>(arg)->_Work();
+  return 0;
+}
+
+void RadioStationProber::_Work() {
+  for (;;) {
+    status_t status = acquire_sem(fWork);
+    if (status == B_INTERRUPTED)
+      continue;
+    if (status != B_OK)
+      break;
+
+    while (!fQuit.load(std::memory_order_relaxed) && fIsIdle && !fIsIdle())
+      snooze(kIdleRecheck);
+    if (fQuit.load(std::memory_order_relaxed))
+      break;
+
+    BString url;
+    {
+      BAutolock lock(&fLock);
+      if (fQueue.empty())
+        continue;
+      url = fQueue.front();
+      fQueue.pop_front();
+      fBusy++;
+    }
+
+    BMessage result(MSG_RADIO_PROBED);
+    _Probe(url, result);
+
+    bool done;
+    {
+      BAutolock lock(&fLock);
+      fBusy--;
+      fPending.erase(url);
+      done = fQueue.empty() && fBusy == 0;
+    }
+    if (fQuit.load(std::memory_order_relaxed))
+      break;
+
+    fTarget.SendMessage(&result);
+    if (done)
+      fTarget.SendMessage(MSG_RADIO_PROBE_DONE);
+  }
+}
+
+/**
+ * @brief Resolves `url` and reads the start of the stream; fills `result`
+ * with "url", "health", "latency" (ms), "bitrate" (kbps) and "codec".
+ */
+void RadioStationProber::_Probe(const BString &url, BMessage &result) {
+  int32 health = RadioStation::kHealthOffline;
+  int32 latencyMs = 0;
+  int32 bitrateKbps = 0;
+  BString codec;
+
+  BString resolved;
+  bool fresh = false;
+  if (!fLibrary->CachedStreamUrl(url, resolved, fresh) || !fresh) {
+    resolved = fLibrary->ResolveStreamUrl(url);
+    if (!fQuit.load(std::memory_order_relaxed))
+      fLibrary->StoreResolvedUrl(url, resolved);
+  }
+
+  if (resolved == "ERR:UNSUPPORTED") {
+    health = RadioStation::kHealthUnsupported;
+  } else if (!resolved.IsEmpty() && resolved != "ERR:CONNECTION") {
+    const bool hls = IsHlsUrl(resolved);
+
+    HttpConnectionPool::Request request;
+    request.url = resolved;
+    request.userAgent = "Beton/1.0 (Haiku OS; VLC-like)";
+    request.maxRedirects = 5;
+    // A live stream never ends; its first bytes are enough.
+    request.maxBytes = hls ? kPlaylistProbeBytes : kProbeBytes;
+    request.timeout = kProbeTimeout;
+    request.cancel = &fQuit;
+    HttpConnectionPool::Response response;
+    status_t status = HttpConnectionPool::Default().Fetch(request, response);
+
+    if (status == B_OK && response.status >= 200 && response.status < 300 &&
+        !response.body.empty()) {
+      latencyMs = (int32)(response.replyTime / 1000);
+      BString type = response.contentType;
+      type.ToLower();
+
+      if (hls || type.FindFirst("mpegurl") >= 0) {
+        BString playlist((const char *)response.body.data(),
+                         response.body.size());
+        if (playlist.StartsWith("#EXTM3U")) {
+          health = RadioStation::kHealthOk;
+          codec = "HLS";
+          int32 bandwidth = playlist.FindFirst("BANDWIDTH=");
+          if (bandwidth >= 0)
+            bitrateKbps = atoi(playlist.String() + bandwidth + 10) / 1000;
+        } else {
+          health = RadioStation::kHealthUnsupported;
+        }
+      } else if (type.FindFirst("text/html") >= 0) {
+        health = RadioStation::kHealthUnsupported;
+      } else {
+        health = RadioStation::kHealthOk;
+        codec = SniffCodec(response.body, bitrateKbps);
+        if (codec.IsEmpty())
+          codec = CodecOfType(type);
+        BString icyBitrate = HeaderValue(response.headers, "icy-br");
+        if (!icyBitrate.IsEmpty() && atoi(icyBitrate.String()) > 0)
+          bitrateKbps = atoi(icyBitrate.String());
+      }
+
+      if (health == RadioStation::kHealthOk && response.replyTime > kSlowReply)
+        health = RadioStation::kHealthSlow;
+    }
+  }
+
+  DEBUG_PRINT("RadioStationProber: %s health=%ld latency=%ld ms %ld kbps %s\n",
+              url.String(), (long)health, (long)latencyMs, (long)bitrateKbps,
+              codec.String());
+
+  result.AddString("url", url);
+  result.AddInt32("health", health);
+  result.AddInt32("latency", latencyMs);
+  result.AddInt32("bitrate", bitrateKbps);
+  result.AddString("codec", codec);
+}
@@ -0,0 +1,69 @@
+#ifndef BETON_RADIO_STATION_PROBER_H
+#define BETON_RADIO_STATION_PROBER_H
+
+#include <Locker.h>
+#include <Messenger.h>
+#include <OS.h>
+#include <String.h>
+#include <SupportDefs.h>
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <set>
+#include <vector>
+
+class BMessage;
+class RadioStationLibrary;
+
+/**
+ * @class RadioStationProber
+ * @brief Checks radio stations in the background, so a dead stream shows in
+ * the list before anyone clicks it.
+ *
+ * kConcurrency low priority workers take station URLs from a queue, resolve
+ * each one like playback does and read the first kProbeBytes of the stream.
+ * The reply gives the latency, the headers or the first frame the bitrate,
+ * and the first bytes the codec. Each result is posted as MSG_RADIO_PROBED,
+ * and MSG_RADIO_PROBE_DONE follows when the queue ran empty; the window
+ * stores them in the RadioStation.
+ *
+ * Workers only start a probe while `isIdle` says so, so probing does not
+ * compete with a station being started or streamed.
+ */
+class RadioStationProber {
+public:
+  static const int32 kConcurrency = 4;
+  static const size_t kProbeBytes = 16 * 1024;
+  static const bigtime_t kProbeTimeout = 8000000;
+  /// A reply slower than this marks the station kHealthSlow.
+  static const bigtime_t kSlowReply = 2000000;
+
+  RadioStationProber(RadioStationLibrary *library, BMessenger target,
+                     std::function<bool()> isIdle);
+  ~RadioStationProber();
+
+  /** @brief Queues `url` unless it is queued or being probed already. */
+  void Enqueue(const BString &url);
+
+  /** @brief Cancels running probes and joins the workers. */
+  void Stop();
+
+private:
+  static int32 _WorkerEntry(void *arg);
+  void _Work();
+  void _Probe(const BString &url, BMessage &result);
+
+  RadioStationLibrary *fLibrary;
+  BMessenger fTarget;
+  std::function<bool()> fIsIdle;
+
+  BLocker fLock{"radio prober"}; ///< Guards the queue and fBusy
+  std::deque<BString> fQueue;
+  std::set<BString> fPending; ///< Queued or being probed
+  int32 fBusy = 0;
+  sem_id fWork;
+  std::atomic<bool> fQuit{false};
+  std::vector<thread_id> fWorkers;
+};
+
+#endif // BETON_RADIO_STATION_PROBER_H
@@ -1,6 +1,7 @@
 #include "SettingsController.h"
 
 #include "Config.h"
+#include "Debug.h"
 #include "MediaTableView.h"
 #include "DLNAViewController.h"
 #include "DLNAService.h"
@@ -12,40 +13,123 @@
 #include "PlaylistLibrary.h"
 #include "RadioStationLibrary.h"
 
+#include <Autolock.h>
 #include <Button.h>
+#include <Entry.h>
 #include <File.h>
 #include <FindDirectory.h>
 #include <InterfaceDefs.h>
 #include <MenuItem.h>
 #include <Message.h>
+#include <MessageRunner.h>
 #include <Path.h>
 #include <Slider.h>
+#include <string.h>
 #include <vector>
 
-SettingsController::SettingsController(MainWindow *window) : fWindow(window) {}
+/** @brief Delay between the first unsaved change and the write. */
+static const bigtime_t kSaveDelay = 1000000;
+
+SettingsController::SettingsController(MainWindow *window)
+    : fWindow(window), fSaveRunner(nullptr), fPendingLock("settings save"),
+      fHasPending(false), fWriterQueued(false) {}
+
+SettingsController::~SettingsController() { delete fSaveRunner; }
 
 /**
- * @brief Persists current application settings to `~/config/settings/Beton/settings`.
+ * @brief Persists current application settings to
+ * `~/config/settings/BeTon/settings`, at most once per kSaveDelay.
  */
 void SettingsController::SaveSettings() {
+  if (fSaveRunner != nullptr)
+    return;
+
+  BMessage flush(MSG_SETTINGS_FLUSH);
+  fSaveRunner = new BMessageRunner(BMessenger(fWindow), &flush, kSaveDelay, 1);
+  if (fSaveRunner->InitCheck() != B_OK)
+    FlushSettings();
+}
+
+/**
+ * @brief Builds the state on the window thread, which owns it, and leaves
+ * the flattening and the disk to a worker.
+ */
+void SettingsController::FlushSettings() {
+  delete fSaveRunner;
+  fSaveRunner = nullptr;
+
   if (!fWindow || !fWindow->fLibraryManager ||
       !fWindow->fLibraryManager->ContentView()) {
     return;
   }
 
-  BPath settingsPath;
-  if (find_directory(B_USER_SETTINGS_DIRECTORY, &settingsPath) == B_OK) {
-    settingsPath.Append("BeTon/settings");
-    BFile file(settingsPath.Path(),
-               B_WRITE_ONLY | B_CREATE_FILE | B_ERASE_FILE);
-    if (file.InitCheck() == B_OK) {
-      BMessage state;
-      SaveSettingsToMessage(state);
-      state.Flatten(&file);
+  BMessage state;
+  SaveSettingsToMessage(state);
+  {
+    BAutolock lock(fPendingLock);
+    fPendingState = state;
+    fHasPending = true;
+    if (fWriterQueued)
+      return;
+    fWriterQueued = true;
+  }
+
+  if (fWindow->QueueJob(kLaneBackground, "save settings",
+                        [this]() { _WritePending(); })
+          .Get() == nullptr) {
+    _WritePending();
+  }
+}
+
+void SettingsController::_WritePending() {
+  for (;;) {
+    BMessage state;
+    {
+      BAutolock lock(fPendingLock);
+      if (!fHasPending) {
+        fWriterQueued = false;
+        return;
+      }
+      state = fPendingState;
+      fPendingState.MakeEmpty();
+      fHasPending = false;
     }
+    status_t status = _WriteSettings(state);
+    if (status != B_OK)
+      DEBUG_PRINT("Saving settings failed: %s\n", strerror(status));
   }
 }
 
+/**
+ * @brief Writes `state` to `settings.tmp` and moves that over the settings
+ * file, so a crash never leaves a half written file behind.
+ */
+status_t SettingsController::_WriteSettings(const BMessage &state) {
+  BPath settingsPath;
+  status_t status = find_directory(B_USER_SETTINGS_DIRECTORY, &settingsPath);
+  if (status != B_OK)
+    return status;
+  settingsPath.Append("BeTon/settings");
+
+  BString tempPath = settingsPath.Path();
+  tempPath << ".tmp";
+  BFile file(tempPath.String(), B_WRITE_ONLY | B_CREATE_FILE | B_ERASE_FILE);
+  status = file.InitCheck();
+  if (status != B_OK)
+    return status;
+  status = state.Flatten(&file);
+  if (status == B_OK)
+    status = file.Sync();
+  file.Unset();
+
+  BEntry temp(tempPath.String());
+  if (status == B_OK)
+    status = temp.Rename(settingsPath.Leaf(), true);
+  if (status != B_OK)
+    temp.Remove();
+  return status;
+}
+
 /**
  * @brief Serializes runtime/UI settings into a persistable BMessage.
  */
@@ -78,8 +162,20 @@ void SettingsController::SaveSettingsToMessage(BMessage &state) {
     state.AddInt32("repeat_mode",
                    fWindow->fPlaybackQueueManager->RepeatModeValue());
   }
+  state.AddInt32("crossfade_seconds", fWindow->fCrossfadeSeconds);
+  state.AddInt32("output_rate", fWindow->fOutputRate);
+  state.AddInt32("stream_quality_kbps", fWindow->fStreamQualityKbps);
+  state.AddInt32("time_shift_minutes", fWindow->fTimeShiftMinutes);
+  state.AddBool("radio_record_library", fWindow->fRecordToLibrary);
+  state.AddInt32("normalization_mode", fWindow->fNormalizationMode);
+  BMessage dsp;
+  fWindow->fDspSettings.Archive(&dsp);
+  state.AddMessage("dsp", &dsp);
+  state.AddBool("loudness_write_files", fWindow->fLoudnessWriteFiles);
   state.AddBool("show_tooltips", fWindow->fShowTooltips);
   state.AddBool("fast_edit_enabled", fWindow->fFastEditEnabled);
+  state.AddInt32("scan_tag_readers", fWindow->fScanTagReaders);
+  state.AddInt32("scan_walkers_per_device", fWindow->fScanWalkersPerDevice);
 
   if (fWindow->fIsMuted) {
     state.AddInt32("volume_level", (int32)fWindow->fPreMuteVolume);
@@ -121,28 +217,52 @@ void SettingsController::SaveSettingsToMessage(BMessage &state) {
     state.AddString("active_dlna_uuid", fWindow->fActiveDlnaServer.uuid);
 }
 
+void SettingsController::ReadSettings(BMessage &state) {
+  BPath settingsPath;
+  if (find_directory(B_USER_SETTINGS_DIRECTORY, &settingsPath) != B_OK)
+    return;
+  settingsPath.Append("BeTon/settings");
+  BFile file(settingsPath.Path(), B_READ_ONLY);
+  if (file.InitCheck() != B_OK || state.Unflatten(&file) != B_OK)
+    state.MakeEmpty();
+}
+
 /**
- * @brief Loads persisted settings and applies them to active window state.
+ * @brief Applies persisted settings to active window state.
+ *
+ * The playlist sidebar, radio stations and discovery follow separately,
+ * see ApplyPlaylists(), ApplyStations() and StartDiscovery().
  */
-void SettingsController::LoadSettings() {
+void SettingsController::ApplySettings(BMessage &state) {
   if (!fWindow || !fWindow->fLibraryManager ||
       !fWindow->fLibraryManager->ContentView()) {
     return;
   }
 
-  BPath settingsPath;
-  if (find_directory(B_USER_SETTINGS_DIRECTORY, &settingsPath) == B_OK) {
-    settingsPath.Append("BeTon/settings");
-    BFile file(settingsPath.Path(), B_READ_ONLY);
-    if (file.InitCheck() == B_OK) {
-      BMessage state;
-
-      if (state.Unflatten(&file) == B_OK)
-        LoadSettingsFromMessage(state);
+  if (!state.IsEmpty())
+    LoadSettingsFromMessage(state);
+
+#if ENABLE_DLNA_OUTPUT
+  fWindow->_SetOutputMenuVisible(fWindow->fDlnaEnabled);
+#endif
+
+  if (fWindow->fPlaylistPath.IsEmpty()) {
+    BPath path;
+    if (find_directory(B_USER_SETTINGS_DIRECTORY, &path) == B_OK) {
+      path.Append("BeTon/Playlists");
+      fWindow->fPlaylistPath = path.Path();
     }
   }
 
-  ApplyLoadedSettings();
+  if (fWindow->fPlaylistLibrary && !fWindow->fPlaylistPath.IsEmpty())
+    fWindow->fPlaylistLibrary->SetPlaylistFolderPath(fWindow->fPlaylistPath);
+
+  if (!fWindow->fDlnaEnabled) {
+    if (fWindow->fDlnaManager)
+      fWindow->fDlnaManager->StopDiscovery();
+    if (fWindow->fDlnaController)
+      fWindow->fDlnaController->SetServerFieldVisible(false);
+  }
 }
 
 /**
@@ -223,6 +343,57 @@ void SettingsController::LoadSettingsFromMessage(BMessage &state) {
       fWindow->fPlaybackQueueManager->SetRepeatModeValue(repeatMode);
   }
 
+  int32 crossfade = 0;
+  if (state.FindInt32("crossfade_seconds", &crossfade) == B_OK) {
+    BMessage setCrossfade(MSG_SET_CROSSFADE);
+    setCrossfade.AddInt32("seconds", crossfade);
+    fWindow->PostMessage(&setCrossfade);
+  }
+
+  int32 outputRate = 0;
+  if (state.FindInt32("output_rate", &outputRate) == B_OK) {
+    BMessage setOutputRate(MSG_SET_OUTPUT_RATE);
+    setOutputRate.AddInt32("rate", outputRate);
+    fWindow->PostMessage(&setOutputRate);
+  }
+
+  int32 streamQuality = 0;
+  if (state.FindInt32("stream_quality_kbps", &streamQuality) == B_OK) {
+    BMessage setStreamQuality(MSG_SET_STREAM_QUALITY);
+    setStreamQuality.AddInt32("kbps", streamQuality);
+    fWindow->PostMessage(&setStreamQuality);
+  }
+
+  int32 timeShift = 0;
+  if (state.FindInt32("time_shift_minutes", &timeShift) == B_OK) {
+    BMessage setTimeShift(MSG_SET_TIME_SHIFT);
+    setTimeShift.AddInt32("minutes", timeShift);
+    fWindow->PostMessage(&setTimeShift);
+  }
+
+  int32 normalization = 0;
+  if (state.FindInt32("normalization_mode", &normalization) == B_OK) {
+    BMessage setNormalization(MSG_SET_NORMALIZATION);
+    setNormalization.AddInt32("mode", normalization);
+    fWindow->PostMessage(&setNormalization);
+  }
+
+  BMessage dsp;
+  if (state.FindMessage("dsp", &dsp) == B_OK) {
+    dsp.what = MSG_SET_DSP;
+    fWindow->PostMessage(&dsp);
+  }
+
+  if (state.FindBool("radio_record_library", &fWindow->fRecordToLibrary) ==
+          B_OK &&
+      fWindow->fRecordLibraryItem)
+    fWindow->fRecordLibraryItem->SetMarked(fWindow->fRecordToLibrary);
+
+  if (state.FindBool("loudness_write_files", &fWindow->fLoudnessWriteFiles) ==
+          B_OK &&
+      fWindow->fLoudnessWriteItem)
+    fWindow->fLoudnessWriteItem->SetMarked(fWindow->fLoudnessWriteFiles);
+
   if (state.FindBool("show_tooltips", &fWindow->fShowTooltips) == B_OK) {
     if (fWindow->fTooltipsOnItem)
       fWindow->fTooltipsOnItem->SetMarked(fWindow->fShowTooltips);
@@ -245,6 +416,21 @@ void SettingsController::LoadSettingsFromMessage(BMessage &state) {
     }
   }
 
+  if (state.FindInt32("scan_tag_readers", &fWindow->fScanTagReaders) == B_OK &&
+      fWindow->fMediaLibraryCache) {
+    BMessage readers(MSG_SET_TAG_READERS);
+    readers.AddInt32("count", fWindow->fScanTagReaders);
+    BMessenger(fWindow->fMediaLibraryCache).SendMessage(&readers);
+  }
+
+  if (state.FindInt32("scan_walkers_per_device",
+                      &fWindow->fScanWalkersPerDevice) == B_OK &&
+      fWindow->fMediaLibraryCache) {
+    BMessage walkers(MSG_SET_SCAN_WALKERS);
+    walkers.AddInt32("count", fWindow->fScanWalkersPerDevice);
+    BMessenger(fWindow->fMediaLibraryCache).SendMessage(&walkers);
+  }
+
   int32 volLevel;
   if (state.FindInt32("volume_level", &volLevel) == B_OK) {
     if (fWindow->fVolumeSlider)
@@ -273,55 +459,39 @@ void SettingsController::LoadSettingsFromMessage(BMessage &state) {
   state.FindString("active_dlna_uuid", &fWindow->fInitialDlnaUuid);
 }
 
-/**
- * @brief Applies post-load settings that depend on initialized UI/controllers.
- */
-void SettingsController::ApplyLoadedSettings() {
-#if ENABLE_DLNA_OUTPUT
-  fWindow->_SetOutputMenuVisible(fWindow->fDlnaEnabled);
-#endif
-
-  if (fWindow->fPlaylistPath.IsEmpty()) {
-    BPath path;
-    if (find_directory(B_USER_SETTINGS_DIRECTORY, &path) == B_OK) {
-      path.Append("BeTon/Playlists");
-      fWindow->fPlaylistPath = path.Path();
-    }
-  }
+void SettingsController::ApplyPlaylists(const BMessage &files) {
+  if (!fWindow->fPlaylistLibrary)
+    return;
 
-  if (fWindow->fPlaylistLibrary && !fWindow->fPlaylistPath.IsEmpty()) {
-    fWindow->fPlaylistLibrary->SetPlaylistFolderPath(fWindow->fPlaylistPath);
-    fWindow->fPlaylistLibrary->LoadAvailablePlaylists();
+  fWindow->fPlaylistLibrary->AddAvailablePlaylists(files);
 
-    // Apply saved ordering only !!after!! sidebar items exist.
-    if (!fWindow->fPendingPlaylistOrder.empty()) {
-      fWindow->fPlaylistLibrary->View()->SetPlaylistOrder(
-          fWindow->fPendingPlaylistOrder);
-      fWindow->fPendingPlaylistOrder.clear();
-    }
+  // Apply saved ordering only !!after!! sidebar items exist.
+  if (!fWindow->fPendingPlaylistOrder.empty()) {
+    fWindow->fPlaylistLibrary->View()->SetPlaylistOrder(
+        fWindow->fPendingPlaylistOrder);
+    fWindow->fPendingPlaylistOrder.clear();
   }
 
   if (!fWindow->fRadioEnabled) {
     int32 idx = fWindow->fPlaylistLibrary->View()->FindIndexByName("Radio");
     if (idx >= 0)
       fWindow->fPlaylistLibrary->View()->RemovePlaylistAt(idx);
-  } else {
-    if (fWindow->fRadioStationLibrary &&
-        fWindow->fRadioStationLibrary->AllStations().empty()) {
-      fWindow->fRadioStationLibrary->LoadStations();
-    }
   }
-
   if (!fWindow->fDlnaEnabled) {
-    if (fWindow->fDlnaManager)
-      fWindow->fDlnaManager->StopDiscovery();
     int32 idx = fWindow->fPlaylistLibrary->View()->FindIndexByName("DLNA");
     if (idx >= 0)
       fWindow->fPlaylistLibrary->View()->RemovePlaylistAt(idx);
-    if (fWindow->fDlnaController)
-      fWindow->fDlnaController->SetServerFieldVisible(false);
-  } else {
-    if (fWindow->fDlnaManager)
-      fWindow->fDlnaManager->StartDiscovery();
   }
 }
+
+void SettingsController::ApplyStations(const BMessage &archive) {
+  if (fWindow->fRadioEnabled && fWindow->fRadioStationLibrary &&
+      fWindow->fRadioStationLibrary->AllStations().empty()) {
+    fWindow->fRadioStationLibrary->LoadStations(archive);
+  }
+}
+
+void SettingsController::StartDiscovery() {
+  if (fWindow->fDlnaEnabled && fWindow->fDlnaManager)
+    fWindow->fDlnaManager->StartDiscovery();
+}
@@ -1,7 +1,10 @@
 #ifndef SETTINGS_CONTROLLER_H
 #define SETTINGS_CONTROLLER_H
 
-class BMessage;
+#include <Locker.h>
+#include <Message.h>
+
+class BMessageRunner;
 class MainWindow;
 
 /**
@@ -11,15 +14,42 @@ class MainWindow;
 class SettingsController {
 public:
   explicit SettingsController(MainWindow *window);
+  ~SettingsController();
 
   /**
-   * @brief Serializes current runtime settings to disk.
+   * @brief Schedules a save; changes within the next second are written
+   * together.
    */
   void SaveSettings();
   /**
-   * @brief Loads settings from disk and applies them to runtime state/UI.
+   * @brief Snapshots the settings now and hands them to the writer; with
+   * the worker pool shut down, writes them before returning.
+   */
+  void FlushSettings();
+  /**
+   * @brief Reads the settings file into `state`, which stays empty if there
+   * is none. Touches no window state, so any thread may call it.
+   */
+  static void ReadSettings(BMessage &state);
+  /**
+   * @brief Applies settings read by ReadSettings() to runtime state/UI.
+   */
+  void ApplySettings(BMessage &state);
+  /**
+   * @brief Fills the playlist sidebar from a PlaylistLibrary::
+   * ListPlaylistFiles() listing and hides the disabled sources.
+   */
+  void ApplyPlaylists(const BMessage &files);
+  /**
+   * @brief Loads the stations read by RadioStationLibrary::ReadStations()
+   * if radio is enabled and none are loaded yet.
    */
-  void LoadSettings();
+  void ApplyStations(const BMessage &archive);
+  /**
+   * @brief Starts DLNA discovery if enabled; startup defers this until the
+   * window has been drawn.
+   */
+  void StartDiscovery();
 
 private:
   /**
@@ -31,11 +61,19 @@ private:
    */
   void LoadSettingsFromMessage(BMessage &state);
   /**
-   * @brief Applies loaded values that require initialized subsystems/UI.
+   * @brief Writes the pending snapshots until none is left; runs on the
+   * worker pool, one writer at a time.
    */
-  void ApplyLoadedSettings();
+  void _WritePending();
+  static status_t _WriteSettings(const BMessage &state);
 
   MainWindow *fWindow;
+  BMessageRunner *fSaveRunner;
+
+  BLocker fPendingLock; ///< Guards the three members below
+  BMessage fPendingState; ///< Newest snapshot not yet written
+  bool fHasPending;
+  bool fWriterQueued; ///< A job runs or is about to run _WritePending()
 };
 
 #endif // SETTINGS_CONTROLLER_H
@@ -39,10 +39,12 @@ void MetadataSyncController::StartSmartSync() {
   if (!files.empty() && fWindow->fMetadataService) {
     fWindow->UpdateStatus(B_TRANSLATE("Syncing metadata..."), true);
 
-    BMessenger target(fWindow);
     MetadataService *handler = fWindow->fMetadataService;
-    fWindow->LaunchThread("sync_metadata",
-                 [files, target, handler]() { handler->SyncMetadata(files); });
+    const std::atomic<bool> *cancel = &fWindow->fShuttingDown;
+    fWindow->QueueJob(kLaneBackground, "sync_metadata",
+                      [files, handler, cancel]() {
+                        handler->SyncMetadata(files, cancel);
+                      });
   } else if (files.empty()) {
     fWindow->UpdateStatus(B_TRANSLATE("No files selected"), false);
   }
@@ -60,9 +62,17 @@ void MetadataSyncController::UpdateSyncProgress(BMessage *msg) {
 }
 
 void MetadataSyncController::QueueSyncConflict(BMessage *msg) {
-  DEBUG_PRINT("MSG_SYNC_CONFLICT received\n");
-
-  fPendingConflicts.push_back(*msg);
+  // The sync sends its conflicts in batches, one "path" per file.
+  BString path;
+  int32 count = 0;
+  for (; msg->FindString("path", count, &path) == B_OK; count++) {
+    BMessage conflict(MSG_SYNC_CONFLICT);
+    conflict.AddString("path", path);
+    fPendingConflicts.push_back(conflict);
+  }
+  DEBUG_PRINT("MSG_SYNC_CONFLICT received: %ld files\n", (long)count);
+  if (count == 0)
+    return;
 
   if (!fConflictDialogOpen) {
     ShowNextConflictDialog();
@@ -80,9 +90,10 @@ void MetadataSyncController::ResolveSyncConflict(BMessage *msg) {
       msg->FindBool("useTags", &useTags) == B_OK) {
 
     BPath filePath(path.String());
-    TagData tags, bfs;
-    MetadataTagIO::ReadTags(filePath, tags);
-    MetadataTagIO::ReadBfsAttributes(filePath, bfs);
+    FileMetadata meta;
+    MetadataTagIO::ReadFile(filePath, kReadTags | kReadBfs, meta);
+    TagData &tags = meta.tags;
+    TagData &bfs = meta.bfs;
 
     bool directionTowardsBfs = useTags;
     TagData &source = useTags ? tags : bfs;
@@ -115,9 +126,10 @@ void MetadataSyncController::ResolveAllSyncConflicts(BMessage *msg) {
       msg->FindBool("useTags", &useTags) == B_OK) {
 
     BPath currentFilePath(currentPath.String());
-    TagData currentTags, currentBfs;
-    MetadataTagIO::ReadTags(currentFilePath, currentTags);
-    MetadataTagIO::ReadBfsAttributes(currentFilePath, currentBfs);
+    FileMetadata currentMeta;
+    MetadataTagIO::ReadFile(currentFilePath, kReadTags | kReadBfs, currentMeta);
+    TagData &currentTags = currentMeta.tags;
+    TagData &currentBfs = currentMeta.bfs;
 
     bool directionTowardsBfs = useTags;
     TagData &currentSource = useTags ? currentTags : currentBfs;
@@ -131,9 +143,10 @@ void MetadataSyncController::ResolveAllSyncConflicts(BMessage *msg) {
       BString path;
       if (pending.FindString("path", &path) == B_OK) {
         BPath filePath(path.String());
-        TagData tags, bfs;
-        MetadataTagIO::ReadTags(filePath, tags);
-        MetadataTagIO::ReadBfsAttributes(filePath, bfs);
+        FileMetadata meta;
+        MetadataTagIO::ReadFile(filePath, kReadTags | kReadBfs, meta);
+        TagData &tags = meta.tags;
+        TagData &bfs = meta.bfs;
         TagData &source = useTags ? tags : bfs;
 
         MetadataTagIO::ApplySync(filePath, source, directionTowardsBfs);
@@ -172,9 +185,10 @@ void MetadataSyncController::ShowNextConflictDialog() {
   if (pending.FindString("path", &path) == B_OK) {
 
     BPath filePath(path.String());
-    TagData tags, bfs;
-    MetadataTagIO::ReadTags(filePath, tags);
-    MetadataTagIO::ReadBfsAttributes(filePath, bfs);
+    FileMetadata meta;
+    MetadataTagIO::ReadFile(filePath, kReadTags | kReadBfs, meta);
+    TagData &tags = meta.tags;
+    TagData &bfs = meta.bfs;
 
     DEBUG_PRINT("Conflict detected for %s:\n", path.String());
     tags.LogDifferences(bfs);
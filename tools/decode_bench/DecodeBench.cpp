@@ -0,0 +1,348 @@
+/**
+ * @file DecodeBench.cpp
+ * @brief Headless decode throughput benchmark for the playback pipeline.
+ *
+ * Decodes every file of a corpus the way the engine does, without a sound
+ * player, and reports per file and path:
+ * - real-time factor (seconds of audio decoded per second of wall time),
+ * - per-buffer latency percentiles (p50, p90, p99, max),
+ * - heap allocations per buffer (operator new, all threads).
+ *
+ * Two paths are measured:
+ * - "track": LocalMediaFile::Open() and BMediaTrack::ReadFrames() in the
+ *   native decoded format, as the decoder thread reads local files;
+ * - "stream": NetworkAudioStreamIO::ReadPcm() over FFmpeg, as streams and
+ *   HLS segments are played. Its latencies include waiting for the FFmpeg
+ *   thread, like the sound player callback does.
+ * Both then run the engine's gain and fade stage (PcmKernels ramps) and,
+ * with --dsp, the DspChain.
+ *
+ * MIDI files are measured on the track path when they are rendered
+ * (ENABLE_MIDI_RENDERING) and skipped otherwise: BMidiSynthFile plays
+ * straight into the synth, there is no PCM to read.
+ *
+ * Usage: decode_bench [--path track|stream|both] [--dsp] [--debug]
+ *        <file or directory>...
+ */
+
+#include "Debug.h"
+#include "DspChain.h"
+#include "NetworkAudioStreamIO.h"
+#include "PcmKernels.h"
+#include "ReadAheadFile.h"
+
+#include <Application.h>
+#include <Directory.h>
+#include <Entry.h>
+#include <MediaFile.h>
+#include <MediaTrack.h>
+#include <Path.h>
+#include <String.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <new>
+#include <string>
+#include <vector>
+
+bool gIsDebug = false;
+
+/** @name Allocation counting */
+///@{
+static std::atomic<uint64> sAllocations{0};
+
+void *operator new(size_t size) {
+  sAllocations.fetch_add(1, std::memory_order_relaxed);
+  if (void *p = malloc(size > 0 ? size : 1))
+    return p;
+  throw std::bad_alloc();
+}
+void *operator new[](size_t size) { return operator new(size); }
+void *operator new(size_t size, const std::nothrow_t &) noexcept {
+  sAllocations.fetch_add(1, std::memory_order_relaxed);
+  return malloc(size > 0 ? size : 1);
+}
+void *operator new[](size_t size, const std::nothrow_t &tag) noexcept {
+  return operator new(size, tag);
+}
+void operator delete(void *p) noexcept { free(p); }
+void operator delete[](void *p) noexcept { free(p); }
+void operator delete(void *p, size_t) noexcept { free(p); }
+void operator delete[](void *p, size_t) noexcept { free(p); }
+///@}
+
+namespace {
+
+/** @brief Gain the stage applies, like a typical ReplayGain track gain. */
+const float kGain = 0.7f;
+/** @brief Length of the fade-in at the start, as in the engine. */
+const bigtime_t kFadeDuration = 80000;
+
+struct Options {
+  bool track = true;
+  bool stream = true;
+  bool dsp = false;
+};
+
+struct Result {
+  bool ok = false;
+  BString error;
+  double audioSeconds = 0;
+  bigtime_t wall = 0;
+  std::vector<bigtime_t> latencies;
+  uint64 allocations = 0;
+  int64 silentBuffers = 0; ///< Stream path: buffers padded with silence
+};
+
+/** @brief The engine's per-buffer stage: gain, fade-in and DSP. */
+class GainStage {
+public:
+  GainStage(const media_raw_audio_format &format, int64 maxFrames, bool dsp)
+      : fFormat(format) {
+    fFadeFrames = (int64)(kFadeDuration * (double)format.frame_rate / 1e6);
+    fFadeLeft = fFadeFrames;
+    if (dsp) {
+      DspSettings settings;
+      settings.enabled = true;
+      settings.preamp = -3.0f;
+      settings.bands[0].gain = 4.0f;
+      settings.bands[2].gain = -2.0f;
+      settings.bands[4].gain = 3.0f;
+      fDsp.SetSettings(settings);
+      fDsp.Prepare(format, maxFrames);
+    }
+  }
+
+  void Process(void *data, int64 frames) {
+    const int32 channels = (int32)fFormat.channel_count;
+    PcmKernels::ApplyGainRamp(data, fFormat.format, channels, frames, kGain,
+                              0.0f);
+    if (fFadeLeft > 0) {
+      int64 ramp = std::min(frames, fFadeLeft);
+      const float step = 1.0f / fFadeFrames;
+      PcmKernels::ApplyGainRamp(data, fFormat.format, channels, ramp,
+                                (fFadeFrames - fFadeLeft) * step, step);
+      fFadeLeft -= ramp;
+    }
+    fDsp.Process(data, frames);
+  }
+
+private:
+  media_raw_audio_format fFormat;
+  int64 fFadeFrames = 0;
+  int64 fFadeLeft = 0;
+  DspChain fDsp;
+};
+
+size_t FrameSize(const media_raw_audio_format &format) {
+  return (format.format & media_raw_audio_format::B_AUDIO_SIZE_MASK) *
+         format.channel_count;
+}
+
+Result RunTrack(const char *path, const Options &options) {
+  Result result;
+  entry_ref ref;
+  if (get_ref_for_path(path, &ref) != B_OK) {
+    result.error = "no such file";
+    return result;
+  }
+  std::unique_ptr<BMediaFile> file(LocalMediaFile::Open(ref));
+  BMediaTrack *track = file->InitCheck() == B_OK ? file->TrackAt(0) : nullptr;
+  media_format format{};
+  if (track == nullptr || track->DecodedFormat(&format) != B_OK ||
+      format.type != B_MEDIA_RAW_AUDIO) {
+    if (track != nullptr)
+      file->ReleaseTrack(track);
+    result.error = "not decodable by the media kit";
+    return result;
+  }
+
+  const media_raw_audio_format &raw = format.u.raw_audio;
+  const size_t frameSize = FrameSize(raw);
+  const size_t chunkSize = raw.buffer_size > 0 ? raw.buffer_size
+                                               : 4096 * frameSize;
+  std::vector<uint8> chunk(chunkSize);
+  GainStage stage(raw, (int64)(chunkSize / frameSize), options.dsp);
+
+  int64 totalFrames = 0;
+  const uint64 allocationsBefore = sAllocations.load();
+  const bigtime_t start = system_time();
+  for (;;) {
+    int64 frames = (int64)(chunkSize / frameSize);
+    bigtime_t before = system_time();
+    if (track->ReadFrames(chunk.data(), &frames) != B_OK || frames <= 0)
+      break;
+    stage.Process(chunk.data(), frames);
+    result.latencies.push_back(system_time() - before);
+    totalFrames += frames;
+  }
+  result.wall = system_time() - start;
+  result.allocations = sAllocations.load() - allocationsBefore;
+  result.audioSeconds = totalFrames / (double)raw.frame_rate;
+  result.ok = true;
+  file->ReleaseTrack(track);
+  return result;
+}
+
+Result RunStream(const char *path, const Options &options) {
+  Result result;
+  NetworkAudioStreamIO stream((BMessenger()));
+  // ICY: HLS mode retries at EOF, which only makes sense for live lists.
+  if (stream.Open(BString(path), NetworkAudioStreamIO::MODE_ICY) != B_OK) {
+    result.error = "FFmpeg could not open it";
+    return result;
+  }
+  media_raw_audio_format raw;
+  if (stream.WaitForFormat(&raw, 5000000) != B_OK || FrameSize(raw) == 0) {
+    stream.Stop();
+    result.error = "no audio format";
+    return result;
+  }
+
+  const size_t frameSize = FrameSize(raw);
+  const size_t chunkSize = raw.buffer_size > 0 ? raw.buffer_size
+                                               : 4096 * frameSize;
+  std::vector<uint8> chunk(chunkSize);
+  GainStage stage(raw, (int64)(chunkSize / frameSize), options.dsp);
+
+  off_t consumed = 0; ///< Decoded bytes read, silence excluded
+  const uint64 allocationsBefore = sAllocations.load();
+  const bigtime_t start = system_time();
+  for (;;) {
+    bigtime_t before = system_time();
+    ssize_t read = stream.ReadPcm(chunk.data(), chunkSize);
+    if (read < 0)
+      break;
+    stage.Process(chunk.data(), (int64)((size_t)read / frameSize));
+    result.latencies.push_back(system_time() - before);
+    // ReadPcm() pads a short ring with silence; only decoded bytes count.
+    off_t real = std::min<off_t>(consumed + read, stream.DecodedBytes());
+    if (real - consumed < read)
+      result.silentBuffers++;
+    consumed = std::max(consumed, real);
+  }
+  result.wall = system_time() - start;
+  result.allocations = sAllocations.load() - allocationsBefore;
+  result.audioSeconds = stream.DecodedBytes() / (double)frameSize /
+                        raw.frame_rate;
+  result.ok = true;
+  stream.Stop();
+  return result;
+}
+
+bigtime_t Percentile(std::vector<bigtime_t> &values, double fraction) {
+  if (values.empty())
+    return 0;
+  size_t index = std::min(values.size() - 1,
+                          (size_t)(fraction * (values.size() - 1) + 0.5));
+  std::nth_element(values.begin(), values.begin() + index, values.end());
+  return values[index];
+}
+
+void Report(const char *path, const char *kind, Result &result) {
+  if (!result.ok) {
+    printf("%-6s %s: skipped (%s)\n", kind, path, result.error.String());
+    return;
+  }
+  const size_t buffers = result.latencies.size();
+  double rtf = result.wall > 0 ? result.audioSeconds / (result.wall / 1e6)
+                               : 0.0;
+  bigtime_t p50 = Percentile(result.latencies, 0.50);
+  bigtime_t p90 = Percentile(result.latencies, 0.90);
+  bigtime_t p99 = Percentile(result.latencies, 0.99);
+  bigtime_t max = buffers > 0 ? *std::max_element(result.latencies.begin(),
+                                                  result.latencies.end())
+                              : 0;
+  printf("%-6s %s\n", kind, path);
+  printf("       %.1f s audio in %.3f s: %.1fx real time, %zu buffers\n",
+         result.audioSeconds, result.wall / 1e6, rtf, buffers);
+  printf("       latency us: p50 %lld  p90 %lld  p99 %lld  max %lld\n",
+         (long long)p50, (long long)p90, (long long)p99, (long long)max);
+  printf("       allocations/buffer: %.2f", buffers > 0
+         ? result.allocations / (double)buffers : 0.0);
+  if (result.silentBuffers > 0)
+    printf("  silent buffers: %lld", (long long)result.silentBuffers);
+  printf("\n");
+}
+
+bool IsMidi(const BString &path) {
+  BString lower(path);
+  lower.ToLower();
+  return lower.EndsWith(".mid") || lower.EndsWith(".midi");
+}
+
+void Collect(const char *path, std::vector<BString> &files) {
+  BEntry entry(path, true);
+  if (entry.IsDirectory()) {
+    BDirectory directory(&entry);
+    BEntry child;
+    std::vector<BString> children;
+    while (directory.GetNextEntry(&child, true) == B_OK) {
+      BPath childPath;
+      if (child.GetPath(&childPath) == B_OK)
+        children.push_back(BString(childPath.Path()));
+    }
+    // A fixed order keeps runs comparable.
+    std::sort(children.begin(), children.end());
+    for (const BString &childPath : children)
+      Collect(childPath.String(), files);
+  } else if (entry.Exists()) {
+    files.push_back(BString(path));
+  }
+}
+
+void Usage() {
+  fprintf(stderr, "usage: decode_bench [--path track|stream|both] [--dsp] "
+                  "[--debug] <file or directory>...\n");
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  Options options;
+  std::vector<BString> files;
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--dsp") == 0) {
+      options.dsp = true;
+    } else if (strcmp(argv[i], "--debug") == 0) {
+      gIsDebug = true;
+    } else if (strcmp(argv[i], "--path") == 0 && i + 1 < argc) {
+      const char *which = argv[++i];
+      options.track = strcmp(which, "stream") != 0;
+      options.stream = strcmp(which, "track") != 0;
+    } else if (argv[i][0] == '-') {
+      Usage();
+      return 1;
+    } else {
+      Collect(argv[i], files);
+    }
+  }
+  if (files.empty()) {
+    Usage();
+    return 1;
+  }
+
+  // The media kit wants an application for its add-ons.
+  BApplication app("application/x-vnd.Beton-decode-bench");
+
+  for (const BString &path : files) {
+    if (IsMidi(path) && !LocalMediaFile::RendersMidi()) {
+      printf("midi   %s: skipped (played by the synth, no PCM)\n",
+             path.String());
+      continue;
+    }
+    if (options.track) {
+      Result result = RunTrack(path.String(), options);
+      Report(path.String(), "track", result);
+    }
+    if (options.stream && !IsMidi(path)) {
+      Result result = RunStream(path.String(), options);
+      Report(path.String(), "stream", result);
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,434 @@
+/**
+ * @file DidlBench.cpp
+ * @brief Compares DidlParser with the substring parser it replaced, on
+ * ContentDirectory replies.
+ *
+ * Each reply is parsed by both: the old way (find <Result>, unescape it
+ * into a copy, cut each <item>/<container> block out and search it per
+ * field) and with DidlParser fed in --chunk byte pieces, as it is from
+ * the network. Reported per reply: objects, time per parse (median of
+ * --iterations) and heap allocations per parse for both. Any difference in
+ * the parsed objects is printed and makes the exit status 1.
+ *
+ * Replies are recorded with e.g.
+ *   curl -s -H 'SOAPAction: "urn:schemas-upnp-org:service:ContentDirectory:1#Browse"' \
+ *        -H 'Content-Type: text/xml; charset="utf-8"' --data @browse.xml \
+ *        http://<server>:<port>/<control URL> > reply.xml
+ * --synthetic N adds a generated reply of N tracks for a quick run.
+ *
+ * Usage: didl_bench [--chunk bytes] [--iterations N] [--synthetic N]
+ *        <reply.xml>...
+ */
+
+#include "DidlParser.h"
+
+#include <OS.h>
+#include <String.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <string>
+#include <vector>
+
+/** @name Allocation counting */
+///@{
+static std::atomic<uint64> sAllocations{0};
+
+void *operator new(size_t size) {
+  sAllocations.fetch_add(1, std::memory_order_relaxed);
+  if (void *p = malloc(size > 0 ? size : 1))
+    return p;
+  throw std::bad_alloc();
+}
+void *operator new[](size_t size) { return operator new(size); }
+void operator delete(void *p) noexcept { free(p); }
+void operator delete[](void *p) noexcept { free(p); }
+void operator delete(void *p, size_t) noexcept { free(p); }
+void operator delete[](void *p, size_t) noexcept { free(p); }
+///@}
+
+namespace {
+
+/** @name The parser DLNAService used before DidlParser */
+///@{
+BString ExtractXmlTag(const BString &xml, const char *tagName) {
+  int32 start = -1;
+  BString p1;
+  p1 << "<" << tagName;
+  int32 i1 = xml.FindFirst(p1);
+  if (i1 >= 0 &&
+      (xml[i1 + p1.Length()] == '>' || xml[i1 + p1.Length()] == ' '))
+    start = i1 + p1.Length();
+
+  if (start < 0) {
+    BString p2;
+    p2 << ":" << tagName;
+    int32 i2 = xml.FindFirst(p2);
+    if (i2 >= 0 &&
+        (xml[i2 + p2.Length()] == '>' || xml[i2 + p2.Length()] == ' '))
+      start = i2 + p2.Length();
+  }
+
+  if (start < 0)
+    return "";
+
+  if (xml[start] == ' ') {
+    int32 gt = xml.FindFirst('>', start);
+    if (gt < 0)
+      return "";
+    start = gt + 1;
+  } else if (xml[start] == '>') {
+    start++;
+  }
+
+  int32 end = xml.FindFirst("</", start);
+  while (end >= 0) {
+    int32 nextGt = xml.FindFirst('>', end);
+    if (nextGt < 0)
+      break;
+
+    BString closing;
+    xml.CopyInto(closing, end + 2, nextGt - (end + 2));
+    if (closing == tagName || closing.EndsWith(BString(":") << tagName)) {
+      BString result;
+      xml.CopyInto(result, start, end - start);
+      return result;
+    }
+    end = xml.FindFirst("</", end + 2);
+  }
+  return "";
+}
+
+BString UnescapeXml(const BString &escaped) {
+  BString result(escaped);
+  result.ReplaceAll("&lt;", "<");
+  result.ReplaceAll("&gt;", ">");
+  result.ReplaceAll("&amp;", "&");
+  result.ReplaceAll("&quot;", "\"");
+  result.ReplaceAll("&apos;", "'");
+  return result;
+}
+
+/** @brief Value of `name="..."` in `block`, searched from its start. */
+BString Attribute(const BString &block, const char *name) {
+  BString pattern;
+  pattern << name << "=\"";
+  BString value;
+  int32 pos = block.FindFirst(pattern);
+  if (pos >= 0) {
+    int32 start = pos + pattern.Length();
+    int32 end = block.FindFirst('"', start);
+    if (end > start)
+      block.CopyInto(value, start, end - start);
+  }
+  return value;
+}
+
+void LegacyParseDidl(const BString &didl, std::vector<DLNABrowseItem> &items) {
+  int32 pos = 0;
+  while (pos < didl.Length()) {
+    int32 itemStart = didl.FindFirst("<item ", pos);
+    int32 contStart = didl.FindFirst("<container ", pos);
+    int32 start;
+    const char *endTag;
+    bool isContainer;
+    if (itemStart >= 0 && (contStart < 0 || itemStart < contStart)) {
+      start = itemStart;
+      endTag = "</item>";
+      isContainer = false;
+    } else if (contStart >= 0) {
+      start = contStart;
+      endTag = "</container>";
+      isContainer = true;
+    } else {
+      break;
+    }
+
+    int32 end = didl.FindFirst(endTag, start);
+    if (end < 0)
+      break;
+    end += strlen(endTag);
+
+    BString block;
+    didl.CopyInto(block, start, end - start);
+
+    DLNABrowseItem item;
+    item.isContainer = isContainer;
+    item.id = Attribute(block, "id");
+    item.refId = Attribute(block, "refID");
+    item.parentId = Attribute(block, "parentID");
+    item.title = UnescapeXml(ExtractXmlTag(block, "dc:title"));
+    item.artist = UnescapeXml(ExtractXmlTag(block, "dc:creator"));
+    if (item.artist.IsEmpty())
+      item.artist = UnescapeXml(ExtractXmlTag(block, "upnp:artist"));
+    item.album = UnescapeXml(ExtractXmlTag(block, "upnp:album"));
+    item.genre = UnescapeXml(ExtractXmlTag(block, "upnp:genre"));
+    item.upnpClass = UnescapeXml(ExtractXmlTag(block, "upnp:class"));
+    item.albumArtUrl = UnescapeXml(ExtractXmlTag(block, "upnp:albumArtURI"));
+
+    int32 resStart = isContainer ? -1 : block.FindFirst("<res ");
+    int32 resClose = resStart >= 0 ? block.FindFirst('>', resStart) : -1;
+    if (resClose >= 0) {
+      int32 resEnd = block.FindFirst("</res>", resClose);
+      if (resEnd > resClose + 1) {
+        BString rawUrl;
+        block.CopyInto(rawUrl, resClose + 1, resEnd - resClose - 1);
+        item.resourceUrl = UnescapeXml(rawUrl);
+        item.resourceUrl.Trim();
+      }
+
+      BString resAttrs;
+      block.CopyInto(resAttrs, resStart, resClose - resStart);
+      BString info = Attribute(resAttrs, "protocolInfo");
+      int32 c1 = info.FindFirst(':');
+      int32 c2 = c1 >= 0 ? info.FindFirst(':', c1 + 1) : -1;
+      int32 c3 = c2 >= 0 ? info.FindFirst(':', c2 + 1) : -1;
+      if (c3 > c2 + 1)
+        info.CopyInto(item.mimeType, c2 + 1, c3 - c2 - 1);
+      item.duration = Attribute(resAttrs, "duration");
+      item.resourceSize = Attribute(resAttrs, "size");
+    }
+
+    items.push_back(item);
+    pos = end;
+  }
+}
+
+bool LegacyParse(const BString &reply, std::vector<DLNABrowseItem> &items,
+                 uint32 &total) {
+  BString didl = ExtractXmlTag(reply, "Result");
+  if (didl.IsEmpty())
+    return false;
+  LegacyParseDidl(UnescapeXml(didl), items);
+  BString totalStr = ExtractXmlTag(reply, "TotalMatches");
+  total = totalStr.IsEmpty() ? 0 : (uint32)atoi(totalStr.String());
+  return true;
+}
+///@}
+
+bool StreamParse(const BString &reply, size_t chunk,
+                 std::vector<DLNABrowseItem> &items, uint32 &total) {
+  DidlParser parser(items);
+  const char *data = reply.String();
+  size_t length = reply.Length();
+  for (size_t offset = 0; offset < length; offset += chunk)
+    parser.FeedSoap(data + offset, std::min(chunk, length - offset));
+  total = parser.HasTotalMatches() ? parser.TotalMatches() : 0;
+  return parser.HasResult();
+}
+
+/** @brief Prints the fields in which `a` and `b` differ. */
+bool Compare(const char *name, size_t index, const DLNABrowseItem &a,
+             const DLNABrowseItem &b) {
+  struct Field {
+    const char *name;
+    const BString DLNABrowseItem::*member;
+  };
+  static const Field kFields[] = {
+      {"id", &DLNABrowseItem::id},
+      {"refID", &DLNABrowseItem::refId},
+      {"parentID", &DLNABrowseItem::parentId},
+      {"title", &DLNABrowseItem::title},
+      {"artist", &DLNABrowseItem::artist},
+      {"album", &DLNABrowseItem::album},
+      {"genre", &DLNABrowseItem::genre},
+      {"class", &DLNABrowseItem::upnpClass},
+      {"albumArtURI", &DLNABrowseItem::albumArtUrl},
+      {"duration", &DLNABrowseItem::duration},
+      {"size", &DLNABrowseItem::resourceSize},
+      {"url", &DLNABrowseItem::resourceUrl},
+      {"mime", &DLNABrowseItem::mimeType},
+  };
+  bool same = a.isContainer == b.isContainer;
+  if (!same)
+    printf("%s: object %zu: container %d vs %d\n", name, index,
+           a.isContainer, b.isContainer);
+  for (const Field &field : kFields) {
+    if (a.*field.member != b.*field.member) {
+      printf("%s: object %zu: %s '%s' vs '%s'\n", name, index, field.name,
+             (a.*field.member).String(), (b.*field.member).String());
+      same = false;
+    }
+  }
+  return same;
+}
+
+BString Escape(const BString &text) {
+  BString escaped(text);
+  escaped.ReplaceAll("&", "&amp;");
+  escaped.ReplaceAll("<", "&lt;");
+  escaped.ReplaceAll(">", "&gt;");
+  escaped.ReplaceAll("\"", "&quot;");
+  return escaped;
+}
+
+/** @brief A Browse reply of `count` tracks, laid out like MiniDLNA's. */
+BString SyntheticReply(int32 count) {
+  BString didl;
+  didl << "<DIDL-Lite xmlns:dc=\"http://purl.org/dc/elements/1.1/\" "
+          "xmlns:upnp=\"urn:schemas-upnp-org:metadata-1-0/upnp/\" "
+          "xmlns=\"urn:schemas-upnp-org:metadata-1-0/DIDL-Lite/\">";
+  for (int32 i = 0; i < count; i++) {
+    BString index;
+    index << i;
+    didl << "<item id=\"64$1$" << index << "\" parentID=\"64$1\" "
+         << "restricted=\"1\"><dc:title>Track " << index
+         << " &amp; Friends</dc:title><upnp:class>object.item.audioItem."
+            "musicTrack</upnp:class><dc:creator>Artist &lt;"
+         << (i % 17) << "&gt;</dc:creator><upnp:artist>Artist "
+         << (i % 17) << "</upnp:artist><upnp:album>Album " << (i / 12)
+         << "</upnp:album><upnp:genre>Rock</upnp:genre>"
+            "<upnp:originalTrackNumber>"
+         << (i % 12 + 1)
+         << "</upnp:originalTrackNumber><upnp:albumArtURI "
+            "dlna:profileID=\"JPEG_TN\">http://192.168.1.2:8200/AlbumArt/"
+         << index << "-" << index
+         << ".jpg</upnp:albumArtURI><res size=\"" << (8000000 + i)
+         << "\" duration=\"0:04:" << (10 + i % 50)
+         << ".000\" bitrate=\"40000\" sampleFrequency=\"44100\" "
+            "nrAudioChannels=\"2\" protocolInfo=\"http-get:*:audio/mpeg:"
+            "DLNA.ORG_PN=MP3;DLNA.ORG_OP=01\">http://192.168.1.2:8200/"
+            "MediaItems/"
+         << index << ".mp3</res></item>";
+  }
+  didl << "</DIDL-Lite>";
+
+  BString reply;
+  reply << "<?xml version=\"1.0\" encoding=\"utf-8\"?>\r\n"
+        << "<s:Envelope xmlns:s=\"http://schemas.xmlsoap.org/soap/envelope/\""
+           " s:encodingStyle=\"http://schemas.xmlsoap.org/soap/encoding/\">"
+        << "<s:Body><u:BrowseResponse xmlns:u=\"urn:schemas-upnp-org:"
+           "service:ContentDirectory:1\"><Result>"
+        << Escape(didl) << "</Result><NumberReturned>" << count
+        << "</NumberReturned><TotalMatches>" << count
+        << "</TotalMatches><UpdateID>1</UpdateID></u:BrowseResponse>"
+        << "</s:Body></s:Envelope>\r\n";
+  return reply;
+}
+
+bool ReadFile(const char *path, BString &contents) {
+  FILE *file = fopen(path, "rb");
+  if (file == nullptr)
+    return false;
+  std::string data;
+  char buffer[65536];
+  size_t read;
+  while ((read = fread(buffer, 1, sizeof(buffer), file)) > 0)
+    data.append(buffer, read);
+  fclose(file);
+  contents.SetTo(data.data(), (int32)data.size());
+  return true;
+}
+
+struct Measurement {
+  bigtime_t time;
+  uint64 allocations;
+};
+
+template <typename Parse>
+Measurement Measure(int32 iterations, Parse parse) {
+  std::vector<bigtime_t> times;
+  uint64 allocations = 0;
+  for (int32 i = 0; i < iterations; i++) {
+    uint64 before = sAllocations.load(std::memory_order_relaxed);
+    bigtime_t start = system_time();
+    parse();
+    times.push_back(system_time() - start);
+    allocations += sAllocations.load(std::memory_order_relaxed) - before;
+  }
+  std::sort(times.begin(), times.end());
+  return {times[times.size() / 2], allocations / iterations};
+}
+
+/** @return false if the parsers disagree. */
+bool Run(const char *name, const BString &reply, size_t chunk,
+         int32 iterations) {
+  std::vector<DLNABrowseItem> legacy;
+  std::vector<DLNABrowseItem> streamed;
+  uint32 legacyTotal = 0;
+  uint32 streamedTotal = 0;
+  bool legacyOk = LegacyParse(reply, legacy, legacyTotal);
+  bool streamedOk = StreamParse(reply, chunk, streamed, streamedTotal);
+
+  bool same = legacyOk == streamedOk && legacyTotal == streamedTotal &&
+              legacy.size() == streamed.size();
+  if (!same)
+    printf("%s: result %d/%d, TotalMatches %u/%u, objects %zu/%zu\n", name,
+           legacyOk, streamedOk, (unsigned)legacyTotal,
+           (unsigned)streamedTotal, legacy.size(), streamed.size());
+  for (size_t i = 0; i < std::min(legacy.size(), streamed.size()); i++)
+    same = Compare(name, i, legacy[i], streamed[i]) && same;
+
+  Measurement old = Measure(iterations, [&]() {
+    std::vector<DLNABrowseItem> items;
+    uint32 total;
+    LegacyParse(reply, items, total);
+  });
+  Measurement now = Measure(iterations, [&]() {
+    std::vector<DLNABrowseItem> items;
+    uint32 total;
+    StreamParse(reply, chunk, items, total);
+  });
+
+  printf("%-32s %6zu objects %8.1f KiB | substring %8lld us %8llu allocs"
+         " | DidlParser %8lld us %8llu allocs | x%.1f%s\n",
+         name, streamed.size(), reply.Length() / 1024.0, (long long)old.time,
+         (unsigned long long)old.allocations, (long long)now.time,
+         (unsigned long long)now.allocations,
+         now.time > 0 ? (double)old.time / now.time : 0.0,
+         same ? "" : "  MISMATCH");
+  return same;
+}
+
+void Usage() {
+  fprintf(stderr, "usage: didl_bench [--chunk bytes] [--iterations N] "
+                  "[--synthetic N] <reply.xml>...\n");
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  size_t chunk = 1460;
+  int32 iterations = 20;
+  std::vector<int32> synthetic;
+  std::vector<const char *> files;
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--chunk") == 0 && i + 1 < argc)
+      chunk = std::max(1, atoi(argv[++i]));
+    else if (strcmp(argv[i], "--iterations") == 0 && i + 1 < argc)
+      iterations = std::max(1, atoi(argv[++i]));
+    else if (strcmp(argv[i], "--synthetic") == 0 && i + 1 < argc)
+      synthetic.push_back(std::max(1, atoi(argv[++i])));
+    else if (argv[i][0] == '-') {
+      Usage();
+      return 2;
+    } else
+      files.push_back(argv[i]);
+  }
+  if (files.empty() && synthetic.empty()) {
+    Usage();
+    return 2;
+  }
+
+  bool same = true;
+  for (int32 count : synthetic) {
+    BString name;
+    name << "synthetic-" << count;
+    same = Run(name.String(), SyntheticReply(count), chunk, iterations) &&
+           same;
+  }
+  for (const char *path : files) {
+    BString reply;
+    if (!ReadFile(path, reply)) {
+      fprintf(stderr, "%s: cannot read\n", path);
+      same = false;
+      continue;
+    }
+    same = Run(path, reply, chunk, iterations) && same;
+  }
+  return same ? 0 : 1;
+}
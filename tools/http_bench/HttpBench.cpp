@@ -0,0 +1,434 @@
+/**
+ * @file HttpBench.cpp
+ * @brief Headless load test for LocalFileHttpServer, the DLNA output's
+ * file server.
+ *
+ * Serves the given files and runs synthetic clients against the server,
+ * one scenario after the other, each for --seconds:
+ * - "range": --clients keep-alive connections, each requesting random
+ *   256 KiB ranges back to back, like renderers that seek and probe;
+ * - "slow": --clients connections, each reading a whole file at about
+ *   twice a CD's rate, like a renderer filling its buffer as it plays;
+ * - "churn": --clients clients, each opening a new connection for a HEAD
+ *   and a 64 KiB range and closing it again.
+ *
+ * Reported per scenario: requests, failures, throughput, time to first
+ * byte percentiles (p50, p99, max), the longest stall between two reads
+ * and server CPU time per MB sent. Server CPU is the team's CPU time less
+ * that of the client threads.
+ *
+ * Exits with 1 if any request failed, so runs can gate changes.
+ *
+ * Usage: http_bench [--clients N] [--seconds S] [--debug] <file>...
+ * or, from the top level: make http-bench BENCH_FILES="<file>..."
+ */
+
+#include "Debug.h"
+#include "LocalFileHttpServer.h"
+
+#include <Entry.h>
+#include <OS.h>
+#include <Path.h>
+#include <String.h>
+
+#include <algorithm>
+#include <arpa/inet.h>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <netinet/in.h>
+#include <random>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <unistd.h>
+#include <vector>
+
+bool gIsDebug = false;
+
+namespace {
+
+const size_t kRangeSize = 256 * 1024;
+const size_t kChurnRangeSize = 64 * 1024;
+/** @brief Slow readers take this much per read... */
+const size_t kSlowReadSize = 16 * 1024;
+/** @brief ...every this often: about 350 KB/s. */
+const bigtime_t kSlowReadInterval = 45000;
+const bigtime_t kSocketTimeout = 10000000;
+
+struct Target {
+  BString url;
+  BString host;
+  uint16 port = 0;
+  BString path; ///< Request target, "/<token>/<name>"
+  off_t size = 0;
+};
+
+/** @brief What one client measured. */
+struct ClientResult {
+  int64 requests = 0;
+  int64 failures = 0;
+  int64 refused = 0; ///< 503 from a full server; counted, not failed
+  off_t bytes = 0;
+  std::vector<bigtime_t> firstByte;
+  bigtime_t longestStall = 0;
+  bigtime_t cpu = 0;
+};
+
+enum Scenario { kRange, kSlow, kChurn };
+
+struct Client {
+  Scenario scenario;
+  const std::vector<Target> *targets;
+  bigtime_t deadline;
+  uint32 seed;
+  ClientResult result;
+};
+
+bool SplitUrl(const BString &url, Target &target) {
+  // http://<host>:<port>/<token>/<name>
+  if (!url.StartsWith("http://"))
+    return false;
+  int32 colon = url.FindFirst(':', 7);
+  int32 slash = url.FindFirst('/', 7);
+  if (colon < 0 || slash < colon)
+    return false;
+  url.CopyInto(target.host, 7, colon - 7);
+  BString port;
+  url.CopyInto(port, colon + 1, slash - colon - 1);
+  target.port = (uint16)atoi(port.String());
+  url.CopyInto(target.path, slash, url.Length() - slash);
+  target.url = url;
+  return target.port != 0;
+}
+
+int Connect(const Target &target) {
+  int sock = socket(AF_INET, SOCK_STREAM, 0);
+  if (sock < 0)
+    return -1;
+  struct timeval timeout;
+  timeout.tv_sec = kSocketTimeout / 1000000;
+  timeout.tv_usec = 0;
+  setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+  setsockopt(sock, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+
+  struct sockaddr_in address;
+  memset(&address, 0, sizeof(address));
+  address.sin_family = AF_INET;
+  address.sin_port = htons(target.port);
+  address.sin_addr.s_addr = inet_addr(target.host.String());
+  if (connect(sock, (struct sockaddr *)&address, sizeof(address)) < 0) {
+    close(sock);
+    return -1;
+  }
+  return sock;
+}
+
+/**
+ * @brief Sends one request on `sock` and reads the whole response.
+ * @param paceUntil If set, reads at most kSlowReadSize per
+ * kSlowReadInterval and gives up on the rest of the body at this time.
+ * @return HTTP status, or -1 if the connection failed.
+ */
+int Exchange(int sock, const BString &request, bool head, bigtime_t paceUntil,
+             ClientResult &result, bool &keepAlive) {
+  const bool pace = paceUntil > 0;
+  const bigtime_t sent = system_time();
+  if (send(sock, request.String(), request.Length(), 0) != request.Length())
+    return -1;
+
+  BString header;
+  char buffer[64 * 1024];
+  off_t pending = 0; ///< Body bytes already in `buffer` with the header
+  bool firstByte = true;
+  while (header.FindFirst("\r\n\r\n") < 0) {
+    ssize_t received = recv(sock, buffer, sizeof(buffer), 0);
+    if (received <= 0)
+      return -1;
+    if (firstByte) {
+      result.firstByte.push_back(system_time() - sent);
+      firstByte = false;
+    }
+    header.Append(buffer, received);
+  }
+  int32 headerEnd = header.FindFirst("\r\n\r\n") + 4;
+  pending = header.Length() - headerEnd;
+  header.Truncate(headerEnd);
+
+  const int status = atoi(header.String() + 9);
+  BString lower(header);
+  lower.ToLower();
+  keepAlive = lower.FindFirst("connection: close") < 0;
+  off_t length = -1;
+  int32 lengthAt = lower.FindFirst("content-length:");
+  if (lengthAt >= 0)
+    length = atoll(lower.String() + lengthAt + 15);
+  if (head)
+    return status;
+
+  // Without a length the body runs to the end of the connection.
+  off_t body = pending;
+  bigtime_t lastRead = system_time();
+  while (length < 0 || body < length) {
+    size_t want = pace ? kSlowReadSize : sizeof(buffer);
+    if (length >= 0)
+      want = (size_t)std::min<off_t>(want, length - body);
+    ssize_t received = recv(sock, buffer, want, 0);
+    if (received < 0)
+      return -1;
+    if (received == 0) {
+      if (length >= 0)
+        return -1;
+      keepAlive = false;
+      break;
+    }
+    bigtime_t now = system_time();
+    result.longestStall = std::max(result.longestStall, now - lastRead);
+    body += received;
+    if (pace) {
+      if (now >= paceUntil) {
+        keepAlive = false;
+        break;
+      }
+      snooze_until(lastRead + kSlowReadInterval, B_SYSTEM_TIMEBASE);
+      now = std::max(now, system_time());
+    }
+    lastRead = now;
+  }
+  result.bytes += body;
+  return status;
+}
+
+BString Request(const char *method, const Target &target, off_t start,
+                off_t size, bool close) {
+  BString request;
+  request << method << " " << target.path << " HTTP/1.1\r\n"
+          << "Host: " << target.host << ":" << (int32)target.port << "\r\n";
+  if (size > 0) {
+    request << "Range: bytes=" << (int64)start << "-"
+            << (int64)(start + size - 1) << "\r\n";
+  }
+  if (close)
+    request << "Connection: close\r\n";
+  request << "\r\n";
+  return request;
+}
+
+void Count(int status, ClientResult &result) {
+  result.requests++;
+  if (status == 503)
+    result.refused++;
+  else if (status != 200 && status != 206)
+    result.failures++;
+}
+
+int32 RunClient(void *data) {
+  Client &client = *static_cast<Client *>(data);
+  ClientResult &result = client.result;
+  const std::vector<Target> &targets = *client.targets;
+  std::mt19937 random(client.seed);
+
+  int sock = -1;
+  size_t next = client.seed;
+  while (system_time() < client.deadline) {
+    const Target &target = targets[next++ % targets.size()];
+    bool keepAlive = false;
+    int status;
+
+    switch (client.scenario) {
+    case kRange: {
+      if (sock < 0 && (sock = Connect(target)) < 0) {
+        result.requests++;
+        result.failures++;
+        snooze(100000);
+        continue;
+      }
+      off_t span = std::max<off_t>(target.size - (off_t)kRangeSize, 1);
+      off_t start = (off_t)(random() % (uint64)span);
+      status = Exchange(sock, Request("GET", target, start, kRangeSize, false),
+                        false, 0, result, keepAlive);
+      break;
+    }
+    case kSlow:
+      sock = Connect(target);
+      status = sock < 0 ? -1
+                        : Exchange(sock, Request("GET", target, 0, 0, true),
+                                   false, client.deadline, result, keepAlive);
+      break;
+    case kChurn:
+      sock = Connect(target);
+      status = sock < 0 ? -1
+                        : Exchange(sock, Request("HEAD", target, 0, 0, false),
+                                   true, 0, result, keepAlive);
+      if (status == 200 && keepAlive) {
+        Count(status, result);
+        status = Exchange(
+            sock, Request("GET", target, 0, kChurnRangeSize, true), false, 0,
+            result, keepAlive);
+      }
+      keepAlive = false;
+      break;
+    }
+
+    Count(status, result);
+    if (status < 0 || !keepAlive) {
+      if (sock >= 0)
+        close(sock);
+      sock = -1;
+    }
+  }
+  if (sock >= 0)
+    close(sock);
+
+  thread_info info;
+  if (get_thread_info(find_thread(NULL), &info) == B_OK)
+    result.cpu = info.user_time + info.kernel_time;
+  return 0;
+}
+
+bigtime_t TeamCpu() {
+  team_usage_info usage;
+  if (get_team_usage_info(B_CURRENT_TEAM, B_TEAM_USAGE_SELF, &usage) != B_OK)
+    return 0;
+  return usage.user_time + usage.kernel_time;
+}
+
+bigtime_t Percentile(std::vector<bigtime_t> &values, double fraction) {
+  if (values.empty())
+    return 0;
+  size_t index = std::min(values.size() - 1,
+                          (size_t)(fraction * (values.size() - 1) + 0.5));
+  std::nth_element(values.begin(), values.begin() + index, values.end());
+  return values[index];
+}
+
+/** @return Failed requests. */
+int64 RunScenario(Scenario scenario, const char *name,
+                  const std::vector<Target> &targets, int32 clients,
+                  bigtime_t duration) {
+  std::vector<Client> states(clients);
+  std::vector<thread_id> threads;
+  const bigtime_t cpuBefore = TeamCpu();
+  const bigtime_t start = system_time();
+  for (int32 i = 0; i < clients; i++) {
+    states[i].scenario = scenario;
+    states[i].targets = &targets;
+    states[i].deadline = start + duration;
+    states[i].seed = (uint32)i + 1;
+    thread_id thread =
+        spawn_thread(RunClient, "bench client", B_NORMAL_PRIORITY, &states[i]);
+    if (thread >= 0) {
+      threads.push_back(thread);
+      resume_thread(thread);
+    }
+  }
+  status_t exitValue;
+  for (thread_id thread : threads)
+    wait_for_thread(thread, &exitValue);
+  const bigtime_t wall = system_time() - start;
+
+  ClientResult total;
+  bigtime_t clientCpu = 0;
+  for (Client &client : states) {
+    const ClientResult &result = client.result;
+    total.requests += result.requests;
+    total.failures += result.failures;
+    total.refused += result.refused;
+    total.bytes += result.bytes;
+    total.firstByte.insert(total.firstByte.end(), result.firstByte.begin(),
+                           result.firstByte.end());
+    total.longestStall = std::max(total.longestStall, result.longestStall);
+    clientCpu += result.cpu;
+  }
+  const bigtime_t serverCpu =
+      std::max<bigtime_t>(TeamCpu() - cpuBefore - clientCpu, 0);
+  const double megabytes = total.bytes / 1e6;
+
+  bigtime_t maxFirstByte =
+      total.firstByte.empty()
+          ? 0
+          : *std::max_element(total.firstByte.begin(), total.firstByte.end());
+  printf("%-6s %ld clients, %.1f s\n", name, (long)clients, wall / 1e6);
+  printf("       requests %lld  failed %lld  refused %lld\n",
+         (long long)total.requests, (long long)total.failures,
+         (long long)total.refused);
+  printf("       %.1f MB at %.1f MB/s\n", megabytes,
+         wall > 0 ? megabytes / (wall / 1e6) : 0.0);
+  printf("       first byte us: p50 %lld  p99 %lld  max %lld\n",
+         (long long)Percentile(total.firstByte, 0.50),
+         (long long)Percentile(total.firstByte, 0.99), (long long)maxFirstByte);
+  printf("       longest stall us: %lld\n", (long long)total.longestStall);
+  printf("       server cpu: %.2f ms/MB\n",
+         megabytes > 0 ? serverCpu / 1000.0 / megabytes : 0.0);
+  return total.failures;
+}
+
+void Usage() {
+  fprintf(stderr, "usage: http_bench [--clients N] [--seconds S] [--debug] "
+                  "<file>...\n");
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  int32 clients = 8;
+  bigtime_t duration = 10000000;
+  std::vector<BString> files;
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--clients") == 0 && i + 1 < argc) {
+      clients = std::max(1, atoi(argv[++i]));
+    } else if (strcmp(argv[i], "--seconds") == 0 && i + 1 < argc) {
+      duration = (bigtime_t)(std::max(0.1, atof(argv[++i])) * 1000000);
+    } else if (strcmp(argv[i], "--debug") == 0) {
+      gIsDebug = true;
+    } else if (argv[i][0] == '-') {
+      Usage();
+      return 1;
+    } else {
+      BPath path(argv[i], NULL, true);
+      if (path.InitCheck() == B_OK)
+        files.push_back(BString(path.Path()));
+    }
+  }
+  if (files.empty()) {
+    Usage();
+    return 1;
+  }
+
+  LocalFileHttpServer server;
+  if (server.Start() != B_OK) {
+    fprintf(stderr, "http_bench: the server did not start\n");
+    return 1;
+  }
+
+  std::vector<Target> targets;
+  for (const BString &file : files) {
+    struct stat st;
+    Target target;
+    BString url;
+    if (stat(file.String(), &st) != 0 || !S_ISREG(st.st_mode) ||
+        st.st_size == 0 || server.ServeFile(file, url) != B_OK ||
+        !SplitUrl(url, target)) {
+      fprintf(stderr, "http_bench: skipping %s\n", file.String());
+      continue;
+    }
+    target.size = st.st_size;
+    targets.push_back(target);
+  }
+  // The server keeps a limited number of files served.
+  if (targets.size() > (size_t)LocalFileHttpServer::kMaxServedFiles)
+    targets.erase(targets.begin(),
+                  targets.end() - LocalFileHttpServer::kMaxServedFiles);
+  if (targets.empty()) {
+    server.Stop();
+    return 1;
+  }
+
+  int64 failures = 0;
+  failures += RunScenario(kRange, "range", targets, clients, duration);
+  failures += RunScenario(kSlow, "slow", targets, clients, duration);
+  failures += RunScenario(kChurn, "churn", targets, clients, duration);
+  server.Stop();
+  return failures > 0 ? 1 : 0;
+}
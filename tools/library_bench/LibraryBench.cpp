@@ -0,0 +1,443 @@
+/**
+ * @file LibraryBench.cpp
+ * @brief Times the library hot paths on synthetic libraries, headless.
+ *
+ * For each --sizes entry a library of that many MediaItems is generated
+ * (seeded, so runs are comparable) and these are measured:
+ *   - cache_save:     MediaCacheWriter, all items, written to a temp file,
+ *   - cache_open:     MediaCacheReader, mapping and reading one numeric
+ *                     column, without building items,
+ *   - cache_load:     MediaCacheReader, mapping and reading every item,
+ *   - cache_{save,open,load}_lz4, cache_{save,open,load}_zstd:
+ *                     the same with a compressed file, if built with
+ *                     CACHE_COMPRESSION=1 (the file cache hides the disk),
+ *   - path_index:     MediaPathIndex::Rebuild(), as RebuildPathIndex does,
+ *   - path_lookup:    one Find() per item,
+ *   - facet_rebuild:  LibraryFacetIndex::Rebuild(),
+ *   - facet_update:   Update() of 1% of the items to another genre,
+ *   - search_rebuild: LibrarySearchIndex::Rebuild(),
+ *   - search_query:   Search() for a few typed queries,
+ *   - sort_title:     SortMediaItems() by title, as the content view does,
+ *   - sort_artist:    the same by artist,
+ *   - smart_facets:   SmartPlaylistRules::Filter() on the facet index,
+ *   - smart_scan:     the same without the index,
+ *   - match_titles:   TrackMatchingUtils::Similarity() of 1000 titles
+ *                     against a 20-track release, as the matcher does,
+ *   - didl_parse:     DidlParser on a DIDL-Lite document of 1000 tracks.
+ *
+ * The filter pass of the column browser needs MediaTableView and is not
+ * linked here; its parts (search, facets, sort) are.
+ *
+ * Output is one tab-separated line per case after a header, so it can be
+ * kept and compared across releases:
+ *   benchmark  items  median_us  min_us  allocs
+ * where allocs are heap allocations per run.
+ *
+ * Usage: library_bench [--iterations N] [--sizes N[,N...]]
+ */
+
+#include "CacheCompression.h"
+#include "DidlParser.h"
+#include "LibraryFacetIndex.h"
+#include "LibrarySearchIndex.h"
+#include "LibrarySnapshot.h"
+#include "MediaCacheFile.h"
+#include "MediaEntryStore.h"
+#include "MediaSortKey.h"
+#include "SmartPlaylistRules.h"
+#include "TrackMatchingUtils.h"
+
+#include <Message.h>
+#include <OS.h>
+#include <String.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <unistd.h>
+#include <vector>
+
+bool gIsDebug = false;
+
+/** @name Allocation counting */
+///@{
+static std::atomic<uint64> sAllocations{0};
+
+void *operator new(size_t size) {
+  sAllocations.fetch_add(1, std::memory_order_relaxed);
+  if (void *p = malloc(size > 0 ? size : 1))
+    return p;
+  throw std::bad_alloc();
+}
+void *operator new[](size_t size) { return operator new(size); }
+void operator delete(void *p) noexcept { free(p); }
+void operator delete[](void *p) noexcept { free(p); }
+void operator delete(void *p, size_t) noexcept { free(p); }
+void operator delete[](void *p, size_t) noexcept { free(p); }
+///@}
+
+namespace {
+
+/** @brief Tracks per album in the synthetic library. */
+const int32 kAlbumTracks = 12;
+/** @brief Titles compared with a release in match_titles. */
+const int32 kMatchTitles = 1000;
+/** @brief Tracks of the document in didl_parse. */
+const int32 kDidlTracks = 1000;
+
+const char *kGenres[] = {"Rock",  "Pop",       "Jazz",       "Classical",
+                         "Metal", "Electronic", "Hip-Hop",   "Folk",
+                         "Blues", "Soundtrack", "Ambient",   "Country",
+                         "Punk",  "Reggae",     "Soul",      ""};
+const char *kWords[] = {"Love",  "Night", "Blue",    "Dream",  "Fire",
+                        "Rain",  "Heart", "Song",    "Road",   "Light",
+                        "River", "Stone", "Summer",  "Shadow", "Gold",
+                        "Wind",  "Ocean", "Morning", "City",   "Ghost"};
+
+BString Words(int32 count) {
+  const int32 wordCount = sizeof(kWords) / sizeof(kWords[0]);
+  BString text;
+  for (int32 w = 0; w < count; w++) {
+    if (w > 0)
+      text << ' ';
+    text << kWords[rand() % wordCount];
+  }
+  return text;
+}
+
+/**
+ * @brief A library shaped like a real one: albums of kAlbumTracks tracks by
+ * a few thousand artists, some untagged, in path order as after a scan.
+ */
+std::vector<MediaItem> SyntheticLibrary(int32 count) {
+  const int32 genreCount = sizeof(kGenres) / sizeof(kGenres[0]);
+  const int32 artistCount = std::max(1, count / 60);
+
+  std::vector<MediaItem> items;
+  items.reserve(count);
+  srand(1);
+  MediaItem album;
+  for (int32 i = 0; i < count; i++) {
+    if (i % kAlbumTracks == 0) {
+      int32 artist = rand() % artistCount;
+      album = MediaItem();
+      album.artist.SetToFormat("Artist %" B_PRId32 " %s", artist,
+                               Words(1).String());
+      album.albumArtist = album.artist;
+      album.album = Words(1 + rand() % 3);
+      album.genre = kGenres[artist % genreCount];
+      album.year = 1960 + rand() % 65;
+      album.base.SetToFormat("/boot/home/music/%s/%s",
+                             album.artist.String(), album.album.String());
+    }
+    MediaItem item = album;
+    item.track = i % kAlbumTracks + 1;
+    item.trackTotal = kAlbumTracks;
+    item.title = Words(1 + rand() % 5);
+    item.path.SetToFormat("%s/%02" B_PRId32 " %s %" B_PRId32 ".flac",
+                          album.base.String(), item.track,
+                          item.title.String(), i);
+    item.duration = 120 + rand() % 300;
+    item.bitrate = 128 + rand() % 900;
+    item.sampleRate = 44100;
+    item.channels = 2;
+    item.rating = rand() % 11;
+    item.size = 4000000 + rand() % 40000000;
+    item.mtime = 1000000000 + rand() % 700000000;
+    item.inode = 1000 + i;
+    if (rand() % 50 == 0) {
+      // Untagged files.
+      item.title = "";
+      item.artist = "";
+      item.album = "";
+      item.genre = "";
+    }
+    items.push_back(item);
+  }
+  std::sort(items.begin(), items.end(),
+            [](const MediaItem &a, const MediaItem &b) {
+              return a.path < b.path;
+            });
+  return items;
+}
+
+BString SyntheticDidl(int32 count) {
+  BString didl;
+  didl << "<DIDL-Lite xmlns:dc=\"http://purl.org/dc/elements/1.1/\" "
+          "xmlns:upnp=\"urn:schemas-upnp-org:metadata-1-0/upnp/\" "
+          "xmlns=\"urn:schemas-upnp-org:metadata-1-0/DIDL-Lite/\">";
+  for (int32 i = 0; i < count; i++) {
+    didl << "<item id=\"64$1$" << i << "\" parentID=\"64$1\" restricted=\"1\">"
+         << "<dc:title>Track " << i << " &amp; Friends</dc:title>"
+         << "<upnp:class>object.item.audioItem.musicTrack</upnp:class>"
+         << "<dc:creator>Artist " << (i % 17) << "</dc:creator>"
+         << "<upnp:album>Album " << (i / 12) << "</upnp:album>"
+         << "<upnp:genre>Rock</upnp:genre>"
+         << "<res size=\"" << (8000000 + i) << "\" duration=\"0:04:"
+         << (10 + i % 50) << ".000\" protocolInfo=\"http-get:*:audio/mpeg:*\">"
+         << "http://192.168.1.2:8200/MediaItems/" << i << ".mp3</res></item>";
+  }
+  didl << "</DIDL-Lite>";
+  return didl;
+}
+
+struct Measurement {
+  bigtime_t median;
+  bigtime_t min;
+  uint64 allocations;
+};
+
+/** @brief Runs `setup` untimed, then `pass` timed, `iterations` times. */
+template <typename Setup, typename Pass>
+Measurement Measure(int32 iterations, Setup setup, Pass pass) {
+  std::vector<bigtime_t> times;
+  uint64 allocations = 0;
+  for (int32 i = 0; i < iterations; i++) {
+    setup();
+    uint64 before = sAllocations.load(std::memory_order_relaxed);
+    bigtime_t start = system_time();
+    pass();
+    times.push_back(system_time() - start);
+    allocations += sAllocations.load(std::memory_order_relaxed) - before;
+  }
+  std::sort(times.begin(), times.end());
+  return {times[times.size() / 2], times.front(), allocations / iterations};
+}
+
+template <typename Pass> Measurement Measure(int32 iterations, Pass pass) {
+  return Measure(iterations, []() {}, pass);
+}
+
+void Report(const char *name, size_t items, const Measurement &m) {
+  printf("%s\t%zu\t%lld\t%lld\t%llu\n", name, items, (long long)m.median,
+         (long long)m.min, (unsigned long long)m.allocations);
+  fflush(stdout);
+}
+
+BMessage SmartRequest() {
+  BMessage request;
+  BMessage genre;
+  genre.AddInt32("type", SmartPlaylistRules::kGenre);
+  genre.AddString("val1", "Rock");
+  request.AddMessage("rule", &genre);
+  BMessage year;
+  year.AddInt32("type", SmartPlaylistRules::kYear);
+  year.AddString("val1", "1970");
+  year.AddString("val2", "1999");
+  request.AddMessage("rule", &year);
+  BMessage rating;
+  rating.AddInt32("type", SmartPlaylistRules::kRating);
+  rating.AddString("val1", "6");
+  request.AddMessage("rule", &rating);
+  return request;
+}
+
+/** @return false if a case failed to run. */
+bool Run(int32 count, int32 iterations, const char *cachePath) {
+  std::vector<MediaItem> items = SyntheticLibrary(count);
+  const size_t size = items.size();
+  bool ok = true;
+  // Sums keep the compiler from dropping the calls.
+  volatile size_t sink = 0;
+
+  for (CacheCodec codec : {kCacheCodecNone, kCacheCodecLZ4, kCacheCodecZstd}) {
+    if (codec != kCacheCodecNone && !CacheCompression::Available())
+      continue;
+    BString save("cache_save"), open("cache_open"), load("cache_load");
+    if (codec != kCacheCodecNone) {
+      save << "_" << CacheCompression::Name(codec);
+      open << "_" << CacheCompression::Name(codec);
+      load << "_" << CacheCompression::Name(codec);
+    }
+
+    Report(save.String(), size, Measure(iterations, [&]() {
+             MediaCacheWriter writer;
+             writer.Reserve(size);
+             for (const MediaItem &item : items)
+               writer.AddItem(item);
+             if (writer.WriteTo(cachePath, codec) != B_OK)
+               ok = false;
+           }));
+
+    Report(open.String(), size, Measure(iterations, [&]() {
+             MediaCacheReader reader;
+             if (reader.Open(cachePath) != B_OK) {
+               ok = false;
+               return;
+             }
+             int64 sum = 0;
+             for (uint32 i = 0; i < reader.CountItems(); i++)
+               sum += reader.Int64Field(i, kCacheMtime);
+             sink = sink + (size_t)sum;
+           }));
+
+    Report(load.String(), size, Measure(iterations, [&]() {
+             MediaCacheReader reader;
+             if (reader.Open(cachePath) != B_OK) {
+               ok = false;
+               return;
+             }
+             std::vector<MediaItem> loaded(reader.CountItems());
+             for (uint32 i = 0; i < reader.CountItems(); i++)
+               reader.ReadItem(i, loaded[i]);
+             sink = sink + loaded.size();
+           }));
+    unlink(cachePath);
+  }
+
+  MediaPathIndex pathIndex;
+  Report("path_index", size, Measure(iterations, [&]() {
+           pathIndex.Clear();
+           pathIndex.Rebuild(items);
+         }));
+  Report("path_lookup", size, Measure(iterations, [&]() {
+           size_t found = 0;
+           for (const MediaItem &item : items)
+             found += pathIndex.Find(item.path) != MediaPathIndex::kNotFound;
+           sink = sink + found;
+         }));
+
+  LibraryFacetIndex facets;
+  Report("facet_rebuild", size,
+         Measure(iterations, [&]() { facets.Rebuild(items); }));
+  {
+    std::vector<MediaItem> changed;
+    const size_t step = 100;
+    Report("facet_update", size / step, Measure(iterations,
+           [&]() {
+             facets.Rebuild(items);
+             changed.clear();
+             for (size_t i = 0; i < size; i += step) {
+               changed.push_back(items[i]);
+               changed.back().genre = "Changed";
+             }
+           },
+           [&]() {
+             for (size_t i = 0, j = 0; i < size; i += step, j++)
+               facets.Update(i, items[i], changed[j]);
+           }));
+    facets.Rebuild(items);
+  }
+
+  LibrarySearchIndex search;
+  Report("search_rebuild", size,
+         Measure(iterations, [&]() { search.Rebuild(items); }));
+  {
+    static const char *kQueries[] = {"lo", "love", "night river", "artist 1",
+                                     "zzz"};
+    std::vector<uint32> positions;
+    Report("search_query", size, Measure(iterations, [&]() {
+             for (const char *query : kQueries) {
+               search.Search(query, positions);
+               sink = sink + positions.size();
+             }
+           }));
+  }
+
+  {
+    std::vector<MediaItem> sorted;
+    // Field IDs of MediaTableView: 0 title, 1 artist.
+    Report("sort_title", size, Measure(iterations,
+           [&]() { sorted = items; },
+           [&]() { SortMediaItems(sorted, 0, true); }));
+    Report("sort_artist", size, Measure(iterations,
+           [&]() { sorted = items; },
+           [&]() { SortMediaItems(sorted, 1, true); }));
+  }
+
+  {
+    BReference<LibrarySnapshot> snapshot(new LibrarySnapshot(1, items), true);
+    LibraryItems library;
+    library.SetTo(snapshot.Get());
+    SmartPlaylistRules rules;
+    rules.Compile(SmartRequest(), (int64)real_time());
+    std::vector<uint32> indexed, scanned;
+    Report("smart_facets", size, Measure(iterations, [&]() {
+             rules.Filter(library, &facets, indexed);
+           }));
+    Report("smart_scan", size, Measure(iterations, [&]() {
+             rules.Filter(library, nullptr, scanned);
+           }));
+    if (indexed != scanned) {
+      fprintf(stderr, "smart playlist: %zu matches with facets, %zu without\n",
+              indexed.size(), scanned.size());
+      ok = false;
+    }
+  }
+
+  return ok;
+}
+
+/** @brief Cases that do not depend on the library size. */
+void RunFixed(int32 iterations) {
+  volatile float sink = 0;
+  {
+    srand(2);
+    std::vector<BString> release, titles;
+    for (int32 i = 0; i < 20; i++)
+      release.push_back(Words(1 + rand() % 5));
+    for (int32 i = 0; i < kMatchTitles; i++)
+      titles.push_back(Words(1 + rand() % 5));
+    Report("match_titles", titles.size(), Measure(iterations, [&]() {
+             std::vector<TrackMatchingUtils::MatchText> tracks;
+             for (const BString &title : release)
+               tracks.push_back(TrackMatchingUtils::PrepareText(title));
+             float sum = 0;
+             for (const BString &title : titles) {
+               TrackMatchingUtils::MatchText text =
+                   TrackMatchingUtils::PrepareText(title);
+               for (const auto &track : tracks)
+                 sum += TrackMatchingUtils::Similarity(text, track, 0.5f);
+             }
+             sink = sink + sum;
+           }));
+  }
+
+  {
+    BString didl = SyntheticDidl(kDidlTracks);
+    Report("didl_parse", kDidlTracks, Measure(iterations, [&]() {
+             std::vector<DLNABrowseItem> parsed;
+             DidlParser parser(parsed);
+             parser.FeedDidl(didl.String(), didl.Length());
+             sink = sink + parsed.size();
+           }));
+  }
+}
+
+void Usage() {
+  fprintf(stderr, "usage: library_bench [--iterations N] [--sizes N[,N...]]\n");
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  int32 iterations = 5;
+  std::vector<int32> sizes = {10000, 100000, 500000};
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--iterations") == 0 && i + 1 < argc) {
+      iterations = std::max(1, atoi(argv[++i]));
+    } else if (strcmp(argv[i], "--sizes") == 0 && i + 1 < argc) {
+      sizes.clear();
+      for (char *size = strtok(argv[++i], ","); size != nullptr;
+           size = strtok(nullptr, ","))
+        sizes.push_back(std::max(1, atoi(size)));
+    } else {
+      Usage();
+      return 2;
+    }
+  }
+
+  BString cachePath;
+  cachePath.SetToFormat("/tmp/library_bench_%" B_PRId32 ".cache",
+                        (int32)getpid());
+
+  printf("benchmark\titems\tmedian_us\tmin_us\tallocs\n");
+  bool ok = true;
+  for (int32 size : sizes)
+    ok = Run(size, iterations, cachePath.String()) && ok;
+  RunFixed(iterations);
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,258 @@
+/**
+ * @file MatchBench.cpp
+ * @brief Compares TrackMatchingUtils' edit distance with the full-matrix
+ * version it replaced, on lists of track titles.
+ *
+ * Every title of a list is compared with every other one, as the matcher
+ * compares files with release tracks. Reported per list: pairs, time per
+ * pass (median of --iterations) and heap allocations per pass for
+ *   - matrix:    the old (len1+1)x(len2+1) matrix per comparison,
+ *   - myers:     LevenshteinDistance(),
+ *   - bounded:   Similarity() with --min-similarity,
+ *   - prepared:  Similarity() on MatchText prepared once per title.
+ * A distance that differs from the matrix one is printed and makes the exit
+ * status 1.
+ *
+ * A list is a text file with one title per line, e.g. from
+ *   query -a 'Audio:Title=*' | xargs -d '\n' catattr -d Audio:Title
+ * --synthetic N adds a generated list of N titles for a quick run.
+ *
+ * Usage: match_bench [--iterations N] [--min-similarity F] [--synthetic N]
+ *        <titles.txt>...
+ */
+
+#include "TrackMatchingUtils.h"
+
+#include <OS.h>
+#include <String.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <vector>
+
+/** @name Allocation counting */
+///@{
+static std::atomic<uint64> sAllocations{0};
+
+void *operator new(size_t size) {
+  sAllocations.fetch_add(1, std::memory_order_relaxed);
+  if (void *p = malloc(size > 0 ? size : 1))
+    return p;
+  throw std::bad_alloc();
+}
+void *operator new[](size_t size) { return operator new(size); }
+void operator delete(void *p) noexcept { free(p); }
+void operator delete[](void *p) noexcept { free(p); }
+void operator delete(void *p, size_t) noexcept { free(p); }
+void operator delete[](void *p, size_t) noexcept { free(p); }
+///@}
+
+namespace {
+
+/** @brief The distance TrackMatchingUtils computed before. */
+int MatrixDistance(const char *s1, const char *s2) {
+  int len1 = strlen(s1);
+  int len2 = strlen(s2);
+  std::vector<std::vector<int>> d(len1 + 1, std::vector<int>(len2 + 1));
+
+  for (int i = 0; i <= len1; i++)
+    d[i][0] = i;
+  for (int j = 0; j <= len2; j++)
+    d[0][j] = j;
+
+  for (int i = 1; i <= len1; i++) {
+    for (int j = 1; j <= len2; j++) {
+      int cost = (tolower(s1[i - 1]) == tolower(s2[j - 1])) ? 0 : 1;
+      d[i][j] = std::min(
+          {d[i - 1][j] + 1, d[i][j - 1] + 1, d[i - 1][j - 1] + cost});
+    }
+  }
+  return d[len1][len2];
+}
+
+std::vector<BString> SyntheticTitles(int32 count) {
+  static const char *kWords[] = {
+      "Symphony", "No.",     "in",      "Minor",   "Major",  "Allegro",
+      "Adagio",   "Love",    "Night",   "The",     "of",     "Live",
+      "Remaster", "Version", "Part",    "Concerto", "for",   "Piano",
+      "Orchestra", "Op.",    "Moderato", "Song",   "Blue",   "Dream"};
+  const int32 wordCount = sizeof(kWords) / sizeof(kWords[0]);
+
+  std::vector<BString> titles;
+  srand(1);
+  for (int32 i = 0; i < count; i++) {
+    BString title;
+    // Mostly short pop titles, some long classical ones past 64 chars.
+    int32 words = (rand() % 4 == 0) ? 10 + rand() % 8 : 1 + rand() % 5;
+    for (int32 w = 0; w < words; w++) {
+      if (w > 0)
+        title << ' ';
+      title << kWords[rand() % wordCount];
+    }
+    if (rand() % 3 == 0)
+      title << ' ' << (int32)(rand() % 40);
+    titles.push_back(title);
+  }
+  return titles;
+}
+
+bool ReadTitles(const char *path, std::vector<BString> &titles) {
+  FILE *file = fopen(path, "r");
+  if (file == nullptr)
+    return false;
+  char line[4096];
+  while (fgets(line, sizeof(line), file) != nullptr) {
+    size_t length = strcspn(line, "\r\n");
+    if (length > 0)
+      titles.push_back(BString(line, (int32)length));
+  }
+  fclose(file);
+  return true;
+}
+
+struct Measurement {
+  bigtime_t time;
+  uint64 allocations;
+};
+
+template <typename Pass>
+Measurement Measure(int32 iterations, Pass pass) {
+  std::vector<bigtime_t> times;
+  uint64 allocations = 0;
+  for (int32 i = 0; i < iterations; i++) {
+    uint64 before = sAllocations.load(std::memory_order_relaxed);
+    bigtime_t start = system_time();
+    pass();
+    times.push_back(system_time() - start);
+    allocations += sAllocations.load(std::memory_order_relaxed) - before;
+  }
+  std::sort(times.begin(), times.end());
+  return {times[times.size() / 2], allocations / iterations};
+}
+
+/** @return false if a distance differs from the matrix one. */
+bool Run(const char *name, const std::vector<BString> &titles,
+         int32 iterations, float minSimilarity) {
+  bool same = true;
+  int32 mismatches = 0;
+  for (size_t i = 0; i < titles.size(); i++) {
+    for (size_t j = i + 1; j < titles.size(); j++) {
+      int expected = MatrixDistance(titles[i].String(), titles[j].String());
+      int actual = TrackMatchingUtils::LevenshteinDistance(titles[i].String(),
+                                                           titles[j].String());
+      if (expected != actual) {
+        same = false;
+        if (mismatches++ < 10)
+          printf("%s: '%s' / '%s': matrix %d, myers %d\n", name,
+                 titles[i].String(), titles[j].String(), expected, actual);
+      }
+    }
+  }
+
+  // Sums keep the compiler from dropping the calls.
+  volatile float sink = 0;
+  Measurement matrix = Measure(iterations, [&]() {
+    int sum = 0;
+    for (size_t i = 0; i < titles.size(); i++)
+      for (size_t j = i + 1; j < titles.size(); j++)
+        sum += MatrixDistance(titles[i].String(), titles[j].String());
+    sink = sink + sum;
+  });
+  Measurement myers = Measure(iterations, [&]() {
+    int sum = 0;
+    for (size_t i = 0; i < titles.size(); i++)
+      for (size_t j = i + 1; j < titles.size(); j++)
+        sum += TrackMatchingUtils::LevenshteinDistance(titles[i].String(),
+                                                       titles[j].String());
+    sink = sink + sum;
+  });
+  Measurement bounded = Measure(iterations, [&]() {
+    float sum = 0;
+    for (size_t i = 0; i < titles.size(); i++)
+      for (size_t j = i + 1; j < titles.size(); j++)
+        sum += TrackMatchingUtils::Similarity(
+            titles[i].String(), titles[j].String(), minSimilarity);
+    sink = sink + sum;
+  });
+  Measurement prepared = Measure(iterations, [&]() {
+    std::vector<TrackMatchingUtils::MatchText> texts;
+    texts.reserve(titles.size());
+    for (const BString &title : titles)
+      texts.push_back(TrackMatchingUtils::PrepareText(title.String()));
+    float sum = 0;
+    for (size_t i = 0; i < texts.size(); i++)
+      for (size_t j = i + 1; j < texts.size(); j++)
+        sum += TrackMatchingUtils::Similarity(texts[i], texts[j],
+                                              minSimilarity);
+    sink = sink + sum;
+  });
+
+  size_t pairs = titles.size() * (titles.size() - 1) / 2;
+  printf("%-24s %9zu pairs | matrix %8lld us %9llu allocs"
+         " | myers %8lld us %6llu allocs | bounded %8lld us"
+         " | prepared %8lld us %6llu allocs | x%.1f%s\n",
+         name, pairs, (long long)matrix.time,
+         (unsigned long long)matrix.allocations, (long long)myers.time,
+         (unsigned long long)myers.allocations, (long long)bounded.time,
+         (long long)prepared.time, (unsigned long long)prepared.allocations,
+         myers.time > 0 ? (double)matrix.time / myers.time : 0.0,
+         same ? "" : "  MISMATCH");
+  return same;
+}
+
+void Usage() {
+  fprintf(stderr, "usage: match_bench [--iterations N] [--min-similarity F] "
+                  "[--synthetic N] <titles.txt>...\n");
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  int32 iterations = 5;
+  float minSimilarity = 0.5f;
+  std::vector<int32> synthetic;
+  std::vector<const char *> files;
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--iterations") == 0 && i + 1 < argc)
+      iterations = std::max(1, atoi(argv[++i]));
+    else if (strcmp(argv[i], "--min-similarity") == 0 && i + 1 < argc)
+      minSimilarity = std::min(1.0, std::max(0.0, atof(argv[++i])));
+    else if (strcmp(argv[i], "--synthetic") == 0 && i + 1 < argc)
+      synthetic.push_back(std::max(2, atoi(argv[++i])));
+    else if (argv[i][0] == '-') {
+      Usage();
+      return 2;
+    } else
+      files.push_back(argv[i]);
+  }
+  if (files.empty() && synthetic.empty()) {
+    Usage();
+    return 2;
+  }
+
+  bool same = true;
+  for (int32 count : synthetic) {
+    BString name;
+    name << "synthetic-" << count;
+    same = Run(name.String(), SyntheticTitles(count), iterations,
+               minSimilarity) && same;
+  }
+  for (const char *path : files) {
+    std::vector<BString> titles;
+    if (!ReadTitles(path, titles)) {
+      fprintf(stderr, "%s: cannot read\n", path);
+      same = false;
+      continue;
+    }
+    if (titles.size() < 2)
+      continue;
+    const char *name = strrchr(path, '/');
+    same = Run(name ? name + 1 : path, titles, iterations, minSimilarity) &&
+           same;
+  }
+  return same ? 0 : 1;
+}
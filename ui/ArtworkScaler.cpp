@@ -0,0 +1,188 @@
+#include "ArtworkScaler.h"
+#include "Debug.h"
+#include "Messages.h"
+
+#include <Bitmap.h>
+#include <Message.h>
+#include <OS.h>
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+/** @brief Fixed-point precision of the filter weights (they sum to 1 << 14). */
+static const int32 kWeightBits = 14;
+static const uint32 kWeightOne = 1u << kWeightBits;
+
+static int32 sNextImageId = 0;
+
+ArtworkImage::ArtworkImage(BBitmap *bitmap)
+    : fBitmap(bitmap), fId((uint32)atomic_add(&sNextImageId, 1) + 1) {}
+
+ArtworkImage::~ArtworkImage() { delete fBitmap; }
+
+/**
+ * @brief Source samples and weights of every target sample along one axis.
+ *
+ * Target sample `i` covers the source interval `[i, i + 1) * source / target`;
+ * each source sample is weighted by how much of it lies inside.
+ */
+struct FilterTaps {
+  std::vector<int32> first;
+  std::vector<int32> count;
+  std::vector<int32> offset; ///< Into weights
+  std::vector<uint32> weights;
+
+  FilterTaps(int32 source, int32 target)
+      : first(target), count(target), offset(target) {
+    double scale = (double)source / target;
+    for (int32 i = 0; i < target; i++) {
+      double lo = i * scale;
+      double hi = std::min((double)source, (i + 1) * scale);
+      int32 j0 = (int32)std::floor(lo);
+      int32 j1 = std::min(source - 1, (int32)std::ceil(hi) - 1);
+
+      first[i] = j0;
+      count[i] = j1 - j0 + 1;
+      offset[i] = (int32)weights.size();
+
+      // Weights are differences of the rounded cumulative coverage, so they
+      // sum to exactly one however many taps there are.
+      uint32 previous = 0;
+      for (int32 j = j0; j <= j1; j++) {
+        double covered = (std::min((double)j + 1, hi) - lo) / (hi - lo);
+        uint32 cumulative =
+            j == j1 ? kWeightOne : (uint32)std::lround(covered * kWeightOne);
+        weights.push_back(cumulative - previous);
+        previous = cumulative;
+      }
+    }
+  }
+};
+
+ArtworkScaler::ArtworkScaler(const BMessenger &target)
+    : BLooper("ArtworkScaler", B_LOW_PRIORITY), fTarget(target), fLatest(0) {}
+
+void ArtworkScaler::Request(ArtworkImage *image, int32 width, int32 height) {
+  if (image == nullptr)
+    return;
+
+  BMessage request(MSG_ARTWORK_SCALE);
+  request.AddPointer("image", image);
+  request.AddInt32("width", width);
+  request.AddInt32("height", height);
+  request.AddInt32("ticket", fLatest.fetch_add(1) + 1);
+
+  image->AcquireReference();
+  if (PostMessage(&request) != B_OK)
+    image->ReleaseReference();
+}
+
+void ArtworkScaler::MessageReceived(BMessage *msg) {
+  switch (msg->what) {
+  case MSG_ARTWORK_SCALE: {
+    ArtworkImage *image = nullptr;
+    if (msg->FindPointer("image", (void **)&image) != B_OK || image == nullptr)
+      break;
+    BReference<ArtworkImage> reference(image, true);
+
+    int32 width = 0, height = 0, ticket = 0;
+    msg->FindInt32("width", &width);
+    msg->FindInt32("height", &height);
+    msg->FindInt32("ticket", &ticket);
+    if (ticket != fLatest.load())
+      break;
+
+    bigtime_t start = system_time();
+    BBitmap *scaled = Downscale(image->Bitmap(), width, height);
+    if (scaled == nullptr)
+      break;
+    DEBUG_PRINT("ArtworkScaler: %ldx%ld in %lld us\n", (long)width,
+                (long)height, (long long)(system_time() - start));
+
+    BMessage result(MSG_ARTWORK_SCALED);
+    result.AddPointer("bitmap", scaled);
+    result.AddInt32("image_id", (int32)image->Id());
+    result.AddInt32("width", width);
+    result.AddInt32("height", height);
+    if (fTarget.SendMessage(&result) != B_OK)
+      delete scaled;
+    break;
+  }
+
+  default:
+    BLooper::MessageReceived(msg);
+  }
+}
+
+BBitmap *ArtworkScaler::Downscale(const BBitmap *source, int32 width,
+                                  int32 height) {
+  if (source == nullptr || !source->IsValid() || width <= 0 || height <= 0)
+    return nullptr;
+  color_space space = source->ColorSpace();
+  if (space != B_RGB32 && space != B_RGBA32)
+    return nullptr;
+
+  int32 sourceWidth = source->Bounds().IntegerWidth() + 1;
+  int32 sourceHeight = source->Bounds().IntegerHeight() + 1;
+  if (width > sourceWidth || height > sourceHeight)
+    return nullptr;
+
+  BBitmap *target = new BBitmap(BRect(0, 0, width - 1, height - 1), B_RGB32);
+  if (!target->IsValid()) {
+    delete target;
+    return nullptr;
+  }
+
+  const uint8 *sourceBits = static_cast<const uint8 *>(source->Bits());
+  int32 sourceStride = source->BytesPerRow();
+  uint8 *targetBits = static_cast<uint8 *>(target->Bits());
+  int32 targetStride = target->BytesPerRow();
+
+  FilterTaps columns(sourceWidth, width);
+  FilterTaps rows(sourceHeight, height);
+
+  // Horizontal pass: every source row to `width` pixels.
+  const int32 rowBytes = width * 4;
+  std::vector<uint8> narrow((size_t)sourceHeight * rowBytes);
+  for (int32 y = 0; y < sourceHeight; y++) {
+    const uint8 *in = sourceBits + (size_t)y * sourceStride;
+    uint8 *out = narrow.data() + (size_t)y * rowBytes;
+    for (int32 x = 0; x < width; x++) {
+      uint32 b = kWeightOne / 2, g = b, r = b, a = b;
+      const uint8 *pixel = in + columns.first[x] * 4;
+      const uint32 *weight = columns.weights.data() + columns.offset[x];
+      for (int32 k = 0; k < columns.count[x]; k++, pixel += 4) {
+        b += pixel[0] * weight[k];
+        g += pixel[1] * weight[k];
+        r += pixel[2] * weight[k];
+        a += pixel[3] * weight[k];
+      }
+      out[x * 4 + 0] = (uint8)(b >> kWeightBits);
+      out[x * 4 + 1] = (uint8)(g >> kWeightBits);
+      out[x * 4 + 2] = (uint8)(r >> kWeightBits);
+      out[x * 4 + 3] = (uint8)(a >> kWeightBits);
+    }
+  }
+
+  // Vertical pass: weighted sums of whole narrow rows.
+  std::vector<uint32> sums(rowBytes);
+  for (int32 y = 0; y < height; y++) {
+    std::fill(sums.begin(), sums.end(), kWeightOne / 2);
+    const uint32 *weight = rows.weights.data() + rows.offset[y];
+    for (int32 k = 0; k < rows.count[y]; k++) {
+      const uint8 *in =
+          narrow.data() + (size_t)(rows.first[y] + k) * rowBytes;
+      uint32 w = weight[k];
+      for (int32 i = 0; i < rowBytes; i++)
+        sums[i] += in[i] * w;
+    }
+
+    uint8 *out = targetBits + (size_t)y * targetStride;
+    for (int32 i = 0; i < rowBytes; i++)
+      out[i] = (uint8)(sums[i] >> kWeightBits);
+    for (int32 x = 0; x < width; x++)
+      out[x * 4 + 3] = 255;
+  }
+
+  return target;
+}
@@ -0,0 +1,66 @@
+#ifndef BETON_ARTWORK_SCALER_H
+#define BETON_ARTWORK_SCALER_H
+
+#include <Looper.h>
+#include <Messenger.h>
+#include <Referenceable.h>
+#include <SupportDefs.h>
+#include <atomic>
+
+class BBitmap;
+
+/**
+ * @class ArtworkImage
+ * @brief Immutable, reference-counted cover bitmap shared with the scaler.
+ */
+class ArtworkImage : public BReferenceable {
+public:
+  /** @brief Takes ownership of `bitmap` (B_RGB32 or B_RGBA32). */
+  explicit ArtworkImage(BBitmap *bitmap);
+  ~ArtworkImage() override;
+
+  const BBitmap *Bitmap() const { return fBitmap; }
+
+  /** @brief Process-wide unique id, used to key scaled copies. */
+  uint32 Id() const { return fId; }
+
+private:
+  BBitmap *fBitmap;
+  uint32 fId;
+};
+
+/**
+ * @class ArtworkScaler
+ * @brief Looper that downscales covers off the window thread.
+ *
+ * Only the newest request is worked on: requests that were superseded while
+ * queued are dropped. Each result is sent to the target as
+ * `MSG_ARTWORK_SCALED` with "bitmap" (a new B_RGB32 `BBitmap` owned by the
+ * receiver), "image_id", "width" and "height".
+ */
+class ArtworkScaler : public BLooper {
+public:
+  explicit ArtworkScaler(const BMessenger &target);
+
+  /** @brief Queues scaling `image` to `width` x `height` pixels. */
+  void Request(ArtworkImage *image, int32 width, int32 height);
+
+  void MessageReceived(BMessage *msg) override;
+
+  /**
+   * @brief Area-averaging (box filter) downscale of a 32-bit bitmap.
+   *
+   * Works on the raw buffers in two separable fixed-point passes; the inner
+   * loops run over contiguous rows so the compiler can vectorize them.
+   *
+   * @return New B_RGB32 bitmap, or nullptr on failure or if the target is
+   * not smaller than the source.
+   */
+  static BBitmap *Downscale(const BBitmap *source, int32 width, int32 height);
+
+private:
+  BMessenger fTarget;
+  std::atomic<int32> fLatest;
+};
+
+#endif // BETON_ARTWORK_SCALER_H
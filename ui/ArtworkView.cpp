@@ -1,4 +1,6 @@
 #include "ArtworkView.h"
+#include "Messages.h"
+
 #include <algorithm>
 #include <Bitmap.h>
 #include <Catalog.h>
@@ -24,58 +26,8 @@ static int32 PixelHeight(const BBitmap *bitmap) {
   return bitmap ? bitmap->Bounds().IntegerHeight() + 1 : 0;
 }
 
-static BBitmap *ScaleBitmap(const BBitmap *source, int32 width, int32 height) {
-  if (!source || !source->IsValid() || width <= 0 || height <= 0)
-    return nullptr;
-
-  BRect bounds(0, 0, width - 1, height - 1);
-  BBitmap *target = new BBitmap(bounds, B_RGB32, true);
-  if (!target->IsValid()) {
-    delete target;
-    return nullptr;
-  }
-
-  BView *canvas = new BView(bounds, "artwork scaler", B_FOLLOW_NONE, 0);
-  target->AddChild(canvas);
-  canvas->LockLooper();
-  canvas->SetDrawingMode(B_OP_COPY);
-  canvas->DrawBitmap(source, source->Bounds(), bounds, B_FILTER_BITMAP_BILINEAR);
-  canvas->Sync();
-  canvas->UnlockLooper();
-  target->RemoveChild(canvas);
-  delete canvas;
-
-  return target;
-}
-
-static BBitmap *ScaleBitmapStepwise(const BBitmap *source, int32 targetWidth,
-                                    int32 targetHeight) {
-  int32 currentWidth = PixelWidth(source);
-  int32 currentHeight = PixelHeight(source);
-  if (currentWidth <= 0 || currentHeight <= 0)
-    return nullptr;
-
-  const BBitmap *current = source;
-  BBitmap *owned = nullptr;
-
-  while (currentWidth / 2 >= targetWidth && currentHeight / 2 >= targetHeight) {
-    int32 nextWidth = std::max(targetWidth, currentWidth / 2);
-    int32 nextHeight = std::max(targetHeight, currentHeight / 2);
-    BBitmap *next = ScaleBitmap(current, nextWidth, nextHeight);
-    if (!next)
-      break;
-
-    delete owned;
-    owned = next;
-    current = owned;
-    currentWidth = nextWidth;
-    currentHeight = nextHeight;
-  }
-
-  BBitmap *result = ScaleBitmap(current, targetWidth, targetHeight);
-  delete owned;
-  return result;
-}
+/** @brief Scaled covers kept per view (current and recent sizes). */
+static const size_t kScaledCoverCount = 4;
 
 }
 /* namespace */
@@ -85,11 +37,28 @@ ArtworkView::ArtworkView(const char *name)
   SetViewColor(B_TRANSPARENT_COLOR);
 }
 
-ArtworkView::~ArtworkView() {
-  delete fBitmap;
-  fBitmap = nullptr;
-  delete fScaledBitmap;
-  fScaledBitmap = nullptr;
+ArtworkView::~ArtworkView() { _ClearScaledCovers(); }
+
+void ArtworkView::AttachedToWindow() {
+  BView::AttachedToWindow();
+
+  fScaler = new ArtworkScaler(BMessenger(this));
+  if (fScaler->Run() < 0) {
+    fScaler->Lock();
+    fScaler->Quit();
+    fScaler = nullptr;
+  }
+}
+
+void ArtworkView::DetachedFromWindow() {
+  if (fScaler != nullptr) {
+    fScaler->Lock();
+    fScaler->Quit();
+    fScaler = nullptr;
+  }
+  fRequestedId = 0;
+
+  BView::DetachedFromWindow();
 }
 
 /**
@@ -99,20 +68,33 @@ ArtworkView::~ArtworkView() {
  * @param bmp The new bitmap to display (can be nullptr to clear).
  */
 void ArtworkView::SetBitmap(BBitmap *bmp) {
-  if (fBitmap == nullptr && bmp == nullptr)
+  if (fImage.Get() == nullptr && bmp == nullptr)
     return;
 
+  // The scaler reads 32-bit pixels; convert anything else once here.
   BBitmap *clone = nullptr;
   if (bmp && bmp->IsValid()) {
-    clone = new BBitmap(bmp);
-    if (!clone->IsValid()) {
+    color_space space = bmp->ColorSpace();
+    if (space == B_RGB32 || space == B_RGBA32) {
+      clone = new BBitmap(bmp);
+    } else {
+      clone = new BBitmap(bmp->Bounds(), B_RGBA32);
+      if (clone->IsValid() && clone->ImportBits(bmp) != B_OK) {
+        delete clone;
+        clone = nullptr;
+      }
+    }
+    if (clone && !clone->IsValid()) {
       delete clone;
       clone = nullptr;
     }
   }
-  delete fBitmap;
-  fBitmap = clone;
-  _InvalidateScaledBitmap();
+
+  // Keep showing the previous cover until the new one is scaled; a cleared
+  // cover switches to the placeholder right away.
+  fImage.SetTo(clone ? new ArtworkImage(clone) : nullptr, true);
+  if (clone == nullptr)
+    fShownBitmap = nullptr;
 
   Invalidate();
 }
@@ -125,7 +107,8 @@ void ArtworkView::Draw(BRect updateRect) {
   SetHighColor(panelBg);
   FillRect(Bounds());
 
-  if (!fBitmap || !fBitmap->IsValid()) {
+  const BBitmap *source = _Source();
+  if (source == nullptr) {
     BRect b = Bounds();
     rgb_color placeholderBg =
         Luminance(panelBg) > 0.5f ? tint_color(panelBg, B_DARKEN_1_TINT)
@@ -153,14 +136,31 @@ void ArtworkView::Draw(BRect updateRect) {
   }
 
   BRect frame = _CoverFrame();
-  _UpdateScaledBitmap();
+  if (!frame.IsValid())
+    return;
 
-  if (fScaledBitmap) {
+  int32 width = frame.IntegerWidth() + 1;
+  int32 height = frame.IntegerHeight() + 1;
+  bool downscale = width < PixelWidth(source) && height < PixelHeight(source);
+  const BBitmap *scaled = downscale ? _ScaledBitmap(frame) : nullptr;
+
+  if (scaled) {
+    // An older size (or cover) is stretched until the scaler catches up.
     SetDrawingMode(B_OP_COPY);
-    DrawBitmapAsync(fScaledBitmap, fScaledFrame.LeftTop());
-  } else if (frame.IsValid()) {
+    if (PixelWidth(scaled) == width && PixelHeight(scaled) == height)
+      DrawBitmapAsync(scaled, frame.LeftTop());
+    else
+      DrawBitmapAsync(scaled, scaled->Bounds(), frame,
+                      B_FILTER_BITMAP_BILINEAR);
+  } else {
+    // Upscaling is cheap for app_server; a large source without any scaled
+    // copy yet is drawn unfiltered for the moment.
     SetDrawingMode(B_OP_ALPHA);
-    DrawBitmapAsync(fBitmap, fBitmap->Bounds(), frame, B_FILTER_BITMAP_BILINEAR);
+    if (downscale)
+      DrawBitmapAsync(source, source->Bounds(), frame);
+    else
+      DrawBitmapAsync(source, source->Bounds(), frame,
+                      B_FILTER_BITMAP_BILINEAR);
   }
   SetDrawingMode(B_OP_COPY);
 }
@@ -170,6 +170,9 @@ void ArtworkView::MessageReceived(BMessage *msg) {
   case B_COLORS_UPDATED:
     Invalidate();
     break;
+  case MSG_ARTWORK_SCALED:
+    _AddScaledCover(msg);
+    break;
   default:
     BView::MessageReceived(msg);
     break;
@@ -185,7 +188,6 @@ void ArtworkView::GetPreferredSize(float *w, float *h) {
 
 void ArtworkView::FrameResized(float width, float height) {
   BView::FrameResized(width, height);
-  _InvalidateScaledBitmap();
 }
 
 bool ArtworkView::HasHeightForWidth() {
@@ -198,13 +200,18 @@ void ArtworkView::GetHeightForWidth(float width, float* min, float* max, float*
   if (pref) *pref = width;
 }
 
+const BBitmap *ArtworkView::_Source() const {
+  return fImage.Get() != nullptr ? fImage->Bitmap() : nullptr;
+}
+
 BRect ArtworkView::_CoverFrame() const {
   BRect bounds = Bounds();
-  if (!fBitmap || !fBitmap->IsValid() || !bounds.IsValid())
+  const BBitmap *source = _Source();
+  if (!source || !bounds.IsValid())
     return BRect();
 
-  int32 sourceWidth = PixelWidth(fBitmap);
-  int32 sourceHeight = PixelHeight(fBitmap);
+  int32 sourceWidth = PixelWidth(source);
+  int32 sourceHeight = PixelHeight(source);
   int32 boundsWidth = bounds.IntegerWidth() + 1;
   int32 boundsHeight = bounds.IntegerHeight() + 1;
   if (sourceWidth <= 0 || sourceHeight <= 0 || boundsWidth <= 0 ||
@@ -223,24 +230,85 @@ BRect ArtworkView::_CoverFrame() const {
   return BRect(left, top, left + targetWidth - 1, top + targetHeight - 1);
 }
 
-void ArtworkView::_InvalidateScaledBitmap() {
-  delete fScaledBitmap;
-  fScaledBitmap = nullptr;
-  fScaledFrame = BRect();
+void ArtworkView::_ClearScaledCovers() {
+  for (ScaledCover &cover : fScaledCovers)
+    delete cover.bitmap;
+  fScaledCovers.clear();
+  fShownBitmap = nullptr;
 }
 
-void ArtworkView::_UpdateScaledBitmap() {
-  BRect frame = _CoverFrame();
-  if (!frame.IsValid())
-    return;
-
+/**
+ * @brief Returns the bitmap to draw into `frame`.
+ *
+ * That is the cached copy of the current image at this size if there is
+ * one. Otherwise the copy is requested from the scaler (once) and the
+ * bitmap shown last is returned, which may be nullptr.
+ */
+const BBitmap *ArtworkView::_ScaledBitmap(BRect frame) {
+  uint32 id = fImage->Id();
   int32 width = frame.IntegerWidth() + 1;
   int32 height = frame.IntegerHeight() + 1;
-  if (fScaledBitmap && fScaledFrame == frame &&
-      PixelWidth(fScaledBitmap) == width && PixelHeight(fScaledBitmap) == height)
+
+  for (auto it = fScaledCovers.begin(); it != fScaledCovers.end(); ++it) {
+    if (it->imageId == id && it->width == width && it->height == height) {
+      fScaledCovers.splice(fScaledCovers.begin(), fScaledCovers, it);
+      fShownBitmap = it->bitmap;
+      return fShownBitmap;
+    }
+  }
+
+  if (fScaler == nullptr) {
+    BMessage result(MSG_ARTWORK_SCALED);
+    result.AddPointer("bitmap",
+                      ArtworkScaler::Downscale(fImage->Bitmap(), width, height));
+    result.AddInt32("image_id", (int32)id);
+    result.AddInt32("width", width);
+    result.AddInt32("height", height);
+    _AddScaledCover(&result);
+    return fShownBitmap;
+  }
+
+  if (fRequestedId != id || fRequestedWidth != width ||
+      fRequestedHeight != height) {
+    fRequestedId = id;
+    fRequestedWidth = width;
+    fRequestedHeight = height;
+    fScaler->Request(fImage.Get(), width, height);
+  }
+  return fShownBitmap;
+}
+
+/** @brief Takes a result of the scaler into the cache. */
+void ArtworkView::_AddScaledCover(BMessage *msg) {
+  BBitmap *bitmap = nullptr;
+  if (msg->FindPointer("bitmap", (void **)&bitmap) != B_OK ||
+      bitmap == nullptr)
     return;
 
-  delete fScaledBitmap;
-  fScaledBitmap = ScaleBitmapStepwise(fBitmap, width, height);
-  fScaledFrame = fScaledBitmap ? frame : BRect();
+  int32 imageId = 0;
+  ScaledCover cover;
+  cover.bitmap = bitmap;
+  cover.width = 0;
+  cover.height = 0;
+  msg->FindInt32("image_id", &imageId);
+  msg->FindInt32("width", &cover.width);
+  msg->FindInt32("height", &cover.height);
+  cover.imageId = (uint32)imageId;
+
+  // Results for a replaced cover are of no use any more.
+  if (fImage.Get() == nullptr || cover.imageId != fImage->Id()) {
+    delete bitmap;
+    return;
+  }
+
+  fScaledCovers.push_front(cover);
+  fShownBitmap = bitmap;
+  while (fScaledCovers.size() > kScaledCoverCount) {
+    delete fScaledCovers.back().bitmap;
+    fScaledCovers.pop_back();
+  }
+
+  if (cover.width == fRequestedWidth && cover.height == fRequestedHeight)
+    fRequestedId = 0;
+  Invalidate();
 }
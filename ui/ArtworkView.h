@@ -1,7 +1,11 @@
 #ifndef BETON_ARTWORK_VIEW_H
 #define BETON_ARTWORK_VIEW_H
 
+#include "ArtworkScaler.h"
+
 #include <View.h>
+#include <list>
+
 class BBitmap;
 
 /**
@@ -11,6 +15,11 @@ class BBitmap;
  * It handles:
  * - Scaling the image to fit the view.
  * - Managing the lifecycle of the BBitmap (takes ownership).
+ *
+ * Downscaling runs on an `ArtworkScaler` while the view is attached. Until
+ * a result for the current size arrives, the previous scaled cover is drawn
+ * stretched into the new frame. The last few results stay cached, so
+ * resizing back and forth does not scale again.
  */
 class ArtworkView : public BView {
 public:
@@ -25,6 +34,8 @@ public:
    */
   void SetBitmap(BBitmap *bmp);
 
+  void AttachedToWindow() override;
+  void DetachedFromWindow() override;
   void Draw(BRect update) override;
   void MessageReceived(BMessage *msg) override;
   void GetPreferredSize(float *w, float *h) override;
@@ -35,15 +46,29 @@ public:
                          float *pref) override;
 
 private:
+  /** @brief Scaled copy of an image at one size. */
+  struct ScaledCover {
+    uint32 imageId;
+    int32 width;
+    int32 height;
+    BBitmap *bitmap;
+  };
+
+  const BBitmap *_Source() const;
   BRect _CoverFrame() const;
-  void _InvalidateScaledBitmap();
-  void _UpdateScaledBitmap();
+  void _ClearScaledCovers();
+  const BBitmap *_ScaledBitmap(BRect frame);
+  void _AddScaledCover(BMessage *msg);
 
   /** @name Data */
   ///@{
-  BBitmap *fBitmap = nullptr;
-  BBitmap *fScaledBitmap = nullptr;
-  BRect fScaledFrame;
+  BReference<ArtworkImage> fImage;
+  std::list<ScaledCover> fScaledCovers; ///< Most recently used first
+  const BBitmap *fShownBitmap = nullptr; ///< Scaled cover drawn last
+  uint32 fRequestedId = 0;
+  int32 fRequestedWidth = 0;
+  int32 fRequestedHeight = 0;
+  ArtworkScaler *fScaler = nullptr;
   ///@}
 };
 
@@ -0,0 +1,101 @@
+#include "AudioHealthWindow.h"
+#include "Messages.h"
+
+#include <Button.h>
+#include <Catalog.h>
+#include <File.h>
+#include <FindDirectory.h>
+#include <LayoutBuilder.h>
+#include <MessageRunner.h>
+#include <Path.h>
+#include <ScrollView.h>
+#include <StringView.h>
+#include <TextView.h>
+
+#undef B_TRANSLATION_CONTEXT
+#define B_TRANSLATION_CONTEXT "AudioHealthWindow"
+
+AudioHealthWindow::AudioHealthWindow(const BMessenger &target)
+    : BWindow(BRect(100, 100, 700, 500), B_TRANSLATE("Audio Engine Health"),
+              B_TITLED_WINDOW, B_ASYNCHRONOUS_CONTROLS),
+      fTarget(target), fRunner(nullptr) {
+  fText = new BTextView("health");
+  fText->MakeEditable(false);
+  fText->SetFontAndColor(be_fixed_font);
+  fText->SetWordWrap(false);
+  BScrollView *scroll = new BScrollView("scroll", fText, 0, true, true);
+
+  fStatus = new BStringView("status", "");
+  fBtnReset = new BButton("Reset", B_TRANSLATE("Reset"),
+                          new BMessage(MSG_AUDIO_HEALTH_RESET));
+  fBtnSave = new BButton("Save", B_TRANSLATE("Save to Desktop"),
+                         new BMessage(MSG_AUDIO_HEALTH_SAVE));
+
+  BLayoutBuilder::Group<>(this, B_VERTICAL, 10)
+      .SetInsets(10, 10, 10, 10)
+      .Add(scroll)
+      .AddGroup(B_HORIZONTAL, 10)
+      .Add(fStatus)
+      .AddGlue()
+      .Add(fBtnReset)
+      .Add(fBtnSave)
+      .End();
+
+  font_height fh;
+  be_fixed_font->GetHeight(&fh);
+  float fontHeight = fh.ascent + fh.descent + fh.leading;
+  ResizeTo(be_fixed_font->StringWidth("x") * 70, fontHeight * 28);
+  CenterOnScreen();
+
+  _RequestReport();
+  BMessage tick(MSG_AUDIO_HEALTH_REFRESH);
+  fRunner = new BMessageRunner(BMessenger(this), &tick, 1000000);
+}
+
+AudioHealthWindow::~AudioHealthWindow() { delete fRunner; }
+
+void AudioHealthWindow::MessageReceived(BMessage *msg) {
+  switch (msg->what) {
+  case MSG_AUDIO_HEALTH_REFRESH:
+    _RequestReport();
+    break;
+  case MSG_AUDIO_HEALTH_REPORT: {
+    const char *report = nullptr;
+    if (msg->FindString("report", &report) == B_OK)
+      fText->SetText(report);
+    break;
+  }
+  case MSG_AUDIO_HEALTH_RESET:
+    fTarget.SendMessage(MSG_AUDIO_HEALTH_RESET);
+    _RequestReport();
+    break;
+  case MSG_AUDIO_HEALTH_SAVE:
+    _Save();
+    break;
+  default:
+    BWindow::MessageReceived(msg);
+  }
+}
+
+void AudioHealthWindow::_RequestReport() {
+  BMessage request(MSG_AUDIO_HEALTH_REPORT);
+  fTarget.SendMessage(&request, this);
+}
+
+void AudioHealthWindow::_Save() {
+  BPath path;
+  if (find_directory(B_DESKTOP_DIRECTORY, &path) != B_OK)
+    return;
+  path.Append("BeTon audio health.txt");
+
+  BFile file(path.Path(), B_WRITE_ONLY | B_CREATE_FILE | B_ERASE_FILE);
+  ssize_t length = fText->TextLength();
+  if (file.InitCheck() == B_OK &&
+      file.Write(fText->Text(), length) == length) {
+    BString text(B_TRANSLATE("Saved to %path%"));
+    text.ReplaceFirst("%path%", path.Path());
+    fStatus->SetText(text.String());
+  } else {
+    fStatus->SetText(B_TRANSLATE("Could not save the report"));
+  }
+}
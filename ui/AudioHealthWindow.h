@@ -0,0 +1,40 @@
+#ifndef BETON_AUDIO_HEALTH_WINDOW_H
+#define BETON_AUDIO_HEALTH_WINDOW_H
+
+#include <Messenger.h>
+#include <Window.h>
+
+class BButton;
+class BMessageRunner;
+class BStringView;
+class BTextView;
+
+/**
+ * @class AudioHealthWindow
+ * @brief Debug window showing AudioPlaybackEngine::HealthReport(), refreshed
+ * every second.
+ *
+ * The report is requested from `target` (the main window, which owns the
+ * engine) with `MSG_AUDIO_HEALTH_REPORT`, so the window never touches the
+ * engine itself.
+ */
+class AudioHealthWindow : public BWindow {
+public:
+  explicit AudioHealthWindow(const BMessenger &target);
+  ~AudioHealthWindow() override;
+
+  void MessageReceived(BMessage *msg) override;
+
+private:
+  void _RequestReport();
+  void _Save();
+
+  BMessenger fTarget;
+  BTextView *fText;
+  BStringView *fStatus;
+  BButton *fBtnReset;
+  BButton *fBtnSave;
+  BMessageRunner *fRunner;
+};
+
+#endif // BETON_AUDIO_HEALTH_WINDOW_H
@@ -0,0 +1,272 @@
+#include "DuplicateFinderWindow.h"
+#include "Messages.h"
+
+#include <Button.h>
+#include <Catalog.h>
+#include <Entry.h>
+#include <LayoutBuilder.h>
+#include <OutlineListView.h>
+#include <Path.h>
+#include <ScrollView.h>
+#include <StatusBar.h>
+#include <StringForSize.h>
+#include <StringItem.h>
+#include <StringView.h>
+
+#undef B_TRANSLATION_CONTEXT
+#define B_TRANSLATION_CONTEXT "DuplicateFinderWindow"
+
+/**
+ * @class DuplicateFileItem
+ * @brief Child row of a group; keeps the full path of the file.
+ */
+class DuplicateFileItem : public BStringItem {
+public:
+  DuplicateFileItem(const char *text, const BString &path)
+      : BStringItem(text, 1), fPath(path) {}
+
+  const BString &Path() const { return fPath; }
+
+private:
+  BString fPath;
+};
+
+static const char *KindLabel(int32 kind) {
+  switch (kind) {
+  case DuplicateFinder::kSameFile:
+    return B_TRANSLATE("Same file");
+  case DuplicateFinder::kIdenticalAudio:
+    return B_TRANSLATE("Identical audio");
+  default:
+    return B_TRANSLATE("Same recording");
+  }
+}
+
+DuplicateFinderWindow::DuplicateFinderWindow(BMessenger target,
+                                             LibrarySnapshot *snapshot)
+    : BWindow(BRect(100, 100, 700, 500), B_TRANSLATE("Find Duplicates"),
+              B_TITLED_WINDOW, B_ASYNCHRONOUS_CONTROLS),
+      fTarget(target), fSnapshot(snapshot), fFinder(BMessenger(this)) {
+  fGroupList = new BOutlineListView("groupList", B_MULTIPLE_SELECTION_LIST);
+  fGroupList->SetSelectionMessage(new BMessage(MSG_SELECTION_CHANGED));
+  fGroupList->SetInvocationMessage(new BMessage(MSG_DUPLICATE_REVEAL));
+  BScrollView *scroll = new BScrollView("scroll", fGroupList, 0, true, true);
+
+  fProgress = new BStatusBar("progress");
+  fSummary = new BStringView("summary", "");
+
+  fBtnReveal = new BButton("Reveal", B_TRANSLATE("Show in Tracker"),
+                           new BMessage(MSG_DUPLICATE_REVEAL));
+  fBtnRescan = new BButton("Rescan", B_TRANSLATE("Search again"),
+                           new BMessage(MSG_DUPLICATE_RESCAN));
+  fBtnClose = new BButton("Close", B_TRANSLATE("Close"),
+                          new BMessage(B_QUIT_REQUESTED));
+
+  BLayoutBuilder::Group<>(this, B_VERTICAL, 10)
+      .SetInsets(10, 10, 10, 10)
+      .Add(scroll)
+      .Add(fProgress)
+      .AddGroup(B_HORIZONTAL, 10)
+      .Add(fSummary)
+      .AddGlue()
+      .Add(fBtnReveal)
+      .Add(fBtnRescan)
+      .Add(fBtnClose)
+      .End();
+
+  font_height fh;
+  be_plain_font->GetHeight(&fh);
+  float fontHeight = fh.ascent + fh.descent + fh.leading;
+
+  ResizeTo(fontHeight * 45, fontHeight * 28);
+  CenterOnScreen();
+
+  _Start();
+}
+
+DuplicateFinderWindow::~DuplicateFinderWindow() {
+  fFinder.Cancel();
+
+  for (int32 i = fGroupList->FullListCountItems() - 1; i >= 0; i--)
+    delete fGroupList->FullListItemAt(i);
+}
+
+bool DuplicateFinderWindow::QuitRequested() {
+  fFinder.Cancel();
+  return true;
+}
+
+void DuplicateFinderWindow::_Start() {
+  for (int32 i = fGroupList->FullListCountItems() - 1; i >= 0; i--)
+    delete fGroupList->RemoveItem(fGroupList->FullListItemAt(i));
+
+  fProgress->Reset(B_TRANSLATE("Reading library..."));
+  fSummary->SetText("");
+  fBtnRescan->SetEnabled(false);
+  _UpdateButtons();
+
+  if (fFinder.Start(fSnapshot.Get()) != B_OK) {
+    fProgress->Reset(B_TRANSLATE("Could not start the search"));
+    fBtnRescan->SetEnabled(true);
+  }
+}
+
+void DuplicateFinderWindow::_ShowProgress(BMessage *msg) {
+  int32 stage = 0, current = 0, total = 0;
+  msg->FindInt32("stage", &stage);
+  msg->FindInt32("current", &current);
+  msg->FindInt32("total", &total);
+
+  const char *label;
+  switch (stage) {
+  case DuplicateFinder::kStageKeys:
+    label = B_TRANSLATE("Comparing tags and sizes...");
+    break;
+  case DuplicateFinder::kStageHashing:
+    label = B_TRANSLATE("Comparing audio data...");
+    break;
+  default:
+    label = B_TRANSLATE("Grouping recordings...");
+    break;
+  }
+
+  BString trailing;
+  if (stage == DuplicateFinder::kStageHashing)
+    trailing << current << " / " << total;
+
+  fProgress->SetMaxValue(total > 0 ? total : 1);
+  fProgress->Update(current - fProgress->CurrentValue(), label,
+                    trailing.String());
+}
+
+void DuplicateFinderWindow::_ShowGroups(BMessage *msg) {
+  int32 groups = 0, files = 0;
+  BMessage group;
+  for (int32 g = 0; msg->FindMessage("group", g, &group) == B_OK; g++) {
+    int32 kind = 0;
+    group.FindInt32("kind", &kind);
+
+    int32 count = 0;
+    type_code type;
+    group.GetInfo("path", &type, &count);
+
+    BString title;
+    title << KindLabel(kind) << " (" << count << ")";
+    BStringItem *header = new BStringItem(title.String());
+    fGroupList->AddItem(header);
+
+    BString path;
+    for (int32 i = 0; group.FindString("path", i, &path) == B_OK; i++) {
+      int64 size = 0;
+      int32 bitrate = 0;
+      group.FindInt64("size", i, &size);
+      group.FindInt32("bitrate", i, &bitrate);
+
+      char sizeText[64];
+      BString text(path);
+      text << "  (" << string_for_size((double)size, sizeText,
+                                       sizeof(sizeText));
+      if (bitrate > 0)
+        text << ", " << bitrate << " kbps";
+      text << ")";
+      fGroupList->AddUnder(new DuplicateFileItem(text.String(), path), header);
+    }
+
+    groups++;
+    files += count;
+  }
+
+  int32 scanned = 0;
+  msg->FindInt32("scanned", &scanned);
+
+  BString summary;
+  if (groups == 0) {
+    summary = B_TRANSLATE("No duplicates found");
+  } else {
+    summary = B_TRANSLATE("%groups% groups, %files% files");
+    summary.ReplaceFirst("%groups%", BString() << groups);
+    summary.ReplaceFirst("%files%", BString() << files);
+  }
+  fSummary->SetText(summary.String());
+
+  BString done(B_TRANSLATE("%items% tracks checked"));
+  done.ReplaceFirst("%items%", BString() << scanned);
+  fProgress->SetMaxValue(1);
+  fProgress->Reset(done.String());
+  fProgress->Update(1);
+
+  fBtnRescan->SetEnabled(true);
+  _UpdateButtons();
+}
+
+/**
+ * @brief Sends the selected files to the main window for revealing.
+ *
+ * A selected group row stands for all of its files.
+ */
+void DuplicateFinderWindow::_RevealSelection() {
+  BMessage reveal(MSG_REVEAL_IN_TRACKER);
+  int32 added = 0;
+
+  auto addFile = [&](BListItem *item) {
+    auto *file = dynamic_cast<DuplicateFileItem *>(item);
+    entry_ref ref;
+    if (file != nullptr &&
+        get_ref_for_path(file->Path().String(), &ref) == B_OK) {
+      reveal.AddRef("refs", &ref);
+      added++;
+    }
+  };
+
+  int32 selected;
+  for (int32 i = 0; (selected = fGroupList->CurrentSelection(i)) >= 0; i++) {
+    BListItem *item = fGroupList->ItemAt(selected);
+    if (item == nullptr)
+      continue;
+    if (item->OutlineLevel() == 0) {
+      int32 children = fGroupList->CountItemsUnder(item, true);
+      for (int32 c = 0; c < children; c++) {
+        BListItem *child = fGroupList->ItemUnderAt(item, true, c);
+        if (!child->IsSelected())
+          addFile(child);
+      }
+    } else {
+      addFile(item);
+    }
+  }
+
+  if (added > 0)
+    fTarget.SendMessage(&reveal);
+}
+
+void DuplicateFinderWindow::_UpdateButtons() {
+  fBtnReveal->SetEnabled(fGroupList->CurrentSelection() >= 0);
+}
+
+void DuplicateFinderWindow::MessageReceived(BMessage *msg) {
+  switch (msg->what) {
+  case MSG_DUPLICATE_PROGRESS:
+    _ShowProgress(msg);
+    break;
+
+  case MSG_DUPLICATES_FOUND:
+    _ShowGroups(msg);
+    break;
+
+  case MSG_SELECTION_CHANGED:
+    _UpdateButtons();
+    break;
+
+  case MSG_DUPLICATE_REVEAL:
+    _RevealSelection();
+    break;
+
+  case MSG_DUPLICATE_RESCAN:
+    _Start();
+    break;
+
+  default:
+    BWindow::MessageReceived(msg);
+    break;
+  }
+}
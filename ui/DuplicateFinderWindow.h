@@ -0,0 +1,62 @@
+#ifndef BETON_DUPLICATE_FINDER_WINDOW_H
+#define BETON_DUPLICATE_FINDER_WINDOW_H
+
+#include "DuplicateFinder.h"
+#include "LibrarySnapshot.h"
+
+#include <Messenger.h>
+#include <Window.h>
+
+class BButton;
+class BOutlineListView;
+class BStatusBar;
+class BStringView;
+
+/**
+ * @class DuplicateFinderWindow
+ * @brief Window listing the duplicate groups found by `DuplicateFinder`.
+ *
+ * Starts a search over the given snapshot when opened and shows its progress.
+ * Each group is a collapsible row with one child per file; a file (or all
+ * files of a group) can be revealed in Tracker through the main window.
+ */
+class DuplicateFinderWindow : public BWindow {
+public:
+  /**
+   * @brief Constructs the window and starts the search.
+   *
+   * @param target Main window; receives `MSG_REVEAL_IN_TRACKER`.
+   * @param snapshot Library items to search.
+   */
+  DuplicateFinderWindow(BMessenger target, LibrarySnapshot *snapshot);
+  ~DuplicateFinderWindow() override;
+
+  void MessageReceived(BMessage *msg) override;
+  bool QuitRequested() override;
+
+private:
+  void _Start();
+  void _ShowProgress(BMessage *msg);
+  void _ShowGroups(BMessage *msg);
+  void _RevealSelection();
+  void _UpdateButtons();
+
+  /** @name Data */
+  ///@{
+  BMessenger fTarget;
+  BReference<LibrarySnapshot> fSnapshot;
+  DuplicateFinder fFinder;
+  ///@}
+
+  /** @name UI Components */
+  ///@{
+  BOutlineListView *fGroupList;
+  BStatusBar *fProgress;
+  BStringView *fSummary;
+  BButton *fBtnReveal;
+  BButton *fBtnRescan;
+  BButton *fBtnClose;
+  ///@}
+};
+
+#endif // BETON_DUPLICATE_FINDER_WINDOW_H
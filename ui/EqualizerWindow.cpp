@@ -0,0 +1,114 @@
+#include "EqualizerWindow.h"
+#include "Messages.h"
+
+#include <Button.h>
+#include <Catalog.h>
+#include <CheckBox.h>
+#include <LayoutBuilder.h>
+#include <Slider.h>
+#include <String.h>
+
+#include <cmath>
+
+#undef B_TRANSLATION_CONTEXT
+#define B_TRANSLATION_CONTEXT "EqualizerWindow"
+
+/** @brief Slider range in dB, for the preamp and every band. */
+static const int32 kRange = 12;
+
+static BString FrequencyLabel(float frequency) {
+  BString label;
+  if (frequency >= 1000.0f)
+    label.SetToFormat(B_TRANSLATE("%g kHz"), frequency / 1000.0f);
+  else
+    label.SetToFormat(B_TRANSLATE("%g Hz"), frequency);
+  return label;
+}
+
+static BSlider *GainSlider(const char *name, const char *label,
+                           orientation direction) {
+  BSlider *slider = new BSlider(name, label,
+                                new BMessage(MSG_EQUALIZER_CHANGED), -kRange,
+                                kRange, direction);
+  slider->SetModificationMessage(new BMessage(MSG_EQUALIZER_CHANGED));
+  slider->SetHashMarks(B_HASH_MARKS_BOTH);
+  slider->SetHashMarkCount(2 * kRange / 6 + 1);
+  return slider;
+}
+
+EqualizerWindow::EqualizerWindow(const BMessenger &target,
+                                 const DspSettings &settings)
+    : BWindow(BRect(100, 100, 560, 420), B_TRANSLATE("Equalizer"),
+              B_TITLED_WINDOW,
+              B_ASYNCHRONOUS_CONTROLS | B_AUTO_UPDATE_SIZE_LIMITS),
+      fTarget(target), fSettings(settings) {
+  fEnabled = new BCheckBox("enabled", B_TRANSLATE("Enable"),
+                           new BMessage(MSG_EQUALIZER_CHANGED));
+  fLimiter = new BCheckBox("limiter", B_TRANSLATE("Limiter"),
+                           new BMessage(MSG_EQUALIZER_CHANGED));
+  fPreamp = GainSlider("preamp", B_TRANSLATE("Preamp"), B_VERTICAL);
+
+  BGroupLayout *bands = new BGroupLayout(B_HORIZONTAL, 10);
+  bands->AddView(fPreamp);
+  for (int32 i = 0; i < DspSettings::kBands; i++) {
+    BString label = FrequencyLabel(fSettings.bands[i].frequency);
+    fBands[i] = GainSlider("band", label.String(), B_VERTICAL);
+    bands->AddView(fBands[i]);
+  }
+
+  BButton *flat = new BButton("flat", B_TRANSLATE("Flat"),
+                              new BMessage(MSG_EQUALIZER_FLAT));
+
+  BLayoutBuilder::Group<>(this, B_VERTICAL, 10)
+      .SetInsets(10, 10, 10, 10)
+      .Add(fEnabled)
+      .Add(bands)
+      .AddGroup(B_HORIZONTAL, 10)
+      .Add(fLimiter)
+      .AddGlue()
+      .Add(flat)
+      .End();
+
+  _UpdateControls();
+  CenterOnScreen();
+}
+
+void EqualizerWindow::MessageReceived(BMessage *msg) {
+  switch (msg->what) {
+  case MSG_EQUALIZER:
+    Activate();
+    break;
+  case MSG_EQUALIZER_CHANGED:
+    _Send();
+    break;
+  case MSG_EQUALIZER_FLAT:
+    fSettings.preamp = 0.0f;
+    fSettings.ResetBands();
+    _UpdateControls();
+    _Send();
+    break;
+  default:
+    BWindow::MessageReceived(msg);
+  }
+}
+
+void EqualizerWindow::_UpdateControls() {
+  fEnabled->SetValue(fSettings.enabled ? B_CONTROL_ON : B_CONTROL_OFF);
+  fLimiter->SetValue(fSettings.limiter ? B_CONTROL_ON : B_CONTROL_OFF);
+  fPreamp->SetValue((int32)std::lround(fSettings.preamp));
+  for (int32 i = 0; i < DspSettings::kBands; i++)
+    fBands[i]->SetValue((int32)std::lround(fSettings.bands[i].gain));
+}
+
+/** @brief Reads the controls into fSettings and sends them to the target. */
+void EqualizerWindow::_Send() {
+  fSettings.enabled = fEnabled->Value() == B_CONTROL_ON;
+  fSettings.limiter = fLimiter->Value() == B_CONTROL_ON;
+  fSettings.preamp = (float)fPreamp->Value();
+  for (int32 i = 0; i < DspSettings::kBands; i++)
+    fSettings.bands[i].gain = (float)fBands[i]->Value();
+
+  BMessage msg(MSG_SET_DSP);
+  fSettings.Archive(&msg);
+  fTarget.SendMessage(&msg);
+}
@@ -0,0 +1,39 @@
+#ifndef BETON_EQUALIZER_WINDOW_H
+#define BETON_EQUALIZER_WINDOW_H
+
+#include "DspChain.h"
+
+#include <Messenger.h>
+#include <Window.h>
+
+class BCheckBox;
+class BSlider;
+
+/**
+ * @class EqualizerWindow
+ * @brief Controls of the playback DSP chain: preamp, the gains of the
+ * equalizer bands and the limiter.
+ *
+ * Every change is sent to `target` (the main window) as `MSG_SET_DSP`;
+ * the window never touches the engine itself. Band frequencies, types and
+ * Q come from the settings and are kept as they are.
+ */
+class EqualizerWindow : public BWindow {
+public:
+  EqualizerWindow(const BMessenger &target, const DspSettings &settings);
+
+  void MessageReceived(BMessage *msg) override;
+
+private:
+  void _UpdateControls();
+  void _Send();
+
+  BMessenger fTarget;
+  DspSettings fSettings;
+  BCheckBox *fEnabled;
+  BCheckBox *fLimiter;
+  BSlider *fPreamp;
+  BSlider *fBands[DspSettings::kBands];
+};
+
+#endif // BETON_EQUALIZER_WINDOW_H
@@ -3,7 +3,8 @@
 #include <Application.h>
 #include <Window.h>
 
-IconButtonView::IconButtonView(const char* name, BBitmap* icon, BMessage* message)
+IconButtonView::IconButtonView(const char* name, const BBitmap* icon,
+                               BMessage* message)
     : BView(name, B_WILL_DRAW), fIcon(icon), fMessage(message), fIsHovered(false) {
   SetViewColor(B_TRANSPARENT_COLOR);
 }
@@ -24,7 +25,7 @@ void IconButtonView::SetTarget(BMessenger target) {
   fTarget = target;
 }
 
-void IconButtonView::SetIcon(BBitmap* icon) {
+void IconButtonView::SetIcon(const BBitmap* icon) {
   fIcon = icon;
   Invalidate();
 }
@@ -12,7 +12,7 @@
  */
 class IconButtonView : public BView {
 public:
-  IconButtonView(const char *name, BBitmap *icon, BMessage *message);
+  IconButtonView(const char *name, const BBitmap *icon, BMessage *message);
   virtual ~IconButtonView();
 
   virtual void AttachedToWindow() override;
@@ -22,11 +22,11 @@ public:
                           const BMessage *message) override;
 
   void SetTarget(BMessenger target);
-  void SetIcon(BBitmap *icon);
+  void SetIcon(const BBitmap *icon);
   void UpdateSystemColors();
 
 private:
-  BBitmap *fIcon;
+  const BBitmap *fIcon; ///< Not owned
   BMessage *fMessage;
   BMessenger fTarget;
   bool fIsHovered;
@@ -0,0 +1,87 @@
+#include "IconCache.h"
+#include "Debug.h"
+
+#include <Application.h>
+#include <Autolock.h>
+#include <Bitmap.h>
+#include <IconUtils.h>
+#include <Resources.h>
+
+#include <math.h>
+
+IconCache &IconCache::Default() {
+  static IconCache sCache;
+  return sCache;
+}
+
+IconCache::IconCache()
+    : fLock("IconCache"), fBytes(0), fMemory(kMemoryIcons) {}
+
+const BBitmap *IconCache::Get(int32 id, float size) {
+  const Key key(id, (int32)ceilf(size));
+  if (key.second <= 0)
+    return nullptr;
+
+  const void *data;
+  size_t length;
+  {
+    BAutolock lock(&fLock);
+    auto it = fIcons.find(key);
+    if (it != fIcons.end())
+      return it->second;
+    data = _LoadData(id, &length);
+  }
+
+  BBitmap *bitmap = _Render(data, length, id, key.second);
+
+  BAutolock lock(&fLock);
+  // Another thread may have rendered it meanwhile; the first one wins.
+  auto inserted = fIcons.emplace(key, bitmap);
+  if (!inserted.second) {
+    delete bitmap;
+    return inserted.first->second;
+  }
+  if (bitmap != nullptr) {
+    fBytes += bitmap->BitsLength();
+    fMemory.Set(fBytes);
+  }
+  return bitmap;
+}
+
+/**
+ * @brief Looks up a vector icon in the application resources.
+ * @return The icon data, owned by the resources, or nullptr.
+ */
+const void *IconCache::_LoadData(int32 id, size_t *length) {
+  *length = 0;
+  if (!be_app || !be_app->AppResources())
+    return nullptr;
+
+  const void *data =
+      be_app->AppResources()->LoadResource(B_VECTOR_ICON_TYPE, id, length);
+  if (!data || *length == 0) {
+    DEBUG_PRINT("Icon-ID %ld not found\n", (long)id);
+    return nullptr;
+  }
+  return data;
+}
+
+/**
+ * @brief Renders vector icon data to a `size` x `size` bitmap.
+ * @return A new bitmap, or nullptr on failure.
+ */
+BBitmap *IconCache::_Render(const void *data, size_t length, int32 id,
+                            int32 size) {
+  if (!data)
+    return nullptr;
+
+  BRect r(0, 0, size - 1, size - 1);
+  auto *bmp = new BBitmap(r, 0, B_RGBA32);
+  if (BIconUtils::GetVectorIcon(static_cast<const uint8 *>(data), length,
+                                bmp) != B_OK) {
+    delete bmp;
+    DEBUG_PRINT("Icon-ID %ld: Decoding failed\n", (long)id);
+    return nullptr;
+  }
+  return bmp;
+}
@@ -0,0 +1,53 @@
+#ifndef BETON_ICON_CACHE_H
+#define BETON_ICON_CACHE_H
+
+#include "MemoryStats.h"
+
+#include <Locker.h>
+#include <SupportDefs.h>
+#include <map>
+#include <utility>
+
+class BBitmap;
+
+/**
+ * @class IconCache
+ * @brief Process-wide cache of the vector icons in the application
+ * resources, rasterized on first use.
+ *
+ * Icons are keyed by resource ID and edge length; an icon with several
+ * states (shuffle off/on, repeat off/all/one, play/pause) has one resource
+ * per state. Each bitmap is rendered once and shared by every view that
+ * shows it, so swapping state icons never rasterizes again.
+ *
+ * Bitmaps live as long as the process and must not be deleted. Get() is
+ * thread-safe; resources are read under the lock, as BResources is not,
+ * and icons are rendered outside of it.
+ */
+class IconCache {
+public:
+  static IconCache &Default();
+
+  /**
+   * @brief The icon `id` at `size` x `size` pixels.
+   * @return The shared bitmap, or nullptr if the resource is missing or
+   * cannot be decoded (not retried).
+   */
+  const BBitmap *Get(int32 id, float size);
+
+private:
+  typedef std::pair<int32, int32> Key; ///< Resource ID, edge length
+
+  IconCache();
+
+  static const void *_LoadData(int32 id, size_t *length);
+  static BBitmap *_Render(const void *data, size_t length, int32 id,
+                          int32 size);
+
+  BLocker fLock;
+  std::map<Key, BBitmap *> fIcons; ///< nullptr: missing or undecodable
+  size_t fBytes;
+  MemoryAccount fMemory;
+};
+
+#endif // BETON_ICON_CACHE_H
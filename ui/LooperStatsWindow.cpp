@@ -0,0 +1,96 @@
+#include "LooperStatsWindow.h"
+#include "LooperStats.h"
+#include "Messages.h"
+
+#include <Button.h>
+#include <Catalog.h>
+#include <FindDirectory.h>
+#include <LayoutBuilder.h>
+#include <MessageRunner.h>
+#include <Path.h>
+#include <ScrollView.h>
+#include <StringView.h>
+#include <TextView.h>
+
+#undef B_TRANSLATION_CONTEXT
+#define B_TRANSLATION_CONTEXT "LooperStatsWindow"
+
+LooperStatsWindow::LooperStatsWindow()
+    : BWindow(BRect(100, 100, 800, 500), B_TRANSLATE("Looper Statistics"),
+              B_TITLED_WINDOW, B_ASYNCHRONOUS_CONTROLS),
+      fRunner(nullptr) {
+  fText = new BTextView("stats");
+  fText->MakeEditable(false);
+  fText->SetFontAndColor(be_fixed_font);
+  fText->SetWordWrap(false);
+  BScrollView *scroll = new BScrollView("scroll", fText, 0, true, true);
+
+  fStatus = new BStringView("status", "");
+  fBtnReset = new BButton("Reset", B_TRANSLATE("Reset"),
+                          new BMessage(MSG_LOOPER_STATS_RESET));
+  fBtnSave = new BButton("Save", B_TRANSLATE("Save to Desktop"),
+                         new BMessage(MSG_LOOPER_STATS_SAVE));
+
+  BLayoutBuilder::Group<>(this, B_VERTICAL, 10)
+      .SetInsets(10, 10, 10, 10)
+      .Add(scroll)
+      .AddGroup(B_HORIZONTAL, 10)
+      .Add(fStatus)
+      .AddGlue()
+      .Add(fBtnReset)
+      .Add(fBtnSave)
+      .End();
+
+  font_height fh;
+  be_fixed_font->GetHeight(&fh);
+  float fontHeight = fh.ascent + fh.descent + fh.leading;
+  ResizeTo(be_fixed_font->StringWidth("x") * 110, fontHeight * 30);
+  CenterOnScreen();
+
+  _Refresh();
+  BMessage tick(MSG_LOOPER_STATS_REFRESH);
+  fRunner = new BMessageRunner(BMessenger(this), &tick, 1000000);
+}
+
+LooperStatsWindow::~LooperStatsWindow() { delete fRunner; }
+
+void LooperStatsWindow::MessageReceived(BMessage *msg) {
+  switch (msg->what) {
+  case MSG_LOOPER_STATS_REFRESH:
+    _Refresh();
+    break;
+  case MSG_LOOPER_STATS_RESET:
+    LooperStats::Reset();
+    _Refresh();
+    break;
+  case MSG_LOOPER_STATS_SAVE:
+    _Save();
+    break;
+  default:
+    BWindow::MessageReceived(msg);
+  }
+}
+
+void LooperStatsWindow::_Refresh() {
+  if (!LooperStats::IsEnabled()) {
+    fText->SetText(B_TRANSLATE("Start BeTon with --looper-stats to record "
+                               "message timings."));
+    return;
+  }
+  fText->SetText(LooperStats::Report().String());
+}
+
+void LooperStatsWindow::_Save() {
+  BPath path;
+  if (find_directory(B_DESKTOP_DIRECTORY, &path) != B_OK)
+    return;
+  path.Append("BeTon looper stats.txt");
+
+  if (LooperStats::DumpToFile(path.Path()) == B_OK) {
+    BString text(B_TRANSLATE("Saved to %path%"));
+    text.ReplaceFirst("%path%", path.Path());
+    fStatus->SetText(text.String());
+  } else {
+    fStatus->SetText(B_TRANSLATE("Could not save the statistics"));
+  }
+}
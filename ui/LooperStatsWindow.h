@@ -0,0 +1,36 @@
+#ifndef BETON_LOOPER_STATS_WINDOW_H
+#define BETON_LOOPER_STATS_WINDOW_H
+
+#include <Window.h>
+
+class BButton;
+class BMessageRunner;
+class BStringView;
+class BTextView;
+
+/**
+ * @class LooperStatsWindow
+ * @brief Debug window showing the `LooperStats` table, refreshed every
+ * second.
+ *
+ * Only reachable (Help menu) when BeTon runs with `--looper-stats`.
+ */
+class LooperStatsWindow : public BWindow {
+public:
+  LooperStatsWindow();
+  ~LooperStatsWindow() override;
+
+  void MessageReceived(BMessage *msg) override;
+
+private:
+  void _Refresh();
+  void _Save();
+
+  BTextView *fText;
+  BStringView *fStatus;
+  BButton *fBtnReset;
+  BButton *fBtnSave;
+  BMessageRunner *fRunner;
+};
+
+#endif // BETON_LOOPER_STATS_WINDOW_H
@@ -1,8 +1,12 @@
 #include "MarqueeTextView.h"
+#include "Debug.h"
+
+#include <Bitmap.h>
 #include <MessageRunner.h>
 #include <OS.h>
 #include <Window.h>
 #include <algorithm>
+#include <cmath>
 #include <map>
 #include <string>
 #include <vector>
@@ -19,7 +23,9 @@ static std::map<std::string, bigtime_t> sGroupCycleStart;
 
 MarqueeTextView::MarqueeTextView(const char *name)
     : BView(name, B_WILL_DRAW | B_FRAME_EVENTS | B_FULL_UPDATE_ON_RESIZE),
-      fTextWidth(0), fRunner(nullptr) {
+      fTextWidth(0), fRunner(nullptr), fTextBitmap(nullptr),
+      fDrawnOffset(-1.0f), fWakeups(0), fWakeupWindowStart(0),
+      fWakeupRate(0.0f) {
   sMarqueeViews.push_back(this);
   fSyncGroup = name ? name : "";
   _ResetCycle();
@@ -28,6 +34,7 @@ MarqueeTextView::MarqueeTextView(const char *name)
 
 MarqueeTextView::~MarqueeTextView() {
   delete fRunner;
+  delete fTextBitmap;
   sMarqueeViews.erase(
       std::remove(sMarqueeViews.begin(), sMarqueeViews.end(), this),
       sMarqueeViews.end());
@@ -43,6 +50,7 @@ void MarqueeTextView::SetText(const BString &text) {
 
   fText = text;
   fTextWidth = StringWidth(fText.String());
+  _InvalidateTextBitmap();
   _ResetCycle();
 
   _UpdateScrolling();
@@ -66,6 +74,7 @@ void MarqueeTextView::UpdateSystemColors() {
   SetViewColor(bg);
   SetLowColor(bg);
   SetHighColor(ui_color(B_PANEL_TEXT_COLOR));
+  _InvalidateTextBitmap();
   Invalidate();
 }
 
@@ -78,32 +87,93 @@ void MarqueeTextView::AttachedToWindow() {
 void MarqueeTextView::DetachedFromWindow() {
   delete fRunner;
   fRunner = nullptr;
+  fWakeupRate = 0.0f;
   BView::DetachedFromWindow();
 }
 
 void MarqueeTextView::FrameResized(float width, float height) {
   BView::FrameResized(width, height);
+  if (fTextBitmap &&
+      fTextBitmap->Bounds().IntegerHeight() != Bounds().IntegerHeight())
+    _InvalidateTextBitmap();
   _ResetCycle();
   _UpdateScrolling();
 }
 
+void MarqueeTextView::WindowActivated(bool active) {
+  BView::WindowActivated(active);
+  // Rest at the start while paused and resume from there.
+  if (_NeedsScroll()) {
+    _ResetCycle();
+    Invalidate();
+  }
+  _UpdateScrolling();
+}
+
+void MarqueeTextView::Show() {
+  BView::Show();
+  _UpdateScrolling();
+}
+
+void MarqueeTextView::Hide() {
+  BView::Hide();
+  _UpdateScrolling();
+}
+
+/**
+ * @brief Whether animation frames would be seen at all.
+ *
+ * A window on another workspace or minimized is never the active one, so
+ * checking activation covers those too.
+ */
+bool MarqueeTextView::_ShouldAnimate() const {
+  BWindow *window = Window();
+  if (window == nullptr || window->IsHidden() || window->IsMinimized() ||
+      !window->IsActive())
+    return false;
+  return !IsHidden() && _NeedsScroll();
+}
+
 void MarqueeTextView::_UpdateScrolling() {
   if (!Window()) return;
 
-  bool needsScroll = _NeedsScroll();
+  bool animate = _ShouldAnimate();
 
-  if (needsScroll && !fRunner) {
+  if (animate && !fRunner) {
     BMessage msg(MSG_MARQUEE_TICK);
     fRunner = new BMessageRunner(BMessenger(this), &msg, kFrameInterval);
-  } else if (!needsScroll && fRunner) {
+    fWakeups = 0;
+    fWakeupWindowStart = system_time();
+  } else if (!animate && fRunner) {
     delete fRunner;
     fRunner = nullptr;
+    fWakeupRate = 0.0f;
   }
 }
 
+void MarqueeTextView::_CountWakeup() {
+  fWakeups++;
+  bigtime_t now = system_time();
+  bigtime_t elapsed = now - fWakeupWindowStart;
+  if (elapsed < 1000000)
+    return;
+
+  fWakeupRate = fWakeups * 1000000.0f / elapsed;
+  DEBUG_PRINT("MarqueeTextView '%s': %.1f wakeups/s\n", Name(), fWakeupRate);
+  fWakeups = 0;
+  fWakeupWindowStart = now;
+}
+
 void MarqueeTextView::MessageReceived(BMessage *msg) {
   if (msg->what == MSG_MARQUEE_TICK) {
-    if (_NeedsScroll())
+    _CountWakeup();
+    // Hiding an ancestor does not reach Hide() here, so recheck each tick.
+    if (!_ShouldAnimate()) {
+      _UpdateScrolling();
+      return;
+    }
+    // Skip frames that would land on the same pixel, e.g. in end pauses.
+    if (std::floor(_ScrollOffset() + 0.5f) != fDrawnOffset)
       Invalidate();
   } else if (msg->what == B_COLORS_UPDATED) {
     UpdateSystemColors();
@@ -115,6 +185,20 @@ void MarqueeTextView::MessageReceived(BMessage *msg) {
 void MarqueeTextView::Draw(BRect updateRect) {
   if (fText.IsEmpty()) return;
 
+  if (_NeedsScroll()) {
+    // Restart the timer when an ancestor was shown again.
+    if (!fRunner)
+      _UpdateScrolling();
+
+    _RenderText();
+    if (fTextBitmap) {
+      fDrawnOffset = fRunner ? std::floor(_ScrollOffset() + 0.5f) : 0.0f;
+      SetDrawingMode(B_OP_COPY);
+      DrawBitmap(fTextBitmap, BPoint(-fDrawnOffset, 0));
+      return;
+    }
+  }
+
   SetDrawingMode(B_OP_OVER);
 
   font_height fh;
@@ -192,6 +276,52 @@ float MarqueeTextView::_ScrollOffset() const {
   return overflow * (1.0f - t);
 }
 
+void MarqueeTextView::_RenderText() {
+  if (fTextBitmap)
+    return;
+
+  BRect bounds(0, 0, std::ceil(fTextWidth) + 1, Bounds().IntegerHeight());
+  BBitmap *bitmap = new BBitmap(bounds, B_RGB32, true);
+  if (!bitmap->IsValid()) {
+    delete bitmap;
+    return;
+  }
+
+  BView *view = new BView(bounds, "marquee text", B_FOLLOW_NONE, 0);
+  bitmap->AddChild(view);
+  if (!bitmap->Lock()) {
+    delete bitmap;
+    return;
+  }
+
+  BFont font;
+  GetFont(&font);
+  view->SetFont(&font);
+  view->SetLowColor(LowColor());
+  view->SetHighColor(HighColor());
+  view->FillRect(bounds, B_SOLID_LOW);
+
+  font_height fh;
+  font.GetHeight(&fh);
+  float textHeight = fh.ascent + fh.descent;
+  float baseline = (Bounds().Height() - textHeight) / 2.0f + fh.ascent;
+  view->SetDrawingMode(B_OP_OVER);
+  view->DrawString(fText.String(), BPoint(0, baseline));
+  view->Sync();
+
+  bitmap->RemoveChild(view);
+  bitmap->Unlock();
+  delete view;
+
+  fTextBitmap = bitmap;
+}
+
+void MarqueeTextView::_InvalidateTextBitmap() {
+  delete fTextBitmap;
+  fTextBitmap = nullptr;
+  fDrawnOffset = -1.0f;
+}
+
 void MarqueeTextView::_ResetCycle() {
   sGroupCycleStart[std::string(fSyncGroup.String())] = system_time();
 }
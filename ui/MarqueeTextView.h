@@ -4,8 +4,18 @@
 #include <View.h>
 #include <String.h>
 
+class BBitmap;
 class BMessageRunner;
 
+/**
+ * @class MarqueeTextView
+ * @brief Single-line label that scrolls back and forth when its text does
+ * not fit.
+ *
+ * Overflowing text is rendered once into an offscreen bitmap; animation
+ * frames only blit it at a new offset. The frame timer runs only while the
+ * text overflows, the view is visible and its window is active.
+ */
 class MarqueeTextView : public BView {
 public:
   MarqueeTextView(const char *name);
@@ -22,24 +32,45 @@ public:
   virtual void MessageReceived(BMessage *msg) override;
   virtual void Draw(BRect updateRect) override;
   virtual void FrameResized(float width, float height) override;
+  virtual void WindowActivated(bool active) override;
+  virtual void Show() override;
+  virtual void Hide() override;
 
   virtual BSize MinSize() override;
   virtual BSize PreferredSize() override;
   virtual BSize MaxSize() override;
 
+  /** @brief Timer wakeups per second over the last measured second. */
+  float WakeupRate() const { return fWakeupRate; }
+
 private:
   void _UpdateScrolling();
+  bool _ShouldAnimate() const;
   bool _NeedsScroll() const;
   float _Overflow() const;
   float _GroupMaxOverflow() const;
   float _ScrollOffset() const;
   void _ResetCycle();
+  void _CountWakeup();
+
+  /** @brief Renders the text into fTextBitmap if it is missing. */
+  void _RenderText();
+  void _InvalidateTextBitmap();
 
   BString fText;
   BString fSyncGroup;
   float fTextWidth;
 
   BMessageRunner *fRunner;
+  BBitmap *fTextBitmap; ///< Pre-rendered text, only while overflowing
+  float fDrawnOffset;   ///< Offset of the last frame, in whole pixels
+
+  /** @name Wakeup accounting */
+  ///@{
+  int32 fWakeups;
+  bigtime_t fWakeupWindowStart;
+  float fWakeupRate;
+  ///@}
 };
 
 #endif // BETON_MARQUEE_TEXT_VIEW_H
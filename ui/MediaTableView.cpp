@@ -3,8 +3,12 @@
 #include "MainWindow.h"
 #include "Messages.h"
 #include <ScrollBar.h>
-#include "MusicSourceSettings.h"
+#include "MediaEntryStore.h"
+#include "MediaSortKey.h"
+#include "MemoryStats.h"
 #include "MetadataTagIO.h"
+#include "PlaybackQueue.h"
+#include "StringPool.h"
 #include <Catalog.h>
 #include <Directory.h>
 #include <Entry.h>
@@ -48,22 +52,183 @@ static float CalculateRowHeight() {
   return ceilf(fontHeight * 1.4f);
 }
 
+class MediaRow;
+
+/**
+ * @class MediaCellField
+ * @brief Placeholder field that points back to its row.
+ *
+ * Cells keep no text of their own: the columns format it from the row's
+ * item when a visible row is drawn, and sort by the item's values.
+ */
+class MediaCellField : public BField {
+public:
+  explicit MediaCellField(const MediaRow *row) : fRow(row) {}
+  const MediaRow *Row() const { return fRow; }
+
+private:
+  const MediaRow *fRow;
+};
+
+/** @brief Number of logical fields (columns) of a MediaRow. */
+static const int32 kMediaFieldCount = 13;
+
+/** @brief Heap bytes of a row's fields, accounted along with the row. */
+static const int64 kFieldBytes =
+    kMediaFieldCount * (int64)sizeof(MediaCellField);
+
+/** @brief Sort keys a row keeps at once (sort columns plus the path). */
+static const int32 kRowSortKeySlots = 4;
+
 /**
  * @class MediaRow
  * @brief Custom BRow subclass to store the associated MediaItem.
+ *
+ * The item is the only copy of the row's data. Its strings are shared with
+ * the library through the string pool, so a row costs the item's handles
+ * plus one pointer-sized `MediaCellField` per column.
+ *
+ * Rows register with their view while they exist, which keeps the view's
+ * path lookup current however a row is removed or deleted.
+ *
+ * Rows and their fields are accounted as kMemoryTableRows.
+ *
+ * Sort keys are built the first time a column compares the row and kept
+ * until the item changes, so re-sorting does not fold strings again. Only a
+ * few are kept, since a view is sorted by one or two columns at a time.
  */
-class MediaRow : public BRow {
+class MediaRow : public BRow, public MemoryCounted<kMemoryTableRows> {
 public:
-  explicit MediaRow(const MediaItem &mi)
-      : BRow(CalculateRowHeight()), fItem(mi) {}
+  explicit MediaRow(const MediaItem &mi, int32 playlistIndex = 0)
+      : BRow(CalculateRowHeight()), fItem(mi), fPlaylistIndex(playlistIndex) {
+    for (int32 i = 0; i < kMediaFieldCount; i++)
+      SetField(new MediaCellField(this), i);
+    MemoryStats::Add(kMemoryTableRows, kFieldBytes, 0);
+  }
+
+  ~MediaRow() override {
+    MemoryStats::Add(kMemoryTableRows, -kFieldBytes, 0);
+    if (fOwner != nullptr)
+      fOwner->_UnregisterRow(this);
+  }
+
+  /** @brief View whose path lookup lists this row, or nullptr. */
+  void SetOwner(MediaTableView *owner) { fOwner = owner; }
 
   const MediaItem &Item() const { return fItem; }
-  void SetItem(const MediaItem &mi) { fItem = mi; }
+  void SetItem(const MediaItem &mi) {
+    fItem = mi;
+    _InvalidateSortKeys();
+  }
+
+  /** @brief 1-based position shown in the Sort column (0 = none). */
+  int32 PlaylistIndex() const { return fPlaylistIndex; }
+  void SetPlaylistIndex(int32 index) {
+    fPlaylistIndex = index;
+    _InvalidateSortKeys();
+  }
+
+  /** @brief Sort key of a logical field, cached until the item changes. */
+  const MediaSortKey &SortKey(int32 field) const {
+    for (int32 i = 0; i < kRowSortKeySlots; i++) {
+      if (fSortKeyField[i] == field)
+        return fSortKeys[i];
+    }
+
+    int32 slot = fNextSortKeySlot;
+    fNextSortKeySlot = (slot + 1) % kRowSortKeySlots;
+    fSortKeyField[slot] = (int8)field;
+    fSortKeys[slot] = field == 12 ? MediaSortKey::ForInt(fPlaylistIndex)
+                                  : MediaSortKey::ForField(fItem, field);
+    return fSortKeys[slot];
+  }
 
 private:
+  void _InvalidateSortKeys() {
+    for (int32 i = 0; i < kRowSortKeySlots; i++)
+      fSortKeyField[i] = -1;
+  }
+
   MediaItem fItem;
+  int32 fPlaylistIndex;
+  MediaTableView *fOwner = nullptr;
+  mutable MediaSortKey fSortKeys[kRowSortKeySlots];
+  mutable int8 fSortKeyField[kRowSortKeySlots] = {-1, -1, -1, -1};
+  mutable int8 fNextSortKeySlot = 0;
 };
 
+/** @brief Compares two rows by their cached sort keys of `field`. */
+static int CompareRowKeys(const MediaRow &a, const MediaRow &b, int32 field) {
+  return MediaSortKey::Compare(a.SortKey(field), b.SortKey(field));
+}
+
+/** @brief Returns the row behind a cell, or nullptr for foreign fields. */
+static const MediaRow *RowOfField(const BField *field) {
+  auto *cell = dynamic_cast<const MediaCellField *>(field);
+  return cell != nullptr ? cell->Row() : nullptr;
+}
+
+/** @brief Numeric value of a cell (year, duration and the integer columns). */
+static int32 CellValue(const MediaRow &row, int32 field) {
+  const MediaItem &mi = row.Item();
+  switch (field) {
+  case 5:
+    return mi.year;
+  case 6:
+    return mi.duration;
+  case 7:
+    return mi.track;
+  case 8:
+    return mi.disc;
+  case 9:
+    return mi.bitrate;
+  case 11:
+    return mi.rating;
+  case 12:
+    return row.PlaylistIndex();
+  default:
+    return 0;
+  }
+}
+
+/** @brief Text of a cell as shown (and edited) in the view. */
+static BString CellText(const MediaRow &row, int32 field) {
+  const MediaItem &mi = row.Item();
+  BString text;
+  switch (field) {
+  case 0:
+    return mi.title;
+  case 1:
+    return mi.artist;
+  case 2:
+    return mi.album;
+  case 3:
+    return mi.albumArtist;
+  case 4:
+    return mi.genre;
+  case 6:
+    text.SetToFormat("%ld:%02ld", (long)(mi.duration / 60),
+                     (long)(mi.duration % 60));
+    return text;
+  case 10:
+    return mi.path;
+  default:
+    text << CellValue(row, field);
+    return text;
+  }
+}
+
+/** @brief Horizontal text inset used by the stock column types. */
+static const float kCellTextMargin = 8.0f;
+
+/** @brief Truncates `text` to the cell and draws it. */
+static void DrawCellText(BTitledColumn *column, BString text, uint32 truncate,
+                         BRect rect, BView *parent) {
+  parent->TruncateString(&text, truncate,
+                         rect.Width() - 2 * kCellTextMargin + 2);
+  column->DrawString(text.String(), parent, rect);
+}
+
 /**
  * @class RightClickFilter
  * @brief Message filter for handling mouse events on the content list view.
@@ -520,60 +685,6 @@ static void BuildFilesMessage(MediaTableView *view, BMessage &filesMsg) {
   }
 }
 
-/**
- * @class StatusStringField
- * @brief BStringField subclass that tracks whether the file is missing.
- *
- * Used to gray out text for missing files in the list view.
- * Also stores the item path for now-playing comparison.
- */
-class StatusStringField : public BStringField {
-public:
-  StatusStringField(const char *string, bool missing,
-                    std::shared_ptr<BString> path = nullptr,
-                    SourceType source = SOURCE_TAGS)
-      : BStringField(string), fMissing(missing), fPath(path), fSource(source) {}
-  bool IsMissing() const { return fMissing; }
-  const BString &Path() const {
-    static BString empty("");
-    return fPath ? *fPath : empty;
-  }
-  SourceType Source() const { return fSource; }
-
-private:
-  bool fMissing;
-  std::shared_ptr<BString> fPath;
-  SourceType fSource;
-};
-
-/**
- * @class StatusIntegerField
- * @brief BIntegerField subclass that tracks whether the file is missing.
- */
-class StatusIntegerField : public BIntegerField {
-public:
-  StatusIntegerField(int32 number, bool missing, SourceType source = SOURCE_TAGS,
-                     std::shared_ptr<BString> path = nullptr,
-                     int32 sortDisc = 0, int32 sortTrack = 0)
-      : BIntegerField(number), fMissing(missing), fSource(source), fPath(path),
-        fSortDisc(sortDisc), fSortTrack(sortTrack) {}
-  bool IsMissing() const { return fMissing; }
-  SourceType Source() const { return fSource; }
-  const BString &Path() const {
-    static BString empty("");
-    return fPath ? *fPath : empty;
-  }
-  int32 SortDisc() const { return fSortDisc; }
-  int32 SortTrack() const { return fSortTrack; }
-
-private:
-  bool fMissing;
-  SourceType fSource;
-  std::shared_ptr<BString> fPath;
-  int32 fSortDisc;
-  int32 fSortTrack;
-};
-
 /**
  * @class StatusStringColumn
  * @brief Column that renders text in gray if the file is missing,
@@ -587,15 +698,36 @@ public:
                      alignment align = B_ALIGN_LEFT,
                      MediaTableView *owner = nullptr)
       : BStringColumn(title, width, minWidth, maxWidth, truncate, align),
-        fAttrName(attrName), fOwner(owner), fTitle(title) {}
+        fAttrName(attrName), fOwner(owner), fTitle(title),
+        fTruncate(truncate) {}
 
   void SetOwner(MediaTableView *owner) { fOwner = owner; }
   const char *Title() const { return fTitle.String(); }
 
+  bool AcceptsField(const BField *field) const override {
+    return RowOfField(field) != nullptr;
+  }
+
+  int CompareFields(BField *field1, BField *field2) override {
+    const MediaRow *a = RowOfField(field1);
+    const MediaRow *b = RowOfField(field2);
+    if (a == nullptr || b == nullptr)
+      return 0;
+    return CompareRowKeys(*a, *b, LogicalFieldNum());
+  }
+
+  float GetPreferredWidth(BField *field, BView *parent) const override {
+    const MediaRow *row = RowOfField(field);
+    if (row == nullptr)
+      return Width();
+    BString text = CellText(*row, LogicalFieldNum());
+    return parent->StringWidth(text.String()) + 2 * kCellTextMargin;
+  }
+
   void DrawField(BField *field, BRect rect, BView *parent) override {
-    StatusStringField *f = dynamic_cast<StatusStringField *>(field);
+    const MediaRow *row = RowOfField(field);
     rgb_color oldColor = parent->HighColor();
-    bool isGray = (f && f->IsMissing());
+    bool isGray = (row && row->Item().missing);
     bool isBold = false;
 
     /**
@@ -605,8 +737,9 @@ public:
      * External changes will be detected via Node Monitoring (TODO).
      */
 
-    if (f && fOwner && !fOwner->NowPlayingPath().IsEmpty() &&
-        !f->Path().IsEmpty() && f->Path() == fOwner->NowPlayingPath()) {
+    if (row && fOwner && !fOwner->NowPlayingPath().IsEmpty() &&
+        !row->Item().path.IsEmpty() &&
+        row->Item().path == fOwner->NowPlayingPath()) {
       isBold = true;
     }
 
@@ -636,8 +769,10 @@ public:
                                       B_DISABLED_LABEL_TINT));
     }
 
-    if (field)
-      BStringColumn::DrawField(field, rect, parent);
+    if (row) {
+      DrawCellText(this, CellText(*row, LogicalFieldNum()), fTruncate, rect,
+                   parent);
+    }
 
     parent->SetHighColor(oldColor);
 
@@ -650,6 +785,7 @@ private:
   BString fAttrName;
   MediaTableView *fOwner = nullptr;
   BString fTitle;
+  uint32 fTruncate;
 };
 
 /**
@@ -668,25 +804,27 @@ public:
   void SetOwner(MediaTableView *owner) { fOwner = owner; }
   const char *Title() const { return fTitle.String(); }
 
+  bool AcceptsField(const BField *field) const override {
+    return RowOfField(field) != nullptr;
+  }
+
   int CompareFields(BField *field1, BField *field2) override {
-    StatusIntegerField *a = dynamic_cast<StatusIntegerField *>(field1);
-    StatusIntegerField *b = dynamic_cast<StatusIntegerField *>(field2);
-    if (a && b &&
-        (fAttrName == "Audio:Track" || fAttrName == "Media:Disc")) {
-      int result = _CompareInt(a->SortDisc(), b->SortDisc());
-      if (result == 0)
-        result = _CompareInt(a->SortTrack(), b->SortTrack());
-      if (result == 0)
-        result = a->Path().ICompare(b->Path());
-      return result;
-    }
-    return BIntegerColumn::CompareFields(field1, field2);
+    const MediaRow *a = RowOfField(field1);
+    const MediaRow *b = RowOfField(field2);
+    if (a == nullptr || b == nullptr)
+      return 0;
+    int32 field = LogicalFieldNum();
+    int result = CompareRowKeys(*a, *b, field);
+    // Track and Disc keys order by disc, then track; keep albums apart.
+    if (result == 0 && (field == 7 || field == 8))
+      result = CompareRowKeys(*a, *b, 10);
+    return result;
   }
 
   void DrawField(BField *field, BRect rect, BView *parent) override {
-    StatusIntegerField *f = dynamic_cast<StatusIntegerField *>(field);
+    const MediaRow *row = RowOfField(field);
     rgb_color oldColor = parent->HighColor();
-    bool isGray = (f && f->IsMissing());
+    bool isGray = (row && row->Item().missing);
 
     /**
      * @note BFS attributes are no longer read during draw.
@@ -712,17 +850,15 @@ public:
                                       B_DISABLED_LABEL_TINT));
     }
 
-    if (field)
-      BIntegerColumn::DrawField(field, rect, parent);
+    if (row) {
+      DrawCellText(this, CellText(*row, LogicalFieldNum()), B_TRUNCATE_MIDDLE,
+                   rect, parent);
+    }
 
     parent->SetHighColor(oldColor);
   }
 
 private:
-  static int _CompareInt(int32 a, int32 b) {
-    return (a < b) ? -1 : (a > b ? 1 : 0);
-  }
-
   BString fAttrName;
   MediaTableView *fOwner = nullptr;
   BString fTitle;
@@ -771,9 +907,21 @@ public:
     return result;
   }
 
+  bool AcceptsField(const BField *field) const override {
+    return RowOfField(field) != nullptr;
+  }
+
+  int CompareFields(BField *field1, BField *field2) override {
+    const MediaRow *a = RowOfField(field1);
+    const MediaRow *b = RowOfField(field2);
+    if (a == nullptr || b == nullptr)
+      return 0;
+    return CompareRowKeys(*a, *b, LogicalFieldNum());
+  }
+
   void DrawField(BField *field, BRect rect, BView *parent) override {
-    StatusStringField *sf = dynamic_cast<StatusStringField *>(field);
-    if (!sf)
+    const MediaRow *row = RowOfField(field);
+    if (!row)
       return;
 
     /**
@@ -803,7 +951,8 @@ public:
       }
     }
 
-    BStringColumn::DrawField(field, rect, parent);
+    DrawCellText(this, RatingToStars(row->Item().rating), B_TRUNCATE_END, rect,
+                 parent);
 
     parent->SetHighColor(oldColor);
     parent->SetFont(&oldFont);
@@ -1010,13 +1159,10 @@ void MediaTableView::SetNowPlayingPath(const BString &path) {
     BString oldPath = fNowPlayingPath;
     fNowPlayingPath = path;
 
-    for (int32 i = 0; i < CountRows(); ++i) {
-      MediaRow *mr = dynamic_cast<MediaRow *>(RowAt(i));
-      if (mr) {
-        if (mr->Item().path == oldPath || mr->Item().path == path) {
-          InvalidateRow(mr);
-        }
-      }
+    for (const BString *key : {&oldPath, &path}) {
+      auto range = fRowsByPath.equal_range(*key);
+      for (auto it = range.first; it != range.second; ++it)
+        InvalidateRow(it->second);
     }
   }
 }
@@ -1024,7 +1170,8 @@ void MediaTableView::SetNowPlayingPath(const BString &path) {
 /**
  * @brief Toggles column layout between library and radio modes.
  *
- * Radio columns: Station (0), Country (1), Language (2), Genre (4), URL (10).
+ * Radio columns: Station (0), Country (1), Language (2), Status (3),
+ * Genre (4), Latency (7), Bitrate (9), URL (10).
  * All other columns are hidden.
  *
  * @param radio True for radio layout, false for library layout.
@@ -1044,8 +1191,8 @@ void MediaTableView::SetRadioMode(bool radio) {
 
   fIsRadioMode = radio;
 
-  static const int32 kRadioFields[] = {0, 1, 2, 4, 10};
-  static const int32 kRadioFieldCount = 5;
+  static const int32 kRadioFields[] = {0, 1, 2, 3, 4, 7, 9, 10};
+  static const int32 kRadioFieldCount = 8;
 
   for (int32 i = 0; i < CountColumns(); ++i) {
     BColumn *col = ColumnAt(i);
@@ -1082,6 +1229,10 @@ void MediaTableView::SetRadioMode(bool radio) {
           titled->SetTitle(B_TRANSLATE("Country"));
         else if (field == 2)
           titled->SetTitle(B_TRANSLATE("Language"));
+        else if (field == 3)
+          titled->SetTitle(B_TRANSLATE("Status"));
+        else if (field == 7)
+          titled->SetTitle(B_TRANSLATE("Latency (ms)"));
         else if (field == 10)
           titled->SetTitle(B_TRANSLATE("URL"));
       } else {
@@ -1091,6 +1242,10 @@ void MediaTableView::SetRadioMode(bool radio) {
           titled->SetTitle(B_TRANSLATE("Artist"));
         else if (field == 2)
           titled->SetTitle(B_TRANSLATE("Album"));
+        else if (field == 3)
+          titled->SetTitle(B_TRANSLATE("Album Artist"));
+        else if (field == 7)
+          titled->SetTitle(B_TRANSLATE("Track"));
         else if (field == 10)
           titled->SetTitle(B_TRANSLATE("Path"));
       }
@@ -1109,121 +1264,87 @@ void MediaTableView::SetPlaylistMode(bool isPlaylist) {
 /**
  * @brief Destructor.
  */
-MediaTableView::~MediaTableView() {}
-
-/**
- * @brief Adds a single media item to the list view.
- * @param mi The media item to add.
- */
-void MediaTableView::AddEntry(const MediaItem &mi) {
-  MediaRow *row = new MediaRow(mi);
-  bool m = mi.missing;
+MediaTableView::~MediaTableView() {
+  // The rows are deleted by BColumnListView after this map is gone.
+  for (auto &entry : fRowsByPath)
+    entry.second->SetOwner(nullptr);
+  fRowsByPath.clear();
+}
 
-  SourceType src = SOURCE_TAGS;
+size_t MediaTableView::PathHash::operator()(const BString &path) const {
+  return HashMediaPath(path.String(), path.Length());
+}
 
-  std::shared_ptr<BString> pathPtr = std::make_shared<BString>(mi.path);
+void MediaTableView::_RegisterRow(MediaRow *row) {
+  row->SetOwner(this);
+  fRowsByPath.emplace(row->Item().path, row);
+}
 
-  if (!mi.path.IsEmpty()) {
-    if (mi.path.StartsWith("http://") || mi.path.StartsWith("https://")) {
-      src = SOURCE_TAGS;
-    } else {
-      MusicSourceSettings ms = MusicSourceSettings::GetSourceForPath(mi.path);
-      src = ms.primary;
+void MediaTableView::_UnregisterRow(MediaRow *row) {
+  auto range = fRowsByPath.equal_range(row->Item().path);
+  for (auto it = range.first; it != range.second; ++it) {
+    if (it->second == row) {
+      fRowsByPath.erase(it);
+      break;
     }
   }
+  row->SetOwner(nullptr);
+}
 
-  row->SetField(new StatusStringField(mi.title, m, pathPtr, src), 0);
-  row->SetField(new StatusStringField(mi.artist, m, pathPtr, src), 1);
-  row->SetField(new StatusStringField(mi.album, m, pathPtr, src), 2);
-  row->SetField(new StatusStringField(mi.albumArtist, m, pathPtr, src), 3);
-  row->SetField(new StatusStringField(mi.genre, m, pathPtr, src), 4);
-
-  BString yearStr;
-  yearStr << mi.year;
-  row->SetField(new StatusStringField(yearStr, m, pathPtr, src), 5);
+MediaRow *MediaTableView::_RowForPath(const BString &path) const {
+  auto it = fRowsByPath.find(path);
+  return it != fRowsByPath.end() ? it->second : nullptr;
+}
 
-  BString durStr;
-  int32 min = mi.duration / 60;
-  int32 sec = mi.duration % 60;
-  durStr.SetToFormat("%ld:%02ld", (long)min, (long)sec);
-  row->SetField(new StatusStringField(durStr, m, pathPtr, src), 6);
+/**
+ * @brief Adds a single media item to the list view.
+ * @param mi The media item to add.
+ */
+void MediaTableView::AddEntry(const MediaItem &mi) {
+  AddRow(_CreateRow(mi, fIsPlaylistMode ? CountRows() + 1 : 0));
+}
 
-  row->SetField(new StatusIntegerField(mi.track, m, src, pathPtr, mi.disc,
-                                       mi.track),
-                7);
-  row->SetField(new StatusIntegerField(mi.disc, m, src, pathPtr, mi.disc,
-                                       mi.track),
-                8);
-  row->SetField(new StatusIntegerField(mi.bitrate, m, src, pathPtr), 9);
-  row->SetField(new StatusStringField(mi.path, m, pathPtr, src), 10);
-  row->SetField(new StatusStringField(RatingColumn::RatingToStars(mi.rating), m,
-                                      pathPtr, src),
-                11);
-  row->SetField(new StatusIntegerField(fIsPlaylistMode ? CountRows() + 1 : 0,
-                                       m, src, pathPtr),
-                12);
+void MediaTableView::AppendEntries(const std::vector<MediaItem> &items) {
+  if (items.empty())
+    return;
 
-  AddRow(row);
+  BWindow *win = Window();
+  if (win)
+    win->DisableUpdates();
+  for (const MediaItem &mi : items)
+    AddEntry(mi);
+  if (win)
+    win->EnableUpdates();
 }
 
 void MediaTableView::UpdateItem(const MediaItem &mi, const BString *matchPath) {
   const BString &key = matchPath ? *matchPath : mi.path;
-  for (int32 i = 0; i < CountRows(); ++i) {
-    MediaRow *mr = dynamic_cast<MediaRow *>(RowAt(i));
-    if (mr && mr->Item().path == key) {
-      mr->SetItem(mi);
-
-      bool m = mi.missing;
-      SourceType src = SOURCE_TAGS;
-
-      std::shared_ptr<BString> pathPtr = std::make_shared<BString>(mi.path);
-
-      if (!mi.path.IsEmpty()) {
-        if (mi.path.StartsWith("http://") || mi.path.StartsWith("https://")) {
-          src = SOURCE_TAGS;
-        } else {
-          MusicSourceSettings ms = MusicSourceSettings::GetSourceForPath(mi.path);
-          src = ms.primary;
-        }
-      }
-
-      mr->SetField(new StatusStringField(mi.title, m, pathPtr, src), 0);
-      mr->SetField(new StatusStringField(mi.artist, m, pathPtr, src), 1);
-      mr->SetField(new StatusStringField(mi.album, m, pathPtr, src), 2);
-      mr->SetField(new StatusStringField(mi.albumArtist, m, pathPtr, src), 3);
-      mr->SetField(new StatusStringField(mi.genre, m, pathPtr, src), 4);
-
-      BString yearStr;
-      yearStr << mi.year;
-      mr->SetField(new StatusStringField(yearStr, m, pathPtr, src), 5);
-
-      BString durStr;
-      int32 min = mi.duration / 60;
-      int32 sec = mi.duration % 60;
-      durStr.SetToFormat("%ld:%02ld", (long)min, (long)sec);
-      mr->SetField(new StatusStringField(durStr, m, pathPtr, src), 6);
-
-      mr->SetField(new StatusIntegerField(mi.track, m, src, pathPtr,
-                                          mi.disc, mi.track),
-                   7);
-      mr->SetField(new StatusIntegerField(mi.disc, m, src, pathPtr, mi.disc,
-                                          mi.track),
-                   8);
-      mr->SetField(new StatusIntegerField(mi.bitrate, m, src, pathPtr), 9);
-      mr->SetField(new StatusStringField(mi.path, m, pathPtr, src), 10);
-      mr->SetField(new StatusStringField(RatingColumn::RatingToStars(mi.rating),
-                                         m, pathPtr, src),
-                   11);
-      mr->SetField(new StatusIntegerField(fIsPlaylistMode ? i + 1 : 0, m, src,
-                                          pathPtr),
-                   12);
-
-      InvalidateRow(mr);
-      break;
-    }
+  std::vector<MediaRow *> rows;
+  auto range = fRowsByPath.equal_range(key);
+  for (auto it = range.first; it != range.second; ++it)
+    rows.push_back(it->second);
+
+  // Rows keep their playlist position; only the item changes.
+  for (MediaRow *mr : rows) {
+    bool rekey = mr->Item().path != mi.path;
+    if (rekey)
+      _UnregisterRow(mr);
+    mr->SetItem(mi);
+    if (rekey)
+      _RegisterRow(mr);
+    InvalidateRow(mr);
   }
 }
 
+bool MediaTableView::RemoveEntry(const BString &path) {
+  MediaRow *row = _RowForPath(path);
+  if (row == nullptr)
+    return false;
+  RemoveRow(row);
+  delete row;
+  return true;
+}
+
 /**
  * @brief Adds multiple media items to the list view in batches.
  *
@@ -1232,27 +1353,21 @@ void MediaTableView::UpdateItem(const MediaItem &mi, const BString *matchPath) {
  *
  * @param items The vector of media items to add.
  */
-void MediaTableView::AddEntries(std::vector<MediaItem> items) {
+void MediaTableView::AddEntries(std::vector<MediaItem> items,
+                                bool presorted) {
   bigtime_t t0 = system_time();
   size_t itemCount = items.size();
   fPendingItems = std::move(items);
   fPendingIndex = 0;
 
-  if (!fHasPendingSortRestore && fIsPlaylistMode) {
-    fPendingSortRestore.MakeEmpty();
-    fPendingSortRestore.AddInt32("sortID", 12);
-    fPendingSortRestore.AddBool("sortascending", true);
-    fPendingSortRestore.AddInt32("sort_schema", 2);
-    fHasPendingSortRestore = true;
-  } else if (!fHasPendingSortRestore) {
-    fPendingSortRestore.MakeEmpty();
-    SaveSortState(&fPendingSortRestore);
+  if (!fHasPendingSortRestore) {
+    EffectiveSortState(&fPendingSortRestore, fIsPlaylistMode);
     if (!fPendingSortRestore.IsEmpty())
       fHasPendingSortRestore = true;
   }
 
   bigtime_t t1 = system_time();
-  if (fHasPendingSortRestore) {
+  if (fHasPendingSortRestore && !presorted) {
     _PreSortPendingItems();
   }
 
@@ -1268,10 +1383,254 @@ void MediaTableView::AddEntries(std::vector<MediaItem> items) {
 #if B_HAIKU_VERSION <= B_HAIKU_VERSION_1_BETA_5
   _AddBatch(kBeta5RowBatchSize);
 #else
-  _AddBatch(fPendingItems.size());
+  // Large lists: show the first page now, the rest in the next chunk.
+  size_t firstPage = (size_t)CountVisibleRows() + 1;
+  if (fPendingItems.size() > firstPage * 2)
+    _AddBatch(firstPage);
+  else
+    _AddBatch(fPendingItems.size());
 #endif
 }
 
+/** @brief Diffs touching at most this many rows are always applied. */
+static const size_t kMinDiffChanges = 64;
+
+/**
+ * @brief Whether a row showing `a` would look and sort the same with `b`.
+ * Strings come from the pool, so equal ones usually share their buffer.
+ */
+static bool SameShownItem(const MediaItem &a, const MediaItem &b) {
+  return a.missing == b.missing && a.mtime == b.mtime && a.size == b.size &&
+         a.rating == b.rating && a.duration == b.duration &&
+         a.year == b.year && a.track == b.track && a.disc == b.disc &&
+         a.bitrate == b.bitrate && StringPool::Equals(a.title, b.title) &&
+         StringPool::Equals(a.artist, b.artist) &&
+         StringPool::Equals(a.album, b.album) &&
+         StringPool::Equals(a.albumArtist, b.albumArtist) &&
+         StringPool::Equals(a.genre, b.genre);
+}
+
+/**
+ * @brief Marks the longest strictly increasing subsequence of `values`.
+ * @return One flag per value; `true` for members of the subsequence.
+ */
+static std::vector<bool> LongestIncreasingRun(
+    const std::vector<int32> &values) {
+  std::vector<int32> tails;    // Index of the last value of each run length
+  std::vector<int32> previous(values.size(), -1);
+  for (int32 i = 0; i < (int32)values.size(); i++) {
+    auto it = std::lower_bound(
+        tails.begin(), tails.end(), values[i],
+        [&values](int32 index, int32 value) { return values[index] < value; });
+    if (it != tails.begin())
+      previous[i] = *(it - 1);
+    if (it == tails.end())
+      tails.push_back(i);
+    else
+      *it = i;
+  }
+
+  std::vector<bool> member(values.size(), false);
+  for (int32 i = tails.empty() ? -1 : tails.back(); i >= 0; i = previous[i])
+    member[i] = true;
+  return member;
+}
+
+bool MediaTableView::ApplyEntries(std::vector<MediaItem> items,
+                                  bool presorted, bool preserveScroll) {
+  auto reload = [&]() {
+    if (preserveScroll)
+      SaveScrollState();
+    ClearEntries();
+    AddEntries(std::move(items), presorted);
+    return false;
+  };
+
+  if (fPendingIndex < fPendingItems.size() || fHasPendingSortRestore)
+    return reload();
+
+  bigtime_t t0 = system_time();
+  // Playlist rows are numbered in the given order; the view sorts them by
+  // another column once sorting resumes.
+  if (!presorted && !fIsPlaylistMode) {
+    BMessage sortState;
+    EffectiveSortState(&sortState, fIsPlaylistMode);
+    if (!sortState.IsEmpty())
+      SortItems(items, sortState, fIsPlaylistMode);
+  }
+
+  /// Pair rows with items by path, in row order.
+  const int32 rowCount = CountRows();
+  std::vector<MediaRow *> rows(rowCount, nullptr);
+  std::unordered_map<BString, std::vector<int32>, PathHash> rowsByPath;
+  rowsByPath.reserve(rowCount);
+  for (int32 i = 0; i < rowCount; i++) {
+    rows[i] = dynamic_cast<MediaRow *>(RowAt(i));
+    if (rows[i] != nullptr)
+      rowsByPath[rows[i]->Item().path].push_back(i);
+  }
+  // Reversed, so pairing pops the first remaining row of a path.
+  for (auto &entry : rowsByPath)
+    std::reverse(entry.second.begin(), entry.second.end());
+
+  std::vector<int32> itemOfRow(rowCount, -1);
+  std::vector<int32> rowOfItem(items.size(), -1);
+  size_t inserted = 0;
+  for (size_t j = 0; j < items.size(); j++) {
+    auto it = rowsByPath.find(items[j].path);
+    if (it == rowsByPath.end() || it->second.empty()) {
+      inserted++;
+      continue;
+    }
+    rowOfItem[j] = it->second.back();
+    itemOfRow[rowOfItem[j]] = (int32)j;
+    it->second.pop_back();
+  }
+
+  /// Kept rows in row order; those outside the longest run of increasing
+  /// item positions have to move.
+  std::vector<int32> keptItems;
+  for (int32 i = 0; i < rowCount; i++) {
+    if (itemOfRow[i] >= 0)
+      keptItems.push_back(itemOfRow[i]);
+  }
+  std::vector<bool> inPlace = LongestIncreasingRun(keptItems);
+  size_t moved = std::count(inPlace.begin(), inPlace.end(), false);
+  size_t removed = (size_t)rowCount - keptItems.size();
+
+  const size_t changes = removed + inserted + moved;
+  if (changes > std::max(kMinDiffChanges, items.size() / 4))
+    return reload();
+
+  BRow *topRow = nullptr;
+  if (preserveScroll) {
+    BPoint topPoint(0, 5);
+    if (BView *outline = ScrollView())
+      topPoint.y += outline->Bounds().top;
+    topRow = RowAt(topPoint);
+  }
+
+  BWindow *win = Window();
+  if (win)
+    win->DisableUpdates();
+  // Rows go exactly where they are put; sorting resumes afterwards.
+  const bool sorting = SortingEnabled();
+  if (sorting)
+    SetSortingEnabled(false);
+
+  std::vector<bool> movedItem(items.size(), false);
+  size_t kept = 0;
+  for (int32 i = 0; i < rowCount; i++) {
+    MediaRow *row = rows[i];
+    if (row == nullptr)
+      continue;
+    const int32 j = itemOfRow[i];
+    if (j < 0) {
+      if (row == topRow)
+        topRow = nullptr;
+      RemoveRow(row);
+      delete row;
+      continue;
+    }
+    if (!inPlace[kept++]) {
+      RemoveRow(row);
+      movedItem[j] = true;
+    }
+    if (!SameShownItem(row->Item(), items[j])) {
+      row->SetItem(items[j]);
+      InvalidateRow(row);
+    }
+  }
+
+  /// The rows in place are in item order; fill in the others around them.
+  for (size_t j = 0; j < items.size(); j++) {
+    const int32 playlistIndex = fIsPlaylistMode ? (int32)j + 1 : 0;
+    if (rowOfItem[j] < 0) {
+      AddRow(_CreateRow(items[j], playlistIndex), (int32)j);
+      continue;
+    }
+    MediaRow *row = rows[rowOfItem[j]];
+    if (row->PlaylistIndex() != playlistIndex) {
+      row->SetPlaylistIndex(playlistIndex);
+      InvalidateRow(row);
+    }
+    if (movedItem[j])
+      AddRow(row, (int32)j);
+  }
+
+  if (sorting)
+    SetSortingEnabled(true);
+
+  // Rows share one height.
+  int32 topIndex = topRow != nullptr ? IndexOf(topRow) : -1;
+  if (topIndex >= 0)
+    ScrollTo(BPoint(0, topIndex * (topRow->Height() + 1)));
+  else if (!preserveScroll)
+    ScrollTo(BPoint(0, 0));
+  RefreshScrollbars();
+
+  if (win)
+    win->EnableUpdates();
+
+  DEBUG_PRINT("ApplyEntries(%zu): %zu removed, %zu inserted, %zu moved, "
+              "%lld us\n",
+              items.size(), removed, inserted, moved,
+              (long long)(system_time() - t0));
+
+  if (Looper())
+    Looper()->PostMessage(MSG_COUNT_UPDATED);
+  return true;
+}
+
+int32 MediaTableView::CountVisibleRows() const {
+  float height = Bounds().Height();
+  if (BView *outline = const_cast<MediaTableView *>(this)->ScrollView())
+    height = outline->Bounds().Height();
+  int32 rows = (int32)(height / (CalculateRowHeight() + 1)) + 1;
+  return rows > 0 ? rows : 1;
+}
+
+int32 MediaTableView::FirstVisibleIndex() const {
+  MediaTableView *self = const_cast<MediaTableView *>(this);
+
+  // Same content-space probe as SaveScrollState().
+  BPoint topPoint(0, 5);
+  if (BView *outline = self->ScrollView())
+    topPoint.y += outline->Bounds().top;
+
+  BRow *top = self->RowAt(topPoint);
+  int32 first = top != nullptr ? self->IndexOf(top) : 0;
+  return first < 0 ? 0 : first;
+}
+
+std::vector<BString> MediaTableView::VisiblePaths() const {
+  std::vector<BString> paths;
+  MediaTableView *self = const_cast<MediaTableView *>(this);
+
+  int32 first = FirstVisibleIndex();
+  int32 last = std::min(self->CountRows(), first + CountVisibleRows());
+  for (int32 i = first; i < last; i++) {
+    if (const MediaItem *item = ItemAt(i))
+      paths.push_back(item->path);
+  }
+  return paths;
+}
+
+std::vector<BString> MediaTableView::AttentionPaths(size_t limit) const {
+  std::vector<BString> paths = VisiblePaths();
+  if (paths.size() > limit)
+    paths.resize(limit);
+
+  for (BRow *r = CurrentSelection(); r && paths.size() < limit;
+       r = CurrentSelection(r)) {
+    const MediaRow *row = dynamic_cast<const MediaRow *>(r);
+    if (row && std::find(paths.begin(), paths.end(), row->Item().path) ==
+                   paths.end())
+      paths.push_back(row->Item().path);
+  }
+  return paths;
+}
+
 /**
  * @brief Creates a MediaRow from a MediaItem without adding it to the view.
  *
@@ -1280,57 +1639,10 @@ void MediaTableView::AddEntries(std::vector<MediaItem> items) {
  * @return Pointer to the newly created MediaRow.
  */
 BRow *MediaTableView::_CreateRow(const MediaItem &mi, int32 playlistIndex) {
-  MediaRow *row = new MediaRow(mi);
-  bool m = mi.missing;
-  SourceType src = SOURCE_TAGS;
-
-  std::shared_ptr<BString> pathPtr = std::make_shared<BString>(mi.path);
-
-  if (!mi.path.IsEmpty()) {
-    /**
-     * @brief Skip MusicSourceSettings lookup for remote URLs (DLNA/Radio).
-     */
-    if (mi.path.StartsWith("http://") || mi.path.StartsWith("https://")) {
-      src = SOURCE_TAGS;
-    } else {
-      MusicSourceSettings ms = MusicSourceSettings::GetSourceForPath(mi.path);
-      src = ms.primary;
-    }
-  }
-
-  row->SetField(new StatusStringField(mi.title, m, pathPtr, src), 0);
-  row->SetField(new StatusStringField(mi.artist, m, pathPtr, src), 1);
-  row->SetField(new StatusStringField(mi.album, m, pathPtr, src), 2);
-  row->SetField(new StatusStringField(mi.albumArtist, m, pathPtr, src), 3);
-  row->SetField(new StatusStringField(mi.genre, m, pathPtr, src), 4);
-
-  BString yearStr;
-  yearStr << mi.year;
-  row->SetField(new StatusStringField(yearStr, m, pathPtr, src), 5);
-
-  BString durStr;
-  int32 min = mi.duration / 60;
-  int32 sec = mi.duration % 60;
-  durStr.SetToFormat("%ld:%02ld", (long)min, (long)sec);
-  row->SetField(new StatusStringField(durStr, m, pathPtr, src), 6);
-
-  row->SetField(new StatusIntegerField(mi.track, m, src, pathPtr, mi.disc,
-                                       mi.track),
-                7);
-  row->SetField(new StatusIntegerField(mi.disc, m, src, pathPtr, mi.disc,
-                                       mi.track),
-                8);
-  row->SetField(new StatusIntegerField(mi.bitrate, m, src, pathPtr), 9);
-  row->SetField(new StatusStringField(mi.path, m, pathPtr, src), 10);
-  row->SetField(new StatusStringField(RatingColumn::RatingToStars(mi.rating), m,
-                                      pathPtr, src),
-                11);
-  row->SetField(new StatusIntegerField((fIsPlaylistMode && playlistIndex > 0)
-                                           ? playlistIndex
-                                           : 0,
-                                       m, src, pathPtr),
-                12);
-
+  MediaRow *row = new MediaRow(mi, (fIsPlaylistMode && playlistIndex > 0)
+                                       ? playlistIndex
+                                       : 0);
+  _RegisterRow(row);
   return row;
 }
 
@@ -1446,35 +1758,71 @@ void MediaTableView::ClearEntries() {
   RefreshScrollbars();
 }
 
+std::vector<MediaItem> MediaTableView::Entries() const {
+  MediaTableView *self = const_cast<MediaTableView *>(this);
+  const int32 count = self->CountRows();
+  std::vector<const MediaRow *> rows;
+  rows.reserve(count);
+  for (int32 i = 0; i < count; i++) {
+    if (auto *mr = dynamic_cast<const MediaRow *>(self->RowAt(i)))
+      rows.push_back(mr);
+  }
+  // A playlist sorted by another column still numbers its rows in order.
+  if (fIsPlaylistMode) {
+    std::stable_sort(rows.begin(), rows.end(),
+                     [](const MediaRow *a, const MediaRow *b) {
+                       return a->PlaylistIndex() < b->PlaylistIndex();
+                     });
+  }
+
+  std::vector<MediaItem> items;
+  items.reserve(rows.size());
+  for (const MediaRow *row : rows)
+    items.push_back(row->Item());
+  return items;
+}
+
 /**
  * @brief Refreshes the scrollbars by invalidating the layout.
  */
 void MediaTableView::RefreshScrollbars() { InvalidateLayout(); }
 
 void MediaTableView::SaveScrollState() {
-  fTopVisiblePath = "";
-  fSavedSelectedPaths.clear();
+  GetScrollState(fTopVisiblePath, fSavedSelectedPaths);
+}
+
+void MediaTableView::GetScrollState(
+    BString &topPath, std::vector<BString> &selectedPaths) const {
+  MediaTableView *self = const_cast<MediaTableView *>(this);
+  topPath = "";
+  selectedPaths.clear();
 
   // RowAt(BPoint) expects content-space coordinates: y=5 is always the
   // first row of the list. Offset by the outline view's scroll position
   // to probe the row actually visible at the top.
   BPoint topPoint(0, 5);
-  if (BView *outline = ScrollView())
+  if (BView *outline = self->ScrollView())
     topPoint.y += outline->Bounds().top;
 
-  if (BRow *topRow = RowAt(topPoint)) {
+  if (BRow *topRow = self->RowAt(topPoint)) {
     if (auto *mr = dynamic_cast<MediaRow *>(topRow)) {
-      fTopVisiblePath = mr->Item().path;
+      topPath = mr->Item().path;
     }
   }
 
   for (BRow *r = CurrentSelection(); r; r = CurrentSelection(r)) {
     if (auto *mr = dynamic_cast<MediaRow *>(r)) {
-      fSavedSelectedPaths.push_back(mr->Item().path);
+      selectedPaths.push_back(mr->Item().path);
     }
   }
 }
 
+void MediaTableView::RestoreScrollState(
+    const BString &topPath, const std::vector<BString> &selectedPaths) {
+  fTopVisiblePath = topPath;
+  fSavedSelectedPaths = selectedPaths;
+}
+
 /**
  * @brief Initiates a drag operation for selected items.
  * @param point The point where the drag started.
@@ -1731,6 +2079,13 @@ void MediaTableView::MessageReceived(BMessage *msg) {
     if (isRadio) {
       menu.AddItem(
           new BMenuItem(B_TRANSLATE("Play"), new BMessage(MSG_RADIO_PLAY)));
+      BMenuItem *record = new BMenuItem(B_TRANSLATE("Record Playing Station"),
+                                        new BMessage(MSG_RADIO_RECORD));
+      if (auto *mw = dynamic_cast<MainWindow *>(Window())) {
+        record->SetMarked(mw->IsRadioRecording());
+        record->SetEnabled(mw->IsRadioRecording() || mw->CanRecordRadio());
+      }
+      menu.AddItem(record);
       menu.AddSeparatorItem();
       menu.AddItem(new BMenuItem(B_TRANSLATE("Edit Station..."),
                                  new BMessage(MSG_RADIO_EDIT)));
@@ -1739,6 +2094,11 @@ void MediaTableView::MessageReceived(BMessage *msg) {
       menu.AddSeparatorItem();
       menu.AddItem(new BMenuItem(B_TRANSLATE("Add Station..."),
                                  new BMessage(MSG_RADIO_ADD)));
+      BMenuItem *more = new BMenuItem(B_TRANSLATE("Show More Stations"),
+                                      new BMessage(MSG_RADIO_MORE_STATIONS));
+      if (auto *mw = dynamic_cast<MainWindow *>(Window()))
+        more->SetEnabled(mw->HasMoreRadioStations());
+      menu.AddItem(more);
     } else if (isDlna) {
       menu.AddItem(new BMenuItem(B_TRANSLATE("Play"), new BMessage(MSG_PLAY)));
       menu.AddSeparatorItem();
@@ -2005,19 +2365,23 @@ const MediaItem *MediaTableView::ItemAt(int32 index) const {
   return nullptr;
 }
 
+const MediaItem *MediaTableView::FindItem(const BString &path) const {
+  const MediaRow *row = _RowForPath(path);
+  return row != nullptr ? &row->Item() : nullptr;
+}
+
 /**
- * @brief Builds a playback queue from the current sorted view.
+ * @brief Appends the current sorted view to a playback queue.
  *
- * Iterates all rows in display order and collects file paths
- * of non-missing items. This is more efficient than having
- * the caller iterate via ItemAt() individually.
+ * Iterates all rows in display order and adds the non-missing items. The
+ * queue shares each path buffer with the row's item, so even the whole
+ * library copies no strings.
  *
- * @param[out] outQueue Vector to fill with file paths.
+ * @param[out] queue Queue to append to.
  */
-void MediaTableView::BuildQueue(std::vector<std::string> &outQueue) const {
+void MediaTableView::BuildQueue(PlaybackQueue &queue) const {
   int32 count = CountRows();
-  outQueue.clear();
-  outQueue.reserve(count);
+  queue.Reserve(count);
 
   for (int32 i = 0; i < count; ++i) {
     const MediaRow *row = dynamic_cast<const MediaRow *>(RowAt(i));
@@ -2026,7 +2390,7 @@ void MediaTableView::BuildQueue(std::vector<std::string> &outQueue) const {
     const MediaItem &mi = row->Item();
     if (mi.missing)
       continue;
-    outQueue.emplace_back(mi.path.String());
+    queue.Append(mi.path, ReplayGain::Of(mi));
   }
 }
 
@@ -2240,99 +2604,54 @@ void MediaTableView::RestoreSortState(BMessage *msg) {
  * @brief Pre-sorts fPendingItems in memory based on the pending sort state.
  *
  * Maps the sort column field ID to the corresponding MediaItem field
- * and uses std::sort so items can be inserted into BColumnListView
- * in already-sorted order, avoiding O(N^2) re-sort overhead.
+ * and sorts by precomputed keys (see MediaSortKey) so items can be
+ * inserted into BColumnListView in already-sorted order, avoiding O(N^2)
+ * re-sort overhead.
  *
  * Column field IDs: 0=title, 1=artist, 2=album, 3=albumArtist,
  * 4=genre, 5=year, 6=duration, 7=track, 8=disc, 9=bitrate,
  * 10=path, 11=rating, 12=playlist sort order.
  */
 void MediaTableView::_PreSortPendingItems() {
+  SortItems(fPendingItems, fPendingSortRestore, fIsPlaylistMode);
+}
+
+void MediaTableView::EffectiveSortState(BMessage *msg, bool playlistMode) {
+  if (!msg)
+    return;
+
+  if (fHasPendingSortRestore) {
+    *msg = fPendingSortRestore;
+  } else if (playlistMode) {
+    msg->MakeEmpty();
+    msg->AddInt32("sortID", 12);
+    msg->AddBool("sortascending", true);
+    msg->AddInt32("sort_schema", 2);
+  } else {
+    SaveSortState(msg);
+  }
+}
+
+void MediaTableView::SortItems(std::vector<MediaItem> &items,
+                               const BMessage &sortState, bool playlistMode) {
   int32 sortID = -1;
   bool ascending = true;
 
-  if (fPendingSortRestore.FindInt32("sortID", 0, &sortID) != B_OK)
+  if (sortState.FindInt32("sortID", 0, &sortID) != B_OK)
     return;
-  fPendingSortRestore.FindBool("sortascending", 0, &ascending);
+  sortState.FindBool("sortascending", 0, &ascending);
 
   int32 sortSchema = 0;
   bool legacySortState =
-      fPendingSortRestore.FindInt32("sort_schema", &sortSchema) != B_OK;
-  if (legacySortState && fIsPlaylistMode && sortID == 7)
+      sortState.FindInt32("sort_schema", &sortSchema) != B_OK;
+  if (legacySortState && playlistMode && sortID == 7)
     sortID = 12;
 
-  if (sortID == 12)
+  // 12 is the playlist order, which the items already have.
+  if (sortID < 0 || sortID >= 12)
     return;
 
-  auto compareInt = [](int32 a, int32 b) {
-    return (a < b) ? -1 : (a > b ? 1 : 0);
-  };
-
-  auto compareAlbumOrder = [&](const MediaItem &a, const MediaItem &b,
-                               bool primaryTrack) {
-    int result = 0;
-    if (primaryTrack) {
-      result = compareInt(a.disc, b.disc);
-      if (result == 0)
-        result = compareInt(a.track, b.track);
-    } else {
-      result = compareInt(a.disc, b.disc);
-      if (result == 0)
-        result = compareInt(a.track, b.track);
-    }
-    return result;
-  };
-
-  auto cmp = [sortID, ascending, compareInt,
-              compareAlbumOrder](const MediaItem &a,
-                                 const MediaItem &b) -> bool {
-    int result = 0;
-    switch (sortID) {
-    case 0:
-      result = a.title.ICompare(b.title);
-      break;
-    case 1:
-      result = a.artist.ICompare(b.artist);
-      break;
-    case 2:
-      result = a.album.ICompare(b.album);
-      break;
-    case 3:
-      result = a.albumArtist.ICompare(b.albumArtist);
-      break;
-    case 4:
-      result = a.genre.ICompare(b.genre);
-      break;
-    case 5:
-      result = compareInt(a.year, b.year);
-      break;
-    case 6:
-      result = compareInt(a.duration, b.duration);
-      break;
-    case 7:
-      result = compareAlbumOrder(a, b, true);
-      break;
-    case 8:
-      result = compareAlbumOrder(a, b, false);
-      break;
-    case 9:
-      result = compareInt(a.bitrate, b.bitrate);
-      break;
-    case 10:
-      result = a.path.ICompare(b.path);
-      break;
-    case 11:
-      result = compareInt(a.rating, b.rating);
-      break;
-    default:
-      return false;
-    }
-    if (result == 0)
-      result = a.path.ICompare(b.path);
-    return ascending ? (result < 0) : (result > 0);
-  };
-
-  std::sort(fPendingItems.begin(), fPendingItems.end(), cmp);
+  SortMediaItems(items, sortID, ascending);
 }
 
 /**
@@ -2466,13 +2785,9 @@ void MediaTableView::StartCellEdit(BRow *row, BColumn *column, int32 colIdx, flo
 
   BRect cellRect(colLeft, rowRect.top, colLeft + column->Width(), rowRect.bottom);
 
-  BField *field = row->GetField(colIdx);
   BString initialText;
-  if (auto *sf = dynamic_cast<BStringField *>(field)) {
-    initialText = sf->String();
-  } else if (auto *ifld = dynamic_cast<BIntegerField *>(field)) {
-    initialText << ifld->Value();
-  }
+  if (auto *mr = dynamic_cast<MediaRow *>(row))
+    initialText = CellText(*mr, colIdx);
 
   fEditingPathPrefix = "";
   if (colIdx == 10) {
@@ -2553,11 +2868,8 @@ void MediaTableView::CommitCellEdit(bool restoreFocus) {
 
   BString originalText;
   if (fEditingRow) {
-    BField *field = fEditingRow->GetField(fEditingColIdx);
-    if (auto *sf = dynamic_cast<BStringField *>(field))
-      originalText = sf->String();
-    else if (auto *ifld = dynamic_cast<BIntegerField *>(field))
-      originalText << ifld->Value();
+    if (auto *mr = dynamic_cast<MediaRow *>(fEditingRow))
+      originalText = CellText(*mr, fEditingColIdx);
     if (fEditingColIdx == 10 && !fEditingPathPrefix.IsEmpty())
       originalText.Prepend(fEditingPathPrefix);
   }
@@ -2683,13 +2995,9 @@ void MediaTableView::LocatePlayingTrack() {
   if (fNowPlayingPath.IsEmpty())
     return;
 
-  for (int32 i = 0; i < CountRows(); ++i) {
-    MediaRow *mr = dynamic_cast<MediaRow *>(RowAt(i));
-    if (mr && mr->Item().path == fNowPlayingPath) {
-      DeselectAll();
-      AddToSelection(mr);
-      ScrollTo(mr);
-      break;
-    }
+  if (MediaRow *mr = _RowForPath(fNowPlayingPath)) {
+    DeselectAll();
+    AddToSelection(mr);
+    ScrollTo(mr);
   }
 }
@@ -9,9 +9,13 @@
 #include <PopUpMenu.h>
 #include <map>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
+class PlaybackQueue;
+
 class CellTextControl;
+class MediaRow;
 
 /**
  * @class MediaTableView
@@ -23,7 +27,10 @@ class CellTextControl;
  * Drag & Drop of items.
  * Context menus.
  * Graying out missing files. (Here we still need a solution what todo with them, maybe delete from DB?)
- * 
+ *
+ * Rows hold only their MediaItem; cell text is formatted when a visible row
+ * is drawn and sorting compares the item values directly. A hash from path
+ * to rows lets per-item updates find their row without walking the list.
  */
 class MediaTableView : public BColumnListView {
 public:
@@ -35,25 +42,93 @@ public:
    */
   void AddEntry(const MediaItem &mi);
 
+  /**
+   * @brief Adds several items to the current rows with a single redraw.
+   *
+   * Unlike AddEntries() this keeps the existing rows.
+   */
+  void AppendEntries(const std::vector<MediaItem> &items);
+
   /**
    * @brief Adds a list of items asynchronously (chunked).
+   *
+   * The first screenful of rows is added and drawn before the rest follows
+   * with the next chunk.
+   *
+   * @param presorted True if `items` are already ordered by
+   * EffectiveSortState(), e.g. by SortItems() on a worker thread.
    */
-  void AddEntries(std::vector<MediaItem> items);
+  void AddEntries(std::vector<MediaItem> items, bool presorted = false);
+
+  /**
+   * @brief Changes the rows to show `items`, in that order, touching only
+   * the rows that differ.
+   *
+   * Rows are matched to items by path, each row once, so repeated playlist
+   * entries pair up in order. Unmatched rows are removed, new items
+   * inserted, and kept rows take the new item and move only if they are out
+   * of order (all but a longest increasing run of them). Kept rows stay
+   * selected. With `preserveScroll` the top visible row stays at the top,
+   * otherwise the list scrolls to its start.
+   *
+   * Reloads through ClearEntries() and AddEntries() instead while a chunked
+   * load or sort restore is pending, or when most rows change.
+   *
+   * @param presorted True if `items` are already ordered by
+   * EffectiveSortState().
+   * @return `true` if the changes were applied in place.
+   */
+  bool ApplyEntries(std::vector<MediaItem> items, bool presorted = false,
+                    bool preserveScroll = true);
 
   void ClearEntries();
+
+  /** @brief Whether a chunked load or sort restore is still pending. */
+  bool IsLoading() const {
+    return fPendingIndex < fPendingItems.size() || fHasPendingSortRestore;
+  }
+
+  /**
+   * @brief Items of all rows, in the order AddEntries() takes them: playlist
+   * order in playlist mode, display order otherwise.
+   */
+  std::vector<MediaItem> Entries() const;
+
+  /**
+   * @brief Removes (and deletes) one row showing `path`.
+   * @return `true` if a row was removed.
+   */
+  bool RemoveEntry(const BString &path);
+
   void RefreshScrollbars();
 
   /**
-   * @brief Builds a playback queue from the current sorted view.
-   * @param[out] outQueue Vector to fill with file paths in display order.
+   * @brief Appends the current sorted view to `queue`, in display order.
    * @note Skips missing files.
    */
-  void BuildQueue(std::vector<std::string> &outQueue) const;
+  void BuildQueue(PlaybackQueue &queue) const;
 
   static constexpr uint32 kMsgShowCtx = MSG_SHOW_CONTEXT_MENU;
 
   const MediaItem *SelectedItem() const;
   const MediaItem *ItemAt(int32 index) const;
+  /** @brief Item of a row showing `path`, or nullptr. */
+  const MediaItem *FindItem(const BString &path) const;
+
+  /** @brief Number of rows that fit into the visible area. */
+  int32 CountVisibleRows() const;
+
+  /** @brief Index of the top row on screen. */
+  int32 FirstVisibleIndex() const;
+
+  /** @brief Paths of the rows currently on screen, top to bottom. */
+  std::vector<BString> VisiblePaths() const;
+
+  /**
+   * @brief Paths of the rows on screen, then of the selected rows, at most
+   * `limit`. Used to tell the scanners what the user is looking at.
+   */
+  std::vector<BString> AttentionPaths(size_t limit) const;
   bool IsRowMissing(BRow *row) const;
 
   /**
@@ -75,9 +150,13 @@ public:
    * In playlist mode, the Sort column displays the sequence index.
    */
   void SetPlaylistMode(bool isPlaylist);
+  bool IsPlaylistMode() const { return fIsPlaylistMode; }
 
   /**
-   * @brief Updates a single row in-place with new metadata without rebuilding the list.
+   * @brief Updates the rows of an item in-place without rebuilding the list.
+   *
+   * Only the affected rows are invalidated.
+   *
    * @param mi The updated media item.
    * @param matchPath Optional row key; rows are matched against this path
    *                  instead of mi.path (used when the path itself changed).
@@ -121,6 +200,17 @@ public:
   
   void SaveScrollState();
 
+  /** @brief Path of the top visible row and of the selected rows. */
+  void GetScrollState(BString &topPath,
+                      std::vector<BString> &selectedPaths) const;
+
+  /**
+   * @brief Scrolls to and selects rows of these paths once the next
+   * AddEntries() has added its last row.
+   */
+  void RestoreScrollState(const BString &topPath,
+                          const std::vector<BString> &selectedPaths);
+
   /**
    * @brief Saves the current sort column and direction.
    * @param msg Message to store sort state into.
@@ -134,6 +224,24 @@ public:
    */
   void RestoreSortState(BMessage *msg);
 
+  /**
+   * @brief Returns the sort state the next AddEntries() will apply.
+   *
+   * That is a pending restore if there is one, the playlist order in
+   * playlist mode, or the current sort columns.
+   *
+   * @param msg Message to store sort state into.
+   * @param playlistMode Playlist mode the entries will be added in.
+   */
+  void EffectiveSortState(BMessage *msg, bool playlistMode);
+
+  /**
+   * @brief Sorts items in memory the way the view would sort them by
+   * `sortState`. Safe to call from any thread.
+   */
+  static void SortItems(std::vector<MediaItem> &items,
+                        const BMessage &sortState, bool playlistMode);
+
 protected:
   bool InitiateDrag(BPoint point, bool wasSelected) override;
   void KeyDown(const char *bytes, int32 numBytes) override;
@@ -162,11 +270,18 @@ private:
                              BView *targetView);
   void InstallEditorKeyFilter();
   void RemoveEditorKeyFilter();
-  /**
-   * @note fRowMap seemed unused in the .cpp, but keeping declaration if needed
-   * later.
-   */
-  std::map<BRow *, MediaItem> fRowMap;
+  /** @name Row lookup */
+  ///@{
+  friend class MediaRow;
+  struct PathHash {
+    size_t operator()(const BString &path) const;
+  };
+  void _RegisterRow(MediaRow *row);
+  void _UnregisterRow(MediaRow *row);
+  MediaRow *_RowForPath(const BString &path) const;
+  /** Every MediaRow of the view by item path (a playlist may repeat one). */
+  std::unordered_multimap<BString, MediaRow *, PathHash> fRowsByPath;
+  ///@}
 
   /** @name Chunked loading state */
   ///@{
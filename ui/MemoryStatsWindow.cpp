@@ -0,0 +1,102 @@
+#include "MemoryStatsWindow.h"
+#include "Messages.h"
+
+#include <Button.h>
+#include <Catalog.h>
+#include <File.h>
+#include <FindDirectory.h>
+#include <LayoutBuilder.h>
+#include <MessageRunner.h>
+#include <Path.h>
+#include <ScrollView.h>
+#include <StringView.h>
+#include <TextView.h>
+
+#undef B_TRANSLATION_CONTEXT
+#define B_TRANSLATION_CONTEXT "MemoryStatsWindow"
+
+MemoryStatsWindow::MemoryStatsWindow(const BMessenger &target)
+    : BWindow(BRect(100, 100, 600, 400), B_TRANSLATE("Memory Usage"),
+              B_TITLED_WINDOW, B_ASYNCHRONOUS_CONTROLS),
+      fTarget(target), fRunner(nullptr) {
+  fText = new BTextView("memory");
+  fText->MakeEditable(false);
+  fText->SetFontAndColor(be_fixed_font);
+  fText->SetWordWrap(false);
+  BScrollView *scroll = new BScrollView("scroll", fText, 0, true, true);
+
+  fStatus = new BStringView("status", "");
+  fBtnTrim = new BButton("Trim", B_TRANSLATE("Trim Caches"),
+                         new BMessage(MSG_MEMORY_TRIM));
+  fBtnSave = new BButton("Save", B_TRANSLATE("Save to Desktop"),
+                         new BMessage(MSG_MEMORY_SAVE));
+
+  BLayoutBuilder::Group<>(this, B_VERTICAL, 10)
+      .SetInsets(10, 10, 10, 10)
+      .Add(scroll)
+      .AddGroup(B_HORIZONTAL, 10)
+      .Add(fStatus)
+      .AddGlue()
+      .Add(fBtnTrim)
+      .Add(fBtnSave)
+      .End();
+
+  font_height fh;
+  be_fixed_font->GetHeight(&fh);
+  float fontHeight = fh.ascent + fh.descent + fh.leading;
+  ResizeTo(be_fixed_font->StringWidth("x") * 50, fontHeight * 18);
+  CenterOnScreen();
+
+  _RequestReport();
+  BMessage tick(MSG_MEMORY_REFRESH);
+  fRunner = new BMessageRunner(BMessenger(this), &tick, 1000000);
+}
+
+MemoryStatsWindow::~MemoryStatsWindow() { delete fRunner; }
+
+void MemoryStatsWindow::MessageReceived(BMessage *msg) {
+  switch (msg->what) {
+  case MSG_MEMORY_REFRESH:
+    _RequestReport();
+    break;
+  case MSG_MEMORY_REPORT: {
+    const char *report = nullptr;
+    if (msg->FindString("report", &report) == B_OK)
+      fText->SetText(report);
+    break;
+  }
+  case MSG_MEMORY_TRIM:
+    fTarget.SendMessage(MSG_MEMORY_TRIM);
+    fStatus->SetText(B_TRANSLATE("Caches trimmed"));
+    _RequestReport();
+    break;
+  case MSG_MEMORY_SAVE:
+    _Save();
+    break;
+  default:
+    BWindow::MessageReceived(msg);
+  }
+}
+
+void MemoryStatsWindow::_RequestReport() {
+  BMessage request(MSG_MEMORY_REPORT);
+  fTarget.SendMessage(&request, this);
+}
+
+void MemoryStatsWindow::_Save() {
+  BPath path;
+  if (find_directory(B_DESKTOP_DIRECTORY, &path) != B_OK)
+    return;
+  path.Append("BeTon memory usage.txt");
+
+  BFile file(path.Path(), B_WRITE_ONLY | B_CREATE_FILE | B_ERASE_FILE);
+  ssize_t length = fText->TextLength();
+  if (file.InitCheck() == B_OK &&
+      file.Write(fText->Text(), length) == length) {
+    BString text(B_TRANSLATE("Saved to %path%"));
+    text.ReplaceFirst("%path%", path.Path());
+    fStatus->SetText(text.String());
+  } else {
+    fStatus->SetText(B_TRANSLATE("Could not save the report"));
+  }
+}
@@ -0,0 +1,39 @@
+#ifndef BETON_MEMORY_STATS_WINDOW_H
+#define BETON_MEMORY_STATS_WINDOW_H
+
+#include <Messenger.h>
+#include <Window.h>
+
+class BButton;
+class BMessageRunner;
+class BStringView;
+class BTextView;
+
+/**
+ * @class MemoryStatsWindow
+ * @brief Debug window showing MemoryStats::Report(), refreshed every second.
+ *
+ * The report is requested from `target` (the main window) with
+ * `MSG_MEMORY_REPORT`, which brings the accounts of the window's own item
+ * lists up to date first. "Trim Caches" sends `MSG_MEMORY_TRIM` there.
+ */
+class MemoryStatsWindow : public BWindow {
+public:
+  explicit MemoryStatsWindow(const BMessenger &target);
+  ~MemoryStatsWindow() override;
+
+  void MessageReceived(BMessage *msg) override;
+
+private:
+  void _RequestReport();
+  void _Save();
+
+  BMessenger fTarget;
+  BTextView *fText;
+  BStringView *fStatus;
+  BButton *fBtnTrim;
+  BButton *fBtnSave;
+  BMessageRunner *fRunner;
+};
+
+#endif // BETON_MEMORY_STATS_WINDOW_H
@@ -2,6 +2,7 @@
 #include "ArtworkView.h"
 
 #include "MarqueeTextView.h"
+#include "SpectrumView.h"
 #include <Catalog.h>
 #include <GroupLayout.h>
 #include <LayoutBuilder.h>
@@ -67,6 +68,10 @@ NowPlayingInfoPanel::NowPlayingInfoPanel() : BView("NowPlayingInfoPanel", B_WILL
   fTechView->SetFont(&tinyFont);
   fTechView->SetExplicitMaxSize(BSize(B_SIZE_UNLIMITED, B_SIZE_UNSET));
 
+  fSpectrumView = new SpectrumView("spectrum");
+  fSpectrumView->SetExplicitMinSize(BSize(B_SIZE_UNSET, fontHeight * 2));
+  fSpectrumView->SetExplicitMaxSize(BSize(B_SIZE_UNLIMITED, fontHeight * 3));
+
   fInfoBox = new BBox("infoBox");
   fInfoBox->SetLabel(B_TRANSLATE("File Information"));
   fInfoBox->SetBorder(B_FANCY_BORDER);
@@ -81,6 +86,7 @@ NowPlayingInfoPanel::NowPlayingInfoPanel() : BView("NowPlayingInfoPanel", B_WILL
       .Add(fAlbumMarquee)
       .Add(fTechView)
       .AddGlue()
+      .Add(fSpectrumView)
       .SetInsets(10, 15, 10, 10);
 
   fArtworkView = new ArtworkView("cover");
@@ -109,6 +115,7 @@ void NowPlayingInfoPanel::SetInfoVisible(bool visible) {
     } else {
       fInfoBox->Hide();
     }
+    _UpdateSpectrum();
     InvalidateLayout();
     Invalidate();
     if (Parent())
@@ -237,6 +244,17 @@ void NowPlayingInfoPanel::SetBoxLabel(const char *label) {
     fInfoBox->SetLabel(label);
 }
 
+void NowPlayingInfoPanel::SetAnalysisTap(AnalysisTap *tap) {
+  fAnalysisTap = tap;
+  _UpdateSpectrum();
+}
+
+/** @brief Lets the spectrum listen only while the metadata box is shown. */
+void NowPlayingInfoPanel::_UpdateSpectrum() {
+  if (fSpectrumView)
+    fSpectrumView->SetTap(fIsInfoVisible ? fAnalysisTap : nullptr);
+}
+
 void NowPlayingInfoPanel::SetWordWrap(bool wrap) {
   /**
    * @brief Kept for API compatibility; word-wrapping is no longer used.
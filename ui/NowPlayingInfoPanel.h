@@ -7,8 +7,10 @@
 
 class BGroupLayout;
 class BBitmap;
+class AnalysisTap;
 class ArtworkView;
 class MarqueeTextView;
+class SpectrumView;
 class BStringView;
 
 /**
@@ -17,7 +19,8 @@ class BStringView;
  * Uses a vertical BGroupLayout to stack components.
  * - `MetadataView` shows track details.
  * - `ArtworkView` shows album cover art.
- * Both can be toggled independently.
+ * Both can be toggled independently. The metadata box also holds a
+ * SpectrumView of the output, which listens only while the box is shown.
  */
 class NowPlayingInfoPanel : public BView {
 public:
@@ -52,12 +55,16 @@ public:
   
   void SetWordWrap(bool wrap);
 
+  /** @brief Source of the spectrum display; nullptr before the engine goes. */
+  void SetAnalysisTap(AnalysisTap *tap);
+
   void AttachedToWindow() override;
   void MessageReceived(BMessage *msg) override;
 
 private:
   void _UpdatePanelVisibility();
   void _ApplyColors();
+  void _UpdateSpectrum();
 
   /** @name UI Components */
   ///@{
@@ -68,6 +75,8 @@ private:
   MarqueeTextView *fArtistMarquee = nullptr;
   MarqueeTextView *fAlbumMarquee = nullptr;
   BStringView *fTechView = nullptr;
+  SpectrumView *fSpectrumView = nullptr;
+  AnalysisTap *fAnalysisTap = nullptr;
 
   BView *fCoverPane = nullptr;
   ArtworkView *fArtworkView = nullptr;
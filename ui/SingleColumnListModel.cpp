@@ -0,0 +1,92 @@
+#include "SingleColumnListModel.h"
+
+#include <algorithm>
+#include <strings.h>
+
+void SingleColumnListModel::Add(const BString &text, const BString &data) {
+  fEntries.push_back({text, data});
+  fOrder.clear();
+}
+
+void SingleColumnListModel::RemoveAt(int32 index) {
+  if (index < 0 || index >= Count())
+    return;
+  fEntries.erase(fEntries.begin() + index);
+  fOrder.clear();
+}
+
+const BString &SingleColumnListModel::TextAt(int32 index) const {
+  static BString empty("");
+  if (index < 0 || index >= Count())
+    return empty;
+  return fEntries[index].text;
+}
+
+const BString &SingleColumnListModel::DataAt(int32 index) const {
+  static BString empty("");
+  if (index < 0 || index >= Count())
+    return empty;
+  return fEntries[index].data;
+}
+
+const std::vector<int32> &SingleColumnListModel::_Order() const {
+  if (fOrder.size() == fEntries.size())
+    return fOrder;
+
+  fOrder.resize(fEntries.size());
+  for (size_t i = 0; i < fOrder.size(); i++)
+    fOrder[i] = (int32)i;
+  std::stable_sort(fOrder.begin(), fOrder.end(), [this](int32 a, int32 b) {
+    return fEntries[a].text.ICompare(fEntries[b].text) < 0;
+  });
+  return fOrder;
+}
+
+int32 SingleColumnListModel::IndexOf(const BString &text) const {
+  const std::vector<int32> &order = _Order();
+  auto it = std::lower_bound(order.begin(), order.end(), text,
+                             [this](int32 index, const BString &value) {
+                               return fEntries[index].text.ICompare(value) < 0;
+                             });
+  // Rows that differ only in case sort next to each other.
+  for (; it != order.end() && fEntries[*it].text.ICompare(text) == 0; ++it) {
+    if (fEntries[*it].text == text)
+      return *it;
+  }
+  return -1;
+}
+
+int32 SingleColumnListModel::IndexOfData(const BString &data) const {
+  for (int32 i = 0; i < Count(); i++) {
+    if (fEntries[i].data == data)
+      return i;
+  }
+  return -1;
+}
+
+int32 SingleColumnListModel::FindPrefix(const BString &prefix) const {
+  if (prefix.IsEmpty())
+    return -1;
+
+  const std::vector<int32> &order = _Order();
+  auto it = std::lower_bound(order.begin(), order.end(), prefix,
+                             [this](int32 index, const BString &value) {
+                               return fEntries[index].text.ICompare(value) < 0;
+                             });
+  if (it == order.end() ||
+      strncasecmp(fEntries[*it].text.String(), prefix.String(),
+                  prefix.Length()) != 0)
+    return -1;
+  return *it;
+}
+
+bool SingleColumnListModel::Equals(const SingleColumnListModel &other) const {
+  if (Count() != other.Count())
+    return false;
+  for (int32 i = 0; i < Count(); i++) {
+    if (fEntries[i].text != other.fEntries[i].text ||
+        fEntries[i].data != other.fEntries[i].data)
+      return false;
+  }
+  return true;
+}
@@ -0,0 +1,68 @@
+#ifndef BETON_SINGLE_COLUMN_LIST_MODEL_H
+#define BETON_SINGLE_COLUMN_LIST_MODEL_H
+
+#include <Referenceable.h>
+#include <String.h>
+#include <SupportDefs.h>
+
+#include <vector>
+
+/**
+ * @class SingleColumnListModel
+ * @brief Contents of a model-backed SingleColumnListView.
+ *
+ * Holds the rows in display order. The strings are BString copies, so they
+ * share their buffers with the (interned) library strings they came from.
+ * A case-insensitive sort order is built on first use for type-ahead and
+ * lookups by text.
+ *
+ * A whole refresh builds a new model and hands it to the view with
+ * `SingleColumnListView::SetModel()`. A model may be shown by several views
+ * or kept in the ViewModelCache; a view edits a private copy then.
+ */
+class SingleColumnListModel : public BReferenceable {
+public:
+  SingleColumnListModel() = default;
+
+  /** @brief Copies the rows (not the references or the lookup order). */
+  SingleColumnListModel(const SingleColumnListModel &other)
+      : BReferenceable(), fEntries(other.fEntries) {}
+
+  void Reserve(int32 count) { fEntries.reserve(count); }
+  void Add(const BString &text, const BString &data = BString());
+  void RemoveAt(int32 index);
+
+  int32 Count() const { return (int32)fEntries.size(); }
+  const BString &TextAt(int32 index) const;
+  const BString &DataAt(int32 index) const;
+
+  /** @brief Index of the row with exactly `text`, or -1. */
+  int32 IndexOf(const BString &text) const;
+
+  /** @brief Index of the row with exactly `data`, or -1. */
+  int32 IndexOfData(const BString &data) const;
+
+  /**
+   * @brief Row whose text starts with `prefix` (case-insensitive), or -1.
+   *
+   * Of several matches the one first in case-insensitive order is returned.
+   */
+  int32 FindPrefix(const BString &prefix) const;
+
+  /** @brief Whether both models show the same rows. */
+  bool Equals(const SingleColumnListModel &other) const;
+
+private:
+  struct Entry {
+    BString text;
+    BString data;
+  };
+
+  /** @brief Entry indexes sorted by case-insensitive text; built lazily. */
+  const std::vector<int32> &_Order() const;
+
+  std::vector<Entry> fEntries;
+  mutable std::vector<int32> fOrder;
+};
+
+#endif // BETON_SINGLE_COLUMN_LIST_MODEL_H
@@ -2,6 +2,7 @@
 #include "Debug.h"
 
 #include <Font.h>
+#include <OS.h>
 #include <ScrollBar.h>
 #include <Window.h>
 
@@ -43,7 +44,12 @@ void SingleColumnListView::AddItem(const BString &text) {
  * @param path The hidden value/path associated with the item.
  */
 void SingleColumnListView::AddItem(const BString &text, const BString &path) {
-  fItems.push_back({text, path, false});
+  if (fModel) {
+    _DetachModel();
+    fModel->Add(text, path);
+  } else {
+    fItems.push_back({text, path, false});
+  }
   UpdateScrollbars();
   Invalidate();
 }
@@ -53,6 +59,7 @@ void SingleColumnListView::AddItem(const BString &text, const BString &path) {
  */
 void SingleColumnListView::Clear() {
   fItems.clear();
+  fModel.Unset();
   fCurrentSelection = -1;
   UpdateScrollbars();
   Invalidate();
@@ -65,6 +72,7 @@ void SingleColumnListView::Clear() {
  */
 void SingleColumnListView::SetItems(
     const std::vector<std::pair<BString, BString>> &items) {
+  fModel.Unset();
   fItems.clear();
   fItems.reserve(items.size());
   fCurrentSelection = -1;
@@ -75,16 +83,36 @@ void SingleColumnListView::SetItems(
   Invalidate();
 }
 
+void SingleColumnListView::SetModel(SingleColumnListModel *model) {
+  fItems.clear();
+  fModel.SetTo(model);
+  fCurrentSelection = -1;
+  UpdateScrollbars();
+  Invalidate();
+}
+
+/**
+ * @brief Gives the view its own copy of a model that others reference too.
+ */
+void SingleColumnListView::_DetachModel() {
+  if (fModel && fModel->CountReferences() > 1)
+    fModel.SetTo(new SingleColumnListModel(*fModel), true);
+}
+
 /**
  * @return The number of items in the list.
  */
-int32 SingleColumnListView::CountItems() const { return (int32)fItems.size(); }
+int32 SingleColumnListView::CountItems() const {
+  return fModel ? fModel->Count() : (int32)fItems.size();
+}
 
 /**
  * @return The display text of the item at the specified index.
  */
 const BString &SingleColumnListView::ItemAt(int32 index) const {
   static BString empty("");
+  if (fModel)
+    return fModel->TextAt(index);
   if (index < 0 || index >= (int32)fItems.size())
     return empty;
   return fItems[index].text;
@@ -95,6 +123,8 @@ const BString &SingleColumnListView::ItemAt(int32 index) const {
  */
 const BString &SingleColumnListView::PathAt(int32 index) const {
   static BString empty("");
+  if (fModel)
+    return fModel->DataAt(index);
   if (index < 0 || index >= (int32)fItems.size())
     return empty;
   return fItems[index].path;
@@ -109,7 +139,15 @@ int32 SingleColumnListView::CurrentSelection() const { return fCurrentSelection;
  * @brief Removes the item at the specified index.
  */
 void SingleColumnListView::RemoveItemAt(int32 index) {
-  if (index >= 0 && index < (int32)fItems.size()) {
+  if (fModel) {
+    _DetachModel();
+    fModel->RemoveAt(index);
+    if (fCurrentSelection == index)
+      fCurrentSelection = -1;
+    else if (fCurrentSelection > index)
+      fCurrentSelection--;
+    Invalidate();
+  } else if (index >= 0 && index < (int32)fItems.size()) {
     fItems.erase(fItems.begin() + index);
     Invalidate();
   }
@@ -120,13 +158,14 @@ void SingleColumnListView::RemoveItemAt(int32 index) {
  * @param index The index to select.
  */
 void SingleColumnListView::Select(int32 index) {
-  if (index < 0 || index >= (int32)fItems.size())
+  if (index < 0 || index >= CountItems())
     return;
   if (fCurrentSelection >= 0 && fCurrentSelection < (int32)fItems.size())
     fItems[fCurrentSelection].selected = false;
 
   fCurrentSelection = index;
-  fItems[index].selected = true;
+  if (!fModel)
+    fItems[index].selected = true;
   Invalidate();
 }
 
@@ -134,8 +173,9 @@ void SingleColumnListView::Select(int32 index) {
  * @brief Removes selection from all items.
  */
 void SingleColumnListView::DeselectAll() {
-  if (fCurrentSelection >= 0 && fCurrentSelection < (int32)fItems.size()) {
-    fItems[fCurrentSelection].selected = false;
+  if (fCurrentSelection >= 0 && fCurrentSelection < CountItems()) {
+    if (!fModel)
+      fItems[fCurrentSelection].selected = false;
     fCurrentSelection = -1;
     Invalidate();
   }
@@ -145,7 +185,7 @@ void SingleColumnListView::DeselectAll() {
  * @brief Scrolls the view to ensure the selected item is visible.
  */
 void SingleColumnListView::ScrollToSelection() {
-  if (fCurrentSelection < 0 || fCurrentSelection >= (int32)fItems.size())
+  if (fCurrentSelection < 0 || fCurrentSelection >= CountItems())
     return;
 
   float y = fCurrentSelection * fItemHeight;
@@ -166,7 +206,8 @@ void SingleColumnListView::ScrollToSelection() {
  */
 void SingleColumnListView::UpdateScrollbars() {
   const float lh = fItemHeight;
-  const float contentHeight = std::max(1.0f, (float)fItems.size() * lh + fExtraBottomPadding);
+  const float contentHeight =
+      std::max(1.0f, (float)CountItems() * lh + fExtraBottomPadding);
 
   float viewHeight = Bounds().Height();
   if (Parent())
@@ -210,16 +251,21 @@ float SingleColumnListView::LineHeight() const {
 
 void SingleColumnListView::Draw(BRect updateRect) {
   BRect bounds = Bounds();
-  int32 first = (int32)(updateRect.top / fItemHeight);
+  // Only the rows inside the update rect; the rest are clipped anyway.
+  int32 first = std::max((int32)0, (int32)(updateRect.top / fItemHeight));
   int32 last = (int32)(updateRect.bottom / fItemHeight);
-  int32 maxRow = std::max(last, (int32)fItems.size() - 1);
+  const int32 count = CountItems();
 
   rgb_color base = ui_color(B_LIST_BACKGROUND_COLOR);
 
   int brightness = base.red + base.green + base.blue;
   bool isDark = (brightness < 384);
 
-  for (int32 i = first; i <= maxRow; ++i) {
+  font_height fh;
+  GetFontHeight(&fh);
+  float textHeight = ceilf(fh.ascent + fh.descent + fh.leading);
+
+  for (int32 i = first; i <= last; ++i) {
     float top = i * fItemHeight;
     BRect rowRect(bounds.left, top, bounds.right, top + fItemHeight - 1);
 
@@ -233,9 +279,9 @@ void SingleColumnListView::Draw(BRect updateRect) {
     }
     FillRect(rowRect);
 
-    if (i < (int32)fItems.size()) {
-
-      if (fItems[i].selected) {
+    if (i < count) {
+      bool selected = fModel ? i == fCurrentSelection : fItems[i].selected;
+      if (selected) {
         if (fUseCustomColor) {
           SetHighColor(fSelectionColor);
           FillRect(rowRect);
@@ -260,9 +306,6 @@ void SingleColumnListView::Draw(BRect updateRect) {
         SetHighColor(ui_color(B_LIST_ITEM_TEXT_COLOR));
       }
 
-      font_height fh;
-      GetFontHeight(&fh);
-      float textHeight = ceilf(fh.ascent + fh.descent + fh.leading);
       /**
        * @brief Vertically center text baseline in row rectangle.
        */
@@ -270,7 +313,7 @@ void SingleColumnListView::Draw(BRect updateRect) {
                        floorf((rowRect.Height() - textHeight) / 2.0f) +
                        fh.ascent;
 
-      DrawString(fItems[i].text.String(), BPoint(rowRect.left + 5, baseline));
+      DrawString(ItemAt(i).String(), BPoint(rowRect.left + 5, baseline));
     }
   }
 }
@@ -283,8 +326,45 @@ void SingleColumnListView::MouseDown(BPoint where) {
   MakeFocus(true);
   int32 index = (int32)(where.y / fItemHeight);
 
-  if (index >= 0 && index < (int32)fItems.size()) {
+  if (index >= 0 && index < CountItems()) {
+    Select(index);
+    SelectionChanged(index);
+  }
+}
+
+/**
+ * @brief Type-ahead: selects the first row starting with the typed text.
+ *
+ * Keys typed within a second of each other extend the search text. Model
+ * lists answer with a binary search over their sorted order.
+ */
+void SingleColumnListView::KeyDown(const char *bytes, int32 numBytes) {
+  if (numBytes <= 0 || (uint8)bytes[0] < ' ' || bytes[0] == B_DELETE) {
+    BView::KeyDown(bytes, numBytes);
+    return;
+  }
+
+  bigtime_t now = system_time();
+  if (now - fLastTypeAhead > 1000000)
+    fTypeAhead = "";
+  fLastTypeAhead = now;
+  fTypeAhead.Append(bytes, numBytes);
+
+  int32 index = -1;
+  if (fModel) {
+    index = fModel->FindPrefix(fTypeAhead);
+  } else {
+    for (int32 i = 0; i < (int32)fItems.size(); i++) {
+      if (fItems[i].text.IStartsWith(fTypeAhead)) {
+        index = i;
+        break;
+      }
+    }
+  }
+
+  if (index >= 0 && index != fCurrentSelection) {
     Select(index);
+    ScrollToSelection();
     SelectionChanged(index);
   }
 }
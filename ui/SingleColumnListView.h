@@ -1,6 +1,8 @@
 #ifndef BETON_SINGLE_COLUMN_LIST_VIEW_H
 #define BETON_SINGLE_COLUMN_LIST_VIEW_H
 
+#include "SingleColumnListModel.h"
+
 #include <Message.h>
 #include <Messenger.h>
 #include <Rect.h>
@@ -29,6 +31,11 @@ struct SimpleItem {
  * vertical column. It handles drawing, scrollbar updates, and mouse interaction
  * for selection. It sends a message to a target when the selection changes. And
  * the best, it works now!!!!!
+ *
+ * Rows either live in the view (`AddItem()`, `SetItems()`) or in a shared
+ * `SingleColumnListModel` set with `SetModel()`; the latter makes a refresh
+ * of a large list a pointer swap. Only visible rows are drawn. Typing
+ * selects the first row starting with the typed text.
  */
 class SingleColumnListView : public BView {
 public:
@@ -62,6 +69,16 @@ public:
    */
   void SetItems(const std::vector<std::pair<BString, BString>> &items);
 
+  /**
+   * @brief Shows `model` instead of the view's own items.
+   *
+   * Clears the selection. Passing nullptr returns to an empty item list.
+   */
+  void SetModel(SingleColumnListModel *model);
+
+  /** @return The current model, or nullptr in item mode. */
+  SingleColumnListModel *Model() const { return fModel.Get(); }
+
   int32 CountItems() const;
   const BString &ItemAt(int32 index) const;
   const BString &PathAt(int32 index) const;
@@ -77,6 +94,7 @@ public:
   void Draw(BRect updateRect) override;
   void FrameResized(float width, float height) override;
   void MouseDown(BPoint where) override;
+  void KeyDown(const char *bytes, int32 numBytes) override;
   void MessageReceived(BMessage *msg) override;
 
   /**
@@ -112,13 +130,22 @@ public:
   void SetExtraBottomPadding(float padding);
 
 protected:
+  void _DetachModel();
+
   /** @name Data */
   ///@{
   std::vector<SimpleItem> fItems;
+  BReference<SingleColumnListModel> fModel; ///< Rows in model mode
   float fItemHeight;
   int32 fCurrentSelection;
   ///@}
 
+  /** @name Type-ahead */
+  ///@{
+  BString fTypeAhead;
+  bigtime_t fLastTypeAhead = 0;
+  ///@}
+
   /** @name Notification */
   ///@{
   uint32 fSelectionWhat = 0;
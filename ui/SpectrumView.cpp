@@ -0,0 +1,150 @@
+#include "SpectrumView.h"
+#include "Messages.h"
+
+#include <MessageRunner.h>
+#include <Window.h>
+
+#include <algorithm>
+
+namespace {
+
+const float kRange = 60.0f;       ///< dB shown below full scale
+const float kFallPerTick = 1.5f;  ///< dB the bars drop per refresh
+const bigtime_t kPeakHold = 1000000;
+
+/** @brief Position of `db` in [0, 1] on the displayed scale. */
+float Scale(float db) {
+  return std::max(0.0f, std::min(1.0f, (db + kRange) / kRange));
+}
+
+} // namespace
+
+SpectrumView::SpectrumView(const char *name)
+    : BView(name, B_WILL_DRAW | B_FULL_UPDATE_ON_RESIZE), fTap(nullptr),
+      fListening(false), fRunner(nullptr), fSerial(0), fChannels(0) {
+  SetViewColor(B_TRANSPARENT_COLOR);
+  std::fill(fBands, fBands + AnalysisTap::kBands, AnalysisTap::kFloor);
+  std::fill(fLevels, fLevels + AnalysisTap::kMaxChannels, AnalysisTap::kFloor);
+  std::fill(fPeaks, fPeaks + AnalysisTap::kMaxChannels, AnalysisTap::kFloor);
+  std::fill(fPeakTime, fPeakTime + AnalysisTap::kMaxChannels, 0);
+}
+
+SpectrumView::~SpectrumView() { _Listen(false); }
+
+void SpectrumView::SetTap(AnalysisTap *tap) {
+  if (tap == fTap)
+    return;
+  _Listen(false);
+  fTap = tap;
+  _Listen(Window() != nullptr);
+}
+
+void SpectrumView::AttachedToWindow() {
+  BView::AttachedToWindow();
+  _Listen(true);
+}
+
+void SpectrumView::DetachedFromWindow() {
+  _Listen(false);
+  BView::DetachedFromWindow();
+}
+
+void SpectrumView::MessageReceived(BMessage *msg) {
+  switch (msg->what) {
+  case MSG_SPECTRUM_TICK:
+    _Update();
+    break;
+  default:
+    BView::MessageReceived(msg);
+  }
+}
+
+/** @brief Attaches to or detaches from the tap and starts/stops polling. */
+void SpectrumView::_Listen(bool listen) {
+  listen = listen && fTap != nullptr;
+  if (listen == fListening)
+    return;
+  fListening = listen;
+  delete fRunner;
+  fRunner = nullptr;
+  if (listen) {
+    fTap->Attach();
+    BMessage tick(MSG_SPECTRUM_TICK);
+    fRunner = new BMessageRunner(BMessenger(this), &tick,
+                                 AnalysisTap::kInterval);
+  } else {
+    fTap->Detach();
+  }
+}
+
+void SpectrumView::_Update() {
+  AnalysisTap::Snapshot snapshot;
+  if (fTap == nullptr || !fTap->Read(snapshot) || snapshot.serial == fSerial)
+    return;
+  fSerial = snapshot.serial;
+
+  bool changed = snapshot.channels != fChannels;
+  fChannels = snapshot.channels;
+  for (int32 i = 0; i < AnalysisTap::kBands; i++) {
+    float value = std::max(snapshot.bands[i], fBands[i] - kFallPerTick);
+    changed |= value != fBands[i];
+    fBands[i] = value;
+  }
+
+  const bigtime_t now = system_time();
+  for (int32 i = 0; i < AnalysisTap::kMaxChannels; i++) {
+    float level = std::max(snapshot.rms[i], fLevels[i] - kFallPerTick);
+    changed |= level != fLevels[i];
+    fLevels[i] = level;
+    float held = fPeaks[i];
+    if (snapshot.peak[i] >= fPeaks[i]) {
+      fPeaks[i] = snapshot.peak[i];
+      fPeakTime[i] = now;
+    } else if (now - fPeakTime[i] > kPeakHold) {
+      fPeaks[i] = std::max(snapshot.peak[i], fPeaks[i] - kFallPerTick);
+    }
+    changed |= fPeaks[i] != held;
+  }
+
+  if (changed)
+    Invalidate();
+}
+
+void SpectrumView::Draw(BRect) {
+  BRect bounds = Bounds();
+  rgb_color background =
+      tint_color(ui_color(B_PANEL_BACKGROUND_COLOR), B_DARKEN_1_TINT);
+  rgb_color bar = ui_color(B_CONTROL_HIGHLIGHT_COLOR);
+  rgb_color peak = tint_color(bar, B_DARKEN_2_TINT);
+  SetHighColor(background);
+  FillRect(bounds);
+
+  // Two thin meters at the bottom, the spectrum above them.
+  const float meterHeight = 3.0f;
+  const int32 meters = std::max<int32>(1, fChannels);
+  BRect spectrum = bounds;
+  spectrum.bottom -= meters * (meterHeight + 1.0f) + 1.0f;
+
+  SetHighColor(bar);
+  const float width = spectrum.Width() / AnalysisTap::kBands;
+  for (int32 i = 0; i < AnalysisTap::kBands; i++) {
+    float height = Scale(fBands[i]) * spectrum.Height();
+    if (height < 1.0f)
+      continue;
+    BRect r(spectrum.left + i * width, spectrum.bottom - height,
+            spectrum.left + (i + 1) * width - 2.0f, spectrum.bottom);
+    FillRect(r);
+  }
+
+  for (int32 i = 0; i < meters && i < AnalysisTap::kMaxChannels; i++) {
+    float top = spectrum.bottom + 2.0f + i * (meterHeight + 1.0f);
+    BRect r(bounds.left, top, bounds.left, top + meterHeight - 1.0f);
+    r.right = bounds.left + Scale(fLevels[i]) * bounds.Width();
+    SetHighColor(bar);
+    if (r.right > r.left)
+      FillRect(r);
+    float x = bounds.left + Scale(fPeaks[i]) * bounds.Width();
+    SetHighColor(peak);
+    StrokeLine(BPoint(x, top), BPoint(x, top + meterHeight - 1.0f));
+  }
+}
@@ -0,0 +1,51 @@
+#ifndef BETON_SPECTRUM_VIEW_H
+#define BETON_SPECTRUM_VIEW_H
+
+#include "AnalysisTap.h"
+
+#include <View.h>
+
+class BMessageRunner;
+
+/**
+ * @class SpectrumView
+ * @brief Spectrum bars with a level meter per channel underneath, drawn
+ * from an AnalysisTap.
+ *
+ * The view listens to the tap (AnalysisTap::Attach()) only while it has
+ * one and is attached to a window, and polls it every
+ * AnalysisTap::kInterval. Bars fall back slowly; peaks are held briefly.
+ */
+class SpectrumView : public BView {
+public:
+  explicit SpectrumView(const char *name);
+  ~SpectrumView() override;
+
+  /** @brief Starts listening to `tap`; nullptr stops. Window thread. */
+  void SetTap(AnalysisTap *tap);
+
+  void AttachedToWindow() override;
+  void DetachedFromWindow() override;
+  void Draw(BRect updateRect) override;
+  void MessageReceived(BMessage *msg) override;
+
+private:
+  void _Listen(bool listen);
+  void _Update();
+
+  AnalysisTap *fTap;
+  bool fListening;
+  BMessageRunner *fRunner;
+  uint32 fSerial; ///< Serial of the last snapshot shown
+
+  /** @name Displayed values, dBFS */
+  ///@{
+  float fBands[AnalysisTap::kBands];
+  float fLevels[AnalysisTap::kMaxChannels];
+  float fPeaks[AnalysisTap::kMaxChannels];
+  bigtime_t fPeakTime[AnalysisTap::kMaxChannels];
+  int32 fChannels;
+  ///@}
+};
+
+#endif // BETON_SPECTRUM_VIEW_H
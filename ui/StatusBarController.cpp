@@ -2,21 +2,53 @@
 
 #include "MediaTableView.h"
 #include "DLNAService.h"
+#include "DLNAViewController.h"
 #include "LibraryBrowserController.h"
+#include "LibraryController.h"
 #include "MainWindow.h"
 #include "MediaItem.h"
 #include "Messages.h"
+#include "RadioStationController.h"
 #include "RadioStationLibrary.h"
 
 #include <Catalog.h>
 #include <Message.h>
 #include <MessageRunner.h>
 #include <Messenger.h>
+#include <StringForSize.h>
 #include <StringView.h>
 
 #undef B_TRANSLATION_CONTEXT
 #define B_TRANSLATION_CONTEXT "StatusBarController"
 
+/** @brief "N tracks. Total duration ..." plus the size when known. */
+static BString FormatTotals(const LibraryTotals &totals) {
+  BString text;
+  const int64 duration = totals.duration;
+  if (duration > 0) {
+    int32 h = duration / 3600;
+    int32 m = (duration % 3600) / 60;
+    int32 s = duration % 60;
+    if (h > 0)
+      text.SetToFormat(
+          B_TRANSLATE("%ld tracks. Total duration %02d:%02d:%02d"),
+          (long)totals.count, (int)h, (int)m, (int)s);
+    else
+      text.SetToFormat(B_TRANSLATE("%ld tracks. Total duration %02d:%02d"),
+                       (long)totals.count, (int)m, (int)s);
+  } else {
+    text.SetToFormat(B_TRANSLATE("%ld tracks"), (long)totals.count);
+  }
+
+  if (totals.size > 0) {
+    char sizeText[64];
+    text << " (" << string_for_size((double)totals.size, sizeText,
+                                    sizeof(sizeText))
+         << ")";
+  }
+  return text;
+}
+
 StatusBarController::StatusBarController(MainWindow *window) : fWindow(window) {}
 
 bool StatusBarController::HandleMessage(BMessage *msg) {
@@ -29,6 +61,12 @@ bool StatusBarController::HandleMessage(BMessage *msg) {
     break;
 
   case MSG_SEARCH_EXECUTE:
+    // A paged station list has to be searched in the library, not the view.
+    if (fWindow->fIsRadioMode && fWindow->fRadioStationController &&
+        fWindow->fRadioStationController->IsPaged()) {
+      fWindow->fRadioStationController->ShowStations();
+      break;
+    }
     fWindow->UpdateFilteredViews();
     break;
 
@@ -52,10 +90,16 @@ bool StatusBarController::HandleMessage(BMessage *msg) {
 
   case MSG_LIBRARY_PREVIEW:
     UpdateLibraryPreview(msg);
+    if (msg->GetInt32("count", 0) > 0 && fWindow->fLibraryController)
+      fWindow->fLibraryController->NoteRowsShown(false);
+    if (fWindow->fIsDlnaMode && fWindow->fDlnaController)
+      fWindow->fDlnaController->PrefetchCovers();
     break;
 
   case MSG_COUNT_UPDATED:
     UpdateLibraryStatus();
+    if (fWindow->fLibraryController)
+      fWindow->fLibraryController->NoteRowsShown(true);
     break;
 
   default:
@@ -86,30 +130,13 @@ void StatusBarController::UpdateLibraryPreview(BMessage *msg) {
     return;
   }
 
-  int32 count = 0;
-  int64 duration = 0;
-  if (msg->FindInt32("count", &count) != B_OK)
+  LibraryTotals totals;
+  if (msg->FindInt32("count", &totals.count) != B_OK)
     return;
+  totals.duration = msg->GetInt64("duration", 0);
+  totals.size = msg->GetInt64("size", 0);
 
-  if (msg->FindInt64("duration", &duration) != B_OK)
-    duration = 0;
-
-  BString text;
-  if (duration > 0) {
-    int32 h = duration / 3600;
-    int32 m = (duration % 3600) / 60;
-    int32 s = duration % 60;
-    if (h > 0)
-      text.SetToFormat(
-          B_TRANSLATE("%ld  tracks. Total duration %02d:%02d:%02d"),
-          (long)count, (int)h, (int)m, (int)s);
-    else
-      text.SetToFormat(B_TRANSLATE("%ld  tracks. Total duration %02d:%02d"),
-                       (long)count, (int)m, (int)s);
-  } else {
-    text.SetToFormat(B_TRANSLATE("%ld tracks"), (long)count);
-  }
-
+  BString text = FormatTotals(totals);
   if (fWindow->fStatusLabel)
     fWindow->fStatusLabel->SetText(text.String());
 }
@@ -180,39 +207,33 @@ void StatusBarController::UpdateLibraryStatus() {
   if (!fWindow->fCacheLoaded)
     return;
 
-  int32 count = 0;
-  int64 totalSeconds = 0;
-
+  // The last filter pass already summed the list; rows changed since then
+  // and the full library are summed here, the latter from its columns.
+  LibraryTotals totals;
   if (fWindow->fLibraryManager && fWindow->fLibraryManager->ContentView()) {
     MediaTableView *cv = fWindow->fLibraryManager->ContentView();
-    count = cv->CountRows();
-    for (int32 i = 0; i < count; ++i) {
-      const MediaItem *mi = cv->ItemAt(i);
-      if (mi)
-        totalSeconds += mi->duration;
+    const int32 count = cv->CountRows();
+    totals = fWindow->fLibraryManager->ShownTotals();
+    if (totals.count != count) {
+      totals = LibraryTotals();
+      totals.count = count;
+      for (int32 i = 0; i < count; ++i) {
+        const MediaItem *mi = cv->ItemAt(i);
+        if (mi) {
+          totals.duration += mi->duration;
+          totals.size += mi->size;
+        }
+      }
     }
-  } else {
-    count = fWindow->fAllItems.size();
-    for (const auto &mi : fWindow->fAllItems)
-      totalSeconds += mi.duration;
+  } else if (fWindow->fAllItems.Snapshot() != nullptr) {
+    totals = fWindow->fAllItems.Snapshot()->Columns().Totals();
   }
 
-  if (count == 0) {
+  if (totals.count == 0) {
     UpdateStatus(B_TRANSLATE("No results found."), true);
     return;
   }
 
-  int32 hours = totalSeconds / 3600;
-  int32 mins = (totalSeconds % 3600) / 60;
-  int32 secs = totalSeconds % 60;
-
-  BString s;
-  if (hours > 0)
-    s.SetToFormat(B_TRANSLATE("%ld tracks. Total duration %02d:%02d:%02d"),
-                  (long)count, (int)hours, (int)mins, (int)secs);
-  else
-    s.SetToFormat(B_TRANSLATE("%ld tracks. Total duration %02d:%02d"),
-                  (long)count, (int)mins, (int)secs);
-
+  BString s = FormatTotals(totals);
   UpdateStatus(s.String(), true);
 }
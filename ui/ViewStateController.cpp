@@ -303,6 +303,10 @@ void ViewStateController::HandleContentSelectionChanged() {
   if (fWindow->fNowPlayingInfoPanel)
     fWindow->fNowPlayingInfoPanel->ClearCover();
 
-  if (fWindow->fArtworkController)
+  if (!fWindow->fArtworkController)
+    return;
+  if (fWindow->fIsDlnaMode)
+    fWindow->fArtworkController->FetchItemCover(*mi);
+  else
     fWindow->fArtworkController->FetchEmbeddedCoverBitmap(mi->path);
 }